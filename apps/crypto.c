@@ -18,6 +18,10 @@
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
 
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) && !defined(XMLSEC_NO_X509)
+#include <xmlsec/openssl/x509.h>
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) && !defined(XMLSEC_NO_X509) */
+
 #include "crypto.h"
 
 int
@@ -84,6 +88,56 @@ xmlSecAppCryptoSimpleKeysMngrCertLoad(xmlSecKeysMngrPtr mngr, const char *filena
 #endif /* XMLSEC_NO_X509 */    
 }
 
+int
+xmlSecAppCryptoSimpleKeysMngrOcspResponseLoad(xmlSecKeysMngrPtr mngr, const char *filename) {
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) && !defined(XMLSEC_NO_X509)
+    xmlSecKeyDataStorePtr store;
+    xmlSecBuffer buffer;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    store = xmlSecKeysMngrGetDataStore(mngr, xmlSecOpenSSLX509StoreId);
+    if(store == NULL) {
+        fprintf(stderr, "Error: xmlSecKeysMngrGetDataStore failed\n");
+        return(-1);
+    }
+
+    ret = xmlSecBufferInitialize(&buffer, 0);
+    if(ret < 0) {
+        fprintf(stderr, "Error: xmlSecBufferInitialize failed\n");
+        return(-1);
+    }
+
+    ret = xmlSecBufferReadFile(&buffer, filename);
+    if(ret < 0) {
+        fprintf(stderr, "Error: xmlSecBufferReadFile failed: file=%s\n",
+                xmlSecErrorsSafeString(filename));
+        xmlSecBufferFinalize(&buffer);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLX509StoreAddOcspResponse(store, xmlSecBufferGetData(&buffer),
+                xmlSecBufferGetSize(&buffer));
+    if(ret < 0) {
+        fprintf(stderr, "Error: xmlSecOpenSSLX509StoreAddOcspResponse failed: file=%s\n",
+                xmlSecErrorsSafeString(filename));
+        xmlSecBufferFinalize(&buffer);
+        return(-1);
+    }
+
+    xmlSecBufferFinalize(&buffer);
+    return(0);
+#else /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) && !defined(XMLSEC_NO_X509) */
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    fprintf(stderr, "Error: loading OCSP responses is supported only by the OpenSSL crypto library\n");
+    return(-1);
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) && !defined(XMLSEC_NO_X509) */
+}
+
 int 
 xmlSecAppCryptoSimpleKeysMngrKeyAndCertsLoad(xmlSecKeysMngrPtr mngr, 
                                              const char* files, const char* pwd, 
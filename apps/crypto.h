@@ -42,6 +42,8 @@ int     xmlSecAppCryptoSimpleKeysMngrCertLoad                   (xmlSecKeysMngrP
                                                                  const char *filename, 
                                                                  xmlSecKeyDataFormat format,
                                                                  xmlSecKeyDataType type);
+int     xmlSecAppCryptoSimpleKeysMngrOcspResponseLoad           (xmlSecKeysMngrPtr mngr, 
+                                                                 const char *filename);
 int     xmlSecAppCryptoSimpleKeysMngrKeyAndCertsLoad            (xmlSecKeysMngrPtr mngr, 
                                                                  const char *files, 
                                                                  const char* pwd, 
@@ -5,10 +5,32 @@
  * 
  * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_APP_THREADS_WIN32        1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_APP_THREADS_PTHREAD      1
+#endif /* defined(_WIN32) */
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define XMLSEC_APP_UNIX_SOCKETS         1
+#endif /* !defined(_WIN32) */
+
 #if defined(_MSC_VER) && _MSC_VER < 1900
 #define snprintf _snprintf
 #endif
@@ -18,6 +40,7 @@
 #include <libxml/parser.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
+#include <libxml/threads.h>
 
 #ifndef XMLSEC_NO_XSLT
 #include <libxslt/xslt.h>
@@ -40,6 +63,7 @@
 #include <xmlsec/parser.h>
 #include <xmlsec/templates.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/metrics.h>
 
 #include "crypto.h"
 #include "cmdline.h"
@@ -75,6 +99,10 @@ static const char helpCommands2[] =
     "  --encrypt   "    "\tencrypt data and output XML document\n"
     "  --decrypt   "    "\tdecrypt data from XML document\n"
 #endif /* XMLSEC_NO_XMLENC */
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+    "  --bench     "    "\tmeasure sign, verify, encrypt or decrypt performance\n"
+    "  --serve     "    "\tserve sign, verify, encrypt or decrypt requests\n"
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
     ;
 
 static const char helpVersion[] = 
@@ -110,6 +138,24 @@ static const char helpDecrypt[] =
     "Usage: xmlsec decrypt [<options>] <file>\n"
     "Decrypts XML Encryption data in the <file>\n";
 
+static const char helpBench[] =     
+    "Usage: xmlsec bench <command> [<options>] <file> [<file> ... ]\n"
+    "Runs the <command> (sign, verify, encrypt or decrypt) for each <file>\n"
+    "the number of times specified with \"--repeat\" option using one\n"
+    "keys manager and prints the throughput, the latency percentiles and\n"
+    "the average time, the number of the libxml2 and xmlsec allocations,\n"
+    "the allocated bytes and the peak memory usage of each processing phase\n";
+
+static const char helpServe[] =     
+    "Usage: xmlsec serve [<options>] <socket>\n"
+    "Loads the keys once and serves the requests received over the Unix\n"
+    "socket <socket> (use \"-\" for stdin and stdout) until the \"shutdown\"\n"
+    "request. Each \"<command> <file> [<output>]\" request line (<command> is\n"
+    "sign, verify, encrypt or decrypt; <output> is required for all but\n"
+    "verify) is answered with a \"OK <file>\" or \"FAIL <file>\" line.\n"
+    "The \"metrics <file>\" request writes the library metrics to <file>\n"
+    "in the Prometheus text format\n";
+
 static const char helpListKeyData[] =     
     "Usage: xmlsec list-key-data\n"
     "Prints the list of known key data klasses\n";
@@ -133,7 +179,9 @@ static const char helpCheckTransforms[] =
 #define xmlSecAppCmdLineTopicEncCommon          0x0010
 #define xmlSecAppCmdLineTopicEncEncrypt         0x0020
 #define xmlSecAppCmdLineTopicEncDecrypt         0x0040
-/* #define UNUSED         0x0080 */
+#define xmlSecAppCmdLineTopicBench              0x0080
+#define xmlSecAppCmdLineTopicBatch              0x0100
+#define xmlSecAppCmdLineTopicServe              0x0200
 #define xmlSecAppCmdLineTopicKeysMngr           0x1000
 #define xmlSecAppCmdLineTopicX509Certs          0x2000
 #define xmlSecAppCmdLineTopicVersion            0x4000
@@ -193,6 +241,18 @@ static xmlSecAppCmdLineParam repeatParam = {
 };
 
 
+static xmlSecAppCmdLineParam timingsParam = { 
+    xmlSecAppCmdLineTopicCryptoConfig,
+    "--timings",
+    NULL,
+    "--timings <file>"
+    "\n\twrite the processor time of every operation in microseconds"
+    "\n\tto <file>, one line per operation (use with \"--repeat\")",
+    xmlSecAppCmdLineParamTypeString,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 static xmlSecAppCmdLineParam disableErrorMsgsParam = { 
     xmlSecAppCmdLineTopicGeneral,
     "--disable-error-msgs",
@@ -595,6 +655,19 @@ static xmlSecAppCmdLineParam enableVisa3DHackParam = {
     NULL
 };
 
+static xmlSecAppCmdLineParam spliceSignatureParam = { 
+    xmlSecAppCmdLineTopicDSigSign,
+    "--splice-signature",
+    NULL,
+    "--splice-signature"
+    "\n\tcopy the template file to the output byte by byte and replace"
+    "\n\tonly the signed <dsig:Signature/> element (the whole document is"
+    "\n\tre-serialized if the element can't be located in the file)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 #endif /* XMLSEC_NO_XMLDSIG */
 
 /****************************************************************
@@ -603,6 +676,29 @@ static xmlSecAppCmdLineParam enableVisa3DHackParam = {
  *
  ***************************************************************/
 #ifndef XMLSEC_NO_XMLENC
+static xmlSecAppCmdLineParam encKeyMatchRecipientParam = {
+    xmlSecAppCmdLineTopicEncDecrypt,
+    "--enckey-match-recipient",
+    NULL,
+    "--enckey-match-recipient"
+    "\n\tdecrypt only the <enc:EncryptedKey/> elements with the Recipient"
+    "\n\tattribute, key names and certificates matching the key",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
+static xmlSecAppCmdLineParam lazyDecryptParam = {
+    xmlSecAppCmdLineTopicEncDecrypt,
+    "--lazy-decrypt",
+    NULL,
+    "--lazy-decrypt"
+    "\n\twrite the decrypted XML data to the output without parsing it",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 static xmlSecAppCmdLineParam enabledCipherRefUrisParam = { 
     xmlSecAppCmdLineTopicEncCommon,
     "--enabled-cipher-reference-uris",
@@ -768,6 +864,44 @@ static xmlSecAppCmdLineParam X509SkipStrictChecksParam = {
     NULL
 };
 
+static xmlSecAppCmdLineParam X509OcspParam = {
+    xmlSecAppCmdLineTopicX509Certs,
+    "--X509-ocsp",
+    NULL,
+    "--X509-ocsp"
+    "\n\tcheck the certificates revocation status with OCSP"
+    "\n\t(OpenSSL only)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
+static xmlSecAppCmdLineParam X509OcspFetchParam = {
+    xmlSecAppCmdLineTopicX509Certs,
+    "--X509-ocsp-fetch",
+    NULL,
+    "--X509-ocsp-fetch"
+    "\n\trequest the OCSP responses from the responders listed"
+    "\n\tin the certificates (implies --X509-ocsp)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING)
+static xmlSecAppCmdLineParam X509OcspResponseParam = {
+    xmlSecAppCmdLineTopicX509Certs,
+    "--X509-ocsp-response",
+    NULL,
+    "--X509-ocsp-response <file>"
+    "\n\tload the stapled OCSP response from DER file <file>"
+    "\n\t(OpenSSL only)",
+    xmlSecAppCmdLineParamTypeString,
+    xmlSecAppCmdLineParamFlagMultipleValues,
+    NULL
+};
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) */
+
 static xmlSecAppCmdLineParam X509DontVerifyCerts = {
     xmlSecAppCmdLineTopicDSigCommon,
     "--insecure",
@@ -780,6 +914,36 @@ static xmlSecAppCmdLineParam X509DontVerifyCerts = {
 };
 #endif /* XMLSEC_NO_X509 */    
 
+/****************************************************************
+ *
+ * Bench and batch params
+ *
+ ***************************************************************/
+static xmlSecAppCmdLineParam batchParam = { 
+    xmlSecAppCmdLineTopicBatch,
+    "--batch",
+    NULL,    
+    "--batch <file>"
+    "\n\tprocess the files listed in <file> (use \"-\" for stdin),"
+    "\n\tone \"<file> [<output>]\" pair per line, using the same"
+    "\n\tkeys manager and contexts for all of them",
+    xmlSecAppCmdLineParamTypeString,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
+static xmlSecAppCmdLineParam threadsParam = { 
+    xmlSecAppCmdLineTopicBench | xmlSecAppCmdLineTopicBatch | xmlSecAppCmdLineTopicServe,
+    "--threads",
+    NULL,    
+    "--threads <number>"
+    "\n\tuse <number> threads for the \"bench\" and \"serve\""
+    "\n\tcommands or the \"--batch\" option (default is 1)",
+    xmlSecAppCmdLineParamTypeNumber,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 static xmlSecAppCmdLineParamPtr parameters[] = {
     /* common dsig params */
 #ifndef XMLSEC_NO_XMLDSIG
@@ -788,6 +952,7 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     &storeSignaturesParam,
     &enabledRefUrisParam,
     &enableVisa3DHackParam,
+    &spliceSignatureParam,
 #endif /* XMLSEC_NO_XMLDSIG */
 
     /* enc params */
@@ -795,6 +960,8 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     &binaryDataParam,
     &xmlDataParam,
     &enabledCipherRefUrisParam,
+    &encKeyMatchRecipientParam,
+    &lazyDecryptParam,
 #endif /* XMLSEC_NO_XMLENC */
              
     /* common dsig and enc parameters */
@@ -841,13 +1008,23 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     &verificationTimeParam,
     &depthParam,    
     &X509SkipStrictChecksParam,    
+    &X509OcspParam,
+    &X509OcspFetchParam,
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING)
+    &X509OcspResponseParam,
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) */
     &X509DontVerifyCerts,
 #endif /* XMLSEC_NO_X509 */    
+
+    /* Bench and batch params */
+    &batchParam,
+    &threadsParam,
     
     /* General configuration params */
     &cryptoParam,
     &cryptoConfigParam,
     &repeatParam,
+    &timingsParam,
     &disableErrorMsgsParam,
     &printCryptoErrorMsgsParam,
     &helpParam,
@@ -871,7 +1048,9 @@ typedef enum {
     xmlSecAppCommandSignTmpl,
     xmlSecAppCommandEncrypt,
     xmlSecAppCommandDecrypt,
-    xmlSecAppCommandEncryptTmpl
+    xmlSecAppCommandEncryptTmpl,
+    xmlSecAppCommandBench,
+    xmlSecAppCommandServe
 } xmlSecAppCommand;
 
 typedef struct _xmlSecAppXmlData                                xmlSecAppXmlData,
@@ -900,25 +1079,48 @@ static int                      xmlSecAppLoadKeys               (void);
 static int                      xmlSecAppPrepareKeyInfoReadCtx  (xmlSecKeyInfoCtxPtr ctx);
 
 #ifndef XMLSEC_NO_XMLDSIG
-static int                      xmlSecAppSignFile               (const char* filename);
-static int                      xmlSecAppVerifyFile             (const char* filename);
+static int                      xmlSecAppSignFile               (const char* filename,
+                                                                 const char* output,
+                                                                 xmlSecDSigCtxPtr ctx);
+static int                      xmlSecAppVerifyFile             (const char* filename,
+                                                                 const char* output,
+                                                                 xmlSecDSigCtxPtr ctx);
+static int                      xmlSecAppSpliceSignature        (const char* filename,
+                                                                 xmlNodePtr node,
+                                                                 FILE* f);
 #ifndef XMLSEC_NO_TMPL_TEST
 static int                      xmlSecAppSignTmpl               (void);
 #endif /* XMLSEC_NO_TMPL_TEST */
 static int                      xmlSecAppPrepareDSigCtx         (xmlSecDSigCtxPtr dsigCtx);
+static int                      xmlSecAppResetDSigCtx           (xmlSecDSigCtxPtr dsigCtx);
 static void                     xmlSecAppPrintDSigCtx           (xmlSecDSigCtxPtr dsigCtx);
 #endif /* XMLSEC_NO_XMLDSIG */
 
 #ifndef XMLSEC_NO_XMLENC
-static int                      xmlSecAppEncryptFile            (const char* filename);
-static int                      xmlSecAppDecryptFile            (const char* filename);
+static int                      xmlSecAppEncryptFile            (const char* filename,
+                                                                 const char* output,
+                                                                 xmlSecEncCtxPtr ctx);
+static int                      xmlSecAppDecryptFile            (const char* filename,
+                                                                 const char* output,
+                                                                 xmlSecEncCtxPtr ctx);
 #ifndef XMLSEC_NO_TMPL_TEST
 static int                      xmlSecAppEncryptTmpl            (void);
 #endif /* XMLSEC_NO_TMPL_TEST */
 static int                      xmlSecAppPrepareEncCtx          (xmlSecEncCtxPtr encCtx);
+static int                      xmlSecAppResetEncCtx            (xmlSecEncCtxPtr encCtx);
 static void                     xmlSecAppPrintEncCtx            (xmlSecEncCtxPtr encCtx);
 #endif /* XMLSEC_NO_XMLENC */
 
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+static int                      xmlSecAppBenchAllocInstall      (void);
+static int                      xmlSecAppBench                  (xmlSecAppCommand command,
+                                                                 const char** files,
+                                                                 int filesNum);
+static int                      xmlSecAppBatch                  (xmlSecAppCommand command,
+                                                                 const char* filename);
+static int                      xmlSecAppServe                  (const char* path);
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
 static void                     xmlSecAppListKeyData            (void);
 static int                      xmlSecAppCheckKeyData       (const char * name);
 static void                     xmlSecAppListTransforms         (void);
@@ -927,8 +1129,10 @@ static int                      xmlSecAppCheckTransform     (const char * name);
 static xmlSecTransformUriType   xmlSecAppGetUriType             (const char* string);
 static FILE*                    xmlSecAppOpenFile               (const char* filename);
 static void                     xmlSecAppCloseFile              (FILE* file);
-static int                      xmlSecAppWriteResult            (xmlDocPtr doc,
+static int                      xmlSecAppWriteResult            (const char* output,
+                                                                 xmlDocPtr doc,
                                                                  xmlSecBufferPtr buffer);
+static void                     xmlSecAppAddTime                (clock_t start_time);
 static int                      xmlSecAppAddIDAttr              (xmlNodePtr cur,
                                                                  const xmlChar* attr,
                                                                  const xmlChar* node,
@@ -938,6 +1142,8 @@ xmlSecKeysMngrPtr gKeysMngr = NULL;
 int repeats = 1;
 int print_debug = 0;
 clock_t total_time = 0;
+FILE* timings_file = NULL;
+xmlMutexPtr stats_mutex = NULL;
 const char* xmlsec_crypto = NULL;
 const char* tmp = NULL;
 
@@ -968,8 +1174,29 @@ int main(int argc, const char **argv) {
         goto success;
     }
     
+    /* the bench command is followed by the command to measure */
+    pos = 2;
+    if(command == xmlSecAppCommandBench) {
+        xmlSecAppCmdLineParamTopic benchTopics = 0;
+
+        subCommand = (argc > 2) ? xmlSecAppParseCommand(argv[2], &benchTopics, NULL) : xmlSecAppCommandUnknown;
+        switch(subCommand) {
+        case xmlSecAppCommandSign:
+        case xmlSecAppCommandVerify:
+        case xmlSecAppCommandEncrypt:
+        case xmlSecAppCommandDecrypt:
+            break;
+        default:
+            fprintf(stderr, "Error: bench command requires \"sign\", \"verify\", \"encrypt\" or \"decrypt\" command\n");
+            xmlSecAppPrintHelp(command, cmdLineTopics);
+            goto fail;
+        }
+        cmdLineTopics = (benchTopics & ~xmlSecAppCmdLineTopicBatch) | xmlSecAppCmdLineTopicBench;
+        pos = 3;
+    }
+
     /* parse command line */
-    pos = xmlSecAppCmdLineParamsListParse(parameters, cmdLineTopics, argv, argc, 2);
+    pos = xmlSecAppCmdLineParamsListParse(parameters, cmdLineTopics, argv, argc, pos);
     if(pos < 0) {
         fprintf(stderr, "Error: invalid parameters\n");
         xmlSecAppPrintUsage();
@@ -984,11 +1211,23 @@ int main(int argc, const char **argv) {
     
     /* we need to have some files at the end */
     switch(command) {
-        case xmlSecAppCommandKeys:
         case xmlSecAppCommandSign:
         case xmlSecAppCommandVerify:
         case xmlSecAppCommandEncrypt:
         case xmlSecAppCommandDecrypt:
+            /* the files are read from the list in the batch mode */
+            if(xmlSecAppCmdLineParamIsSet(&batchParam)) {
+                if(pos < argc) {
+                    fprintf(stderr, "Error: <file> parameter can not be used with \"--batch\" option\n");
+                    xmlSecAppPrintUsage();
+                    goto fail;
+                }
+                break;
+            }
+            /* falls through */
+        case xmlSecAppCommandKeys:
+        case xmlSecAppCommandBench:
+        case xmlSecAppCommandServe:
             if(pos >= argc) {
                 fprintf(stderr, "Error: <file> parameter is required for this command\n");
                 xmlSecAppPrintUsage();
@@ -999,6 +1238,16 @@ int main(int argc, const char **argv) {
             break;
     }
 
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+    /* the counting allocators must be installed before libxml2 allocates anything */
+    if(command == xmlSecAppCommandBench) {
+        if(xmlSecAppBenchAllocInstall() < 0) {
+            fprintf(stderr, "Error: failed to install the bench memory functions\n");
+            goto fail;
+        }
+    }
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
     /* now init the xmlsec and all other libs */
     /* ignore "--crypto" if we don't have dynamic loading */
     tmp = xmlSecAppCmdLineParamGetString(&cryptoParam);
@@ -1039,6 +1288,45 @@ int main(int argc, const char **argv) {
         repeats = xmlSecAppCmdLineParamGetInt(&repeatParam, 1);
     }
 
+    /* open the per operation timings file */
+    if(xmlSecAppCmdLineParamGetString(&timingsParam) != NULL) {
+        timings_file = fopen(xmlSecAppCmdLineParamGetString(&timingsParam), "w");
+        if(timings_file == NULL) {
+            fprintf(stderr, "Error: failed to open file \"%s\"\n",
+                    xmlSecAppCmdLineParamGetString(&timingsParam));
+            goto fail;
+        }
+    }
+
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+    /* the bench command does all the repeats itself */
+    if(command == xmlSecAppCommandBench) {
+        if(xmlSecAppBench(subCommand, argv + pos, argc - pos) < 0) {
+            fprintf(stderr, "Error: benchmark failed\n");
+            goto fail;
+        }
+        goto success;
+    }
+
+    /* the batch mode processes all the files from the list once */
+    if(xmlSecAppCmdLineParamIsSet(&batchParam)) {
+        if(xmlSecAppBatch(command, xmlSecAppCmdLineParamGetString(&batchParam)) < 0) {
+            fprintf(stderr, "Error: batch processing failed\n");
+            goto fail;
+        }
+        goto success;
+    }
+
+    /* the serve command runs until the "shutdown" request */
+    if(command == xmlSecAppCommandServe) {
+        if(xmlSecAppServe(argv[pos]) < 0) {
+            fprintf(stderr, "Error: serve failed\n");
+            goto fail;
+        }
+        goto success;
+    }
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
     /* execute requested number of times */
     for(; repeats > 0; --repeats) {
         switch(command) {
@@ -1079,7 +1367,7 @@ int main(int argc, const char **argv) {
 #ifndef XMLSEC_NO_XMLDSIG
         case xmlSecAppCommandSign:
             for(i = pos; i < argc; ++i) {
-                if(xmlSecAppSignFile(argv[i]) < 0) {
+                if(xmlSecAppSignFile(argv[i], xmlSecAppCmdLineParamGetString(&outputParam), NULL) < 0) {
                     fprintf(stderr, "Error: failed to sign file \"%s\"\n", argv[i]);
                     goto fail;
                 }
@@ -1087,7 +1375,7 @@ int main(int argc, const char **argv) {
             break;
         case xmlSecAppCommandVerify:
             for(i = pos; i < argc; ++i) {
-                if(xmlSecAppVerifyFile(argv[i]) < 0) {
+                if(xmlSecAppVerifyFile(argv[i], xmlSecAppCmdLineParamGetString(&outputParam), NULL) < 0) {
                     fprintf(stderr, "Error: failed to verify file \"%s\"\n", argv[i]);
                     goto fail;
                 }
@@ -1106,7 +1394,7 @@ int main(int argc, const char **argv) {
 #ifndef XMLSEC_NO_XMLENC
         case xmlSecAppCommandEncrypt:
             for(i = pos; i < argc; ++i) {
-                if(xmlSecAppEncryptFile(argv[i]) < 0) {
+                if(xmlSecAppEncryptFile(argv[i], xmlSecAppCmdLineParamGetString(&outputParam), NULL) < 0) {
                     fprintf(stderr, "Error: failed to encrypt file with template \"%s\"\n", argv[i]);
                     goto fail;
                 }
@@ -1114,7 +1402,7 @@ int main(int argc, const char **argv) {
             break;
         case xmlSecAppCommandDecrypt:
             for(i = pos; i < argc; ++i) {
-                if(xmlSecAppDecryptFile(argv[i]) < 0) {
+                if(xmlSecAppDecryptFile(argv[i], xmlSecAppCmdLineParamGetString(&outputParam), NULL) < 0) {
                     fprintf(stderr, "Error: failed to decrypt file \"%s\"\n", argv[i]);
                     goto fail;
                 }
@@ -1149,6 +1437,10 @@ int main(int argc, const char **argv) {
 success:
     res = 0;
 fail:
+    if(timings_file != NULL) {
+        fclose(timings_file);
+        timings_file = NULL;
+    }
     if(gKeysMngr != NULL) {
         xmlSecKeysMngrDestroy(gKeysMngr);
         gKeysMngr = NULL;
@@ -1161,24 +1453,29 @@ fail:
 
 #ifndef XMLSEC_NO_XMLDSIG
 static int 
-xmlSecAppSignFile(const char* filename) {
+xmlSecAppSignFile(const char* filename, const char* output, xmlSecDSigCtxPtr ctx) {
     xmlSecAppXmlDataPtr data = NULL;
-    xmlSecDSigCtx dsigCtx;
+    xmlSecDSigCtx localCtx;
+    xmlSecDSigCtxPtr dsigCtx = ctx;
     clock_t start_time;
     int res = -1;
+    int ret;
     
     if(filename == NULL) {
         return(-1);
     }
 
-    if(xmlSecDSigCtxInitialize(&dsigCtx, gKeysMngr) < 0) {
-        fprintf(stderr, "Error: dsig context initialization failed\n");
-        return(-1);
-    }
-
-    if(xmlSecAppPrepareDSigCtx(&dsigCtx) < 0) {
-        fprintf(stderr, "Error: dsig context preparation failed\n");
-        goto done;
+    /* use the caller's context or create a new one */
+    if(dsigCtx == NULL) {
+        if(xmlSecDSigCtxInitialize(&localCtx, gKeysMngr) < 0) {
+            fprintf(stderr, "Error: dsig context initialization failed\n");
+            return(-1);
+        }
+        dsigCtx = &localCtx;
+        if(xmlSecAppPrepareDSigCtx(dsigCtx) < 0) {
+            fprintf(stderr, "Error: dsig context preparation failed\n");
+            goto done;
+        }
     }
 
     /* parse template and select start node */
@@ -1191,22 +1488,30 @@ xmlSecAppSignFile(const char* filename) {
     
     /* sign */
     start_time = clock();
-    if(xmlSecDSigCtxSign(&dsigCtx, data->startNode) < 0) {
+    if(xmlSecDSigCtxSign(dsigCtx, data->startNode) < 0) {
         fprintf(stderr,"Error: signature failed \n");
         goto done;
     }
-    total_time += clock() - start_time;    
+    xmlSecAppAddTime(start_time);
 
     if(repeats <= 1) { 
         FILE* f;
         
-        f = xmlSecAppOpenFile(xmlSecAppCmdLineParamGetString(&outputParam));
+        f = xmlSecAppOpenFile(output);
         if(f == NULL) {
             fprintf(stderr,"Error: failed to open output file \"%s\"\n",
-                    xmlSecAppCmdLineParamGetString(&outputParam));
+                    output);
+            goto done;
+        }
+        ret = xmlSecAppSpliceSignature(filename, data->startNode, f);
+        if(ret < 0) {
+            fprintf(stderr,"Error: failed to write output file \"%s\"\n",
+                    output);
+            xmlSecAppCloseFile(f);
             goto done;
+        } else if(ret > 0) {
+            xmlDocDump(f, data->doc);
         }
-        xmlDocDump(f, data->doc);
         xmlSecAppCloseFile(f);
     }
 
@@ -1214,19 +1519,50 @@ xmlSecAppSignFile(const char* filename) {
 done:
     /* print debug info if requested */
     if(repeats <= 1) {
-        xmlSecAppPrintDSigCtx(&dsigCtx);
+        xmlSecAppPrintDSigCtx(dsigCtx);
+    }
+    if(dsigCtx == &localCtx) {
+        xmlSecDSigCtxFinalize(dsigCtx);
+    } else if(xmlSecAppResetDSigCtx(dsigCtx) < 0) {
+        res = -1;
     }
-    xmlSecDSigCtxFinalize(&dsigCtx);
     if(data != NULL) {
         xmlSecAppXmlDataDestroy(data);
     }
     return(res);
 }
 
+/* returns 1 if the signed document needs to be written with xmlDocDump() */
+static int
+xmlSecAppSpliceSignature(const char* filename, xmlNodePtr node, FILE* f) {
+    xmlOutputBufferPtr output;
+    int ret;
+
+    if(!xmlSecAppCmdLineParamIsSet(&spliceSignatureParam) || (strcmp(filename, "-") == 0)) {
+        return(1);
+    }
+
+    output = xmlOutputBufferCreateFile(f, NULL);
+    if(output == NULL) {
+        fprintf(stderr, "Error: failed to create output buffer\n");
+        return(-1);
+    }
+    ret = xmlSecWriteFileWithNode(filename, node, output);
+    if(xmlOutputBufferClose(output) < 0) {
+        ret = -1;
+    }
+    if(ret > 0) {
+        fprintf(stderr, "Warning: failed to locate the signature in \"%s\", "
+                        "writing the whole document\n", filename);
+    }
+    return(ret);
+}
+
 static int 
-xmlSecAppVerifyFile(const char* filename) {
+xmlSecAppVerifyFile(const char* filename, const char* output, xmlSecDSigCtxPtr ctx) {
     xmlSecAppXmlDataPtr data = NULL;
-    xmlSecDSigCtx dsigCtx;
+    xmlSecDSigCtx localCtx;
+    xmlSecDSigCtxPtr dsigCtx = ctx;
     clock_t start_time;
     int res = -1;
     
@@ -1234,13 +1570,17 @@ xmlSecAppVerifyFile(const char* filename) {
         return(-1);
     }
 
-    if(xmlSecDSigCtxInitialize(&dsigCtx, gKeysMngr) < 0) {
-        fprintf(stderr, "Error: dsig context initialization failed\n");
-        return(-1);
-    }
-    if(xmlSecAppPrepareDSigCtx(&dsigCtx) < 0) {
-        fprintf(stderr, "Error: dsig context preparation failed\n");
-        goto done;
+    /* use the caller's context or create a new one */
+    if(dsigCtx == NULL) {
+        if(xmlSecDSigCtxInitialize(&localCtx, gKeysMngr) < 0) {
+            fprintf(stderr, "Error: dsig context initialization failed\n");
+            return(-1);
+        }
+        dsigCtx = &localCtx;
+        if(xmlSecAppPrepareDSigCtx(dsigCtx) < 0) {
+            fprintf(stderr, "Error: dsig context preparation failed\n");
+            goto done;
+        }
     }
     
     /* parse template and select start node */
@@ -1252,13 +1592,13 @@ xmlSecAppVerifyFile(const char* filename) {
 
     /* sign */
     start_time = clock();
-    if(xmlSecDSigCtxVerify(&dsigCtx, data->startNode) < 0) {
+    if(xmlSecDSigCtxVerify(dsigCtx, data->startNode) < 0) {
         fprintf(stderr,"Error: signature failed \n");
         goto done;
     }
-    total_time += clock() - start_time;    
+    xmlSecAppAddTime(start_time);
 
-    if((repeats <= 1) && (dsigCtx.status != xmlSecDSigStatusSucceeded)){ 
+    if((repeats <= 1) && (dsigCtx->status != xmlSecDSigStatusSucceeded)){ 
         /* return an error if signature does not match */
         goto done;
     }
@@ -1271,15 +1611,15 @@ done:
         xmlSecSize good, i, size;
         FILE* f;
         
-        f = xmlSecAppOpenFile(xmlSecAppCmdLineParamGetString(&outputParam));
+        f = xmlSecAppOpenFile(output);
         if(f == NULL) {
             fprintf(stderr,"Error: failed to open output file \"%s\"\n",
-                    xmlSecAppCmdLineParamGetString(&outputParam));
+                    output);
             goto done;
         }
         xmlSecAppCloseFile(f);
 
-        switch(dsigCtx.status) {
+        switch(dsigCtx->status) {
             case xmlSecDSigStatusUnknown:
                 fprintf(stderr, "ERROR\n");
                 break;
@@ -1292,9 +1632,9 @@ done:
         }    
 
         /* print stats about # of good/bad references/manifests */
-        size = xmlSecPtrListGetSize(&(dsigCtx.signedInfoReferences));
+        size = xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences));
         for(i = good = 0; i < size; ++i) {
-            dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(&(dsigCtx.signedInfoReferences), i);
+            dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(&(dsigCtx->signedInfoReferences), i);
             if(dsigRefCtx == NULL) {
                 fprintf(stderr,"Error: reference ctx is null\n");
                 goto done;
@@ -1305,9 +1645,9 @@ done:
         }
         fprintf(stderr, "SignedInfo References (ok/all): %d/%d\n", good, size);
 
-        size = xmlSecPtrListGetSize(&(dsigCtx.manifestReferences));
+        size = xmlSecPtrListGetSize(&(dsigCtx->manifestReferences));
         for(i = good = 0; i < size; ++i) {
-            dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(&(dsigCtx.manifestReferences), i);
+            dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(&(dsigCtx->manifestReferences), i);
             if(dsigRefCtx == NULL) {
                 fprintf(stderr,"Error: reference ctx is null\n");
                 goto done;
@@ -1318,9 +1658,13 @@ done:
         }
         fprintf(stderr, "Manifests References (ok/all): %d/%d\n", good, size);
 
-        xmlSecAppPrintDSigCtx(&dsigCtx);
+        xmlSecAppPrintDSigCtx(dsigCtx);
+    }
+    if(dsigCtx == &localCtx) {
+        xmlSecDSigCtxFinalize(dsigCtx);
+    } else if(xmlSecAppResetDSigCtx(dsigCtx) < 0) {
+        res = -1;
     }
-    xmlSecDSigCtxFinalize(&dsigCtx);
     if(data != NULL) {
         xmlSecAppXmlDataDestroy(data);
     }
@@ -1416,7 +1760,7 @@ xmlSecAppSignTmpl(void) {
         fprintf(stderr,"Error: signature failed \n");
         goto done;
     }
-    total_time += clock() - start_time;    
+    xmlSecAppAddTime(start_time);
 
     if(repeats <= 1) { 
         FILE* f;
@@ -1498,6 +1842,29 @@ xmlSecAppPrepareDSigCtx(xmlSecDSigCtxPtr dsigCtx) {
     return(0);
 }
 
+static int
+xmlSecAppResetDSigCtx(xmlSecDSigCtxPtr dsigCtx) {
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: dsig context is null\n");
+        return(-1);
+    }
+
+    /* the user settings are kept but the session key is destroyed
+     * and the key requirements are cleared */
+    xmlSecDSigCtxReset(dsigCtx);
+    dsigCtx->keyInfoWriteCtx.keyReq.keyType = xmlSecKeyDataTypePublic;
+    if(xmlSecAppCmdLineParamGetString(&sessionKeyParam) != NULL) {
+        dsigCtx->signKey = xmlSecAppCryptoKeyGenerate(xmlSecAppCmdLineParamGetString(&sessionKeyParam),
+                                NULL, xmlSecKeyDataTypeSession);
+        if(dsigCtx->signKey == NULL) {
+            fprintf(stderr, "Error: failed to generate a session key \"%s\"\n",
+                    xmlSecAppCmdLineParamGetString(&sessionKeyParam));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
 static void
 xmlSecAppPrintDSigCtx(xmlSecDSigCtxPtr dsigCtx) { 
     if(dsigCtx == NULL) {
@@ -1522,9 +1889,10 @@ xmlSecAppPrintDSigCtx(xmlSecDSigCtxPtr dsigCtx) {
 
 #ifndef XMLSEC_NO_XMLENC
 static int 
-xmlSecAppEncryptFile(const char* filename) {
+xmlSecAppEncryptFile(const char* filename, const char* output, xmlSecEncCtxPtr ctx) {
     xmlSecAppXmlDataPtr data = NULL;
-    xmlSecEncCtx encCtx;
+    xmlSecEncCtx localCtx;
+    xmlSecEncCtxPtr encCtx = ctx;
     xmlDocPtr doc = NULL;
     xmlNodePtr startTmplNode;
     clock_t start_time;
@@ -1534,13 +1902,17 @@ xmlSecAppEncryptFile(const char* filename) {
         return(-1);
     }
 
-    if(xmlSecEncCtxInitialize(&encCtx, gKeysMngr) < 0) {
-        fprintf(stderr, "Error: enc context initialization failed\n");
-        return(-1);
-    }
-    if(xmlSecAppPrepareEncCtx(&encCtx) < 0) {
-        fprintf(stderr, "Error: enc context preparation failed\n");
-        goto done;
+    /* use the caller's context or create a new one */
+    if(encCtx == NULL) {
+        if(xmlSecEncCtxInitialize(&localCtx, gKeysMngr) < 0) {
+            fprintf(stderr, "Error: enc context initialization failed\n");
+            return(-1);
+        }
+        encCtx = &localCtx;
+        if(xmlSecAppPrepareEncCtx(encCtx) < 0) {
+            fprintf(stderr, "Error: enc context preparation failed\n");
+            goto done;
+        }
     }
 
     /* parse doc and find template node */
@@ -1560,12 +1932,12 @@ xmlSecAppEncryptFile(const char* filename) {
     if(xmlSecAppCmdLineParamGetString(&binaryDataParam) != NULL) {
         /* encrypt */
         start_time = clock();            
-        if(xmlSecEncCtxUriEncrypt(&encCtx, startTmplNode, BAD_CAST xmlSecAppCmdLineParamGetString(&binaryDataParam)) < 0) {
+        if(xmlSecEncCtxUriEncrypt(encCtx, startTmplNode, BAD_CAST xmlSecAppCmdLineParamGetString(&binaryDataParam)) < 0) {
             fprintf(stderr, "Error: failed to encrypt file \"%s\"\n", 
                     xmlSecAppCmdLineParamGetString(&binaryDataParam));
             goto done;
         }
-        total_time += clock() - start_time;    
+        xmlSecAppAddTime(start_time);
     } else if(xmlSecAppCmdLineParamGetString(&xmlDataParam) != NULL) {
         /* parse file and select node for encryption */
         data = xmlSecAppXmlDataCreate(xmlSecAppCmdLineParamGetString(&xmlDataParam), NULL, NULL);
@@ -1577,12 +1949,12 @@ xmlSecAppEncryptFile(const char* filename) {
 
         /* encrypt */
         start_time = clock();            
-        if(xmlSecEncCtxXmlEncrypt(&encCtx, startTmplNode, data->startNode) < 0) {
+        if(xmlSecEncCtxXmlEncrypt(encCtx, startTmplNode, data->startNode) < 0) {
             fprintf(stderr, "Error: failed to encrypt xml file \"%s\"\n", 
                     xmlSecAppCmdLineParamGetString(&xmlDataParam));
             goto done;
         }
-        total_time += clock() - start_time;    
+        xmlSecAppAddTime(start_time);
     } else {
         fprintf(stderr, "Error: encryption data not specified (use \"--xml\" or \"--binary\" options)\n");
         goto done;
@@ -1590,12 +1962,12 @@ xmlSecAppEncryptFile(const char* filename) {
     
     /* print out result only once per execution */
     if(repeats <= 1) {
-        if(encCtx.resultReplaced) {
-            if(xmlSecAppWriteResult((data != NULL) ? data->doc : doc, NULL) < 0) {
+        if(encCtx->resultReplaced) {
+            if(xmlSecAppWriteResult(output, (data != NULL) ? data->doc : doc, NULL) < 0) {
                 goto done;
             }
         } else {
-            if(xmlSecAppWriteResult(NULL, encCtx.result) < 0) {
+            if(xmlSecAppWriteResult(output, NULL, encCtx->result) < 0) {
                 goto done;
             }
         }       
@@ -1605,9 +1977,13 @@ xmlSecAppEncryptFile(const char* filename) {
 done:
     /* print debug info if requested */
     if(repeats <= 1) {
-        xmlSecAppPrintEncCtx(&encCtx);
+        xmlSecAppPrintEncCtx(encCtx);
+    }
+    if(encCtx == &localCtx) {
+        xmlSecEncCtxFinalize(encCtx);
+    } else if(xmlSecAppResetEncCtx(encCtx) < 0) {
+        res = -1;
     }
-    xmlSecEncCtxFinalize(&encCtx);
 
     if(data != NULL) {
         xmlSecAppXmlDataDestroy(data);
@@ -1619,9 +1995,10 @@ done:
 }
 
 static int 
-xmlSecAppDecryptFile(const char* filename) {
+xmlSecAppDecryptFile(const char* filename, const char* output, xmlSecEncCtxPtr ctx) {
     xmlSecAppXmlDataPtr data = NULL;
-    xmlSecEncCtx encCtx;
+    xmlSecEncCtx localCtx;
+    xmlSecEncCtxPtr encCtx = ctx;
     clock_t start_time;
     int res = -1;
 
@@ -1629,13 +2006,17 @@ xmlSecAppDecryptFile(const char* filename) {
         return(-1);
     }
 
-    if(xmlSecEncCtxInitialize(&encCtx, gKeysMngr) < 0) {
-        fprintf(stderr, "Error: enc context initialization failed\n");
-        return(-1);
-    }
-    if(xmlSecAppPrepareEncCtx(&encCtx) < 0) {
-        fprintf(stderr, "Error: enc context preparation failed\n");
-        goto done;
+    /* use the caller's context or create a new one */
+    if(encCtx == NULL) {
+        if(xmlSecEncCtxInitialize(&localCtx, gKeysMngr) < 0) {
+            fprintf(stderr, "Error: enc context initialization failed\n");
+            return(-1);
+        }
+        encCtx = &localCtx;
+        if(xmlSecAppPrepareEncCtx(encCtx) < 0) {
+            fprintf(stderr, "Error: enc context preparation failed\n");
+            goto done;
+        }
     }
 
     /* parse template and select start node */
@@ -1646,20 +2027,20 @@ xmlSecAppDecryptFile(const char* filename) {
     }
 
     start_time = clock();  
-    if(xmlSecEncCtxDecrypt(&encCtx, data->startNode) < 0) {
+    if(xmlSecEncCtxDecrypt(encCtx, data->startNode) < 0) {
         fprintf(stderr, "Error: failed to decrypt file\n");
         goto done;
     }
-    total_time += clock() - start_time;    
+    xmlSecAppAddTime(start_time);
     
     /* print out result only once per execution */
     if(repeats <= 1) {
-        if(encCtx.resultReplaced) {
-            if(xmlSecAppWriteResult(data->doc, NULL) < 0) {
+        if(encCtx->resultReplaced) {
+            if(xmlSecAppWriteResult(output, data->doc, NULL) < 0) {
                 goto done;
             }
         } else {
-            if(xmlSecAppWriteResult(NULL, encCtx.result) < 0) {
+            if(xmlSecAppWriteResult(output, NULL, encCtx->result) < 0) {
                 goto done;
             }
         }       
@@ -1669,9 +2050,13 @@ xmlSecAppDecryptFile(const char* filename) {
 done:
     /* print debug info if requested */
     if(repeats <= 1) { 
-        xmlSecAppPrintEncCtx(&encCtx);
+        xmlSecAppPrintEncCtx(encCtx);
+    }
+    if(encCtx == &localCtx) {
+        xmlSecEncCtxFinalize(encCtx);
+    } else if(xmlSecAppResetEncCtx(encCtx) < 0) {
+        res = -1;
     }
-    xmlSecEncCtxFinalize(&encCtx);
 
     if(data != NULL) {
         xmlSecAppXmlDataDestroy(data);
@@ -1736,16 +2121,16 @@ xmlSecAppEncryptTmpl(void) {
         fprintf(stderr, "Error: failed to encrypt data\n");
         goto done;      
     }
-    total_time += clock() - start_time;    
+    xmlSecAppAddTime(start_time);
     
     /* print out result only once per execution */
     if(repeats <= 1) {
         if(encCtx.resultReplaced) {
-            if(xmlSecAppWriteResult(doc, NULL) < 0) {
+            if(xmlSecAppWriteResult(xmlSecAppCmdLineParamGetString(&outputParam), doc, NULL) < 0) {
                 goto done;
             }
         } else {
-            if(xmlSecAppWriteResult(NULL, encCtx.result) < 0) {
+            if(xmlSecAppWriteResult(xmlSecAppCmdLineParamGetString(&outputParam), NULL, encCtx.result) < 0) {
                 goto done;
             }
         }       
@@ -1788,6 +2173,13 @@ xmlSecAppPrepareEncCtx(xmlSecEncCtxPtr encCtx) {
         }
     }
 
+    if(xmlSecAppCmdLineParamIsSet(&lazyDecryptParam)) {
+        encCtx->flags |= XMLSEC_ENC_LAZY_DECRYPTED_DATA;
+    }
+    if(xmlSecAppCmdLineParamIsSet(&encKeyMatchRecipientParam)) {
+        encCtx->keyInfoReadCtx.flags |= XMLSEC_KEYINFO_FLAGS_ENCKEY_MATCH_RECIPIENT;
+    }
+
     if(xmlSecAppCmdLineParamGetStringList(&enabledCipherRefUrisParam) != NULL) {
         encCtx->transformCtx.enabledUris = xmlSecAppGetUriType(
                     xmlSecAppCmdLineParamGetStringList(&enabledCipherRefUrisParam));
@@ -1800,6 +2192,29 @@ xmlSecAppPrepareEncCtx(xmlSecEncCtxPtr encCtx) {
     return(0);
 }
 
+static int
+xmlSecAppResetEncCtx(xmlSecEncCtxPtr encCtx) {
+    if(encCtx == NULL) {
+        fprintf(stderr, "Error: enc context is null\n");
+        return(-1);
+    }
+
+    /* the user settings are kept but the session key is destroyed
+     * and the key requirements are cleared */
+    xmlSecEncCtxReset(encCtx);
+    encCtx->keyInfoWriteCtx.keyReq.keyType = xmlSecKeyDataTypePublic;
+    if(xmlSecAppCmdLineParamGetString(&sessionKeyParam) != NULL) {
+        encCtx->encKey = xmlSecAppCryptoKeyGenerate(xmlSecAppCmdLineParamGetString(&sessionKeyParam),
+                                NULL, xmlSecKeyDataTypeSession);
+        if(encCtx->encKey == NULL) {
+            fprintf(stderr, "Error: failed to generate a session key \"%s\"\n",
+                    xmlSecAppCmdLineParamGetString(&sessionKeyParam));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
 static void 
 xmlSecAppPrintEncCtx(xmlSecEncCtxPtr encCtx) {
     if(encCtx == NULL) {
@@ -1818,28 +2233,1572 @@ xmlSecAppPrintEncCtx(xmlSecEncCtxPtr encCtx) {
 
 #endif /* XMLSEC_NO_XMLENC */
 
-static void 
-xmlSecAppListKeyData(void) {
-    fprintf(stdout, "Registered key data klasses:\n");
-    xmlSecKeyDataIdListDebugDump(xmlSecKeyDataIdsGet(), stdout);
-}
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+/****************************************************************
+ *
+ * Threads
+ *
+ ***************************************************************/
+typedef void                    (*xmlSecAppThreadRunCallback)   (void* param);
+
+typedef struct _xmlSecAppThread                                 xmlSecAppThread,
+                                                                *xmlSecAppThreadPtr;
+struct _xmlSecAppThread {
+    xmlSecAppThreadRunCallback  run;
+    void*                       param;
+#if defined(XMLSEC_APP_THREADS_WIN32)
+    HANDLE                      handle;
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+    pthread_t                   handle;
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+};
 
-static int 
-xmlSecAppCheckKeyData(const char * name) {
-    if(xmlSecKeyDataIdListFindByName(xmlSecKeyDataIdsGet(), BAD_CAST name, xmlSecKeyDataUsageAny) == xmlSecKeyDataIdUnknown) {
-        return -1;
-    }
-    return 0;
+#if defined(XMLSEC_APP_THREADS_WIN32)
+static DWORD WINAPI
+xmlSecAppThreadMain(LPVOID param) {
+    xmlSecAppThreadPtr thread = (xmlSecAppThreadPtr)param;
+
+    thread->run(thread->param);
+    return(0);
 }
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+static void*
+xmlSecAppThreadMain(void* param) {
+    xmlSecAppThreadPtr thread = (xmlSecAppThreadPtr)param;
 
-static void 
-xmlSecAppListTransforms(void) {
-    fprintf(stdout, "Registered transform klasses:\n");
-    xmlSecTransformIdListDebugDump(xmlSecTransformIdsGet(), stdout);
+    thread->run(thread->param);
+    return(NULL);
 }
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
 
-static int 
-xmlSecAppCheckTransform(const char * name) {
+/* returns the "--threads" value or a negative value if it is invalid */
+static int
+xmlSecAppGetThreadsNumber(void) {
+    int threadsNum = 1;
+
+    if(xmlSecAppCmdLineParamIsSet(&threadsParam)) {
+        threadsNum = xmlSecAppCmdLineParamGetInt(&threadsParam, 1);
+        if(threadsNum <= 0) {
+            fprintf(stderr, "Error: invalid number of threads %d\n", threadsNum);
+            return(-1);
+        }
+    }
+#if !defined(XMLSEC_APP_THREADS_WIN32) && !defined(XMLSEC_APP_THREADS_PTHREAD)
+    if(threadsNum > 1) {
+        fprintf(stderr, "Error: threads are not supported on this platform\n");
+        return(-1);
+    }
+#endif /* !defined(XMLSEC_APP_THREADS_WIN32) && !defined(XMLSEC_APP_THREADS_PTHREAD) */
+    return(threadsNum);
+}
+
+/*
+ * Calls @run for each of @threadsNum params (@paramSize bytes each) in
+ * the @params array, the current thread runs the first one. Returns 0 if
+ * all the threads were started or a negative value otherwise (the
+ * started threads are always waited for).
+ */
+static int
+xmlSecAppRunThreads(xmlSecAppThreadRunCallback run, void* params, size_t paramSize, int threadsNum) {
+    xmlSecAppThreadPtr threads;
+    int started, ii;
+
+    if(threadsNum <= 1) {
+        run(params);
+        return(0);
+    }
+
+    threads = (xmlSecAppThreadPtr)calloc(threadsNum, sizeof(xmlSecAppThread));
+    if(threads == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        return(-1);
+    }
+    for(started = 1; started < threadsNum; ++started) {
+        threads[started].run = run;
+        threads[started].param = (char*)params + started * paramSize;
+#if defined(XMLSEC_APP_THREADS_WIN32)
+        threads[started].handle = CreateThread(NULL, 0, xmlSecAppThreadMain, &(threads[started]), 0, NULL);
+        if(threads[started].handle == NULL) {
+            fprintf(stderr, "Error: failed to create thread\n");
+            break;
+        }
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+        if(pthread_create(&(threads[started].handle), NULL, xmlSecAppThreadMain, &(threads[started])) != 0) {
+            fprintf(stderr, "Error: failed to create thread\n");
+            break;
+        }
+#else /* defined(XMLSEC_APP_THREADS_WIN32) */
+        break;
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+    }
+
+    run(params);
+    for(ii = 1; ii < started; ++ii) {
+#if defined(XMLSEC_APP_THREADS_WIN32)
+        WaitForSingleObject(threads[ii].handle, INFINITE);
+        CloseHandle(threads[ii].handle);
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+        pthread_join(threads[ii].handle, NULL);
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+    }
+    free(threads);
+    return((started < threadsNum) ? -1 : 0);
+}
+
+/****************************************************************
+ *
+ * Bench
+ *
+ * The operations are distributed between the threads one at a time.
+ * The time of each operation is split into phases using the keys
+ * manager getKey callback and the transforms chains pre-execute
+ * callbacks: the time between the first <dsig:Reference/> chain and
+ * the <dsig:SignedInfo/> chain is counted as references processing,
+ * the time after the <dsig:SignedInfo/> (or the cipher) chain is
+ * prepared is counted as signature (or cipher) processing.
+ *
+ * The libxml2 memory functions (and thus the xmlsec ones) are replaced
+ * with the counting wrappers before the libraries are initialized. The
+ * allocations are counted per thread and are split between the phases
+ * at the same marks as the time. The crypto library allocations do not
+ * go through libxml2 and are not counted.
+ *
+ ***************************************************************/
+typedef enum {
+    xmlSecAppBenchPhaseParse = 0,
+    xmlSecAppBenchPhaseKeys,
+    xmlSecAppBenchPhaseReferences,
+    xmlSecAppBenchPhaseSignature,
+    xmlSecAppBenchPhaseCipher,
+    xmlSecAppBenchPhaseSerialize,
+    xmlSecAppBenchPhaseOther,
+    xmlSecAppBenchPhasesNumber
+} xmlSecAppBenchPhase;
+
+static const char* xmlSecAppBenchPhaseNames[xmlSecAppBenchPhasesNumber] = {
+    "parse",
+    "key resolution",
+    "references (c14n, digest)",
+    "signature (c14n, key op)",
+    "cipher",
+    "serialization",
+    "other"
+};
+
+typedef struct _xmlSecAppBenchJob                               xmlSecAppBenchJob,
+                                                                *xmlSecAppBenchJobPtr;
+struct _xmlSecAppBenchJob {
+    xmlSecAppCommand    command;
+    const char**        files;
+    int                 filesNum;
+    int                 total;
+    int                 next;
+    int                 failed;
+    xmlMutexPtr         mutex;
+    double*             latencies;
+};
+
+typedef struct _xmlSecAppBenchThread                            xmlSecAppBenchThread,
+                                                                *xmlSecAppBenchThreadPtr;
+typedef struct _xmlSecAppBenchAllocCounters                     xmlSecAppBenchAllocCounters,
+                                                                *xmlSecAppBenchAllocCountersPtr;
+struct _xmlSecAppBenchAllocCounters {
+    size_t              allocs;
+    size_t              bytes;
+    long                current;        /* might be negative if the memory is freed by another thread */
+    long                peak;           /* since the last phase switch */
+};
+
+struct _xmlSecAppBenchThread {
+    xmlSecAppBenchJobPtr job;
+    double              phases[xmlSecAppBenchPhasesNumber];
+    size_t              allocs[xmlSecAppBenchPhasesNumber];
+    size_t              allocBytes[xmlSecAppBenchPhasesNumber];
+    long                allocPeaks[xmlSecAppBenchPhasesNumber];
+
+    /* the current operation marks */
+    double              keysTime;
+    double              referencesStart;
+    double              transformStart;
+
+    /* the allocations of the current phase */
+    xmlSecAppBenchAllocCounters counters;
+    xmlSecAppBenchPhase allocPhase;
+    xmlSecAppBenchPhase allocTransformPhase;
+    size_t              allocsMark;
+    size_t              allocBytesMark;
+    long                allocCurrentMark;
+};
+
+static xmlSecGetKeyCallback xmlSecAppBenchOrigGetKey = NULL;
+
+/* the allocations size prefix keeps the max alignment */
+typedef union _xmlSecAppBenchAllocHeader {
+    size_t              size;
+    double              d;
+    long double         ld;
+    void*               p;
+} xmlSecAppBenchAllocHeader;
+
+static int              xmlSecAppBenchAllocInstalled    = 0;
+static xmlFreeFunc      xmlSecAppBenchOrigFree          = NULL;
+static xmlMallocFunc    xmlSecAppBenchOrigMalloc        = NULL;
+static xmlReallocFunc   xmlSecAppBenchOrigRealloc       = NULL;
+
+#if defined(XMLSEC_APP_THREADS_WIN32)
+static DWORD xmlSecAppBenchCountersKey = TLS_OUT_OF_INDEXES;
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+static pthread_key_t xmlSecAppBenchCountersKey;
+#else /* defined(XMLSEC_APP_THREADS_WIN32) */
+static xmlSecAppBenchAllocCountersPtr xmlSecAppBenchCountersCurrent = NULL;
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+
+static xmlSecAppBenchAllocCountersPtr
+xmlSecAppBenchGetCounters(void) {
+#if defined(XMLSEC_APP_THREADS_WIN32)
+    return((xmlSecAppBenchAllocCountersPtr)TlsGetValue(xmlSecAppBenchCountersKey));
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+    return((xmlSecAppBenchAllocCountersPtr)pthread_getspecific(xmlSecAppBenchCountersKey));
+#else /* defined(XMLSEC_APP_THREADS_WIN32) */
+    return(xmlSecAppBenchCountersCurrent);
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+}
+
+static void
+xmlSecAppBenchSetCounters(xmlSecAppBenchAllocCountersPtr counters) {
+    if(xmlSecAppBenchAllocInstalled == 0) {
+        return;
+    }
+#if defined(XMLSEC_APP_THREADS_WIN32)
+    TlsSetValue(xmlSecAppBenchCountersKey, counters);
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+    pthread_setspecific(xmlSecAppBenchCountersKey, counters);
+#else /* defined(XMLSEC_APP_THREADS_WIN32) */
+    xmlSecAppBenchCountersCurrent = counters;
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+}
+
+static void
+xmlSecAppBenchCount(long delta, size_t size) {
+    xmlSecAppBenchAllocCountersPtr counters;
+
+    counters = xmlSecAppBenchGetCounters();
+    if(counters == NULL) {
+        return;
+    }
+    if(size > 0) {
+        ++counters->allocs;
+        counters->bytes += size;
+    }
+    counters->current += delta;
+    if(counters->current > counters->peak) {
+        counters->peak = counters->current;
+    }
+}
+
+static void*
+xmlSecAppBenchMalloc(size_t size) {
+    xmlSecAppBenchAllocHeader* header;
+
+    header = (xmlSecAppBenchAllocHeader*)xmlSecAppBenchOrigMalloc(sizeof(xmlSecAppBenchAllocHeader) + size);
+    if(header == NULL) {
+        return(NULL);
+    }
+    header->size = size;
+    xmlSecAppBenchCount((long)size, size);
+    return(header + 1);
+}
+
+static void*
+xmlSecAppBenchRealloc(void* mem, size_t size) {
+    xmlSecAppBenchAllocHeader* header;
+    size_t oldSize;
+
+    if(mem == NULL) {
+        return(xmlSecAppBenchMalloc(size));
+    }
+    header = ((xmlSecAppBenchAllocHeader*)mem) - 1;
+    oldSize = header->size;
+
+    header = (xmlSecAppBenchAllocHeader*)xmlSecAppBenchOrigRealloc(header, sizeof(xmlSecAppBenchAllocHeader) + size);
+    if(header == NULL) {
+        return(NULL);
+    }
+    header->size = size;
+    xmlSecAppBenchCount((long)size - (long)oldSize, size);
+    return(header + 1);
+}
+
+static void
+xmlSecAppBenchFree(void* mem) {
+    xmlSecAppBenchAllocHeader* header;
+
+    if(mem == NULL) {
+        return;
+    }
+    header = ((xmlSecAppBenchAllocHeader*)mem) - 1;
+    xmlSecAppBenchCount(-(long)header->size, 0);
+    xmlSecAppBenchOrigFree(header);
+}
+
+static char*
+xmlSecAppBenchStrdup(const char* str) {
+    char* res;
+    size_t size;
+
+    if(str == NULL) {
+        return(NULL);
+    }
+    size = strlen(str) + 1;
+    res = (char*)xmlSecAppBenchMalloc(size);
+    if(res == NULL) {
+        return(NULL);
+    }
+    memcpy(res, str, size);
+    return(res);
+}
+
+static int
+xmlSecAppBenchAllocInstall(void) {
+    xmlStrdupFunc strdupFunc = NULL;
+
+    if(xmlSecAppBenchAllocInstalled != 0) {
+        return(0);
+    }
+#if defined(XMLSEC_APP_THREADS_WIN32)
+    xmlSecAppBenchCountersKey = TlsAlloc();
+    if(xmlSecAppBenchCountersKey == TLS_OUT_OF_INDEXES) {
+        return(-1);
+    }
+#elif defined(XMLSEC_APP_THREADS_PTHREAD)
+    if(pthread_key_create(&xmlSecAppBenchCountersKey, NULL) != 0) {
+        return(-1);
+    }
+#endif /* defined(XMLSEC_APP_THREADS_WIN32) */
+
+    if(xmlMemGet(&xmlSecAppBenchOrigFree, &xmlSecAppBenchOrigMalloc,
+                 &xmlSecAppBenchOrigRealloc, &strdupFunc) != 0) {
+        return(-1);
+    }
+    if(xmlMemSetup(xmlSecAppBenchFree, xmlSecAppBenchMalloc,
+                   xmlSecAppBenchRealloc, xmlSecAppBenchStrdup) != 0) {
+        return(-1);
+    }
+    xmlSecAppBenchAllocInstalled = 1;
+    return(0);
+}
+
+/* adds the allocations since the last switch to the current phase */
+static void
+xmlSecAppBenchAllocSwitch(xmlSecAppBenchThreadPtr thread, xmlSecAppBenchPhase phase) {
+    xmlSecAppBenchAllocCountersPtr counters = &(thread->counters);
+    xmlSecAppBenchPhase cur = thread->allocPhase;
+
+    thread->allocs[cur] += counters->allocs - thread->allocsMark;
+    thread->allocBytes[cur] += counters->bytes - thread->allocBytesMark;
+    if(counters->peak - thread->allocCurrentMark > thread->allocPeaks[cur]) {
+        thread->allocPeaks[cur] = counters->peak - thread->allocCurrentMark;
+    }
+
+    thread->allocPhase = phase;
+    thread->allocsMark = counters->allocs;
+    thread->allocBytesMark = counters->bytes;
+    thread->allocCurrentMark = counters->current;
+    counters->peak = counters->current;
+}
+
+/* returns the wall clock time in microseconds */
+static double
+xmlSecAppBenchNow(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return(((double)now.QuadPart * 1000000.0) / (double)freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((double)ts.tv_sec * 1000000.0) + ((double)ts.tv_nsec / 1000.0));
+#else /* defined(_WIN32) */
+    return(((double)clock() * 1000000.0) / CLOCKS_PER_SEC);
+#endif /* defined(_WIN32) */
+}
+
+static xmlSecKeyPtr
+xmlSecAppBenchGetKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecAppBenchThreadPtr thread;
+    xmlSecAppBenchPhase phase = xmlSecAppBenchPhaseOther;
+    xmlSecKeyPtr key;
+    double start;
+
+    thread = (keyInfoCtx != NULL) ? (xmlSecAppBenchThreadPtr)keyInfoCtx->userData : NULL;
+    if(thread != NULL) {
+        phase = thread->allocPhase;
+        xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseKeys);
+    }
+    start = xmlSecAppBenchNow();
+    key = xmlSecAppBenchOrigGetKey(keyInfoNode, keyInfoCtx);
+    if(thread != NULL) {
+        thread->keysTime += xmlSecAppBenchNow() - start;
+        xmlSecAppBenchAllocSwitch(thread, phase);
+    }
+    return(key);
+}
+
+#ifndef XMLSEC_NO_XMLDSIG
+static int
+xmlSecAppBenchReferencePreExec(xmlSecTransformCtxPtr transformCtx) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecAppBenchThreadPtr thread;
+
+    dsigRefCtx = (xmlSecDSigReferenceCtxPtr)((char*)transformCtx - offsetof(xmlSecDSigReferenceCtx, transformCtx));
+    thread = (xmlSecAppBenchThreadPtr)dsigRefCtx->dsigCtx->userData;
+    if((thread != NULL) && (thread->referencesStart <= 0)) {
+        thread->referencesStart = xmlSecAppBenchNow();
+        xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseReferences);
+    }
+    return(0);
+}
+#endif /* XMLSEC_NO_XMLDSIG */
+
+static int
+xmlSecAppBenchTransformPreExec(xmlSecTransformCtxPtr transformCtx) {
+    xmlSecAppBenchThreadPtr thread;
+
+    thread = (xmlSecAppBenchThreadPtr)transformCtx->userData;
+    if(thread != NULL) {
+        thread->transformStart = xmlSecAppBenchNow();
+        xmlSecAppBenchAllocSwitch(thread, thread->allocTransformPhase);
+    }
+    return(0);
+}
+
+static void
+xmlSecAppBenchAddOperation(xmlSecAppBenchThreadPtr thread, xmlSecAppBenchPhase transformPhase,
+                           double start, double end) {
+    double other = end - start;
+    double t;
+
+    if(thread->transformStart > 0) {
+        t = (thread->referencesStart > thread->transformStart) ? thread->referencesStart : end;
+        thread->phases[transformPhase] += t - thread->transformStart;
+        other -= t - thread->transformStart;
+    }
+    if(thread->referencesStart > 0) {
+        t = (thread->transformStart > thread->referencesStart) ? thread->transformStart : end;
+        thread->phases[xmlSecAppBenchPhaseReferences] += t - thread->referencesStart;
+        other -= t - thread->referencesStart;
+    }
+    thread->phases[xmlSecAppBenchPhaseKeys] += thread->keysTime;
+    other -= thread->keysTime;
+    thread->phases[xmlSecAppBenchPhaseOther] += (other > 0) ? other : 0;
+
+    thread->keysTime = 0;
+    thread->referencesStart = 0;
+    thread->transformStart = 0;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseOther);
+}
+
+static double
+xmlSecAppBenchSerialize(xmlSecAppBenchThreadPtr thread, xmlDocPtr doc) {
+    xmlChar* buf = NULL;
+    int size = 0;
+    double start, end;
+
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseSerialize);
+    start = xmlSecAppBenchNow();
+    xmlDocDumpMemory(doc, &buf, &size);
+    if(buf != NULL) {
+        xmlFree(buf);
+    }
+    end = xmlSecAppBenchNow();
+    thread->phases[xmlSecAppBenchPhaseSerialize] += end - start;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseOther);
+    return(end);
+}
+
+#ifndef XMLSEC_NO_XMLDSIG
+static int
+xmlSecAppBenchDSig(xmlSecAppBenchThreadPtr thread, const char* filename, double* latency) {
+    xmlSecAppXmlDataPtr data = NULL;
+    xmlSecDSigCtx dsigCtx;
+    double start, parsed, end;
+    int ret;
+    int res = -1;
+
+    if(xmlSecDSigCtxInitialize(&dsigCtx, gKeysMngr) < 0) {
+        fprintf(stderr, "Error: dsig context initialization failed\n");
+        return(-1);
+    }
+
+    thread->allocTransformPhase = xmlSecAppBenchPhaseSignature;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseParse);
+    start = xmlSecAppBenchNow();
+    data = xmlSecAppXmlDataCreate(filename, xmlSecNodeSignature, xmlSecDSigNs);
+    if(data == NULL) {
+        fprintf(stderr, "Error: failed to load document \"%s\"\n", filename);
+        goto done;
+    }
+    parsed = xmlSecAppBenchNow();
+    thread->phases[xmlSecAppBenchPhaseParse] += parsed - start;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseOther);
+
+    if(xmlSecAppPrepareDSigCtx(&dsigCtx) < 0) {
+        fprintf(stderr, "Error: dsig context preparation failed\n");
+        goto done;
+    }
+    dsigCtx.userData = thread;
+    dsigCtx.keyInfoReadCtx.userData = thread;
+    dsigCtx.referencePreExecuteCallback = xmlSecAppBenchReferencePreExec;
+    dsigCtx.transformCtx.userData = thread;
+    dsigCtx.transformCtx.preExecCallback = xmlSecAppBenchTransformPreExec;
+
+    if(thread->job->command == xmlSecAppCommandSign) {
+        ret = xmlSecDSigCtxSign(&dsigCtx, data->startNode);
+    } else {
+        ret = xmlSecDSigCtxVerify(&dsigCtx, data->startNode);
+    }
+    end = xmlSecAppBenchNow();
+    if(ret < 0) {
+        fprintf(stderr,"Error: signature failed \n");
+        goto done;
+    }
+    if((thread->job->command == xmlSecAppCommandVerify) && (dsigCtx.status != xmlSecDSigStatusSucceeded)) {
+        fprintf(stderr, "Error: signature in the file \"%s\" is invalid\n", filename);
+        goto done;
+    }
+    xmlSecAppBenchAddOperation(thread, xmlSecAppBenchPhaseSignature, parsed, end);
+
+    if(thread->job->command == xmlSecAppCommandSign) {
+        end = xmlSecAppBenchSerialize(thread, data->doc);
+    }
+    (*latency) = end - start;
+    res = 0;
+
+done:
+    xmlSecDSigCtxFinalize(&dsigCtx);
+    if(data != NULL) {
+        xmlSecAppXmlDataDestroy(data);
+    }
+    return(res);
+}
+#endif /* XMLSEC_NO_XMLDSIG */
+
+#ifndef XMLSEC_NO_XMLENC
+static int
+xmlSecAppBenchEncrypt(xmlSecAppBenchThreadPtr thread, const char* filename, double* latency) {
+    xmlSecAppXmlDataPtr data = NULL;
+    xmlSecEncCtx encCtx;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr startTmplNode;
+    double start, parsed, end;
+    int ret;
+    int res = -1;
+
+    if(xmlSecEncCtxInitialize(&encCtx, gKeysMngr) < 0) {
+        fprintf(stderr, "Error: enc context initialization failed\n");
+        return(-1);
+    }
+
+    thread->allocTransformPhase = xmlSecAppBenchPhaseCipher;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseParse);
+    start = xmlSecAppBenchNow();
+    doc = xmlSecParseFile(filename);
+    if(doc == NULL) {
+        fprintf(stderr, "Error: failed to parse xml file \"%s\"\n", filename);
+        goto done;
+    }
+    startTmplNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeEncryptedData, xmlSecEncNs);
+    if(startTmplNode == NULL) {
+        fprintf(stderr, "Error: failed to find default node with name=\"%s\"\n", 
+                xmlSecNodeEncryptedData);
+        goto done;
+    }
+    if(xmlSecAppCmdLineParamGetString(&xmlDataParam) != NULL) {
+        data = xmlSecAppXmlDataCreate(xmlSecAppCmdLineParamGetString(&xmlDataParam), NULL, NULL);
+        if(data == NULL) {
+            fprintf(stderr, "Error: failed to load file \"%s\"\n", 
+                    xmlSecAppCmdLineParamGetString(&xmlDataParam));
+            goto done;
+        }
+    } else if(xmlSecAppCmdLineParamGetString(&binaryDataParam) == NULL) {
+        fprintf(stderr, "Error: encryption data not specified (use \"--xml\" or \"--binary\" options)\n");
+        goto done;
+    }
+    parsed = xmlSecAppBenchNow();
+    thread->phases[xmlSecAppBenchPhaseParse] += parsed - start;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseOther);
+
+    if(xmlSecAppPrepareEncCtx(&encCtx) < 0) {
+        fprintf(stderr, "Error: enc context preparation failed\n");
+        goto done;
+    }
+    encCtx.keyInfoReadCtx.userData = thread;
+    encCtx.transformCtx.userData = thread;
+    encCtx.transformCtx.preExecCallback = xmlSecAppBenchTransformPreExec;
+
+    if(data != NULL) {
+        ret = xmlSecEncCtxXmlEncrypt(&encCtx, startTmplNode, data->startNode);
+    } else {
+        ret = xmlSecEncCtxUriEncrypt(&encCtx, startTmplNode, BAD_CAST xmlSecAppCmdLineParamGetString(&binaryDataParam));
+    }
+    end = xmlSecAppBenchNow();
+    if(ret < 0) {
+        fprintf(stderr, "Error: failed to encrypt data\n");
+        goto done;
+    }
+    xmlSecAppBenchAddOperation(thread, xmlSecAppBenchPhaseCipher, parsed, end);
+
+    if(encCtx.resultReplaced) {
+        end = xmlSecAppBenchSerialize(thread, (data != NULL) ? data->doc : doc);
+    }
+    (*latency) = end - start;
+    res = 0;
+
+done:
+    xmlSecEncCtxFinalize(&encCtx);
+    if(data != NULL) {
+        xmlSecAppXmlDataDestroy(data);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+xmlSecAppBenchDecrypt(xmlSecAppBenchThreadPtr thread, const char* filename, double* latency) {
+    xmlSecAppXmlDataPtr data = NULL;
+    xmlSecEncCtx encCtx;
+    double start, parsed, end;
+    int ret;
+    int res = -1;
+
+    if(xmlSecEncCtxInitialize(&encCtx, gKeysMngr) < 0) {
+        fprintf(stderr, "Error: enc context initialization failed\n");
+        return(-1);
+    }
+
+    thread->allocTransformPhase = xmlSecAppBenchPhaseCipher;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseParse);
+    start = xmlSecAppBenchNow();
+    data = xmlSecAppXmlDataCreate(filename, xmlSecNodeEncryptedData, xmlSecEncNs);
+    if(data == NULL) {
+        fprintf(stderr, "Error: failed to load document \"%s\"\n", filename);
+        goto done;
+    }
+    parsed = xmlSecAppBenchNow();
+    thread->phases[xmlSecAppBenchPhaseParse] += parsed - start;
+    xmlSecAppBenchAllocSwitch(thread, xmlSecAppBenchPhaseOther);
+
+    if(xmlSecAppPrepareEncCtx(&encCtx) < 0) {
+        fprintf(stderr, "Error: enc context preparation failed\n");
+        goto done;
+    }
+    encCtx.keyInfoReadCtx.userData = thread;
+    encCtx.transformCtx.userData = thread;
+    encCtx.transformCtx.preExecCallback = xmlSecAppBenchTransformPreExec;
+
+    ret = xmlSecEncCtxDecrypt(&encCtx, data->startNode);
+    end = xmlSecAppBenchNow();
+    if(ret < 0) {
+        fprintf(stderr, "Error: failed to decrypt file \"%s\"\n", filename);
+        goto done;
+    }
+    xmlSecAppBenchAddOperation(thread, xmlSecAppBenchPhaseCipher, parsed, end);
+
+    if(encCtx.resultReplaced) {
+        end = xmlSecAppBenchSerialize(thread, data->doc);
+    }
+    (*latency) = end - start;
+    res = 0;
+
+done:
+    xmlSecEncCtxFinalize(&encCtx);
+    if(data != NULL) {
+        xmlSecAppXmlDataDestroy(data);
+    }
+    return(res);
+}
+#endif /* XMLSEC_NO_XMLENC */
+
+static void
+xmlSecAppBenchRun(void* param) {
+    xmlSecAppBenchThreadPtr thread = (xmlSecAppBenchThreadPtr)param;
+    xmlSecAppBenchJobPtr job = thread->job;
+    const char* filename;
+    int pos, ret;
+
+    xmlSecAppBenchSetCounters(&(thread->counters));
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = (job->failed == 0) ? job->next : job->total;
+        if(pos < job->total) {
+            ++job->next;
+        }
+        xmlMutexUnlock(job->mutex);
+
+        if(pos >= job->total) {
+            break;
+        }
+
+        filename = job->files[pos % job->filesNum];
+        switch(job->command) {
+#ifndef XMLSEC_NO_XMLDSIG
+        case xmlSecAppCommandSign:
+        case xmlSecAppCommandVerify:
+            ret = xmlSecAppBenchDSig(thread, filename, &(job->latencies[pos]));
+            break;
+#endif /* XMLSEC_NO_XMLDSIG */
+#ifndef XMLSEC_NO_XMLENC
+        case xmlSecAppCommandEncrypt:
+            ret = xmlSecAppBenchEncrypt(thread, filename, &(job->latencies[pos]));
+            break;
+        case xmlSecAppCommandDecrypt:
+            ret = xmlSecAppBenchDecrypt(thread, filename, &(job->latencies[pos]));
+            break;
+#endif /* XMLSEC_NO_XMLENC */
+        default:
+            fprintf(stderr, "Error: invalid bench command %d\n", job->command);
+            ret = -1;
+            break;
+        }
+
+        if(ret < 0) {
+            xmlMutexLock(job->mutex);
+            job->failed = 1;
+            xmlMutexUnlock(job->mutex);
+            break;
+        }
+    }
+    xmlSecAppBenchSetCounters(NULL);
+}
+
+static int
+xmlSecAppBenchCompareLatencies(const void* a, const void* b) {
+    double aa = *((const double*)a);
+    double bb = *((const double*)b);
+
+    return((aa < bb) ? -1 : ((aa > bb) ? 1 : 0));
+}
+
+/* nearest-rank percentile of the sorted latencies */
+static double
+xmlSecAppBenchPercentile(const double* latencies, int size, double p) {
+    int pos;
+
+    pos = (int)(size * p);
+    if(pos < size * p) {
+        ++pos;
+    }
+    if(pos < 1) {
+        pos = 1;
+    }
+    return(latencies[pos - 1]);
+}
+
+static int
+xmlSecAppBench(xmlSecAppCommand command, const char** files, int filesNum) {
+    xmlSecAppBenchJob job;
+    xmlSecAppBenchThreadPtr threads = NULL;
+    double phases[xmlSecAppBenchPhasesNumber];
+    size_t allocs[xmlSecAppBenchPhasesNumber];
+    size_t allocBytes[xmlSecAppBenchPhasesNumber];
+    long allocPeaks[xmlSecAppBenchPhasesNumber];
+    double start, elapsed;
+    int threadsNum;
+    int res = -1;
+    int ret, ii, jj;
+
+    if((files == NULL) || (filesNum <= 0) || (gKeysMngr == NULL)) {
+        return(-1);
+    }
+    threadsNum = xmlSecAppGetThreadsNumber();
+    if(threadsNum <= 0) {
+        return(-1);
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.command = command;
+    job.files = files;
+    job.filesNum = filesNum;
+    job.total = repeats * filesNum;
+    job.latencies = (double*)malloc(sizeof(double) * job.total);
+    if(job.latencies == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        goto done;
+    }
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        fprintf(stderr, "Error: failed to create mutex\n");
+        goto done;
+    }
+    threads = (xmlSecAppBenchThreadPtr)calloc(threadsNum, sizeof(xmlSecAppBenchThread));
+    if(threads == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        goto done;
+    }
+    for(ii = 0; ii < threadsNum; ++ii) {
+        threads[ii].job = &job;
+    }
+
+    /* measure the key resolution for all the operations */
+    xmlSecAppBenchOrigGetKey = gKeysMngr->getKey;
+    gKeysMngr->getKey = xmlSecAppBenchGetKey;
+
+    start = xmlSecAppBenchNow();
+    ret = xmlSecAppRunThreads(xmlSecAppBenchRun, threads, sizeof(xmlSecAppBenchThread), threadsNum);
+    elapsed = xmlSecAppBenchNow() - start;
+
+    gKeysMngr->getKey = xmlSecAppBenchOrigGetKey;
+    xmlSecAppBenchOrigGetKey = NULL;
+
+    if((ret < 0) || (job.failed != 0)) {
+        goto done;
+    }
+
+    /* print results */
+    memset(phases, 0, sizeof(phases));
+    memset(allocs, 0, sizeof(allocs));
+    memset(allocBytes, 0, sizeof(allocBytes));
+    memset(allocPeaks, 0, sizeof(allocPeaks));
+    for(ii = 0; ii < threadsNum; ++ii) {
+        for(jj = 0; jj < xmlSecAppBenchPhasesNumber; ++jj) {
+            phases[jj] += threads[ii].phases[jj];
+            allocs[jj] += threads[ii].allocs[jj];
+            allocBytes[jj] += threads[ii].allocBytes[jj];
+            if(threads[ii].allocPeaks[jj] > allocPeaks[jj]) {
+                allocPeaks[jj] = threads[ii].allocPeaks[jj];
+            }
+        }
+    }
+    qsort(job.latencies, job.total, sizeof(double), xmlSecAppBenchCompareLatencies);
+
+    fprintf(stdout, "Threads:            %d\n", threadsNum);
+    fprintf(stdout, "Operations:         %d\n", job.total);
+    fprintf(stdout, "Elapsed time:       %.3f msec\n", elapsed / 1000.0);
+    fprintf(stdout, "Throughput:         %.2f ops/sec\n", (elapsed > 0) ? (job.total * 1000000.0 / elapsed) : 0.0);
+    fprintf(stdout, "Latency (usec):     min %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+            job.latencies[0],
+            xmlSecAppBenchPercentile(job.latencies, job.total, 0.50),
+            xmlSecAppBenchPercentile(job.latencies, job.total, 0.90),
+            xmlSecAppBenchPercentile(job.latencies, job.total, 0.99),
+            job.latencies[job.total - 1]);
+    fprintf(stdout, "Phases (average usec per operation):\n");
+    for(jj = 0; jj < xmlSecAppBenchPhasesNumber; ++jj) {
+        if((phases[jj] > 0) || (jj == xmlSecAppBenchPhaseOther)) {
+            fprintf(stdout, "    %-28s %10.1f\n", xmlSecAppBenchPhaseNames[jj], phases[jj] / job.total);
+        }
+    }
+    if(xmlSecAppBenchAllocInstalled != 0) {
+        fprintf(stdout, "Allocations (average per operation, max peak bytes):\n");
+        fprintf(stdout, "    %-28s %10s %12s %12s\n", "", "allocs", "bytes", "peak");
+        for(jj = 0; jj < xmlSecAppBenchPhasesNumber; ++jj) {
+            if((allocs[jj] > 0) || (jj == xmlSecAppBenchPhaseOther)) {
+                fprintf(stdout, "    %-28s %10.1f %12.1f %12ld\n", xmlSecAppBenchPhaseNames[jj],
+                        (double)allocs[jj] / job.total, (double)allocBytes[jj] / job.total,
+                        allocPeaks[jj]);
+            }
+        }
+    }
+    res = 0;
+
+done:
+    if(threads != NULL) {
+        free(threads);
+    }
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    if(job.latencies != NULL) {
+        free(job.latencies);
+    }
+    return(res);
+}
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+/****************************************************************
+ *
+ * Worker contexts
+ *
+ * The batch and the serve modes create the contexts once per worker
+ * thread and reset them after each file.
+ *
+ ***************************************************************/
+typedef struct _xmlSecAppWorkerCtx                              xmlSecAppWorkerCtx,
+                                                                *xmlSecAppWorkerCtxPtr;
+struct _xmlSecAppWorkerCtx {
+#ifndef XMLSEC_NO_XMLDSIG
+    xmlSecDSigCtx       dsigCtx;
+    int                 dsigInitialized;
+#endif /* XMLSEC_NO_XMLDSIG */
+#ifndef XMLSEC_NO_XMLENC
+    xmlSecEncCtx        encCtx;
+    int                 encInitialized;
+#endif /* XMLSEC_NO_XMLENC */
+};
+
+static void
+xmlSecAppWorkerCtxFinalize(xmlSecAppWorkerCtxPtr ctx) {
+#ifndef XMLSEC_NO_XMLDSIG
+    if(ctx->dsigInitialized != 0) {
+        xmlSecDSigCtxFinalize(&(ctx->dsigCtx));
+        ctx->dsigInitialized = 0;
+    }
+#endif /* XMLSEC_NO_XMLDSIG */
+#ifndef XMLSEC_NO_XMLENC
+    if(ctx->encInitialized != 0) {
+        xmlSecEncCtxFinalize(&(ctx->encCtx));
+        ctx->encInitialized = 0;
+    }
+#endif /* XMLSEC_NO_XMLENC */
+}
+
+/* creates the contexts required for @command (all of them for "serve") */
+static int
+xmlSecAppWorkerCtxInitialize(xmlSecAppWorkerCtxPtr ctx, xmlSecAppCommand command) {
+    int dsig = 0;
+    int enc = 0;
+
+    memset(ctx, 0, sizeof(xmlSecAppWorkerCtx));
+    switch(command) {
+    case xmlSecAppCommandSign:
+    case xmlSecAppCommandVerify:
+        dsig = 1;
+        break;
+    case xmlSecAppCommandEncrypt:
+    case xmlSecAppCommandDecrypt:
+        enc = 1;
+        break;
+    case xmlSecAppCommandServe:
+        dsig = enc = 1;
+        break;
+    default:
+        fprintf(stderr, "Error: invalid worker command %d\n", command);
+        return(-1);
+    }
+
+#ifndef XMLSEC_NO_XMLDSIG
+    if(dsig != 0) {
+        if(xmlSecDSigCtxInitialize(&(ctx->dsigCtx), gKeysMngr) < 0) {
+            fprintf(stderr, "Error: dsig context initialization failed\n");
+            return(-1);
+        }
+        ctx->dsigInitialized = 1;
+        if(xmlSecAppPrepareDSigCtx(&(ctx->dsigCtx)) < 0) {
+            fprintf(stderr, "Error: dsig context preparation failed\n");
+            xmlSecAppWorkerCtxFinalize(ctx);
+            return(-1);
+        }
+    }
+#endif /* XMLSEC_NO_XMLDSIG */
+#ifndef XMLSEC_NO_XMLENC
+    if(enc != 0) {
+        if(xmlSecEncCtxInitialize(&(ctx->encCtx), gKeysMngr) < 0) {
+            fprintf(stderr, "Error: enc context initialization failed\n");
+            xmlSecAppWorkerCtxFinalize(ctx);
+            return(-1);
+        }
+        ctx->encInitialized = 1;
+        if(xmlSecAppPrepareEncCtx(&(ctx->encCtx)) < 0) {
+            fprintf(stderr, "Error: enc context preparation failed\n");
+            xmlSecAppWorkerCtxFinalize(ctx);
+            return(-1);
+        }
+    }
+#endif /* XMLSEC_NO_XMLENC */
+    return(0);
+}
+
+static int
+xmlSecAppWorkerCtxProcessFile(xmlSecAppWorkerCtxPtr ctx, xmlSecAppCommand command,
+                              const char* file, const char* output) {
+    switch(command) {
+#ifndef XMLSEC_NO_XMLDSIG
+    case xmlSecAppCommandSign:
+        return((ctx->dsigInitialized != 0) ? xmlSecAppSignFile(file, output, &(ctx->dsigCtx)) : -1);
+    case xmlSecAppCommandVerify:
+        return((ctx->dsigInitialized != 0) ? xmlSecAppVerifyFile(file, output, &(ctx->dsigCtx)) : -1);
+#endif /* XMLSEC_NO_XMLDSIG */
+#ifndef XMLSEC_NO_XMLENC
+    case xmlSecAppCommandEncrypt:
+        return((ctx->encInitialized != 0) ? xmlSecAppEncryptFile(file, output, &(ctx->encCtx)) : -1);
+    case xmlSecAppCommandDecrypt:
+        return((ctx->encInitialized != 0) ? xmlSecAppDecryptFile(file, output, &(ctx->encCtx)) : -1);
+#endif /* XMLSEC_NO_XMLENC */
+    default:
+        return(-1);
+    }
+}
+
+/*
+ * Splits the @buf line into at most @wordsMax space separated words
+ * (the "#" starts a comment). Returns the number of words or a negative
+ * value if there are more than @wordsMax words.
+ */
+static int
+xmlSecAppSplitLine(char* buf, char** words, int wordsMax) {
+    char* p = buf;
+    int num = 0;
+
+    while(*p != '\0') {
+        while((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')) {
+            *(p++) = '\0';
+        }
+        if((*p == '\0') || (*p == '#')) {
+            break;
+        }
+        if(num >= wordsMax) {
+            return(-1);
+        }
+        words[num++] = p;
+        while((*p != '\0') && (*p != ' ') && (*p != '\t') && (*p != '\r') && (*p != '\n')) {
+            ++p;
+        }
+    }
+    return(num);
+}
+
+/****************************************************************
+ *
+ * Batch
+ *
+ * Each worker thread reads the next "<file> [<output>]" line from the
+ * shared list and processes it with its own contexts.
+ *
+ ***************************************************************/
+#define XMLSEC_APP_BATCH_LINE_SIZE      4096
+
+typedef struct _xmlSecAppBatchJob                               xmlSecAppBatchJob,
+                                                                *xmlSecAppBatchJobPtr;
+struct _xmlSecAppBatchJob {
+    xmlSecAppCommand    command;
+    FILE*               input;
+    int                 line;
+    int                 error;
+    xmlMutexPtr         mutex;
+};
+
+typedef struct _xmlSecAppBatchThread                            xmlSecAppBatchThread,
+                                                                *xmlSecAppBatchThreadPtr;
+struct _xmlSecAppBatchThread {
+    xmlSecAppBatchJobPtr job;
+    int                 processed;
+    int                 failed;
+};
+
+/*
+ * Reads the next not empty line from the list and splits it into
+ * the file and the output names. Returns 1 if the line is read, 0
+ * at the end of the list and a negative value if an error occurs.
+ */
+static int
+xmlSecAppBatchReadLine(xmlSecAppBatchJobPtr job, char* buf, int* line, char** file, char** output) {
+    char* words[2];
+    size_t len;
+    int num;
+    int res = 0;
+
+    xmlMutexLock(job->mutex);
+    while((job->error == 0) && (fgets(buf, XMLSEC_APP_BATCH_LINE_SIZE, job->input) != NULL)) {
+        ++job->line;
+        len = strlen(buf);
+        if((len > 0) && (buf[len - 1] != '\n') && (feof(job->input) == 0)) {
+            fprintf(stderr, "Error: line %d in the batch list is too long\n", job->line);
+            job->error = 1;
+            break;
+        }
+
+        num = xmlSecAppSplitLine(buf, words, 2);
+        if(num < 0) {
+            fprintf(stderr, "Error: line %d in the batch list has more than two file names\n", job->line);
+            job->error = 1;
+            break;
+        } else if(num > 0) {
+            (*file) = words[0];
+            (*output) = (num > 1) ? words[1] : NULL;
+            (*line) = job->line;
+            res = 1;
+            break;
+        }
+    }
+    if(job->error != 0) {
+        res = -1;
+    }
+    xmlMutexUnlock(job->mutex);
+    return(res);
+}
+
+static void
+xmlSecAppBatchRun(void* param) {
+    xmlSecAppBatchThreadPtr thread = (xmlSecAppBatchThreadPtr)param;
+    xmlSecAppBatchJobPtr job = thread->job;
+    xmlSecAppWorkerCtx ctx;
+    char buf[XMLSEC_APP_BATCH_LINE_SIZE];
+    char* file;
+    char* output;
+    int line = 0;
+    int ret;
+
+    /* the contexts are created once for all the files */
+    if(xmlSecAppWorkerCtxInitialize(&ctx, job->command) < 0) {
+        xmlMutexLock(job->mutex);
+        job->error = 1;
+        xmlMutexUnlock(job->mutex);
+        return;
+    }
+
+    while(xmlSecAppBatchReadLine(job, buf, &line, &file, &output) > 0) {
+        ret = xmlSecAppWorkerCtxProcessFile(&ctx, job->command, file, output);
+        ++thread->processed;
+        if(ret < 0) {
+            fprintf(stderr, "Error: failed to process file \"%s\" (line %d)\n", file, line);
+            ++thread->failed;
+        }
+    }
+
+    xmlSecAppWorkerCtxFinalize(&ctx);
+}
+
+static int
+xmlSecAppBatch(xmlSecAppCommand command, const char* filename) {
+    xmlSecAppBatchJob job;
+    xmlSecAppBatchThreadPtr threads = NULL;
+    int processed = 0;
+    int failed = 0;
+    int threadsNum;
+    int res = -1;
+    int ret, ii;
+
+    if((filename == NULL) || (gKeysMngr == NULL)) {
+        return(-1);
+    }
+    threadsNum = xmlSecAppGetThreadsNumber();
+    if(threadsNum <= 0) {
+        return(-1);
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.command = command;
+    if(strcmp(filename, "-") == 0) {
+        job.input = stdin;
+    } else {
+        job.input = fopen(filename, "r");
+        if(job.input == NULL) {
+            fprintf(stderr, "Error: failed to open file \"%s\"\n", filename);
+            goto done;
+        }
+    }
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        fprintf(stderr, "Error: failed to create mutex\n");
+        goto done;
+    }
+    threads = (xmlSecAppBatchThreadPtr)calloc(threadsNum, sizeof(xmlSecAppBatchThread));
+    if(threads == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        goto done;
+    }
+    for(ii = 0; ii < threadsNum; ++ii) {
+        threads[ii].job = &job;
+    }
+
+    /* the per operation stats are shared between threads */
+    if(threadsNum > 1) {
+        stats_mutex = xmlNewMutex();
+        if(stats_mutex == NULL) {
+            fprintf(stderr, "Error: failed to create mutex\n");
+            goto done;
+        }
+    }
+
+    ret = xmlSecAppRunThreads(xmlSecAppBatchRun, threads, sizeof(xmlSecAppBatchThread), threadsNum);
+    for(ii = 0; ii < threadsNum; ++ii) {
+        processed += threads[ii].processed;
+        failed += threads[ii].failed;
+    }
+    fprintf(stderr, "Processed %d files (%d failed)\n", processed, failed);
+    if((ret < 0) || (job.error != 0) || (failed > 0)) {
+        goto done;
+    }
+    res = 0;
+
+done:
+    if(stats_mutex != NULL) {
+        xmlFreeMutex(stats_mutex);
+        stats_mutex = NULL;
+    }
+    if(threads != NULL) {
+        free(threads);
+    }
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    if((job.input != NULL) && (job.input != stdin)) {
+        fclose(job.input);
+    }
+    return(res);
+}
+
+/****************************************************************
+ *
+ * Serve
+ *
+ * The keys are loaded once and the worker threads process the
+ * "<command> <file> [<output>]" request lines (the <command> is
+ * "sign", "verify", "encrypt" or "decrypt") received over a Unix
+ * socket or from stdin. Each request is answered with one
+ * "OK <file>" or "FAIL <file>" line. The "metrics <file>" request
+ * dumps the library metrics and the "shutdown" request stops the server.
+ *
+ * In the socket mode each worker accepts a connection and serves all
+ * its requests. In the stdin mode the workers share stdin and stdout
+ * thus the responses can come in a different order than the requests.
+ *
+ ***************************************************************/
+#define XMLSEC_APP_SERVE_BACKLOG        16
+
+typedef struct _xmlSecAppServeJob                               xmlSecAppServeJob,
+                                                                *xmlSecAppServeJobPtr;
+struct _xmlSecAppServeJob {
+    int                 listenFd;
+    int                 stop;
+    xmlMutexPtr         mutex;
+};
+
+typedef struct _xmlSecAppServeThread                            xmlSecAppServeThread,
+                                                                *xmlSecAppServeThreadPtr;
+struct _xmlSecAppServeThread {
+    xmlSecAppServeJobPtr job;
+    xmlSecAppWorkerCtx  ctx;
+    int                 processed;
+    int                 failed;
+};
+
+static void
+xmlSecAppServeStop(xmlSecAppServeJobPtr job) {
+    xmlMutexLock(job->mutex);
+    if(job->stop == 0) {
+        job->stop = 1;
+#ifdef XMLSEC_APP_UNIX_SOCKETS
+        /* wakes up the workers waiting in accept() */
+        if(job->listenFd >= 0) {
+            shutdown(job->listenFd, SHUT_RDWR);
+        }
+#endif /* XMLSEC_APP_UNIX_SOCKETS */
+    }
+    xmlMutexUnlock(job->mutex);
+}
+
+static int
+xmlSecAppServeDumpMetrics(const char* filename) {
+    FILE* f;
+    int ret;
+
+    f = fopen(filename, "w");
+    if(f == NULL) {
+        fprintf(stderr, "Error: failed to open file \"%s\"\n", filename);
+        return(-1);
+    }
+    ret = xmlSecMetricsDumpPrometheus(f);
+    if(fclose(f) != 0) {
+        ret = -1;
+    }
+    return(ret);
+}
+
+/*
+ * Serves the requests from @input until the end of it or the "shutdown"
+ * request. The @ioMutex (if any) guards @input and @output shared with
+ * the other workers.
+ */
+static void
+xmlSecAppServeConnection(xmlSecAppServeThreadPtr thread, FILE* input, FILE* output, xmlMutexPtr ioMutex) {
+    xmlSecAppServeJobPtr job = thread->job;
+    xmlSecAppCmdLineParamTopic topics;
+    xmlSecAppCommand command;
+    char buf[XMLSEC_APP_BATCH_LINE_SIZE];
+    char* words[3];
+    const char* status;
+    size_t len;
+    int num, ret;
+
+    while(1) {
+        if(ioMutex != NULL) {
+            xmlMutexLock(ioMutex);
+        }
+        ret = ((job->stop == 0) && (fgets(buf, sizeof(buf), input) != NULL)) ? 1 : 0;
+        if(ioMutex != NULL) {
+            xmlMutexUnlock(ioMutex);
+        }
+        if(ret == 0) {
+            break;
+        }
+
+        len = strlen(buf);
+        if((len > 0) && (buf[len - 1] != '\n') && (feof(input) == 0)) {
+            fprintf(stderr, "Error: the request is too long\n");
+            break;
+        }
+        num = xmlSecAppSplitLine(buf, words, 3);
+        if(num == 0) {
+            continue;
+        } else if((num == 1) && (strcmp(words[0], "shutdown") == 0)) {
+            xmlSecAppServeStop(job);
+            break;
+        }
+
+        if((num == 2) && (strcmp(words[0], "metrics") == 0)) {
+            ret = xmlSecAppServeDumpMetrics(words[1]);
+            command = xmlSecAppCommandUnknown;
+        } else {
+            command = (num >= 2) ? xmlSecAppParseCommand(words[0], &topics, NULL) : xmlSecAppCommandUnknown;
+            ret = (command == xmlSecAppCommandUnknown) ? -1 : 0;
+        }
+        switch(command) {
+        case xmlSecAppCommandSign:
+        case xmlSecAppCommandEncrypt:
+        case xmlSecAppCommandDecrypt:
+            /* the stdout is not available for the results */
+            ret = (num == 3) ? xmlSecAppWorkerCtxProcessFile(&(thread->ctx), command, words[1], words[2]) : -1;
+            break;
+        case xmlSecAppCommandVerify:
+            ret = xmlSecAppWorkerCtxProcessFile(&(thread->ctx), command, words[1], (num == 3) ? words[2] : NULL);
+            break;
+        default:
+            if(ret < 0) {
+                fprintf(stderr, "Error: invalid request \"%s\"\n", words[0]);
+            }
+            break;
+        }
+
+        ++thread->processed;
+        if(ret < 0) {
+            ++thread->failed;
+        }
+        status = (ret < 0) ? "FAIL" : "OK";
+
+        if(ioMutex != NULL) {
+            xmlMutexLock(ioMutex);
+        }
+        fprintf(output, "%s %s\n", status, (num >= 2) ? words[1] : words[0]);
+        fflush(output);
+        if(ioMutex != NULL) {
+            xmlMutexUnlock(ioMutex);
+        }
+    }
+}
+
+static void
+xmlSecAppServeRun(void* param) {
+    xmlSecAppServeThreadPtr thread = (xmlSecAppServeThreadPtr)param;
+    xmlSecAppServeJobPtr job = thread->job;
+
+    /* the contexts are created once for all the requests */
+    if(xmlSecAppWorkerCtxInitialize(&(thread->ctx), xmlSecAppCommandServe) < 0) {
+        xmlSecAppServeStop(job);
+        return;
+    }
+
+    if(job->listenFd < 0) {
+        xmlSecAppServeConnection(thread, stdin, stdout, job->mutex);
+    }
+#ifdef XMLSEC_APP_UNIX_SOCKETS
+    while(job->listenFd >= 0) {
+        FILE* input;
+        FILE* output;
+        int fd, fd2;
+
+        fd = accept(job->listenFd, NULL, NULL);
+        if(job->stop != 0) {
+            if(fd >= 0) {
+                close(fd);
+            }
+            break;
+        } else if(fd < 0) {
+            if((errno == EINTR) || (errno == ECONNABORTED)) {
+                continue;
+            }
+            fprintf(stderr, "Error: failed to accept connection (errno=%d)\n", errno);
+            xmlSecAppServeStop(job);
+            break;
+        }
+
+        fd2 = dup(fd);
+        input = fdopen(fd, "r");
+        output = (fd2 >= 0) ? fdopen(fd2, "w") : NULL;
+        if((input == NULL) || (output == NULL)) {
+            fprintf(stderr, "Error: failed to open connection streams\n");
+            if(input != NULL) {
+                fclose(input);
+            } else {
+                close(fd);
+            }
+            if(output != NULL) {
+                fclose(output);
+            } else if(fd2 >= 0) {
+                close(fd2);
+            }
+            continue;
+        }
+        xmlSecAppServeConnection(thread, input, output, NULL);
+        fclose(output);
+        fclose(input);
+    }
+#endif /* XMLSEC_APP_UNIX_SOCKETS */
+
+    xmlSecAppWorkerCtxFinalize(&(thread->ctx));
+}
+
+#ifdef XMLSEC_APP_UNIX_SOCKETS
+static int
+xmlSecAppServeListen(const char* path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path \"%s\" is too long\n", path);
+        return(-1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        fprintf(stderr, "Error: failed to create socket (errno=%d)\n", errno);
+        return(-1);
+    }
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Error: failed to bind socket \"%s\" (errno=%d)\n", path, errno);
+        close(fd);
+        return(-1);
+    }
+    if(listen(fd, XMLSEC_APP_SERVE_BACKLOG) < 0) {
+        fprintf(stderr, "Error: failed to listen on socket \"%s\" (errno=%d)\n", path, errno);
+        close(fd);
+        unlink(path);
+        return(-1);
+    }
+    return(fd);
+}
+#endif /* XMLSEC_APP_UNIX_SOCKETS */
+
+static int
+xmlSecAppServe(const char* path) {
+    xmlSecAppServeJob job;
+    xmlSecAppServeThreadPtr threads = NULL;
+    int processed = 0;
+    int failed = 0;
+    int threadsNum;
+    int res = -1;
+    int ret, ii;
+
+    if((path == NULL) || (gKeysMngr == NULL)) {
+        return(-1);
+    }
+    threadsNum = xmlSecAppGetThreadsNumber();
+    if(threadsNum <= 0) {
+        return(-1);
+    }
+
+    xmlSecMetricsSetEnabled(1);
+
+    memset(&job, 0, sizeof(job));
+    job.listenFd = -1;
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        fprintf(stderr, "Error: failed to create mutex\n");
+        goto done;
+    }
+    if(strcmp(path, "-") != 0) {
+#ifdef XMLSEC_APP_UNIX_SOCKETS
+        /* a client closing the connection early should not kill us */
+        signal(SIGPIPE, SIG_IGN);
+        job.listenFd = xmlSecAppServeListen(path);
+        if(job.listenFd < 0) {
+            goto done;
+        }
+#else /* XMLSEC_APP_UNIX_SOCKETS */
+        fprintf(stderr, "Error: sockets are not supported on this platform, use \"-\" for stdin\n");
+        goto done;
+#endif /* XMLSEC_APP_UNIX_SOCKETS */
+    }
+    threads = (xmlSecAppServeThreadPtr)calloc(threadsNum, sizeof(xmlSecAppServeThread));
+    if(threads == NULL) {
+        fprintf(stderr, "Error: failed to allocate memory\n");
+        goto done;
+    }
+    for(ii = 0; ii < threadsNum; ++ii) {
+        threads[ii].job = &job;
+    }
+
+    /* the per operation stats are shared between threads */
+    if(threadsNum > 1) {
+        stats_mutex = xmlNewMutex();
+        if(stats_mutex == NULL) {
+            fprintf(stderr, "Error: failed to create mutex\n");
+            goto done;
+        }
+    }
+
+    ret = xmlSecAppRunThreads(xmlSecAppServeRun, threads, sizeof(xmlSecAppServeThread), threadsNum);
+    for(ii = 0; ii < threadsNum; ++ii) {
+        processed += threads[ii].processed;
+        failed += threads[ii].failed;
+    }
+    fprintf(stderr, "Processed %d requests (%d failed)\n", processed, failed);
+    if(ret < 0) {
+        goto done;
+    }
+    res = 0;
+
+done:
+    if(stats_mutex != NULL) {
+        xmlFreeMutex(stats_mutex);
+        stats_mutex = NULL;
+    }
+    if(threads != NULL) {
+        free(threads);
+    }
+#ifdef XMLSEC_APP_UNIX_SOCKETS
+    if(job.listenFd >= 0) {
+        close(job.listenFd);
+        unlink(path);
+    }
+#endif /* XMLSEC_APP_UNIX_SOCKETS */
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    return(res);
+}
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
+static void 
+xmlSecAppListKeyData(void) {
+    fprintf(stdout, "Registered key data klasses:\n");
+    xmlSecKeyDataIdListDebugDump(xmlSecKeyDataIdsGet(), stdout);
+}
+
+static int 
+xmlSecAppCheckKeyData(const char * name) {
+    if(xmlSecKeyDataIdListFindByName(xmlSecKeyDataIdsGet(), BAD_CAST name, xmlSecKeyDataUsageAny) == xmlSecKeyDataIdUnknown) {
+        return -1;
+    }
+    return 0;
+}
+
+static void 
+xmlSecAppListTransforms(void) {
+    fprintf(stdout, "Registered transform klasses:\n");
+    xmlSecTransformIdListDebugDump(xmlSecTransformIdsGet(), stdout);
+}
+
+static int 
+xmlSecAppCheckTransform(const char * name) {
     if(xmlSecTransformIdListFindByName(xmlSecTransformIdsGet(), BAD_CAST name, xmlSecTransformUsageAny) == xmlSecTransformIdUnknown) {
         return -1;
     }
@@ -1868,6 +3827,13 @@ xmlSecAppPrepareKeyInfoReadCtx(xmlSecKeyInfoCtxPtr keyInfoCtx) {
     if(xmlSecAppCmdLineParamIsSet(&X509SkipStrictChecksParam)) {
         keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_SKIP_STRICT_CHECKS;
     }
+    if(xmlSecAppCmdLineParamIsSet(&X509OcspParam)) {
+        keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK;
+    }
+    if(xmlSecAppCmdLineParamIsSet(&X509OcspFetchParam)) {
+        keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK;
+        keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_FETCH;
+    }
     if(xmlSecAppCmdLineParamIsSet(&X509DontVerifyCerts)) {
         keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
     }
@@ -2203,6 +4169,20 @@ xmlSecAppLoadKeys(void) {
         }
     }
 
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING)
+    /* read all stapled OCSP responses */
+    for(value = X509OcspResponseParam.value; value != NULL; value = value->next) {
+        if(value->strValue == NULL) {
+            fprintf(stderr, "Error: invalid value for option \"%s\".\n", X509OcspResponseParam.fullName);
+            return(-1);
+        } else if(xmlSecAppCryptoSimpleKeysMngrOcspResponseLoad(gKeysMngr, value->strValue) < 0) {
+            fprintf(stderr, "Error: failed to load OCSP response from \"%s\".\n",
+                    value->strValue);
+            return(-1);
+        }
+    }
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_CRYPTO_DYNAMIC_LOADING) */
+
 #endif /* XMLSEC_NO_X509 */    
 
     return(0);
@@ -2269,6 +4249,12 @@ xmlSecAppInit(void) {
         fprintf(stderr, "Error: xmlsec crypto intialization failed.\n");
         return(-1);
     }
+
+    /* nothing is registered after this point */
+    if(xmlSecRegistriesFreeze() < 0) {
+        fprintf(stderr, "Error: xmlsec registries freeze failed.\n");
+        return(-1);
+    }
     return(0);
 }
 
@@ -2594,7 +4580,8 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
                         xmlSecAppCmdLineTopicDSigCommon |
                         xmlSecAppCmdLineTopicDSigSign |
                         xmlSecAppCmdLineTopicKeysMngr |
-                        xmlSecAppCmdLineTopicX509Certs;
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicBatch;
         return(xmlSecAppCommandSign);
     } else 
     
@@ -2605,7 +4592,8 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
                         xmlSecAppCmdLineTopicDSigCommon |
                         xmlSecAppCmdLineTopicDSigVerify |
                         xmlSecAppCmdLineTopicKeysMngr |
-                        xmlSecAppCmdLineTopicX509Certs;
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicBatch;
         return(xmlSecAppCommandVerify);
     } else 
 #ifndef XMLSEC_NO_TMPL_TEST
@@ -2631,7 +4619,8 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
                         xmlSecAppCmdLineTopicEncCommon |
                         xmlSecAppCmdLineTopicEncEncrypt |
                         xmlSecAppCmdLineTopicKeysMngr |
-                        xmlSecAppCmdLineTopicX509Certs;
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicBatch;
         return(xmlSecAppCommandEncrypt);
     } else 
 
@@ -2642,7 +4631,8 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
                         xmlSecAppCmdLineTopicEncCommon |
                         xmlSecAppCmdLineTopicEncDecrypt |
                         xmlSecAppCmdLineTopicKeysMngr |
-                        xmlSecAppCmdLineTopicX509Certs;
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicBatch;
         return(xmlSecAppCommandDecrypt);
     } else 
 
@@ -2660,6 +4650,40 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
 #endif /* XMLSEC_NO_TMPL_TEST */
 #endif /* XMLSEC_NO_XMLENC */
 
+#if !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC)
+    if((strcmp(cmd, "bench") == 0) || (strcmp(cmd, "--bench") == 0)) {
+        (*cmdLineTopics) = 
+                        xmlSecAppCmdLineTopicGeneral |
+                        xmlSecAppCmdLineTopicCryptoConfig |
+                        xmlSecAppCmdLineTopicDSigCommon |
+                        xmlSecAppCmdLineTopicDSigSign |
+                        xmlSecAppCmdLineTopicDSigVerify |
+                        xmlSecAppCmdLineTopicEncCommon |
+                        xmlSecAppCmdLineTopicEncEncrypt |
+                        xmlSecAppCmdLineTopicEncDecrypt |
+                        xmlSecAppCmdLineTopicKeysMngr |
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicBench;
+        return(xmlSecAppCommandBench);
+    } else 
+
+    if((strcmp(cmd, "serve") == 0) || (strcmp(cmd, "--serve") == 0)) {
+        (*cmdLineTopics) = 
+                        xmlSecAppCmdLineTopicGeneral |
+                        xmlSecAppCmdLineTopicCryptoConfig |
+                        xmlSecAppCmdLineTopicDSigCommon |
+                        xmlSecAppCmdLineTopicDSigSign |
+                        xmlSecAppCmdLineTopicDSigVerify |
+                        xmlSecAppCmdLineTopicEncCommon |
+                        xmlSecAppCmdLineTopicEncEncrypt |
+                        xmlSecAppCmdLineTopicEncDecrypt |
+                        xmlSecAppCmdLineTopicKeysMngr |
+                        xmlSecAppCmdLineTopicX509Certs |
+                        xmlSecAppCmdLineTopicServe;
+        return(xmlSecAppCommandServe);
+    } else 
+#endif /* !defined(XMLSEC_NO_XMLDSIG) || !defined(XMLSEC_NO_XMLENC) */
+
     if(1) {
         (*cmdLineTopics) = 0;
         return(xmlSecAppCommandUnknown);
@@ -2709,6 +4733,12 @@ xmlSecAppPrintHelp(xmlSecAppCommand command, xmlSecAppCmdLineParamTopic topics)
     case xmlSecAppCommandEncryptTmpl:
         fprintf(stdout, "%s\n", helpEncryptTmpl);
         break;
+    case xmlSecAppCommandBench:
+        fprintf(stdout, "%s\n", helpBench);
+        break;
+    case xmlSecAppCommandServe:
+        fprintf(stdout, "%s\n", helpServe);
+        break;
     }
     if(topics != 0) {
         fprintf(stdout, "Options:\n");
@@ -2766,11 +4796,28 @@ xmlSecAppCloseFile(FILE* file) {
     fclose(file);
 }
 
+static void
+xmlSecAppAddTime(clock_t start_time) {
+    clock_t op_time;
+
+    op_time = clock() - start_time;
+    if(stats_mutex != NULL) {
+        xmlMutexLock(stats_mutex);
+    }
+    total_time += op_time;
+    if(timings_file != NULL) {
+        fprintf(timings_file, "%ld\n", (long)(((double)op_time * 1000000) / CLOCKS_PER_SEC));
+    }
+    if(stats_mutex != NULL) {
+        xmlMutexUnlock(stats_mutex);
+    }
+}
+
 static int 
-xmlSecAppWriteResult(xmlDocPtr doc, xmlSecBufferPtr buffer) {
+xmlSecAppWriteResult(const char* output, xmlDocPtr doc, xmlSecBufferPtr buffer) {
     FILE* f;
 
-    f = xmlSecAppOpenFile(xmlSecAppCmdLineParamGetString(&outputParam));
+    f = xmlSecAppOpenFile(output);
     if(f == NULL) {
         return(-1);
     }
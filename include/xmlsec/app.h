@@ -72,6 +72,20 @@ XMLSEC_EXPORT xmlSecKeyDataId                   xmlSecKeyDataDsaGetKlass
  */
 #define xmlSecKeyDataEcdsaId                    xmlSecKeyDataEcdsaGetKlass()
 XMLSEC_EXPORT xmlSecKeyDataId                   xmlSecKeyDataEcdsaGetKlass      (void);
+/**
+ * xmlSecKeyDataEd25519Id:
+ *
+ * The Ed25519 key klass.
+ */
+#define xmlSecKeyDataEd25519Id                  xmlSecKeyDataEd25519GetKlass()
+XMLSEC_EXPORT xmlSecKeyDataId                   xmlSecKeyDataEd25519GetKlass    (void);
+/**
+ * xmlSecKeyDataEd448Id:
+ *
+ * The Ed448 key klass.
+ */
+#define xmlSecKeyDataEd448Id                    xmlSecKeyDataEd448GetKlass()
+XMLSEC_EXPORT xmlSecKeyDataId                   xmlSecKeyDataEd448GetKlass      (void);
 /**
  * xmlSecKeyDataGost2001Id:
  *
@@ -161,6 +175,27 @@ XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformAes192CbcGetKlass
  */
 #define xmlSecTransformAes256CbcId              xmlSecTransformAes256CbcGetKlass()
 XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformAes256CbcGetKlass(void);
+/**
+ * xmlSecTransformAes128GcmId:
+ *
+ * The AES128 GCM cipher transform klass.
+ */
+#define xmlSecTransformAes128GcmId              xmlSecTransformAes128GcmGetKlass()
+XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformAes128GcmGetKlass(void);
+/**
+ * xmlSecTransformAes192GcmId:
+ *
+ * The AES192 GCM cipher transform klass.
+ */
+#define xmlSecTransformAes192GcmId              xmlSecTransformAes192GcmGetKlass()
+XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformAes192GcmGetKlass(void);
+/**
+ * xmlSecTransformAes256GcmId:
+ *
+ * The AES256 GCM cipher transform klass.
+ */
+#define xmlSecTransformAes256GcmId              xmlSecTransformAes256GcmGetKlass()
+XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformAes256GcmGetKlass(void);
 /**
  * xmlSecTransformKWAes128Id:
  *
@@ -246,6 +281,21 @@ XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformEcdsaSha384GetKla
 #define xmlSecTransformEcdsaSha512Id            xmlSecTransformEcdsaSha512GetKlass()
 XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformEcdsaSha512GetKlass  (void);
 
+/**
+ * xmlSecTransformEd25519Id:
+ *
+ * The EdDSA Ed25519 signature transform klass.
+ */
+#define xmlSecTransformEd25519Id                xmlSecTransformEd25519GetKlass()
+XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformEd25519GetKlass  (void);
+/**
+ * xmlSecTransformEd448Id:
+ *
+ * The EdDSA Ed448 signature transform klass.
+ */
+#define xmlSecTransformEd448Id                  xmlSecTransformEd448GetKlass()
+XMLSEC_EXPORT xmlSecTransformId                 xmlSecTransformEd448GetKlass    (void);
+
 /**
  * xmlSecTransformGost2001GostR3411_94Id:
  *
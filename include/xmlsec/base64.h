@@ -58,6 +58,10 @@ XMLSEC_EXPORT xmlChar*          xmlSecBase64Encode              (const xmlSecByt
 XMLSEC_EXPORT int               xmlSecBase64Decode              (const xmlChar* str,
                                                                  xmlSecByte *buf,
                                                                  xmlSecSize len);
+XMLSEC_EXPORT int               xmlSecBase64NodeContentDecode   (xmlNodePtr node,
+                                                                 xmlSecByte *buf,
+                                                                 xmlSecSize len,
+                                                                 xmlSecSize* written);
 
 #ifdef __cplusplus
 }
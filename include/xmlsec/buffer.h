@@ -20,6 +20,8 @@ extern "C" {
 
 typedef struct _xmlSecBuffer                                    xmlSecBuffer,
                                                                 *xmlSecBufferPtr;
+typedef struct _xmlSecBufferMemCounter                          xmlSecBufferMemCounter,
+                                                                *xmlSecBufferMemCounterPtr;
 
 
 /**
@@ -28,12 +30,17 @@ typedef struct _xmlSecBuffer                                    xmlSecBuffer,
  *                              allocated memory size.
  * @xmlSecAllocModeDouble:      the memory allocation mode that tries to minimize
  *                              the number of malloc calls.
+ * @xmlSecAllocModeOffset:      same as @xmlSecAllocModeDouble but removing data
+ *                              from the beginning of a buffer only moves the
+ *                              data pointer (for buffers consumed from the head,
+ *                              @xmlSecList treats it as @xmlSecAllocModeDouble).
  *
  * The memory allocation mode (used by @xmlSecBuffer and @xmlSecList).
  */
 typedef enum {
     xmlSecAllocModeExact = 0,
-    xmlSecAllocModeDouble
+    xmlSecAllocModeDouble,
+    xmlSecAllocModeOffset
 } xmlSecAllocMode;
 
 /*****************************************************************************
@@ -42,20 +49,48 @@ typedef enum {
  *
  ****************************************************************************/
 
+/**
+ * xmlSecBufferMemCounter:
+ * @size: the memory currently allocated by the buffers.
+ * @peakSize: the maximum of @size.
+ * @maxSize: the memory limit for the buffers (0 means no limit).
+ *
+ * The memory allocated by a group of buffers (for example, all the
+ * buffers of a transforms chain). A buffer that would grow the @size
+ * above @maxSize fails with #XMLSEC_ERRORS_R_LIMIT_EXCEEDED error
+ * (see #xmlSecBufferSetMemCounter).
+ */
+struct _xmlSecBufferMemCounter {
+    xmlSecSize          size;
+    xmlSecSize          peakSize;
+    xmlSecSize          maxSize;
+};
+
 /**
  * xmlSecBuffer:
  * @data: the pointer to buffer data.
  * @size: the current data size.
  * @maxSize: the max data size (allocated buffer size).
  * @allocMode: the buffer memory allocation mode.
+ * @offset: the offset of @data from the beginning of the allocated memory
+ *          (#xmlSecAllocModeOffset only).
+ * @memCounter: the memory counter this buffer allocations are charged to
+ *          (may be NULL).
+ * @inlineData: the storage owned by the buffer's owner used before any
+ *          heap allocation (may be NULL, see #xmlSecBufferSetInlineStorage).
+ * @inlineSize: the @inlineData size.
  *
  * Binary data buffer.
  */
 struct _xmlSecBuffer {
-    xmlSecByte*         data;
-    xmlSecSize          size;
-    xmlSecSize          maxSize;
-    xmlSecAllocMode     allocMode;
+    xmlSecByte*                 data;
+    xmlSecSize                  size;
+    xmlSecSize                  maxSize;
+    xmlSecAllocMode             allocMode;
+    xmlSecSize                  offset;
+    xmlSecBufferMemCounterPtr   memCounter;
+    xmlSecByte*                 inlineData;
+    xmlSecSize                  inlineSize;
 };
 
 XMLSEC_EXPORT void              xmlSecBufferSetDefaultAllocMode (xmlSecAllocMode defAllocMode,
@@ -77,6 +112,13 @@ XMLSEC_EXPORT xmlSecSize        xmlSecBufferGetMaxSize          (xmlSecBufferPtr
 XMLSEC_EXPORT int               xmlSecBufferSetMaxSize          (xmlSecBufferPtr buf,
                                                                  xmlSecSize size);
 XMLSEC_EXPORT void              xmlSecBufferEmpty               (xmlSecBufferPtr buf);
+XMLSEC_EXPORT int               xmlSecBufferSwap                (xmlSecBufferPtr buf1,
+                                                                 xmlSecBufferPtr buf2);
+XMLSEC_EXPORT int               xmlSecBufferSetInlineStorage    (xmlSecBufferPtr buf,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize size);
+XMLSEC_EXPORT void              xmlSecBufferSetMemCounter       (xmlSecBufferPtr buf,
+                                                                 xmlSecBufferMemCounterPtr memCounter);
 XMLSEC_EXPORT int               xmlSecBufferAppend              (xmlSecBufferPtr buf,
                                                                  const xmlSecByte* data,
                                                                  xmlSecSize size);
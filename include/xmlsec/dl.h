@@ -10,6 +10,9 @@
 #ifndef __XMLSEC_DL_H__
 #define __XMLSEC_DL_H__
 
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/list.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -19,6 +22,10 @@ typedef struct _xmlSecCryptoDLFunctions         xmlSecCryptoDLFunctions,
 
 XMLSEC_EXPORT int                               xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms
                                                                             (xmlSecCryptoDLFunctionsPtr functions);
+XMLSEC_EXPORT int                               xmlSecCryptoDLFunctionsAddKeyDataAndTransforms
+                                                                            (xmlSecCryptoDLFunctionsPtr functions,
+                                                                             xmlSecPtrListPtr keyDataIds,
+                                                                             xmlSecPtrListPtr transformIds);
 
 #ifndef XMLSEC_NO_CRYPTO_DYNAMIC_LOADING
 
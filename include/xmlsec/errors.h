@@ -359,6 +359,14 @@ extern "C" {
  */
 #define XMLSEC_ERRORS_R_DSIG_INVALID_REFERENCE          82
 
+/**
+ * XMLSEC_ERRORS_R_LIMIT_EXCEEDED:
+ *
+ * The processing limit (references number, transforms number,
+ * digested data size, XPath operations, ...) exceeded.
+ */
+#define XMLSEC_ERRORS_R_LIMIT_EXCEEDED                  91
+
 /**
  * XMLSEC_ERRORS_R_ASSERTION:
  *
@@ -417,6 +425,106 @@ XMLSEC_EXPORT void              xmlSecErrorsDefaultCallbackEnableOutput
 XMLSEC_EXPORT int               xmlSecErrorsGetCode             (xmlSecSize pos);
 XMLSEC_EXPORT const char*       xmlSecErrorsGetMsg              (xmlSecSize pos);
 
+/**
+ * xmlSecErrorRecord:
+ * @file:               the error location file name (__FILE__ macro).
+ * @line:               the error location line number (__LINE__ macro).
+ * @func:               the error location function name (__func__ macro).
+ * @errorObject:        the error specific error object.
+ * @errorSubject:       the error specific error subject.
+ * @reason:             the error code.
+ * @msgFormat:          the additional error message in printf format (not
+ *                      formatted, use #xmlSecErrorRecordGetMsg).
+ * @msgArgs:            the @msgFormat arguments (private).
+ * @msg:                the formatted message buffer (private).
+ * @msgSize:            the @msg buffer size (private).
+ * @msgReady:           the flag: 1 if @msg is formatted (private).
+ *
+ * The error record passed to the #xmlSecErrorsRecordCallback. The record
+ * (including the error message) is only valid during the callback call.
+ */
+typedef struct _xmlSecErrorRecord                       xmlSecErrorRecord, *xmlSecErrorRecordPtr;
+struct _xmlSecErrorRecord {
+    const char*         file;
+    int                 line;
+    const char*         func;
+    const char*         errorObject;
+    const char*         errorSubject;
+    int                 reason;
+    const char*         msgFormat;
+
+    /* private */
+    void*               msgArgs;
+    xmlChar*            msg;
+    xmlSecSize          msgSize;
+    int                 msgReady;
+};
+
+/**
+ * xmlSecErrorsRecordCallback:
+ * @record:             the error record.
+ *
+ * The structured errors reporting callback function. The error message
+ * is formatted only if the callback calls #xmlSecErrorRecordGetMsg.
+ */
+typedef void (*xmlSecErrorsRecordCallback)                      (xmlSecErrorRecordPtr record);
+
+XMLSEC_EXPORT void              xmlSecErrorsSetRecordCallback   (xmlSecErrorsRecordCallback callback);
+XMLSEC_EXPORT const xmlChar*    xmlSecErrorRecordGetMsg         (xmlSecErrorRecordPtr record);
+
+/**
+ * XMLSEC_ERRORS_STACK_SIZE:
+ *
+ * The max number of errors kept in the per-thread errors stack.
+ */
+#define XMLSEC_ERRORS_STACK_SIZE                        32
+
+/**
+ * XMLSEC_ERRORS_STACK_STRING_SIZE:
+ *
+ * The max length (including the trailing zero) of the error object
+ * and error subject strings kept in the per-thread errors stack.
+ */
+#define XMLSEC_ERRORS_STACK_STRING_SIZE                 128
+
+/**
+ * XMLSEC_ERRORS_STACK_MSG_SIZE:
+ *
+ * The max length (including the trailing zero) of the error message
+ * kept in the per-thread errors stack.
+ */
+#define XMLSEC_ERRORS_STACK_MSG_SIZE                    256
+
+/**
+ * xmlSecErrorsStackItem:
+ * @file:               the error location file name (__FILE__ macro).
+ * @line:               the error location line number (__LINE__ macro).
+ * @func:               the error location function name (__func__ macro).
+ * @reason:             the error code.
+ * @errorObject:        the error specific error object.
+ * @errorSubject:       the error specific error subject.
+ * @msg:                the error message.
+ *
+ * The error collected in the per-thread errors stack.
+ */
+typedef struct _xmlSecErrorsStackItem                   xmlSecErrorsStackItem, *xmlSecErrorsStackItemPtr;
+struct _xmlSecErrorsStackItem {
+    const char*         file;
+    int                 line;
+    const char*         func;
+    int                 reason;
+    char                errorObject[XMLSEC_ERRORS_STACK_STRING_SIZE];
+    char                errorSubject[XMLSEC_ERRORS_STACK_STRING_SIZE];
+    xmlChar             msg[XMLSEC_ERRORS_STACK_MSG_SIZE];
+};
+
+XMLSEC_EXPORT int               xmlSecErrorsStackStart          (void);
+XMLSEC_EXPORT void              xmlSecErrorsStackStop           (void);
+XMLSEC_EXPORT void              xmlSecErrorsStackClear          (void);
+XMLSEC_EXPORT xmlSecSize        xmlSecErrorsStackGetSize        (void);
+XMLSEC_EXPORT xmlSecSize        xmlSecErrorsStackGetDropped     (void);
+XMLSEC_EXPORT xmlSecErrorsStackItemPtr xmlSecErrorsStackGetItem (xmlSecSize pos);
+
 
 
 /* __FUNCTION__ is defined for MSC compiler < MS VS .NET 2003 */
@@ -0,0 +1,65 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Parallel tasks executor.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_EXECUTOR_H__
+#define __XMLSEC_EXECUTOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <xmlsec/xmlsec.h>
+
+/**
+ * xmlSecExecutorTaskMethod:
+ * @data:               the task data.
+ *
+ * Runs one task of a parallel stage (e.g. one of the workers of
+ * #xmlSecDSigCtxVerifyParallel).
+ */
+typedef void            (*xmlSecExecutorTaskMethod)     (void* data);
+
+/**
+ * xmlSecExecutorRunCallback:
+ * @task:               the task method.
+ * @tasksData:          the array of @tasksNumber tasks data.
+ * @tasksNumber:        the number of tasks.
+ * @userData:           the data registered with #xmlSecExecutorSetCallback.
+ *
+ * Calls @task for every element of @tasksData, concurrently if possible,
+ * and returns after all these calls are finished. The tasks of a stage take
+ * the work items from a queue shared between them: running some of the tasks
+ * one after another in the current thread (or not running them at all)
+ * is slower but correct as long as at least one task runs.
+ *
+ * Returns: 0 on success or a negative value if none of the tasks could be run.
+ */
+typedef int             (*xmlSecExecutorRunCallback)    (xmlSecExecutorTaskMethod task,
+                                                         void** tasksData,
+                                                         xmlSecSize tasksNumber,
+                                                         void* userData);
+
+XMLSEC_EXPORT void              xmlSecExecutorSetCallback       (xmlSecExecutorRunCallback callback,
+                                                                 xmlSecSize threadsNumber,
+                                                                 void* userData);
+XMLSEC_EXPORT xmlSecSize        xmlSecExecutorGetThreadsNumber  (void);
+XMLSEC_EXPORT int               xmlSecExecutorRun               (xmlSecExecutorTaskMethod task,
+                                                                 void** tasksData,
+                                                                 xmlSecSize tasksNumber);
+XMLSEC_EXPORT int               xmlSecExecutorDefaultRunCallback(xmlSecExecutorTaskMethod task,
+                                                                 void** tasksData,
+                                                                 xmlSecSize tasksNumber,
+                                                                 void* userData);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_EXECUTOR_H__ */
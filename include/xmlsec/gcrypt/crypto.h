@@ -31,6 +31,9 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecGCryptShutdown            (void);
 XMLSEC_CRYPTO_EXPORT int                xmlSecGCryptKeysMngrInit        (xmlSecKeysMngrPtr mngr);
 XMLSEC_CRYPTO_EXPORT int                xmlSecGCryptGenerateRandom      (xmlSecBufferPtr buffer,
                                                                          xmlSecSize size);
+XMLSEC_CRYPTO_EXPORT int                xmlSecGCryptGenerateRandomBytes (xmlSecByte* out,
+                                                                         xmlSecSize outSize,
+                                                                         void* context);
 
 
 /********************************************************************
@@ -29,6 +29,92 @@ XMLSEC_EXPORT int       xmlSecIORegisterCallbacks               (xmlInputMatchCa
                                                                  xmlInputOpenCallback openFunc,
                                                                  xmlInputReadCallback readFunc,
                                                                  xmlInputCloseCallback closeFunc);
+XMLSEC_EXPORT int       xmlSecIOCallbacksFreeze                 (void);
+XMLSEC_EXPORT int       xmlSecIOCallbacksIsFrozen               (void);
+
+/********************************************************************
+ *
+ * Caching input I/O callbacks
+ *
+ *******************************************************************/
+XMLSEC_EXPORT int       xmlSecIOCacheSetLimits                  (xmlSecSize maxEntries,
+                                                                 xmlSecSize maxSize,
+                                                                 xmlSecSize maxAge);
+XMLSEC_EXPORT void      xmlSecIOCacheFlush                      (void);
+XMLSEC_EXPORT int       xmlSecIOCacheMatch                      (const char* uri);
+XMLSEC_EXPORT void*     xmlSecIOCacheOpen                       (const char* uri);
+XMLSEC_EXPORT int       xmlSecIOCacheRead                       (void* context,
+                                                                 char* buffer,
+                                                                 int len);
+XMLSEC_EXPORT int       xmlSecIOCacheClose                      (void* context);
+
+/********************************************************************
+ *
+ * Attachments (cid: URIs)
+ *
+ *******************************************************************/
+/**
+ * xmlSecAttachmentOpenCallback:
+ * @userData:           the resolver's user data.
+ * @cid:                the attachment Content-ID (the "cid:" URI without
+ *                      the scheme, unescaped).
+ *
+ * Opens the attachment for reading.
+ *
+ * Returns: the attachment reading context or NULL if the attachment is
+ * not found or an error occurs.
+ */
+typedef void*           (*xmlSecAttachmentOpenCallback)         (void* userData,
+                                                                 const xmlChar* cid);
+
+/**
+ * xmlSecAttachmentReadCallback:
+ * @attachment:         the attachment reading context.
+ * @data:               the buffer for the data.
+ * @maxDataSize:        the buffer size.
+ * @dataSize:           the pointer to the size of the data read (0 at the
+ *                      end of the attachment).
+ *
+ * Reads the next chunk of the attachment content. The callback may
+ * parse the MIME part and decode its content on the fly; the data is
+ * digested as it is returned and never buffered as a whole.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+typedef int             (*xmlSecAttachmentReadCallback)         (void* attachment,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize maxDataSize,
+                                                                 xmlSecSize* dataSize);
+
+/**
+ * xmlSecAttachmentCloseCallback:
+ * @attachment:         the attachment reading context.
+ *
+ * Closes the attachment opened with #xmlSecAttachmentOpenCallback.
+ */
+typedef void            (*xmlSecAttachmentCloseCallback)        (void* attachment);
+
+/**
+ * xmlSecAttachmentResolver:
+ * @openCallback:       the attachment open callback.
+ * @readCallback:       the attachment read callback.
+ * @closeCallback:      the attachment close callback (may be NULL).
+ * @userData:           the user data passed to @openCallback.
+ *
+ * Resolves the "cid:" URIs (SOAP with Attachments, AS4) of the transforms
+ * chain (see #xmlSecTransformCtxSetAttachmentResolver). With
+ * #XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES the attachments are read and
+ * digested in parallel, so the callbacks must allow different
+ * attachments to be read from different threads.
+ */
+struct _xmlSecAttachmentResolver {
+    xmlSecAttachmentOpenCallback        openCallback;
+    xmlSecAttachmentReadCallback        readCallback;
+    xmlSecAttachmentCloseCallback       closeCallback;
+    void*                               userData;
+};
+
+XMLSEC_EXPORT int       xmlSecAttachmentUriCheck                (const xmlChar* uri);
 
 /********************************************************************
  *
@@ -45,7 +131,13 @@ XMLSEC_EXPORT int       xmlSecIORegisterCallbacks               (xmlInputMatchCa
 XMLSEC_EXPORT xmlSecTransformId xmlSecTransformInputURIGetKlass (void);
 XMLSEC_EXPORT int       xmlSecTransformInputURIOpen             (xmlSecTransformPtr transform,
                                                                  const xmlChar* uri);
+XMLSEC_EXPORT int       xmlSecTransformInputURIOpenAttachment   (xmlSecTransformPtr transform,
+                                                                 xmlSecAttachmentResolverPtr resolver,
+                                                                 const xmlChar* uri);
 XMLSEC_EXPORT int       xmlSecTransformInputURIClose            (xmlSecTransformPtr transform);
+XMLSEC_EXPORT int       xmlSecTransformInputURIGetMappedData    (xmlSecTransformPtr transform,
+                                                                 const xmlSecByte** data,
+                                                                 xmlSecSize* dataSize);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,43 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Pre-generated keys pool.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_KEYGENPOOL_H__
+#define __XMLSEC_KEYGENPOOL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysdata.h>
+
+/**
+ * XMLSEC_KEYGEN_POOL_MAX_ENTRIES:
+ *
+ * The max number of different key klass, size and type combinations
+ * pre-generated by the keys pool.
+ */
+#define XMLSEC_KEYGEN_POOL_MAX_ENTRIES          16
+
+XMLSEC_EXPORT int               xmlSecKeyGenPoolStart           (xmlSecKeyDataId dataId,
+                                                                 xmlSecSize sizeBits,
+                                                                 xmlSecKeyDataType type,
+                                                                 xmlSecSize poolSize);
+XMLSEC_EXPORT void              xmlSecKeyGenPoolStop            (void);
+XMLSEC_EXPORT xmlSecSize        xmlSecKeyGenPoolGetSize         (xmlSecKeyDataId dataId,
+                                                                 xmlSecSize sizeBits,
+                                                                 xmlSecKeyDataType type);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_KEYGENPOOL_H__ */
@@ -154,6 +154,36 @@ typedef enum {
  */
 #define XMLSEC_KEYINFO_FLAGS_X509DATA_SKIP_STRICT_CHECKS        0x00004000
 
+/**
+ * XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK:
+ *
+ * If the flag is set then the revocation status of the verified certificates
+ * chain is checked with the OCSP responses added to the keys store (see
+ * also XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_FETCH). A certificate without a
+ * "good" status is considered invalid. Only OpenSSL supports this flag.
+ */
+#define XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK                0x00008000
+
+/**
+ * XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_FETCH:
+ *
+ * If the flag is set (together with XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK)
+ * then the missing OCSP responses are requested from the OCSP responders
+ * listed in the certificates using the registered I/O callbacks.
+ */
+#define XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_FETCH                0x00010000
+
+/**
+ * XMLSEC_KEYINFO_FLAGS_ENCKEY_MATCH_RECIPIENT:
+ *
+ * If the flag is set then an <enc:EncryptedKey/> element is decrypted only
+ * if the key found for it matches the element's Recipient attribute and
+ * <dsig:KeyName/>, <dsig:X509SerialNumber/> and <dsig:X509SKI/> elements
+ * in its <dsig:KeyInfo/> node. The identifiers missing from the key (e.g.
+ * the key has no name) are not checked.
+ */
+#define XMLSEC_KEYINFO_FLAGS_ENCKEY_MATCH_RECIPIENT             0x00020000
+
 /**
  * xmlSecKeyInfoCtx:
  * @userData:           the pointer to user data (xmlsec and xmlsec-crypto
@@ -173,6 +173,13 @@ XMLSEC_EXPORT void      xmlSecKeyReqDebugXmlDump                (xmlSecKeyReqPtr
  * @usage:              the key usage.
  * @notValidBefore:     the start key validity interval.
  * @notValidAfter:      the end key validity interval.
+ * @refs:               the references counter of a shared key (0 if the key
+ *                      is not shared, see #xmlSecKeyShare).
+ * @useWithList:        the applications/identifiers the key is restricted to
+ *                      (NULL if the key can be used with any application).
+ * @valueType:          the key value type cached by #xmlSecKeyShare
+ *                      (#xmlSecKeyDataTypeUnknown if not known).
+ * @valueSize:          the key value size cached by #xmlSecKeyShare.
  *
  * The key.
  */
@@ -183,6 +190,10 @@ struct _xmlSecKey {
     xmlSecKeyUsage                      usage;
     time_t                              notValidBefore;
     time_t                              notValidAfter;
+    long                                refs;
+    xmlSecPtrListPtr                    useWithList;
+    xmlSecKeyDataType                   valueType;
+    xmlSecSize                          valueSize;
 };
 
 XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyCreate         (void);
@@ -191,6 +202,8 @@ XMLSEC_EXPORT void              xmlSecKeyEmpty          (xmlSecKeyPtr key);
 XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyDuplicate      (xmlSecKeyPtr key);
 XMLSEC_EXPORT int               xmlSecKeyCopy           (xmlSecKeyPtr keyDst,
                                                          xmlSecKeyPtr keySrc);
+XMLSEC_EXPORT int               xmlSecKeyShare          (xmlSecKeyPtr key);
+XMLSEC_EXPORT int               xmlSecKeyIsShared       (xmlSecKeyPtr key);
 
 XMLSEC_EXPORT const xmlChar*    xmlSecKeyGetName        (xmlSecKeyPtr key);
 XMLSEC_EXPORT int               xmlSecKeySetName        (xmlSecKeyPtr key,
@@ -209,6 +222,11 @@ XMLSEC_EXPORT xmlSecKeyDataPtr  xmlSecKeyEnsureData     (xmlSecKeyPtr key,
 XMLSEC_EXPORT int               xmlSecKeyAdoptData      (xmlSecKeyPtr key,
                                                          xmlSecKeyDataPtr data);
 
+XMLSEC_EXPORT int               xmlSecKeyAddUseWith     (xmlSecKeyPtr key,
+                                                         const xmlChar* application,
+                                                         const xmlChar* identifier);
+XMLSEC_EXPORT xmlSecPtrListPtr  xmlSecKeyGetUseWithList (xmlSecKeyPtr key);
+
 XMLSEC_EXPORT void              xmlSecKeyDebugDump      (xmlSecKeyPtr key,
                                                          FILE *output);
 XMLSEC_EXPORT void              xmlSecKeyDebugXmlDump   (xmlSecKeyPtr key,
@@ -97,6 +97,14 @@ typedef unsigned int                                    xmlSecKeyDataUsage;
  */
 #define xmlSecKeyDataUsageRetrievalMethodNodeBin        0x00020
 
+/**
+ * xmlSecKeyDataUsageReadFromFile:
+ *
+ * The key data could be read from a file (PEM, DER, PKCS12, ...) but
+ * has no XML representation.
+ */
+#define xmlSecKeyDataUsageReadFromFile                  0x00100
+
 /**
  * xmlSecKeyDataUsageAny:
  *
@@ -245,6 +253,8 @@ XMLSEC_EXPORT int               xmlSecKeyDataIdsInit            (void);
 XMLSEC_EXPORT void              xmlSecKeyDataIdsShutdown        (void);
 XMLSEC_EXPORT int               xmlSecKeyDataIdsRegisterDefault (void);
 XMLSEC_EXPORT int               xmlSecKeyDataIdsRegister        (xmlSecKeyDataId id);
+XMLSEC_EXPORT int               xmlSecKeyDataIdsFreeze          (void);
+XMLSEC_EXPORT int               xmlSecKeyDataIdsIsFrozen        (void);
 
 /**************************************************************************
  *
@@ -616,6 +626,7 @@ XMLSEC_EXPORT xmlSecPtrListId   xmlSecKeyDataListGetKlass       (void);
  */
 #define xmlSecKeyDataIdListId   xmlSecKeyDataIdListGetKlass()
 XMLSEC_EXPORT xmlSecPtrListId   xmlSecKeyDataIdListGetKlass     (void);
+XMLSEC_EXPORT int               xmlSecKeyDataIdListAddDefault   (xmlSecPtrListPtr list);
 XMLSEC_EXPORT int               xmlSecKeyDataIdListFind         (xmlSecPtrListPtr list,
                                                                  xmlSecKeyDataId dataId);
 XMLSEC_EXPORT xmlSecKeyDataId   xmlSecKeyDataIdListFindByNode   (xmlSecPtrListPtr list,
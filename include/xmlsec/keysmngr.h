@@ -34,6 +34,7 @@ typedef const struct _xmlSecKeyStoreKlass               xmlSecKeyStoreKlass,
  ***************************************************************************/
 XMLSEC_EXPORT xmlSecKeysMngrPtr         xmlSecKeysMngrCreate            (void);
 XMLSEC_EXPORT void                      xmlSecKeysMngrDestroy           (xmlSecKeysMngrPtr mngr);
+XMLSEC_EXPORT xmlSecKeysMngrPtr         xmlSecKeysMngrRef               (xmlSecKeysMngrPtr mngr);
 
 XMLSEC_EXPORT xmlSecKeyPtr              xmlSecKeysMngrFindKey           (xmlSecKeysMngrPtr mngr,
                                                                          const xmlChar* name,
@@ -48,6 +49,17 @@ XMLSEC_EXPORT int                       xmlSecKeysMngrAdoptDataStore    (xmlSecK
 XMLSEC_EXPORT xmlSecKeyDataStorePtr     xmlSecKeysMngrGetDataStore      (xmlSecKeysMngrPtr mngr,
                                                                          xmlSecKeyDataStoreId id);
 
+XMLSEC_EXPORT int                       xmlSecKeysMngrEnableKeyCache    (xmlSecKeysMngrPtr mngr,
+                                                                         xmlSecSize maxSize,
+                                                                         unsigned int ttl);
+XMLSEC_EXPORT int                       xmlSecKeysMngrEnableEncryptedKeyCache(xmlSecKeysMngrPtr mngr,
+                                                                         xmlSecSize maxSize,
+                                                                         unsigned int ttl);
+XMLSEC_EXPORT int                       xmlSecKeysMngrEnableVerifyCache (xmlSecKeysMngrPtr mngr,
+                                                                         xmlSecSize maxSize,
+                                                                         unsigned int ttl);
+XMLSEC_EXPORT void                      xmlSecKeysMngrInvalidateKeyCache(xmlSecKeysMngrPtr mngr);
+
 /**
  * xmlSecGetKeyCallback:
  * @keyInfoNode:                the pointer to <dsig:KeyInfo/> node.
@@ -66,13 +78,36 @@ typedef xmlSecKeyPtr    (*xmlSecGetKeyCallback)         (xmlNodePtr keyInfoNode,
  * @keysStore:                  the key store (list of keys known to keys manager).
  * @storesList:                 the list of key data stores known to keys manager.
  * @getKey:                     the callback used to read <dsig:KeyInfo/> node.
+ * @keyCache:                   the resolved keys cache (private, see
+ *                              #xmlSecKeysMngrEnableKeyCache).
+ * @encKeyCache:                the unwrapped keys cache (private, see
+ *                              #xmlSecKeysMngrEnableEncryptedKeyCache).
+ * @verifyCache:                the verified signatures cache (private, see
+ *                              #xmlSecKeysMngrEnableVerifyCache).
+ * @refs:                       the references counter (see #xmlSecKeysMngrRef).
  *
  * The keys manager structure.
+ *
+ * Once the keys manager is set up (the stores are adopted), it can be shared
+ * between threads: #xmlSecKeysMngrFindKey and #xmlSecKeysMngrGetKey can be
+ * called concurrently as long as the adopted stores are thread-safe. The
+ * simple keys store is: its lookups share a read-write lock and
+ * #xmlSecSimpleKeysStoreAdoptKey, #xmlSecSimpleKeysStoreReplaceKey and
+ * #xmlSecSimpleKeysStoreRemoveKeys can be used to change the keys while
+ * the store is in use. Sharing the keys with #xmlSecKeyShare makes the lookups
+ * return references instead of copies of the key material.
+ *
+ * To replace the keys manager (e.g. to rotate keys or CRLs) without
+ * pausing the operations in progress, use #xmlSecKeysMngrHolder.
  */
 struct _xmlSecKeysMngr {
     xmlSecKeyStorePtr           keysStore;
     xmlSecPtrList               storesList;
     xmlSecGetKeyCallback        getKey;
+    void*                       keyCache;
+    void*                       encKeyCache;
+    void*                       verifyCache;
+    long                        refs;
 };
 
 
@@ -80,6 +115,44 @@ XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeysMngrGetKey    (xmlNodePtr keyInfoNode,
                                                          xmlSecKeyInfoCtxPtr keyInfoCtx);
 
 
+/****************************************************************************
+ *
+ * Keys Manager Holder
+ *
+ ***************************************************************************/
+/**
+ * xmlSecKeysMngrHolder:
+ *
+ * The opaque holder of the current keys manager generation: the operations
+ * acquire the current keys manager with #xmlSecKeysMngrHolderAcquire and
+ * release it with #xmlSecKeysMngrDestroy, the new keys manager is loaded
+ * separately and installed with #xmlSecKeysMngrHolderSwap.
+ */
+typedef struct _xmlSecKeysMngrHolder                    xmlSecKeysMngrHolder,
+                                                        *xmlSecKeysMngrHolderPtr;
+
+XMLSEC_EXPORT xmlSecKeysMngrHolderPtr   xmlSecKeysMngrHolderCreate      (xmlSecKeysMngrPtr mngr);
+XMLSEC_EXPORT void                      xmlSecKeysMngrHolderDestroy     (xmlSecKeysMngrHolderPtr holder);
+XMLSEC_EXPORT xmlSecKeysMngrPtr         xmlSecKeysMngrHolderAcquire     (xmlSecKeysMngrHolderPtr holder,
+                                                                         xmlSecSize* generation);
+XMLSEC_EXPORT xmlSecSize                xmlSecKeysMngrHolderSwap        (xmlSecKeysMngrHolderPtr holder,
+                                                                         xmlSecKeysMngrPtr mngr);
+
+/**
+ * xmlSecKeysMngrLoadCallback:
+ * @context:                    the callback context.
+ *
+ * Creates and loads a new keys manager (see #xmlSecKeysMngrHolderSwapReplicated).
+ *
+ * Returns: the pointer to the new keys manager or NULL if an error occurs.
+ */
+typedef xmlSecKeysMngrPtr       (*xmlSecKeysMngrLoadCallback)   (void* context);
+
+XMLSEC_EXPORT xmlSecSize                xmlSecKeysMngrHolderSwapReplicated(xmlSecKeysMngrHolderPtr holder,
+                                                                         xmlSecKeysMngrLoadCallback loadCallback,
+                                                                         void* context);
+
+
 /**************************************************************************
  *
  * xmlSecKeyStore
@@ -247,12 +320,19 @@ struct _xmlSecKeyStoreKlass {
 XMLSEC_EXPORT xmlSecKeyStoreId          xmlSecSimpleKeysStoreGetKlass   (void);
 XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreAdoptKey   (xmlSecKeyStorePtr store,
                                                                          xmlSecKeyPtr key);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreReplaceKey (xmlSecKeyStorePtr store,
+                                                                         xmlSecKeyPtr key);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreRemoveKeys (xmlSecKeyStorePtr store,
+                                                                         const xmlChar* name);
 XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreLoad       (xmlSecKeyStorePtr store,
                                                                          const char *uri,
                                                                          xmlSecKeysMngrPtr keysMngr);
 XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSave       (xmlSecKeyStorePtr store,
                                                                          const char *filename,
                                                                          xmlSecKeyDataType type);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSaveSnapshot(xmlSecKeyStorePtr store,
+                                                                         const char *filename,
+                                                                         xmlSecKeyDataType type);
 XMLSEC_EXPORT xmlSecPtrListPtr          xmlSecSimpleKeysStoreGetKeys    (xmlSecKeyStorePtr store);
 
 
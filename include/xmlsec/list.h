@@ -23,6 +23,14 @@ typedef const struct _xmlSecPtrListKlass                        xmlSecPtrListKla
 typedef struct _xmlSecPtrList                                   xmlSecPtrList,
                                                                 *xmlSecPtrListPtr;
 
+/**
+ * XMLSEC_PTR_LIST_INLINE_SIZE:
+ *
+ * The number of item slots stored inside the #xmlSecPtrList structure
+ * itself; the lists with fewer items do not allocate memory.
+ */
+#define XMLSEC_PTR_LIST_INLINE_SIZE                             4
+
 /**
  * xmlSecPtrList:
  * @id:                         the list items description.
@@ -30,6 +38,9 @@ typedef struct _xmlSecPtrList                                   xmlSecPtrList,
  * @use:                        the current list size.
  * @max:                        the max (allocated) list size.
  * @allocMode:                  the memory allocation mode.
+ * @inlineData:                 the storage for the small lists (@data points
+ *                              to it until the list grows); because of it the
+ *                              list structure must never be copied by value.
  *
  * The pointers list.
  */
@@ -40,6 +51,8 @@ struct _xmlSecPtrList {
     xmlSecSize                  use;
     xmlSecSize                  max;
     xmlSecAllocMode             allocMode;
+
+    xmlSecPtr                   inlineData[XMLSEC_PTR_LIST_INLINE_SIZE];
 };
 
 XMLSEC_EXPORT void              xmlSecPtrListSetDefaultAllocMode(xmlSecAllocMode defAllocMode,
@@ -62,6 +75,9 @@ XMLSEC_EXPORT xmlSecPtr         xmlSecPtrListGetItem            (xmlSecPtrListPt
                                                                  xmlSecSize pos);
 XMLSEC_EXPORT int               xmlSecPtrListAdd                (xmlSecPtrListPtr list,
                                                                  xmlSecPtr item);
+XMLSEC_EXPORT int               xmlSecPtrListAddItems           (xmlSecPtrListPtr list,
+                                                                 const xmlSecPtr* items,
+                                                                 xmlSecSize itemsSize);
 XMLSEC_EXPORT int               xmlSecPtrListSet                (xmlSecPtrListPtr list,
                                                                  xmlSecPtr item,
                                                                  xmlSecSize pos);
@@ -69,6 +85,8 @@ XMLSEC_EXPORT int               xmlSecPtrListRemove             (xmlSecPtrListPt
                                                                  xmlSecSize pos);
 XMLSEC_EXPORT xmlSecPtr         xmlSecPtrListRemoveAndReturn    (xmlSecPtrListPtr list,
                                                                  xmlSecSize pos);
+XMLSEC_EXPORT void              xmlSecPtrListTruncate           (xmlSecPtrListPtr list,
+                                                                 xmlSecSize size);
 XMLSEC_EXPORT void              xmlSecPtrListDebugDump          (xmlSecPtrListPtr list,
                                                                  FILE* output);
 XMLSEC_EXPORT void              xmlSecPtrListDebugXmlDump       (xmlSecPtrListPtr list,
@@ -0,0 +1,114 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Process-wide metrics.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_METRICS_H__
+#define __XMLSEC_METRICS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stdio.h>
+
+#include <xmlsec/xmlsec.h>
+
+/**
+ * xmlSecMetric:
+ * @xmlSecMetricSignaturesCreated:      the number of created signatures.
+ * @xmlSecMetricSignaturesVerified:     the number of successfully verified signatures.
+ * @xmlSecMetricSignaturesInvalid:      the number of signatures that failed verification.
+ * @xmlSecMetricDataEncrypted:          the number of encrypted <enc:EncryptedData/>
+ *                                      or <enc:EncryptedKey/> nodes.
+ * @xmlSecMetricDataDecrypted:          the number of decrypted <enc:EncryptedData/>
+ *                                      or <enc:EncryptedKey/> nodes.
+ * @xmlSecMetricC14NBytes:              the number of bytes produced by the c14n transforms.
+ * @xmlSecMetricXPathCacheHits:         the compiled XPath expressions cache hits.
+ * @xmlSecMetricXPathCacheMisses:       the compiled XPath expressions cache misses.
+ * @xmlSecMetricKeysCacheHits:          the keys manager resolved keys cache hits.
+ * @xmlSecMetricKeysCacheMisses:        the keys manager resolved keys cache misses.
+ * @xmlSecMetricX509CacheHits:          the certificates verification cache hits.
+ * @xmlSecMetricX509CacheMisses:        the certificates verification cache misses.
+ * @xmlSecMetricTransformsMemoryPeak:   the maximum memory allocated by the buffers
+ *                                      of one transforms chain (a gauge: the
+ *                                      maximum instead of the sum is reported).
+ * @xmlSecMetricLast:                   the number of metrics.
+ *
+ * The process-wide metrics (see #xmlSecMetricsSetEnabled).
+ */
+typedef enum {
+    xmlSecMetricSignaturesCreated = 0,
+    xmlSecMetricSignaturesVerified,
+    xmlSecMetricSignaturesInvalid,
+    xmlSecMetricDataEncrypted,
+    xmlSecMetricDataDecrypted,
+    xmlSecMetricC14NBytes,
+    xmlSecMetricXPathCacheHits,
+    xmlSecMetricXPathCacheMisses,
+    xmlSecMetricKeysCacheHits,
+    xmlSecMetricKeysCacheMisses,
+    xmlSecMetricX509CacheHits,
+    xmlSecMetricX509CacheMisses,
+    xmlSecMetricTransformsMemoryPeak,
+    xmlSecMetricLast
+} xmlSecMetric;
+
+/**
+ * XMLSEC_METRICS_PHASES_NUMBER:
+ *
+ * The number of the timed processing phases (see #xmlSecTracePhase).
+ */
+#define XMLSEC_METRICS_PHASES_NUMBER                    6
+
+/**
+ * XMLSEC_METRICS_BUCKETS_NUMBER:
+ *
+ * The number of buckets in the phase timings histogram: the bucket i
+ * counts the phases that took less than 2^i microseconds (the last one
+ * counts all the rest).
+ */
+#define XMLSEC_METRICS_BUCKETS_NUMBER                   32
+
+typedef struct _xmlSecMetricsPhaseStats                 xmlSecMetricsPhaseStats,
+                                                        *xmlSecMetricsPhaseStatsPtr;
+
+/**
+ * xmlSecMetricsPhaseStats:
+ * @count:              the number of the finished phases.
+ * @failed:             the number of the failed phases.
+ * @time:               the total time of the phases (in microseconds).
+ * @buckets:            the phase timings histogram (not cumulative, see
+ *                      #XMLSEC_METRICS_BUCKETS_NUMBER).
+ *
+ * The timings of one processing phase.
+ */
+struct _xmlSecMetricsPhaseStats {
+    xmlSecSize          count;
+    xmlSecSize          failed;
+    double              time;
+    xmlSecSize          buckets[XMLSEC_METRICS_BUCKETS_NUMBER];
+};
+
+XMLSEC_EXPORT void              xmlSecMetricsSetEnabled         (int enabled);
+XMLSEC_EXPORT int               xmlSecMetricsIsEnabled          (void);
+XMLSEC_EXPORT void              xmlSecMetricsAdd                (xmlSecMetric metric,
+                                                                 xmlSecSize value);
+XMLSEC_EXPORT xmlSecSize        xmlSecMetricsGet                (xmlSecMetric metric);
+XMLSEC_EXPORT const char*       xmlSecMetricsGetName            (xmlSecMetric metric);
+XMLSEC_EXPORT int               xmlSecMetricsGetPhaseStats      (xmlSecTracePhase phase,
+                                                                 xmlSecMetricsPhaseStatsPtr stats);
+XMLSEC_EXPORT double            xmlSecMetricsPhaseStatsGetPercentile(xmlSecMetricsPhaseStatsPtr stats,
+                                                                 double percentile);
+XMLSEC_EXPORT int               xmlSecMetricsDumpPrometheus     (FILE* output);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_METRICS_H__ */
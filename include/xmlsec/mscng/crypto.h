@@ -27,6 +27,7 @@ XMLSEC_CRYPTO_EXPORT LPWSTR xmlSecMSCngConvertUtf8ToUnicode(const xmlChar* str);
 XMLSEC_CRYPTO_EXPORT xmlChar* xmlSecMSCngConvertTstrToUtf8(LPCTSTR str);
 XMLSEC_CRYPTO_EXPORT xmlChar* xmlSecMSCngConvertUnicodeToUtf8(LPCWSTR str);
 XMLSEC_CRYPTO_EXPORT int xmlSecMSCngGenerateRandom(xmlSecBufferPtr buffer, size_t size);
+XMLSEC_CRYPTO_EXPORT int xmlSecMSCngGenerateRandomBytes(xmlSecByte* out, xmlSecSize outSize, void* context);
 
 /********************************************************************
  *
@@ -22,6 +22,13 @@ extern "C" {
 
 typedef struct _xmlSecNodeSet   xmlSecNodeSet, *xmlSecNodeSetPtr;
 
+/**
+ * xmlSecNodeSetIndex:
+ *
+ * The nodes set lookup index (private, opaque).
+ */
+typedef struct _xmlSecNodeSetIndex      xmlSecNodeSetIndex, *xmlSecNodeSetIndexPtr;
+
 /**
  * xmlSecNodeSetType:
  * @xmlSecNodeSetNormal:        nodes set = nodes in the list.
@@ -74,8 +81,12 @@ typedef enum {
  * @prev:                       the previous nodes set.
  * @children:                   the children list (valid only if type
  *                              equal to #xmlSecNodeSetList).
+ * @index:                      the lookup index built on the first
+ *                              #xmlSecNodeSetContains call (private).
  *
- * The enchanced nodes set.
+ * The enchanced nodes set. The lookup index is built and updated by
+ * #xmlSecNodeSetContains without any locking: same as the libxml2 XPath
+ * objects, a nodes set must not be used by several threads at once.
  */
 struct _xmlSecNodeSet {
     xmlNodeSetPtr       nodes;
@@ -86,6 +97,7 @@ struct _xmlSecNodeSet {
     xmlSecNodeSetPtr    next;
     xmlSecNodeSetPtr    prev;
     xmlSecNodeSetPtr    children;
+    xmlSecNodeSetIndexPtr index;
 };
 
 /**
@@ -119,6 +131,7 @@ XMLSEC_EXPORT xmlSecNodeSetPtr  xmlSecNodeSetAdd        (xmlSecNodeSetPtr nset,
 XMLSEC_EXPORT xmlSecNodeSetPtr  xmlSecNodeSetAddList    (xmlSecNodeSetPtr nset,
                                                          xmlSecNodeSetPtr newNSet,
                                                          xmlSecNodeSetOp op);
+XMLSEC_EXPORT int               xmlSecNodeSetMaterialize(xmlSecNodeSetPtr nset);
 XMLSEC_EXPORT xmlSecNodeSetPtr  xmlSecNodeSetGetChildren(xmlDocPtr doc,
                                                          const xmlNodePtr parent,
                                                          int withComments,
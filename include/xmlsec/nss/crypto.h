@@ -36,6 +36,9 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecNssShutdown               (void);
 XMLSEC_CRYPTO_EXPORT int                xmlSecNssKeysMngrInit           (xmlSecKeysMngrPtr mngr);
 XMLSEC_CRYPTO_EXPORT int                xmlSecNssGenerateRandom         (xmlSecBufferPtr buffer,
                                                                          xmlSecSize size);
+XMLSEC_CRYPTO_EXPORT int                xmlSecNssGenerateRandomBytes    (xmlSecByte* out,
+                                                                         xmlSecSize outSize,
+                                                                         void* context);
 
 XMLSEC_CRYPTO_EXPORT void               xmlSecNssErrorsDefaultCallback  (const char* file,
                                                                         int line,
@@ -37,6 +37,7 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecNssKeysStoreLoad  (xmlSecKeyStoreP
 XMLSEC_CRYPTO_EXPORT int                xmlSecNssKeysStoreSave  (xmlSecKeyStorePtr store,
                                                                  const char *filename,
                                                                  xmlSecKeyDataType type);
+XMLSEC_CRYPTO_EXPORT void               xmlSecNssKeysStoreInvalidateCache(xmlSecKeyStorePtr store);
 
 #ifdef __cplusplus
 }
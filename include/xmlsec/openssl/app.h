@@ -37,6 +37,8 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppShutdown        (void);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppDefaultKeysMngrInit(xmlSecKeysMngrPtr mngr);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppDefaultKeysMngrAdoptKey(xmlSecKeysMngrPtr mngr,
                                                                          xmlSecKeyPtr key);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppDefaultKeysMngrSetHotKey(xmlSecKeysMngrPtr mngr,
+                                                                         const xmlChar* name);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppDefaultKeysMngrLoad(xmlSecKeysMngrPtr mngr,
                                                                          const char* uri);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppDefaultKeysMngrSave(xmlSecKeysMngrPtr mngr,
@@ -61,6 +63,7 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppKeysMngrAddCertsPath(xml
                                                                          const char *path);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppKeysMngrAddCertsFile(xmlSecKeysMngrPtr mngr,
                                                                          const char *filename);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppKeysMngrReloadCertsPaths(xmlSecKeysMngrPtr mngr);
 
 #endif /* XMLSEC_NO_X509 */
 
@@ -86,6 +89,9 @@ XMLSEC_CRYPTO_EXPORT xmlSecKeyPtr       xmlSecOpenSSLAppKeyLoadBIO      (BIO* bi
                                                                          const char *pwd,
                                                                          void* pwdCallback,
                                                                          void* pwdCallbackCtx);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppKeySetHot       (xmlSecKeyPtr key);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLAppKeysCacheSetEnabled(int enabled);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLAppKeysCacheFlush  (void);
 
 #ifndef XMLSEC_NO_X509
 XMLSEC_CRYPTO_EXPORT xmlSecKeyPtr       xmlSecOpenSSLAppPkcs12Load      (const char* filename,
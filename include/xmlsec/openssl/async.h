@@ -0,0 +1,85 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Non-blocking execution with OpenSSL ASYNC jobs
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_OPENSSL_ASYNC_H__
+#define __XMLSEC_OPENSSL_ASYNC_H__
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/xmldsig.h>
+#include <xmlsec/xmlenc.h>
+#include <xmlsec/openssl/crypto.h>
+
+/**
+ * XMLSEC_OPENSSL_ASYNC:
+ *
+ * Defined if OpenSSL supports ASYNC jobs (OpenSSL 1.1.0 or newer).
+ */
+#if defined(XMLSEC_OPENSSL_API_110) && !defined(LIBRESSL_VERSION_NUMBER) && !defined(OPENSSL_NO_ASYNC)
+#define XMLSEC_OPENSSL_ASYNC        1
+#endif /* defined(XMLSEC_OPENSSL_API_110) && !defined(LIBRESSL_VERSION_NUMBER) && !defined(OPENSSL_NO_ASYNC) */
+
+#ifdef XMLSEC_OPENSSL_ASYNC
+
+#include <openssl/async.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * xmlSecOpenSSLAsyncCtx:
+ *
+ * The async execution context: an OpenSSL ASYNC job and its wait context.
+ */
+typedef struct _xmlSecOpenSSLAsyncCtx                   xmlSecOpenSSLAsyncCtx,
+                                                        *xmlSecOpenSSLAsyncCtxPtr;
+
+/**
+ * xmlSecOpenSSLAsyncOperation:
+ * @data:               the operation data.
+ *
+ * The operation executed in the ASYNC job.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+typedef int             (*xmlSecOpenSSLAsyncOperation)                  (void* data);
+
+XMLSEC_CRYPTO_EXPORT xmlSecOpenSSLAsyncCtxPtr   xmlSecOpenSSLAsyncCtxCreate     (void);
+XMLSEC_CRYPTO_EXPORT void                       xmlSecOpenSSLAsyncCtxDestroy    (xmlSecOpenSSLAsyncCtxPtr asyncCtx);
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncCtxRun        (xmlSecOpenSSLAsyncCtxPtr asyncCtx,
+                                                                                 xmlSecOpenSSLAsyncOperation op,
+                                                                                 void* data);
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncCtxIsPending  (xmlSecOpenSSLAsyncCtxPtr asyncCtx);
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncCtxGetWaitFds (xmlSecOpenSSLAsyncCtxPtr asyncCtx,
+                                                                                 OSSL_ASYNC_FD* fds,
+                                                                                 xmlSecSize* fdsSize);
+
+#ifndef XMLSEC_NO_XMLDSIG
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncDSigCtxSign   (xmlSecOpenSSLAsyncCtxPtr asyncCtx,
+                                                                                 xmlSecDSigCtxPtr dsigCtx,
+                                                                                 xmlNodePtr tmpl);
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncDSigCtxVerify (xmlSecOpenSSLAsyncCtxPtr asyncCtx,
+                                                                                 xmlSecDSigCtxPtr dsigCtx,
+                                                                                 xmlNodePtr node);
+#endif /* XMLSEC_NO_XMLDSIG */
+
+#ifndef XMLSEC_NO_XMLENC
+XMLSEC_CRYPTO_EXPORT int                        xmlSecOpenSSLAsyncEncCtxDecrypt (xmlSecOpenSSLAsyncCtxPtr asyncCtx,
+                                                                                 xmlSecEncCtxPtr encCtx,
+                                                                                 xmlNodePtr node);
+#endif /* XMLSEC_NO_XMLENC */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XMLSEC_OPENSSL_ASYNC */
+
+#endif /* __XMLSEC_OPENSSL_ASYNC_H__ */
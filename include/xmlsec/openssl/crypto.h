@@ -34,6 +34,9 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLShutdown           (void);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLKeysMngrInit       (xmlSecKeysMngrPtr mngr);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLGenerateRandom     (xmlSecBufferPtr buffer,
                                                                          xmlSecSize size);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLGenerateRandomBytes(xmlSecByte* out,
+                                                                         xmlSecSize outSize,
+                                                                         void* context);
 
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLSetDefaultTrustedCertsFolder(const xmlChar* path);
 XMLSEC_CRYPTO_EXPORT const xmlChar*     xmlSecOpenSSLGetDefaultTrustedCertsFolder(void);
@@ -79,6 +82,11 @@ XMLSEC_CRYPTO_EXPORT const xmlChar*     xmlSecOpenSSLGetDefaultTrustedCertsFolde
 #define XMLSEC_NO_ECDSA     1
 #endif /* OPENSSL_NO_ECDSA */
 
+/* EdDSA keys are available starting from OpenSSL 1.1.1 */
+#if defined(OPENSSL_NO_EC) || defined(LIBRESSL_VERSION_NUMBER) || (OPENSSL_VERSION_NUMBER < 0x10101000L)
+#define XMLSEC_NO_EDDSA     1
+#endif /* defined(OPENSSL_NO_EC) || defined(LIBRESSL_VERSION_NUMBER) || (OPENSSL_VERSION_NUMBER < 0x10101000L) */
+
 #ifdef OPENSSL_NO_GOST
 #define XMLSEC_NO_GOST      1
 #define XMLSEC_NO_GOST2012  1
@@ -162,6 +170,33 @@ XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformAes192CbcGetKlass(
         xmlSecOpenSSLTransformAes256CbcGetKlass()
 XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformAes256CbcGetKlass(void);
 
+/**
+ * xmlSecOpenSSLTransformAes128GcmId:
+ *
+ * The AES128 GCM cipher transform klass.
+ */
+#define xmlSecOpenSSLTransformAes128GcmId \
+        xmlSecOpenSSLTransformAes128GcmGetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformAes128GcmGetKlass(void);
+
+/**
+ * xmlSecOpenSSLTransformAes192GcmId:
+ *
+ * The AES192 GCM cipher transform klass.
+ */
+#define xmlSecOpenSSLTransformAes192GcmId \
+        xmlSecOpenSSLTransformAes192GcmGetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformAes192GcmGetKlass(void);
+
+/**
+ * xmlSecOpenSSLTransformAes256GcmId:
+ *
+ * The AES256 GCM cipher transform klass.
+ */
+#define xmlSecOpenSSLTransformAes256GcmId \
+        xmlSecOpenSSLTransformAes256GcmGetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformAes256GcmGetKlass(void);
+
 /**
  * xmlSecOpenSSLTransformKWAes128Id:
  *
@@ -189,6 +224,12 @@ XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformKWAes192GetKlass(v
         xmlSecOpenSSLTransformKWAes256GetKlass()
 XMLSEC_CRYPTO_EXPORT xmlSecTransformId  xmlSecOpenSSLTransformKWAes256GetKlass(void);
 
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLKWAesDecodeBatch   (xmlSecKeyPtr key,
+                                                                         xmlSecBufferPtr* in,
+                                                                         xmlSecBufferPtr* out,
+                                                                         xmlSecSize size,
+                                                                         int* results);
+
 #endif /* XMLSEC_NO_AES */
 
 /********************************************************************
@@ -357,6 +398,52 @@ XMLSEC_CRYPTO_EXPORT xmlSecTransformId xmlSecOpenSSLTransformEcdsaSha512GetKlass
 
 #endif /* XMLSEC_NO_ECDSA */
 
+/********************************************************************
+ *
+ * EdDSA transforms
+ *
+ *******************************************************************/
+#ifndef XMLSEC_NO_EDDSA
+#include <openssl/evp.h>
+
+/**
+ * xmlSecOpenSSLKeyDataEd25519Id:
+ *
+ * The Ed25519 key klass.
+ */
+#define xmlSecOpenSSLKeyDataEd25519Id \
+        xmlSecOpenSSLKeyDataEd25519GetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecKeyDataId    xmlSecOpenSSLKeyDataEd25519GetKlass (void);
+
+/**
+ * xmlSecOpenSSLKeyDataEd448Id:
+ *
+ * The Ed448 key klass.
+ */
+#define xmlSecOpenSSLKeyDataEd448Id \
+        xmlSecOpenSSLKeyDataEd448GetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecKeyDataId    xmlSecOpenSSLKeyDataEd448GetKlass   (void);
+
+/**
+ * xmlSecOpenSSLTransformEd25519Id:
+ *
+ * The EdDSA Ed25519 signature transform klass.
+ */
+#define xmlSecOpenSSLTransformEd25519Id \
+        xmlSecOpenSSLTransformEd25519GetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecTransformId xmlSecOpenSSLTransformEd25519GetKlass(void);
+
+/**
+ * xmlSecOpenSSLTransformEd448Id:
+ *
+ * The EdDSA Ed448 signature transform klass.
+ */
+#define xmlSecOpenSSLTransformEd448Id \
+        xmlSecOpenSSLTransformEd448GetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecTransformId xmlSecOpenSSLTransformEd448GetKlass(void);
+
+#endif /* XMLSEC_NO_EDDSA */
+
 #ifndef XMLSEC_NO_GOST
 
 /********************************************************************
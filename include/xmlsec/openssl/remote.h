@@ -0,0 +1,87 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Remote private key operations (signing service or HSM cluster).
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_OPENSSL_REMOTE_H__
+#define __XMLSEC_OPENSSL_REMOTE_H__
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/openssl/crypto.h>
+
+/**
+ * XMLSEC_OPENSSL_REMOTE:
+ *
+ * Defined if the remote private key operations are supported (POSIX
+ * sockets and threads are required).
+ */
+#if !defined(_WIN32) && !defined(XMLSEC_OPENSSL_NO_REMOTE)
+#define XMLSEC_OPENSSL_REMOTE       1
+#endif /* !defined(_WIN32) && !defined(XMLSEC_OPENSSL_NO_REMOTE) */
+
+#ifdef XMLSEC_OPENSSL_REMOTE
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * XMLSEC_OPENSSL_REMOTE_DEFAULT_MAX_PENDING:
+ *
+ * The default maximum number of the requests sent to the remote signer
+ * and waiting for the reply.
+ */
+#define XMLSEC_OPENSSL_REMOTE_DEFAULT_MAX_PENDING       64
+
+/**
+ * xmlSecOpenSSLRemoteSigner:
+ *
+ * The connection to the remote signing service shared by all the keys
+ * adopted with #xmlSecOpenSSLRemoteSignerAdoptKey.
+ */
+typedef struct _xmlSecOpenSSLRemoteSigner               xmlSecOpenSSLRemoteSigner,
+                                                        *xmlSecOpenSSLRemoteSignerPtr;
+
+XMLSEC_CRYPTO_EXPORT xmlSecOpenSSLRemoteSignerPtr xmlSecOpenSSLRemoteSignerCreate (const char* address,
+                                                                                 xmlSecSize maxPending);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLRemoteSignerDestroy        (xmlSecOpenSSLRemoteSignerPtr signer);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLRemoteSignerAdoptKey       (xmlSecOpenSSLRemoteSignerPtr signer,
+                                                                                 xmlSecKeyPtr key,
+                                                                                 const xmlChar* keyName);
+
+/**
+ * xmlSecOpenSSLKeyDataRemoteId:
+ *
+ * The remote private key reference klass.
+ */
+#define xmlSecOpenSSLKeyDataRemoteId \
+        xmlSecOpenSSLKeyDataRemoteGetKlass()
+XMLSEC_CRYPTO_EXPORT xmlSecKeyDataId    xmlSecOpenSSLKeyDataRemoteGetKlass      (void);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLKeyDataRemoteSign          (xmlSecKeyDataPtr data,
+                                                                                 const xmlChar* algorithm,
+                                                                                 const xmlSecByte* in,
+                                                                                 xmlSecSize inSize,
+                                                                                 xmlSecBufferPtr out);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLKeyDataRemoteDecrypt       (xmlSecKeyDataPtr data,
+                                                                                 const xmlChar* algorithm,
+                                                                                 const xmlSecByte* in,
+                                                                                 xmlSecSize inSize,
+                                                                                 const xmlSecByte* params,
+                                                                                 xmlSecSize paramsSize,
+                                                                                 xmlSecBufferPtr out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
+#endif /* __XMLSEC_OPENSSL_REMOTE_H__ */
@@ -38,6 +38,8 @@ extern "C" {
 #define xmlSecKeyDataDesId                      xmlSecOpenSSLKeyDataDesId
 #define xmlSecKeyDataDsaId                      xmlSecOpenSSLKeyDataDsaId
 #define xmlSecKeyDataEcdsaId                    xmlSecOpenSSLKeyDataEcdsaId
+#define xmlSecKeyDataEd25519Id                  xmlSecOpenSSLKeyDataEd25519Id
+#define xmlSecKeyDataEd448Id                    xmlSecOpenSSLKeyDataEd448Id
 #define xmlSecKeyDataHmacId                     xmlSecOpenSSLKeyDataHmacId
 #define xmlSecKeyDataRsaId                      xmlSecOpenSSLKeyDataRsaId
 #define xmlSecKeyDataX509Id                     xmlSecOpenSSLKeyDataX509Id
@@ -58,6 +60,9 @@ extern "C" {
 #define xmlSecTransformAes128CbcId              xmlSecOpenSSLTransformAes128CbcId
 #define xmlSecTransformAes192CbcId              xmlSecOpenSSLTransformAes192CbcId
 #define xmlSecTransformAes256CbcId              xmlSecOpenSSLTransformAes256CbcId
+#define xmlSecTransformAes128GcmId              xmlSecOpenSSLTransformAes128GcmId
+#define xmlSecTransformAes192GcmId              xmlSecOpenSSLTransformAes192GcmId
+#define xmlSecTransformAes256GcmId              xmlSecOpenSSLTransformAes256GcmId
 #define xmlSecTransformKWAes128Id               xmlSecOpenSSLTransformKWAes128Id
 #define xmlSecTransformKWAes192Id               xmlSecOpenSSLTransformKWAes192Id
 #define xmlSecTransformKWAes256Id               xmlSecOpenSSLTransformKWAes256Id
@@ -70,6 +75,8 @@ extern "C" {
 #define xmlSecTransformEcdsaSha256Id            xmlSecOpenSSLTransformEcdsaSha256Id
 #define xmlSecTransformEcdsaSha384Id            xmlSecOpenSSLTransformEcdsaSha384Id
 #define xmlSecTransformEcdsaSha512Id            xmlSecOpenSSLTransformEcdsaSha512Id
+#define xmlSecTransformEd25519Id                xmlSecOpenSSLTransformEd25519Id
+#define xmlSecTransformEd448Id                  xmlSecOpenSSLTransformEd448Id
 #define xmlSecTransformHmacMd5Id                xmlSecOpenSSLTransformHmacMd5Id
 #define xmlSecTransformHmacRipemd160Id          xmlSecOpenSSLTransformHmacRipemd160Id
 #define xmlSecTransformHmacSha1Id               xmlSecOpenSSLTransformHmacSha1Id
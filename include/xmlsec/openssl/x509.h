@@ -95,10 +95,14 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAdoptCert (xmlSecK
                                                                          xmlSecKeyDataType type);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAdoptCrl  (xmlSecKeyDataStorePtr store,
                                                                          X509_CRL* crl);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddOcspResponse(xmlSecKeyDataStorePtr store,
+                                                                         const xmlSecByte* data,
+                                                                         xmlSecSize dataSize);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store,
                                                                          const char* path);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store,
                                                                          const char* filename);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreReloadCertsPaths(xmlSecKeyDataStorePtr store);
 
 #endif /* XMLSEC_NO_X509 */
 
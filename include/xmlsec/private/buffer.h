@@ -0,0 +1,60 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Memory arena and mapped file helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_BUFFER_H__
+#define __XMLSEC_PRIVATE_BUFFER_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/buffer.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+#include <xmlsec/xmlsec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct _xmlSecArena                     xmlSecArena,
+                                                *xmlSecArenaPtr;
+
+xmlSecArenaPtr  xmlSecArenaCreate                           (void);
+void            xmlSecArenaDestroy                          (xmlSecArenaPtr arena);
+void            xmlSecArenaReset                            (xmlSecArenaPtr arena);
+void*           xmlSecArenaAlloc                            (xmlSecArenaPtr arena,
+                                                             xmlSecSize size);
+xmlChar*        xmlSecArenaStrndup                          (xmlSecArenaPtr arena,
+                                                             const xmlChar* str,
+                                                             xmlSecSize len);
+xmlChar*        xmlSecArenaGetProp                          (xmlSecArenaPtr arena,
+                                                             xmlNodePtr node,
+                                                             const xmlChar* name);
+
+/**
+ * xmlSecMappedFile:
+ * @data:               the file content.
+ * @size:               the file size.
+ *
+ * The read-only memory mapped file.
+ */
+typedef struct _xmlSecMappedFile {
+    xmlSecByte*         data;
+    xmlSecSize          size;
+} xmlSecMappedFile, *xmlSecMappedFilePtr;
+
+int             xmlSecMappedFileOpen                        (xmlSecMappedFilePtr file,
+                                                             const char* filename);
+void            xmlSecMappedFileClose                       (xmlSecMappedFilePtr file);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_BUFFER_H__ */
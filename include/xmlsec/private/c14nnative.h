@@ -0,0 +1,46 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Native canonicalization of XML nodes sets
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_C14NNATIVE_H__
+#define __XMLSEC_PRIVATE_C14NNATIVE_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/c14nnative.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/nodeset.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int xmlSecC14NNativeIsSupported                             (xmlSecNodeSetPtr nodes,
+                                                             int mode);
+int xmlSecC14NNativeIsWholeDocument                         (xmlSecNodeSetPtr nodes,
+                                                             int* withComments);
+int xmlSecC14NNativeExecute                                 (xmlSecNodeSetPtr nodes,
+                                                             int mode,
+                                                             xmlChar** inclusiveNsList,
+                                                             int withComments,
+                                                             int trimTextNodes,
+                                                             int parallel,
+                                                             xmlOutputBufferPtr buf);
+const xmlChar* xmlSecC14NNativeTrimText                     (xmlNodePtr parent,
+                                                             const xmlChar* str,
+                                                             xmlSecSize* size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_C14NNATIVE_H__ */
@@ -0,0 +1,77 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Streaming canonicalization of XML files
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_C14NSTREAM_H__
+#define __XMLSEC_PRIVATE_C14NSTREAM_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/c14nstream.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * xmlSecC14NStreamMode:
+ * @xmlSecC14NStreamModeExclC14N:               the exclusive c14n without comments.
+ * @xmlSecC14NStreamModeC14N2TrimTextNodes:     the canonical XML 2.0 with the TrimTextNodes
+ *                                              parameter (without it the output is the same
+ *                                              as for #xmlSecC14NStreamModeExclC14N).
+ * @xmlSecC14NStreamModeCopy:                   the plain serialization of the document.
+ *
+ * The output produced by #xmlSecC14NStreamProcess.
+ */
+typedef enum {
+    xmlSecC14NStreamModeExclC14N = 0,
+    xmlSecC14NStreamModeC14N2TrimTextNodes,
+    xmlSecC14NStreamModeCopy
+} xmlSecC14NStreamMode;
+
+/**
+ * xmlSecC14NStreamWriteCallback:
+ * @context:            the user context.
+ * @data:               the output data.
+ * @dataSize:           the output data size.
+ *
+ * Receives the next chunk of the #xmlSecC14NStreamProcess output.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+typedef int (*xmlSecC14NStreamWriteCallback)                (void* context,
+                                                             const xmlSecByte* data,
+                                                             xmlSecSize dataSize);
+
+xmlDocPtr xmlSecC14NStreamExtractNode                       (const char* filename,
+                                                             const xmlChar* name,
+                                                             const xmlChar* ns);
+xmlDocPtr xmlSecC14NStreamExtractNodes                      (const char* filename,
+                                                             const xmlChar* name,
+                                                             const xmlChar* ns,
+                                                             const xmlChar** idAttrs,
+                                                             const xmlChar** ids);
+int xmlSecC14NStreamProcess                                 (const char* filename,
+                                                             xmlSecC14NStreamMode mode,
+                                                             xmlChar** inclusiveNsList,
+                                                             const xmlChar* name,
+                                                             const xmlChar* ns,
+                                                             xmlNodePtr replacement,
+                                                             xmlSecC14NStreamWriteCallback writeCallback,
+                                                             void* writeContext);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_C14NSTREAM_H__ */
@@ -0,0 +1,48 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Per-document cache of canonicalization results
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_DOCCACHE_H__
+#define __XMLSEC_PRIVATE_DOCCACHE_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/doccache.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int                     xmlSecDocCachesInitialize               (void);
+void                    xmlSecDocCachesFinalize                 (void);
+int                     xmlSecDocCacheGetGeneration             (xmlDocPtr doc,
+                                                                 xmlSecSize* generation);
+int                     xmlSecDocCacheLookup                    (xmlDocPtr doc,
+                                                                 const xmlChar* key,
+                                                                 xmlNodePtr root,
+                                                                 xmlSecBufferPtr data);
+int                     xmlSecDocCacheAdd                       (xmlDocPtr doc,
+                                                                 const xmlChar* key,
+                                                                 xmlNodePtr root,
+                                                                 xmlNodePtr excluded,
+                                                                 xmlSecSize generation,
+                                                                 const xmlSecByte* data,
+                                                                 xmlSecSize dataSize);
+void                    xmlSecDocCacheTouch                     (xmlNodePtr node);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_DOCCACHE_H__ */
@@ -0,0 +1,51 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Input URI prefetching
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_IO_H__
+#define __XMLSEC_PRIVATE_IO_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/io.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/transforms.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct _xmlSecIOPrefetch                xmlSecIOPrefetch,
+                                                *xmlSecIOPrefetchPtr;
+
+xmlSecIOPrefetchPtr xmlSecIOPrefetchCreate                  (void);
+void            xmlSecIOPrefetchDestroy                     (xmlSecIOPrefetchPtr prefetch);
+int             xmlSecIOPrefetchStart                       (xmlSecIOPrefetchPtr prefetch,
+                                                             const xmlChar* uri);
+int             xmlSecTransformInputURIOpenPrefetched       (xmlSecTransformPtr transform,
+                                                             xmlSecIOPrefetchPtr prefetch,
+                                                             const xmlChar* uri);
+
+int             xmlSecIOCacheDigestFind                     (const char* uri,
+                                                             const xmlChar* key,
+                                                             xmlChar** digestValue,
+                                                             xmlSecSize* version);
+int             xmlSecIOCacheDigestAdd                      (const char* uri,
+                                                             xmlSecSize version,
+                                                             const xmlChar* key,
+                                                             const xmlChar* digestValue);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_IO_H__ */
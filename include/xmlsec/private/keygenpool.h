@@ -0,0 +1,34 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Pre-generated keys pool helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_KEYGENPOOL_H__
+#define __XMLSEC_PRIVATE_KEYGENPOOL_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/keygenpool.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/keygenpool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+xmlSecKeyDataPtr        xmlSecKeyGenPoolTake                    (xmlSecKeyDataId dataId,
+                                                                 xmlSecSize sizeBits,
+                                                                 xmlSecKeyDataType type);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_KEYGENPOOL_H__ */
@@ -0,0 +1,55 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Resolved keys, unwrapped keys and verified signatures cache helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_KEYSMNGR_H__
+#define __XMLSEC_PRIVATE_KEYSMNGR_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/keysmngr.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keyinfo.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+xmlSecKeyPtr    xmlSecKeysMngrKeyCacheFind                  (xmlSecKeysMngrPtr mngr,
+                                                             xmlNodePtr keyInfoNode,
+                                                             xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                                             xmlChar** cacheKey);
+int             xmlSecKeysMngrKeyCacheAdd                   (xmlSecKeysMngrPtr mngr,
+                                                             const xmlChar* cacheKey,
+                                                             xmlSecKeyPtr key);
+xmlSecBufferPtr xmlSecKeysMngrEncryptedKeyCacheFind         (xmlSecKeysMngrPtr mngr,
+                                                             xmlNodePtr encKeyNode,
+                                                             xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                                             xmlChar** cacheKey);
+int             xmlSecKeysMngrEncryptedKeyCacheAdd          (xmlSecKeysMngrPtr mngr,
+                                                             const xmlChar* cacheKey,
+                                                             const xmlSecByte* data,
+                                                             xmlSecSize dataSize);
+int             xmlSecKeysMngrVerifyCacheFind               (xmlSecKeysMngrPtr mngr,
+                                                             xmlNodePtr keyInfoNode,
+                                                             xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                                             const xmlChar* signature,
+                                                             xmlChar** cacheKey);
+int             xmlSecKeysMngrVerifyCacheAdd                (xmlSecKeysMngrPtr mngr,
+                                                             const xmlChar* cacheKey);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_KEYSMNGR_H__ */
@@ -0,0 +1,35 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Process-wide metrics helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_METRICS_H__
+#define __XMLSEC_PRIVATE_METRICS_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/metrics.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/metrics.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int                     xmlSecMetricsInitialize                 (void);
+void                    xmlSecMetricsShutdown                   (void);
+void                    xmlSecMetricsPhaseBegin                 (xmlSecTracePhase phase);
+void                    xmlSecMetricsPhaseEnd                   (xmlSecTracePhase phase,
+                                                                 int result);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_METRICS_H__ */
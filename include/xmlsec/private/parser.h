@@ -0,0 +1,36 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Pooled push parser contexts
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_PARSER_H__
+#define __XMLSEC_PRIVATE_PARSER_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/parser.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/tree.h>
+#include <libxml/parser.h>
+
+#include <xmlsec/xmlsec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int                     xmlSecParserCtxtPoolInitialize          (void);
+void                    xmlSecParserCtxtPoolFinalize            (void);
+xmlParserCtxtPtr        xmlSecParserCtxtAcquire                 (int options);
+void                    xmlSecParserCtxtRelease                 (xmlParserCtxtPtr ctxt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_PARSER_H__ */
@@ -0,0 +1,117 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Transforms chain helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_TRANSFORMS_H__
+#define __XMLSEC_PRIVATE_TRANSFORMS_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/transforms.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <xmlsec/transforms.h>
+#include <xmlsec/private/buffer.h>
+#include <xmlsec/private/io.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct _xmlSecTransformPlan                     xmlSecTransformPlan,
+                                                        *xmlSecTransformPlanPtr;
+
+/**************************************************************************
+ *
+ * Transforms context private data: kept behind xmlSecTransformCtx::reserved0
+ * to preserve the public structure layout
+ *
+ *************************************************************************/
+typedef struct _xmlSecTransformCtxPrivate               xmlSecTransformCtxPrivate,
+                                                        *xmlSecTransformCtxPrivatePtr;
+struct _xmlSecTransformCtxPrivate {
+    /* user settings */
+    xmlSecSize                  binChunkMaxSize;
+    xmlSecSize                  maxTransforms;
+    xmlSecSize                  maxDigestSize;
+    xmlSecSize                  maxXPathOps;
+    xmlSecSize                  maxMemSize;
+    xmlSecAttachmentResolverPtr attachmentResolver;
+
+    /* results */
+    xmlSecSize                  binChunkSize;
+    xmlSecSize                  digestSize;
+    xmlSecSize                  xpathOps;
+    xmlSecBufferMemCounter      memCounter;
+
+    /* the transforms released by xmlSecTransformCtxReset() and kept for reuse */
+    xmlSecTransformPtr          freeTransforms;
+    xmlSecSize                  freeTransformsSize;
+
+    /* the objects that live until xmlSecTransformCtxReset() */
+    xmlSecArenaPtr              arena;
+
+    /* the transforms klasses pre-resolved from a compiled template (not owned) */
+    xmlSecTransformPlanPtr      plan;
+
+    /* the external URIs read in the background (not owned) */
+    xmlSecIOPrefetchPtr         prefetch;
+};
+
+#define xmlSecTransformCtxGetPrivate(ctx) \
+    ((xmlSecTransformCtxPrivatePtr)((ctx)->reserved0))
+
+/**************************************************************************
+ *
+ * Transform private data: allocated by xmlSecTransformCreate() after the
+ * klass data and kept behind xmlSecTransform::reserved0 to preserve the
+ * public structure layout
+ *
+ *************************************************************************/
+typedef struct _xmlSecTransformPrivate                  xmlSecTransformPrivate,
+                                                        *xmlSecTransformPrivatePtr;
+struct _xmlSecTransformPrivate {
+    xmlSecTransformStats        stats;
+    /* the digest, HMAC and signature transforms outBuf inline storage follows */
+};
+
+#define xmlSecTransformGetPrivate(transform) \
+    ((xmlSecTransformPrivatePtr)((transform)->reserved0))
+
+xmlSecSize xmlSecTransformCtxGetBinaryChunkSize             (xmlSecTransformCtxPtr ctx);
+void xmlSecTransformCtxUpdateBinaryChunkSize                (xmlSecTransformCtxPtr ctx,
+                                                             xmlSecSize processedSize);
+xmlSecArenaPtr xmlSecTransformCtxGetArena                   (xmlSecTransformCtxPtr ctx);
+xmlChar** xmlSecTransformC14NGetInclusiveNsList             (xmlSecTransformPtr transform);
+int xmlSecTransformC14N2GetTrimTextNodes                    (xmlSecTransformPtr transform);
+void xmlSecTransformC14NCacheInitialize                     (void);
+void xmlSecTransformC14NCacheShutdown                       (void);
+int xmlSecTransformBase64DecodeTextNodes                     (xmlSecTransformPtr transform,
+                                                             xmlSecNodeSetPtr nodes,
+                                                             xmlSecTransformCtxPtr transformCtx);
+
+/**************************************************************************
+ *
+ * Transforms plan: the transforms klasses resolved once for the
+ * Algorithm attributes of a template
+ *
+ *************************************************************************/
+xmlSecTransformPlanPtr xmlSecTransformPlanCreate            (void);
+void xmlSecTransformPlanDestroy                             (xmlSecTransformPlanPtr plan);
+int xmlSecTransformPlanAddNode                              (xmlSecTransformPlanPtr plan,
+                                                             xmlNodePtr node,
+                                                             xmlSecTransformUsage usage);
+xmlSecTransformId xmlSecTransformPlanFind                   (xmlSecTransformPlanPtr plan,
+                                                             const xmlChar* href,
+                                                             xmlSecTransformUsage usage);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_TRANSFORMS_H__ */
@@ -0,0 +1,45 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Per-thread random bytes pool.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_RANDOM_H__
+#define __XMLSEC_RANDOM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <xmlsec/xmlsec.h>
+
+/**
+ * xmlSecRandomGenerateMethod:
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ * @context:            the crypto library specific context.
+ *
+ * Fills @out with @outSize bytes from the crypto library random generator.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+typedef int             (*xmlSecRandomGenerateMethod)   (xmlSecByte* out,
+                                                         xmlSecSize outSize,
+                                                         void* context);
+
+XMLSEC_EXPORT void              xmlSecRandomSetPoolSize         (xmlSecSize size);
+XMLSEC_EXPORT xmlSecSize        xmlSecRandomGetPoolSize         (void);
+XMLSEC_EXPORT int               xmlSecRandomGenerate            (xmlSecRandomGenerateMethod generate,
+                                                                 void* context,
+                                                                 xmlSecByte* out,
+                                                                 xmlSecSize outSize);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_RANDOM_H__ */
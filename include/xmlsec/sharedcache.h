@@ -0,0 +1,43 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * The cache shared by the forked processes.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_SHAREDCACHE_H__
+#define __XMLSEC_SHAREDCACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+
+/**
+ * XMLSEC_SHARED_CACHE_DEFAULT_SIZE:
+ *
+ * The default shared cache size in bytes.
+ */
+#define XMLSEC_SHARED_CACHE_DEFAULT_SIZE                (4 * 1024 * 1024)
+
+XMLSEC_EXPORT int               xmlSecSharedCacheCreate         (xmlSecSize size);
+XMLSEC_EXPORT void              xmlSecSharedCacheDestroy        (void);
+XMLSEC_EXPORT int               xmlSecSharedCacheIsEnabled      (void);
+XMLSEC_EXPORT int               xmlSecSharedCacheLookup         (const xmlSecByte* key,
+                                                                 xmlSecSize keySize,
+                                                                 xmlSecBufferPtr value);
+XMLSEC_EXPORT int               xmlSecSharedCacheAdd            (const xmlSecByte* key,
+                                                                 xmlSecSize keySize,
+                                                                 const xmlSecByte* value,
+                                                                 xmlSecSize valueSize);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_SHAREDCACHE_H__ */
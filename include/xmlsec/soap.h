@@ -119,6 +119,44 @@ XMLSEC_DEPRECATED XMLSEC_EXPORT xmlNodePtr        xmlSecSoap12GetBodyEntry
 XMLSEC_DEPRECATED XMLSEC_EXPORT xmlNodePtr        xmlSecSoap12GetFaultEntry       (xmlNodePtr envNode);
 
 
+/***********************************************************************
+ *
+ * SOAP body entries iterator
+ *
+ **********************************************************************/
+typedef struct _xmlSecSoapBodyEntriesIter               xmlSecSoapBodyEntriesIter,
+                                                        *xmlSecSoapBodyEntriesIterPtr;
+
+/**
+ * xmlSecSoapBodyEntriesIter:
+ * @bodyNode:           the <soap:Body> node.
+ * @cur:                the current body entry (NULL before the first one).
+ * @pos:                the position of the current body entry.
+ * @size:               the number of body entries (valid if @sizeKnown is set).
+ * @sizeKnown:          the flag that @size was already counted.
+ *
+ * The SOAP 1.1 or 1.2 body entries iterator. It remembers the last
+ * returned entry thus walking through all the entries (sequentially or by
+ * increasing positions) is linear in the number of entries. The body
+ * entries must not be added or removed while the iterator is in use.
+ */
+struct _xmlSecSoapBodyEntriesIter {
+    xmlNodePtr          bodyNode;
+    xmlNodePtr          cur;
+    xmlSecSize          pos;
+    xmlSecSize          size;
+    int                 sizeKnown;
+};
+
+XMLSEC_DEPRECATED XMLSEC_EXPORT int               xmlSecSoapBodyEntriesIterInitialize(xmlSecSoapBodyEntriesIterPtr iter,
+                                                                 xmlNodePtr bodyNode);
+XMLSEC_DEPRECATED XMLSEC_EXPORT void              xmlSecSoapBodyEntriesIterFinalize(xmlSecSoapBodyEntriesIterPtr iter);
+XMLSEC_DEPRECATED XMLSEC_EXPORT xmlNodePtr        xmlSecSoapBodyEntriesIterNext   (xmlSecSoapBodyEntriesIterPtr iter);
+XMLSEC_DEPRECATED XMLSEC_EXPORT xmlNodePtr        xmlSecSoapBodyEntriesIterGet    (xmlSecSoapBodyEntriesIterPtr iter,
+                                                                 xmlSecSize pos);
+XMLSEC_DEPRECATED XMLSEC_EXPORT xmlSecSize        xmlSecSoapBodyEntriesIterGetSize(xmlSecSoapBodyEntriesIterPtr iter);
+
+
 #endif /* XMLSEC_NO_SOAP */
 
 
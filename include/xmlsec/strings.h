@@ -113,6 +113,15 @@ XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefAes192Cbc[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecNameAes256Cbc[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefAes256Cbc[];
 
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameAes128Gcm[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefAes128Gcm[];
+
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameAes192Gcm[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefAes192Gcm[];
+
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameAes256Gcm[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefAes256Gcm[];
+
 XMLSEC_EXPORT_VAR const xmlChar xmlSecNameKWAes128[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefKWAes128[];
 
@@ -159,6 +168,15 @@ XMLSEC_EXPORT_VAR const xmlChar xmlSecNsExcC14NWithComments[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeInclusiveNamespaces[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecAttrPrefixList[];
 
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameC14N2[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefC14N2[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNsC14N2[];
+
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeC14N2IgnoreComments[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeC14N2TrimTextNodes[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeC14N2PrefixRewrite[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeC14N2QNameAware[];
+
 /*************************************************************************
  *
  * DES strings
@@ -233,6 +251,20 @@ XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefEcdsaSha384[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecNameEcdsaSha512[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefEcdsaSha512[];
 
+/*************************************************************************
+ *
+ * EdDSA strings
+ *
+ ************************************************************************/
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameEd25519KeyValue[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameEd448KeyValue[];
+
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameEd25519[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefEd25519[];
+
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNameEd448[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecHrefEd448[];
+
 /*************************************************************************
  *
  * GOST2001 strings
@@ -511,6 +543,7 @@ XMLSEC_EXPORT_VAR const xmlChar xmlSecRelationshipReferenceNs[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecRelationshipAttrId[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecRelationshipAttrSourceId[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecRelationshipAttrTargetMode[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecRelationshipsContentType[];
 
 /*************************************************************************
  *
@@ -551,6 +584,20 @@ XMLSEC_EXPORT_VAR const xmlChar xmlSecSoapFaultCodeReceiver[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecSoapFaultCodeSender[];
 XMLSEC_EXPORT_VAR const xmlChar xmlSecSoapFaultDataEncodningUnknown[];
 
+/*************************************************************************
+ *
+ * WS-Security strings
+ *
+ ************************************************************************/
+XMLSEC_EXPORT_VAR const xmlChar xmlSecWsseNs[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecWsuNs[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeSecurity[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeBinarySecurityToken[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeSecurityTokenReference[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecNodeTimestamp[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecAttrValueType[];
+XMLSEC_EXPORT_VAR const xmlChar xmlSecWsseValueTypeX509v3[];
+
 
 #endif /* XMLSEC_NO_SOAP */
 
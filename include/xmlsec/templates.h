@@ -60,6 +60,14 @@ XMLSEC_EXPORT xmlNodePtr xmlSecTmplManifestAddReference         (xmlNodePtr mani
                                                                  const xmlChar *id,
                                                                  const xmlChar *uri,
                                                                  const xmlChar *type);
+XMLSEC_EXPORT xmlNodePtr xmlSecTmplManifestAddPackagePart       (xmlNodePtr manifestNode,
+                                                                 xmlSecTransformId digestMethodId,
+                                                                 const xmlChar *partName,
+                                                                 const xmlChar *contentType);
+XMLSEC_EXPORT xmlNodePtr xmlSecTmplManifestAddPackageRelationships(xmlNodePtr manifestNode,
+                                                                 xmlSecTransformId digestMethodId,
+                                                                 const xmlChar *partName,
+                                                                 const xmlChar **sourceIds);
 
 /***********************************************************************
  *
@@ -153,6 +161,28 @@ XMLSEC_EXPORT int       xmlSecTmplTransformAddXPath2            (xmlNodePtr tran
 XMLSEC_EXPORT int       xmlSecTmplTransformAddXPointer          (xmlNodePtr transformNode,
                                                                  const xmlChar *expression,
                                                                  const xmlChar **nsList);
+XMLSEC_EXPORT int       xmlSecTmplTransformAddRelationshipReference(xmlNodePtr transformNode,
+                                                                 const xmlChar *sourceId);
+
+/***********************************************************************
+ *
+ * Frozen templates
+ *
+ **********************************************************************/
+/**
+ * xmlSecTmplFrozen:
+ *
+ * The opaque frozen (prebuilt) template: a private copy of a template
+ * that can be stamped into any number of documents.
+ */
+typedef struct _xmlSecTmplFrozen                                xmlSecTmplFrozen,
+                                                                *xmlSecTmplFrozenPtr;
+
+XMLSEC_EXPORT xmlSecTmplFrozenPtr xmlSecTmplFreeze              (xmlNodePtr tmplNode);
+XMLSEC_EXPORT void      xmlSecTmplFrozenDestroy                 (xmlSecTmplFrozenPtr frozen);
+XMLSEC_EXPORT xmlNodePtr xmlSecTmplFrozenStamp                  (xmlSecTmplFrozenPtr frozen,
+                                                                 xmlDocPtr doc,
+                                                                 const xmlChar *idSuffix);
 
 #ifdef __cplusplus
 }
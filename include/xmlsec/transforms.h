@@ -26,15 +26,27 @@ extern "C" {
 
 typedef const struct _xmlSecTransformKlass              xmlSecTransformKlass,
                                                         *xmlSecTransformId;
+typedef struct _xmlSecTransformStats                    xmlSecTransformStats,
+                                                        *xmlSecTransformStatsPtr;
 
 /**
  * XMLSEC_TRANSFORM_BINARY_CHUNK:
  *
  * The binary data chunks size. XMLSec processes binary data one chunk
  * at a time. Changing this impacts xmlsec memory usage and performance.
+ * This is the initial (and the minimal) chunk size, the transforms chain
+ * grows it up to the size set with #xmlSecTransformCtxSetBinaryChunkMaxSize
+ * as data flows through.
  */
 #define XMLSEC_TRANSFORM_BINARY_CHUNK                   1024
 
+/**
+ * XMLSEC_TRANSFORM_BINARY_CHUNK_MAX:
+ *
+ * The default maximum binary data chunks size.
+ */
+#define XMLSEC_TRANSFORM_BINARY_CHUNK_MAX               65536
+
 /**********************************************************************
  *
  * High-level functions
@@ -45,6 +57,8 @@ XMLSEC_EXPORT int               xmlSecTransformIdsInit          (void);
 XMLSEC_EXPORT void              xmlSecTransformIdsShutdown      (void);
 XMLSEC_EXPORT int               xmlSecTransformIdsRegisterDefault(void);
 XMLSEC_EXPORT int               xmlSecTransformIdsRegister      (xmlSecTransformId id);
+XMLSEC_EXPORT int               xmlSecTransformIdsFreeze        (void);
+XMLSEC_EXPORT int               xmlSecTransformIdsIsFrozen      (void);
 
 /**
  * xmlSecTransformStatus:
@@ -278,6 +292,39 @@ typedef int             (*xmlSecTransformCtxPreExecuteCallback)         (xmlSecT
  */
 #define XMLSEC_TRANSFORMCTX_FLAGS_USE_VISA3D_HACK               0x00000001
 
+/**
+ * XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS:
+ *
+ * If this flag is set then every transform in the chain counts the
+ * processed bytes, the push/pop calls and the time spent in them
+ * (see #xmlSecTransformStats).
+ */
+#define XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS                 0x00000002
+
+/**
+ * XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS:
+ *
+ * If this flag is set then a canonicalization transform followed by
+ * a transform that takes XML (e.g. XPath) passes its nodes set to the
+ * next transform instead of serializing it for the XML parser. The nodes
+ * stay in the original document: the DTD, the here() function and
+ * the well-formedness check of the canonical form are not re-evaluated
+ * as they would be after the parsing.
+ */
+#define XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS                0x00000004
+
+/**
+ * XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N:
+ *
+ * If this flag is set then the canonicalization of a large document (or
+ * of a document with an enveloped signature) splits the children of the
+ * document element into ranges canonicalized by the executor tasks (see
+ * #xmlSecExecutorSetCallback). The output is the same, but the canonical
+ * form of all the ranges is kept in memory until it is written in the
+ * document order.
+ */
+#define XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N                 0x00000008
+
 /**
  * xmlSecTransformCtx:
  * @userData:           the pointer to user data (xmlsec and xmlsec-crypto never
@@ -301,7 +348,7 @@ typedef int             (*xmlSecTransformCtxPreExecuteCallback)         (xmlSecT
  * @xptrExpr:           the xpointer expression from data source URI (if any).
  * @first:              the first transform in the chain.
  * @last:               the last transform in the chain.
- * @reserved0:          reserved for the future.
+ * @reserved0:          the private data (do not touch).
  * @reserved1:          reserved for the future.
  *
  * The transform execution context.
@@ -335,6 +382,16 @@ XMLSEC_EXPORT void                      xmlSecTransformCtxFinalize      (xmlSecT
 XMLSEC_EXPORT void                      xmlSecTransformCtxReset         (xmlSecTransformCtxPtr ctx);
 XMLSEC_EXPORT int                       xmlSecTransformCtxCopyUserPref  (xmlSecTransformCtxPtr dst,
                                                                          xmlSecTransformCtxPtr src);
+XMLSEC_EXPORT int                       xmlSecTransformCtxSetBinaryChunkMaxSize(xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecSize size);
+XMLSEC_EXPORT int                       xmlSecTransformCtxSetLimits     (xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecSize maxTransforms,
+                                                                         xmlSecSize maxDigestSize,
+                                                                         xmlSecSize maxXPathOps);
+XMLSEC_EXPORT int                       xmlSecTransformCtxSetMaxMemSize (xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecSize maxMemSize);
+XMLSEC_EXPORT int                       xmlSecTransformCtxSetAttachmentResolver(xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecAttachmentResolverPtr resolver);
 XMLSEC_EXPORT int                       xmlSecTransformCtxSetUri        (xmlSecTransformCtxPtr ctx,
                                                                          const xmlChar* uri,
                                                                          xmlNodePtr hereNode);
@@ -365,6 +422,8 @@ XMLSEC_EXPORT int                       xmlSecTransformCtxExecute       (xmlSecT
                                                                          xmlDocPtr doc);
 XMLSEC_EXPORT void                      xmlSecTransformCtxDebugDump     (xmlSecTransformCtxPtr ctx,
                                                                         FILE* output);
+XMLSEC_EXPORT int                       xmlSecTransformCtxGetStats      (xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecTransformStatsPtr stats);
 XMLSEC_EXPORT void                      xmlSecTransformCtxDebugXmlDump  (xmlSecTransformCtxPtr ctx,
                                                                          FILE* output);
 
@@ -373,6 +432,31 @@ XMLSEC_EXPORT void                      xmlSecTransformCtxDebugXmlDump  (xmlSecT
  * xmlSecTransform
  *
  *************************************************************************/
+/**
+ * xmlSecTransformStats:
+ * @bytesIn:            the number of binary bytes received by the transform.
+ * @bytesOut:           the number of binary bytes produced by the transform.
+ * @pushBinCalls:       the number of #xmlSecTransformPushBin calls.
+ * @popBinCalls:        the number of #xmlSecTransformPopBin calls.
+ * @pushXmlCalls:       the number of #xmlSecTransformPushXml calls.
+ * @popXmlCalls:        the number of #xmlSecTransformPopXml calls.
+ * @time:               the cumulative wall time spent in the push/pop calls
+ *                      (in microseconds, includes the time spent in the
+ *                      transforms called from this one).
+ *
+ * The transform statistics collected when the transforms chain context
+ * has #XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS flag set.
+ */
+struct _xmlSecTransformStats {
+    xmlSecSize                          bytesIn;
+    xmlSecSize                          bytesOut;
+    xmlSecSize                          pushBinCalls;
+    xmlSecSize                          popBinCalls;
+    xmlSecSize                          pushXmlCalls;
+    xmlSecSize                          popXmlCalls;
+    double                              time;
+};
+
 /**
  * xmlSecTransform:
  * @id:                 the transform id (pointer to #xmlSecTransformId).
@@ -385,7 +469,7 @@ XMLSEC_EXPORT void                      xmlSecTransformCtxDebugXmlDump  (xmlSecT
  * @outBuf:             the output binary data buffer.
  * @inNodes:            the input XML nodes.
  * @outNodes:           the output XML nodes.
- * @reserved0:          reserved for the future.
+ * @reserved0:          the private data (do not touch).
  * @reserved1:          reserved for the future.
  *
  * The transform structure.
@@ -415,6 +499,7 @@ struct _xmlSecTransform {
 
 XMLSEC_EXPORT xmlSecTransformPtr        xmlSecTransformCreate   (xmlSecTransformId id);
 XMLSEC_EXPORT void                      xmlSecTransformDestroy  (xmlSecTransformPtr transform);
+XMLSEC_EXPORT void                      xmlSecTransformCacheFlush(void);
 XMLSEC_EXPORT xmlSecTransformPtr        xmlSecTransformNodeRead (xmlNodePtr node,
                                                                  xmlSecTransformUsage usage,
                                                                  xmlSecTransformCtxPtr transformCtx);
@@ -454,6 +539,7 @@ XMLSEC_EXPORT int                       xmlSecTransformPopXml   (xmlSecTransform
 XMLSEC_EXPORT int                       xmlSecTransformExecute  (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
+XMLSEC_EXPORT xmlSecTransformStatsPtr   xmlSecTransformGetStats (xmlSecTransformPtr transform);
 XMLSEC_EXPORT void                      xmlSecTransformDebugDump(xmlSecTransformPtr transform,
                                                                  FILE* output);
 XMLSEC_EXPORT void                      xmlSecTransformDebugXmlDump(xmlSecTransformPtr transform,
@@ -574,6 +660,20 @@ typedef int             (*xmlSecTransformInitializeMethod)      (xmlSecTransform
  */
 typedef void            (*xmlSecTransformFinalizeMethod)        (xmlSecTransformPtr transform);
 
+/**
+ * xmlSecTransformResetMethod:
+ * @transform:                  the pointer to transform object.
+ *
+ * The transform specific reset method: brings the transform from any
+ * state back to the state right after the initialization but keeps
+ * the allocated resources (e.g. the crypto library contexts). The
+ * transforms with this method are cached per-thread by
+ * #xmlSecTransformDestroy and reused by #xmlSecTransformCreate.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+typedef int             (*xmlSecTransformResetMethod)           (xmlSecTransformPtr transform);
+
 /**
  * xmlSecTransformGetDataTypeMethod:
  * @transform:                  the pointer to transform object.
@@ -761,7 +861,7 @@ typedef int             (*xmlSecTransformExecuteMethod)         (xmlSecTransform
  * @popXml:                     the XML data "pop from chain" procesing method.
  * @execute:                    the low level data processing method used  by default
  *                              implementations of @pushBin, @popBin, @pushXml and @popXml.
- * @reserved0:                  reserved for the future.
+ * @reset:                      the optional reset method (see #xmlSecTransformResetMethod).
  * @reserved1:                  reserved for the future.
  *
  * The transform klass desccription structure.
@@ -794,8 +894,10 @@ struct _xmlSecTransformKlass {
     /* low level method */
     xmlSecTransformExecuteMethod        execute;
 
+    /* optional reuse support */
+    xmlSecTransformResetMethod          reset;
+
     /* reserved for future */
-    void*                               reserved0;
     void*                               reserved1;
 };
 
@@ -820,6 +922,7 @@ struct _xmlSecTransformKlass {
  */
 #define xmlSecTransformIdListId xmlSecTransformIdListGetKlass()
 XMLSEC_EXPORT xmlSecPtrListId   xmlSecTransformIdListGetKlass   (void);
+XMLSEC_EXPORT int               xmlSecTransformIdListAddDefault (xmlSecPtrListPtr list);
 XMLSEC_EXPORT int               xmlSecTransformIdListFind       (xmlSecPtrListPtr list,
                                                                  xmlSecTransformId transformId);
 XMLSEC_EXPORT xmlSecTransformId xmlSecTransformIdListFindByHref (xmlSecPtrListPtr list,
@@ -910,6 +1013,15 @@ XMLSEC_EXPORT xmlSecTransformId xmlSecTransformExclC14NGetKlass         (void);
         xmlSecTransformExclC14NWithCommentsGetKlass()
 XMLSEC_EXPORT xmlSecTransformId xmlSecTransformExclC14NWithCommentsGetKlass(void);
 
+/**
+ * xmlSecTransformC14N2Id:
+ *
+ * The canonical XML 2.0 transform klass.
+ */
+#define xmlSecTransformC14N2Id \
+        xmlSecTransformC14N2GetKlass()
+XMLSEC_EXPORT xmlSecTransformId xmlSecTransformC14N2GetKlass            (void);
+
 /**
  * xmlSecTransformEnvelopedId:
  *
@@ -949,6 +1061,10 @@ XMLSEC_EXPORT int               xmlSecTransformXPointerSetExpr          (xmlSecT
                                                                          const xmlChar* expr,
                                                                          xmlSecNodeSetType nodeSetType,
                                                                          xmlNodePtr hereNode);
+XMLSEC_EXPORT void              xmlSecTransformXPathGetCacheStats       (xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
+XMLSEC_EXPORT void              xmlSecTransformXPathFlushCache          (void);
+
 /**
  * xmlSecTransformRelationshipId:
  *
@@ -970,6 +1086,7 @@ XMLSEC_EXPORT xmlSecTransformId xmlSecTransformRelationshipGetKlass     (void);
         xmlSecTransformXsltGetKlass()
 XMLSEC_EXPORT xmlSecTransformId xmlSecTransformXsltGetKlass             (void);
 XMLSEC_EXPORT void              xmlSecTransformXsltSetDefaultSecurityPrefs(xsltSecurityPrefsPtr sec);
+XMLSEC_EXPORT void              xmlSecTransformXsltSetCacheSize         (xmlSecSize maxSize);
 #endif /* XMLSEC_NO_XSLT */
 
 /**
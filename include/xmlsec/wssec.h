@@ -0,0 +1,94 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * WS-Security header processing.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_WSSEC_H__
+#define __XMLSEC_WSSEC_H__
+
+#ifndef XMLSEC_NO_SOAP
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libxml/tree.h>
+#include <libxml/hash.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/list.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/xmldsig.h>
+
+typedef struct _xmlSecWsSecHeader               xmlSecWsSecHeader,
+                                                *xmlSecWsSecHeaderPtr;
+
+/**
+ * xmlSecWsSecHeader:
+ * @keysMngr:           the pointer to keys manager.
+ * @keyInfoFlags:       the <dsig:KeyInfo/> reading flags for the signatures
+ *                      and the encrypted data (see #xmlSecKeyInfoCtx).
+ * @securityNode:       the <wsse:Security/> node.
+ * @timestampNode:      the <wsu:Timestamp/> node (if any).
+ * @ids:                the ID attributes names (NULL terminated list).
+ * @entries:            the <enc:EncryptedKey/>, <enc:ReferenceList/>,
+ *                      <enc:EncryptedData/> and <dsig:Signature/> header
+ *                      elements in the processing order.
+ * @tokens:             the header elements by their Id attributes.
+ * @sessionKeys:        the unwrapped <enc:EncryptedKey/> values.
+ * @status:             the signatures verification status.
+ * @signaturesNumber:   the number of verified signatures.
+ * @decryptedNumber:    the number of decrypted <enc:EncryptedData/> elements.
+ * @reserved0:          reserved for the future.
+ * @reserved1:          reserved for the future.
+ *
+ * The WS-Security header processing context. The header is indexed in
+ * one pass by #xmlSecWsSecHeaderRead and then #xmlSecWsSecHeaderProcess
+ * decrypts and verifies the header elements in the order they appear
+ * resolving <wsse:SecurityTokenReference/> elements with the tokens index.
+ */
+struct _xmlSecWsSecHeader {
+    xmlSecKeysMngrPtr           keysMngr;
+    unsigned int                keyInfoFlags;
+    xmlNodePtr                  securityNode;
+    xmlNodePtr                  timestampNode;
+    const xmlChar**             ids;
+
+    xmlSecPtrList               entries;
+    xmlHashTablePtr             tokens;
+    xmlHashTablePtr             sessionKeys;
+
+    xmlSecDSigStatus            status;
+    xmlSecSize                  signaturesNumber;
+    xmlSecSize                  decryptedNumber;
+
+    /* for the future */
+    void*                       reserved0;
+    void*                       reserved1;
+};
+
+XMLSEC_EXPORT int               xmlSecWsSecHeaderInitialize     (xmlSecWsSecHeaderPtr header,
+                                                                 xmlSecKeysMngrPtr keysMngr);
+XMLSEC_EXPORT void              xmlSecWsSecHeaderFinalize       (xmlSecWsSecHeaderPtr header);
+XMLSEC_EXPORT xmlNodePtr        xmlSecWsSecFindSecurity         (xmlNodePtr envNode);
+XMLSEC_EXPORT int               xmlSecWsSecHeaderRead           (xmlSecWsSecHeaderPtr header,
+                                                                 xmlNodePtr securityNode,
+                                                                 const xmlChar** ids);
+XMLSEC_EXPORT xmlNodePtr        xmlSecWsSecHeaderFindToken      (xmlSecWsSecHeaderPtr header,
+                                                                 const xmlChar* id);
+XMLSEC_EXPORT xmlNodePtr        xmlSecWsSecHeaderResolveTokenReference(xmlSecWsSecHeaderPtr header,
+                                                                 xmlNodePtr strNode);
+XMLSEC_EXPORT int               xmlSecWsSecHeaderProcess        (xmlSecWsSecHeaderPtr header);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* XMLSEC_NO_SOAP */
+
+#endif /* __XMLSEC_WSSEC_H__ */
@@ -34,6 +34,14 @@ extern "C" {
 typedef struct _xmlSecDSigReferenceCtx          xmlSecDSigReferenceCtx,
                                                 *xmlSecDSigReferenceCtxPtr;
 
+/**
+ * xmlSecDSigTemplate:
+ *
+ * The compiled signature template (opaque).
+ */
+typedef struct _xmlSecDSigTemplate              xmlSecDSigTemplate,
+                                                *xmlSecDSigTemplatePtr;
+
 /**
  * xmlSecDSigStatus:
  * @xmlSecDSigStatusUnknown:    the status is unknown.
@@ -94,6 +102,87 @@ typedef enum {
  */
 #define XMLSEC_DSIG_FLAGS_USE_VISA3D_HACK                       0x00000010
 
+/**
+ * XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES:
+ *
+ * If this flag is set then <dsig:Reference/> children of <dsig:SignedInfo/>
+ * and <dsig:Manifest/> elements are processed concurrently using a worker
+ * thread per CPU. The document must not be modified (or used by any other
+ * code) while the signature is processed. The signature status is determined
+ * in the same order as without this flag but all the references are processed
+ * (and added to the references lists) even if one of them fails. When signing,
+ * the <dsig:DigestValue/> nodes are written after all the digests of the same
+ * <dsig:SignedInfo/> or <dsig:Manifest/> element are calculated, so these
+ * references must not cover each other's <dsig:DigestValue/> nodes. The
+ * external URIs are read concurrently, the registered IO callbacks must be
+ * thread safe. The flag is ignored if xmlsec is built without threads support.
+ */
+#define XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES                   0x00000020
+
+/**
+ * XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST:
+ *
+ * If this flag is set then <dsig:SignatureValue/> is verified before
+ * the <dsig:Reference/> digests are calculated and the references are not
+ * processed at all if the signature value is invalid. This limits the cost
+ * of processing the forged documents to one signature verification.
+ * The flag is ignored when signing.
+ */
+#define XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST                0x00000040
+
+/**
+ * XMLSEC_DSIG_FLAGS_PREFETCH_REFERENCES:
+ *
+ * If this flag is set then the external URIs of all <dsig:Reference/>
+ * children of <dsig:SignedInfo/> element are read concurrently in the
+ * background before the references are processed; the digests are
+ * calculated as the data arrives. Only the URIs allowed by
+ * enabledReferenceUris are read (before the referencePreExecuteCallback
+ * is called). The flag is ignored if xmlsec is built without threads support.
+ */
+#define XMLSEC_DSIG_FLAGS_PREFETCH_REFERENCES                   0x00000080
+
+/**
+ * XMLSEC_DSIG_FLAGS_IDS_ADDED:
+ *
+ * If this flag is set then the "Id" attributes are not added to the
+ * document IDs hash before the signature is processed: the application
+ * already did it with one #xmlSecAddIDs call for the whole document
+ * (e.g. before verifying several signatures in the same document).
+ */
+#define XMLSEC_DSIG_FLAGS_IDS_ADDED                             0x00000100
+
+/**
+ * XMLSEC_DSIG_FLAGS_PINNED_KEY:
+ *
+ * If this flag is set then the signKey set by the application is the only
+ * key allowed: the <dsig:KeyInfo/> node is neither read (no keys manager
+ * lookup, no X509Data or KeyValue parsing) nor written when signing. The
+ * key still has to match the signature method requirements and the
+ * processing fails if the signKey is not set.
+ */
+#define XMLSEC_DSIG_FLAGS_PINNED_KEY                            0x00000200
+
+/**
+ * xmlSecDSigReferenceDigestCallback:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> processing context.
+ * @digest:             the pointer to the output buffer for the binary digest value.
+ *
+ * Lets the application supply the trusted precomputed digest of the
+ * <dsig:Reference/> to the external object (e.g. kept by the storage
+ * layer) instead of reading and digesting it (see
+ * #xmlSecDSigCtxSetReferenceDigestCallback). The URI is in the #uri
+ * member of @dsigRefCtx, the transforms are in its #transformCtx (from
+ * #first up to the #digestMethod that identifies the digest algorithm).
+ * The pre-digest buffer (see #xmlSecDSigReferenceCtxGetPreDigestBuffer)
+ * is empty for such references.
+ *
+ * Returns: 1 if the digest is written to @digest, 0 if the reference should
+ * be processed as usual or a negative value if an error occurs.
+ */
+typedef int             (*xmlSecDSigReferenceDigestCallback)    (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                                 xmlSecBufferPtr digest);
+
 /**
  * xmlSecDSigCtx:
  * @userData:                   the pointer to user data (xmlsec and xmlsec-crypto libraries
@@ -123,8 +212,8 @@ typedef enum {
  * @id:                         the pointer to Id attribute of <dsig:Signature/> node.
  * @signedInfoReferences:       the list of references in <dsig:SignedInfo/> node.
  * @manifestReferences:         the list of references in <dsig:Manifest/> nodes.
- * @reserved0:                  reserved for the future.
- * @reserved1:                  reserved for the future.
+ * @reserved0:                  the private data (do not touch).
+ * @reserved1:                  the private data (do not touch).
  *
  * XML DSig processing context.
  */
@@ -167,10 +256,42 @@ XMLSEC_EXPORT void              xmlSecDSigCtxDestroy            (xmlSecDSigCtxPt
 XMLSEC_EXPORT int               xmlSecDSigCtxInitialize         (xmlSecDSigCtxPtr dsigCtx,
                                                                  xmlSecKeysMngrPtr keysMngr);
 XMLSEC_EXPORT void              xmlSecDSigCtxFinalize           (xmlSecDSigCtxPtr dsigCtx);
+XMLSEC_EXPORT void              xmlSecDSigCtxReset              (xmlSecDSigCtxPtr dsigCtx);
+XMLSEC_EXPORT int               xmlSecDSigCtxSetMaxReferences   (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecSize maxReferences);
+XMLSEC_EXPORT int               xmlSecDSigCtxSetReferenceDigestCallback(xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigReferenceDigestCallback callback);
 XMLSEC_EXPORT int               xmlSecDSigCtxSign               (xmlSecDSigCtxPtr dsigCtx,
                                                                  xmlNodePtr tmpl);
 XMLSEC_EXPORT int               xmlSecDSigCtxVerify             (xmlSecDSigCtxPtr dsigCtx,
                                                                  xmlNodePtr node);
+XMLSEC_EXPORT int               xmlSecDSigCtxVerifyBatch        (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlNodePtr* nodes,
+                                                                 xmlSecSize nodesSize,
+                                                                 xmlSecDSigStatus* statuses);
+XMLSEC_EXPORT int               xmlSecDSigCtxVerifyParallel     (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlNodePtr* nodes,
+                                                                 xmlSecSize nodesSize,
+                                                                 xmlSecDSigStatus* statuses);
+XMLSEC_EXPORT xmlSecDSigReferenceCtxPtr xmlSecDSigCtxVerifyManifestReference(xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecSize pos);
+XMLSEC_EXPORT int               xmlSecDSigCtxSignWithTemplate   (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigTemplatePtr compiledTmpl,
+                                                                 xmlNodePtr tmpl);
+XMLSEC_EXPORT int               xmlSecDSigCtxSignBatch          (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigTemplatePtr compiledTmpl,
+                                                                 xmlNodePtr* tmpls,
+                                                                 xmlSecSize tmplsSize,
+                                                                 xmlSecDSigStatus* statuses);
+XMLSEC_EXPORT int               xmlSecDSigCtxResign             (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlNodePtr node,
+                                                                 xmlNodePtr* changedNodes,
+                                                                 xmlSecSize changedNodesSize);
+XMLSEC_EXPORT int               xmlSecDSigCtxSignFile           (xmlSecDSigCtxPtr dsigCtx,
+                                                                 const char* filename,
+                                                                 xmlOutputBufferPtr output);
+XMLSEC_EXPORT int               xmlSecDSigCtxVerifyFile         (xmlSecDSigCtxPtr dsigCtx,
+                                                                 const char* filename);
 XMLSEC_EXPORT int               xmlSecDSigCtxEnableReferenceTransform(xmlSecDSigCtxPtr dsigCtx,
                                                                 xmlSecTransformId transformId);
 XMLSEC_EXPORT int               xmlSecDSigCtxEnableSignatureTransform(xmlSecDSigCtxPtr dsigCtx,
@@ -181,6 +302,24 @@ XMLSEC_EXPORT void              xmlSecDSigCtxDebugDump          (xmlSecDSigCtxPt
 XMLSEC_EXPORT void              xmlSecDSigCtxDebugXmlDump       (xmlSecDSigCtxPtr dsigCtx,
                                                                  FILE* output);
 
+/**************************************************************************
+ *
+ * xmlSecDSigTemplate: the <dsig:Signature/> template with the transforms
+ * resolved once for signing many documents
+ *
+ *************************************************************************/
+XMLSEC_EXPORT xmlSecDSigTemplatePtr xmlSecDSigTemplateCreate    (xmlNodePtr tmpl);
+XMLSEC_EXPORT void              xmlSecDSigTemplateDestroy       (xmlSecDSigTemplatePtr compiledTmpl);
+
+/**************************************************************************
+ *
+ * The per-document cache of the canonical <dsig:SignedInfo/> bytes
+ * and <dsig:Reference/> digests
+ *
+ *************************************************************************/
+XMLSEC_EXPORT int               xmlSecDSigDocCacheEnable        (xmlDocPtr doc);
+XMLSEC_EXPORT void              xmlSecDSigDocCacheDisable       (xmlDocPtr doc);
+XMLSEC_EXPORT void              xmlSecDSigDocCacheInvalidate    (xmlDocPtr doc);
 
 /**************************************************************************
  *
@@ -49,6 +49,17 @@ typedef enum {
  */
 #define XMLSEC_ENC_RETURN_REPLACED_NODE                 0x00000001
 
+/**
+ * XMLSEC_ENC_LAZY_DECRYPTED_DATA:
+ *
+ * If this flag is set, then the decrypted XML element or content is not
+ * parsed: the <enc:EncryptedData/> node is replaced with a text node that
+ * holds the decrypted data and is written as is when the document is saved
+ * (in the UTF-8 encoding). Use #xmlSecEncParseLazyDecryptedNodes to get
+ * the parsed nodes.
+ */
+#define XMLSEC_ENC_LAZY_DECRYPTED_DATA                  0x00000002
+
 /**
  * xmlSecEncCtx:
  * @userData:                   the pointer to user data (xmlsec and xmlsec-crypto libraries
@@ -141,13 +152,39 @@ XMLSEC_EXPORT int               xmlSecEncCtxBinaryEncrypt       (xmlSecEncCtxPtr
 XMLSEC_EXPORT int               xmlSecEncCtxXmlEncrypt          (xmlSecEncCtxPtr encCtx,
                                                                  xmlNodePtr tmpl,
                                                                  xmlNodePtr node);
+XMLSEC_EXPORT int               xmlSecEncCtxXmlEncryptMultiple  (xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr tmpl,
+                                                                 xmlNodePtr* nodes,
+                                                                 xmlSecSize nodesSize);
 XMLSEC_EXPORT int               xmlSecEncCtxUriEncrypt          (xmlSecEncCtxPtr encCtx,
                                                                  xmlNodePtr tmpl,
                                                                  const xmlChar *uri);
+XMLSEC_EXPORT int               xmlSecEncCtxBinaryEncryptToOutput(xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr tmpl,
+                                                                 const xmlSecByte* data,
+                                                                 xmlSecSize dataSize,
+                                                                 xmlOutputBufferPtr output);
+XMLSEC_EXPORT int               xmlSecEncCtxUriEncryptToOutput  (xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr tmpl,
+                                                                 const xmlChar *uri,
+                                                                 xmlOutputBufferPtr output);
+XMLSEC_EXPORT int               xmlSecEncCtxXmlEncryptToOutput  (xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr tmpl,
+                                                                 xmlNodePtr node,
+                                                                 xmlOutputBufferPtr output);
 XMLSEC_EXPORT int               xmlSecEncCtxDecrypt             (xmlSecEncCtxPtr encCtx,
                                                                  xmlNodePtr node);
 XMLSEC_EXPORT xmlSecBufferPtr   xmlSecEncCtxDecryptToBuffer     (xmlSecEncCtxPtr encCtx,
                                                                  xmlNodePtr node                );
+XMLSEC_EXPORT int               xmlSecEncCtxDecryptToOutput     (xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr node,
+                                                                 xmlOutputBufferPtr output);
+XMLSEC_EXPORT int               xmlSecEncCtxDecryptParallel     (xmlSecEncCtxPtr encCtx,
+                                                                 xmlNodePtr* nodes,
+                                                                 xmlSecSize nodesSize,
+                                                                 int* results);
+XMLSEC_EXPORT int               xmlSecEncIsLazyDecryptedNode    (xmlNodePtr node);
+XMLSEC_EXPORT int               xmlSecEncParseLazyDecryptedNodes(xmlNodePtr node);
 XMLSEC_EXPORT void              xmlSecEncCtxDebugDump           (xmlSecEncCtxPtr encCtx,
                                                                  FILE* output);
 XMLSEC_EXPORT void              xmlSecEncCtxDebugXmlDump        (xmlSecEncCtxPtr encCtx,
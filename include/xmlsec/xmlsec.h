@@ -45,6 +45,17 @@ typedef void*                                   xmlSecPtr;
 #define xmlSecSize                              size_t
 #endif /* XMLSEC_NO_SIZE_T */
 
+/**
+ * XMLSEC_SIZE_FMT:
+ *
+ * The printf format for #xmlSecSize.
+ */
+#ifdef XMLSEC_NO_SIZE_T
+#define XMLSEC_SIZE_FMT                         "%u"
+#else  /* XMLSEC_NO_SIZE_T */
+#define XMLSEC_SIZE_FMT                         "%zu"
+#endif /* XMLSEC_NO_SIZE_T */
+
 /**
  * XMLSEC_SIZE_BAD_CAST:
  * @val:        the value to cast
@@ -74,6 +85,7 @@ typedef struct _xmlSecKeyStore                  xmlSecKeyStore, *xmlSecKeyStoreP
 typedef struct _xmlSecKeysMngr                  xmlSecKeysMngr, *xmlSecKeysMngrPtr;
 typedef struct _xmlSecTransform                 xmlSecTransform, *xmlSecTransformPtr;
 typedef struct _xmlSecTransformCtx              xmlSecTransformCtx, *xmlSecTransformCtxPtr;
+typedef struct _xmlSecAttachmentResolver        xmlSecAttachmentResolver, *xmlSecAttachmentResolverPtr;
 
 #ifndef XMLSEC_NO_XMLDSIG
 typedef struct _xmlSecDSigCtx                   xmlSecDSigCtx, *xmlSecDSigCtxPtr;
@@ -85,6 +97,7 @@ typedef struct _xmlSecEncCtx                    xmlSecEncCtx, *xmlSecEncCtxPtr;
 
 XMLSEC_EXPORT int                               xmlSecInit              (void);
 XMLSEC_EXPORT int                               xmlSecShutdown          (void);
+XMLSEC_EXPORT int                               xmlSecRegistriesFreeze  (void);
 XMLSEC_EXPORT const xmlChar *                   xmlSecGetDefaultCrypto  (void);
 XMLSEC_EXPORT void                              xmlSecSetExternalEntityLoader (xmlExternalEntityLoader);
 
@@ -114,6 +127,78 @@ XMLSEC_EXPORT void                              xmlSecSetExternalEntityLoader (x
 #define XMLSEC_DEPRECATED
 #endif /* !defined(IN_XMLSEC) */
 
+/***********************************************************************
+ *
+ * Tracing
+ *
+ ***********************************************************************/
+/**
+ * xmlSecTracePhase:
+ * @xmlSecTracePhaseSignedInfo:         the <dsig:SignedInfo/> canonicalization
+ *                                      and digest (and the signature calculation
+ *                                      when signing).
+ * @xmlSecTracePhaseReference:          the <dsig:Reference/> node processing
+ *                                      (including the digest calculation).
+ * @xmlSecTracePhaseKeyInfo:            the key resolution for the <dsig:KeyInfo/>
+ *                                      node (might be NULL).
+ * @xmlSecTracePhaseX509Verify:         the certificates chain verification.
+ * @xmlSecTracePhaseSignatureVerify:    the <dsig:SignatureValue/> verification.
+ * @xmlSecTracePhaseCipher:             the <enc:EncryptedData/> or <enc:EncryptedKey/>
+ *                                      cipher transforms chain execution.
+ *
+ * The processing phase reported to the tracing callbacks.
+ */
+typedef enum {
+    xmlSecTracePhaseSignedInfo = 0,
+    xmlSecTracePhaseReference,
+    xmlSecTracePhaseKeyInfo,
+    xmlSecTracePhaseX509Verify,
+    xmlSecTracePhaseSignatureVerify,
+    xmlSecTracePhaseCipher
+} xmlSecTracePhase;
+
+/**
+ * xmlSecTraceBeginCallback:
+ * @phase:              the processing phase.
+ * @node:               the node processed in this phase (might be NULL).
+ * @userData:           the user data from the processing context: the
+ *                      #xmlSecDSigCtx or #xmlSecEncCtx userData for most phases
+ *                      and the #xmlSecKeyInfoCtx userData for
+ *                      #xmlSecTracePhaseX509Verify.
+ *
+ * The callback called when a processing phase starts. The callback
+ * might be called from several threads at once (see
+ * #XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES).
+ *
+ * Returns: the span pointer passed to the #xmlSecTraceEndCallback for
+ * this phase (might be NULL).
+ */
+typedef void*           (*xmlSecTraceBeginCallback)             (xmlSecTracePhase phase,
+                                                                 xmlNodePtr node,
+                                                                 void* userData);
+
+/**
+ * xmlSecTraceEndCallback:
+ * @span:               the span pointer returned by #xmlSecTraceBeginCallback.
+ * @phase:              the processing phase.
+ * @result:             the phase result: 0 on success or a negative value
+ *                      if an error occurs.
+ *
+ * The callback called when a processing phase ends.
+ */
+typedef void            (*xmlSecTraceEndCallback)               (void* span,
+                                                                 xmlSecTracePhase phase,
+                                                                 int result);
+
+XMLSEC_EXPORT void      xmlSecTraceSetCallbacks (xmlSecTraceBeginCallback beginCallback,
+                                                 xmlSecTraceEndCallback endCallback);
+XMLSEC_EXPORT void*     xmlSecTraceBegin        (xmlSecTracePhase phase,
+                                                 xmlNodePtr node,
+                                                 void* userData);
+XMLSEC_EXPORT void      xmlSecTraceEnd          (void* span,
+                                                 xmlSecTracePhase phase,
+                                                 int result);
+
 /***********************************************************************
  *
  * Version checking
@@ -50,6 +50,21 @@ XMLSEC_EXPORT xmlNodePtr        xmlSecFindParent        (const xmlNodePtr cur,
 XMLSEC_EXPORT xmlNodePtr        xmlSecFindNode          (const xmlNodePtr parent,
                                                          const xmlChar *name,
                                                          const xmlChar *ns);
+
+/**
+ * XMLSEC_FIND_NODES_ID_INDEX:
+ *
+ * #xmlSecFindNodes looks up only the nodes registered in the document
+ * ID index instead of scanning the tree.
+ */
+#define XMLSEC_FIND_NODES_ID_INDEX                      0x00000001
+
+XMLSEC_EXPORT int               xmlSecFindNodes         (const xmlNodePtr parent,
+                                                         const xmlChar *name,
+                                                         const xmlChar *ns,
+                                                         int flags,
+                                                         xmlNodePtr** nodes,
+                                                         xmlSecSize* nodesSize);
 XMLSEC_EXPORT xmlNodePtr        xmlSecAddChild          (xmlNodePtr parent,
                                                          const xmlChar *name,
                                                          const xmlChar *ns);
@@ -102,6 +117,9 @@ XMLSEC_EXPORT xmlChar*          xmlSecGetQName          (xmlNodePtr node,
 
 XMLSEC_EXPORT int               xmlSecPrintXmlString    (FILE * fd,
                                                          const xmlChar * str);
+XMLSEC_EXPORT int               xmlSecWriteFileWithNode (const char* filename,
+                                                         xmlNodePtr node,
+                                                         xmlOutputBufferPtr output);
 
 /**
  * xmlSecIsHex:
@@ -168,6 +168,44 @@ xmlSecKeyDataEcdsaGetKlass(void) {
     return(xmlSecCryptoDLGetFunctions()->keyDataEcdsaGetKlass());
 }
 
+/**
+ * xmlSecKeyDataEd25519GetKlass:
+ *
+ * The Ed25519 key data klass.
+ *
+ * Returns: Ed25519 key data klass or NULL if an error occurs
+ * (xmlsec-crypto library is not loaded or the Ed25519 key data
+ * klass is not implemented).
+ */
+xmlSecKeyDataId
+xmlSecKeyDataEd25519GetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->keyDataEd25519GetKlass == NULL)) {
+        xmlSecNotImplementedError("keyDataEd25519GetKlass");
+        return(xmlSecKeyDataIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->keyDataEd25519GetKlass());
+}
+
+/**
+ * xmlSecKeyDataEd448GetKlass:
+ *
+ * The Ed448 key data klass.
+ *
+ * Returns: Ed448 key data klass or NULL if an error occurs
+ * (xmlsec-crypto library is not loaded or the Ed448 key data
+ * klass is not implemented).
+ */
+xmlSecKeyDataId
+xmlSecKeyDataEd448GetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->keyDataEd448GetKlass == NULL)) {
+        xmlSecNotImplementedError("keyDataEd448GetKlass");
+        return(xmlSecKeyDataIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->keyDataEd448GetKlass());
+}
+
 /**
  * xmlSecKeyDataGost2001GetKlass:
  *
@@ -387,6 +425,63 @@ xmlSecTransformAes256CbcGetKlass(void) {
     return(xmlSecCryptoDLGetFunctions()->transformAes256CbcGetKlass());
 }
 
+/**
+ * xmlSecTransformAes128GcmGetKlass:
+ *
+ * AES 128 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 128 GCM encryption transform or NULL if an error
+ * occurs (the xmlsec-crypto library is not loaded or this transform is not
+ * implemented).
+ */
+xmlSecTransformId
+xmlSecTransformAes128GcmGetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->transformAes128GcmGetKlass == NULL)) {
+        xmlSecNotImplementedError("transformAes128GcmGetKlass");
+        return(xmlSecTransformIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->transformAes128GcmGetKlass());
+}
+
+/**
+ * xmlSecTransformAes192GcmGetKlass:
+ *
+ * AES 192 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 192 GCM encryption transform or NULL if an error
+ * occurs (the xmlsec-crypto library is not loaded or this transform is not
+ * implemented).
+ */
+xmlSecTransformId
+xmlSecTransformAes192GcmGetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->transformAes192GcmGetKlass == NULL)) {
+        xmlSecNotImplementedError("transformAes192GcmGetKlass");
+        return(xmlSecTransformIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->transformAes192GcmGetKlass());
+}
+
+/**
+ * xmlSecTransformAes256GcmGetKlass:
+ *
+ * AES 256 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 256 GCM encryption transform or NULL if an error
+ * occurs (the xmlsec-crypto library is not loaded or this transform is not
+ * implemented).
+ */
+xmlSecTransformId
+xmlSecTransformAes256GcmGetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->transformAes256GcmGetKlass == NULL)) {
+        xmlSecNotImplementedError("transformAes256GcmGetKlass");
+        return(xmlSecTransformIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->transformAes256GcmGetKlass());
+}
+
 /**
  * xmlSecTransformKWAes128GetKlass:
  *
@@ -615,6 +710,44 @@ xmlSecTransformEcdsaSha512GetKlass(void) {
     return(xmlSecCryptoDLGetFunctions()->transformEcdsaSha512GetKlass());
 }
 
+/**
+ * xmlSecTransformEd25519GetKlass:
+ *
+ * The EdDSA Ed25519 signature transform klass.
+ *
+ * Returns: EdDSA Ed25519 signature transform klass or NULL if an error
+ * occurs (the xmlsec-crypto library is not loaded or this transform is not
+ * implemented).
+ */
+xmlSecTransformId
+xmlSecTransformEd25519GetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->transformEd25519GetKlass == NULL)) {
+        xmlSecNotImplementedError("transformEd25519GetKlass");
+        return(xmlSecTransformIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->transformEd25519GetKlass());
+}
+
+/**
+ * xmlSecTransformEd448GetKlass:
+ *
+ * The EdDSA Ed448 signature transform klass.
+ *
+ * Returns: EdDSA Ed448 signature transform klass or NULL if an error
+ * occurs (the xmlsec-crypto library is not loaded or this transform is not
+ * implemented).
+ */
+xmlSecTransformId
+xmlSecTransformEd448GetKlass(void) {
+    if((xmlSecCryptoDLGetFunctions() == NULL) || (xmlSecCryptoDLGetFunctions()->transformEd448GetKlass == NULL)) {
+        xmlSecNotImplementedError("transformEd448GetKlass");
+        return(xmlSecTransformIdUnknown);
+    }
+
+    return(xmlSecCryptoDLGetFunctions()->transformEd448GetKlass());
+}
+
 /**
  * xmlSecTransformGost2001GostR3411_94GetKlass:
  *
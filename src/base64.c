@@ -15,13 +15,18 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/base64.h>
+#include <xmlsec/nodeset.h>
+#include <xmlsec/executor.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/transforms.h>
+
 /*
  * the table to map numbers to base64
  */
@@ -38,6 +43,30 @@ static const xmlSecByte base64[] =
     '4', '5', '6', '7', '8', '9', '+', '/'  /* 7 */
 };
 
+/*
+ * the table to map base64 characters to numbers (0xFF for all other characters)
+ */
+static const xmlSecByte base64Reverse[256] =
+{
+/*   0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F   */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 0 */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 1 */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F, /* 2 */
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 3 */
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, /* 4 */
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 5 */
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, /* 6 */
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 7 */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 8 */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* 9 */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* A */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* B */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* C */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* D */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, /* E */
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF  /* F */
+};
+
 
 /* few macros to simplify the code */
 #define xmlSecBase64Encode1(a)          (((a) >> 2) & 0x3F)
@@ -88,6 +117,20 @@ static xmlSecBase64Status       xmlSecBase64CtxEncodeByteFinal  (xmlSecBase64Ctx
 static xmlSecBase64Status       xmlSecBase64CtxDecodeByte       (xmlSecBase64CtxPtr ctx,
                                                                  xmlSecByte inByte,
                                                                  xmlSecByte* outByte);
+static void                     xmlSecBase64CtxEncodeBlocks     (xmlSecBase64CtxPtr ctx,
+                                                                 const xmlSecByte* inBuf,
+                                                                 xmlSecSize inBufSize,
+                                                                 xmlSecSize* inBufResSize,
+                                                                 xmlSecByte* outBuf,
+                                                                 xmlSecSize outBufSize,
+                                                                 xmlSecSize* outBufResSize);
+static void                     xmlSecBase64CtxDecodeBlocks     (xmlSecBase64CtxPtr ctx,
+                                                                 const xmlSecByte* inBuf,
+                                                                 xmlSecSize inBufSize,
+                                                                 xmlSecSize* inBufResSize,
+                                                                 xmlSecByte* outBuf,
+                                                                 xmlSecSize outBufSize,
+                                                                 xmlSecSize* outBufResSize);
 static int                      xmlSecBase64CtxEncode           (xmlSecBase64CtxPtr ctx,
                                                                  const xmlSecByte* inBuf,
                                                                  xmlSecSize inBufSize,
@@ -107,6 +150,13 @@ static int                      xmlSecBase64CtxDecode           (xmlSecBase64Ctx
                                                                  xmlSecSize outBufSize,
                                                                  xmlSecSize* outBufResSize);
 static int                      xmlSecBase64CtxDecodeIsFinished (xmlSecBase64CtxPtr ctx);
+static int                      xmlSecBase64CtxDecodeParallel   (xmlSecBase64CtxPtr ctx,
+                                                                 const xmlSecByte* inBuf,
+                                                                 xmlSecSize inBufSize,
+                                                                 xmlSecSize* inBufResSize,
+                                                                 xmlSecByte* outBuf,
+                                                                 xmlSecSize outBufSize,
+                                                                 xmlSecSize* outBufResSize);
 
 
 static int g_xmlsec_base64_default_line_size = XMLSEC_BASE64_LINESIZE;
@@ -249,7 +299,7 @@ xmlSecBase64CtxUpdate(xmlSecBase64CtxPtr ctx,
             return(-1);
         }
     } else {
-        ret = xmlSecBase64CtxDecode(ctx, in, inSize, &inResSize,
+        ret = xmlSecBase64CtxDecodeParallel(ctx, in, inSize, &inResSize,
                                     out, outSize, &outResSize);
         if((ret < 0) || (inResSize != inSize)) {
             xmlSecInternalError("xmlSecBase64CtxDecode", NULL);
@@ -437,12 +487,101 @@ xmlSecBase64CtxDecodeByte(xmlSecBase64CtxPtr ctx, xmlSecByte inByte, xmlSecByte*
 }
 
 
+/*
+ * Encodes as many complete 3 bytes blocks as possible, one output quad
+ * at a time. Stops before a block that would cross the line end, the
+ * byte-by-byte state machine takes care of it.
+ */
+static void
+xmlSecBase64CtxEncodeBlocks(xmlSecBase64CtxPtr ctx,
+                     const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
+                     xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
+    xmlSecSize inPos = 0, outPos = 0;
+    xmlSecByte a, b, c;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->inPos == 0);
+    xmlSecAssert(inBuf != NULL);
+    xmlSecAssert(inBufResSize != NULL);
+    xmlSecAssert(outBuf != NULL);
+    xmlSecAssert(outBufResSize != NULL);
+
+    while((inPos + 3 <= inBufSize) && (outPos + 4 <= outBufSize)) {
+        if(ctx->columns > 0) {
+            if(ctx->linePos >= ctx->columns) {
+                outBuf[outPos++] = '\n';
+                ctx->linePos = 0;
+                continue;
+            }
+            if(ctx->linePos + 4 > ctx->columns) {
+                break;
+            }
+        }
+
+        a = inBuf[inPos];
+        b = inBuf[inPos + 1];
+        c = inBuf[inPos + 2];
+        outBuf[outPos]     = base64[xmlSecBase64Encode1(a)];
+        outBuf[outPos + 1] = base64[xmlSecBase64Encode2(a, b)];
+        outBuf[outPos + 2] = base64[xmlSecBase64Encode3(b, c)];
+        outBuf[outPos + 3] = base64[xmlSecBase64Encode4(c)];
+
+        inPos  += 3;
+        outPos += 4;
+        ctx->linePos += 4;
+    }
+
+    (*inBufResSize)  = inPos;
+    (*outBufResSize) = outPos;
+}
+
+/*
+ * Decodes as many complete 4 characters blocks as possible. Stops at
+ * the first block with anything but base64 characters (spaces, padding,
+ * invalid characters), the byte-by-byte state machine takes care of it.
+ */
+static void
+xmlSecBase64CtxDecodeBlocks(xmlSecBase64CtxPtr ctx,
+                     const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
+                     xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
+    xmlSecSize inPos = 0, outPos = 0;
+    xmlSecByte a, b, c, d;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->inPos == 0);
+    xmlSecAssert(inBuf != NULL);
+    xmlSecAssert(inBufResSize != NULL);
+    xmlSecAssert(outBuf != NULL);
+    xmlSecAssert(outBufResSize != NULL);
+
+    while((inPos + 4 <= inBufSize) && (outPos + 3 <= outBufSize)) {
+        a = base64Reverse[inBuf[inPos]];
+        b = base64Reverse[inBuf[inPos + 1]];
+        c = base64Reverse[inBuf[inPos + 2]];
+        d = base64Reverse[inBuf[inPos + 3]];
+        if(((a | b | c | d) & 0xC0) != 0) {
+            break;
+        }
+
+        outBuf[outPos]     = (xmlSecByte)xmlSecBase64Decode1(a, b);
+        outBuf[outPos + 1] = (xmlSecByte)xmlSecBase64Decode2(b, c);
+        outBuf[outPos + 2] = (xmlSecByte)xmlSecBase64Decode3(c, d);
+
+        inPos  += 4;
+        outPos += 3;
+    }
+
+    (*inBufResSize)  = inPos;
+    (*outBufResSize) = outPos;
+}
+
 static int
 xmlSecBase64CtxEncode(xmlSecBase64CtxPtr ctx,
                      const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
                      xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
     xmlSecBase64Status status = xmlSecBase64StatusNext;
     xmlSecSize inPos, outPos;
+    xmlSecSize inSize, outSize;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(inBuf != NULL, -1);
@@ -452,6 +591,17 @@ xmlSecBase64CtxEncode(xmlSecBase64CtxPtr ctx,
 
     /* encode */
     for(inPos = outPos = 0; (inPos < inBufSize) && (outPos < outBufSize); ) {
+        /* fast path for complete blocks */
+        if(ctx->inPos == 0) {
+            xmlSecBase64CtxEncodeBlocks(ctx, inBuf + inPos, inBufSize - inPos, &inSize,
+                                        outBuf + outPos, outBufSize - outPos, &outSize);
+            inPos  += inSize;
+            outPos += outSize;
+            if((inPos >= inBufSize) || (outPos >= outBufSize)) {
+                break;
+            }
+        }
+
         status = xmlSecBase64CtxEncodeByte(ctx, inBuf[inPos], &(outBuf[outPos]));
         switch(status) {
             case xmlSecBase64StatusConsumeAndNext:
@@ -521,6 +671,7 @@ xmlSecBase64CtxDecode(xmlSecBase64CtxPtr ctx,
                      xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
     xmlSecBase64Status status = xmlSecBase64StatusNext;
     xmlSecSize inPos, outPos;
+    xmlSecSize inSize, outSize;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(inBuf != NULL, -1);
@@ -530,6 +681,25 @@ xmlSecBase64CtxDecode(xmlSecBase64CtxPtr ctx,
 
     /* decode */
     for(inPos = outPos = 0; (inPos < inBufSize) && (outPos < outBufSize) && (status != xmlSecBase64StatusDone); ) {
+        /* fast path for complete blocks */
+        if((ctx->inPos == 0) && (ctx->finished == 0)) {
+            xmlSecBase64CtxDecodeBlocks(ctx, inBuf + inPos, inBufSize - inPos, &inSize,
+                                        outBuf + outPos, outBufSize - outPos, &outSize);
+            inPos  += inSize;
+            outPos += outSize;
+            if((inPos >= inBufSize) || (outPos >= outBufSize)) {
+                break;
+            }
+        }
+
+        /* spaces are ignored in any state: skip them all at once */
+        if(xmlSecIsBase64Space(inBuf[inPos])) {
+            while((inPos < inBufSize) && xmlSecIsBase64Space(inBuf[inPos])) {
+                ++inPos;
+            }
+            continue;
+        }
+
         status = xmlSecBase64CtxDecodeByte(ctx, inBuf[inPos], &(outBuf[outPos]));
         switch(status) {
             case xmlSecBase64StatusConsumeAndNext:
@@ -568,6 +738,235 @@ xmlSecBase64CtxDecodeIsFinished(xmlSecBase64CtxPtr ctx) {
     return((ctx->inPos == 0) ? 1 : 0);
 }
 
+/***********************************************************************
+ *
+ * Parallel decoding: the input is split into chunks that start at
+ * the 4 characters blocks boundaries (the base64 characters in each chunk
+ * are counted first since the spaces can be anywhere) and the chunks
+ * are decoded by the executor tasks with their own contexts directly
+ * to their places in the output buffer. Only the last chunk may have
+ * the padding or invalid characters, otherwise the input is decoded
+ * sequentially.
+ *
+ ***********************************************************************/
+#define XMLSEC_BASE64_PARALLEL_MIN_CHUNK_SIZE   262144
+#define XMLSEC_BASE64_PARALLEL_MAX_CHUNKS       16
+
+typedef struct _xmlSecBase64DecodeChunk {
+    const xmlSecByte*   in;
+    xmlSecSize          inSize;
+    xmlSecSize          count;          /* the number of non space characters */
+    int                 plain;          /* only base64 characters and spaces */
+
+    xmlSecBase64Ctx     ctx;
+    xmlSecByte*         out;
+    xmlSecSize          outSize;
+    xmlSecSize          outResSize;
+    int                 result;
+} xmlSecBase64DecodeChunk;
+
+typedef struct _xmlSecBase64DecodeJob {
+    xmlSecBase64DecodeChunk     chunks[XMLSEC_BASE64_PARALLEL_MAX_CHUNKS];
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlMutexPtr                 mutex;
+} xmlSecBase64DecodeJob, *xmlSecBase64DecodeJobPtr;
+
+static xmlSecBase64DecodeChunk*
+xmlSecBase64DecodeJobNext(xmlSecBase64DecodeJobPtr job) {
+    xmlSecSize pos;
+
+    xmlSecAssert2(job != NULL, NULL);
+    xmlSecAssert2(job->mutex != NULL, NULL);
+
+    xmlMutexLock(job->mutex);
+    pos = job->next;
+    if(pos < job->size) {
+        ++job->next;
+    }
+    xmlMutexUnlock(job->mutex);
+
+    return((pos < job->size) ? &(job->chunks[pos]) : NULL);
+}
+
+static void
+xmlSecBase64DecodeCountTask(void* data) {
+    xmlSecBase64DecodeJobPtr job = (xmlSecBase64DecodeJobPtr)data;
+    xmlSecBase64DecodeChunk* chunk;
+    xmlSecSize ii, count;
+    xmlSecByte flags;
+
+    xmlSecAssert(job != NULL);
+
+    while((chunk = xmlSecBase64DecodeJobNext(job)) != NULL) {
+        for(ii = count = 0, flags = 0; ii < chunk->inSize; ++ii) {
+            if(!xmlSecIsBase64Space(chunk->in[ii])) {
+                flags |= base64Reverse[chunk->in[ii]];
+                ++count;
+            }
+        }
+        chunk->count = count;
+        chunk->plain = ((flags & 0xC0) == 0) ? 1 : 0;
+    }
+}
+
+static void
+xmlSecBase64DecodeTask(void* data) {
+    xmlSecBase64DecodeJobPtr job = (xmlSecBase64DecodeJobPtr)data;
+    xmlSecBase64DecodeChunk* chunk;
+    xmlSecSize inResSize;
+
+    xmlSecAssert(job != NULL);
+
+    while((chunk = xmlSecBase64DecodeJobNext(job)) != NULL) {
+        chunk->result = xmlSecBase64CtxDecode(&(chunk->ctx), chunk->in, chunk->inSize, &inResSize,
+                                              chunk->out, chunk->outSize, &(chunk->outResSize));
+        if((chunk->result >= 0) && (inResSize != chunk->inSize)) {
+            chunk->result = -1;
+        }
+    }
+}
+
+static int
+xmlSecBase64DecodeJobRun(xmlSecBase64DecodeJobPtr job, xmlSecExecutorTaskMethod task) {
+    void* tasks[XMLSEC_BASE64_PARALLEL_MAX_CHUNKS];
+    xmlSecSize ii;
+
+    xmlSecAssert2(job != NULL, -1);
+    xmlSecAssert2(task != NULL, -1);
+
+    for(ii = 0; ii < job->size; ++ii) {
+        tasks[ii] = job;
+    }
+    job->next = 0;
+    return(xmlSecExecutorRun(task, tasks, job->size));
+}
+
+/* same as xmlSecBase64CtxDecode() but splits the big inputs between the executor tasks */
+static int
+xmlSecBase64CtxDecodeParallel(xmlSecBase64CtxPtr ctx,
+                     const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
+                     xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
+    xmlSecBase64DecodeJob job;
+    xmlSecBase64DecodeChunk* chunk;
+    xmlSecBase64DecodeChunk* prev;
+    xmlSecSize chunksNum, before, skip, outPos, ii;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->encode == 0, -1);
+    xmlSecAssert2(inBufResSize != NULL, -1);
+    xmlSecAssert2(outBufResSize != NULL, -1);
+
+    chunksNum = xmlSecExecutorGetThreadsNumber();
+    if(chunksNum > XMLSEC_BASE64_PARALLEL_MAX_CHUNKS) {
+        chunksNum = XMLSEC_BASE64_PARALLEL_MAX_CHUNKS;
+    }
+    if(chunksNum > inBufSize / XMLSEC_BASE64_PARALLEL_MIN_CHUNK_SIZE) {
+        chunksNum = inBufSize / XMLSEC_BASE64_PARALLEL_MIN_CHUNK_SIZE;
+    }
+    if((chunksNum < 2) || (ctx->inPos != 0) || (ctx->finished != 0)) {
+        return(xmlSecBase64CtxDecode(ctx, inBuf, inBufSize, inBufResSize,
+                                     outBuf, outBufSize, outBufResSize));
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
+    /* count the characters in the equal chunks */
+    for(ii = 0; ii < chunksNum; ++ii) {
+        chunk = &(job.chunks[ii]);
+        chunk->in = inBuf + (inBufSize / chunksNum) * ii;
+        chunk->inSize = (ii + 1 < chunksNum) ? (inBufSize / chunksNum) : (inBufSize - (inBufSize / chunksNum) * ii);
+    }
+    job.size = chunksNum;
+    ret = xmlSecBase64DecodeJobRun(&job, xmlSecBase64DecodeCountTask);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+
+    /* move the chunks starts to the blocks boundaries: the first characters
+     * of a chunk might complete the last block of the previous one */
+    for(ii = 1, before = job.chunks[0].count; ii < chunksNum; ++ii) {
+        prev = &(job.chunks[ii - 1]);
+        chunk = &(job.chunks[ii]);
+        if(prev->plain == 0) {
+            break;
+        }
+
+        skip = (4 - (before % 4)) % 4;
+        before += chunk->count;
+        while((skip > 0) && (chunk->inSize > 0)) {
+            if(!xmlSecIsBase64Space(chunk->in[0])) {
+                if((base64Reverse[chunk->in[0]] & 0xC0) != 0) {
+                    break;
+                }
+                ++prev->count;
+                --chunk->count;
+                --skip;
+            }
+            ++chunk->in;
+            --chunk->inSize;
+            ++prev->inSize;
+        }
+        if(skip > 0) {
+            break;
+        }
+    }
+
+    /* all the chunks but the last one are decoded to exactly 3 bytes per block */
+    for(ii = 0, outPos = 0; (ii + 1 < chunksNum) && (outPos <= outBufSize); ++ii) {
+        outPos += 3 * (job.chunks[ii].count / 4);
+    }
+    if((ii + 1 < chunksNum) || (outPos > outBufSize)) {
+        xmlFreeMutex(job.mutex);
+        return(xmlSecBase64CtxDecode(ctx, inBuf, inBufSize, inBufResSize,
+                                     outBuf, outBufSize, outBufResSize));
+    }
+
+    for(ii = 0, outPos = 0; ii < chunksNum; ++ii) {
+        chunk = &(job.chunks[ii]);
+        chunk->out = outBuf + outPos;
+        chunk->outSize = (ii + 1 < chunksNum) ? 3 * (chunk->count / 4) : (outBufSize - outPos);
+        chunk->result = -1;
+        xmlSecBase64CtxInitialize(&(chunk->ctx), 0, 0);
+        outPos += chunk->outSize;
+    }
+    ret = xmlSecBase64DecodeJobRun(&job, xmlSecBase64DecodeTask);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+    for(ii = 0, outPos = 0; ii < chunksNum; ++ii) {
+        chunk = &(job.chunks[ii]);
+        if(chunk->result < 0) {
+            xmlSecInternalError("xmlSecBase64CtxDecode", NULL);
+            goto done;
+        }
+        outPos += chunk->outResSize;
+    }
+
+    /* the last chunk might end with a partial block or with the padding */
+    chunk = &(job.chunks[chunksNum - 1]);
+    ctx->inByte = chunk->ctx.inByte;
+    ctx->inPos = chunk->ctx.inPos;
+    ctx->finished = chunk->ctx.finished;
+
+    (*inBufResSize) = inBufSize;
+    (*outBufResSize) = outPos;
+    res = 0;
+
+done:
+    xmlFreeMutex(job.mutex);
+    return(res);
+}
+
 /**
  * xmlSecBase64Encode:
  * @buf:                the input buffer.
@@ -683,6 +1082,90 @@ xmlSecBase64Decode(const xmlChar* str, xmlSecByte *buf, xmlSecSize len) {
     return(size_update + size_final);
 }
 
+/**
+ * xmlSecBase64NodeContentDecode:
+ * @node:               the pointer to the node with base64 encoded content.
+ * @buf:                the output buffer.
+ * @len:                the output buffer size.
+ * @written:            the pointer to the number of bytes written to @buf.
+ *
+ * Decodes the text children of @node directly into @buf (e.g. a small
+ * stack buffer for DigestValue or SignatureValue) without copying the
+ * node content. The decoding is not attempted if @node has children
+ * other than text or CDATA nodes or if the decoded content might not
+ * fit into @buf: the caller should fall back to reading the content
+ * into an #xmlSecBuffer.
+ *
+ * Returns: 1 if the content is decoded, 0 if the decoding was not
+ * attempted or a negative value if an error occurs.
+ */
+int
+xmlSecBase64NodeContentDecode(xmlNodePtr node, xmlSecByte *buf, xmlSecSize len,
+                              xmlSecSize* written) {
+    xmlSecBase64Ctx ctx;
+    xmlNodePtr cur;
+    xmlSecSize inSize, size;
+    int ret;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(len > 0, -1);
+    xmlSecAssert2(written != NULL, -1);
+
+    (*written) = 0;
+    if(node->type != XML_ELEMENT_NODE) {
+        return(0);
+    }
+
+    /* base64 decode size is less than input size */
+    inSize = 0;
+    for(cur = node->children; cur != NULL; cur = cur->next) {
+        if((cur->type != XML_TEXT_NODE) && (cur->type != XML_CDATA_SECTION_NODE)) {
+            return(0);
+        }
+        if(cur->content != NULL) {
+            inSize += xmlStrlen(cur->content);
+        }
+    }
+    if((3 * inSize) / 4 + 4 > len) {
+        return(0);
+    }
+
+    ret = xmlSecBase64CtxInitialize(&ctx, 0, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxInitialize", NULL);
+        return(-1);
+    }
+
+    size = 0;
+    for(cur = node->children; cur != NULL; cur = cur->next) {
+        if((cur->content == NULL) || (cur->content[0] == '\0')) {
+            continue;
+        }
+
+        ret = xmlSecBase64CtxUpdate(&ctx, cur->content, xmlStrlen(cur->content),
+                                    buf + size, len - size);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBase64CtxUpdate", NULL);
+            xmlSecBase64CtxFinalize(&ctx);
+            return(-1);
+        }
+        size += ret;
+    }
+
+    ret = xmlSecBase64CtxFinal(&ctx, buf + size, len - size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxFinal", NULL);
+        xmlSecBase64CtxFinalize(&ctx);
+        return(-1);
+    }
+    size += ret;
+    xmlSecBase64CtxFinalize(&ctx);
+
+    (*written) = size;
+    return(1);
+}
+
 /**************************************************************
  *
  * Base64 Transform
@@ -699,6 +1182,11 @@ xmlSecBase64Decode(const xmlChar* str, xmlSecByte *buf, xmlSecSize len) {
 
 static int              xmlSecBase64Initialize          (xmlSecTransformPtr transform);
 static void             xmlSecBase64Finalize            (xmlSecTransformPtr transform);
+static int              xmlSecBase64PushBin             (xmlSecTransformPtr transform,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize,
+                                                         int final,
+                                                         xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecBase64Execute             (xmlSecTransformPtr transform,
                                                          int last,
                                                          xmlSecTransformCtxPtr transformCtx);
@@ -720,7 +1208,7 @@ static xmlSecTransformKlass xmlSecBase64Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecBase64PushBin,                        /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -799,6 +1287,68 @@ xmlSecBase64Finalize(xmlSecTransformPtr transform) {
     xmlSecBase64CtxFinalize(ctx);
 }
 
+/*
+ * Same as xmlSecTransformDefaultPushBin() but a big input (e.g. the whole
+ * <enc:CipherValue/> text) is decoded at once, without copying it to the input
+ * buffer in chunks, so it can be split between the executor tasks.
+ */
+static int
+xmlSecBase64PushBin(xmlSecTransformPtr transform, const xmlSecByte* data, xmlSecSize dataSize,
+                    int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecBase64CtxPtr ctx;
+    xmlSecBufferPtr out;
+    xmlSecSize outSize, outLen;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformBase64Id), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecBase64GetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if((transform->operation == xmlSecTransformOperationDecode) &&
+       (dataSize >= 2 * XMLSEC_BASE64_PARALLEL_MIN_CHUNK_SIZE) &&
+       (xmlSecBufferGetSize(&(transform->inBuf)) == 0) &&
+       ((transform->status == xmlSecTransformStatusNone) || (transform->status == xmlSecTransformStatusWorking))) {
+        xmlSecAssert2(data != NULL, -1);
+
+        if(transform->status == xmlSecTransformStatusNone) {
+            ctx->encode = 0;
+            transform->status = xmlSecTransformStatusWorking;
+        }
+
+        out = &(transform->outBuf);
+        outSize = xmlSecBufferGetSize(out);
+        outLen = 3 * dataSize / 4 + 8;
+        ret = xmlSecBufferSetMaxSize(out, outSize + outLen);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetMaxSize",
+                                 xmlSecTransformGetName(transform),
+                                 "size=" XMLSEC_SIZE_FMT, outSize + outLen);
+            return(-1);
+        }
+        ret = xmlSecBase64CtxUpdate(ctx, data, dataSize, xmlSecBufferGetData(out) + outSize, outLen);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBase64CtxUpdate",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        outLen = ret;
+        ret = xmlSecBufferSetSize(out, outSize + outLen);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetSize",
+                                 xmlSecTransformGetName(transform),
+                                 "size=" XMLSEC_SIZE_FMT, outSize + outLen);
+            return(-1);
+        }
+
+        /* finish and push the decoded data to the next transform */
+        data = NULL;
+        dataSize = 0;
+    }
+    return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+}
+
 static int
 xmlSecBase64Execute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr transformCtx) {
     xmlSecBase64CtxPtr ctx;
@@ -829,7 +1379,8 @@ xmlSecBase64Execute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPt
                 if(ctx->encode != 0) {
                     outLen = 4 * inSize / 3 + 8;
                     if(ctx->columns > 0) {
-                        outLen += inSize / ctx->columns + 4;
+                        /* one '\n' per line of encoded data */
+                        outLen += outLen / ctx->columns + 4;
                     }
                 } else {
                     outLen = 3 * inSize / 4 + 8;
@@ -915,3 +1466,138 @@ xmlSecBase64Execute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPt
 }
 
 
+
+/* the decoded data are pushed to the next transform in chunks of this size */
+#define XMLSEC_BASE64_DECODE_CHUNK_SIZE         XMLSEC_TRANSFORM_BINARY_CHUNK
+
+typedef struct _xmlSecBase64DecodeTextNodesCtx {
+    xmlSecTransformPtr          transform;
+    xmlSecTransformCtxPtr       transformCtx;
+} xmlSecBase64DecodeTextNodesCtx, *xmlSecBase64DecodeTextNodesCtxPtr;
+
+static int
+xmlSecBase64DecodeTextNodesPush(xmlSecTransformPtr transform, const xmlSecByte* data,
+                                xmlSecSize dataSize, int last,
+                                xmlSecTransformCtxPtr transformCtx) {
+    int ret;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    if(transform->next != NULL) {
+        ret = xmlSecTransformPushBin(transform->next, data, dataSize, last, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPushBin", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    } else if(dataSize > 0) {
+        ret = xmlSecBufferAppend(&(transform->outBuf), data, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferAppend", xmlSecTransformGetName(transform),
+                                 "size=" XMLSEC_SIZE_FMT, dataSize);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecBase64DecodeTextNodesWalkCallback(xmlSecNodeSetPtr nset ATTRIBUTE_UNUSED, xmlNodePtr cur,
+                                        xmlNodePtr parent ATTRIBUTE_UNUSED, void* data) {
+    xmlSecBase64DecodeTextNodesCtxPtr walkCtx = (xmlSecBase64DecodeTextNodesCtxPtr)data;
+    xmlSecByte out[XMLSEC_BASE64_DECODE_CHUNK_SIZE + 8];
+    xmlSecBase64CtxPtr ctx;
+    const xmlSecByte* in;
+    xmlSecSize inSize, chunkSize;
+    int ret;
+
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2(walkCtx != NULL, -1);
+
+    if((cur->type != XML_TEXT_NODE) || (cur->content == NULL)) {
+        return(0);
+    }
+    ctx = xmlSecBase64GetCtx(walkCtx->transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* 4 base64 chars are decoded to 3 bytes at most */
+    in = (const xmlSecByte*)cur->content;
+    inSize = (xmlSecSize)xmlStrlen(cur->content);
+    while(inSize > 0) {
+        chunkSize = (inSize < 4 * XMLSEC_BASE64_DECODE_CHUNK_SIZE / 3) ? inSize : 4 * XMLSEC_BASE64_DECODE_CHUNK_SIZE / 3;
+
+        ret = xmlSecBase64CtxUpdate(ctx, in, chunkSize, out, sizeof(out));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBase64CtxUpdate", xmlSecTransformGetName(walkCtx->transform));
+            return(-1);
+        }
+        ret = xmlSecBase64DecodeTextNodesPush(walkCtx->transform, out, (xmlSecSize)ret, 0,
+                                              walkCtx->transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBase64DecodeTextNodesPush", xmlSecTransformGetName(walkCtx->transform));
+            return(-1);
+        }
+
+        in += chunkSize;
+        inSize -= chunkSize;
+    }
+    return(0);
+}
+
+/**
+ * xmlSecTransformBase64DecodeTextNodes:
+ * @transform:          the pointer to base64 decode transform.
+ * @nodes:              the nodes set.
+ * @transformCtx:       the pointer to transform context.
+ *
+ * Decodes the text nodes content from @nodes (i.e. the output of the
+ * #xmlSecTransformRemoveXmlTagsC14NId transform) and pushes the result
+ * directly to the next transform (e.g. digest): the text is not copied
+ * to the output buffers of the previous transform and of @transform.
+ * The @transform must not have any input yet, it is finished when
+ * the function returns.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformBase64DecodeTextNodes(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
+                                     xmlSecTransformCtxPtr transformCtx) {
+    xmlSecBase64DecodeTextNodesCtx walkCtx;
+    xmlSecBase64CtxPtr ctx;
+    xmlSecByte out[16];
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformBase64Id), -1);
+    xmlSecAssert2(transform->operation == xmlSecTransformOperationDecode, -1);
+    xmlSecAssert2(transform->status == xmlSecTransformStatusNone, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecBase64GetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    ctx->encode = 0;
+    transform->status = xmlSecTransformStatusWorking;
+
+    walkCtx.transform = transform;
+    walkCtx.transformCtx = transformCtx;
+    ret = xmlSecNodeSetWalk(nodes, xmlSecBase64DecodeTextNodesWalkCallback, &walkCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeSetWalk", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    ret = xmlSecBase64CtxFinal(ctx, out, sizeof(out));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxFinal", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    transform->status = xmlSecTransformStatusFinished;
+
+    ret = xmlSecBase64DecodeTextNodesPush(transform, out, (xmlSecSize)ret, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64DecodeTextNodesPush", xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    return(0);
+}
@@ -50,6 +50,91 @@ static const char xmlSecBnRevLookupTable[] =
     '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
 };
 
+/* string conversions work on 32 bit limbs, least significant limb first */
+typedef unsigned int                    xmlSecBnLimb;
+typedef unsigned long long              xmlSecBnDoubleLimb;
+#define XMLSEC_BN_LIMB_BITS             32
+#define XMLSEC_BN_LIMB_BYTES            4
+#define XMLSEC_BN_LIMB_MAX              0xFFFFFFFFU
+
+/* returns the number of digits that fit into one limb and base^digits */
+static xmlSecSize
+xmlSecBnGetLimbDigits(xmlSecSize base, xmlSecBnLimb* mult) {
+    xmlSecSize digits = 1;
+
+    (*mult) = (xmlSecBnLimb)base;
+    while((*mult) <= XMLSEC_BN_LIMB_MAX / base) {
+        (*mult) *= (xmlSecBnLimb)base;
+        ++digits;
+    }
+    return(digits);
+}
+
+static xmlSecBnLimb*
+xmlSecBnLimbsCreate(const xmlSecByte* data, xmlSecSize size, xmlSecSize extra, xmlSecSize* used) {
+    xmlSecBnLimb* limbs;
+    xmlSecSize i, count;
+
+    xmlSecAssert2(used != NULL, NULL);
+
+    count = (size + XMLSEC_BN_LIMB_BYTES - 1) / XMLSEC_BN_LIMB_BYTES + extra;
+    if(count == 0) {
+        count = 1;
+    }
+    limbs = (xmlSecBnLimb*)xmlMalloc(sizeof(xmlSecBnLimb) * count);
+    if(limbs == NULL) {
+        xmlSecMallocError(sizeof(xmlSecBnLimb) * count, NULL);
+        return(NULL);
+    }
+    memset(limbs, 0, sizeof(xmlSecBnLimb) * count);
+
+    /* data is big endian: the last byte is the least significant one */
+    for(i = 0; i < size; ++i) {
+        xmlSecAssert2(data != NULL, NULL);
+        limbs[i / XMLSEC_BN_LIMB_BYTES] |=
+            ((xmlSecBnLimb)data[size - i - 1]) << (8 * (i % XMLSEC_BN_LIMB_BYTES));
+    }
+
+    /* skip leading zeros */
+    for((*used) = (size + XMLSEC_BN_LIMB_BYTES - 1) / XMLSEC_BN_LIMB_BYTES;
+        ((*used) > 0) && (limbs[(*used) - 1] == 0); --(*used));
+
+    return(limbs);
+}
+
+/* limbs = limbs * mult + add */
+static void
+xmlSecBnLimbsMulAdd(xmlSecBnLimb* limbs, xmlSecSize* used, xmlSecBnLimb mult, xmlSecBnLimb add) {
+    xmlSecBnDoubleLimb over = add;
+    xmlSecSize i;
+
+    for(i = 0; i < (*used); ++i) {
+        over     = over + (xmlSecBnDoubleLimb)limbs[i] * mult;
+        limbs[i] = (xmlSecBnLimb)(over & XMLSEC_BN_LIMB_MAX);
+        over     = over >> XMLSEC_BN_LIMB_BITS;
+    }
+    if(over > 0) {
+        limbs[(*used)++] = (xmlSecBnLimb)over;
+    }
+}
+
+/* limbs = limbs / divider, returns the modulus */
+static xmlSecBnLimb
+xmlSecBnLimbsDiv(xmlSecBnLimb* limbs, xmlSecSize* used, xmlSecBnLimb divider) {
+    xmlSecBnDoubleLimb over = 0;
+    xmlSecSize i;
+
+    for(i = (*used); i > 0; --i) {
+        over         = (over << XMLSEC_BN_LIMB_BITS) | limbs[i - 1];
+        limbs[i - 1] = (xmlSecBnLimb)(over / divider);
+        over         = over % divider;
+    }
+    while(((*used) > 0) && (limbs[(*used) - 1] == 0)) {
+        --(*used);
+    }
+    return((xmlSecBnLimb)over);
+}
+
 /*****************************************************************************
  *
  * xmlSecBn
@@ -170,7 +255,10 @@ xmlSecBnZero(xmlSecBnPtr bn) {
  */
 int
 xmlSecBnFromString(xmlSecBnPtr bn, const xmlChar* str, xmlSecSize base) {
-    xmlSecSize i, len, size;
+    xmlSecSize i, len, size, used;
+    xmlSecSize digits, chunkSize;
+    xmlSecBnLimb mult, chunk, chunkMult;
+    xmlSecBnLimb* limbs;
     xmlSecByte ch;
     xmlSecByte* data;
     int positive;
@@ -228,7 +316,19 @@ xmlSecBnFromString(xmlSecBnPtr bn, const xmlChar* str, xmlSecSize base) {
         break;
     }
 
-    /* now parse the number itself */
+    /* now parse the number itself: collect as many digits as fit into a limb
+     * and fold them into the number with one multiplication */
+    digits = xmlSecBnGetLimbDigits(base, &mult);
+    limbs = xmlSecBnLimbsCreate(xmlSecBufferGetData(bn), xmlSecBufferGetSize(bn),
+                                (len - i) / digits + 1, &used);
+    if(limbs == NULL) {
+        xmlSecInternalError("xmlSecBnLimbsCreate", NULL);
+        return (-1);
+    }
+
+    chunk = 0;
+    chunkMult = 1;
+    chunkSize = 0;
     while(i < len) {
         ch = str[i++];
         if(isspace(ch)) {
@@ -238,21 +338,49 @@ xmlSecBnFromString(xmlSecBnPtr bn, const xmlChar* str, xmlSecSize base) {
         nn = xmlSecBnLookupTable[ch];
         if((nn < 0) || ((xmlSecSize)nn >= base)) {
             xmlSecInvalidIntegerDataError2("char", nn, "base", base, "0 <= char < base", NULL);
+            xmlFree(limbs);
             return (-1);
         }
 
-        ret = xmlSecBnMul(bn, base);
-        if(ret < 0) {
-            xmlSecInternalError2("xmlSecBnMul", NULL, "base=%d", base);
-            return (-1);
+        chunk = chunk * (xmlSecBnLimb)base + (xmlSecBnLimb)nn;
+        chunkMult *= (xmlSecBnLimb)base;
+        if((++chunkSize) == digits) {
+            xmlSecBnLimbsMulAdd(limbs, &used, chunkMult, chunk);
+            chunk = 0;
+            chunkMult = 1;
+            chunkSize = 0;
         }
+    }
+    if(chunkSize > 0) {
+        xmlSecBnLimbsMulAdd(limbs, &used, chunkMult, chunk);
+    }
 
-        ret = xmlSecBnAdd(bn, nn);
-        if(ret < 0) {
-            xmlSecInternalError2("xmlSecBnAdd", NULL, "base=%d", base);
-            return (-1);
+    /* write the number back, the size never goes down */
+    size = xmlSecBufferGetSize(bn);
+    for(len = used * XMLSEC_BN_LIMB_BYTES; len > 0; --len) {
+        if(((limbs[(len - 1) / XMLSEC_BN_LIMB_BYTES] >> (8 * ((len - 1) % XMLSEC_BN_LIMB_BYTES))) & 0xFF) != 0) {
+            break;
         }
     }
+    if(size < len) {
+        size = len;
+    }
+    ret = xmlSecBufferSetSize(bn, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetSize", NULL, "size=%lu", (unsigned long)size);
+        xmlFree(limbs);
+        return (-1);
+    }
+    data = xmlSecBufferGetData(bn);
+    for(i = 0; i < size; ++i) {
+        xmlSecAssert2(data != NULL, -1);
+        if(i < used * XMLSEC_BN_LIMB_BYTES) {
+            data[size - i - 1] = (xmlSecByte)((limbs[i / XMLSEC_BN_LIMB_BYTES] >> (8 * (i % XMLSEC_BN_LIMB_BYTES))) & 0xFF);
+        } else {
+            data[size - i - 1] = 0;
+        }
+    }
+    xmlFree(limbs);
 
     /* check if we need to add 00 prefix, do this for empty bn too */
     data = xmlSecBufferGetData(bn);
@@ -299,10 +427,11 @@ xmlSecBnToString(xmlSecBnPtr bn, xmlSecSize base) {
     xmlSecBn bn2;
     int positive = 1;
     xmlChar* res;
-    xmlSecSize i, len, size;
+    xmlSecSize i, j, len, size, used, digits;
+    xmlSecBnLimb mult, rem;
+    xmlSecBnLimb* limbs;
     xmlSecByte* data;
     int ret;
-    int nn;
     xmlChar ch;
 
     xmlSecAssert2(bn != NULL, NULL);
@@ -350,8 +479,11 @@ xmlSecBnToString(xmlSecBnPtr bn, xmlSecSize base) {
      *      len = log base (256) * <bn size>
      * Since the smallest base == 2 then we can get away with
      *      len = 8 * <bn size>
+     * Digits are produced a limb at a time and the last limb might add
+     * a few extra zeros.
      */
-    len = 8 * size + 1 + 1;
+    digits = xmlSecBnGetLimbDigits(base, &mult);
+    len = 8 * size + digits + 1 + 1;
     res = (xmlChar*)xmlMalloc(len + 1);
     if(res == NULL) {
         xmlSecMallocError(len + 1, NULL);
@@ -360,16 +492,26 @@ xmlSecBnToString(xmlSecBnPtr bn, xmlSecSize base) {
     }
     memset(res, 0, len + 1);
 
-    for(i = 0; (xmlSecBufferGetSize(&bn2) > 0) && (i < len); i++) {
-        if(xmlSecBnDiv(&bn2, base, &nn) < 0) {
-            xmlSecInternalError2("xmlSecBnDiv", NULL, "base=%d", base);
-            xmlFree(res);
-            xmlSecBnFinalize(&bn2);
-            return (NULL);
-        }
-        xmlSecAssert2((size_t)nn < sizeof(xmlSecBnRevLookupTable), NULL);
-        res[i] = xmlSecBnRevLookupTable[nn];
+    limbs = xmlSecBnLimbsCreate(data, size, 0, &used);
+    if(limbs == NULL) {
+        xmlSecInternalError("xmlSecBnLimbsCreate", NULL);
+        xmlFree(res);
+        xmlSecBnFinalize(&bn2);
+        return (NULL);
+    }
+
+    /* divide by base^digits and print the modulus, empty bn has no digits */
+    i = 0;
+    if(size > 0) {
+        do {
+            rem = xmlSecBnLimbsDiv(limbs, &used, mult);
+            for(j = 0; (j < digits) && (i < len); ++j, ++i) {
+                res[i] = xmlSecBnRevLookupTable[rem % base];
+                rem /= (xmlSecBnLimb)base;
+            }
+        } while((used > 0) && (i < len));
     }
+    xmlFree(limbs);
     xmlSecAssert2(i < len, NULL);
 
     /* we might have '0' at the beggining, remove it but keep one zero */
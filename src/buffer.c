@@ -14,6 +14,18 @@
 #include <string.h>
 #include <ctype.h>
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define XMLSEC_BUFFER_MMAP      1
+
+/* the size of the mapped file head requested when the file is opened */
+#define XMLSEC_MAPPED_FILE_READAHEAD_SIZE       (1024 * 1024)
+#endif /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+
 #include <libxml/tree.h>
 
 #include <xmlsec/xmlsec.h>
@@ -22,6 +34,8 @@
 #include <xmlsec/buffer.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/buffer.h>
+
 /*****************************************************************************
  *
  * xmlSecBuffer
@@ -30,6 +44,19 @@
 static xmlSecAllocMode gAllocMode = xmlSecAllocModeDouble;
 static xmlSecSize gInitialSize = 1024;
 
+/* the buffer data lives in the inline storage rather than on the heap */
+#define xmlSecBufferIsInline(buf) \
+    (((buf)->inlineData != NULL) && ((buf)->data != NULL) && \
+     (((buf)->data - (buf)->offset) == (buf)->inlineData))
+
+static void     xmlSecBufferResetOffset                 (xmlSecBufferPtr buf);
+static int      xmlSecBufferSpillInline                 (xmlSecBufferPtr buf);
+static void     xmlSecBufferMemCounterAdd               (xmlSecBufferMemCounterPtr memCounter,
+                                                         xmlSecSize addSize,
+                                                         xmlSecSize removeSize);
+static int      xmlSecBufferBase64TextChildrenRead      (xmlSecBufferPtr buf,
+                                                         xmlNodePtr node);
+
 /**
  * xmlSecBufferSetDefaultAllocMode:
  * @defAllocMode:       the new default buffer allocation mode.
@@ -106,10 +133,40 @@ xmlSecBufferInitialize(xmlSecBufferPtr buf, xmlSecSize size) {
     buf->data = NULL;
     buf->size = buf->maxSize = 0;
     buf->allocMode = gAllocMode;
+    buf->offset = 0;
+    buf->memCounter = NULL;
+    buf->inlineData = NULL;
+    buf->inlineSize = 0;
 
     return(xmlSecBufferSetMaxSize(buf, size));
 }
 
+/**
+ * xmlSecBufferSetInlineStorage:
+ * @buf:                the pointer to buffer object.
+ * @data:               the storage.
+ * @size:               the storage size.
+ *
+ * Makes @buf use @data (e.g. an array inside the structure that owns
+ * the buffer) for up to @size bytes instead of allocating memory on the
+ * heap, the data is moved to the heap transparently if the buffer grows
+ * bigger. The @data must outlive the buffer, #xmlSecBufferSwap never
+ * hands it over to the other buffer. The buffer must be empty and have
+ * no memory allocated.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecBufferSetInlineStorage(xmlSecBufferPtr buf, xmlSecByte* data, xmlSecSize size) {
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(buf->data == NULL, -1);
+    xmlSecAssert2((data != NULL) || (size == 0), -1);
+
+    buf->inlineData = (size > 0) ? data : NULL;
+    buf->inlineSize = (size > 0) ? size : 0;
+    return(0);
+}
+
 /**
  * xmlSecBufferFinalize:
  * @buf:                the pointer to buffer object.
@@ -122,11 +179,13 @@ xmlSecBufferFinalize(xmlSecBufferPtr buf) {
     xmlSecAssert(buf != NULL);
 
     xmlSecBufferEmpty(buf);
-    if(buf->data != 0) {
+    if((buf->data != 0) && !xmlSecBufferIsInline(buf)) {
         xmlFree(buf->data);
     }
+    xmlSecBufferMemCounterAdd(buf->memCounter, 0, buf->maxSize);
     buf->data = NULL;
     buf->size = buf->maxSize = 0;
+    buf->memCounter = NULL;
 }
 
 /**
@@ -139,6 +198,14 @@ void
 xmlSecBufferEmpty(xmlSecBufferPtr buf) {
     xmlSecAssert(buf != NULL);
 
+    /* go back to the beginning of the allocated memory */
+    if(buf->offset > 0) {
+        xmlSecAssert(buf->data != NULL);
+
+        buf->data -= buf->offset;
+        buf->maxSize += buf->offset;
+        buf->offset = 0;
+    }
     if(buf->data != 0) {
         xmlSecAssert(buf->maxSize > 0);
 
@@ -147,6 +214,107 @@ xmlSecBufferEmpty(xmlSecBufferPtr buf) {
     buf->size = 0;
 }
 
+/**
+ * xmlSecBufferSwap:
+ * @buf1:               the pointer to the first buffer object.
+ * @buf2:               the pointer to the second buffer object.
+ *
+ * Exchanges the content of two buffers without copying data. This allows
+ * one to hand a complete buffer over to another owner (e.g. from one
+ * transform's output to the next transform's input). The data in the
+ * inline storage (see #xmlSecBufferSetInlineStorage) is moved to the
+ * heap first.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecBufferSwap(xmlSecBufferPtr buf1, xmlSecBufferPtr buf2) {
+    xmlSecBuffer tmp;
+
+    xmlSecAssert2(buf1 != NULL, -1);
+    xmlSecAssert2(buf2 != NULL, -1);
+
+    if((xmlSecBufferSpillInline(buf1) < 0) || (xmlSecBufferSpillInline(buf2) < 0)) {
+        xmlSecInternalError("xmlSecBufferSpillInline", NULL);
+        return(-1);
+    }
+
+    tmp = (*buf1);
+    (*buf1) = (*buf2);
+    (*buf2) = tmp;
+
+    /* the memory counters and the inline storage stay with the buffers,
+     * the memory moves between them */
+    buf2->memCounter = buf1->memCounter;
+    buf1->memCounter = tmp.memCounter;
+    buf2->inlineData = buf1->inlineData;
+    buf2->inlineSize = buf1->inlineSize;
+    buf1->inlineData = tmp.inlineData;
+    buf1->inlineSize = tmp.inlineSize;
+    if(buf1->memCounter != buf2->memCounter) {
+        xmlSecBufferMemCounterAdd(buf1->memCounter, buf1->maxSize + buf1->offset, buf2->maxSize + buf2->offset);
+        xmlSecBufferMemCounterAdd(buf2->memCounter, buf2->maxSize + buf2->offset, buf1->maxSize + buf1->offset);
+    }
+    return(0);
+}
+
+/* moves the data from the inline storage to the heap */
+static int
+xmlSecBufferSpillInline(xmlSecBufferPtr buf) {
+    xmlSecByte* newData;
+
+    xmlSecAssert2(buf != NULL, -1);
+
+    if(!xmlSecBufferIsInline(buf)) {
+        return(0);
+    }
+    xmlSecBufferResetOffset(buf);
+
+    newData = (xmlSecByte*)xmlMalloc(buf->maxSize);
+    if(newData == NULL) {
+        xmlSecMallocError(buf->maxSize, NULL);
+        return(-1);
+    }
+    memcpy(newData, buf->data, buf->maxSize);
+    memset(buf->data, 0, buf->maxSize);
+    buf->data = newData;
+    return(0);
+}
+
+/**
+ * xmlSecBufferSetMemCounter:
+ * @buf:                the pointer to buffer object.
+ * @memCounter:         the pointer to memory counter or NULL.
+ *
+ * Charges the memory allocated by @buf to @memCounter (the memory is
+ * removed from the previous buffer's counter, if any). The @memCounter
+ * must outlive the buffer or be detached by setting it to NULL.
+ */
+void
+xmlSecBufferSetMemCounter(xmlSecBufferPtr buf, xmlSecBufferMemCounterPtr memCounter) {
+    xmlSecAssert(buf != NULL);
+
+    if(buf->memCounter == memCounter) {
+        return;
+    }
+    xmlSecBufferMemCounterAdd(buf->memCounter, 0, buf->maxSize + buf->offset);
+    xmlSecBufferMemCounterAdd(memCounter, buf->maxSize + buf->offset, 0);
+    buf->memCounter = memCounter;
+}
+
+static void
+xmlSecBufferMemCounterAdd(xmlSecBufferMemCounterPtr memCounter, xmlSecSize addSize, xmlSecSize removeSize) {
+    if(memCounter == NULL) {
+        return;
+    }
+
+    memCounter->size += addSize;
+    memCounter->size = (memCounter->size > removeSize) ? (memCounter->size - removeSize) : 0;
+    if(memCounter->size > memCounter->peakSize) {
+        memCounter->peakSize = memCounter->size;
+    }
+}
+
 /**
  * xmlSecBufferGetData:
  * @buf:                the pointer to buffer object.
@@ -272,21 +440,56 @@ xmlSecBufferSetMaxSize(xmlSecBufferPtr buf, xmlSecSize size) {
         return(0);
     }
 
+    /* try to reuse the space before the data first */
+    if(buf->offset > 0) {
+        xmlSecBufferResetOffset(buf);
+        if(size <= buf->maxSize) {
+            return(0);
+        }
+    }
+
     switch(buf->allocMode) {
         case xmlSecAllocModeExact:
             newSize = size + 8;
             break;
         case xmlSecAllocModeDouble:
+        case xmlSecAllocModeOffset:
             newSize = 2 * size + 32;
             break;
     }
 
-    if(newSize < gInitialSize) {
+    /* the small buffer fits into the inline storage */
+    if((buf->data == NULL) && (size <= buf->inlineSize)) {
+        newSize = buf->inlineSize;
+    } else if(newSize < gInitialSize) {
         newSize = gInitialSize;
     }
 
+    /* the offset is 0 here so the buffer owns exactly maxSize bytes */
+    if((buf->memCounter != NULL) && (buf->memCounter->maxSize > 0)) {
+        xmlSecSize otherSize;
+
+        otherSize = (buf->memCounter->size > buf->maxSize) ? (buf->memCounter->size - buf->maxSize) : 0;
+        if(otherSize + newSize > buf->memCounter->maxSize) {
+            /* try to fit the exact size before giving up */
+            if(otherSize + size > buf->memCounter->maxSize) {
+                xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED, NULL,
+                                  "maxMemSize=%lu", (unsigned long)buf->memCounter->maxSize);
+                return(-1);
+            }
+            newSize = size;
+        }
+    }
 
-    if(buf->data != NULL) {
+    if((buf->data == NULL) && (newSize == buf->inlineSize)) {
+        newData = buf->inlineData;
+    } else if(xmlSecBufferIsInline(buf)) {
+        newData = (xmlSecByte*)xmlMalloc(newSize);
+        if(newData != NULL) {
+            memcpy(newData, buf->data, buf->maxSize);
+            memset(buf->data, 0, buf->maxSize);
+        }
+    } else if(buf->data != NULL) {
         newData = (xmlSecByte*)xmlRealloc(buf->data, newSize);
     } else {
         newData = (xmlSecByte*)xmlMalloc(newSize);
@@ -296,6 +499,7 @@ xmlSecBufferSetMaxSize(xmlSecBufferPtr buf, xmlSecSize size) {
         return(-1);
     }
 
+    xmlSecBufferMemCounterAdd(buf->memCounter, newSize, buf->maxSize);
     buf->data = newData;
     buf->maxSize = newSize;
 
@@ -358,6 +562,17 @@ xmlSecBufferPrepend(xmlSecBufferPtr buf, const xmlSecByte* data, xmlSecSize size
     if(size > 0) {
         xmlSecAssert2(data != NULL, -1);
 
+        /* put the data back in front of the current data if it fits */
+        if(size <= buf->offset) {
+            buf->data -= size;
+            buf->offset -= size;
+            buf->maxSize += size;
+
+            memcpy(buf->data, data, size);
+            buf->size += size;
+            return(0);
+        }
+
         ret = xmlSecBufferSetMaxSize(buf, buf->size + size);
         if(ret < 0) {
             xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL, "size=%d", buf->size + size);
@@ -385,6 +600,22 @@ int
 xmlSecBufferRemoveHead(xmlSecBufferPtr buf, xmlSecSize size) {
     xmlSecAssert2(buf != NULL, -1);
 
+    if(buf->allocMode == xmlSecAllocModeOffset) {
+        if(size >= buf->size) {
+            xmlSecBufferEmpty(buf);
+            return(0);
+        }
+        xmlSecAssert2(buf->data != NULL, -1);
+
+        /* just move the data pointer */
+        memset(buf->data, 0, size);
+        buf->data += size;
+        buf->offset += size;
+        buf->size -= size;
+        buf->maxSize -= size;
+        return(0);
+    }
+
     if(size < buf->size) {
         xmlSecAssert2(buf->data != NULL, -1);
 
@@ -425,6 +656,32 @@ xmlSecBufferRemoveTail(xmlSecBufferPtr buf, xmlSecSize size) {
     return(0);
 }
 
+/*
+ * Moves the data back to the beginning of the allocated memory
+ * (see #xmlSecAllocModeOffset).
+ */
+static void
+xmlSecBufferResetOffset(xmlSecBufferPtr buf) {
+    xmlSecByte* start;
+
+    xmlSecAssert(buf != NULL);
+
+    if(buf->offset == 0) {
+        return;
+    }
+    xmlSecAssert(buf->data != NULL);
+
+    start = buf->data - buf->offset;
+    if(buf->size > 0) {
+        memmove(start, buf->data, buf->size);
+    }
+    memset(start + buf->size, 0, buf->offset);
+
+    buf->data = start;
+    buf->maxSize += buf->offset;
+    buf->offset = 0;
+}
+
 /**
  * xmlSecBufferReadFile:
  * @buf:                the pointer to buffer object.
@@ -436,6 +693,7 @@ xmlSecBufferRemoveTail(xmlSecBufferPtr buf, xmlSecSize size) {
  */
 int
 xmlSecBufferReadFile(xmlSecBufferPtr buf, const char* filename) {
+    xmlSecMappedFile mappedFile;
     xmlSecByte buffer[1024];
     FILE* f;
     int ret, len;
@@ -443,6 +701,23 @@ xmlSecBufferReadFile(xmlSecBufferPtr buf, const char* filename) {
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(filename != NULL, -1);
 
+    /* copy the mapped file at once instead of growing the buffer */
+    ret = xmlSecMappedFileOpen(&mappedFile, filename);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecMappedFileOpen", NULL);
+        return(-1);
+    } else if(ret == 0) {
+        ret = xmlSecBufferAppend(buf, mappedFile.data, mappedFile.size);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferAppend", NULL,
+                                 "size=" XMLSEC_SIZE_FMT, mappedFile.size);
+            xmlSecMappedFileClose(&mappedFile);
+            return(-1);
+        }
+        xmlSecMappedFileClose(&mappedFile);
+        return(0);
+    }
+
     f = fopen(filename, "rb");
     if(f == NULL) {
         xmlSecIOError("fopen", filename, NULL);
@@ -471,6 +746,166 @@ xmlSecBufferReadFile(xmlSecBufferPtr buf, const char* filename) {
     return(0);
 }
 
+/**
+ * xmlSecMappedFileOpen:
+ * @file:               the pointer to mapped file.
+ * @filename:           the file name.
+ *
+ * Maps the regular file @filename for sequential reading.
+ *
+ * Returns: 0 on success, 1 if the file can't be mapped (empty, not
+ * a regular file or no mmap on this platform) and the caller needs
+ * to read it, or a negative value if an error occurs.
+ */
+int
+xmlSecMappedFileOpen(xmlSecMappedFilePtr file, const char* filename) {
+#ifdef XMLSEC_BUFFER_MMAP
+    struct stat st;
+    void* data;
+    int fd;
+#endif /* XMLSEC_BUFFER_MMAP */
+
+    xmlSecAssert2(file != NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    memset(file, 0, sizeof(xmlSecMappedFile));
+
+#ifdef XMLSEC_BUFFER_MMAP
+    fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        xmlSecIOError("open", filename, NULL);
+        return(-1);
+    }
+    if(fstat(fd, &st) < 0) {
+        xmlSecIOError("fstat", filename, NULL);
+        close(fd);
+        return(-1);
+    }
+    if(!S_ISREG(st.st_mode) || (st.st_size <= 0) ||
+       ((off_t)((xmlSecSize)st.st_size) != st.st_size)) {
+        close(fd);
+        return(1);
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return(1);
+    }
+#ifdef HAVE_MADVISE
+    /* start reading the first pages now, the kernel reads ahead the rest
+     * while the caller consumes the data */
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(data, ((size_t)st.st_size < XMLSEC_MAPPED_FILE_READAHEAD_SIZE) ?
+        (size_t)st.st_size : XMLSEC_MAPPED_FILE_READAHEAD_SIZE, MADV_WILLNEED);
+#endif /* HAVE_MADVISE */
+
+    file->data = (xmlSecByte*)data;
+    file->size = (xmlSecSize)st.st_size;
+    return(0);
+#else  /* XMLSEC_BUFFER_MMAP */
+    return(1);
+#endif /* XMLSEC_BUFFER_MMAP */
+}
+
+/**
+ * xmlSecMappedFileClose:
+ * @file:               the pointer to mapped file.
+ *
+ * Unmaps the file mapped with #xmlSecMappedFileOpen.
+ */
+void
+xmlSecMappedFileClose(xmlSecMappedFilePtr file) {
+    xmlSecAssert(file != NULL);
+
+#ifdef XMLSEC_BUFFER_MMAP
+    if(file->data != NULL) {
+        munmap(file->data, file->size);
+    }
+#endif /* XMLSEC_BUFFER_MMAP */
+    memset(file, 0, sizeof(xmlSecMappedFile));
+}
+
+/*
+ * Base64 decodes the text and CDATA children of the element @node directly
+ * into @buf, without making a copy of the node content first.
+ *
+ * Returns: 1 if the content was decoded, 0 if @node has other children
+ * (the caller needs to use xmlNodeGetContent()) or a negative value
+ * if an error occurs.
+ */
+static int
+xmlSecBufferBase64TextChildrenRead(xmlSecBufferPtr buf, xmlNodePtr node) {
+    xmlSecBase64CtxPtr ctx;
+    xmlNodePtr cur;
+    xmlSecSize inSize, size;
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(node->type != XML_ELEMENT_NODE) {
+        return(0);
+    }
+
+    /* base64 decode size is less than input size */
+    inSize = 0;
+    for(cur = node->children; cur != NULL; cur = cur->next) {
+        if((cur->type != XML_TEXT_NODE) && (cur->type != XML_CDATA_SECTION_NODE)) {
+            return(0);
+        }
+        if(cur->content != NULL) {
+            inSize += xmlStrlen(cur->content);
+        }
+    }
+
+    ret = xmlSecBufferSetMaxSize(buf, (3 * inSize) / 4 + 4);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL, "size=" XMLSEC_SIZE_FMT, (3 * inSize) / 4 + 4);
+        return(-1);
+    }
+
+    ctx = xmlSecBase64CtxCreate(0, 0);
+    if(ctx == NULL) {
+        xmlSecInternalError("xmlSecBase64CtxCreate", NULL);
+        return(-1);
+    }
+
+    size = 0;
+    for(cur = node->children; cur != NULL; cur = cur->next) {
+        if((cur->content == NULL) || (cur->content[0] == '\0')) {
+            continue;
+        }
+
+        ret = xmlSecBase64CtxUpdate(ctx, cur->content, xmlStrlen(cur->content),
+                                    xmlSecBufferGetData(buf) + size,
+                                    xmlSecBufferGetMaxSize(buf) - size);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBase64CtxUpdate", NULL);
+            xmlSecBase64CtxDestroy(ctx);
+            return(-1);
+        }
+        size += ret;
+    }
+
+    ret = xmlSecBase64CtxFinal(ctx, xmlSecBufferGetData(buf) + size,
+                               xmlSecBufferGetMaxSize(buf) - size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxFinal", NULL);
+        xmlSecBase64CtxDestroy(ctx);
+        return(-1);
+    }
+    size += ret;
+    xmlSecBase64CtxDestroy(ctx);
+
+    ret = xmlSecBufferSetSize(buf, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetSize", NULL, "size=" XMLSEC_SIZE_FMT, size);
+        return(-1);
+    }
+    return(1);
+}
+
 /**
  * xmlSecBufferBase64NodeContentRead:
  * @buf:                the pointer to buffer object.
@@ -490,6 +925,15 @@ xmlSecBufferBase64NodeContentRead(xmlSecBufferPtr buf, xmlNodePtr node) {
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
+    /* decode text children in place if possible */
+    ret = xmlSecBufferBase64TextChildrenRead(buf, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferBase64TextChildrenRead", NULL);
+        return(-1);
+    } else if(ret > 0) {
+        return(0);
+    }
+
     content = xmlNodeGetContent(node);
     if(content == NULL) {
         xmlSecInvalidNodeContentError(node, NULL, "empty");
@@ -536,6 +980,7 @@ xmlSecBufferBase64NodeContentRead(xmlSecBufferPtr buf, xmlNodePtr node) {
 int
 xmlSecBufferBase64NodeContentWrite(xmlSecBufferPtr buf, xmlNodePtr node, int columns) {
     xmlChar* content;
+    xmlNodePtr text;
 
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
@@ -545,8 +990,27 @@ xmlSecBufferBase64NodeContentWrite(xmlSecBufferPtr buf, xmlNodePtr node, int col
         xmlSecInternalError("xmlSecBase64Encode", NULL);
         return(-1);
     }
-    xmlNodeAddContent(node, content);
-    xmlFree(content);
+
+    /* the text would be merged into the existing text node anyway */
+    if((node->type != XML_ELEMENT_NODE) || ((node->last != NULL) && (node->last->type == XML_TEXT_NODE))) {
+        xmlNodeAddContent(node, content);
+        xmlFree(content);
+        return(0);
+    }
+
+    /* the new text node takes the encoded string as is (no copy) */
+    text = xmlNewDocText(node->doc, NULL);
+    if(text == NULL) {
+        xmlSecXmlError("xmlNewDocText", NULL);
+        xmlFree(content);
+        return(-1);
+    }
+    text->content = content;
+    if(xmlAddChild(node, text) == NULL) {
+        xmlSecXmlError("xmlAddChild", NULL);
+        xmlFreeNode(text);
+        return(-1);
+    }
 
     return(0);
 }
@@ -602,3 +1066,222 @@ xmlSecBufferIOClose(xmlSecBufferPtr buf) {
     /* just do nothing */
     return(0);
 }
+
+/*****************************************************************************
+ *
+ * xmlSecArena: the memory for the objects that live as long as one
+ * sign, verify, encrypt or decrypt operation. The memory is allocated
+ * in chunks and is released all at once by xmlSecArenaReset() or
+ * xmlSecArenaDestroy().
+ *
+ ****************************************************************************/
+#define XMLSEC_ARENA_CHUNK_SIZE                 4096
+#define xmlSecArenaAlignSize(size)              \
+    (((size) + sizeof(void*) - 1) & ~((xmlSecSize)sizeof(void*) - 1))
+
+typedef struct _xmlSecArenaChunk                xmlSecArenaChunk,
+                                                *xmlSecArenaChunkPtr;
+struct _xmlSecArenaChunk {
+    xmlSecArenaChunkPtr         next;
+    xmlSecSize                  size;
+    xmlSecSize                  used;
+};
+
+struct _xmlSecArena {
+    xmlSecArenaChunkPtr         chunks;
+};
+
+#define xmlSecArenaChunkHeaderSize              \
+    xmlSecArenaAlignSize(sizeof(xmlSecArenaChunk))
+#define xmlSecArenaChunkData(chunk)             \
+    (((xmlSecByte*)(chunk)) + xmlSecArenaChunkHeaderSize)
+
+/**
+ * xmlSecArenaCreate:
+ *
+ * Creates new empty arena. The caller is responsible for destroying
+ * returned object with #xmlSecArenaDestroy function.
+ *
+ * Returns: pointer to newly allocated arena or NULL if an error occurs.
+ */
+xmlSecArenaPtr
+xmlSecArenaCreate(void) {
+    xmlSecArenaPtr arena;
+
+    arena = (xmlSecArenaPtr)xmlMalloc(sizeof(xmlSecArena));
+    if(arena == NULL) {
+        xmlSecMallocError(sizeof(xmlSecArena), NULL);
+        return(NULL);
+    }
+    memset(arena, 0, sizeof(xmlSecArena));
+    return(arena);
+}
+
+/**
+ * xmlSecArenaDestroy:
+ * @arena:              the pointer to arena.
+ *
+ * Frees all the memory allocated from the @arena and the @arena itself.
+ */
+void
+xmlSecArenaDestroy(xmlSecArenaPtr arena) {
+    xmlSecArenaChunkPtr chunk;
+
+    xmlSecAssert(arena != NULL);
+
+    while(arena->chunks != NULL) {
+        chunk = arena->chunks;
+        arena->chunks = chunk->next;
+
+        memset(chunk, 0, xmlSecArenaChunkHeaderSize + chunk->used);
+        xmlFree(chunk);
+    }
+    xmlFree(arena);
+}
+
+/**
+ * xmlSecArenaReset:
+ * @arena:              the pointer to arena.
+ *
+ * Frees all the memory allocated from the @arena; one chunk is kept
+ * for the next operation.
+ */
+void
+xmlSecArenaReset(xmlSecArenaPtr arena) {
+    xmlSecArenaChunkPtr chunk, kept = NULL;
+
+    xmlSecAssert(arena != NULL);
+
+    while(arena->chunks != NULL) {
+        chunk = arena->chunks;
+        arena->chunks = chunk->next;
+
+        memset(xmlSecArenaChunkData(chunk), 0, chunk->used);
+        chunk->used = 0;
+        if((kept == NULL) && (chunk->size == XMLSEC_ARENA_CHUNK_SIZE)) {
+            kept = chunk;
+        } else {
+            memset(chunk, 0, xmlSecArenaChunkHeaderSize);
+            xmlFree(chunk);
+        }
+    }
+    if(kept != NULL) {
+        kept->next = NULL;
+        arena->chunks = kept;
+    }
+}
+
+/**
+ * xmlSecArenaAlloc:
+ * @arena:              the pointer to arena.
+ * @size:               the requested size.
+ *
+ * Allocates @size bytes from the @arena. The memory is released
+ * by #xmlSecArenaReset or #xmlSecArenaDestroy functions
+ * and must not be freed with xmlFree().
+ *
+ * Returns: pointer to the allocated (zeroed) memory or NULL if an error occurs.
+ */
+void*
+xmlSecArenaAlloc(xmlSecArenaPtr arena, xmlSecSize size) {
+    xmlSecArenaChunkPtr chunk;
+    xmlSecSize chunkSize;
+    void* res;
+
+    xmlSecAssert2(arena != NULL, NULL);
+
+    size = xmlSecArenaAlignSize(size);
+    chunk = arena->chunks;
+    if((chunk == NULL) || (chunk->used + size > chunk->size)) {
+        chunkSize = (size > XMLSEC_ARENA_CHUNK_SIZE) ? size : XMLSEC_ARENA_CHUNK_SIZE;
+        chunk = (xmlSecArenaChunkPtr)xmlMalloc(xmlSecArenaChunkHeaderSize + chunkSize);
+        if(chunk == NULL) {
+            xmlSecMallocError(xmlSecArenaChunkHeaderSize + chunkSize, NULL);
+            return(NULL);
+        }
+        memset(chunk, 0, xmlSecArenaChunkHeaderSize + chunkSize);
+        chunk->size = chunkSize;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    res = xmlSecArenaChunkData(chunk) + chunk->used;
+    chunk->used += size;
+    return(res);
+}
+
+/**
+ * xmlSecArenaStrndup:
+ * @arena:              the pointer to arena.
+ * @str:                the source string.
+ * @len:                the number of chars to copy from @str.
+ *
+ * Copies the first @len chars of @str to the memory allocated from @arena.
+ *
+ * Returns: the NULL terminated copy of @str or NULL if an error occurs.
+ */
+xmlChar*
+xmlSecArenaStrndup(xmlSecArenaPtr arena, const xmlChar* str, xmlSecSize len) {
+    xmlChar* res;
+
+    xmlSecAssert2(arena != NULL, NULL);
+    xmlSecAssert2(str != NULL, NULL);
+
+    res = (xmlChar*)xmlSecArenaAlloc(arena, len + 1);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecArenaAlloc", NULL);
+        return(NULL);
+    }
+    memcpy(res, str, len);
+    res[len] = '\0';
+    return(res);
+}
+
+/**
+ * xmlSecArenaGetProp:
+ * @arena:              the pointer to arena.
+ * @node:               the pointer to node.
+ * @name:               the attribute name (without namespace).
+ *
+ * The same as xmlGetProp() but the result is allocated from @arena.
+ *
+ * Returns: the attribute value or NULL if the attribute doesn't
+ * exist or an error occurs.
+ */
+xmlChar*
+xmlSecArenaGetProp(xmlSecArenaPtr arena, xmlNodePtr node, const xmlChar* name) {
+    xmlAttrPtr attr;
+    xmlChar* value;
+    xmlChar* res;
+
+    xmlSecAssert2(arena != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+
+    /* fast path: the attribute is a single text node */
+    if(node->type == XML_ELEMENT_NODE) {
+        for(attr = node->properties; attr != NULL; attr = attr->next) {
+            if((attr->ns != NULL) || !xmlStrEqual(attr->name, name)) {
+                continue;
+            }
+            if(attr->children == NULL) {
+                return(xmlSecArenaStrndup(arena, BAD_CAST "", 0));
+            }
+            if((attr->children->next == NULL) &&
+               ((attr->children->type == XML_TEXT_NODE) || (attr->children->type == XML_CDATA_SECTION_NODE)) &&
+               (attr->children->content != NULL)) {
+                return(xmlSecArenaStrndup(arena, attr->children->content, xmlStrlen(attr->children->content)));
+            }
+            break;
+        }
+    }
+
+    /* entities, DTD defaults, etc. */
+    value = xmlGetProp(node, name);
+    if(value == NULL) {
+        return(NULL);
+    }
+    res = xmlSecArenaStrndup(arena, value, xmlStrlen(value));
+    xmlFree(value);
+    return(res);
+}
@@ -15,34 +15,250 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/parserInternals.h>
 #include <libxml/c14n.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/list.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/xmltree.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/c14nnative.h>
+#include <xmlsec/private/transforms.h>
+
+/******************************************************************************
+ *
+ * InclusiveNamespaces PrefixList cache
+ *
+ * SAML and WS-Security messages use the same few PrefixList values in
+ * every exclusive c14n transform. The parsed prefixes are shared between
+ * all the threads: an entry is never changed after it is created and it
+ * is reference counted so the cache can be flushed while the prefixes
+ * are used by a transform.
+ *
+ *****************************************************************************/
+#define XMLSEC_C14N_PREFIX_LIST_CACHE_MAX_SIZE          256
+
+typedef struct _xmlSecC14NPrefixList            xmlSecC14NPrefixList,
+                                                *xmlSecC14NPrefixListPtr;
+struct _xmlSecC14NPrefixList {
+    xmlChar**                   prefixes;       /* NULL terminated */
+    int                         refs;
+    xmlSecC14NPrefixListPtr     next;
+};
+
+static xmlMutexPtr              xmlSecC14NPrefixListCacheMutex   = NULL;
+static xmlHashTablePtr          xmlSecC14NPrefixListCacheTable   = NULL;
+static xmlSecC14NPrefixListPtr  xmlSecC14NPrefixListCacheEntries = NULL;
+
+static void
+xmlSecC14NPrefixListRelease(xmlSecC14NPrefixListPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->refs > 0);
+
+    if((--entry->refs) > 0) {
+        return;
+    }
+    /* the prefixes are allocated together with the entry */
+    xmlFree(entry);
+}
+
+/* must be called under the lock */
+static void
+xmlSecC14NPrefixListCacheEntriesRelease(void) {
+    xmlSecC14NPrefixListPtr entry;
+
+    if(xmlSecC14NPrefixListCacheTable != NULL) {
+        xmlHashFree(xmlSecC14NPrefixListCacheTable, NULL);
+        xmlSecC14NPrefixListCacheTable = NULL;
+    }
+    while((entry = xmlSecC14NPrefixListCacheEntries) != NULL) {
+        xmlSecC14NPrefixListCacheEntries = entry->next;
+        entry->next = NULL;
+        xmlSecC14NPrefixListRelease(entry);
+    }
+}
+
+/**
+ * xmlSecTransformC14NCacheInitialize:
+ *
+ * Initializes the InclusiveNamespaces PrefixList cache. This function is
+ * called from the #xmlSecTransformIdsInit function.
+ */
+void
+xmlSecTransformC14NCacheInitialize(void) {
+    if(xmlSecC14NPrefixListCacheMutex == NULL) {
+        xmlSecC14NPrefixListCacheMutex = xmlNewMutex();
+        if(xmlSecC14NPrefixListCacheMutex == NULL) {
+            /* the prefixes will be parsed every time */
+            xmlSecXmlError("xmlNewMutex", NULL);
+        }
+    }
+}
+
+/**
+ * xmlSecTransformC14NCacheShutdown:
+ *
+ * Destroys the InclusiveNamespaces PrefixList cache. This function is
+ * called from the #xmlSecTransformIdsShutdown function.
+ */
+void
+xmlSecTransformC14NCacheShutdown(void) {
+    if(xmlSecC14NPrefixListCacheMutex != NULL) {
+        xmlSecC14NPrefixListCacheEntriesRelease();
+        xmlFreeMutex(xmlSecC14NPrefixListCacheMutex);
+        xmlSecC14NPrefixListCacheMutex = NULL;
+    }
+}
+
+/* the list of namespaces is space separated: the entry, the prefixes
+ * array and the split copy of the @list are allocated in one block */
+static xmlSecC14NPrefixListPtr
+xmlSecC14NPrefixListCreate(const xmlChar* list) {
+    xmlSecC14NPrefixListPtr entry;
+    xmlSecSize listSize, count, size, pos;
+    xmlChar *p, *n;
+    const xmlChar* cur;
+
+    xmlSecAssert2(list != NULL, NULL);
+
+    listSize = (xmlSecSize)xmlStrlen(list);
+    for(cur = list, count = 1; (*cur) != '\0'; ++cur) {
+        if((*cur) == ' ') {
+            ++count;
+        }
+    }
+
+    size = sizeof(xmlSecC14NPrefixList) + (count + 1) * sizeof(xmlChar*) + listSize + 1;
+    entry = (xmlSecC14NPrefixListPtr)xmlMalloc(size);
+    if(entry == NULL) {
+        xmlSecMallocError(size, NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecC14NPrefixList));
+    entry->refs = 1;
+    entry->prefixes = (xmlChar**)(((xmlSecByte*)entry) + sizeof(xmlSecC14NPrefixList));
+
+    p = (xmlChar*)(entry->prefixes + count + 1);
+    memcpy(p, list, listSize + 1);
+    for(pos = 0, n = p; ((p != NULL) && ((*p) != '\0')); p = n) {
+        n = (xmlChar*)xmlStrchr(p, ' ');
+        if(n != NULL) {
+            *(n++) = '\0';
+        }
+        entry->prefixes[pos++] = p;
+    }
+    entry->prefixes[pos] = NULL;
+    return(entry);
+}
+
+static xmlSecC14NPrefixListPtr
+xmlSecC14NPrefixListAcquire(const xmlChar* list) {
+    xmlSecC14NPrefixListPtr entry;
+    xmlSecC14NPrefixListPtr tmp;
+
+    xmlSecAssert2(list != NULL, NULL);
+
+    if(xmlSecC14NPrefixListCacheMutex != NULL) {
+        xmlMutexLock(xmlSecC14NPrefixListCacheMutex);
+        if(xmlSecC14NPrefixListCacheTable != NULL) {
+            entry = (xmlSecC14NPrefixListPtr)xmlHashLookup(xmlSecC14NPrefixListCacheTable, list);
+            if(entry != NULL) {
+                ++entry->refs;
+                xmlMutexUnlock(xmlSecC14NPrefixListCacheMutex);
+                return(entry);
+            }
+        }
+        xmlMutexUnlock(xmlSecC14NPrefixListCacheMutex);
+    }
+
+    /* parse outside of the lock */
+    entry = xmlSecC14NPrefixListCreate(list);
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecC14NPrefixListCreate", NULL);
+        return(NULL);
+    }
+
+    if(xmlSecC14NPrefixListCacheMutex == NULL) {
+        return(entry);
+    }
+
+    xmlMutexLock(xmlSecC14NPrefixListCacheMutex);
+    if((xmlSecC14NPrefixListCacheTable != NULL) &&
+       (xmlHashSize(xmlSecC14NPrefixListCacheTable) >= XMLSEC_C14N_PREFIX_LIST_CACHE_MAX_SIZE)) {
+        xmlSecC14NPrefixListCacheEntriesRelease();
+    }
+    if(xmlSecC14NPrefixListCacheTable == NULL) {
+        xmlSecC14NPrefixListCacheTable = xmlHashCreate(0);
+    }
+    if(xmlSecC14NPrefixListCacheTable != NULL) {
+        /* another thread might be faster */
+        tmp = (xmlSecC14NPrefixListPtr)xmlHashLookup(xmlSecC14NPrefixListCacheTable, list);
+        if(tmp != NULL) {
+            ++tmp->refs;
+            xmlMutexUnlock(xmlSecC14NPrefixListCacheMutex);
+            xmlSecC14NPrefixListRelease(entry);
+            return(tmp);
+        }
+        if(xmlHashAddEntry(xmlSecC14NPrefixListCacheTable, list, entry) == 0) {
+            ++entry->refs;
+            entry->next = xmlSecC14NPrefixListCacheEntries;
+            xmlSecC14NPrefixListCacheEntries = entry;
+        }
+    }
+    xmlMutexUnlock(xmlSecC14NPrefixListCacheMutex);
+    return(entry);
+}
+
+static void
+xmlSecC14NPrefixListCacheRelease(xmlSecC14NPrefixListPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(xmlSecC14NPrefixListCacheMutex != NULL) {
+        xmlMutexLock(xmlSecC14NPrefixListCacheMutex);
+        xmlSecC14NPrefixListRelease(entry);
+        xmlMutexUnlock(xmlSecC14NPrefixListCacheMutex);
+    } else {
+        xmlSecC14NPrefixListRelease(entry);
+    }
+}
 
 /******************************************************************************
  *
  * C14N transforms
  *
- * Inclusive namespaces list for ExclC14N (xmlSecStringList) is located
- * after xmlSecTransform structure
+ * xmlSecTransformC14NCtx is located after xmlSecTransform structure.
  *
  *****************************************************************************/
+typedef struct _xmlSecTransformC14NCtx          xmlSecTransformC14NCtx,
+                                                *xmlSecTransformC14NCtxPtr;
+struct _xmlSecTransformC14NCtx {
+    /* inclusive namespaces prefixes for ExclC14N (shared, read-only) */
+    xmlSecC14NPrefixListPtr     prefixList;
+
+    /* C14N 2.0 parameters */
+    int                         withComments;
+    int                         trimTextNodes;
+};
+
 #define xmlSecTransformC14NSize \
-    (sizeof(xmlSecTransform) + sizeof(xmlSecPtrList))
-#define xmlSecTransformC14NGetNsList(transform) \
+    (sizeof(xmlSecTransform) + sizeof(xmlSecTransformC14NCtx))
+#define xmlSecTransformC14NGetCtx(transform) \
     ((xmlSecTransformCheckSize((transform), xmlSecTransformC14NSize)) ? \
-        (xmlSecPtrListPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform)) : \
-        (xmlSecPtrListPtr)NULL)
+        (xmlSecTransformC14NCtxPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform)) : \
+        (xmlSecTransformC14NCtxPtr)NULL)
+#define xmlSecTransformC14NGetPrefixes(ctx) \
+    (((ctx)->prefixList != NULL) ? (ctx)->prefixList->prefixes : (xmlChar**)NULL)
 
 #define xmlSecTransformC14NCheckId(transform) \
     (xmlSecTransformInclC14NCheckId((transform)) || \
      xmlSecTransformInclC14N11CheckId((transform)) || \
      xmlSecTransformExclC14NCheckId((transform)) || \
+     xmlSecTransformCheckId((transform), xmlSecTransformC14N2Id) || \
      xmlSecTransformCheckId((transform), xmlSecTransformRemoveXmlTagsC14NId))
 #define xmlSecTransformInclC14NCheckId(transform) \
     (xmlSecTransformCheckId((transform), xmlSecTransformInclC14NId) || \
@@ -57,12 +273,24 @@
 
 static int              xmlSecTransformC14NInitialize   (xmlSecTransformPtr transform);
 static void             xmlSecTransformC14NFinalize     (xmlSecTransformPtr transform);
+static int              xmlSecTransformC14NReset        (xmlSecTransformPtr transform);
 static int              xmlSecTransformC14NNodeRead     (xmlSecTransformPtr transform,
                                                          xmlNodePtr node,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecTransformC14N2NodeRead    (xmlSecTransformPtr transform,
+                                                         xmlNodePtr node,
+                                                         xmlSecTransformCtxPtr transformCtx);
+static xmlSecTransformDataType xmlSecTransformC14NGetDataType(xmlSecTransformPtr transform,
+                                                         xmlSecTransformMode mode,
+                                                         xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecTransformC14NPushXml      (xmlSecTransformPtr transform,
                                                          xmlSecNodeSetPtr nodes,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecTransformC14NPopXml       (xmlSecTransformPtr transform,
+                                                         xmlSecNodeSetPtr* nodes,
+                                                         xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecTransformC14NKeepNodes    (xmlSecTransformPtr transform,
+                                                         xmlSecNodeSetPtr nodes);
 static int              xmlSecTransformC14NPopBin       (xmlSecTransformPtr transform,
                                                          xmlSecByte* data,
                                                          xmlSecSize maxDataSize,
@@ -70,55 +298,68 @@ static int              xmlSecTransformC14NPopBin       (xmlSecTransformPtr tran
                                                          xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecTransformC14NExecute      (xmlSecTransformId id,
                                                          xmlSecNodeSetPtr nodes,
-                                                         xmlChar** nsList,
+                                                         xmlSecTransformC14NCtxPtr ctx,
+                                                         int parallel,
                                                          xmlOutputBufferPtr buf);
 static int
 xmlSecTransformC14NInitialize(xmlSecTransformPtr transform) {
-    xmlSecPtrListPtr nsList;
-    int ret;
+    xmlSecTransformC14NCtxPtr ctx;
 
     xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
 
-    nsList = xmlSecTransformC14NGetNsList(transform);
-    xmlSecAssert2(nsList != NULL, -1);
-
-    ret = xmlSecPtrListInitialize(nsList, xmlSecStringListId);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecPtrListInitialize",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    memset(ctx, 0, sizeof(xmlSecTransformC14NCtx));
     return(0);
 }
 
 static void
 xmlSecTransformC14NFinalize(xmlSecTransformPtr transform) {
-    xmlSecPtrListPtr nsList;
+    xmlSecTransformC14NCtxPtr ctx;
 
     xmlSecAssert(xmlSecTransformC14NCheckId(transform));
 
-    nsList = xmlSecTransformC14NGetNsList(transform);
-    xmlSecAssert(xmlSecPtrListCheckId(nsList, xmlSecStringListId));
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->prefixList != NULL) {
+        xmlSecC14NPrefixListCacheRelease(ctx->prefixList);
+    }
+    memset(ctx, 0, sizeof(xmlSecTransformC14NCtx));
+}
+
+static int
+xmlSecTransformC14NReset(xmlSecTransformPtr transform) {
+    xmlSecTransformC14NCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
+
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
 
-    xmlSecPtrListFinalize(nsList);
+    if(ctx->prefixList != NULL) {
+        xmlSecC14NPrefixListCacheRelease(ctx->prefixList);
+        ctx->prefixList = NULL;
+    }
+    ctx->withComments = 0;
+    ctx->trimTextNodes = 0;
+    return(0);
 }
 
 static int
 xmlSecTransformC14NNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransformCtxPtr transformCtx) {
-    xmlSecPtrListPtr nsList;
+    xmlSecTransformC14NCtxPtr ctx;
     xmlNodePtr cur;
     xmlChar *list;
-    xmlChar *p, *n, *tmp;
-    int ret;
 
     /* we have something to read only for exclusive c14n transforms */
     xmlSecAssert2(xmlSecTransformExclC14NCheckId(transform), -1);
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
-    nsList = xmlSecTransformC14NGetNsList(transform);
-    xmlSecAssert2(xmlSecPtrListCheckId(nsList, xmlSecStringListId), -1);
-    xmlSecAssert2(xmlSecPtrListGetSize(nsList) == 0, -1);
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->prefixList == NULL, -1);
 
     /* there is only one optional node */
     cur = xmlSecGetNextElementNode(node->children);
@@ -137,38 +378,14 @@ xmlSecTransformC14NNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlSe
             return(-1);
         }
 
-        /* the list of namespaces is space separated */
-        for(p = n = list; ((p != NULL) && ((*p) != '\0')); p = n) {
-            n = (xmlChar*)xmlStrchr(p, ' ');
-            if(n != NULL) {
-                *(n++) = '\0';
-            }
-
-            tmp = xmlStrdup(p);
-            if(tmp == NULL) {
-                xmlSecStrdupError(p, xmlSecTransformGetName(transform));
-                xmlFree(list);
-                return(-1);
-            }
-
-            ret = xmlSecPtrListAdd(nsList, tmp);
-            if(ret < 0) {
-                xmlSecInternalError("xmlSecPtrListAdd",
-                                    xmlSecTransformGetName(transform));
-                xmlFree(tmp);
-                xmlFree(list);
-                return(-1);
-            }
-        }
-        xmlFree(list);
-
-        /* add NULL at the end */
-        ret = xmlSecPtrListAdd(nsList, NULL);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListAdd",
+        ctx->prefixList = xmlSecC14NPrefixListAcquire(list);
+        if(ctx->prefixList == NULL) {
+            xmlSecInternalError("xmlSecC14NPrefixListAcquire",
                                 xmlSecTransformGetName(transform));
+            xmlFree(list);
             return(-1);
         }
+        xmlFree(list);
 
         cur = xmlSecGetNextElementNode(cur->next);
     }
@@ -182,11 +399,65 @@ xmlSecTransformC14NNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlSe
     return(0);
 }
 
+/* the canonical form is XML by itself: with the XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS
+ * flag the transform also returns the nodes for the next transform instead
+ * of serializing them for the parser */
+static xmlSecTransformDataType
+xmlSecTransformC14NGetDataType(xmlSecTransformPtr transform, xmlSecTransformMode mode,
+                               xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformDataType type;
+
+    xmlSecAssert2(xmlSecTransformC14NCheckId(transform), xmlSecTransformDataTypeUnknown);
+    xmlSecAssert2(transformCtx != NULL, xmlSecTransformDataTypeUnknown);
+
+    type = xmlSecTransformDefaultGetDataType(transform, mode, transformCtx);
+    if((mode == xmlSecTransformModePop) &&
+       ((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS) == 0)) {
+        type &= ~xmlSecTransformDataTypeXml;
+    }
+    return(type);
+}
+
+static int
+xmlSecTransformC14NKeepNodes(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes) {
+    xmlSecNodeSetPtr children;
+
+    xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(nodes->doc != NULL, -1);
+    xmlSecAssert2(transform->outNodes == NULL, -1);
+
+    transform->inNodes = nodes;
+    if(xmlSecTransformCheckId(transform, xmlSecTransformInclC14NWithCommentsId) ||
+       xmlSecTransformCheckId(transform, xmlSecTransformInclC14N11WithCommentsId) ||
+       xmlSecTransformCheckId(transform, xmlSecTransformExclC14NWithCommentsId)) {
+        transform->outNodes = nodes;
+        return(0);
+    }
+
+    /* the canonical form would not have comments */
+    children = xmlSecNodeSetGetChildren(nodes->doc, NULL, 0, 0);
+    if(children == NULL) {
+        xmlSecInternalError("xmlSecNodeSetGetChildren",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    transform->outNodes = xmlSecNodeSetAdd(nodes, children, xmlSecNodeSetIntersection);
+    if(transform->outNodes == NULL) {
+        xmlSecInternalError("xmlSecNodeSetAdd",
+                            xmlSecTransformGetName(transform));
+        xmlSecNodeSetDestroy(children);
+        return(-1);
+    }
+    return(0);
+}
+
 static int
 xmlSecTransformC14NPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
                             xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformC14NCtxPtr ctx;
     xmlOutputBufferPtr buf;
-    xmlSecPtrListPtr nsList;
     int ret;
 
     xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
@@ -208,6 +479,42 @@ xmlSecTransformC14NPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
     }
     xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
 
+    /* the next transform takes XML: pass the nodes without serializing them */
+    if((transform->next != NULL) &&
+       ((xmlSecTransformC14NGetDataType(transform, xmlSecTransformModePop, transformCtx) & xmlSecTransformDataTypeXml) != 0) &&
+       ((xmlSecTransformGetDataType(transform->next, xmlSecTransformModePush, transformCtx) & xmlSecTransformDataTypeXml) != 0)) {
+        ret = xmlSecTransformC14NKeepNodes(transform, nodes);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformC14NKeepNodes",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        transform->status = xmlSecTransformStatusFinished;
+
+        ret = xmlSecTransformPushXml(transform->next, transform->outNodes, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPushXml",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        return(0);
+    }
+
+    /* the base64 encoded text goes to the base64 transform without staging */
+    if((transform->id == xmlSecTransformRemoveXmlTagsC14NId) && (transform->next != NULL) &&
+       (transform->next->id == xmlSecTransformBase64Id) &&
+       (transform->next->operation == xmlSecTransformOperationDecode) &&
+       (transform->next->status == xmlSecTransformStatusNone)) {
+        ret = xmlSecTransformBase64DecodeTextNodes(transform->next, nodes, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformBase64DecodeTextNodes",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        transform->status = xmlSecTransformStatusFinished;
+        return(0);
+    }
+
     /* prepare output buffer: next transform or ourselves */
     if(transform->next != NULL) {
         buf = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
@@ -225,12 +532,11 @@ xmlSecTransformC14NPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
         }
     }
 
-    /* we are using a semi-hack here: we know that xmlSecPtrList keeps
-     * all pointers in the big array */
-    nsList = xmlSecTransformC14NGetNsList(transform);
-    xmlSecAssert2(xmlSecPtrListCheckId(nsList, xmlSecStringListId), -1);
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
 
-    ret = xmlSecTransformC14NExecute(transform->id, nodes, (xmlChar**)(nsList->data), buf);
+    ret = xmlSecTransformC14NExecute(transform->id, nodes, ctx,
+        ((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N) != 0) ? 1 : 0, buf);
     if(ret < 0) {
         xmlSecInternalError("xmlSecTransformC14NExecute",
                             xmlSecTransformGetName(transform));
@@ -243,6 +549,7 @@ xmlSecTransformC14NPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
         xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
         return(-1);
     }
+    xmlSecMetricsAdd(xmlSecMetricC14NBytes, (xmlSecSize)ret);
     transform->status = xmlSecTransformStatusFinished;
     return(0);
 }
@@ -251,7 +558,7 @@ static int
 xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
                             xmlSecSize maxDataSize, xmlSecSize* dataSize,
                             xmlSecTransformCtxPtr transformCtx) {
-    xmlSecPtrListPtr nsList;
+    xmlSecTransformC14NCtxPtr ctx;
     xmlSecBufferPtr out;
     int ret;
 
@@ -289,12 +596,11 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             return(-1);
         }
 
-        /* we are using a semi-hack here: we know that xmlSecPtrList keeps
-         * all pointers in the big array */
-        nsList = xmlSecTransformC14NGetNsList(transform);
-        xmlSecAssert2(xmlSecPtrListCheckId(nsList, xmlSecStringListId), -1);
+        ctx = xmlSecTransformC14NGetCtx(transform);
+        xmlSecAssert2(ctx != NULL, -1);
 
-        ret = xmlSecTransformC14NExecute(transform->id, transform->inNodes, (xmlChar**)(nsList->data), buf);
+        ret = xmlSecTransformC14NExecute(transform->id, transform->inNodes, ctx,
+            ((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N) != 0) ? 1 : 0, buf);
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformC14NExecute",
                                 xmlSecTransformGetName(transform));
@@ -306,6 +612,7 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
             return(-1);
         }
+        xmlSecMetricsAdd(xmlSecMetricC14NBytes, (xmlSecSize)ret);
         transform->status = xmlSecTransformStatusWorking;
     }
 
@@ -317,8 +624,8 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
         if(outSize > maxDataSize) {
             outSize = maxDataSize;
         }
-        if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-            outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+        if(outSize > xmlSecTransformCtxGetBinaryChunkSize(transformCtx)) {
+            outSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
         }
         if(outSize > 0) {
             xmlSecAssert2(xmlSecBufferGetData(&(transform->outBuf)), -1);
@@ -348,42 +655,236 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
 }
 
 static int
-xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlChar** nsList,
-                           xmlOutputBufferPtr buf) {
+xmlSecTransformC14NPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
+                          xmlSecTransformCtxPtr transformCtx) {
+    xmlSecNodeSetPtr inNodes = NULL;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformC14NCheckId(transform), -1);
+    xmlSecAssert2(transform->inNodes == NULL, -1);
+    xmlSecAssert2(transform->outNodes == NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    if(transform->prev == NULL) {
+        xmlSecInvalidTransfromError2(transform,
+                                     "prev transform=\"%s\"",
+                                     xmlSecErrorsSafeString(transform->prev));
+        return(-1);
+    }
+
+    ret = xmlSecTransformPopXml(transform->prev, &inNodes, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPopXml",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    ret = xmlSecTransformC14NKeepNodes(transform, inNodes);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformC14NKeepNodes",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    transform->status = xmlSecTransformStatusFinished;
+
+    if(nodes != NULL) {
+        (*nodes) = transform->outNodes;
+    }
+    return(0);
+}
+
+/**
+ * xmlSecTransformC14NGetInclusiveNsList:
+ * @transform:          the pointer to exclusive c14n transform.
+ *
+ * Gets the inclusive namespaces prefixes read from the
+ * <ec:InclusiveNamespaces/> node.
+ *
+ * Returns: the NULL terminated list of prefixes or NULL if it is empty.
+ */
+xmlChar**
+xmlSecTransformC14NGetInclusiveNsList(xmlSecTransformPtr transform) {
+    xmlSecTransformC14NCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformExclC14NCheckId(transform), NULL);
+
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    return(xmlSecTransformC14NGetPrefixes(ctx));
+}
+
+/**
+ * xmlSecTransformC14N2GetTrimTextNodes:
+ * @transform:          the pointer to C14N 2.0 transform.
+ *
+ * Gets the TrimTextNodes parameter read from the transform node.
+ *
+ * Returns: 1 if the whitespace in the text nodes is trimmed or 0 otherwise.
+ */
+int
+xmlSecTransformC14N2GetTrimTextNodes(xmlSecTransformPtr transform) {
+    xmlSecTransformC14NCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformC14N2Id), 0);
+
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, 0);
+
+    return(ctx->trimTextNodes);
+}
+
+/* reads the xsd:boolean content of the C14N 2.0 parameter node */
+static int
+xmlSecTransformC14N2ReadBoolean(xmlSecTransformPtr transform, xmlNodePtr node, int* value) {
+    xmlChar* content;
+    xmlChar* start;
+    xmlChar* end;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(value != NULL, -1);
+
+    content = xmlNodeGetContent(node);
+    if(content == NULL) {
+        xmlSecInvalidNodeContentError(node, xmlSecTransformGetName(transform), "empty");
+        return(-1);
+    }
+    for(start = content; IS_BLANK_CH(*start); ++start);
+    for(end = start + xmlStrlen(start); (end > start) && IS_BLANK_CH(*(end - 1)); --end);
+    (*end) = '\0';
+
+    if(xmlStrEqual(start, BAD_CAST "true") || xmlStrEqual(start, BAD_CAST "1")) {
+        (*value) = 1;
+    } else if(xmlStrEqual(start, BAD_CAST "false") || xmlStrEqual(start, BAD_CAST "0")) {
+        (*value) = 0;
+    } else {
+        xmlSecInvalidNodeContentError(node, xmlSecTransformGetName(transform), "boolean expected");
+        xmlFree(content);
+        return(-1);
+    }
+    xmlFree(content);
+    return(0);
+}
+
+static int
+xmlSecTransformC14N2NodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformC14NCtxPtr ctx;
+    xmlNodePtr cur;
+    xmlChar* content;
+    int ignoreComments = 1;
+    int trimTextNodes = 0;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformC14N2Id), -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecTransformC14NGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* all the parameters are optional */
+    for(cur = xmlSecGetNextElementNode(node->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeC14N2IgnoreComments, xmlSecNsC14N2)) {
+            ret = xmlSecTransformC14N2ReadBoolean(transform, cur, &ignoreComments);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformC14N2ReadBoolean",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeC14N2TrimTextNodes, xmlSecNsC14N2)) {
+            ret = xmlSecTransformC14N2ReadBoolean(transform, cur, &trimTextNodes);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformC14N2ReadBoolean",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeC14N2PrefixRewrite, xmlSecNsC14N2)) {
+            /* only the default "none" is supported */
+            content = xmlNodeGetContent(cur);
+            if((content == NULL) || !xmlStrEqual(content, BAD_CAST "none")) {
+                xmlSecOtherError2(XMLSEC_ERRORS_R_NOT_IMPLEMENTED, xmlSecTransformGetName(transform),
+                                  "PrefixRewrite=%s", xmlSecErrorsSafeString(content));
+                if(content != NULL) {
+                    xmlFree(content);
+                }
+                return(-1);
+            }
+            xmlFree(content);
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeC14N2QNameAware, xmlSecNsC14N2)) {
+            /* the QName aware elements and attributes are not supported */
+            if(xmlSecGetNextElementNode(cur->children) != NULL) {
+                xmlSecOtherError(XMLSEC_ERRORS_R_NOT_IMPLEMENTED, xmlSecTransformGetName(transform),
+                                 "QNameAware");
+                return(-1);
+            }
+        } else {
+            xmlSecUnexpectedNodeError(cur, xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+
+    ctx->withComments = (ignoreComments != 0) ? 0 : 1;
+    ctx->trimTextNodes = trimTextNodes;
+    return(0);
+}
+
+static int
+xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlSecTransformC14NCtxPtr ctx,
+                           int parallel, xmlOutputBufferPtr buf) {
+    xmlChar** nsList;
+    int mode, withComments;
+    int treeWithComments = 1;
     int ret;
 
     xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
     xmlSecAssert2(nodes != NULL, -1);
     xmlSecAssert2(nodes->doc != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(buf != NULL, -1);
 
-    /* execute c14n transform */
+    nsList = xmlSecTransformC14NGetPrefixes(ctx);
+
+    /* select c14n mode */
     if(id == xmlSecTransformInclC14NId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 0, buf);
+        mode = XML_C14N_1_0;
+        withComments = 0;
+        nsList = NULL;
     } else if(id == xmlSecTransformInclC14NWithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 1, buf);
+        mode = XML_C14N_1_0;
+        withComments = 1;
+        nsList = NULL;
     } else if(id == xmlSecTransformInclC14N11Id) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 0, buf);
+        mode = XML_C14N_1_1;
+        withComments = 0;
+        nsList = NULL;
     } else if(id == xmlSecTransformInclC14N11WithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 1, buf);
+        mode = XML_C14N_1_1;
+        withComments = 1;
+        nsList = NULL;
     } else if(id == xmlSecTransformExclC14NId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, nsList, 0, buf);
+        mode = XML_C14N_EXCLUSIVE_1_0;
+        withComments = 0;
     } else if(id == xmlSecTransformExclC14NWithCommentsId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, nsList, 1, buf);
+        mode = XML_C14N_EXCLUSIVE_1_0;
+        withComments = 1;
+    } else if(id == xmlSecTransformC14N2Id) {
+        /* without prefixes rewriting and QName aware nodes the C14N 2.0
+         * namespaces rendering is the same as in the exclusive c14n */
+        ret = xmlSecC14NNativeExecute(nodes, XML_C14N_EXCLUSIVE_1_0, NULL,
+                    ctx->withComments, ctx->trimTextNodes, parallel, buf);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeExecute", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+        return(0);
     } else if(id == xmlSecTransformRemoveXmlTagsC14NId) {
         ret = xmlSecNodeSetDumpTextNodes(nodes, buf);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetDumpTextNodes", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+        return(0);
     } else {
         /* shoudn't be possible to come here, actually */
         xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_TRANSFORM,
@@ -391,6 +892,25 @@ xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlChar
         return(-1);
     }
 
+    /* use the native c14n if possible */
+    if(xmlSecC14NNativeIsSupported(nodes, mode) != 0) {
+        ret = xmlSecC14NNativeExecute(nodes, mode, nsList, withComments, 0, parallel, buf);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeExecute", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+        return(0);
+    }
+
+    /* execute c14n transform, the whole document needs no visibility callback */
+    if(xmlSecC14NNativeIsWholeDocument(nodes, &treeWithComments) != 0) {
+        ret = xmlC14NExecute(nodes->doc, NULL, NULL, mode, nsList,
+                    ((withComments != 0) && (treeWithComments != 0)) ? 1 : 0, buf);
+    } else {
+        ret = xmlC14NExecute(nodes->doc,
+                    (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
+                    nodes, mode, nsList, withComments, buf);
+    }
     if(ret < 0) {
         xmlSecXmlError("xmlC14NExecute", xmlSecTransformKlassGetName(id));
         return(-1);
@@ -421,14 +941,14 @@ static xmlSecTransformKlass xmlSecTransformInclC14NKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -469,14 +989,14 @@ static xmlSecTransformKlass xmlSecTransformInclC14NWithCommentsKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -516,14 +1036,14 @@ static xmlSecTransformKlass xmlSecTransformInclC14N11Klass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -562,14 +1082,14 @@ static xmlSecTransformKlass xmlSecTransformInclC14N11WithCommentsKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -608,14 +1128,14 @@ static xmlSecTransformKlass xmlSecTransformExclC14NKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -654,14 +1174,14 @@ static xmlSecTransformKlass xmlSecTransformExclC14NWithCommentsKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformC14NGetDataType,             /* xmlSecTransformGetDataTypeMethod getDataType; */
     NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
     xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecTransformC14NPopXml,                  /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -678,6 +1198,56 @@ xmlSecTransformExclC14NWithCommentsGetKlass(void) {
     return(&xmlSecTransformExclC14NWithCommentsKlass);
 }
 
+/***************************************************************************
+ *
+ * C14N 2.0
+ *
+ ***************************************************************************/
+static xmlSecTransformKlass xmlSecTransformC14N2Klass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecTransformC14NSize,                    /* xmlSecSize objSize */
+
+    xmlSecNameC14N2,                            /* const xmlChar* name; */
+    xmlSecHrefC14N2,                            /* const xmlChar* href; */
+    xmlSecTransformUsageC14NMethod | xmlSecTransformUsageDSigTransform,
+                                                /* xmlSecAlgorithmUsage usage; */
+
+    xmlSecTransformC14NInitialize,              /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecTransformC14NFinalize,                /* xmlSecTransformFinalizeMethod finalize; */
+    xmlSecTransformC14N2NodeRead,               /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
+    NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformC14NPopBin,                  /* xmlSecTransformPopBinMethod popBin; */
+    xmlSecTransformC14NPushXml,                 /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    NULL,                                       /* xmlSecTransformExecuteMethod execute; */
+
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecTransformC14N2GetKlass:
+ *
+ * Canonical XML 2.0 transform klass (http://www.w3.org/TR/xml-c14n2/).
+ * The IgnoreComments and TrimTextNodes parameters are supported, the
+ * PrefixRewrite parameter must be "none" and the QNameAware parameter
+ * must be empty. The output does not depend on the XPath nodes set
+ * features that C14N 2.0 drops, so it can be produced by a single pass
+ * over the document (see #xmlSecDSigCtxVerifyFile).
+ *
+ * Returns: C14N 2.0 transform id.
+ */
+xmlSecTransformId
+xmlSecTransformC14N2GetKlass(void) {
+    return(&xmlSecTransformC14N2Klass);
+}
+
 /***************************************************************************
  *
  * Remove XML tags C14N
@@ -707,7 +1277,7 @@ static xmlSecTransformKlass xmlSecTransformRemoveXmlTagsC14NKlass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     NULL,                                       /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformC14NReset,                   /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -0,0 +1,2248 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Native canonicalization of XML nodes sets.
+ *
+ * libxml2 xmlC14NExecute() asks the visibility callback about every node,
+ * attribute and namespace in the document, calls xmlSearchNs() for every
+ * namespace declaration on the ancestors axis of every element, parses
+ * all the namespace URIs again for every element and writes the output
+ * into the output buffer in small pieces. The code below implements the
+ * same algorithms (and produces byte for byte the same output as libxml2)
+ * but checks the nodes set membership directly, keeps the in-scope
+ * namespaces on a stack while walking the tree, remembers the namespace
+ * URIs already checked and collects the output in big chunks with the
+ * escaping done from the precomputed tables.
+ *
+ * The inclusive c14n 1.1 xml:base fixup is not implemented: the documents
+ * with xml:base attributes (or a DTD that might default them) are left to
+ * libxml2, see xmlSecC14NNativeIsSupported().
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/parserInternals.h>
+#include <libxml/c14n.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/uri.h>
+#include <libxml/xpathInternals.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/nodeset.h>
+#include <xmlsec/executor.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/private/c14nnative.h>
+
+/* the output is passed to the output buffer in chunks of this size */
+#define XMLSEC_C14N_NATIVE_CHUNK_SIZE                   65536
+
+/* the initial size of the stacks */
+#define XMLSEC_C14N_NATIVE_STACK_SIZE                   16
+
+/* the parallel c14n: the minimal number of nodes per range and the maximal number of ranges */
+#define XMLSEC_C14N_NATIVE_PARALLEL_MIN_NODES           4096
+#define XMLSEC_C14N_NATIVE_PARALLEL_MAX_RANGES          16
+
+/* the position relative to the document element (same as in libxml2) */
+#define XMLSEC_C14N_NATIVE_BEFORE_DOCUMENT_ELEMENT      0
+#define XMLSEC_C14N_NATIVE_INSIDE_DOCUMENT_ELEMENT      1
+#define XMLSEC_C14N_NATIVE_AFTER_DOCUMENT_ELEMENT       2
+
+/**************************************************************************
+ *
+ * Escaping (c14n spec, section 2.3): only the characters below 0x40 are
+ * ever replaced, the table maps them to the index in the replacements
+ * list (0 means "as is").
+ *
+ * Most of the text is copied as is: the string is scanned one machine
+ * word at a time (the words are compared with each special character
+ * repeated in every byte) and only the word with a special character is
+ * checked byte by byte.
+ *
+ *************************************************************************/
+#define XMLSEC_C14N_NATIVE_ESCAPE_TABLE_SIZE            64
+#define XMLSEC_C14N_NATIVE_ESCAPE_MAX_CHARS             6
+
+typedef unsigned long                                   xmlSecC14NNativeWord;
+
+#define XMLSEC_C14N_NATIVE_WORD_ONES \
+    (((xmlSecC14NNativeWord)-1) / 0xFF)
+#define XMLSEC_C14N_NATIVE_WORD_HIGHS \
+    (XMLSEC_C14N_NATIVE_WORD_ONES * 0x80)
+#define XMLSEC_C14N_NATIVE_WORD_CHAR(ch) \
+    (XMLSEC_C14N_NATIVE_WORD_ONES * (xmlSecC14NNativeWord)(ch))
+/* not zero if (and only if) one of the bytes in the word is zero */
+#define XMLSEC_C14N_NATIVE_WORD_HAS_ZERO(word) \
+    (((word) - XMLSEC_C14N_NATIVE_WORD_ONES) & ~(word) & XMLSEC_C14N_NATIVE_WORD_HIGHS)
+
+typedef struct _xmlSecC14NNativeEscaping {
+    xmlSecByte                  table[XMLSEC_C14N_NATIVE_ESCAPE_TABLE_SIZE];
+    xmlSecC14NNativeWord        words[XMLSEC_C14N_NATIVE_ESCAPE_MAX_CHARS];
+    xmlSecSize                  wordsSize;
+} xmlSecC14NNativeEscaping;
+
+static const char* const xmlSecC14NNativeEscapes[] = {
+    NULL, "&amp;", "&lt;", "&gt;", "&quot;", "&#x9;", "&#xA;", "&#xD;"
+};
+
+/* text nodes: '&', '<', '>' and '\r' */
+static const xmlSecC14NNativeEscaping xmlSecC14NNativeTextEscaping = {
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 3, 0
+    },
+    {
+        XMLSEC_C14N_NATIVE_WORD_CHAR('&'), XMLSEC_C14N_NATIVE_WORD_CHAR('<'),
+        XMLSEC_C14N_NATIVE_WORD_CHAR('>'), XMLSEC_C14N_NATIVE_WORD_CHAR('\r')
+    },
+    4
+};
+
+/* attribute values: '&', '<', '"', '\t', '\n' and '\r' */
+static const xmlSecC14NNativeEscaping xmlSecC14NNativeAttrEscaping = {
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 5, 6, 0, 0, 7, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 4, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0
+    },
+    {
+        XMLSEC_C14N_NATIVE_WORD_CHAR('&'), XMLSEC_C14N_NATIVE_WORD_CHAR('<'),
+        XMLSEC_C14N_NATIVE_WORD_CHAR('"'), XMLSEC_C14N_NATIVE_WORD_CHAR('\t'),
+        XMLSEC_C14N_NATIVE_WORD_CHAR('\n'), XMLSEC_C14N_NATIVE_WORD_CHAR('\r')
+    },
+    6
+};
+
+/* comments and PIs: '\r' */
+static const xmlSecC14NNativeEscaping xmlSecC14NNativeMiscEscaping = {
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    },
+    {
+        XMLSEC_C14N_NATIVE_WORD_CHAR('\r')
+    },
+    1
+};
+
+/**************************************************************************
+ *
+ * Enveloped signature visibility: the nodes set produced by the enveloped
+ * transform is the input subtrees set intersected with the inverted
+ * <dsig:Signature/> subtree set. Instead of running every node through
+ * the generic nodes sets code (which walks the ancestors of each node
+ * for both sets), we check the visibility directly and remember the
+ * result for the last parent: c14n visits the siblings, attributes and
+ * namespaces of an element in a row.
+ *
+ *************************************************************************/
+typedef struct _xmlSecC14NNativeEnveloped {
+    xmlNodeSetPtr       roots;          /* NULL means the whole document */
+    xmlNodePtr          excluded;       /* the <dsig:Signature/> node */
+    int                 withoutComments;
+
+    xmlNodePtr          lastParent;
+    int                 lastParentExcluded;
+    int                 lastParentInRoots;
+} xmlSecC14NNativeEnveloped, *xmlSecC14NNativeEnvelopedPtr;
+
+/**************************************************************************
+ *
+ * Canonicalization context
+ *
+ *************************************************************************/
+typedef enum {
+    xmlSecC14NNativeVisibilityNodeSet = 0,
+    xmlSecC14NNativeVisibilityEnveloped,
+    xmlSecC14NNativeVisibilitySubtree,
+    xmlSecC14NNativeVisibilityDocument
+} xmlSecC14NNativeVisibility;
+
+typedef struct _xmlSecC14NNativeInScopeNs {
+    xmlNsPtr                    ns;
+    int                         shadow;         /* not declared, only hides the outer declarations */
+} xmlSecC14NNativeInScopeNs;
+
+typedef struct _xmlSecC14NNativeRenderedNs {
+    xmlNsPtr                    ns;
+    xmlNodePtr                  node;
+} xmlSecC14NNativeRenderedNs;
+
+typedef struct _xmlSecC14NNativeFrame {
+    xmlNodePtr                  node;
+    int                         visible;
+    int                         parentIsDoc;
+
+    /* the stacks positions to restore at the element end */
+    xmlSecSize                  inScopeSize;
+    xmlSecSize                  renderedEnd;
+    xmlSecSize                  renderedPrevStart;
+    xmlSecSize                  renderedPrevEnd;
+} xmlSecC14NNativeFrame;
+
+typedef struct _xmlSecC14NNativeCtx {
+    int                         mode;
+    int                         withComments;
+    int                         trimTextNodes;
+    xmlChar**                   inclusiveNsList;
+    xmlDocPtr                   doc;
+    xmlOutputBufferPtr          buf;
+
+    /* the nodes set */
+    xmlSecC14NNativeVisibility  visibility;
+    xmlSecNodeSetPtr            nodes;
+    xmlSecC14NNativeEnveloped   enveloped;
+    int                         treeWithComments;
+
+    /* the output chunk and the buffer it goes to instead of @buf (if any) */
+    xmlSecByte*                 out;
+    xmlSecSize                  outSize;
+    xmlSecBufferPtr             outBuffer;
+
+    /* the position relative to the document element */
+    int                         pos;
+    int                         parentIsDoc;
+
+    /* the walked elements: the current element and its ancestors */
+    xmlSecC14NNativeFrame*      frames;
+    xmlSecSize                  framesSize;
+    xmlSecSize                  framesMaxSize;
+
+    /* the namespaces declared on the walked elements */
+    xmlSecC14NNativeInScopeNs*  inScope;
+    xmlSecSize                  inScopeSize;
+    xmlSecSize                  inScopeMaxSize;
+
+    /* the rendered namespaces (libxml2 "visible namespaces stack") */
+    xmlSecC14NNativeRenderedNs* rendered;
+    xmlSecSize                  renderedEnd;
+    xmlSecSize                  renderedPrevStart;
+    xmlSecSize                  renderedPrevEnd;
+    xmlSecSize                  renderedMaxSize;
+
+    /* the sorted namespaces and attributes of the current element */
+    xmlNsPtr*                   ns;
+    xmlSecSize                  nsSize;
+    xmlSecSize                  nsMaxSize;
+    xmlAttrPtr*                 attrs;
+    xmlSecSize                  attrsSize;
+    xmlSecSize                  attrsMaxSize;
+
+    /* the namespace URIs already checked to be absolute */
+    xmlHashTablePtr             checkedHrefs;
+} xmlSecC14NNativeCtx, *xmlSecC14NNativeCtxPtr;
+
+static int      xmlSecC14NNativeEnvelopedInitialize     (xmlSecC14NNativeEnvelopedPtr enveloped,
+                                                         xmlSecNodeSetPtr nodes);
+static int      xmlSecC14NNativeEnvelopedIsVisible      (xmlSecC14NNativeEnvelopedPtr enveloped,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent);
+static xmlNodePtr xmlSecC14NNativeSubtreeGetRoot        (xmlSecNodeSetPtr nodes,
+                                                         int* withComments);
+
+static int      xmlSecC14NNativeCtxInitialize           (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlSecNodeSetPtr nodes,
+                                                         int mode,
+                                                         xmlChar** inclusiveNsList,
+                                                         int withComments,
+                                                         int trimTextNodes,
+                                                         xmlOutputBufferPtr buf);
+static void     xmlSecC14NNativeCtxFinalize             (xmlSecC14NNativeCtxPtr ctx);
+static int      xmlSecC14NNativeCtxFlush                (xmlSecC14NNativeCtxPtr ctx);
+static int      xmlSecC14NNativeCtxWriteData            (xmlSecC14NNativeCtxPtr ctx,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize size);
+static int      xmlSecC14NNativeCtxWrite                (xmlSecC14NNativeCtxPtr ctx,
+                                                         const xmlChar* str);
+static int      xmlSecC14NNativeCtxWriteEscapedData     (xmlSecC14NNativeCtxPtr ctx,
+                                                         const xmlChar* str,
+                                                         xmlSecSize size,
+                                                         const xmlSecC14NNativeEscaping* escaping);
+static int      xmlSecC14NNativeCtxWriteEscaped         (xmlSecC14NNativeCtxPtr ctx,
+                                                         const xmlChar* str,
+                                                         const xmlSecC14NNativeEscaping* escaping);
+static int      xmlSecC14NNativeCtxWriteText            (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NNativeCtxWriteQName           (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns,
+                                                         const xmlChar* name);
+static int      xmlSecC14NNativeCtxWriteNs              (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns);
+static int      xmlSecC14NNativeCtxWriteAttr            (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlAttrPtr attr);
+static int      xmlSecC14NNativeCtxIsVisible            (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent);
+static int      xmlSecC14NNativeCtxIsAncestorVisible    (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         xmlSecSize level);
+static int      xmlSecC14NNativeCtxPushInScopeNs        (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns,
+                                                         int shadow);
+static int      xmlSecC14NNativeCtxPushElementNs        (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NNativeCtxPushAncestorsNs      (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node);
+static xmlNsPtr xmlSecC14NNativeCtxSearchNs             (xmlSecC14NNativeCtxPtr ctx,
+                                                         const xmlChar* prefix);
+static int      xmlSecC14NNativeCtxAddRendered          (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NNativeCtxFindRendered         (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns);
+static int      xmlSecC14NNativeCtxExclFindRendered     (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns);
+static int      xmlSecC14NNativeCtxInsertNs             (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNsPtr ns);
+static int      xmlSecC14NNativeCtxInsertAttr           (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlAttrPtr attr);
+static int      xmlSecC14NNativeCtxCheckNs              (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NNativeCtxNsAxis               (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int visible);
+static int      xmlSecC14NNativeCtxExclNsAxis           (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int visible);
+static int      xmlSecC14NNativeCtxAttrsAxis            (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int visible);
+static int      xmlSecC14NNativeCtxStartElement         (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int visible);
+static int      xmlSecC14NNativeCtxEndElement           (xmlSecC14NNativeCtxPtr ctx);
+static int      xmlSecC14NNativeCtxProcessNode          (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NNativeCtxProcess              (xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr first,
+                                                         xmlNodePtr last);
+static int      xmlSecC14NNativeCtxProcessParallel      (xmlSecC14NNativeCtxPtr ctx);
+
+/**************************************************************************
+ *
+ * Parallel c14n: the children of the document element are split into
+ * ranges of siblings and every range is canonicalized by an executor task
+ * with its own context (started at the document element, same as the main
+ * context) into its own buffer. The buffers are written in the document
+ * order after all the tasks are done.
+ *
+ *************************************************************************/
+typedef struct _xmlSecC14NNativeRange {
+    xmlSecC14NNativeCtx         ctx;
+    xmlNodePtr                  first;
+    xmlNodePtr                  last;
+    xmlSecBuffer                out;
+    int                         result;
+} xmlSecC14NNativeRange;
+
+typedef struct _xmlSecC14NNativeJob {
+    xmlSecC14NNativeRange*      ranges;
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlMutexPtr                 mutex;
+} xmlSecC14NNativeJob, *xmlSecC14NNativeJobPtr;
+
+static xmlSecSize xmlSecC14NNativeCountNodes            (xmlNodePtr node);
+static int      xmlSecC14NNativeJobInitialize           (xmlSecC14NNativeJobPtr job,
+                                                         xmlSecC14NNativeCtxPtr ctx,
+                                                         xmlNodePtr root,
+                                                         xmlSecSize nodesNum,
+                                                         xmlSecSize rangesNum);
+static void     xmlSecC14NNativeJobFinalize             (xmlSecC14NNativeJobPtr job);
+static void     xmlSecC14NNativeJobTask                 (void* data);
+
+#define xmlSecC14NNativeIsXmlNs(ns) \
+    (((ns) != NULL) && \
+     xmlStrEqual((ns)->prefix, BAD_CAST "xml") && \
+     xmlStrEqual((ns)->href, XML_XML_NAMESPACE))
+#define xmlSecC14NNativeIsXmlAttr(attr) \
+    (((attr)->ns != NULL) && xmlSecC14NNativeIsXmlNs((attr)->ns))
+
+/**
+ * xmlSecC14NNativeIsSupported:
+ * @nodes:              the pointer to nodes set.
+ * @mode:               the c14n mode (#xmlC14NMode).
+ *
+ * Checks whether the native canonicalization can process the @nodes
+ * in the @mode: the inclusive c14n 1.1 is supported only for documents
+ * without xml:base attributes and DTD.
+ *
+ * Returns: 1 if the native canonicalization can be used or 0 otherwise.
+ */
+int
+xmlSecC14NNativeIsSupported(xmlSecNodeSetPtr nodes, int mode) {
+    xmlNodePtr cur;
+    xmlAttrPtr attr;
+
+    xmlSecAssert2(nodes != NULL, 0);
+    xmlSecAssert2(nodes->doc != NULL, 0);
+
+    switch(mode) {
+    case XML_C14N_1_0:
+    case XML_C14N_EXCLUSIVE_1_0:
+        return(1);
+    case XML_C14N_1_1:
+        break;
+    default:
+        return(0);
+    }
+
+    /* the DTD might add default xml:base attributes */
+    if((nodes->doc->intSubset != NULL) || (nodes->doc->extSubset != NULL)) {
+        return(0);
+    }
+    cur = nodes->doc->children;
+    while(cur != NULL) {
+        if(cur->type == XML_ELEMENT_NODE) {
+            for(attr = cur->properties; attr != NULL; attr = attr->next) {
+                if(xmlSecC14NNativeIsXmlAttr(attr) && xmlStrEqual(attr->name, BAD_CAST "base")) {
+                    return(0);
+                }
+            }
+            if(cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+        }
+        while((cur != NULL) && (cur->next == NULL) && (cur->parent != (xmlNodePtr)nodes->doc)) {
+            cur = cur->parent;
+        }
+        cur = (cur != NULL) ? cur->next : NULL;
+    }
+    return(1);
+}
+
+/**
+ * xmlSecC14NNativeExecute:
+ * @nodes:              the pointer to nodes set.
+ * @mode:               the c14n mode (#xmlC14NMode).
+ * @inclusiveNsList:    the inclusive namespaces prefixes list for the
+ *                      exclusive c14n (might be NULL).
+ * @withComments:       the flag to include comments.
+ * @trimTextNodes:      the flag to trim the whitespace in the text nodes
+ *                      (the canonical XML 2.0 TrimTextNodes parameter).
+ * @parallel:           the flag to split the document element children
+ *                      between the executor tasks (the whole document and
+ *                      the enveloped signature nodes sets only).
+ * @buf:                the output buffer.
+ *
+ * Writes the canonical form of the @nodes to @buf, same as
+ * xmlC14NExecute() with #xmlSecNodeSetContains as the visibility
+ * callback. The caller should check the mode with
+ * #xmlSecC14NNativeIsSupported first.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecC14NNativeExecute(xmlSecNodeSetPtr nodes, int mode, xmlChar** inclusiveNsList,
+                        int withComments, int trimTextNodes, int parallel, xmlOutputBufferPtr buf) {
+    xmlSecC14NNativeCtx ctx;
+    xmlNodePtr root = NULL;
+    int wholeDocument;
+    int treeWithComments = 1;
+    int ret;
+
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(nodes->doc != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+
+    if(buf->encoder != NULL) {
+        xmlSecInvalidDataError("c14n requires UTF8 output buffer", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecC14NNativeCtxInitialize(&ctx, nodes, mode, inclusiveNsList, withComments, trimTextNodes, buf);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxInitialize", NULL);
+        return(-1);
+    }
+
+    /* the whole document is checked first: the document with just the document
+     * element is a subtree too but only the whole document walk can be split
+     * between the executor tasks */
+    wholeDocument = xmlSecC14NNativeIsWholeDocument(nodes, &treeWithComments);
+    if(wholeDocument == 0) {
+        root = xmlSecC14NNativeSubtreeGetRoot(nodes, &treeWithComments);
+    }
+
+    if(wholeDocument != 0) {
+        /* everything is visible, no nodes set checks at all */
+        ctx.visibility = xmlSecC14NNativeVisibilityDocument;
+        ctx.treeWithComments = treeWithComments;
+
+        if(parallel != 0) {
+            ret = xmlSecC14NNativeCtxProcessParallel(&ctx);
+        } else {
+            ret = xmlSecC14NNativeCtxProcess(&ctx, nodes->doc->children, NULL);
+        }
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            goto done;
+        }
+    } else if(root != NULL) {
+        /* nothing outside of the subtree is visible: walk just the subtree
+         * with the namespaces declared on its ancestors in scope */
+        ctx.visibility = xmlSecC14NNativeVisibilitySubtree;
+        ctx.treeWithComments = treeWithComments;
+
+        ret = xmlSecC14NNativeCtxPushAncestorsNs(&ctx, root);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxPushAncestorsNs", NULL);
+            goto done;
+        }
+
+        ret = xmlSecC14NNativeCtxProcess(&ctx, root, root);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            goto done;
+        }
+    } else {
+        if(xmlSecC14NNativeEnvelopedInitialize(&(ctx.enveloped), nodes) != 0) {
+            ctx.visibility = xmlSecC14NNativeVisibilityEnveloped;
+        }
+
+        if((parallel != 0) && (ctx.visibility == xmlSecC14NNativeVisibilityEnveloped)) {
+            ret = xmlSecC14NNativeCtxProcessParallel(&ctx);
+        } else {
+            ret = xmlSecC14NNativeCtxProcess(&ctx, nodes->doc->children, NULL);
+        }
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            goto done;
+        }
+    }
+
+    ret = xmlSecC14NNativeCtxFlush(&ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxFlush", NULL);
+        goto done;
+    }
+    ret = xmlOutputBufferFlush(buf);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferFlush", NULL);
+        goto done;
+    }
+
+    /* success */
+    ret = 0;
+
+done:
+    xmlSecC14NNativeCtxFinalize(&ctx);
+    return((ret < 0) ? -1 : 0);
+}
+
+static int
+xmlSecC14NNativeEnvelopedInitialize(xmlSecC14NNativeEnvelopedPtr enveloped, xmlSecNodeSetPtr nodes) {
+    xmlSecNodeSetPtr input = NULL;
+    xmlSecNodeSetPtr envelope;
+    int ii;
+
+    xmlSecAssert2(enveloped != NULL, 0);
+    xmlSecAssert2(nodes != NULL, 0);
+
+    memset(enveloped, 0, sizeof(xmlSecC14NNativeEnveloped));
+
+    /* either just the envelope set or the input set followed by it */
+    if(nodes->next == nodes) {
+        envelope = nodes;
+    } else if(nodes->next->next == nodes) {
+        input = nodes;
+        envelope = nodes->next;
+    } else {
+        return(0);
+    }
+
+    if((envelope->type != xmlSecNodeSetTreeInvert) || (envelope->op != xmlSecNodeSetIntersection) ||
+       (envelope->nodes == NULL) || (envelope->nodes->nodeNr != 1) ||
+       (envelope->nodes->nodeTab[0] == NULL) ||
+       (envelope->nodes->nodeTab[0]->type != XML_ELEMENT_NODE)) {
+        return(0);
+    }
+    enveloped->excluded = envelope->nodes->nodeTab[0];
+
+    if(input != NULL) {
+        if(input->op != xmlSecNodeSetIntersection) {
+            return(0);
+        }
+        if(input->type == xmlSecNodeSetTreeWithoutComments) {
+            enveloped->withoutComments = 1;
+        } else if(input->type != xmlSecNodeSetTree) {
+            return(0);
+        }
+        if(input->nodes != NULL) {
+            /* the attributes and namespaces need the special handling */
+            for(ii = 0; ii < input->nodes->nodeNr; ++ii) {
+                if((input->nodes->nodeTab[ii] == NULL) ||
+                   (input->nodes->nodeTab[ii]->type == XML_ATTRIBUTE_NODE) ||
+                   (input->nodes->nodeTab[ii]->type == XML_NAMESPACE_DECL)) {
+                    return(0);
+                }
+            }
+        }
+        enveloped->roots = input->nodes;
+    }
+    return(1);
+}
+
+static int
+xmlSecC14NNativeEnvelopedIsVisible(xmlSecC14NNativeEnvelopedPtr enveloped, xmlNodePtr node, xmlNodePtr parent) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(enveloped != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    if((enveloped->withoutComments != 0) && (node->type == XML_COMMENT_NODE)) {
+        return(0);
+    }
+
+    /* this is a libxml hack! check xpath.c for details */
+    if((node->type == XML_NAMESPACE_DECL) && (parent != NULL) && (parent->type == XML_ATTRIBUTE_NODE)) {
+        parent = parent->parent;
+    }
+
+    /* check the parent and its ancestors (if not done already) */
+    if((parent != enveloped->lastParent) || (parent == NULL)) {
+        enveloped->lastParent = parent;
+        enveloped->lastParentExcluded = 0;
+        enveloped->lastParentInRoots = (enveloped->roots == NULL) ? 1 : 0;
+        /* the nodes sets only look at the element ancestors */
+        for(cur = parent; (cur != NULL) && (cur->type == XML_ELEMENT_NODE); cur = cur->parent) {
+            if(cur == enveloped->excluded) {
+                enveloped->lastParentExcluded = 1;
+                break;
+            }
+            if((enveloped->lastParentInRoots == 0) && (xmlXPathNodeSetContains(enveloped->roots, cur) != 0)) {
+                enveloped->lastParentInRoots = 1;
+            }
+        }
+    }
+    if(enveloped->lastParentExcluded != 0) {
+        return(0);
+    }
+
+    /* attributes and namespaces go with their element */
+    if((node->type == XML_ATTRIBUTE_NODE) || (node->type == XML_NAMESPACE_DECL)) {
+        return(enveloped->lastParentInRoots);
+    }
+    if(node == enveloped->excluded) {
+        return(0);
+    }
+    if(enveloped->lastParentInRoots != 0) {
+        return(1);
+    }
+    return(xmlXPathNodeSetContains(enveloped->roots, node) != 0 ? 1 : 0);
+}
+
+/*
+ * Subtree visibility: the nodes set is a single element subtree (the
+ * <dsig:SignedInfo/> element or a same document reference to an element).
+ * Nothing outside of the subtree is visible and there is no need to walk
+ * the whole document.
+ */
+static xmlNodePtr
+xmlSecC14NNativeSubtreeGetRoot(xmlSecNodeSetPtr nodes, int* withComments) {
+    xmlNodePtr root;
+
+    xmlSecAssert2(nodes != NULL, NULL);
+    xmlSecAssert2(withComments != NULL, NULL);
+
+    if((nodes->next != nodes) || (nodes->children != NULL) ||
+       (nodes->nodes == NULL) || (nodes->nodes->nodeNr != 1)) {
+        return(NULL);
+    }
+    if(nodes->type == xmlSecNodeSetTreeWithoutComments) {
+        (*withComments) = 0;
+    } else if(nodes->type != xmlSecNodeSetTree) {
+        return(NULL);
+    }
+
+    root = nodes->nodes->nodeTab[0];
+    if((root == NULL) || (root->type != XML_ELEMENT_NODE) || (root->doc != nodes->doc)) {
+        return(NULL);
+    }
+    return(root);
+}
+
+/**
+ * xmlSecC14NNativeIsWholeDocument:
+ * @nodes:              the pointer to nodes set.
+ * @withComments:       the result flag: 1 if the comments are in the set
+ *                      or 0 otherwise.
+ *
+ * Checks if @nodes is the whole document (e.g. the same document reference
+ * URI="" without the enveloped signature transform): every node but,
+ * depending on the set type, the comments is visible.
+ *
+ * Returns: 1 if @nodes is the whole document or 0 otherwise.
+ */
+int
+xmlSecC14NNativeIsWholeDocument(xmlSecNodeSetPtr nodes, int* withComments) {
+    xmlNodePtr cur;
+    int ii = 0;
+
+    xmlSecAssert2(nodes != NULL, 0);
+    xmlSecAssert2(nodes->doc != NULL, 0);
+    xmlSecAssert2(withComments != NULL, 0);
+
+    if((nodes->next != nodes) || (nodes->children != NULL) || (nodes->op != xmlSecNodeSetIntersection)) {
+        return(0);
+    }
+    if(nodes->type == xmlSecNodeSetTreeWithoutComments) {
+        (*withComments) = 0;
+    } else if(nodes->type == xmlSecNodeSetTree) {
+        (*withComments) = 1;
+    } else {
+        return(0);
+    }
+    if(nodes->nodes == NULL) {
+        return(1);
+    }
+
+    /* the trees rooted at all the document children (but the comments
+     * for the set without comments) in the document order */
+    for(cur = nodes->doc->children; cur != NULL; cur = cur->next) {
+        if((cur->type == XML_COMMENT_NODE) && ((*withComments) == 0)) {
+            continue;
+        }
+        if((ii >= nodes->nodes->nodeNr) || (nodes->nodes->nodeTab[ii] != cur)) {
+            return(0);
+        }
+        ++ii;
+    }
+    return((ii == nodes->nodes->nodeNr) ? 1 : 0);
+}
+
+/**
+ * xmlSecC14NNativeTrimText:
+ * @parent:             the parent element of the text node.
+ * @str:                the text node content.
+ * @size:               the pointer to the @str size, updated with the
+ *                      trimmed text size on return.
+ *
+ * Removes the leading and trailing whitespace from the text node content
+ * as the canonical XML 2.0 TrimTextNodes parameter requires unless the
+ * xml:space="preserve" attribute is in scope for @parent.
+ *
+ * Returns: the pointer to the first character of the trimmed text.
+ */
+const xmlChar*
+xmlSecC14NNativeTrimText(xmlNodePtr parent, const xmlChar* str, xmlSecSize* size) {
+    xmlSecAssert2(str != NULL, NULL);
+    xmlSecAssert2(size != NULL, NULL);
+
+    if((parent != NULL) && (xmlNodeGetSpacePreserve(parent) == 1)) {
+        return(str);
+    }
+    while(((*size) > 0) && IS_BLANK_CH(str[0])) {
+        ++str;
+        --(*size);
+    }
+    while(((*size) > 0) && IS_BLANK_CH(str[(*size) - 1])) {
+        --(*size);
+    }
+    return(str);
+}
+
+static int
+xmlSecC14NNativeCtxInitialize(xmlSecC14NNativeCtxPtr ctx, xmlSecNodeSetPtr nodes, int mode,
+                              xmlChar** inclusiveNsList, int withComments, int trimTextNodes,
+                              xmlOutputBufferPtr buf) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecC14NNativeCtx));
+    ctx->out = (xmlSecByte*)xmlMalloc(XMLSEC_C14N_NATIVE_CHUNK_SIZE);
+    if(ctx->out == NULL) {
+        xmlSecMallocError(XMLSEC_C14N_NATIVE_CHUNK_SIZE, NULL);
+        return(-1);
+    }
+
+    ctx->mode = mode;
+    ctx->withComments = withComments;
+    ctx->trimTextNodes = trimTextNodes;
+    ctx->inclusiveNsList = (mode == XML_C14N_EXCLUSIVE_1_0) ? inclusiveNsList : NULL;
+    ctx->doc = nodes->doc;
+    ctx->buf = buf;
+    ctx->visibility = xmlSecC14NNativeVisibilityNodeSet;
+    ctx->nodes = nodes;
+    ctx->pos = XMLSEC_C14N_NATIVE_BEFORE_DOCUMENT_ELEMENT;
+    ctx->parentIsDoc = 1;
+    return(0);
+}
+
+static void
+xmlSecC14NNativeCtxFinalize(xmlSecC14NNativeCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->out != NULL) {
+        xmlFree(ctx->out);
+    }
+    if(ctx->frames != NULL) {
+        xmlFree(ctx->frames);
+    }
+    if(ctx->inScope != NULL) {
+        xmlFree(ctx->inScope);
+    }
+    if(ctx->rendered != NULL) {
+        xmlFree(ctx->rendered);
+    }
+    if(ctx->ns != NULL) {
+        xmlFree(ctx->ns);
+    }
+    if(ctx->attrs != NULL) {
+        xmlFree(ctx->attrs);
+    }
+    if(ctx->checkedHrefs != NULL) {
+        xmlHashFree(ctx->checkedHrefs, NULL);
+    }
+    memset(ctx, 0, sizeof(xmlSecC14NNativeCtx));
+}
+
+static int
+xmlSecC14NNativeCtxFlush(xmlSecC14NNativeCtxPtr ctx) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->buf != NULL, -1);
+
+    if(ctx->outSize == 0) {
+        return(0);
+    }
+    if(ctx->outBuffer != NULL) {
+        ret = xmlSecBufferAppend(ctx->outBuffer, ctx->out, ctx->outSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferAppend", NULL, "size=%d", (int)ctx->outSize);
+            return(-1);
+        }
+    } else {
+        ret = xmlOutputBufferWrite(ctx->buf, (int)ctx->outSize, (const char*)ctx->out);
+        if(ret < 0) {
+            xmlSecXmlError2("xmlOutputBufferWrite", NULL, "size=%d", (int)ctx->outSize);
+            return(-1);
+        }
+    }
+    ctx->outSize = 0;
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxWriteData(xmlSecC14NNativeCtxPtr ctx, const xmlSecByte* data, xmlSecSize size) {
+    xmlSecSize chunk;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->out != NULL, -1);
+
+    while(size > 0) {
+        if(ctx->outSize >= XMLSEC_C14N_NATIVE_CHUNK_SIZE) {
+            ret = xmlSecC14NNativeCtxFlush(ctx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxFlush", NULL);
+                return(-1);
+            }
+        }
+        chunk = XMLSEC_C14N_NATIVE_CHUNK_SIZE - ctx->outSize;
+        if(chunk > size) {
+            chunk = size;
+        }
+        memcpy(ctx->out + ctx->outSize, data, chunk);
+        ctx->outSize += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxWrite(xmlSecC14NNativeCtxPtr ctx, const xmlChar* str) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(str == NULL) {
+        return(0);
+    }
+    return(xmlSecC14NNativeCtxWriteData(ctx, str, XMLSEC_SIZE_BAD_CAST(xmlStrlen(str))));
+}
+
+/* returns the position of the first character to escape or @size if there is none */
+static xmlSecSize
+xmlSecC14NNativeFindEscape(const xmlChar* str, xmlSecSize size, const xmlSecC14NNativeEscaping* escaping) {
+    xmlSecC14NNativeWord word;
+    xmlSecC14NNativeWord found;
+    xmlSecSize pos = 0;
+    xmlSecSize ii;
+
+    xmlSecAssert2(str != NULL, size);
+    xmlSecAssert2(escaping != NULL, size);
+
+    while(pos + sizeof(xmlSecC14NNativeWord) <= size) {
+        memcpy(&word, str + pos, sizeof(xmlSecC14NNativeWord));
+        for(found = 0, ii = 0; ii < escaping->wordsSize; ++ii) {
+            found |= XMLSEC_C14N_NATIVE_WORD_HAS_ZERO(word ^ escaping->words[ii]);
+        }
+        if(found != 0) {
+            break;
+        }
+        pos += sizeof(xmlSecC14NNativeWord);
+    }
+    for(; pos < size; ++pos) {
+        if((str[pos] < XMLSEC_C14N_NATIVE_ESCAPE_TABLE_SIZE) && (escaping->table[str[pos]] != 0)) {
+            break;
+        }
+    }
+    return(pos);
+}
+
+static int
+xmlSecC14NNativeCtxWriteEscapedData(xmlSecC14NNativeCtxPtr ctx, const xmlChar* str, xmlSecSize size,
+                                    const xmlSecC14NNativeEscaping* escaping) {
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(escaping != NULL, -1);
+
+    while(size > 0) {
+        pos = xmlSecC14NNativeFindEscape(str, size, escaping);
+        ret = xmlSecC14NNativeCtxWriteData(ctx, str, pos);
+        if(ret < 0) {
+            return(-1);
+        }
+        if(pos >= size) {
+            break;
+        }
+        ret = xmlSecC14NNativeCtxWrite(ctx, BAD_CAST xmlSecC14NNativeEscapes[escaping->table[str[pos]]]);
+        if(ret < 0) {
+            return(-1);
+        }
+        str += pos + 1;
+        size -= pos + 1;
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxWriteEscaped(xmlSecC14NNativeCtxPtr ctx, const xmlChar* str,
+                                const xmlSecC14NNativeEscaping* escaping) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(escaping != NULL, -1);
+
+    if(str == NULL) {
+        return(0);
+    }
+    return(xmlSecC14NNativeCtxWriteEscapedData(ctx, str, XMLSEC_SIZE_BAD_CAST(xmlStrlen(str)), escaping));
+}
+
+static int
+xmlSecC14NNativeCtxWriteText(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node) {
+    const xmlChar* str;
+    xmlSecSize size;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(node->content == NULL) {
+        return(0);
+    }
+    size = XMLSEC_SIZE_BAD_CAST(xmlStrlen(node->content));
+    if(ctx->trimTextNodes != 0) {
+        str = xmlSecC14NNativeTrimText(node->parent, node->content, &size);
+    } else {
+        str = node->content;
+    }
+    return(xmlSecC14NNativeCtxWriteEscapedData(ctx, str, size, &xmlSecC14NNativeTextEscaping));
+}
+
+static int
+xmlSecC14NNativeCtxWriteQName(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns, const xmlChar* name) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if((ns != NULL) && (xmlStrlen(ns->prefix) > 0)) {
+        if((xmlSecC14NNativeCtxWrite(ctx, ns->prefix) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST ":") < 0)) {
+            return(-1);
+        }
+    }
+    return(xmlSecC14NNativeCtxWrite(ctx, name));
+}
+
+/* same as libxml2: the namespace href is quoted but not escaped */
+static int
+xmlSecC14NNativeCtxWriteNs(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns) {
+    const xmlChar* start;
+    const xmlChar* cur;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ns != NULL, -1);
+
+    if(ns->prefix != NULL) {
+        if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST " xmlns:") < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, ns->prefix) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "=") < 0)) {
+            return(-1);
+        }
+    } else {
+        if(xmlSecC14NNativeCtxWrite(ctx, BAD_CAST " xmlns=") < 0) {
+            return(-1);
+        }
+    }
+
+    if(ns->href == NULL) {
+        return(xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\"\""));
+    }
+    if(xmlStrchr(ns->href, '"') == NULL) {
+        if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\"") < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, ns->href) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\"") < 0)) {
+            return(-1);
+        }
+        return(0);
+    }
+    if(xmlStrchr(ns->href, '\'') == NULL) {
+        if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "'") < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, ns->href) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "'") < 0)) {
+            return(-1);
+        }
+        return(0);
+    }
+
+    /* both quotes: use '"' and replace it with &quot; */
+    if(xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\"") < 0) {
+        return(-1);
+    }
+    for(start = cur = ns->href; (*cur) != '\0'; ++cur) {
+        if((*cur) != '"') {
+            continue;
+        }
+        if((xmlSecC14NNativeCtxWriteData(ctx, start, XMLSEC_SIZE_BAD_CAST(cur - start)) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "&quot;") < 0)) {
+            return(-1);
+        }
+        start = cur + 1;
+    }
+    if((xmlSecC14NNativeCtxWriteData(ctx, start, XMLSEC_SIZE_BAD_CAST(cur - start)) < 0) ||
+       (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\"") < 0)) {
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxWriteAttr(xmlSecC14NNativeCtxPtr ctx, xmlAttrPtr attr) {
+    xmlChar* value;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(attr != NULL, -1);
+
+    if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST " ") < 0) ||
+       (xmlSecC14NNativeCtxWriteQName(ctx, attr->ns, attr->name) < 0) ||
+       (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "=\"") < 0)) {
+        return(-1);
+    }
+
+    /* the attribute value is almost always just one text node */
+    if((attr->children != NULL) && (attr->children->type == XML_TEXT_NODE) && (attr->children->next == NULL)) {
+        ret = xmlSecC14NNativeCtxWriteEscaped(ctx, attr->children->content, &xmlSecC14NNativeAttrEscaping);
+    } else {
+        value = xmlNodeListGetString(ctx->doc, attr->children, 1);
+        ret = xmlSecC14NNativeCtxWriteEscaped(ctx, value, &xmlSecC14NNativeAttrEscaping);
+        if(value != NULL) {
+            xmlFree(value);
+        }
+    }
+    if(ret < 0) {
+        return(-1);
+    }
+    return(xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "\""));
+}
+
+/* the visibility of the walked nodes and their attributes and namespaces */
+static int
+xmlSecC14NNativeCtxIsVisible(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    switch(ctx->visibility) {
+    case xmlSecC14NNativeVisibilitySubtree:
+    case xmlSecC14NNativeVisibilityDocument:
+        return(((node->type != XML_COMMENT_NODE) || (ctx->treeWithComments != 0)) ? 1 : 0);
+    case xmlSecC14NNativeVisibilityEnveloped:
+        return(xmlSecC14NNativeEnvelopedIsVisible(&(ctx->enveloped), node, parent));
+    default:
+        /* same as libxml2: anything but 0 is visible */
+        return((xmlSecNodeSetContains(ctx->nodes, node, parent) != 0) ? 1 : 0);
+    }
+}
+
+/*
+ * The visibility of the @node ancestor of the current element: the walked
+ * ancestors remember their visibility, the @level is the number of the
+ * walked elements from the walk root to the @node (0 if the @node is above
+ * the walk root).
+ */
+static int
+xmlSecC14NNativeCtxIsAncestorVisible(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, xmlSecSize level) {
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    if(level > 0) {
+        xmlSecAssert2(level <= ctx->framesSize, 0);
+        xmlSecAssert2(ctx->frames[level - 1].node == node, 0);
+        return(ctx->frames[level - 1].visible);
+    }
+    if(ctx->visibility == xmlSecC14NNativeVisibilitySubtree) {
+        return(0);
+    }
+    return(xmlSecC14NNativeCtxIsVisible(ctx, node, node->parent));
+}
+
+static int
+xmlSecC14NNativeCtxPushInScopeNs(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns, int shadow) {
+    xmlSecC14NNativeInScopeNs* newItems;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ns != NULL, -1);
+
+    if(ctx->inScopeSize >= ctx->inScopeMaxSize) {
+        newSize = (ctx->inScopeMaxSize > 0) ? (2 * ctx->inScopeMaxSize) : XMLSEC_C14N_NATIVE_STACK_SIZE;
+        newItems = (xmlSecC14NNativeInScopeNs*)xmlRealloc(ctx->inScope, newSize * sizeof(xmlSecC14NNativeInScopeNs));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecC14NNativeInScopeNs), NULL);
+            return(-1);
+        }
+        ctx->inScope = newItems;
+        ctx->inScopeMaxSize = newSize;
+    }
+    ctx->inScope[ctx->inScopeSize].ns = ns;
+    ctx->inScope[ctx->inScopeSize].shadow = shadow;
+    ++ctx->inScopeSize;
+    return(0);
+}
+
+/*
+ * Pushes the namespaces declared on the @node. Same as xmlSearchNs(), the
+ * element namespace hides the outer declarations even if it is not declared
+ * anywhere (this only happens for broken trees created by the applications).
+ */
+static int
+xmlSecC14NNativeCtxPushElementNs(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node) {
+    xmlNsPtr ns;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if((node->ns != NULL) && (node->ns->href != NULL)) {
+        for(ns = node->nsDef; (ns != NULL) && (ns != node->ns); ns = ns->next);
+        if((ns == NULL) && (xmlSecC14NNativeCtxSearchNs(ctx, node->ns->prefix) != node->ns)) {
+            ret = xmlSecC14NNativeCtxPushInScopeNs(ctx, node->ns, 1);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxPushInScopeNs", NULL);
+                return(-1);
+            }
+        }
+    }
+    for(ns = node->nsDef; ns != NULL; ns = ns->next) {
+        ret = xmlSecC14NNativeCtxPushInScopeNs(ctx, ns, 0);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxPushInScopeNs", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* pushes the namespaces declared on the @node ancestors, the outermost first */
+static int
+xmlSecC14NNativeCtxPushAncestorsNs(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node) {
+    xmlNodePtr* ancestors;
+    xmlNodePtr cur;
+    xmlSecSize size, ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    for(size = 0, cur = node->parent; (cur != NULL) && (cur->type == XML_ELEMENT_NODE); cur = cur->parent) {
+        ++size;
+    }
+    if(size == 0) {
+        return(0);
+    }
+
+    ancestors = (xmlNodePtr*)xmlMalloc(size * sizeof(xmlNodePtr));
+    if(ancestors == NULL) {
+        xmlSecMallocError(size * sizeof(xmlNodePtr), NULL);
+        return(-1);
+    }
+    for(ii = size, cur = node->parent; ii > 0; --ii, cur = cur->parent) {
+        ancestors[ii - 1] = cur;
+    }
+    for(ii = 0; ii < size; ++ii) {
+        ret = xmlSecC14NNativeCtxPushElementNs(ctx, ancestors[ii]);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxPushElementNs", NULL);
+            xmlFree(ancestors);
+            return(-1);
+        }
+    }
+    xmlFree(ancestors);
+    return(0);
+}
+
+/* same as xmlSearchNs() for the current element */
+static xmlNsPtr
+xmlSecC14NNativeCtxSearchNs(xmlSecC14NNativeCtxPtr ctx, const xmlChar* prefix) {
+    xmlSecC14NNativeInScopeNs* item;
+    xmlSecSize own;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    /* the "xml" prefix is never declared in the tree */
+    if(xmlStrEqual(prefix, BAD_CAST "xml")) {
+        return(NULL);
+    }
+
+    /* the element's own namespace doesn't count */
+    own = (ctx->framesSize > 0) ? ctx->frames[ctx->framesSize - 1].inScopeSize : ctx->inScopeSize;
+    for(ii = ctx->inScopeSize; ii > 0; --ii) {
+        item = &(ctx->inScope[ii - 1]);
+        if(((item->shadow != 0) && (ii > own)) || (item->ns->href == NULL)) {
+            continue;
+        }
+        if(xmlStrEqual(item->ns->prefix, prefix)) {
+            return(item->ns);
+        }
+    }
+    return(NULL);
+}
+
+/* the libxml2 xmlC14NStrEqual(): NULL is the same as the empty string */
+static int
+xmlSecC14NNativeStrEqual(const xmlChar* str1, const xmlChar* str2) {
+    if(str1 == NULL) {
+        str1 = BAD_CAST "";
+    }
+    if(str2 == NULL) {
+        str2 = BAD_CAST "";
+    }
+    return(xmlStrEqual(str1, str2));
+}
+
+static int
+xmlSecC14NNativeCtxAddRendered(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns, xmlNodePtr node) {
+    xmlSecC14NNativeRenderedNs* newItems;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->renderedEnd >= ctx->renderedMaxSize) {
+        newSize = (ctx->renderedMaxSize > 0) ? (2 * ctx->renderedMaxSize) : XMLSEC_C14N_NATIVE_STACK_SIZE;
+        newItems = (xmlSecC14NNativeRenderedNs*)xmlRealloc(ctx->rendered, newSize * sizeof(xmlSecC14NNativeRenderedNs));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecC14NNativeRenderedNs), NULL);
+            return(-1);
+        }
+        ctx->rendered = newItems;
+        ctx->renderedMaxSize = newSize;
+    }
+    ctx->rendered[ctx->renderedEnd].ns = ns;
+    ctx->rendered[ctx->renderedEnd].node = node;
+    ++ctx->renderedEnd;
+    return(0);
+}
+
+/* inclusive c14n: checks whether the @ns is already rendered by the output ancestors */
+static int
+xmlSecC14NNativeCtxFindRendered(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns) {
+    const xmlChar* prefix;
+    const xmlChar* href;
+    xmlNsPtr ns1;
+    xmlSecSize start;
+    xmlSecSize ii;
+    int hasEmptyNs;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ns != NULL, 0);
+
+    prefix = (ns->prefix != NULL) ? ns->prefix : BAD_CAST "";
+    href = (ns->href != NULL) ? ns->href : BAD_CAST "";
+    hasEmptyNs = (((*prefix) == '\0') && ((*href) == '\0')) ? 1 : 0;
+
+    /* the default namespace xmlns="" is rendered if not declared yet */
+    start = (hasEmptyNs != 0) ? 0 : ctx->renderedPrevStart;
+    for(ii = ctx->renderedEnd; ii > start; --ii) {
+        ns1 = ctx->rendered[ii - 1].ns;
+        if(xmlSecC14NNativeStrEqual(prefix, (ns1 != NULL) ? ns1->prefix : NULL)) {
+            return(xmlSecC14NNativeStrEqual(href, (ns1 != NULL) ? ns1->href : NULL));
+        }
+    }
+    return(hasEmptyNs);
+}
+
+/* exclusive c14n: checks whether the @ns is already rendered by the output ancestors */
+static int
+xmlSecC14NNativeCtxExclFindRendered(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns) {
+    const xmlChar* prefix;
+    const xmlChar* href;
+    xmlNsPtr ns1;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ns != NULL, 0);
+
+    prefix = (ns->prefix != NULL) ? ns->prefix : BAD_CAST "";
+    href = (ns->href != NULL) ? ns->href : BAD_CAST "";
+
+    for(ii = ctx->renderedEnd; ii > 0; --ii) {
+        ns1 = ctx->rendered[ii - 1].ns;
+        if(xmlSecC14NNativeStrEqual(prefix, (ns1 != NULL) ? ns1->prefix : NULL)) {
+            if(xmlSecC14NNativeStrEqual(href, (ns1 != NULL) ? ns1->href : NULL)) {
+                return(xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)ns1, ctx->rendered[ii - 1].node));
+            }
+            return(0);
+        }
+    }
+    return((((*prefix) == '\0') && ((*href) == '\0')) ? 1 : 0);
+}
+
+/* the namespaces are sorted by prefix, same as the libxml2 list insert */
+static int
+xmlSecC14NNativeCtxInsertNs(xmlSecC14NNativeCtxPtr ctx, xmlNsPtr ns) {
+    xmlNsPtr* newItems;
+    xmlSecSize newSize;
+    xmlSecSize pos;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ns != NULL, -1);
+
+    if(ctx->nsSize >= ctx->nsMaxSize) {
+        newSize = (ctx->nsMaxSize > 0) ? (2 * ctx->nsMaxSize) : XMLSEC_C14N_NATIVE_STACK_SIZE;
+        newItems = (xmlNsPtr*)xmlRealloc(ctx->ns, newSize * sizeof(xmlNsPtr));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlNsPtr), NULL);
+            return(-1);
+        }
+        ctx->ns = newItems;
+        ctx->nsMaxSize = newSize;
+    }
+
+    for(pos = 0; pos < ctx->nsSize; ++pos) {
+        if((ctx->ns[pos] == ns) || (xmlStrcmp(ctx->ns[pos]->prefix, ns->prefix) >= 0)) {
+            break;
+        }
+    }
+    memmove(ctx->ns + pos + 1, ctx->ns + pos, (ctx->nsSize - pos) * sizeof(xmlNsPtr));
+    ctx->ns[pos] = ns;
+    ++ctx->nsSize;
+    return(0);
+}
+
+/* the libxml2 xmlC14NAttrsCompare() */
+static int
+xmlSecC14NNativeAttrsCompare(xmlAttrPtr attr1, xmlAttrPtr attr2) {
+    int ret;
+
+    if(attr1 == attr2) {
+        return(0);
+    }
+    if(attr1->ns == attr2->ns) {
+        return(xmlStrcmp(attr1->name, attr2->name));
+    }
+
+    /* the attributes without namespace go first */
+    if(attr1->ns == NULL) {
+        return(-1);
+    }
+    if(attr2->ns == NULL) {
+        return(1);
+    }
+    if(attr1->ns->prefix == NULL) {
+        return(-1);
+    }
+    if(attr2->ns->prefix == NULL) {
+        return(1);
+    }
+
+    ret = xmlStrcmp(attr1->ns->href, attr2->ns->href);
+    if(ret == 0) {
+        ret = xmlStrcmp(attr1->name, attr2->name);
+    }
+    return(ret);
+}
+
+static int
+xmlSecC14NNativeCtxInsertAttr(xmlSecC14NNativeCtxPtr ctx, xmlAttrPtr attr) {
+    xmlAttrPtr* newItems;
+    xmlSecSize newSize;
+    xmlSecSize pos;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(attr != NULL, -1);
+
+    if(ctx->attrsSize >= ctx->attrsMaxSize) {
+        newSize = (ctx->attrsMaxSize > 0) ? (2 * ctx->attrsMaxSize) : XMLSEC_C14N_NATIVE_STACK_SIZE;
+        newItems = (xmlAttrPtr*)xmlRealloc(ctx->attrs, newSize * sizeof(xmlAttrPtr));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlAttrPtr), NULL);
+            return(-1);
+        }
+        ctx->attrs = newItems;
+        ctx->attrsMaxSize = newSize;
+    }
+
+    for(pos = 0; pos < ctx->attrsSize; ++pos) {
+        if(xmlSecC14NNativeAttrsCompare(ctx->attrs[pos], attr) >= 0) {
+            break;
+        }
+    }
+    memmove(ctx->attrs + pos + 1, ctx->attrs + pos, (ctx->attrsSize - pos) * sizeof(xmlAttrPtr));
+    ctx->attrs[pos] = attr;
+    ++ctx->attrsSize;
+    return(0);
+}
+
+/* c14n must fail on the relative namespace URIs */
+static int
+xmlSecC14NNativeCtxCheckNs(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node) {
+    xmlURIPtr uri;
+    xmlNsPtr ns;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    for(ns = node->nsDef; ns != NULL; ns = ns->next) {
+        if(xmlStrlen(ns->href) <= 0) {
+            continue;
+        }
+        if((ctx->checkedHrefs != NULL) && (xmlHashLookup(ctx->checkedHrefs, ns->href) != NULL)) {
+            continue;
+        }
+
+        uri = xmlParseURI((const char*)ns->href);
+        if(uri == NULL) {
+            xmlSecXmlError2("xmlParseURI", NULL,
+                            "href=%s", xmlSecErrorsSafeString(ns->href));
+            return(-1);
+        }
+        if(xmlStrlen(BAD_CAST uri->scheme) <= 0) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_DATA, NULL,
+                              "relative namespace href=%s", xmlSecErrorsSafeString(ns->href));
+            xmlFreeURI(uri);
+            return(-1);
+        }
+        xmlFreeURI(uri);
+
+        if(ctx->checkedHrefs == NULL) {
+            ctx->checkedHrefs = xmlHashCreate(XMLSEC_C14N_NATIVE_STACK_SIZE);
+            if(ctx->checkedHrefs == NULL) {
+                xmlSecXmlError("xmlHashCreate", NULL);
+                return(-1);
+            }
+        }
+        ret = xmlHashAddEntry(ctx->checkedHrefs, ns->href, ctx);
+        if(ret < 0) {
+            xmlSecXmlError("xmlHashAddEntry", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* inclusive c14n namespaces axis */
+static int
+xmlSecC14NNativeCtxNsAxis(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, int visible) {
+    xmlNs nsDefault;
+    xmlNsPtr ns;
+    xmlSecSize ii;
+    int alreadyRendered;
+    int hasEmptyNs = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    ctx->nsSize = 0;
+    for(ii = ctx->inScopeSize; ii > 0; --ii) {
+        ns = ctx->inScope[ii - 1].ns;
+        if((ctx->inScope[ii - 1].shadow != 0) ||
+           (xmlSecC14NNativeCtxSearchNs(ctx, ns->prefix) != ns) ||
+           xmlSecC14NNativeIsXmlNs(ns) ||
+           (xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)ns, node) == 0)) {
+            continue;
+        }
+
+        alreadyRendered = xmlSecC14NNativeCtxFindRendered(ctx, ns);
+        if(visible != 0) {
+            if(xmlSecC14NNativeCtxAddRendered(ctx, ns, node) < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxAddRendered", NULL);
+                return(-1);
+            }
+        }
+        if(alreadyRendered == 0) {
+            if(xmlSecC14NNativeCtxInsertNs(ctx, ns) < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxInsertNs", NULL);
+                return(-1);
+            }
+        }
+        if(xmlStrlen(ns->prefix) == 0) {
+            hasEmptyNs = 1;
+        }
+    }
+
+    /* xmlns="" if the nearest output ancestor has the default namespace */
+    if((visible != 0) && (hasEmptyNs == 0)) {
+        memset(&nsDefault, 0, sizeof(nsDefault));
+        if(xmlSecC14NNativeCtxFindRendered(ctx, &nsDefault) == 0) {
+            if(xmlSecC14NNativeCtxWriteNs(ctx, &nsDefault) < 0) {
+                return(-1);
+            }
+        }
+    }
+
+    for(ii = 0; ii < ctx->nsSize; ++ii) {
+        if(xmlSecC14NNativeCtxWriteNs(ctx, ctx->ns[ii]) < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* exclusive c14n namespaces axis */
+static int
+xmlSecC14NNativeCtxExclNsAxis(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, int visible) {
+    xmlNs nsDefault;
+    xmlNsPtr ns;
+    xmlAttrPtr attr;
+    const xmlChar* prefix;
+    xmlSecSize ii;
+    int alreadyRendered;
+    int hasEmptyNs = 0;
+    int hasVisiblyUtilizedEmptyNs = 0;
+    int hasEmptyNsInInclusiveList = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    ctx->nsSize = 0;
+
+    /* the namespaces from the inclusive list are processed as in the inclusive c14n */
+    if(ctx->inclusiveNsList != NULL) {
+        for(ii = 0; ctx->inclusiveNsList[ii] != NULL; ++ii) {
+            prefix = ctx->inclusiveNsList[ii];
+            if(xmlStrEqual(prefix, BAD_CAST "#default") || xmlStrEqual(prefix, BAD_CAST "")) {
+                prefix = NULL;
+                hasEmptyNsInInclusiveList = 1;
+            }
+
+            ns = xmlSecC14NNativeCtxSearchNs(ctx, prefix);
+            if((ns == NULL) || xmlSecC14NNativeIsXmlNs(ns) ||
+               (xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)ns, node) == 0)) {
+                continue;
+            }
+
+            alreadyRendered = xmlSecC14NNativeCtxFindRendered(ctx, ns);
+            if(visible != 0) {
+                if(xmlSecC14NNativeCtxAddRendered(ctx, ns, node) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxAddRendered", NULL);
+                    return(-1);
+                }
+            }
+            if(alreadyRendered == 0) {
+                if(xmlSecC14NNativeCtxInsertNs(ctx, ns) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertNs", NULL);
+                    return(-1);
+                }
+            }
+            if(xmlStrlen(ns->prefix) == 0) {
+                hasEmptyNs = 1;
+            }
+        }
+    }
+
+    /* the element namespace */
+    if(node->ns != NULL) {
+        ns = node->ns;
+    } else {
+        ns = xmlSecC14NNativeCtxSearchNs(ctx, NULL);
+        hasVisiblyUtilizedEmptyNs = 1;
+    }
+    if((ns != NULL) && !xmlSecC14NNativeIsXmlNs(ns)) {
+        if((visible != 0) && (xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)ns, node) != 0)) {
+            if(xmlSecC14NNativeCtxExclFindRendered(ctx, ns) == 0) {
+                if(xmlSecC14NNativeCtxInsertNs(ctx, ns) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertNs", NULL);
+                    return(-1);
+                }
+            }
+        }
+        if(visible != 0) {
+            if(xmlSecC14NNativeCtxAddRendered(ctx, ns, node) < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxAddRendered", NULL);
+                return(-1);
+            }
+        }
+        if(xmlStrlen(ns->prefix) == 0) {
+            hasEmptyNs = 1;
+        }
+    }
+
+    /* the attributes namespaces (the default namespace doesn't apply to attributes) */
+    for(attr = node->properties; attr != NULL; attr = attr->next) {
+        if((attr->ns != NULL) && !xmlSecC14NNativeIsXmlNs(attr->ns) &&
+           (xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)attr, node) != 0)) {
+            alreadyRendered = xmlSecC14NNativeCtxExclFindRendered(ctx, attr->ns);
+            if(xmlSecC14NNativeCtxAddRendered(ctx, attr->ns, node) < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxAddRendered", NULL);
+                return(-1);
+            }
+            if((alreadyRendered == 0) && (visible != 0)) {
+                if(xmlSecC14NNativeCtxInsertNs(ctx, attr->ns) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertNs", NULL);
+                    return(-1);
+                }
+            }
+            if(xmlStrlen(attr->ns->prefix) == 0) {
+                hasEmptyNs = 1;
+            }
+        } else if((attr->ns != NULL) && (xmlStrlen(attr->ns->prefix) == 0) && (xmlStrlen(attr->ns->href) == 0)) {
+            hasVisiblyUtilizedEmptyNs = 1;
+        }
+    }
+
+    /* xmlns="" */
+    memset(&nsDefault, 0, sizeof(nsDefault));
+    if((visible != 0) && (hasVisiblyUtilizedEmptyNs != 0) && (hasEmptyNs == 0) && (hasEmptyNsInInclusiveList == 0)) {
+        if(xmlSecC14NNativeCtxExclFindRendered(ctx, &nsDefault) == 0) {
+            if(xmlSecC14NNativeCtxWriteNs(ctx, &nsDefault) < 0) {
+                return(-1);
+            }
+        }
+    } else if((visible != 0) && (hasEmptyNs == 0) && (hasEmptyNsInInclusiveList != 0)) {
+        if(xmlSecC14NNativeCtxFindRendered(ctx, &nsDefault) == 0) {
+            if(xmlSecC14NNativeCtxWriteNs(ctx, &nsDefault) < 0) {
+                return(-1);
+            }
+        }
+    }
+
+    for(ii = 0; ii < ctx->nsSize; ++ii) {
+        if(xmlSecC14NNativeCtxWriteNs(ctx, ctx->ns[ii]) < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* the nearest xml:* attribute on the ancestors that are not in the output */
+static xmlAttrPtr
+xmlSecC14NNativeCtxFindHiddenAttr(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, const xmlChar* name) {
+    xmlAttrPtr attr;
+    xmlSecSize level;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->framesSize > 0, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+
+    for(level = ctx->framesSize - 1; node != NULL; node = node->parent) {
+        if(xmlSecC14NNativeCtxIsAncestorVisible(ctx, node, level) != 0) {
+            break;
+        }
+        attr = xmlHasNsProp(node, name, XML_XML_NAMESPACE);
+        if(attr != NULL) {
+            return(attr);
+        }
+        if(level > 0) {
+            --level;
+        }
+    }
+    return(NULL);
+}
+
+static int
+xmlSecC14NNativeCtxAttrsAxis(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, int visible) {
+    xmlAttrPtr attr;
+    xmlAttrPtr xmlLangAttr = NULL;
+    xmlAttrPtr xmlSpaceAttr = NULL;
+    xmlNodePtr cur;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->framesSize > 0, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    ctx->attrsSize = 0;
+    switch(ctx->mode) {
+    case XML_C14N_1_0:
+        for(attr = node->properties; attr != NULL; attr = attr->next) {
+            if(xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)attr, node) != 0) {
+                if(xmlSecC14NNativeCtxInsertAttr(ctx, attr) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                    return(-1);
+                }
+            }
+        }
+
+        /* the nearest xml:* attributes from the ancestors if the parent is not in the output */
+        if((visible != 0) && (node->parent != NULL) &&
+           (xmlSecC14NNativeCtxIsAncestorVisible(ctx, node->parent, ctx->framesSize - 1) == 0)) {
+            for(cur = node->parent; (cur != NULL) && (cur->type == XML_ELEMENT_NODE); cur = cur->parent) {
+                for(attr = cur->properties; attr != NULL; attr = attr->next) {
+                    if(!xmlSecC14NNativeIsXmlAttr(attr)) {
+                        continue;
+                    }
+                    for(ii = 0; ii < ctx->attrsSize; ++ii) {
+                        if(xmlSecC14NNativeAttrsCompare(ctx->attrs[ii], attr) == 0) {
+                            break;
+                        }
+                    }
+                    if(ii < ctx->attrsSize) {
+                        continue;
+                    }
+                    if(xmlSecC14NNativeCtxInsertAttr(ctx, attr) < 0) {
+                        xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                        return(-1);
+                    }
+                }
+            }
+        }
+        break;
+    case XML_C14N_1_1:
+        for(attr = node->properties; attr != NULL; attr = attr->next) {
+            /* the simple inheritable xml:* attributes are processed below */
+            if((visible != 0) && xmlSecC14NNativeIsXmlAttr(attr)) {
+                if((xmlLangAttr == NULL) && xmlStrEqual(attr->name, BAD_CAST "lang")) {
+                    xmlLangAttr = attr;
+                    continue;
+                }
+                if((xmlSpaceAttr == NULL) && xmlStrEqual(attr->name, BAD_CAST "space")) {
+                    xmlSpaceAttr = attr;
+                    continue;
+                }
+            }
+            if(xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)attr, node) != 0) {
+                if(xmlSecC14NNativeCtxInsertAttr(ctx, attr) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                    return(-1);
+                }
+            }
+        }
+
+        /* xml:base is not supported (see xmlSecC14NNativeIsSupported) */
+        if(visible != 0) {
+            if(xmlLangAttr == NULL) {
+                xmlLangAttr = xmlSecC14NNativeCtxFindHiddenAttr(ctx, node->parent, BAD_CAST "lang");
+            }
+            if(xmlLangAttr != NULL) {
+                if(xmlSecC14NNativeCtxInsertAttr(ctx, xmlLangAttr) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                    return(-1);
+                }
+            }
+            if(xmlSpaceAttr == NULL) {
+                xmlSpaceAttr = xmlSecC14NNativeCtxFindHiddenAttr(ctx, node->parent, BAD_CAST "space");
+            }
+            if(xmlSpaceAttr != NULL) {
+                if(xmlSecC14NNativeCtxInsertAttr(ctx, xmlSpaceAttr) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                    return(-1);
+                }
+            }
+        }
+        break;
+    default:
+        /* the xml:* attributes are not imported in the exclusive c14n */
+        for(attr = node->properties; attr != NULL; attr = attr->next) {
+            if(xmlSecC14NNativeCtxIsVisible(ctx, (xmlNodePtr)attr, node) != 0) {
+                if(xmlSecC14NNativeCtxInsertAttr(ctx, attr) < 0) {
+                    xmlSecInternalError("xmlSecC14NNativeCtxInsertAttr", NULL);
+                    return(-1);
+                }
+            }
+        }
+        break;
+    }
+
+    for(ii = 0; ii < ctx->attrsSize; ++ii) {
+        if(xmlSecC14NNativeCtxWriteAttr(ctx, ctx->attrs[ii]) < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxStartElement(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node, int visible) {
+    xmlSecC14NNativeFrame* newItems;
+    xmlSecC14NNativeFrame* frame;
+    xmlSecSize newSize;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    ret = xmlSecC14NNativeCtxCheckNs(ctx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxCheckNs", NULL);
+        return(-1);
+    }
+
+    if(ctx->framesSize >= ctx->framesMaxSize) {
+        newSize = (ctx->framesMaxSize > 0) ? (2 * ctx->framesMaxSize) : XMLSEC_C14N_NATIVE_STACK_SIZE;
+        newItems = (xmlSecC14NNativeFrame*)xmlRealloc(ctx->frames, newSize * sizeof(xmlSecC14NNativeFrame));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecC14NNativeFrame), NULL);
+            return(-1);
+        }
+        ctx->frames = newItems;
+        ctx->framesMaxSize = newSize;
+    }
+    frame = &(ctx->frames[ctx->framesSize++]);
+    frame->node = node;
+    frame->visible = visible;
+    frame->parentIsDoc = 0;
+    frame->inScopeSize = ctx->inScopeSize;
+    frame->renderedEnd = ctx->renderedEnd;
+    frame->renderedPrevStart = ctx->renderedPrevStart;
+    frame->renderedPrevEnd = ctx->renderedPrevEnd;
+
+    ret = xmlSecC14NNativeCtxPushElementNs(ctx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxPushElementNs", NULL);
+        return(-1);
+    }
+
+    if(visible != 0) {
+        if(ctx->parentIsDoc != 0) {
+            frame->parentIsDoc = 1;
+            ctx->parentIsDoc = 0;
+            ctx->pos = XMLSEC_C14N_NATIVE_INSIDE_DOCUMENT_ELEMENT;
+        }
+        if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "<") < 0) ||
+           (xmlSecC14NNativeCtxWriteQName(ctx, node->ns, node->name) < 0)) {
+            return(-1);
+        }
+    }
+
+    if(ctx->mode == XML_C14N_EXCLUSIVE_1_0) {
+        ret = xmlSecC14NNativeCtxExclNsAxis(ctx, node, visible);
+    } else {
+        ret = xmlSecC14NNativeCtxNsAxis(ctx, node, visible);
+    }
+    if(ret < 0) {
+        return(-1);
+    }
+    if(visible != 0) {
+        ctx->renderedPrevStart = ctx->renderedPrevEnd;
+        ctx->renderedPrevEnd = ctx->renderedEnd;
+    }
+
+    ret = xmlSecC14NNativeCtxAttrsAxis(ctx, node, visible);
+    if(ret < 0) {
+        return(-1);
+    }
+    if(visible != 0) {
+        if(xmlSecC14NNativeCtxWrite(ctx, BAD_CAST ">") < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NNativeCtxEndElement(xmlSecC14NNativeCtxPtr ctx) {
+    xmlSecC14NNativeFrame* frame;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->framesSize > 0, -1);
+
+    frame = &(ctx->frames[ctx->framesSize - 1]);
+    if(frame->visible != 0) {
+        if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST "</") < 0) ||
+           (xmlSecC14NNativeCtxWriteQName(ctx, frame->node->ns, frame->node->name) < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, BAD_CAST ">") < 0)) {
+            return(-1);
+        }
+        if(frame->parentIsDoc != 0) {
+            ctx->parentIsDoc = 1;
+            ctx->pos = XMLSEC_C14N_NATIVE_AFTER_DOCUMENT_ELEMENT;
+        }
+    }
+
+    ctx->inScopeSize = frame->inScopeSize;
+    ctx->renderedEnd = frame->renderedEnd;
+    ctx->renderedPrevStart = frame->renderedPrevStart;
+    ctx->renderedPrevEnd = frame->renderedPrevEnd;
+    --ctx->framesSize;
+    return(0);
+}
+
+/* writes the @node (or starts the element) */
+static int
+xmlSecC14NNativeCtxProcessNode(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr node) {
+    int visible;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    visible = xmlSecC14NNativeCtxIsVisible(ctx, node, node->parent);
+    switch(node->type) {
+    case XML_ELEMENT_NODE:
+        return(xmlSecC14NNativeCtxStartElement(ctx, node, visible));
+    case XML_TEXT_NODE:
+    case XML_CDATA_SECTION_NODE:
+        if(visible == 0) {
+            return(0);
+        }
+        return(xmlSecC14NNativeCtxWriteText(ctx, node));
+    case XML_PI_NODE:
+        if(visible == 0) {
+            return(0);
+        }
+        if((xmlSecC14NNativeCtxWrite(ctx, (ctx->pos == XMLSEC_C14N_NATIVE_AFTER_DOCUMENT_ELEMENT) ? BAD_CAST "\n<?" : BAD_CAST "<?") < 0) ||
+           (xmlSecC14NNativeCtxWrite(ctx, node->name) < 0)) {
+            return(-1);
+        }
+        if((node->content != NULL) && ((*node->content) != '\0')) {
+            if((xmlSecC14NNativeCtxWrite(ctx, BAD_CAST " ") < 0) ||
+               (xmlSecC14NNativeCtxWriteEscaped(ctx, node->content, &xmlSecC14NNativeMiscEscaping) < 0)) {
+                return(-1);
+            }
+        }
+        return(xmlSecC14NNativeCtxWrite(ctx, (ctx->pos == XMLSEC_C14N_NATIVE_BEFORE_DOCUMENT_ELEMENT) ? BAD_CAST "?>\n" : BAD_CAST "?>"));
+    case XML_COMMENT_NODE:
+        if((visible == 0) || (ctx->withComments == 0)) {
+            return(0);
+        }
+        if((xmlSecC14NNativeCtxWrite(ctx, (ctx->pos == XMLSEC_C14N_NATIVE_AFTER_DOCUMENT_ELEMENT) ? BAD_CAST "\n<!--" : BAD_CAST "<!--") < 0) ||
+           (xmlSecC14NNativeCtxWriteEscaped(ctx, node->content, &xmlSecC14NNativeMiscEscaping) < 0)) {
+            return(-1);
+        }
+        return(xmlSecC14NNativeCtxWrite(ctx, (ctx->pos == XMLSEC_C14N_NATIVE_BEFORE_DOCUMENT_ELEMENT) ? BAD_CAST "-->\n" : BAD_CAST "-->"));
+    case XML_DOCUMENT_TYPE_NODE:
+    case XML_NOTATION_NODE:
+    case XML_DTD_NODE:
+    case XML_ELEMENT_DECL:
+    case XML_ATTRIBUTE_DECL:
+    case XML_ENTITY_DECL:
+    case XML_XINCLUDE_START:
+    case XML_XINCLUDE_END:
+        /* ignored according to the c14n spec */
+        return(0);
+    default:
+        xmlSecInvalidIntegerTypeError("node type", node->type, "supported c14n node type", NULL);
+        return(-1);
+    }
+}
+
+/* walks the siblings from @first to @last (or to the last sibling if @last
+ * is NULL) and their descendants in the document order */
+static int
+xmlSecC14NNativeCtxProcess(xmlSecC14NNativeCtxPtr ctx, xmlNodePtr first, xmlNodePtr last) {
+    xmlNodePtr cur;
+    xmlSecSize base;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    base = ctx->framesSize;
+    cur = first;
+    while(cur != NULL) {
+        ret = xmlSecC14NNativeCtxProcessNode(ctx, cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcessNode", NULL);
+            return(-1);
+        }
+        if(cur->type == XML_ELEMENT_NODE) {
+            if(cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+            ret = xmlSecC14NNativeCtxEndElement(ctx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxEndElement", NULL);
+                return(-1);
+            }
+        }
+
+        /* the next node: the next sibling or the next sibling of the ancestors */
+        while(cur != NULL) {
+            if(ctx->framesSize == base) {
+                cur = (cur != last) ? cur->next : NULL;
+                break;
+            }
+            if(cur->next != NULL) {
+                cur = cur->next;
+                break;
+            }
+            cur = cur->parent;
+            ret = xmlSecC14NNativeCtxEndElement(ctx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NNativeCtxEndElement", NULL);
+                return(-1);
+            }
+        }
+    }
+    return(0);
+}
+
+/* same as xmlSecC14NNativeCtxProcess(ctx, doc->children, NULL) but the document
+ * element children are split between the executor tasks (if there are enough) */
+static int
+xmlSecC14NNativeCtxProcessParallel(xmlSecC14NNativeCtxPtr ctx) {
+    xmlSecC14NNativeJob job;
+    void* tasks[XMLSEC_C14N_NATIVE_PARALLEL_MAX_RANGES];
+    xmlNodePtr root;
+    xmlSecSize nodesNum, rangesNum, ii;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->doc != NULL, -1);
+    xmlSecAssert2(ctx->framesSize == 0, -1);
+
+    root = xmlDocGetRootElement(ctx->doc);
+    if((root == NULL) || (root->children == NULL)) {
+        return(xmlSecC14NNativeCtxProcess(ctx, ctx->doc->children, NULL));
+    }
+
+    nodesNum = xmlSecC14NNativeCountNodes(root);
+    rangesNum = xmlSecExecutorGetThreadsNumber();
+    if(rangesNum > XMLSEC_C14N_NATIVE_PARALLEL_MAX_RANGES) {
+        rangesNum = XMLSEC_C14N_NATIVE_PARALLEL_MAX_RANGES;
+    }
+    if(rangesNum > nodesNum / XMLSEC_C14N_NATIVE_PARALLEL_MIN_NODES) {
+        rangesNum = nodesNum / XMLSEC_C14N_NATIVE_PARALLEL_MIN_NODES;
+    }
+    if(rangesNum < 2) {
+        return(xmlSecC14NNativeCtxProcess(ctx, ctx->doc->children, NULL));
+    }
+
+    /* the nodes before the document element and its start tag */
+    if(root->prev != NULL) {
+        ret = xmlSecC14NNativeCtxProcess(ctx, ctx->doc->children, root->prev);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            return(-1);
+        }
+    }
+    ret = xmlSecC14NNativeCtxProcessNode(ctx, root);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxProcessNode", NULL);
+        return(-1);
+    }
+
+    /* the document element children */
+    ret = xmlSecC14NNativeJobInitialize(&job, ctx, root, nodesNum, rangesNum);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeJobInitialize", NULL);
+        return(-1);
+    }
+    for(ii = 0; ii < job.size; ++ii) {
+        tasks[ii] = &job;
+    }
+    ret = xmlSecExecutorRun(xmlSecC14NNativeJobTask, tasks, job.size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+    for(ii = 0; ii < job.size; ++ii) {
+        if(job.ranges[ii].result < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            goto done;
+        }
+        ret = xmlSecC14NNativeCtxWriteData(ctx, xmlSecBufferGetData(&(job.ranges[ii].out)),
+                                           xmlSecBufferGetSize(&(job.ranges[ii].out)));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxWriteData", NULL);
+            goto done;
+        }
+        xmlSecBufferFinalize(&(job.ranges[ii].out));
+    }
+
+    /* the document element end tag and the nodes after it */
+    ret = xmlSecC14NNativeCtxEndElement(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NNativeCtxEndElement", NULL);
+        goto done;
+    }
+    if(root->next != NULL) {
+        ret = xmlSecC14NNativeCtxProcess(ctx, root->next, NULL);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxProcess", NULL);
+            goto done;
+        }
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    xmlSecC14NNativeJobFinalize(&job);
+    return(res);
+}
+
+/* the number of nodes in the @node subtree (attributes and namespaces are not counted) */
+static xmlSecSize
+xmlSecC14NNativeCountNodes(xmlNodePtr node) {
+    xmlNodePtr cur;
+    xmlSecSize res = 0;
+
+    xmlSecAssert2(node != NULL, 0);
+
+    cur = node;
+    while(cur != NULL) {
+        ++res;
+        if((cur->type == XML_ELEMENT_NODE) && (cur->children != NULL)) {
+            cur = cur->children;
+            continue;
+        }
+        while((cur != node) && (cur->next == NULL)) {
+            cur = cur->parent;
+        }
+        cur = (cur != node) ? cur->next : NULL;
+    }
+    return(res);
+}
+
+/* splits the @root children into up to @rangesNum ranges with about the same
+ * number of nodes, @ctx has just started the @root element */
+static int
+xmlSecC14NNativeJobInitialize(xmlSecC14NNativeJobPtr job, xmlSecC14NNativeCtxPtr ctx,
+                              xmlNodePtr root, xmlSecSize nodesNum, xmlSecSize rangesNum) {
+    xmlSecC14NNativeRange* range;
+    xmlNodePtr cur;
+    xmlSecSize count, limit;
+    int ret;
+
+    xmlSecAssert2(job != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->framesSize == 1, -1);
+    xmlSecAssert2(root != NULL, -1);
+    xmlSecAssert2(root->children != NULL, -1);
+    xmlSecAssert2(rangesNum > 0, -1);
+
+    memset(job, 0, sizeof(xmlSecC14NNativeJob));
+    job->ranges = (xmlSecC14NNativeRange*)xmlMalloc(rangesNum * sizeof(xmlSecC14NNativeRange));
+    if(job->ranges == NULL) {
+        xmlSecMallocError(rangesNum * sizeof(xmlSecC14NNativeRange), NULL);
+        return(-1);
+    }
+    memset(job->ranges, 0, rangesNum * sizeof(xmlSecC14NNativeRange));
+    job->mutex = xmlNewMutex();
+    if(job->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlSecC14NNativeJobFinalize(job);
+        return(-1);
+    }
+
+    for(cur = root->children, count = 0; (cur != NULL) && (job->size < rangesNum); ) {
+        range = &(job->ranges[job->size++]);
+        range->result = -1;
+
+        ret = xmlSecBufferInitialize(&(range->out), 0);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferInitialize", NULL);
+            xmlSecC14NNativeJobFinalize(job);
+            return(-1);
+        }
+        ret = xmlSecC14NNativeCtxInitialize(&(range->ctx), ctx->nodes, ctx->mode, ctx->inclusiveNsList,
+                                            ctx->withComments, ctx->trimTextNodes, ctx->buf);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxInitialize", NULL);
+            xmlSecC14NNativeJobFinalize(job);
+            return(-1);
+        }
+        range->ctx.visibility = ctx->visibility;
+        range->ctx.enveloped = ctx->enveloped;
+        range->ctx.enveloped.lastParent = NULL;
+        range->ctx.treeWithComments = ctx->treeWithComments;
+        range->ctx.outBuffer = &(range->out);
+
+        /* same state as the main context, the start tag is written by it */
+        ret = xmlSecC14NNativeCtxStartElement(&(range->ctx), root, ctx->frames[0].visible);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NNativeCtxStartElement", NULL);
+            xmlSecC14NNativeJobFinalize(job);
+            return(-1);
+        }
+        range->ctx.outSize = 0;
+        xmlSecBufferEmpty(&(range->out));
+
+        /* the last range takes all the remaining children */
+        limit = (nodesNum / rangesNum) * job->size;
+        range->first = cur;
+        do {
+            count += xmlSecC14NNativeCountNodes(cur);
+            range->last = cur;
+            cur = cur->next;
+        } while((cur != NULL) && ((count < limit) || (job->size == rangesNum)));
+    }
+    return(0);
+}
+
+static void
+xmlSecC14NNativeJobFinalize(xmlSecC14NNativeJobPtr job) {
+    xmlSecSize ii;
+
+    xmlSecAssert(job != NULL);
+
+    if(job->ranges != NULL) {
+        for(ii = 0; ii < job->size; ++ii) {
+            xmlSecC14NNativeCtxFinalize(&(job->ranges[ii].ctx));
+            xmlSecBufferFinalize(&(job->ranges[ii].out));
+        }
+        xmlFree(job->ranges);
+    }
+    if(job->mutex != NULL) {
+        xmlFreeMutex(job->mutex);
+    }
+    memset(job, 0, sizeof(xmlSecC14NNativeJob));
+}
+
+static void
+xmlSecC14NNativeJobTask(void* data) {
+    xmlSecC14NNativeJobPtr job = (xmlSecC14NNativeJobPtr)data;
+    xmlSecC14NNativeRange* range;
+    xmlSecSize pos;
+
+    xmlSecAssert(job != NULL);
+    xmlSecAssert(job->mutex != NULL);
+
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = job->next;
+        if(pos < job->size) {
+            ++job->next;
+        }
+        xmlMutexUnlock(job->mutex);
+
+        if(pos >= job->size) {
+            break;
+        }
+        range = &(job->ranges[pos]);
+        range->result = xmlSecC14NNativeCtxProcess(&(range->ctx), range->first, range->last);
+        if(range->result >= 0) {
+            range->result = xmlSecC14NNativeCtxFlush(&(range->ctx));
+        }
+    }
+}
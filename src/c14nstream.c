@@ -0,0 +1,1054 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Streaming canonicalization of XML files.
+ *
+ * The file is read with xmlTextReader and only the current node with its
+ * ancestors is kept in memory. This supports exactly what is needed for
+ * the enveloped signature over the whole document: the exclusive c14n
+ * (or the canonical XML 2.0) of the document without the first node with the given name (the
+ * <dsig:Signature/> node) and the copy of the document with this node
+ * replaced. The <dsig:Signature/> node and the subtrees it references by
+ * ID can be extracted into a partial document.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/xmlreader.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/xmltree.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/private/c14nnative.h>
+#include <xmlsec/private/c14nstream.h>
+
+/* the output is passed to the write callback in chunks of this size */
+#define XMLSEC_C14N_STREAM_CHUNK_SIZE                   65536
+
+/* same as xmlSecParseFile(): load DTD, add default attributes and substitute entities */
+#define XMLSEC_C14N_STREAM_PARSE_OPTIONS \
+    (XML_PARSE_DTDLOAD | XML_PARSE_DTDATTR | XML_PARSE_NOENT)
+
+typedef struct _xmlSecC14NStreamNs {
+    const xmlChar*              prefix;
+    const xmlChar*              href;
+    int                         depth;
+} xmlSecC14NStreamNs;
+
+typedef struct _xmlSecC14NStreamCtx {
+    xmlSecC14NStreamMode        mode;
+    xmlChar**                   inclusiveNsList;
+    xmlSecC14NStreamWriteCallback writeCallback;
+    void*                       writeContext;
+    xmlSecBuffer                buffer;
+
+    /* the namespaces rendered by the output ancestors */
+    xmlSecC14NStreamNs*         rendered;
+    xmlSecSize                  renderedSize;
+    xmlSecSize                  renderedMaxSize;
+
+    /* the namespaces to render for the current element */
+    xmlSecC14NStreamNs*         candidates;
+    xmlSecSize                  candidatesSize;
+    xmlSecSize                  candidatesMaxSize;
+
+    /* the attributes of the current element */
+    xmlAttrPtr*                 attrs;
+    xmlSecSize                  attrsMaxSize;
+
+    int                         rootSeen;
+} xmlSecC14NStreamCtx, *xmlSecC14NStreamCtxPtr;
+
+static int      xmlSecC14NStreamCtxInitialize           (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlSecC14NStreamMode mode,
+                                                         xmlChar** inclusiveNsList,
+                                                         xmlSecC14NStreamWriteCallback writeCallback,
+                                                         void* writeContext);
+static void     xmlSecC14NStreamCtxFinalize             (xmlSecC14NStreamCtxPtr ctx);
+static int      xmlSecC14NStreamCtxFlush                (xmlSecC14NStreamCtxPtr ctx);
+static int      xmlSecC14NStreamCtxWriteData            (xmlSecC14NStreamCtxPtr ctx,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize size);
+static int      xmlSecC14NStreamCtxWrite                (xmlSecC14NStreamCtxPtr ctx,
+                                                         const xmlChar* str);
+static int      xmlSecC14NStreamCtxWriteEscaped         (xmlSecC14NStreamCtxPtr ctx,
+                                                         const xmlChar* str,
+                                                         xmlSecSize size,
+                                                         int isAttr);
+static int      xmlSecC14NStreamCtxWriteQName           (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlNsPtr ns,
+                                                         const xmlChar* name);
+static int      xmlSecC14NStreamCtxWriteNs              (xmlSecC14NStreamCtxPtr ctx,
+                                                         const xmlChar* prefix,
+                                                         const xmlChar* href);
+static int      xmlSecC14NStreamCtxWriteAttr            (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlAttrPtr attr);
+static int      xmlSecC14NStreamCtxWriteNode            (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlNodePtr node);
+static int      xmlSecC14NStreamCtxAddNs                (xmlSecC14NStreamNs** items,
+                                                         xmlSecSize* itemsSize,
+                                                         xmlSecSize* itemsMaxSize,
+                                                         const xmlChar* prefix,
+                                                         const xmlChar* href,
+                                                         int depth);
+static int      xmlSecC14NStreamCtxAddCandidate         (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         const xmlChar* prefix);
+static int      xmlSecC14NStreamCtxStartElement         (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int depth);
+static int      xmlSecC14NStreamCtxEndElement           (xmlSecC14NStreamCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         int depth);
+static int      xmlSecC14NStreamCtxMisc                 (xmlSecC14NStreamCtxPtr ctx,
+                                                         int nodeType,
+                                                         const xmlChar* name,
+                                                         const xmlChar* value,
+                                                         int depth);
+
+/* copies the reader's current element subtree under @parent (or as the @doc root) */
+static xmlNodePtr
+xmlSecC14NStreamCopyNode(xmlTextReaderPtr reader, xmlDocPtr doc, xmlNodePtr parent) {
+    xmlNodePtr node;
+    xmlNodePtr copy;
+    xmlNsPtr* nsList;
+    xmlSecSize ii;
+
+    xmlSecAssert2(reader != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    /* read the whole subtree */
+    node = xmlTextReaderExpand(reader);
+    if(node == NULL) {
+        xmlSecXmlError("xmlTextReaderExpand", NULL);
+        return(NULL);
+    }
+
+    copy = xmlDocCopyNode(node, doc, 1);
+    if(copy == NULL) {
+        xmlSecXmlError("xmlDocCopyNode", NULL);
+        return(NULL);
+    }
+    if(parent != NULL) {
+        xmlAddChild(parent, copy);
+    } else {
+        xmlDocSetRootElement(doc, copy);
+    }
+
+    /* declare the namespaces from the ancestors */
+    nsList = xmlGetNsList(node->doc, node);
+    if(nsList != NULL) {
+        for(ii = 0; nsList[ii] != NULL; ++ii) {
+            if(xmlSearchNs(doc, copy, nsList[ii]->prefix) != NULL) {
+                continue;
+            }
+            if(xmlNewNs(copy, nsList[ii]->href, nsList[ii]->prefix) == NULL) {
+                xmlSecXmlError("xmlNewNs", NULL);
+                xmlFree(nsList);
+                return(NULL);
+            }
+        }
+        xmlFree(nsList);
+    }
+    return(copy);
+}
+
+/* checks if one of the @idAttrs attributes of @node has a value from @ids */
+static int
+xmlSecC14NStreamCheckNodeId(xmlNodePtr node, const xmlChar** idAttrs, const xmlChar** ids) {
+    xmlAttrPtr attr;
+    xmlChar* value;
+    xmlSecSize ii, jj;
+    int res = 0;
+
+    for(ii = 0; (res == 0) && (idAttrs[ii] != NULL); ++ii) {
+        attr = xmlHasProp(node, idAttrs[ii]);
+        if((attr == NULL) || (attr->children == NULL)) {
+            continue;
+        }
+        value = xmlNodeListGetString(node->doc, attr->children, 1);
+        if(value == NULL) {
+            continue;
+        }
+        for(jj = 0; ids[jj] != NULL; ++jj) {
+            if(xmlStrEqual(value, ids[jj])) {
+                res = 1;
+                break;
+            }
+        }
+        xmlFree(value);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecC14NStreamExtractNode:
+ * @filename:           the XML file name.
+ * @name:               the node name.
+ * @ns:                 the node namespace href.
+ *
+ * Finds the first node with @name and @ns in the file @filename and
+ * copies it into a new document. All the namespaces in scope of the
+ * original node are declared on the copy so that c14n of the copy
+ * subtree produces the same result as for the original one.
+ *
+ * Returns: the pointer to the new document or NULL if an error occurs
+ * or the node is not found.
+ */
+xmlDocPtr
+xmlSecC14NStreamExtractNode(const char* filename, const xmlChar* name, const xmlChar* ns) {
+    xmlTextReaderPtr reader;
+    xmlDocPtr res = NULL;
+    xmlNodePtr node;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+
+    reader = xmlReaderForFile(filename, NULL, XMLSEC_C14N_STREAM_PARSE_OPTIONS);
+    if(reader == NULL) {
+        xmlSecXmlError2("xmlReaderForFile", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        return(NULL);
+    }
+
+    while((ret = xmlTextReaderRead(reader)) == 1) {
+        if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            continue;
+        }
+        node = xmlTextReaderCurrentNode(reader);
+        if((node == NULL) || (!xmlSecCheckNodeName(node, name, ns))) {
+            continue;
+        }
+
+        res = xmlNewDoc(BAD_CAST "1.0");
+        if(res == NULL) {
+            xmlSecXmlError("xmlNewDoc", NULL);
+            xmlFreeTextReader(reader);
+            return(NULL);
+        }
+        if(xmlSecC14NStreamCopyNode(reader, res, NULL) == NULL) {
+            xmlSecInternalError2("xmlSecC14NStreamCopyNode", NULL,
+                                 "filename=%s", xmlSecErrorsSafeString(filename));
+            xmlFreeDoc(res);
+            xmlFreeTextReader(reader);
+            return(NULL);
+        }
+        break;
+    }
+    if(ret < 0) {
+        xmlSecXmlError2("xmlTextReaderRead", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        if(res != NULL) {
+            xmlFreeDoc(res);
+        }
+        xmlFreeTextReader(reader);
+        return(NULL);
+    }
+    xmlFreeTextReader(reader);
+
+    if(res == NULL) {
+        xmlSecOtherError3(XMLSEC_ERRORS_R_NODE_NOT_FOUND, NULL,
+                          "node=%s; filename=%s",
+                          xmlSecErrorsSafeString(name),
+                          xmlSecErrorsSafeString(filename));
+        return(NULL);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecC14NStreamExtractNodes:
+ * @filename:           the XML file name.
+ * @name:               the node name.
+ * @ns:                 the node namespace href.
+ * @idAttrs:            the NULL terminated list of ID attributes names.
+ * @ids:                the NULL terminated list of ID values.
+ *
+ * Reads the file @filename and copies into a new document only the first
+ * node with @name and @ns and the nodes with one of the @idAttrs attributes
+ * value in @ids (the nodes inside copied subtrees are not checked). The
+ * other subtrees are skipped by the reader and never kept in memory.
+ * The copies are added in the document order to the "PartialDocument"
+ * root node without namespace, the namespaces in scope of the original
+ * nodes are declared on the copies and the @idAttrs attributes are
+ * registered as IDs.
+ *
+ * Returns: the pointer to the new document or NULL if an error occurs
+ * or the node with @name and @ns is not found.
+ */
+xmlDocPtr
+xmlSecC14NStreamExtractNodes(const char* filename, const xmlChar* name, const xmlChar* ns,
+                             const xmlChar** idAttrs, const xmlChar** ids) {
+    xmlTextReaderPtr reader;
+    xmlDocPtr res;
+    xmlNodePtr root;
+    xmlNodePtr node;
+    xmlNodePtr copy;
+    xmlSecSize idsSize, found = 0;
+    int nodeFound = 0;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(idAttrs != NULL, NULL);
+    xmlSecAssert2(ids != NULL, NULL);
+
+    for(idsSize = 0; ids[idsSize] != NULL; ++idsSize) {
+    }
+
+    res = xmlNewDoc(BAD_CAST "1.0");
+    if(res == NULL) {
+        xmlSecXmlError("xmlNewDoc", NULL);
+        return(NULL);
+    }
+    root = xmlNewDocNode(res, NULL, BAD_CAST "PartialDocument", NULL);
+    if(root == NULL) {
+        xmlSecXmlError("xmlNewDocNode", NULL);
+        xmlFreeDoc(res);
+        return(NULL);
+    }
+    xmlDocSetRootElement(res, root);
+
+    reader = xmlReaderForFile(filename, NULL, XMLSEC_C14N_STREAM_PARSE_OPTIONS);
+    if(reader == NULL) {
+        xmlSecXmlError2("xmlReaderForFile", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlFreeDoc(res);
+        return(NULL);
+    }
+
+    ret = xmlTextReaderRead(reader);
+    while((ret == 1) && ((nodeFound == 0) || (found < idsSize))) {
+        if(xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+            ret = xmlTextReaderRead(reader);
+            continue;
+        }
+        node = xmlTextReaderCurrentNode(reader);
+        if(node == NULL) {
+            xmlSecXmlError("xmlTextReaderCurrentNode", NULL);
+            ret = -1;
+            break;
+        }
+        if(xmlSecC14NStreamCheckNodeId(node, idAttrs, ids) == 1) {
+            ++found;
+        } else if((nodeFound != 0) || (!xmlSecCheckNodeName(node, name, ns))) {
+            ret = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        copy = xmlSecC14NStreamCopyNode(reader, res, root);
+        if(copy == NULL) {
+            xmlSecInternalError2("xmlSecC14NStreamCopyNode", NULL,
+                                 "filename=%s", xmlSecErrorsSafeString(filename));
+            xmlFreeTextReader(reader);
+            xmlFreeDoc(res);
+            return(NULL);
+        }
+        xmlSecAddIDs(res, copy, idAttrs);
+        if((nodeFound == 0) && (xmlSecFindNode(copy, name, ns) != NULL)) {
+            nodeFound = 1;
+        }
+
+        /* skip the subtree */
+        ret = xmlTextReaderNext(reader);
+    }
+    if(ret < 0) {
+        xmlSecXmlError2("xmlTextReaderRead", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlFreeTextReader(reader);
+        xmlFreeDoc(res);
+        return(NULL);
+    }
+    xmlFreeTextReader(reader);
+
+    if(nodeFound == 0) {
+        xmlSecOtherError3(XMLSEC_ERRORS_R_NODE_NOT_FOUND, NULL,
+                          "node=%s; filename=%s",
+                          xmlSecErrorsSafeString(name),
+                          xmlSecErrorsSafeString(filename));
+        xmlFreeDoc(res);
+        return(NULL);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecC14NStreamProcess:
+ * @filename:           the XML file name.
+ * @mode:               the output mode.
+ * @inclusiveNsList:    the NULL terminated list of inclusive namespaces
+ *                      prefixes for exclusive c14n or NULL.
+ * @name:               the name of the node to skip or replace.
+ * @ns:                 the namespace href of the node to skip or replace.
+ * @replacement:        the node to write instead of the first node with
+ *                      @name and @ns in #xmlSecC14NStreamModeCopy mode or NULL.
+ * @writeCallback:      the output callback.
+ * @writeContext:       the output callback context.
+ *
+ * Reads the file @filename node by node and writes the exclusive c14n,
+ * the canonical XML 2.0 or the copy of the document into @writeCallback. The first node with
+ * @name and @ns is excluded from the output (as the enveloped signature
+ * transform does) or replaced with @replacement.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecC14NStreamProcess(const char* filename, xmlSecC14NStreamMode mode, xmlChar** inclusiveNsList,
+                        const xmlChar* name, const xmlChar* ns, xmlNodePtr replacement,
+                        xmlSecC14NStreamWriteCallback writeCallback, void* writeContext) {
+    xmlSecC14NStreamCtx ctx;
+    xmlTextReaderPtr reader;
+    xmlNodePtr node;
+    int nodeType, depth;
+    int found = 0;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(writeCallback != NULL, -1);
+
+    ret = xmlSecC14NStreamCtxInitialize(&ctx, mode, inclusiveNsList, writeCallback, writeContext);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NStreamCtxInitialize", NULL);
+        return(-1);
+    }
+
+    reader = xmlReaderForFile(filename, NULL, XMLSEC_C14N_STREAM_PARSE_OPTIONS);
+    if(reader == NULL) {
+        xmlSecXmlError2("xmlReaderForFile", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlSecC14NStreamCtxFinalize(&ctx);
+        return(-1);
+    }
+
+    if(mode == xmlSecC14NStreamModeCopy) {
+        ret = xmlSecC14NStreamCtxWrite(&ctx, BAD_CAST "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NStreamCtxWrite", NULL);
+            goto done;
+        }
+    }
+
+    ret = xmlTextReaderRead(reader);
+    while(ret == 1) {
+        nodeType = xmlTextReaderNodeType(reader);
+        depth = xmlTextReaderDepth(reader);
+        node = xmlTextReaderCurrentNode(reader);
+        if((node == NULL) || (depth < 0)) {
+            xmlSecXmlError("xmlTextReaderCurrentNode", NULL);
+            ret = -1;
+            goto done;
+        }
+
+        switch(nodeType) {
+        case XML_READER_TYPE_ELEMENT:
+            if((found == 0) && (xmlSecCheckNodeName(node, name, ns))) {
+                found = 1;
+                if((mode == xmlSecC14NStreamModeCopy) && (replacement != NULL)) {
+                    ret = xmlSecC14NStreamCtxWriteNode(&ctx, replacement);
+                    if(ret < 0) {
+                        xmlSecInternalError("xmlSecC14NStreamCtxWriteNode", NULL);
+                        goto done;
+                    }
+                }
+                if(depth == 0) {
+                    ctx.rootSeen = 1;
+                }
+
+                /* skip the subtree */
+                ret = xmlTextReaderNext(reader);
+                continue;
+            }
+
+            ret = xmlSecC14NStreamCtxStartElement(&ctx, node, depth);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NStreamCtxStartElement", NULL);
+                goto done;
+            }
+            if(xmlTextReaderIsEmptyElement(reader) == 1) {
+                ret = xmlSecC14NStreamCtxEndElement(&ctx, node, depth);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecC14NStreamCtxEndElement", NULL);
+                    goto done;
+                }
+            }
+            break;
+        case XML_READER_TYPE_END_ELEMENT:
+            ret = xmlSecC14NStreamCtxEndElement(&ctx, node, depth);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NStreamCtxEndElement", NULL);
+                goto done;
+            }
+            break;
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_CDATA:
+        case XML_READER_TYPE_WHITESPACE:
+        case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+            /* the text outside of the document element is not part of c14n */
+            if(depth > 0) {
+                const xmlChar* value = xmlTextReaderConstValue(reader);
+                xmlSecSize size;
+
+                if(value == NULL) {
+                    break;
+                }
+                size = XMLSEC_SIZE_BAD_CAST(xmlStrlen(value));
+                if(mode == xmlSecC14NStreamModeC14N2TrimTextNodes) {
+                    value = xmlSecC14NNativeTrimText(node->parent, value, &size);
+                }
+                ret = xmlSecC14NStreamCtxWriteEscaped(&ctx, value, size, 0);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecC14NStreamCtxWriteEscaped", NULL);
+                    goto done;
+                }
+            }
+            break;
+        case XML_READER_TYPE_COMMENT:
+        case XML_READER_TYPE_PROCESSING_INSTRUCTION:
+            ret = xmlSecC14NStreamCtxMisc(&ctx, nodeType,
+                    xmlTextReaderConstName(reader), xmlTextReaderConstValue(reader),
+                    depth);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecC14NStreamCtxMisc", NULL);
+                goto done;
+            }
+            break;
+        case XML_READER_TYPE_DOCUMENT_TYPE:
+            /* not a part of c14n */
+            break;
+        default:
+            xmlSecInvalidIntegerTypeError("nodeType", nodeType,
+                    "element, text, comment or processing instruction", NULL);
+            ret = -1;
+            goto done;
+        }
+
+        ret = xmlTextReaderRead(reader);
+    }
+    if(ret < 0) {
+        xmlSecXmlError2("xmlTextReaderRead", NULL,
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        goto done;
+    }
+
+    ret = xmlSecC14NStreamCtxFlush(&ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecC14NStreamCtxFlush", NULL);
+        goto done;
+    }
+
+    /* success */
+    ret = 0;
+
+done:
+    xmlFreeTextReader(reader);
+    xmlSecC14NStreamCtxFinalize(&ctx);
+    return((ret < 0) ? -1 : 0);
+}
+
+static int
+xmlSecC14NStreamCtxInitialize(xmlSecC14NStreamCtxPtr ctx, xmlSecC14NStreamMode mode,
+                              xmlChar** inclusiveNsList,
+                              xmlSecC14NStreamWriteCallback writeCallback, void* writeContext) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(writeCallback != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecC14NStreamCtx));
+    ret = xmlSecBufferInitialize(&(ctx->buffer), XMLSEC_C14N_STREAM_CHUNK_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
+    ctx->mode = mode;
+    ctx->inclusiveNsList = inclusiveNsList;
+    ctx->writeCallback = writeCallback;
+    ctx->writeContext = writeContext;
+    return(0);
+}
+
+static void
+xmlSecC14NStreamCtxFinalize(xmlSecC14NStreamCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->rendered != NULL) {
+        xmlFree(ctx->rendered);
+    }
+    if(ctx->candidates != NULL) {
+        xmlFree(ctx->candidates);
+    }
+    if(ctx->attrs != NULL) {
+        xmlFree(ctx->attrs);
+    }
+    xmlSecBufferFinalize(&(ctx->buffer));
+    memset(ctx, 0, sizeof(xmlSecC14NStreamCtx));
+}
+
+static int
+xmlSecC14NStreamCtxFlush(xmlSecC14NStreamCtxPtr ctx) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->writeCallback != NULL, -1);
+
+    if(xmlSecBufferGetSize(&(ctx->buffer)) == 0) {
+        return(0);
+    }
+    ret = ctx->writeCallback(ctx->writeContext,
+                xmlSecBufferGetData(&(ctx->buffer)),
+                xmlSecBufferGetSize(&(ctx->buffer)));
+    if(ret < 0) {
+        xmlSecInternalError("writeCallback", NULL);
+        return(-1);
+    }
+    xmlSecBufferEmpty(&(ctx->buffer));
+    return(0);
+}
+
+static int
+xmlSecC14NStreamCtxWriteData(xmlSecC14NStreamCtxPtr ctx, const xmlSecByte* data, xmlSecSize size) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(size == 0) {
+        return(0);
+    }
+    xmlSecAssert2(data != NULL, -1);
+
+    ret = xmlSecBufferAppend(&(ctx->buffer), data, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferAppend", NULL, "size=" XMLSEC_SIZE_FMT, size);
+        return(-1);
+    }
+    if(xmlSecBufferGetSize(&(ctx->buffer)) >= XMLSEC_C14N_STREAM_CHUNK_SIZE) {
+        ret = xmlSecC14NStreamCtxFlush(ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecC14NStreamCtxFlush", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NStreamCtxWrite(xmlSecC14NStreamCtxPtr ctx, const xmlChar* str) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(str == NULL) {
+        return(0);
+    }
+    return(xmlSecC14NStreamCtxWriteData(ctx, str, XMLSEC_SIZE_BAD_CAST(xmlStrlen(str))));
+}
+
+/* the escaping rules are from the c14n spec, section 2.3 */
+static int
+xmlSecC14NStreamCtxWriteEscaped(xmlSecC14NStreamCtxPtr ctx, const xmlChar* str, xmlSecSize size,
+                                int isAttr) {
+    const xmlChar* start;
+    const xmlChar* cur;
+    const char* replace;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(str == NULL) {
+        return(0);
+    }
+    for(start = cur = str; cur < str + size; ++cur) {
+        switch(*cur) {
+        case '&':
+            replace = "&amp;";
+            break;
+        case '<':
+            replace = "&lt;";
+            break;
+        case '>':
+            replace = (isAttr != 0) ? NULL : "&gt;";
+            break;
+        case '"':
+            replace = (isAttr != 0) ? "&quot;" : NULL;
+            break;
+        case '\t':
+            replace = (isAttr != 0) ? "&#x9;" : NULL;
+            break;
+        case '\n':
+            replace = (isAttr != 0) ? "&#xA;" : NULL;
+            break;
+        case '\r':
+            replace = "&#xD;";
+            break;
+        default:
+            replace = NULL;
+            break;
+        }
+        if(replace == NULL) {
+            continue;
+        }
+
+        ret = xmlSecC14NStreamCtxWriteData(ctx, start, XMLSEC_SIZE_BAD_CAST(cur - start));
+        if(ret < 0) {
+            return(-1);
+        }
+        ret = xmlSecC14NStreamCtxWrite(ctx, BAD_CAST replace);
+        if(ret < 0) {
+            return(-1);
+        }
+        start = cur + 1;
+    }
+    return(xmlSecC14NStreamCtxWriteData(ctx, start, XMLSEC_SIZE_BAD_CAST(cur - start)));
+}
+
+static int
+xmlSecC14NStreamCtxWriteQName(xmlSecC14NStreamCtxPtr ctx, xmlNsPtr ns, const xmlChar* name) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    if((ns != NULL) && (ns->prefix != NULL)) {
+        if((xmlSecC14NStreamCtxWrite(ctx, ns->prefix) < 0) ||
+           (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST ":") < 0)) {
+            return(-1);
+        }
+    }
+    return(xmlSecC14NStreamCtxWrite(ctx, name));
+}
+
+static int
+xmlSecC14NStreamCtxWriteNs(xmlSecC14NStreamCtxPtr ctx, const xmlChar* prefix, const xmlChar* href) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST " xmlns") < 0) {
+        return(-1);
+    }
+    if(prefix != NULL) {
+        if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST ":") < 0) ||
+           (xmlSecC14NStreamCtxWrite(ctx, prefix) < 0)) {
+            return(-1);
+        }
+    }
+    if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "=\"") < 0) ||
+       (xmlSecC14NStreamCtxWriteEscaped(ctx, href, XMLSEC_SIZE_BAD_CAST(xmlStrlen(href)), 1) < 0) ||
+       (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "\"") < 0)) {
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecC14NStreamCtxWriteAttr(xmlSecC14NStreamCtxPtr ctx, xmlAttrPtr attr) {
+    xmlChar* value;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(attr != NULL, -1);
+
+    value = xmlNodeGetContent((xmlNodePtr)attr);
+    if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST " ") < 0) ||
+       (xmlSecC14NStreamCtxWriteQName(ctx, attr->ns, attr->name) < 0) ||
+       (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "=\"") < 0) ||
+       (xmlSecC14NStreamCtxWriteEscaped(ctx, value, XMLSEC_SIZE_BAD_CAST(xmlStrlen(value)), 1) < 0) ||
+       (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "\"") < 0)) {
+        ret = -1;
+    } else {
+        ret = 0;
+    }
+    if(value != NULL) {
+        xmlFree(value);
+    }
+    return(ret);
+}
+
+static int
+xmlSecC14NStreamCtxWriteNode(xmlSecC14NStreamCtxPtr ctx, xmlNodePtr node) {
+    xmlBufferPtr buffer;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    buffer = xmlBufferCreate();
+    if(buffer == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(-1);
+    }
+    ret = xmlNodeDump(buffer, node->doc, node, 0, 0);
+    if(ret < 0) {
+        xmlSecXmlError("xmlNodeDump", NULL);
+        xmlBufferFree(buffer);
+        return(-1);
+    }
+    ret = xmlSecC14NStreamCtxWriteData(ctx, xmlBufferContent(buffer), XMLSEC_SIZE_BAD_CAST(xmlBufferLength(buffer)));
+    xmlBufferFree(buffer);
+    return(ret);
+}
+
+static int
+xmlSecC14NStreamCtxAddNs(xmlSecC14NStreamNs** items, xmlSecSize* itemsSize, xmlSecSize* itemsMaxSize,
+                         const xmlChar* prefix, const xmlChar* href, int depth) {
+    xmlSecC14NStreamNs* newItems;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(items != NULL, -1);
+    xmlSecAssert2(itemsSize != NULL, -1);
+    xmlSecAssert2(itemsMaxSize != NULL, -1);
+
+    if((*itemsSize) >= (*itemsMaxSize)) {
+        newSize = ((*itemsMaxSize) > 0) ? 2 * (*itemsMaxSize) : 16;
+        newItems = (xmlSecC14NStreamNs*)xmlRealloc((*items), newSize * sizeof(xmlSecC14NStreamNs));
+        if(newItems == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecC14NStreamNs), NULL);
+            return(-1);
+        }
+        (*items) = newItems;
+        (*itemsMaxSize) = newSize;
+    }
+    (*items)[(*itemsSize)].prefix = prefix;
+    (*items)[(*itemsSize)].href   = href;
+    (*items)[(*itemsSize)].depth  = depth;
+    ++(*itemsSize);
+    return(0);
+}
+
+/* adds the namespace with @prefix to the the list of namespaces to render
+ * for @node unless an output ancestor has already rendered the same one */
+static int
+xmlSecC14NStreamCtxAddCandidate(xmlSecC14NStreamCtxPtr ctx, xmlNodePtr node, const xmlChar* prefix) {
+    const xmlChar* href;
+    const xmlChar* renderedHref;
+    xmlNsPtr ns;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(xmlStrEqual(prefix, BAD_CAST "xml")) {
+        return(0);
+    }
+    for(ii = 0; ii < ctx->candidatesSize; ++ii) {
+        if(xmlStrEqual(ctx->candidates[ii].prefix, prefix)) {
+            return(0);
+        }
+    }
+
+    ns = xmlSearchNs(node->doc, node, prefix);
+    if((ns == NULL) && (prefix != NULL)) {
+        /* not in scope */
+        return(0);
+    }
+    href = ((ns != NULL) && (ns->href != NULL)) ? ns->href : BAD_CAST "";
+
+    renderedHref = BAD_CAST "";
+    for(ii = ctx->renderedSize; ii > 0; --ii) {
+        if(xmlStrEqual(ctx->rendered[ii - 1].prefix, prefix)) {
+            renderedHref = ctx->rendered[ii - 1].href;
+            break;
+        }
+    }
+    if(xmlStrEqual(renderedHref, href)) {
+        return(0);
+    }
+
+    return(xmlSecC14NStreamCtxAddNs(&(ctx->candidates), &(ctx->candidatesSize), &(ctx->candidatesMaxSize),
+                                    prefix, href, 0));
+}
+
+static int
+xmlSecC14NStreamCtxStartElement(xmlSecC14NStreamCtxPtr ctx, xmlNodePtr node, int depth) {
+    xmlSecC14NStreamNs tmpNs;
+    xmlAttrPtr tmpAttr;
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+    xmlSecSize attrsSize = 0;
+    xmlSecSize ii, jj;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(depth == 0) {
+        ctx->rootSeen = 1;
+    }
+    if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "<") < 0) ||
+       (xmlSecC14NStreamCtxWriteQName(ctx, node->ns, node->name) < 0)) {
+        return(-1);
+    }
+
+    if(ctx->mode == xmlSecC14NStreamModeCopy) {
+        for(ns = node->nsDef; ns != NULL; ns = ns->next) {
+            ret = xmlSecC14NStreamCtxWriteNs(ctx, ns->prefix, ns->href);
+            if(ret < 0) {
+                return(-1);
+            }
+        }
+        for(attr = node->properties; attr != NULL; attr = attr->next) {
+            ret = xmlSecC14NStreamCtxWriteAttr(ctx, attr);
+            if(ret < 0) {
+                return(-1);
+            }
+        }
+        return(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST ">"));
+    }
+
+    /* exclusive c14n: the visibly utilized namespaces and the inclusive ones */
+    ctx->candidatesSize = 0;
+    ret = xmlSecC14NStreamCtxAddCandidate(ctx, node, (node->ns != NULL) ? node->ns->prefix : NULL);
+    if(ret < 0) {
+        return(-1);
+    }
+    for(attr = node->properties; attr != NULL; attr = attr->next) {
+        if((attr->ns != NULL) && (attr->ns->prefix != NULL)) {
+            ret = xmlSecC14NStreamCtxAddCandidate(ctx, node, attr->ns->prefix);
+            if(ret < 0) {
+                return(-1);
+            }
+        }
+        ++attrsSize;
+    }
+    if(ctx->inclusiveNsList != NULL) {
+        for(ii = 0; ctx->inclusiveNsList[ii] != NULL; ++ii) {
+            if(xmlStrEqual(ctx->inclusiveNsList[ii], BAD_CAST "#default")) {
+                ret = xmlSecC14NStreamCtxAddCandidate(ctx, node, NULL);
+            } else {
+                ret = xmlSecC14NStreamCtxAddCandidate(ctx, node, ctx->inclusiveNsList[ii]);
+            }
+            if(ret < 0) {
+                return(-1);
+            }
+        }
+    }
+
+    /* namespaces are sorted by prefix, the default namespace goes first */
+    for(ii = 1; ii < ctx->candidatesSize; ++ii) {
+        for(jj = ii; jj > 0; --jj) {
+            if((ctx->candidates[jj].prefix != NULL) &&
+               ((ctx->candidates[jj - 1].prefix == NULL) ||
+                (xmlStrcmp(ctx->candidates[jj - 1].prefix, ctx->candidates[jj].prefix) <= 0))) {
+                break;
+            }
+            tmpNs = ctx->candidates[jj];
+            ctx->candidates[jj] = ctx->candidates[jj - 1];
+            ctx->candidates[jj - 1] = tmpNs;
+        }
+    }
+    for(ii = 0; ii < ctx->candidatesSize; ++ii) {
+        ret = xmlSecC14NStreamCtxWriteNs(ctx, ctx->candidates[ii].prefix, ctx->candidates[ii].href);
+        if(ret < 0) {
+            return(-1);
+        }
+        ret = xmlSecC14NStreamCtxAddNs(&(ctx->rendered), &(ctx->renderedSize), &(ctx->renderedMaxSize),
+                ctx->candidates[ii].prefix, ctx->candidates[ii].href, depth);
+        if(ret < 0) {
+            return(-1);
+        }
+    }
+
+    /* attributes are sorted by namespace href and then by local name */
+    if(attrsSize > ctx->attrsMaxSize) {
+        xmlAttrPtr* newAttrs;
+
+        newAttrs = (xmlAttrPtr*)xmlRealloc(ctx->attrs, attrsSize * sizeof(xmlAttrPtr));
+        if(newAttrs == NULL) {
+            xmlSecMallocError(attrsSize * sizeof(xmlAttrPtr), NULL);
+            return(-1);
+        }
+        ctx->attrs = newAttrs;
+        ctx->attrsMaxSize = attrsSize;
+    }
+    for(attr = node->properties, ii = 0; attr != NULL; attr = attr->next, ++ii) {
+        ctx->attrs[ii] = attr;
+        for(jj = ii; jj > 0; --jj) {
+            const xmlChar* href1 = (ctx->attrs[jj - 1]->ns != NULL) ? ctx->attrs[jj - 1]->ns->href : NULL;
+            const xmlChar* href2 = (ctx->attrs[jj]->ns != NULL) ? ctx->attrs[jj]->ns->href : NULL;
+
+            ret = xmlStrcmp(href1, href2);
+            if((ret < 0) || ((ret == 0) && (xmlStrcmp(ctx->attrs[jj - 1]->name, ctx->attrs[jj]->name) <= 0))) {
+                break;
+            }
+            tmpAttr = ctx->attrs[jj];
+            ctx->attrs[jj] = ctx->attrs[jj - 1];
+            ctx->attrs[jj - 1] = tmpAttr;
+        }
+    }
+    for(ii = 0; ii < attrsSize; ++ii) {
+        ret = xmlSecC14NStreamCtxWriteAttr(ctx, ctx->attrs[ii]);
+        if(ret < 0) {
+            return(-1);
+        }
+    }
+
+    return(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST ">"));
+}
+
+static int
+xmlSecC14NStreamCtxEndElement(xmlSecC14NStreamCtxPtr ctx, xmlNodePtr node, int depth) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* the namespaces rendered by this element are out of scope now */
+    while((ctx->renderedSize > 0) && (ctx->rendered[ctx->renderedSize - 1].depth >= depth)) {
+        --ctx->renderedSize;
+    }
+
+    if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "</") < 0) ||
+       (xmlSecC14NStreamCtxWriteQName(ctx, node->ns, node->name) < 0) ||
+       (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST ">") < 0)) {
+        return(-1);
+    }
+    return(0);
+}
+
+/* comments and processing instructions */
+static int
+xmlSecC14NStreamCtxMisc(xmlSecC14NStreamCtxPtr ctx, int nodeType, const xmlChar* name,
+                        const xmlChar* value, int depth) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if((nodeType == XML_READER_TYPE_COMMENT) && (ctx->mode != xmlSecC14NStreamModeCopy)) {
+        return(0);
+    }
+
+    /* the nodes outside of the document element are separated with new lines */
+    if((depth == 0) && (ctx->rootSeen != 0)) {
+        if(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "\n") < 0) {
+            return(-1);
+        }
+    }
+    if(nodeType == XML_READER_TYPE_COMMENT) {
+        if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "<!--") < 0) ||
+           (xmlSecC14NStreamCtxWrite(ctx, value) < 0) ||
+           (xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "-->") < 0)) {
+            return(-1);
+        }
+    } else {
+        if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "<?") < 0) ||
+           (xmlSecC14NStreamCtxWrite(ctx, name) < 0)) {
+            return(-1);
+        }
+        if((value != NULL) && (value[0] != '\0')) {
+            if((xmlSecC14NStreamCtxWrite(ctx, BAD_CAST " ") < 0) ||
+               (xmlSecC14NStreamCtxWrite(ctx, value) < 0)) {
+                return(-1);
+            }
+        }
+        if(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "?>") < 0) {
+            return(-1);
+        }
+    }
+    if((depth == 0) && (ctx->rootSeen == 0)) {
+        if(xmlSecC14NStreamCtxWrite(ctx, BAD_CAST "\n") < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
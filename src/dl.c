@@ -530,62 +530,102 @@ int
 xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(struct _xmlSecCryptoDLFunctions* functions) {
     xmlSecAssert2(functions != NULL, -1);
 
+    return(xmlSecCryptoDLFunctionsAddKeyDataAndTransforms(functions,
+                xmlSecKeyDataIdsGet(), xmlSecTransformIdsGet()));
+}
+
+/**
+ * xmlSecCryptoDLFunctionsAddKeyDataAndTransforms:
+ * @functions:          the functions table.
+ * @keyDataIds:         the key data klasses list.
+ * @transformIds:       the transform klasses list.
+ *
+ * Adds the key data and transforms klasses from @functions table to
+ * @keyDataIds and @transformIds lists. Unlike
+ * #xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms, this function
+ * does not touch the global lists: with several crypto libraries loaded
+ * at once (see #xmlSecCryptoDLGetLibraryFunctions), an application can
+ * pick one of them for a single signature or encryption context by
+ * filling the context enabled key data and transforms lists (together
+ * with #xmlSecKeyDataIdListAddDefault and #xmlSecTransformIdListAddDefault)
+ * instead of switching the global table with #xmlSecCryptoDLSetFunctions.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecCryptoDLFunctionsAddKeyDataAndTransforms(struct _xmlSecCryptoDLFunctions* functions,
+                                               xmlSecPtrListPtr keyDataIds,
+                                               xmlSecPtrListPtr transformIds) {
+    xmlSecAssert2(functions != NULL, -1);
+    xmlSecAssert2(xmlSecPtrListCheckId(keyDataIds, xmlSecKeyDataIdListId), -1);
+    xmlSecAssert2(xmlSecPtrListCheckId(transformIds, xmlSecTransformIdListId), -1);
+
     /****************************************************************************
      *
      * Register keys
      *
      ****************************************************************************/
-    if((functions->keyDataAesGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataAesGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataAesGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataAesGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataAesGetKlass()));
         return(-1);
     }
-    if((functions->keyDataDesGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataDesGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataDesGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataDesGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataDesGetKlass()));
         return(-1);
     }
-    if((functions->keyDataDsaGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataDsaGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataDsaGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataDsaGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataDsaGetKlass()));
         return(-1);
     }
-    if((functions->keyDataEcdsaGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataEcdsaGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataEcdsaGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataEcdsaGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataEcdsaGetKlass()));
         return(-1);
     }
-    if((functions->keyDataGost2001GetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataGost2001GetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataEd25519GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataEd25519GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecKeyDataKlassGetName(functions->keyDataEd25519GetKlass()));
+        return(-1);
+    }
+    if((functions->keyDataEd448GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataEd448GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecKeyDataKlassGetName(functions->keyDataEd448GetKlass()));
+        return(-1);
+    }
+    if((functions->keyDataGost2001GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataGost2001GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataGost2001GetKlass()));
         return(-1);
     }
-    if((functions->keyDataGostR3410_2012_256GetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataGostR3410_2012_256GetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataGostR3410_2012_256GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataGostR3410_2012_256GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataGostR3410_2012_256GetKlass()));
         return(-1);
     }
-    if((functions->keyDataGostR3410_2012_512GetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataGostR3410_2012_512GetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataGostR3410_2012_512GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataGostR3410_2012_512GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataGostR3410_2012_512GetKlass()));
         return(-1);
-    }    if((functions->keyDataHmacGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataHmacGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    }    if((functions->keyDataHmacGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataHmacGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataHmacGetKlass()));
         return(-1);
     }
-    if((functions->keyDataRsaGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataRsaGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataRsaGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataRsaGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataRsaGetKlass()));
         return(-1);
     }
-    if((functions->keyDataX509GetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataX509GetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataX509GetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataX509GetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataX509GetKlass()));
         return(-1);
     }
-    if((functions->keyDataRawX509CertGetKlass != NULL) && (xmlSecKeyDataIdsRegister(functions->keyDataRawX509CertGetKlass()) < 0)) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister",
+    if((functions->keyDataRawX509CertGetKlass != NULL) && (xmlSecPtrListAdd(keyDataIds, (xmlSecPtr)functions->keyDataRawX509CertGetKlass()) < 0)) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyDataKlassGetName(functions->keyDataRawX509CertGetKlass()));
         return(-1);
     }
@@ -596,265 +636,295 @@ xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(struct _xmlSecCryptoDLFuncti
      * Register transforms
      *
      ****************************************************************************/
-    if((functions->transformAes128CbcGetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformAes128CbcGetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformAes128CbcGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes128CbcGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformAes128CbcGetKlass()));
         return(-1);
     }
 
-    if((functions->transformAes192CbcGetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformAes192CbcGetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformAes192CbcGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes192CbcGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformAes192CbcGetKlass()));
         return(-1);
     }
 
-    if((functions->transformAes256CbcGetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformAes256CbcGetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformAes256CbcGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes256CbcGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformAes256CbcGetKlass()));
         return(-1);
     }
 
-    if((functions->transformKWAes128GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformKWAes128GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformAes128GcmGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes128GcmGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformKlassGetName(functions->transformAes128GcmGetKlass()));
+        return(-1);
+    }
+
+    if((functions->transformAes192GcmGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes192GcmGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformKlassGetName(functions->transformAes192GcmGetKlass()));
+        return(-1);
+    }
+
+    if((functions->transformAes256GcmGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformAes256GcmGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformKlassGetName(functions->transformAes256GcmGetKlass()));
+        return(-1);
+    }
+
+    if((functions->transformKWAes128GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformKWAes128GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformKWAes128GetKlass()));
         return(-1);
     }
 
-    if((functions->transformKWAes192GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformKWAes192GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformKWAes192GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformKWAes192GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformKWAes192GetKlass()));
         return(-1);
     }
 
-    if((functions->transformKWAes256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformKWAes256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformKWAes256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformKWAes256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformKWAes256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformDes3CbcGetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformDes3CbcGetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformDes3CbcGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformDes3CbcGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformDes3CbcGetKlass()));
         return(-1);
     }
 
-    if((functions->transformKWDes3GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformKWDes3GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformKWDes3GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformKWDes3GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformKWDes3GetKlass()));
         return(-1);
     }
 
-    if((functions->transformGost2001GostR3411_94GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGost2001GostR3411_94GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGost2001GostR3411_94GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGost2001GostR3411_94GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGost2001GostR3411_94GetKlass()));
         return(-1);
     }
 
-    if((functions->transformGostR3410_2012GostR3411_2012_256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGostR3410_2012GostR3411_2012_256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGostR3410_2012GostR3411_2012_256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGostR3410_2012GostR3411_2012_256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGostR3410_2012GostR3411_2012_256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformGostR3410_2012GostR3411_2012_512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGostR3410_2012GostR3411_2012_512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGostR3410_2012GostR3411_2012_512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGostR3410_2012GostR3411_2012_512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGostR3410_2012GostR3411_2012_512GetKlass()));
         return(-1);
     }
 
-    if((functions->transformDsaSha1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformDsaSha1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformDsaSha1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformDsaSha1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformDsaSha1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformDsaSha256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformDsaSha256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformDsaSha256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformDsaSha256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformDsaSha256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformEcdsaSha1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformEcdsaSha1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEcdsaSha1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEcdsaSha1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformEcdsaSha1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformEcdsaSha224GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformEcdsaSha224GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEcdsaSha224GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEcdsaSha224GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformEcdsaSha224GetKlass()));
         return(-1);
     }
 
-    if((functions->transformEcdsaSha256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformEcdsaSha256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEcdsaSha256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEcdsaSha256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformEcdsaSha256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformEcdsaSha384GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformEcdsaSha384GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEcdsaSha384GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEcdsaSha384GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformEcdsaSha384GetKlass()));
         return(-1);
     }
 
-    if((functions->transformEcdsaSha512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformEcdsaSha512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEcdsaSha512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEcdsaSha512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformEcdsaSha512GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacMd5GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacMd5GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformEd25519GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEd25519GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformKlassGetName(functions->transformEd25519GetKlass()));
+        return(-1);
+    }
+
+    if((functions->transformEd448GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformEd448GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecTransformKlassGetName(functions->transformEd448GetKlass()));
+        return(-1);
+    }
+
+    if((functions->transformHmacMd5GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacMd5GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacMd5GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacRipemd160GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacRipemd160GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacRipemd160GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacRipemd160GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacRipemd160GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacSha1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacSha1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacSha1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacSha1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacSha1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacSha224GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacSha224GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacSha224GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacSha224GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacSha224GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacSha256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacSha256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacSha256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacSha256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacSha256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacSha384GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacSha384GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacSha384GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacSha384GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacSha384GetKlass()));
         return(-1);
     }
 
-    if((functions->transformHmacSha512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformHmacSha512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformHmacSha512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformHmacSha512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformHmacSha512GetKlass()));
         return(-1);
     }
 
-    if((functions->transformMd5GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformMd5GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformMd5GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformMd5GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformMd5GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRipemd160GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRipemd160GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRipemd160GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRipemd160GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRipemd160GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaMd5GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaMd5GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaMd5GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaMd5GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaMd5GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaRipemd160GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaRipemd160GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaRipemd160GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaRipemd160GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaRipemd160GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaSha1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaSha1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaSha1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaSha1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaSha1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaSha224GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaSha224GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaSha224GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaSha224GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaSha224GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaSha256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaSha256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaSha256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaSha256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaSha256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaSha384GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaSha384GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaSha384GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaSha384GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaSha384GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaSha512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaSha512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaSha512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaSha512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaSha512GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaPkcs1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaPkcs1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaPkcs1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaPkcs1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaPkcs1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformRsaOaepGetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformRsaOaepGetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformRsaOaepGetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformRsaOaepGetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformRsaOaepGetKlass()));
         return(-1);
     }
 
-    if((functions->transformGostR3411_94GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGostR3411_94GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGostR3411_94GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGostR3411_94GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGostR3411_94GetKlass()));
         return(-1);
     }
 
-    if((functions->transformGostR3411_2012_256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGostR3411_2012_256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGostR3411_2012_256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGostR3411_2012_256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGostR3411_2012_256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformGostR3411_2012_512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformGostR3411_2012_512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformGostR3411_2012_512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformGostR3411_2012_512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformGostR3411_2012_512GetKlass()));
         return(-1);
     }
-    if((functions->transformSha1GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformSha1GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformSha1GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformSha1GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformSha1GetKlass()));
         return(-1);
     }
 
-    if((functions->transformSha224GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformSha224GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformSha224GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformSha224GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformSha224GetKlass()));
         return(-1);
     }
 
-    if((functions->transformSha256GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformSha256GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformSha256GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformSha256GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformSha256GetKlass()));
         return(-1);
     }
 
-    if((functions->transformSha384GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformSha384GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformSha384GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformSha384GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformSha384GetKlass()));
         return(-1);
     }
 
-    if((functions->transformSha512GetKlass != NULL) && xmlSecTransformIdsRegister(functions->transformSha512GetKlass()) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister",
+    if((functions->transformSha512GetKlass != NULL) && xmlSecPtrListAdd(transformIds, (xmlSecPtr)functions->transformSha512GetKlass()) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecTransformKlassGetName(functions->transformSha512GetKlass()));
         return(-1);
     }
@@ -0,0 +1,609 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Per-document cache of canonicalization results.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/xmldsig.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/private/doccache.h>
+
+/**************************************************************************
+ *
+ * Documents caches
+ *
+ * The signature and the references of a document are often processed
+ * more than once (signed and then verified for audit, verified again
+ * when a stored message is read, ...). A document cache keeps the
+ * results computed over the document nodes: the canonical <dsig:SignedInfo/>
+ * bytes and the <dsig:Reference/> digests. Each item remembers the node
+ * whose subtree the result is computed from (the document node for the
+ * whole document) and, optionally, a node inside it that is excluded from
+ * the result (the enveloped <dsig:Signature/> node).
+ *
+ * The xmlsec functions that modify the document report the modified
+ * node with #xmlSecDocCacheTouch: the items that might depend on it
+ * (the node is in the item subtree but not in its excluded node, or the
+ * node is an ancestor of the item subtree) are dropped and the document
+ * generation is incremented. The results computed while the document
+ * generation changed are not added to the cache.
+ *
+ * The caches are kept in a side table indexed by the document pointer:
+ * the document _private field belongs to the application. The document
+ * psvi field (unused by libxml2 for documents) points to the cache: if
+ * the application frees the document without #xmlSecDSigDocCacheDisable
+ * and a new document is allocated at the same address, the new document
+ * does not have the tag and the stale cache is dropped instead of used.
+ *
+ *****************************************************************************/
+/**
+ * XMLSEC_DOC_CACHE_MAX_ITEMS:
+ *
+ * The max number of items kept for one document.
+ */
+#define XMLSEC_DOC_CACHE_MAX_ITEMS                              256
+
+typedef struct _xmlSecDocCacheItem                      xmlSecDocCacheItem,
+                                                        *xmlSecDocCacheItemPtr;
+struct _xmlSecDocCacheItem {
+    xmlSecDocCacheItemPtr       next;
+    xmlChar*                    key;
+    xmlNodePtr                  root;
+    xmlNodePtr                  excluded;
+    xmlSecByte*                 data;
+    xmlSecSize                  dataSize;
+};
+
+typedef struct _xmlSecDocCache {
+    xmlDocPtr                   doc;
+    xmlSecSize                  generation;
+    xmlSecDocCacheItemPtr       items;
+    xmlSecSize                  itemsSize;
+} xmlSecDocCache, *xmlSecDocCachePtr;
+
+static xmlSecDocCachePtr        xmlSecDocCacheCreate                    (xmlDocPtr doc);
+static void                     xmlSecDocCacheDestroy                   (xmlSecDocCachePtr cache);
+static void                     xmlSecDocCacheHashDestroy               (void* payload,
+                                                                         const xmlChar* name);
+static void                     xmlSecDocCacheClear                     (xmlSecDocCachePtr cache);
+static xmlSecDocCachePtr        xmlSecDocCacheFind                      (xmlDocPtr doc);
+static void                     xmlSecDocCacheGetName                   (xmlDocPtr doc,
+                                                                         xmlChar* name,
+                                                                         xmlSecSize nameSize);
+static int                      xmlSecDocCacheItemDependsOn             (xmlSecDocCacheItemPtr item,
+                                                                         xmlNodePtr node);
+static void                     xmlSecDocCacheItemDestroy               (xmlSecDocCacheItemPtr item);
+
+static xmlMutexPtr              xmlSecDocCachesMutex = NULL;
+static xmlHashTablePtr          xmlSecDocCaches = NULL;
+static int                      xmlSecDocCachesCount = 0;
+
+/**
+ * xmlSecDocCachesInitialize:
+ *
+ * Initializes the documents caches table (called from #xmlSecInit).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDocCachesInitialize(void) {
+    xmlSecAssert2(xmlSecDocCachesMutex == NULL, -1);
+    xmlSecAssert2(xmlSecDocCaches == NULL, -1);
+
+    xmlSecDocCaches = xmlHashCreate(0);
+    if(xmlSecDocCaches == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+    xmlSecDocCachesMutex = xmlNewMutex();
+    if(xmlSecDocCachesMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlHashFree(xmlSecDocCaches, NULL);
+        xmlSecDocCaches = NULL;
+        return(-1);
+    }
+    xmlSecDocCachesCount = 0;
+    return(0);
+}
+
+/**
+ * xmlSecDocCachesFinalize:
+ *
+ * Frees all the documents caches (called from #xmlSecShutdown).
+ */
+void
+xmlSecDocCachesFinalize(void) {
+    if(xmlSecDocCaches != NULL) {
+        xmlHashFree(xmlSecDocCaches, xmlSecDocCacheHashDestroy);
+        xmlSecDocCaches = NULL;
+    }
+    if(xmlSecDocCachesMutex != NULL) {
+        xmlFreeMutex(xmlSecDocCachesMutex);
+        xmlSecDocCachesMutex = NULL;
+    }
+    xmlSecDocCachesCount = 0;
+}
+
+/**
+ * xmlSecDSigDocCacheEnable:
+ * @doc:                the pointer to the document.
+ *
+ * Enables the cache of the canonical <dsig:SignedInfo/> bytes and of
+ * the <dsig:Reference/> digests computed when the signatures in @doc
+ * are signed or verified: the next verifications of the same signatures
+ * reuse them if the nodes they are computed from were not modified since.
+ * Only the same document references (the whole document or an element
+ * referenced by its ID) with c14n, base64 and enveloped signature
+ * transforms are cached.
+ *
+ * The document modifications done by xmlsec functions update the cache.
+ * The application must call #xmlSecDSigDocCacheInvalidate after modifying
+ * the document directly and must call #xmlSecDSigDocCacheDisable before
+ * freeing the document. The cache uses the @doc psvi field, which must
+ * not be used by the application.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDSigDocCacheEnable(xmlDocPtr doc) {
+    xmlSecDocCachePtr cache;
+    xmlChar name[64];
+    int ret;
+
+    xmlSecAssert2(doc != NULL, -1);
+
+    if(xmlSecDocCachesMutex == NULL) {
+        xmlSecInternalError("xmlSecDocCachesInitialize", NULL);
+        return(-1);
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    if(xmlSecDocCacheFind(doc) != NULL) {
+        xmlMutexUnlock(xmlSecDocCachesMutex);
+        return(0);
+    }
+    if(doc->psvi != NULL) {
+        xmlSecInvalidDataError("document psvi field is already used", NULL);
+        xmlMutexUnlock(xmlSecDocCachesMutex);
+        return(-1);
+    }
+
+    cache = xmlSecDocCacheCreate(doc);
+    if(cache == NULL) {
+        xmlSecInternalError("xmlSecDocCacheCreate", NULL);
+        xmlMutexUnlock(xmlSecDocCachesMutex);
+        return(-1);
+    }
+
+    xmlSecDocCacheGetName(doc, name, sizeof(name));
+    ret = xmlHashAddEntry(xmlSecDocCaches, name, cache);
+    if(ret != 0) {
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        xmlSecDocCacheDestroy(cache);
+        xmlMutexUnlock(xmlSecDocCachesMutex);
+        return(-1);
+    }
+    doc->psvi = cache;
+    ++xmlSecDocCachesCount;
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+
+    return(0);
+}
+
+/**
+ * xmlSecDSigDocCacheDisable:
+ * @doc:                the pointer to the document.
+ *
+ * Disables and frees the @doc cache enabled by #xmlSecDSigDocCacheEnable.
+ */
+void
+xmlSecDSigDocCacheDisable(xmlDocPtr doc) {
+    xmlChar name[64];
+
+    xmlSecAssert(doc != NULL);
+
+    if(xmlSecDocCachesMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    if(xmlSecDocCacheFind(doc) != NULL) {
+        xmlSecDocCacheGetName(doc, name, sizeof(name));
+        xmlHashRemoveEntry(xmlSecDocCaches, name, xmlSecDocCacheHashDestroy);
+        --xmlSecDocCachesCount;
+        doc->psvi = NULL;
+    }
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+}
+
+/**
+ * xmlSecDSigDocCacheInvalidate:
+ * @doc:                the pointer to the document.
+ *
+ * Drops all the results cached for @doc (the cache stays enabled). The
+ * application must call this function after modifying @doc with other
+ * than xmlsec functions.
+ */
+void
+xmlSecDSigDocCacheInvalidate(xmlDocPtr doc) {
+    xmlSecDocCachePtr cache;
+
+    xmlSecAssert(doc != NULL);
+
+    if(xmlSecDocCachesMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    cache = xmlSecDocCacheFind(doc);
+    if(cache != NULL) {
+        xmlSecDocCacheClear(cache);
+        ++cache->generation;
+    }
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+}
+
+/**
+ * xmlSecDocCacheGetGeneration:
+ * @doc:                the pointer to the document.
+ * @generation:         the pointer to the returned document generation.
+ *
+ * Gets the current generation of @doc: the results computed from now
+ * on can be added to the cache with this generation.
+ *
+ * Returns: 1 if the cache is enabled for @doc, 0 otherwise.
+ */
+int
+xmlSecDocCacheGetGeneration(xmlDocPtr doc, xmlSecSize* generation) {
+    xmlSecDocCachePtr cache;
+    int res = 0;
+
+    xmlSecAssert2(doc != NULL, 0);
+    xmlSecAssert2(generation != NULL, 0);
+
+    if((xmlSecDocCachesMutex == NULL) || (xmlSecDocCachesCount == 0)) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    cache = xmlSecDocCacheFind(doc);
+    if(cache != NULL) {
+        (*generation) = cache->generation;
+        res = 1;
+    }
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+
+    return(res);
+}
+
+/**
+ * xmlSecDocCacheLookup:
+ * @doc:                the pointer to the document.
+ * @key:                the result key.
+ * @root:               the node the result is computed from.
+ * @data:               the buffer for the returned result.
+ *
+ * Looks up the result for @key computed from @root in the @doc cache.
+ *
+ * Returns: 1 if the result is found, 0 if not or a negative value
+ * if an error occurs.
+ */
+int
+xmlSecDocCacheLookup(xmlDocPtr doc, const xmlChar* key, xmlNodePtr root, xmlSecBufferPtr data) {
+    xmlSecDocCachePtr cache;
+    xmlSecDocCacheItemPtr item;
+    xmlSecDocCacheItemPtr prev = NULL;
+    int res = 0;
+    int ret;
+
+    xmlSecAssert2(doc != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(root != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+
+    if((xmlSecDocCachesMutex == NULL) || (xmlSecDocCachesCount == 0)) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    cache = xmlSecDocCacheFind(doc);
+    if(cache != NULL) {
+        for(item = cache->items; item != NULL; prev = item, item = item->next) {
+            if(!xmlStrEqual(item->key, key)) {
+                continue;
+            }
+
+            /* the ID is now assigned to another node */
+            if(item->root != root) {
+                if(prev != NULL) {
+                    prev->next = item->next;
+                } else {
+                    cache->items = item->next;
+                }
+                --cache->itemsSize;
+                xmlSecDocCacheItemDestroy(item);
+                break;
+            }
+
+            ret = xmlSecBufferSetData(data, item->data, item->dataSize);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecBufferSetData", NULL);
+                res = -1;
+                break;
+            }
+            res = 1;
+            break;
+        }
+    }
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+
+    return(res);
+}
+
+/**
+ * xmlSecDocCacheAdd:
+ * @doc:                the pointer to the document.
+ * @key:                the result key.
+ * @root:               the node the result is computed from.
+ * @excluded:           the node in @root subtree excluded from the result or NULL.
+ * @generation:         the @doc generation when the result computation started.
+ * @data:               the result.
+ * @dataSize:           the result size.
+ *
+ * Adds the result for @key to the @doc cache (replacing the previous one)
+ * unless @doc was modified since @generation.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDocCacheAdd(xmlDocPtr doc, const xmlChar* key, xmlNodePtr root, xmlNodePtr excluded,
+                  xmlSecSize generation, const xmlSecByte* data, xmlSecSize dataSize) {
+    xmlSecDocCachePtr cache;
+    xmlSecDocCacheItemPtr item;
+    xmlSecDocCacheItemPtr prev;
+    xmlSecDocCacheItemPtr newItem;
+
+    xmlSecAssert2(doc != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(root != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize > 0, -1);
+
+    if((xmlSecDocCachesMutex == NULL) || (xmlSecDocCachesCount == 0)) {
+        return(0);
+    }
+
+    newItem = (xmlSecDocCacheItemPtr)xmlMalloc(sizeof(xmlSecDocCacheItem));
+    if(newItem == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDocCacheItem), NULL);
+        return(-1);
+    }
+    memset(newItem, 0, sizeof(xmlSecDocCacheItem));
+    newItem->root     = root;
+    newItem->excluded = excluded;
+
+    newItem->key = xmlStrdup(key);
+    if(newItem->key == NULL) {
+        xmlSecStrdupError(key, NULL);
+        xmlSecDocCacheItemDestroy(newItem);
+        return(-1);
+    }
+    newItem->data = (xmlSecByte*)xmlMalloc(dataSize);
+    if(newItem->data == NULL) {
+        xmlSecMallocError(dataSize, NULL);
+        xmlSecDocCacheItemDestroy(newItem);
+        return(-1);
+    }
+    memcpy(newItem->data, data, dataSize);
+    newItem->dataSize = dataSize;
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    cache = xmlSecDocCacheFind(doc);
+    if((cache == NULL) || (cache->generation != generation)) {
+        xmlMutexUnlock(xmlSecDocCachesMutex);
+        xmlSecDocCacheItemDestroy(newItem);
+        return(0);
+    }
+
+    /* drop the previous result and the oldest item if the cache is full */
+    for(prev = NULL, item = cache->items; item != NULL; prev = item, item = item->next) {
+        if((xmlStrEqual(item->key, key)) ||
+           ((item->next == NULL) && (cache->itemsSize >= XMLSEC_DOC_CACHE_MAX_ITEMS))) {
+            if(prev != NULL) {
+                prev->next = item->next;
+            } else {
+                cache->items = item->next;
+            }
+            --cache->itemsSize;
+            xmlSecDocCacheItemDestroy(item);
+            break;
+        }
+    }
+
+    newItem->next = cache->items;
+    cache->items = newItem;
+    ++cache->itemsSize;
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+
+    return(0);
+}
+
+/**
+ * xmlSecDocCacheTouch:
+ * @node:               the pointer to the modified node.
+ *
+ * Drops the results that might depend on @node from its document cache:
+ * called by xmlsec functions before @node is removed from the document,
+ * after it is added to the document or after its content or attributes
+ * are changed.
+ */
+void
+xmlSecDocCacheTouch(xmlNodePtr node) {
+    xmlSecDocCachePtr cache;
+    xmlSecDocCacheItemPtr item;
+    xmlSecDocCacheItemPtr prev;
+    xmlSecDocCacheItemPtr next;
+
+    /* the caches are rarely enabled, don't lock for nothing */
+    if((node == NULL) || (node->doc == NULL) ||
+       (xmlSecDocCachesMutex == NULL) || (xmlSecDocCachesCount == 0)) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecDocCachesMutex);
+    cache = xmlSecDocCacheFind(node->doc);
+    if(cache != NULL) {
+        ++cache->generation;
+        for(prev = NULL, item = cache->items; item != NULL; item = next) {
+            next = item->next;
+            if(xmlSecDocCacheItemDependsOn(item, node) != 0) {
+                if(prev != NULL) {
+                    prev->next = next;
+                } else {
+                    cache->items = next;
+                }
+                --cache->itemsSize;
+                xmlSecDocCacheItemDestroy(item);
+            } else {
+                prev = item;
+            }
+        }
+    }
+    xmlMutexUnlock(xmlSecDocCachesMutex);
+}
+
+static xmlSecDocCachePtr
+xmlSecDocCacheCreate(xmlDocPtr doc) {
+    xmlSecDocCachePtr cache;
+
+    xmlSecAssert2(doc != NULL, NULL);
+
+    cache = (xmlSecDocCachePtr)xmlMalloc(sizeof(xmlSecDocCache));
+    if(cache == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDocCache), NULL);
+        return(NULL);
+    }
+    memset(cache, 0, sizeof(xmlSecDocCache));
+    cache->doc = doc;
+    return(cache);
+}
+
+static void
+xmlSecDocCacheDestroy(xmlSecDocCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    xmlSecDocCacheClear(cache);
+    xmlFree(cache);
+}
+
+static void
+xmlSecDocCacheHashDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlSecDocCacheDestroy((xmlSecDocCachePtr)payload);
+    }
+}
+
+static void
+xmlSecDocCacheClear(xmlSecDocCachePtr cache) {
+    xmlSecDocCacheItemPtr item;
+
+    xmlSecAssert(cache != NULL);
+
+    while(cache->items != NULL) {
+        item = cache->items;
+        cache->items = item->next;
+        xmlSecDocCacheItemDestroy(item);
+    }
+    cache->itemsSize = 0;
+}
+
+/*
+ * Returns the @doc cache. The cache left over from a freed document
+ * allocated at the same address is dropped (the caller holds
+ * xmlSecDocCachesMutex).
+ */
+static xmlSecDocCachePtr
+xmlSecDocCacheFind(xmlDocPtr doc) {
+    xmlSecDocCachePtr cache;
+    xmlChar name[64];
+
+    xmlSecAssert2(doc != NULL, NULL);
+    xmlSecAssert2(xmlSecDocCaches != NULL, NULL);
+
+    xmlSecDocCacheGetName(doc, name, sizeof(name));
+    cache = (xmlSecDocCachePtr)xmlHashLookup(xmlSecDocCaches, name);
+    if((cache != NULL) && (doc->psvi != (void*)cache)) {
+        xmlHashRemoveEntry(xmlSecDocCaches, name, xmlSecDocCacheHashDestroy);
+        --xmlSecDocCachesCount;
+        return(NULL);
+    }
+    return(cache);
+}
+
+static void
+xmlSecDocCacheGetName(xmlDocPtr doc, xmlChar* name, xmlSecSize nameSize) {
+    xmlSecAssert(doc != NULL);
+    xmlSecAssert(name != NULL);
+
+    (void)xmlStrPrintf(name, (int)nameSize, "%p", (void*)doc);
+}
+
+/*
+ * Returns 1 if the @item result might change when @node is modified:
+ * @node is in the @item subtree (but not in its excluded subtree) or
+ * @node is an ancestor of the @item subtree (the inherited namespaces
+ * and xml:* attributes).
+ */
+static int
+xmlSecDocCacheItemDependsOn(xmlSecDocCacheItemPtr item, xmlNodePtr node) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(item != NULL, 1);
+    xmlSecAssert2(item->root != NULL, 1);
+    xmlSecAssert2(node != NULL, 1);
+
+    for(cur = node; cur != NULL; cur = cur->parent) {
+        if(cur == item->excluded) {
+            return(0);
+        }
+        if(cur == item->root) {
+            return(1);
+        }
+    }
+    for(cur = item->root->parent; cur != NULL; cur = cur->parent) {
+        if(cur == node) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecDocCacheItemDestroy(xmlSecDocCacheItemPtr item) {
+    xmlSecAssert(item != NULL);
+
+    if(item->key != NULL) {
+        xmlFree(item->key);
+    }
+    if(item->data != NULL) {
+        memset(item->data, 0, item->dataSize);
+        xmlFree(item->data);
+    }
+    xmlFree(item);
+}
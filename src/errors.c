@@ -16,6 +16,14 @@
 #include <time.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_ERRORS_STACK_WIN32       1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_ERRORS_STACK_PTHREAD     1
+#endif /* defined(_WIN32) */
+
 #include <libxml/tree.h>
 
 #include <xmlsec/xmlsec.h>
@@ -84,11 +92,43 @@ static xmlSecErrorDescription xmlSecErrorsTable[XMLSEC_ERRORS_MAX_NUMBER + 1] =
   { XMLSEC_ERRORS_R_CERT_HAS_EXPIRED,           "certificate has expirred" },
   { XMLSEC_ERRORS_R_DSIG_NO_REFERENCES,         "Reference nodes are not found" },
   { XMLSEC_ERRORS_R_DSIG_INVALID_REFERENCE,     "Reference verification failed" },
+  { XMLSEC_ERRORS_R_LIMIT_EXCEEDED,             "processing limit exceeded" },
   { XMLSEC_ERRORS_R_ASSERTION,                  "assertion" },
   { 0,                                          NULL}
 };
 
 static xmlSecErrorsCallback xmlSecErrorsClbk = xmlSecErrorsDefaultCallback;
+static xmlSecErrorsRecordCallback xmlSecErrorsRecordClbk = NULL;
+
+/* the per-thread errors stack */
+typedef struct _xmlSecErrorsStack {
+    xmlSecErrorsStackItem       items[XMLSEC_ERRORS_STACK_SIZE];
+    xmlSecSize                  size;
+    xmlSecSize                  dropped;
+} xmlSecErrorsStack, *xmlSecErrorsStackPtr;
+
+#if defined(XMLSEC_ERRORS_STACK_WIN32)
+static DWORD xmlSecErrorsStackKey = TLS_OUT_OF_INDEXES;
+#elif defined(XMLSEC_ERRORS_STACK_PTHREAD)
+static pthread_key_t xmlSecErrorsStackKey;
+static int xmlSecErrorsStackKeyCreated = 0;
+#else /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+/* no threads support, there is only one thread */
+static xmlSecErrorsStackPtr xmlSecErrorsStackCurrent = NULL;
+#endif /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+
+static xmlSecErrorsStackPtr     xmlSecErrorsStackGet            (void);
+static int                      xmlSecErrorsStackSet            (xmlSecErrorsStackPtr stack);
+static void                     xmlSecErrorsStackFree           (void* stack);
+static void                     xmlSecErrorsStackPush           (xmlSecErrorsStackPtr stack,
+                                                                 const char* file,
+                                                                 int line,
+                                                                 const char* func,
+                                                                 const char* errorObject,
+                                                                 const char* errorSubject,
+                                                                 int reason,
+                                                                 const char* msg,
+                                                                 va_list va);
 static int  xmlSecPrintErrorMessages = 1;       /* whether the error messages will be printed immidiatelly */
 
 /**
@@ -99,6 +139,17 @@ static int  xmlSecPrintErrorMessages = 1;       /* whether the error messages wi
  */
 void
 xmlSecErrorsInit(void) {
+#if defined(XMLSEC_ERRORS_STACK_WIN32)
+    if(xmlSecErrorsStackKey == TLS_OUT_OF_INDEXES) {
+        xmlSecErrorsStackKey = TlsAlloc();
+    }
+#elif defined(XMLSEC_ERRORS_STACK_PTHREAD)
+    if(xmlSecErrorsStackKeyCreated == 0) {
+        if(pthread_key_create(&xmlSecErrorsStackKey, xmlSecErrorsStackFree) == 0) {
+            xmlSecErrorsStackKeyCreated = 1;
+        }
+    }
+#endif /* defined(XMLSEC_ERRORS_STACK_WIN32) */
 }
 
 /**
@@ -109,6 +160,18 @@ xmlSecErrorsInit(void) {
  */
 void
 xmlSecErrorsShutdown(void) {
+    xmlSecErrorsStackStop();
+#if defined(XMLSEC_ERRORS_STACK_WIN32)
+    if(xmlSecErrorsStackKey != TLS_OUT_OF_INDEXES) {
+        TlsFree(xmlSecErrorsStackKey);
+        xmlSecErrorsStackKey = TLS_OUT_OF_INDEXES;
+    }
+#elif defined(XMLSEC_ERRORS_STACK_PTHREAD)
+    if(xmlSecErrorsStackKeyCreated != 0) {
+        pthread_key_delete(xmlSecErrorsStackKey);
+        xmlSecErrorsStackKeyCreated = 0;
+    }
+#endif /* defined(XMLSEC_ERRORS_STACK_WIN32) */
 }
 
 /**
@@ -123,6 +186,271 @@ xmlSecErrorsSetCallback(xmlSecErrorsCallback callback) {
     xmlSecErrorsClbk = callback;
 }
 
+/**
+ * xmlSecErrorsSetRecordCallback:
+ * @callback:           the new structured errors callback function.
+ *
+ * Sets the structured errors callback function to @callback that will
+ * be called every time an error occurs instead of the callback set with
+ * #xmlSecErrorsSetCallback. Unlike the latter, the error message is not
+ * formatted unless the @callback asks for it with #xmlSecErrorRecordGetMsg
+ * which makes errors reporting cheap when only the error codes are
+ * needed. Set @callback to NULL to go back to #xmlSecErrorsSetCallback
+ * callback.
+ */
+void
+xmlSecErrorsSetRecordCallback(xmlSecErrorsRecordCallback callback) {
+    xmlSecErrorsRecordClbk = callback;
+}
+
+/**
+ * xmlSecErrorRecordGetMsg:
+ * @record:             the error record.
+ *
+ * Formats the @record error message on the first call. The message
+ * can only be requested from the #xmlSecErrorsRecordCallback call.
+ *
+ * Returns: the formatted error message.
+ */
+const xmlChar*
+xmlSecErrorRecordGetMsg(xmlSecErrorRecordPtr record) {
+    int ret;
+
+    /* could not use asserts here! */
+    if((record == NULL) || (record->msg == NULL) || (record->msgSize <= 0)) {
+        return(BAD_CAST "");
+    }
+    if(record->msgReady != 0) {
+        return(record->msg);
+    }
+
+    /* the arguments list can only be used once */
+    record->msgReady = 1;
+    if((record->msgFormat != NULL) && (record->msgArgs != NULL)) {
+        ret = xmlStrVPrintf(record->msg, record->msgSize, record->msgFormat,
+                            *((va_list*)record->msgArgs));
+        if(ret < 0) {
+            /* Can't really report an error from an error callback */
+            memcpy(record->msg, fatal_error, sizeof(fatal_error));
+        }
+        record->msg[record->msgSize - 1] = '\0'; /* just in case */
+    } else {
+        record->msg[0] = '\0';
+    }
+    return(record->msg);
+}
+
+/**
+ * xmlSecErrorsStackStart:
+ *
+ * Starts collecting the errors reported in the current thread in the
+ * per-thread errors stack (the stack is cleared if it already exists).
+ * While the stack is active, the errors from the current thread are
+ * not passed to the errors callbacks, so concurrent threads collect
+ * their own errors without any locking. The caller is responsible for
+ * calling #xmlSecErrorsStackStop function before the thread exits.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecErrorsStackStart(void) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    if(stack != NULL) {
+        xmlSecErrorsStackClear();
+        return(0);
+    }
+
+    stack = (xmlSecErrorsStackPtr)xmlMalloc(sizeof(xmlSecErrorsStack));
+    if(stack == NULL) {
+        xmlSecMallocError(sizeof(xmlSecErrorsStack), NULL);
+        return(-1);
+    }
+    memset(stack, 0, sizeof(xmlSecErrorsStack));
+
+    if(xmlSecErrorsStackSet(stack) < 0) {
+        xmlFree(stack);
+        xmlSecInternalError("xmlSecErrorsStackSet", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecErrorsStackStop:
+ *
+ * Stops collecting the errors in the current thread and destroys
+ * the per-thread errors stack. The following errors are passed to
+ * the errors callbacks again.
+ */
+void
+xmlSecErrorsStackStop(void) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    if(stack != NULL) {
+        xmlSecErrorsStackSet(NULL);
+        xmlSecErrorsStackFree(stack);
+    }
+}
+
+/**
+ * xmlSecErrorsStackClear:
+ *
+ * Removes all the errors from the current thread errors stack.
+ */
+void
+xmlSecErrorsStackClear(void) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    if(stack != NULL) {
+        stack->size = 0;
+        stack->dropped = 0;
+    }
+}
+
+/**
+ * xmlSecErrorsStackGetSize:
+ *
+ * Gets the number of errors in the current thread errors stack.
+ *
+ * Returns: the number of errors or 0 if the errors stack is not
+ * started in the current thread.
+ */
+xmlSecSize
+xmlSecErrorsStackGetSize(void) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    return((stack != NULL) ? stack->size : 0);
+}
+
+/**
+ * xmlSecErrorsStackGetDropped:
+ *
+ * Gets the number of errors that didn't fit in the current thread
+ * errors stack (the stack keeps the first #XMLSEC_ERRORS_STACK_SIZE
+ * errors since the first error is usually the root cause).
+ *
+ * Returns: the number of dropped errors.
+ */
+xmlSecSize
+xmlSecErrorsStackGetDropped(void) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    return((stack != NULL) ? stack->dropped : 0);
+}
+
+/**
+ * xmlSecErrorsStackGetItem:
+ * @pos:                the error position.
+ *
+ * Gets the error at position @pos in the current thread errors stack
+ * (the first reported error is at position 0).
+ *
+ * Returns: the pointer to the error or NULL if @pos is out of range.
+ */
+xmlSecErrorsStackItemPtr
+xmlSecErrorsStackGetItem(xmlSecSize pos) {
+    xmlSecErrorsStackPtr stack;
+
+    stack = xmlSecErrorsStackGet();
+    if((stack == NULL) || (pos >= stack->size)) {
+        return(NULL);
+    }
+    return(&(stack->items[pos]));
+}
+
+static xmlSecErrorsStackPtr
+xmlSecErrorsStackGet(void) {
+#if defined(XMLSEC_ERRORS_STACK_WIN32)
+    if(xmlSecErrorsStackKey == TLS_OUT_OF_INDEXES) {
+        return(NULL);
+    }
+    return((xmlSecErrorsStackPtr)TlsGetValue(xmlSecErrorsStackKey));
+#elif defined(XMLSEC_ERRORS_STACK_PTHREAD)
+    if(xmlSecErrorsStackKeyCreated == 0) {
+        return(NULL);
+    }
+    return((xmlSecErrorsStackPtr)pthread_getspecific(xmlSecErrorsStackKey));
+#else /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+    return(xmlSecErrorsStackCurrent);
+#endif /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+}
+
+static int
+xmlSecErrorsStackSet(xmlSecErrorsStackPtr stack) {
+#if defined(XMLSEC_ERRORS_STACK_WIN32)
+    if((xmlSecErrorsStackKey == TLS_OUT_OF_INDEXES) || (!TlsSetValue(xmlSecErrorsStackKey, stack))) {
+        return(-1);
+    }
+#elif defined(XMLSEC_ERRORS_STACK_PTHREAD)
+    if((xmlSecErrorsStackKeyCreated == 0) || (pthread_setspecific(xmlSecErrorsStackKey, stack) != 0)) {
+        return(-1);
+    }
+#else /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+    xmlSecErrorsStackCurrent = stack;
+#endif /* defined(XMLSEC_ERRORS_STACK_WIN32) */
+    return(0);
+}
+
+static void
+xmlSecErrorsStackFree(void* stack) {
+    if(stack != NULL) {
+        xmlFree(stack);
+    }
+}
+
+static void
+xmlSecErrorsStackCopyString(char* dst, xmlSecSize dstSize, const char* src) {
+    xmlSecSize size;
+
+    if(src == NULL) {
+        dst[0] = '\0';
+        return;
+    }
+    size = strlen(src);
+    if(size >= dstSize) {
+        size = dstSize - 1;
+    }
+    memcpy(dst, src, size);
+    dst[size] = '\0';
+}
+
+static void
+xmlSecErrorsStackPush(xmlSecErrorsStackPtr stack, const char* file, int line, const char* func,
+                      const char* errorObject, const char* errorSubject,
+                      int reason, const char* msg, va_list va) {
+    xmlSecErrorsStackItemPtr item;
+    int ret;
+
+    if(stack->size >= XMLSEC_ERRORS_STACK_SIZE) {
+        ++stack->dropped;
+        return;
+    }
+    item = &(stack->items[stack->size++]);
+
+    /* file and func are string literals */
+    item->file   = file;
+    item->line   = line;
+    item->func   = func;
+    item->reason = reason;
+    xmlSecErrorsStackCopyString(item->errorObject, sizeof(item->errorObject), errorObject);
+    xmlSecErrorsStackCopyString(item->errorSubject, sizeof(item->errorSubject), errorSubject);
+    if(msg != NULL) {
+        ret = xmlStrVPrintf(item->msg, sizeof(item->msg), msg, va);
+        if(ret < 0) {
+            xmlSecErrorsStackCopyString((char*)item->msg, sizeof(item->msg), (const char*)fatal_error);
+        }
+        item->msg[sizeof(item->msg) - 1] = '\0'; /* just in case */
+    } else {
+        item->msg[0] = '\0';
+    }
+}
+
 /**
  * xmlSecErrorsDefaultCallback:
  * @file:               the error location file name (__FILE__ macro).
@@ -230,6 +558,47 @@ void
 xmlSecError(const char* file, int line, const char* func,
             const char* errorObject, const char* errorSubject,
             int reason, const char* msg, ...) {
+    xmlSecErrorsStackPtr stack;
+
+    /* the current thread collects its own errors */
+    stack = xmlSecErrorsStackGet();
+    if(stack != NULL) {
+        va_list va;
+
+        va_start(va, msg);
+        xmlSecErrorsStackPush(stack, file, line, func, errorObject, errorSubject, reason, msg, va);
+        va_end(va);
+        return;
+    }
+
+    if(xmlSecErrorsRecordClbk != NULL) {
+        xmlChar error_msg[XMLSEC_ERRORS_BUFFER_SIZE];
+        xmlSecErrorRecord record;
+        va_list va;
+
+        record.file         = file;
+        record.line         = line;
+        record.func         = func;
+        record.errorObject  = errorObject;
+        record.errorSubject = errorSubject;
+        record.reason       = reason;
+        record.msgFormat    = msg;
+        record.msgArgs      = &va;
+        record.msg          = error_msg;
+        record.msgSize      = sizeof(error_msg);
+        record.msgReady     = 0;
+
+        va_start(va, msg);
+        xmlSecErrorsRecordClbk(&record);
+        va_end(va);
+        return;
+    }
+
+    /* nobody will see the message, don't bother formatting it */
+    if((xmlSecErrorsClbk == xmlSecErrorsDefaultCallback) && (xmlSecPrintErrorMessages == 0)) {
+        return;
+    }
+
     if(xmlSecErrorsClbk != NULL) {
         xmlChar error_msg[XMLSEC_ERRORS_BUFFER_SIZE];
         int ret;
@@ -17,6 +17,7 @@
 #endif /* XMLSEC_PRIVATE */
 
 #include <errno.h>
+#include <limits.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -865,6 +866,28 @@ extern "C" {
                     (msg), (param1), (param2), (param3), (param4) \
         )
 
+/**********************************************************************
+ *
+ * Safe cast macros.
+ *
+ **********************************************************************/
+/**
+ * XMLSEC_SAFE_CAST_SIZE_TO_INT:
+ * @srcVal:             the source #xmlSecSize value.
+ * @dstVal:             the destination int variable.
+ * @errorAction:        the statement executed if @srcVal is too big for int.
+ * @errorObject:        the error specific error object (e.g. transform, key data, etc).
+ *
+ * Macro. Casts @srcVal to int or reports an error and executes @errorAction
+ * if the value doesn't fit.
+ */
+#define XMLSEC_SAFE_CAST_SIZE_TO_INT(srcVal, dstVal, errorAction, errorObject) \
+        if((srcVal) > (xmlSecSize)INT_MAX) {                \
+            xmlSecInvalidSizeMoreThanError("size", (srcVal), INT_MAX, (errorObject)); \
+            errorAction;                                    \
+        }                                                   \
+        (dstVal) = (int)(srcVal)
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,233 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Parallel tasks executor: the library parallel stages (the references
+ * digests, the signatures verification, the encryption and the decryption)
+ * submit their tasks to the executor registered by the application or
+ * to the default one that starts a thread per task.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_EXECUTOR_THREADS_WIN32   1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#include <unistd.h>
+#define XMLSEC_EXECUTOR_THREADS_PTHREAD 1
+#endif /* defined(_WIN32) */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/executor.h>
+#include <xmlsec/errors.h>
+
+static xmlSecExecutorRunCallback xmlSecExecutorClbk             = xmlSecExecutorDefaultRunCallback;
+static xmlSecSize               xmlSecExecutorThreadsNumber     = 0;
+static void*                    xmlSecExecutorUserData          = NULL;
+
+/**
+ * xmlSecExecutorSetCallback:
+ * @callback:           the new executor callback or NULL for the default one.
+ * @threadsNumber:      the number of tasks the @callback can run at the same
+ *                      time or 0 to use the number of processors.
+ * @userData:           the data passed to @callback.
+ *
+ * Sets the executor used by all the library parallel stages, e.g. to submit
+ * the tasks to the application's own scheduler instead of starting new threads.
+ * The function is not thread safe and should be called before any
+ * parallel processing is started.
+ */
+void
+xmlSecExecutorSetCallback(xmlSecExecutorRunCallback callback, xmlSecSize threadsNumber, void* userData) {
+    xmlSecExecutorClbk = (callback != NULL) ? callback : xmlSecExecutorDefaultRunCallback;
+    xmlSecExecutorThreadsNumber = threadsNumber;
+    xmlSecExecutorUserData = userData;
+}
+
+/**
+ * xmlSecExecutorGetThreadsNumber:
+ *
+ * Gets the number of tasks the executor can run at the same time: the number
+ * set with #xmlSecExecutorSetCallback or the number of processors.
+ *
+ * Returns: the number of parallel tasks (always at least 1).
+ */
+xmlSecSize
+xmlSecExecutorGetThreadsNumber(void) {
+    xmlSecSize res;
+
+    if(xmlSecExecutorThreadsNumber > 0) {
+        return(xmlSecExecutorThreadsNumber);
+    }
+
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32)
+    {
+        SYSTEM_INFO info;
+
+        GetSystemInfo(&info);
+        res = (info.dwNumberOfProcessors > 0) ? (xmlSecSize)info.dwNumberOfProcessors : 1;
+    }
+#elif defined(XMLSEC_EXECUTOR_THREADS_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+    {
+        long num;
+
+        num = sysconf(_SC_NPROCESSORS_ONLN);
+        res = (num > 0) ? (xmlSecSize)num : 1;
+    }
+#else  /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+    res = 1;
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+
+    return(res);
+}
+
+/**
+ * xmlSecExecutorRun:
+ * @task:               the task method.
+ * @tasksData:          the array of @tasksNumber tasks data.
+ * @tasksNumber:        the number of tasks.
+ *
+ * Runs the tasks with the current executor (see #xmlSecExecutorRunCallback).
+ * If the executor fails then the first task is run in the current thread
+ * so the stage is always completed.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecExecutorRun(xmlSecExecutorTaskMethod task, void** tasksData, xmlSecSize tasksNumber) {
+    int ret;
+
+    xmlSecAssert2(task != NULL, -1);
+    xmlSecAssert2(tasksData != NULL, -1);
+
+    if(tasksNumber == 0) {
+        return(0);
+    } else if(tasksNumber == 1) {
+        task(tasksData[0]);
+        return(0);
+    }
+
+    ret = xmlSecExecutorClbk(task, tasksData, tasksNumber, xmlSecExecutorUserData);
+    if(ret < 0) {
+        /* not fatal: the task will do all the work */
+        task(tasksData[0]);
+    }
+    return(0);
+}
+
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD)
+typedef struct _xmlSecExecutorThread {
+    xmlSecExecutorTaskMethod    task;
+    void*                       data;
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32)
+    HANDLE                      handle;
+#else /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+    pthread_t                   handle;
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+    int                         started;
+} xmlSecExecutorThread, *xmlSecExecutorThreadPtr;
+
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32)
+static DWORD WINAPI
+xmlSecExecutorThreadRun(LPVOID param) {
+    xmlSecExecutorThreadPtr thread = (xmlSecExecutorThreadPtr)param;
+
+    thread->task(thread->data);
+    return(0);
+}
+#else /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+static void*
+xmlSecExecutorThreadRun(void* param) {
+    xmlSecExecutorThreadPtr thread = (xmlSecExecutorThreadPtr)param;
+
+    thread->task(thread->data);
+    return(NULL);
+}
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD) */
+
+/**
+ * xmlSecExecutorDefaultRunCallback:
+ * @task:               the task method.
+ * @tasksData:          the array of @tasksNumber tasks data.
+ * @tasksNumber:        the number of tasks.
+ * @userData:           not used.
+ *
+ * The default executor: the first task runs in the current thread and every
+ * other task in a new thread. The tasks that could not get a thread run in
+ * the current thread after the first one. If threads are not supported on the
+ * platform then all the tasks run one after another in the current thread.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecExecutorDefaultRunCallback(xmlSecExecutorTaskMethod task, void** tasksData,
+                                 xmlSecSize tasksNumber, void* userData ATTRIBUTE_UNUSED) {
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD)
+    xmlSecExecutorThreadPtr threads;
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD) */
+    xmlSecSize ii;
+
+    xmlSecAssert2(task != NULL, -1);
+    xmlSecAssert2(tasksData != NULL, -1);
+
+    if(tasksNumber == 0) {
+        return(0);
+    }
+
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD)
+    threads = (xmlSecExecutorThreadPtr)xmlMalloc(sizeof(xmlSecExecutorThread) * tasksNumber);
+    if(threads == NULL) {
+        xmlSecMallocError(sizeof(xmlSecExecutorThread) * tasksNumber, NULL);
+        return(-1);
+    }
+    memset(threads, 0, sizeof(xmlSecExecutorThread) * tasksNumber);
+
+    for(ii = 1; ii < tasksNumber; ++ii) {
+        threads[ii].task = task;
+        threads[ii].data = tasksData[ii];
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32)
+        threads[ii].handle = CreateThread(NULL, 0, xmlSecExecutorThreadRun, &(threads[ii]), 0, NULL);
+        threads[ii].started = (threads[ii].handle != NULL) ? 1 : 0;
+#else /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+        threads[ii].started = (pthread_create(&(threads[ii].handle), NULL, xmlSecExecutorThreadRun, &(threads[ii])) == 0) ? 1 : 0;
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+    }
+
+    task(tasksData[0]);
+    for(ii = 1; ii < tasksNumber; ++ii) {
+        if(threads[ii].started == 0) {
+            task(tasksData[ii]);
+        }
+    }
+
+    for(ii = 1; ii < tasksNumber; ++ii) {
+        if(threads[ii].started == 0) {
+            continue;
+        }
+#if defined(XMLSEC_EXECUTOR_THREADS_WIN32)
+        WaitForSingleObject(threads[ii].handle, INFINITE);
+        CloseHandle(threads[ii].handle);
+#else /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+        pthread_join(threads[ii].handle, NULL);
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) */
+    }
+    xmlFree(threads);
+#else /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD) */
+    for(ii = 0; ii < tasksNumber; ++ii) {
+        task(tasksData[ii]);
+    }
+#endif /* defined(XMLSEC_EXECUTOR_THREADS_WIN32) || defined(XMLSEC_EXECUTOR_THREADS_PTHREAD) */
+
+    return(0);
+}
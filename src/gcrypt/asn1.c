@@ -178,13 +178,72 @@ xmlSecGCryptAsn1ParseTag (xmlSecByte const **buffer, xmlSecSize *buflen, struct
     return(0);
 }
 
+/* The INTEGER value found in the DER buffer: the key parameters are
+   passed to gcry_sexp_build() as "%b" byte strings right from the
+   input buffer (libgcrypt reads them as unsigned MPIs), without the
+   intermediate gcry_mpi_t copies. */
+struct xmlSecGCryptAsn1Integer
+{
+  const xmlSecByte *data;
+  xmlSecSize size;
+};
+
+/* the DER INTEGER is big-endian, the key parameters are positive numbers
+   so only the leading zero bytes need to be skipped to compare them */
+static void
+xmlSecGCryptAsn1IntegerStrip(const struct xmlSecGCryptAsn1Integer *in, struct xmlSecGCryptAsn1Integer *out) {
+    xmlSecAssert(in != NULL);
+    xmlSecAssert(out != NULL);
+
+    out->data = in->data;
+    out->size = in->size;
+    while((out->size > 0) && (out->data[0] == 0)) {
+        ++out->data;
+        --out->size;
+    }
+}
+
+static int
+xmlSecGCryptAsn1IntegerCmp(const struct xmlSecGCryptAsn1Integer *a, const struct xmlSecGCryptAsn1Integer *b) {
+    struct xmlSecGCryptAsn1Integer aa, bb;
+
+    xmlSecAssert2(a != NULL, 0);
+    xmlSecAssert2(b != NULL, 0);
+
+    xmlSecGCryptAsn1IntegerStrip(a, &aa);
+    xmlSecGCryptAsn1IntegerStrip(b, &bb);
+    if(aa.size != bb.size) {
+        return((aa.size < bb.size) ? -1 : 1);
+    }
+    if(aa.size == 0) {
+        return(0);
+    }
+    return(memcmp(aa.data, bb.data, aa.size));
+}
+
+static void
+xmlSecGCryptAsn1IntegerSwap(struct xmlSecGCryptAsn1Integer *a, struct xmlSecGCryptAsn1Integer *b) {
+    struct xmlSecGCryptAsn1Integer tmp;
+
+    xmlSecAssert(a != NULL);
+    xmlSecAssert(b != NULL);
+
+    tmp = (*a);
+    (*a) = (*b);
+    (*b) = tmp;
+}
+
+/* the "%b" arguments of gcry_sexp_build() */
+#define XMLSEC_GCRYPT_ASN1_INTEGER_ARG(param) \
+    (int)((param).size), (const void*)((param).data)
+
+/* the INTEGERs are located in the buffer in a single pass, nothing is copied */
 static int
 xmlSecGCryptAsn1ParseIntegerSequence(xmlSecByte const **buffer, xmlSecSize *buflen,
-                                     gcry_mpi_t * params, int params_size) {
+                                     struct xmlSecGCryptAsn1Integer * params, int params_size) {
     const xmlSecByte *buf;
     xmlSecSize length;
     struct tag_info ti;
-    gcry_error_t err;
     int idx = 0;
     int ret;
 
@@ -219,11 +278,8 @@ xmlSecGCryptAsn1ParseIntegerSequence(xmlSecByte const **buffer, xmlSecSize *bufl
             return(-1);
         }
 
-        err = gcry_mpi_scan(&(params[idx]), GCRYMPI_FMT_USG, buf, ti.length, NULL);
-        if((err != GPG_ERR_NO_ERROR) || (params[idx] == NULL)) {
-            xmlSecGCryptError("gcry_mpi_scan", err, NULL);
-            return(-1);
-        }
+        params[idx].data = buf;
+        params[idx].size = ti.length;
         buf += ti.length;
         length -= ti.length;
     }
@@ -249,9 +305,12 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
     gcry_sexp_t s_pub_key = NULL;
     gcry_sexp_t s_priv_key = NULL;
     gcry_error_t err;
-    gcry_mpi_t keyparms[20];
+    struct xmlSecGCryptAsn1Integer keyparms[20];
+    struct xmlSecGCryptAsn1Integer zero;
+    gcry_mpi_t mpi_p = NULL;
+    gcry_mpi_t mpi_q = NULL;
+    gcry_mpi_t mpi_u = NULL;
     int keyparms_num;
-    unsigned int idx;
     int ret;
 
     xmlSecAssert2(der != NULL, NULL);
@@ -259,6 +318,7 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
 
     /* Parse the ASN.1 structure.  */
     memset(&keyparms, 0, sizeof(keyparms));
+    memset(&zero, 0, sizeof(zero));
     ret = xmlSecGCryptAsn1ParseIntegerSequence(
         &der, &derlen,
         keyparms,  sizeof(keyparms) / sizeof(keyparms[0])
@@ -270,7 +330,10 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
     keyparms_num = ret;
 
     /* The value of the first integer should be 0. */
-    if ((keyparms_num < 1) || (gcry_mpi_cmp_ui(keyparms[0], 0) != 0)) {
+    if(keyparms_num >= 1) {
+        xmlSecGCryptAsn1IntegerStrip(&(keyparms[0]), &zero);
+    }
+    if ((keyparms_num < 1) || (zero.size != 0)) {
         xmlSecInternalError2("xmlSecGCryptAsn1ParseTag", NULL,
                              "num=%d", (int)keyparms_num);
         goto done;
@@ -316,14 +379,16 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
 
         /* Convert from OpenSSL parameter ordering to the OpenPGP order. */
         /* First check that x < y; if not swap x and y  */
-        if (gcry_mpi_cmp (keyparms[4], keyparms[5]) > 0) {
-            gcry_mpi_swap (keyparms[4], keyparms[5]);
+        if (xmlSecGCryptAsn1IntegerCmp (&(keyparms[4]), &(keyparms[5])) > 0) {
+            xmlSecGCryptAsn1IntegerSwap (&(keyparms[4]), &(keyparms[5]));
         }
 
         /* Build the S-expressions  */
         err = gcry_sexp_build (&s_priv_key, NULL,
-                "(private-key(dsa(p%m)(q%m)(g%m)(x%m)(y%m)))",
-                keyparms[1], keyparms[2], keyparms[3], keyparms[4], keyparms[5]
+                "(private-key(dsa(p%b)(q%b)(g%b)(x%b)(y%b)))",
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2]),
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[3]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[4]),
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[5])
         );
         if((err != GPG_ERR_NO_ERROR) || (s_priv_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(private-key/dsa)", err, NULL);
@@ -331,8 +396,9 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
         }
 
         err = gcry_sexp_build (&s_pub_key, NULL,
-                "(public-key(dsa(p%m)(q%m)(g%m)(y%m)))",
-                keyparms[1], keyparms[2], keyparms[3], keyparms[5]
+                "(public-key(dsa(p%b)(q%b)(g%b)(y%b)))",
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2]),
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[3]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[5])
         );
         if((err != GPG_ERR_NO_ERROR) || (s_pub_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(public-key/dsa)", err, NULL);
@@ -367,8 +433,9 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
 
         /* Build the S-expression.  */
         err = gcry_sexp_build (&s_pub_key, NULL,
-                "(public-key(dsa(p%m)(q%m)(g%m)(y%m)))",
-                keyparms[2], keyparms[3], keyparms[4], keyparms[1]
+                "(public-key(dsa(p%b)(q%b)(g%b)(y%b)))",
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[3]),
+                XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[4]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1])
         );
         if((err != GPG_ERR_NO_ERROR) || (s_pub_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(public-key/dsa)", err, NULL);
@@ -405,25 +472,51 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
         /* Convert from OpenSSL parameter ordering to the OpenPGP order. */
         /* (http://gnupg.10057.n7.nabble.com/RSA-PKCS-1-signing-differs-from-OpenSSL-s-td27920.html) */
         /* First check that p < q; if not swap p and q and recompute u.  */ 
-        if (gcry_mpi_cmp (keyparms[4], keyparms[5]) > 0) {
-            gcry_mpi_swap (keyparms[4], keyparms[5]);
-            gcry_mpi_invm (keyparms[8], keyparms[4], keyparms[5]);
+        if (xmlSecGCryptAsn1IntegerCmp (&(keyparms[4]), &(keyparms[5])) > 0) {
+            /* the only value we need to compute */
+            xmlSecGCryptAsn1IntegerSwap (&(keyparms[4]), &(keyparms[5]));
+
+            err = gcry_mpi_scan(&mpi_p, GCRYMPI_FMT_USG, keyparms[4].data, keyparms[4].size, NULL);
+            if((err != GPG_ERR_NO_ERROR) || (mpi_p == NULL)) {
+                xmlSecGCryptError("gcry_mpi_scan(p)", err, NULL);
+                goto done;
+            }
+            err = gcry_mpi_scan(&mpi_q, GCRYMPI_FMT_USG, keyparms[5].data, keyparms[5].size, NULL);
+            if((err != GPG_ERR_NO_ERROR) || (mpi_q == NULL)) {
+                xmlSecGCryptError("gcry_mpi_scan(q)", err, NULL);
+                goto done;
+            }
+            mpi_u = gcry_mpi_new(0);
+            if(mpi_u == NULL) {
+                xmlSecGCryptError("gcry_mpi_new", (gcry_error_t)GPG_ERR_GENERAL, NULL);
+                goto done;
+            }
+            gcry_mpi_invm (mpi_u, mpi_p, mpi_q);
+
+            /* Build the S-expression.  */
+            err = gcry_sexp_build (&s_priv_key, NULL,
+                             "(private-key(rsa(n%b)(e%b)(d%b)(p%b)(q%b)(u%m)))",
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2]),
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[3]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[4]),
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[5]), mpi_u
+            );
+        } else {
+            /* Build the S-expression.  */
+            err = gcry_sexp_build (&s_priv_key, NULL,
+                             "(private-key(rsa(n%b)(e%b)(d%b)(p%b)(q%b)(u%b)))",
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2]),
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[3]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[4]),
+                             XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[5]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[8])
+            );
         }
-
-        /* Build the S-expression.  */
-        err = gcry_sexp_build (&s_priv_key, NULL,
-                         "(private-key(rsa(n%m)(e%m)(d%m)(p%m)(q%m)(u%m)))",
-                         keyparms[1], keyparms[2], keyparms[3],
-                         keyparms[4], keyparms[5], keyparms[8]
-        );
         if((err != GPG_ERR_NO_ERROR) || (s_priv_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(private-key/rsa)", err, NULL);
             goto done;
         }
 
         err = gcry_sexp_build (&s_pub_key, NULL,
-                         "(public-key(rsa(n%m)(e%m)))",
-                         keyparms[1], keyparms[2]
+                         "(public-key(rsa(n%b)(e%b)))",
+                         XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2])
         );
         if((err != GPG_ERR_NO_ERROR) || (s_pub_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(public-key/rsa)", err, NULL);
@@ -458,8 +551,8 @@ xmlSecGCryptParseDer(const xmlSecByte * der, xmlSecSize derlen,
 
         /* Build the S-expression.  */
         err = gcry_sexp_build (&s_pub_key, NULL,
-                         "(public-key(rsa(n%m)(e%m)))",
-                         keyparms[1], keyparms[2]
+                         "(public-key(rsa(n%b)(e%b)))",
+                         XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[1]), XMLSEC_GCRYPT_ASN1_INTEGER_ARG(keyparms[2])
         );
         if((err != GPG_ERR_NO_ERROR) || (s_pub_key == NULL)) {
             xmlSecGCryptError("gcry_sexp_build(public-key/rsa)", err, NULL);
@@ -497,10 +590,14 @@ done:
     if(s_pub_key != NULL) {
         gcry_sexp_release(s_pub_key);
     }
-    for (idx = 0; idx < sizeof(keyparms) / sizeof(keyparms[0]); idx++) {
-        if(keyparms[idx] != NULL) {
-            gcry_mpi_release (keyparms[idx]);
-        }
+    if(mpi_p != NULL) {
+        gcry_mpi_release(mpi_p);
+    }
+    if(mpi_q != NULL) {
+        gcry_mpi_release(mpi_q);
+    }
+    if(mpi_u != NULL) {
+        gcry_mpi_release(mpi_u);
     }
 
     return(key_data);
@@ -10,6 +10,10 @@
 
 #include <string.h>
 
+#if defined(_MSC_VER)
+#include <windows.h>
+#endif /* defined(_MSC_VER) */
+
 #include <gcrypt.h>
 
 #include <xmlsec/xmlsec.h>
@@ -24,11 +28,69 @@
 
 /**************************************************************************
  *
- * Helpers
+ * Shared GCrypt asym key pair: the keys are never modified after they are
+ * adopted, so the key data copies (e.g. the signature transforms keys)
+ * share one reference counted pair instead of copying the s-expressions.
+ * GCrypt public key operations only read the keys and can use them from
+ * multiple threads.
  *
  *************************************************************************/
-static gcry_sexp_t             xmlSecGCryptAsymSExpDup    (gcry_sexp_t sexp);
+typedef struct _xmlSecGCryptAsymKeyPair          xmlSecGCryptAsymKeyPair,
+                                                *xmlSecGCryptAsymKeyPairPtr;
+struct _xmlSecGCryptAsymKeyPair {
+    gcry_sexp_t pub_key;
+    gcry_sexp_t priv_key;
+    xmlSecSize  nbits;          /* gcry_pk_get_nbits() parses the key every time */
+    int         refs;
+};
+
+#if defined(__GNUC__)
+#define xmlSecGCryptAsymKeyPairRefsIncrement(pair)      __sync_add_and_fetch(&((pair)->refs), 1)
+#define xmlSecGCryptAsymKeyPairRefsDecrement(pair)      __sync_sub_and_fetch(&((pair)->refs), 1)
+#elif defined(_MSC_VER)
+#define xmlSecGCryptAsymKeyPairRefsIncrement(pair)      InterlockedIncrement((volatile LONG*)&((pair)->refs))
+#define xmlSecGCryptAsymKeyPairRefsDecrement(pair)      InterlockedDecrement((volatile LONG*)&((pair)->refs))
+#else  /* defined(_MSC_VER) */
+/* no atomics: the key data copies can not be used from multiple threads */
+#define xmlSecGCryptAsymKeyPairRefsIncrement(pair)      (++((pair)->refs))
+#define xmlSecGCryptAsymKeyPairRefsDecrement(pair)      (--((pair)->refs))
+#endif /* defined(__GNUC__) */
+
+static xmlSecGCryptAsymKeyPairPtr
+xmlSecGCryptAsymKeyPairCreate(gcry_sexp_t pub_key, gcry_sexp_t priv_key) {
+    xmlSecGCryptAsymKeyPairPtr pair;
+
+    xmlSecAssert2(pub_key != NULL, NULL);
+
+    pair = (xmlSecGCryptAsymKeyPairPtr)xmlMalloc(sizeof(xmlSecGCryptAsymKeyPair));
+    if(pair == NULL) {
+        xmlSecMallocError(sizeof(xmlSecGCryptAsymKeyPair), NULL);
+        return(NULL);
+    }
+    memset(pair, 0, sizeof(xmlSecGCryptAsymKeyPair));
+    pair->pub_key = pub_key;
+    pair->priv_key = priv_key;
+    pair->nbits = gcry_pk_get_nbits(pub_key);
+    pair->refs = 1;
+    return(pair);
+}
 
+static void
+xmlSecGCryptAsymKeyPairRelease(xmlSecGCryptAsymKeyPairPtr pair) {
+    xmlSecAssert(pair != NULL);
+
+    if(xmlSecGCryptAsymKeyPairRefsDecrement(pair) > 0) {
+        return;
+    }
+    if(pair->pub_key != NULL) {
+        gcry_sexp_release(pair->pub_key);
+    }
+    if(pair->priv_key != NULL) {
+        gcry_sexp_release(pair->priv_key);
+    }
+    memset(pair, 0, sizeof(xmlSecGCryptAsymKeyPair));
+    xmlFree(pair);
+}
 
 /**************************************************************************
  *
@@ -38,8 +100,7 @@ static gcry_sexp_t             xmlSecGCryptAsymSExpDup    (gcry_sexp_t sexp);
 typedef struct _xmlSecGCryptAsymKeyDataCtx       xmlSecGCryptAsymKeyDataCtx,
                                                 *xmlSecGCryptAsymKeyDataCtxPtr;
 struct _xmlSecGCryptAsymKeyDataCtx {
-    gcry_sexp_t pub_key;
-    gcry_sexp_t priv_key;
+    xmlSecGCryptAsymKeyPairPtr pair;
 };
 
 /******************************************************************************
@@ -100,28 +161,15 @@ xmlSecGCryptAsymKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
 
     ctxDst = xmlSecGCryptAsymKeyDataGetCtx(dst);
     xmlSecAssert2(ctxDst != NULL, -1);
-    xmlSecAssert2(ctxDst->pub_key == NULL, -1);
-    xmlSecAssert2(ctxDst->priv_key == NULL, -1);
+    xmlSecAssert2(ctxDst->pair == NULL, -1);
 
     ctxSrc = xmlSecGCryptAsymKeyDataGetCtx(src);
     xmlSecAssert2(ctxSrc != NULL, -1);
 
-    if(ctxSrc->pub_key != NULL) {
-        ctxDst->pub_key = xmlSecGCryptAsymSExpDup(ctxSrc->pub_key);
-        if(ctxDst->pub_key == NULL) {
-            xmlSecInternalError("xmlSecGCryptAsymSExpDup(pub_key)",
-                                xmlSecKeyDataGetName(dst));
-            return(-1);
-        }
-    }
-
-    if(ctxSrc->priv_key != NULL) {
-        ctxDst->priv_key = xmlSecGCryptAsymSExpDup(ctxSrc->priv_key);
-        if(ctxDst->priv_key == NULL) {
-            xmlSecInternalError("xmlSecGCryptAsymSExpDup(priv_key)",
-                                xmlSecKeyDataGetName(dst));
-            return(-1);
-        }
+    /* no copy, just one more reference */
+    if(ctxSrc->pair != NULL) {
+        xmlSecGCryptAsymKeyPairRefsIncrement(ctxSrc->pair);
+        ctxDst->pair = ctxSrc->pair;
     }
 
     return(0);
@@ -137,11 +185,8 @@ xmlSecGCryptAsymKeyDataFinalize(xmlSecKeyDataPtr data) {
     ctx = xmlSecGCryptAsymKeyDataGetCtx(data);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->pub_key != NULL) {
-        gcry_sexp_release(ctx->pub_key);
-    }
-    if(ctx->priv_key != NULL) {
-        gcry_sexp_release(ctx->priv_key);
+    if(ctx->pair != NULL) {
+        xmlSecGCryptAsymKeyPairRelease(ctx->pair);
     }
     memset(ctx, 0, sizeof(xmlSecGCryptAsymKeyDataCtx));
 }
@@ -197,6 +242,7 @@ done:
 static int
 xmlSecGCryptAsymKeyDataAdoptKeyPair(xmlSecKeyDataPtr data, gcry_sexp_t pub_key, gcry_sexp_t priv_key) {
     xmlSecGCryptAsymKeyDataCtxPtr ctx;
+    xmlSecGCryptAsymKeyPairPtr pair;
 
     xmlSecAssert2(xmlSecKeyDataIsValid(data), -1);
     xmlSecAssert2(xmlSecKeyDataCheckSize(data, xmlSecGCryptAsymKeyDataSize), -1);
@@ -211,16 +257,18 @@ xmlSecGCryptAsymKeyDataAdoptKeyPair(xmlSecKeyDataPtr data, gcry_sexp_t pub_key,
     ctx = xmlSecGCryptAsymKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, -1);
 
-    /* release prev values and assign new ones */
-    if(ctx->pub_key != NULL) {
-        gcry_sexp_release(ctx->pub_key);
-    }
-    if(ctx->priv_key != NULL) {
-        gcry_sexp_release(ctx->priv_key);
+    pair = xmlSecGCryptAsymKeyPairCreate(pub_key, priv_key);
+    if(pair == NULL) {
+        xmlSecInternalError("xmlSecGCryptAsymKeyPairCreate",
+                            xmlSecKeyDataGetName(data));
+        return(-1);
     }
 
-    ctx->pub_key = pub_key;
-    ctx->priv_key = priv_key;
+    /* release prev values (the copies keep using them) and assign new ones */
+    if(ctx->pair != NULL) {
+        xmlSecGCryptAsymKeyPairRelease(ctx->pair);
+    }
+    ctx->pair = pair;
 
     /* done */
     return(0);
@@ -236,7 +284,7 @@ xmlSecGCryptAsymKeyDataGetPublicKey(xmlSecKeyDataPtr data) {
     ctx = xmlSecGCryptAsymKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, NULL);
 
-    return(ctx->pub_key);
+    return((ctx->pair != NULL) ? ctx->pair->pub_key : NULL);
 }
 
 static gcry_sexp_t
@@ -249,7 +297,7 @@ xmlSecGCryptAsymKeyDataGetPrivateKey(xmlSecKeyDataPtr data) {
     ctx = xmlSecGCryptAsymKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, NULL);
 
-    return(ctx->priv_key);
+    return((ctx->pair != NULL) ? ctx->pair->priv_key : NULL);
 }
 
 static int
@@ -314,9 +362,9 @@ xmlSecGCryptAsymKeyDataGetType(xmlSecKeyDataPtr data) {
     ctx = xmlSecGCryptAsymKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, xmlSecKeyDataTypeUnknown);
 
-    if((ctx->priv_key != NULL) && (ctx->pub_key != NULL)) {
+    if((ctx->pair != NULL) && (ctx->pair->priv_key != NULL) && (ctx->pair->pub_key != NULL)) {
         return (xmlSecKeyDataTypePrivate | xmlSecKeyDataTypePublic);
-    } else if(ctx->pub_key != NULL) {
+    } else if((ctx->pair != NULL) && (ctx->pair->pub_key != NULL)) {
         return (xmlSecKeyDataTypePublic);
     }
 
@@ -334,7 +382,7 @@ xmlSecGCryptAsymKeyDataGetSize(xmlSecKeyDataPtr data) {
     xmlSecAssert2(ctx != NULL, 0);
 
     /* use pub key since it is more often you have it than not */
-    return (ctx->pub_key != NULL) ? gcry_pk_get_nbits(ctx->pub_key) : 0;
+    return (ctx->pair != NULL) ? ctx->pair->nbits : 0;
 }
 
 /******************************************************************************
@@ -342,47 +390,6 @@ xmlSecGCryptAsymKeyDataGetSize(xmlSecKeyDataPtr data) {
  * helper functions
  *
  *****************************************************************************/
-static gcry_sexp_t
-xmlSecGCryptAsymSExpDup(gcry_sexp_t pKey) {
-    gcry_sexp_t res = NULL;
-    xmlSecByte *buf = NULL;
-    gcry_error_t err;
-    size_t size;
-
-    xmlSecAssert2(pKey != NULL, NULL);
-
-    size = gcry_sexp_sprint(pKey, GCRYSEXP_FMT_ADVANCED, NULL, 0);
-    if(size == 0) {
-        xmlSecGCryptError("gcry_sexp_sprint", GPG_ERR_NO_ERROR, NULL);
-        goto done;
-    }
-
-    buf = (xmlSecByte *)xmlMalloc(size);
-    if(buf == NULL) {
-        xmlSecMallocError(size, NULL);
-        goto done;
-    }
-
-    size = gcry_sexp_sprint(pKey, GCRYSEXP_FMT_ADVANCED, buf, size);
-    if(size == 0) {
-        xmlSecGCryptError2("gcry_sexp_sprint", GPG_ERR_NO_ERROR, NULL,
-                           "size=%lu", (unsigned long)size);
-        goto done;
-    }
-
-    err = gcry_sexp_new(&res, buf, size, 1);
-    if((err != GPG_ERR_NO_ERROR) || (res == NULL)) {
-        xmlSecGCryptError("gcry_sexp_new", err, NULL);
-        goto done;
-    }
-
-done:
-    if(buf != NULL) {
-        xmlFree(buf);
-    }
-    return (res);
-}
-
 /**
  * xmlSecGCryptNodeGetMpiValue:
  * @cur: the poitner to an XML node.
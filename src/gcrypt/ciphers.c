@@ -16,6 +16,7 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/gcrypt/crypto.h>
 
@@ -91,7 +92,12 @@ xmlSecGCryptBlockCipherCtxInit(xmlSecGCryptBlockCipherCtxPtr ctx,
         iv = xmlSecBufferGetData(out) + outSize;
 
         /* generate and use random iv */
-        gcry_randomize(iv, blockLen, GCRY_STRONG_RANDOM);
+        ret = xmlSecRandomGenerate(xmlSecGCryptGenerateRandomBytes, NULL, iv, blockLen);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecRandomGenerate", cipherName,
+                                 "size=%d", blockLen);
+            return(-1);
+        }
         err = gcry_cipher_setiv(ctx->cipherCtx, iv, blockLen);
         if(err != GPG_ERR_NO_ERROR) {
             xmlSecGCryptError("gcry_cipher_setiv", err,
@@ -253,8 +259,13 @@ xmlSecGCryptBlockCipherCtxFinal(xmlSecGCryptBlockCipherCtxPtr ctx,
 
         /* create random padding */
         if((xmlSecSize)blockLen > (inSize + 1)) {
-            gcry_randomize(inBuf + inSize, blockLen - inSize - 1,
-                        GCRY_STRONG_RANDOM); /* as usual, we are paranoid */
+            ret = xmlSecRandomGenerate(xmlSecGCryptGenerateRandomBytes, NULL,
+                                       inBuf + inSize, blockLen - inSize - 1);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecRandomGenerate", cipherName,
+                                     "size=%d", ((int)blockLen - inSize - 1));
+                return(-1);
+            }
         }
         inBuf[blockLen - 1] = blockLen - inSize;
         inSize = blockLen;
@@ -18,6 +18,7 @@
 #include <xmlsec/errors.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/private.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/gcrypt/app.h>
 #include <xmlsec/gcrypt/crypto.h>
@@ -280,7 +281,8 @@ xmlSecGCryptKeysMngrInit(xmlSecKeysMngrPtr mngr) {
  * @buffer:             the destination buffer.
  * @size:               the numer of bytes to generate.
  *
- * Generates @size random bytes and puts result in @buffer.
+ * Generates @size random bytes and puts result in @buffer
+ * (see #xmlSecRandomGenerate).
  *
  * Returns: 0 on success or a negative value otherwise.
  */
@@ -299,6 +301,30 @@ xmlSecGCryptGenerateRandom(xmlSecBufferPtr buffer, xmlSecSize size) {
     }
 
     /* get random data */
-    gcry_randomize(xmlSecBufferGetData(buffer), size, GCRY_STRONG_RANDOM);
+    ret = xmlSecRandomGenerate(xmlSecGCryptGenerateRandomBytes, NULL,
+                               xmlSecBufferGetData(buffer), size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL,
+                             "size=%d", size);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecGCryptGenerateRandomBytes:
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ * @context:            not used.
+ *
+ * The GCrypt random generator for #xmlSecRandomGenerate.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecGCryptGenerateRandomBytes(xmlSecByte* out, xmlSecSize outSize, void* context ATTRIBUTE_UNUSED) {
+    xmlSecAssert2(out != NULL, -1);
+
+    gcry_randomize(out, outSize, GCRY_STRONG_RANDOM);
     return(0);
 }
@@ -48,6 +48,10 @@ static xmlSecKWAesKlass xmlSecGCryptKWAesKlass = {
     xmlSecGCryptKWAesBlockEncrypt,          /* xmlSecKWAesBlockEncryptMethod       encrypt; */
     xmlSecGCryptKWAesBlockDecrypt,          /* xmlSecKWAesBlockDecryptMethod       decrypt; */
 
+    /* bulk operations */
+    NULL,                                   /* xmlSecKWAesWrapMethod               wrap; */
+    NULL,                                   /* xmlSecKWAesUnwrapMethod             unwrap; */
+
     /* for the future */
     NULL,                                   /* void*                               reserved0; */
     NULL                                    /* void*                               reserved1; */
@@ -23,6 +23,7 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/gcrypt/crypto.h>
 
@@ -400,12 +401,17 @@ static int
 xmlSecGCryptKWDes3GenerateRandom(void * context,
                                  xmlSecByte * out, xmlSecSize outSize) {
     xmlSecGCryptKWDes3CtxPtr ctx = (xmlSecGCryptKWDes3CtxPtr)context;
+    int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(outSize > 0, -1);
 
-    gcry_randomize(out, outSize, GCRY_STRONG_RANDOM);
+    ret = xmlSecRandomGenerate(xmlSecGCryptGenerateRandomBytes, NULL, out, outSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecRandomGenerate", NULL);
+        return(-1);
+    }
     return((int)outSize);
 }
 
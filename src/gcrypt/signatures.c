@@ -590,7 +590,6 @@ static int
 xmlSecGCryptDsaPkSign(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
                       const xmlSecByte* dgst, xmlSecSize dgstSize,
                       xmlSecBufferPtr out) {
-    gcry_mpi_t m_hash = NULL;
     gcry_sexp_t s_data = NULL;
     gcry_sexp_t s_sig = NULL;
     gcry_sexp_t s_r = NULL;
@@ -608,16 +607,11 @@ xmlSecGCryptDsaPkSign(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
     xmlSecAssert2(dgstSize > 0, -1);
     xmlSecAssert2(out != NULL, -1);
 
-    /* get the current digest, can't use "hash" :( */
-    err = gcry_mpi_scan(&m_hash, GCRYMPI_FMT_USG, dgst, dgstSize, NULL);
-    if((err != GPG_ERR_NO_ERROR) || (m_hash == NULL)) {
-        xmlSecGCryptError("gcry_mpi_scan(hash)", err, NULL);
-        goto done;
-    }
-
+    /* get the current digest, can't use "hash" :( but the raw value
+     * is read as an unsigned MPI so no need to create it ourselves */
     err = gcry_sexp_build (&s_data, NULL,
-                           "(data (flags raw)(value %m))",
-                           m_hash);
+                           "(data (flags raw)(value %b))",
+                           (int)dgstSize, dgst);
     if((err != GPG_ERR_NO_ERROR) || (s_data == NULL)) {
         xmlSecGCryptError("gcry_sexp_build(data)", err, NULL);
         goto done;
@@ -697,9 +691,6 @@ xmlSecGCryptDsaPkSign(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
     res = 0;
 
 done:
-    if(m_hash != NULL) {
-        gcry_mpi_release(m_hash);
-    }
     if(m_r != NULL) {
         gcry_mpi_release(m_r);
     }
@@ -727,10 +718,7 @@ static int
 xmlSecGCryptDsaPkVerify(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
                         const xmlSecByte* dgst, xmlSecSize dgstSize,
                         const xmlSecByte* data, xmlSecSize dataSize) {
-    gcry_mpi_t m_hash = NULL;
     gcry_sexp_t s_data = NULL;
-    gcry_mpi_t m_sig_r = NULL;
-    gcry_mpi_t m_sig_s = NULL;
     gcry_sexp_t s_sig = NULL;
     gpg_error_t err;
     int res = -1;
@@ -743,35 +731,18 @@ xmlSecGCryptDsaPkVerify(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
     xmlSecAssert2(dataSize == (20 + 20), -1);
 
     /* get the current digest, can't use "hash" :( */
-    err = gcry_mpi_scan(&m_hash, GCRYMPI_FMT_USG, dgst, dgstSize, NULL);
-    if((err != GPG_ERR_NO_ERROR) || (m_hash == NULL)) {
-        xmlSecGCryptError("gcry_mpi_scan(hash)", err, NULL);
-        goto done;
-    }
-
     err = gcry_sexp_build (&s_data, NULL,
-                           "(data (flags raw)(value %m))",
-                           m_hash);
+                           "(data (flags raw)(value %b))",
+                           (int)dgstSize, dgst);
     if((err != GPG_ERR_NO_ERROR) || (s_data == NULL)) {
         xmlSecGCryptError("gcry_sexp_build(data)", err, NULL);
         goto done;
     }
 
-    /* get the existing signature */
-    err = gcry_mpi_scan(&m_sig_r, GCRYMPI_FMT_USG, data, 20, NULL);
-    if((err != GPG_ERR_NO_ERROR) || (m_sig_r == NULL)) {
-        xmlSecGCryptError("gcry_mpi_scan(r)", err, NULL);
-        goto done;
-    }
-    err = gcry_mpi_scan(&m_sig_s, GCRYMPI_FMT_USG, data + 20, 20, NULL);
-    if((err != GPG_ERR_NO_ERROR) || (m_sig_s == NULL)) {
-        xmlSecGCryptError("gcry_mpi_scan(s)", err, NULL);
-        goto done;
-    }
-
+    /* get the existing signature: r and s are read as unsigned MPIs */
     err = gcry_sexp_build (&s_sig, NULL,
-                           "(sig-val(dsa(r %m)(s %m)))",
-                           m_sig_r, m_sig_s);
+                           "(sig-val(dsa(r %b)(s %b)))",
+                           20, data, 20, data + 20);
     if((err != GPG_ERR_NO_ERROR) || (s_sig == NULL)) {
         xmlSecGCryptError("gcry_sexp_build(sig-val)", err, NULL);
         goto done;
@@ -790,16 +761,6 @@ xmlSecGCryptDsaPkVerify(int digest ATTRIBUTE_UNUSED, xmlSecKeyDataPtr key_data,
 
     /* done */
 done:
-    if(m_hash != NULL) {
-        gcry_mpi_release(m_hash);
-    }
-    if(m_sig_r != NULL) {
-        gcry_mpi_release(m_sig_r);
-    }
-    if(m_sig_s != NULL) {
-        gcry_mpi_release(m_sig_s);
-    }
-
     if(s_data != NULL) {
         gcry_sexp_release(s_data);
     }
@@ -891,10 +852,33 @@ xmlSecGCryptTransformDsaSha1GetKlass(void) {
  * the RSA modulus.
  *
  ***************************************************************************/
+static const char*
+xmlSecGCryptRsaPkcs1GetDataFormat(int digest) {
+    /* prebuilt formats: no hash name lookup and formatting per signature */
+    switch(digest) {
+    case GCRY_MD_MD5:
+        return("(data (flags pkcs1)(hash md5 %b))");
+    case GCRY_MD_RMD160:
+        return("(data (flags pkcs1)(hash rmd160 %b))");
+    case GCRY_MD_SHA1:
+        return("(data (flags pkcs1)(hash sha1 %b))");
+    case GCRY_MD_SHA256:
+        return("(data (flags pkcs1)(hash sha256 %b))");
+    case GCRY_MD_SHA384:
+        return("(data (flags pkcs1)(hash sha384 %b))");
+    case GCRY_MD_SHA512:
+        return("(data (flags pkcs1)(hash sha512 %b))");
+    default:
+        xmlSecInvalidIntegerTypeError("digest", digest, "supported digest", NULL);
+        return(NULL);
+    }
+}
+
 static int
 xmlSecGCryptRsaPkcs1PkSign(int digest, xmlSecKeyDataPtr key_data,
                            const xmlSecByte* dgst, xmlSecSize dgstSize,
                            xmlSecBufferPtr out) {
+    const char* dataFormat;
     gcry_sexp_t s_data = NULL;
     gcry_mpi_t m_sig = NULL;
     gcry_sexp_t s_sig = NULL;
@@ -910,10 +894,12 @@ xmlSecGCryptRsaPkcs1PkSign(int digest, xmlSecKeyDataPtr key_data,
     xmlSecAssert2(out != NULL, -1);
 
     /* get the current digest */
-    err = gcry_sexp_build (&s_data, NULL,
-                           "(data (flags pkcs1)(hash %s %b))",
-                           gcry_md_algo_name(digest),
-                           (int)dgstSize, dgst);
+    dataFormat = xmlSecGCryptRsaPkcs1GetDataFormat(digest);
+    if(dataFormat == NULL) {
+        xmlSecInternalError("xmlSecGCryptRsaPkcs1GetDataFormat", NULL);
+        goto done;
+    }
+    err = gcry_sexp_build (&s_data, NULL, dataFormat, (int)dgstSize, dgst);
     if((err != GPG_ERR_NO_ERROR) || (s_data == NULL)) {
         xmlSecGCryptError("gcry_sexp_build(data)", err, NULL);
         goto done;
@@ -990,8 +976,8 @@ static int
 xmlSecGCryptRsaPkcs1PkVerify(int digest, xmlSecKeyDataPtr key_data,
                              const xmlSecByte* dgst, xmlSecSize dgstSize,
                              const xmlSecByte* data, xmlSecSize dataSize) {
+    const char* dataFormat;
     gcry_sexp_t s_data = NULL;
-    gcry_mpi_t m_sig = NULL;
     gcry_sexp_t s_sig = NULL;
     gpg_error_t err;
     int res = -1;
@@ -1004,25 +990,21 @@ xmlSecGCryptRsaPkcs1PkVerify(int digest, xmlSecKeyDataPtr key_data,
     xmlSecAssert2(dataSize > 0, -1);
 
     /* get the current digest */
-    err = gcry_sexp_build (&s_data, NULL,
-                           "(data (flags pkcs1)(hash %s %b))",
-                           gcry_md_algo_name(digest),
-                           (int)dgstSize, dgst);
-    if((err != GPG_ERR_NO_ERROR) || (s_data == NULL)) {
-        xmlSecGCryptError("gcry_sexp_build(data)", err, NULL);
+    dataFormat = xmlSecGCryptRsaPkcs1GetDataFormat(digest);
+    if(dataFormat == NULL) {
+        xmlSecInternalError("xmlSecGCryptRsaPkcs1GetDataFormat", NULL);
         goto done;
     }
-
-    /* get the existing signature */
-    err = gcry_mpi_scan(&m_sig, GCRYMPI_FMT_USG, data, dataSize, NULL);
-    if((err != GPG_ERR_NO_ERROR) || (m_sig == NULL)) {
-        xmlSecGCryptError("gcry_mpi_scan", err, NULL);
+    err = gcry_sexp_build (&s_data, NULL, dataFormat, (int)dgstSize, dgst);
+    if((err != GPG_ERR_NO_ERROR) || (s_data == NULL)) {
+        xmlSecGCryptError("gcry_sexp_build(data)", err, NULL);
         goto done;
     }
 
+    /* get the existing signature: s is read as an unsigned MPI */
     err = gcry_sexp_build (&s_sig, NULL,
-                           "(sig-val(rsa(s %m)))",
-                           m_sig);
+                           "(sig-val(rsa(s %b)))",
+                           (int)dataSize, data);
     if((err != GPG_ERR_NO_ERROR) || (s_sig == NULL)) {
         xmlSecGCryptError("gcry_sexp_build(sig-val)", err, NULL);
         goto done;
@@ -1041,10 +1023,6 @@ xmlSecGCryptRsaPkcs1PkVerify(int digest, xmlSecKeyDataPtr key_data,
 
     /* done */
 done:
-    if(m_sig != NULL) {
-        gcry_mpi_release(m_sig);
-    }
-
     if(s_data != NULL) {
         gcry_sexp_release(s_data);
     }
@@ -18,10 +18,12 @@
 #include <xmlsec/errors.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/private.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/gnutls/app.h>
 #include <xmlsec/gnutls/crypto.h>
 #include <xmlsec/gnutls/x509.h>
+#include <xmlsec/gcrypt/crypto.h>
 
 static xmlSecCryptoDLFunctionsPtr gXmlSecGnuTLSFunctions = NULL;
 
@@ -308,7 +310,8 @@ xmlSecGnuTLSKeysMngrInit(xmlSecKeysMngrPtr mngr) {
  * @buffer:             the destination buffer.
  * @size:               the numer of bytes to generate.
  *
- * Generates @size random bytes and puts result in @buffer.
+ * Generates @size random bytes and puts result in @buffer
+ * (see #xmlSecRandomGenerate).
  *
  * Returns: 0 on success or a negative value otherwise.
  */
@@ -327,6 +330,12 @@ xmlSecGnuTLSGenerateRandom(xmlSecBufferPtr buffer, xmlSecSize size) {
     }
 
     /* get random data */
-    gcry_randomize(xmlSecBufferGetData(buffer), size, GCRY_STRONG_RANDOM);
+    ret = xmlSecRandomGenerate(xmlSecGCryptGenerateRandomBytes, NULL,
+                               xmlSecBufferGetData(buffer), size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL,
+                             "size=%d", size);
+        return(-1);
+    }
     return(0);
 }
@@ -1459,8 +1459,11 @@ xmlSecGnuTLSKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data, xmlSecKeyPtr k
 
     if((ctx->keyCert == NULL) && (xmlSecPtrListGetSize(&(ctx->certsList)) > 0) && (xmlSecKeyGetValue(key) == NULL)) {
         gnutls_x509_crt_t cert;
+        void* span;
 
+        span = xmlSecTraceBegin(xmlSecTracePhaseX509Verify, NULL, keyInfoCtx->userData);
         cert = xmlSecGnuTLSX509StoreVerify(x509Store, &(ctx->certsList), &(ctx->crlsList), keyInfoCtx);
+        xmlSecTraceEnd(span, xmlSecTracePhaseX509Verify, (cert != NULL) ? 0 : -1);
         if(cert != NULL) {
             xmlSecKeyDataPtr keyValue;
 
@@ -1407,6 +1407,353 @@ done:
 }
 
 
+static int
+xmlSecGnuTLSDnAttrsCompare(const void* ll, const void* rr) {
+    const xmlSecGnuTLSDnAttr* llAttr = (const xmlSecGnuTLSDnAttr*)ll;
+    const xmlSecGnuTLSDnAttr* rrAttr = (const xmlSecGnuTLSDnAttr*)rr;
+    int ret;
+
+    ret = xmlStrcmp(llAttr->key, rrAttr->key);
+    if(ret != 0) {
+        return(ret);
+    }
+    return(xmlStrcmp(llAttr->value, rrAttr->value));
+}
+
+/**
+ * xmlSecGnuTLSDnNormalize:
+ * @dn:                 the DN string.
+ *
+ * Converts @dn to a canonical form that can be compared with xmlStrEqual
+ * (or used as a hash table key) instead of xmlSecGnuTLSDnAttrsEqual: the
+ * attribute keys are lower-cased ("emailAddress" becomes "email"), the
+ * attributes are sorted and every value is prefixed with its length.
+ *
+ * Returns: the newly allocated string or NULL if an error occurs.
+ */
+xmlChar*
+xmlSecGnuTLSDnNormalize(const xmlChar* dn) {
+    xmlSecGnuTLSDnAttr attrs[XMLSEC_GNUTLS_DN_ATTRS_SIZE];
+    xmlChar* res = NULL;
+    xmlChar* p;
+    xmlChar* q;
+    xmlSecSize ii, num, size;
+    int ret;
+
+    xmlSecAssert2(dn != NULL, NULL);
+
+    xmlSecGnuTLSDnAttrsInitialize(attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+    ret = xmlSecGnuTLSDnAttrsParse(dn, attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSDnAttrsParse", NULL);
+        goto done;
+    }
+
+    /* normalize keys and calculate the result size */
+    for(num = 0, size = 1; (num < XMLSEC_GNUTLS_DN_ATTRS_SIZE) && (attrs[num].key != NULL); ++num) {
+        for(q = attrs[num].key; (*q) != '\0'; ++q) {
+            (*q) = (xmlChar)tolower(*q);
+        }
+        if(xmlStrcmp(attrs[num].key, BAD_CAST "emailaddress") == 0) {
+            attrs[num].key[5] = '\0';
+        }
+        /* "<key>=<value size>:<value>;" */
+        size += xmlStrlen(attrs[num].key) + xmlStrlen(attrs[num].value) + 24;
+    }
+    if(num > 1) {
+        qsort(attrs, num, sizeof(xmlSecGnuTLSDnAttr), xmlSecGnuTLSDnAttrsCompare);
+    }
+
+    res = (xmlChar*)xmlMalloc(size);
+    if(res == NULL) {
+        xmlSecMallocError(size, NULL);
+        goto done;
+    }
+    for(ii = 0, p = res; ii < num; ++ii) {
+        ret = xmlStrPrintf(p, (int)(size - (p - res)), "%s=%d:%s;",
+                           attrs[ii].key,
+                           xmlStrlen(attrs[ii].value),
+                           (attrs[ii].value != NULL) ? (char*)attrs[ii].value : "");
+        if(ret < 0) {
+            xmlSecXmlError("xmlStrPrintf", NULL);
+            xmlFree(res);
+            res = NULL;
+            goto done;
+        }
+        p += ret;
+    }
+    (*p) = '\0';
+
+done:
+    xmlSecGnuTLSDnAttrsDeinitialize(attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
+    return(res);
+}
+
+/**
+ * xmlSecGnuTLSDnGetKey:
+ * @dn:                 the DN string.
+ *
+ * Normalizes @dn with xmlSecGnuTLSDnNormalize. If @dn can't be parsed
+ * then it is copied as-is (i.e. only the exact match is possible).
+ *
+ * Returns: the newly allocated string or NULL if an error occurs.
+ */
+xmlChar*
+xmlSecGnuTLSDnGetKey(const xmlChar *dn) {
+    xmlChar* res;
+
+    xmlSecAssert2(dn != NULL, NULL);
+
+    res = xmlSecGnuTLSDnNormalize(dn);
+    if(res == NULL) {
+        /* we can't parse it: fall back to the exact match */
+        res = xmlStrdup(dn);
+        if(res == NULL) {
+            xmlSecStrdupError(dn, NULL);
+            return(NULL);
+        }
+    }
+    return(res);
+}
+
+/* FNV-1a: the hash only filters the candidates, the keys are compared anyway */
+static unsigned int
+xmlSecGnuTLSDnKeyHash(const xmlChar* key) {
+    unsigned int hash = 2166136261U;
+
+    xmlSecAssert2(key != NULL, 0);
+
+    for(; (*key) != '\0'; ++key) {
+        hash = (hash ^ (*key)) * 16777619U;
+    }
+    return(hash);
+}
+
+static int
+xmlSecGnuTLSX509DnIndexEntryInitialize(xmlSecGnuTLSX509DnIndexEntry* entry, gnutls_x509_crt_t cert) {
+    xmlChar* dn;
+
+    xmlSecAssert2(entry != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    memset(entry, 0, sizeof(xmlSecGnuTLSX509DnIndexEntry));
+    entry->cert = cert;
+
+    dn = xmlSecGnuTLSX509CertGetSubjectDN(cert);
+    if(dn == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetSubjectDN", NULL);
+        return(-1);
+    }
+    entry->subject = xmlSecGnuTLSDnGetKey(dn);
+    xmlFree(dn);
+    if(entry->subject == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSDnGetKey(subject)", NULL);
+        return(-1);
+    }
+    entry->subjectHash = xmlSecGnuTLSDnKeyHash(entry->subject);
+
+    dn = xmlSecGnuTLSX509CertGetIssuerDN(cert);
+    if(dn == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerDN", NULL);
+        return(-1);
+    }
+    entry->issuer = xmlSecGnuTLSDnGetKey(dn);
+    xmlFree(dn);
+    if(entry->issuer == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSDnGetKey(issuer)", NULL);
+        return(-1);
+    }
+    entry->issuerHash = xmlSecGnuTLSDnKeyHash(entry->issuer);
+
+    return(0);
+}
+
+static void
+xmlSecGnuTLSX509DnIndexEntryFinalize(xmlSecGnuTLSX509DnIndexEntry* entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->subject != NULL) {
+        xmlFree(entry->subject);
+    }
+    if(entry->issuer != NULL) {
+        xmlFree(entry->issuer);
+    }
+    memset(entry, 0, sizeof(xmlSecGnuTLSX509DnIndexEntry));
+}
+
+/**
+ * xmlSecGnuTLSX509DnIndexInitialize:
+ * @dnIndex:            the pointer to DN index.
+ * @certs:              the certs list.
+ *
+ * Normalizes the subject and issuer DNs of all the certs in @certs. The
+ * index doesn't own the certs and @certs should not change while the
+ * index is in use.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecGnuTLSX509DnIndexInitialize(xmlSecGnuTLSX509DnIndexPtr dnIndex, xmlSecPtrListPtr certs) {
+    gnutls_x509_crt_t cert;
+    xmlSecSize ii, size;
+    int ret;
+
+    xmlSecAssert2(dnIndex != NULL, -1);
+    xmlSecAssert2(certs != NULL, -1);
+
+    memset(dnIndex, 0, sizeof(xmlSecGnuTLSX509DnIndex));
+
+    size = xmlSecPtrListGetSize(certs);
+    if(size <= 0) {
+        return(0);
+    }
+
+    dnIndex->entries = (xmlSecGnuTLSX509DnIndexEntry*)xmlMalloc(sizeof(xmlSecGnuTLSX509DnIndexEntry) * size);
+    if(dnIndex->entries == NULL) {
+        xmlSecMallocError(sizeof(xmlSecGnuTLSX509DnIndexEntry) * size, NULL);
+        return(-1);
+    }
+    memset(dnIndex->entries, 0, sizeof(xmlSecGnuTLSX509DnIndexEntry) * size);
+
+    for(ii = 0; ii < size; ++ii) {
+        cert = xmlSecPtrListGetItem(certs, ii);
+        if(cert == NULL) {
+            xmlSecInternalError2("xmlSecPtrListGetItem", NULL,
+                                 "pos=%i", (int)ii);
+            return(-1);
+        }
+
+        /* entries are finalized up to the dnIndex->size */
+        ++dnIndex->size;
+        ret = xmlSecGnuTLSX509DnIndexEntryInitialize(&(dnIndex->entries[ii]), cert);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecGnuTLSX509DnIndexEntryInitialize", NULL,
+                                 "pos=%i", (int)ii);
+            return(-1);
+        }
+    }
+
+    return(0);
+}
+
+/**
+ * xmlSecGnuTLSX509DnIndexFinalize:
+ * @dnIndex:            the pointer to DN index.
+ *
+ * Releases the memory allocated by the DN index.
+ */
+void
+xmlSecGnuTLSX509DnIndexFinalize(xmlSecGnuTLSX509DnIndexPtr dnIndex) {
+    xmlSecSize ii;
+
+    xmlSecAssert(dnIndex != NULL);
+
+    if(dnIndex->entries != NULL) {
+        for(ii = 0; ii < dnIndex->size; ++ii) {
+            xmlSecGnuTLSX509DnIndexEntryFinalize(&(dnIndex->entries[ii]));
+        }
+        xmlFree(dnIndex->entries);
+    }
+    memset(dnIndex, 0, sizeof(xmlSecGnuTLSX509DnIndex));
+}
+
+static xmlSecGnuTLSX509DnIndexEntry*
+xmlSecGnuTLSX509DnIndexGetEntry(xmlSecGnuTLSX509DnIndexPtr dnIndex, gnutls_x509_crt_t cert) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(dnIndex != NULL, NULL);
+    xmlSecAssert2(cert != NULL, NULL);
+
+    for(ii = 0; ii < dnIndex->size; ++ii) {
+        if(dnIndex->entries[ii].cert == cert) {
+            return(&(dnIndex->entries[ii]));
+        }
+    }
+    return(NULL);
+}
+
+/**
+ * xmlSecGnuTLSX509DnIndexFindSigned:
+ * @dnIndex:            the pointer to DN index.
+ * @cert:               the cert from the index.
+ *
+ * Searches @dnIndex for a cert with the issuer DN equal to the @cert
+ * subject DN.
+ *
+ * Returns: the found cert or NULL if the cert is not found or an error occurs.
+ */
+gnutls_x509_crt_t
+xmlSecGnuTLSX509DnIndexFindSigned(xmlSecGnuTLSX509DnIndexPtr dnIndex, gnutls_x509_crt_t cert) {
+    xmlSecGnuTLSX509DnIndexEntry* entry;
+    xmlSecSize ii;
+
+    xmlSecAssert2(dnIndex != NULL, NULL);
+    xmlSecAssert2(cert != NULL, NULL);
+
+    entry = xmlSecGnuTLSX509DnIndexGetEntry(dnIndex, cert);
+    if(entry == NULL) {
+        xmlSecInvalidDataError("the cert is not in the DN index", NULL);
+        return(NULL);
+    }
+
+    for(ii = 0; ii < dnIndex->size; ++ii) {
+        if((dnIndex->entries[ii].issuerHash == entry->subjectHash) &&
+           xmlStrEqual(dnIndex->entries[ii].issuer, entry->subject))
+        {
+            return(dnIndex->entries[ii].cert);
+        }
+    }
+    return(NULL);
+}
+
+/**
+ * xmlSecGnuTLSX509DnIndexFindSigner:
+ * @dnIndex:            the pointer to DN index.
+ * @cert:               the cert (not necessary from the index).
+ *
+ * Searches @dnIndex for a cert with the subject DN equal to the @cert
+ * issuer DN.
+ *
+ * Returns: the found cert or NULL if the cert is not found or an error occurs.
+ */
+gnutls_x509_crt_t
+xmlSecGnuTLSX509DnIndexFindSigner(xmlSecGnuTLSX509DnIndexPtr dnIndex, gnutls_x509_crt_t cert) {
+    xmlSecGnuTLSX509DnIndexEntry* entry;
+    xmlSecGnuTLSX509DnIndexEntry tmp;
+    gnutls_x509_crt_t res = NULL;
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(dnIndex != NULL, NULL);
+    xmlSecAssert2(cert != NULL, NULL);
+
+    /* the certs from the store are not in the index */
+    entry = xmlSecGnuTLSX509DnIndexGetEntry(dnIndex, cert);
+    if(entry == NULL) {
+        ret = xmlSecGnuTLSX509DnIndexEntryInitialize(&tmp, cert);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509DnIndexEntryInitialize", NULL);
+            xmlSecGnuTLSX509DnIndexEntryFinalize(&tmp);
+            return(NULL);
+        }
+        entry = &tmp;
+    }
+
+    for(ii = 0; ii < dnIndex->size; ++ii) {
+        if((dnIndex->entries[ii].subjectHash == entry->issuerHash) &&
+           xmlStrEqual(dnIndex->entries[ii].subject, entry->issuer))
+        {
+            res = dnIndex->entries[ii].cert;
+            break;
+        }
+    }
+
+    if(entry == &tmp) {
+        xmlSecGnuTLSX509DnIndexEntryFinalize(&tmp);
+    }
+    return(res);
+}
+
 #endif /* XMLSEC_NO_X509 */
 
 
@@ -114,6 +114,8 @@ xmlSecKeyDataPtr        xmlSecGnuTLSCreateKeyDataAndAdoptPrivKey(gnutls_x509_pri
  * LDAP DN parser
  *
  ************************************************************************/
+#define XMLSEC_GNUTLS_DN_ATTRS_SIZE             1024
+
 typedef struct _xmlSecGnuTLSDnAttr {
     xmlChar * key;
     xmlChar * value;
@@ -133,6 +135,35 @@ int                     xmlSecGnuTLSDnAttrsEqual                (const xmlSecGnu
 int                     xmlSecGnuTLSDnAttrsParse                (const xmlChar * dn,
                                                                  xmlSecGnuTLSDnAttr * attrs,
                                                                  xmlSecSize attrsSize);
+xmlChar*                xmlSecGnuTLSDnNormalize                 (const xmlChar * dn);
+xmlChar*                xmlSecGnuTLSDnGetKey                    (const xmlChar * dn);
+
+/*************************************************************************
+ *
+ * Certs DN index: the subject and issuer DNs are normalized once
+ * (see xmlSecGnuTLSDnGetKey) and compared by hash and string
+ *
+ ************************************************************************/
+typedef struct _xmlSecGnuTLSX509DnIndexEntry {
+    gnutls_x509_crt_t   cert;
+    xmlChar *           subject;
+    xmlChar *           issuer;
+    unsigned int        subjectHash;
+    unsigned int        issuerHash;
+} xmlSecGnuTLSX509DnIndexEntry;
+
+typedef struct _xmlSecGnuTLSX509DnIndex {
+    xmlSecGnuTLSX509DnIndexEntry * entries;
+    xmlSecSize                     size;
+} xmlSecGnuTLSX509DnIndex, *xmlSecGnuTLSX509DnIndexPtr;
+
+int                     xmlSecGnuTLSX509DnIndexInitialize       (xmlSecGnuTLSX509DnIndexPtr dnIndex,
+                                                                 xmlSecPtrListPtr certs);
+void                    xmlSecGnuTLSX509DnIndexFinalize         (xmlSecGnuTLSX509DnIndexPtr dnIndex);
+gnutls_x509_crt_t       xmlSecGnuTLSX509DnIndexFindSigned       (xmlSecGnuTLSX509DnIndexPtr dnIndex,
+                                                                 gnutls_x509_crt_t cert);
+gnutls_x509_crt_t       xmlSecGnuTLSX509DnIndexFindSigner       (xmlSecGnuTLSX509DnIndexPtr dnIndex,
+                                                                 gnutls_x509_crt_t cert);
 #endif /* XMLSEC_NO_X509 */
 
 #ifdef __cplusplus
@@ -20,6 +20,12 @@
 #include <errno.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+
+#include <gnutls/gnutls.h>
+#include <gnutls/x509.h>
+#include <gnutls/crypto.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -39,11 +45,56 @@
  * Internal GnuTLS X509 store CTX
  *
  *************************************************************************/
+/**
+ * XMLSEC_GNUTLS_X509_VERIFY_CACHE_SIZE:
+ *
+ * The max number of successfully verified certificate chains remembered
+ * by the GnuTLS X509 store.
+ */
+#define XMLSEC_GNUTLS_X509_VERIFY_CACHE_SIZE                    64
+
+#define XMLSEC_GNUTLS_X509_VERIFY_CACHE_MD_SIZE                 32
+
+/*
+ * The certs are indexed when they are adopted by the store: the DNs are
+ * normalized (see xmlSecGnuTLSDnNormalize) so the lookups are simple hash
+ * table searches instead of parsing and comparing DNs for every cert.
+ * The index doesn't own the certs, the first adopted cert wins.
+ */
+typedef struct _xmlSecGnuTLSX509CertsIndex {
+    xmlHashTablePtr     bySubject;      /* subject DN -> cert */
+    xmlHashTablePtr     byIssuerSerial; /* issuer DN, serial -> cert */
+    xmlHashTablePtr     bySki;          /* base64 SKI -> cert */
+} xmlSecGnuTLSX509CertsIndex, *xmlSecGnuTLSX509CertsIndexPtr;
+
+/*
+ * The verified chains cache entry: SHA-256 over the verification flags
+ * and the SHA-256 fingerprints of all the certs in the chain. Only the
+ * gnutls_x509_crt_list_verify() result is cached, the certs validity
+ * time is always checked. The cache is flushed every time the store changes.
+ */
+typedef struct _xmlSecGnuTLSX509VerifyCacheEntry        xmlSecGnuTLSX509VerifyCacheEntry,
+                                                        *xmlSecGnuTLSX509VerifyCacheEntryPtr;
+struct _xmlSecGnuTLSX509VerifyCacheEntry {
+    unsigned char                       md[XMLSEC_GNUTLS_X509_VERIFY_CACHE_MD_SIZE];
+    xmlSecGnuTLSX509VerifyCacheEntryPtr prev;
+    xmlSecGnuTLSX509VerifyCacheEntryPtr next;
+};
+
 typedef struct _xmlSecGnuTLSX509StoreCtx                xmlSecGnuTLSX509StoreCtx,
                                                         *xmlSecGnuTLSX509StoreCtxPtr;
 struct _xmlSecGnuTLSX509StoreCtx {
     xmlSecPtrList certsTrusted;
     xmlSecPtrList certsUntrusted;
+
+    xmlSecGnuTLSX509CertsIndex          trustedIndex;
+    xmlSecGnuTLSX509CertsIndex          untrustedIndex;
+
+    /* verified chains cache */
+    xmlSecGnuTLSX509VerifyCacheEntryPtr cacheHead;
+    xmlSecGnuTLSX509VerifyCacheEntryPtr cacheTail;
+    xmlSecSize                          cacheSize;
+    xmlMutexPtr                         cacheMutex;
 };
 
 /****************************************************************************
@@ -78,16 +129,28 @@ static xmlSecKeyDataStoreKlass xmlSecGnuTLSX509StoreKlass = {
     NULL,                                       /* void* reserved1; */
 };
 
-static gnutls_x509_crt_t xmlSecGnuTLSX509FindCert                       (xmlSecPtrListPtr certs,
-                                                                         const xmlChar *subjectName,
-                                                                         const xmlChar *issuerName,
+static int              xmlSecGnuTLSX509CertsIndexInitialize            (xmlSecGnuTLSX509CertsIndexPtr certsIndex);
+static void             xmlSecGnuTLSX509CertsIndexFinalize              (xmlSecGnuTLSX509CertsIndexPtr certsIndex);
+static int              xmlSecGnuTLSX509CertsIndexAdd                   (xmlSecGnuTLSX509CertsIndexPtr certsIndex,
+                                                                         gnutls_x509_crt_t cert);
+static gnutls_x509_crt_t xmlSecGnuTLSX509CertsIndexFind                 (xmlSecGnuTLSX509CertsIndexPtr certsIndex,
+                                                                         const xmlChar *subjectKey,
+                                                                         const xmlChar *issuerKey,
                                                                          const xmlChar *issuerSerial,
                                                                          const xmlChar *ski);
-static gnutls_x509_crt_t xmlSecGnuTLSX509FindSignedCert                 (xmlSecPtrListPtr certs,
-                                                                         gnutls_x509_crt_t cert);
-static gnutls_x509_crt_t xmlSecGnuTLSX509FindSignerCert                 (xmlSecPtrListPtr certs,
+static gnutls_x509_crt_t xmlSecGnuTLSX509StoreFindSignerCert            (xmlSecGnuTLSX509StoreCtxPtr ctx,
                                                                          gnutls_x509_crt_t cert);
 
+static int              xmlSecGnuTLSX509ChainDigest                     (gnutls_x509_crt_t * cert_list,
+                                                                         xmlSecSize cert_list_length,
+                                                                         unsigned int flags,
+                                                                         unsigned char * md);
+static int              xmlSecGnuTLSX509VerifyCacheLookup               (xmlSecGnuTLSX509StoreCtxPtr ctx,
+                                                                         const unsigned char * md);
+static int              xmlSecGnuTLSX509VerifyCacheAdd                  (xmlSecGnuTLSX509StoreCtxPtr ctx,
+                                                                         const unsigned char * md);
+static void             xmlSecGnuTLSX509VerifyCacheFlush                (xmlSecGnuTLSX509StoreCtxPtr ctx);
+
 
 /**
  * xmlSecGnuTLSX509StoreGetKlass:
@@ -124,6 +187,8 @@ xmlSecGnuTLSX509StoreFindCert(xmlSecKeyDataStorePtr store,
                               const xmlSecKeyInfoCtx* keyInfoCtx) {
     xmlSecGnuTLSX509StoreCtxPtr ctx;
     gnutls_x509_crt_t res = NULL;
+    xmlChar * subjectKey = NULL;
+    xmlChar * issuerKey = NULL;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecGnuTLSX509StoreId), NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
@@ -131,11 +196,35 @@ xmlSecGnuTLSX509StoreFindCert(xmlSecKeyDataStorePtr store,
     ctx = xmlSecGnuTLSX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, NULL);
 
+    /* normalize the DNs once for both indexes */
+    if(subjectName != NULL) {
+        subjectKey = xmlSecGnuTLSDnGetKey(subjectName);
+        if(subjectKey == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSDnGetKey(subject)",
+                                xmlSecKeyDataStoreGetName(store));
+            return(NULL);
+        }
+    } else if((issuerName != NULL) && (issuerSerial != NULL)) {
+        issuerKey = xmlSecGnuTLSDnGetKey(issuerName);
+        if(issuerKey == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSDnGetKey(issuer)",
+                                xmlSecKeyDataStoreGetName(store));
+            return(NULL);
+        }
+    }
+
     if(res == NULL) {
-        res = xmlSecGnuTLSX509FindCert(&(ctx->certsTrusted), subjectName, issuerName, issuerSerial, ski);
+        res = xmlSecGnuTLSX509CertsIndexFind(&(ctx->trustedIndex), subjectKey, issuerKey, issuerSerial, ski);
     }
     if(res == NULL) {
-        res = xmlSecGnuTLSX509FindCert(&(ctx->certsUntrusted), subjectName, issuerName, issuerSerial, ski);
+        res = xmlSecGnuTLSX509CertsIndexFind(&(ctx->untrustedIndex), subjectKey, issuerKey, issuerSerial, ski);
+    }
+
+    if(subjectKey != NULL) {
+        xmlFree(subjectKey);
+    }
+    if(issuerKey != NULL) {
+        xmlFree(issuerKey);
     }
     return(res);
 }
@@ -214,8 +303,11 @@ xmlSecGnuTLSX509StoreVerify(xmlSecKeyDataStorePtr store,
     xmlSecSize crl_list_length;
     gnutls_x509_crt_t * ca_list = NULL;
     xmlSecSize ca_list_length;
+    xmlSecGnuTLSX509DnIndex dnIndex;
     time_t verification_time;
     unsigned int flags = 0;
+    unsigned char md[XMLSEC_GNUTLS_X509_VERIFY_CACHE_MD_SIZE];
+    int useCache;
     xmlSecSize ii;
     int ret;
     int err;
@@ -234,7 +326,14 @@ xmlSecGnuTLSX509StoreVerify(xmlSecKeyDataStorePtr store,
     ctx = xmlSecGnuTLSX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, NULL);
 
-    /* Prepare */
+    /* Prepare: the DNs are normalized once for all the chains */
+    ret = xmlSecGnuTLSX509DnIndexInitialize(&dnIndex, certs);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509DnIndexInitialize",
+                            xmlSecKeyDataStoreGetName(store));
+        xmlSecGnuTLSX509DnIndexFinalize(&dnIndex);
+        return(NULL);
+    }
     cert_list_length = certs_size + xmlSecPtrListGetSize(&(ctx->certsUntrusted));
     if(cert_list_length > 0) {
         cert_list = (gnutls_x509_crt_t *)xmlMalloc(sizeof(gnutls_x509_crt_t) * cert_list_length);
@@ -292,6 +391,9 @@ xmlSecGnuTLSX509StoreVerify(xmlSecKeyDataStorePtr store,
         flags |= GNUTLS_VERIFY_ALLOW_SIGN_RSA_MD5;
     }
 
+    /* the CRLs come with the document, don't bother caching the results for them */
+    useCache = ((crl_list_length == 0) && (ctx->cacheMutex != NULL)) ? 1 : 0;
+
     /* We are going to build all possible cert chains and try to verify them */
     for(ii = 0; (ii < certs_size) && (res == NULL); ++ii) {
         gnutls_x509_crt_t cert, cert2;
@@ -306,7 +408,7 @@ xmlSecGnuTLSX509StoreVerify(xmlSecKeyDataStorePtr store,
         }
 
         /* check if we are the "leaf" node in the certs chain */
-        if(xmlSecGnuTLSX509FindSignedCert(certs, cert) != NULL) {
+        if(xmlSecGnuTLSX509DnIndexFindSigned(&dnIndex, cert) != NULL) {
             continue;
         }
 
@@ -321,21 +423,44 @@ xmlSecGnuTLSX509StoreVerify(xmlSecKeyDataStorePtr store,
             cert_list[cert_list_cur_length] = cert2;
 
             /* find next */
-            tmp = xmlSecGnuTLSX509FindSignerCert(certs, cert2);
+            tmp = xmlSecGnuTLSX509DnIndexFindSigner(&dnIndex, cert2);
             if(tmp == NULL) {
-                tmp = xmlSecGnuTLSX509FindSignerCert(&(ctx->certsUntrusted), cert2);
+                tmp = xmlSecGnuTLSX509StoreFindSignerCert(ctx, cert2);
             }
             cert2 = tmp;
         }
 
         /* try to verify */
 	if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) {
-            err = gnutls_x509_crt_list_verify(
-                    cert_list, (int)cert_list_cur_length, /* certs chain */
-                    ca_list, (int)ca_list_length, /* trusted cas */
-                    crl_list, (int)crl_list_length, /* crls */
-                    flags, /* flags */
-                    &verify);
+            /* did we verify this chain already? */
+            ret = 0;
+            if(useCache != 0) {
+                ret = xmlSecGnuTLSX509ChainDigest(cert_list, cert_list_cur_length, flags, md);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecGnuTLSX509ChainDigest",
+                                        xmlSecKeyDataStoreGetName(store));
+                    goto done;
+                }
+                ret = xmlSecGnuTLSX509VerifyCacheLookup(ctx, md);
+            }
+            if(ret == 1) {
+                err = GNUTLS_E_SUCCESS;
+            } else {
+                err = gnutls_x509_crt_list_verify(
+                        cert_list, (int)cert_list_cur_length, /* certs chain */
+                        ca_list, (int)ca_list_length, /* trusted cas */
+                        crl_list, (int)crl_list_length, /* crls */
+                        flags, /* flags */
+                        &verify);
+                if((useCache != 0) && (err == GNUTLS_E_SUCCESS) && (verify == 0)) {
+                    ret = xmlSecGnuTLSX509VerifyCacheAdd(ctx, md);
+                    if(ret < 0) {
+                        xmlSecInternalError("xmlSecGnuTLSX509VerifyCacheAdd",
+                                            xmlSecKeyDataStoreGetName(store));
+                        goto done;
+                    }
+                }
+            }
         } else {
             err = GNUTLS_E_SUCCESS;
         }
@@ -375,6 +500,7 @@ done:
     if(cert_list != NULL) {
         xmlFree(cert_list);
     }
+    xmlSecGnuTLSX509DnIndexFinalize(&dnIndex);
 
     return(res);
 }
@@ -400,6 +526,9 @@ xmlSecGnuTLSX509StoreAdoptCert(xmlSecKeyDataStorePtr store, gnutls_x509_crt_t ce
     ctx = xmlSecGnuTLSX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
 
+    /* the store changed: forget the previous verification results */
+    xmlSecGnuTLSX509VerifyCacheFlush(ctx);
+
     if((type & xmlSecKeyDataTypeTrusted) != 0) {
         ret = xmlSecPtrListAdd(&(ctx->certsTrusted), cert);
         if(ret < 0) {
@@ -407,6 +536,14 @@ xmlSecGnuTLSX509StoreAdoptCert(xmlSecKeyDataStorePtr store, gnutls_x509_crt_t ce
                                 xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
+        ret = xmlSecGnuTLSX509CertsIndexAdd(&(ctx->trustedIndex), cert);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAdd(trusted)",
+                                xmlSecKeyDataStoreGetName(store));
+            /* the caller still owns the cert on error */
+            xmlSecPtrListRemoveAndReturn(&(ctx->certsTrusted), xmlSecPtrListGetSize(&(ctx->certsTrusted)) - 1);
+            return(-1);
+        }
     } else {
         ret = xmlSecPtrListAdd(&(ctx->certsUntrusted), cert);
         if(ret < 0) {
@@ -414,6 +551,14 @@ xmlSecGnuTLSX509StoreAdoptCert(xmlSecKeyDataStorePtr store, gnutls_x509_crt_t ce
                                 xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
+        ret = xmlSecGnuTLSX509CertsIndexAdd(&(ctx->untrustedIndex), cert);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertsIndexAdd(untrusted)",
+                                xmlSecKeyDataStoreGetName(store));
+            /* the caller still owns the cert on error */
+            xmlSecPtrListRemoveAndReturn(&(ctx->certsUntrusted), xmlSecPtrListGetSize(&(ctx->certsUntrusted)) - 1);
+            return(-1);
+        }
     }
 
     /* done */
@@ -446,6 +591,26 @@ xmlSecGnuTLSX509StoreInitialize(xmlSecKeyDataStorePtr store) {
         return(-1);
     }
 
+    ret = xmlSecGnuTLSX509CertsIndexInitialize(&(ctx->trustedIndex));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexInitialize(trusted)",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecGnuTLSX509CertsIndexInitialize(&(ctx->untrustedIndex));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertsIndexInitialize(untrusted)",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->cacheMutex = xmlNewMutex();
+    if(ctx->cacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
     return(0);
 }
 
@@ -457,6 +622,12 @@ xmlSecGnuTLSX509StoreFinalize(xmlSecKeyDataStorePtr store) {
     ctx = xmlSecGnuTLSX509StoreGetCtx(store);
     xmlSecAssert(ctx != NULL);
 
+    xmlSecGnuTLSX509VerifyCacheFlush(ctx);
+    if(ctx->cacheMutex != NULL) {
+        xmlFreeMutex(ctx->cacheMutex);
+    }
+    xmlSecGnuTLSX509CertsIndexFinalize(&(ctx->trustedIndex));
+    xmlSecGnuTLSX509CertsIndexFinalize(&(ctx->untrustedIndex));
     xmlSecPtrListFinalize(&(ctx->certsTrusted));
     xmlSecPtrListFinalize(&(ctx->certsUntrusted));
 
@@ -469,240 +640,348 @@ xmlSecGnuTLSX509StoreFinalize(xmlSecKeyDataStorePtr store) {
  * Low-level x509 functions
  *
  *****************************************************************************/
-#define XMLSEC_GNUTLS_DN_ATTRS_SIZE             1024
+static int
+xmlSecGnuTLSX509CertsIndexInitialize(xmlSecGnuTLSX509CertsIndexPtr certsIndex) {
+    xmlSecAssert2(certsIndex != NULL, -1);
+
+    memset(certsIndex, 0, sizeof(xmlSecGnuTLSX509CertsIndex));
 
+    certsIndex->bySubject = xmlHashCreate(0);
+    if(certsIndex->bySubject == NULL) {
+        xmlSecXmlError("xmlHashCreate(bySubject)", NULL);
+        return(-1);
+    }
+    certsIndex->byIssuerSerial = xmlHashCreate(0);
+    if(certsIndex->byIssuerSerial == NULL) {
+        xmlSecXmlError("xmlHashCreate(byIssuerSerial)", NULL);
+        return(-1);
+    }
+    certsIndex->bySki = xmlHashCreate(0);
+    if(certsIndex->bySki == NULL) {
+        xmlSecXmlError("xmlHashCreate(bySki)", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecGnuTLSX509CertsIndexFinalize(xmlSecGnuTLSX509CertsIndexPtr certsIndex) {
+    xmlSecAssert(certsIndex != NULL);
+
+    /* the certs are owned by the lists */
+    if(certsIndex->bySubject != NULL) {
+        xmlHashFree(certsIndex->bySubject, NULL);
+    }
+    if(certsIndex->byIssuerSerial != NULL) {
+        xmlHashFree(certsIndex->byIssuerSerial, NULL);
+    }
+    if(certsIndex->bySki != NULL) {
+        xmlHashFree(certsIndex->bySki, NULL);
+    }
+    memset(certsIndex, 0, sizeof(xmlSecGnuTLSX509CertsIndex));
+}
+
+/* either all or none of the cert keys are added to the index */
 static int
-xmlSecGnuTLSX509DnsEqual(const xmlChar * ll, const xmlChar * rr) {
-    xmlSecGnuTLSDnAttr ll_attrs[XMLSEC_GNUTLS_DN_ATTRS_SIZE];
-    xmlSecGnuTLSDnAttr rr_attrs[XMLSEC_GNUTLS_DN_ATTRS_SIZE];
+xmlSecGnuTLSX509CertsIndexAdd(xmlSecGnuTLSX509CertsIndexPtr certsIndex, gnutls_x509_crt_t cert) {
+    xmlChar * dn = NULL;
+    xmlChar * subjectKey = NULL;
+    xmlChar * issuerKey = NULL;
+    xmlChar * serial = NULL;
+    xmlChar * ski = NULL;
+    size_t skiSize = 0;
+    unsigned int critical = 0;
+    int addedSubject = 0;
+    int addedIssuerSerial = 0;
+    int err;
     int ret;
     int res = -1;
 
-    xmlSecAssert2(ll != NULL, -1);
-    xmlSecAssert2(rr != NULL, -1);
+    xmlSecAssert2(certsIndex != NULL, -1);
+    xmlSecAssert2(certsIndex->bySubject != NULL, -1);
+    xmlSecAssert2(certsIndex->byIssuerSerial != NULL, -1);
+    xmlSecAssert2(certsIndex->bySki != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
 
-    /* fast version first */
-    if(xmlStrEqual(ll, rr)) {
-        return(1);
+    /* get all the keys first */
+    dn = xmlSecGnuTLSX509CertGetSubjectDN(cert);
+    if(dn == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetSubjectDN", NULL);
+        goto done;
     }
-
-    /* prepare */
-    xmlSecGnuTLSDnAttrsInitialize(ll_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    xmlSecGnuTLSDnAttrsInitialize(rr_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-
-    /* parse */
-    ret = xmlSecGnuTLSDnAttrsParse(ll, ll_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecGnuTLSDnAttrsParse(ll)", NULL);
+    subjectKey = xmlSecGnuTLSDnGetKey(dn);
+    if(subjectKey == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSDnGetKey(subject)", NULL);
         goto done;
     }
+    xmlFree(dn);
 
-    ret = xmlSecGnuTLSDnAttrsParse(rr, rr_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecGnuTLSDnAttrsParse(rr)", NULL);
+    dn = xmlSecGnuTLSX509CertGetIssuerDN(cert);
+    if(dn == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerDN", NULL);
         goto done;
     }
-
-    /* compare */
-    ret = xmlSecGnuTLSDnAttrsEqual(ll_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE,
-                                   rr_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    if(ret == 1) {
-        res = 1;
-    } else if(ret == 0) {
-        res = 0;
-    } else {
-        xmlSecInternalError("xmlSecGnuTLSDnAttrsEqual", NULL);
+    issuerKey = xmlSecGnuTLSDnGetKey(dn);
+    if(issuerKey == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSDnGetKey(issuer)", NULL);
+        goto done;
+    }
+    serial = xmlSecGnuTLSX509CertGetIssuerSerial(cert);
+    if(serial == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerSerial", NULL);
         goto done;
     }
 
-done:
-    xmlSecGnuTLSDnAttrsDeinitialize(ll_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    xmlSecGnuTLSDnAttrsDeinitialize(rr_attrs, XMLSEC_GNUTLS_DN_ATTRS_SIZE);
-    return(res);
-}
-
-static gnutls_x509_crt_t
-xmlSecGnuTLSX509FindCert(xmlSecPtrListPtr certs,
-                         const xmlChar *subjectName,
-                         const xmlChar *issuerName,
-                         const xmlChar *issuerSerial,
-                         const xmlChar *ski) {
-    xmlSecSize ii, sz;
-
-    xmlSecAssert2(certs != NULL, NULL);
-
-    /* todo: this is not the fastest way to search certs */
-    sz = xmlSecPtrListGetSize(certs);
-    for(ii = 0; (ii < sz); ++ii) {
-        gnutls_x509_crt_t cert = xmlSecPtrListGetItem(certs, ii);
-        if(cert == NULL) {
-            xmlSecInternalError2("xmlSecPtrListGetItem", NULL,
-                                 "pos=%i", (int)ii);
-            return(NULL);
+    /* ski is optional */
+    err = gnutls_x509_crt_get_subject_key_id(cert, NULL, &skiSize, &critical);
+    if((err == GNUTLS_E_SHORT_MEMORY_BUFFER) && (skiSize > 0)) {
+        ski = xmlSecGnuTLSX509CertGetSKI(cert);
+        if(ski == NULL) {
+            xmlSecInternalError("xmlSecGnuTLSX509CertGetSKI", NULL);
+            goto done;
         }
+    }
 
-        if(subjectName != NULL) {
-            xmlChar * tmp;
-
-            tmp = xmlSecGnuTLSX509CertGetSubjectDN(cert);
-            if(tmp == NULL) {
-                xmlSecInternalError2("xmlSecGnuTLSX509CertGetSubjectDN", NULL,
-                                     "pos=%i", (int)ii);
-                return(NULL);
-            }
-
-            if(xmlSecGnuTLSX509DnsEqual(subjectName, tmp) == 1) {
-                xmlFree(tmp);
-                return(cert);
-            }
-            xmlFree(tmp);
-        } else if((issuerName != NULL) && (issuerSerial != NULL)) {
-            xmlChar * tmp1;
-            xmlChar * tmp2;
-
-            tmp1 = xmlSecGnuTLSX509CertGetIssuerDN(cert);
-            if(tmp1 == NULL) {
-                xmlSecInternalError2("xmlSecGnuTLSX509CertGetIssuerDN", NULL,
-                                     "pos=%i", (int)ii);
-                return(NULL);
-            }
-
-            tmp2 = xmlSecGnuTLSX509CertGetIssuerSerial(cert);
-            if(tmp2 == NULL) {
-                xmlSecInternalError2("xmlSecGnuTLSX509CertGetIssuerSerial", NULL,
-                                     "pos=%i", (int)ii);
-                xmlFree(tmp1);
-                return(NULL);
-            }
-
-            if((xmlSecGnuTLSX509DnsEqual(issuerName, tmp1) == 1) && xmlStrEqual(issuerSerial, tmp2)) {
-                xmlFree(tmp1);
-                xmlFree(tmp2);
-                return(cert);
-            }
-            xmlFree(tmp1);
-            xmlFree(tmp2);
-        } else if(ski != NULL) {
-            xmlChar * tmp;
+    /* add */
+    if(xmlHashLookup(certsIndex->bySubject, subjectKey) == NULL) {
+        ret = xmlHashAddEntry(certsIndex->bySubject, subjectKey, cert);
+        if(ret < 0) {
+            xmlSecXmlError("xmlHashAddEntry(bySubject)", NULL);
+            goto done;
+        }
+        addedSubject = 1;
+    }
+    if(xmlHashLookup2(certsIndex->byIssuerSerial, issuerKey, serial) == NULL) {
+        ret = xmlHashAddEntry2(certsIndex->byIssuerSerial, issuerKey, serial, cert);
+        if(ret < 0) {
+            xmlSecXmlError("xmlHashAddEntry2(byIssuerSerial)", NULL);
+            goto done;
+        }
+        addedIssuerSerial = 1;
+    }
+    if((ski != NULL) && (xmlHashLookup(certsIndex->bySki, ski) == NULL)) {
+        ret = xmlHashAddEntry(certsIndex->bySki, ski, cert);
+        if(ret < 0) {
+            xmlSecXmlError("xmlHashAddEntry(bySki)", NULL);
+            goto done;
+        }
+    }
 
-            tmp = xmlSecGnuTLSX509CertGetSKI(cert);
-            if(tmp == NULL) {
-                xmlSecInternalError2("xmlSecGnuTLSX509CertGetSKI", NULL,
-                                     "pos=%i", (int)ii);
-                return(NULL);
-            }
+    /* success */
+    res = 0;
 
-            if(xmlStrEqual(ski, tmp)) {
-                xmlFree(tmp);
-                return(cert);
-            }
-            xmlFree(tmp);
+done:
+    if(res < 0) {
+        if(addedSubject != 0) {
+            xmlHashRemoveEntry(certsIndex->bySubject, subjectKey, NULL);
+        }
+        if(addedIssuerSerial != 0) {
+            xmlHashRemoveEntry2(certsIndex->byIssuerSerial, issuerKey, serial, NULL);
         }
     }
+    if(dn != NULL) {
+        xmlFree(dn);
+    }
+    if(subjectKey != NULL) {
+        xmlFree(subjectKey);
+    }
+    if(issuerKey != NULL) {
+        xmlFree(issuerKey);
+    }
+    if(serial != NULL) {
+        xmlFree(serial);
+    }
+    if(ski != NULL) {
+        xmlFree(ski);
+    }
+    return(res);
+}
 
+/* the DNs are expected to be normalized with xmlSecGnuTLSDnGetKey */
+static gnutls_x509_crt_t
+xmlSecGnuTLSX509CertsIndexFind(xmlSecGnuTLSX509CertsIndexPtr certsIndex,
+                               const xmlChar *subjectKey,
+                               const xmlChar *issuerKey,
+                               const xmlChar *issuerSerial,
+                               const xmlChar *ski) {
+    xmlSecAssert2(certsIndex != NULL, NULL);
+
+    if(subjectKey != NULL) {
+        return((gnutls_x509_crt_t)xmlHashLookup(certsIndex->bySubject, subjectKey));
+    } else if((issuerKey != NULL) && (issuerSerial != NULL)) {
+        return((gnutls_x509_crt_t)xmlHashLookup2(certsIndex->byIssuerSerial, issuerKey, issuerSerial));
+    } else if(ski != NULL) {
+        return((gnutls_x509_crt_t)xmlHashLookup(certsIndex->bySki, ski));
+    }
     return(NULL);
 }
 
-/* signed cert has issuer dn equal to our's subject dn */
+/* signer cert has subject dn equal to our's issuer dn */
 static gnutls_x509_crt_t
-xmlSecGnuTLSX509FindSignedCert(xmlSecPtrListPtr certs, gnutls_x509_crt_t cert) {
+xmlSecGnuTLSX509StoreFindSignerCert(xmlSecGnuTLSX509StoreCtxPtr ctx, gnutls_x509_crt_t cert) {
     gnutls_x509_crt_t res = NULL;
-    xmlChar * subject = NULL;
-    xmlSecSize ii, sz;
+    xmlChar * issuer;
+    xmlChar * issuerKey;
 
-    xmlSecAssert2(certs != NULL, NULL);
+    xmlSecAssert2(ctx != NULL, NULL);
     xmlSecAssert2(cert != NULL, NULL);
 
-    /* get subject */
-    subject = xmlSecGnuTLSX509CertGetSubjectDN(cert);
-    if(subject == NULL) {
-        xmlSecInternalError("xmlSecGnuTLSX509CertGetSubjectDN", NULL);
-        goto done;
+    issuer = xmlSecGnuTLSX509CertGetIssuerDN(cert);
+    if(issuer == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerDN", NULL);
+        return(NULL);
+    }
+    issuerKey = xmlSecGnuTLSDnGetKey(issuer);
+    xmlFree(issuer);
+    if(issuerKey == NULL) {
+        xmlSecInternalError("xmlSecGnuTLSDnGetKey", NULL);
+        return(NULL);
     }
 
-    /* todo: this is not the fastest way to search certs */
-    sz = xmlSecPtrListGetSize(certs);
-    for(ii = 0; (ii < sz) && (res == NULL); ++ii) {
-        gnutls_x509_crt_t tmp;
-        xmlChar * issuer;
+    res = xmlSecGnuTLSX509CertsIndexFind(&(ctx->untrustedIndex), issuerKey, NULL, NULL, NULL);
+    xmlFree(issuerKey);
+    return(res);
+}
 
-        tmp = xmlSecPtrListGetItem(certs, ii);
-        if(tmp == NULL) {
-            xmlSecInternalError2("xmlSecPtrListGetItem", NULL,
-                                 "pos=%i", (int)ii);
-            goto done;
-        }
+static int
+xmlSecGnuTLSX509ChainDigest(gnutls_x509_crt_t * cert_list, xmlSecSize cert_list_length,
+                            unsigned int flags, unsigned char * md) {
+    gnutls_hash_hd_t hash;
+    unsigned char fp[XMLSEC_GNUTLS_X509_VERIFY_CACHE_MD_SIZE];
+    size_t fpSize;
+    xmlSecSize ii;
+    int err;
 
-        issuer = xmlSecGnuTLSX509CertGetIssuerDN(tmp);
-        if(issuer == NULL) {
-            xmlSecInternalError2("xmlSecGnuTLSX509CertGetIssuerDN", NULL,
-                                 "pos=%i", (int)ii);
-            goto done;
-        }
+    xmlSecAssert2(cert_list != NULL, -1);
+    xmlSecAssert2(md != NULL, -1);
 
-        /* are we done? */
-        if(xmlSecGnuTLSX509DnsEqual(subject, issuer) == 1) {
-            res = tmp;
+    err = gnutls_hash_init(&hash, GNUTLS_DIG_SHA256);
+    if(err != GNUTLS_E_SUCCESS) {
+        xmlSecGnuTLSError("gnutls_hash_init", err, NULL);
+        return(-1);
+    }
+    err = gnutls_hash(hash, &flags, sizeof(flags));
+    for(ii = 0; (ii < cert_list_length) && (err == GNUTLS_E_SUCCESS); ++ii) {
+        fpSize = sizeof(fp);
+        err = gnutls_x509_crt_get_fingerprint(cert_list[ii], GNUTLS_DIG_SHA256, fp, &fpSize);
+        if(err == GNUTLS_E_SUCCESS) {
+            err = gnutls_hash(hash, fp, fpSize);
         }
-        xmlFree(issuer);
     }
+    gnutls_hash_deinit(hash, md);
 
-done:
-    if(subject != NULL) {
-        xmlFree(subject);
+    if(err != GNUTLS_E_SUCCESS) {
+        xmlSecGnuTLSError("gnutls_hash", err, NULL);
+        return(-1);
     }
-    return(res);
+    return(0);
 }
 
-/* signer cert has subject dn equal to our's issuer dn */
-static gnutls_x509_crt_t
-xmlSecGnuTLSX509FindSignerCert(xmlSecPtrListPtr certs, gnutls_x509_crt_t cert) {
-    gnutls_x509_crt_t res = NULL;
-    xmlChar * issuer = NULL;
-    xmlSecSize ii, sz;
+static void
+xmlSecGnuTLSX509VerifyCacheUnlink(xmlSecGnuTLSX509StoreCtxPtr ctx, xmlSecGnuTLSX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
 
-    xmlSecAssert2(certs != NULL, NULL);
-    xmlSecAssert2(cert != NULL, NULL);
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        ctx->cacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        ctx->cacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
 
-    /* get issuer */
-    issuer = xmlSecGnuTLSX509CertGetIssuerDN(cert);
-    if(issuer == NULL) {
-        xmlSecInternalError("xmlSecGnuTLSX509CertGetIssuerDN", NULL);
-        goto done;
+static void
+xmlSecGnuTLSX509VerifyCachePushFront(xmlSecGnuTLSX509StoreCtxPtr ctx, xmlSecGnuTLSX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = ctx->cacheHead;
+    if(ctx->cacheHead != NULL) {
+        ctx->cacheHead->prev = entry;
+    } else {
+        ctx->cacheTail = entry;
     }
+    ctx->cacheHead = entry;
+}
 
-    /* todo: this is not the fastest way to search certs */
-    sz = xmlSecPtrListGetSize(certs);
-    for(ii = 0; (ii < sz) && (res == NULL); ++ii) {
-        gnutls_x509_crt_t tmp;
-        xmlChar * subject;
+static int
+xmlSecGnuTLSX509VerifyCacheLookup(xmlSecGnuTLSX509StoreCtxPtr ctx, const unsigned char * md) {
+    xmlSecGnuTLSX509VerifyCacheEntryPtr entry;
+    int res = 0;
 
-        tmp = xmlSecPtrListGetItem(certs, ii);
-        if(tmp == NULL) {
-            xmlSecInternalError2("xmlSecPtrListGetItem", NULL,
-                                 "pos=%i", (int)ii);
-            goto done;
-        }
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(md != NULL, -1);
 
-        subject = xmlSecGnuTLSX509CertGetSubjectDN(tmp);
-        if(subject == NULL) {
-            xmlSecInternalError2("xmlSecGnuTLSX509CertGetSubjectDN", NULL,
-                                 "pos=%i", (int)ii);
-            goto done;
+    xmlMutexLock(ctx->cacheMutex);
+    for(entry = ctx->cacheHead; entry != NULL; entry = entry->next) {
+        if(memcmp(entry->md, md, sizeof(entry->md)) == 0) {
+            break;
         }
+    }
+    if(entry != NULL) {
+        /* most recently used goes first */
+        xmlSecGnuTLSX509VerifyCacheUnlink(ctx, entry);
+        xmlSecGnuTLSX509VerifyCachePushFront(ctx, entry);
+        res = 1;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(res);
+}
 
-        /* are we done? */
-        if((xmlSecGnuTLSX509DnsEqual(issuer, subject) == 1)) {
-            res = tmp;
-        }
-        xmlFree(subject);
+static int
+xmlSecGnuTLSX509VerifyCacheAdd(xmlSecGnuTLSX509StoreCtxPtr ctx, const unsigned char * md) {
+    xmlSecGnuTLSX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(md != NULL, -1);
+
+    entry = (xmlSecGnuTLSX509VerifyCacheEntryPtr)xmlMalloc(sizeof(xmlSecGnuTLSX509VerifyCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecGnuTLSX509VerifyCacheEntry), NULL);
+        return(-1);
     }
+    memset(entry, 0, sizeof(xmlSecGnuTLSX509VerifyCacheEntry));
+    memcpy(entry->md, md, sizeof(entry->md));
+
+    xmlMutexLock(ctx->cacheMutex);
+    xmlSecGnuTLSX509VerifyCachePushFront(ctx, entry);
+    ++ctx->cacheSize;
+    while((ctx->cacheSize > XMLSEC_GNUTLS_X509_VERIFY_CACHE_SIZE) && (ctx->cacheTail != NULL)) {
+        entry = ctx->cacheTail;
+        xmlSecGnuTLSX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+        --ctx->cacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(0);
+}
 
-done:
-    if(issuer != NULL) {
-        xmlFree(issuer);
+static void
+xmlSecGnuTLSX509VerifyCacheFlush(xmlSecGnuTLSX509StoreCtxPtr ctx) {
+    xmlSecGnuTLSX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexLock(ctx->cacheMutex);
+    }
+    while(ctx->cacheHead != NULL) {
+        entry = ctx->cacheHead;
+        xmlSecGnuTLSX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+    }
+    ctx->cacheSize = 0;
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexUnlock(ctx->cacheMutex);
     }
-    return(res);
 }
 
 #endif /* XMLSEC_NO_X509 */
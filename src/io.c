@@ -12,10 +12,18 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_IO_PREFETCH_PTHREAD      1
+#endif /* !defined(_WIN32) && defined(HAVE_PTHREAD_H) */
 
 #include <libxml/uri.h>
 #include <libxml/tree.h>
 #include <libxml/xmlIO.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #ifdef LIBXML_HTTP_ENABLED
 #include <libxml/nanohttp.h>
@@ -30,8 +38,13 @@
 #include <xmlsec/transforms.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/io.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/strings.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/buffer.h>
+#include <xmlsec/private/io.h>
+
 /*******************************************************************
  *
  * Input I/O callback sets
@@ -134,6 +147,12 @@ xmlSecIOCallbackPtrListFind(xmlSecPtrListPtr list, const char* uri) {
 
 static xmlSecPtrList xmlSecAllIOCallbacks;
 
+/* the callbacks list is read without locks, it can not be changed once frozen */
+static int xmlSecAllIOCallbacksFrozen = 0;
+
+static int              xmlSecIOCacheInitialize                 (void);
+static void             xmlSecIOCacheFinalize                   (void);
+
 /**
  * xmlSecIOInit:
  *
@@ -160,6 +179,12 @@ xmlSecIOInit(void) {
     xmlNanoFTPInit();
 #endif /* LIBXML_FTP_ENABLED */
 
+    ret = xmlSecIOCacheInitialize();
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecIOCacheInitialize", NULL);
+        return(-1);
+    }
+
     return(xmlSecIORegisterDefaultCallbacks());
 }
 
@@ -180,17 +205,25 @@ xmlSecIOShutdown(void) {
     xmlNanoFTPCleanup();
 #endif /* LIBXML_FTP_ENABLED */
 
+    xmlSecIOCacheFinalize();
     xmlSecPtrListFinalize(&xmlSecAllIOCallbacks);
+    xmlSecAllIOCallbacksFrozen = 0;
 }
 
 /**
  * xmlSecIOCleanupCallbacks:
  *
  * Clears the entire input callback table. this includes the
- * compiled-in I/O.
+ * compiled-in I/O. Does nothing if the callbacks are frozen with
+ * #xmlSecIOCallbacksFreeze.
  */
 void
 xmlSecIOCleanupCallbacks(void) {
+    if(xmlSecAllIOCallbacksFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "IO callbacks are frozen");
+        return;
+    }
     xmlSecPtrListEmpty(&xmlSecAllIOCallbacks);
 }
 
@@ -214,6 +247,12 @@ xmlSecIORegisterCallbacks(xmlInputMatchCallback matchFunc,
 
     xmlSecAssert2(matchFunc != NULL, -1);
 
+    if(xmlSecAllIOCallbacksFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "IO callbacks are frozen");
+        return(-1);
+    }
+
     callbacks = xmlSecIOCallbackCreate(matchFunc, openFunc, readFunc, closeFunc);
     if(callbacks == NULL) {
         xmlSecInternalError("xmlSecIOCallbackCreate", NULL);
@@ -229,6 +268,36 @@ xmlSecIORegisterCallbacks(xmlInputMatchCallback matchFunc,
     return(0);
 }
 
+/**
+ * xmlSecIOCallbacksFreeze:
+ *
+ * Makes the input callbacks table read-only: the following
+ * #xmlSecIORegisterCallbacks and #xmlSecIOCleanupCallbacks calls fail
+ * and the table can be used from any thread without locks. The function
+ * should be called after all the callbacks are registered and before
+ * the threads that use the library are started. The table is unfrozen
+ * by #xmlSecIOShutdown.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIOCallbacksFreeze(void) {
+    xmlSecAllIOCallbacksFrozen = 1;
+    return(0);
+}
+
+/**
+ * xmlSecIOCallbacksIsFrozen:
+ *
+ * Checks if the input callbacks table was frozen with
+ * #xmlSecIOCallbacksFreeze.
+ *
+ * Returns: 1 if the table is frozen or 0 otherwise.
+ */
+int
+xmlSecIOCallbacksIsFrozen(void) {
+    return((xmlSecAllIOCallbacksFrozen != 0) ? 1 : 0);
+}
 
 /**
  * xmlSecIORegisterDefaultCallbacks:
@@ -270,216 +339,1712 @@ xmlSecIORegisterDefaultCallbacks(void) {
 }
 
 
-
-
-/**************************************************************
+/*******************************************************************
  *
- * Input URI Transform
+ * Caching input I/O callbacks
  *
- * xmlSecInputURICtx is located after xmlSecTransform
+ * The responses are kept in memory in the LRU order and served
+ * without opening a new connection until they expire. The content
+ * digest is recorded when the response is cached and checked on
+ * every hit. The expired responses are revalidated with a conditional
+ * request (or compared with the new response if the transport can't
+ * send one) and kept if not modified.
  *
- **************************************************************/
-typedef struct _xmlSecInputURICtx                               xmlSecInputURICtx,
-                                                                *xmlSecInputURICtxPtr;
-struct _xmlSecInputURICtx {
-    xmlSecIOCallbackPtr         clbks;
-    void*                       clbksCtx;
+ * The <dsig:Reference/> digests of a response are kept with it (see
+ * xmlSecIOCacheDigestFind) and dropped together when it changes.
+ *
+ ******************************************************************/
+#define XMLSEC_IO_CACHE_DEFAULT_MAX_ENTRIES     256
+#define XMLSEC_IO_CACHE_DEFAULT_MAX_SIZE        (16 * 1024 * 1024)
+#define XMLSEC_IO_CACHE_DEFAULT_MAX_AGE         300
+#define XMLSEC_IO_CACHE_READ_CHUNK              4096
+
+typedef struct _xmlSecIOCacheEntry              xmlSecIOCacheEntry,
+                                                *xmlSecIOCacheEntryPtr;
+struct _xmlSecIOCacheEntry {
+    xmlChar*                    uri;
+    xmlSecBuffer                data;
+    xmlSecBuffer                digest;
+    time_t                      expires;
+    time_t                      fetched;        /* for If-Modified-Since */
+    xmlSecSize                  version;
+    xmlHashTablePtr             digests;        /* the reference digests */
+    xmlSecSize                  refs;
+    int                         cached;
+    xmlSecIOCacheEntryPtr       prev;
+    xmlSecIOCacheEntryPtr       next;
 };
-#define xmlSecTransformInputUriSize \
-        (sizeof(xmlSecTransform) + sizeof(xmlSecInputURICtx))
-#define xmlSecTransformInputUriGetCtx(transform) \
-    ((xmlSecTransformCheckSize((transform), xmlSecTransformInputUriSize)) ? \
-        (xmlSecInputURICtxPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform)) : \
-        (xmlSecInputURICtxPtr)NULL)
 
-static int              xmlSecTransformInputURIInitialize       (xmlSecTransformPtr transform);
-static void             xmlSecTransformInputURIFinalize         (xmlSecTransformPtr transform);
-static int              xmlSecTransformInputURIPopBin           (xmlSecTransformPtr transform,
-                                                                 xmlSecByte* data,
-                                                                 xmlSecSize maxDataSize,
-                                                                 xmlSecSize* dataSize,
-                                                                 xmlSecTransformCtxPtr transformCtx);
+typedef struct _xmlSecIOCacheReader {
+    xmlSecIOCacheEntryPtr       entry;
+    xmlSecSize                  pos;
+} xmlSecIOCacheReader, *xmlSecIOCacheReaderPtr;
+
+static xmlMutexPtr              xmlSecIOCacheMutex = NULL;
+static xmlHashTablePtr          xmlSecIOCacheEntries = NULL;
+static xmlSecIOCacheEntryPtr    xmlSecIOCacheHead = NULL;       /* most recently used */
+static xmlSecIOCacheEntryPtr    xmlSecIOCacheTail = NULL;       /* least recently used */
+static xmlSecSize               xmlSecIOCacheCount = 0;
+static xmlSecSize               xmlSecIOCacheSize = 0;
+static xmlSecSize               xmlSecIOCacheMaxEntries = XMLSEC_IO_CACHE_DEFAULT_MAX_ENTRIES;
+static xmlSecSize               xmlSecIOCacheMaxSize = XMLSEC_IO_CACHE_DEFAULT_MAX_SIZE;
+static xmlSecSize               xmlSecIOCacheMaxAge = XMLSEC_IO_CACHE_DEFAULT_MAX_AGE;
+static xmlSecSize               xmlSecIOCacheVersion = 0;
+
+static xmlSecIOCacheEntryPtr    xmlSecIOCacheEntryCreate        (const char* uri);
+static void                     xmlSecIOCacheEntryRelease       (xmlSecIOCacheEntryPtr entry);
+static int                      xmlSecIOCacheEntryDigest        (xmlSecIOCacheEntryPtr entry,
+                                                                 xmlSecBufferPtr digest);
+static xmlSecIOCacheEntryPtr    xmlSecIOCacheEntryFetch         (const char* uri,
+                                                                 xmlSecIOCacheEntryPtr stale,
+                                                                 int* cacheable,
+                                                                 int* notModified);
+static xmlSecIOCacheEntryPtr    xmlSecIOCacheGet                (const char* uri,
+                                                                 int checkData);
+static void                     xmlSecIOCacheDigestDestroy      (void* payload,
+                                                                 const xmlChar* name);
+#ifdef LIBXML_HTTP_ENABLED
+static int                      xmlSecIOCacheFormatHttpDate     (time_t t,
+                                                                 char* buf,
+                                                                 xmlSecSize bufSize,
+                                                                 const char* prefix);
+#endif /* LIBXML_HTTP_ENABLED */
+static void                     xmlSecIOCacheLink               (xmlSecIOCacheEntryPtr entry);
+static void                     xmlSecIOCacheUnlink             (xmlSecIOCacheEntryPtr entry);
+static void                     xmlSecIOCacheRemove             (xmlSecIOCacheEntryPtr entry);
+static void                     xmlSecIOCacheEvict              (void);
 
-static xmlSecTransformKlass xmlSecTransformInputURIKlass = {
-    /* klass/object sizes */
-    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
-    xmlSecTransformInputUriSize,                /* xmlSecSize objSize */
+static int
+xmlSecIOCacheInitialize(void) {
+    xmlSecAssert2(xmlSecIOCacheMutex == NULL, -1);
+    xmlSecAssert2(xmlSecIOCacheEntries == NULL, -1);
 
-    BAD_CAST "input-uri",                       /* const xmlChar* name; */
-    NULL,                                       /* const xmlChar* href; */
-    0,                                          /* xmlSecAlgorithmUsage usage; */
+    xmlSecIOCacheMutex = xmlNewMutex();
+    if(xmlSecIOCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
 
-    xmlSecTransformInputURIInitialize,          /* xmlSecTransformInitializeMethod initialize; */
-    xmlSecTransformInputURIFinalize,            /* xmlSecTransformFinalizeMethod finalize; */
-    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
-    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
-    NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
-    NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
-    NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
-    xmlSecTransformInputURIPopBin,              /* xmlSecTransformPopBinMethod popBin; */
-    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
-    NULL,                                       /* xmlSecTransformExecuteMethod execute; */
+    xmlSecIOCacheEntries = xmlHashCreate(0);
+    if(xmlSecIOCacheEntries == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+    return(0);
+}
 
-    NULL,                                       /* void* reserved0; */
-    NULL,                                       /* void* reserved1; */
-};
+static void
+xmlSecIOCacheFinalize(void) {
+    xmlSecIOCacheFlush();
 
-/**
- * xmlSecTransformInputURIGetKlass:
- *
- * The input uri transform klass. Reads binary data from an uri.
- *
- * Returns: input URI transform id.
- */
-xmlSecTransformId
-xmlSecTransformInputURIGetKlass(void) {
-    return(&xmlSecTransformInputURIKlass);
+    if(xmlSecIOCacheEntries != NULL) {
+        xmlHashFree(xmlSecIOCacheEntries, NULL);
+        xmlSecIOCacheEntries = NULL;
+    }
+    if(xmlSecIOCacheMutex != NULL) {
+        xmlFreeMutex(xmlSecIOCacheMutex);
+        xmlSecIOCacheMutex = NULL;
+    }
 }
 
 /**
- * xmlSecTransformInputURIOpen:
- * @transform:          the pointer to IO transform.
- * @uri:                the URL to open.
+ * xmlSecIOCacheSetLimits:
+ * @maxEntries:         the max number of cached responses.
+ * @maxSize:            the max total size of cached responses (in bytes).
+ * @maxAge:             the time (in seconds) a response is served from
+ *                      the cache; 0 disables caching.
  *
- * Opens the given @uri for reading.
+ * Sets the limits for the caching I/O callbacks (see #xmlSecIOCacheOpen).
+ * The cached responses that do not fit in the new limits are dropped.
  *
- * Returns: 0 on success or a negative value otherwise.
+ * Returns: 0 on success or a negative value if an error occurs.
  */
 int
-xmlSecTransformInputURIOpen(xmlSecTransformPtr transform, const xmlChar *uri) {
-    xmlSecInputURICtxPtr ctx;
+xmlSecIOCacheSetLimits(xmlSecSize maxEntries, xmlSecSize maxSize, xmlSecSize maxAge) {
+    xmlSecAssert2(xmlSecIOCacheMutex != NULL, -1);
 
-    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
-    xmlSecAssert2(uri != NULL, -1);
+    xmlMutexLock(xmlSecIOCacheMutex);
+    xmlSecIOCacheMaxEntries = maxEntries;
+    xmlSecIOCacheMaxSize    = maxSize;
+    xmlSecIOCacheMaxAge     = maxAge;
+    xmlSecIOCacheEvict();
+    xmlMutexUnlock(xmlSecIOCacheMutex);
 
-    ctx = xmlSecTransformInputUriGetCtx(transform);
-    xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->clbks == NULL, -1);
-    xmlSecAssert2(ctx->clbksCtx == NULL, -1);
+    return(0);
+}
 
-    /*
-     * Try to find one of the input accept method accepting that scheme
-     * Go in reverse to give precedence to user defined handlers.
-     * try with an unescaped version of the uri
-     */
-    if(ctx->clbks == NULL) {
-        char *unescaped;
+/**
+ * xmlSecIOCacheFlush:
+ *
+ * Drops all the responses cached by the caching I/O callbacks.
+ * The responses that are still being read are freed when closed.
+ */
+void
+xmlSecIOCacheFlush(void) {
+    xmlSecIOCacheEntryPtr entry;
 
-        unescaped = xmlURIUnescapeString((char*)uri, 0, NULL);
-        if (unescaped != NULL) {
-            ctx->clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, unescaped);
-            if(ctx->clbks != NULL) {
-                ctx->clbksCtx = ctx->clbks->opencallback(unescaped);
-            }
-            xmlFree(unescaped);
-        }
+    if(xmlSecIOCacheMutex == NULL) {
+        return;
     }
 
-    /*
-     * If this failed try with a non-escaped uri this may be a strange
-     * filename
-     */
-    if (ctx->clbks == NULL) {
-        ctx->clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, (char*)uri);
-        if(ctx->clbks != NULL) {
-            ctx->clbksCtx = ctx->clbks->opencallback((char*)uri);
-        }
+    xmlMutexLock(xmlSecIOCacheMutex);
+    while(xmlSecIOCacheHead != NULL) {
+        entry = xmlSecIOCacheHead;
+        xmlSecIOCacheRemove(entry);
     }
+    xmlMutexUnlock(xmlSecIOCacheMutex);
+}
 
-    if((ctx->clbks == NULL) || (ctx->clbksCtx == NULL)) {
-        xmlSecInternalError2("ctx->clbks->opencallback", xmlSecTransformGetName(transform),
-                            "uri=%s", xmlSecErrorsSafeString(uri));
-        return(-1);
+/**
+ * xmlSecIOCacheMatch:
+ * @uri:                the URI.
+ *
+ * The caching I/O callbacks match function: accepts http:// and https://
+ * URIs. The callbacks are registered with #xmlSecIORegisterCallbacks ahead
+ * of the transport that fetches the data:
+ *
+ * |[<!-- language="C" -->
+ *     xmlSecIOCleanupCallbacks();
+ *     xmlSecIORegisterCallbacks(xmlSecIOCacheMatch, xmlSecIOCacheOpen,
+ *                               xmlSecIOCacheRead, xmlSecIOCacheClose);
+ *     xmlSecIORegisterDefaultCallbacks();
+ * ]|
+ *
+ * Returns: 1 if the @uri is accepted or 0 otherwise.
+ */
+int
+xmlSecIOCacheMatch(const char* uri) {
+    if(uri == NULL) {
+        return(0);
+    }
+    if((xmlStrncasecmp(BAD_CAST uri, BAD_CAST "http://", 7) == 0) ||
+       (xmlStrncasecmp(BAD_CAST uri, BAD_CAST "https://", 8) == 0)) {
+        return(1);
     }
-
     return(0);
 }
 
-
 /**
- * xmlSecTransformInputURIClose:
- * @transform:          the pointer to IO transform.
+ * xmlSecIOCacheOpen:
+ * @uri:                the URI.
  *
- * Closes the given @transform and frees up resourses.
+ * The caching I/O callbacks open function. Serves a fresh cached response
+ * with a matching content digest, otherwise fetches the @uri with the
+ * next registered I/O callbacks accepting it and caches the response.
+ * The I/O callbacks don't expose the response headers: a response is kept
+ * for the max age set with #xmlSecIOCacheSetLimits (only 200 responses
+ * are cached for the default libxml2 HTTP transport). Then it is
+ * revalidated with the If-Modified-Since request (the default libxml2
+ * HTTP transport, the server compares the resource modification time with
+ * the local time of the previous request) or fetched again and compared
+ * with the cached data (other transports), the unchanged response is kept
+ * for another max age.
  *
- * Returns: 0 on success or a negative value otherwise.
+ * Returns: the reader context or NULL if an error occurs.
  */
-int
-xmlSecTransformInputURIClose(xmlSecTransformPtr transform) {
-    xmlSecInputURICtxPtr ctx;
+void*
+xmlSecIOCacheOpen(const char* uri) {
+    xmlSecIOCacheReaderPtr reader;
+    xmlSecIOCacheEntryPtr entry;
 
-    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(uri != NULL, NULL);
+    xmlSecAssert2(xmlSecIOCacheMutex != NULL, NULL);
+    xmlSecAssert2(xmlSecIOCacheEntries != NULL, NULL);
 
-    ctx = xmlSecTransformInputUriGetCtx(transform);
-    xmlSecAssert2(ctx != NULL, -1);
+    reader = (xmlSecIOCacheReaderPtr)xmlMalloc(sizeof(xmlSecIOCacheReader));
+    if(reader == NULL) {
+        xmlSecMallocError(sizeof(xmlSecIOCacheReader), NULL);
+        return(NULL);
+    }
+    memset(reader, 0, sizeof(xmlSecIOCacheReader));
 
-    /* close if still open and mark as closed */
-    if((ctx->clbksCtx != NULL) && (ctx->clbks != NULL) && (ctx->clbks->closecallback != NULL)) {
-    	(ctx->clbks->closecallback)(ctx->clbksCtx);
-    	ctx->clbksCtx = NULL;
-    	ctx->clbks = NULL;
+    entry = xmlSecIOCacheGet(uri, 1);
+    if(entry == NULL) {
+        xmlFree(reader);
+        return(NULL);
     }
 
-    /* done */
-    return(0);
+    reader->entry = entry;
+    return(reader);
 }
 
-static int
-xmlSecTransformInputURIInitialize(xmlSecTransformPtr transform) {
-    xmlSecInputURICtxPtr ctx;
+/**
+ * xmlSecIOCacheRead:
+ * @context:            the reader context from #xmlSecIOCacheOpen.
+ * @buffer:             the output buffer.
+ * @len:                the output buffer size.
+ *
+ * The caching I/O callbacks read function.
+ *
+ * Returns: the number of bytes read or a negative value if an error occurs.
+ */
+int
+xmlSecIOCacheRead(void* context, char* buffer, int len) {
+    xmlSecIOCacheReaderPtr reader = (xmlSecIOCacheReaderPtr)context;
+    xmlSecSize size;
 
-    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(reader != NULL, -1);
+    xmlSecAssert2(reader->entry != NULL, -1);
+    xmlSecAssert2(buffer != NULL, -1);
+    xmlSecAssert2(len >= 0, -1);
 
-    ctx = xmlSecTransformInputUriGetCtx(transform);
-    xmlSecAssert2(ctx != NULL, -1);
+    size = xmlSecBufferGetSize(&(reader->entry->data));
+    xmlSecAssert2(reader->pos <= size, -1);
 
-    memset(ctx, 0, sizeof(xmlSecInputURICtx));
+    size -= reader->pos;
+    if(size > (xmlSecSize)len) {
+        size = (xmlSecSize)len;
+    }
+    if(size > 0) {
+        memcpy(buffer, xmlSecBufferGetData(&(reader->entry->data)) + reader->pos, size);
+        reader->pos += size;
+    }
+    return((int)size);
+}
+
+/**
+ * xmlSecIOCacheClose:
+ * @context:            the reader context from #xmlSecIOCacheOpen.
+ *
+ * The caching I/O callbacks close function.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIOCacheClose(void* context) {
+    xmlSecIOCacheReaderPtr reader = (xmlSecIOCacheReaderPtr)context;
+
+    xmlSecAssert2(reader != NULL, -1);
+    xmlSecAssert2(xmlSecIOCacheMutex != NULL, -1);
+
+    if(reader->entry != NULL) {
+        xmlMutexLock(xmlSecIOCacheMutex);
+        xmlSecIOCacheEntryRelease(reader->entry);
+        xmlMutexUnlock(xmlSecIOCacheMutex);
+    }
+    memset(reader, 0, sizeof(xmlSecIOCacheReader));
+    xmlFree(reader);
     return(0);
 }
 
-static void
-xmlSecTransformInputURIFinalize(xmlSecTransformPtr transform) {
-	xmlSecInputURICtxPtr ctx;
-	int ret;
+/*
+ * Returns the referenced entry with the @uri data (cached or not) or NULL
+ * if an error occurs. The cached data digest is checked if @checkData
+ * is set (i.e. if the data is going to be read).
+ */
+static xmlSecIOCacheEntryPtr
+xmlSecIOCacheGet(const char* uri, int checkData) {
+    xmlSecIOCacheEntryPtr entry;
+    xmlSecIOCacheEntryPtr stale = NULL;
+    xmlSecIOCacheEntryPtr fetched = NULL;
+    xmlSecBuffer digest;
+    time_t requested = 0;
+    int cacheable = 0;
+    int notModified = 0;
+    int ret;
 
-    xmlSecAssert(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId));
+    xmlSecAssert2(uri != NULL, NULL);
+    xmlSecAssert2(xmlSecIOCacheMutex != NULL, NULL);
+    xmlSecAssert2(xmlSecIOCacheEntries != NULL, NULL);
+
+    /* cache hit: take a reference so the entry survives the unlocked check */
+    xmlMutexLock(xmlSecIOCacheMutex);
+    entry = (xmlSecIOCacheEntryPtr)xmlHashLookup(xmlSecIOCacheEntries, BAD_CAST uri);
+    if(entry != NULL) {
+        ++(entry->refs);
+        xmlSecIOCacheUnlink(entry);
+        xmlSecIOCacheLink(entry);
+        if(entry->expires <= time(NULL)) {
+            stale = entry;
+            entry = NULL;
+        }
+    }
+    xmlMutexUnlock(xmlSecIOCacheMutex);
+
+    /* expired: keep it if not modified */
+    if(stale != NULL) {
+        requested = time(NULL);
+        fetched = xmlSecIOCacheEntryFetch(uri, stale, &cacheable, &notModified);
+        if(notModified != 0) {
+            xmlMutexLock(xmlSecIOCacheMutex);
+            if(stale->cached != 0) {
+                stale->fetched = requested;
+                stale->expires = stale->fetched + (time_t)xmlSecIOCacheMaxAge;
+            }
+            xmlMutexUnlock(xmlSecIOCacheMutex);
+            entry = stale;
+            stale = NULL;
+        } else if(fetched == NULL) {
+            xmlMutexLock(xmlSecIOCacheMutex);
+            xmlSecIOCacheEntryRelease(stale);
+            xmlMutexUnlock(xmlSecIOCacheMutex);
+            return(NULL);
+        }
+    }
 
-    ctx = xmlSecTransformInputUriGetCtx(transform);
-    xmlSecAssert(ctx != NULL);
+    if((entry != NULL) && (checkData != 0)) {
+        ret = xmlSecBufferInitialize(&digest, 0);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferInitialize", NULL);
+            xmlMutexLock(xmlSecIOCacheMutex);
+            xmlSecIOCacheEntryRelease(entry);
+            xmlMutexUnlock(xmlSecIOCacheMutex);
+            return(NULL);
+        }
+        ret = xmlSecIOCacheEntryDigest(entry, &digest);
+        if((ret < 0) ||
+           (xmlSecBufferGetSize(&digest) != xmlSecBufferGetSize(&(entry->digest))) ||
+           (memcmp(xmlSecBufferGetData(&digest), xmlSecBufferGetData(&(entry->digest)),
+                   xmlSecBufferGetSize(&digest)) != 0)) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_DATA_NOT_MATCH, NULL,
+                              "cached response digest mismatch, uri=%s",
+                              xmlSecErrorsSafeString(uri));
+
+            /* drop the entry and fetch again */
+            xmlMutexLock(xmlSecIOCacheMutex);
+            if(entry->cached != 0) {
+                xmlSecIOCacheRemove(entry);
+            }
+            xmlSecIOCacheEntryRelease(entry);
+            xmlMutexUnlock(xmlSecIOCacheMutex);
+            entry = NULL;
+        }
+        xmlSecBufferFinalize(&digest);
+    }
+    if(entry != NULL) {
+        return(entry);
+    }
 
-    ret = xmlSecTransformInputURIClose(transform);
-    if(ret < 0) {
-        xmlSecInternalError2("xmlSecTransformInputURIClose",
-                             xmlSecTransformGetName(transform),
-                             "ret=%d", ret);
-		/* ignore the error */
-		/* return; */
-	}
+    /* cache miss */
+    if(fetched == NULL) {
+        requested = time(NULL);
+        fetched = xmlSecIOCacheEntryFetch(uri, NULL, &cacheable, &notModified);
+        if(fetched == NULL) {
+            return(NULL);
+        }
+    }
 
-    memset(ctx, 0, sizeof(xmlSecInputURICtx));
-    return;
-}
+    if((cacheable != 0) && (xmlSecIOCacheMaxAge > 0) &&
+       (xmlSecBufferGetSize(&(fetched->data)) <= xmlSecIOCacheMaxSize)) {
+        ret = xmlSecIOCacheEntryDigest(fetched, &(fetched->digest));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIOCacheEntryDigest", NULL);
+            cacheable = 0;
+        }
+    } else {
+        cacheable = 0;
+    }
 
-static int
-xmlSecTransformInputURIPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
-                              xmlSecSize maxDataSize, xmlSecSize* dataSize,
-                              xmlSecTransformCtxPtr transformCtx) {
-    xmlSecInputURICtxPtr ctx;
+    xmlMutexLock(xmlSecIOCacheMutex);
+    if(stale != NULL) {
+        /* the response has changed */
+        if(stale->cached != 0) {
+            xmlSecIOCacheRemove(stale);
+        }
+        xmlSecIOCacheEntryRelease(stale);
+    }
+    if((cacheable != 0) && (xmlHashLookup(xmlSecIOCacheEntries, fetched->uri) == NULL)) {
+        fetched->fetched = requested;
+        fetched->expires = fetched->fetched + (time_t)xmlSecIOCacheMaxAge;
+        fetched->version = ++xmlSecIOCacheVersion;
+        if(xmlHashAddEntry(xmlSecIOCacheEntries, fetched->uri, fetched) == 0) {
+            /* the cache holds its own reference */
+            ++(fetched->refs);
+            fetched->cached = 1;
+            xmlSecIOCacheLink(fetched);
+            xmlSecIOCacheEvict();
+        }
+    }
+    xmlMutexUnlock(xmlSecIOCacheMutex);
 
+    return(fetched);
+}
+
+static xmlSecIOCacheEntryPtr
+xmlSecIOCacheEntryCreate(const char* uri) {
+    xmlSecIOCacheEntryPtr entry;
     int ret;
 
-    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
-    xmlSecAssert2(data != NULL, -1);
-    xmlSecAssert2(dataSize != NULL, -1);
-    xmlSecAssert2(transformCtx != NULL, -1);
+    xmlSecAssert2(uri != NULL, NULL);
 
-    ctx = xmlSecTransformInputUriGetCtx(transform);
+    entry = (xmlSecIOCacheEntryPtr)xmlMalloc(sizeof(xmlSecIOCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecIOCacheEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecIOCacheEntry));
+    entry->refs = 1;
+
+    ret = xmlSecBufferInitialize(&(entry->data), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize(data)", NULL);
+        xmlFree(entry);
+        return(NULL);
+    }
+    ret = xmlSecBufferInitialize(&(entry->digest), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize(digest)", NULL);
+        xmlSecBufferFinalize(&(entry->data));
+        xmlFree(entry);
+        return(NULL);
+    }
+
+    entry->uri = xmlStrdup(BAD_CAST uri);
+    if(entry->uri == NULL) {
+        xmlSecStrdupError(BAD_CAST uri, NULL);
+        xmlSecIOCacheEntryRelease(entry);
+        return(NULL);
+    }
+    return(entry);
+}
+
+/* the caller holds the cache mutex if the entry was ever shared */
+static void
+xmlSecIOCacheEntryRelease(xmlSecIOCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->refs > 0);
+
+    --(entry->refs);
+    if(entry->refs > 0) {
+        return;
+    }
+
+    if(entry->uri != NULL) {
+        xmlFree(entry->uri);
+    }
+    if(entry->digests != NULL) {
+        xmlHashFree(entry->digests, xmlSecIOCacheDigestDestroy);
+    }
+    xmlSecBufferFinalize(&(entry->data));
+    xmlSecBufferFinalize(&(entry->digest));
+    memset(entry, 0, sizeof(xmlSecIOCacheEntry));
+    xmlFree(entry);
+}
+
+static int
+xmlSecIOCacheEntryDigest(xmlSecIOCacheEntryPtr entry, xmlSecBufferPtr digest) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformId id;
+    xmlSecTransformPtr transform;
+    int ret;
+
+    xmlSecAssert2(entry != NULL, -1);
+    xmlSecAssert2(digest != NULL, -1);
+
+    ret = xmlSecBufferSetSize(digest, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetSize", NULL);
+        return(-1);
+    }
+
+    /* the digest is only available once the crypto library is loaded */
+    id = xmlSecTransformIdListFindByHref(xmlSecTransformIdsGet(), xmlSecHrefSha256,
+                                         xmlSecTransformUsageDigestMethod);
+    if((id == xmlSecTransformIdUnknown) || (xmlSecBufferGetSize(&(entry->data)) == 0)) {
+        return(0);
+    }
+
+    ret = xmlSecTransformCtxInitialize(&transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxInitialize", NULL);
+        return(-1);
+    }
+
+    transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, id);
+    if(transform == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxCreateAndAppend",
+                            xmlSecTransformKlassGetName(id));
+        xmlSecTransformCtxFinalize(&transformCtx);
+        return(-1);
+    }
+    transform->operation = xmlSecTransformOperationSign;
+
+    ret = xmlSecTransformCtxBinaryExecute(&transformCtx,
+                                          xmlSecBufferGetData(&(entry->data)),
+                                          xmlSecBufferGetSize(&(entry->data)));
+    if((ret < 0) || (transformCtx.result == NULL)) {
+        xmlSecInternalError("xmlSecTransformCtxBinaryExecute",
+                            xmlSecTransformKlassGetName(id));
+        xmlSecTransformCtxFinalize(&transformCtx);
+        return(-1);
+    }
+
+    ret = xmlSecBufferSetData(digest, xmlSecBufferGetData(transformCtx.result),
+                              xmlSecBufferGetSize(transformCtx.result));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetData", NULL);
+        xmlSecTransformCtxFinalize(&transformCtx);
+        return(-1);
+    }
+
+    xmlSecTransformCtxFinalize(&transformCtx);
+    return(0);
+}
+
+/*
+ * Fetches the @uri. If the @stale entry is given and the response is not
+ * modified, returns NULL and sets @notModified.
+ */
+static xmlSecIOCacheEntryPtr
+xmlSecIOCacheEntryFetch(const char* uri, xmlSecIOCacheEntryPtr stale, int* cacheable, int* notModified) {
+    xmlSecIOCacheEntryPtr entry;
+    xmlSecIOCallbackPtr clbks = NULL;
+    xmlSecIOCallbackPtr tmp;
+    xmlSecSize i, size;
+    void* clbksCtx = NULL;
+    int ret;
+
+    xmlSecAssert2(uri != NULL, NULL);
+    xmlSecAssert2(cacheable != NULL, NULL);
+    xmlSecAssert2(notModified != NULL, NULL);
+
+    (*cacheable) = 0;
+    (*notModified) = 0;
+
+    /* the transport is the first callbacks set after the cache that accepts the uri */
+    size = xmlSecPtrListGetSize(&xmlSecAllIOCallbacks);
+    for(i = 0; i < size; ++i) {
+        tmp = (xmlSecIOCallbackPtr)xmlSecPtrListGetItem(&xmlSecAllIOCallbacks, i);
+        xmlSecAssert2(tmp != NULL, NULL);
+
+        if((tmp->opencallback != xmlSecIOCacheOpen) && (tmp->opencallback != NULL) &&
+           (tmp->matchcallback(uri) != 0)) {
+            clbks = tmp;
+            break;
+        }
+    }
+    if(clbks == NULL) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_IO_FAILED, NULL,
+                          "no transport, uri=%s", xmlSecErrorsSafeString(uri));
+        return(NULL);
+    }
+
+#ifdef LIBXML_HTTP_ENABLED
+    /* the libxml2 HTTP transport can send the conditional request */
+    if((stale != NULL) && (clbks->opencallback == xmlIOHTTPOpen)) {
+        char headers[128];
+
+        /* the dates have 1 second resolution: the changes made in the same
+         * second as the previous request should not be missed */
+        ret = xmlSecIOCacheFormatHttpDate(stale->fetched - 1, headers, sizeof(headers), "If-Modified-Since: ");
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIOCacheFormatHttpDate", NULL);
+            return(NULL);
+        }
+        clbksCtx = xmlNanoHTTPMethod(uri, "GET", NULL, NULL, headers, 0);
+        if(clbksCtx == NULL) {
+            xmlSecIOError("xmlNanoHTTPMethod", uri, NULL);
+            return(NULL);
+        }
+        if(xmlNanoHTTPReturnCode(clbksCtx) == 304) {
+            xmlNanoHTTPClose(clbksCtx);
+            (*notModified) = 1;
+            return(NULL);
+        }
+    }
+#endif /* LIBXML_HTTP_ENABLED */
+
+    if(clbksCtx == NULL) {
+        clbksCtx = clbks->opencallback(uri);
+        if(clbksCtx == NULL) {
+            xmlSecIOError("opencallback", uri, NULL);
+            return(NULL);
+        }
+    }
+
+    entry = xmlSecIOCacheEntryCreate(uri);
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecIOCacheEntryCreate", NULL);
+        if(clbks->closecallback != NULL) {
+            clbks->closecallback(clbksCtx);
+        }
+        return(NULL);
+    }
+
+    /* read the full response */
+    if(clbks->readcallback != NULL) {
+        do {
+            size = xmlSecBufferGetSize(&(entry->data));
+            ret = xmlSecBufferSetMaxSize(&(entry->data), size + XMLSEC_IO_CACHE_READ_CHUNK);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL,
+                                     "size=" XMLSEC_SIZE_FMT, size + XMLSEC_IO_CACHE_READ_CHUNK);
+                break;
+            }
+            ret = clbks->readcallback(clbksCtx,
+                    (char*)xmlSecBufferGetData(&(entry->data)) + size,
+                    XMLSEC_IO_CACHE_READ_CHUNK);
+            if(ret < 0) {
+                xmlSecIOError("readcallback", uri, NULL);
+                break;
+            }
+            if(xmlSecBufferSetSize(&(entry->data), size + ret) < 0) {
+                xmlSecInternalError2("xmlSecBufferSetSize", NULL,
+                                     "size=" XMLSEC_SIZE_FMT, size + ret);
+                ret = -1;
+                break;
+            }
+        } while(ret > 0);
+
+        if(ret < 0) {
+            if(clbks->closecallback != NULL) {
+                clbks->closecallback(clbksCtx);
+            }
+            xmlSecIOCacheEntryRelease(entry);
+            return(NULL);
+        }
+    }
+
+    /* libxml2 HTTP transport opens error responses too */
+    (*cacheable) = 1;
+#ifdef LIBXML_HTTP_ENABLED
+    if((clbks->opencallback == xmlIOHTTPOpen) && (xmlNanoHTTPReturnCode(clbksCtx) != 200)) {
+        (*cacheable) = 0;
+    }
+#endif /* LIBXML_HTTP_ENABLED */
+
+    if(clbks->closecallback != NULL) {
+        clbks->closecallback(clbksCtx);
+    }
+
+    /* the cached data is never modified, it can be read without the lock */
+    if((stale != NULL) && ((*cacheable) != 0) &&
+       (xmlSecBufferGetSize(&(entry->data)) == xmlSecBufferGetSize(&(stale->data))) &&
+       (memcmp(xmlSecBufferGetData(&(entry->data)), xmlSecBufferGetData(&(stale->data)),
+               xmlSecBufferGetSize(&(entry->data))) == 0)) {
+        xmlSecIOCacheEntryRelease(entry);
+        (*notModified) = 1;
+        return(NULL);
+    }
+    return(entry);
+}
+
+static void
+xmlSecIOCacheDigestDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlFree(payload);
+    }
+}
+
+#ifdef LIBXML_HTTP_ENABLED
+/* formats the RFC 7231 IMF-fixdate header (the names are not localized) */
+static int
+xmlSecIOCacheFormatHttpDate(time_t t, char* buf, xmlSecSize bufSize, const char* prefix) {
+    static const char* days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    struct tm tm;
+    int ret;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(prefix != NULL, -1);
+
+#if defined(_WIN32)
+    if(gmtime_s(&tm, &t) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_IO_FAILED, NULL, "gmtime_s");
+        return(-1);
+    }
+#else  /* defined(_WIN32) */
+    if(gmtime_r(&t, &tm) == NULL) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_IO_FAILED, NULL, "gmtime_r");
+        return(-1);
+    }
+#endif /* defined(_WIN32) */
+
+    ret = snprintf(buf, bufSize, "%s%s, %02d %s %04d %02d:%02d:%02d GMT\r\n", prefix,
+        days[tm.tm_wday % 7], tm.tm_mday, months[tm.tm_mon % 12], tm.tm_year + 1900,
+        tm.tm_hour, tm.tm_min, tm.tm_sec);
+    if((ret < 0) || ((xmlSecSize)ret >= bufSize)) {
+        xmlSecInvalidSizeMoreThanError("HTTP date", ret, bufSize, NULL);
+        return(-1);
+    }
+    return(0);
+}
+#endif /* LIBXML_HTTP_ENABLED */
+
+/**
+ * xmlSecIOCacheDigestFind:
+ * @uri:                the external resource URI.
+ * @key:                the digest key (the transforms and digest method).
+ * @digestValue:        the pointer to return the digest value (the caller
+ *                      is responsible for freeing it with xmlFree).
+ * @version:            the pointer to return the cached response version
+ *                      for #xmlSecIOCacheDigestAdd (0 if not cached).
+ *
+ * Finds the digest computed earlier from the same response. The response
+ * is fetched (or revalidated if expired) and cached first, so the digest
+ * is only valid if the resource is not modified since it was computed.
+ * The digests are only cached if the @uri is read with the caching I/O
+ * callbacks (see #xmlSecIOCacheMatch).
+ *
+ * Returns: 1 if the digest is found, 0 if not or a negative value if
+ * an error occurs.
+ */
+int
+xmlSecIOCacheDigestFind(const char* uri, const xmlChar* key, xmlChar** digestValue, xmlSecSize* version) {
+    xmlSecIOCallbackPtr clbks;
+    xmlSecIOCacheEntryPtr entry;
+    const xmlChar* value = NULL;
+    int res = 0;
+
+    xmlSecAssert2(uri != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(digestValue != NULL, -1);
+    xmlSecAssert2(version != NULL, -1);
+
+    (*digestValue) = NULL;
+    (*version) = 0;
+
+    /* the data is only read from the cache if it comes first */
+    clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, uri);
+    if((clbks == NULL) || (clbks->opencallback != xmlSecIOCacheOpen) ||
+       (xmlSecIOCacheMutex == NULL) || (xmlSecIOCacheMaxAge == 0)) {
+        return(0);
+    }
+
+    /* the errors are reported again when the data is read */
+    entry = xmlSecIOCacheGet(uri, 0);
+    if(entry == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecIOCacheMutex);
+    if(entry->cached != 0) {
+        (*version) = entry->version;
+        if(entry->digests != NULL) {
+            value = (const xmlChar*)xmlHashLookup(entry->digests, key);
+        }
+        if(value != NULL) {
+            (*digestValue) = xmlStrdup(value);
+            if((*digestValue) == NULL) {
+                xmlSecStrdupError(value, NULL);
+                res = -1;
+            } else {
+                res = 1;
+            }
+        }
+    }
+    xmlSecIOCacheEntryRelease(entry);
+    xmlMutexUnlock(xmlSecIOCacheMutex);
+
+    return(res);
+}
+
+/**
+ * xmlSecIOCacheDigestAdd:
+ * @uri:                the external resource URI.
+ * @version:            the cached response version from #xmlSecIOCacheDigestFind.
+ * @key:                the digest key (the transforms and digest method).
+ * @digestValue:        the digest value.
+ *
+ * Remembers the digest computed from the cached response @version. The
+ * digest is dropped if the response has changed meanwhile.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIOCacheDigestAdd(const char* uri, xmlSecSize version, const xmlChar* key, const xmlChar* digestValue) {
+    xmlSecIOCacheEntryPtr entry;
+    xmlChar* value;
+    int res = 0;
+
+    xmlSecAssert2(uri != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(digestValue != NULL, -1);
+
+    if((version == 0) || (xmlSecIOCacheMutex == NULL)) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecIOCacheMutex);
+    entry = (xmlSecIOCacheEntryPtr)xmlHashLookup(xmlSecIOCacheEntries, BAD_CAST uri);
+    if((entry != NULL) && (entry->version == version)) {
+        if(entry->digests == NULL) {
+            entry->digests = xmlHashCreate(0);
+            if(entry->digests == NULL) {
+                xmlSecXmlError("xmlHashCreate", NULL);
+                res = -1;
+                goto done;
+            }
+        }
+        value = xmlStrdup(digestValue);
+        if(value == NULL) {
+            xmlSecStrdupError(digestValue, NULL);
+            res = -1;
+            goto done;
+        }
+        if(xmlHashUpdateEntry(entry->digests, key, value, xmlSecIOCacheDigestDestroy) < 0) {
+            xmlSecXmlError("xmlHashUpdateEntry", NULL);
+            xmlFree(value);
+            res = -1;
+            goto done;
+        }
+    }
+
+done:
+    xmlMutexUnlock(xmlSecIOCacheMutex);
+    return(res);
+}
+
+/* called with the cache mutex held */
+static void
+xmlSecIOCacheLink(xmlSecIOCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->prev == NULL);
+    xmlSecAssert(entry->next == NULL);
+
+    entry->next = xmlSecIOCacheHead;
+    if(xmlSecIOCacheHead != NULL) {
+        xmlSecIOCacheHead->prev = entry;
+    } else {
+        xmlSecIOCacheTail = entry;
+    }
+    xmlSecIOCacheHead = entry;
+
+    ++xmlSecIOCacheCount;
+    xmlSecIOCacheSize += xmlSecBufferGetSize(&(entry->data));
+}
+
+/* called with the cache mutex held */
+static void
+xmlSecIOCacheUnlink(xmlSecIOCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        xmlSecIOCacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        xmlSecIOCacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+
+    xmlSecAssert(xmlSecIOCacheCount > 0);
+    --xmlSecIOCacheCount;
+    xmlSecIOCacheSize -= xmlSecBufferGetSize(&(entry->data));
+}
+
+/* called with the cache mutex held, drops the cache reference */
+static void
+xmlSecIOCacheRemove(xmlSecIOCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->cached != 0);
+    xmlSecAssert(xmlSecIOCacheEntries != NULL);
+
+    xmlHashRemoveEntry(xmlSecIOCacheEntries, entry->uri, NULL);
+    xmlSecIOCacheUnlink(entry);
+    entry->cached = 0;
+    xmlSecIOCacheEntryRelease(entry);
+}
+
+/* called with the cache mutex held */
+static void
+xmlSecIOCacheEvict(void) {
+    while((xmlSecIOCacheTail != NULL) &&
+          ((xmlSecIOCacheCount > xmlSecIOCacheMaxEntries) ||
+           (xmlSecIOCacheSize > xmlSecIOCacheMaxSize) ||
+           (xmlSecIOCacheMaxAge == 0))) {
+        xmlSecIOCacheRemove(xmlSecIOCacheTail);
+    }
+}
+
+
+
+
+/**************************************************************
+ *
+ * Input URI prefetching: every URI is read by its own thread while
+ * the consumers wait for the next chunk of data.
+ *
+ **************************************************************/
+/**
+ * XMLSEC_IO_PREFETCH_MAX_THREADS:
+ *
+ * The max number of URIs fetched at the same time, the other URIs are
+ * read when needed.
+ */
+#define XMLSEC_IO_PREFETCH_MAX_THREADS          16
+
+/**
+ * XMLSEC_IO_PREFETCH_READ_CHUNK:
+ *
+ * The max size of a single read of the prefetching thread. The data is
+ * read straight into the shared buffer, so the large reads cost no
+ * copying and the consumer digests the previous chunk meanwhile.
+ */
+#define XMLSEC_IO_PREFETCH_READ_CHUNK           (1024 * 1024)
+#define XMLSEC_IO_PREFETCH_BUFFER_SIZE          4096
+
+typedef struct _xmlSecIOPrefetchEntry           xmlSecIOPrefetchEntry,
+                                                *xmlSecIOPrefetchEntryPtr;
+struct _xmlSecIOPrefetchEntry {
+    xmlSecIOPrefetchPtr         prefetch;
+    xmlChar*                    uri;
+    xmlSecBuffer                data;
+    int                         status;         /* 0 reading, 1 done, -1 failed */
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_t                   thread;
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+};
+
+struct _xmlSecIOPrefetch {
+    xmlSecIOPrefetchEntry       entries[XMLSEC_IO_PREFETCH_MAX_THREADS];
+    xmlSecSize                  entriesSize;
+    int                         cancel;
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_mutex_t             mutex;
+    pthread_cond_t              cond;
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+};
+
+static xmlSecIOPrefetchEntryPtr xmlSecIOPrefetchFind            (xmlSecIOPrefetchPtr prefetch,
+                                                                 const xmlChar* uri);
+static int                      xmlSecIOPrefetchEntryRead       (xmlSecIOPrefetchEntryPtr entry,
+                                                                 xmlSecSize pos,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize maxDataSize,
+                                                                 xmlSecSize* dataSize);
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+static void*                    xmlSecIOPrefetchThread          (void* param);
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+/**
+ * xmlSecIOPrefetchCreate:
+ *
+ * Creates the URIs prefetching context.
+ *
+ * Returns: the pointer to the prefetching context or NULL if an error occurs.
+ */
+xmlSecIOPrefetchPtr
+xmlSecIOPrefetchCreate(void) {
+    xmlSecIOPrefetchPtr prefetch;
+
+    prefetch = (xmlSecIOPrefetchPtr)xmlMalloc(sizeof(xmlSecIOPrefetch));
+    if(prefetch == NULL) {
+        xmlSecMallocError(sizeof(xmlSecIOPrefetch), NULL);
+        return(NULL);
+    }
+    memset(prefetch, 0, sizeof(xmlSecIOPrefetch));
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    if(pthread_mutex_init(&(prefetch->mutex), NULL) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_mutex_init");
+        xmlFree(prefetch);
+        return(NULL);
+    }
+    if(pthread_cond_init(&(prefetch->cond), NULL) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_cond_init");
+        pthread_mutex_destroy(&(prefetch->mutex));
+        xmlFree(prefetch);
+        return(NULL);
+    }
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    return(prefetch);
+}
+
+/**
+ * xmlSecIOPrefetchDestroy:
+ * @prefetch:           the pointer to prefetching context.
+ *
+ * Waits for the started reads to finish and destroys @prefetch. The
+ * transforms opened with #xmlSecTransformInputURIOpenPrefetched must be
+ * closed first.
+ */
+void
+xmlSecIOPrefetchDestroy(xmlSecIOPrefetchPtr prefetch) {
+    xmlSecSize ii;
+
+    xmlSecAssert(prefetch != NULL);
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_mutex_lock(&(prefetch->mutex));
+    prefetch->cancel = 1;
+    pthread_mutex_unlock(&(prefetch->mutex));
+
+    for(ii = 0; ii < prefetch->entriesSize; ++ii) {
+        pthread_join(prefetch->entries[ii].thread, NULL);
+    }
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    for(ii = 0; ii < prefetch->entriesSize; ++ii) {
+        xmlFree(prefetch->entries[ii].uri);
+        xmlSecBufferFinalize(&(prefetch->entries[ii].data));
+    }
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_cond_destroy(&(prefetch->cond));
+    pthread_mutex_destroy(&(prefetch->mutex));
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    memset(prefetch, 0, sizeof(xmlSecIOPrefetch));
+    xmlFree(prefetch);
+}
+
+/**
+ * xmlSecIOPrefetchStart:
+ * @prefetch:           the pointer to prefetching context.
+ * @uri:                the URI (without xpointer expression).
+ *
+ * Starts reading @uri in the background using the registered I/O callbacks.
+ * The URIs that are already started, and all URIs once the max number of
+ * threads is reached or if xmlsec is built without threads support, are
+ * ignored.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecIOPrefetchStart(xmlSecIOPrefetchPtr prefetch, const xmlChar* uri) {
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    xmlSecIOPrefetchEntryPtr entry;
+    int ret;
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    xmlSecAssert2(prefetch != NULL, -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    if((prefetch->entriesSize >= XMLSEC_IO_PREFETCH_MAX_THREADS) ||
+       (xmlSecIOPrefetchFind(prefetch, uri) != NULL)) {
+        return(0);
+    }
+
+    entry = &(prefetch->entries[prefetch->entriesSize]);
+    memset(entry, 0, sizeof(xmlSecIOPrefetchEntry));
+    entry->prefetch = prefetch;
+
+    ret = xmlSecBufferInitialize(&(entry->data), XMLSEC_IO_PREFETCH_BUFFER_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
+    entry->uri = xmlStrdup(uri);
+    if(entry->uri == NULL) {
+        xmlSecStrdupError(uri, NULL);
+        xmlSecBufferFinalize(&(entry->data));
+        return(-1);
+    }
+
+    if(pthread_create(&(entry->thread), NULL, xmlSecIOPrefetchThread, entry) != 0) {
+        /* not fatal: the uri will be read when needed */
+        xmlFree(entry->uri);
+        xmlSecBufferFinalize(&(entry->data));
+        memset(entry, 0, sizeof(xmlSecIOPrefetchEntry));
+        return(0);
+    }
+    ++prefetch->entriesSize;
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    return(0);
+}
+
+static xmlSecIOPrefetchEntryPtr
+xmlSecIOPrefetchFind(xmlSecIOPrefetchPtr prefetch, const xmlChar* uri) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(prefetch != NULL, NULL);
+    xmlSecAssert2(uri != NULL, NULL);
+
+    for(ii = 0; ii < prefetch->entriesSize; ++ii) {
+        if(xmlStrEqual(prefetch->entries[ii].uri, uri)) {
+            return(&(prefetch->entries[ii]));
+        }
+    }
+    return(NULL);
+}
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+static void*
+xmlSecIOPrefetchThread(void* param) {
+    xmlSecIOPrefetchEntryPtr entry = (xmlSecIOPrefetchEntryPtr)param;
+    xmlSecIOPrefetchPtr prefetch;
+    xmlSecIOCallbackPtr clbks = NULL;
+    void* clbksCtx = NULL;
+    xmlSecByte* buf;
+    xmlSecSize size;
+    char* unescaped;
+    int status = -1;
+    int cancel = 0;
+    int ret;
+
+    xmlSecAssert2(entry != NULL, NULL);
+    xmlSecAssert2(entry->prefetch != NULL, NULL);
+    xmlSecAssert2(entry->uri != NULL, NULL);
+    prefetch = entry->prefetch;
+
+    /* same lookup as in xmlSecTransformInputURIOpen() */
+    unescaped = xmlURIUnescapeString((char*)entry->uri, 0, NULL);
+    if(unescaped != NULL) {
+        clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, unescaped);
+        if(clbks != NULL) {
+            clbksCtx = clbks->opencallback(unescaped);
+        }
+        xmlFree(unescaped);
+    }
+    if(clbks == NULL) {
+        clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, (char*)entry->uri);
+        if(clbks != NULL) {
+            clbksCtx = clbks->opencallback((char*)entry->uri);
+        }
+    }
+
+    if((clbks != NULL) && (clbksCtx != NULL) && (clbks->readcallback != NULL)) {
+        while(cancel == 0) {
+            /* only this thread changes the buffer, the consumers read the
+             * data before the current size under the lock */
+            pthread_mutex_lock(&(prefetch->mutex));
+            size = xmlSecBufferGetSize(&(entry->data));
+            if(xmlSecBufferSetMaxSize(&(entry->data), size + XMLSEC_IO_PREFETCH_READ_CHUNK) < 0) {
+                pthread_mutex_unlock(&(prefetch->mutex));
+                break;
+            }
+            buf = xmlSecBufferGetData(&(entry->data)) + size;
+            pthread_mutex_unlock(&(prefetch->mutex));
+
+            ret = (clbks->readcallback)(clbksCtx, (char*)buf, XMLSEC_IO_PREFETCH_READ_CHUNK);
+            if(ret <= 0) {
+                status = (ret == 0) ? 1 : -1;
+                break;
+            }
+
+            pthread_mutex_lock(&(prefetch->mutex));
+            if(xmlSecBufferSetSize(&(entry->data), size + (xmlSecSize)ret) < 0) {
+                cancel = 1;
+            } else {
+                cancel = prefetch->cancel;
+            }
+            pthread_cond_broadcast(&(prefetch->cond));
+            pthread_mutex_unlock(&(prefetch->mutex));
+        }
+    }
+    if((clbks != NULL) && (clbksCtx != NULL) && (clbks->closecallback != NULL)) {
+        (clbks->closecallback)(clbksCtx);
+    }
+
+    pthread_mutex_lock(&(prefetch->mutex));
+    entry->status = status;
+    pthread_cond_broadcast(&(prefetch->cond));
+    pthread_mutex_unlock(&(prefetch->mutex));
+
+    return(NULL);
+}
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+/* waits for the data at @pos, returns 0 and empty data at the end */
+static int
+xmlSecIOPrefetchEntryRead(xmlSecIOPrefetchEntryPtr entry, xmlSecSize pos,
+                          xmlSecByte* data, xmlSecSize maxDataSize, xmlSecSize* dataSize) {
+    xmlSecSize size;
+    int res = 0;
+
+    xmlSecAssert2(entry != NULL, -1);
+    xmlSecAssert2(entry->prefetch != NULL, -1);
+    xmlSecAssert2(dataSize != NULL, -1);
+
+    (*dataSize) = 0;
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_mutex_lock(&(entry->prefetch->mutex));
+    while((entry->status == 0) && (xmlSecBufferGetSize(&(entry->data)) <= pos)) {
+        pthread_cond_wait(&(entry->prefetch->cond), &(entry->prefetch->mutex));
+    }
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    size = xmlSecBufferGetSize(&(entry->data));
+    if(pos < size) {
+        size -= pos;
+        if(size > maxDataSize) {
+            size = maxDataSize;
+        }
+        if((data != NULL) && (size > 0)) {
+            memcpy(data, xmlSecBufferGetData(&(entry->data)) + pos, size);
+        }
+        (*dataSize) = size;
+    } else if(entry->status < 0) {
+        res = -1;
+    }
+
+#ifdef XMLSEC_IO_PREFETCH_PTHREAD
+    pthread_mutex_unlock(&(entry->prefetch->mutex));
+#endif /* XMLSEC_IO_PREFETCH_PTHREAD */
+
+    return(res);
+}
+
+/**************************************************************
+ *
+ * Attachments (cid: URIs)
+ *
+ **************************************************************/
+/**
+ * xmlSecAttachmentUriCheck:
+ * @uri:                the URI.
+ *
+ * Checks if @uri refers to a message attachment ("cid:" URI, RFC 2392).
+ *
+ * Returns: 1 if @uri is an attachment URI or 0 otherwise.
+ */
+int
+xmlSecAttachmentUriCheck(const xmlChar* uri) {
+    if(uri == NULL) {
+        return(0);
+    }
+    return((xmlStrncasecmp(uri, BAD_CAST "cid:", 4) == 0) ? 1 : 0);
+}
+
+/**************************************************************
+ *
+ * Input URI Transform
+ *
+ * xmlSecInputURICtx is located after xmlSecTransform
+ *
+ **************************************************************/
+typedef struct _xmlSecInputURICtx                               xmlSecInputURICtx,
+                                                                *xmlSecInputURICtxPtr;
+struct _xmlSecInputURICtx {
+    xmlSecIOCallbackPtr         clbks;
+    void*                       clbksCtx;
+    xmlSecMappedFile            mappedFile;
+    xmlSecSize                  mappedPos;
+    xmlSecIOPrefetchEntryPtr    prefetched;
+    xmlSecSize                  prefetchedPos;
+    xmlSecAttachmentResolverPtr resolver;
+    void*                       attachment;
+};
+#define xmlSecTransformInputUriSize \
+        (sizeof(xmlSecTransform) + sizeof(xmlSecInputURICtx))
+#define xmlSecTransformInputUriGetCtx(transform) \
+    ((xmlSecTransformCheckSize((transform), xmlSecTransformInputUriSize)) ? \
+        (xmlSecInputURICtxPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform)) : \
+        (xmlSecInputURICtxPtr)NULL)
+
+static int              xmlSecTransformInputURIMapFile          (xmlSecInputURICtxPtr ctx,
+                                                                 const char* uri);
+static int              xmlSecTransformInputURIInitialize       (xmlSecTransformPtr transform);
+static void             xmlSecTransformInputURIFinalize         (xmlSecTransformPtr transform);
+static int              xmlSecTransformInputURIPopBin           (xmlSecTransformPtr transform,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize maxDataSize,
+                                                                 xmlSecSize* dataSize,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+
+static xmlSecTransformKlass xmlSecTransformInputURIKlass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecTransformInputUriSize,                /* xmlSecSize objSize */
+
+    BAD_CAST "input-uri",                       /* const xmlChar* name; */
+    NULL,                                       /* const xmlChar* href; */
+    0,                                          /* xmlSecAlgorithmUsage usage; */
+
+    xmlSecTransformInputURIInitialize,          /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecTransformInputURIFinalize,            /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
+    NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    NULL,                                       /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformInputURIPopBin,              /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    NULL,                                       /* xmlSecTransformExecuteMethod execute; */
+
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecTransformInputURIGetKlass:
+ *
+ * The input uri transform klass. Reads binary data from an uri.
+ *
+ * Returns: input URI transform id.
+ */
+xmlSecTransformId
+xmlSecTransformInputURIGetKlass(void) {
+    return(&xmlSecTransformInputURIKlass);
+}
+
+/**
+ * xmlSecTransformInputURIOpen:
+ * @transform:          the pointer to IO transform.
+ * @uri:                the URL to open.
+ *
+ * Opens the given @uri for reading.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformInputURIOpen(xmlSecTransformPtr transform, const xmlChar *uri) {
+    xmlSecInputURICtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->clbks == NULL, -1);
+    xmlSecAssert2(ctx->clbksCtx == NULL, -1);
+
+    /*
+     * Try to find one of the input accept method accepting that scheme
+     * Go in reverse to give precedence to user defined handlers.
+     * try with an unescaped version of the uri
+     */
+    if(ctx->clbks == NULL) {
+        char *unescaped;
+
+        unescaped = xmlURIUnescapeString((char*)uri, 0, NULL);
+        if (unescaped != NULL) {
+            ctx->clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, unescaped);
+            if(ctx->clbks != NULL) {
+                ctx->clbksCtx = ctx->clbks->opencallback(unescaped);
+            }
+            xmlFree(unescaped);
+        }
+    }
+
+    /*
+     * If this failed try with a non-escaped uri this may be a strange
+     * filename
+     */
+    if (ctx->clbks == NULL) {
+        ctx->clbks = xmlSecIOCallbackPtrListFind(&xmlSecAllIOCallbacks, (char*)uri);
+        if(ctx->clbks != NULL) {
+            ctx->clbksCtx = ctx->clbks->opencallback((char*)uri);
+        }
+    }
+
+    if((ctx->clbks == NULL) || (ctx->clbksCtx == NULL)) {
+        xmlSecInternalError2("ctx->clbks->opencallback", xmlSecTransformGetName(transform),
+                            "uri=%s", xmlSecErrorsSafeString(uri));
+        return(-1);
+    }
+
+    /* local files are read from the mapped pages if possible */
+    if(ctx->clbks->opencallback == xmlFileOpen) {
+        int ret;
+
+        ret = xmlSecTransformInputURIMapFile(ctx, (const char*)uri);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformInputURIMapFile", xmlSecTransformGetName(transform),
+                                "uri=%s", xmlSecErrorsSafeString(uri));
+            return(-1);
+        }
+    }
+
+    return(0);
+}
+
+/**
+ * xmlSecTransformInputURIOpenPrefetched:
+ * @transform:          the pointer to IO transform.
+ * @prefetch:           the pointer to prefetching context.
+ * @uri:                the URL to open.
+ *
+ * Opens the given @uri for reading if it was started with
+ * #xmlSecIOPrefetchStart: the data is read as it arrives.
+ *
+ * Returns: 1 if @uri is opened, 0 if it wasn't prefetched or a negative
+ * value if an error occurs.
+ */
+int
+xmlSecTransformInputURIOpenPrefetched(xmlSecTransformPtr transform,
+                                      xmlSecIOPrefetchPtr prefetch, const xmlChar* uri) {
+    xmlSecInputURICtxPtr ctx;
+    xmlSecIOPrefetchEntryPtr entry;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(prefetch != NULL, -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->clbks == NULL, -1);
+    xmlSecAssert2(ctx->prefetched == NULL, -1);
+
+    entry = xmlSecIOPrefetchFind(prefetch, uri);
+    if(entry == NULL) {
+        return(0);
+    }
+
+    /* wait for the first chunk to report open errors here */
+    ret = xmlSecIOPrefetchEntryRead(entry, 0, NULL, 0, &size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecIOPrefetchEntryRead", xmlSecTransformGetName(transform),
+                            "uri=%s", xmlSecErrorsSafeString(uri));
+        return(-1);
+    }
+
+    ctx->prefetched = entry;
+    ctx->prefetchedPos = 0;
+    return(1);
+}
+
+/**
+ * xmlSecTransformInputURIOpenAttachment:
+ * @transform:          the pointer to IO transform.
+ * @resolver:           the pointer to attachment resolver.
+ * @uri:                the URL to open.
+ *
+ * Opens the given @uri for reading with the @resolver callbacks if it
+ * is an attachment ("cid:") URI. The attachment is read chunk by chunk
+ * as the transforms chain consumes it.
+ *
+ * Returns: 1 if @uri is opened, 0 if it is not an attachment URI or a
+ * negative value if an error occurs.
+ */
+int
+xmlSecTransformInputURIOpenAttachment(xmlSecTransformPtr transform,
+                                      xmlSecAttachmentResolverPtr resolver, const xmlChar* uri) {
+    xmlSecInputURICtxPtr ctx;
+    char* cid;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(resolver != NULL, -1);
+    xmlSecAssert2(resolver->openCallback != NULL, -1);
+    xmlSecAssert2(resolver->readCallback != NULL, -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->clbks == NULL, -1);
+    xmlSecAssert2(ctx->attachment == NULL, -1);
+
+    if(xmlSecAttachmentUriCheck(uri) != 1) {
+        return(0);
+    }
+
+    /* the Content-ID is url-encoded in the uri */
+    cid = xmlURIUnescapeString((const char*)uri + 4, 0, NULL);
+    if(cid == NULL) {
+        xmlSecStrdupError(uri, xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    ctx->attachment = (resolver->openCallback)(resolver->userData, BAD_CAST cid);
+    if(ctx->attachment == NULL) {
+        xmlSecInternalError2("resolver->openCallback", xmlSecTransformGetName(transform),
+                             "cid=%s", xmlSecErrorsSafeString(cid));
+        xmlFree(cid);
+        return(-1);
+    }
+    xmlFree(cid);
+
+    ctx->resolver = resolver;
+    return(1);
+}
+
+/**
+ * xmlSecTransformInputURIGetMappedData:
+ * @transform:          the pointer to IO transform.
+ * @data:               the pointer to the result data.
+ * @dataSize:           the pointer to the result data size.
+ *
+ * Gets the not yet read part of the memory mapped local file opened
+ * with #xmlSecTransformInputURIOpen and marks it as read.
+ *
+ * Returns: 1 if the file is mapped, 0 if it is not or a negative value
+ * if an error occurs.
+ */
+int
+xmlSecTransformInputURIGetMappedData(xmlSecTransformPtr transform,
+                                     const xmlSecByte** data, xmlSecSize* dataSize) {
+    xmlSecInputURICtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize != NULL, -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->mappedFile.data == NULL) {
+        return(0);
+    }
+    xmlSecAssert2(ctx->mappedPos <= ctx->mappedFile.size, -1);
+
+    (*data) = ctx->mappedFile.data + ctx->mappedPos;
+    (*dataSize) = ctx->mappedFile.size - ctx->mappedPos;
+    ctx->mappedPos = ctx->mappedFile.size;
+    return(1);
+}
+
+static int
+xmlSecTransformInputURIMapFile(xmlSecInputURICtxPtr ctx, const char* uri) {
+    const char* path;
+    char* unescaped;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->mappedFile.data == NULL, -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+    unescaped = xmlURIUnescapeString(uri, 0, NULL);
+    if(unescaped == NULL) {
+        /* keep reading with the callbacks */
+        return(0);
+    }
+
+    /* same as xmlFileOpen() */
+    path = unescaped;
+    if(xmlStrncasecmp(BAD_CAST path, BAD_CAST "file://localhost/", 17) == 0) {
+        path += 16;
+    } else if(xmlStrncasecmp(BAD_CAST path, BAD_CAST "file:///", 8) == 0) {
+        path += 7;
+    }
+#if defined(_WIN32)
+    if((path != unescaped) && (path[0] == '/') && (path[1] != '\0') && (path[2] == ':')) {
+        ++path;
+    }
+#endif /* defined(_WIN32) */
+
+    ret = xmlSecMappedFileOpen(&(ctx->mappedFile), path);
+    xmlFree(unescaped);
+    if(ret != 0) {
+        /* the file is still open with the callbacks */
+        memset(&(ctx->mappedFile), 0, sizeof(xmlSecMappedFile));
+        return(0);
+    }
+    ctx->mappedPos = 0;
+    return(0);
+}
+
+
+/**
+ * xmlSecTransformInputURIClose:
+ * @transform:          the pointer to IO transform.
+ *
+ * Closes the given @transform and frees up resourses.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformInputURIClose(xmlSecTransformPtr transform) {
+    xmlSecInputURICtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->mappedFile.data != NULL) {
+        xmlSecMappedFileClose(&(ctx->mappedFile));
+        ctx->mappedPos = 0;
+    }
+    ctx->prefetched = NULL;
+    ctx->prefetchedPos = 0;
+
+    if(ctx->attachment != NULL) {
+        xmlSecAssert2(ctx->resolver != NULL, -1);
+        if(ctx->resolver->closeCallback != NULL) {
+            (ctx->resolver->closeCallback)(ctx->attachment);
+        }
+        ctx->attachment = NULL;
+        ctx->resolver = NULL;
+    }
+
+    /* close if still open and mark as closed */
+    if((ctx->clbksCtx != NULL) && (ctx->clbks != NULL) && (ctx->clbks->closecallback != NULL)) {
+    	(ctx->clbks->closecallback)(ctx->clbksCtx);
+    	ctx->clbksCtx = NULL;
+    	ctx->clbks = NULL;
+    }
+
+    /* done */
+    return(0);
+}
+
+static int
+xmlSecTransformInputURIInitialize(xmlSecTransformPtr transform) {
+    xmlSecInputURICtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecInputURICtx));
+    return(0);
+}
+
+static void
+xmlSecTransformInputURIFinalize(xmlSecTransformPtr transform) {
+	xmlSecInputURICtxPtr ctx;
+	int ret;
+
+    xmlSecAssert(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId));
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
+    xmlSecAssert(ctx != NULL);
+
+    ret = xmlSecTransformInputURIClose(transform);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformInputURIClose",
+                             xmlSecTransformGetName(transform),
+                             "ret=%d", ret);
+		/* ignore the error */
+		/* return; */
+	}
+
+    memset(ctx, 0, sizeof(xmlSecInputURICtx));
+    return;
+}
+
+static int
+xmlSecTransformInputURIPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
+                              xmlSecSize maxDataSize, xmlSecSize* dataSize,
+                              xmlSecTransformCtxPtr transformCtx) {
+    xmlSecInputURICtxPtr ctx;
+
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformInputURIId), -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecTransformInputUriGetCtx(transform);
     xmlSecAssert2(ctx != NULL, -1);
 
-    if((ctx->clbksCtx != NULL) && (ctx->clbks != NULL) && (ctx->clbks->readcallback != NULL)) {
+    if(ctx->attachment != NULL) {
+        xmlSecAssert2(ctx->resolver != NULL, -1);
+
+        (*dataSize) = 0;
+        ret = (ctx->resolver->readCallback)(ctx->attachment, data, maxDataSize, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError("ctx->resolver->readCallback", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        xmlSecAssert2((*dataSize) <= maxDataSize, -1);
+    } else if(ctx->prefetched != NULL) {
+        ret = xmlSecIOPrefetchEntryRead(ctx->prefetched, ctx->prefetchedPos,
+                                        data, maxDataSize, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIOPrefetchEntryRead", xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        ctx->prefetchedPos += (*dataSize);
+    } else if(ctx->mappedFile.data != NULL) {
+        xmlSecSize size;
+
+        xmlSecAssert2(ctx->mappedPos <= ctx->mappedFile.size, -1);
+        size = ctx->mappedFile.size - ctx->mappedPos;
+        if(size > maxDataSize) {
+            size = maxDataSize;
+        }
+        if(size > 0) {
+            memcpy(data, ctx->mappedFile.data + ctx->mappedPos, size);
+            ctx->mappedPos += size;
+        }
+        (*dataSize) = size;
+    } else if((ctx->clbksCtx != NULL) && (ctx->clbks != NULL) && (ctx->clbks->readcallback != NULL)) {
         ret = (ctx->clbks->readcallback)(ctx->clbksCtx, (char*)data, (int)maxDataSize);
         if(ret < 0) {
             xmlSecInternalError("ctx->clbks->readcallback", xmlSecTransformGetName(transform));
@@ -0,0 +1,348 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Pre-generated keys pool: the asymmetric keys generation takes tens to
+ * hundreds of milliseconds (with a very high variance for RSA). With the
+ * pool started, a background thread generates the keys of the configured
+ * klasses and sizes in advance and #xmlSecKeyGenerate takes them from the
+ * pool instead of generating a new key on the request path.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#include <unistd.h>
+#define XMLSEC_KEYGEN_POOL_PTHREAD      1
+#endif /* !defined(_WIN32) && defined(HAVE_PTHREAD_H) */
+
+#include <libxml/tree.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/keygenpool.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/private/keygenpool.h>
+
+#ifdef XMLSEC_KEYGEN_POOL_PTHREAD
+
+typedef struct _xmlSecKeyGenPoolEntry                   xmlSecKeyGenPoolEntry,
+                                                        *xmlSecKeyGenPoolEntryPtr;
+struct _xmlSecKeyGenPoolEntry {
+    xmlSecKeyDataId             dataId;
+    xmlSecSize                  sizeBits;
+    xmlSecKeyDataType           type;
+    xmlSecKeyDataPtr*           keys;
+    xmlSecSize                  keysSize;       /* the pool size */
+    xmlSecSize                  keysNum;        /* the number of ready keys */
+    int                         failed;         /* don't retry the failed generation */
+};
+
+static xmlSecKeyGenPoolEntry    xmlSecKeyGenPoolEntries[XMLSEC_KEYGEN_POOL_MAX_ENTRIES];
+static xmlSecSize               xmlSecKeyGenPoolEntriesSize = 0;
+static pthread_mutex_t          xmlSecKeyGenPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t           xmlSecKeyGenPoolCond = PTHREAD_COND_INITIALIZER;
+static pthread_t                xmlSecKeyGenPoolThread;
+static int                      xmlSecKeyGenPoolThreadStarted = 0;
+static int                      xmlSecKeyGenPoolCancel = 0;
+static pid_t                    xmlSecKeyGenPoolPid = 0;       /* the keys are not reused after fork() */
+
+static void*                    xmlSecKeyGenPoolThreadRun       (void* param);
+
+/* should be called under lock */
+static xmlSecKeyGenPoolEntryPtr
+xmlSecKeyGenPoolFind(xmlSecKeyDataId dataId, xmlSecSize sizeBits, xmlSecKeyDataType type) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < xmlSecKeyGenPoolEntriesSize; ++ii) {
+        if((xmlSecKeyGenPoolEntries[ii].dataId == dataId) &&
+           (xmlSecKeyGenPoolEntries[ii].sizeBits == sizeBits) &&
+           (xmlSecKeyGenPoolEntries[ii].type == type)) {
+            return(&(xmlSecKeyGenPoolEntries[ii]));
+        }
+    }
+    return(NULL);
+}
+
+/* should be called under lock: the first entry that needs more keys */
+static xmlSecKeyGenPoolEntryPtr
+xmlSecKeyGenPoolFindEmpty(void) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < xmlSecKeyGenPoolEntriesSize; ++ii) {
+        if((xmlSecKeyGenPoolEntries[ii].failed == 0) &&
+           (xmlSecKeyGenPoolEntries[ii].keysNum < xmlSecKeyGenPoolEntries[ii].keysSize)) {
+            return(&(xmlSecKeyGenPoolEntries[ii]));
+        }
+    }
+    return(NULL);
+}
+
+static void*
+xmlSecKeyGenPoolThreadRun(void* param ATTRIBUTE_UNUSED) {
+    xmlSecKeyGenPoolEntryPtr entry;
+    xmlSecKeyDataId dataId;
+    xmlSecSize sizeBits;
+    xmlSecKeyDataType type;
+    xmlSecKeyDataPtr data;
+    int ret;
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    while(xmlSecKeyGenPoolCancel == 0) {
+        entry = xmlSecKeyGenPoolFindEmpty();
+        if(entry == NULL) {
+            pthread_cond_wait(&xmlSecKeyGenPoolCond, &xmlSecKeyGenPoolMutex);
+            continue;
+        }
+        dataId = entry->dataId;
+        sizeBits = entry->sizeBits;
+        type = entry->type;
+        pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+
+        /* the slow part goes without lock */
+        data = xmlSecKeyDataCreate(dataId);
+        if(data != NULL) {
+            ret = xmlSecKeyDataGenerate(data, sizeBits, type);
+            if(ret < 0) {
+                xmlSecInternalError3("xmlSecKeyDataGenerate",
+                                     xmlSecKeyDataKlassGetName(dataId),
+                                     "size=%d;type=%d", (int)sizeBits, (int)type);
+                xmlSecKeyDataDestroy(data);
+                data = NULL;
+            }
+        } else {
+            xmlSecInternalError("xmlSecKeyDataCreate",
+                                xmlSecKeyDataKlassGetName(dataId));
+        }
+
+        /* the entries are only removed by xmlSecKeyGenPoolStop() after
+         * this thread exits so the entry pointer is still good */
+        pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+        if(data == NULL) {
+            entry->failed = 1;
+        } else if((xmlSecKeyGenPoolCancel != 0) || (entry->keysNum >= entry->keysSize)) {
+            xmlSecKeyDataDestroy(data);
+        } else {
+            entry->keys[entry->keysNum++] = data;
+        }
+    }
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+
+    return(NULL);
+}
+
+#endif /* XMLSEC_KEYGEN_POOL_PTHREAD */
+
+/**
+ * xmlSecKeyGenPoolStart:
+ * @dataId:             the key klass (rsa, ec, ...).
+ * @sizeBits:           the key size (in bits!).
+ * @type:               the key type (session, permanent, ...).
+ * @poolSize:           the number of keys to keep ready.
+ *
+ * Starts pre-generating the keys of klass @dataId, size @sizeBits and
+ * type @type in a background thread: #xmlSecKeyGenerate called with the
+ * same parameters takes a ready key from the pool (and the pool is
+ * refilled in the background) or generates a new key if the pool is empty.
+ * The calls for a klass, size and type that is already in the pool are
+ * ignored. The keys generated before fork() are never used in the child
+ * process.
+ *
+ * The #xmlSecKeyGenPoolStop function must be called before the crypto
+ * library is shut down.
+ *
+ * Returns: 0 on success or a negative value if an error occurs (including
+ * xmlsec built without threads support).
+ */
+int
+xmlSecKeyGenPoolStart(xmlSecKeyDataId dataId, xmlSecSize sizeBits,
+                      xmlSecKeyDataType type, xmlSecSize poolSize) {
+#ifdef XMLSEC_KEYGEN_POOL_PTHREAD
+    xmlSecKeyGenPoolEntryPtr entry;
+    int res = -1;
+
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
+    xmlSecAssert2(poolSize > 0, -1);
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    if(xmlSecKeyGenPoolFind(dataId, sizeBits, type) != NULL) {
+        res = 0;
+        goto done;
+    }
+    if(xmlSecKeyGenPoolEntriesSize >= XMLSEC_KEYGEN_POOL_MAX_ENTRIES) {
+        xmlSecInvalidSizeMoreThanError("Keys pool entries",
+                                       xmlSecKeyGenPoolEntriesSize + 1,
+                                       XMLSEC_KEYGEN_POOL_MAX_ENTRIES,
+                                       xmlSecKeyDataKlassGetName(dataId));
+        goto done;
+    }
+
+    entry = &(xmlSecKeyGenPoolEntries[xmlSecKeyGenPoolEntriesSize]);
+    memset(entry, 0, sizeof(xmlSecKeyGenPoolEntry));
+    entry->keys = (xmlSecKeyDataPtr*)xmlMalloc(sizeof(xmlSecKeyDataPtr) * poolSize);
+    if(entry->keys == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyDataPtr) * poolSize,
+                          xmlSecKeyDataKlassGetName(dataId));
+        goto done;
+    }
+    entry->dataId   = dataId;
+    entry->sizeBits = sizeBits;
+    entry->type     = type;
+    entry->keysSize = poolSize;
+
+    if(xmlSecKeyGenPoolThreadStarted == 0) {
+        xmlSecKeyGenPoolCancel = 0;
+        if(pthread_create(&xmlSecKeyGenPoolThread, NULL, xmlSecKeyGenPoolThreadRun, NULL) != 0) {
+            xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED,
+                             xmlSecKeyDataKlassGetName(dataId),
+                             "pthread_create");
+            xmlFree(entry->keys);
+            memset(entry, 0, sizeof(xmlSecKeyGenPoolEntry));
+            goto done;
+        }
+        xmlSecKeyGenPoolThreadStarted = 1;
+        xmlSecKeyGenPoolPid = getpid();
+    }
+    ++xmlSecKeyGenPoolEntriesSize;
+    pthread_cond_signal(&xmlSecKeyGenPoolCond);
+
+    /* success */
+    res = 0;
+
+done:
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+    return(res);
+#else /* XMLSEC_KEYGEN_POOL_PTHREAD */
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
+    xmlSecAssert2(poolSize > 0, -1);
+
+    xmlSecNotImplementedError("keys pool requires threads support");
+    return(-1);
+#endif /* XMLSEC_KEYGEN_POOL_PTHREAD */
+}
+
+/**
+ * xmlSecKeyGenPoolStop:
+ *
+ * Stops the background keys generation (waiting for the key that is being
+ * generated) and destroys all the pre-generated keys. This function must be
+ * called before the crypto library is shut down, it is also called from
+ * the #xmlSecShutdown function.
+ */
+void
+xmlSecKeyGenPoolStop(void) {
+#ifdef XMLSEC_KEYGEN_POOL_PTHREAD
+    xmlSecSize ii, jj;
+
+    /* the thread doesn't exist after fork(), the mutex might be locked by it */
+    if((xmlSecKeyGenPoolThreadStarted == 0) || (xmlSecKeyGenPoolPid != getpid())) {
+        return;
+    }
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    xmlSecKeyGenPoolCancel = 1;
+    pthread_cond_broadcast(&xmlSecKeyGenPoolCond);
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+
+    pthread_join(xmlSecKeyGenPoolThread, NULL);
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    for(ii = 0; ii < xmlSecKeyGenPoolEntriesSize; ++ii) {
+        for(jj = 0; jj < xmlSecKeyGenPoolEntries[ii].keysNum; ++jj) {
+            xmlSecKeyDataDestroy(xmlSecKeyGenPoolEntries[ii].keys[jj]);
+        }
+        xmlFree(xmlSecKeyGenPoolEntries[ii].keys);
+        memset(&(xmlSecKeyGenPoolEntries[ii]), 0, sizeof(xmlSecKeyGenPoolEntry));
+    }
+    xmlSecKeyGenPoolEntriesSize = 0;
+    xmlSecKeyGenPoolThreadStarted = 0;
+    xmlSecKeyGenPoolCancel = 0;
+    xmlSecKeyGenPoolPid = 0;
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+#endif /* XMLSEC_KEYGEN_POOL_PTHREAD */
+}
+
+/**
+ * xmlSecKeyGenPoolGetSize:
+ * @dataId:             the key klass (rsa, ec, ...).
+ * @sizeBits:           the key size (in bits!).
+ * @type:               the key type (session, permanent, ...).
+ *
+ * Gets the number of the ready keys of klass @dataId, size @sizeBits
+ * and type @type in the pool.
+ *
+ * Returns: the number of the ready keys.
+ */
+xmlSecSize
+xmlSecKeyGenPoolGetSize(xmlSecKeyDataId dataId, xmlSecSize sizeBits, xmlSecKeyDataType type) {
+#ifdef XMLSEC_KEYGEN_POOL_PTHREAD
+    xmlSecKeyGenPoolEntryPtr entry;
+    xmlSecSize res = 0;
+
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, 0);
+
+    if((xmlSecKeyGenPoolThreadStarted == 0) || (xmlSecKeyGenPoolPid != getpid())) {
+        return(0);
+    }
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    entry = xmlSecKeyGenPoolFind(dataId, sizeBits, type);
+    if(entry != NULL) {
+        res = entry->keysNum;
+    }
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+    return(res);
+#else /* XMLSEC_KEYGEN_POOL_PTHREAD */
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, 0);
+    return(0);
+#endif /* XMLSEC_KEYGEN_POOL_PTHREAD */
+}
+
+/**
+ * xmlSecKeyGenPoolTake:
+ * @dataId:             the key klass (rsa, ec, ...).
+ * @sizeBits:           the key size (in bits!).
+ * @type:               the key type (session, permanent, ...).
+ *
+ * Takes a pre-generated key data from the pool and wakes up the background
+ * thread to generate a replacement.
+ *
+ * Returns: the key data (the caller owns it) or NULL if the pool has no
+ * ready keys with the requested parameters (not an error).
+ */
+xmlSecKeyDataPtr
+xmlSecKeyGenPoolTake(xmlSecKeyDataId dataId, xmlSecSize sizeBits, xmlSecKeyDataType type) {
+#ifdef XMLSEC_KEYGEN_POOL_PTHREAD
+    xmlSecKeyGenPoolEntryPtr entry;
+    xmlSecKeyDataPtr res = NULL;
+
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, NULL);
+
+    /* the keys generated before fork() are shared with the parent */
+    if((xmlSecKeyGenPoolThreadStarted == 0) || (xmlSecKeyGenPoolPid != getpid())) {
+        return(NULL);
+    }
+
+    pthread_mutex_lock(&xmlSecKeyGenPoolMutex);
+    entry = xmlSecKeyGenPoolFind(dataId, sizeBits, type);
+    if((entry != NULL) && (entry->keysNum > 0)) {
+        res = entry->keys[--entry->keysNum];
+        entry->keys[entry->keysNum] = NULL;
+        pthread_cond_signal(&xmlSecKeyGenPoolCond);
+    }
+    pthread_mutex_unlock(&xmlSecKeyGenPoolMutex);
+    return(res);
+#else /* XMLSEC_KEYGEN_POOL_PTHREAD */
+    xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, NULL);
+    return(NULL);
+#endif /* XMLSEC_KEYGEN_POOL_PTHREAD */
+}
@@ -58,6 +58,8 @@
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/keysmngr.h>
+
 
 /**************************************************************************
  *
@@ -1287,6 +1289,8 @@ xmlSecKeyDataEncryptedKeyGetKlass(void) {
 static int
 xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
     xmlSecBufferPtr result;
+    xmlSecBufferPtr cached;
+    xmlChar* cacheKey = NULL;
     int ret;
 
     xmlSecAssert2(id == xmlSecKeyDataEncryptedKeyId, -1);
@@ -1306,6 +1310,25 @@ xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePt
     }
     ++keyInfoCtx->curEncryptedKeyLevel;
 
+    /* check if we already unwrapped this key */
+    if(keyInfoCtx->keysMngr != NULL) {
+        cached = xmlSecKeysMngrEncryptedKeyCacheFind(keyInfoCtx->keysMngr, node, keyInfoCtx, &cacheKey);
+        if(cached != NULL) {
+            ret = xmlSecKeyDataBinRead(keyInfoCtx->keyReq.keyId, key,
+                                   xmlSecBufferGetData(cached),
+                                   xmlSecBufferGetSize(cached),
+                                   keyInfoCtx);
+            xmlSecBufferDestroy(cached);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecKeyDataBinRead",
+                                    xmlSecKeyDataKlassGetName(id));
+                return(-1);
+            }
+            --keyInfoCtx->curEncryptedKeyLevel;
+            return(0);
+        }
+    }
+
     /* init Enc context */
     if(keyInfoCtx->encCtx != NULL) {
         xmlSecEncCtxReset(keyInfoCtx->encCtx);
@@ -1314,6 +1337,9 @@ xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePt
         if(ret < 0) {
             xmlSecInternalError("xmlSecKeyInfoCtxCreateEncCtx",
                                 xmlSecKeyDataKlassGetName(id));
+            if(cacheKey != NULL) {
+                xmlFree(cacheKey);
+            }
             return(-1);
         }
     }
@@ -1328,8 +1354,16 @@ xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePt
         if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_ENCKEY_DONT_STOP_ON_FAILED_DECRYPTION) != 0) {
             xmlSecInternalError("xmlSecEncCtxDecryptToBuffer",
                                 xmlSecKeyDataKlassGetName(id));
+            if(cacheKey != NULL) {
+                xmlFree(cacheKey);
+            }
             return(-1);
         }
+        if(cacheKey != NULL) {
+            xmlFree(cacheKey);
+        }
+        /* the next <enc:EncryptedKey/> is at the same level */
+        --keyInfoCtx->curEncryptedKeyLevel;
         return(0);
     }
 
@@ -1340,10 +1374,26 @@ xmlSecKeyDataEncryptedKeyXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePt
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeyDataBinRead",
                             xmlSecKeyDataKlassGetName(id));
+        if(cacheKey != NULL) {
+            xmlFree(cacheKey);
+        }
         return(-1);
     }
     --keyInfoCtx->curEncryptedKeyLevel;
 
+    /* remember the unwrapped key only if it is good */
+    if(cacheKey != NULL) {
+        ret = xmlSecKeysMngrEncryptedKeyCacheAdd(keyInfoCtx->keysMngr, cacheKey,
+                                   xmlSecBufferGetData(result),
+                                   xmlSecBufferGetSize(result));
+        if(ret < 0) {
+            /* not fatal, the key is still good */
+            xmlSecInternalError("xmlSecKeysMngrEncryptedKeyCacheAdd",
+                                xmlSecKeyDataKlassGetName(id));
+        }
+        xmlFree(cacheKey);
+    }
+
     return(0);
 }
 
@@ -24,6 +24,29 @@
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/keygenpool.h>
+#include <xmlsec/private/keysmngr.h>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#endif /* defined(_MSC_VER) */
+
+/* the shared keys (see xmlSecKeyShare()) references counter */
+#if defined(__GNUC__)
+#define xmlSecKeyRefsIncrement(key)     __sync_add_and_fetch(&((key)->refs), 1)
+#define xmlSecKeyRefsDecrement(key)     __sync_sub_and_fetch(&((key)->refs), 1)
+#define xmlSecKeyRefsGet(key)           __sync_add_and_fetch(&((key)->refs), 0)
+#elif defined(_MSC_VER)
+#define xmlSecKeyRefsIncrement(key)     InterlockedIncrement((volatile LONG*)&((key)->refs))
+#define xmlSecKeyRefsDecrement(key)     InterlockedDecrement((volatile LONG*)&((key)->refs))
+#define xmlSecKeyRefsGet(key)           InterlockedCompareExchange((volatile LONG*)&((key)->refs), 0, 0)
+#else  /* defined(_MSC_VER) */
+/* no atomics: shared keys can not be used from multiple threads */
+#define xmlSecKeyRefsIncrement(key)     (++((key)->refs))
+#define xmlSecKeyRefsDecrement(key)     (--((key)->refs))
+#define xmlSecKeyRefsGet(key)           ((key)->refs)
+#endif /* defined(__GNUC__) */
+
 /**************************************************************************
  *
  * xmlSecKeyUseWith
@@ -380,6 +403,46 @@ xmlSecKeyReqCopy(xmlSecKeyReqPtr dst, xmlSecKeyReqPtr src) {
     return(0);
 }
 
+/*
+ * The key restricted to some applications/identifiers (see #xmlSecKeyAddUseWith)
+ * matches if one of them is in the requirements. The keys without restrictions
+ * and the requirements without KeyUseWith information match anything.
+ */
+static int
+xmlSecKeyReqMatchKeyUseWith(xmlSecKeyReqPtr keyReq, xmlSecKeyPtr key) {
+    xmlSecKeyUseWithPtr reqUseWith, keyUseWith;
+    xmlSecSize reqSize, keySize, ii, jj;
+
+    xmlSecAssert2(keyReq != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    reqSize = xmlSecPtrListGetSize(&(keyReq->keyUseWithList));
+    if((reqSize == 0) || (key->useWithList == NULL)) {
+        return(1);
+    }
+    keySize = xmlSecPtrListGetSize(key->useWithList);
+    if(keySize == 0) {
+        return(1);
+    }
+
+    for(ii = 0; ii < reqSize; ++ii) {
+        reqUseWith = (xmlSecKeyUseWithPtr)xmlSecPtrListGetItem(&(keyReq->keyUseWithList), ii);
+        if(reqUseWith == NULL) {
+            continue;
+        }
+        for(jj = 0; jj < keySize; ++jj) {
+            keyUseWith = (xmlSecKeyUseWithPtr)xmlSecPtrListGetItem(key->useWithList, jj);
+            if((keyUseWith != NULL) &&
+               xmlStrEqual(keyUseWith->application, reqUseWith->application) &&
+               xmlStrEqual(keyUseWith->identifier, reqUseWith->identifier)) {
+
+                return(1);
+            }
+        }
+    }
+    return(0);
+}
+
 /**
  * xmlSecKeyReqMatchKey:
  * @keyReq:             the pointer to key requirements object.
@@ -401,7 +464,27 @@ xmlSecKeyReqMatchKey(xmlSecKeyReqPtr keyReq, xmlSecKeyPtr key) {
     if((keyReq->keyUsage != xmlSecKeyDataUsageUnknown) && ((keyReq->keyUsage & key->usage) == 0)) {
         return(0);
     }
+    if(xmlSecKeyReqMatchKeyUseWith(keyReq, key) != 1) {
+        return(0);
+    }
+
+    /* a shared key is read-only: use the value type and size cached by
+     * xmlSecKeyShare() instead of asking the crypto library again for
+     * every key in the store */
+    if((xmlSecKeyRefsGet(key) > 0) && (key->valueType != xmlSecKeyDataTypeUnknown)) {
+        if((keyReq->keyId != xmlSecKeyDataIdUnknown) &&
+           (!xmlSecKeyDataCheckId(key->value, keyReq->keyId))) {
+
+            return(0);
+        }
+        if((keyReq->keyBitsSize > 0) &&
+           (key->valueSize > 0) &&
+           (key->valueSize < keyReq->keyBitsSize)) {
 
+            return(0);
+        }
+        return(1);
+    }
     return(xmlSecKeyReqMatchKeyValue(keyReq, xmlSecKeyGetValue(key)));
 }
 
@@ -488,6 +571,13 @@ xmlSecKeyReqDebugXmlDump(xmlSecKeyReqPtr keyReq, FILE* output) {
  * xmlSecKey
  *
  *************************************************************************/
+#define xmlSecKeyCheckNotShared(key, ret) \
+    if(xmlSecKeyRefsGet(key) > 0) { \
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL, \
+                         "the key is shared and can not be modified"); \
+        return(ret); \
+    }
+
 /**
  * xmlSecKeyCreate:
  *
@@ -521,6 +611,11 @@ xmlSecKeyCreate(void)  {
 void
 xmlSecKeyEmpty(xmlSecKeyPtr key) {
     xmlSecAssert(key != NULL);
+    if(xmlSecKeyRefsGet(key) > 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "the key is shared and can not be modified");
+        return;
+    }
 
     if(key->value != NULL) {
         xmlSecKeyDataDestroy(key->value);
@@ -531,6 +626,9 @@ xmlSecKeyEmpty(xmlSecKeyPtr key) {
     if(key->dataList != NULL) {
         xmlSecPtrListDestroy(key->dataList);
     }
+    if(key->useWithList != NULL) {
+        xmlSecPtrListDestroy(key->useWithList);
+    }
 
     memset(key, 0, sizeof(xmlSecKey));
 }
@@ -539,12 +637,21 @@ xmlSecKeyEmpty(xmlSecKeyPtr key) {
  * xmlSecKeyDestroy:
  * @key:                the pointer to key.
  *
- * Destroys the key created using #xmlSecKeyCreate function.
+ * Destroys the key created using #xmlSecKeyCreate function. For a shared
+ * key (see #xmlSecKeyShare), releases one reference and destroys the key
+ * when the last reference is gone.
  */
 void
 xmlSecKeyDestroy(xmlSecKeyPtr key) {
     xmlSecAssert(key != NULL);
 
+    if(xmlSecKeyRefsGet(key) > 0) {
+        if(xmlSecKeyRefsDecrement(key) > 0) {
+            return;
+        }
+        key->refs = 0;
+    }
+
     xmlSecKeyEmpty(key);
     xmlFree(key);
 }
@@ -562,6 +669,7 @@ int
 xmlSecKeyCopy(xmlSecKeyPtr keyDst, xmlSecKeyPtr keySrc) {
     xmlSecAssert2(keyDst != NULL, -1);
     xmlSecAssert2(keySrc != NULL, -1);
+    xmlSecKeyCheckNotShared(keyDst, -1);
 
     /* empty destination */
     xmlSecKeyEmpty(keyDst);
@@ -591,6 +699,14 @@ xmlSecKeyCopy(xmlSecKeyPtr keyDst, xmlSecKeyPtr keySrc) {
         }
     }
 
+    if(keySrc->useWithList != NULL) {
+        keyDst->useWithList = xmlSecPtrListDuplicate(keySrc->useWithList);
+        if(keyDst->useWithList == NULL) {
+            xmlSecInternalError("xmlSecPtrListDuplicate", NULL);
+            return(-1);
+        }
+    }
+
     keyDst->usage          = keySrc->usage;
     keyDst->notValidBefore = keySrc->notValidBefore;
     keyDst->notValidAfter  = keySrc->notValidAfter;
@@ -601,7 +717,9 @@ xmlSecKeyCopy(xmlSecKeyPtr keyDst, xmlSecKeyPtr keySrc) {
  * xmlSecKeyDuplicate:
  * @key:                the pointer to the #xmlSecKey structure.
  *
- * Creates a duplicate of the given @key.
+ * Creates a duplicate of the given @key. For a shared key (see
+ * #xmlSecKeyShare), no copy is made: the @key itself is returned with
+ * one more reference.
  *
  * Returns: the pointer to newly allocated #xmlSecKey structure
  * or NULL if an error occurs.
@@ -613,6 +731,11 @@ xmlSecKeyDuplicate(xmlSecKeyPtr key) {
 
     xmlSecAssert2(key != NULL, NULL);
 
+    if(xmlSecKeyRefsGet(key) > 0) {
+        xmlSecKeyRefsIncrement(key);
+        return(key);
+    }
+
     newKey = xmlSecKeyCreate();
     if(newKey == NULL) {
         xmlSecInternalError("xmlSecKeyCreate", NULL);
@@ -629,6 +752,49 @@ xmlSecKeyDuplicate(xmlSecKeyPtr key) {
     return(newKey);
 }
 
+/**
+ * xmlSecKeyShare:
+ * @key:                the pointer to key.
+ *
+ * Switches @key to the shared mode: the key becomes read-only and
+ * reference counted. #xmlSecKeyDuplicate returns the same key with one
+ * more reference instead of copying all the key data and #xmlSecKeyDestroy
+ * releases one reference. This allows keys stores to hand out the same key
+ * to concurrent operations. The caller owns the first reference. The key
+ * data must not be modified directly once the key is shared: the key value
+ * type and size are cached here for the key requirements matching.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeyShare(xmlSecKeyPtr key) {
+    xmlSecAssert2(key != NULL, -1);
+
+    if(key->refs == 0) {
+        if(key->value != NULL) {
+            key->valueType = xmlSecKeyDataGetType(key->value);
+            key->valueSize = xmlSecKeyDataGetSize(key->value);
+        }
+        key->refs = 1;
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeyIsShared:
+ * @key:                the pointer to key.
+ *
+ * Checks whether @key is in the shared mode (see #xmlSecKeyShare).
+ *
+ * Returns: 1 if the key is shared or 0 otherwise.
+ */
+int
+xmlSecKeyIsShared(xmlSecKeyPtr key) {
+    xmlSecAssert2(key != NULL, 0);
+
+    return((xmlSecKeyRefsGet(key) > 0) ? 1 : 0);
+}
+
 /**
  * xmlSecKeyMatch:
  * @key:                the pointer to key.
@@ -668,6 +834,9 @@ xmlSecKeyGetType(xmlSecKeyPtr key) {
     if(data == NULL) {
         return(xmlSecKeyDataTypeUnknown);
     }
+    if((xmlSecKeyRefsGet(key) > 0) && (key->valueType != xmlSecKeyDataTypeUnknown)) {
+        return(key->valueType);
+    }
     return(xmlSecKeyDataGetType(data));
 }
 
@@ -698,6 +867,7 @@ xmlSecKeyGetName(xmlSecKeyPtr key) {
 int
 xmlSecKeySetName(xmlSecKeyPtr key, const xmlChar* name) {
     xmlSecAssert2(key != NULL, -1);
+    xmlSecKeyCheckNotShared(key, -1);
 
     if(key->name != NULL) {
         xmlFree(key->name);
@@ -742,12 +912,14 @@ xmlSecKeyGetValue(xmlSecKeyPtr key) {
 int
 xmlSecKeySetValue(xmlSecKeyPtr key, xmlSecKeyDataPtr value) {
     xmlSecAssert2(key != NULL, -1);
+    xmlSecKeyCheckNotShared(key, -1);
 
-    if(key->value != NULL) {
+    if((key->value != NULL) && (key->value != value)) {
         xmlSecKeyDataDestroy(key->value);
-        key->value = NULL;
     }
     key->value = value;
+    key->valueType = xmlSecKeyDataTypeUnknown;
+    key->valueSize = 0;
 
     return(0);
 }
@@ -807,6 +979,7 @@ xmlSecKeyEnsureData(xmlSecKeyPtr key, xmlSecKeyDataId dataId) {
     if(data != NULL) {
         return(data);
     }
+    xmlSecKeyCheckNotShared(key, NULL);
 
     data = xmlSecKeyDataCreate(dataId);
     if(data == NULL) {
@@ -845,14 +1018,11 @@ xmlSecKeyAdoptData(xmlSecKeyPtr key, xmlSecKeyDataPtr data) {
 
     xmlSecAssert2(key != NULL, -1);
     xmlSecAssert2(xmlSecKeyDataIsValid(data), -1);
+    xmlSecKeyCheckNotShared(key, -1);
 
     /* special cases */
     if(data->id == xmlSecKeyDataValueId) {
-        if(key->value != NULL) {
-            xmlSecKeyDataDestroy(key->value);
-        }
-        key->value = data;
-        return(0);
+        return(xmlSecKeySetValue(key, data));
     }
 
     if(key->dataList == NULL) {
@@ -875,6 +1045,67 @@ xmlSecKeyAdoptData(xmlSecKeyPtr key, xmlSecKeyDataPtr data) {
     return(xmlSecPtrListAdd(key->dataList, data));
 }
 
+/**
+ * xmlSecKeyAddUseWith:
+ * @key:                the pointer to key.
+ * @application:        the application value.
+ * @identifier:         the identifier value.
+ *
+ * Restricts @key to the given application/identifier: once restricted,
+ * the key matches only the key requirements without KeyUseWith information
+ * or with one of the applications/identifiers added to the key (see also
+ * #xmlSecKeyGetUseWithList function).
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecKeyAddUseWith(xmlSecKeyPtr key, const xmlChar* application, const xmlChar* identifier) {
+    xmlSecKeyUseWithPtr keyUseWith;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecKeyCheckNotShared(key, -1);
+
+    if(key->useWithList == NULL) {
+        key->useWithList = xmlSecPtrListCreate(xmlSecKeyUseWithPtrListId);
+        if(key->useWithList == NULL) {
+            xmlSecInternalError("xmlSecPtrListCreate", NULL);
+            return(-1);
+        }
+    }
+
+    keyUseWith = xmlSecKeyUseWithCreate(application, identifier);
+    if(keyUseWith == NULL) {
+        xmlSecInternalError("xmlSecKeyUseWithCreate", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecPtrListAdd(key->useWithList, keyUseWith);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd", NULL);
+        xmlSecKeyUseWithDestroy(keyUseWith);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeyGetUseWithList:
+ * @key:                the pointer to key.
+ *
+ * Gets the applications/identifiers the @key is restricted to (see
+ * #xmlSecKeyAddUseWith function).
+ *
+ * Returns: the list of #xmlSecKeyUseWith objects or NULL if the key
+ * can be used with any application.
+ */
+xmlSecPtrListPtr
+xmlSecKeyGetUseWithList(xmlSecKeyPtr key) {
+    xmlSecAssert2(key != NULL, NULL);
+
+    return(key->useWithList);
+}
+
 /**
  * xmlSecKeyDebugDump:
  * @key:                the pointer to key.
@@ -975,7 +1206,9 @@ xmlSecKeyDebugXmlDump(xmlSecKeyPtr key, FILE *output) {
  * @sizeBits:           the new key size (in bits!).
  * @type:               the new key type (session, permanent, ...).
  *
- * Generates new key of requested klass @dataId and @type.
+ * Generates new key of requested klass @dataId and @type. The key is
+ * taken from the pre-generated keys pool if it was started for these
+ * parameters (see #xmlSecKeyGenPoolStart) and has a ready key.
  *
  * Returns: pointer to newly created key or NULL if an error occurs.
  */
@@ -987,20 +1220,24 @@ xmlSecKeyGenerate(xmlSecKeyDataId dataId, xmlSecSize sizeBits, xmlSecKeyDataType
 
     xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, NULL);
 
-    data = xmlSecKeyDataCreate(dataId);
+    /* try the pre-generated keys first */
+    data = xmlSecKeyGenPoolTake(dataId, sizeBits, type);
     if(data == NULL) {
-        xmlSecInternalError("xmlSecKeyDataCreate",
-                            xmlSecKeyDataKlassGetName(dataId));
-        return(NULL);
-    }
+        data = xmlSecKeyDataCreate(dataId);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecKeyDataCreate",
+                                xmlSecKeyDataKlassGetName(dataId));
+            return(NULL);
+        }
 
-    ret = xmlSecKeyDataGenerate(data, sizeBits, type);
-    if(ret < 0) {
-        xmlSecInternalError3("xmlSecKeyDataGenerate",
-                             xmlSecKeyDataKlassGetName(dataId),
-                             "size=%d;type=%d", sizeBits, type);
-        xmlSecKeyDataDestroy(data);
-        return(NULL);
+        ret = xmlSecKeyDataGenerate(data, sizeBits, type);
+        if(ret < 0) {
+            xmlSecInternalError3("xmlSecKeyDataGenerate",
+                                 xmlSecKeyDataKlassGetName(dataId),
+                                 "size=%d;type=%d", sizeBits, type);
+            xmlSecKeyDataDestroy(data);
+            return(NULL);
+        }
     }
 
     key = xmlSecKeyCreate();
@@ -1196,18 +1433,53 @@ xmlSecKeyReadMemory(xmlSecKeyDataId dataId, const xmlSecByte* data, xmlSecSize d
     return (key);
 }
 
+static xmlSecKeyPtr      xmlSecKeysMngrReadKey                   (xmlNodePtr keyInfoNode,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+
 /**
  * xmlSecKeysMngrGetKey:
  * @keyInfoNode:        the pointer to <dsig:KeyInfo/> node.
  * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
  *
- * Reads the <dsig:KeyInfo/> node @keyInfoNode and extracts the key.
+ * Reads the <dsig:KeyInfo/> node @keyInfoNode and extracts the key. If
+ * the resolved keys cache is enabled for the keys manager (see
+ * #xmlSecKeysMngrEnableKeyCache) then the cached key is returned when
+ * possible.
  *
  * Returns: the pointer to key or NULL if the key is not found or
  * an error occurs.
  */
 xmlSecKeyPtr
 xmlSecKeysMngrGetKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecKeyPtr key;
+    xmlChar* cacheKey = NULL;
+    int ret;
+
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    if(keyInfoCtx->keysMngr != NULL) {
+        key = xmlSecKeysMngrKeyCacheFind(keyInfoCtx->keysMngr, keyInfoNode, keyInfoCtx, &cacheKey);
+        if(key != NULL) {
+            return(key);
+        }
+    }
+
+    key = xmlSecKeysMngrReadKey(keyInfoNode, keyInfoCtx);
+    if((key != NULL) && (cacheKey != NULL)) {
+        ret = xmlSecKeysMngrKeyCacheAdd(keyInfoCtx->keysMngr, cacheKey, key);
+        if(ret < 0) {
+            /* not fatal, the key is still good */
+            xmlSecInternalError("xmlSecKeysMngrKeyCacheAdd", NULL);
+        }
+    }
+    if(cacheKey != NULL) {
+        xmlFree(cacheKey);
+    }
+    return(key);
+}
+
+static xmlSecKeyPtr
+xmlSecKeysMngrReadKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
     xmlSecKeyPtr key;
     int ret;
 
@@ -15,6 +15,8 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -34,6 +36,26 @@
 static xmlSecPtrList xmlSecAllKeyDataIds;
 static int xmlSecImportPersistKey = 0;
 
+/*
+ * The node, href and name indexes of xmlSecAllKeyDataIds: the first registered
+ * klass wins on duplicates to match the list order. The indexes are built
+ * on the first lookup rather than on every registration (most klasses
+ * are never looked up by a short-lived process) and are only used while
+ * they cover every item in the list. After #xmlSecKeyDataIdsFreeze the
+ * list and the indexes never change and are read without the mutex.
+ */
+static xmlHashTablePtr xmlSecAllKeyDataIdsByNode = NULL;
+static xmlHashTablePtr xmlSecAllKeyDataIdsByHref = NULL;
+static xmlHashTablePtr xmlSecAllKeyDataIdsByName = NULL;
+static xmlSecSize xmlSecAllKeyDataIdsIndexed = 0;
+static xmlMutexPtr xmlSecAllKeyDataIdsIndexMutex = NULL;
+static int xmlSecAllKeyDataIdsFrozen = 0;
+
+static int              xmlSecKeyDataIdsIndexAdd                (xmlSecKeyDataId id);
+static int              xmlSecKeyDataIdsIndexRebuild            (void);
+static int              xmlSecKeyDataIdsIndexEnsure             (xmlSecPtrListPtr list);
+static void             xmlSecKeyDataIdsIndexFinalize           (void);
+
 /**
  * xmlSecKeyDataIdsGet:
  *
@@ -64,6 +86,12 @@ xmlSecKeyDataIdsInit(void) {
         return(-1);
     }
 
+    xmlSecAllKeyDataIdsIndexMutex = xmlNewMutex();
+    if(xmlSecAllKeyDataIdsIndexMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
     ret = xmlSecKeyDataIdsRegisterDefault();
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeyDataIdsRegisterDefault", NULL);
@@ -81,7 +109,143 @@ xmlSecKeyDataIdsInit(void) {
  */
 void
 xmlSecKeyDataIdsShutdown(void) {
+    xmlSecKeyDataIdsIndexFinalize();
     xmlSecPtrListFinalize(xmlSecKeyDataIdsGet());
+    xmlSecAllKeyDataIdsFrozen = 0;
+
+    if(xmlSecAllKeyDataIdsIndexMutex != NULL) {
+        xmlFreeMutex(xmlSecAllKeyDataIdsIndexMutex);
+        xmlSecAllKeyDataIdsIndexMutex = NULL;
+    }
+}
+
+static void
+xmlSecKeyDataIdsIndexFinalize(void) {
+    if(xmlSecAllKeyDataIdsByNode != NULL) {
+        xmlHashFree(xmlSecAllKeyDataIdsByNode, NULL);
+        xmlSecAllKeyDataIdsByNode = NULL;
+    }
+    if(xmlSecAllKeyDataIdsByHref != NULL) {
+        xmlHashFree(xmlSecAllKeyDataIdsByHref, NULL);
+        xmlSecAllKeyDataIdsByHref = NULL;
+    }
+    if(xmlSecAllKeyDataIdsByName != NULL) {
+        xmlHashFree(xmlSecAllKeyDataIdsByName, NULL);
+        xmlSecAllKeyDataIdsByName = NULL;
+    }
+    xmlSecAllKeyDataIdsIndexed = 0;
+}
+
+static int
+xmlSecKeyDataIdsIndexAdd(xmlSecKeyDataId id) {
+    xmlSecAssert2(id != xmlSecKeyDataIdUnknown, -1);
+
+    if(xmlSecAllKeyDataIdsByNode == NULL) {
+        xmlSecAllKeyDataIdsByNode = xmlHashCreate(0);
+        if(xmlSecAllKeyDataIdsByNode == NULL) {
+            xmlSecXmlError("xmlHashCreate", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+    if(xmlSecAllKeyDataIdsByHref == NULL) {
+        xmlSecAllKeyDataIdsByHref = xmlHashCreate(0);
+        if(xmlSecAllKeyDataIdsByHref == NULL) {
+            xmlSecXmlError("xmlHashCreate", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+    if(xmlSecAllKeyDataIdsByName == NULL) {
+        xmlSecAllKeyDataIdsByName = xmlHashCreate(0);
+        if(xmlSecAllKeyDataIdsByName == NULL) {
+            xmlSecXmlError("xmlHashCreate", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+
+    /* keep the first klass on duplicates */
+    if((id->dataNodeName != NULL) &&
+       (xmlHashLookup2(xmlSecAllKeyDataIdsByNode, id->dataNodeName, id->dataNodeNs) == NULL)) {
+        if(xmlHashAddEntry2(xmlSecAllKeyDataIdsByNode, id->dataNodeName, id->dataNodeNs, (void*)id) < 0) {
+            xmlSecXmlError2("xmlHashAddEntry2", xmlSecKeyDataKlassGetName(id),
+                            "node=%s", xmlSecErrorsSafeString(id->dataNodeName));
+            return(-1);
+        }
+    }
+    if((id->href != NULL) && (xmlHashLookup(xmlSecAllKeyDataIdsByHref, id->href) == NULL)) {
+        if(xmlHashAddEntry(xmlSecAllKeyDataIdsByHref, id->href, (void*)id) < 0) {
+            xmlSecXmlError2("xmlHashAddEntry", xmlSecKeyDataKlassGetName(id),
+                            "href=%s", xmlSecErrorsSafeString(id->href));
+            return(-1);
+        }
+    }
+    if((id->name != NULL) && (xmlHashLookup(xmlSecAllKeyDataIdsByName, id->name) == NULL)) {
+        if(xmlHashAddEntry(xmlSecAllKeyDataIdsByName, id->name, (void*)id) < 0) {
+            xmlSecXmlError("xmlHashAddEntry", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+
+    ++xmlSecAllKeyDataIdsIndexed;
+    return(0);
+}
+
+static int
+xmlSecKeyDataIdsIndexRebuild(void) {
+    xmlSecKeyDataId id;
+    xmlSecSize i, size;
+    int ret;
+
+    xmlSecKeyDataIdsIndexFinalize();
+
+    size = xmlSecPtrListGetSize(xmlSecKeyDataIdsGet());
+    for(i = 0; i < size; ++i) {
+        id = (xmlSecKeyDataId)xmlSecPtrListGetItem(xmlSecKeyDataIdsGet(), i);
+        xmlSecAssert2(id != xmlSecKeyDataIdUnknown, -1);
+
+        ret = xmlSecKeyDataIdsIndexAdd(id);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyDataIdsIndexAdd",
+                                xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* returns 1 if the indexes can be used for lookups in @list, 0 otherwise */
+static int
+xmlSecKeyDataIdsIndexEnsure(xmlSecPtrListPtr list) {
+    int ret;
+
+    if(list != xmlSecKeyDataIdsGet()) {
+        return(0);
+    }
+    if(xmlSecAllKeyDataIdsFrozen != 0) {
+        return(1);
+    }
+    if((xmlSecAllKeyDataIdsByNode != NULL) &&
+       (xmlSecAllKeyDataIdsByHref != NULL) &&
+       (xmlSecAllKeyDataIdsByName != NULL) &&
+       (xmlSecAllKeyDataIdsIndexed == xmlSecPtrListGetSize(xmlSecKeyDataIdsGet()))) {
+        return(1);
+    }
+    if(xmlSecAllKeyDataIdsIndexMutex == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecAllKeyDataIdsIndexMutex);
+    if(xmlSecAllKeyDataIdsIndexed != xmlSecPtrListGetSize(xmlSecKeyDataIdsGet())) {
+        ret = xmlSecKeyDataIdsIndexRebuild();
+        if(ret < 0) {
+            /* fall back to the list scan */
+            xmlSecInternalError("xmlSecKeyDataIdsIndexRebuild", NULL);
+            xmlSecKeyDataIdsIndexFinalize();
+        }
+    }
+    ret = (xmlSecAllKeyDataIdsIndexed == xmlSecPtrListGetSize(xmlSecKeyDataIdsGet())) ? 1 : 0;
+    xmlMutexUnlock(xmlSecAllKeyDataIdsIndexMutex);
+
+    return(ret);
 }
 
 /**
@@ -98,6 +262,14 @@ xmlSecKeyDataIdsRegister(xmlSecKeyDataId id) {
 
     xmlSecAssert2(id != xmlSecKeyDataIdUnknown, -1);
 
+    if(xmlSecAllKeyDataIdsFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION,
+                         xmlSecKeyDataKlassGetName(id),
+                         "key data klasses are frozen");
+        return(-1);
+    }
+
+    /* the indexes are rebuilt on the next lookup */
     ret = xmlSecPtrListAdd(xmlSecKeyDataIdsGet(), (xmlSecPtr)id);
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListAdd",
@@ -108,6 +280,55 @@ xmlSecKeyDataIdsRegister(xmlSecKeyDataId id) {
     return(0);
 }
 
+/**
+ * xmlSecKeyDataIdsFreeze:
+ *
+ * Builds the lookup indexes for the global list of key data klasses
+ * and makes the list read-only: the following registrations fail and
+ * the lookups do not take any locks. The function should be called
+ * after all the klasses are registered and before the threads that
+ * use the library are started. The list is unfrozen by
+ * #xmlSecKeyDataIdsShutdown.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeyDataIdsFreeze(void) {
+    int ret;
+
+    xmlSecAssert2(xmlSecAllKeyDataIdsIndexMutex != NULL, -1);
+
+    if(xmlSecAllKeyDataIdsFrozen != 0) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecAllKeyDataIdsIndexMutex);
+    ret = xmlSecKeyDataIdsIndexRebuild();
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyDataIdsIndexRebuild", NULL);
+        xmlSecKeyDataIdsIndexFinalize();
+        xmlMutexUnlock(xmlSecAllKeyDataIdsIndexMutex);
+        return(-1);
+    }
+    xmlSecAllKeyDataIdsFrozen = 1;
+    xmlMutexUnlock(xmlSecAllKeyDataIdsIndexMutex);
+
+    return(0);
+}
+
+/**
+ * xmlSecKeyDataIdsIsFrozen:
+ *
+ * Checks if the global list of key data klasses was frozen with
+ * #xmlSecKeyDataIdsFreeze.
+ *
+ * Returns: 1 if the list is frozen or 0 otherwise.
+ */
+int
+xmlSecKeyDataIdsIsFrozen(void) {
+    return((xmlSecAllKeyDataIdsFrozen != 0) ? 1 : 0);
+}
+
 /**
  * xmlSecKeyDataIdsRegisterDefault:
  *
@@ -119,24 +340,47 @@ xmlSecKeyDataIdsRegister(xmlSecKeyDataId id) {
  */
 int
 xmlSecKeyDataIdsRegisterDefault(void) {
-    if(xmlSecKeyDataIdsRegister(xmlSecKeyDataNameId) < 0) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister(xmlSecKeyDataNameId)", NULL);
+    if(xmlSecAllKeyDataIdsFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "key data klasses are frozen");
+        return(-1);
+    }
+    return(xmlSecKeyDataIdListAddDefault(xmlSecKeyDataIdsGet()));
+}
+
+/**
+ * xmlSecKeyDataIdListAddDefault:
+ * @list:               the pointer to key data ids list.
+ *
+ * Adds default (implemented by XML Security Library) key data
+ * klasses (KeyName, KeyValue, RetrievalMethod, ...) to @list. Together with
+ * #xmlSecCryptoDLFunctionsAddKeyDataAndTransforms this allows to fill
+ * a per-context enabled key data list for one crypto library.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeyDataIdListAddDefault(xmlSecPtrListPtr list) {
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), -1);
+
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecKeyDataNameId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecKeyDataNameId)", NULL);
         return(-1);
     }
 
-    if(xmlSecKeyDataIdsRegister(xmlSecKeyDataValueId) < 0) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister(xmlSecKeyDataValueId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecKeyDataValueId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecKeyDataValueId)", NULL);
         return(-1);
     }
 
-    if(xmlSecKeyDataIdsRegister(xmlSecKeyDataRetrievalMethodId) < 0) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister(xmlSecKeyDataRetrievalMethodId", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecKeyDataRetrievalMethodId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecKeyDataRetrievalMethodId)", NULL);
         return(-1);
     }
 
 #ifndef XMLSEC_NO_XMLENC
-    if(xmlSecKeyDataIdsRegister(xmlSecKeyDataEncryptedKeyId) < 0) {
-        xmlSecInternalError("xmlSecKeyDataIdsRegister(xmlSecKeyDataEncryptedKeyId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecKeyDataEncryptedKeyId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecKeyDataEncryptedKeyId)", NULL);
         return(-1);
     }
 #endif /* XMLSEC_NO_XMLENC */
@@ -1058,6 +1302,21 @@ xmlSecKeyDataIdListFindByNode(xmlSecPtrListPtr list, const xmlChar* nodeName,
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), xmlSecKeyDataIdUnknown);
     xmlSecAssert2(nodeName != NULL, xmlSecKeyDataIdUnknown);
 
+    if(xmlSecKeyDataIdsIndexEnsure(list) == 1) {
+        dataId = (xmlSecKeyDataId)xmlHashLookup2(xmlSecAllKeyDataIdsByNode, nodeName, nodeNs);
+        if((dataId != xmlSecKeyDataIdUnknown) && ((usage & dataId->usage) != 0) &&
+           xmlStrEqual(nodeName, dataId->dataNodeName) &&
+           xmlStrEqual(nodeNs, dataId->dataNodeNs)) {
+
+            return(dataId);
+        }
+        /* the hash doesn't tell NULL and empty namespaces apart */
+        if((dataId == xmlSecKeyDataIdUnknown) && (nodeNs != NULL) && (nodeNs[0] != '\0')) {
+            return(xmlSecKeyDataIdUnknown);
+        }
+        /* another klass with the same node might have the right usage */
+    }
+
     size = xmlSecPtrListGetSize(list);
     for(i = 0; i < size; ++i) {
         dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, i);
@@ -1092,6 +1351,17 @@ xmlSecKeyDataIdListFindByHref(xmlSecPtrListPtr list, const xmlChar* href,
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), xmlSecKeyDataIdUnknown);
     xmlSecAssert2(href != NULL, xmlSecKeyDataIdUnknown);
 
+    if(xmlSecKeyDataIdsIndexEnsure(list) == 1) {
+        dataId = (xmlSecKeyDataId)xmlHashLookup(xmlSecAllKeyDataIdsByHref, href);
+        if(dataId == xmlSecKeyDataIdUnknown) {
+            return(xmlSecKeyDataIdUnknown);
+        }
+        if((usage & dataId->usage) != 0) {
+            return(dataId);
+        }
+        /* another klass with the same href might have the right usage */
+    }
+
     size = xmlSecPtrListGetSize(list);
     for(i = 0; i < size; ++i) {
         dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, i);
@@ -1125,6 +1395,17 @@ xmlSecKeyDataIdListFindByName(xmlSecPtrListPtr list, const xmlChar* name,
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), xmlSecKeyDataIdUnknown);
     xmlSecAssert2(name != NULL, xmlSecKeyDataIdUnknown);
 
+    if(xmlSecKeyDataIdsIndexEnsure(list) == 1) {
+        dataId = (xmlSecKeyDataId)xmlHashLookup(xmlSecAllKeyDataIdsByName, name);
+        if(dataId == xmlSecKeyDataIdUnknown) {
+            return(xmlSecKeyDataIdUnknown);
+        }
+        if((usage & dataId->usage) != 0) {
+            return(dataId);
+        }
+        /* another klass with the same name might have the right usage */
+    }
+
     size = xmlSecPtrListGetSize(list);
     for(i = 0; i < size; ++i) {
         dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, i);
@@ -8,15 +8,24 @@
  *
  * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
  */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* sched_getcpu() and the CPU affinity for the NUMA replicas */
+#define _GNU_SOURCE
+#endif /* defined(__linux__) && !defined(_GNU_SOURCE) */
+
 #include "globals.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/c14n.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -24,13 +33,45 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/keysmngr.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/buffer.h>
+#include <xmlsec/private/keysmngr.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_SIMPLE_KEYS_STORE_SRWLOCK        1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_SIMPLE_KEYS_STORE_PTHREAD        1
+#endif /* defined(_WIN32) */
+
+#if defined(__linux__) && defined(HAVE_PTHREAD_H)
+#include <sched.h>
+#include <pthread.h>
+#define XMLSEC_KEYS_MNGR_NUMA   1
+#endif /* defined(__linux__) && defined(HAVE_PTHREAD_H) */
+
+static void             xmlSecKeysMngrKeyCacheDestroy           (void* cache);
+
 /****************************************************************************
  *
  * Keys Manager
  *
  ***************************************************************************/
+#if defined(__GNUC__)
+#define xmlSecKeysMngrRefsIncrement(mngr)       __sync_add_and_fetch(&((mngr)->refs), 1)
+#define xmlSecKeysMngrRefsDecrement(mngr)       __sync_sub_and_fetch(&((mngr)->refs), 1)
+#elif defined(_MSC_VER)
+#define xmlSecKeysMngrRefsIncrement(mngr)       InterlockedIncrement((volatile LONG*)&((mngr)->refs))
+#define xmlSecKeysMngrRefsDecrement(mngr)       InterlockedDecrement((volatile LONG*)&((mngr)->refs))
+#else  /* defined(_MSC_VER) */
+/* no atomics: the references can not be acquired or released from multiple threads */
+#define xmlSecKeysMngrRefsIncrement(mngr)       (++((mngr)->refs))
+#define xmlSecKeysMngrRefsDecrement(mngr)       (--((mngr)->refs))
+#endif /* defined(__GNUC__) */
+
 /**
  * xmlSecKeysMngrCreate:
  *
@@ -52,6 +93,7 @@ xmlSecKeysMngrCreate(void) {
         return(NULL);
     }
     memset(mngr, 0, sizeof(xmlSecKeysMngr));
+    mngr->refs = 1;
 
     ret = xmlSecPtrListInitialize(&(mngr->storesList), xmlSecKeyDataStorePtrListId);
     if(ret < 0) {
@@ -66,12 +108,18 @@ xmlSecKeysMngrCreate(void) {
  * xmlSecKeysMngrDestroy:
  * @mngr:               the pointer to keys manager.
  *
- * Destroys keys manager created with #xmlSecKeysMngrCreate function.
+ * Releases one reference to the keys manager (see #xmlSecKeysMngrRef)
+ * and destroys keys manager created with #xmlSecKeysMngrCreate function
+ * when the last reference is gone.
  */
 void
 xmlSecKeysMngrDestroy(xmlSecKeysMngrPtr mngr) {
     xmlSecAssert(mngr != NULL);
 
+    if(xmlSecKeysMngrRefsDecrement(mngr) > 0) {
+        return;
+    }
+
     /* destroy keys store */
     if(mngr->keysStore != NULL) {
         xmlSecKeyStoreDestroy(mngr->keysStore);
@@ -80,10 +128,40 @@ xmlSecKeysMngrDestroy(xmlSecKeysMngrPtr mngr) {
     /* destroy other data stores */
     xmlSecPtrListFinalize(&(mngr->storesList));
 
+    if(mngr->keyCache != NULL) {
+        xmlSecKeysMngrKeyCacheDestroy(mngr->keyCache);
+    }
+    if(mngr->encKeyCache != NULL) {
+        xmlSecKeysMngrKeyCacheDestroy(mngr->encKeyCache);
+    }
+    if(mngr->verifyCache != NULL) {
+        xmlSecKeysMngrKeyCacheDestroy(mngr->verifyCache);
+    }
+
     memset(mngr, 0, sizeof(xmlSecKeysMngr));
     xmlFree(mngr);
 }
 
+/**
+ * xmlSecKeysMngrRef:
+ * @mngr:               the pointer to keys manager.
+ *
+ * Acquires one more reference to the keys manager: @mngr is destroyed
+ * when every reference is released with #xmlSecKeysMngrDestroy. This
+ * allows an operation to keep using the keys manager after it was
+ * replaced (see #xmlSecKeysMngrHolderSwap).
+ *
+ * Returns: the @mngr or NULL if an error occurs.
+ */
+xmlSecKeysMngrPtr
+xmlSecKeysMngrRef(xmlSecKeysMngrPtr mngr) {
+    xmlSecAssert2(mngr != NULL, NULL);
+    xmlSecAssert2(mngr->refs > 0, NULL);
+
+    xmlSecKeysMngrRefsIncrement(mngr);
+    return(mngr);
+}
+
 /**
  * xmlSecKeysMngrFindKey:
  * @mngr:               the pointer to keys manager.
@@ -130,6 +208,8 @@ xmlSecKeysMngrAdoptKeysStore(xmlSecKeysMngrPtr mngr, xmlSecKeyStorePtr store) {
     }
     mngr->keysStore = store;
 
+    /* the cached keys might come from the old store */
+    xmlSecKeysMngrInvalidateKeyCache(mngr);
     return(0);
 }
 
@@ -166,6 +246,9 @@ xmlSecKeysMngrAdoptDataStore(xmlSecKeysMngrPtr mngr, xmlSecKeyDataStorePtr store
     xmlSecAssert2(mngr != NULL, -1);
     xmlSecAssert2(xmlSecKeyDataStoreIsValid(store), -1);
 
+    /* the cached keys might be verified with the old store */
+    xmlSecKeysMngrInvalidateKeyCache(mngr);
+
     size = xmlSecPtrListGetSize(&(mngr->storesList));
     for(pos = 0; pos < size; ++pos) {
         tmp = (xmlSecKeyDataStorePtr)xmlSecPtrListGetItem(&(mngr->storesList), pos);
@@ -209,472 +292,3214 @@ xmlSecKeysMngrGetDataStore(xmlSecKeysMngrPtr mngr, xmlSecKeyDataStoreId id) {
 
 /**************************************************************************
  *
- * xmlSecKeyStore functions
+ * Keys manager holder
+ *
+ * The current keys manager generation: the operations acquire a reference
+ * to the current keys manager and release it when done, the replacement
+ * is loaded without holding any lock and swapped in. The previous keys
+ * manager is destroyed when the last operation using it releases it.
  *
  *************************************************************************/
+struct _xmlSecKeysMngrHolder {
+    xmlSecKeysMngrPtr           mngr;
+    xmlSecKeysMngrPtr*          replicas;       /* one keys manager per NUMA node (optional) */
+    xmlSecSize                  replicasSize;
+    int*                        cpuNodes;       /* the NUMA node of each CPU */
+    xmlSecSize                  cpuNodesSize;
+    xmlSecSize                  generation;
+    xmlMutexPtr                 mutex;          /* protects all of the above */
+};
+
+static void             xmlSecKeysMngrHolderReplicasDestroy     (xmlSecKeysMngrPtr* replicas,
+                                                                 xmlSecSize replicasSize,
+                                                                 int* cpuNodes);
+static int              xmlSecKeysMngrHolderCurrentCpu          (void);
+static int              xmlSecKeysMngrHolderLoadReplicas        (xmlSecKeysMngrLoadCallback loadCallback,
+                                                                 void* context,
+                                                                 xmlSecKeysMngrPtr** replicas,
+                                                                 xmlSecSize* replicasSize,
+                                                                 int** cpuNodes,
+                                                                 xmlSecSize* cpuNodesSize);
+
 /**
- * xmlSecKeyStoreCreate:
- * @id:                 the key store klass.
+ * xmlSecKeysMngrHolderCreate:
+ * @mngr:               the pointer to the initial keys manager.
  *
- * Creates new store of the specified klass @klass. Caller is responsible
- * for freeing the returned store by calling #xmlSecKeyStoreDestroy function.
+ * Creates new keys manager holder and adopts @mngr as its first
+ * generation. Caller is responsible for freeing it with
+ * #xmlSecKeysMngrHolderDestroy function.
  *
- * Returns: the pointer to newly allocated keys store or NULL if an error occurs.
+ * Returns: the pointer to newly allocated keys manager holder or NULL if
+ * an error occurs.
  */
-xmlSecKeyStorePtr
-xmlSecKeyStoreCreate(xmlSecKeyStoreId id)  {
-    xmlSecKeyStorePtr store;
-    int ret;
+xmlSecKeysMngrHolderPtr
+xmlSecKeysMngrHolderCreate(xmlSecKeysMngrPtr mngr) {
+    xmlSecKeysMngrHolderPtr holder;
 
-    xmlSecAssert2(id != NULL, NULL);
-    xmlSecAssert2(id->objSize > 0, NULL);
+    xmlSecAssert2(mngr != NULL, NULL);
 
-    /* Allocate a new xmlSecKeyStore and fill the fields. */
-    store = (xmlSecKeyStorePtr)xmlMalloc(id->objSize);
-    if(store == NULL) {
-        xmlSecMallocError(id->objSize,
-                          xmlSecKeyStoreKlassGetName(id));
+    holder = (xmlSecKeysMngrHolderPtr)xmlMalloc(sizeof(xmlSecKeysMngrHolder));
+    if(holder == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeysMngrHolder), NULL);
         return(NULL);
     }
-    memset(store, 0, id->objSize);
-    store->id = id;
+    memset(holder, 0, sizeof(xmlSecKeysMngrHolder));
 
-    if(id->initialize != NULL) {
-        ret = (id->initialize)(store);
-        if(ret < 0) {
-            xmlSecInternalError("id->initialize",
-                                xmlSecKeyStoreKlassGetName(id));
-            xmlSecKeyStoreDestroy(store);
-            return(NULL);
-        }
+    holder->mutex = xmlNewMutex();
+    if(holder->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlFree(holder);
+        return(NULL);
     }
-
-    return(store);
+    holder->mngr = mngr;
+    holder->generation = 1;
+    return(holder);
 }
 
 /**
- * xmlSecKeyStoreDestroy:
- * @store:              the pointer to keys store.
+ * xmlSecKeysMngrHolderDestroy:
+ * @holder:             the pointer to keys manager holder.
  *
- * Destroys the store created with #xmlSecKeyStoreCreate function.
+ * Destroys keys manager holder and releases the current keys manager.
  */
 void
-xmlSecKeyStoreDestroy(xmlSecKeyStorePtr store) {
-    xmlSecAssert(xmlSecKeyStoreIsValid(store));
-    xmlSecAssert(store->id->objSize > 0);
+xmlSecKeysMngrHolderDestroy(xmlSecKeysMngrHolderPtr holder) {
+    xmlSecAssert(holder != NULL);
 
-    if(store->id->finalize != NULL) {
-        (store->id->finalize)(store);
+    if(holder->mngr != NULL) {
+        xmlSecKeysMngrDestroy(holder->mngr);
     }
-    memset(store, 0, store->id->objSize);
-    xmlFree(store);
+    xmlSecKeysMngrHolderReplicasDestroy(holder->replicas, holder->replicasSize, holder->cpuNodes);
+    if(holder->mutex != NULL) {
+        xmlFreeMutex(holder->mutex);
+    }
+    memset(holder, 0, sizeof(xmlSecKeysMngrHolder));
+    xmlFree(holder);
 }
 
 /**
- * xmlSecKeyStoreFindKey:
- * @store:              the pointer to keys store.
- * @name:               the desired key name.
- * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
+ * xmlSecKeysMngrHolderAcquire:
+ * @holder:             the pointer to keys manager holder.
+ * @generation:         the optional pointer to return the keys manager generation.
  *
- * Lookups key in the store. The caller is responsible for destroying
- * the returned key using #xmlSecKeyDestroy method.
+ * Acquires a reference to the current keys manager. The keys manager stays
+ * valid even if it is replaced with #xmlSecKeysMngrHolderSwap until the
+ * caller releases it with #xmlSecKeysMngrDestroy.
  *
- * Returns: the pointer to a key or NULL if key is not found or an error occurs.
+ * Returns: the pointer to the current keys manager or NULL if an error occurs.
  */
-xmlSecKeyPtr
-xmlSecKeyStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyInfoCtxPtr keyInfoCtx) {
-    xmlSecAssert2(xmlSecKeyStoreIsValid(store), NULL);
-    xmlSecAssert2(store->id->findKey != NULL, NULL);
-    xmlSecAssert2(keyInfoCtx != NULL, NULL);
-
-    return(store->id->findKey(store, name, keyInfoCtx));
-}
-
-/****************************************************************************
- *
- * Simple Keys Store
- *
- * keys list (xmlSecPtrList) is located after xmlSecKeyStore
- *
- ***************************************************************************/
-#define xmlSecSimpleKeysStoreSize \
-        (sizeof(xmlSecKeyStore) + sizeof(xmlSecPtrList))
-#define xmlSecSimpleKeysStoreGetList(store) \
-    ((xmlSecKeyStoreCheckSize((store), xmlSecSimpleKeysStoreSize)) ? \
-        (xmlSecPtrListPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
-        (xmlSecPtrListPtr)NULL)
-
-static int                      xmlSecSimpleKeysStoreInitialize (xmlSecKeyStorePtr store);
-static void                     xmlSecSimpleKeysStoreFinalize   (xmlSecKeyStorePtr store);
-static xmlSecKeyPtr             xmlSecSimpleKeysStoreFindKey    (xmlSecKeyStorePtr store,
-                                                                 const xmlChar* name,
-                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+xmlSecKeysMngrPtr
+xmlSecKeysMngrHolderAcquire(xmlSecKeysMngrHolderPtr holder, xmlSecSize* generation) {
+    xmlSecKeysMngrPtr mngr;
+    int cpu, node;
 
-static xmlSecKeyStoreKlass xmlSecSimpleKeysStoreKlass = {
-    sizeof(xmlSecKeyStoreKlass),
-    xmlSecSimpleKeysStoreSize,
+    xmlSecAssert2(holder != NULL, NULL);
+    xmlSecAssert2(holder->mutex != NULL, NULL);
 
-    /* data */
-    BAD_CAST "simple-keys-store",               /* const xmlChar* name; */
+    cpu = xmlSecKeysMngrHolderCurrentCpu();
 
-    /* constructors/destructor */
-    xmlSecSimpleKeysStoreInitialize,            /* xmlSecKeyStoreInitializeMethod initialize; */
-    xmlSecSimpleKeysStoreFinalize,              /* xmlSecKeyStoreFinalizeMethod finalize; */
-    xmlSecSimpleKeysStoreFindKey,               /* xmlSecKeyStoreFindKeyMethod findKey; */
+    xmlMutexLock(holder->mutex);
+    mngr = holder->mngr;
+    if((holder->replicas != NULL) && (cpu >= 0) && ((xmlSecSize)cpu < holder->cpuNodesSize)) {
+        node = holder->cpuNodes[cpu];
+        if((node >= 0) && ((xmlSecSize)node < holder->replicasSize) && (holder->replicas[node] != NULL)) {
+            mngr = holder->replicas[node];
+        }
+    }
+    mngr = xmlSecKeysMngrRef(mngr);
+    if(generation != NULL) {
+        (*generation) = holder->generation;
+    }
+    xmlMutexUnlock(holder->mutex);
 
-    /* reserved for the future */
-    NULL,                                       /* void* reserved0; */
-    NULL,                                       /* void* reserved1; */
-};
+    if(mngr == NULL) {
+        xmlSecInternalError("xmlSecKeysMngrRef", NULL);
+        return(NULL);
+    }
+    return(mngr);
+}
 
 /**
- * xmlSecSimpleKeysStoreGetKlass:
+ * xmlSecKeysMngrHolderSwap:
+ * @holder:             the pointer to keys manager holder.
+ * @mngr:               the pointer to the new keys manager.
  *
- * The simple list based keys store klass.
+ * Adopts the fully loaded @mngr as the current keys manager: the operations
+ * started after this call use @mngr, the operations in progress keep
+ * using the previous keys manager which is destroyed when the last of
+ * them releases it.
  *
- * Returns: simple list based keys store klass.
+ * Returns: the new keys manager generation or 0 if an error occurs.
  */
-xmlSecKeyStoreId
-xmlSecSimpleKeysStoreGetKlass(void) {
-    return(&xmlSecSimpleKeysStoreKlass);
+xmlSecSize
+xmlSecKeysMngrHolderSwap(xmlSecKeysMngrHolderPtr holder, xmlSecKeysMngrPtr mngr) {
+    xmlSecKeysMngrPtr oldMngr;
+    xmlSecKeysMngrPtr* oldReplicas;
+    xmlSecSize oldReplicasSize;
+    int* oldCpuNodes;
+    xmlSecSize generation;
+
+    xmlSecAssert2(holder != NULL, 0);
+    xmlSecAssert2(holder->mutex != NULL, 0);
+    xmlSecAssert2(mngr != NULL, 0);
+
+    xmlMutexLock(holder->mutex);
+    oldMngr = holder->mngr;
+    oldReplicas = holder->replicas;
+    oldReplicasSize = holder->replicasSize;
+    oldCpuNodes = holder->cpuNodes;
+    holder->mngr = mngr;
+    holder->replicas = NULL;
+    holder->replicasSize = 0;
+    holder->cpuNodes = NULL;
+    holder->cpuNodesSize = 0;
+    generation = ++holder->generation;
+    xmlMutexUnlock(holder->mutex);
+
+    /* the operations in progress might still hold references */
+    if(oldMngr != NULL) {
+        xmlSecKeysMngrDestroy(oldMngr);
+    }
+    xmlSecKeysMngrHolderReplicasDestroy(oldReplicas, oldReplicasSize, oldCpuNodes);
+    return(generation);
 }
 
 /**
- * xmlSecSimpleKeysStoreAdoptKey:
- * @store:              the pointer to simple keys store.
- * @key:                the pointer to key.
+ * xmlSecKeysMngrHolderSwapReplicated:
+ * @holder:             the pointer to keys manager holder.
+ * @loadCallback:       the callback to create and load a keys manager.
+ * @context:            the @loadCallback context.
  *
- * Adds @key to the @store.
+ * Loads a copy of the keys manager for each NUMA node and adopts them as
+ * the current generation (see #xmlSecKeysMngrHolderSwap). Each copy is
+ * loaded by @loadCallback from a thread running on the node's CPUs, so
+ * its keys and certificates are allocated in the node's local memory,
+ * and #xmlSecKeysMngrHolderAcquire returns the copy for the node of the
+ * CPU the caller runs on.
  *
- * Returns: 0 on success or a negative value if an error occurs.
+ * The copies are never modified after loading: @loadCallback should load
+ * the same keys every time (e.g. from the same snapshot written by
+ * #xmlSecSimpleKeysStoreSaveSnapshot), and the keys should only be changed
+ * by loading the next generation.
+ *
+ * If the system has only one NUMA node (or the NUMA nodes can't be
+ * detected), @loadCallback is called once from the current thread.
+ *
+ * Returns: the new keys manager generation or 0 if an error occurs.
  */
-int
-xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
-    xmlSecPtrListPtr list;
+xmlSecSize
+xmlSecKeysMngrHolderSwapReplicated(xmlSecKeysMngrHolderPtr holder, xmlSecKeysMngrLoadCallback loadCallback,
+                                   void* context) {
+    xmlSecKeysMngrPtr mngr;
+    xmlSecKeysMngrPtr oldMngr;
+    xmlSecKeysMngrPtr* replicas = NULL;
+    xmlSecKeysMngrPtr* oldReplicas;
+    xmlSecSize replicasSize = 0;
+    xmlSecSize oldReplicasSize;
+    int* cpuNodes = NULL;
+    int* oldCpuNodes;
+    xmlSecSize cpuNodesSize = 0;
+    xmlSecSize generation;
     int ret;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
-    xmlSecAssert2(key != NULL, -1);
-
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+    xmlSecAssert2(holder != NULL, 0);
+    xmlSecAssert2(holder->mutex != NULL, 0);
+    xmlSecAssert2(loadCallback != NULL, 0);
 
-    ret = xmlSecPtrListAdd(list, key);
+    ret = xmlSecKeysMngrHolderLoadReplicas(loadCallback, context,
+        &replicas, &replicasSize, &cpuNodes, &cpuNodesSize);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecPtrListAdd",
-                            xmlSecKeyStoreGetName(store));
-        return(-1);
+        xmlSecInternalError("xmlSecKeysMngrHolderLoadReplicas", NULL);
+        return(0);
+    }
+    if(replicas == NULL) {
+        /* single node */
+        mngr = loadCallback(context);
+        if(mngr == NULL) {
+            xmlSecInternalError("loadCallback", NULL);
+            return(0);
+        }
+        generation = xmlSecKeysMngrHolderSwap(holder, mngr);
+        if(generation == 0) {
+            xmlSecInternalError("xmlSecKeysMngrHolderSwap", NULL);
+            xmlSecKeysMngrDestroy(mngr);
+            return(0);
+        }
+        return(generation);
     }
+    xmlSecAssert2(replicasSize > 0, 0);
+    xmlSecAssert2(replicas[0] != NULL, 0);
 
-    return(0);
+    /* the first node's copy is used by the CPUs we don't know about */
+    mngr = xmlSecKeysMngrRef(replicas[0]);
+    if(mngr == NULL) {
+        xmlSecInternalError("xmlSecKeysMngrRef", NULL);
+        xmlSecKeysMngrHolderReplicasDestroy(replicas, replicasSize, cpuNodes);
+        return(0);
+    }
+
+    xmlMutexLock(holder->mutex);
+    oldMngr = holder->mngr;
+    oldReplicas = holder->replicas;
+    oldReplicasSize = holder->replicasSize;
+    oldCpuNodes = holder->cpuNodes;
+    holder->mngr = mngr;
+    holder->replicas = replicas;
+    holder->replicasSize = replicasSize;
+    holder->cpuNodes = cpuNodes;
+    holder->cpuNodesSize = cpuNodesSize;
+    generation = ++holder->generation;
+    xmlMutexUnlock(holder->mutex);
+
+    /* the operations in progress might still hold references */
+    if(oldMngr != NULL) {
+        xmlSecKeysMngrDestroy(oldMngr);
+    }
+    xmlSecKeysMngrHolderReplicasDestroy(oldReplicas, oldReplicasSize, oldCpuNodes);
+    return(generation);
 }
 
-/**
- * xmlSecSimpleKeysStoreLoad:
- * @store:              the pointer to simple keys store.
- * @uri:                the filename.
- * @keysMngr:           the pointer to associated keys manager.
- *
- * Reads keys from an XML file.
- *
- * Returns: 0 on success or a negative value if an error occurs.
- */
-int
-xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
-                            xmlSecKeysMngrPtr keysMngr) {
-    xmlDocPtr doc;
-    xmlNodePtr root;
-    xmlNodePtr cur;
-    xmlSecKeyPtr key;
-    xmlSecKeyInfoCtx keyInfoCtx;
-    int ret;
+static void
+xmlSecKeysMngrHolderReplicasDestroy(xmlSecKeysMngrPtr* replicas, xmlSecSize replicasSize, int* cpuNodes) {
+    xmlSecSize ii;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
-    xmlSecAssert2(uri != NULL, -1);
+    if(replicas != NULL) {
+        for(ii = 0; ii < replicasSize; ++ii) {
+            if(replicas[ii] != NULL) {
+                xmlSecKeysMngrDestroy(replicas[ii]);
+            }
+        }
+        xmlFree(replicas);
+    }
+    if(cpuNodes != NULL) {
+        xmlFree(cpuNodes);
+    }
+}
 
-    doc = xmlParseFile(uri);
-    if(doc == NULL) {
-        xmlSecXmlError2("xmlParseFile", xmlSecKeyStoreGetName(store),
-                        "uri=%s", xmlSecErrorsSafeString(uri));
+#ifdef XMLSEC_KEYS_MNGR_NUMA
+
+typedef struct _xmlSecKeysMngrReplicaLoader {
+    xmlSecKeysMngrLoadCallback  loadCallback;
+    void*                       context;
+    cpu_set_t                   cpus;
+    xmlSecKeysMngrPtr           mngr;
+    pthread_t                   thread;
+    int                         started;
+} xmlSecKeysMngrReplicaLoader, *xmlSecKeysMngrReplicaLoaderPtr;
+
+static int
+xmlSecKeysMngrHolderCurrentCpu(void) {
+    return(sched_getcpu());
+}
+
+/* parses the "0-3,8-11" CPUs list */
+static int
+xmlSecKeysMngrHolderReadCpuList(const char* filename, cpu_set_t* cpus) {
+    FILE* f;
+    char buf[1024];
+    char* p;
+    long first, last;
+
+    xmlSecAssert2(filename != NULL, -1);
+    xmlSecAssert2(cpus != NULL, -1);
+
+    f = fopen(filename, "r");
+    if(f == NULL) {
         return(-1);
     }
-
-    root = xmlDocGetRootElement(doc);
-    if(!xmlSecCheckNodeName(root, BAD_CAST "Keys", xmlSecNs)) {
-        xmlSecInvalidNodeError(root, BAD_CAST "Keys",
-                               xmlSecKeyStoreGetName(store));
-        xmlFreeDoc(doc);
+    p = fgets(buf, sizeof(buf), f);
+    fclose(f);
+    if(p == NULL) {
         return(-1);
     }
 
-    cur = xmlSecGetNextElementNode(root->children);
-    while((cur != NULL) && xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs)) {
-        key = xmlSecKeyCreate();
-        if(key == NULL) {
-            xmlSecInternalError("xmlSecKeyCreate",
-                                xmlSecKeyStoreGetName(store));
-            xmlFreeDoc(doc);
-            return(-1);
+    CPU_ZERO(cpus);
+    while((*p) != '\0') {
+        if((*p < '0') || (*p > '9')) {
+            ++p;
+            continue;
         }
-
-        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
-                                xmlSecKeyStoreGetName(store));
-            xmlSecKeyDestroy(key);
-            xmlFreeDoc(doc);
-            return(-1);
+        first = strtol(p, &p, 10);
+        last = first;
+        if((*p) == '-') {
+            last = strtol(p + 1, &p, 10);
         }
+        for(; (first <= last) && (first < CPU_SETSIZE); ++first) {
+            CPU_SET((int)first, cpus);
+        }
+    }
+    return(0);
+}
 
-        keyInfoCtx.mode           = xmlSecKeyInfoModeRead;
-        keyInfoCtx.keysMngr       = keysMngr;
-        keyInfoCtx.flags          = XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND |
-                                    XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
-        keyInfoCtx.keyReq.keyId   = xmlSecKeyDataIdUnknown;
-        keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeAny;
-        keyInfoCtx.keyReq.keyUsage= xmlSecKeyDataUsageAny;
+static void*
+xmlSecKeysMngrHolderLoadReplica(void* arg) {
+    xmlSecKeysMngrReplicaLoaderPtr loader = (xmlSecKeysMngrReplicaLoaderPtr)arg;
 
-        ret = xmlSecKeyInfoNodeRead(cur, key, &keyInfoCtx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeRead",
-                                xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
-            xmlSecKeyDestroy(key);
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    /* the memory is allocated on the node of the CPU that touches it first */
+    (void)sched_setaffinity(0, sizeof(cpu_set_t), &(loader->cpus));
+    loader->mngr = loader->loadCallback(loader->context);
+    return(NULL);
+}
 
-        if(xmlSecKeyIsValid(key)) {
-            ret = xmlSecSimpleKeysStoreAdoptKey(store, key);
-            if(ret < 0) {
-                xmlSecInternalError("xmlSecSimpleKeysStoreAdoptKey",
-                                    xmlSecKeyStoreGetName(store));
-                xmlSecKeyDestroy(key);
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        } else {
-            /* we have an unknown key in our file, just ignore it */
-            xmlSecKeyDestroy(key);
+static int
+xmlSecKeysMngrHolderLoadReplicas(xmlSecKeysMngrLoadCallback loadCallback, void* context,
+                                 xmlSecKeysMngrPtr** replicas, xmlSecSize* replicasSize,
+                                 int** cpuNodes, xmlSecSize* cpuNodesSize) {
+    xmlSecKeysMngrReplicaLoaderPtr loaders = NULL;
+    xmlSecSize nodesNumber, ii;
+    char filename[128];
+    cpu_set_t cpus;
+    int cpu;
+    int res = -1;
+
+    xmlSecAssert2(loadCallback != NULL, -1);
+    xmlSecAssert2(replicas != NULL, -1);
+    xmlSecAssert2(replicasSize != NULL, -1);
+    xmlSecAssert2(cpuNodes != NULL, -1);
+    xmlSecAssert2(cpuNodesSize != NULL, -1);
+
+    (*replicas) = NULL;
+    (*replicasSize) = 0;
+    (*cpuNodes) = NULL;
+    (*cpuNodesSize) = 0;
+
+    /* the nodes are numbered from 0 without gaps */
+    for(nodesNumber = 0; ; ++nodesNumber) {
+        snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%lu/cpulist",
+            (unsigned long)nodesNumber);
+        if(xmlSecKeysMngrHolderReadCpuList(filename, &cpus) < 0) {
+            break;
         }
-        cur = xmlSecGetNextElementNode(cur->next);
     }
-
-    if(cur != NULL) {
-        xmlSecUnexpectedNodeError(cur, xmlSecKeyStoreGetName(store));
-        xmlFreeDoc(doc);
-        return(-1);
+    if(nodesNumber <= 1) {
+        /* nothing to replicate */
+        return(0);
     }
 
-    xmlFreeDoc(doc);
-    return(0);
-
-}
+    loaders = (xmlSecKeysMngrReplicaLoaderPtr)xmlMalloc(sizeof(xmlSecKeysMngrReplicaLoader) * nodesNumber);
+    if(loaders == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeysMngrReplicaLoader) * nodesNumber, NULL);
+        goto done;
+    }
+    memset(loaders, 0, sizeof(xmlSecKeysMngrReplicaLoader) * nodesNumber);
+
+    (*cpuNodes) = (int*)xmlMalloc(sizeof(int) * CPU_SETSIZE);
+    if((*cpuNodes) == NULL) {
+        xmlSecMallocError(sizeof(int) * CPU_SETSIZE, NULL);
+        goto done;
+    }
+    for(cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        (*cpuNodes)[cpu] = -1;
+    }
+    (*cpuNodesSize) = CPU_SETSIZE;
+
+    for(ii = 0; ii < nodesNumber; ++ii) {
+        snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%lu/cpulist",
+            (unsigned long)ii);
+        if(xmlSecKeysMngrHolderReadCpuList(filename, &(loaders[ii].cpus)) < 0) {
+            xmlSecIOError("fopen", filename, NULL);
+            goto done;
+        }
+        for(cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if(CPU_ISSET(cpu, &(loaders[ii].cpus))) {
+                (*cpuNodes)[cpu] = (int)ii;
+            }
+        }
+        loaders[ii].loadCallback = loadCallback;
+        loaders[ii].context = context;
+    }
+
+    /* load all the copies at once */
+    for(ii = 0; ii < nodesNumber; ++ii) {
+        if(pthread_create(&(loaders[ii].thread), NULL, xmlSecKeysMngrHolderLoadReplica, &(loaders[ii])) != 0) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_create: node=%lu",
+                (unsigned long)ii);
+            goto done;
+        }
+        loaders[ii].started = 1;
+    }
+
+    res = 0;
+
+done:
+    if(loaders != NULL) {
+        for(ii = 0; ii < nodesNumber; ++ii) {
+            if(loaders[ii].started != 0) {
+                pthread_join(loaders[ii].thread, NULL);
+            }
+            if((loaders[ii].mngr == NULL) && (res == 0)) {
+                xmlSecInternalError2("loadCallback", NULL, "node=%lu", (unsigned long)ii);
+                res = -1;
+            }
+        }
+    }
+    if(res == 0) {
+        (*replicas) = (xmlSecKeysMngrPtr*)xmlMalloc(sizeof(xmlSecKeysMngrPtr) * nodesNumber);
+        if((*replicas) == NULL) {
+            xmlSecMallocError(sizeof(xmlSecKeysMngrPtr) * nodesNumber, NULL);
+            res = -1;
+        }
+    }
+    if(res == 0) {
+        for(ii = 0; ii < nodesNumber; ++ii) {
+            (*replicas)[ii] = loaders[ii].mngr;
+        }
+        (*replicasSize) = nodesNumber;
+    } else {
+        if(loaders != NULL) {
+            for(ii = 0; ii < nodesNumber; ++ii) {
+                if(loaders[ii].mngr != NULL) {
+                    xmlSecKeysMngrDestroy(loaders[ii].mngr);
+                }
+            }
+        }
+        if((*cpuNodes) != NULL) {
+            xmlFree(*cpuNodes);
+            (*cpuNodes) = NULL;
+        }
+        (*cpuNodesSize) = 0;
+    }
+    if(loaders != NULL) {
+        xmlFree(loaders);
+    }
+    return(res);
+}
+
+#else /* XMLSEC_KEYS_MNGR_NUMA */
+
+static int
+xmlSecKeysMngrHolderCurrentCpu(void) {
+    return(-1);
+}
+
+static int
+xmlSecKeysMngrHolderLoadReplicas(xmlSecKeysMngrLoadCallback loadCallback ATTRIBUTE_UNUSED,
+                                 void* context ATTRIBUTE_UNUSED,
+                                 xmlSecKeysMngrPtr** replicas, xmlSecSize* replicasSize,
+                                 int** cpuNodes, xmlSecSize* cpuNodesSize) {
+    xmlSecAssert2(replicas != NULL, -1);
+    xmlSecAssert2(replicasSize != NULL, -1);
+    xmlSecAssert2(cpuNodes != NULL, -1);
+    xmlSecAssert2(cpuNodesSize != NULL, -1);
+
+    /* no NUMA nodes detection: a single copy */
+    (*replicas) = NULL;
+    (*replicasSize) = 0;
+    (*cpuNodes) = NULL;
+    (*cpuNodesSize) = 0;
+    return(0);
+}
+
+#endif /* XMLSEC_KEYS_MNGR_NUMA */
+
+/**************************************************************************
+ *
+ * Resolved keys cache
+ *
+ * The keys resolved from the self-contained <dsig:KeyInfo/> nodes (only
+ * <dsig:KeyName/>, <dsig:KeyValue/> and <dsig:X509Data/> children) are
+ * kept as shared keys (see xmlSecKeyShare) indexed by the serialized
+ * <dsig:KeyInfo/> node and the key requirements.
+ *
+ * The unwrapped <enc:EncryptedKey/> values are kept in a separate cache
+ * indexed by the serialized <enc:EncryptedKey/> node: it contains the
+ * <enc:CipherValue/> and the <dsig:KeyInfo/> that selects the decryption
+ * key in the keys manager.
+ *
+ * The verified signatures cache only remembers the names: the signed data
+ * and signature value together with the <dsig:KeyInfo/> node and the key
+ * requirements used to resolve the verification key.
+ *
+ *************************************************************************/
+typedef struct _xmlSecKeyCacheItem {
+    xmlSecKeyPtr                key;
+    xmlSecBufferPtr             data;
+    time_t                      expires;
+    unsigned int                generation;
+} xmlSecKeyCacheItem, *xmlSecKeyCacheItemPtr;
+
+typedef struct _xmlSecKeyCache {
+    xmlHashTablePtr             items;
+    xmlSecSize                  maxSize;
+    unsigned int                ttl;
+    unsigned int                generation;
+    xmlMutexPtr                 mutex;          /* protects all of the above */
+} xmlSecKeyCache, *xmlSecKeyCachePtr;
+
+static void
+xmlSecKeyCacheItemDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    xmlSecKeyCacheItemPtr item = (xmlSecKeyCacheItemPtr)payload;
+
+    if(item != NULL) {
+        if(item->key != NULL) {
+            xmlSecKeyDestroy(item->key);
+        }
+        if(item->data != NULL) {
+            /* the buffer is zeroed before it is freed */
+            xmlSecBufferDestroy(item->data);
+        }
+        xmlFree(item);
+    }
+}
+
+static xmlSecKeyCachePtr
+xmlSecKeyCacheCreate(xmlSecSize maxSize, unsigned int ttl) {
+    xmlSecKeyCachePtr ctx;
+
+    xmlSecAssert2(maxSize > 0, NULL);
+
+    ctx = (xmlSecKeyCachePtr)xmlMalloc(sizeof(xmlSecKeyCache));
+    if(ctx == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyCache), NULL);
+        return(NULL);
+    }
+    memset(ctx, 0, sizeof(xmlSecKeyCache));
+    ctx->maxSize = maxSize;
+    ctx->ttl = ttl;
+
+    ctx->items = xmlHashCreate(0);
+    if(ctx->items == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecKeysMngrKeyCacheDestroy(ctx);
+        return(NULL);
+    }
+    ctx->mutex = xmlNewMutex();
+    if(ctx->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlSecKeysMngrKeyCacheDestroy(ctx);
+        return(NULL);
+    }
+    return(ctx);
+}
+
+static void
+xmlSecKeysMngrKeyCacheDestroy(void* cache) {
+    xmlSecKeyCachePtr ctx = (xmlSecKeyCachePtr)cache;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->items != NULL) {
+        xmlHashFree(ctx->items, xmlSecKeyCacheItemDestroy);
+    }
+    if(ctx->mutex != NULL) {
+        xmlFreeMutex(ctx->mutex);
+    }
+    memset(ctx, 0, sizeof(xmlSecKeyCache));
+    xmlFree(ctx);
+}
+
+static void
+xmlSecKeyCacheInvalidate(xmlSecKeyCachePtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    /* the stale items are removed on lookup or when the cache is full */
+    xmlMutexLock(ctx->mutex);
+    ++ctx->generation;
+    xmlMutexUnlock(ctx->mutex);
+}
+
+static int
+xmlSecKeyCacheItemIsValid(xmlSecKeyCachePtr ctx, xmlSecKeyCacheItemPtr item, time_t now) {
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(item != NULL, 0);
+
+    if(item->generation != ctx->generation) {
+        return(0);
+    }
+    if((ctx->ttl > 0) && (item->expires <= now)) {
+        return(0);
+    }
+    return(1);
+}
+
+/* must be called with the cache mutex locked */
+static xmlSecKeyCacheItemPtr
+xmlSecKeyCacheLookup(xmlSecKeyCachePtr ctx, const xmlChar* name) {
+    xmlSecKeyCacheItemPtr item;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+
+    item = (xmlSecKeyCacheItemPtr)xmlHashLookup(ctx->items, name);
+    if(item == NULL) {
+        return(NULL);
+    }
+    if(xmlSecKeyCacheItemIsValid(ctx, item, time(NULL)) != 1) {
+        xmlHashRemoveEntry(ctx->items, name, xmlSecKeyCacheItemDestroy);
+        return(NULL);
+    }
+    return(item);
+}
+
+typedef struct _xmlSecKeyCacheCleanupCtx {
+    xmlSecKeyCachePtr           cache;
+    time_t                      now;
+} xmlSecKeyCacheCleanupCtx;
+
+static void
+xmlSecKeyCacheCleanupItem(void* payload, void* data, const xmlChar* name) {
+    xmlSecKeyCacheCleanupCtx* cleanupCtx = (xmlSecKeyCacheCleanupCtx*)data;
+
+    if(xmlSecKeyCacheItemIsValid(cleanupCtx->cache, (xmlSecKeyCacheItemPtr)payload, cleanupCtx->now) != 1) {
+        xmlHashRemoveEntry(cleanupCtx->cache->items, name, xmlSecKeyCacheItemDestroy);
+    }
+}
+
+/* takes ownership of the @item (even on failure) */
+static int
+xmlSecKeyCacheInsert(xmlSecKeyCachePtr ctx, const xmlChar* name, xmlSecKeyCacheItemPtr item) {
+    xmlSecKeyCacheCleanupCtx cleanupCtx;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(item != NULL, -1);
+
+    xmlMutexLock(ctx->mutex);
+    cleanupCtx.cache = ctx;
+    cleanupCtx.now = time(NULL);
+    item->expires = cleanupCtx.now + ctx->ttl;
+    item->generation = ctx->generation;
+
+    /* make room: drop stale items first and everything if it is not enough */
+    if((xmlSecSize)xmlHashSize(ctx->items) >= ctx->maxSize) {
+        xmlHashScan(ctx->items, xmlSecKeyCacheCleanupItem, &cleanupCtx);
+    }
+    if((xmlSecSize)xmlHashSize(ctx->items) >= ctx->maxSize) {
+        xmlHashFree(ctx->items, xmlSecKeyCacheItemDestroy);
+        ctx->items = xmlHashCreate(0);
+    }
+    if(ctx->items != NULL) {
+        ret = xmlHashUpdateEntry(ctx->items, name, item, xmlSecKeyCacheItemDestroy);
+    } else {
+        ret = -1;
+    }
+    xmlMutexUnlock(ctx->mutex);
+
+    if(ret != 0) {
+        xmlSecXmlError("xmlHashUpdateEntry", NULL);
+        xmlSecKeyCacheItemDestroy(item, NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/*
+ * Appends the exclusive c14n of the @node subtree to @buf. Unlike the plain
+ * xmlNodeDump(), the output includes the namespaces declared on the @node
+ * ancestors and does not depend on the prefixes declared but not used, thus
+ * two subtrees produce the same output only if they have the same content.
+ */
+static int
+xmlSecKeyCacheDumpNode(xmlNodePtr node, xmlBufferPtr buf) {
+    xmlDocPtr doc;
+    xmlNodePtr copy;
+    xmlOutputBufferPtr output;
+    int ret;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+
+    /* the copy declares the namespaces defined outside of the subtree */
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    if(doc == NULL) {
+        xmlSecXmlError("xmlNewDoc", NULL);
+        return(-1);
+    }
+    copy = xmlDocCopyNode(node, doc, 1);
+    if(copy == NULL) {
+        xmlSecXmlError("xmlDocCopyNode", NULL);
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    xmlDocSetRootElement(doc, copy);
+
+    output = xmlOutputBufferCreateBuffer(buf, NULL);
+    if(output == NULL) {
+        xmlSecXmlError("xmlOutputBufferCreateBuffer", NULL);
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    ret = xmlC14NDocSaveTo(doc, NULL, XML_C14N_EXCLUSIVE_1_0, NULL, 0, output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlC14NDocSaveTo", NULL);
+        xmlOutputBufferClose(output);
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    ret = xmlOutputBufferClose(output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", NULL);
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    xmlFreeDoc(doc);
+    return(0);
+}
+
+static xmlChar*
+xmlSecKeyCacheGetName(xmlNodePtr node, const char* header) {
+    xmlBufferPtr buf;
+    xmlChar* res;
+    int ret;
+
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(header != NULL, NULL);
+
+    buf = xmlBufferCreate();
+    if(buf == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(NULL);
+    }
+    xmlBufferCCat(buf, header);
+    ret = xmlSecKeyCacheDumpNode(node, buf);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyCacheDumpNode", NULL);
+        xmlBufferFree(buf);
+        return(NULL);
+    }
+    res = xmlStrdup(xmlBufferContent(buf));
+    if(res == NULL) {
+        xmlSecStrdupError(xmlBufferContent(buf), NULL);
+    }
+    xmlBufferFree(buf);
+    return(res);
+}
 
 /**
- * xmlSecSimpleKeysStoreSave:
- * @store:              the pointer to simple keys store.
- * @filename:           the filename.
- * @type:               the saved keys type (public, private, ...).
+ * xmlSecKeysMngrEnableKeyCache:
+ * @mngr:               the pointer to keys manager.
+ * @maxSize:            the max number of cached keys.
+ * @ttl:                the cached keys time to live in seconds (0 means
+ *                      the keys never expire).
  *
- * Writes keys from @store to an XML file.
+ * Enables the resolved keys cache in #xmlSecKeysMngrGetKey: the key
+ * found for a <dsig:KeyInfo/> node that only has <dsig:KeyName/>,
+ * <dsig:KeyValue/> and <dsig:X509Data/> children is remembered and
+ * returned for the following <dsig:KeyInfo/> nodes with the same exclusive
+ * c14n form (i.e. the same content and namespaces), the same key
+ * requirements and <dsig:KeyInfo/> processing settings without parsing
+ * the key and verifying the certificates again. The cached keys
+ * are shared (see #xmlSecKeyShare) and must not be modified.
+ *
+ * The cache is invalidated when a keys or data store is adopted by @mngr;
+ * the application should call #xmlSecKeysMngrInvalidateKeyCache when it
+ * changes the content of the stores (e.g. adds keys, certificates or CRLs).
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
-xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
-    xmlSecKeyInfoCtx keyInfoCtx;
-    xmlSecPtrListPtr list;
-    xmlSecKeyPtr key;
-    xmlSecSize i, keysSize;
-    xmlDocPtr doc;
+xmlSecKeysMngrEnableKeyCache(xmlSecKeysMngrPtr mngr, xmlSecSize maxSize, unsigned int ttl) {
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->keyCache == NULL, -1);
+    xmlSecAssert2(maxSize > 0, -1);
+
+    mngr->keyCache = xmlSecKeyCacheCreate(maxSize, ttl);
+    if(mngr->keyCache == NULL) {
+        xmlSecInternalError("xmlSecKeyCacheCreate", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrEnableEncryptedKeyCache:
+ * @mngr:               the pointer to keys manager.
+ * @maxSize:            the max number of cached keys.
+ * @ttl:                the cached keys time to live in seconds (0 means
+ *                      the keys never expire).
+ *
+ * Enables the unwrapped keys cache for <enc:EncryptedKey/> nodes: the
+ * decrypted key value is remembered and an <enc:EncryptedKey/> node with
+ * the same exclusive c14n form (same <enc:EncryptionMethod/>, <dsig:KeyInfo/>
+ * and <enc:CipherValue/> with the same namespaces) is not decrypted again
+ * with the keys from @mngr.
+ * This saves the expensive RSA private key operation when the same
+ * session key arrives in many messages.
+ *
+ * The cache keeps the plain session keys in memory for @ttl seconds and
+ * lets anybody who can replay the <enc:EncryptedKey/> node skip the
+ * decryption: it is disabled by default and should only be enabled when
+ * this is acceptable. The cache is invalidated the same way as the
+ * resolved keys cache (see #xmlSecKeysMngrInvalidateKeyCache).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysMngrEnableEncryptedKeyCache(xmlSecKeysMngrPtr mngr, xmlSecSize maxSize, unsigned int ttl) {
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->encKeyCache == NULL, -1);
+    xmlSecAssert2(maxSize > 0, -1);
+
+    mngr->encKeyCache = xmlSecKeyCacheCreate(maxSize, ttl);
+    if(mngr->encKeyCache == NULL) {
+        xmlSecInternalError("xmlSecKeyCacheCreate", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrEnableVerifyCache:
+ * @mngr:               the pointer to keys manager.
+ * @maxSize:            the max number of cached signatures.
+ * @ttl:                the cached signatures time to live in seconds (0 means
+ *                      the signatures never expire).
+ *
+ * Enables the verified signatures cache for the retried and duplicate
+ * messages: when a <dsig:Signature/> is successfully verified, the
+ * canonical <dsig:SignedInfo/>, the <dsig:SignatureValue/> and the
+ * exclusive c14n of the <dsig:KeyInfo/> node that selected the key in
+ * @mngr are remembered.
+ * An identical signature is then verified without the public key
+ * operation: the <dsig:SignedInfo/> is still canonicalized and all
+ * the <dsig:Reference/> digests are still checked.
+ *
+ * Only the signatures with the same-document references (the "URI"
+ * attribute is empty or starts with '#') verified with the key found by
+ * #xmlSecKeysMngrGetKey are cached. The cache is invalidated the same
+ * way as the resolved keys cache (see #xmlSecKeysMngrInvalidateKeyCache).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysMngrEnableVerifyCache(xmlSecKeysMngrPtr mngr, xmlSecSize maxSize, unsigned int ttl) {
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->verifyCache == NULL, -1);
+    xmlSecAssert2(maxSize > 0, -1);
+
+    mngr->verifyCache = xmlSecKeyCacheCreate(maxSize, ttl);
+    if(mngr->verifyCache == NULL) {
+        xmlSecInternalError("xmlSecKeyCacheCreate", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrInvalidateKeyCache:
+ * @mngr:               the pointer to keys manager.
+ *
+ * Drops all the keys from the resolved keys and unwrapped keys caches
+ * and all the signatures from the verified signatures cache (see
+ * #xmlSecKeysMngrEnableKeyCache, #xmlSecKeysMngrEnableEncryptedKeyCache
+ * and #xmlSecKeysMngrEnableVerifyCache). The keys already returned to
+ * the callers are not affected.
+ */
+void
+xmlSecKeysMngrInvalidateKeyCache(xmlSecKeysMngrPtr mngr) {
+    xmlSecAssert(mngr != NULL);
+
+    if(mngr->keyCache != NULL) {
+        xmlSecKeyCacheInvalidate((xmlSecKeyCachePtr)mngr->keyCache);
+    }
+    if(mngr->encKeyCache != NULL) {
+        xmlSecKeyCacheInvalidate((xmlSecKeyCachePtr)mngr->encKeyCache);
+    }
+    if(mngr->verifyCache != NULL) {
+        xmlSecKeyCacheInvalidate((xmlSecKeyCachePtr)mngr->verifyCache);
+    }
+}
+
+/*
+ * Writes the key requirements and the <dsig:KeyInfo/> processing settings
+ * to @header. Returns 1 if the key found for @keyInfoNode (NULL means
+ * the key is looked up in the keys store) can be cached, 0 if not or
+ * a negative value if an error occurs.
+ */
+static int
+xmlSecKeysMngrKeyCacheGetHeader(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                char* header, int headerSize) {
     xmlNodePtr cur;
-    xmlSecKeyDataPtr data;
-    xmlSecPtrListPtr idsList;
-    xmlSecKeyDataId dataId;
-    xmlSecSize idsSize, j;
+    int ret;
+
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(headerSize > 0, -1);
+
+    /* only the keys defined by <dsig:KeyInfo/> content alone are cached */
+    if((keyInfoCtx->mode != xmlSecKeyInfoModeRead) ||
+       (xmlSecPtrListGetSize(&(keyInfoCtx->enabledKeyData)) > 0) ||
+       (xmlSecPtrListGetSize(&(keyInfoCtx->keyReq.keyUseWithList)) > 0)) {
+        return(0);
+    }
+    cur = (keyInfoNode != NULL) ? xmlSecGetNextElementNode(keyInfoNode->children) : NULL;
+    for(; cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeKeyName, xmlSecDSigNs) &&
+           !xmlSecCheckNodeName(cur, xmlSecNodeKeyValue, xmlSecDSigNs) &&
+           !xmlSecCheckNodeName(cur, xmlSecNodeX509Data, xmlSecDSigNs)) {
+            return(0);
+        }
+    }
+
+    /* the key requirements and the settings that change the result */
+    ret = xmlStrPrintf(BAD_CAST header, headerSize, "%s:%u:%u:%lu:%u:%u:%ld:%d|",
+            xmlSecErrorsSafeString(xmlSecKeyDataKlassGetName(keyInfoCtx->keyReq.keyId)),
+            keyInfoCtx->keyReq.keyType,
+            keyInfoCtx->keyReq.keyUsage,
+            (unsigned long)keyInfoCtx->keyReq.keyBitsSize,
+            keyInfoCtx->flags,
+            keyInfoCtx->flags2,
+#ifndef XMLSEC_NO_X509
+            (long)keyInfoCtx->certsVerificationTime,
+            keyInfoCtx->certsVerificationDepth
+#else /* XMLSEC_NO_X509 */
+            0L, 0
+#endif /* XMLSEC_NO_X509 */
+    );
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        return(-1);
+    }
+    return(1);
+}
+
+static xmlChar*
+xmlSecKeysMngrKeyCacheGetName(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    char header[256];
+    int ret;
+
+    xmlSecAssert2(keyInfoNode != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    ret = xmlSecKeysMngrKeyCacheGetHeader(keyInfoNode, keyInfoCtx, header, sizeof(header));
+    if(ret != 1) {
+        return(NULL);
+    }
+    return(xmlSecKeyCacheGetName(keyInfoNode, header));
+}
+
+/**
+ * xmlSecKeysMngrKeyCacheFind:
+ * @mngr:               the pointer to keys manager.
+ * @keyInfoNode:        the pointer to <dsig:KeyInfo/> node.
+ * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
+ * @cacheKey:           the pointer to the returned cache key.
+ *
+ * Lookups the key for @keyInfoNode in the resolved keys cache. If the key
+ * is not found but could be cached then the cache key is returned in
+ * @cacheKey, the caller is responsible for freeing it with xmlFree.
+ *
+ * Returns: the key (the caller is responsible for destroying it) or NULL
+ * if the key is not found or an error occurs.
+ */
+xmlSecKeyPtr
+xmlSecKeysMngrKeyCacheFind(xmlSecKeysMngrPtr mngr, xmlNodePtr keyInfoNode,
+                           xmlSecKeyInfoCtxPtr keyInfoCtx, xmlChar** cacheKey) {
+    xmlSecKeyCachePtr ctx;
+    xmlSecKeyCacheItemPtr item;
+    xmlSecKeyPtr key = NULL;
+    xmlChar* name;
+
+    xmlSecAssert2(mngr != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+    xmlSecAssert2(cacheKey != NULL, NULL);
+
+    (*cacheKey) = NULL;
+    ctx = (xmlSecKeyCachePtr)mngr->keyCache;
+    if((ctx == NULL) || (keyInfoNode == NULL)) {
+        return(NULL);
+    }
+
+    name = xmlSecKeysMngrKeyCacheGetName(keyInfoNode, keyInfoCtx);
+    if(name == NULL) {
+        return(NULL);
+    }
+
+    xmlMutexLock(ctx->mutex);
+    item = xmlSecKeyCacheLookup(ctx, name);
+    if(item != NULL) {
+        key = xmlSecKeyDuplicate(item->key);
+    }
+    xmlMutexUnlock(ctx->mutex);
+
+    if(key != NULL) {
+        xmlSecMetricsAdd(xmlSecMetricKeysCacheHits, 1);
+        xmlFree(name);
+        return(key);
+    }
+    xmlSecMetricsAdd(xmlSecMetricKeysCacheMisses, 1);
+    (*cacheKey) = name;
+    return(NULL);
+}
+
+/**
+ * xmlSecKeysMngrKeyCacheAdd:
+ * @mngr:               the pointer to keys manager.
+ * @cacheKey:           the cache key returned by #xmlSecKeysMngrKeyCacheFind.
+ * @key:                the resolved key.
+ *
+ * Adds a copy of the @key to the resolved keys cache.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysMngrKeyCacheAdd(xmlSecKeysMngrPtr mngr, const xmlChar* cacheKey, xmlSecKeyPtr key) {
+    xmlSecKeyCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->keyCache != NULL, -1);
+    xmlSecAssert2(cacheKey != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    item = (xmlSecKeyCacheItemPtr)xmlMalloc(sizeof(xmlSecKeyCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyCacheItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecKeyCacheItem));
+
+    item->key = xmlSecKeyDuplicate(key);
+    if(item->key == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        xmlSecKeyCacheItemDestroy(item, NULL);
+        return(-1);
+    }
+    ret = xmlSecKeyShare(item->key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyShare", NULL);
+        xmlSecKeyCacheItemDestroy(item, NULL);
+        return(-1);
+    }
+
+    ret = xmlSecKeyCacheInsert((xmlSecKeyCachePtr)mngr->keyCache, cacheKey, item);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyCacheInsert", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrEncryptedKeyCacheFind:
+ * @mngr:               the pointer to keys manager.
+ * @encKeyNode:         the pointer to <enc:EncryptedKey/> node.
+ * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
+ * @cacheKey:           the pointer to the returned cache key.
+ *
+ * Lookups the unwrapped key value for @encKeyNode in the unwrapped keys
+ * cache. If the value is not found but could be cached then the cache
+ * key is returned in @cacheKey, the caller is responsible for freeing
+ * it with xmlFree.
+ *
+ * Returns: the copy of the unwrapped key value (the caller is responsible
+ * for destroying it) or NULL if the value is not found or an error occurs.
+ */
+xmlSecBufferPtr
+xmlSecKeysMngrEncryptedKeyCacheFind(xmlSecKeysMngrPtr mngr, xmlNodePtr encKeyNode,
+                                    xmlSecKeyInfoCtxPtr keyInfoCtx, xmlChar** cacheKey) {
+    xmlSecKeyCachePtr ctx;
+    xmlSecKeyCacheItemPtr item;
+    xmlSecBufferPtr res = NULL;
+    xmlChar* name;
+    char header[64];
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, NULL);
+    xmlSecAssert2(encKeyNode != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+    xmlSecAssert2(cacheKey != NULL, NULL);
+
+    (*cacheKey) = NULL;
+    ctx = (xmlSecKeyCachePtr)mngr->encKeyCache;
+    if(ctx == NULL) {
+        return(NULL);
+    }
+
+    /* the flags change the way the decryption key is found */
+    ret = xmlStrPrintf(BAD_CAST header, sizeof(header), "%u:%u|",
+            keyInfoCtx->flags, keyInfoCtx->flags2);
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        return(NULL);
+    }
+    name = xmlSecKeyCacheGetName(encKeyNode, header);
+    if(name == NULL) {
+        xmlSecInternalError("xmlSecKeyCacheGetName", NULL);
+        return(NULL);
+    }
+
+    xmlMutexLock(ctx->mutex);
+    item = xmlSecKeyCacheLookup(ctx, name);
+    if(item != NULL) {
+        res = xmlSecBufferCreate(xmlSecBufferGetSize(item->data));
+        if(res != NULL) {
+            ret = xmlSecBufferSetData(res, xmlSecBufferGetData(item->data),
+                                      xmlSecBufferGetSize(item->data));
+            if(ret < 0) {
+                xmlSecBufferDestroy(res);
+                res = NULL;
+            }
+        }
+    }
+    xmlMutexUnlock(ctx->mutex);
+
+    if(res != NULL) {
+        xmlSecMetricsAdd(xmlSecMetricKeysCacheHits, 1);
+        xmlFree(name);
+        return(res);
+    }
+    xmlSecMetricsAdd(xmlSecMetricKeysCacheMisses, 1);
+    (*cacheKey) = name;
+    return(NULL);
+}
+
+/**
+ * xmlSecKeysMngrEncryptedKeyCacheAdd:
+ * @mngr:               the pointer to keys manager.
+ * @cacheKey:           the cache key returned by #xmlSecKeysMngrEncryptedKeyCacheFind.
+ * @data:               the unwrapped key value.
+ * @dataSize:           the unwrapped key value size.
+ *
+ * Adds a copy of the unwrapped key value to the unwrapped keys cache.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysMngrEncryptedKeyCacheAdd(xmlSecKeysMngrPtr mngr, const xmlChar* cacheKey,
+                                   const xmlSecByte* data, xmlSecSize dataSize) {
+    xmlSecKeyCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->encKeyCache != NULL, -1);
+    xmlSecAssert2(cacheKey != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize > 0, -1);
+
+    item = (xmlSecKeyCacheItemPtr)xmlMalloc(sizeof(xmlSecKeyCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyCacheItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecKeyCacheItem));
+
+    item->data = xmlSecBufferCreate(dataSize);
+    if(item->data == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        xmlSecKeyCacheItemDestroy(item, NULL);
+        return(-1);
+    }
+    ret = xmlSecBufferSetData(item->data, data, dataSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetData", NULL);
+        xmlSecKeyCacheItemDestroy(item, NULL);
+        return(-1);
+    }
+
+    ret = xmlSecKeyCacheInsert((xmlSecKeyCachePtr)mngr->encKeyCache, cacheKey, item);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyCacheInsert", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrVerifyCacheFind:
+ * @mngr:               the pointer to keys manager.
+ * @keyInfoNode:        the pointer to <dsig:KeyInfo/> node (might be NULL).
+ * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
+ * @signature:          the signed data and signature value.
+ * @cacheKey:           the pointer to the returned cache key.
+ *
+ * Lookups the @signature verified with the key found by #xmlSecKeysMngrGetKey
+ * for @keyInfoNode in the verified signatures cache. If the signature is
+ * not found but could be cached then the cache key is returned in
+ * @cacheKey, the caller is responsible for freeing it with xmlFree.
+ *
+ * Returns: 1 if the signature was already verified, 0 if not or a negative
+ * value if an error occurs.
+ */
+int
+xmlSecKeysMngrVerifyCacheFind(xmlSecKeysMngrPtr mngr, xmlNodePtr keyInfoNode,
+                              xmlSecKeyInfoCtxPtr keyInfoCtx, const xmlChar* signature,
+                              xmlChar** cacheKey) {
+    xmlSecKeyCachePtr ctx;
+    xmlBufferPtr buf;
+    xmlChar* name;
+    char header[256];
+    int found;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(signature != NULL, -1);
+    xmlSecAssert2(cacheKey != NULL, -1);
+
+    (*cacheKey) = NULL;
+    ctx = (xmlSecKeyCachePtr)mngr->verifyCache;
+    if(ctx == NULL) {
+        return(0);
+    }
+
+    ret = xmlSecKeysMngrKeyCacheGetHeader(keyInfoNode, keyInfoCtx, header, sizeof(header));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeysMngrKeyCacheGetHeader", NULL);
+        return(-1);
+    } else if(ret == 0) {
+        return(0);
+    }
+
+    buf = xmlBufferCreate();
+    if(buf == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(-1);
+    }
+    xmlBufferCCat(buf, header);
+    if((keyInfoNode != NULL) && (xmlSecKeyCacheDumpNode(keyInfoNode, buf) < 0)) {
+        xmlSecInternalError("xmlSecKeyCacheDumpNode", NULL);
+        xmlBufferFree(buf);
+        return(-1);
+    }
+    xmlBufferCCat(buf, "|");
+    xmlBufferCat(buf, signature);
+    name = xmlStrdup(xmlBufferContent(buf));
+    if(name == NULL) {
+        xmlSecStrdupError(xmlBufferContent(buf), NULL);
+        xmlBufferFree(buf);
+        return(-1);
+    }
+    xmlBufferFree(buf);
+
+    xmlMutexLock(ctx->mutex);
+    found = (xmlSecKeyCacheLookup(ctx, name) != NULL) ? 1 : 0;
+    xmlMutexUnlock(ctx->mutex);
+
+    if(found != 0) {
+        xmlSecMetricsAdd(xmlSecMetricKeysCacheHits, 1);
+        xmlFree(name);
+        return(1);
+    }
+    xmlSecMetricsAdd(xmlSecMetricKeysCacheMisses, 1);
+    (*cacheKey) = name;
+    return(0);
+}
+
+/**
+ * xmlSecKeysMngrVerifyCacheAdd:
+ * @mngr:               the pointer to keys manager.
+ * @cacheKey:           the cache key returned by #xmlSecKeysMngrVerifyCacheFind.
+ *
+ * Adds the successfully verified signature to the verified signatures cache.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysMngrVerifyCacheAdd(xmlSecKeysMngrPtr mngr, const xmlChar* cacheKey) {
+    xmlSecKeyCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(mngr->verifyCache != NULL, -1);
+    xmlSecAssert2(cacheKey != NULL, -1);
+
+    item = (xmlSecKeyCacheItemPtr)xmlMalloc(sizeof(xmlSecKeyCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecKeyCacheItem), NULL);
+        return(-1);
+    }
+    memset(item, 0, sizeof(xmlSecKeyCacheItem));
+
+    ret = xmlSecKeyCacheInsert((xmlSecKeyCachePtr)mngr->verifyCache, cacheKey, item);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyCacheInsert", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * xmlSecKeyStore functions
+ *
+ *************************************************************************/
+/**
+ * xmlSecKeyStoreCreate:
+ * @id:                 the key store klass.
+ *
+ * Creates new store of the specified klass @klass. Caller is responsible
+ * for freeing the returned store by calling #xmlSecKeyStoreDestroy function.
+ *
+ * Returns: the pointer to newly allocated keys store or NULL if an error occurs.
+ */
+xmlSecKeyStorePtr
+xmlSecKeyStoreCreate(xmlSecKeyStoreId id)  {
+    xmlSecKeyStorePtr store;
+    int ret;
+
+    xmlSecAssert2(id != NULL, NULL);
+    xmlSecAssert2(id->objSize > 0, NULL);
+
+    /* Allocate a new xmlSecKeyStore and fill the fields. */
+    store = (xmlSecKeyStorePtr)xmlMalloc(id->objSize);
+    if(store == NULL) {
+        xmlSecMallocError(id->objSize,
+                          xmlSecKeyStoreKlassGetName(id));
+        return(NULL);
+    }
+    memset(store, 0, id->objSize);
+    store->id = id;
+
+    if(id->initialize != NULL) {
+        ret = (id->initialize)(store);
+        if(ret < 0) {
+            xmlSecInternalError("id->initialize",
+                                xmlSecKeyStoreKlassGetName(id));
+            xmlSecKeyStoreDestroy(store);
+            return(NULL);
+        }
+    }
+
+    return(store);
+}
+
+/**
+ * xmlSecKeyStoreDestroy:
+ * @store:              the pointer to keys store.
+ *
+ * Destroys the store created with #xmlSecKeyStoreCreate function.
+ */
+void
+xmlSecKeyStoreDestroy(xmlSecKeyStorePtr store) {
+    xmlSecAssert(xmlSecKeyStoreIsValid(store));
+    xmlSecAssert(store->id->objSize > 0);
+
+    if(store->id->finalize != NULL) {
+        (store->id->finalize)(store);
+    }
+    memset(store, 0, store->id->objSize);
+    xmlFree(store);
+}
+
+/**
+ * xmlSecKeyStoreFindKey:
+ * @store:              the pointer to keys store.
+ * @name:               the desired key name.
+ * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
+ *
+ * Lookups key in the store. The caller is responsible for destroying
+ * the returned key using #xmlSecKeyDestroy method.
+ *
+ * Returns: the pointer to a key or NULL if key is not found or an error occurs.
+ */
+xmlSecKeyPtr
+xmlSecKeyStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecAssert2(xmlSecKeyStoreIsValid(store), NULL);
+    xmlSecAssert2(store->id->findKey != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    return(store->id->findKey(store, name, keyInfoCtx));
+}
+
+/****************************************************************************
+ *
+ * Simple Keys Store
+ *
+ * xmlSecSimpleKeysStoreCtx is located after xmlSecKeyStore, the keys list
+ * (xmlSecPtrList) is the first member of the ctx.
+ *
+ ***************************************************************************/
+typedef struct _xmlSecSimpleKeysStoreNameEntry          xmlSecSimpleKeysStoreNameEntry,
+                                                        *xmlSecSimpleKeysStoreNameEntryPtr;
+struct _xmlSecSimpleKeysStoreNameEntry {
+    xmlSecSize*                         items;          /* positions in the keys list */
+    xmlSecSize                          size;
+    xmlSecSize                          maxSize;
+    xmlSecSimpleKeysStoreNameEntryPtr   next;
+};
+
+typedef struct _xmlSecSimpleKeysStoreSnapshot           xmlSecSimpleKeysStoreSnapshot,
+                                                        *xmlSecSimpleKeysStoreSnapshotPtr;
+
+/*
+ * The lookups only read the store and take the lock in the shared mode,
+ * the changes (adding, replacing or removing keys, decoding the snapshot
+ * and updating the index) take it in the exclusive mode.
+ */
+#if defined(XMLSEC_SIMPLE_KEYS_STORE_SRWLOCK)
+typedef SRWLOCK                                         xmlSecSimpleKeysStoreLock;
+#define xmlSecSimpleKeysStoreLockInitialize(lock)       (InitializeSRWLock(lock), 0)
+#define xmlSecSimpleKeysStoreLockFinalize(lock)
+#define xmlSecSimpleKeysStoreReadLock(lock)             AcquireSRWLockShared(lock)
+#define xmlSecSimpleKeysStoreReadUnlock(lock)           ReleaseSRWLockShared(lock)
+#define xmlSecSimpleKeysStoreWriteLock(lock)            AcquireSRWLockExclusive(lock)
+#define xmlSecSimpleKeysStoreWriteUnlock(lock)          ReleaseSRWLockExclusive(lock)
+#elif defined(XMLSEC_SIMPLE_KEYS_STORE_PTHREAD)
+typedef pthread_rwlock_t                                xmlSecSimpleKeysStoreLock;
+#define xmlSecSimpleKeysStoreLockInitialize(lock)       pthread_rwlock_init((lock), NULL)
+#define xmlSecSimpleKeysStoreLockFinalize(lock)         pthread_rwlock_destroy(lock)
+#define xmlSecSimpleKeysStoreReadLock(lock)             pthread_rwlock_rdlock(lock)
+#define xmlSecSimpleKeysStoreReadUnlock(lock)           pthread_rwlock_unlock(lock)
+#define xmlSecSimpleKeysStoreWriteLock(lock)            pthread_rwlock_wrlock(lock)
+#define xmlSecSimpleKeysStoreWriteUnlock(lock)          pthread_rwlock_unlock(lock)
+#else  /* defined(XMLSEC_SIMPLE_KEYS_STORE_PTHREAD) */
+/* no read-write locks: the lookups are serialized */
+typedef xmlMutexPtr                                     xmlSecSimpleKeysStoreLock;
+#define xmlSecSimpleKeysStoreLockInitialize(lock)       (((*(lock) = xmlNewMutex()) != NULL) ? 0 : -1)
+#define xmlSecSimpleKeysStoreLockFinalize(lock)         xmlFreeMutex(*(lock))
+#define xmlSecSimpleKeysStoreReadLock(lock)             xmlMutexLock(*(lock))
+#define xmlSecSimpleKeysStoreReadUnlock(lock)           xmlMutexUnlock(*(lock))
+#define xmlSecSimpleKeysStoreWriteLock(lock)            xmlMutexLock(*(lock))
+#define xmlSecSimpleKeysStoreWriteUnlock(lock)          xmlMutexUnlock(*(lock))
+#endif /* defined(XMLSEC_SIMPLE_KEYS_STORE_SRWLOCK) */
+
+#if defined(__GNUC__)
+#define xmlSecSimpleKeysStoreCopyingIncrement(ctx)      __sync_add_and_fetch(&((ctx)->copying), 1)
+#define xmlSecSimpleKeysStoreCopyingDecrement(ctx)      __sync_sub_and_fetch(&((ctx)->copying), 1)
+#define xmlSecSimpleKeysStoreCopyingGet(ctx)            __sync_add_and_fetch(&((ctx)->copying), 0)
+#elif defined(_MSC_VER)
+#define xmlSecSimpleKeysStoreCopyingIncrement(ctx)      InterlockedIncrement((volatile LONG*)&((ctx)->copying))
+#define xmlSecSimpleKeysStoreCopyingDecrement(ctx)      InterlockedDecrement((volatile LONG*)&((ctx)->copying))
+#define xmlSecSimpleKeysStoreCopyingGet(ctx)            InterlockedCompareExchange((volatile LONG*)&((ctx)->copying), 0, 0)
+#else  /* defined(_MSC_VER) */
+/* no atomics: the keys can not be looked up from multiple threads */
+#define xmlSecSimpleKeysStoreCopyingIncrement(ctx)      (++((ctx)->copying))
+#define xmlSecSimpleKeysStoreCopyingDecrement(ctx)      (--((ctx)->copying))
+#define xmlSecSimpleKeysStoreCopyingGet(ctx)            ((ctx)->copying)
+#endif /* defined(__GNUC__) */
+
+typedef struct _xmlSecSimpleKeysStoreCtx                xmlSecSimpleKeysStoreCtx,
+                                                        *xmlSecSimpleKeysStoreCtxPtr;
+struct _xmlSecSimpleKeysStoreCtx {
+    xmlSecPtrList                       keys;
+    xmlHashTablePtr                     names;          /* key name -> name entry */
+    xmlHashTablePtr                     useWith;        /* (application, identifier) -> name entry */
+    xmlSecSimpleKeysStoreNameEntryPtr   unrestricted;   /* the keys without KeyUseWith restrictions */
+    xmlSecSimpleKeysStoreNameEntryPtr   entries;        /* all the name entries */
+    xmlSecSize                          namesSize;      /* the number of indexed keys */
+    xmlSecSimpleKeysStoreSnapshotPtr    snapshot;       /* the keys not decoded yet */
+    xmlSecPtrList                       retired;        /* the removed keys that might be still copied */
+    xmlSecSimpleKeysStoreLock           lock;           /* protects all of the above */
+    int                                 lockInitialized;
+    long                                copying;        /* the lookups copying a key outside of the lock */
+};
+
+#define xmlSecSimpleKeysStoreSize \
+        (sizeof(xmlSecKeyStore) + sizeof(xmlSecSimpleKeysStoreCtx))
+#define xmlSecSimpleKeysStoreGetCtx(store) \
+    ((xmlSecKeyStoreCheckSize((store), xmlSecSimpleKeysStoreSize)) ? \
+        (xmlSecSimpleKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+        (xmlSecSimpleKeysStoreCtxPtr)NULL)
+#define xmlSecSimpleKeysStoreGetList(store) \
+    ((xmlSecKeyStoreCheckSize((store), xmlSecSimpleKeysStoreSize)) ? \
+        (xmlSecPtrListPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+        (xmlSecPtrListPtr)NULL)
+
+static int                      xmlSecSimpleKeysStoreInitialize (xmlSecKeyStorePtr store);
+static void                     xmlSecSimpleKeysStoreFinalize   (xmlSecKeyStorePtr store);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreFindKey    (xmlSecKeyStorePtr store,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreLookup     (xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int                      xmlSecSimpleKeysStoreNeedsUpdate(xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name);
+static int                      xmlSecSimpleKeysStoreUpdate     (xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name);
+static int                      xmlSecSimpleKeysStoreRetireKey  (xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 xmlSecSize pos);
+static int                      xmlSecSimpleKeysStorePutKey     (xmlSecPtrListPtr list,
+                                                                 xmlSecKeyPtr key,
+                                                                 xmlSecSize pos);
+static void                     xmlSecSimpleKeysStoreIndexReset (xmlSecSimpleKeysStoreCtxPtr ctx);
+static int                      xmlSecSimpleKeysStoreIndexUpdate(xmlSecSimpleKeysStoreCtxPtr ctx);
+static xmlSecSize               xmlSecSimpleKeysStoreEntryFind  (xmlSecPtrListPtr list,
+                                                                 xmlSecSimpleKeysStoreNameEntryPtr entry,
+                                                                 xmlSecKeyReqPtr keyReq,
+                                                                 xmlSecSize maxPos);
+static int                      xmlSecSimpleKeysStoreReadKey    (xmlNodePtr node,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeysMngrPtr keysMngr,
+                                                                 xmlSecKeyPtr* key);
+static xmlDocPtr                xmlSecSimpleKeysStoreWriteDoc   (xmlSecKeyStorePtr store,
+                                                                 xmlSecKeyDataType type,
+                                                                 int writeKeyNames);
+
+static int                      xmlSecSimpleKeysStoreIsSnapshot (const char* filename);
+static int                      xmlSecSimpleKeysStoreLoadSnapshot(xmlSecKeyStorePtr store,
+                                                                 const char* filename,
+                                                                 xmlSecKeysMngrPtr keysMngr);
+static void                     xmlSecSimpleKeysStoreSnapshotDestroy(xmlSecSimpleKeysStoreSnapshotPtr snapshot);
+static int                      xmlSecSimpleKeysStoreSnapshotIsDecoded(xmlSecSimpleKeysStoreSnapshotPtr snapshot,
+                                                                 const xmlChar* name);
+static int                      xmlSecSimpleKeysStoreSnapshotDecodeName(xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name);
+static int                      xmlSecSimpleKeysStoreSnapshotDecodeAll(xmlSecSimpleKeysStoreCtxPtr ctx);
+
+static xmlSecKeyStoreKlass xmlSecSimpleKeysStoreKlass = {
+    sizeof(xmlSecKeyStoreKlass),
+    xmlSecSimpleKeysStoreSize,
+
+    /* data */
+    BAD_CAST "simple-keys-store",               /* const xmlChar* name; */
+
+    /* constructors/destructor */
+    xmlSecSimpleKeysStoreInitialize,            /* xmlSecKeyStoreInitializeMethod initialize; */
+    xmlSecSimpleKeysStoreFinalize,              /* xmlSecKeyStoreFinalizeMethod finalize; */
+    xmlSecSimpleKeysStoreFindKey,               /* xmlSecKeyStoreFindKeyMethod findKey; */
+
+    /* reserved for the future */
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecSimpleKeysStoreGetKlass:
+ *
+ * The simple list based keys store klass.
+ *
+ * Returns: simple list based keys store klass.
+ */
+xmlSecKeyStoreId
+xmlSecSimpleKeysStoreGetKlass(void) {
+    return(&xmlSecSimpleKeysStoreKlass);
+}
+
+/**
+ * xmlSecSimpleKeysStoreAdoptKey:
+ * @store:              the pointer to simple keys store.
+ * @key:                the pointer to key.
+ *
+ * Adds @key to the @store. If @key is shared (see #xmlSecKeyShare) then
+ * the lookups return references to it instead of copies. The key is added
+ * and indexed atomically: this function can be called while other threads
+ * look up keys in the @store (e.g. to load new keys). Use
+ * #xmlSecSimpleKeysStoreReplaceKey to rotate a key.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecPtrListPtr list;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    list = &(ctx->keys);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    pos = xmlSecPtrListGetSize(list);
+    ret = xmlSecPtrListAdd(list, key);
+    if(ret < 0) {
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        xmlSecInternalError("xmlSecPtrListAdd",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    ret = xmlSecSimpleKeysStoreIndexUpdate(ctx);
+    if(ret < 0) {
+        /* the caller still owns the key */
+        xmlSecPtrListRemoveAndReturn(list, pos);
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        xmlSecInternalError("xmlSecSimpleKeysStoreIndexUpdate",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+
+    return(0);
+}
+
+/**
+ * xmlSecSimpleKeysStoreReplaceKey:
+ * @store:              the pointer to simple keys store.
+ * @key:                the pointer to key (must have a name).
+ *
+ * Atomically replaces all the keys with the @key name in the @store with
+ * @key (the @key takes the place of the first of them), or adds @key if there
+ * are no such keys. This function can be called while other threads look up
+ * keys in the @store (e.g. to rotate a key): the lookups return either one
+ * of the old keys or the new one. The keys returned by the earlier lookups
+ * stay valid.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreReplaceKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+    xmlSecPtrListPtr list;
+    xmlSecSize pos, ii;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(xmlSecKeyGetName(key) != NULL, -1);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    list = &(ctx->keys);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    ret = xmlSecSimpleKeysStoreUpdate(ctx, xmlSecKeyGetName(key));
+    if(ret < 0) {
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        xmlSecInternalError("xmlSecSimpleKeysStoreUpdate",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    /* the first key is replaced in place, the others are removed */
+    entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlHashLookup(ctx->names, xmlSecKeyGetName(key));
+    if((entry != NULL) && (entry->size > 0)) {
+        pos = entry->items[0];
+        for(ii = 0; ii < entry->size; ++ii) {
+            ret = xmlSecSimpleKeysStoreRetireKey(ctx, entry->items[ii]);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecSimpleKeysStoreRetireKey",
+                                    xmlSecKeyStoreGetName(store));
+                break;
+            }
+        }
+    } else {
+        pos = xmlSecPtrListGetSize(list);
+    }
+    if(ret == 0) {
+        ret = xmlSecSimpleKeysStorePutKey(list, key, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStorePutKey",
+                                xmlSecKeyStoreGetName(store));
+        }
+    }
+
+    /* the positions and the KeyUseWith restrictions have changed */
+    xmlSecSimpleKeysStoreIndexReset(ctx);
+    if(ret == 0) {
+        ret = xmlSecSimpleKeysStoreIndexUpdate(ctx);
+        if(ret < 0) {
+            /* the key is in the store: the index is rebuilt on the next lookup */
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexUpdate",
+                                xmlSecKeyStoreGetName(store));
+            ret = 0;
+        }
+    }
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+
+    return(ret);
+}
+
+/**
+ * xmlSecSimpleKeysStoreRemoveKeys:
+ * @store:              the pointer to simple keys store.
+ * @name:               the key name.
+ *
+ * Atomically removes all the keys named @name from the @store. This function
+ * can be called while other threads look up keys in the @store. The keys
+ * returned by the earlier lookups stay valid.
+ *
+ * Returns: the number of removed keys or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreRemoveKeys(xmlSecKeyStorePtr store, const xmlChar* name) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+    xmlSecSize ii, removed = 0;
+    int ret = 0;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    ret = xmlSecSimpleKeysStoreUpdate(ctx, name);
+    if(ret < 0) {
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        xmlSecInternalError("xmlSecSimpleKeysStoreUpdate",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlHashLookup(ctx->names, name);
+    if((entry == NULL) || (entry->size == 0)) {
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        return(0);
+    }
+    for(ii = 0; ii < entry->size; ++ii) {
+        ret = xmlSecSimpleKeysStoreRetireKey(ctx, entry->items[ii]);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreRetireKey",
+                                xmlSecKeyStoreGetName(store));
+            break;
+        }
+        ++removed;
+    }
+
+    /* the index is rebuilt on the next lookup */
+    xmlSecSimpleKeysStoreIndexReset(ctx);
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+    if(ret < 0) {
+        return(-1);
+    }
+
+    XMLSEC_SAFE_CAST_SIZE_TO_INT(removed, ret, return(-1), xmlSecKeyStoreGetName(store));
+    return(ret);
+}
+
+/**
+ * xmlSecSimpleKeysStoreLoad:
+ * @store:              the pointer to simple keys store.
+ * @uri:                the filename.
+ * @keysMngr:           the pointer to associated keys manager.
+ *
+ * Reads keys from an XML file or from a binary snapshot written by
+ * #xmlSecSimpleKeysStoreSaveSnapshot (the format is detected automatically).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
+                            xmlSecKeysMngrPtr keysMngr) {
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlNodePtr cur;
+    xmlSecKeyPtr key;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(uri != NULL, -1);
+
+    if(xmlSecSimpleKeysStoreIsSnapshot(uri) == 1) {
+        ret = xmlSecSimpleKeysStoreLoadSnapshot(store, uri, keysMngr);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecSimpleKeysStoreLoadSnapshot", xmlSecKeyStoreGetName(store),
+                                 "uri=%s", xmlSecErrorsSafeString(uri));
+            return(-1);
+        }
+        return(0);
+    }
+
+    doc = xmlParseFile(uri);
+    if(doc == NULL) {
+        xmlSecXmlError2("xmlParseFile", xmlSecKeyStoreGetName(store),
+                        "uri=%s", xmlSecErrorsSafeString(uri));
+        return(-1);
+    }
+
+    root = xmlDocGetRootElement(doc);
+    if(!xmlSecCheckNodeName(root, BAD_CAST "Keys", xmlSecNs)) {
+        xmlSecInvalidNodeError(root, BAD_CAST "Keys",
+                               xmlSecKeyStoreGetName(store));
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+
+    cur = xmlSecGetNextElementNode(root->children);
+    while((cur != NULL) && xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs)) {
+        ret = xmlSecSimpleKeysStoreReadKey(cur, NULL, keysMngr, &key);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreReadKey",
+                                xmlSecKeyStoreGetName(store));
+            xmlFreeDoc(doc);
+            return(-1);
+        }
+
+        /* we might have an unknown key in our file, just ignore it */
+        if(key != NULL) {
+            ret = xmlSecSimpleKeysStoreAdoptKey(store, key);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecSimpleKeysStoreAdoptKey",
+                                    xmlSecKeyStoreGetName(store));
+                xmlSecKeyDestroy(key);
+                xmlFreeDoc(doc);
+                return(-1);
+            }
+        }
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    if(cur != NULL) {
+        xmlSecUnexpectedNodeError(cur, xmlSecKeyStoreGetName(store));
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+
+    xmlFreeDoc(doc);
+    return(0);
+
+}
+
+/* reads the key from <dsig:KeyInfo/> @node, the @key is NULL if it is not valid (e.g. unknown) */
+static int
+xmlSecSimpleKeysStoreReadKey(xmlNodePtr node, const xmlChar* name, xmlSecKeysMngrPtr keysMngr,
+                             xmlSecKeyPtr* key) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr res;
+    int ret;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    (*key) = NULL;
+    res = xmlSecKeyCreate();
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecKeyCreate", NULL);
+        return(-1);
+    }
+    if(name != NULL) {
+        ret = xmlSecKeySetName(res, name);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeySetName", NULL);
+            xmlSecKeyDestroy(res);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxInitialize", NULL);
+        xmlSecKeyDestroy(res);
+        return(-1);
+    }
+
+    keyInfoCtx.mode           = xmlSecKeyInfoModeRead;
+    keyInfoCtx.keysMngr       = keysMngr;
+    keyInfoCtx.flags          = XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND |
+                                XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
+    keyInfoCtx.keyReq.keyId   = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage= xmlSecKeyDataUsageAny;
+
+    ret = xmlSecKeyInfoNodeRead(node, res, &keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoNodeRead", NULL);
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        xmlSecKeyDestroy(res);
+        return(-1);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+
+    if(!xmlSecKeyIsValid(res)) {
+        xmlSecKeyDestroy(res);
+        return(0);
+    }
+    (*key) = res;
+    return(0);
+}
+
+/**
+ * xmlSecSimpleKeysStoreSave:
+ * @store:              the pointer to simple keys store.
+ * @filename:           the filename.
+ * @type:               the saved keys type (public, private, ...).
+ *
+ * Writes keys from @store to an XML file.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
+    xmlDocPtr doc;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    doc = xmlSecSimpleKeysStoreWriteDoc(store, type, 1);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreWriteDoc",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    /* now write result */
+    ret = xmlSaveFormatFile(filename, doc, 1);
+    if(ret < 0) {
+        xmlSecXmlError2("xmlSaveFormatFile", xmlSecKeyStoreGetName(store),
+                        "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+
+    xmlFreeDoc(doc);
+    return(0);
+}
+
+/* creates <Keys/> document with one <dsig:KeyInfo/> child per key in the @store (in the same order) */
+static xmlDocPtr
+xmlSecSimpleKeysStoreWriteDoc(xmlSecKeyStorePtr store, xmlSecKeyDataType type, int writeKeyNames) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecPtrListPtr list;
+    xmlSecKeyPtr key;
+    xmlSecSize i, keysSize;
+    xmlDocPtr doc;
+    xmlNodePtr cur;
+    xmlSecKeyDataPtr data;
+    xmlSecPtrListPtr idsList;
+    xmlSecKeyDataId dataId;
+    xmlSecSize idsSize, j;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    list = xmlSecSimpleKeysStoreGetList(store);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
+
+    /* all the keys are written */
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    ret = xmlSecSimpleKeysStoreSnapshotDecodeAll(ctx);
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecodeAll",
+                            xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
+
+    /* create doc */
+    doc = xmlSecCreateTree(BAD_CAST "Keys", xmlSecNs);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecCreateTree",
+                            xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
+
+    idsList = xmlSecKeyDataIdsGet();
+    xmlSecAssert2(idsList != NULL, NULL);
+
+    keysSize = xmlSecPtrListGetSize(list);
+    idsSize = xmlSecPtrListGetSize(idsList);
+    for(i = 0; i < keysSize; ++i) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, i);
+        xmlSecAssert2(key != NULL, NULL);
+
+        cur = xmlSecAddChild(xmlDocGetRootElement(doc), xmlSecNodeKeyInfo, xmlSecDSigNs);
+        if(cur == NULL) {
+            xmlSecInternalError2("xmlSecAddChild",
+                                 xmlSecKeyStoreGetName(store),
+                                 "node=%s",
+                                 xmlSecErrorsSafeString(xmlSecNodeKeyInfo));
+            xmlFreeDoc(doc);
+            return(NULL);
+        }
+
+        /* special data key name */
+        if((writeKeyNames != 0) && (xmlSecKeyGetName(key) != NULL)) {
+            if(xmlSecAddChild(cur, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
+                xmlSecInternalError2("xmlSecAddChild",
+                                     xmlSecKeyStoreGetName(store),
+                                     "node=%s",
+                                     xmlSecErrorsSafeString(xmlSecNodeKeyName));
+                xmlFreeDoc(doc);
+                return(NULL);
+            }
+        }
+
+        /* create nodes for other keys data */
+        for(j = 0; j < idsSize; ++j) {
+            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, j);
+            xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, NULL);
+
+            if(dataId->dataNodeName == NULL) {
+                continue;
+            }
+
+            data = xmlSecKeyGetData(key, dataId);
+            if(data == NULL) {
+                continue;
+            }
+
+            if(xmlSecAddChild(cur, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
+                xmlSecInternalError2("xmlSecAddChild",
+                                     xmlSecKeyStoreGetName(store),
+                                    "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
+                xmlFreeDoc(doc);
+                return(NULL);
+            }
+        }
+
+        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
+                                xmlSecKeyStoreGetName(store));
+            xmlFreeDoc(doc);
+            return(NULL);
+        }
+
+        keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
+        keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
+        keyInfoCtx.keyReq.keyType       = type;
+        keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
+
+        /* finally write key in the node */
+        ret = xmlSecKeyInfoNodeWrite(cur, key, &keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoNodeWrite",
+                                xmlSecKeyStoreGetName(store));
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlFreeDoc(doc);
+            return(NULL);
+        }
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    }
+
+    return(doc);
+}
+
+/**
+ * xmlSecSimpleKeysStoreGetKeys:
+ * @store:              the pointer to simple keys store.
+ *
+ * Gets list of keys from simple keys store. The keys can be appended to
+ * the list but they should not be renamed or replaced since the store
+ * maintains an index by key name. The list is not protected against
+ * concurrent access: use #xmlSecSimpleKeysStoreAdoptKey,
+ * #xmlSecSimpleKeysStoreReplaceKey and #xmlSecSimpleKeysStoreRemoveKeys
+ * to change a store shared between threads.
+ *
+ * Returns: pointer to the list of keys stored in the keys store or NULL
+ * if an error occurs.
+ */
+xmlSecPtrListPtr
+xmlSecSimpleKeysStoreGetKeys(xmlSecKeyStorePtr store) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecPtrListPtr list;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    list = xmlSecSimpleKeysStoreGetList(store);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
+
+    /* the keys from the snapshot are decoded on demand */
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    ret = xmlSecSimpleKeysStoreSnapshotDecodeAll(ctx);
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecodeAll",
+                            xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
+
+    return list;
+}
+
+static int
+xmlSecSimpleKeysStoreInitialize(xmlSecKeyStorePtr store) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecPtrListPtr list;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    list = xmlSecSimpleKeysStoreGetList(store);
+    xmlSecAssert2(list != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecSimpleKeysStoreCtx));
+    ret = xmlSecPtrListInitialize(list, xmlSecKeyPtrListId);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize(xmlSecKeyPtrListId)",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    ret = xmlSecPtrListInitialize(&(ctx->retired), xmlSecKeyPtrListId);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize(xmlSecKeyPtrListId)",
+                            xmlSecKeyStoreGetName(store));
+        xmlSecPtrListFinalize(list);
+        return(-1);
+    }
+
+    ret = xmlSecSimpleKeysStoreLockInitialize(&(ctx->lock));
+    if(ret != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, xmlSecKeyStoreGetName(store),
+                         "unable to initialize the keys store lock");
+        xmlSecPtrListFinalize(&(ctx->retired));
+        xmlSecPtrListFinalize(list);
+        return(-1);
+    }
+    ctx->lockInitialized = 1;
+
+    return(0);
+}
+
+static void
+xmlSecSimpleKeysStoreFinalize(xmlSecKeyStorePtr store) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId));
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
+
+    xmlSecSimpleKeysStoreIndexReset(ctx);
+    if(ctx->snapshot != NULL) {
+        xmlSecSimpleKeysStoreSnapshotDestroy(ctx->snapshot);
+    }
+    xmlSecPtrListFinalize(&(ctx->keys));
+    xmlSecPtrListFinalize(&(ctx->retired));
+    if(ctx->lockInitialized != 0) {
+        xmlSecSimpleKeysStoreLockFinalize(&(ctx->lock));
+    }
+    memset(ctx, 0, sizeof(xmlSecSimpleKeysStoreCtx));
+}
+
+static void
+xmlSecSimpleKeysStoreIndexReset(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->names != NULL) {
+        xmlHashFree(ctx->names, NULL);
+        ctx->names = NULL;
+    }
+    if(ctx->useWith != NULL) {
+        xmlHashFree(ctx->useWith, NULL);
+        ctx->useWith = NULL;
+    }
+    ctx->unrestricted = NULL;
+    while(ctx->entries != NULL) {
+        entry = ctx->entries;
+        ctx->entries = entry->next;
+
+        if(entry->items != NULL) {
+            xmlFree(entry->items);
+        }
+        xmlFree(entry);
+    }
+    ctx->namesSize = 0;
+}
+
+static xmlSecSimpleKeysStoreNameEntryPtr
+xmlSecSimpleKeysStoreIndexEntryCreate(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlMalloc(sizeof(xmlSecSimpleKeysStoreNameEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecSimpleKeysStoreNameEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecSimpleKeysStoreNameEntry));
+    entry->next = ctx->entries;
+    ctx->entries = entry;
+    return(entry);
+}
+
+static int
+xmlSecSimpleKeysStoreIndexEntryAdd(xmlSecSimpleKeysStoreNameEntryPtr entry, xmlSecSize pos) {
+    xmlSecSize* newItems;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(entry != NULL, -1);
+
+    if(entry->size >= entry->maxSize) {
+        newSize = 2 * entry->maxSize + 4;
+        newItems = (xmlSecSize*)xmlRealloc(entry->items, sizeof(xmlSecSize) * newSize);
+        if(newItems == NULL) {
+            xmlSecMallocError(sizeof(xmlSecSize) * newSize, NULL);
+            return(-1);
+        }
+        entry->items = newItems;
+        entry->maxSize = newSize;
+    }
+    entry->items[entry->size++] = pos;
+    return(0);
+}
+
+/* libxml2 hash tables do not accept NULL as the first name; the candidates
+ * are always checked with xmlSecKeyMatch() so the collisions are harmless */
+#define xmlSecSimpleKeysStoreIndexName(name) \
+    (((name) != NULL) ? (name) : BAD_CAST "")
+
+/* adds the key position to the entry for (name, name2) in the given table */
+static int
+xmlSecSimpleKeysStoreIndexAdd(xmlSecSimpleKeysStoreCtxPtr ctx, xmlHashTablePtr table,
+                              const xmlChar* name, const xmlChar* name2, xmlSecSize pos) {
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(table != NULL, -1);
+
+    entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlHashLookup2(table, name, name2);
+    if(entry == NULL) {
+        entry = xmlSecSimpleKeysStoreIndexEntryCreate(ctx);
+        if(entry == NULL) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexEntryCreate", NULL);
+            return(-1);
+        }
+        if(xmlHashAddEntry2(table, name, name2, entry) != 0) {
+            xmlSecXmlError2("xmlHashAddEntry2", NULL,
+                            "name=%s", xmlSecErrorsSafeString(name));
+            return(-1);
+        }
+    }
+
+    return(xmlSecSimpleKeysStoreIndexEntryAdd(entry, pos));
+}
+
+static int
+xmlSecSimpleKeysStoreIndexAddKey(xmlSecSimpleKeysStoreCtxPtr ctx, xmlSecKeyPtr key, xmlSecSize pos) {
+    xmlSecPtrListPtr useWithList;
+    xmlSecKeyUseWithPtr keyUseWith;
+    xmlSecSize size, ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    if(xmlSecKeyGetName(key) != NULL) {
+        ret = xmlSecSimpleKeysStoreIndexAdd(ctx, ctx->names, xmlSecKeyGetName(key), NULL, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexAdd(names)", NULL);
+            return(-1);
+        }
+    }
+
+    useWithList = xmlSecKeyGetUseWithList(key);
+    size = (useWithList != NULL) ? xmlSecPtrListGetSize(useWithList) : 0;
+    if(size == 0) {
+        return(xmlSecSimpleKeysStoreIndexEntryAdd(ctx->unrestricted, pos));
+    }
+    for(ii = 0; ii < size; ++ii) {
+        keyUseWith = (xmlSecKeyUseWithPtr)xmlSecPtrListGetItem(useWithList, ii);
+        if(keyUseWith == NULL) {
+            continue;
+        }
+        ret = xmlSecSimpleKeysStoreIndexAdd(ctx, ctx->useWith,
+                    xmlSecSimpleKeysStoreIndexName(keyUseWith->application),
+                    keyUseWith->identifier, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexAdd(useWith)", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/*
+ * Indexes the keys added to the list since the last update (the list
+ * is accessible via xmlSecSimpleKeysStoreGetKeys() and might have been
+ * changed directly: if it has shrunk, the index is rebuilt).
+ */
+static int
+xmlSecSimpleKeysStoreIndexUpdate(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecKeyPtr key;
+    xmlSecSize pos, size;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+    if((ctx->names != NULL) && (ctx->namesSize == size)) {
+        return(0);
+    }
+    if((ctx->names == NULL) || (ctx->namesSize > size)) {
+        xmlSecSimpleKeysStoreIndexReset(ctx);
+
+        ctx->names = xmlHashCreate(0);
+        if(ctx->names == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+        ctx->useWith = xmlHashCreate(0);
+        if(ctx->useWith == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+            xmlSecSimpleKeysStoreIndexReset(ctx);
+            return(-1);
+        }
+        ctx->unrestricted = xmlSecSimpleKeysStoreIndexEntryCreate(ctx);
+        if(ctx->unrestricted == NULL) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexEntryCreate", NULL);
+            xmlSecSimpleKeysStoreIndexReset(ctx);
+            return(-1);
+        }
+    }
+
+    for(pos = ctx->namesSize; pos < size; ++pos) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), pos);
+        if(key == NULL) {
+            continue;
+        }
+
+        ret = xmlSecSimpleKeysStoreIndexAddKey(ctx, key, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexAddKey", NULL);
+            xmlSecSimpleKeysStoreIndexReset(ctx);
+            return(-1);
+        }
+    }
+    ctx->namesSize = size;
+    return(0);
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
+                            xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecKeyPtr key, res;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    xmlSecSimpleKeysStoreReadLock(&(ctx->lock));
+    if(xmlSecSimpleKeysStoreNeedsUpdate(ctx, name) == 1) {
+        /* the candidates are not decoded from the snapshot or not indexed
+         * yet (the keys list was changed directly): this changes the store */
+        xmlSecSimpleKeysStoreReadUnlock(&(ctx->lock));
+        xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+        ret = xmlSecSimpleKeysStoreUpdate(ctx, name);
+        xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreUpdate", xmlSecKeyStoreGetName(store));
+            return(NULL);
+        }
+        xmlSecSimpleKeysStoreReadLock(&(ctx->lock));
+    }
+
+    key = xmlSecSimpleKeysStoreLookup(ctx, name, keyInfoCtx);
+    if(key == NULL) {
+        xmlSecSimpleKeysStoreReadUnlock(&(ctx->lock));
+        return(NULL);
+    }
+    if(xmlSecKeyIsShared(key) == 1) {
+        /* only takes a reference */
+        res = xmlSecKeyDuplicate(key);
+        xmlSecSimpleKeysStoreReadUnlock(&(ctx->lock));
+    } else {
+        /* copy the key outside of the lock: the key is not destroyed
+         * if it is replaced or removed in the meantime */
+        xmlSecSimpleKeysStoreCopyingIncrement(ctx);
+        xmlSecSimpleKeysStoreReadUnlock(&(ctx->lock));
+        res = xmlSecKeyDuplicate(key);
+        xmlSecSimpleKeysStoreCopyingDecrement(ctx);
+    }
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
+
+    return(res);
+}
+
+/* checks whether the lookup for @name needs to decode the snapshot or
+ * update the index (called under the read lock) */
+static int
+xmlSecSimpleKeysStoreNeedsUpdate(xmlSecSimpleKeysStoreCtxPtr ctx, const xmlChar* name) {
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->snapshot != NULL) {
+        if(name == NULL) {
+            return(1);
+        }
+        if(xmlSecSimpleKeysStoreSnapshotIsDecoded(ctx->snapshot, name) != 1) {
+            return(1);
+        }
+    }
+    if((ctx->names == NULL) || (ctx->namesSize != xmlSecPtrListGetSize(&(ctx->keys)))) {
+        return(1);
+    }
+    return(0);
+}
+
+/* decodes the keys named @name (or all keys if @name is NULL) from the
+ * snapshot and updates the index (called under the write lock) */
+static int
+xmlSecSimpleKeysStoreUpdate(xmlSecSimpleKeysStoreCtxPtr ctx, const xmlChar* name) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->snapshot != NULL) {
+        if(name != NULL) {
+            ret = xmlSecSimpleKeysStoreSnapshotDecodeName(ctx, name);
+        } else {
+            ret = xmlSecSimpleKeysStoreSnapshotDecodeAll(ctx);
+        }
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecode", NULL);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecSimpleKeysStoreIndexUpdate(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreIndexUpdate", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* takes the key at @pos out of the keys list and destroys it, or keeps it
+ * until the lookups copying keys outside of the lock are done (called under
+ * the write lock) */
+static int
+xmlSecSimpleKeysStoreRetireKey(xmlSecSimpleKeysStoreCtxPtr ctx, xmlSecSize pos) {
+    xmlSecKeyPtr key;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(xmlSecSimpleKeysStoreCopyingGet(ctx) == 0) {
+        xmlSecPtrListEmpty(&(ctx->retired));
+    }
+
+    key = (xmlSecKeyPtr)xmlSecPtrListRemoveAndReturn(&(ctx->keys), pos);
+    if(key == NULL) {
+        return(0);
+    }
+    if(xmlSecSimpleKeysStoreCopyingGet(ctx) == 0) {
+        xmlSecKeyDestroy(key);
+        return(0);
+    }
+
+    ret = xmlSecPtrListAdd(&(ctx->retired), key);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd", NULL);
+        xmlSecSimpleKeysStorePutKey(&(ctx->keys), key, pos);
+        return(-1);
+    }
+    return(0);
+}
+
+/* puts @key at the @pos emptied by xmlSecPtrListRemoveAndReturn() (the list
+ * shrinks if it was the last position) */
+static int
+xmlSecSimpleKeysStorePutKey(xmlSecPtrListPtr list, xmlSecKeyPtr key, xmlSecSize pos) {
+    xmlSecAssert2(list != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    if(pos < xmlSecPtrListGetSize(list)) {
+        xmlSecAssert2(xmlSecPtrListGetItem(list, pos) == NULL, -1);
+        return(xmlSecPtrListSet(list, key, pos));
+    }
+    return(xmlSecPtrListAdd(list, key));
+}
+
+/* returns the first key in the store matching the lookup or NULL (called
+ * under the read lock, the index is up to date) */
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreLookup(xmlSecSimpleKeysStoreCtxPtr ctx, const xmlChar* name,
+                            xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecSimpleKeysStoreNameEntryPtr entry;
+    xmlSecKeyUseWithPtr keyUseWith;
+    xmlSecPtrListPtr list;
+    xmlSecKeyPtr key;
+    xmlSecSize pos, size, ii;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    list = &(ctx->keys);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
+
+    /* only the keys with the given name are candidates */
+    if(name != NULL) {
+        entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlHashLookup(ctx->names, name);
+        if(entry == NULL) {
+            return(NULL);
+        }
+        for(ii = 0; ii < entry->size; ++ii) {
+            key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, entry->items[ii]);
+            if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
+                return(key);
+            }
+        }
+        return(NULL);
+    }
+
+    /* only the keys restricted to one of the requested applications/identifiers
+     * or not restricted at all are candidates: pick the first one in the list */
+    size = xmlSecPtrListGetSize(&(keyInfoCtx->keyReq.keyUseWithList));
+    if(size > 0) {
+        pos = xmlSecSimpleKeysStoreEntryFind(list, ctx->unrestricted,
+                    &(keyInfoCtx->keyReq), xmlSecPtrListGetSize(list));
+        for(ii = 0; ii < size; ++ii) {
+            keyUseWith = (xmlSecKeyUseWithPtr)xmlSecPtrListGetItem(&(keyInfoCtx->keyReq.keyUseWithList), ii);
+            if(keyUseWith == NULL) {
+                continue;
+            }
+            entry = (xmlSecSimpleKeysStoreNameEntryPtr)xmlHashLookup2(ctx->useWith,
+                    xmlSecSimpleKeysStoreIndexName(keyUseWith->application),
+                    keyUseWith->identifier);
+            pos = xmlSecSimpleKeysStoreEntryFind(list, entry, &(keyInfoCtx->keyReq), pos);
+        }
+        if(pos >= xmlSecPtrListGetSize(list)) {
+            return(NULL);
+        }
+        return((xmlSecKeyPtr)xmlSecPtrListGetItem(list, pos));
+    }
+
+    size = xmlSecPtrListGetSize(list);
+    for(pos = 0; pos < size; ++pos) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, pos);
+        if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
+            return(key);
+        }
+    }
+    return(NULL);
+}
+
+/*
+ * Returns the position of the first key from the @entry (the positions are
+ * sorted) that matches @keyReq and is before @maxPos, or @maxPos otherwise.
+ */
+static xmlSecSize
+xmlSecSimpleKeysStoreEntryFind(xmlSecPtrListPtr list, xmlSecSimpleKeysStoreNameEntryPtr entry,
+                               xmlSecKeyReqPtr keyReq, xmlSecSize maxPos) {
+    xmlSecKeyPtr key;
+    xmlSecSize ii;
+
+    xmlSecAssert2(list != NULL, maxPos);
+    xmlSecAssert2(keyReq != NULL, maxPos);
+
+    if(entry == NULL) {
+        return(maxPos);
+    }
+    for(ii = 0; (ii < entry->size) && (entry->items[ii] < maxPos); ++ii) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, entry->items[ii]);
+        if((key != NULL) && (xmlSecKeyMatch(key, NULL, keyReq) == 1)) {
+            return(entry->items[ii]);
+        }
+    }
+    return(maxPos);
+}
+
+
+/****************************************************************************
+ *
+ * Simple Keys Store snapshot
+ *
+ * The binary snapshot of the keys store (all integers are 32 bit little
+ * endian, all offsets are from the beginning of the file):
+ *
+ *   magic "XMLSECKS" | version | count | count * entry | data
+ *   entry: name offset | name size | KeyInfo offset | KeyInfo size
+ *
+ * The entries are sorted by key name (bytes comparison, the keys without
+ * names go first), the KeyInfo is the serialized <dsig:KeyInfo/> element
+ * without <dsig:KeyName/> child. The snapshot is mapped in memory and each
+ * key is decoded on the first lookup of its name.
+ *
+ ***************************************************************************/
+#define XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC                "XMLSECKS"
+#define XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE           8
+#define XMLSEC_KEYS_STORE_SNAPSHOT_VERSION              1
+#define XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE          16
+#define XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE           16
+#define XMLSEC_KEYS_STORE_SNAPSHOT_MAX_SIZE             0xFFFFFFFFUL
+
+struct _xmlSecSimpleKeysStoreSnapshot {
+    xmlSecMappedFile            file;
+    xmlSecBufferPtr             buffer;         /* the file content if it can't be mapped */
+    const xmlSecByte*           data;
+    xmlSecSize                  size;
+    xmlSecSize                  count;
+    xmlSecByte*                 decoded;        /* the entries already in the keys list */
+    xmlSecSize                  decodedSize;
+    xmlSecKeysMngrPtr           keysMngr;
+};
+
+typedef struct _xmlSecSimpleKeysStoreSnapshotItem {
+    const xmlChar*              name;
+    xmlSecSize                  nameSize;
+    xmlBufferPtr                keyInfo;
+} xmlSecSimpleKeysStoreSnapshotItem, *xmlSecSimpleKeysStoreSnapshotItemPtr;
+
+static xmlSecSize
+xmlSecSimpleKeysStoreSnapshotGetUInt(const xmlSecByte* data) {
+    return((xmlSecSize)data[0] | ((xmlSecSize)data[1] << 8) |
+           ((xmlSecSize)data[2] << 16) | ((xmlSecSize)data[3] << 24));
+}
+
+static void
+xmlSecSimpleKeysStoreSnapshotSetUInt(xmlSecByte* data, xmlSecSize value) {
+    data[0] = (xmlSecByte)(value & 0xFF);
+    data[1] = (xmlSecByte)((value >> 8) & 0xFF);
+    data[2] = (xmlSecByte)((value >> 16) & 0xFF);
+    data[3] = (xmlSecByte)((value >> 24) & 0xFF);
+}
+
+static int
+xmlSecSimpleKeysStoreSnapshotCmpNames(const xmlSecByte* name1, xmlSecSize size1,
+                                      const xmlSecByte* name2, xmlSecSize size2) {
+    int res;
+
+    res = memcmp(name1, name2, (size1 < size2) ? size1 : size2);
+    if(res != 0) {
+        return(res);
+    }
+    return((size1 < size2) ? -1 : ((size1 > size2) ? 1 : 0));
+}
+
+static int
+xmlSecSimpleKeysStoreSnapshotCmpItems(const void* item1, const void* item2) {
+    xmlSecSimpleKeysStoreSnapshotItemPtr p1 = (xmlSecSimpleKeysStoreSnapshotItemPtr)item1;
+    xmlSecSimpleKeysStoreSnapshotItemPtr p2 = (xmlSecSimpleKeysStoreSnapshotItemPtr)item2;
+
+    return(xmlSecSimpleKeysStoreSnapshotCmpNames(p1->name, p1->nameSize, p2->name, p2->nameSize));
+}
+
+/* returns 1 if the file starts with the snapshot magic, 0 otherwise */
+static int
+xmlSecSimpleKeysStoreIsSnapshot(const char* filename) {
+    xmlSecByte magic[XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE];
+    FILE* f;
+    size_t len;
+
+    xmlSecAssert2(filename != NULL, 0);
+
+    /* not a file (e.g. url): let the XML parser deal with it */
+    f = fopen(filename, "rb");
+    if(f == NULL) {
+        return(0);
+    }
+    len = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+
+    if((len != sizeof(magic)) || (memcmp(magic, XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC, sizeof(magic)) != 0)) {
+        return(0);
+    }
+    return(1);
+}
+
+static void
+xmlSecSimpleKeysStoreSnapshotDestroy(xmlSecSimpleKeysStoreSnapshotPtr snapshot) {
+    xmlSecAssert(snapshot != NULL);
+
+    xmlSecMappedFileClose(&(snapshot->file));
+    if(snapshot->buffer != NULL) {
+        xmlSecBufferDestroy(snapshot->buffer);
+    }
+    if(snapshot->decoded != NULL) {
+        xmlFree(snapshot->decoded);
+    }
+    memset(snapshot, 0, sizeof(xmlSecSimpleKeysStoreSnapshot));
+    xmlFree(snapshot);
+}
+
+/* checks the header and that all the entries are within the data */
+static int
+xmlSecSimpleKeysStoreSnapshotCheck(xmlSecSimpleKeysStoreSnapshotPtr snapshot) {
+    const xmlSecByte* entry;
+    xmlSecSize version, offset, size, ii;
+
+    xmlSecAssert2(snapshot != NULL, -1);
+    xmlSecAssert2(snapshot->data != NULL, -1);
+
+    if((snapshot->size < XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE) ||
+       (memcmp(snapshot->data, XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC, XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE) != 0)) {
+        xmlSecInvalidDataError("keys store snapshot header", NULL);
+        return(-1);
+    }
+    version = xmlSecSimpleKeysStoreSnapshotGetUInt(snapshot->data + XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE);
+    if(version != XMLSEC_KEYS_STORE_SNAPSHOT_VERSION) {
+        xmlSecOtherError3(XMLSEC_ERRORS_R_INVALID_VERSION, NULL,
+                          "keys store snapshot version=%lu; expected=%lu",
+                          (unsigned long)version, (unsigned long)XMLSEC_KEYS_STORE_SNAPSHOT_VERSION);
+        return(-1);
+    }
+
+    snapshot->count = xmlSecSimpleKeysStoreSnapshotGetUInt(snapshot->data + XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE + 4);
+    if(snapshot->count > (snapshot->size - XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE) / XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE) {
+        xmlSecInvalidSizeMoreThanError("keys store snapshot entries", snapshot->count,
+            (snapshot->size - XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE) / XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE,
+            NULL);
+        return(-1);
+    }
+    for(ii = 0; ii < snapshot->count; ++ii) {
+        entry = snapshot->data + XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE + ii * XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE;
+
+        /* name */
+        offset = xmlSecSimpleKeysStoreSnapshotGetUInt(entry);
+        size = xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 4);
+        if((offset > snapshot->size) || (size > snapshot->size - offset)) {
+            xmlSecInvalidDataError("keys store snapshot key name", NULL);
+            return(-1);
+        }
+
+        /* KeyInfo */
+        offset = xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 8);
+        size = xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 12);
+        if((offset > snapshot->size) || (size > snapshot->size - offset) || (size == 0) || (size > INT_MAX)) {
+            xmlSecInvalidDataError("keys store snapshot key info", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecSimpleKeysStoreSnapshotGetEntry(xmlSecSimpleKeysStoreSnapshotPtr snapshot, xmlSecSize pos,
+                                      const xmlSecByte** name, xmlSecSize* nameSize,
+                                      const xmlSecByte** keyInfo, xmlSecSize* keyInfoSize) {
+    const xmlSecByte* entry;
+
+    xmlSecAssert(snapshot != NULL);
+    xmlSecAssert(pos < snapshot->count);
+
+    /* already checked in xmlSecSimpleKeysStoreSnapshotCheck() */
+    entry = snapshot->data + XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE + pos * XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE;
+    if(name != NULL) {
+        (*name) = snapshot->data + xmlSecSimpleKeysStoreSnapshotGetUInt(entry);
+    }
+    if(nameSize != NULL) {
+        (*nameSize) = xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 4);
+    }
+    if(keyInfo != NULL) {
+        (*keyInfo) = snapshot->data + xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 8);
+    }
+    if(keyInfoSize != NULL) {
+        (*keyInfoSize) = xmlSecSimpleKeysStoreSnapshotGetUInt(entry + 12);
+    }
+}
+
+static int
+xmlSecSimpleKeysStoreLoadSnapshot(xmlSecKeyStorePtr store, const char* filename,
+                                  xmlSecKeysMngrPtr keysMngr) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreSnapshotPtr snapshot;
     int ret;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
     xmlSecAssert2(filename != NULL, -1);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
 
-    /* create doc */
-    doc = xmlSecCreateTree(BAD_CAST "Keys", xmlSecNs);
-    if(doc == NULL) {
-        xmlSecInternalError("xmlSecCreateTree",
-                            xmlSecKeyStoreGetName(store));
+    snapshot = (xmlSecSimpleKeysStoreSnapshotPtr)xmlMalloc(sizeof(xmlSecSimpleKeysStoreSnapshot));
+    if(snapshot == NULL) {
+        xmlSecMallocError(sizeof(xmlSecSimpleKeysStoreSnapshot), xmlSecKeyStoreGetName(store));
         return(-1);
     }
+    memset(snapshot, 0, sizeof(xmlSecSimpleKeysStoreSnapshot));
+    snapshot->keysMngr = keysMngr;
 
-    idsList = xmlSecKeyDataIdsGet();
-    xmlSecAssert2(idsList != NULL, -1);
+    /* map the file or read it if it is not possible */
+    ret = xmlSecMappedFileOpen(&(snapshot->file), filename);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecMappedFileOpen", xmlSecKeyStoreGetName(store));
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        return(-1);
+    } else if(ret == 0) {
+        snapshot->data = snapshot->file.data;
+        snapshot->size = snapshot->file.size;
+    } else {
+        snapshot->buffer = xmlSecBufferCreate(0);
+        if(snapshot->buffer == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", xmlSecKeyStoreGetName(store));
+            xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+            return(-1);
+        }
+        ret = xmlSecBufferReadFile(snapshot->buffer, filename);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferReadFile", xmlSecKeyStoreGetName(store),
+                                 "filename=%s", xmlSecErrorsSafeString(filename));
+            xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+            return(-1);
+        }
+        snapshot->data = xmlSecBufferGetData(snapshot->buffer);
+        snapshot->size = xmlSecBufferGetSize(snapshot->buffer);
+    }
 
-    keysSize = xmlSecPtrListGetSize(list);
-    idsSize = xmlSecPtrListGetSize(idsList);
-    for(i = 0; i < keysSize; ++i) {
-        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, i);
-        xmlSecAssert2(key != NULL, -1);
+    ret = xmlSecSimpleKeysStoreSnapshotCheck(snapshot);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecSimpleKeysStoreSnapshotCheck", xmlSecKeyStoreGetName(store),
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        return(-1);
+    }
+    if(snapshot->count == 0) {
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        return(0);
+    }
 
-        cur = xmlSecAddChild(xmlDocGetRootElement(doc), xmlSecNodeKeyInfo, xmlSecDSigNs);
-        if(cur == NULL) {
-            xmlSecInternalError2("xmlSecAddChild",
-                                 xmlSecKeyStoreGetName(store),
-                                 "node=%s",
-                                 xmlSecErrorsSafeString(xmlSecNodeKeyInfo));
+    snapshot->decoded = (xmlSecByte*)xmlMalloc(snapshot->count);
+    if(snapshot->decoded == NULL) {
+        xmlSecMallocError(snapshot->count, xmlSecKeyStoreGetName(store));
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        return(-1);
+    }
+    memset(snapshot->decoded, 0, snapshot->count);
+
+    /* only one snapshot is kept: decode the previous one */
+    xmlSecSimpleKeysStoreWriteLock(&(ctx->lock));
+    ret = xmlSecSimpleKeysStoreSnapshotDecodeAll(ctx);
+    if(ret == 0) {
+        ctx->snapshot = snapshot;
+    }
+    xmlSecSimpleKeysStoreWriteUnlock(&(ctx->lock));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecodeAll", xmlSecKeyStoreGetName(store));
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        return(-1);
+    }
+    return(0);
+}
+
+/* adds the key from the @pos entry to the keys list, the caller holds the store lock */
+static int
+xmlSecSimpleKeysStoreSnapshotDecode(xmlSecSimpleKeysStoreCtxPtr ctx, xmlSecSize pos) {
+    xmlSecSimpleKeysStoreSnapshotPtr snapshot;
+    const xmlSecByte* name;
+    const xmlSecByte* keyInfo;
+    xmlSecSize nameSize, keyInfoSize;
+    xmlChar* keyName = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->snapshot != NULL, -1);
+
+    snapshot = ctx->snapshot;
+    xmlSecAssert2(pos < snapshot->count, -1);
+    if(snapshot->decoded[pos] != 0) {
+        return(0);
+    }
+
+    xmlSecSimpleKeysStoreSnapshotGetEntry(snapshot, pos, &name, &nameSize, &keyInfo, &keyInfoSize);
+    doc = xmlReadMemory((const char*)keyInfo, (int)keyInfoSize, NULL, NULL, 0);
+    if(doc == NULL) {
+        xmlSecXmlError("xmlReadMemory", NULL);
+        return(-1);
+    }
+    root = xmlDocGetRootElement(doc);
+    if(!xmlSecCheckNodeName(root, xmlSecNodeKeyInfo, xmlSecDSigNs)) {
+        xmlSecInvalidNodeError(root, xmlSecNodeKeyInfo, NULL);
+        xmlFreeDoc(doc);
+        return(-1);
+    }
+    if(nameSize > 0) {
+        keyName = xmlStrndup(name, (int)nameSize);
+        if(keyName == NULL) {
+            xmlSecStrdupError(name, NULL);
             xmlFreeDoc(doc);
             return(-1);
         }
+    }
 
-        /* special data key name */
-        if(xmlSecKeyGetName(key) != NULL) {
-            if(xmlSecAddChild(cur, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild",
-                                     xmlSecKeyStoreGetName(store),
-                                     "node=%s",
-                                     xmlSecErrorsSafeString(xmlSecNodeKeyName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
+    /* the name is known: the <dsig:KeyName/> doesn't go to the keys manager */
+    ret = xmlSecSimpleKeysStoreReadKey(root, keyName, snapshot->keysMngr, &key);
+    if(keyName != NULL) {
+        xmlFree(keyName);
+    }
+    xmlFreeDoc(doc);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreReadKey", NULL);
+        return(-1);
+    }
+
+    /* the unknown keys are ignored */
+    if(key != NULL) {
+        ret = xmlSecPtrListAdd(&(ctx->keys), key);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            xmlSecKeyDestroy(key);
+            return(-1);
         }
+    }
+    snapshot->decoded[pos] = 1;
+    ++snapshot->decodedSize;
+    return(0);
+}
 
-        /* create nodes for other keys data */
-        for(j = 0; j < idsSize; ++j) {
-            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, j);
-            xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
+/* decodes all the entries with @name, the caller holds the store lock */
+/* returns the position of the first entry named @name (or the position
+ * where it would be) */
+static xmlSecSize
+xmlSecSimpleKeysStoreSnapshotFindFirst(xmlSecSimpleKeysStoreSnapshotPtr snapshot,
+                                       const xmlChar* name, xmlSecSize nameSize) {
+    const xmlSecByte* entryName;
+    xmlSecSize entryNameSize;
+    xmlSecSize first, last, middle;
+
+    xmlSecAssert2(snapshot != NULL, 0);
+    xmlSecAssert2(name != NULL, 0);
+
+    for(first = 0, last = snapshot->count; first < last; ) {
+        middle = first + (last - first) / 2;
+        xmlSecSimpleKeysStoreSnapshotGetEntry(snapshot, middle, &entryName, &entryNameSize, NULL, NULL);
+        if(xmlSecSimpleKeysStoreSnapshotCmpNames(entryName, entryNameSize, name, nameSize) < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return(first);
+}
 
-            if(dataId->dataNodeName == NULL) {
-                continue;
-            }
+/* checks whether all the keys named @name are decoded (read only) */
+static int
+xmlSecSimpleKeysStoreSnapshotIsDecoded(xmlSecSimpleKeysStoreSnapshotPtr snapshot, const xmlChar* name) {
+    const xmlSecByte* entryName;
+    xmlSecSize entryNameSize, nameSize;
+    xmlSecSize pos;
+
+    xmlSecAssert2(snapshot != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    nameSize = XMLSEC_SIZE_BAD_CAST(xmlStrlen(name));
+    for(pos = xmlSecSimpleKeysStoreSnapshotFindFirst(snapshot, name, nameSize); pos < snapshot->count; ++pos) {
+        xmlSecSimpleKeysStoreSnapshotGetEntry(snapshot, pos, &entryName, &entryNameSize, NULL, NULL);
+        if(xmlSecSimpleKeysStoreSnapshotCmpNames(entryName, entryNameSize, name, nameSize) != 0) {
+            break;
+        }
+        if(snapshot->decoded[pos] == 0) {
+            return(0);
+        }
+    }
+    return(1);
+}
 
-            data = xmlSecKeyGetData(key, dataId);
-            if(data == NULL) {
-                continue;
-            }
+static int
+xmlSecSimpleKeysStoreSnapshotDecodeName(xmlSecSimpleKeysStoreCtxPtr ctx, const xmlChar* name) {
+    xmlSecSimpleKeysStoreSnapshotPtr snapshot;
+    const xmlSecByte* entryName;
+    xmlSecSize entryNameSize, nameSize;
+    xmlSecSize first;
+    int ret;
 
-            if(xmlSecAddChild(cur, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild",
-                                     xmlSecKeyStoreGetName(store),
-                                    "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        }
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
 
-        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    snapshot = ctx->snapshot;
+    if(snapshot == NULL) {
+        return(0);
+    }
+    nameSize = XMLSEC_SIZE_BAD_CAST(xmlStrlen(name));
+    first = xmlSecSimpleKeysStoreSnapshotFindFirst(snapshot, name, nameSize);
+
+    for(; first < snapshot->count; ++first) {
+        xmlSecSimpleKeysStoreSnapshotGetEntry(snapshot, first, &entryName, &entryNameSize, NULL, NULL);
+        if(xmlSecSimpleKeysStoreSnapshotCmpNames(entryName, entryNameSize, name, nameSize) != 0) {
+            break;
+        }
+        ret = xmlSecSimpleKeysStoreSnapshotDecode(ctx, first);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
-                                xmlSecKeyStoreGetName(store));
-            xmlFreeDoc(doc);
+            xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecode", NULL);
             return(-1);
         }
+    }
 
-        keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
-        keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
-        keyInfoCtx.keyReq.keyType       = type;
-        keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
+    if(snapshot->decodedSize >= snapshot->count) {
+        xmlSecSimpleKeysStoreSnapshotDestroy(snapshot);
+        ctx->snapshot = NULL;
+    }
+    return(0);
+}
 
-        /* finally write key in the node */
-        ret = xmlSecKeyInfoNodeWrite(cur, key, &keyInfoCtx);
+/* decodes all the remaining entries, the caller holds the store lock */
+static int
+xmlSecSimpleKeysStoreSnapshotDecodeAll(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(ctx->snapshot == NULL) {
+        return(0);
+    }
+    for(ii = 0; ii < ctx->snapshot->count; ++ii) {
+        ret = xmlSecSimpleKeysStoreSnapshotDecode(ctx, ii);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeWrite",
-                                xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
-            xmlFreeDoc(doc);
+            xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDecode", NULL);
             return(-1);
         }
-        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
     }
 
-    /* now write result */
-    ret = xmlSaveFormatFile(filename, doc, 1);
-    if(ret < 0) {
-        xmlSecXmlError2("xmlSaveFormatFile", xmlSecKeyStoreGetName(store),
-                        "filename=%s", xmlSecErrorsSafeString(filename));
+    xmlSecSimpleKeysStoreSnapshotDestroy(ctx->snapshot);
+    ctx->snapshot = NULL;
+    return(0);
+}
+
+/* serializes <dsig:KeyInfo/> @node with all the namespaces it needs */
+static xmlBufferPtr
+xmlSecSimpleKeysStoreSnapshotDumpKeyInfo(xmlNodePtr node) {
+    xmlDocPtr doc;
+    xmlNodePtr copy;
+    xmlBufferPtr res;
+
+    xmlSecAssert2(node != NULL, NULL);
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    if(doc == NULL) {
+        xmlSecXmlError("xmlNewDoc", NULL);
+        return(NULL);
+    }
+    copy = xmlDocCopyNode(node, doc, 1);
+    if(copy == NULL) {
+        xmlSecXmlError("xmlDocCopyNode", NULL);
         xmlFreeDoc(doc);
-        return(-1);
+        return(NULL);
     }
+    xmlDocSetRootElement(doc, copy);
 
+    res = xmlBufferCreate();
+    if(res == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        xmlFreeDoc(doc);
+        return(NULL);
+    }
+    if(xmlNodeDump(res, doc, copy, 0, 0) < 0) {
+        xmlSecXmlError("xmlNodeDump", NULL);
+        xmlBufferFree(res);
+        xmlFreeDoc(doc);
+        return(NULL);
+    }
     xmlFreeDoc(doc);
-    return(0);
+    return(res);
 }
 
 /**
- * xmlSecSimpleKeysStoreGetKeys:
+ * xmlSecSimpleKeysStoreSaveSnapshot:
  * @store:              the pointer to simple keys store.
+ * @filename:           the filename.
+ * @type:               the saved keys type (public, private, ...).
  *
- * Gets list of keys from simple keys store.
+ * Writes keys from @store to a binary snapshot file. The snapshot is
+ * loaded with #xmlSecSimpleKeysStoreLoad much faster than the XML file
+ * from #xmlSecSimpleKeysStoreSave: the file is mapped in memory, the
+ * keys are indexed by name in the file itself and each key is decoded
+ * on the first lookup of its name. The format is versioned: a snapshot
+ * written by a different version of the library might be rejected
+ * and needs to be re-created from the XML file.
  *
- * Returns: pointer to the list of keys stored in the keys store or NULL
- * if an error occurs.
+ * Returns: 0 on success or a negative value if an error occurs.
  */
-xmlSecPtrListPtr
-xmlSecSimpleKeysStoreGetKeys(xmlSecKeyStorePtr store) {
-    xmlSecPtrListPtr list;
-
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
-
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
-
-    return list;
-}
-
-static int
-xmlSecSimpleKeysStoreInitialize(xmlSecKeyStorePtr store) {
+int
+xmlSecSimpleKeysStoreSaveSnapshot(xmlSecKeyStorePtr store, const char* filename, xmlSecKeyDataType type) {
+    xmlSecSimpleKeysStoreSnapshotItemPtr items = NULL;
+    xmlSecByte header[XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE];
+    xmlSecByte entry[XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE];
     xmlSecPtrListPtr list;
-    int ret;
+    xmlSecKeyPtr key;
+    xmlDocPtr doc;
+    xmlNodePtr cur;
+    xmlSecSize count = 0, ii;
+    xmlSecSize offset, keyInfoSize;
+    FILE* f = NULL;
+    int res = -1;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(filename != NULL, -1);
 
     list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(list != NULL, -1);
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
 
-    ret = xmlSecPtrListInitialize(list, xmlSecKeyPtrListId);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecPtrListInitialize(xmlSecKeyPtrListId)",
-                            xmlSecKeyStoreGetName(store));
+    /* the names are stored in the entries */
+    doc = xmlSecSimpleKeysStoreWriteDoc(store, type, 0);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreWriteDoc", xmlSecKeyStoreGetName(store));
         return(-1);
     }
 
-    return(0);
-}
+    /* one <dsig:KeyInfo/> per key in the list order */
+    for(cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        ++count;
+    }
+    xmlSecAssert2(count == xmlSecPtrListGetSize(list), -1);
 
-static void
-xmlSecSimpleKeysStoreFinalize(xmlSecKeyStorePtr store) {
-    xmlSecPtrListPtr list;
+    if(count > 0) {
+        items = (xmlSecSimpleKeysStoreSnapshotItemPtr)xmlMalloc(count * sizeof(xmlSecSimpleKeysStoreSnapshotItem));
+        if(items == NULL) {
+            xmlSecMallocError(count * sizeof(xmlSecSimpleKeysStoreSnapshotItem), xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        memset(items, 0, count * sizeof(xmlSecSimpleKeysStoreSnapshotItem));
+    }
+    for(ii = 0, cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children); cur != NULL; ++ii, cur = xmlSecGetNextElementNode(cur->next)) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, ii);
+        xmlSecAssert2(key != NULL, -1);
 
-    xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId));
+        items[ii].name = (xmlSecKeyGetName(key) != NULL) ? xmlSecKeyGetName(key) : BAD_CAST "";
+        items[ii].nameSize = XMLSEC_SIZE_BAD_CAST(xmlStrlen(items[ii].name));
+        items[ii].keyInfo = xmlSecSimpleKeysStoreSnapshotDumpKeyInfo(cur);
+        if(items[ii].keyInfo == NULL) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreSnapshotDumpKeyInfo", xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+    }
+    if(items != NULL) {
+        qsort(items, count, sizeof(xmlSecSimpleKeysStoreSnapshotItem), xmlSecSimpleKeysStoreSnapshotCmpItems);
+    }
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert(list != NULL);
+    f = fopen(filename, "wb");
+    if(f == NULL) {
+        xmlSecIOError("fopen", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
 
-    xmlSecPtrListFinalize(list);
-}
+    memcpy(header, XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC, XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE);
+    xmlSecSimpleKeysStoreSnapshotSetUInt(header + XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE, XMLSEC_KEYS_STORE_SNAPSHOT_VERSION);
+    xmlSecSimpleKeysStoreSnapshotSetUInt(header + XMLSEC_KEYS_STORE_SNAPSHOT_MAGIC_SIZE + 4, count);
+    if(fwrite(header, 1, sizeof(header), f) != sizeof(header)) {
+        xmlSecIOError("fwrite", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
 
-static xmlSecKeyPtr
-xmlSecSimpleKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
-                            xmlSecKeyInfoCtxPtr keyInfoCtx) {
-    xmlSecPtrListPtr list;
-    xmlSecKeyPtr key;
-    xmlSecSize pos, size;
+    /* entries table, the data follows it */
+    offset = XMLSEC_KEYS_STORE_SNAPSHOT_HEADER_SIZE + count * XMLSEC_KEYS_STORE_SNAPSHOT_ENTRY_SIZE;
+    for(ii = 0; ii < count; ++ii) {
+        keyInfoSize = (xmlSecSize)xmlBufferLength(items[ii].keyInfo);
+        if((items[ii].nameSize > XMLSEC_KEYS_STORE_SNAPSHOT_MAX_SIZE - offset) ||
+           (keyInfoSize > XMLSEC_KEYS_STORE_SNAPSHOT_MAX_SIZE - offset - items[ii].nameSize)) {
+            xmlSecInvalidSizeOtherError("keys store snapshot is larger than 4GB", xmlSecKeyStoreGetName(store));
+            goto done;
+        }
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
-    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+        xmlSecSimpleKeysStoreSnapshotSetUInt(entry, offset);
+        xmlSecSimpleKeysStoreSnapshotSetUInt(entry + 4, items[ii].nameSize);
+        xmlSecSimpleKeysStoreSnapshotSetUInt(entry + 8, offset + items[ii].nameSize);
+        xmlSecSimpleKeysStoreSnapshotSetUInt(entry + 12, keyInfoSize);
+        if(fwrite(entry, 1, sizeof(entry), f) != sizeof(entry)) {
+            xmlSecIOError("fwrite", filename, xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        offset += items[ii].nameSize + keyInfoSize;
+    }
+    for(ii = 0; ii < count; ++ii) {
+        keyInfoSize = (xmlSecSize)xmlBufferLength(items[ii].keyInfo);
+        if((fwrite(items[ii].name, 1, items[ii].nameSize, f) != items[ii].nameSize) ||
+           (fwrite(xmlBufferContent(items[ii].keyInfo), 1, keyInfoSize, f) != keyInfoSize)) {
+            xmlSecIOError("fwrite", filename, xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+    }
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
+    /* success */
+    res = 0;
 
-    size = xmlSecPtrListGetSize(list);
-    for(pos = 0; pos < size; ++pos) {
-        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, pos);
-        if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
-            return(xmlSecKeyDuplicate(key));
+done:
+    if(f != NULL) {
+        if((fclose(f) != 0) && (res == 0)) {
+            xmlSecIOError("fclose", filename, xmlSecKeyStoreGetName(store));
+            res = -1;
         }
     }
-    return(NULL);
+    if(items != NULL) {
+        for(ii = 0; ii < count; ++ii) {
+            if(items[ii].keyInfo != NULL) {
+                xmlBufferFree(items[ii].keyInfo);
+            }
+        }
+        xmlFree(items);
+    }
+    xmlFreeDoc(doc);
+    return(res);
 }
-
@@ -227,18 +227,18 @@ xmlSecKWDes3Decode(xmlSecKWDes3Id kwDes3Id, void *context,
 static int
 xmlSecKWDes3BufferReverse(xmlSecByte *buf, xmlSecSize size) 
 {
-    xmlSecByte * p;
-    xmlSecByte ch;
-
-    xmlSecAssert2(buf != NULL, -1);
-    xmlSecAssert2(size > 0, -1);
-
-    for(p = buf + size - 1; p >= buf; ++buf, --p) {
-        ch = (*p);
-        (*p) = (*buf);
-        (*buf) = ch;
-    }
-    return (0);
+    xmlSecByte * p;
+    xmlSecByte ch;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(size > 0, -1);
+
+    for(p = buf + size - 1; p >= buf; ++buf, --p) {
+        ch = (*p);
+        (*p) = (*buf);
+        (*buf) = ch;
+    }
+    return (0);
 }
 
 #endif /* XMLSEC_NO_DES */
@@ -349,7 +349,15 @@ xmlSecKWAesEncode(xmlSecKWAesId kwAesId, void *context,
     memcpy(out, xmlSecKWAesMagicBlock, XMLSEC_KW_AES_MAGIC_BLOCK_SIZE);
 
     N = (inSize / 8);
-    if(N == 1) {
+    if((N > 1) && (kwAesId->wrap != NULL)) {
+        /* the backend runs the whole loop with the prepared key */
+        ret = kwAesId->wrap(out + XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, inSize, out, outSize, context);
+        if(ret < 0) {
+            xmlSecInternalError("kwAesId->wrap", NULL);
+            return(-1);
+        }
+        xmlSecAssert2((xmlSecSize)ret == inSize + XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+    } else if(N == 1) {
         ret = kwAesId->encrypt(out, inSize + XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, out, outSize, context);
         if(ret < 0) {
             xmlSecInternalError("kwAesId->encrypt", NULL);
@@ -403,7 +411,16 @@ xmlSecKWAesDecode(xmlSecKWAesId kwAesId, void *context,
     }
 
     N = (inSize / 8) - 1;
-    if(N == 1) {
+    if((N > 1) && (kwAesId->unwrap != NULL)) {
+        /* the backend runs the whole loop with the prepared key and checks the magic block */
+        ret = kwAesId->unwrap(out, inSize, out, outSize, context);
+        if(ret < 0) {
+            xmlSecInternalError("kwAesId->unwrap", NULL);
+            return(-1);
+        }
+        xmlSecAssert2((xmlSecSize)ret == inSize - XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+        return(ret);
+    } else if(N == 1) {
         ret = kwAesId->decrypt(out, inSize, out, outSize, context);
         if(ret < 0) {
             xmlSecInternalError("kwAesId->decrypt", NULL);
@@ -114,6 +114,16 @@ typedef int  (*xmlSecKWAesBlockDecryptMethod)       (const xmlSecByte * in,
                                                      xmlSecByte * out,
                                                      xmlSecSize outSize,
                                                      void * context);
+typedef int  (*xmlSecKWAesWrapMethod)               (const xmlSecByte * in,
+                                                     xmlSecSize inSize,
+                                                     xmlSecByte * out,
+                                                     xmlSecSize outSize,
+                                                     void * context);
+typedef int  (*xmlSecKWAesUnwrapMethod)             (const xmlSecByte * in,
+                                                     xmlSecSize inSize,
+                                                     xmlSecByte * out,
+                                                     xmlSecSize outSize,
+                                                     void * context);
 
 
 struct _xmlSecKWAesKlass {
@@ -121,6 +131,10 @@ struct _xmlSecKWAesKlass {
     xmlSecKWAesBlockEncryptMethod       encrypt;
     xmlSecKWAesBlockDecryptMethod       decrypt;
 
+    /* optional: the whole RFC 3394 wrap/unwrap loop in one call */
+    xmlSecKWAesWrapMethod               wrap;
+    xmlSecKWAesUnwrapMethod             unwrap;
+
     /* for the future */
     void*                               reserved0;
     void*                               reserved1;
@@ -150,7 +150,9 @@ xmlSecPtrListEmpty(xmlSecPtrListPtr list) {
         xmlSecAssert(list->data != NULL);
 
         memset(list->data, 0, sizeof(xmlSecPtr) * list->use);
-        xmlFree(list->data);
+        if(list->data != list->inlineData) {
+            xmlFree(list->data);
+        }
     }
     list->max = list->use = 0;
     list->data = NULL;
@@ -185,6 +187,18 @@ xmlSecPtrListCopy(xmlSecPtrListPtr dst, xmlSecPtrListPtr src) {
         return(-1);
     }
 
+    /* the pointers are copied at once if there is nothing to duplicate */
+    if(dst->id->duplicateItem == NULL) {
+        if(src->use > 0) {
+            xmlSecAssert2(src->data != NULL, -1);
+            xmlSecAssert2(dst->data != NULL, -1);
+
+            memcpy(dst->data + dst->use, src->data, sizeof(xmlSecPtr) * src->use);
+            dst->use += src->use;
+        }
+        return(0);
+    }
+
     /* copy one item after another */
     for(i = 0; i < src->use; ++i, ++dst->use) {
         xmlSecAssert2(src->data != NULL, -1);
@@ -298,6 +312,41 @@ xmlSecPtrListAdd(xmlSecPtrListPtr list, xmlSecPtr item) {
     return(0);
 }
 
+/**
+ * xmlSecPtrListAddItems:
+ * @list:               the pointer to list.
+ * @items:              the items.
+ * @itemsSize:          the number of items in @items.
+ *
+ * Adds @itemsSize items from @items array to the end of the @list
+ * (the items are not duplicated).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecPtrListAddItems(xmlSecPtrListPtr list, const xmlSecPtr* items, xmlSecSize itemsSize) {
+    int ret;
+
+    xmlSecAssert2(xmlSecPtrListIsValid(list), -1);
+    xmlSecAssert2((items != NULL) || (itemsSize == 0), -1);
+
+    if(itemsSize == 0) {
+        return(0);
+    }
+
+    ret = xmlSecPtrListEnsureSize(list, list->use + itemsSize);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecPtrListEnsureSize",
+                             xmlSecPtrListGetName(list),
+                             "size=" XMLSEC_SIZE_FMT, list->use + itemsSize);
+        return(-1);
+    }
+
+    memcpy(list->data + list->use, items, sizeof(xmlSecPtr) * itemsSize);
+    list->use += itemsSize;
+    return(0);
+}
+
 /**
  * xmlSecPtrListSet:
  * @list:               the pointer to list.
@@ -372,6 +421,34 @@ xmlSecPtrListRemoveAndReturn(xmlSecPtrListPtr list, xmlSecSize pos) {
     return(res);
 }
 
+/**
+ * xmlSecPtrListTruncate:
+ * @list:               the pointer to list.
+ * @size:               the new list size.
+ *
+ * Destroys the list items at the positions starting from @size and
+ * shrinks the list to @size items. Unlike #xmlSecPtrListEmpty, the
+ * allocated memory is kept for the items added later.
+ */
+void
+xmlSecPtrListTruncate(xmlSecPtrListPtr list, xmlSecSize size) {
+    xmlSecSize pos;
+
+    xmlSecAssert(xmlSecPtrListIsValid(list));
+
+    if(size >= list->use) {
+        return;
+    }
+    xmlSecAssert(list->data != NULL);
+
+    for(pos = size; pos < list->use; ++pos) {
+        if((list->id->destroyItem != NULL) && (list->data[pos] != NULL)) {
+            list->id->destroyItem(list->data[pos]);
+        }
+        list->data[pos] = NULL;
+    }
+    list->use = size;
+}
 
 /**
  * xmlSecPtrListDebugDump:
@@ -435,11 +512,20 @@ xmlSecPtrListEnsureSize(xmlSecPtrListPtr list, xmlSecSize size) {
         return(0);
     }
 
+    /* the small lists live inside the list structure */
+    if((list->data == NULL) && (size < XMLSEC_PTR_LIST_INLINE_SIZE)) {
+        memset(list->inlineData, 0, sizeof(list->inlineData));
+        list->data = list->inlineData;
+        list->max = XMLSEC_PTR_LIST_INLINE_SIZE;
+        return(0);
+    }
+
     switch(list->allocMode) {
         case xmlSecAllocModeExact:
             newSize = size + 8;
             break;
         case xmlSecAllocModeDouble:
+        case xmlSecAllocModeOffset:
             newSize = 2 * size + 32;
             break;
     }
@@ -448,7 +534,7 @@ xmlSecPtrListEnsureSize(xmlSecPtrListPtr list, xmlSecSize size) {
         newSize = gInitialSize;
     }
 
-    if(list->data != NULL) {
+    if((list->data != NULL) && (list->data != list->inlineData)) {
         newData = (xmlSecPtr*)xmlRealloc(list->data, sizeof(xmlSecPtr) * newSize);
     } else {
         newData = (xmlSecPtr*)xmlMalloc(sizeof(xmlSecPtr) * newSize);
@@ -458,6 +544,10 @@ xmlSecPtrListEnsureSize(xmlSecPtrListPtr list, xmlSecSize size) {
                           xmlSecPtrListGetName(list));
         return(-1);
     }
+    if(list->data == list->inlineData) {
+        memcpy(newData, list->inlineData, sizeof(xmlSecPtr) * list->use);
+        memset(list->inlineData, 0, sizeof(list->inlineData));
+    }
 
     list->data = newData;
     list->max = newSize;
@@ -44,6 +44,11 @@ static void             xmlSecTransformMemBufFinalize           (xmlSecTransform
 static int              xmlSecTransformMemBufExecute            (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecTransformMemBufPushBin            (xmlSecTransformPtr transform,
+                                                                 const xmlSecByte* data,
+                                                                 xmlSecSize dataSize,
+                                                                 int final,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 static xmlSecTransformKlass xmlSecTransformMemBufKlass = {
     /* klass/object sizes */
     sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
@@ -61,7 +66,7 @@ static xmlSecTransformKlass xmlSecTransformMemBufKlass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformMemBufPushBin,               /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -194,3 +199,59 @@ xmlSecTransformMemBufExecute(xmlSecTransformPtr transform, int last, xmlSecTrans
     return(0);
 }
 
+/* copies the data to our buffer and passes it to the next transform as-is (no outBuf staging) */
+static int
+xmlSecTransformMemBufPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
+                             xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecBufferPtr buffer;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformMemBufId), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    buffer = xmlSecTransformMemBufGetBuf(transform);
+    xmlSecAssert2(buffer != NULL, -1);
+
+    /* the last transform in the chain keeps the result in outBuf */
+    if(transform->next == NULL) {
+        return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+    }
+
+    if(transform->status == xmlSecTransformStatusNone) {
+        transform->status = xmlSecTransformStatusWorking;
+    }
+    if(transform->status == xmlSecTransformStatusFinished) {
+        /* the only way we can get here is if there is no input */
+        xmlSecAssert2(dataSize == 0, -1);
+        return(0);
+    } else if(transform->status != xmlSecTransformStatusWorking) {
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+
+    if(dataSize > 0) {
+        xmlSecAssert2(data != NULL, -1);
+
+        ret = xmlSecBufferAppend(buffer, data, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferAppend",
+                                 xmlSecTransformGetName(transform),
+                                 "size=" XMLSEC_SIZE_FMT, dataSize);
+            return(-1);
+        }
+    }
+    if(final != 0) {
+        transform->status = xmlSecTransformStatusFinished;
+    }
+
+    if((dataSize > 0) || (final != 0)) {
+        ret = xmlSecTransformPushBin(transform->next, data, dataSize, final, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformPushBin",
+                                 xmlSecTransformGetName(transform->next),
+                                 "final=%d", final);
+            return(-1);
+        }
+    }
+    return(0);
+}
@@ -0,0 +1,581 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Process-wide metrics: the signatures and encryption counters, the cache
+ * hit rates and the processing phases timings. Each thread updates its own
+ * counters without any locking, the counters of all the threads are summed
+ * up only when the metrics are read.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_METRICS_WIN32            1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_METRICS_PTHREAD          1
+#endif /* defined(_WIN32) */
+
+#include <libxml/tree.h>
+#include <libxml/threads.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/metrics.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/private/metrics.h>
+
+/* the maximum nesting of the same phase (e.g. <enc:EncryptedKey/> in <dsig:KeyInfo/>) */
+#define XMLSEC_METRICS_PHASE_DEPTH      8
+
+typedef struct _xmlSecMetricInfo {
+    const char*         name;
+    const char*         help;
+    int                 gauge;
+} xmlSecMetricInfo;
+
+static const xmlSecMetricInfo xmlSecMetricsInfo[xmlSecMetricLast] = {
+    { "xmlsec_signatures_created_total",        "Created signatures", 0 },
+    { "xmlsec_signatures_verified_total",       "Successfully verified signatures", 0 },
+    { "xmlsec_signatures_invalid_total",        "Signatures that failed verification", 0 },
+    { "xmlsec_data_encrypted_total",            "Encrypted EncryptedData and EncryptedKey nodes", 0 },
+    { "xmlsec_data_decrypted_total",            "Decrypted EncryptedData and EncryptedKey nodes", 0 },
+    { "xmlsec_c14n_bytes_total",                "Bytes produced by the canonicalization transforms", 0 },
+    { "xmlsec_xpath_cache_hits_total",          "Compiled XPath expressions cache hits", 0 },
+    { "xmlsec_xpath_cache_misses_total",        "Compiled XPath expressions cache misses", 0 },
+    { "xmlsec_keys_cache_hits_total",           "Resolved keys cache hits", 0 },
+    { "xmlsec_keys_cache_misses_total",         "Resolved keys cache misses", 0 },
+    { "xmlsec_x509_cache_hits_total",           "Certificates verification cache hits", 0 },
+    { "xmlsec_x509_cache_misses_total",         "Certificates verification cache misses", 0 },
+    { "xmlsec_transforms_memory_peak_bytes",    "Maximum memory allocated by the buffers of one transforms chain", 1 }
+};
+
+static const char* xmlSecMetricsPhaseNames[XMLSEC_METRICS_PHASES_NUMBER] = {
+    "signed_info",
+    "reference",
+    "key_info",
+    "x509_verify",
+    "signature_verify",
+    "cipher"
+};
+
+/**************************************************************************
+ *
+ * Per-thread metrics: only the owner thread writes them, the readers
+ * might see slightly stale values. The metrics of the exited threads
+ * are added to the retired totals.
+ *
+ *************************************************************************/
+typedef struct _xmlSecMetricsThread                     xmlSecMetricsThread,
+                                                        *xmlSecMetricsThreadPtr;
+struct _xmlSecMetricsThread {
+    xmlSecSize                  counters[xmlSecMetricLast];
+    xmlSecMetricsPhaseStats     phases[XMLSEC_METRICS_PHASES_NUMBER];
+    double                      starts[XMLSEC_METRICS_PHASES_NUMBER][XMLSEC_METRICS_PHASE_DEPTH];
+    int                         depths[XMLSEC_METRICS_PHASES_NUMBER];
+    xmlSecMetricsThreadPtr      next;           /* all the threads metrics */
+    xmlSecMetricsThreadPtr      prev;
+};
+
+#if defined(XMLSEC_METRICS_WIN32)
+static DWORD xmlSecMetricsThreadKey = TLS_OUT_OF_INDEXES;
+#elif defined(XMLSEC_METRICS_PTHREAD)
+static pthread_key_t xmlSecMetricsThreadKey;
+static int xmlSecMetricsThreadKeyCreated = 0;
+#else /* defined(XMLSEC_METRICS_WIN32) */
+/* no threads support, there is only one thread */
+static xmlSecMetricsThreadPtr xmlSecMetricsThreadCurrent = NULL;
+#endif /* defined(XMLSEC_METRICS_WIN32) */
+
+static int                      xmlSecMetricsEnabled    = 0;
+static xmlMutexPtr              xmlSecMetricsMutex      = NULL;
+static xmlSecMetricsThreadPtr   xmlSecMetricsThreads    = NULL;
+static xmlSecMetricsThread      xmlSecMetricsRetired;
+
+static double
+xmlSecMetricsNow(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((double)ts.tv_sec * 1000000.0) + ((double)ts.tv_nsec / 1000.0));
+#else /* defined(CLOCK_MONOTONIC) */
+    return(((double)clock() * 1000000.0) / CLOCKS_PER_SEC);
+#endif /* defined(CLOCK_MONOTONIC) */
+}
+
+/* adds the @src metrics to the @dst totals */
+static void
+xmlSecMetricsThreadMerge(xmlSecMetricsThreadPtr dst, const xmlSecMetricsThread* src) {
+    xmlSecSize ii, jj;
+
+    for(ii = 0; ii < xmlSecMetricLast; ++ii) {
+        if(xmlSecMetricsInfo[ii].gauge == 0) {
+            dst->counters[ii] += src->counters[ii];
+        } else if(dst->counters[ii] < src->counters[ii]) {
+            dst->counters[ii] = src->counters[ii];
+        }
+    }
+    for(ii = 0; ii < XMLSEC_METRICS_PHASES_NUMBER; ++ii) {
+        dst->phases[ii].count += src->phases[ii].count;
+        dst->phases[ii].failed += src->phases[ii].failed;
+        dst->phases[ii].time += src->phases[ii].time;
+        for(jj = 0; jj < XMLSEC_METRICS_BUCKETS_NUMBER; ++jj) {
+            dst->phases[ii].buckets[jj] += src->phases[ii].buckets[jj];
+        }
+    }
+}
+
+/* called when the thread exits */
+static void
+xmlSecMetricsThreadDestroy(void* data) {
+    xmlSecMetricsThreadPtr thread = (xmlSecMetricsThreadPtr)data;
+
+    if(thread == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecMetricsMutex);
+    if(thread->prev != NULL) {
+        thread->prev->next = thread->next;
+    } else {
+        xmlSecMetricsThreads = thread->next;
+    }
+    if(thread->next != NULL) {
+        thread->next->prev = thread->prev;
+    }
+    xmlSecMetricsThreadMerge(&xmlSecMetricsRetired, thread);
+    xmlMutexUnlock(xmlSecMetricsMutex);
+
+    xmlFree(thread);
+}
+
+/*
+ * Gets the current thread metrics creating them if needed. Returns NULL
+ * if the metrics are disabled or can not be created (not an error, the
+ * values are simply not counted).
+ */
+static xmlSecMetricsThreadPtr
+xmlSecMetricsThreadGet(void) {
+    xmlSecMetricsThreadPtr thread;
+
+    if((xmlSecMetricsEnabled == 0) || (xmlSecMetricsMutex == NULL)) {
+        return(NULL);
+    }
+
+#if defined(XMLSEC_METRICS_WIN32)
+    if(xmlSecMetricsThreadKey == TLS_OUT_OF_INDEXES) {
+        return(NULL);
+    }
+    thread = (xmlSecMetricsThreadPtr)TlsGetValue(xmlSecMetricsThreadKey);
+#elif defined(XMLSEC_METRICS_PTHREAD)
+    if(xmlSecMetricsThreadKeyCreated == 0) {
+        return(NULL);
+    }
+    thread = (xmlSecMetricsThreadPtr)pthread_getspecific(xmlSecMetricsThreadKey);
+#else /* defined(XMLSEC_METRICS_WIN32) */
+    thread = xmlSecMetricsThreadCurrent;
+#endif /* defined(XMLSEC_METRICS_WIN32) */
+    if(thread != NULL) {
+        return(thread);
+    }
+
+    thread = (xmlSecMetricsThreadPtr)xmlMalloc(sizeof(xmlSecMetricsThread));
+    if(thread == NULL) {
+        return(NULL);
+    }
+    memset(thread, 0, sizeof(xmlSecMetricsThread));
+
+#if defined(XMLSEC_METRICS_WIN32)
+    if(!TlsSetValue(xmlSecMetricsThreadKey, thread)) {
+        xmlFree(thread);
+        return(NULL);
+    }
+#elif defined(XMLSEC_METRICS_PTHREAD)
+    if(pthread_setspecific(xmlSecMetricsThreadKey, thread) != 0) {
+        xmlFree(thread);
+        return(NULL);
+    }
+#else /* defined(XMLSEC_METRICS_WIN32) */
+    xmlSecMetricsThreadCurrent = thread;
+#endif /* defined(XMLSEC_METRICS_WIN32) */
+
+    xmlMutexLock(xmlSecMetricsMutex);
+    thread->next = xmlSecMetricsThreads;
+    if(xmlSecMetricsThreads != NULL) {
+        xmlSecMetricsThreads->prev = thread;
+    }
+    xmlSecMetricsThreads = thread;
+    xmlMutexUnlock(xmlSecMetricsMutex);
+
+    return(thread);
+}
+
+/* sums up the metrics of all the threads */
+static void
+xmlSecMetricsCollect(xmlSecMetricsThreadPtr totals) {
+    xmlSecMetricsThreadPtr thread;
+
+    xmlSecAssert(totals != NULL);
+
+    memset(totals, 0, sizeof(xmlSecMetricsThread));
+    if(xmlSecMetricsMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecMetricsMutex);
+    xmlSecMetricsThreadMerge(totals, &xmlSecMetricsRetired);
+    for(thread = xmlSecMetricsThreads; thread != NULL; thread = thread->next) {
+        xmlSecMetricsThreadMerge(totals, thread);
+    }
+    xmlMutexUnlock(xmlSecMetricsMutex);
+}
+
+/**
+ * xmlSecMetricsInitialize:
+ *
+ * Initializes the metrics registry. This function is called from the
+ * #xmlSecInit function.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecMetricsInitialize(void) {
+    if(xmlSecMetricsMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecMetricsMutex = xmlNewMutex();
+    if(xmlSecMetricsMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+    memset(&xmlSecMetricsRetired, 0, sizeof(xmlSecMetricsRetired));
+
+#if defined(XMLSEC_METRICS_WIN32)
+    if(xmlSecMetricsThreadKey == TLS_OUT_OF_INDEXES) {
+        xmlSecMetricsThreadKey = TlsAlloc();
+    }
+#elif defined(XMLSEC_METRICS_PTHREAD)
+    if(xmlSecMetricsThreadKeyCreated == 0) {
+        if(pthread_key_create(&xmlSecMetricsThreadKey, xmlSecMetricsThreadDestroy) == 0) {
+            xmlSecMetricsThreadKeyCreated = 1;
+        }
+    }
+#endif /* defined(XMLSEC_METRICS_WIN32) */
+    return(0);
+}
+
+/**
+ * xmlSecMetricsShutdown:
+ *
+ * Destroys the metrics registry. This function is called from the
+ * #xmlSecShutdown function.
+ */
+void
+xmlSecMetricsShutdown(void) {
+    xmlSecMetricsThreadPtr thread;
+
+    if(xmlSecMetricsMutex == NULL) {
+        return;
+    }
+
+    /* the metrics of the threads that are still running are released too */
+    xmlMutexLock(xmlSecMetricsMutex);
+    while(xmlSecMetricsThreads != NULL) {
+        thread = xmlSecMetricsThreads;
+        xmlSecMetricsThreads = thread->next;
+        xmlFree(thread);
+    }
+    xmlMutexUnlock(xmlSecMetricsMutex);
+
+#if defined(XMLSEC_METRICS_WIN32)
+    if(xmlSecMetricsThreadKey != TLS_OUT_OF_INDEXES) {
+        TlsFree(xmlSecMetricsThreadKey);
+        xmlSecMetricsThreadKey = TLS_OUT_OF_INDEXES;
+    }
+#elif defined(XMLSEC_METRICS_PTHREAD)
+    if(xmlSecMetricsThreadKeyCreated != 0) {
+        pthread_key_delete(xmlSecMetricsThreadKey);
+        xmlSecMetricsThreadKeyCreated = 0;
+    }
+#else /* defined(XMLSEC_METRICS_WIN32) */
+    xmlSecMetricsThreadCurrent = NULL;
+#endif /* defined(XMLSEC_METRICS_WIN32) */
+
+    xmlFreeMutex(xmlSecMetricsMutex);
+    xmlSecMetricsMutex = NULL;
+}
+
+/**
+ * xmlSecMetricsSetEnabled:
+ * @enabled:            1 to collect the metrics or 0 to stop collecting them.
+ *
+ * Enables or disables the metrics collection (disabled by default). The
+ * already collected values are kept.
+ */
+void
+xmlSecMetricsSetEnabled(int enabled) {
+    xmlSecMetricsEnabled = enabled;
+}
+
+/**
+ * xmlSecMetricsIsEnabled:
+ *
+ * Checks if the metrics are collected (see #xmlSecMetricsSetEnabled).
+ *
+ * Returns: 1 if the metrics are collected or 0 otherwise.
+ */
+int
+xmlSecMetricsIsEnabled(void) {
+    return((xmlSecMetricsEnabled != 0) ? 1 : 0);
+}
+
+/**
+ * xmlSecMetricsAdd:
+ * @metric:             the metric.
+ * @value:              the value to add.
+ *
+ * Adds @value to the @metric counter of the current thread (or updates
+ * the @metric maximum for the gauges). Does nothing if the metrics are
+ * disabled.
+ */
+void
+xmlSecMetricsAdd(xmlSecMetric metric, xmlSecSize value) {
+    xmlSecMetricsThreadPtr thread;
+
+    xmlSecAssert(metric < xmlSecMetricLast);
+
+    thread = xmlSecMetricsThreadGet();
+    if(thread == NULL) {
+        return;
+    }
+    if(xmlSecMetricsInfo[metric].gauge == 0) {
+        thread->counters[metric] += value;
+    } else if(thread->counters[metric] < value) {
+        thread->counters[metric] = value;
+    }
+}
+
+/**
+ * xmlSecMetricsGet:
+ * @metric:             the metric.
+ *
+ * Gets the @metric value summed up for all the threads (the maximum
+ * for the gauges).
+ *
+ * Returns: the metric value.
+ */
+xmlSecSize
+xmlSecMetricsGet(xmlSecMetric metric) {
+    xmlSecMetricsThread totals;
+
+    xmlSecAssert2(metric < xmlSecMetricLast, 0);
+
+    xmlSecMetricsCollect(&totals);
+    return(totals.counters[metric]);
+}
+
+/**
+ * xmlSecMetricsGetName:
+ * @metric:             the metric.
+ *
+ * Gets the @metric name as it is reported by #xmlSecMetricsDumpPrometheus.
+ *
+ * Returns: the metric name or NULL if @metric is invalid.
+ */
+const char*
+xmlSecMetricsGetName(xmlSecMetric metric) {
+    xmlSecAssert2(metric < xmlSecMetricLast, NULL);
+
+    return(xmlSecMetricsInfo[metric].name);
+}
+
+/**
+ * xmlSecMetricsGetPhaseStats:
+ * @phase:              the processing phase.
+ * @stats:              the pointer to the result.
+ *
+ * Gets the @phase timings summed up for all the threads.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecMetricsGetPhaseStats(xmlSecTracePhase phase, xmlSecMetricsPhaseStatsPtr stats) {
+    xmlSecMetricsThread totals;
+
+    xmlSecAssert2(phase < XMLSEC_METRICS_PHASES_NUMBER, -1);
+    xmlSecAssert2(stats != NULL, -1);
+
+    xmlSecMetricsCollect(&totals);
+    memcpy(stats, &(totals.phases[phase]), sizeof(xmlSecMetricsPhaseStats));
+    return(0);
+}
+
+/**
+ * xmlSecMetricsPhaseStatsGetPercentile:
+ * @stats:              the phase timings.
+ * @percentile:         the percentile (from 0 to 100).
+ *
+ * Estimates the @percentile of the phase time from the histogram.
+ *
+ * Returns: the upper bound of the histogram bucket the @percentile falls
+ * into (in microseconds) or 0 if there are no timings.
+ */
+double
+xmlSecMetricsPhaseStatsGetPercentile(xmlSecMetricsPhaseStatsPtr stats, double percentile) {
+    double rank, count = 0;
+    xmlSecSize ii;
+
+    xmlSecAssert2(stats != NULL, 0);
+
+    if(stats->count == 0) {
+        return(0);
+    }
+    rank = (stats->count * percentile) / 100.0;
+    for(ii = 0; ii < XMLSEC_METRICS_BUCKETS_NUMBER; ++ii) {
+        count += stats->buckets[ii];
+        if((count >= rank) && (stats->buckets[ii] > 0)) {
+            break;
+        }
+    }
+    if(ii >= XMLSEC_METRICS_BUCKETS_NUMBER) {
+        ii = XMLSEC_METRICS_BUCKETS_NUMBER - 1;
+    }
+    return((double)((xmlSecSize)1 << ii));
+}
+
+/**
+ * xmlSecMetricsPhaseBegin:
+ * @phase:              the processing phase.
+ *
+ * Starts the @phase timer (called from #xmlSecTraceBegin).
+ */
+void
+xmlSecMetricsPhaseBegin(xmlSecTracePhase phase) {
+    xmlSecMetricsThreadPtr thread;
+    int depth;
+
+    if((xmlSecMetricsEnabled == 0) || (phase >= XMLSEC_METRICS_PHASES_NUMBER)) {
+        return;
+    }
+    thread = xmlSecMetricsThreadGet();
+    if(thread == NULL) {
+        return;
+    }
+
+    /* the too deeply nested phases are counted but not timed */
+    depth = thread->depths[phase]++;
+    if(depth < XMLSEC_METRICS_PHASE_DEPTH) {
+        thread->starts[phase][depth] = xmlSecMetricsNow();
+    }
+}
+
+/**
+ * xmlSecMetricsPhaseEnd:
+ * @phase:              the processing phase.
+ * @result:             the phase result.
+ *
+ * Stops the @phase timer and adds the phase time to the histogram
+ * (called from #xmlSecTraceEnd).
+ */
+void
+xmlSecMetricsPhaseEnd(xmlSecTracePhase phase, int result) {
+    xmlSecMetricsThreadPtr thread;
+    xmlSecMetricsPhaseStatsPtr stats;
+    double time;
+    xmlSecSize bucket;
+    int depth;
+
+    if((xmlSecMetricsEnabled == 0) || (phase >= XMLSEC_METRICS_PHASES_NUMBER)) {
+        return;
+    }
+    thread = xmlSecMetricsThreadGet();
+    if((thread == NULL) || (thread->depths[phase] <= 0)) {
+        /* the metrics were enabled in the middle of the phase */
+        return;
+    }
+
+    stats = &(thread->phases[phase]);
+    ++stats->count;
+    if(result < 0) {
+        ++stats->failed;
+    }
+    depth = --thread->depths[phase];
+    if(depth >= XMLSEC_METRICS_PHASE_DEPTH) {
+        return;
+    }
+
+    time = xmlSecMetricsNow() - thread->starts[phase][depth];
+    stats->time += time;
+    for(bucket = 0; bucket + 1 < XMLSEC_METRICS_BUCKETS_NUMBER; ++bucket) {
+        if(time < (double)((xmlSecSize)1 << bucket)) {
+            break;
+        }
+    }
+    ++stats->buckets[bucket];
+}
+
+/**
+ * xmlSecMetricsDumpPrometheus:
+ * @output:             the output file.
+ *
+ * Prints all the metrics in the Prometheus text exposition format. The
+ * phase timings are reported as the "xmlsec_phase_duration_microseconds"
+ * histogram with the "phase" label.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecMetricsDumpPrometheus(FILE* output) {
+    xmlSecMetricsThread totals;
+    xmlSecMetricsPhaseStatsPtr stats;
+    unsigned long count;
+    xmlSecSize ii, jj;
+
+    xmlSecAssert2(output != NULL, -1);
+
+    xmlSecMetricsCollect(&totals);
+    for(ii = 0; ii < xmlSecMetricLast; ++ii) {
+        fprintf(output, "# HELP %s %s\n", xmlSecMetricsInfo[ii].name, xmlSecMetricsInfo[ii].help);
+        fprintf(output, "# TYPE %s %s\n", xmlSecMetricsInfo[ii].name,
+                (xmlSecMetricsInfo[ii].gauge != 0) ? "gauge" : "counter");
+        fprintf(output, "%s %lu\n", xmlSecMetricsInfo[ii].name, (unsigned long)totals.counters[ii]);
+    }
+
+    fprintf(output, "# HELP xmlsec_phase_failures_total Failed processing phases\n");
+    fprintf(output, "# TYPE xmlsec_phase_failures_total counter\n");
+    for(ii = 0; ii < XMLSEC_METRICS_PHASES_NUMBER; ++ii) {
+        fprintf(output, "xmlsec_phase_failures_total{phase=\"%s\"} %lu\n",
+                xmlSecMetricsPhaseNames[ii], (unsigned long)totals.phases[ii].failed);
+    }
+
+    fprintf(output, "# HELP xmlsec_phase_duration_microseconds Processing phases duration\n");
+    fprintf(output, "# TYPE xmlsec_phase_duration_microseconds histogram\n");
+    for(ii = 0; ii < XMLSEC_METRICS_PHASES_NUMBER; ++ii) {
+        stats = &(totals.phases[ii]);
+        for(jj = 0, count = 0; jj + 1 < XMLSEC_METRICS_BUCKETS_NUMBER; ++jj) {
+            count += (unsigned long)stats->buckets[jj];
+            fprintf(output, "xmlsec_phase_duration_microseconds_bucket{phase=\"%s\",le=\"%lu\"} %lu\n",
+                    xmlSecMetricsPhaseNames[ii], (unsigned long)1 << jj, count);
+        }
+        fprintf(output, "xmlsec_phase_duration_microseconds_bucket{phase=\"%s\",le=\"+Inf\"} %lu\n",
+                xmlSecMetricsPhaseNames[ii], (unsigned long)stats->count);
+        fprintf(output, "xmlsec_phase_duration_microseconds_sum{phase=\"%s\"} %.0f\n",
+                xmlSecMetricsPhaseNames[ii], stats->time);
+        fprintf(output, "xmlsec_phase_duration_microseconds_count{phase=\"%s\"} %lu\n",
+                xmlSecMetricsPhaseNames[ii], (unsigned long)stats->count);
+    }
+    fflush(output);
+    return(0);
+}
@@ -0,0 +1,387 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Shared BCRYPT algorithm providers and reusable hash objects.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2018 Miklos Vajna <vmiklos@vmiklos.hu>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <string.h>
+#include <wchar.h>
+
+#define WIN32_NO_STATUS
+#include <windows.h>
+#undef WIN32_NO_STATUS
+#include <ntstatus.h>
+#include <bcrypt.h>
+
+#include <libxml/threads.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/mscng/crypto.h>
+#include "algprov.h"
+
+/**************************************************************************
+ *
+ * BCryptOpenAlgorithmProvider() is an expensive call (it loads and
+ * initializes the provider) and it used to be done for every transform
+ * and for every imported key. The algorithm handles are thread safe,
+ * so one handle per (algorithm, flags) pair is opened on first use and
+ * shared by all the callers until xmlSecMSCngShutdown().
+ *
+ * The plain digest hash objects are created with BCRYPT_HASH_REUSABLE_FLAG
+ * (Windows 8 and later) when possible: BCryptFinishHash() resets such hash
+ * to the initial state and the hash is kept for the next transform instead
+ * of being destroyed.
+ *
+ *****************************************************************************/
+#define XMLSEC_MSCNG_ALG_PROVIDERS_SIZE                 32
+#define XMLSEC_MSCNG_HASH_POOL_SIZE                     16
+
+#ifndef BCRYPT_HASH_REUSABLE_FLAG
+#define BCRYPT_HASH_REUSABLE_FLAG                       0x00000020
+#endif /* BCRYPT_HASH_REUSABLE_FLAG */
+
+typedef struct _xmlSecMSCngHashItem {
+    BCRYPT_HASH_HANDLE          hHash;
+    PBYTE                       pbHashObject;
+} xmlSecMSCngHashItem;
+
+typedef struct _xmlSecMSCngAlgProviderEntry {
+    LPCWSTR                     pszAlgId;
+    ULONG                       dwFlags;
+    BCRYPT_ALG_HANDLE           hAlg;
+
+    /* plain digests only (dwFlags == 0) */
+    DWORD                       cbHashObject;
+    DWORD                       cbHash;
+    int                         reusable;
+    xmlSecMSCngHashItem         hashes[XMLSEC_MSCNG_HASH_POOL_SIZE];
+    xmlSecSize                  hashesSize;
+} xmlSecMSCngAlgProviderEntry, *xmlSecMSCngAlgProviderEntryPtr;
+
+static xmlMutexPtr              xmlSecMSCngAlgProvidersMutex    = NULL;
+static xmlSecMSCngAlgProviderEntry xmlSecMSCngAlgProviders[XMLSEC_MSCNG_ALG_PROVIDERS_SIZE];
+static xmlSecSize               xmlSecMSCngAlgProvidersSize     = 0;
+
+/* the caller must hold the mutex */
+static xmlSecMSCngAlgProviderEntryPtr
+xmlSecMSCngAlgProviderFind(LPCWSTR pszAlgId, ULONG dwFlags) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < xmlSecMSCngAlgProvidersSize; ++ii) {
+        if((xmlSecMSCngAlgProviders[ii].dwFlags == dwFlags) &&
+           (wcscmp(xmlSecMSCngAlgProviders[ii].pszAlgId, pszAlgId) == 0)) {
+            return(&(xmlSecMSCngAlgProviders[ii]));
+        }
+    }
+    return(NULL);
+}
+
+/* the caller must hold the mutex; returns NULL if the table is full */
+static xmlSecMSCngAlgProviderEntryPtr
+xmlSecMSCngAlgProviderGetEntry(LPCWSTR pszAlgId, ULONG dwFlags, NTSTATUS* status) {
+    xmlSecMSCngAlgProviderEntryPtr entry;
+    BCRYPT_ALG_HANDLE hAlg = NULL;
+
+    (*status) = STATUS_SUCCESS;
+    entry = xmlSecMSCngAlgProviderFind(pszAlgId, dwFlags);
+    if(entry != NULL) {
+        return(entry);
+    }
+    if(xmlSecMSCngAlgProvidersSize >= XMLSEC_MSCNG_ALG_PROVIDERS_SIZE) {
+        return(NULL);
+    }
+
+    (*status) = BCryptOpenAlgorithmProvider(&hAlg, pszAlgId, NULL, dwFlags);
+    if((*status) != STATUS_SUCCESS) {
+        return(NULL);
+    }
+
+    entry = &(xmlSecMSCngAlgProviders[xmlSecMSCngAlgProvidersSize++]);
+    memset(entry, 0, sizeof(xmlSecMSCngAlgProviderEntry));
+    entry->pszAlgId = pszAlgId;
+    entry->dwFlags  = dwFlags;
+    entry->hAlg     = hAlg;
+    entry->reusable = 1;
+    return(entry);
+}
+
+/**
+ * xmlSecMSCngAlgProviderInitialize:
+ *
+ * Initializes the shared algorithm providers cache. This function is
+ * called from the #xmlSecMSCngInit function.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecMSCngAlgProviderInitialize(void) {
+    if(xmlSecMSCngAlgProvidersMutex == NULL) {
+        xmlSecMSCngAlgProvidersMutex = xmlNewMutex();
+        if(xmlSecMSCngAlgProvidersMutex == NULL) {
+            xmlSecXmlError("xmlNewMutex", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * xmlSecMSCngAlgProviderShutdown:
+ *
+ * Destroys the pooled hash objects and closes the shared algorithm
+ * providers. This function is called from the #xmlSecMSCngShutdown function.
+ */
+void
+xmlSecMSCngAlgProviderShutdown(void) {
+    xmlSecSize ii, jj;
+
+    if(xmlSecMSCngAlgProvidersMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+    for(ii = 0; ii < xmlSecMSCngAlgProvidersSize; ++ii) {
+        for(jj = 0; jj < xmlSecMSCngAlgProviders[ii].hashesSize; ++jj) {
+            BCryptDestroyHash(xmlSecMSCngAlgProviders[ii].hashes[jj].hHash);
+            xmlFree(xmlSecMSCngAlgProviders[ii].hashes[jj].pbHashObject);
+        }
+        BCryptCloseAlgorithmProvider(xmlSecMSCngAlgProviders[ii].hAlg, 0);
+    }
+    memset(xmlSecMSCngAlgProviders, 0, sizeof(xmlSecMSCngAlgProviders));
+    xmlSecMSCngAlgProvidersSize = 0;
+    xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+
+    xmlFreeMutex(xmlSecMSCngAlgProvidersMutex);
+    xmlSecMSCngAlgProvidersMutex = NULL;
+}
+
+/**
+ * xmlSecMSCngAlgProviderOpen:
+ * @phAlg:              the pointer to the result algorithm handle.
+ * @pszAlgId:           the algorithm id (one of the BCRYPT_*_ALGORITHM constants).
+ * @dwFlags:            the BCryptOpenAlgorithmProvider() flags.
+ *
+ * Gets the shared algorithm handle for @pszAlgId and @dwFlags, the same as
+ * BCryptOpenAlgorithmProvider() but the provider is opened only once.
+ * The caller must not change the handle properties and must release it
+ * with #xmlSecMSCngAlgProviderClose.
+ *
+ * Returns: STATUS_SUCCESS or the BCryptOpenAlgorithmProvider() error.
+ */
+NTSTATUS
+xmlSecMSCngAlgProviderOpen(BCRYPT_ALG_HANDLE* phAlg, LPCWSTR pszAlgId, ULONG dwFlags) {
+    xmlSecMSCngAlgProviderEntryPtr entry;
+    NTSTATUS status;
+
+    xmlSecAssert2(phAlg != NULL, STATUS_INVALID_PARAMETER);
+    xmlSecAssert2(pszAlgId != NULL, STATUS_INVALID_PARAMETER);
+    xmlSecAssert2(xmlSecMSCngAlgProvidersMutex != NULL, STATUS_INVALID_PARAMETER);
+
+    xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+    entry = xmlSecMSCngAlgProviderGetEntry(pszAlgId, dwFlags, &status);
+    if(entry != NULL) {
+        (*phAlg) = entry->hAlg;
+    }
+    xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+    if(entry != NULL) {
+        return(STATUS_SUCCESS);
+    } else if(status != STATUS_SUCCESS) {
+        return(status);
+    }
+
+    /* the table is full */
+    return(BCryptOpenAlgorithmProvider(phAlg, pszAlgId, NULL, dwFlags));
+}
+
+/**
+ * xmlSecMSCngAlgProviderClose:
+ * @hAlg:               the algorithm handle.
+ *
+ * Releases the algorithm handle returned by #xmlSecMSCngAlgProviderOpen.
+ * The shared handles stay open until xmlSecMSCngShutdown().
+ */
+void
+xmlSecMSCngAlgProviderClose(BCRYPT_ALG_HANDLE hAlg) {
+    xmlSecSize ii;
+    int shared = 0;
+
+    xmlSecAssert(hAlg != NULL);
+    xmlSecAssert(xmlSecMSCngAlgProvidersMutex != NULL);
+
+    xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+    for(ii = 0; ii < xmlSecMSCngAlgProvidersSize; ++ii) {
+        if(xmlSecMSCngAlgProviders[ii].hAlg == hAlg) {
+            shared = 1;
+            break;
+        }
+    }
+    xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+
+    if(shared == 0) {
+        BCryptCloseAlgorithmProvider(hAlg, 0);
+    }
+}
+
+static int
+xmlSecMSCngHashCreate(BCRYPT_ALG_HANDLE hAlg, DWORD cbHashObject, int* reusable,
+                      BCRYPT_HASH_HANDLE* phHash, PBYTE* ppbHashObject) {
+    NTSTATUS status;
+
+    (*ppbHashObject) = (PBYTE)xmlMalloc(cbHashObject);
+    if((*ppbHashObject) == NULL) {
+        xmlSecMallocError(cbHashObject, NULL);
+        return(-1);
+    }
+
+    status = STATUS_NOT_SUPPORTED;
+    if((*reusable) != 0) {
+        status = BCryptCreateHash(hAlg, phHash, (*ppbHashObject), cbHashObject,
+            NULL, 0, BCRYPT_HASH_REUSABLE_FLAG);
+        if(status == STATUS_INVALID_PARAMETER) {
+            /* before Windows 8 */
+            (*reusable) = 0;
+        }
+    }
+    if((*reusable) == 0) {
+        status = BCryptCreateHash(hAlg, phHash, (*ppbHashObject), cbHashObject,
+            NULL, 0, 0);
+    }
+    if(status != STATUS_SUCCESS) {
+        xmlSecMSCngNtError("BCryptCreateHash", NULL, status);
+        xmlFree(*ppbHashObject);
+        (*ppbHashObject) = NULL;
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecMSCngHashAcquire:
+ * @pszAlgId:           the digest algorithm id (one of the BCRYPT_*_ALGORITHM constants).
+ * @phHash:             the pointer to the result hash handle.
+ * @ppbHashObject:      the pointer to the result hash object buffer.
+ * @pcbHash:            the pointer to the result digest length.
+ *
+ * Gets a hash object for @pszAlgId in the initial state from the pool or
+ * creates a new one. The hash must be returned with #xmlSecMSCngHashRelease.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecMSCngHashAcquire(LPCWSTR pszAlgId, BCRYPT_HASH_HANDLE* phHash,
+                       PBYTE* ppbHashObject, DWORD* pcbHash) {
+    xmlSecMSCngAlgProviderEntryPtr entry;
+    BCRYPT_ALG_HANDLE hAlg = NULL;
+    DWORD cbHashObject = 0;
+    DWORD cbData = 0;
+    int reusable = 0;
+    NTSTATUS status;
+    int ret;
+
+    xmlSecAssert2(pszAlgId != NULL, -1);
+    xmlSecAssert2(phHash != NULL, -1);
+    xmlSecAssert2(ppbHashObject != NULL, -1);
+    xmlSecAssert2(pcbHash != NULL, -1);
+    xmlSecAssert2(xmlSecMSCngAlgProvidersMutex != NULL, -1);
+
+    xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+    entry = xmlSecMSCngAlgProviderGetEntry(pszAlgId, 0, &status);
+    if(entry == NULL) {
+        xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+        if(status != STATUS_SUCCESS) {
+            xmlSecMSCngNtError("BCryptOpenAlgorithmProvider", NULL, status);
+        } else {
+            xmlSecInvalidSizeMoreThanError("Algorithm providers",
+                xmlSecMSCngAlgProvidersSize, XMLSEC_MSCNG_ALG_PROVIDERS_SIZE, NULL);
+        }
+        return(-1);
+    }
+    if(entry->cbHash == 0) {
+        status = BCryptGetProperty(entry->hAlg, BCRYPT_OBJECT_LENGTH,
+            (PBYTE)&(entry->cbHashObject), sizeof(DWORD), &cbData, 0);
+        if(status == STATUS_SUCCESS) {
+            status = BCryptGetProperty(entry->hAlg, BCRYPT_HASH_LENGTH,
+                (PBYTE)&(entry->cbHash), sizeof(DWORD), &cbData, 0);
+        }
+        if(status != STATUS_SUCCESS) {
+            entry->cbHash = 0;
+            xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+            xmlSecMSCngNtError("BCryptGetProperty", NULL, status);
+            return(-1);
+        }
+    }
+    (*pcbHash) = entry->cbHash;
+    if(entry->hashesSize > 0) {
+        --entry->hashesSize;
+        (*phHash) = entry->hashes[entry->hashesSize].hHash;
+        (*ppbHashObject) = entry->hashes[entry->hashesSize].pbHashObject;
+        memset(&(entry->hashes[entry->hashesSize]), 0, sizeof(xmlSecMSCngHashItem));
+        xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+        return(0);
+    }
+    /* the shared handle and the sizes are never changed */
+    hAlg = entry->hAlg;
+    cbHashObject = entry->cbHashObject;
+    reusable = entry->reusable;
+    xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+
+    ret = xmlSecMSCngHashCreate(hAlg, cbHashObject, &reusable, phHash, ppbHashObject);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecMSCngHashCreate", NULL);
+        return(-1);
+    }
+    if(reusable == 0) {
+        xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+        entry->reusable = 0;
+        xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecMSCngHashRelease:
+ * @pszAlgId:           the digest algorithm id.
+ * @hHash:              the hash handle.
+ * @pbHashObject:       the hash object buffer.
+ * @finished:           the flag indicating that BCryptFinishHash() was
+ *                      successfully called for the hash.
+ *
+ * Returns the hash from #xmlSecMSCngHashAcquire to the pool if it is
+ * reusable and back in the initial state, otherwise destroys it.
+ */
+void
+xmlSecMSCngHashRelease(LPCWSTR pszAlgId, BCRYPT_HASH_HANDLE hHash,
+                       PBYTE pbHashObject, int finished) {
+    xmlSecMSCngAlgProviderEntryPtr entry;
+    int pooled = 0;
+
+    xmlSecAssert(pszAlgId != NULL);
+    xmlSecAssert(hHash != NULL);
+    xmlSecAssert(pbHashObject != NULL);
+    xmlSecAssert(xmlSecMSCngAlgProvidersMutex != NULL);
+
+    if(finished != 0) {
+        xmlMutexLock(xmlSecMSCngAlgProvidersMutex);
+        entry = xmlSecMSCngAlgProviderFind(pszAlgId, 0);
+        if((entry != NULL) && (entry->reusable != 0) && (entry->hashesSize < XMLSEC_MSCNG_HASH_POOL_SIZE)) {
+            entry->hashes[entry->hashesSize].hHash = hHash;
+            entry->hashes[entry->hashesSize].pbHashObject = pbHashObject;
+            ++entry->hashesSize;
+            pooled = 1;
+        }
+        xmlMutexUnlock(xmlSecMSCngAlgProvidersMutex);
+    }
+
+    if(pooled == 0) {
+        BCryptDestroyHash(hHash);
+        xmlFree(pbHashObject);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * XML Security Library
+ *
+ * THIS IS A PRIVATE XMLSEC HEADER FILE
+ * DON'T USE IT IN YOUR APPLICATION
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2018 Miklos Vajna <vmiklos@vmiklos.hu>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_MSCNG_ALGPROV_H__
+#define __XMLSEC_MSCNG_ALGPROV_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "mscng/algprov.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <bcrypt.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**************************************************************************
+ *
+ * Shared BCRYPT algorithm providers and reusable hash objects
+ *
+ *****************************************************************************/
+int                     xmlSecMSCngAlgProviderInitialize        (void);
+void                    xmlSecMSCngAlgProviderShutdown          (void);
+
+NTSTATUS                xmlSecMSCngAlgProviderOpen              (BCRYPT_ALG_HANDLE* phAlg,
+                                                                 LPCWSTR pszAlgId,
+                                                                 ULONG dwFlags);
+void                    xmlSecMSCngAlgProviderClose             (BCRYPT_ALG_HANDLE hAlg);
+
+int                     xmlSecMSCngHashAcquire                  (LPCWSTR pszAlgId,
+                                                                 BCRYPT_HASH_HANDLE* phHash,
+                                                                 PBYTE* ppbHashObject,
+                                                                 DWORD* pcbHash);
+void                    xmlSecMSCngHashRelease                  (LPCWSTR pszAlgId,
+                                                                 BCRYPT_HASH_HANDLE hHash,
+                                                                 PBYTE pbHashObject,
+                                                                 int finished);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_MSCNG_ALGPROV_H__ */
@@ -27,12 +27,28 @@
 
 #include <xmlsec/mscng/crypto.h>
 
+#include "algprov.h"
+
 typedef struct _xmlSecMSCngKeyDataCtx xmlSecMSCngKeyDataCtx,
                                       *xmlSecMSCngKeyDataCtxPtr;
 
+/*
+ * CryptAcquireCertificatePrivateKey() is an IPC round-trip to LSASS (or
+ * to the smartcard) for the CNG KSP keys: the private key handle is
+ * acquired once and shared by the key data duplicates.
+ */
+typedef struct _xmlSecMSCngPrivKey xmlSecMSCngPrivKey,
+                                   *xmlSecMSCngPrivKeyPtr;
+
+struct _xmlSecMSCngPrivKey {
+    NCRYPT_KEY_HANDLE hKey;
+    BOOL fCallerFree;
+    volatile LONG refcnt;
+};
+
 struct _xmlSecMSCngKeyDataCtx {
     PCCERT_CONTEXT cert;
-    NCRYPT_KEY_HANDLE privkey;
+    xmlSecMSCngPrivKeyPtr privkey;
     BCRYPT_KEY_HANDLE pubkey;
 };
 
@@ -59,30 +75,61 @@ xmlSecMSCngKeyDataCertGetPubkey(PCCERT_CONTEXT cert, BCRYPT_KEY_HANDLE* key) {
 }
 
 static int
-xmlSecMSCngKeyDataCertGetPrivkey(PCCERT_CONTEXT cert, NCRYPT_KEY_HANDLE* key) {
+xmlSecMSCngKeyDataCertGetPrivkey(PCCERT_CONTEXT cert, xmlSecMSCngPrivKeyPtr* key) {
+    xmlSecMSCngPrivKeyPtr privkey;
     int ret;
 
     xmlSecAssert2(cert != NULL, -1);
     xmlSecAssert2(key != NULL, -1);
 
     DWORD keySpec = 0;
-    BOOL callerFree = FALSE;
+
+    privkey = (xmlSecMSCngPrivKeyPtr)xmlMalloc(sizeof(xmlSecMSCngPrivKey));
+    if(privkey == NULL) {
+        xmlSecMallocError(sizeof(xmlSecMSCngPrivKey), NULL);
+        return(-1);
+    }
+    memset(privkey, 0, sizeof(xmlSecMSCngPrivKey));
 
     ret = CryptAcquireCertificatePrivateKey(
         cert,
         CRYPT_ACQUIRE_COMPARE_KEY_FLAG | CRYPT_ACQUIRE_ONLY_NCRYPT_KEY_FLAG,
         NULL,
-        key,
+        &(privkey->hKey),
         &keySpec,
-        &callerFree);
+        &(privkey->fCallerFree));
     if(ret == FALSE) {
         xmlSecMSCngLastError("CryptAcquireCertificatePrivateKey", NULL);
+        xmlFree(privkey);
         return(-1);
     }
 
+    privkey->refcnt = 1;
+    (*key) = privkey;
     return(0);
 }
 
+static void
+xmlSecMSCngKeyDataPrivkeyRelease(xmlSecMSCngPrivKeyPtr privkey) {
+    SECURITY_STATUS status;
+
+    xmlSecAssert(privkey != NULL);
+
+    if(InterlockedDecrement(&(privkey->refcnt)) > 0) {
+        return;
+    }
+
+    /* the handle cached with the certificate context is not ours */
+    if((privkey->hKey != 0) && (privkey->fCallerFree != FALSE)) {
+        status = NCryptFreeObject(privkey->hKey);
+        if(status != ERROR_SUCCESS) {
+            xmlSecMSCngNtError("NCryptFreeObject", NULL, status);
+        }
+    }
+    memset(privkey, 0, sizeof(xmlSecMSCngPrivKey));
+    xmlFree(privkey);
+}
+
 /**
  * xmlSecMSCngKeyDataAdoptCert:
  * @data:               the pointer to MSCng pccert data.
@@ -111,7 +158,7 @@ xmlSecMSCngKeyDataAdoptCert(xmlSecKeyDataPtr data, PCCERT_CONTEXT cert, xmlSecKe
 
     /* acquire the CNG key handle from the certificate */
     if((type & xmlSecKeyDataTypePrivate) != 0) {
-        NCRYPT_KEY_HANDLE hPrivKey;
+        xmlSecMSCngPrivKeyPtr hPrivKey = NULL;
 
         ret = xmlSecMSCngKeyDataCertGetPrivkey(cert, &hPrivKey);
         if(ret < 0) {
@@ -258,7 +305,10 @@ xmlSecMSCngKeyDataGetPrivKey(xmlSecKeyDataPtr data) {
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, 0);
 
-    return(ctx->privkey);
+    if(ctx->privkey == NULL) {
+        return(0);
+    }
+    return(ctx->privkey->hKey);
 }
 
 static int
@@ -287,11 +337,8 @@ xmlSecMSCngKeyDataFinalize(xmlSecKeyDataPtr data) {
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->privkey != 0) {
-        status = NCryptFreeObject(ctx->privkey);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptDestroyKey", NULL, status);
-        }
+    if(ctx->privkey != NULL) {
+        xmlSecMSCngKeyDataPrivkeyRelease(ctx->privkey);
     }
 
     if(ctx->pubkey != 0) {
@@ -327,7 +374,7 @@ xmlSecMSCngKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
     dstCtx = xmlSecMSCngKeyDataGetCtx(dst);
     xmlSecAssert2(dstCtx != NULL, -1);
     xmlSecAssert2(dstCtx->cert == NULL, -1);
-    xmlSecAssert2(dstCtx->privkey == 0, -1);
+    xmlSecAssert2(dstCtx->privkey == NULL, -1);
     xmlSecAssert2(dstCtx->pubkey == NULL, -1);
 
     srcCtx = xmlSecMSCngKeyDataGetCtx(src);
@@ -341,12 +388,9 @@ xmlSecMSCngKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
         }
     }
 
-    if(srcCtx->privkey != 0) {
-        ret = xmlSecMSCngKeyDataCertGetPrivkey(dstCtx->cert, &dstCtx->privkey);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecMSCngKeyDataCertGetPrivkey", NULL);
-            return(-1);
-        }
+    if(srcCtx->privkey != NULL) {
+        dstCtx->privkey = srcCtx->privkey;
+        InterlockedIncrement(&(dstCtx->privkey->refcnt));
     }
 
     if(dstCtx->cert != NULL) {
@@ -407,10 +451,9 @@ xmlSecMSCngKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
                 return(-1);
         }
 
-        status = BCryptOpenAlgorithmProvider(
+        status = xmlSecMSCngAlgProviderOpen(
             &hAlg,
             pszAlgId,
-            NULL,
             0);
         if(status != STATUS_SUCCESS) {
             xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -425,12 +468,12 @@ xmlSecMSCngKeyDataDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
             xmlSecMSCngNtError("BCryptImportKeyPair",
                 NULL, status);
             xmlFree(pbBlob);
-            BCryptCloseAlgorithmProvider(hAlg, 0);
+            xmlSecMSCngAlgProviderClose(hAlg);
             return(-1);
         }
 
         xmlFree(pbBlob);
-        BCryptCloseAlgorithmProvider(hAlg, 0);
+        xmlSecMSCngAlgProviderClose(hAlg);
     }
 
     return(0);
@@ -454,7 +497,7 @@ xmlSecMSCngKeyDataDsaGetType(xmlSecKeyDataPtr data) {
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, xmlSecKeyDataTypeUnknown);
 
-    if(ctx->privkey != 0) {
+    if(ctx->privkey != NULL) {
         return(xmlSecKeyDataTypePrivate | xmlSecKeyDataTypePublic);
     }
 
@@ -690,10 +733,9 @@ xmlSecMSCngKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     lpszBlobType = BCRYPT_DSA_PUBLIC_BLOB;
     dsakey->dwMagic = BCRYPT_DSA_PUBLIC_MAGIC;
 
-    status = BCryptOpenAlgorithmProvider(
+    status = xmlSecMSCngAlgProviderOpen(
         &hAlg,
         BCRYPT_DSA_ALGORITHM,
-        NULL,
         0);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -742,7 +784,7 @@ done:
     xmlSecBufferFinalize(&blob);
 
     if(hAlg != 0) {
-        BCryptCloseAlgorithmProvider(hAlg, 0);
+        xmlSecMSCngAlgProviderClose(hAlg);
     }
 
     if(hKey != 0) {
@@ -930,10 +972,9 @@ xmlSecMSCngKeyDataDsaGenerate(xmlSecKeyDataPtr data, xmlSecSize sizeBits,
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, -1);
 
-    status = BCryptOpenAlgorithmProvider(
+    status = xmlSecMSCngAlgProviderOpen(
         &hAlg,
         BCRYPT_DSA_ALGORITHM,
-        NULL,
         0);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -977,7 +1018,7 @@ done:
     }
 
     if (hAlg != 0) {
-        BCryptCloseAlgorithmProvider(hAlg, 0);
+        xmlSecMSCngAlgProviderClose(hAlg);
     }
 
     return(res);
@@ -1052,7 +1093,7 @@ xmlSecMSCngKeyDataRsaGetType(xmlSecKeyDataPtr data) {
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, xmlSecKeyDataTypeUnknown);
 
-    if(ctx->privkey != 0) {
+    if(ctx->privkey != NULL) {
         return(xmlSecKeyDataTypePrivate | xmlSecKeyDataTypePublic);
     }
 
@@ -1090,7 +1131,7 @@ xmlSecMSCngKeyDataGetSize(xmlSecKeyDataPtr data) {
         }
 
         return(length);
-    } else if(ctx->privkey != 0) {
+    } else if(ctx->privkey != NULL) {
         xmlSecNotImplementedError(NULL);
         return(0);
     }
@@ -1249,10 +1290,9 @@ xmlSecMSCngKeyDataRsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
 
     lpszBlobType = BCRYPT_RSAPUBLIC_BLOB;
 
-    status = BCryptOpenAlgorithmProvider(
+    status = xmlSecMSCngAlgProviderOpen(
         &hAlg,
         BCRYPT_RSA_ALGORITHM,
-        NULL,
         0);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -1303,7 +1343,7 @@ done:
     }
 
     if(hAlg != 0) {
-        BCryptCloseAlgorithmProvider(hAlg, 0);
+        xmlSecMSCngAlgProviderClose(hAlg);
     }
 
     return(res);
@@ -1434,10 +1474,9 @@ xmlSecMSCngKeyDataRsaGenerate(xmlSecKeyDataPtr data, xmlSecSize sizeBits,
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, -1);
 
-    status = BCryptOpenAlgorithmProvider(
+    status = xmlSecMSCngAlgProviderOpen(
         &hAlg,
         BCRYPT_RSA_ALGORITHM,
-        NULL,
         0);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -1481,7 +1520,7 @@ done:
     }
 
     if (hAlg != 0) {
-        BCryptCloseAlgorithmProvider(hAlg, 0);
+        xmlSecMSCngAlgProviderClose(hAlg);
     }
 
     return(res);
@@ -1556,7 +1595,7 @@ xmlSecMSCngKeyDataEcdsaGetType(xmlSecKeyDataPtr data) {
     ctx = xmlSecMSCngKeyDataGetCtx(data);
     xmlSecAssert2(ctx != NULL, xmlSecKeyDataTypeUnknown);
 
-    if(ctx->privkey != 0) {
+    if(ctx->privkey != NULL) {
         return(xmlSecKeyDataTypePrivate | xmlSecKeyDataTypePublic);
     }
 
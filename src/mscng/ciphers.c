@@ -23,10 +23,13 @@
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 #include <xmlsec/bn.h>
 
 #include <xmlsec/mscng/crypto.h>
 
+#include "algprov.h"
+
 /**************************************************************************
  *
  * Internal MSCng Block cipher CTX
@@ -116,10 +119,9 @@ xmlSecMSCngBlockCipherInitialize(xmlSecTransformPtr transform) {
         return(-1);
     }
 
-    status = BCryptOpenAlgorithmProvider(
+    status = xmlSecMSCngAlgProviderOpen(
         &ctx->hAlg,
         ctx->pszAlgId,
-        NULL,
         0);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
@@ -155,7 +157,7 @@ xmlSecMSCngBlockCipherFinalize(xmlSecTransformPtr transform) {
     }
 
     if(ctx->hAlg != NULL) {
-        BCryptCloseAlgorithmProvider(ctx->hAlg, 0);
+        xmlSecMSCngAlgProviderClose(ctx->hAlg);
     }
 
     memset(ctx, 0, sizeof(xmlSecMSCngBlockCipherCtx));
@@ -323,12 +325,10 @@ xmlSecMSCngBlockCipherCtxInit(xmlSecMSCngBlockCipherCtxPtr ctx,
         iv = xmlSecBufferGetData(out) + outSize;
 
         /* generate and use random iv */
-        status = BCryptGenRandom(NULL,
-            (PBYTE)iv,
-            dwBlockLen,
-            BCRYPT_USE_SYSTEM_PREFERRED_RNG);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptGetProperty", cipherName, status);
+        ret = xmlSecRandomGenerate(xmlSecMSCngGenerateRandomBytes, NULL,
+            iv, dwBlockLen);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecRandomGenerate", cipherName);
             return(-1);
         }
 
@@ -544,12 +544,10 @@ xmlSecMSCngBlockCipherCtxFinal(xmlSecMSCngBlockCipherCtxPtr ctx,
 
         /* create random padding */
         if((size_t)dwBlockLen > (inSize + 1)) {
-            status = BCryptGenRandom(NULL,
-                (PBYTE) inBuf + inSize,
-                dwBlockLen - inSize - 1,
-                BCRYPT_USE_SYSTEM_PREFERRED_RNG);
-            if(status != STATUS_SUCCESS) {
-                xmlSecMSCngNtError("BCryptGetProperty", cipherName, status);
+            ret = xmlSecRandomGenerate(xmlSecMSCngGenerateRandomBytes, NULL,
+                inBuf + inSize, dwBlockLen - inSize - 1);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecRandomGenerate", cipherName);
                 return(-1);
             }
         }
@@ -21,11 +21,14 @@
 #include <xmlsec/errors.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/private.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/mscng/app.h>
 #include <xmlsec/mscng/crypto.h>
 #include <xmlsec/mscng/x509.h>
 
+#include "algprov.h"
+
 static xmlSecCryptoDLFunctionsPtr gXmlSecMSCngFunctions = NULL;
 
 /**
@@ -311,9 +314,12 @@ xmlSecMSCngInit (void)  {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
         return(-1);
     }
-    return(0);
 
-    /* TODO: if necessary do, additional initialization here */
+    if(xmlSecMSCngAlgProviderInitialize() < 0) {
+        xmlSecInternalError("xmlSecMSCngAlgProviderInitialize", NULL);
+        return(-1);
+    }
+    return(0);
 }
 
 /**
@@ -325,7 +331,7 @@ xmlSecMSCngInit (void)  {
  */
 int
 xmlSecMSCngShutdown(void) {
-    /* TODO: if necessary, do additional shutdown here */
+    xmlSecMSCngAlgProviderShutdown();
     return(0);
 }
 
@@ -335,13 +341,12 @@ xmlSecMSCngShutdown(void) {
  * @size:               the numer of bytes to generate.
  *
  * Generates @size random bytes and puts result in @buffer
- * (not implemented yet).
+ * (see #xmlSecRandomGenerate).
  *
  * Returns: 0 on success or a negative value otherwise.
  */
 int
 xmlSecMSCngGenerateRandom(xmlSecBufferPtr buffer, size_t size) {
-    NTSTATUS status;
     int ret;
 
     xmlSecAssert2(buffer != NULL, -1);
@@ -353,10 +358,36 @@ xmlSecMSCngGenerateRandom(xmlSecBufferPtr buffer, size_t size) {
         return(-1);
     }
 
+    ret = xmlSecRandomGenerate(xmlSecMSCngGenerateRandomBytes, NULL,
+        xmlSecBufferGetData(buffer), size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL, "size=%d", size);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * xmlSecMSCngGenerateRandomBytes:
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ * @context:            not used.
+ *
+ * The MSCng random generator for #xmlSecRandomGenerate.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecMSCngGenerateRandomBytes(xmlSecByte* out, xmlSecSize outSize, void* context ATTRIBUTE_UNUSED) {
+    NTSTATUS status;
+
+    xmlSecAssert2(out != NULL, -1);
+
     status = BCryptGenRandom(
         NULL,
-        (PBYTE)xmlSecBufferGetData(buffer),
-        size,
+        (PBYTE)out,
+        outSize,
         BCRYPT_USE_SYSTEM_PREFERRED_RNG);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptGenRandom", NULL, status);
@@ -24,12 +24,13 @@
 
 #include <xmlsec/mscng/crypto.h>
 
+#include "algprov.h"
+
 typedef struct _xmlSecMSCngDigestCtx xmlSecMSCngDigestCtx, *xmlSecMSCngDigestCtxPtr;
 struct _xmlSecMSCngDigestCtx {
     LPCWSTR pszAlgId;
     DWORD cbHash;
     PBYTE pbHash;
-    BCRYPT_ALG_HANDLE hAlg;
     PBYTE pbHashObject;
     BCRYPT_HASH_HANDLE hHash;
 };
@@ -151,16 +152,9 @@ static void xmlSecMSCngDigestFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecMSCngDigestGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->hAlg != 0) {
-        BCryptCloseAlgorithmProvider(ctx->hAlg, 0);
-    }
-
     if(ctx->hHash != 0) {
-        BCryptDestroyHash(ctx->hHash);
-    }
-
-    if(ctx->pbHashObject != NULL) {
-        xmlFree(ctx->pbHashObject);
+        /* not finished: can't be reused */
+        xmlSecMSCngHashRelease(ctx->pszAlgId, ctx->hHash, ctx->pbHashObject, 0);
     }
 
     if(ctx->pbHash != NULL) {
@@ -214,8 +208,6 @@ xmlSecMSCngDigestExecute(xmlSecTransformPtr transform,
     xmlSecBufferPtr in, out;
     NTSTATUS status;
     int ret;
-    DWORD cbData = 0;
-    DWORD cbHashObject = 0;
 
     xmlSecAssert2(xmlSecMSCngDigestCheckId(transform), -1);
     xmlSecAssert2((transform->operation == xmlSecTransformOperationSign) || (transform->operation == xmlSecTransformOperationVerify), -1);
@@ -232,47 +224,11 @@ xmlSecMSCngDigestExecute(xmlSecTransformPtr transform,
     xmlSecAssert2(ctx != NULL, -1);
 
     if(transform->status == xmlSecTransformStatusNone) {
-        /* open an algorithm handle */
-        status = BCryptOpenAlgorithmProvider(
-            &ctx->hAlg,
-            ctx->pszAlgId,
-            NULL,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptOpenAlgorithmProvider", xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
-        /* calculate the size of the buffer to hold the hash object */
-        status = BCryptGetProperty(
-            ctx->hAlg,
-            BCRYPT_OBJECT_LENGTH,
-            (PBYTE)&cbHashObject,
-            sizeof(DWORD),
-            &cbData,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptGetProperty", xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
-        /* allocate the hash object on the heap */
-        ctx->pbHashObject = (PBYTE)xmlMalloc(cbHashObject);
-        if(ctx->pbHashObject == NULL) {
-            xmlSecMallocError(cbHashObject, NULL);
-            return(-1);
-        }
-
-        /* calculate the length of the hash */
-        status = BCryptGetProperty(
-            ctx->hAlg,
-            BCRYPT_HASH_LENGTH,
-            (PBYTE)&ctx->cbHash,
-            sizeof(DWORD),
-            &cbData,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptGetProperty", xmlSecTransformGetName(transform), status);
+        /* get a hash in the initial state */
+        ret = xmlSecMSCngHashAcquire(ctx->pszAlgId, &ctx->hHash,
+            &ctx->pbHashObject, &ctx->cbHash);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecMSCngHashAcquire", xmlSecTransformGetName(transform));
             return(-1);
         }
 
@@ -283,20 +239,6 @@ xmlSecMSCngDigestExecute(xmlSecTransformPtr transform,
             return(-1);
         }
 
-        /* create the hash */
-        status = BCryptCreateHash(
-            ctx->hAlg,
-            &ctx->hHash,
-            ctx->pbHashObject,
-            cbHashObject,
-            NULL,
-            0,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptCreateHash", xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
         transform->status = xmlSecTransformStatusWorking;
     }
 
@@ -336,6 +278,11 @@ xmlSecMSCngDigestExecute(xmlSecTransformPtr transform,
                 return(-1);
             }
 
+            /* the hash is back in the initial state */
+            xmlSecMSCngHashRelease(ctx->pszAlgId, ctx->hHash, ctx->pbHashObject, 1);
+            ctx->hHash = 0;
+            ctx->pbHashObject = NULL;
+
             xmlSecAssert2(ctx->cbHash > 0, -1);
 
             /* copy result to output */
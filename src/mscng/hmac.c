@@ -28,6 +28,8 @@
 
 #include <xmlsec/mscng/crypto.h>
 
+#include "algprov.h"
+
 typedef struct _xmlSecMSCngHmacCtx xmlSecMSCngHmacCtx, *xmlSecMSCngHmacCtxPtr;
 
 struct _xmlSecMSCngHmacCtx {
@@ -155,7 +157,7 @@ xmlSecMSCngHmacFinalize(xmlSecTransformPtr transform) {
     }
 
     if(ctx->hAlg != NULL) {
-        BCryptCloseAlgorithmProvider(ctx->hAlg, 0);
+        xmlSecMSCngAlgProviderClose(ctx->hAlg);
     }
 
     memset(ctx, 0, sizeof(xmlSecMSCngHmacCtx));
@@ -254,9 +256,8 @@ xmlSecMSCngHmacSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
     /* at this point we know what should be they key, go ahead with the CNG
      * calls */
 
-    status = BCryptOpenAlgorithmProvider(&ctx->hAlg,
+    status = xmlSecMSCngAlgProviderOpen(&ctx->hAlg,
         ctx->pszAlgId,
-        NULL,
         BCRYPT_ALG_HANDLE_HMAC_FLAG);
     if(status != STATUS_SUCCESS) {
         xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
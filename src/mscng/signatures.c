@@ -24,6 +24,8 @@
 #include <xmlsec/mscng/crypto.h>
 #include <xmlsec/mscng/certkeys.h>
 
+#include "algprov.h"
+
 /**************************************************************************
  *
  * Internal MSCng signatures ctx
@@ -37,7 +39,6 @@ struct _xmlSecMSCngSignatureCtx {
     LPCWSTR pszHashAlgId;
     DWORD cbHash;
     PBYTE pbHash;
-    BCRYPT_ALG_HANDLE hHashAlg;
     PBYTE pbHashObject;
     BCRYPT_HASH_HANDLE hHash;
 };
@@ -254,16 +255,9 @@ static void xmlSecMSCngSignatureFinalize(xmlSecTransformPtr transform) {
         xmlFree(ctx->pbHash);
     }
 
-    if(ctx->hHashAlg != 0) {
-        BCryptCloseAlgorithmProvider(ctx->hHashAlg, 0);
-    }
-
-    if(ctx->pbHashObject != NULL) {
-        xmlFree(ctx->pbHashObject);
-    }
-
     if(ctx->hHash != 0) {
-        BCryptDestroyHash(ctx->hHash);
+        /* not finished: can't be reused */
+        xmlSecMSCngHashRelease(ctx->pszHashAlgId, ctx->hHash, ctx->pbHashObject, 0);
     }
 
     memset(ctx, 0, sizeof(xmlSecMSCngSignatureCtx));
@@ -389,8 +383,6 @@ xmlSecMSCngSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTransf
     xmlSecSize inSize;
     xmlSecSize outSize;
     NTSTATUS status;
-    DWORD cbData = 0;
-    DWORD cbHashObject = 0;
     BCRYPT_PKCS1_PADDING_INFO info;
     BCRYPT_PKCS1_PADDING_INFO* pInfo = NULL;
     DWORD infoFlags = 0;
@@ -411,50 +403,12 @@ xmlSecMSCngSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTransf
     if(transform->status == xmlSecTransformStatusNone) {
         xmlSecAssert2(outSize == 0, -1);
 
-        /* open an algorithm handle */
-        status = BCryptOpenAlgorithmProvider(
-            &ctx->hHashAlg,
-            ctx->pszHashAlgId,
-            NULL,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptOpenAlgorithmProvider",
-                xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
-        /* calculate the size of the buffer to hold the hash object */
-        status = BCryptGetProperty(
-            ctx->hHashAlg,
-            BCRYPT_OBJECT_LENGTH,
-            (PBYTE)&cbHashObject,
-            sizeof(DWORD),
-            &cbData,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptGetProperty",
-                xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
-        /* allocate the hash object on the heap */
-        ctx->pbHashObject = (PBYTE)xmlMalloc(cbHashObject);
-        if(ctx->pbHashObject == NULL) {
-            xmlSecMallocError(cbHashObject, NULL);
-            return(-1);
-        }
-
-        /* calculate the length of the hash */
-        status = BCryptGetProperty(
-            ctx->hHashAlg,
-            BCRYPT_HASH_LENGTH,
-            (PBYTE)&ctx->cbHash,
-            sizeof(DWORD),
-            &cbData,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptGetProperty",
-                xmlSecTransformGetName(transform), status);
+        /* get a hash in the initial state */
+        ret = xmlSecMSCngHashAcquire(ctx->pszHashAlgId, &ctx->hHash,
+            &ctx->pbHashObject, &ctx->cbHash);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecMSCngHashAcquire",
+                xmlSecTransformGetName(transform));
             return(-1);
         }
 
@@ -465,21 +419,6 @@ xmlSecMSCngSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTransf
             return(-1);
         }
 
-        /* create the hash */
-        status = BCryptCreateHash(
-            ctx->hHashAlg,
-            &ctx->hHash,
-            ctx->pbHashObject,
-            cbHashObject,
-            NULL,
-            0,
-            0);
-        if(status != STATUS_SUCCESS) {
-            xmlSecMSCngNtError("BCryptCreateHash",
-                xmlSecTransformGetName(transform), status);
-            return(-1);
-        }
-
         transform->status = xmlSecTransformStatusWorking;
     }
 
@@ -519,6 +458,11 @@ xmlSecMSCngSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTransf
                 return(-1);
             }
 
+            /* the hash is back in the initial state */
+            xmlSecMSCngHashRelease(ctx->pszHashAlgId, ctx->hHash, ctx->pbHashObject, 1);
+            ctx->hHash = 0;
+            ctx->pbHashObject = NULL;
+
             xmlSecAssert2(ctx->cbHash > 0, -1);
 
             if(transform->operation == xmlSecTransformOperationSign) {
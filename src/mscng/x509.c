@@ -734,6 +734,7 @@ xmlSecMSCngKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data,
     xmlSecMSCngX509DataCtxPtr ctx;
     xmlSecKeyDataStorePtr store;
     PCCERT_CONTEXT cert;
+    void* span;
 
     xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecMSCngKeyDataX509Id), -1);
     xmlSecAssert2(key != NULL, -1);
@@ -759,7 +760,9 @@ xmlSecMSCngKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data,
         return(-1);
     }
 
+    span = xmlSecTraceBegin(xmlSecTracePhaseX509Verify, NULL, keyInfoCtx->userData);
     cert = xmlSecMSCngX509StoreVerify(store, ctx->hMemStore, keyInfoCtx);
+    xmlSecTraceEnd(span, xmlSecTracePhaseX509Verify, (cert != NULL) ? 0 : -1);
     if(cert != NULL) {
         int ret;
         PCCERT_CONTEXT certCopy;
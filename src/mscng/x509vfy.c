@@ -13,7 +13,13 @@
 
 #include <string.h>
 
+#define WIN32_NO_STATUS
 #include <windows.h>
+#undef WIN32_NO_STATUS
+#include <ntstatus.h>
+#include <bcrypt.h>
+
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -27,6 +33,42 @@
 #include <xmlsec/mscng/crypto.h>
 #include <xmlsec/mscng/x509.h>
 
+#include "algprov.h"
+
+/**
+ * XMLSEC_MSCNG_X509_VERIFY_CACHE_SIZE:
+ *
+ * The max number of successful certificate verification results
+ * remembered by the MSCng X509 store.
+ */
+#define XMLSEC_MSCNG_X509_VERIFY_CACHE_SIZE                     64
+
+/**
+ * XMLSEC_MSCNG_X509_VERIFY_CACHE_TTL:
+ *
+ * The max time (in seconds) a successful certificate verification result
+ * is reused, so the revocation status is re-checked at least that often.
+ */
+#define XMLSEC_MSCNG_X509_VERIFY_CACHE_TTL                      60
+
+#define XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE                  32
+
+/*
+ * The verified certificates cache entry: the SHA-256 of the signer certificate
+ * DER, the SHA-256 over the DERs of all the certificates in the document and
+ * the expiration time (the earliest of the certificate NotAfter and the cache
+ * TTL). The cache is flushed every time the store changes.
+ */
+typedef struct _xmlSecMSCngX509VerifyCacheEntry         xmlSecMSCngX509VerifyCacheEntry,
+                                                        *xmlSecMSCngX509VerifyCacheEntryPtr;
+struct _xmlSecMSCngX509VerifyCacheEntry {
+    BYTE                                certMd[XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE];
+    BYTE                                certsMd[XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE];
+    ULONGLONG                           expires;
+    xmlSecMSCngX509VerifyCacheEntryPtr  prev;
+    xmlSecMSCngX509VerifyCacheEntryPtr  next;
+};
+
 typedef struct _xmlSecMSCngX509StoreCtx xmlSecMSCngX509StoreCtx,
                                        *xmlSecMSCngX509StoreCtxPtr;
 struct _xmlSecMSCngX509StoreCtx {
@@ -34,6 +76,15 @@ struct _xmlSecMSCngX509StoreCtx {
     HCERTSTORE trustedMemStore;
     HCERTSTORE untrusted;
     HCERTSTORE untrustedMemStore;
+
+    /* chain engine that knows about the untrusted certificates */
+    HCERTCHAINENGINE chainEngine;
+
+    /* verified certificates cache */
+    xmlSecMSCngX509VerifyCacheEntryPtr cacheHead;
+    xmlSecMSCngX509VerifyCacheEntryPtr cacheTail;
+    xmlSecSize cacheSize;
+    xmlMutexPtr cacheMutex;
 };
 
 #define xmlSecMSCngX509StoreGetCtx(store) \
@@ -42,6 +93,8 @@ struct _xmlSecMSCngX509StoreCtx {
 #define xmlSecMSCngX509StoreSize \
     (sizeof(xmlSecKeyDataStoreKlass) + sizeof(xmlSecMSCngX509StoreCtx))
 
+static void             xmlSecMSCngX509VerifyCacheFlush (xmlSecMSCngX509StoreCtxPtr ctx);
+
 static void
 xmlSecMSCngX509StoreFinalize(xmlSecKeyDataStorePtr store) {
     xmlSecMSCngX509StoreCtxPtr ctx;
@@ -51,6 +104,15 @@ xmlSecMSCngX509StoreFinalize(xmlSecKeyDataStorePtr store) {
     ctx = xmlSecMSCngX509StoreGetCtx(store);
     xmlSecAssert(ctx != NULL);
 
+    xmlSecMSCngX509VerifyCacheFlush(ctx);
+    if(ctx->cacheMutex != NULL) {
+        xmlFreeMutex(ctx->cacheMutex);
+    }
+
+    if(ctx->chainEngine != NULL) {
+        CertFreeCertificateChainEngine(ctx->chainEngine);
+    }
+
     if(ctx->trusted != NULL) {
         ret = CertCloseStore(ctx->trusted, CERT_CLOSE_STORE_CHECK_FLAG);
         if(ret == FALSE) {
@@ -84,6 +146,7 @@ xmlSecMSCngX509StoreFinalize(xmlSecKeyDataStorePtr store) {
 
 static int
 xmlSecMSCngX509StoreInitialize(xmlSecKeyDataStorePtr store) {
+    CERT_CHAIN_ENGINE_CONFIG engineConfig;
     int ret;
     xmlSecMSCngX509StoreCtxPtr ctx;
 
@@ -168,6 +231,27 @@ xmlSecMSCngX509StoreInitialize(xmlSecKeyDataStorePtr store) {
         return(-1);
     }
 
+    /* create a chain engine that searches the untrusted certificates too
+     * and caches the end certificates between the verifications */
+    memset(&engineConfig, 0, sizeof(engineConfig));
+    engineConfig.cbSize = sizeof(engineConfig);
+    engineConfig.cAdditionalStore = 1;
+    engineConfig.rghAdditionalStore = &(ctx->untrusted);
+    engineConfig.dwFlags = CERT_CHAIN_CACHE_END_CERT;
+    ret = CertCreateCertificateChainEngine(&engineConfig, &(ctx->chainEngine));
+    if(ret == FALSE) {
+        xmlSecMSCngLastError("CertCreateCertificateChainEngine", xmlSecKeyDataStoreGetName(store));
+        xmlSecMSCngX509StoreFinalize(store);
+        return(-1);
+    }
+
+    ctx->cacheMutex = xmlNewMutex();
+    if(ctx->cacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", xmlSecKeyDataStoreGetName(store));
+        xmlSecMSCngX509StoreFinalize(store);
+        return(-1);
+    }
+
     return(0);
 }
 
@@ -242,6 +326,16 @@ xmlSecMSCngX509StoreAdoptCert(xmlSecKeyDataStorePtr store, PCCERT_CONTEXT pCert,
         return(-1);
     }
 
+    /* the store changed: forget the previous verification results */
+    xmlSecMSCngX509VerifyCacheFlush(ctx);
+    if(ctx->chainEngine != NULL) {
+        ret = CertResyncCertificateChainEngine(ctx->chainEngine);
+        if(ret == FALSE) {
+            xmlSecMSCngLastError("CertResyncCertificateChainEngine", xmlSecKeyDataStoreGetName(store));
+            return(-1);
+        }
+    }
+
     return(0);
 }
 
@@ -462,7 +556,7 @@ xmlSecMSCngX509StoreVerifyCertificateOwn(PCCERT_CONTEXT cert,
  * xmlSecMSCngX509StoreVerifyCertificateSystem:
  * @cert: the certificate we check
  * @time: pointer to FILETIME that we are interested in
- * @untrustedStore: untrusted certificates added via API
+ * @chainEngine: the chain engine with the untrusted certificates added via API
  * @docStore: untrusted certificates/CRLs extracted from a document
  *
  * Verifies @cert based on system trusted certificates.
@@ -471,10 +565,9 @@ xmlSecMSCngX509StoreVerifyCertificateOwn(PCCERT_CONTEXT cert,
  */
 static int
 xmlSecMSCngX509StoreVerifyCertificateSystem(PCCERT_CONTEXT cert,
-        FILETIME* time, HCERTSTORE untrustedStore, HCERTSTORE docStore) {
+        FILETIME* time, HCERTCHAINENGINE chainEngine, HCERTSTORE docStore) {
     PCCERT_CHAIN_CONTEXT pChainContext = NULL;
     CERT_CHAIN_PARA chainPara;
-    HCERTSTORE chainStore = NULL;
     int res = -1;
     int ret;
 
@@ -482,28 +575,9 @@ xmlSecMSCngX509StoreVerifyCertificateSystem(PCCERT_CONTEXT cert,
     memset(&chainPara, 0, sizeof(CERT_CHAIN_PARA));
     chainPara.cbSize = sizeof(CERT_CHAIN_PARA);
 
-    /* create additional store for CertGetCertificateChain() */
-    chainStore = CertOpenStore(CERT_STORE_PROV_COLLECTION, 0, 0, 0, NULL);
-    if(chainStore == NULL) {
-        xmlSecMSCngLastError("CertOpenStore", NULL);
-        goto end;
-    }
-
-    ret = CertAddStoreToCollection(chainStore, docStore, 0, 0);
-    if(ret == FALSE) {
-        xmlSecMSCngLastError("CertAddStoreToCollection", NULL);
-        goto end;
-    }
-
-    ret = CertAddStoreToCollection(chainStore, untrustedStore, 0, 0);
-    if(ret == FALSE) {
-        xmlSecMSCngLastError("CertAddStoreToCollection", NULL);
-        goto end;
-    }
-
     /* build a chain using CertGetCertificateChain
      and the certificate retrieved */
-    ret = CertGetCertificateChain(NULL, cert, time, chainStore, &chainPara,
+    ret = CertGetCertificateChain(chainEngine, cert, time, docStore, &chainPara,
         CERT_CHAIN_REVOCATION_CHECK_CHAIN, NULL, &pChainContext);
     if(ret == FALSE) {
         xmlSecMSCngLastError("CertGetCertificateChain", NULL);
@@ -513,7 +587,7 @@ xmlSecMSCngX509StoreVerifyCertificateSystem(PCCERT_CONTEXT cert,
     if (pChainContext->TrustStatus.dwErrorStatus == CERT_TRUST_REVOCATION_STATUS_UNKNOWN) {
         CertFreeCertificateChain(pChainContext);
         pChainContext = NULL;
-        ret = CertGetCertificateChain(NULL, cert, time, chainStore, &chainPara,
+        ret = CertGetCertificateChain(chainEngine, cert, time, docStore, &chainPara,
             CERT_CHAIN_REVOCATION_CHECK_CHAIN_EXCLUDE_ROOT, NULL,
             &pChainContext);
         if(ret == FALSE) {
@@ -531,10 +605,6 @@ end:
         CertFreeCertificateChain(pChainContext);
     }
 
-    if(chainStore != NULL) {
-        CertCloseStore(chainStore, 0);
-    }
-
     return (res);
 }
 
@@ -605,7 +675,7 @@ xmlSecMSCngX509StoreVerifyCertificate(xmlSecKeyDataStorePtr store,
 
     /* verify based on the system certificates */
     ret = xmlSecMSCngX509StoreVerifyCertificateSystem(cert,
-        &fTime, ctx->untrusted, certStore);
+        &fTime, ctx->chainEngine, certStore);
     if(ret >= 0) {
         return(0);
     }
@@ -613,6 +683,197 @@ xmlSecMSCngX509StoreVerifyCertificate(xmlSecKeyDataStorePtr store,
     return(-1);
 }
 
+static ULONGLONG
+xmlSecMSCngFileTimeToULL(const FILETIME* in) {
+    xmlSecAssert2(in != NULL, 0);
+
+    return((((ULONGLONG)in->dwHighDateTime) << 32) | (ULONGLONG)in->dwLowDateTime);
+}
+
+/**
+ * xmlSecMSCngX509VerifyCacheDigest:
+ * @cert: the certificate to digest or NULL.
+ * @certs: the certificates store to digest if @cert is NULL.
+ * @md: the output buffer (XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE bytes).
+ *
+ * Calculates SHA-256 of the @cert DER or over the DERs of all the
+ * certificates in @certs.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+static int
+xmlSecMSCngX509VerifyCacheDigest(PCCERT_CONTEXT cert, HCERTSTORE certs, BYTE* md) {
+    PCCERT_CONTEXT cur = NULL;
+    BCRYPT_HASH_HANDLE hHash = NULL;
+    PBYTE pbHashObject = NULL;
+    DWORD cbHash = 0;
+    NTSTATUS status = STATUS_SUCCESS;
+    int ret;
+
+    xmlSecAssert2((cert != NULL) || (certs != NULL), -1);
+    xmlSecAssert2(md != NULL, -1);
+
+    ret = xmlSecMSCngHashAcquire(BCRYPT_SHA256_ALGORITHM, &hHash, &pbHashObject, &cbHash);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecMSCngHashAcquire", NULL);
+        return(-1);
+    }
+    if(cbHash != XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE) {
+        xmlSecInvalidSizeError("SHA-256 digest", cbHash,
+            XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE, NULL);
+        xmlSecMSCngHashRelease(BCRYPT_SHA256_ALGORITHM, hHash, pbHashObject, 0);
+        return(-1);
+    }
+
+    if(cert != NULL) {
+        status = BCryptHashData(hHash, cert->pbCertEncoded, cert->cbCertEncoded, 0);
+    } else {
+        while((cur = CertEnumCertificatesInStore(certs, cur)) != NULL) {
+            status = BCryptHashData(hHash, cur->pbCertEncoded, cur->cbCertEncoded, 0);
+            if(status != STATUS_SUCCESS) {
+                CertFreeCertificateContext(cur);
+                break;
+            }
+        }
+    }
+    if(status != STATUS_SUCCESS) {
+        xmlSecMSCngNtError("BCryptHashData", NULL, status);
+        xmlSecMSCngHashRelease(BCRYPT_SHA256_ALGORITHM, hHash, pbHashObject, 0);
+        return(-1);
+    }
+
+    status = BCryptFinishHash(hHash, md, XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE, 0);
+    if(status != STATUS_SUCCESS) {
+        xmlSecMSCngNtError("BCryptFinishHash", NULL, status);
+        xmlSecMSCngHashRelease(BCRYPT_SHA256_ALGORITHM, hHash, pbHashObject, 0);
+        return(-1);
+    }
+    xmlSecMSCngHashRelease(BCRYPT_SHA256_ALGORITHM, hHash, pbHashObject, 1);
+    return(0);
+}
+
+static void
+xmlSecMSCngX509VerifyCacheUnlink(xmlSecMSCngX509StoreCtxPtr ctx, xmlSecMSCngX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        ctx->cacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        ctx->cacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+static void
+xmlSecMSCngX509VerifyCachePushFront(xmlSecMSCngX509StoreCtxPtr ctx, xmlSecMSCngX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = ctx->cacheHead;
+    if(ctx->cacheHead != NULL) {
+        ctx->cacheHead->prev = entry;
+    } else {
+        ctx->cacheTail = entry;
+    }
+    ctx->cacheHead = entry;
+}
+
+static int
+xmlSecMSCngX509VerifyCacheLookup(xmlSecMSCngX509StoreCtxPtr ctx, const BYTE* certMd,
+                                 const BYTE* certsMd, ULONGLONG now) {
+    xmlSecMSCngX509VerifyCacheEntryPtr entry;
+    xmlSecMSCngX509VerifyCacheEntryPtr next;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+
+    xmlMutexLock(ctx->cacheMutex);
+    for(entry = ctx->cacheHead; entry != NULL; entry = next) {
+        next = entry->next;
+        if(entry->expires <= now) {
+            /* expired: the chain has to be built again */
+            xmlSecMSCngX509VerifyCacheUnlink(ctx, entry);
+            xmlFree(entry);
+            --ctx->cacheSize;
+            continue;
+        }
+        if((memcmp(entry->certMd, certMd, sizeof(entry->certMd)) == 0) &&
+           (memcmp(entry->certsMd, certsMd, sizeof(entry->certsMd)) == 0)) {
+            /* most recently used goes first */
+            xmlSecMSCngX509VerifyCacheUnlink(ctx, entry);
+            xmlSecMSCngX509VerifyCachePushFront(ctx, entry);
+            res = 1;
+            break;
+        }
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(res);
+}
+
+static int
+xmlSecMSCngX509VerifyCacheAdd(xmlSecMSCngX509StoreCtxPtr ctx, const BYTE* certMd,
+                              const BYTE* certsMd, ULONGLONG expires) {
+    xmlSecMSCngX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+
+    entry = (xmlSecMSCngX509VerifyCacheEntryPtr)xmlMalloc(sizeof(xmlSecMSCngX509VerifyCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecMSCngX509VerifyCacheEntry), NULL);
+        return(-1);
+    }
+    memset(entry, 0, sizeof(xmlSecMSCngX509VerifyCacheEntry));
+    memcpy(entry->certMd, certMd, sizeof(entry->certMd));
+    memcpy(entry->certsMd, certsMd, sizeof(entry->certsMd));
+    entry->expires = expires;
+
+    xmlMutexLock(ctx->cacheMutex);
+    xmlSecMSCngX509VerifyCachePushFront(ctx, entry);
+    ++ctx->cacheSize;
+    while((ctx->cacheSize > XMLSEC_MSCNG_X509_VERIFY_CACHE_SIZE) && (ctx->cacheTail != NULL)) {
+        /* evict least recently used */
+        entry = ctx->cacheTail;
+        xmlSecMSCngX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+        --ctx->cacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(0);
+}
+
+static void
+xmlSecMSCngX509VerifyCacheFlush(xmlSecMSCngX509StoreCtxPtr ctx) {
+    xmlSecMSCngX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexLock(ctx->cacheMutex);
+    }
+    while(ctx->cacheHead != NULL) {
+        entry = ctx->cacheHead;
+        xmlSecMSCngX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+    }
+    ctx->cacheSize = 0;
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexUnlock(ctx->cacheMutex);
+    }
+}
+
 /**
  * xmlSecMSCngX509StoreVerify:
  * @store: the pointer to X509 certificate context store klass.
@@ -626,13 +887,46 @@ xmlSecMSCngX509StoreVerifyCertificate(xmlSecKeyDataStorePtr store,
 PCCERT_CONTEXT
 xmlSecMSCngX509StoreVerify(xmlSecKeyDataStorePtr store, HCERTSTORE certs,
         xmlSecKeyInfoCtx* keyInfoCtx) {
+    xmlSecMSCngX509StoreCtxPtr ctx;
     PCCERT_CONTEXT cert = NULL;
+    PCCRL_CONTEXT crl;
+    BYTE certMd[XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE];
+    BYTE certsMd[XMLSEC_MSCNG_X509_VERIFY_CACHE_MD_SIZE];
+    FILETIME fNow;
+    ULONGLONG now = 0;
+    ULONGLONG expires;
+    int useCache = 0;
     int ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecMSCngX509StoreId), NULL);
     xmlSecAssert2(certs != NULL, NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
+    ctx = xmlSecMSCngX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    /* the cached results are only valid for the current time, the same
+     * certs and no CRLs in the document */
+    if(((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) &&
+       (keyInfoCtx->certsVerificationTime <= 0) && (ctx->cacheMutex != NULL)) {
+        crl = CertEnumCRLsInStore(certs, NULL);
+        if(crl != NULL) {
+            CertFreeCRLContext(crl);
+        } else {
+            useCache = 1;
+        }
+    }
+    if(useCache != 0) {
+        ret = xmlSecMSCngX509VerifyCacheDigest(NULL, certs, certsMd);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecMSCngX509VerifyCacheDigest",
+                xmlSecKeyDataStoreGetName(store));
+            return(NULL);
+        }
+        GetSystemTimeAsFileTime(&fNow);
+        now = xmlSecMSCngFileTimeToULL(&fNow);
+    }
+
     while((cert = CertEnumCertificatesInStore(certs, cert)) != NULL) {
         PCCERT_CONTEXT foundCert = NULL;
         int skip = 0;
@@ -662,9 +956,36 @@ xmlSecMSCngX509StoreVerify(xmlSecKeyDataStorePtr store, HCERTSTORE certs,
                 return(cert);
             }
 
+            /* did we verify this cert already? */
+            if(useCache != 0) {
+                ret = xmlSecMSCngX509VerifyCacheDigest(cert, NULL, certMd);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecMSCngX509VerifyCacheDigest",
+                        xmlSecKeyDataStoreGetName(store));
+                    CertFreeCertificateContext(cert);
+                    return(NULL);
+                }
+                if(xmlSecMSCngX509VerifyCacheLookup(ctx, certMd, certsMd, now) == 1) {
+                    return(cert);
+                }
+            }
+
             /* need to actually verify the certificate */
             ret = xmlSecMSCngX509StoreVerifyCertificate(store, cert, certs, keyInfoCtx);
             if(ret == 0) {
+                if(useCache != 0) {
+                    expires = now + (ULONGLONG)XMLSEC_MSCNG_X509_VERIFY_CACHE_TTL * 10000000;
+                    if(xmlSecMSCngFileTimeToULL(&(cert->pCertInfo->NotAfter)) < expires) {
+                        expires = xmlSecMSCngFileTimeToULL(&(cert->pCertInfo->NotAfter));
+                    }
+                    ret = xmlSecMSCngX509VerifyCacheAdd(ctx, certMd, certsMd, expires);
+                    if(ret < 0) {
+                        xmlSecInternalError("xmlSecMSCngX509VerifyCacheAdd",
+                            xmlSecKeyDataStoreGetName(store));
+                        CertFreeCertificateContext(cert);
+                        return(NULL);
+                    }
+                }
                 return(cert);
             }
         }
@@ -12,6 +12,8 @@
 
 #include <string.h>
 
+#include <libxml/threads.h>
+
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
@@ -276,6 +278,9 @@ xmlSecMSCryptoInit (void)  {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
         return(-1);
     }
+
+    /* share the verify context providers */
+    xmlSecMSCryptoProvidersPoolInitialize();
     return(0);
 }
 
@@ -288,7 +293,7 @@ xmlSecMSCryptoInit (void)  {
  */
 int
 xmlSecMSCryptoShutdown(void) {
-    /* TODO: if necessary, do additional shutdown here */
+    xmlSecMSCryptoProvidersPoolShutdown();
     return(0);
 }
 
@@ -720,6 +725,125 @@ xmlSecMSCryptoConvertUtf8ToTstr(const xmlChar*  str) {
  * Crypto Providers
  *
  ********************************************************************/
+/*
+ * CryptAcquireContext() loads and initializes the CSP every time and it
+ * is called for every transform and every key. The ephemeral providers
+ * (CRYPT_VERIFYCONTEXT without a container) have no state shared between
+ * the keys or hashes created from them, so one handle per providers list
+ * and flags is acquired on the first use and the callers get a new
+ * reference to it (CryptContextAddRef). The callers release the handles
+ * with CryptReleaseContext() as before. The pool keeps its own reference
+ * until xmlSecMSCryptoShutdown().
+ */
+#define XMLSEC_MSCRYPTO_PROVIDERS_POOL_SIZE             32
+
+typedef struct _xmlSecMSCryptoProvidersPoolEntry {
+    const xmlSecMSCryptoProviderInfo *  providers;
+    DWORD                               dwFlags;
+    HCRYPTPROV                          hProv;
+} xmlSecMSCryptoProvidersPoolEntry;
+
+static xmlMutexPtr                      xmlSecMSCryptoProvidersPoolMutex = NULL;
+static xmlSecMSCryptoProvidersPoolEntry xmlSecMSCryptoProvidersPool[XMLSEC_MSCRYPTO_PROVIDERS_POOL_SIZE];
+static xmlSecSize                       xmlSecMSCryptoProvidersPoolSize  = 0;
+
+/**
+ * xmlSecMSCryptoProvidersPoolInitialize:
+ *
+ * Initializes the shared providers pool. This function is called
+ * from the #xmlSecMSCryptoInit function.
+ */
+void
+xmlSecMSCryptoProvidersPoolInitialize(void) {
+    if(xmlSecMSCryptoProvidersPoolMutex == NULL) {
+        xmlSecMSCryptoProvidersPoolMutex = xmlNewMutex();
+        if(xmlSecMSCryptoProvidersPoolMutex == NULL) {
+            /* the providers will be acquired every time */
+            xmlSecXmlError("xmlNewMutex", NULL);
+        }
+    }
+}
+
+/**
+ * xmlSecMSCryptoProvidersPoolShutdown:
+ *
+ * Releases the pool references to the shared providers. This function
+ * is called from the #xmlSecMSCryptoShutdown function.
+ */
+void
+xmlSecMSCryptoProvidersPoolShutdown(void) {
+    xmlSecSize ii;
+
+    if(xmlSecMSCryptoProvidersPoolMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecMSCryptoProvidersPoolMutex);
+    for(ii = 0; ii < xmlSecMSCryptoProvidersPoolSize; ++ii) {
+        CryptReleaseContext(xmlSecMSCryptoProvidersPool[ii].hProv, 0);
+    }
+    memset(xmlSecMSCryptoProvidersPool, 0, sizeof(xmlSecMSCryptoProvidersPool));
+    xmlSecMSCryptoProvidersPoolSize = 0;
+    xmlMutexUnlock(xmlSecMSCryptoProvidersPoolMutex);
+
+    xmlFreeMutex(xmlSecMSCryptoProvidersPoolMutex);
+    xmlSecMSCryptoProvidersPoolMutex = NULL;
+}
+
+static HCRYPTPROV
+xmlSecMSCryptoProvidersPoolGet(const xmlSecMSCryptoProviderInfo * providers, DWORD dwFlags) {
+    HCRYPTPROV res = 0;
+    xmlSecSize ii;
+
+    xmlSecAssert2(providers != NULL, 0);
+
+    if(xmlSecMSCryptoProvidersPoolMutex == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecMSCryptoProvidersPoolMutex);
+    for(ii = 0; ii < xmlSecMSCryptoProvidersPoolSize; ++ii) {
+        if((xmlSecMSCryptoProvidersPool[ii].providers == providers) &&
+           (xmlSecMSCryptoProvidersPool[ii].dwFlags == dwFlags)) {
+            if(CryptContextAddRef(xmlSecMSCryptoProvidersPool[ii].hProv, NULL, 0)) {
+                res = xmlSecMSCryptoProvidersPool[ii].hProv;
+            }
+            break;
+        }
+    }
+    xmlMutexUnlock(xmlSecMSCryptoProvidersPoolMutex);
+    return(res);
+}
+
+static void
+xmlSecMSCryptoProvidersPoolAdd(const xmlSecMSCryptoProviderInfo * providers, DWORD dwFlags, HCRYPTPROV hProv) {
+    xmlSecSize ii;
+
+    xmlSecAssert(providers != NULL);
+    xmlSecAssert(hProv != 0);
+
+    if(xmlSecMSCryptoProvidersPoolMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecMSCryptoProvidersPoolMutex);
+    for(ii = 0; ii < xmlSecMSCryptoProvidersPoolSize; ++ii) {
+        if((xmlSecMSCryptoProvidersPool[ii].providers == providers) &&
+           (xmlSecMSCryptoProvidersPool[ii].dwFlags == dwFlags)) {
+            break;
+        }
+    }
+    if((ii >= xmlSecMSCryptoProvidersPoolSize) &&
+       (xmlSecMSCryptoProvidersPoolSize < XMLSEC_MSCRYPTO_PROVIDERS_POOL_SIZE) &&
+       CryptContextAddRef(hProv, NULL, 0)) {
+        xmlSecMSCryptoProvidersPool[xmlSecMSCryptoProvidersPoolSize].providers = providers;
+        xmlSecMSCryptoProvidersPool[xmlSecMSCryptoProvidersPoolSize].dwFlags = dwFlags;
+        xmlSecMSCryptoProvidersPool[xmlSecMSCryptoProvidersPoolSize].hProv = hProv;
+        ++xmlSecMSCryptoProvidersPoolSize;
+    }
+    xmlMutexUnlock(xmlSecMSCryptoProvidersPoolMutex);
+}
+
 /**
  * xmlSecMSCryptoFindProvider:
  * @providers:           the pointer to list of providers, last provider should have NULL for name.
@@ -727,9 +851,13 @@ xmlSecMSCryptoConvertUtf8ToTstr(const xmlChar*  str) {
  * @dwFlags:             the flags for CryptAcquireContext call
  * @bUseXmlSecContainer: the flag to indicate whether we should try to use XmlSec container if default fails
  *
- * Finds the first provider from the list
+ * Finds the first provider from the list. The ephemeral providers
+ * (@pszContainer is NULL and @dwFlags has CRYPT_VERIFYCONTEXT) are
+ * shared: the same handle with a new reference is returned for the
+ * same @providers list and @dwFlags.
  *
- * Returns: provider handle on success or NULL for error.
+ * Returns: provider handle (must be released with CryptReleaseContext)
+ * on success or NULL for error.
  */
 HCRYPTPROV
 xmlSecMSCryptoFindProvider(const xmlSecMSCryptoProviderInfo * providers,
@@ -741,9 +869,23 @@ xmlSecMSCryptoFindProvider(const xmlSecMSCryptoProviderInfo * providers,
     DWORD dwLastError;
     BOOL ret;
     int ii;
+    int shared;
 
     xmlSecAssert2(providers != NULL, 0);
 
+#ifndef XMLSEC_MSCRYPTO_NT4
+    shared = ((pszContainer == NULL) && ((dwFlags & CRYPT_VERIFYCONTEXT) != 0)) ? 1 : 0;
+#else  /* XMLSEC_MSCRYPTO_NT4 */
+    /* no CryptContextAddRef() */
+    shared = 0;
+#endif /* XMLSEC_MSCRYPTO_NT4 */
+    if(shared != 0) {
+        res = xmlSecMSCryptoProvidersPoolGet(providers, dwFlags);
+        if(res != 0) {
+            return(res);
+        }
+    }
+
     for(ii = 0; (res == 0) && (providers[ii].providerName != NULL) && (providers[ii].providerType != 0); ++ii) {
         /* first try */
         ret = CryptAcquireContext(&res,
@@ -752,6 +894,9 @@ xmlSecMSCryptoFindProvider(const xmlSecMSCryptoProviderInfo * providers,
                     providers[ii].providerType,
                     dwFlags);
         if((ret == TRUE) && (res != 0)) {
+            if(shared != 0) {
+                xmlSecMSCryptoProvidersPoolAdd(providers, dwFlags, res);
+            }
             return (res);
         }
 
@@ -24,6 +24,8 @@
 #include <wincrypt.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/buffer.h>
@@ -52,15 +54,41 @@
  *
  * MSCrypto Keys Store. Uses Simple Keys Store under the hood
  *
- * Simple Keys Store ptr is located after xmlSecKeyStore
+ * MSCrypto Keys Store ctx is located after xmlSecKeyStore, Simple Keys Store
+ * ptr is the first member of the ctx
  *
  ***************************************************************************/
+/**
+ * XMLSEC_MSCRYPTO_KEYS_STORE_INDEX_SIZE:
+ *
+ * The max number of the names (found certificates and misses) remembered
+ * by the MSCrypto keys store between the MS Certificate store changes.
+ */
+#define XMLSEC_MSCRYPTO_KEYS_STORE_INDEX_SIZE           256
+
+typedef struct _xmlSecMSCryptoKeysStoreIndexItem {
+    PCCERT_CONTEXT              cert;           /* NULL if the cert is not in the system store */
+} xmlSecMSCryptoKeysStoreIndexItem, *xmlSecMSCryptoKeysStoreIndexItemPtr;
+
+typedef struct _xmlSecMSCryptoKeysStoreCtx {
+    xmlSecKeyStorePtr           ss;             /* must be the first */
+    HCERTSTORE                  hStore;         /* the system store, kept open for the index */
+    HANDLE                      hStoreChanged;  /* signaled when the system store changes */
+    xmlHashTablePtr             index;          /* name -> index item */
+    xmlMutexPtr                 indexMutex;     /* protects all the above but ss */
+} xmlSecMSCryptoKeysStoreCtx, *xmlSecMSCryptoKeysStoreCtxPtr;
+
 #define xmlSecMSCryptoKeysStoreSize \
-        (sizeof(xmlSecKeyStore) + sizeof(xmlSecKeyStorePtr))
+        (sizeof(xmlSecKeyStore) + sizeof(xmlSecMSCryptoKeysStoreCtx))
+
+#define xmlSecMSCryptoKeysStoreGetCtx(store) \
+    ((xmlSecKeyStoreCheckSize((store), xmlSecMSCryptoKeysStoreSize)) ? \
+     (xmlSecMSCryptoKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+     (xmlSecMSCryptoKeysStoreCtxPtr)NULL)
 
 #define xmlSecMSCryptoKeysStoreGetSS(store) \
     ((xmlSecKeyStoreCheckSize((store), xmlSecMSCryptoKeysStoreSize)) ? \
-     (xmlSecKeyStorePtr*)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+     &(((xmlSecMSCryptoKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)))->ss) : \
      (xmlSecKeyStorePtr*)NULL)
 
 static int                      xmlSecMSCryptoKeysStoreInitialize   (xmlSecKeyStorePtr store);
@@ -246,69 +274,207 @@ xmlSecMSCryptoKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSe
     return (xmlSecSimpleKeysStoreSave(*ss, filename, type));
 }
 
+static void
+xmlSecMSCryptoKeysStoreIndexItemDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    xmlSecMSCryptoKeysStoreIndexItemPtr item = (xmlSecMSCryptoKeysStoreIndexItemPtr)payload;
+
+    if(item != NULL) {
+        if(item->cert != NULL) {
+            CertFreeCertificateContext(item->cert);
+        }
+        xmlFree(item);
+    }
+}
+
 static int
 xmlSecMSCryptoKeysStoreInitialize(xmlSecKeyStorePtr store) {
-    xmlSecKeyStorePtr *ss;
+    xmlSecMSCryptoKeysStoreCtxPtr ctx;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecMSCryptoKeysStoreId), -1);
 
-    ss = xmlSecMSCryptoKeysStoreGetSS(store);
-    xmlSecAssert2((*ss == NULL), -1);
+    ctx = xmlSecMSCryptoKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    memset(ctx, 0, sizeof(xmlSecMSCryptoKeysStoreCtx));
 
-    *ss = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
-    if(*ss == NULL) {
+    ctx->ss = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    if(ctx->ss == NULL) {
         xmlSecInternalError("xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId)",
                             xmlSecKeyStoreGetName(store));
         return(-1);
     }
 
+    ctx->indexMutex = xmlNewMutex();
+    if(ctx->indexMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
     return(0);
 }
 
 static void
 xmlSecMSCryptoKeysStoreFinalize(xmlSecKeyStorePtr store) {
-    xmlSecKeyStorePtr *ss;
+    xmlSecMSCryptoKeysStoreCtxPtr ctx;
 
     xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecMSCryptoKeysStoreId));
 
-    ss = xmlSecMSCryptoKeysStoreGetSS(store);
-    xmlSecAssert((ss != NULL) && (*ss != NULL));
+    ctx = xmlSecMSCryptoKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
 
-    xmlSecKeyStoreDestroy(*ss);
+    if(ctx->ss != NULL) {
+        xmlSecKeyStoreDestroy(ctx->ss);
+    }
+    if(ctx->index != NULL) {
+        xmlHashFree(ctx->index, xmlSecMSCryptoKeysStoreIndexItemDestroy);
+    }
+    if(ctx->hStore != NULL) {
+        CertCloseStore(ctx->hStore, 0);
+    }
+    if(ctx->hStoreChanged != NULL) {
+        CloseHandle(ctx->hStoreChanged);
+    }
+    if(ctx->indexMutex != NULL) {
+        xmlFreeMutex(ctx->indexMutex);
+    }
+    memset(ctx, 0, sizeof(xmlSecMSCryptoKeysStoreCtx));
 }
 
-static PCCERT_CONTEXT
-xmlSecMSCryptoKeysStoreFindCert(xmlSecKeyStorePtr store, const xmlChar* name,
-                                xmlSecKeyInfoCtxPtr keyInfoCtx) {
+static HCERTSTORE
+xmlSecMSCryptoKeysStoreOpenSystemStore(xmlSecKeyStorePtr store) {
     LPCTSTR storeName;
-    HCERTSTORE hStoreHandle = NULL;
-    PCCERT_CONTEXT pCertContext = NULL;
-    LPTSTR wcName = NULL;
+    HCERTSTORE hStore;
 
-    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecMSCryptoKeysStoreId), NULL);
-    xmlSecAssert2(name != NULL, NULL);
-    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+    xmlSecAssert2(store != NULL, NULL);
 
     storeName = xmlSecMSCryptoAppGetCertStoreName();
     if(storeName == NULL) {
         storeName = XMLSEC_MSCRYPTO_APP_DEFAULT_CERT_STORE_NAME;
     }
 
-    hStoreHandle = CertOpenSystemStore(0, storeName);
-    if (NULL == hStoreHandle) {
+    hStore = CertOpenSystemStore(0, storeName);
+    if (NULL == hStore) {
         xmlSecMSCryptoError2("CertOpenSystemStore",
                              xmlSecKeyStoreGetName(store),
                              "storeName=%s",
                              xmlSecErrorsSafeString(storeName));
         return(NULL);
     }
+    return(hStore);
+}
+
+/*
+ * Makes sure the index is in sync with the system store: the store is opened
+ * and the change notifications are requested on the first call, the index is
+ * dropped when the store signals a change. The caller must hold the index
+ * mutex. Returns 1 if the index can be used and 0 if the notifications are
+ * not available (the index is disabled then).
+ */
+static int
+xmlSecMSCryptoKeysStoreIndexSync(xmlSecKeyStorePtr store, xmlSecMSCryptoKeysStoreCtxPtr ctx) {
+    xmlSecAssert2(store != NULL, 0);
+    xmlSecAssert2(ctx != NULL, 0);
+
+    if(ctx->hStoreChanged == NULL) {
+        if(ctx->hStore != NULL) {
+            /* notifications failed before */
+            return(0);
+        }
+
+        ctx->hStore = xmlSecMSCryptoKeysStoreOpenSystemStore(store);
+        if(ctx->hStore == NULL) {
+            xmlSecInternalError("xmlSecMSCryptoKeysStoreOpenSystemStore",
+                                xmlSecKeyStoreGetName(store));
+            return(0);
+        }
+
+        ctx->hStoreChanged = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if(ctx->hStoreChanged == NULL) {
+            xmlSecMSCryptoError("CreateEvent", xmlSecKeyStoreGetName(store));
+            return(0);
+        }
+        if(!CertControlStore(ctx->hStore, 0, CERT_STORE_CTRL_NOTIFY_CHANGE, &(ctx->hStoreChanged))) {
+            xmlSecMSCryptoError("CertControlStore(CERT_STORE_CTRL_NOTIFY_CHANGE)",
+                                xmlSecKeyStoreGetName(store));
+            CloseHandle(ctx->hStoreChanged);
+            ctx->hStoreChanged = NULL;
+            return(0);
+        }
+        return(1);
+    }
+
+    if(WaitForSingleObject(ctx->hStoreChanged, 0) == WAIT_OBJECT_0) {
+        /* pick up the changes and re-arm the notification */
+        if(!CertControlStore(ctx->hStore, 0, CERT_STORE_CTRL_RESYNC, &(ctx->hStoreChanged))) {
+            xmlSecMSCryptoError("CertControlStore(CERT_STORE_CTRL_RESYNC)",
+                                xmlSecKeyStoreGetName(store));
+        }
+        if(ctx->index != NULL) {
+            xmlHashFree(ctx->index, xmlSecMSCryptoKeysStoreIndexItemDestroy);
+            ctx->index = NULL;
+        }
+    }
+    return(1);
+}
+
+/* the index is an optimization: the errors are reported but not returned */
+static void
+xmlSecMSCryptoKeysStoreIndexAdd(xmlSecMSCryptoKeysStoreCtxPtr ctx, const xmlChar* name, PCCERT_CONTEXT cert) {
+    xmlSecMSCryptoKeysStoreIndexItemPtr item;
+    int ret;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(name != NULL);
+
+    item = (xmlSecMSCryptoKeysStoreIndexItemPtr)xmlMalloc(sizeof(xmlSecMSCryptoKeysStoreIndexItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecMSCryptoKeysStoreIndexItem), NULL);
+        return;
+    }
+    memset(item, 0, sizeof(xmlSecMSCryptoKeysStoreIndexItem));
+    if(cert != NULL) {
+        item->cert = CertDuplicateCertificateContext(cert);
+        if(item->cert == NULL) {
+            xmlSecMSCryptoError("CertDuplicateCertificateContext", NULL);
+            xmlFree(item);
+            return;
+        }
+    }
+
+    /* start over when full: the index is refilled quickly by the hot names */
+    if((ctx->index != NULL) && (xmlHashSize(ctx->index) >= XMLSEC_MSCRYPTO_KEYS_STORE_INDEX_SIZE)) {
+        xmlHashFree(ctx->index, xmlSecMSCryptoKeysStoreIndexItemDestroy);
+        ctx->index = NULL;
+    }
+    if(ctx->index == NULL) {
+        ctx->index = xmlHashCreate(0);
+        if(ctx->index == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+            xmlSecMSCryptoKeysStoreIndexItemDestroy(item, NULL);
+            return;
+        }
+    }
+    ret = xmlHashUpdateEntry(ctx->index, name, item, xmlSecMSCryptoKeysStoreIndexItemDestroy);
+    if(ret < 0) {
+        xmlSecXmlError("xmlHashUpdateEntry", NULL);
+        xmlSecMSCryptoKeysStoreIndexItemDestroy(item, NULL);
+    }
+}
+
+static PCCERT_CONTEXT
+xmlSecMSCryptoKeysStoreFindCertInStore(xmlSecKeyStorePtr store, HCERTSTORE hStoreHandle,
+                                       const xmlChar* name) {
+    PCCERT_CONTEXT pCertContext = NULL;
+    LPTSTR wcName = NULL;
+
+    xmlSecAssert2(store != NULL, NULL);
+    xmlSecAssert2(hStoreHandle != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
 
     /* convert name to unicode */
     wcName = xmlSecMSCryptoConvertUtf8ToTstr(name);
     if(wcName == NULL) {
         xmlSecInternalError("xmlSecMSCryptoConvertUtf8ToTstr(name)",
                             xmlSecKeyStoreGetName(store));
-        CertCloseStore(hStoreHandle, 0);
         return(NULL);
     }
 
@@ -345,8 +511,8 @@ xmlSecMSCryptoKeysStoreFindCert(xmlSecKeyStorePtr store, const xmlChar* name,
             pbFriendlyName = xmlMalloc(dwPropSize);
             if(pbFriendlyName == NULL) {
                 xmlSecMallocError(dwPropSize, xmlSecKeyStoreGetName(store));
+                CertFreeCertificateContext(pCertCtxIter);
                 xmlFree(wcName);
-                CertCloseStore(hStoreHandle, 0);
                 return(NULL);
             }
 
@@ -391,9 +557,60 @@ xmlSecMSCryptoKeysStoreFindCert(xmlSecKeyStorePtr store, const xmlChar* name,
 
     /* OK, I give up, I'm gone :( */
 
-    /* aleksey todo: is it a right idea to close store if we have a handle to
-     * a cert in this store? */
     xmlFree(wcName);
+    return(pCertContext);
+}
+
+static PCCERT_CONTEXT
+xmlSecMSCryptoKeysStoreFindCert(xmlSecKeyStorePtr store, const xmlChar* name,
+                                xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecMSCryptoKeysStoreCtxPtr ctx;
+    xmlSecMSCryptoKeysStoreIndexItemPtr item;
+    HCERTSTORE hStoreHandle;
+    PCCERT_CONTEXT pCertContext = NULL;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecMSCryptoKeysStoreId), NULL);
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    ctx = xmlSecMSCryptoKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->indexMutex != NULL, NULL);
+
+    /*
+     * The system store search (the subject DN variants, the enumeration for
+     * the friendly name and the subject substring match) is done once per
+     * name, the result (or the miss) is remembered until the system store
+     * signals a change.
+     */
+    xmlMutexLock(ctx->indexMutex);
+    if(xmlSecMSCryptoKeysStoreIndexSync(store, ctx) != 0) {
+        if(ctx->index != NULL) {
+            item = (xmlSecMSCryptoKeysStoreIndexItemPtr)xmlHashLookup(ctx->index, name);
+            if(item != NULL) {
+                if(item->cert != NULL) {
+                    pCertContext = CertDuplicateCertificateContext(item->cert);
+                }
+                xmlMutexUnlock(ctx->indexMutex);
+                return(pCertContext);
+            }
+        }
+
+        pCertContext = xmlSecMSCryptoKeysStoreFindCertInStore(store, ctx->hStore, name);
+        xmlSecMSCryptoKeysStoreIndexAdd(ctx, name, pCertContext);
+        xmlMutexUnlock(ctx->indexMutex);
+        return(pCertContext);
+    }
+    xmlMutexUnlock(ctx->indexMutex);
+
+    /* no change notifications: search the system store every time */
+    hStoreHandle = xmlSecMSCryptoKeysStoreOpenSystemStore(store);
+    if(hStoreHandle == NULL) {
+        xmlSecInternalError("xmlSecMSCryptoKeysStoreOpenSystemStore",
+                            xmlSecKeyStoreGetName(store));
+        return(NULL);
+    }
+    pCertContext = xmlSecMSCryptoKeysStoreFindCertInStore(store, hStoreHandle, name);
     CertCloseStore(hStoreHandle, 0);
     return(pCertContext);
 }
@@ -49,6 +49,10 @@ static xmlSecKWAesKlass xmlSecMSCryptoKWAesKlass = {
     xmlSecMSCryptoKWAesBlockEncrypt,        /* xmlSecKWAesBlockEncryptMethod       encrypt; */
     xmlSecMSCryptoKWAesBlockDecrypt,        /* xmlSecKWAesBlockDecryptMethod       decrypt; */
 
+    /* bulk operations */
+    NULL,                                   /* xmlSecKWAesWrapMethod               wrap; */
+    NULL,                                   /* xmlSecKWAesUnwrapMethod             unwrap; */
+
     /* for the future */
     NULL,                                   /* void*                               reserved0; */
     NULL                                    /* void*                               reserved1; */
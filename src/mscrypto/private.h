@@ -72,6 +72,8 @@ HCRYPTPROV         xmlSecMSCryptoFindProvider                   (const xmlSecMSC
                                                                  LPCTSTR pszContainer,
                                                                  DWORD dwFlags,
                                                                  BOOL bUseXmlSecContainer);
+void               xmlSecMSCryptoProvidersPoolInitialize        (void);
+void               xmlSecMSCryptoProvidersPoolShutdown          (void);
 
 
 /******************************************************************************
@@ -1421,8 +1421,11 @@ xmlSecMSCryptoKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data, xmlSecKeyPtr
 
     if((ctx->keyCert == NULL) && (xmlSecKeyGetValue(key) == NULL)) {
         PCCERT_CONTEXT cert;
+        void* span;
 
+        span = xmlSecTraceBegin(xmlSecTracePhaseX509Verify, NULL, keyInfoCtx->userData);
         cert = xmlSecMSCryptoX509StoreVerify(x509Store, ctx->hMemStore, keyInfoCtx);
+        xmlSecTraceEnd(span, xmlSecTracePhaseX509Verify, (cert != NULL) ? 0 : -1);
         if(cert != NULL) {
             xmlSecKeyDataPtr keyValue = NULL;
         PCCERT_CONTEXT pCert = NULL;
@@ -29,12 +29,854 @@
 static int      xmlSecNodeSetOneContains                (xmlSecNodeSetPtr nset,
                                                          xmlNodePtr node,
                                                          xmlNodePtr parent);
-static int      xmlSecNodeSetWalkRecursive              (xmlSecNodeSetPtr nset,
+static int      xmlSecNodeSetNodesContain               (xmlSecNodeSetPtr nset,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent);
+static void     xmlSecNodeSetDropBitmap                 (xmlSecNodeSetPtr nset);
+
+/* the namespace declarations in scope of the current element during the walk */
+typedef struct _xmlSecNodeSetNsStack {
+    xmlNsPtr*           tab;
+    xmlSecSize          size;
+    xmlSecSize          max;
+} xmlSecNodeSetNsStack, *xmlSecNodeSetNsStackPtr;
+
+static int      xmlSecNodeSetWalkTree                   (xmlSecNodeSetPtr nset,
                                                          xmlSecNodeSetWalkCallback walkFunc,
                                                          void* data,
-                                                         xmlNodePtr cur,
+                                                         xmlNodePtr root,
+                                                         xmlNodePtr rootParent,
+                                                         xmlSecNodeSetNsStackPtr nsStack);
+
+/**************************************************************************
+ *
+ * Compact nodes sets
+ *
+ * The xmlSecNodeSetGetChildren() sets (the enveloped signature, the
+ * SignedInfo and the whole document subtrees) have only a few roots.
+ * Instead of the separately allocated xmlNodeSet and its nodes table,
+ * the roots are stored inline right after the nodes set itself: the
+ * set is allocated with a single malloc and the xmlSecNodeSetContains()
+ * checks the ancestors against the inline roots without building the
+ * lookup index. The nodes list of such set can not be modified.
+ *
+ *************************************************************************/
+#define XMLSEC_NODESET_COMPACT_MAX_ROOTS        4
+#define XMLSEC_NODESET_COMPACT_MAX_DEPTH        32
+
+typedef struct _xmlSecNodeSetCompact {
+    xmlSecNodeSet       nset;
+    xmlNodeSet          nodes;
+    xmlNodePtr          nodeTab[XMLSEC_NODESET_COMPACT_MAX_ROOTS];
+} xmlSecNodeSetCompact, *xmlSecNodeSetCompactPtr;
+
+#define xmlSecNodeSetIsCompact(nset)            \
+    ((nset)->nodes == &(((xmlSecNodeSetCompactPtr)(nset))->nodes))
+
+static xmlSecNodeSetPtr xmlSecNodeSetCompactCreate      (xmlDocPtr doc,
+                                                         xmlNodePtr parent,
+                                                         int withComments,
+                                                         xmlSecNodeSetType type);
+static int      xmlSecNodeSetCompactContainsAncestor    (xmlSecNodeSetPtr nset,
+                                                         xmlNodePtr node);
+
+/**************************************************************************
+ *
+ * Nodes lookup index
+ *
+ * The xmlXPathNodeSetContains() function scans the whole nodes list and
+ * c14n calls xmlSecNodeSetContains() for every node in the document. For
+ * the big nodes sets we build (on the first lookup) an open addressing
+ * hash table of the @nodes list. The namespace nodes in the XPath nodes
+ * sets are copies with the "next" pointer set to the parent element
+ * and they are keyed by the (parent, prefix) pair (check libxml xpath.c
+ * for details).
+ *
+ * The tree nodes sets also remember the membership of the ancestor
+ * elements so all the descendants and attributes of an element are
+ * resolved without walking up to the document root again. The document
+ * is not expected to change while the nodes set is used and the index is
+ * not protected by a mutex: a nodes set is used by one thread at a time
+ * (the parallel c14n only splits the whole document and the enveloped
+ * signature walks that do not look up the nodes sets).
+ *
+ *************************************************************************/
+#define XMLSEC_NODESET_INDEX_THRESHOLD          16
+#define XMLSEC_NODESET_INDEX_MIN_SIZE           32
+
+typedef struct _xmlSecNodeSetMemoEntry {
+    xmlNodePtr          node;
+    int                 status;
+} xmlSecNodeSetMemoEntry, *xmlSecNodeSetMemoEntryPtr;
+
+typedef struct _xmlSecNodeSetBitmap             xmlSecNodeSetBitmap,
+                                                *xmlSecNodeSetBitmapPtr;
+static void     xmlSecNodeSetBitmapDestroy              (xmlSecNodeSetBitmapPtr bitmap);
+static int      xmlSecNodeSetBitmapContains             (xmlSecNodeSetBitmapPtr bitmap,
+                                                         xmlNodePtr node,
                                                          xmlNodePtr parent);
 
+struct _xmlSecNodeSetIndex {
+    xmlNodePtr*                 table;
+    xmlSecSize                  mask;
+    int                         tableBuilt;
+
+    xmlSecNodeSetMemoEntryPtr   memo;
+    xmlSecSize                  memoMask;
+    xmlSecSize                  memoUsed;
+
+    xmlSecNodeSetBitmapPtr      bitmap;
+};
+
+static xmlSecSize
+xmlSecNodeSetIndexHashPtr(const void* ptr) {
+    xmlSecSize val = (xmlSecSize)(((size_t)ptr) >> 3);
+
+    /* mix the bits, the pointers are aligned and close to each other */
+    val ^= (val >> 16);
+    val *= 0x45d9f3bU;
+    val ^= (val >> 16);
+    return(val);
+}
+
+static xmlSecSize
+xmlSecNodeSetIndexHashNs(xmlNodePtr parent, const xmlChar* prefix) {
+    xmlSecSize val = xmlSecNodeSetIndexHashPtr(parent);
+
+    if(prefix != NULL) {
+        for(; (*prefix) != '\0'; ++prefix) {
+            val = val * 31 + (*prefix);
+        }
+    }
+    return(val);
+}
+
+static xmlSecSize
+xmlSecNodeSetIndexHashNode(xmlNodePtr node) {
+    xmlSecAssert2(node != NULL, 0);
+
+    if(node->type == XML_NAMESPACE_DECL) {
+        return(xmlSecNodeSetIndexHashNs((xmlNodePtr)(((xmlNsPtr)node)->next),
+                                        ((xmlNsPtr)node)->prefix));
+    }
+    return(xmlSecNodeSetIndexHashPtr(node));
+}
+
+static void
+xmlSecNodeSetIndexDestroy(xmlSecNodeSetIndexPtr index) {
+    xmlSecAssert(index != NULL);
+
+    if(index->table != NULL) {
+        xmlFree(index->table);
+    }
+    if(index->memo != NULL) {
+        xmlFree(index->memo);
+    }
+    if(index->bitmap != NULL) {
+        xmlSecNodeSetBitmapDestroy(index->bitmap);
+    }
+    memset(index, 0, sizeof(xmlSecNodeSetIndex));
+    xmlFree(index);
+}
+
+static xmlSecNodeSetIndexPtr
+xmlSecNodeSetGetIndex(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetIndexPtr index;
+
+    xmlSecAssert2(nset != NULL, NULL);
+
+    if(nset->index != NULL) {
+        return(nset->index);
+    }
+
+    index = (xmlSecNodeSetIndexPtr)xmlMalloc(sizeof(xmlSecNodeSetIndex));
+    if(index == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetIndex), NULL);
+        return(NULL);
+    }
+    memset(index, 0, sizeof(xmlSecNodeSetIndex));
+    nset->index = index;
+    return(index);
+}
+
+static int
+xmlSecNodeSetIndexBuild(xmlSecNodeSetIndexPtr index, xmlNodeSetPtr nodes) {
+    xmlSecSize size, pos;
+    xmlNodePtr cur;
+    int i;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(index->table == NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(nodes->nodeNr > 0, -1);
+
+    /* keep the table at most half full */
+    for(size = XMLSEC_NODESET_INDEX_MIN_SIZE; size < 2 * (xmlSecSize)nodes->nodeNr; size *= 2);
+
+    index->table = (xmlNodePtr*)xmlMalloc(size * sizeof(xmlNodePtr));
+    if(index->table == NULL) {
+        xmlSecMallocError(size * sizeof(xmlNodePtr), NULL);
+        return(-1);
+    }
+    memset(index->table, 0, size * sizeof(xmlNodePtr));
+    index->mask = size - 1;
+
+    for(i = 0; i < nodes->nodeNr; ++i) {
+        cur = nodes->nodeTab[i];
+        if(cur == NULL) {
+            continue;
+        }
+        /* namespace without parent can't match anything */
+        if((cur->type == XML_NAMESPACE_DECL) && (((xmlNsPtr)cur)->next == NULL)) {
+            continue;
+        }
+        for(pos = xmlSecNodeSetIndexHashNode(cur) & index->mask;
+            index->table[pos] != NULL;
+            pos = (pos + 1) & index->mask);
+        index->table[pos] = cur;
+    }
+
+    return(0);
+}
+
+static int
+xmlSecNodeSetIndexContains(xmlSecNodeSetIndexPtr index, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecSize pos;
+    xmlNodePtr cur;
+
+    xmlSecAssert2(index != NULL, 0);
+    xmlSecAssert2(index->table != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    if(node->type != XML_NAMESPACE_DECL) {
+        for(pos = xmlSecNodeSetIndexHashPtr(node) & index->mask;
+            (cur = index->table[pos]) != NULL;
+            pos = (pos + 1) & index->mask) {
+            if(cur == node) {
+                return(1);
+            }
+        }
+        return(0);
+    }
+
+    /* parent must be set for namespace nodes */
+    if(parent == NULL) {
+        return(0);
+    }
+    for(pos = xmlSecNodeSetIndexHashNs(parent, ((xmlNsPtr)node)->prefix) & index->mask;
+        (cur = index->table[pos]) != NULL;
+        pos = (pos + 1) & index->mask) {
+        if((cur->type == XML_NAMESPACE_DECL) &&
+           (((xmlNsPtr)cur)->next == (xmlNsPtr)parent) &&
+           xmlStrEqual(((xmlNsPtr)cur)->prefix, ((xmlNsPtr)node)->prefix)) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/* returns the memo entry for @node, the entry node is NULL if it is a new one */
+static xmlSecNodeSetMemoEntryPtr
+xmlSecNodeSetIndexMemoLookup(xmlSecNodeSetIndexPtr index, xmlNodePtr node) {
+    xmlSecSize pos;
+
+    xmlSecAssert2(index != NULL, NULL);
+    xmlSecAssert2(index->memo != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    for(pos = xmlSecNodeSetIndexHashPtr(node) & index->memoMask;
+        (index->memo[pos].node != NULL) && (index->memo[pos].node != node);
+        pos = (pos + 1) & index->memoMask);
+    return(&(index->memo[pos]));
+}
+
+static int
+xmlSecNodeSetIndexMemoGrow(xmlSecNodeSetIndexPtr index) {
+    xmlSecNodeSetMemoEntryPtr oldMemo;
+    xmlSecSize oldSize, newSize, i;
+    xmlSecNodeSetMemoEntryPtr entry;
+
+    xmlSecAssert2(index != NULL, -1);
+
+    oldMemo = index->memo;
+    oldSize = (oldMemo != NULL) ? (index->memoMask + 1) : 0;
+    newSize = (oldSize > 0) ? (2 * oldSize) : XMLSEC_NODESET_INDEX_MIN_SIZE;
+
+    index->memo = (xmlSecNodeSetMemoEntryPtr)xmlMalloc(newSize * sizeof(xmlSecNodeSetMemoEntry));
+    if(index->memo == NULL) {
+        xmlSecMallocError(newSize * sizeof(xmlSecNodeSetMemoEntry), NULL);
+        index->memo = oldMemo;
+        return(-1);
+    }
+    memset(index->memo, 0, newSize * sizeof(xmlSecNodeSetMemoEntry));
+    index->memoMask = newSize - 1;
+
+    for(i = 0; i < oldSize; ++i) {
+        if(oldMemo[i].node != NULL) {
+            entry = xmlSecNodeSetIndexMemoLookup(index, oldMemo[i].node);
+            (*entry) = oldMemo[i];
+        }
+    }
+    if(oldMemo != NULL) {
+        xmlFree(oldMemo);
+    }
+    return(0);
+}
+
+static int
+xmlSecNodeSetNodesContain(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecNodeSetIndexPtr index;
+
+    xmlSecAssert2(nset != NULL, 0);
+    xmlSecAssert2(nset->nodes != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    /* this is a libxml hack! check xpath.c for details */
+    if((node->type == XML_NAMESPACE_DECL) && (parent != NULL) && (parent->type == XML_ATTRIBUTE_NODE)) {
+        parent = parent->parent;
+    }
+
+    /* build the index for big nodes sets on the first lookup */
+    if(nset->nodes->nodeNr > XMLSEC_NODESET_INDEX_THRESHOLD) {
+        index = xmlSecNodeSetGetIndex(nset);
+        if((index != NULL) && (index->tableBuilt == 0)) {
+            /* don't try again if it fails, fall back to the list scan */
+            index->tableBuilt = 1;
+            xmlSecNodeSetIndexBuild(index, nset->nodes);
+        }
+        if((index != NULL) && (index->table != NULL)) {
+            return(xmlSecNodeSetIndexContains(index, node, parent));
+        }
+    }
+
+    if(node->type != XML_NAMESPACE_DECL) {
+        return(xmlXPathNodeSetContains(nset->nodes, node));
+    } else {
+        xmlNs ns;
+
+        memcpy(&ns, node, sizeof(ns));
+        ns.next = (xmlNsPtr)parent;
+
+        /*
+         * If the input is an XPath node-set, then the node-set must explicitly
+         * contain every node to be rendered to the canonical form.
+         */
+        return(xmlXPathNodeSetContains(nset->nodes, (xmlNodePtr)&ns));
+    }
+}
+
+static int
+xmlSecNodeSetTreeContainsAncestor(xmlSecNodeSetPtr nset, xmlNodePtr node) {
+    xmlSecNodeSetIndexPtr index;
+    xmlSecNodeSetMemoEntryPtr entry;
+    int status;
+
+    xmlSecAssert2(nset != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+    xmlSecAssert2(node->type == XML_ELEMENT_NODE, 0);
+
+    if((nset->index == NULL) && (nset->nodes != NULL) && xmlSecNodeSetIsCompact(nset)) {
+        status = xmlSecNodeSetCompactContainsAncestor(nset, node);
+        if(status >= 0) {
+            return(status);
+        }
+    }
+
+    index = xmlSecNodeSetGetIndex(nset);
+    if((index != NULL) && (index->memo != NULL)) {
+        entry = xmlSecNodeSetIndexMemoLookup(index, node);
+        if(entry->node != NULL) {
+            return(entry->status);
+        }
+    }
+
+    status = xmlSecNodeSetOneContains(nset, node, node->parent);
+
+    /* the memo might be re-allocated during the recursive call */
+    if((index != NULL) && ((index->memo == NULL) || (2 * (index->memoUsed + 1) > index->memoMask + 1))) {
+        if(xmlSecNodeSetIndexMemoGrow(index) < 0) {
+            return(status);
+        }
+    }
+    if((index != NULL) && (index->memo != NULL)) {
+        entry = xmlSecNodeSetIndexMemoLookup(index, node);
+        if(entry->node == NULL) {
+            entry->node   = node;
+            entry->status = status;
+            ++index->memoUsed;
+        }
+    }
+    return(status);
+}
+
+/**************************************************************************
+ *
+ * Materialized nodes sets
+ *
+ * The XPath Filter 2.0 transform builds long chains of intersected,
+ * subtracted and united nodes sets and every xmlSecNodeSetContains()
+ * call walks the whole chain. The chain can be collapsed once into a
+ * bitmap indexed by the node position in the document order. Each tree
+ * nodes set is a set of contiguous positions ranges (the element, its
+ * namespaces and attributes and all its descendants) and the nodes sets
+ * operations are the word-wise AND, ANDNOT and OR operations.
+ *
+ * The nodes that are not in the bitmap (e.g. the "xml" namespace) are
+ * still checked against the chain.
+ *
+ *************************************************************************/
+typedef unsigned long                           xmlSecNodeSetBitmapWord;
+#define XMLSEC_NODESET_BITMAP_WORD_BITS         (8 * sizeof(xmlSecNodeSetBitmapWord))
+#define xmlSecNodeSetBitmapWordsNum(size)       \
+    (((size) + XMLSEC_NODESET_BITMAP_WORD_BITS - 1) / XMLSEC_NODESET_BITMAP_WORD_BITS)
+#define xmlSecNodeSetBitmapSet(words, pos)      \
+    ((words)[(pos) / XMLSEC_NODESET_BITMAP_WORD_BITS] |= \
+        (((xmlSecNodeSetBitmapWord)1) << ((pos) % XMLSEC_NODESET_BITMAP_WORD_BITS)))
+#define xmlSecNodeSetBitmapTest(words, pos)     \
+    (((words)[(pos) / XMLSEC_NODESET_BITMAP_WORD_BITS] & \
+        (((xmlSecNodeSetBitmapWord)1) << ((pos) % XMLSEC_NODESET_BITMAP_WORD_BITS))) != 0)
+
+typedef struct _xmlSecNodeSetBitmapEntry {
+    xmlNodePtr          node;           /* the node or the namespace parent element */
+    const xmlChar*      prefix;         /* the namespace prefix */
+    int                 isNs;
+    xmlSecSize          pos;            /* the position in the document order */
+    xmlSecSize          end;            /* the last position in the node subtree */
+} xmlSecNodeSetBitmapEntry, *xmlSecNodeSetBitmapEntryPtr;
+
+struct _xmlSecNodeSetBitmap {
+    xmlSecNodeSetBitmapEntryPtr table;
+    xmlSecSize                  mask;
+    xmlSecSize                  size;           /* the number of nodes */
+
+    xmlSecNodeSetBitmapWord*    comments;
+    xmlSecNodeSetBitmapWord*    words;
+    xmlSecSize                  wordsNum;
+};
+
+static void
+xmlSecNodeSetBitmapDestroy(xmlSecNodeSetBitmapPtr bitmap) {
+    xmlSecAssert(bitmap != NULL);
+
+    if(bitmap->table != NULL) {
+        xmlFree(bitmap->table);
+    }
+    if(bitmap->comments != NULL) {
+        xmlFree(bitmap->comments);
+    }
+    if(bitmap->words != NULL) {
+        xmlFree(bitmap->words);
+    }
+    memset(bitmap, 0, sizeof(xmlSecNodeSetBitmap));
+    xmlFree(bitmap);
+}
+
+static xmlSecNodeSetBitmapEntryPtr
+xmlSecNodeSetBitmapLookup(xmlSecNodeSetBitmapPtr bitmap, xmlNodePtr node,
+                          const xmlChar* prefix, int isNs) {
+    xmlSecNodeSetBitmapEntryPtr entry;
+    xmlSecSize pos;
+
+    xmlSecAssert2(bitmap != NULL, NULL);
+    xmlSecAssert2(bitmap->table != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    pos = ((isNs != 0) ? xmlSecNodeSetIndexHashNs(node, prefix) : xmlSecNodeSetIndexHashPtr(node));
+    for(pos &= bitmap->mask; ; pos = (pos + 1) & bitmap->mask) {
+        entry = &(bitmap->table[pos]);
+        if(entry->node == NULL) {
+            return(entry);
+        }
+        if((entry->node == node) && (entry->isNs == isNs) &&
+           ((isNs == 0) || xmlStrEqual(entry->prefix, prefix))) {
+            return(entry);
+        }
+    }
+}
+
+static xmlSecNodeSetBitmapEntryPtr
+xmlSecNodeSetBitmapAdd(xmlSecNodeSetBitmapPtr bitmap, xmlNodePtr node,
+                       const xmlChar* prefix, int isNs) {
+    xmlSecNodeSetBitmapEntryPtr entry;
+
+    xmlSecAssert2(bitmap != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    /* keep the table at most half full */
+    if((bitmap->table == NULL) || (2 * (bitmap->size + 1) > bitmap->mask + 1)) {
+        xmlSecNodeSetBitmapEntryPtr oldTable = bitmap->table;
+        xmlSecSize oldSize = (oldTable != NULL) ? (bitmap->mask + 1) : 0;
+        xmlSecSize newSize = (oldSize > 0) ? (2 * oldSize) : XMLSEC_NODESET_INDEX_MIN_SIZE;
+        xmlSecSize i;
+
+        bitmap->table = (xmlSecNodeSetBitmapEntryPtr)xmlMalloc(newSize * sizeof(xmlSecNodeSetBitmapEntry));
+        if(bitmap->table == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecNodeSetBitmapEntry), NULL);
+            bitmap->table = oldTable;
+            return(NULL);
+        }
+        memset(bitmap->table, 0, newSize * sizeof(xmlSecNodeSetBitmapEntry));
+        bitmap->mask = newSize - 1;
+
+        for(i = 0; i < oldSize; ++i) {
+            if(oldTable[i].node != NULL) {
+                entry = xmlSecNodeSetBitmapLookup(bitmap, oldTable[i].node,
+                                oldTable[i].prefix, oldTable[i].isNs);
+                (*entry) = oldTable[i];
+            }
+        }
+        if(oldTable != NULL) {
+            xmlFree(oldTable);
+        }
+    }
+
+    entry = xmlSecNodeSetBitmapLookup(bitmap, node, prefix, isNs);
+    xmlSecAssert2(entry != NULL, NULL);
+    xmlSecAssert2(entry->node == NULL, NULL);
+
+    entry->node   = node;
+    entry->prefix = prefix;
+    entry->isNs   = isNs;
+    entry->pos    = entry->end = bitmap->size++;
+    return(entry);
+}
+
+/* numbers the nodes in the same order as xmlSecNodeSetWalk() visits them */
+static int
+xmlSecNodeSetBitmapAddTree(xmlSecNodeSetBitmapPtr bitmap, xmlDocPtr doc, xmlNodePtr cur) {
+    xmlSecNodeSetBitmapEntryPtr entry;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(bitmap != NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+
+    entry = xmlSecNodeSetBitmapAdd(bitmap, cur, NULL, 0);
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecNodeSetBitmapAdd", NULL);
+        return(-1);
+    }
+    pos = entry->pos;
+
+    if(cur->type == XML_ELEMENT_NODE) {
+        xmlAttrPtr attr;
+        xmlNodePtr node;
+        xmlNsPtr ns;
+
+        for(node = cur; node != NULL; node = node->parent) {
+            for(ns = node->nsDef; ns != NULL; ns = ns->next) {
+                if(xmlSearchNs(doc, cur, ns->prefix) != ns) {
+                    continue;
+                }
+                entry = xmlSecNodeSetBitmapLookup(bitmap, cur, ns->prefix, 1);
+                if((entry != NULL) && (entry->node != NULL)) {
+                    continue;
+                }
+                if(xmlSecNodeSetBitmapAdd(bitmap, cur, ns->prefix, 1) == NULL) {
+                    xmlSecInternalError("xmlSecNodeSetBitmapAdd", NULL);
+                    return(-1);
+                }
+            }
+        }
+        for(attr = cur->properties; attr != NULL; attr = attr->next) {
+            if(xmlSecNodeSetBitmapAdd(bitmap, (xmlNodePtr)attr, NULL, 0) == NULL) {
+                xmlSecInternalError("xmlSecNodeSetBitmapAdd", NULL);
+                return(-1);
+            }
+        }
+        for(node = cur->children; node != NULL; node = node->next) {
+            ret = xmlSecNodeSetBitmapAddTree(bitmap, doc, node);
+            if(ret < 0) {
+                return(ret);
+            }
+        }
+
+        /* the table might be re-allocated */
+        entry = xmlSecNodeSetBitmapLookup(bitmap, cur, NULL, 0);
+        xmlSecAssert2((entry != NULL) && (entry->pos == pos), -1);
+        entry->end = bitmap->size - 1;
+    }
+    return(0);
+}
+
+static void
+xmlSecNodeSetBitmapSetRange(xmlSecNodeSetBitmapWord* words, xmlSecSize start, xmlSecSize end) {
+    xmlSecSize pos;
+
+    xmlSecAssert(words != NULL);
+
+    /* end is inclusive */
+    for(pos = start; (pos <= end) && ((pos % XMLSEC_NODESET_BITMAP_WORD_BITS) != 0); ++pos) {
+        xmlSecNodeSetBitmapSet(words, pos);
+    }
+    for(; pos + XMLSEC_NODESET_BITMAP_WORD_BITS <= end + 1; pos += XMLSEC_NODESET_BITMAP_WORD_BITS) {
+        words[pos / XMLSEC_NODESET_BITMAP_WORD_BITS] = ~((xmlSecNodeSetBitmapWord)0);
+    }
+    for(; pos <= end; ++pos) {
+        xmlSecNodeSetBitmapSet(words, pos);
+    }
+}
+
+static void
+xmlSecNodeSetBitmapFill(xmlSecNodeSetBitmapPtr bitmap, xmlSecNodeSetBitmapWord* words) {
+    xmlSecAssert(bitmap != NULL);
+    xmlSecAssert(words != NULL);
+
+    memset(words, 0, bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+    if(bitmap->size > 0) {
+        xmlSecNodeSetBitmapSetRange(words, 0, bitmap->size - 1);
+    }
+}
+
+static void
+xmlSecNodeSetBitmapInvert(xmlSecNodeSetBitmapPtr bitmap, xmlSecNodeSetBitmapWord* words) {
+    xmlSecSize i;
+
+    xmlSecAssert(bitmap != NULL);
+    xmlSecAssert(words != NULL);
+
+    for(i = 0; i < bitmap->wordsNum; ++i) {
+        words[i] = ~words[i];
+    }
+    /* clear the bits after the last node */
+    if((bitmap->size % XMLSEC_NODESET_BITMAP_WORD_BITS) != 0) {
+        words[bitmap->wordsNum - 1] &=
+            (((xmlSecNodeSetBitmapWord)1) << (bitmap->size % XMLSEC_NODESET_BITMAP_WORD_BITS)) - 1;
+    }
+}
+
+static int      xmlSecNodeSetBitmapMarkChain            (xmlSecNodeSetBitmapPtr bitmap,
+                                                         xmlSecNodeSetPtr nset,
+                                                         xmlSecNodeSetBitmapWord* res);
+
+static int
+xmlSecNodeSetBitmapMarkOne(xmlSecNodeSetBitmapPtr bitmap, xmlSecNodeSetPtr nset,
+                           xmlSecNodeSetBitmapWord* res) {
+    xmlSecNodeSetBitmapEntryPtr entry;
+    xmlNodePtr cur;
+    xmlSecSize i;
+    int tree = 0;
+    int invert = 0;
+    int withoutComments = 0;
+
+    xmlSecAssert2(bitmap != NULL, -1);
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    switch(nset->type) {
+    case xmlSecNodeSetNormal:
+        break;
+    case xmlSecNodeSetInvert:
+        invert = 1;
+        break;
+    case xmlSecNodeSetTree:
+        tree = 1;
+        break;
+    case xmlSecNodeSetTreeWithoutComments:
+        tree = withoutComments = 1;
+        break;
+    case xmlSecNodeSetTreeInvert:
+        tree = invert = 1;
+        break;
+    case xmlSecNodeSetTreeWithoutCommentsInvert:
+        tree = invert = withoutComments = 1;
+        break;
+    case xmlSecNodeSetList:
+        return(xmlSecNodeSetBitmapMarkChain(bitmap, nset->children, res));
+    default:
+        xmlSecInvalidIntegerTypeError("node set type", nset->type,
+                "supported nodeset type", NULL);
+        return(-1);
+    }
+
+    if(nset->nodes == NULL) {
+        /* all nodes are in the nodes list */
+        xmlSecNodeSetBitmapFill(bitmap, res);
+    } else {
+        memset(res, 0, bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+        for(i = 0; i < (xmlSecSize)nset->nodes->nodeNr; ++i) {
+            cur = nset->nodes->nodeTab[i];
+            if(cur == NULL) {
+                continue;
+            }
+            if(cur->type == XML_NAMESPACE_DECL) {
+                xmlNodePtr parent = (xmlNodePtr)(((xmlNsPtr)cur)->next);
+
+                if((parent == NULL) || (parent->type != XML_ELEMENT_NODE)) {
+                    continue;
+                }
+                entry = xmlSecNodeSetBitmapLookup(bitmap, parent, ((xmlNsPtr)cur)->prefix, 1);
+            } else {
+                entry = xmlSecNodeSetBitmapLookup(bitmap, cur, NULL, 0);
+            }
+            if((entry == NULL) || (entry->node == NULL)) {
+                /* not in the bitmap, it is checked against the chain */
+                continue;
+            }
+            if((tree != 0) && (cur->type == XML_ELEMENT_NODE)) {
+                xmlSecNodeSetBitmapSetRange(res, entry->pos, entry->end);
+            } else {
+                xmlSecNodeSetBitmapSet(res, entry->pos);
+            }
+        }
+    }
+
+    if(invert != 0) {
+        xmlSecNodeSetBitmapInvert(bitmap, res);
+    }
+    if(withoutComments != 0) {
+        for(i = 0; i < bitmap->wordsNum; ++i) {
+            res[i] &= ~(bitmap->comments[i]);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecNodeSetBitmapMarkChain(xmlSecNodeSetBitmapPtr bitmap, xmlSecNodeSetPtr nset,
+                             xmlSecNodeSetBitmapWord* res) {
+    xmlSecNodeSetBitmapWord* tmp;
+    xmlSecNodeSetPtr cur;
+    xmlSecSize i;
+    int ret;
+
+    xmlSecAssert2(bitmap != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    xmlSecNodeSetBitmapFill(bitmap, res);
+    if(nset == NULL) {
+        return(0);
+    }
+
+    tmp = (xmlSecNodeSetBitmapWord*)xmlMalloc(bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+    if(tmp == NULL) {
+        xmlSecMallocError(bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord), NULL);
+        return(-1);
+    }
+
+    cur = nset;
+    do {
+        ret = xmlSecNodeSetBitmapMarkOne(bitmap, cur, tmp);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetBitmapMarkOne", NULL);
+            xmlFree(tmp);
+            return(-1);
+        }
+
+        switch(cur->op) {
+        case xmlSecNodeSetIntersection:
+            for(i = 0; i < bitmap->wordsNum; ++i) {
+                res[i] &= tmp[i];
+            }
+            break;
+        case xmlSecNodeSetSubtraction:
+            for(i = 0; i < bitmap->wordsNum; ++i) {
+                res[i] &= ~tmp[i];
+            }
+            break;
+        case xmlSecNodeSetUnion:
+            for(i = 0; i < bitmap->wordsNum; ++i) {
+                res[i] |= tmp[i];
+            }
+            break;
+        default:
+            xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                              "node set operation=%d", (int)cur->op);
+            xmlFree(tmp);
+            return(-1);
+        }
+        cur = cur->next;
+    } while(cur != nset);
+
+    xmlFree(tmp);
+    return(0);
+}
+
+static xmlSecNodeSetBitmapPtr
+xmlSecNodeSetBitmapCreate(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetBitmapPtr bitmap;
+    xmlNodePtr cur;
+    xmlSecSize i;
+    int ret;
+
+    xmlSecAssert2(nset != NULL, NULL);
+    xmlSecAssert2(nset->doc != NULL, NULL);
+
+    bitmap = (xmlSecNodeSetBitmapPtr)xmlMalloc(sizeof(xmlSecNodeSetBitmap));
+    if(bitmap == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetBitmap), NULL);
+        return(NULL);
+    }
+    memset(bitmap, 0, sizeof(xmlSecNodeSetBitmap));
+
+    /* number all the document nodes */
+    for(cur = nset->doc->children; cur != NULL; cur = cur->next) {
+        ret = xmlSecNodeSetBitmapAddTree(bitmap, nset->doc, cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetBitmapAddTree", NULL);
+            xmlSecNodeSetBitmapDestroy(bitmap);
+            return(NULL);
+        }
+    }
+    if(bitmap->size == 0) {
+        /* nothing to do */
+        return(bitmap);
+    }
+    bitmap->wordsNum = xmlSecNodeSetBitmapWordsNum(bitmap->size);
+
+    bitmap->comments = (xmlSecNodeSetBitmapWord*)xmlMalloc(bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+    bitmap->words = (xmlSecNodeSetBitmapWord*)xmlMalloc(bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+    if((bitmap->comments == NULL) || (bitmap->words == NULL)) {
+        xmlSecMallocError(bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord), NULL);
+        xmlSecNodeSetBitmapDestroy(bitmap);
+        return(NULL);
+    }
+    memset(bitmap->comments, 0, bitmap->wordsNum * sizeof(xmlSecNodeSetBitmapWord));
+    for(i = 0; i <= bitmap->mask; ++i) {
+        if((bitmap->table[i].node != NULL) && (bitmap->table[i].isNs == 0) &&
+           (bitmap->table[i].node->type == XML_COMMENT_NODE)) {
+            xmlSecNodeSetBitmapSet(bitmap->comments, bitmap->table[i].pos);
+        }
+    }
+
+    /* and evaluate the chain */
+    ret = xmlSecNodeSetBitmapMarkChain(bitmap, nset, bitmap->words);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeSetBitmapMarkChain", NULL);
+        xmlSecNodeSetBitmapDestroy(bitmap);
+        return(NULL);
+    }
+    return(bitmap);
+}
+
+/* returns 1 or 0 if the node is in the bitmap or a negative value otherwise */
+static int
+xmlSecNodeSetBitmapContains(xmlSecNodeSetBitmapPtr bitmap, xmlNodePtr node, xmlNodePtr parent) {
+    xmlSecNodeSetBitmapEntryPtr entry;
+
+    xmlSecAssert2(bitmap != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(bitmap->table == NULL) {
+        return(-1);
+    }
+    if(node->type == XML_NAMESPACE_DECL) {
+        if((parent == NULL) || (parent->type != XML_ELEMENT_NODE)) {
+            return(-1);
+        }
+        entry = xmlSecNodeSetBitmapLookup(bitmap, parent, ((xmlNsPtr)node)->prefix, 1);
+    } else {
+        if(parent != node->parent) {
+            return(-1);
+        }
+        entry = xmlSecNodeSetBitmapLookup(bitmap, node, NULL, 0);
+    }
+    if((entry == NULL) || (entry->node == NULL)) {
+        return(-1);
+    }
+    return((xmlSecNodeSetBitmapTest(bitmap->words, entry->pos)) ? 1 : 0);
+}
+
 /**
  * xmlSecNodeSetCreate:
  * @doc:                the pointer to parent XML document.
@@ -86,9 +928,12 @@ xmlSecNodeSetDestroy(xmlSecNodeSetPtr nset) {
             nset = NULL;
         }
 
-        if(tmp->nodes != NULL) {
+        if((tmp->nodes != NULL) && !xmlSecNodeSetIsCompact(tmp)) {
             xmlXPathFreeNodeSet(tmp->nodes);
         }
+        if(tmp->index != NULL) {
+            xmlSecNodeSetIndexDestroy(tmp->index);
+        }
         if(tmp->children != NULL) {
             xmlSecNodeSetDestroy(tmp->children);
         }
@@ -142,26 +987,7 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
     }
 
     if(nset->nodes != NULL) {
-        if(node->type != XML_NAMESPACE_DECL) {
-            in_nodes_set = xmlXPathNodeSetContains(nset->nodes, node);
-        } else {
-            xmlNs ns;
-
-            memcpy(&ns, node, sizeof(ns));
-
-            /* this is a libxml hack! check xpath.c for details */
-            if((parent != NULL) && (parent->type == XML_ATTRIBUTE_NODE)) {
-                ns.next = (xmlNsPtr)parent->parent;
-            } else {
-                ns.next = (xmlNsPtr)parent;
-            }
-
-            /*
-             * If the input is an XPath node-set, then the node-set must explicitly
-             * contain every node to be rendered to the canonical form.
-             */
-            in_nodes_set = (xmlXPathNodeSetContains(nset->nodes, (xmlNodePtr)&ns));
-        }
+        in_nodes_set = xmlSecNodeSetNodesContain(nset, node, parent);
     }
 
     switch(nset->type) {
@@ -175,7 +1001,7 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
             return(1);
         }
         if((parent != NULL) && (parent->type == XML_ELEMENT_NODE)) {
-            return(xmlSecNodeSetOneContains(nset, parent, parent->parent));
+            return(xmlSecNodeSetTreeContainsAncestor(nset, parent));
         }
         return(0);
     case xmlSecNodeSetTreeInvert:
@@ -184,7 +1010,7 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
             return(0);
         }
         if((parent != NULL) && (parent->type == XML_ELEMENT_NODE)) {
-            return(xmlSecNodeSetOneContains(nset, parent, parent->parent));
+            return(xmlSecNodeSetTreeContainsAncestor(nset, parent));
         }
         return(1);
     default:
@@ -201,7 +1027,9 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
  * @node:               the pointer to XML node to check.
  * @parent:             the pointer to @node parent node.
  *
- * Checks whether the @node is in the nodes set or not.
+ * Checks whether the @node is in the nodes set or not. The first call
+ * might build the @nset lookup index, thus @nset must not be checked
+ * from several threads at once.
  *
  * Returns: 1 if the @node is in the nodes set @nset, 0 if it is not
  * and a negative value if an error occurs.
@@ -217,6 +1045,12 @@ xmlSecNodeSetContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent)
     if(nset == NULL) {
         return(1);
     }
+    if((nset->index != NULL) && (nset->index->bitmap != NULL)) {
+        status = xmlSecNodeSetBitmapContains(nset->index->bitmap, node, parent);
+        if(status >= 0) {
+            return(status);
+        }
+    }
 
     status = 1;
     cur = nset;
@@ -265,6 +1099,10 @@ xmlSecNodeSetAdd(xmlSecNodeSetPtr nset, xmlSecNodeSetPtr newNSet,
     xmlSecAssert2(newNSet != NULL, NULL);
     xmlSecAssert2(newNSet->next == newNSet, NULL);
 
+    /* the materialized chains are not valid anymore */
+    xmlSecNodeSetDropBitmap(newNSet);
+    xmlSecNodeSetDropBitmap(nset);
+
     newNSet->op = op;
     if(nset == NULL) {
         return(newNSet);
@@ -314,6 +1152,59 @@ xmlSecNodeSetAddList(xmlSecNodeSetPtr nset, xmlSecNodeSetPtr newNSet, xmlSecNode
 }
 
 
+/**
+ * xmlSecNodeSetMaterialize:
+ * @nset:               the pointer to nodes set.
+ *
+ * Evaluates the nodes sets chain @nset (including all the children
+ * nodes sets lists) once for all the document nodes and stores the
+ * result as a document order bitmap. The following #xmlSecNodeSetContains
+ * calls for @nset do not walk the chain. The result is discarded when
+ * @nset is changed with #xmlSecNodeSetAdd or #xmlSecNodeSetAddList.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecNodeSetMaterialize(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetIndexPtr index;
+    xmlSecNodeSetBitmapPtr bitmap;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(nset->doc != NULL, -1);
+
+    index = xmlSecNodeSetGetIndex(nset);
+    if(index == NULL) {
+        xmlSecInternalError("xmlSecNodeSetGetIndex", NULL);
+        return(-1);
+    }
+
+    bitmap = xmlSecNodeSetBitmapCreate(nset);
+    if(bitmap == NULL) {
+        xmlSecInternalError("xmlSecNodeSetBitmapCreate", NULL);
+        return(-1);
+    }
+
+    if(index->bitmap != NULL) {
+        xmlSecNodeSetBitmapDestroy(index->bitmap);
+    }
+    index->bitmap = bitmap;
+    return(0);
+}
+
+static void
+xmlSecNodeSetDropBitmap(xmlSecNodeSetPtr nset) {
+    xmlSecNodeSetIndexPtr index;
+
+    if((nset == NULL) || (nset->index == NULL)) {
+        return;
+    }
+    index = nset->index;
+    if(index->bitmap != NULL) {
+        xmlSecNodeSetBitmapDestroy(index->bitmap);
+        index->bitmap = NULL;
+    }
+}
+
 /**
  * xmlSecNodeSetWalk:
  * @nset:               the pointer to node set.
@@ -328,6 +1219,7 @@ xmlSecNodeSetAddList(xmlSecNodeSetPtr nset, xmlSecNodeSetPtr newNSet, xmlSecNode
  */
 int
 xmlSecNodeSetWalk(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc, void* data) {
+    xmlSecNodeSetNsStack nsStack;
     xmlNodePtr cur;
     int ret = 0;
 
@@ -335,6 +1227,8 @@ xmlSecNodeSetWalk(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc, voi
     xmlSecAssert2(nset->doc != NULL, -1);
     xmlSecAssert2(walkFunc != NULL, -1);
 
+    memset(&nsStack, 0, sizeof(nsStack));
+
     /* special cases */
     if(nset->nodes != NULL) {
         int i;
@@ -344,9 +1238,13 @@ xmlSecNodeSetWalk(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc, voi
         case xmlSecNodeSetTree:
         case xmlSecNodeSetTreeWithoutComments:
             for(i = 0; (ret >= 0) && (i < nset->nodes->nodeNr); ++i) {
-                ret = xmlSecNodeSetWalkRecursive(nset, walkFunc, data,
+                ret = xmlSecNodeSetWalkTree(nset, walkFunc, data,
                     nset->nodes->nodeTab[i],
-                    xmlSecGetParent(nset->nodes->nodeTab[i]));
+                    xmlSecGetParent(nset->nodes->nodeTab[i]),
+                    &nsStack);
+            }
+            if(nsStack.tab != NULL) {
+                xmlFree(nsStack.tab);
             }
             return(ret);
         default:
@@ -355,77 +1253,260 @@ xmlSecNodeSetWalk(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc, voi
     }
 
     for(cur = nset->doc->children; (cur != NULL) && (ret >= 0); cur = cur->next) {
-        ret = xmlSecNodeSetWalkRecursive(nset, walkFunc, data, cur, xmlSecGetParent(cur));
+        ret = xmlSecNodeSetWalkTree(nset, walkFunc, data, cur, xmlSecGetParent(cur), &nsStack);
+    }
+    if(nsStack.tab != NULL) {
+        xmlFree(nsStack.tab);
     }
     return(ret);
 }
 
 static int
-xmlSecNodeSetWalkRecursive(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc,
-                            void* data, xmlNodePtr cur, xmlNodePtr parent) {
+xmlSecNodeSetNsStackReserve(xmlSecNodeSetNsStackPtr nsStack, xmlSecSize size) {
+    xmlNsPtr* newTab;
+    xmlSecSize newMax;
+
+    xmlSecAssert2(nsStack != NULL, -1);
+
+    if(nsStack->size + size <= nsStack->max) {
+        return(0);
+    }
+    for(newMax = (nsStack->max > 0) ? (2 * nsStack->max) : 16; newMax < nsStack->size + size; newMax *= 2);
+
+    newTab = (xmlNsPtr*)xmlRealloc(nsStack->tab, newMax * sizeof(xmlNsPtr));
+    if(newTab == NULL) {
+        xmlSecMallocError(newMax * sizeof(xmlNsPtr), NULL);
+        return(-1);
+    }
+    nsStack->tab = newTab;
+    nsStack->max = newMax;
+    return(0);
+}
+
+/* returns the namespaces declared on the element or the document (the xml namespace) @node */
+static xmlNsPtr
+xmlSecNodeSetNsStackGetNsList(xmlNodePtr node) {
+    xmlSecAssert2(node != NULL, NULL);
+
+    switch(node->type) {
+    case XML_ELEMENT_NODE:
+        return(node->nsDef);
+    case XML_DOCUMENT_NODE:
+    case XML_HTML_DOCUMENT_NODE:
+        return(((xmlDocPtr)node)->oldNs);
+    default:
+        return(NULL);
+    }
+}
+
+/* pushes @node namespaces declarations, the first one ends up on the top */
+static int
+xmlSecNodeSetNsStackPush(xmlSecNodeSetNsStackPtr nsStack, xmlNodePtr node) {
+    xmlNsPtr ns;
+    xmlSecSize size, pos;
+
+    xmlSecAssert2(nsStack != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    for(size = 0, ns = xmlSecNodeSetNsStackGetNsList(node); ns != NULL; ns = ns->next) {
+        ++size;
+    }
+    if(size == 0) {
+        return(0);
+    }
+    if(xmlSecNodeSetNsStackReserve(nsStack, size) < 0) {
+        xmlSecInternalError("xmlSecNodeSetNsStackReserve", NULL);
+        return(-1);
+    }
+    for(pos = nsStack->size + size, ns = xmlSecNodeSetNsStackGetNsList(node); ns != NULL; ns = ns->next) {
+        nsStack->tab[--pos] = ns;
+    }
+    nsStack->size += size;
+    return(0);
+}
+
+static void
+xmlSecNodeSetNsStackPop(xmlSecNodeSetNsStackPtr nsStack, xmlNodePtr node) {
+    xmlNsPtr ns;
+
+    xmlSecAssert(nsStack != NULL);
+    xmlSecAssert(node != NULL);
+
+    for(ns = xmlSecNodeSetNsStackGetNsList(node); ns != NULL; ns = ns->next) {
+        xmlSecAssert(nsStack->size > 0);
+        --nsStack->size;
+    }
+}
+
+/* puts the namespaces declared on the @node ancestors to the stack */
+static int
+xmlSecNodeSetNsStackInit(xmlSecNodeSetNsStackPtr nsStack, xmlNodePtr node) {
+    xmlNodePtr cur;
+    xmlNsPtr ns;
+    xmlSecSize size, pos;
+
+    xmlSecAssert2(nsStack != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    nsStack->size = 0;
+    if(node->type == XML_NAMESPACE_DECL) {
+        return(0);
+    }
+    for(size = 0, cur = node->parent; cur != NULL; cur = cur->parent) {
+        for(ns = xmlSecNodeSetNsStackGetNsList(cur); ns != NULL; ns = ns->next) {
+            ++size;
+        }
+    }
+    if(size == 0) {
+        return(0);
+    }
+    if(xmlSecNodeSetNsStackReserve(nsStack, size) < 0) {
+        xmlSecInternalError("xmlSecNodeSetNsStackReserve", NULL);
+        return(-1);
+    }
+
+    /* the closest ancestor is on the top */
+    for(pos = size, cur = node->parent; cur != NULL; cur = cur->parent) {
+        for(ns = xmlSecNodeSetNsStackGetNsList(cur); ns != NULL; ns = ns->next) {
+            nsStack->tab[--pos] = ns;
+        }
+    }
+    nsStack->size = size;
+    return(0);
+}
+
+/* the same check as in xmlSearchNs(): returns 1 if @ns is not hidden by the closer declarations */
+static int
+xmlSecNodeSetNsStackIsVisible(xmlSecNodeSetNsStackPtr nsStack, xmlSecSize pos, xmlDocPtr doc) {
+    xmlNsPtr ns, other;
+    xmlSecSize ii;
+
+    xmlSecAssert2(nsStack != NULL, 0);
+    xmlSecAssert2(pos < nsStack->size, 0);
+    xmlSecAssert2(doc != NULL, 0);
+
+    ns = nsStack->tab[pos];
+    if((ns->prefix != NULL) && xmlStrEqual(ns->prefix, BAD_CAST "xml")) {
+        /* xmlSearchNs() always returns the document's xml namespace */
+        return((ns == doc->oldNs) ? 1 : 0);
+    }
+    for(ii = pos + 1; ii < nsStack->size; ++ii) {
+        other = nsStack->tab[ii];
+        if(ns->prefix == NULL) {
+            if((other->prefix == NULL) && (other->href != NULL)) {
+                return(0);
+            }
+        } else if((other->prefix != NULL) && xmlStrEqual(other->prefix, ns->prefix)) {
+            return(0);
+        }
+    }
+    return(1);
+}
+
+/* attributes and visible namespaces of the element @cur */
+static int
+xmlSecNodeSetWalkElement(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc,
+                         void* data, xmlNodePtr cur, xmlSecNodeSetNsStackPtr nsStack) {
+    xmlAttrPtr attr;
+    xmlSecSize pos;
     int ret;
 
     xmlSecAssert2(nset != NULL, -1);
-    xmlSecAssert2(cur != NULL, -1);
     xmlSecAssert2(walkFunc != NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2(nsStack != NULL, -1);
 
-    /* the node itself */
-    if(xmlSecNodeSetContains(nset, cur, parent)) {
-        ret = walkFunc(nset, cur, parent, data);
-
-        if(ret < 0) {
-            return(ret);
+    for(attr = cur->properties; attr != NULL; attr = attr->next) {
+        if(xmlSecNodeSetContains(nset, (xmlNodePtr)attr, cur)) {
+            ret = walkFunc(nset, (xmlNodePtr)attr, cur, data);
+            if(ret < 0) {
+                return(ret);
+            }
         }
     }
 
-    /* element node has attributes, namespaces  */
-    if(cur->type == XML_ELEMENT_NODE) {
-        xmlAttrPtr attr;
-        xmlNodePtr node;
-        xmlNsPtr ns, tmp;
-
-        attr = (xmlAttrPtr)cur->properties;
-        while(attr != NULL) {
-            if(xmlSecNodeSetContains(nset, (xmlNodePtr)attr, cur)) {
-                ret = walkFunc(nset, (xmlNodePtr)attr, cur, data);
-                if(ret < 0) {
-                    return(ret);
-                }
-            }
-            attr = attr->next;
-        }
-
-        node = cur;
-        while(node != NULL) {
-            ns = node->nsDef;
-            while(ns != NULL) {
-                tmp = xmlSearchNs(nset->doc, cur, ns->prefix);
-                if((tmp == ns) && xmlSecNodeSetContains(nset, (xmlNodePtr)ns, cur)) {
-                    ret = walkFunc(nset, (xmlNodePtr)ns, cur, data);
-                    if(ret < 0) {
-                        return(ret);
-                    }
-                }
-                ns = ns->next;
+    /* from the closest declaration to the farthest one */
+    for(pos = nsStack->size; pos > 0; --pos) {
+        if((xmlSecNodeSetNsStackIsVisible(nsStack, pos - 1, nset->doc) == 1) &&
+           xmlSecNodeSetContains(nset, (xmlNodePtr)nsStack->tab[pos - 1], cur)) {
+            ret = walkFunc(nset, (xmlNodePtr)nsStack->tab[pos - 1], cur, data);
+            if(ret < 0) {
+                return(ret);
             }
-            node = node->parent;
         }
     }
+    return(0);
+}
 
-    /* element and document nodes have children */
-    if((cur->type == XML_ELEMENT_NODE) || (cur->type == XML_DOCUMENT_NODE)) {
-        xmlNodePtr node;
+/*
+ * Visits @root and all its descendants in the document order without
+ * recursion: the tree is walked using the parent links and the namespaces
+ * in scope are kept in @nsStack, so each element is handled in time
+ * proportional to its own attributes and the namespaces in scope.
+ */
+static int
+xmlSecNodeSetWalkTree(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walkFunc,
+                      void* data, xmlNodePtr root, xmlNodePtr rootParent,
+                      xmlSecNodeSetNsStackPtr nsStack) {
+    xmlNodePtr cur, parent;
+    int ret;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(walkFunc != NULL, -1);
+    xmlSecAssert2(root != NULL, -1);
+    xmlSecAssert2(nsStack != NULL, -1);
+
+    ret = xmlSecNodeSetNsStackInit(nsStack, root);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeSetNsStackInit", NULL);
+        return(-1);
+    }
+
+    cur = root;
+    parent = rootParent;
+    while(1) {
+        /* the node itself */
+        if(xmlSecNodeSetContains(nset, cur, parent)) {
+            ret = walkFunc(nset, cur, parent, data);
+            if(ret < 0) {
+                return(ret);
+            }
+        }
 
-        node = cur->children;
-        while(node != NULL) {
-            ret = xmlSecNodeSetWalkRecursive(nset, walkFunc, data, node, cur);
+        /* element node has attributes, namespaces  */
+        ret = xmlSecNodeSetNsStackPush(nsStack, cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetNsStackPush", NULL);
+            return(-1);
+        }
+        if(cur->type == XML_ELEMENT_NODE) {
+            ret = xmlSecNodeSetWalkElement(nset, walkFunc, data, cur, nsStack);
             if(ret < 0) {
                 return(ret);
             }
-            node = node->next;
+        }
+
+        /* element and document nodes have children */
+        if(((cur->type == XML_ELEMENT_NODE) || (cur->type == XML_DOCUMENT_NODE)) && (cur->children != NULL)) {
+            parent = cur;
+            cur = cur->children;
+            continue;
+        }
+
+        /* go to the next sibling of the node or of its closest ancestor */
+        while(1) {
+            xmlSecNodeSetNsStackPop(nsStack, cur);
+            if(cur == root) {
+                return(0);
+            }
+            if(cur->next != NULL) {
+                cur = cur->next;
+                break;
+            }
+            cur = parent;
+            parent = (cur != root) ? cur->parent : rootParent;
         }
     }
-    return(0);
 }
 
 /**
@@ -446,16 +1527,35 @@ xmlSecNodeSetWalkRecursive(xmlSecNodeSetPtr nset, xmlSecNodeSetWalkCallback walk
  *    all nodes in the @doc except nodes in the @parent subtree
  *    and comment nodes.
  *
+ * The nodes list of the returned nodes set can not be modified.
+ *
  * Returns: pointer to the newly created #xmlSecNodeSet structure
  * or NULL if an error occurs.
  */
 xmlSecNodeSetPtr
 xmlSecNodeSetGetChildren(xmlDocPtr doc, const xmlNodePtr parent, int withComments, int invert) {
+    xmlSecNodeSetPtr nset;
     xmlNodeSetPtr nodes;
     xmlSecNodeSetType type;
 
     xmlSecAssert2(doc != NULL, NULL);
 
+    if(withComments && invert) {
+        type = xmlSecNodeSetTreeInvert;
+    } else if(withComments && !invert) {
+        type = xmlSecNodeSetTree;
+    } else if(!withComments && invert) {
+        type = xmlSecNodeSetTreeWithoutCommentsInvert;
+    } else { /* if(!withComments && !invert) */
+        type = xmlSecNodeSetTreeWithoutComments;
+    }
+
+    /* the common cases: a few roots stored inline */
+    nset = xmlSecNodeSetCompactCreate(doc, parent, withComments, type);
+    if(nset != NULL) {
+        return(nset);
+    }
+
     nodes = xmlXPathNodeSetCreate(parent);
     if(nodes == NULL) {
         xmlSecXmlError("xmlXPathNodeSetCreate", NULL);
@@ -472,17 +1572,97 @@ xmlSecNodeSetGetChildren(xmlDocPtr doc, const xmlNodePtr parent, int withComment
         }
     }
 
-    if(withComments && invert) {
-        type = xmlSecNodeSetTreeInvert;
-    } else if(withComments && !invert) {
-        type = xmlSecNodeSetTree;
-    } else if(!withComments && invert) {
-        type = xmlSecNodeSetTreeWithoutCommentsInvert;
-    } else { /* if(!withComments && !invert) */
-        type = xmlSecNodeSetTreeWithoutComments;
+    nset = xmlSecNodeSetCreate(doc, nodes, type);
+    if(nset == NULL) {
+        xmlSecInternalError("xmlSecNodeSetCreate", NULL);
+        xmlXPathFreeNodeSet(nodes);
+        return(NULL);
+    }
+    return(nset);
+}
+
+static xmlSecNodeSetPtr
+xmlSecNodeSetCompactCreate(xmlDocPtr doc, xmlNodePtr parent, int withComments, xmlSecNodeSetType type) {
+    xmlSecNodeSetCompactPtr compact;
+    xmlNodePtr roots[XMLSEC_NODESET_COMPACT_MAX_ROOTS];
+    xmlNodePtr cur;
+    int rootsNr = 0;
+
+    xmlSecAssert2(doc != NULL, NULL);
+
+    /* the namespace nodes are copied by libxml, use the generic nodes list */
+    if(parent != NULL) {
+        if(parent->type == XML_NAMESPACE_DECL) {
+            return(NULL);
+        }
+        roots[rootsNr++] = parent;
+    } else {
+        for(cur = doc->children; cur != NULL; cur = cur->next) {
+            if(!withComments && (cur->type == XML_COMMENT_NODE)) {
+                continue;
+            }
+            if(rootsNr >= XMLSEC_NODESET_COMPACT_MAX_ROOTS) {
+                return(NULL);
+            }
+            roots[rootsNr++] = cur;
+        }
+    }
+
+    compact = (xmlSecNodeSetCompactPtr)xmlMalloc(sizeof(xmlSecNodeSetCompact));
+    if(compact == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetCompact), NULL);
+        return(NULL);
+    }
+    memset(compact, 0, sizeof(xmlSecNodeSetCompact));
+    memcpy(compact->nodeTab, roots, sizeof(xmlNodePtr) * rootsNr);
+
+    compact->nodes.nodeNr   = rootsNr;
+    compact->nodes.nodeMax  = rootsNr;
+    compact->nodes.nodeTab  = compact->nodeTab;
+
+    compact->nset.doc       = doc;
+    compact->nset.nodes     = &(compact->nodes);
+    compact->nset.type      = type;
+    compact->nset.next      = compact->nset.prev = &(compact->nset);
+    return(&(compact->nset));
+}
+
+/* returns -1 if the element is too deep to check without the memo */
+static int
+xmlSecNodeSetCompactContainsAncestor(xmlSecNodeSetPtr nset, xmlNodePtr node) {
+    xmlNodePtr cur;
+    int depth, ii;
+    int inTree = 0;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(nset->nodes != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    for(cur = node, depth = 0; (cur != NULL) && (cur->type == XML_ELEMENT_NODE); cur = cur->parent, ++depth) {
+        if(depth >= XMLSEC_NODESET_COMPACT_MAX_DEPTH) {
+            return(-1);
+        }
+        for(ii = 0; ii < nset->nodes->nodeNr; ++ii) {
+            if(nset->nodes->nodeTab[ii] == cur) {
+                inTree = 1;
+                break;
+            }
+        }
+        if(inTree) {
+            break;
+        }
     }
 
-    return(xmlSecNodeSetCreate(doc, nodes, type));
+    switch(nset->type) {
+    case xmlSecNodeSetTree:
+    case xmlSecNodeSetTreeWithoutComments:
+        return(inTree);
+    case xmlSecNodeSetTreeInvert:
+    case xmlSecNodeSetTreeWithoutCommentsInvert:
+        return(!inTree);
+    default:
+        return(-1);
+    }
 }
 
 static int
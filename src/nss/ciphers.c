@@ -20,8 +20,10 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/nss/crypto.h>
+#include "pk11_pool.h"
 
 #define XMLSEC_NSS_MAX_KEY_SIZE         32
 #define XMLSEC_NSS_MAX_IV_SIZE          32
@@ -74,7 +76,6 @@ xmlSecNssBlockCipherCtxInit(xmlSecNssBlockCipherCtxPtr ctx,
     PK11SlotInfo* slot;
     PK11SymKey* symKey;
     int ivLen;
-    SECStatus rv;
     int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
@@ -92,10 +93,10 @@ xmlSecNssBlockCipherCtxInit(xmlSecNssBlockCipherCtxPtr ctx,
 
     if(encrypt) {
         /* generate random iv */
-        rv = PK11_GenerateRandom(ctx->iv, ivLen);
-        if(rv != SECSuccess) {
-            xmlSecNssError2("PK11_GenerateRandom", cipherName,
-                            "size=%d", ivLen);
+        ret = xmlSecRandomGenerate(xmlSecNssGenerateRandomBytes, NULL, ctx->iv, (xmlSecSize)ivLen);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecRandomGenerate", cipherName,
+                                 "size=%d", ivLen);
             return(-1);
         }
 
@@ -134,9 +135,9 @@ xmlSecNssBlockCipherCtxInit(xmlSecNssBlockCipherCtxPtr ctx,
     ivItem.data = ctx->iv;
     ivItem.len  = ctx->ivSize;
 
-    slot = PK11_GetBestSlot(ctx->cipher, NULL);
+    slot = xmlSecNssPk11GetBestSlot(ctx->cipher);
     if(slot == NULL) {
-        xmlSecNssError("PK11_GetBestSlot", cipherName);
+        xmlSecInternalError("xmlSecNssPk11GetBestSlot", cipherName);
         return(-1);
     }
 
@@ -281,10 +282,10 @@ xmlSecNssBlockCipherCtxFinal(xmlSecNssBlockCipherCtxPtr ctx,
 
         /* generate random padding */
         if((xmlSecSize)blockLen > (inSize + 1)) {
-            rv = PK11_GenerateRandom(inBuf + inSize, blockLen - inSize - 1);
-            if(rv != SECSuccess) {
-                xmlSecNssError2("PK11_GenerateRandom", cipherName,
-                                "size=%d", ((int)blockLen - inSize - 1));
+            ret = xmlSecRandomGenerate(xmlSecNssGenerateRandomBytes, NULL, inBuf + inSize, blockLen - inSize - 1);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecRandomGenerate", cipherName,
+                                     "size=%d", ((int)blockLen - inSize - 1));
                 return(-1);
             }
         }
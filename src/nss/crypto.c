@@ -23,10 +23,12 @@
 #include <xmlsec/errors.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/private.h>
+#include <xmlsec/random.h>
 #include <xmlsec/xmltree.h>
 
 #include <xmlsec/nss/app.h>
 #include <xmlsec/nss/crypto.h>
+#include "pk11_pool.h"
 #include <xmlsec/nss/x509.h>
 
 static xmlSecCryptoDLFunctionsPtr gXmlSecNssFunctions = NULL;
@@ -280,6 +282,9 @@ xmlSecNssInit (void)  {
     /* set default errors callback for xmlsec to us */
     xmlSecErrorsSetCallback(xmlSecNssErrorsDefaultCallback);
 
+    /* pooled digest contexts and cached slots */
+    xmlSecNssPk11PoolInitialize();
+
     /* register our klasses */
     if(xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(xmlSecCryptoGetFunctions_nss()) < 0) {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
@@ -298,6 +303,7 @@ xmlSecNssInit (void)  {
  */
 int
 xmlSecNssShutdown(void) {
+    xmlSecNssPk11PoolShutdown();
     return(0);
 }
 
@@ -382,13 +388,13 @@ xmlSecNssGetInternalKeySlot()
  * @buffer:             the destination buffer.
  * @size:               the numer of bytes to generate.
  *
- * Generates @size random bytes and puts result in @buffer.
+ * Generates @size random bytes and puts result in @buffer
+ * (see #xmlSecRandomGenerate).
  *
  * Returns: 0 on success or a negative value otherwise.
  */
 int
 xmlSecNssGenerateRandom(xmlSecBufferPtr buffer, xmlSecSize size) {
-    SECStatus rv;
     int ret;
 
     xmlSecAssert2(buffer != NULL, -1);
@@ -401,10 +407,35 @@ xmlSecNssGenerateRandom(xmlSecBufferPtr buffer, xmlSecSize size) {
     }
 
     /* get random data */
-    rv = PK11_GenerateRandom((xmlSecByte*)xmlSecBufferGetData(buffer), size);
+    ret = xmlSecRandomGenerate(xmlSecNssGenerateRandomBytes, NULL,
+                               xmlSecBufferGetData(buffer), size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL, "size=%d", size);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecNssGenerateRandomBytes:
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ * @context:            not used.
+ *
+ * The NSS random generator for #xmlSecRandomGenerate.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecNssGenerateRandomBytes(xmlSecByte* out, xmlSecSize outSize, void* context ATTRIBUTE_UNUSED) {
+    SECStatus rv;
+
+    xmlSecAssert2(out != NULL, -1);
+
+    rv = PK11_GenerateRandom(out, outSize);
     if(rv != SECSuccess) {
         xmlSecNssError2("PK11_GenerateRandom", NULL,
-                        "size=%lu", (unsigned long)size);
+                        "size=%lu", (unsigned long)outSize);
         return(-1);
     }
     return(0);
@@ -23,6 +23,7 @@
 
 #include <xmlsec/nss/app.h>
 #include <xmlsec/nss/crypto.h>
+#include "pk11_pool.h"
 
 #define XMLSEC_NSS_MAX_DIGEST_SIZE              64
 
@@ -163,9 +164,9 @@ xmlSecNssDigestInitialize(xmlSecTransformPtr transform) {
         return(-1);
     }
 
-    ctx->digestCtx = PK11_CreateDigestContext(ctx->digest->offset);
+    ctx->digestCtx = xmlSecNssPk11DigestCtxAcquire(ctx->digest->offset);
     if(ctx->digestCtx == NULL) {
-        xmlSecNssError("PK11_CreateDigestContext", xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecNssPk11DigestCtxAcquire", xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -183,7 +184,8 @@ xmlSecNssDigestFinalize(xmlSecTransformPtr transform) {
     xmlSecAssert(ctx != NULL);
 
     if(ctx->digestCtx != NULL) {
-        PK11_DestroyContext(ctx->digestCtx, PR_TRUE);
+        xmlSecAssert(ctx->digest != NULL);
+        xmlSecNssPk11DigestCtxRelease(ctx->digest->offset, ctx->digestCtx);
     }
     memset(ctx, 0, sizeof(xmlSecNssDigestCtx));
 }
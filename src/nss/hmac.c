@@ -25,6 +25,7 @@
 
 #include <xmlsec/nss/app.h>
 #include <xmlsec/nss/crypto.h>
+#include "pk11_pool.h"
 
 /* sizes in bits */
 #define XMLSEC_NSS_MIN_HMAC_SIZE                80
@@ -355,9 +356,9 @@ xmlSecNssHmacSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
     keyItem.data = xmlSecBufferGetData(buffer);
     keyItem.len  = xmlSecBufferGetSize(buffer);
 
-    slot = PK11_GetBestSlot(ctx->digestType, NULL);
+    slot = xmlSecNssPk11GetBestSlot(ctx->digestType);
     if(slot == NULL) {
-        xmlSecNssError("PK11_GetBestSlot", xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecNssPk11GetBestSlot", xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <nss.h>
 #include <cert.h>
@@ -27,6 +28,8 @@
 #include <keyhi.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/buffer.h>
@@ -45,15 +48,48 @@
  *
  * Nss Keys Store. Uses Simple Keys Store under the hood
  *
- * Simple Keys Store ptr is located after xmlSecKeyStore
+ * Nss Keys Store ctx is located after xmlSecKeyStore, Simple Keys Store
+ * ptr is the first member of the ctx
  *
  ***************************************************************************/
+/**
+ * XMLSEC_NSS_KEYS_STORE_CACHE_SIZE:
+ *
+ * The max number of the NSS DB lookup results (found keys and misses)
+ * remembered by the NSS keys store.
+ */
+#define XMLSEC_NSS_KEYS_STORE_CACHE_SIZE                256
+
+/**
+ * XMLSEC_NSS_KEYS_STORE_CACHE_TTL:
+ *
+ * The NSS DB lookup results time to live (in seconds): the certificates
+ * added to or removed from the NSS DB are picked up after that.
+ */
+#define XMLSEC_NSS_KEYS_STORE_CACHE_TTL                 60
+
+typedef struct _xmlSecNssKeysStoreCacheItem {
+    xmlSecKeyPtr                key;            /* NULL if the key is not in the NSS DB */
+    time_t                      expires;
+} xmlSecNssKeysStoreCacheItem, *xmlSecNssKeysStoreCacheItemPtr;
+
+typedef struct _xmlSecNssKeysStoreCtx {
+    xmlSecKeyStorePtr           ss;             /* must be the first */
+    xmlHashTablePtr             cache;          /* "<keyType>:<name>" -> cache item */
+    xmlMutexPtr                 cacheMutex;     /* protects the cache */
+} xmlSecNssKeysStoreCtx, *xmlSecNssKeysStoreCtxPtr;
+
 #define xmlSecNssKeysStoreSize \
-        (sizeof(xmlSecKeyStore) + sizeof(xmlSecKeyStorePtr))
+        (sizeof(xmlSecKeyStore) + sizeof(xmlSecNssKeysStoreCtx))
+
+#define xmlSecNssKeysStoreGetCtx(store) \
+    ((xmlSecKeyStoreCheckSize((store), xmlSecNssKeysStoreSize)) ? \
+     (xmlSecNssKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+     (xmlSecNssKeysStoreCtxPtr)NULL)
 
 #define xmlSecNssKeysStoreGetSS(store) \
     ((xmlSecKeyStoreCheckSize((store), xmlSecNssKeysStoreSize)) ? \
-     (xmlSecKeyStorePtr*)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+     &(((xmlSecNssKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)))->ss) : \
      (xmlSecKeyStorePtr*)NULL)
 
 static int                      xmlSecNssKeysStoreInitialize    (xmlSecKeyStorePtr store);
@@ -62,6 +98,15 @@ static xmlSecKeyPtr             xmlSecNssKeysStoreFindKey       (xmlSecKeyStoreP
                                                                  const xmlChar* name,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
 
+static xmlChar*                 xmlSecNssKeysStoreCacheGetName  (const xmlChar* name,
+                                                                 xmlSecKeyDataType keyType);
+static int                      xmlSecNssKeysStoreCacheFind     (xmlSecNssKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* cacheName,
+                                                                 xmlSecKeyPtr* key);
+static void                     xmlSecNssKeysStoreCacheAdd      (xmlSecNssKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* cacheName,
+                                                                 xmlSecKeyPtr key);
+
 static xmlSecKeyStoreKlass xmlSecNssKeysStoreKlass = {
     sizeof(xmlSecKeyStoreKlass),
     xmlSecNssKeysStoreSize,
@@ -239,41 +284,212 @@ xmlSecNssKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyD
     return (xmlSecSimpleKeysStoreSave(*ss, filename, type));
 }
 
+static void
+xmlSecNssKeysStoreCacheItemDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    xmlSecNssKeysStoreCacheItemPtr item = (xmlSecNssKeysStoreCacheItemPtr)payload;
+
+    if(item != NULL) {
+        if(item->key != NULL) {
+            xmlSecKeyDestroy(item->key);
+        }
+        xmlFree(item);
+    }
+}
+
+/**
+ * xmlSecNssKeysStoreInvalidateCache:
+ * @store:              the pointer to Nss keys store.
+ *
+ * Drops the remembered NSS DB lookup results (both the found keys and the
+ * misses). The results expire on their own after
+ * #XMLSEC_NSS_KEYS_STORE_CACHE_TTL seconds, the application should call
+ * this function to pick up the NSS DB changes immediately.
+ */
+void
+xmlSecNssKeysStoreInvalidateCache(xmlSecKeyStorePtr store) {
+    xmlSecNssKeysStoreCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecNssKeysStoreId));
+
+    ctx = xmlSecNssKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->cacheMutex != NULL);
+
+    xmlMutexLock(ctx->cacheMutex);
+    if(ctx->cache != NULL) {
+        xmlHashFree(ctx->cache, xmlSecNssKeysStoreCacheItemDestroy);
+        ctx->cache = NULL;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+}
+
 static int
 xmlSecNssKeysStoreInitialize(xmlSecKeyStorePtr store) {
-    xmlSecKeyStorePtr *ss;
+    xmlSecNssKeysStoreCtxPtr ctx;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecNssKeysStoreId), -1);
 
-    ss = xmlSecNssKeysStoreGetSS(store);
-    xmlSecAssert2(((ss == NULL) || (*ss == NULL)), -1);
+    ctx = xmlSecNssKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    memset(ctx, 0, sizeof(xmlSecNssKeysStoreCtx));
 
-    *ss = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
-    if(*ss == NULL) {
+    ctx->ss = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    if(ctx->ss == NULL) {
         xmlSecInternalError("xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId)",
                             xmlSecKeyStoreGetName(store));
         return(-1);
     }
 
+    ctx->cacheMutex = xmlNewMutex();
+    if(ctx->cacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
     return(0);
 }
 
 static void
 xmlSecNssKeysStoreFinalize(xmlSecKeyStorePtr store) {
-    xmlSecKeyStorePtr *ss;
+    xmlSecNssKeysStoreCtxPtr ctx;
 
     xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecNssKeysStoreId));
 
-    ss = xmlSecNssKeysStoreGetSS(store);
-    xmlSecAssert((ss != NULL) && (*ss != NULL));
+    ctx = xmlSecNssKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
 
-    xmlSecKeyStoreDestroy(*ss);
+    if(ctx->ss != NULL) {
+        xmlSecKeyStoreDestroy(ctx->ss);
+    }
+    if(ctx->cache != NULL) {
+        xmlHashFree(ctx->cache, xmlSecNssKeysStoreCacheItemDestroy);
+    }
+    if(ctx->cacheMutex != NULL) {
+        xmlFreeMutex(ctx->cacheMutex);
+    }
+    memset(ctx, 0, sizeof(xmlSecNssKeysStoreCtx));
+}
+
+static xmlChar*
+xmlSecNssKeysStoreCacheGetName(const xmlChar* name, xmlSecKeyDataType keyType) {
+    xmlChar* res;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    /* only public/private bits change the lookup result */
+    keyType &= (xmlSecKeyDataTypePublic | xmlSecKeyDataTypePrivate);
+
+    size = xmlStrlen(name) + 16;
+    res = (xmlChar*)xmlMalloc(size);
+    if(res == NULL) {
+        xmlSecMallocError(size, NULL);
+        return(NULL);
+    }
+    ret = xmlStrPrintf(res, size, "%u:%s", (unsigned int)keyType, name);
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        xmlFree(res);
+        return(NULL);
+    }
+    return(res);
+}
+
+/* returns 1 and the key copy (NULL for a remembered miss) if found in the cache,
+ * 0 if not found and a negative value if an error occurs */
+static int
+xmlSecNssKeysStoreCacheFind(xmlSecNssKeysStoreCtxPtr ctx, const xmlChar* cacheName, xmlSecKeyPtr* key) {
+    xmlSecNssKeysStoreCacheItemPtr item;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(cacheName != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    (*key) = NULL;
+
+    xmlMutexLock(ctx->cacheMutex);
+    if(ctx->cache != NULL) {
+        item = (xmlSecNssKeysStoreCacheItemPtr)xmlHashLookup(ctx->cache, cacheName);
+        if((item != NULL) && (item->expires <= time(NULL))) {
+            xmlHashRemoveEntry(ctx->cache, cacheName, xmlSecNssKeysStoreCacheItemDestroy);
+            item = NULL;
+        }
+        if((item != NULL) && (item->key != NULL)) {
+            (*key) = xmlSecKeyDuplicate(item->key);
+            if((*key) == NULL) {
+                xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+                res = -1;
+            } else {
+                res = 1;
+            }
+        } else if(item != NULL) {
+            res = 1;
+        }
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    return(res);
+}
+
+/* the cache is an optimization: the errors are reported but not returned */
+static void
+xmlSecNssKeysStoreCacheAdd(xmlSecNssKeysStoreCtxPtr ctx, const xmlChar* cacheName, xmlSecKeyPtr key) {
+    xmlSecNssKeysStoreCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->cacheMutex != NULL);
+    xmlSecAssert(cacheName != NULL);
+
+    item = (xmlSecNssKeysStoreCacheItemPtr)xmlMalloc(sizeof(xmlSecNssKeysStoreCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNssKeysStoreCacheItem), NULL);
+        return;
+    }
+    memset(item, 0, sizeof(xmlSecNssKeysStoreCacheItem));
+    item->expires = time(NULL) + XMLSEC_NSS_KEYS_STORE_CACHE_TTL;
+    if(key != NULL) {
+        item->key = xmlSecKeyDuplicate(key);
+        if(item->key == NULL) {
+            xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+            xmlSecNssKeysStoreCacheItemDestroy(item, NULL);
+            return;
+        }
+    }
+
+    xmlMutexLock(ctx->cacheMutex);
+    /* start over when full: the cache is refilled quickly by the hot names */
+    if((ctx->cache != NULL) && (xmlHashSize(ctx->cache) >= XMLSEC_NSS_KEYS_STORE_CACHE_SIZE)) {
+        xmlHashFree(ctx->cache, xmlSecNssKeysStoreCacheItemDestroy);
+        ctx->cache = NULL;
+    }
+    if(ctx->cache == NULL) {
+        ctx->cache = xmlHashCreate(0);
+        if(ctx->cache == NULL) {
+            xmlMutexUnlock(ctx->cacheMutex);
+            xmlSecXmlError("xmlHashCreate", NULL);
+            xmlSecNssKeysStoreCacheItemDestroy(item, NULL);
+            return;
+        }
+    }
+    ret = xmlHashUpdateEntry(ctx->cache, cacheName, item, xmlSecNssKeysStoreCacheItemDestroy);
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    if(ret < 0) {
+        xmlSecXmlError("xmlHashUpdateEntry", NULL);
+        xmlSecNssKeysStoreCacheItemDestroy(item, NULL);
+    }
 }
 
 static xmlSecKeyPtr
 xmlSecNssKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
                           xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecNssKeysStoreCtxPtr ctx;
     xmlSecKeyStorePtr* ss;
+    xmlChar* cacheName = NULL;
     xmlSecKeyPtr key = NULL;
     xmlSecKeyPtr retval = NULL;
     xmlSecKeyReqPtr keyReq = NULL;
@@ -287,6 +503,8 @@ xmlSecNssKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecNssKeysStoreId), NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
+    ctx = xmlSecNssKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
     ss = xmlSecNssKeysStoreGetSS(store);
     xmlSecAssert2(((ss != NULL) && (*ss != NULL)), NULL);
 
@@ -310,8 +528,24 @@ xmlSecNssKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
     keyReq = &(keyInfoCtx->keyReq);
     if (keyReq->keyType &
         (xmlSecKeyDataTypePublic | xmlSecKeyDataTypePrivate)) {
+        /* did we look for this name in the NSS DB recently? */
+        cacheName = xmlSecNssKeysStoreCacheGetName(name, keyReq->keyType);
+        if(cacheName == NULL) {
+            xmlSecInternalError("xmlSecNssKeysStoreCacheGetName", NULL);
+            goto done;
+        }
+        ret = xmlSecNssKeysStoreCacheFind(ctx, cacheName, &retval);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNssKeysStoreCacheFind", NULL);
+            goto done;
+        } else if(ret > 0) {
+            goto done;
+        }
+
         cert = CERT_FindCertByNickname (CERT_GetDefaultCertDB(), (char *)name);
         if (cert == NULL) {
+            /* remember the miss */
+            xmlSecNssKeysStoreCacheAdd(ctx, cacheName, NULL);
             goto done;
         }
 
@@ -342,7 +576,7 @@ xmlSecNssKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
         key = xmlSecKeyCreate();
         if (key == NULL) {
             xmlSecInternalError("xmlSecKeyCreate", NULL);
-            return (NULL);
+            goto done;
         }
 
         x509Data = xmlSecKeyDataCreate(xmlSecNssKeyDataX509Id);
@@ -389,11 +623,16 @@ xmlSecNssKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
         }
         x509Data = NULL;
 
+        xmlSecNssKeysStoreCacheAdd(ctx, cacheName, key);
+
         retval = key;
         key = NULL;
     }
 
 done:
+    if (cacheName != NULL) {
+        xmlFree(cacheName);
+    }
     if (cert != NULL) {
         CERT_DestroyCertificate(cert);
     }
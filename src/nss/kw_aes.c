@@ -57,6 +57,10 @@ static xmlSecKWAesKlass xmlSecNssKWAesKlass = {
     xmlSecNSSKWAesBlockEncrypt,         /* xmlSecKWAesBlockEncryptMethod       encrypt; */
     xmlSecNSSKWAesBlockDecrypt,         /* xmlSecKWAesBlockDecryptMethod       decrypt; */
 
+    /* bulk operations */
+    NULL,                               /* xmlSecKWAesWrapMethod               wrap; */
+    NULL,                               /* xmlSecKWAesUnwrapMethod             unwrap; */
+
     /* for the future */
     NULL,                               /* void*                               reserved0; */
     NULL                                /* void*                               reserved1; */
@@ -25,6 +25,7 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/nss/crypto.h>
 
@@ -405,15 +406,15 @@ static int
 xmlSecNssKWDes3GenerateRandom(void * context,
                               xmlSecByte * out, xmlSecSize outSize) {
     xmlSecNssKWDes3CtxPtr ctx = (xmlSecNssKWDes3CtxPtr)context;
-    SECStatus status;
+    int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(outSize > 0, -1);
 
-    status = PK11_GenerateRandom(out, outSize);
-    if(status != SECSuccess) {
-        xmlSecNssError("PK11_GenerateRandom", NULL);
+    ret = xmlSecRandomGenerate(xmlSecNssGenerateRandomBytes, NULL, out, outSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecRandomGenerate", NULL);
         return(-1);
     }
 
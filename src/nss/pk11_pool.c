@@ -0,0 +1,562 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Reusable PK11 digest contexts, cached slots and shared public keys.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <string.h>
+
+#include <nspr.h>
+#include <nss.h>
+#include <secoid.h>
+#include <pk11func.h>
+#include <keyhi.h>
+
+#include <libxml/threads.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/nss/crypto.h>
+#include "pk11_pool.h"
+
+/**************************************************************************
+ *
+ * PK11_CreateDigestContext() and PK11_GetBestSlot() look up the best slot
+ * for the mechanism every time, which takes the NSS modules list lock and
+ * becomes a contention point when many threads sign or verify at once.
+ *
+ * The best slot is looked up once per mechanism and kept referenced until
+ * xmlSecNssShutdown(). For every digest algorithm one context is prepared
+ * once and the new contexts are cloned from it with PK11_CloneContext();
+ * the released digest contexts are reset and kept for the next transform.
+ *
+ *****************************************************************************/
+#define XMLSEC_NSS_PK11_POOL_SIZE                       16
+#define XMLSEC_NSS_PK11_DIGESTS_SIZE                    16
+#define XMLSEC_NSS_PK11_SLOTS_SIZE                      32
+
+typedef struct _xmlSecNssPk11DigestEntry {
+    SECOidTag                   hashAlg;
+    PK11Context*                prepared;
+    PK11Context*                items[XMLSEC_NSS_PK11_POOL_SIZE];
+    xmlSecSize                  size;
+} xmlSecNssPk11DigestEntry, *xmlSecNssPk11DigestEntryPtr;
+
+typedef struct _xmlSecNssPk11SlotEntry {
+    CK_MECHANISM_TYPE           type;
+    PK11SlotInfo*               slot;
+} xmlSecNssPk11SlotEntry;
+
+/*
+ * The public keys read from the <dsig:KeyValue/> nodes and certificates are
+ * imported into a PK11 slot before use. The same partner sends the same key
+ * with every message: the imported keys are found by the DER encoded
+ * SubjectPublicKeyInfo and shared (reference counted) by all the key data
+ * objects. The cache keeps the unused keys until they are pushed out by
+ * the newer ones.
+ */
+#define XMLSEC_NSS_PK11_PUBKEYS_SIZE                    32
+
+struct _xmlSecNssPk11PubKey {
+    SECKEYPublicKey*            pubkey;
+    xmlSecByte*                 id;
+    xmlSecSize                  idSize;
+    unsigned int                hash;
+    xmlSecSize                  refs;
+    xmlSecSize                  lastUse;
+    int                         cached;
+};
+
+static xmlMutexPtr              xmlSecNssPk11PoolMutex          = NULL;
+static xmlSecNssPk11DigestEntry xmlSecNssPk11Digests[XMLSEC_NSS_PK11_DIGESTS_SIZE];
+static xmlSecSize               xmlSecNssPk11DigestsSize        = 0;
+static xmlSecNssPk11SlotEntry   xmlSecNssPk11Slots[XMLSEC_NSS_PK11_SLOTS_SIZE];
+static xmlSecSize               xmlSecNssPk11SlotsSize          = 0;
+static xmlSecNssPk11PubKeyPtr   xmlSecNssPk11PubKeys[XMLSEC_NSS_PK11_PUBKEYS_SIZE];
+static xmlSecSize               xmlSecNssPk11PubKeysClock       = 0;
+
+/* the caller must hold the mutex; returns NULL if the table is full */
+static xmlSecNssPk11DigestEntryPtr
+xmlSecNssPk11DigestEntryGet(SECOidTag hashAlg) {
+    xmlSecNssPk11DigestEntryPtr entry;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < xmlSecNssPk11DigestsSize; ++ii) {
+        if(xmlSecNssPk11Digests[ii].hashAlg == hashAlg) {
+            return(&(xmlSecNssPk11Digests[ii]));
+        }
+    }
+    if(xmlSecNssPk11DigestsSize >= XMLSEC_NSS_PK11_DIGESTS_SIZE) {
+        return(NULL);
+    }
+
+    entry = &(xmlSecNssPk11Digests[xmlSecNssPk11DigestsSize++]);
+    memset(entry, 0, sizeof(xmlSecNssPk11DigestEntry));
+    entry->hashAlg = hashAlg;
+    return(entry);
+}
+
+static unsigned int
+xmlSecNssPk11PubKeyHash(const xmlSecByte* id, xmlSecSize idSize) {
+    unsigned int hash = 2166136261U;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < idSize; ++ii) {
+        hash = (hash ^ id[ii]) * 16777619U;
+    }
+    return(hash);
+}
+
+static void
+xmlSecNssPk11PubKeyDestroy(xmlSecNssPk11PubKeyPtr sharedKey) {
+    xmlSecAssert(sharedKey != NULL);
+
+    if(sharedKey->pubkey != NULL) {
+        SECKEY_DestroyPublicKey(sharedKey->pubkey);
+    }
+    if(sharedKey->id != NULL) {
+        xmlFree(sharedKey->id);
+    }
+    memset(sharedKey, 0, sizeof(xmlSecNssPk11PubKey));
+    xmlFree(sharedKey);
+}
+
+/* the caller must hold the mutex; returns NULL if not found */
+static xmlSecNssPk11PubKeyPtr
+xmlSecNssPk11PubKeyFind(const xmlSecByte* id, xmlSecSize idSize, unsigned int hash) {
+    xmlSecNssPk11PubKeyPtr sharedKey;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_NSS_PK11_PUBKEYS_SIZE; ++ii) {
+        sharedKey = xmlSecNssPk11PubKeys[ii];
+        if((sharedKey != NULL) && (sharedKey->hash == hash) &&
+           (sharedKey->idSize == idSize) &&
+           (memcmp(sharedKey->id, id, idSize) == 0)) {
+            return(sharedKey);
+        }
+    }
+    return(NULL);
+}
+
+/* the caller must hold the mutex; returns 0 if all the keys are in use */
+static int
+xmlSecNssPk11PubKeyInsert(xmlSecNssPk11PubKeyPtr sharedKey) {
+    xmlSecNssPk11PubKeyPtr* slot = NULL;
+    xmlSecSize ii;
+
+    xmlSecAssert2(sharedKey != NULL, 0);
+
+    /* an empty slot or the least recently used unreferenced key */
+    for(ii = 0; ii < XMLSEC_NSS_PK11_PUBKEYS_SIZE; ++ii) {
+        if(xmlSecNssPk11PubKeys[ii] == NULL) {
+            slot = &(xmlSecNssPk11PubKeys[ii]);
+            break;
+        }
+        if((xmlSecNssPk11PubKeys[ii]->refs == 0) &&
+           ((slot == NULL) || (xmlSecNssPk11PubKeys[ii]->lastUse < (*slot)->lastUse))) {
+            slot = &(xmlSecNssPk11PubKeys[ii]);
+        }
+    }
+    if(slot == NULL) {
+        return(0);
+    }
+
+    if((*slot) != NULL) {
+        xmlSecNssPk11PubKeyDestroy(*slot);
+    }
+    sharedKey->cached = 1;
+    (*slot) = sharedKey;
+    return(1);
+}
+
+/**
+ * xmlSecNssPk11PoolInitialize:
+ *
+ * Initializes the PK11 contexts pool. This function is called
+ * from the #xmlSecNssInit function.
+ */
+void
+xmlSecNssPk11PoolInitialize(void) {
+    if(xmlSecNssPk11PoolMutex == NULL) {
+        xmlSecNssPk11PoolMutex = xmlNewMutex();
+        if(xmlSecNssPk11PoolMutex == NULL) {
+            /* the contexts and slots will be looked up every time */
+            xmlSecXmlError("xmlNewMutex", NULL);
+        }
+    }
+}
+
+/**
+ * xmlSecNssPk11PoolShutdown:
+ *
+ * Frees the pooled PK11 contexts and releases the cached slots.
+ * This function is called from the #xmlSecNssShutdown function.
+ */
+void
+xmlSecNssPk11PoolShutdown(void) {
+    xmlSecSize ii, jj;
+
+    if(xmlSecNssPk11PoolMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    for(ii = 0; ii < xmlSecNssPk11DigestsSize; ++ii) {
+        for(jj = 0; jj < xmlSecNssPk11Digests[ii].size; ++jj) {
+            PK11_DestroyContext(xmlSecNssPk11Digests[ii].items[jj], PR_TRUE);
+        }
+        if(xmlSecNssPk11Digests[ii].prepared != NULL) {
+            PK11_DestroyContext(xmlSecNssPk11Digests[ii].prepared, PR_TRUE);
+        }
+    }
+    memset(xmlSecNssPk11Digests, 0, sizeof(xmlSecNssPk11Digests));
+    xmlSecNssPk11DigestsSize = 0;
+
+    for(ii = 0; ii < xmlSecNssPk11SlotsSize; ++ii) {
+        PK11_FreeSlot(xmlSecNssPk11Slots[ii].slot);
+    }
+    memset(xmlSecNssPk11Slots, 0, sizeof(xmlSecNssPk11Slots));
+    xmlSecNssPk11SlotsSize = 0;
+
+    /* the keys still in use are destroyed with the last reference */
+    for(ii = 0; ii < XMLSEC_NSS_PK11_PUBKEYS_SIZE; ++ii) {
+        if(xmlSecNssPk11PubKeys[ii] == NULL) {
+            continue;
+        }
+        if(xmlSecNssPk11PubKeys[ii]->refs == 0) {
+            xmlSecNssPk11PubKeyDestroy(xmlSecNssPk11PubKeys[ii]);
+        } else {
+            xmlSecNssPk11PubKeys[ii]->cached = 0;
+        }
+        xmlSecNssPk11PubKeys[ii] = NULL;
+    }
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+
+    xmlFreeMutex(xmlSecNssPk11PoolMutex);
+    xmlSecNssPk11PoolMutex = NULL;
+}
+
+/**
+ * xmlSecNssPk11GetBestSlot:
+ * @type:               the PKCS#11 mechanism.
+ *
+ * Gets the best slot for the mechanism @type, the same as PK11_GetBestSlot()
+ * but the slot is looked up only once.
+ *
+ * Returns: the slot reference (must be released with PK11_FreeSlot())
+ * or NULL if an error occurs.
+ */
+PK11SlotInfo*
+xmlSecNssPk11GetBestSlot(CK_MECHANISM_TYPE type) {
+    PK11SlotInfo* slot = NULL;
+    xmlSecSize ii;
+
+    if(xmlSecNssPk11PoolMutex == NULL) {
+        return(PK11_GetBestSlot(type, NULL));
+    }
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    for(ii = 0; ii < xmlSecNssPk11SlotsSize; ++ii) {
+        if(xmlSecNssPk11Slots[ii].type == type) {
+            slot = PK11_ReferenceSlot(xmlSecNssPk11Slots[ii].slot);
+            break;
+        }
+    }
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    if(slot != NULL) {
+        return(slot);
+    }
+
+    /* don't hold our lock while NSS looks up the slot */
+    slot = PK11_GetBestSlot(type, NULL);
+    if(slot == NULL) {
+        return(NULL);
+    }
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    for(ii = 0; ii < xmlSecNssPk11SlotsSize; ++ii) {
+        if(xmlSecNssPk11Slots[ii].type == type) {
+            break;
+        }
+    }
+    if((ii >= xmlSecNssPk11SlotsSize) && (xmlSecNssPk11SlotsSize < XMLSEC_NSS_PK11_SLOTS_SIZE)) {
+        xmlSecNssPk11Slots[xmlSecNssPk11SlotsSize].type = type;
+        xmlSecNssPk11Slots[xmlSecNssPk11SlotsSize].slot = PK11_ReferenceSlot(slot);
+        ++xmlSecNssPk11SlotsSize;
+    }
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    return(slot);
+}
+
+/**
+ * xmlSecNssPk11DigestCtxAcquire:
+ * @hashAlg:            the digest algorithm.
+ *
+ * Gets a digest context for @hashAlg from the pool or clones a new one
+ * from the prepared context. The caller must call PK11_DigestBegin()
+ * before using the context and return it to the pool with
+ * #xmlSecNssPk11DigestCtxRelease.
+ *
+ * Returns: the digest context or NULL if an error occurs.
+ */
+PK11Context*
+xmlSecNssPk11DigestCtxAcquire(SECOidTag hashAlg) {
+    xmlSecNssPk11DigestEntryPtr entry;
+    PK11Context* prepared = NULL;
+    PK11Context* res = NULL;
+
+    if(xmlSecNssPk11PoolMutex == NULL) {
+        return(PK11_CreateDigestContext(hashAlg));
+    }
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    entry = xmlSecNssPk11DigestEntryGet(hashAlg);
+    if(entry != NULL) {
+        if(entry->size > 0) {
+            res = entry->items[--entry->size];
+            entry->items[entry->size] = NULL;
+        } else {
+            if(entry->prepared == NULL) {
+                entry->prepared = PK11_CreateDigestContext(hashAlg);
+                if((entry->prepared != NULL) && (PK11_DigestBegin(entry->prepared) != SECSuccess)) {
+                    PK11_DestroyContext(entry->prepared, PR_TRUE);
+                    entry->prepared = NULL;
+                }
+            }
+            prepared = entry->prepared;
+        }
+    }
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    if(res != NULL) {
+        return(res);
+    }
+
+    /* the prepared context is never changed (and freed only on shutdown) */
+    if(prepared != NULL) {
+        res = PK11_CloneContext(prepared);
+        if(res != NULL) {
+            return(res);
+        }
+    }
+    return(PK11_CreateDigestContext(hashAlg));
+}
+
+/**
+ * xmlSecNssPk11DigestCtxRelease:
+ * @hashAlg:            the digest algorithm.
+ * @digestCtx:          the digest context.
+ *
+ * Resets the digest context @digestCtx and returns it to the pool
+ * (or destroys it if the pool is full).
+ */
+void
+xmlSecNssPk11DigestCtxRelease(SECOidTag hashAlg, PK11Context* digestCtx) {
+    xmlSecNssPk11DigestEntryPtr entry;
+    int pooled = 0;
+
+    xmlSecAssert(digestCtx != NULL);
+
+    /* don't keep the previous data state around */
+    if((xmlSecNssPk11PoolMutex != NULL) && (PK11_DigestBegin(digestCtx) == SECSuccess)) {
+        xmlMutexLock(xmlSecNssPk11PoolMutex);
+        entry = xmlSecNssPk11DigestEntryGet(hashAlg);
+        if((entry != NULL) && (entry->size < XMLSEC_NSS_PK11_POOL_SIZE)) {
+            entry->items[entry->size++] = digestCtx;
+            pooled = 1;
+        }
+        xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    }
+
+    if(pooled == 0) {
+        PK11_DestroyContext(digestCtx, PR_TRUE);
+    }
+}
+
+/**
+ * xmlSecNssPk11PubKeyShare:
+ * @pubkey:             the public key.
+ *
+ * Looks up the shared public key with the same SubjectPublicKeyInfo as
+ * @pubkey or imports @pubkey into the best PK11 slot and shares it. On
+ * success @pubkey is owned (or destroyed) by the cache and must not
+ * be used by the caller anymore. The shared key must be released with
+ * #xmlSecNssPk11PubKeyRelease.
+ *
+ * Returns: the shared key or NULL if the key can't be shared (the caller
+ * still owns @pubkey in this case).
+ */
+xmlSecNssPk11PubKeyPtr
+xmlSecNssPk11PubKeyShare(SECKEYPublicKey* pubkey) {
+    xmlSecNssPk11PubKeyPtr sharedKey = NULL;
+    xmlSecNssPk11PubKeyPtr res;
+    CK_MECHANISM_TYPE type;
+    PK11SlotInfo* slot;
+    SECItem* spki;
+    unsigned int hash;
+
+    xmlSecAssert2(pubkey != NULL, NULL);
+
+    if(xmlSecNssPk11PoolMutex == NULL) {
+        return(NULL);
+    }
+    switch(pubkey->keyType) {
+    case rsaKey:
+        type = CKM_RSA_PKCS;
+        break;
+    case dsaKey:
+        type = CKM_DSA;
+        break;
+    case ecKey:
+        type = CKM_ECDSA;
+        break;
+    default:
+        return(NULL);
+    }
+
+    spki = SECKEY_EncodeDERSubjectPublicKeyInfo(pubkey);
+    if(spki == NULL) {
+        return(NULL);
+    }
+    hash = xmlSecNssPk11PubKeyHash(spki->data, spki->len);
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    res = xmlSecNssPk11PubKeyFind(spki->data, spki->len, hash);
+    if(res != NULL) {
+        ++res->refs;
+        res->lastUse = ++xmlSecNssPk11PubKeysClock;
+    }
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    if(res != NULL) {
+        SECITEM_FreeItem(spki, PR_TRUE);
+        SECKEY_DestroyPublicKey(pubkey);
+        return(res);
+    }
+
+    /* don't hold our lock while NSS imports the key */
+    if(pubkey->pkcs11Slot == NULL) {
+        slot = xmlSecNssPk11GetBestSlot(type);
+        if(slot == NULL) {
+            SECITEM_FreeItem(spki, PR_TRUE);
+            return(NULL);
+        }
+        if(PK11_ImportPublicKey(slot, pubkey, PR_FALSE) == CK_INVALID_HANDLE) {
+            PK11_FreeSlot(slot);
+            SECITEM_FreeItem(spki, PR_TRUE);
+            return(NULL);
+        }
+        PK11_FreeSlot(slot);
+    }
+
+    sharedKey = (xmlSecNssPk11PubKeyPtr)xmlMalloc(sizeof(xmlSecNssPk11PubKey));
+    if(sharedKey == NULL) {
+        SECITEM_FreeItem(spki, PR_TRUE);
+        return(NULL);
+    }
+    memset(sharedKey, 0, sizeof(xmlSecNssPk11PubKey));
+    sharedKey->id = (xmlSecByte*)xmlMalloc(spki->len);
+    if(sharedKey->id == NULL) {
+        xmlFree(sharedKey);
+        SECITEM_FreeItem(spki, PR_TRUE);
+        return(NULL);
+    }
+    memcpy(sharedKey->id, spki->data, spki->len);
+    sharedKey->idSize = spki->len;
+    sharedKey->hash   = hash;
+    sharedKey->refs   = 1;
+    sharedKey->pubkey = pubkey;
+    SECITEM_FreeItem(spki, PR_TRUE);
+
+    xmlMutexLock(xmlSecNssPk11PoolMutex);
+    res = xmlSecNssPk11PubKeyFind(sharedKey->id, sharedKey->idSize, hash);
+    if(res != NULL) {
+        /* another thread was faster */
+        ++res->refs;
+    } else {
+        /* the key is shared even if it doesn't fit into the cache */
+        (void)xmlSecNssPk11PubKeyInsert(sharedKey);
+        res = sharedKey;
+        sharedKey = NULL;
+    }
+    res->lastUse = ++xmlSecNssPk11PubKeysClock;
+    xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+
+    if(sharedKey != NULL) {
+        xmlSecNssPk11PubKeyDestroy(sharedKey);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecNssPk11PubKeyRef:
+ * @sharedKey:          the shared key.
+ *
+ * Adds a reference to @sharedKey.
+ *
+ * Returns: @sharedKey.
+ */
+xmlSecNssPk11PubKeyPtr
+xmlSecNssPk11PubKeyRef(xmlSecNssPk11PubKeyPtr sharedKey) {
+    xmlSecAssert2(sharedKey != NULL, NULL);
+
+    if(xmlSecNssPk11PoolMutex != NULL) {
+        xmlMutexLock(xmlSecNssPk11PoolMutex);
+        ++sharedKey->refs;
+        xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    } else {
+        ++sharedKey->refs;
+    }
+    return(sharedKey);
+}
+
+/**
+ * xmlSecNssPk11PubKeyRelease:
+ * @sharedKey:          the shared key.
+ *
+ * Releases the reference to @sharedKey. The key is kept in the cache
+ * for the next #xmlSecNssPk11PubKeyShare call or destroyed if it was
+ * pushed out of the cache.
+ */
+void
+xmlSecNssPk11PubKeyRelease(xmlSecNssPk11PubKeyPtr sharedKey) {
+    int destroy;
+
+    xmlSecAssert(sharedKey != NULL);
+    xmlSecAssert(sharedKey->refs > 0);
+
+    if(xmlSecNssPk11PoolMutex != NULL) {
+        xmlMutexLock(xmlSecNssPk11PoolMutex);
+        --sharedKey->refs;
+        destroy = ((sharedKey->refs == 0) && (sharedKey->cached == 0)) ? 1 : 0;
+        xmlMutexUnlock(xmlSecNssPk11PoolMutex);
+    } else {
+        /* after xmlSecNssShutdown() */
+        --sharedKey->refs;
+        destroy = (sharedKey->refs == 0) ? 1 : 0;
+    }
+
+    if(destroy != 0) {
+        xmlSecNssPk11PubKeyDestroy(sharedKey);
+    }
+}
+
+/**
+ * xmlSecNssPk11PubKeyGet:
+ * @sharedKey:          the shared key.
+ *
+ * Gets the imported public key. The key is shared between threads and
+ * must not be modified or destroyed by the caller.
+ *
+ * Returns: the public key.
+ */
+SECKEYPublicKey*
+xmlSecNssPk11PubKeyGet(xmlSecNssPk11PubKeyPtr sharedKey) {
+    xmlSecAssert2(sharedKey != NULL, NULL);
+    return(sharedKey->pubkey);
+}
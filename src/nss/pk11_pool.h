@@ -0,0 +1,58 @@
+/*
+ * XML Security Library
+ *
+ * THIS IS A PRIVATE XMLSEC HEADER FILE
+ * DON'T USE IT IN YOUR APPLICATION
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_NSS_PK11_POOL_H__
+#define __XMLSEC_NSS_PK11_POOL_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "nss/pk11_pool.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <secoid.h>
+#include <pk11func.h>
+#include <keyhi.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**************************************************************************
+ *
+ * Reusable PK11 digest contexts and cached slots
+ *
+ *****************************************************************************/
+void                    xmlSecNssPk11PoolInitialize             (void);
+void                    xmlSecNssPk11PoolShutdown               (void);
+
+PK11SlotInfo*           xmlSecNssPk11GetBestSlot                (CK_MECHANISM_TYPE type);
+
+PK11Context*            xmlSecNssPk11DigestCtxAcquire           (SECOidTag hashAlg);
+void                    xmlSecNssPk11DigestCtxRelease           (SECOidTag hashAlg,
+                                                                 PK11Context* digestCtx);
+
+/**************************************************************************
+ *
+ * Shared imported public keys
+ *
+ *****************************************************************************/
+typedef struct _xmlSecNssPk11PubKey     xmlSecNssPk11PubKey,
+                                        *xmlSecNssPk11PubKeyPtr;
+
+xmlSecNssPk11PubKeyPtr  xmlSecNssPk11PubKeyShare                (SECKEYPublicKey* pubkey);
+xmlSecNssPk11PubKeyPtr  xmlSecNssPk11PubKeyRef                  (xmlSecNssPk11PubKeyPtr sharedKey);
+void                    xmlSecNssPk11PubKeyRelease              (xmlSecNssPk11PubKeyPtr sharedKey);
+SECKEYPublicKey*        xmlSecNssPk11PubKeyGet                  (xmlSecNssPk11PubKeyPtr sharedKey);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_NSS_PK11_POOL_H__ */
@@ -24,6 +24,7 @@
 #include <xmlsec/nss/crypto.h>
 #include <xmlsec/nss/bignum.h>
 #include <xmlsec/nss/pkikeys.h>
+#include "pk11_pool.h"
 
 /**************************************************************************
  *
@@ -35,6 +36,7 @@ typedef struct _xmlSecNssPKIKeyDataCtx  xmlSecNssPKIKeyDataCtx,
 struct _xmlSecNssPKIKeyDataCtx {
     SECKEYPublicKey  *pubkey;
     SECKEYPrivateKey *privkey;
+    xmlSecNssPk11PubKeyPtr sharedPubkey;        /* owns pubkey if not NULL */
 };
 
 /******************************************************************************
@@ -102,6 +104,12 @@ xmlSecNSSPKIKeyDataCtxFree(xmlSecNssPKIKeyDataCtxPtr ctx)
         ctx->privkey = NULL;
     }
 
+    if (ctx->sharedPubkey != NULL) {
+        xmlSecNssPk11PubKeyRelease(ctx->sharedPubkey);
+        ctx->sharedPubkey = NULL;
+        ctx->pubkey = NULL;
+    }
+
     if (ctx->pubkey)
     {
         SECKEY_DestroyPublicKey(ctx->pubkey);
@@ -123,7 +131,10 @@ xmlSecNSSPKIKeyDataCtxDup(xmlSecNssPKIKeyDataCtxPtr ctxDst,
         }
     }
 
-    if (ctxSrc->pubkey != NULL) {
+    if (ctxSrc->sharedPubkey != NULL) {
+        ctxDst->sharedPubkey = xmlSecNssPk11PubKeyRef(ctxSrc->sharedPubkey);
+        ctxDst->pubkey = ctxSrc->pubkey;
+    } else if (ctxSrc->pubkey != NULL) {
         ctxDst->pubkey = SECKEY_CopyPublicKey(ctxSrc->pubkey);
         if(ctxDst->pubkey == NULL) {
             xmlSecNssError("SECKEY_CopyPublicKey", NULL);
@@ -169,11 +180,22 @@ xmlSecNssPKIKeyDataAdoptKey(xmlSecKeyDataPtr data,
     }
     ctx->privkey = privkey;
 
-    if (ctx->pubkey) {
+    if (ctx->sharedPubkey != NULL) {
+        xmlSecNssPk11PubKeyRelease(ctx->sharedPubkey);
+        ctx->sharedPubkey = NULL;
+    } else if (ctx->pubkey) {
         SECKEY_DestroyPublicKey(ctx->pubkey);
     }
     ctx->pubkey = pubkey;
 
+    /* the public only keys (KeyValue, certificates) are imported once and shared */
+    if ((privkey == NULL) && (pubkey != NULL)) {
+        ctx->sharedPubkey = xmlSecNssPk11PubKeyShare(pubkey);
+        if (ctx->sharedPubkey != NULL) {
+            ctx->pubkey = xmlSecNssPk11PubKeyGet(ctx->sharedPubkey);
+        }
+    }
+
     return(0);
 }
 
@@ -544,8 +566,6 @@ xmlSecNssKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     xmlSecKeyDataPtr data = NULL;
     xmlNodePtr cur;
     int ret;
-    PK11SlotInfo *slot = NULL;
-    CK_OBJECT_HANDLE handle;
     SECKEYPublicKey *pubkey=NULL;
     PRArenaPool *arena = NULL;
 
@@ -563,13 +583,6 @@ xmlSecNssKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         goto done;
     }
 
-    slot = PK11_GetBestSlot(CKM_DSA, NULL);
-    if(slot == NULL) {
-        xmlSecNssError("PK11_GetBestSlot", xmlSecKeyDataKlassGetName(id));
-        ret = -1;
-        goto done;
-    }
-
     arena = PORT_NewArena(DER_DEFAULT_CHUNKSIZE);
     if(arena == NULL) {
         xmlSecNssError("PORT_NewArena", xmlSecKeyDataKlassGetName(id));
@@ -675,14 +688,6 @@ xmlSecNssKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         goto done;
     }
 
-    handle = PK11_ImportPublicKey(slot, pubkey, PR_FALSE);
-    if(handle == CK_INVALID_HANDLE) {
-        xmlSecNssError("PK11_ImportPublicKey",
-                       xmlSecKeyDataKlassGetName(id));
-        ret = -1;
-        goto done;
-    }
-
     data = xmlSecKeyDataCreate(id);
     if(data == NULL) {
         xmlSecInternalError("xmlSecKeyDataCreate",
@@ -710,9 +715,6 @@ xmlSecNssKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     ret = 0;
 
 done:
-    if (slot != NULL) {
-        PK11_FreeSlot(slot);
-    }
     if (ret != 0) {
         if (pubkey != NULL) {
             SECKEY_DestroyPublicKey(pubkey);
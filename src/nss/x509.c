@@ -1444,8 +1444,11 @@ xmlSecNssKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data, xmlSecKeyPtr key,
 
     if((ctx->keyCert == NULL) && (ctx->certsList != NULL) && (xmlSecKeyGetValue(key) == NULL)) {
         CERTCertificate* cert;
+        void* span;
 
+        span = xmlSecTraceBegin(xmlSecTracePhaseX509Verify, NULL, keyInfoCtx->userData);
         cert = xmlSecNssX509StoreVerify(x509Store, ctx->certsList, keyInfoCtx);
+        xmlSecTraceEnd(span, xmlSecTracePhaseX509Verify, (cert != NULL) ? 0 : -1);
         if(cert != NULL) {
             xmlSecKeyDataPtr keyValue;
 
@@ -1585,6 +1588,14 @@ xmlSecNssX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
     derCert.data = (unsigned char *)buf;
     derCert.len = size;
 
+    /* the same certs are usually sent in every message: NSS keeps the
+     * certs it has seen in the database and finds them by DER without
+     * decoding the whole cert again */
+    cert = CERT_FindCertByDERCert(CERT_GetDefaultCertDB(), &derCert);
+    if(cert != NULL) {
+        return(cert);
+    }
+
     /* decode cert and import to temporary cert db */
     cert = __CERT_NewTempCertificate(CERT_GetDefaultCertDB(), &derCert,
                                      NULL, PR_FALSE, PR_TRUE);
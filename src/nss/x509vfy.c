@@ -21,8 +21,10 @@
 
 #include <cert.h>
 #include <secerr.h>
+#include <pk11func.h>
 
 #include <libxml/tree.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -34,12 +36,48 @@
 
 #include <xmlsec/nss/crypto.h>
 #include <xmlsec/nss/x509.h>
+#include "pk11_pool.h"
 
 /**************************************************************************
  *
  * Internal NSS X509 store CTX
  *
  *************************************************************************/
+/**
+ * XMLSEC_NSS_X509_VERIFY_CACHE_SIZE:
+ *
+ * The max number of successful certificate verification results
+ * remembered by the NSS X509 store.
+ */
+#define XMLSEC_NSS_X509_VERIFY_CACHE_SIZE                       64
+
+/**
+ * XMLSEC_NSS_X509_VERIFY_CACHE_TIME_BUCKET:
+ *
+ * The verification time granularity (in seconds) for the cached
+ * certificate verification results: a result is reused only for the
+ * verification times in the same bucket, so the OCSP/CRL status is
+ * re-checked at least that often.
+ */
+#define XMLSEC_NSS_X509_VERIFY_CACHE_TIME_BUCKET                60
+
+#define XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE                    32
+
+/*
+ * The verified certificates cache entry: the SHA-256 of the signer certificate
+ * DER, the SHA-256 over the DERs of all the certificates in the list and the
+ * verification time bucket. The cache is flushed every time the store changes.
+ */
+typedef struct _xmlSecNssX509VerifyCacheEntry           xmlSecNssX509VerifyCacheEntry,
+                                                        *xmlSecNssX509VerifyCacheEntryPtr;
+struct _xmlSecNssX509VerifyCacheEntry {
+    unsigned char                       certMd[XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE];
+    unsigned char                       certsMd[XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE];
+    PRTime                              timeBucket;
+    xmlSecNssX509VerifyCacheEntryPtr    prev;
+    xmlSecNssX509VerifyCacheEntryPtr    next;
+};
+
 typedef struct _xmlSecNssX509StoreCtx           xmlSecNssX509StoreCtx,
                                                 *xmlSecNssX509StoreCtxPtr;
 struct _xmlSecNssX509StoreCtx {
@@ -53,6 +91,12 @@ struct _xmlSecNssX509StoreCtx {
      */
 
     CERTCertList* certsList; /* just keeping a reference to destroy later */
+
+    /* verified certificates cache */
+    xmlSecNssX509VerifyCacheEntryPtr    cacheHead;
+    xmlSecNssX509VerifyCacheEntryPtr    cacheTail;
+    xmlSecSize                          cacheSize;
+    xmlMutexPtr                         cacheMutex;
 };
 
 /****************************************************************************
@@ -82,6 +126,18 @@ static xmlSecByte *     xmlSecNssX509NameRead           (xmlSecByte *str,
 static int              xmlSecNssNumToItem              (SECItem *it, 
                                                          PRUint64 num);
 
+static int              xmlSecNssX509CertsDigest        (CERTCertList* certs,
+                                                         unsigned char *md);
+static int              xmlSecNssX509VerifyCacheLookup  (xmlSecNssX509StoreCtxPtr ctx,
+                                                         const unsigned char *certMd,
+                                                         const unsigned char *certsMd,
+                                                         PRTime timeBucket);
+static int              xmlSecNssX509VerifyCacheAdd     (xmlSecNssX509StoreCtxPtr ctx,
+                                                         const unsigned char *certMd,
+                                                         const unsigned char *certsMd,
+                                                         PRTime timeBucket);
+static void             xmlSecNssX509VerifyCacheFlush   (xmlSecNssX509StoreCtxPtr ctx);
+
 
 static xmlSecKeyDataStoreKlass xmlSecNssX509StoreKlass = {
     sizeof(xmlSecKeyDataStoreKlass),
@@ -169,6 +225,11 @@ xmlSecNssX509StoreVerify(xmlSecKeyDataStorePtr store, CERTCertList* certs,
     int64 timeboundary;
     int64 tmp1, tmp2;
     PRErrorCode err;
+    unsigned char certMd[XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE];
+    unsigned char certsMd[XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE];
+    PRTime timeBucket = 0;
+    int useCache;
+    int ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecNssX509StoreId), NULL);
     xmlSecAssert2(certs != NULL, NULL);
@@ -187,6 +248,19 @@ xmlSecNssX509StoreVerify(xmlSecKeyDataStorePtr store, CERTCertList* certs,
         timeboundary = PR_Now();
     }
 
+    /* the cached results are only valid for the same certs list */
+    useCache = (((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) &&
+                (ctx->cacheMutex != NULL)) ? 1 : 0;
+    if(useCache != 0) {
+        ret = xmlSecNssX509CertsDigest(certs, certsMd);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNssX509CertsDigest",
+                                xmlSecKeyDataStoreGetName(store));
+            return(NULL);
+        }
+        timeBucket = timeboundary / ((PRTime)XMLSEC_NSS_X509_VERIFY_CACHE_TIME_BUCKET * PR_USEC_PER_SEC);
+    }
+
     for (head = CERT_LIST_HEAD(certs);
          !CERT_LIST_END(head, certs);
          head = CERT_LIST_NEXT(head)) {
@@ -214,6 +288,19 @@ xmlSecNssX509StoreVerify(xmlSecKeyDataStorePtr store, CERTCertList* certs,
         }
 
         if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) {
+            /* did we verify this cert already? */
+            if(useCache != 0) {
+                if(PK11_HashBuf(SEC_OID_SHA256, certMd, cert->derCert.data, (PRInt32)cert->derCert.len) != SECSuccess) {
+                    xmlSecNssError("PK11_HashBuf", xmlSecKeyDataStoreGetName(store));
+                    return(NULL);
+                }
+                if((xmlSecNssX509VerifyCacheLookup(ctx, certMd, certsMd, timeBucket) == 1) &&
+                   (CERT_CheckCertValidTimes(cert, timeboundary, PR_FALSE) == secCertTimeValid)) {
+                    status = SECSuccess;
+                    break;
+                }
+            }
+
             /* it's important to set the usage here, otherwise no real verification
              * is performed. */
             status = CERT_VerifyCertificate(CERT_GetDefaultCertDB(),
@@ -221,6 +308,14 @@ xmlSecNssX509StoreVerify(xmlSecKeyDataStorePtr store, CERTCertList* certs,
                                             certificateUsageEmailSigner,
                                             timeboundary , NULL, NULL, NULL);
             if(status == SECSuccess) {
+                if(useCache != 0) {
+                    ret = xmlSecNssX509VerifyCacheAdd(ctx, certMd, certsMd, timeBucket);
+                    if(ret < 0) {
+                        xmlSecInternalError("xmlSecNssX509VerifyCacheAdd",
+                                            xmlSecKeyDataStoreGetName(store));
+                        return(NULL);
+                    }
+                }
                 break;
             }
         } else {
@@ -288,6 +383,9 @@ xmlSecNssX509StoreAdoptCert(xmlSecKeyDataStorePtr store, CERTCertificate* cert,
     ctx = xmlSecNssX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
 
+    /* the store changed: forget the previous verification results */
+    xmlSecNssX509VerifyCacheFlush(ctx);
+
     if(ctx->certsList == NULL) {
         ctx->certsList = CERT_NewCertList();
         if(ctx->certsList == NULL) {
@@ -332,6 +430,12 @@ xmlSecNssX509StoreInitialize(xmlSecKeyDataStorePtr store) {
 
     memset(ctx, 0, sizeof(xmlSecNssX509StoreCtx));
 
+    ctx->cacheMutex = xmlNewMutex();
+    if(ctx->cacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
     return(0);
 }
 
@@ -347,10 +451,167 @@ xmlSecNssX509StoreFinalize(xmlSecKeyDataStorePtr store) {
         CERT_DestroyCertList(ctx->certsList);
         ctx->certsList = NULL;
     }
+    xmlSecNssX509VerifyCacheFlush(ctx);
+    if(ctx->cacheMutex != NULL) {
+        xmlFreeMutex(ctx->cacheMutex);
+    }
 
     memset(ctx, 0, sizeof(xmlSecNssX509StoreCtx));
 }
 
+static int
+xmlSecNssX509CertsDigest(CERTCertList* certs, unsigned char *md) {
+    CERTCertListNode* head;
+    PK11Context* mdCtx;
+    unsigned int mdLen = 0;
+    SECStatus rv;
+
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(md != NULL, -1);
+
+    mdCtx = xmlSecNssPk11DigestCtxAcquire(SEC_OID_SHA256);
+    if(mdCtx == NULL) {
+        xmlSecInternalError("xmlSecNssPk11DigestCtxAcquire", NULL);
+        return(-1);
+    }
+
+    rv = PK11_DigestBegin(mdCtx);
+    for (head = CERT_LIST_HEAD(certs);
+         (rv == SECSuccess) && !CERT_LIST_END(head, certs);
+         head = CERT_LIST_NEXT(head)) {
+        rv = PK11_DigestOp(mdCtx, head->cert->derCert.data, head->cert->derCert.len);
+    }
+    if(rv == SECSuccess) {
+        rv = PK11_DigestFinal(mdCtx, md, &mdLen, XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE);
+    }
+    xmlSecNssPk11DigestCtxRelease(SEC_OID_SHA256, mdCtx);
+
+    if((rv != SECSuccess) || (mdLen != XMLSEC_NSS_X509_VERIFY_CACHE_MD_SIZE)) {
+        xmlSecNssError("PK11_DigestOp", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecNssX509VerifyCacheUnlink(xmlSecNssX509StoreCtxPtr ctx, xmlSecNssX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        ctx->cacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        ctx->cacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+static void
+xmlSecNssX509VerifyCachePushFront(xmlSecNssX509StoreCtxPtr ctx, xmlSecNssX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = ctx->cacheHead;
+    if(ctx->cacheHead != NULL) {
+        ctx->cacheHead->prev = entry;
+    } else {
+        ctx->cacheTail = entry;
+    }
+    ctx->cacheHead = entry;
+}
+
+static int
+xmlSecNssX509VerifyCacheLookup(xmlSecNssX509StoreCtxPtr ctx,
+                               const unsigned char *certMd,
+                               const unsigned char *certsMd,
+                               PRTime timeBucket) {
+    xmlSecNssX509VerifyCacheEntryPtr entry;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+
+    xmlMutexLock(ctx->cacheMutex);
+    for(entry = ctx->cacheHead; entry != NULL; entry = entry->next) {
+        if((entry->timeBucket == timeBucket) &&
+           (memcmp(entry->certMd, certMd, sizeof(entry->certMd)) == 0) &&
+           (memcmp(entry->certsMd, certsMd, sizeof(entry->certsMd)) == 0)) {
+            break;
+        }
+    }
+    if(entry != NULL) {
+        /* most recently used goes first */
+        xmlSecNssX509VerifyCacheUnlink(ctx, entry);
+        xmlSecNssX509VerifyCachePushFront(ctx, entry);
+        res = 1;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(res);
+}
+
+static int
+xmlSecNssX509VerifyCacheAdd(xmlSecNssX509StoreCtxPtr ctx,
+                            const unsigned char *certMd,
+                            const unsigned char *certsMd,
+                            PRTime timeBucket) {
+    xmlSecNssX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+
+    entry = (xmlSecNssX509VerifyCacheEntryPtr)xmlMalloc(sizeof(xmlSecNssX509VerifyCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNssX509VerifyCacheEntry), NULL);
+        return(-1);
+    }
+    memset(entry, 0, sizeof(xmlSecNssX509VerifyCacheEntry));
+    memcpy(entry->certMd, certMd, sizeof(entry->certMd));
+    memcpy(entry->certsMd, certsMd, sizeof(entry->certsMd));
+    entry->timeBucket = timeBucket;
+
+    xmlMutexLock(ctx->cacheMutex);
+    xmlSecNssX509VerifyCachePushFront(ctx, entry);
+    ++ctx->cacheSize;
+    while((ctx->cacheSize > XMLSEC_NSS_X509_VERIFY_CACHE_SIZE) && (ctx->cacheTail != NULL)) {
+        /* evict least recently used (most likely from the old time buckets) */
+        entry = ctx->cacheTail;
+        xmlSecNssX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+        --ctx->cacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(0);
+}
+
+static void
+xmlSecNssX509VerifyCacheFlush(xmlSecNssX509StoreCtxPtr ctx) {
+    xmlSecNssX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexLock(ctx->cacheMutex);
+    }
+    while(ctx->cacheHead != NULL) {
+        entry = ctx->cacheHead;
+        xmlSecNssX509VerifyCacheUnlink(ctx, entry);
+        xmlFree(entry);
+    }
+    ctx->cacheSize = 0;
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexUnlock(ctx->cacheMutex);
+    }
+}
 
 /*****************************************************************************
  *
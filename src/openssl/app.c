@@ -11,15 +11,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <libxml/tree.h>
+#include <libxml/threads.h>
 
 #include <openssl/evp.h>
 #include <openssl/rand.h>
 #include <openssl/pem.h>
 #include <openssl/pkcs12.h>
+#include <openssl/sha.h>
 #include <openssl/conf.h>
 #include <openssl/engine.h>
+#include <openssl/crypto.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
@@ -32,6 +37,7 @@
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include <xmlsec/openssl/x509.h>
+#include "evp_pool.h"
 
 static int      xmlSecOpenSSLAppLoadRANDFile            (const char *filename);
 static int      xmlSecOpenSSLAppSaveRANDFile            (const char *filename);
@@ -43,6 +49,15 @@ static int      xmlSecOpenSSLDummyPasswordCallback      (char *buf,
                                                          int bufsize,
                                                          int verify,
                                                          void *userdata);
+static xmlSecKeyPtr xmlSecOpenSSLAppKeysCacheFind       (const char* filename,
+                                                         xmlSecKeyDataFormat format,
+                                                         const char* pwd,
+                                                         struct stat* st);
+static void     xmlSecOpenSSLAppKeysCacheAdd            (const char* filename,
+                                                         xmlSecKeyDataFormat format,
+                                                         const char* pwd,
+                                                         const struct stat* st,
+                                                         xmlSecKeyPtr key);
 
 /* conversion from ptr to func "the right way" */
 XMLSEC_PTR_TO_FUNC_IMPL(pem_password_cb)
@@ -70,12 +85,14 @@ xmlSecOpenSSLAppInit(const char* config) {
 #else /* !defined(XMLSEC_OPENSSL_API_110) */
     int ret;
 
-    ret = OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CRYPTO_STRINGS | 
+    /* xmlsec never runs async jobs and never selects engines by itself: the
+     * async subsystem and the built-in engines are initialized by OpenSSL
+     * on the first use instead of slowing down every process start. Engines
+     * configured in openssl.cnf are still loaded with the config. */
+    ret = OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CRYPTO_STRINGS |
                               OPENSSL_INIT_ADD_ALL_CIPHERS |
                               OPENSSL_INIT_ADD_ALL_DIGESTS |
-                              OPENSSL_INIT_LOAD_CONFIG |
-                              OPENSSL_INIT_ASYNC |
-                              OPENSSL_INIT_ENGINE_ALL_BUILTIN,
+                              OPENSSL_INIT_LOAD_CONFIG,
                               NULL);
     if(ret != 1) {
         xmlSecOpenSSLError("OPENSSL_init_crypto", NULL);
@@ -138,7 +155,9 @@ xmlSecOpenSSLAppShutdown(void) {
  * @pwdCallback:        the key password callback.
  * @pwdCallbackCtx:     the user context for password callback.
  *
- * Reads key from the a file.
+ * Reads key from the a file. The password protected keys are taken from
+ * the unlocked keys cache if it is enabled and the file did not change
+ * (see #xmlSecOpenSSLAppKeysCacheSetEnabled).
  *
  * Returns: pointer to the key or NULL if an error occurs.
  */
@@ -148,10 +167,16 @@ xmlSecOpenSSLAppKeyLoad(const char *filename, xmlSecKeyDataFormat format,
                         void* pwdCallbackCtx) {
     BIO* bio;
     xmlSecKeyPtr key;
+    struct stat st;
 
     xmlSecAssert2(filename != NULL, NULL);
     xmlSecAssert2(format != xmlSecKeyDataFormatUnknown, NULL);
 
+    key = xmlSecOpenSSLAppKeysCacheFind(filename, format, pwd, &st);
+    if(key != NULL) {
+        return(key);
+    }
+
     bio = BIO_new_file(filename, "rb");
     if(bio == NULL) {
         xmlSecOpenSSLError2("BIO_new_file", NULL,
@@ -168,6 +193,7 @@ xmlSecOpenSSLAppKeyLoad(const char *filename, xmlSecKeyDataFormat format,
     }
 
     BIO_free(bio);
+    xmlSecOpenSSLAppKeysCacheAdd(filename, format, pwd, &st, key);
     return(key);
 }
 
@@ -498,7 +524,8 @@ xmlSecOpenSSLAppKeyCertLoadBIO(xmlSecKeyPtr key, BIO* bio, xmlSecKeyDataFormat f
  *
  * Reads key and all associated certificates from the PKCS12 file.
  * For uniformity, call xmlSecOpenSSLAppKeyLoad instead of this function. Pass
- * in format=xmlSecKeyDataFormatPkcs12.
+ * in format=xmlSecKeyDataFormatPkcs12. The unlocked keys cache is used
+ * if it is enabled (see #xmlSecOpenSSLAppKeysCacheSetEnabled).
  *
  * Returns: pointer to the key or NULL if an error occurs.
  */
@@ -507,9 +534,15 @@ xmlSecOpenSSLAppPkcs12Load(const char *filename, const char *pwd,
                            void* pwdCallback, void* pwdCallbackCtx) {
     BIO* bio;
     xmlSecKeyPtr key;
+    struct stat st;
 
     xmlSecAssert2(filename != NULL, NULL);
 
+    key = xmlSecOpenSSLAppKeysCacheFind(filename, xmlSecKeyDataFormatPkcs12, pwd, &st);
+    if(key != NULL) {
+        return(key);
+    }
+
     bio = BIO_new_file(filename, "rb");
     if(bio == NULL) {
         xmlSecOpenSSLError2("BIO_new_file", NULL,
@@ -526,6 +559,7 @@ xmlSecOpenSSLAppPkcs12Load(const char *filename, const char *pwd,
     }
 
     BIO_free(bio);
+    xmlSecOpenSSLAppKeysCacheAdd(filename, xmlSecKeyDataFormatPkcs12, pwd, &st, key);
     return(key);
 }
 
@@ -667,12 +701,8 @@ xmlSecOpenSSLAppPkcs12LoadBIO(BIO* bio, const char *pwd,
     }
 
     if(has_cert == 0) {
-        tmpcert = X509_dup(cert);
-        if(tmpcert == NULL) {
-            xmlSecOpenSSLError("X509_dup",
-                               xmlSecKeyDataGetName(x509Data));
-            goto done;
-        }
+        X509_up_ref(cert);
+        tmpcert = cert;
 
         ret = sk_X509_push(chain, tmpcert);
         if(ret < 1) {
@@ -694,18 +724,14 @@ xmlSecOpenSSLAppPkcs12LoadBIO(BIO* bio, const char *pwd,
     for(i = 0; i < sk_X509_num(chain); ++i) {
         xmlSecAssert2(sk_X509_value(chain, i), NULL);
 
-        tmpcert = X509_dup(sk_X509_value(chain, i));
-        if(tmpcert == NULL) {
-            xmlSecOpenSSLError("X509_dup",
-                               xmlSecKeyDataGetName(x509Data));
-            X509_free(tmpcert);
-            goto done;
-        }
+        tmpcert = sk_X509_value(chain, i);
+        X509_up_ref(tmpcert);
 
         ret = xmlSecOpenSSLKeyDataX509AdoptCert(x509Data, tmpcert);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLKeyDataX509AdoptCert",
                                 xmlSecKeyDataGetName(x509Data));
+            X509_free(tmpcert);
             goto done;
         }
     }
@@ -1028,6 +1054,39 @@ xmlSecOpenSSLAppKeysMngrAddCertsFile(xmlSecKeysMngrPtr mngr, const char *filenam
     return(0);
 }
 
+/**
+ * xmlSecOpenSSLAppKeysMngrReloadCertsPaths:
+ * @mngr:               the keys manager.
+ *
+ * Reloads the trusted certificates if any of the folders or files added
+ * with #xmlSecOpenSSLAppKeysMngrAddCertsPath or #xmlSecOpenSSLAppKeysMngrAddCertsFile
+ * changed (see #xmlSecOpenSSLX509StoreReloadCertsPaths).
+ *
+ * Returns: 1 if the certificates were reloaded, 0 if nothing changed or
+ * a negative value otherwise.
+ */
+int
+xmlSecOpenSSLAppKeysMngrReloadCertsPaths(xmlSecKeysMngrPtr mngr) {
+    xmlSecKeyDataStorePtr x509Store;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+
+    x509Store = xmlSecKeysMngrGetDataStore(mngr, xmlSecOpenSSLX509StoreId);
+    if(x509Store == NULL) {
+        xmlSecInternalError("xmlSecKeysMngrGetDataStore(xmlSecOpenSSLX509StoreId)", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLX509StoreReloadCertsPaths(x509Store);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreReloadCertsPaths", NULL);
+        return(-1);
+    }
+
+    return(ret);
+}
+
 static X509*
 xmlSecOpenSSLAppCertLoadBIO(BIO* bio, xmlSecKeyDataFormat format) {
     X509 *cert;
@@ -1140,6 +1199,134 @@ xmlSecOpenSSLAppDefaultKeysMngrAdoptKey(xmlSecKeysMngrPtr mngr, xmlSecKeyPtr key
     return(0);
 }
 
+/**
+ * xmlSecOpenSSLAppKeySetHot:
+ * @key:                the pointer to key.
+ *
+ * Marks the asymmetric @key as frequently used for signing or verification
+ * (e.g. the key of a partner that signs most of the traffic). The OpenSSL
+ * contexts initialized for the key are kept until #xmlSecOpenSSLShutdown
+ * and, for the EC keys, the generator multiples table for the key curve
+ * is precomputed (OpenSSL before 3.0). OpenSSL has no API to precompute
+ * the multiples of the public point itself.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLAppKeySetHot(xmlSecKeyPtr key) {
+    xmlSecKeyDataPtr value;
+    EVP_PKEY* pKey;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+
+    value = xmlSecKeyGetValue(key);
+    if(value == NULL) {
+        xmlSecInvalidDataError("key has no value", NULL);
+        return(-1);
+    }
+    if((xmlSecKeyDataGetType(value) & (xmlSecKeyDataTypePublic | xmlSecKeyDataTypePrivate)) == 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_KEY_DATA, xmlSecKeyDataGetName(value),
+                         "not an asymmetric key");
+        return(-1);
+    }
+
+    pKey = xmlSecOpenSSLEvpKeyDataGetEvp(value);
+    if(pKey == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLEvpKeyDataGetEvp",
+                            xmlSecKeyDataGetName(value));
+        return(-1);
+    }
+
+#if !defined(XMLSEC_NO_ECDSA) && (OPENSSL_VERSION_NUMBER < 0x30000000L)
+    if(EVP_PKEY_base_id(pKey) == EVP_PKEY_EC) {
+        EC_KEY* ecKey;
+
+        ecKey = EVP_PKEY_get1_EC_KEY(pKey);
+        if(ecKey == NULL) {
+            xmlSecOpenSSLError("EVP_PKEY_get1_EC_KEY",
+                               xmlSecKeyDataGetName(value));
+            return(-1);
+        }
+        ret = EC_KEY_precompute_mult(ecKey, NULL);
+        EC_KEY_free(ecKey);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EC_KEY_precompute_mult",
+                               xmlSecKeyDataGetName(value));
+            return(-1);
+        }
+    }
+#endif /* !defined(XMLSEC_NO_ECDSA) && (OPENSSL_VERSION_NUMBER < 0x30000000L) */
+
+    ret = xmlSecOpenSSLEvpKeySetHot(pKey);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpKeySetHot",
+                            xmlSecKeyDataGetName(value));
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLAppDefaultKeysMngrSetHotKey:
+ * @mngr:               the pointer to keys manager.
+ * @name:               the key name.
+ *
+ * Marks all the keys named @name in the keys manager @mngr created with
+ * #xmlSecOpenSSLAppDefaultKeysMngrInit function as frequently used (see
+ * #xmlSecOpenSSLAppKeySetHot).
+ *
+ * Returns: 0 on success or a negative value otherwise (including
+ * the case when there are no keys with this name).
+ */
+int
+xmlSecOpenSSLAppDefaultKeysMngrSetHotKey(xmlSecKeysMngrPtr mngr, const xmlChar* name) {
+    xmlSecKeyStorePtr store;
+    xmlSecPtrListPtr keys;
+    xmlSecKeyPtr key;
+    xmlSecSize ii, size;
+    int found = 0;
+    int ret;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    store = xmlSecKeysMngrGetKeysStore(mngr);
+    if(store == NULL) {
+        xmlSecInternalError("xmlSecKeysMngrGetKeysStore", NULL);
+        return(-1);
+    }
+
+    keys = xmlSecSimpleKeysStoreGetKeys(store);
+    if(keys == NULL) {
+        xmlSecInternalError("xmlSecSimpleKeysStoreGetKeys", NULL);
+        return(-1);
+    }
+
+    size = xmlSecPtrListGetSize(keys);
+    for(ii = 0; ii < size; ++ii) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(keys, ii);
+        if((key == NULL) || (!xmlStrEqual(xmlSecKeyGetName(key), name))) {
+            continue;
+        }
+
+        ret = xmlSecOpenSSLAppKeySetHot(key);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecOpenSSLAppKeySetHot", NULL,
+                                 "name=%s", xmlSecErrorsSafeString(name));
+            return(-1);
+        }
+        found = 1;
+    }
+
+    if(found == 0) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_KEY_NOT_FOUND, NULL,
+                          "name=%s", xmlSecErrorsSafeString(name));
+        return(-1);
+    }
+    return(0);
+}
+
 /**
  * xmlSecOpenSSLAppDefaultKeysMngrLoad:
  * @mngr:               the pointer to keys manager.
@@ -1209,6 +1396,342 @@ xmlSecOpenSSLAppDefaultKeysMngrSave(xmlSecKeysMngrPtr mngr, const char* filename
     return(0);
 }
 
+/**************************************************************************
+ *
+ * Unlocked keys cache
+ *
+ * Unlocking a password protected PKCS12 file or PEM key runs the password
+ * based key derivation (often 100k+ iterations). The cache keeps the loaded
+ * keys by the file name, format and password and checks the file identity
+ * (device, inode, size and modification time) on each lookup: reloading an
+ * unchanged file returns a copy of the cached key (sharing the OpenSSL key)
+ * and only the changed files are unlocked again. The modification time
+ * includes the nanoseconds where struct stat has them (a file rewritten
+ * within the same second is detected even if its size did not change).
+ * The passwords are not stored, only their salted SHA256 digests.
+ *
+ * The entries table is allocated from the OpenSSL secure heap. OpenSSL
+ * also allocates the private keys parts from it; the secure heap is the
+ * locked (not swappable) memory if the application initialized it with
+ * CRYPTO_secure_malloc_init(). Otherwise the regular heap is used.
+ *
+ *************************************************************************/
+#define XMLSEC_OPENSSL_APP_KEYS_CACHE_SIZE              16
+#define XMLSEC_OPENSSL_APP_KEYS_CACHE_SALT_SIZE         16
+
+#if defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
+#define xmlSecOpenSSLAppKeysCacheMTimeNsec(st)          ((long)((st)->st_mtim.tv_nsec))
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC)
+#define xmlSecOpenSSLAppKeysCacheMTimeNsec(st)          ((long)((st)->st_mtimespec.tv_nsec))
+#else  /* defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC) */
+#define xmlSecOpenSSLAppKeysCacheMTimeNsec(st)          0L
+#endif /* defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC) */
+
+#if defined(XMLSEC_OPENSSL_API_110) && !defined(LIBRESSL_VERSION_NUMBER)
+#define xmlSecOpenSSLAppKeysCacheAlloc(size)            OPENSSL_secure_zalloc(size)
+#define xmlSecOpenSSLAppKeysCacheFree(ptr, size)        OPENSSL_secure_clear_free((ptr), (size))
+#else /* defined(XMLSEC_OPENSSL_API_110) && !defined(LIBRESSL_VERSION_NUMBER) */
+#define xmlSecOpenSSLAppKeysCacheAlloc(size)            OPENSSL_malloc(size)
+#define xmlSecOpenSSLAppKeysCacheFree(ptr, size)        \
+    { OPENSSL_cleanse((ptr), (size)); OPENSSL_free(ptr); }
+#endif /* defined(XMLSEC_OPENSSL_API_110) && !defined(LIBRESSL_VERSION_NUMBER) */
+
+typedef struct _xmlSecOpenSSLAppKeysCacheEntry {
+    char*                       filename;
+    xmlSecKeyDataFormat         format;
+    xmlSecByte                  pwdDigest[SHA256_DIGEST_LENGTH];
+    dev_t                       dev;
+    ino_t                       ino;
+    off_t                       size;
+    time_t                      mtime;
+    long                        mtimeNsec;
+    xmlSecKeyPtr                key;
+    xmlSecSize                  lastUse;
+} xmlSecOpenSSLAppKeysCacheEntry, *xmlSecOpenSSLAppKeysCacheEntryPtr;
+
+typedef struct _xmlSecOpenSSLAppKeysCache {
+    xmlSecByte                  salt[XMLSEC_OPENSSL_APP_KEYS_CACHE_SALT_SIZE];
+    xmlSecOpenSSLAppKeysCacheEntry entries[XMLSEC_OPENSSL_APP_KEYS_CACHE_SIZE];
+    xmlSecSize                  clock;
+} xmlSecOpenSSLAppKeysCache, *xmlSecOpenSSLAppKeysCachePtr;
+
+static xmlSecOpenSSLAppKeysCachePtr xmlSecOpenSSLAppKeysCacheData       = NULL;
+static xmlMutexPtr                  xmlSecOpenSSLAppKeysCacheMutex      = NULL;
+
+static void
+xmlSecOpenSSLAppKeysCacheEntryClear(xmlSecOpenSSLAppKeysCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->filename != NULL) {
+        xmlFree(entry->filename);
+    }
+    if(entry->key != NULL) {
+        xmlSecKeyDestroy(entry->key);
+    }
+    OPENSSL_cleanse(entry, sizeof(xmlSecOpenSSLAppKeysCacheEntry));
+}
+
+/* should be called under the cache mutex */
+static int
+xmlSecOpenSSLAppKeysCachePwdDigest(const char* pwd, xmlSecByte* digest) {
+    EVP_MD_CTX* mdCtx;
+    int ret;
+
+    xmlSecAssert2(pwd != NULL, -1);
+    xmlSecAssert2(digest != NULL, -1);
+    xmlSecAssert2(xmlSecOpenSSLAppKeysCacheData != NULL, -1);
+
+    mdCtx = EVP_MD_CTX_create();
+    if(mdCtx == NULL) {
+        xmlSecOpenSSLError("EVP_MD_CTX_create", NULL);
+        return(-1);
+    }
+    ret = EVP_DigestInit_ex(mdCtx, EVP_sha256(), NULL);
+    if(ret == 1) {
+        ret = EVP_DigestUpdate(mdCtx, xmlSecOpenSSLAppKeysCacheData->salt,
+                               sizeof(xmlSecOpenSSLAppKeysCacheData->salt));
+    }
+    if(ret == 1) {
+        ret = EVP_DigestUpdate(mdCtx, pwd, strlen(pwd));
+    }
+    if(ret == 1) {
+        ret = EVP_DigestFinal_ex(mdCtx, digest, NULL);
+    }
+    EVP_MD_CTX_destroy(mdCtx);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_Digest", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* should be called under the cache mutex, returns NULL if not found */
+static xmlSecOpenSSLAppKeysCacheEntryPtr
+xmlSecOpenSSLAppKeysCacheEntryFind(const char* filename, xmlSecKeyDataFormat format,
+                                   const xmlSecByte* pwdDigest) {
+    xmlSecOpenSSLAppKeysCacheEntryPtr entry;
+    xmlSecSize ii;
+
+    xmlSecAssert2(filename != NULL, NULL);
+    xmlSecAssert2(pwdDigest != NULL, NULL);
+    xmlSecAssert2(xmlSecOpenSSLAppKeysCacheData != NULL, NULL);
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_APP_KEYS_CACHE_SIZE; ++ii) {
+        entry = &(xmlSecOpenSSLAppKeysCacheData->entries[ii]);
+        if((entry->key != NULL) && (entry->format == format) &&
+           (strcmp(entry->filename, filename) == 0) &&
+           (CRYPTO_memcmp(entry->pwdDigest, pwdDigest, sizeof(entry->pwdDigest)) == 0)) {
+            return(entry);
+        }
+    }
+    return(NULL);
+}
+
+/* returns a copy of the cached key or NULL, @st is set to the file identity */
+static xmlSecKeyPtr
+xmlSecOpenSSLAppKeysCacheFind(const char* filename, xmlSecKeyDataFormat format,
+                              const char* pwd, struct stat* st) {
+    xmlSecOpenSSLAppKeysCacheEntryPtr entry;
+    xmlSecByte pwdDigest[SHA256_DIGEST_LENGTH];
+    xmlSecKeyPtr key = NULL;
+
+    xmlSecAssert2(filename != NULL, NULL);
+    xmlSecAssert2(st != NULL, NULL);
+
+    /* the not protected keys are cheap to load */
+    memset(st, 0, sizeof(struct stat));
+    if((pwd == NULL) || (xmlSecOpenSSLAppKeysCacheMutex == NULL)) {
+        return(NULL);
+    }
+    if(stat(filename, st) != 0) {
+        memset(st, 0, sizeof(struct stat));
+        return(NULL);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLAppKeysCacheMutex);
+    if((xmlSecOpenSSLAppKeysCacheData != NULL) &&
+       (xmlSecOpenSSLAppKeysCachePwdDigest(pwd, pwdDigest) == 0)) {
+        entry = xmlSecOpenSSLAppKeysCacheEntryFind(filename, format, pwdDigest);
+        if(entry != NULL) {
+            if((entry->dev == st->st_dev) && (entry->ino == st->st_ino) &&
+               (entry->size == st->st_size) && (entry->mtime == st->st_mtime) &&
+               (entry->mtimeNsec == xmlSecOpenSSLAppKeysCacheMTimeNsec(st))) {
+                entry->lastUse = ++xmlSecOpenSSLAppKeysCacheData->clock;
+                key = xmlSecKeyDuplicate(entry->key);
+                if(key == NULL) {
+                    xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+                }
+            } else {
+                /* the file changed */
+                xmlSecOpenSSLAppKeysCacheEntryClear(entry);
+            }
+        }
+    }
+    xmlMutexUnlock(xmlSecOpenSSLAppKeysCacheMutex);
+
+    OPENSSL_cleanse(pwdDigest, sizeof(pwdDigest));
+    return(key);
+}
+
+/* remembers a copy of @key loaded from the file with the identity @st, failures are ignored */
+static void
+xmlSecOpenSSLAppKeysCacheAdd(const char* filename, xmlSecKeyDataFormat format,
+                             const char* pwd, const struct stat* st, xmlSecKeyPtr key) {
+    xmlSecOpenSSLAppKeysCacheEntryPtr entry;
+    xmlSecByte pwdDigest[SHA256_DIGEST_LENGTH];
+    xmlSecKeyPtr keyCopy;
+    char* filenameCopy;
+    xmlSecSize ii;
+
+    xmlSecAssert(filename != NULL);
+    xmlSecAssert(st != NULL);
+    xmlSecAssert(key != NULL);
+
+    /* the file was not found by stat() before it was loaded */
+    if((pwd == NULL) || (xmlSecOpenSSLAppKeysCacheMutex == NULL) || (st->st_mtime == 0)) {
+        return;
+    }
+
+    filenameCopy = (char*)xmlStrdup(BAD_CAST filename);
+    if(filenameCopy == NULL) {
+        xmlSecStrdupError(BAD_CAST filename, NULL);
+        return;
+    }
+    keyCopy = xmlSecKeyDuplicate(key);
+    if(keyCopy == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        xmlFree(filenameCopy);
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLAppKeysCacheMutex);
+    if((xmlSecOpenSSLAppKeysCacheData != NULL) &&
+       (xmlSecOpenSSLAppKeysCachePwdDigest(pwd, pwdDigest) == 0)) {
+        entry = xmlSecOpenSSLAppKeysCacheEntryFind(filename, format, pwdDigest);
+        if(entry == NULL) {
+            /* replace the least recently used one */
+            entry = &(xmlSecOpenSSLAppKeysCacheData->entries[0]);
+            for(ii = 1; (ii < XMLSEC_OPENSSL_APP_KEYS_CACHE_SIZE) && (entry->key != NULL); ++ii) {
+                if((xmlSecOpenSSLAppKeysCacheData->entries[ii].key == NULL) ||
+                   (xmlSecOpenSSLAppKeysCacheData->entries[ii].lastUse < entry->lastUse)) {
+                    entry = &(xmlSecOpenSSLAppKeysCacheData->entries[ii]);
+                }
+            }
+        }
+        xmlSecOpenSSLAppKeysCacheEntryClear(entry);
+
+        entry->filename = filenameCopy;
+        entry->format   = format;
+        memcpy(entry->pwdDigest, pwdDigest, sizeof(entry->pwdDigest));
+        entry->dev      = st->st_dev;
+        entry->ino      = st->st_ino;
+        entry->size     = st->st_size;
+        entry->mtime    = st->st_mtime;
+        entry->mtimeNsec = xmlSecOpenSSLAppKeysCacheMTimeNsec(st);
+        entry->key      = keyCopy;
+        entry->lastUse  = ++xmlSecOpenSSLAppKeysCacheData->clock;
+        filenameCopy = NULL;
+        keyCopy = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLAppKeysCacheMutex);
+
+    OPENSSL_cleanse(pwdDigest, sizeof(pwdDigest));
+    if(filenameCopy != NULL) {
+        xmlFree(filenameCopy);
+    }
+    if(keyCopy != NULL) {
+        xmlSecKeyDestroy(keyCopy);
+    }
+}
+
+/**
+ * xmlSecOpenSSLAppKeysCacheSetEnabled:
+ * @enabled:            the flag.
+ *
+ * Enables or disables the unlocked keys cache used by #xmlSecOpenSSLAppKeyLoad
+ * and #xmlSecOpenSSLAppPkcs12Load for the password protected key files. The
+ * cached keys are returned for the same file name, format and password as long
+ * as the file device, inode, size and modification time (with nanoseconds
+ * if the platform provides them) did not change. The
+ * cache is disabled by default and this function is not thread safe: it should
+ * be called during the application initialization. The cache is flushed
+ * when it is disabled or in #xmlSecOpenSSLShutdown.
+ *
+ * The private keys stay in memory until the cache is flushed. Initialize the
+ * OpenSSL secure heap with CRYPTO_secure_malloc_init() to keep them in the
+ * locked memory that is never swapped.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLAppKeysCacheSetEnabled(int enabled) {
+    xmlSecOpenSSLAppKeysCachePtr cache;
+
+    if(enabled == 0) {
+        if(xmlSecOpenSSLAppKeysCacheMutex == NULL) {
+            return(0);
+        }
+        xmlSecOpenSSLAppKeysCacheFlush();
+
+        cache = xmlSecOpenSSLAppKeysCacheData;
+        xmlSecOpenSSLAppKeysCacheData = NULL;
+        if(cache != NULL) {
+            xmlSecOpenSSLAppKeysCacheFree(cache, sizeof(xmlSecOpenSSLAppKeysCache));
+        }
+        xmlFreeMutex(xmlSecOpenSSLAppKeysCacheMutex);
+        xmlSecOpenSSLAppKeysCacheMutex = NULL;
+        return(0);
+    }
+
+    if(xmlSecOpenSSLAppKeysCacheMutex != NULL) {
+        return(0);
+    }
+
+    cache = (xmlSecOpenSSLAppKeysCachePtr)xmlSecOpenSSLAppKeysCacheAlloc(sizeof(xmlSecOpenSSLAppKeysCache));
+    if(cache == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLAppKeysCache), NULL);
+        return(-1);
+    }
+    memset(cache, 0, sizeof(xmlSecOpenSSLAppKeysCache));
+    if(RAND_bytes(cache->salt, sizeof(cache->salt)) != 1) {
+        xmlSecOpenSSLError("RAND_bytes", NULL);
+        xmlSecOpenSSLAppKeysCacheFree(cache, sizeof(xmlSecOpenSSLAppKeysCache));
+        return(-1);
+    }
+
+    xmlSecOpenSSLAppKeysCacheMutex = xmlNewMutex();
+    if(xmlSecOpenSSLAppKeysCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlSecOpenSSLAppKeysCacheFree(cache, sizeof(xmlSecOpenSSLAppKeysCache));
+        return(-1);
+    }
+    xmlSecOpenSSLAppKeysCacheData = cache;
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLAppKeysCacheFlush:
+ *
+ * Drops all the keys from the unlocked keys cache (see
+ * #xmlSecOpenSSLAppKeysCacheSetEnabled).
+ */
+void
+xmlSecOpenSSLAppKeysCacheFlush(void) {
+    xmlSecSize ii;
+
+    if(xmlSecOpenSSLAppKeysCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLAppKeysCacheMutex);
+    if(xmlSecOpenSSLAppKeysCacheData != NULL) {
+        for(ii = 0; ii < XMLSEC_OPENSSL_APP_KEYS_CACHE_SIZE; ++ii) {
+            xmlSecOpenSSLAppKeysCacheEntryClear(&(xmlSecOpenSSLAppKeysCacheData->entries[ii]));
+        }
+        xmlSecOpenSSLAppKeysCacheData->clock = 0;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLAppKeysCacheMutex);
+}
 
 /*
  * Random numbers initialization from openssl (apps/app_rand.c)
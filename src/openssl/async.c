@@ -0,0 +1,330 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Non-blocking execution with OpenSSL ASYNC jobs.
+ *
+ * The sign/verify/decrypt operation runs in an OpenSSL ASYNC job: when
+ * an async-capable engine (e.g. a hardware accelerator) submits
+ * a private key operation it pauses the job and the control returns to
+ * the caller who can start other operations and resume this one later
+ * (e.g. when the engine's wait fd is readable).
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <string.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/xmldsig.h>
+#include <xmlsec/xmlenc.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/openssl/crypto.h>
+#include <xmlsec/openssl/async.h>
+
+#ifdef XMLSEC_OPENSSL_ASYNC
+
+struct _xmlSecOpenSSLAsyncCtx {
+    ASYNC_JOB*                  job;
+    ASYNC_WAIT_CTX*             waitCtx;
+
+    /* the arguments of the paused xmlSecOpenSSLAsync*Ctx* operation */
+    void*                       opCtx;
+    xmlNodePtr                  opNode;
+};
+
+typedef struct _xmlSecOpenSSLAsyncJobArgs {
+    xmlSecOpenSSLAsyncOperation op;
+    void*                       data;
+} xmlSecOpenSSLAsyncJobArgs;
+
+static int      xmlSecOpenSSLAsyncJobExecute            (void* args);
+
+/**
+ * xmlSecOpenSSLAsyncCtxCreate:
+ *
+ * Creates the async execution context. The context runs one operation
+ * at a time, create one context per operation in flight.
+ *
+ * Returns: pointer to newly allocated context object or NULL if an error occurs.
+ */
+xmlSecOpenSSLAsyncCtxPtr
+xmlSecOpenSSLAsyncCtxCreate(void) {
+    xmlSecOpenSSLAsyncCtxPtr asyncCtx;
+
+    asyncCtx = (xmlSecOpenSSLAsyncCtxPtr) xmlMalloc(sizeof(xmlSecOpenSSLAsyncCtx));
+    if(asyncCtx == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLAsyncCtx), NULL);
+        return(NULL);
+    }
+    memset(asyncCtx, 0, sizeof(xmlSecOpenSSLAsyncCtx));
+
+    asyncCtx->waitCtx = ASYNC_WAIT_CTX_new();
+    if(asyncCtx->waitCtx == NULL) {
+        xmlSecOpenSSLError("ASYNC_WAIT_CTX_new", NULL);
+        xmlSecOpenSSLAsyncCtxDestroy(asyncCtx);
+        return(NULL);
+    }
+
+    return(asyncCtx);
+}
+
+/**
+ * xmlSecOpenSSLAsyncCtxDestroy:
+ * @asyncCtx:           the pointer to async execution context.
+ *
+ * Destroys the context. OpenSSL can't cancel an ASYNC job, the paused
+ * operation must be resumed until it is finished before the context is
+ * destroyed.
+ */
+void
+xmlSecOpenSSLAsyncCtxDestroy(xmlSecOpenSSLAsyncCtxPtr asyncCtx) {
+    xmlSecAssert(asyncCtx != NULL);
+    xmlSecAssert(asyncCtx->job == NULL);
+
+    if(asyncCtx->waitCtx != NULL) {
+        ASYNC_WAIT_CTX_free(asyncCtx->waitCtx);
+    }
+    memset(asyncCtx, 0, sizeof(xmlSecOpenSSLAsyncCtx));
+    xmlFree(asyncCtx);
+}
+
+/**
+ * xmlSecOpenSSLAsyncCtxRun:
+ * @asyncCtx:           the pointer to async execution context.
+ * @op:                 the operation.
+ * @data:               the operation data.
+ *
+ * Starts @op(@data) in a new ASYNC job or, if the previous call returned
+ * 0, resumes the paused job (the @op and @data are ignored in this case).
+ * The @data must stay valid until the operation is finished.
+ *
+ * Returns: 1 if the operation is finished, 0 if it is paused (call this
+ * function again to resume it) or a negative value if an error occurs
+ * or the operation failed.
+ */
+int
+xmlSecOpenSSLAsyncCtxRun(xmlSecOpenSSLAsyncCtxPtr asyncCtx, xmlSecOpenSSLAsyncOperation op, void* data) {
+    xmlSecOpenSSLAsyncJobArgs args;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(asyncCtx != NULL, -1);
+    xmlSecAssert2(asyncCtx->waitCtx != NULL, -1);
+    xmlSecAssert2(op != NULL, -1);
+
+    /* the args are copied by OpenSSL when the job starts */
+    args.op   = op;
+    args.data = data;
+
+    ret = ASYNC_start_job(&(asyncCtx->job), asyncCtx->waitCtx, &res,
+                          xmlSecOpenSSLAsyncJobExecute, &args, sizeof(args));
+    switch(ret) {
+    case ASYNC_PAUSE:
+        return(0);
+    case ASYNC_NO_JOBS:
+        /* the jobs pool is exhausted, the job is not started: try again later */
+        asyncCtx->job = NULL;
+        return(0);
+    case ASYNC_FINISH:
+        asyncCtx->job = NULL;
+        if(res < 0) {
+            xmlSecInternalError("xmlSecOpenSSLAsyncOperation", NULL);
+            return(-1);
+        }
+        return(1);
+    default:
+        asyncCtx->job = NULL;
+        xmlSecOpenSSLError("ASYNC_start_job", NULL);
+        return(-1);
+    }
+}
+
+/**
+ * xmlSecOpenSSLAsyncCtxIsPending:
+ * @asyncCtx:           the pointer to async execution context.
+ *
+ * Checks if there is a paused operation in @asyncCtx.
+ *
+ * Returns: 1 if the operation is paused, 0 otherwise.
+ */
+int
+xmlSecOpenSSLAsyncCtxIsPending(xmlSecOpenSSLAsyncCtxPtr asyncCtx) {
+    xmlSecAssert2(asyncCtx != NULL, 0);
+
+    return((asyncCtx->job != NULL) ? 1 : 0);
+}
+
+/**
+ * xmlSecOpenSSLAsyncCtxGetWaitFds:
+ * @asyncCtx:           the pointer to async execution context.
+ * @fds:                the output array for the fds or NULL to get the number of fds.
+ * @fdsSize:            the size of @fds on input and the number of the fds on output.
+ *
+ * Gets the file descriptors to wait on (e.g. with poll()) before resuming
+ * the paused operation. The fds are registered by the engine that paused
+ * the job.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLAsyncCtxGetWaitFds(xmlSecOpenSSLAsyncCtxPtr asyncCtx, OSSL_ASYNC_FD* fds, xmlSecSize* fdsSize) {
+    size_t numfds = 0;
+    int ret;
+
+    xmlSecAssert2(asyncCtx != NULL, -1);
+    xmlSecAssert2(asyncCtx->waitCtx != NULL, -1);
+    xmlSecAssert2(fdsSize != NULL, -1);
+
+    ret = ASYNC_WAIT_CTX_get_all_fds(asyncCtx->waitCtx, NULL, &numfds);
+    if(ret != 1) {
+        xmlSecOpenSSLError("ASYNC_WAIT_CTX_get_all_fds", NULL);
+        return(-1);
+    }
+    if(fds != NULL) {
+        if((*fdsSize) < numfds) {
+            xmlSecInvalidSizeLessThanError("fds array", (*fdsSize), numfds, NULL);
+            return(-1);
+        }
+        ret = ASYNC_WAIT_CTX_get_all_fds(asyncCtx->waitCtx, fds, &numfds);
+        if(ret != 1) {
+            xmlSecOpenSSLError("ASYNC_WAIT_CTX_get_all_fds", NULL);
+            return(-1);
+        }
+    }
+
+    (*fdsSize) = numfds;
+    return(0);
+}
+
+static int
+xmlSecOpenSSLAsyncJobExecute(void* args) {
+    xmlSecOpenSSLAsyncJobArgs* jobArgs = (xmlSecOpenSSLAsyncJobArgs*)args;
+
+    xmlSecAssert2(jobArgs != NULL, -1);
+    xmlSecAssert2(jobArgs->op != NULL, -1);
+
+    return(jobArgs->op(jobArgs->data));
+}
+
+#ifndef XMLSEC_NO_XMLDSIG
+static int
+xmlSecOpenSSLAsyncDSigSignOperation(void* data) {
+    xmlSecOpenSSLAsyncCtxPtr asyncCtx = (xmlSecOpenSSLAsyncCtxPtr)data;
+
+    xmlSecAssert2(asyncCtx != NULL, -1);
+
+    return(xmlSecDSigCtxSign((xmlSecDSigCtxPtr)asyncCtx->opCtx, asyncCtx->opNode));
+}
+
+static int
+xmlSecOpenSSLAsyncDSigVerifyOperation(void* data) {
+    xmlSecOpenSSLAsyncCtxPtr asyncCtx = (xmlSecOpenSSLAsyncCtxPtr)data;
+
+    xmlSecAssert2(asyncCtx != NULL, -1);
+
+    return(xmlSecDSigCtxVerify((xmlSecDSigCtxPtr)asyncCtx->opCtx, asyncCtx->opNode));
+}
+
+/**
+ * xmlSecOpenSSLAsyncDSigCtxSign:
+ * @asyncCtx:           the pointer to async execution context.
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @tmpl:               the pointer to <dsig:Signature/> node with signature template.
+ *
+ * Non-blocking #xmlSecDSigCtxSign: if the function returns 0 then
+ * call it again with the same parameters to resume the operation.
+ *
+ * Returns: 1 if the signature is created, 0 if the operation is paused
+ * or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLAsyncDSigCtxSign(xmlSecOpenSSLAsyncCtxPtr asyncCtx, xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
+    xmlSecAssert2(asyncCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+
+    if(asyncCtx->job == NULL) {
+        asyncCtx->opCtx  = dsigCtx;
+        asyncCtx->opNode = tmpl;
+    }
+    xmlSecAssert2(asyncCtx->opCtx == dsigCtx, -1);
+    xmlSecAssert2(asyncCtx->opNode == tmpl, -1);
+
+    return(xmlSecOpenSSLAsyncCtxRun(asyncCtx, xmlSecOpenSSLAsyncDSigSignOperation, asyncCtx));
+}
+
+/**
+ * xmlSecOpenSSLAsyncDSigCtxVerify:
+ * @asyncCtx:           the pointer to async execution context.
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @node:               the pointer with <dsig:Signature/> node.
+ *
+ * Non-blocking #xmlSecDSigCtxVerify: if the function returns 0 then
+ * call it again with the same parameters to resume the operation.
+ *
+ * Returns: 1 if the verification is finished (check #status member
+ * of @dsigCtx to get the result), 0 if the operation is paused or
+ * a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLAsyncDSigCtxVerify(xmlSecOpenSSLAsyncCtxPtr asyncCtx, xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    xmlSecAssert2(asyncCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(asyncCtx->job == NULL) {
+        asyncCtx->opCtx  = dsigCtx;
+        asyncCtx->opNode = node;
+    }
+    xmlSecAssert2(asyncCtx->opCtx == dsigCtx, -1);
+    xmlSecAssert2(asyncCtx->opNode == node, -1);
+
+    return(xmlSecOpenSSLAsyncCtxRun(asyncCtx, xmlSecOpenSSLAsyncDSigVerifyOperation, asyncCtx));
+}
+#endif /* XMLSEC_NO_XMLDSIG */
+
+#ifndef XMLSEC_NO_XMLENC
+static int
+xmlSecOpenSSLAsyncEncDecryptOperation(void* data) {
+    xmlSecOpenSSLAsyncCtxPtr asyncCtx = (xmlSecOpenSSLAsyncCtxPtr)data;
+
+    xmlSecAssert2(asyncCtx != NULL, -1);
+
+    return(xmlSecEncCtxDecrypt((xmlSecEncCtxPtr)asyncCtx->opCtx, asyncCtx->opNode));
+}
+
+/**
+ * xmlSecOpenSSLAsyncEncCtxDecrypt:
+ * @asyncCtx:           the pointer to async execution context.
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @node:               the pointer to <enc:EncryptedData/> node.
+ *
+ * Non-blocking #xmlSecEncCtxDecrypt: if the function returns 0 then
+ * call it again with the same parameters to resume the operation.
+ *
+ * Returns: 1 if the data is decrypted, 0 if the operation is paused
+ * or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLAsyncEncCtxDecrypt(xmlSecOpenSSLAsyncCtxPtr asyncCtx, xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    xmlSecAssert2(asyncCtx != NULL, -1);
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(asyncCtx->job == NULL) {
+        asyncCtx->opCtx  = encCtx;
+        asyncCtx->opNode = node;
+    }
+    xmlSecAssert2(asyncCtx->opCtx == encCtx, -1);
+    xmlSecAssert2(asyncCtx->opNode == node, -1);
+
+    return(xmlSecOpenSSLAsyncCtxRun(asyncCtx, xmlSecOpenSSLAsyncEncDecryptOperation, asyncCtx));
+}
+#endif /* XMLSEC_NO_XMLENC */
+
+#endif /* XMLSEC_OPENSSL_ASYNC */
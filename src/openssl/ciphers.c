@@ -11,16 +11,17 @@
 #include <string.h>
 
 #include <openssl/evp.h>
-#include <openssl/rand.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 
 /**************************************************************************
@@ -28,6 +29,10 @@
  * Internal OpenSSL Block cipher CTX
  *
  *****************************************************************************/
+/* XML Encryption 1.1: 96 bits IV is prepended and 128 bits tag is appended */
+#define XMLSEC_OPENSSL_AES_GCM_IV_SIZE                  12
+#define XMLSEC_OPENSSL_AES_GCM_TAG_SIZE                 16
+
 typedef struct _xmlSecOpenSSLEvpBlockCipherCtx          xmlSecOpenSSLEvpBlockCipherCtx,
                                                         *xmlSecOpenSSLEvpBlockCipherCtxPtr;
 struct _xmlSecOpenSSLEvpBlockCipherCtx {
@@ -36,6 +41,7 @@ struct _xmlSecOpenSSLEvpBlockCipherCtx {
     EVP_CIPHER_CTX*     cipherCtx;
     int                 keyInitialized;
     int                 ctxInitialized;
+    int                 gcmMode;
     xmlSecByte          key[EVP_MAX_KEY_LENGTH];
     xmlSecByte          iv[EVP_MAX_IV_LENGTH];
     xmlSecByte          pad[2*EVP_MAX_BLOCK_LENGTH];
@@ -63,6 +69,18 @@ static int      xmlSecOpenSSLEvpBlockCipherCtxFinal     (xmlSecOpenSSLEvpBlockCi
                                                          xmlSecBufferPtr out,
                                                          const xmlChar* cipherName,
                                                          xmlSecTransformCtxPtr transformCtx);
+#ifndef XMLSEC_NO_AES
+static int      xmlSecOpenSSLEvpGcmCipherCtxUpdate      (xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
+                                                         xmlSecBufferPtr in,
+                                                         xmlSecBufferPtr out,
+                                                         const xmlChar* cipherName,
+                                                         xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpGcmCipherCtxFinal       (xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
+                                                         xmlSecBufferPtr in,
+                                                         xmlSecBufferPtr out,
+                                                         const xmlChar* cipherName,
+                                                         xmlSecTransformCtxPtr transformCtx);
+#endif /* XMLSEC_NO_AES */
 static int
 xmlSecOpenSSLEvpBlockCipherCtxInit(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
                                 xmlSecBufferPtr in, xmlSecBufferPtr out,
@@ -84,13 +102,13 @@ xmlSecOpenSSLEvpBlockCipherCtxInit(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
     ivLen = EVP_CIPHER_iv_length(ctx->cipher);
     xmlSecAssert2(ivLen > 0, -1);
     xmlSecAssert2((xmlSecSize)ivLen <= sizeof(ctx->iv), -1);
+    xmlSecAssert2((ctx->gcmMode == 0) || (ivLen == XMLSEC_OPENSSL_AES_GCM_IV_SIZE), -1);
 
     if(encrypt) {
         /* generate random iv */
-        ret = RAND_bytes(ctx->iv, ivLen);
-        if(ret != 1) {
-            xmlSecOpenSSLError2("RAND_bytes", cipherName,
-                                "size=%lu", (unsigned long)ivLen);
+        ret = xmlSecRandomGenerate(xmlSecOpenSSLGenerateRandomBytes, NULL, ctx->iv, (xmlSecSize)ivLen);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecRandomGenerate", cipherName, "size=%d", ivLen);
             return(-1);
         }
 
@@ -128,6 +146,10 @@ xmlSecOpenSSLEvpBlockCipherCtxInit(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
     }
 
     ctx->ctxInitialized = 1;
+    if(ctx->gcmMode != 0) {
+        /* no padding in GCM */
+        return(0);
+    }
 
     /*
      * The padding used in XML Enc does not follow RFC 1423
@@ -230,6 +252,12 @@ xmlSecOpenSSLEvpBlockCipherCtxUpdate(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
     xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
+#ifndef XMLSEC_NO_AES
+    if(ctx->gcmMode != 0) {
+        return(xmlSecOpenSSLEvpGcmCipherCtxUpdate(ctx, in, out, cipherName, transformCtx));
+    }
+#endif /* XMLSEC_NO_AES */
+
     blockLen = EVP_CIPHER_block_size(ctx->cipher);
     xmlSecAssert2(blockLen > 0, -1);
 
@@ -295,6 +323,12 @@ xmlSecOpenSSLEvpBlockCipherCtxFinal(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
     xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
+#ifndef XMLSEC_NO_AES
+    if(ctx->gcmMode != 0) {
+        return(xmlSecOpenSSLEvpGcmCipherCtxFinal(ctx, in, out, cipherName, transformCtx));
+    }
+#endif /* XMLSEC_NO_AES */
+
     blockLen = EVP_CIPHER_block_size(ctx->cipher);
     xmlSecAssert2(blockLen > 0, -1);
     xmlSecAssert2(blockLen <= EVP_MAX_BLOCK_LENGTH, -1);
@@ -329,9 +363,9 @@ xmlSecOpenSSLEvpBlockCipherCtxFinal(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
 
         /* generate random padding */
         if(padLen > 1) {
-            ret = RAND_bytes(ctx->pad + inSize, padLen - 1);
-            if(ret != 1) {
-                xmlSecOpenSSLError("RAND_bytes", cipherName);
+            ret = xmlSecRandomGenerate(xmlSecOpenSSLGenerateRandomBytes, NULL, ctx->pad + inSize, padLen - 1);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecRandomGenerate", cipherName);
                 return(-1);
             }
         }
@@ -392,6 +426,138 @@ xmlSecOpenSSLEvpBlockCipherCtxFinal(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
     return(0);
 }
 
+#ifndef XMLSEC_NO_AES
+/*
+ * AES GCM (XML Encryption 1.1): no padding, the data is encrypted
+ * in as large chunks as we get and the authentication tag follows
+ * the cipher text.
+ */
+static int
+xmlSecOpenSSLEvpGcmCipherCtxUpdate(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
+                                  xmlSecBufferPtr in, xmlSecBufferPtr out,
+                                  const xmlChar* cipherName,
+                                  xmlSecTransformCtxPtr transformCtx) {
+    xmlSecSize inSize;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cipherCtx != NULL, -1);
+    xmlSecAssert2(ctx->ctxInitialized != 0, -1);
+    xmlSecAssert2(ctx->gcmMode != 0, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    inSize = xmlSecBufferGetSize(in);
+    if(!EVP_CIPHER_CTX_encrypting(ctx->cipherCtx)) {
+        /* keep the last bytes around: it might be the tag */
+        if(inSize <= XMLSEC_OPENSSL_AES_GCM_TAG_SIZE) {
+            return(0);
+        }
+        inSize -= XMLSEC_OPENSSL_AES_GCM_TAG_SIZE;
+    }
+    if(inSize == 0) {
+        return(0);
+    }
+
+    ret = xmlSecOpenSSLEvpBlockCipherCtxUpdateBlock(ctx, xmlSecBufferGetData(in), inSize, out, cipherName, 0); /* not final */
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpBlockCipherCtxUpdateBlock", cipherName);
+        return(-1);
+    }
+
+    /* remove the processed data from input */
+    ret = xmlSecBufferRemoveHead(in, inSize);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferRemoveHead", cipherName, "size=%d", (int)inSize);
+        return(-1);
+    }
+
+    /* done */
+    return(0);
+}
+
+static int
+xmlSecOpenSSLEvpGcmCipherCtxFinal(xmlSecOpenSSLEvpBlockCipherCtxPtr ctx,
+                                 xmlSecBufferPtr in,
+                                 xmlSecBufferPtr out,
+                                 const xmlChar* cipherName,
+                                 xmlSecTransformCtxPtr transformCtx) {
+    xmlSecSize inSize;
+    int outLen = 0;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cipherCtx != NULL, -1);
+    xmlSecAssert2(ctx->ctxInitialized != 0, -1);
+    xmlSecAssert2(ctx->gcmMode != 0, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+    xmlSecAssert2(sizeof(ctx->pad) >= XMLSEC_OPENSSL_AES_GCM_TAG_SIZE, -1);
+
+    inSize = xmlSecBufferGetSize(in);
+    if(EVP_CIPHER_CTX_encrypting(ctx->cipherCtx)) {
+        /* everything is already encrypted in xmlSecOpenSSLEvpGcmCipherCtxUpdate() */
+        xmlSecAssert2(inSize == 0, -1);
+
+        ret = EVP_CipherFinal(ctx->cipherCtx, ctx->pad, &outLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_CipherFinal", cipherName);
+            return(-1);
+        }
+        xmlSecAssert2(outLen == 0, -1);
+
+        /* get the tag and write it to the output */
+        ret = EVP_CIPHER_CTX_ctrl(ctx->cipherCtx, EVP_CTRL_GCM_GET_TAG,
+                                  XMLSEC_OPENSSL_AES_GCM_TAG_SIZE, ctx->pad);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_CIPHER_CTX_ctrl(EVP_CTRL_GCM_GET_TAG)", cipherName);
+            return(-1);
+        }
+
+        ret = xmlSecBufferAppend(out, ctx->pad, XMLSEC_OPENSSL_AES_GCM_TAG_SIZE);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferAppend", cipherName,
+                                 "size=%d", XMLSEC_OPENSSL_AES_GCM_TAG_SIZE);
+            return(-1);
+        }
+    } else {
+        /* the only data left is the tag */
+        if(inSize != XMLSEC_OPENSSL_AES_GCM_TAG_SIZE) {
+            xmlSecInvalidSizeError("AES GCM tag", inSize, XMLSEC_OPENSSL_AES_GCM_TAG_SIZE,
+                                   cipherName);
+            return(-1);
+        }
+
+        ret = EVP_CIPHER_CTX_ctrl(ctx->cipherCtx, EVP_CTRL_GCM_SET_TAG,
+                                  XMLSEC_OPENSSL_AES_GCM_TAG_SIZE, xmlSecBufferGetData(in));
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_CIPHER_CTX_ctrl(EVP_CTRL_GCM_SET_TAG)", cipherName);
+            return(-1);
+        }
+
+        /* this is where the tag is verified */
+        ret = EVP_CipherFinal(ctx->cipherCtx, ctx->pad, &outLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_CipherFinal", cipherName);
+            return(-1);
+        }
+        xmlSecAssert2(outLen == 0, -1);
+    }
+
+    /* remove the tag from input */
+    ret = xmlSecBufferRemoveHead(in, inSize);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferRemoveHead", cipherName, "size=%d", (int)inSize);
+        return(-1);
+    }
+
+    /* done */
+    return(0);
+}
+#endif /* XMLSEC_NO_AES */
+
 
 /******************************************************************************
  *
@@ -429,7 +595,10 @@ xmlSecOpenSSLEvpBlockCipherCheckId(xmlSecTransformPtr transform) {
 #ifndef XMLSEC_NO_AES
     if(xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes128CbcId) ||
        xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes192CbcId) ||
-       xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes256CbcId)) {
+       xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes256CbcId) ||
+       xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes128GcmId) ||
+       xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes192GcmId) ||
+       xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformAes256GcmId)) {
 
        return(1);
     }
@@ -467,6 +636,18 @@ xmlSecOpenSSLEvpBlockCipherInitialize(xmlSecTransformPtr transform) {
     } else if(transform->id == xmlSecOpenSSLTransformAes256CbcId) {
         ctx->cipher     = EVP_aes_256_cbc();
         ctx->keyId      = xmlSecOpenSSLKeyDataAesId;
+    } else if(transform->id == xmlSecOpenSSLTransformAes128GcmId) {
+        ctx->cipher     = EVP_aes_128_gcm();
+        ctx->keyId      = xmlSecOpenSSLKeyDataAesId;
+        ctx->gcmMode    = 1;
+    } else if(transform->id == xmlSecOpenSSLTransformAes192GcmId) {
+        ctx->cipher     = EVP_aes_192_gcm();
+        ctx->keyId      = xmlSecOpenSSLKeyDataAesId;
+        ctx->gcmMode    = 1;
+    } else if(transform->id == xmlSecOpenSSLTransformAes256GcmId) {
+        ctx->cipher     = EVP_aes_256_gcm();
+        ctx->keyId      = xmlSecOpenSSLKeyDataAesId;
+        ctx->gcmMode    = 1;
     } else
 #endif /* XMLSEC_NO_AES */
 
@@ -476,10 +657,12 @@ xmlSecOpenSSLEvpBlockCipherInitialize(xmlSecTransformPtr transform) {
     }
 
     /* create cipher ctx */
-    ctx->cipherCtx = EVP_CIPHER_CTX_new();
+    ctx->cipher = xmlSecOpenSSLEvpCipherFetch(ctx->cipher);
+
+    ctx->cipherCtx = xmlSecOpenSSLEvpCipherCtxAcquire();
     if(ctx->cipherCtx == NULL) {
-        xmlSecOpenSSLError("EVP_CIPHER_CTX_new",
-                           xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpCipherCtxAcquire",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -498,7 +681,7 @@ xmlSecOpenSSLEvpBlockCipherFinalize(xmlSecTransformPtr transform) {
     xmlSecAssert(ctx != NULL);
 
     if(ctx->cipherCtx != NULL) {
-        EVP_CIPHER_CTX_free(ctx->cipherCtx);
+        xmlSecOpenSSLEvpCipherCtxRelease(ctx->cipherCtx);
     }
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLEvpBlockCipherCtx));
@@ -773,6 +956,123 @@ xmlSecOpenSSLTransformAes256CbcGetKlass(void) {
     return(&xmlSecOpenSSLAes256CbcKlass);
 }
 
+static xmlSecTransformKlass xmlSecOpenSSLAes128GcmKlass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecOpenSSLEvpBlockCipherSize,            /* xmlSecSize objSize */
+
+    xmlSecNameAes128Gcm,                        /* const xmlChar* name; */
+    xmlSecHrefAes128Gcm,                        /* const xmlChar* href; */
+    xmlSecTransformUsageEncryptionMethod,       /* xmlSecAlgorithmUsage usage; */
+
+    xmlSecOpenSSLEvpBlockCipherInitialize,      /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecOpenSSLEvpBlockCipherFinalize,        /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    xmlSecOpenSSLEvpBlockCipherSetKeyReq,       /* xmlSecTransformSetKeyMethod setKeyReq; */
+    xmlSecOpenSSLEvpBlockCipherSetKey,          /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecOpenSSLEvpBlockCipherExecute,         /* xmlSecTransformExecuteMethod execute; */
+
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLTransformAes128GcmGetKlass:
+ *
+ * AES 128 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 128 GCM encryption transform.
+ */
+xmlSecTransformId
+xmlSecOpenSSLTransformAes128GcmGetKlass(void) {
+    return(&xmlSecOpenSSLAes128GcmKlass);
+}
+
+static xmlSecTransformKlass xmlSecOpenSSLAes192GcmKlass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecOpenSSLEvpBlockCipherSize,            /* xmlSecSize objSize */
+
+    xmlSecNameAes192Gcm,                        /* const xmlChar* name; */
+    xmlSecHrefAes192Gcm,                        /* const xmlChar* href; */
+    xmlSecTransformUsageEncryptionMethod,       /* xmlSecAlgorithmUsage usage; */
+
+    xmlSecOpenSSLEvpBlockCipherInitialize,      /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecOpenSSLEvpBlockCipherFinalize,        /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    xmlSecOpenSSLEvpBlockCipherSetKeyReq,       /* xmlSecTransformSetKeyMethod setKeyReq; */
+    xmlSecOpenSSLEvpBlockCipherSetKey,          /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecOpenSSLEvpBlockCipherExecute,         /* xmlSecTransformExecuteMethod execute; */
+
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLTransformAes192GcmGetKlass:
+ *
+ * AES 192 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 192 GCM encryption transform.
+ */
+xmlSecTransformId
+xmlSecOpenSSLTransformAes192GcmGetKlass(void) {
+    return(&xmlSecOpenSSLAes192GcmKlass);
+}
+
+static xmlSecTransformKlass xmlSecOpenSSLAes256GcmKlass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecOpenSSLEvpBlockCipherSize,            /* xmlSecSize objSize */
+
+    xmlSecNameAes256Gcm,                        /* const xmlChar* name; */
+    xmlSecHrefAes256Gcm,                        /* const xmlChar* href; */
+    xmlSecTransformUsageEncryptionMethod,       /* xmlSecAlgorithmUsage usage; */
+
+    xmlSecOpenSSLEvpBlockCipherInitialize,      /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecOpenSSLEvpBlockCipherFinalize,        /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    xmlSecOpenSSLEvpBlockCipherSetKeyReq,       /* xmlSecTransformSetKeyMethod setKeyReq; */
+    xmlSecOpenSSLEvpBlockCipherSetKey,          /* xmlSecTransformSetKeyMethod setKey; */
+    NULL,                                       /* xmlSecTransformValidateMethod validate; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecOpenSSLEvpBlockCipherExecute,         /* xmlSecTransformExecuteMethod execute; */
+
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLTransformAes256GcmGetKlass:
+ *
+ * AES 256 GCM encryption transform klass.
+ *
+ * Returns: pointer to AES 256 GCM encryption transform.
+ */
+xmlSecTransformId
+xmlSecOpenSSLTransformAes256GcmGetKlass(void) {
+    return(&xmlSecOpenSSLAes256GcmKlass);
+}
+
 #endif /* XMLSEC_NO_AES */
 
 #ifndef XMLSEC_NO_DES
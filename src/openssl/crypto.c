@@ -20,10 +20,12 @@
 #include <xmlsec/errors.h>
 #include <xmlsec/dl.h>
 #include <xmlsec/private.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/openssl/app.h>
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/x509.h>
+#include "evp_pool.h"
 
 static int              xmlSecOpenSSLErrorsInit                 (void);
 
@@ -78,6 +80,11 @@ xmlSecCryptoGetFunctions_openssl(void) {
     gXmlSecOpenSSLFunctions->keyDataEcdsaGetKlass       = xmlSecOpenSSLKeyDataEcdsaGetKlass;
 #endif /* XMLSEC_NO_ECDSA */
 
+#ifndef XMLSEC_NO_EDDSA
+    gXmlSecOpenSSLFunctions->keyDataEd25519GetKlass     = xmlSecOpenSSLKeyDataEd25519GetKlass;
+    gXmlSecOpenSSLFunctions->keyDataEd448GetKlass       = xmlSecOpenSSLKeyDataEd448GetKlass;
+#endif /* XMLSEC_NO_EDDSA */
+
 #ifndef XMLSEC_NO_GOST
     gXmlSecOpenSSLFunctions->keyDataGost2001GetKlass           = xmlSecOpenSSLKeyDataGost2001GetKlass;
 #endif /* XMLSEC_NO_GOST */
@@ -120,6 +127,9 @@ xmlSecCryptoGetFunctions_openssl(void) {
     gXmlSecOpenSSLFunctions->transformAes128CbcGetKlass         = xmlSecOpenSSLTransformAes128CbcGetKlass;
     gXmlSecOpenSSLFunctions->transformAes192CbcGetKlass         = xmlSecOpenSSLTransformAes192CbcGetKlass;
     gXmlSecOpenSSLFunctions->transformAes256CbcGetKlass         = xmlSecOpenSSLTransformAes256CbcGetKlass;
+    gXmlSecOpenSSLFunctions->transformAes128GcmGetKlass         = xmlSecOpenSSLTransformAes128GcmGetKlass;
+    gXmlSecOpenSSLFunctions->transformAes192GcmGetKlass         = xmlSecOpenSSLTransformAes192GcmGetKlass;
+    gXmlSecOpenSSLFunctions->transformAes256GcmGetKlass         = xmlSecOpenSSLTransformAes256GcmGetKlass;
     gXmlSecOpenSSLFunctions->transformKWAes128GetKlass          = xmlSecOpenSSLTransformKWAes128GetKlass;
     gXmlSecOpenSSLFunctions->transformKWAes192GetKlass          = xmlSecOpenSSLTransformKWAes192GetKlass;
     gXmlSecOpenSSLFunctions->transformKWAes256GetKlass          = xmlSecOpenSSLTransformKWAes256GetKlass;
@@ -169,6 +179,12 @@ xmlSecCryptoGetFunctions_openssl(void) {
 
 #endif /* XMLSEC_NO_ECDSA */
 
+    /******************************* EdDSA ********************************/
+#ifndef XMLSEC_NO_EDDSA
+    gXmlSecOpenSSLFunctions->transformEd25519GetKlass           = xmlSecOpenSSLTransformEd25519GetKlass;
+    gXmlSecOpenSSLFunctions->transformEd448GetKlass             = xmlSecOpenSSLTransformEd448GetKlass;
+#endif /* XMLSEC_NO_EDDSA */
+
     /******************************* GOST ********************************/
 #ifndef XMLSEC_NO_GOST
     gXmlSecOpenSSLFunctions->transformGost2001GostR3411_94GetKlass     = xmlSecOpenSSLTransformGost2001GostR3411_94GetKlass;
@@ -327,6 +343,9 @@ xmlSecOpenSSLInit (void)  {
         return(-1);
     }
 
+    /* pooled contexts and pre-fetched algorithms */
+    xmlSecOpenSSLEvpPoolInitialize();
+
     /* register our klasses */
     if(xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(xmlSecCryptoGetFunctions_openssl()) < 0) {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
@@ -346,6 +365,11 @@ xmlSecOpenSSLInit (void)  {
 int
 xmlSecOpenSSLShutdown(void) {
     xmlSecOpenSSLSetDefaultTrustedCertsFolder(NULL);
+    xmlSecOpenSSLAppKeysCacheSetEnabled(0);
+
+    /* the cached transforms hold the pooled contexts */
+    xmlSecTransformCacheFlush();
+    xmlSecOpenSSLEvpPoolShutdown();
     return(0);
 }
 
@@ -390,7 +414,8 @@ xmlSecOpenSSLKeysMngrInit(xmlSecKeysMngrPtr mngr) {
  * @buffer:             the destination buffer.
  * @size:               the numer of bytes to generate.
  *
- * Generates @size random bytes and puts result in @buffer.
+ * Generates @size random bytes and puts result in @buffer
+ * (see #xmlSecRandomGenerate).
  *
  * Returns: 0 on success or a negative value otherwise.
  */
@@ -408,10 +433,35 @@ xmlSecOpenSSLGenerateRandom(xmlSecBufferPtr buffer, xmlSecSize size) {
     }
 
     /* get random data */
-    ret = RAND_bytes((xmlSecByte*)xmlSecBufferGetData(buffer), size);
+    ret = xmlSecRandomGenerate(xmlSecOpenSSLGenerateRandomBytes, NULL,
+                               xmlSecBufferGetData(buffer), size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL, "size=" XMLSEC_SIZE_FMT, size);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLGenerateRandomBytes:
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ * @context:            not used.
+ *
+ * The OpenSSL random generator for #xmlSecRandomGenerate.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLGenerateRandomBytes(xmlSecByte* out, xmlSecSize outSize, void* context ATTRIBUTE_UNUSED) {
+    int ret;
+
+    xmlSecAssert2(out != NULL, -1);
+
+    ret = RAND_bytes(out, outSize);
     if(ret != 1) {
         xmlSecOpenSSLError2("RAND_bytes", NULL,
-                            "size=%lu", (unsigned long)size);
+                            "size=%lu", (unsigned long)outSize);
         return(-1);
     }
     return(0);
@@ -20,6 +20,7 @@
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 /**************************************************************************
  *
@@ -49,13 +50,21 @@ struct _xmlSecOpenSSLDigestCtx {
 
 static int      xmlSecOpenSSLEvpDigestInitialize        (xmlSecTransformPtr transform);
 static void     xmlSecOpenSSLEvpDigestFinalize          (xmlSecTransformPtr transform);
+static int      xmlSecOpenSSLEvpDigestReset             (xmlSecTransformPtr transform);
 static int      xmlSecOpenSSLEvpDigestVerify            (xmlSecTransformPtr transform,
                                                          const xmlSecByte* data,
                                                          xmlSecSize dataSize,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpDigestPushBin           (xmlSecTransformPtr transform,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize,
+                                                         int final,
+                                                         xmlSecTransformCtxPtr transformCtx);
 static int      xmlSecOpenSSLEvpDigestExecute           (xmlSecTransformPtr transform,
                                                          int last,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpDigestStart             (xmlSecTransformPtr transform,
+                                                         xmlSecOpenSSLDigestCtxPtr ctx);
 static int      xmlSecOpenSSLEvpDigestCheckId           (xmlSecTransformPtr transform);
 
 static int
@@ -217,10 +226,12 @@ xmlSecOpenSSLEvpDigestInitialize(xmlSecTransformPtr transform) {
     }
 
     /* create digest CTX */
-    ctx->digestCtx = EVP_MD_CTX_new();
+    ctx->digest = xmlSecOpenSSLEvpDigestFetch(ctx->digest);
+
+    ctx->digestCtx = xmlSecOpenSSLEvpMdCtxAcquire();
     if(ctx->digestCtx == NULL) {
-        xmlSecOpenSSLError("EVP_MD_CTX_new",
-                           xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpMdCtxAcquire",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -239,12 +250,32 @@ xmlSecOpenSSLEvpDigestFinalize(xmlSecTransformPtr transform) {
     xmlSecAssert(ctx != NULL);
 
     if(ctx->digestCtx != NULL) {
-        EVP_MD_CTX_free(ctx->digestCtx);
+        xmlSecOpenSSLEvpMdCtxRelease(ctx->digestCtx);
     }
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLDigestCtx));
 }
 
+static int
+xmlSecOpenSSLEvpDigestReset(xmlSecTransformPtr transform) {
+    xmlSecOpenSSLDigestCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpDigestCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpDigestSize), -1);
+
+    ctx = xmlSecOpenSSLEvpDigestGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    /* keep the digest and the digest context for the next use: the context
+     * is not reset, EVP_DigestInit_ex() re-initializes it in place and
+     * the provider's digest state is not freed and re-created for every
+     * (usually short) reference */
+    memset(ctx->dgst, 0, sizeof(ctx->dgst));
+    ctx->dgstSize = 0;
+    return(0);
+}
+
 static int
 xmlSecOpenSSLEvpDigestVerify(xmlSecTransformPtr transform,
                         const xmlSecByte* data, xmlSecSize dataSize,
@@ -280,6 +311,77 @@ xmlSecOpenSSLEvpDigestVerify(xmlSecTransformPtr transform,
     return(0);
 }
 
+static int
+xmlSecOpenSSLEvpDigestStart(xmlSecTransformPtr transform, xmlSecOpenSSLDigestCtxPtr ctx) {
+    int ret;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digest != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    if(transform->status == xmlSecTransformStatusNone) {
+        ret = EVP_DigestInit_ex(ctx->digestCtx, ctx->digest, NULL);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_DigestInit_ex",
+                               xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        transform->status = xmlSecTransformStatusWorking;
+    }
+    return(0);
+}
+
+/*
+ * The digest consumes all its input right away: instead of staging the data
+ * in the inBuf and processing it in XMLSEC_TRANSFORM_BINARY_CHUNK pieces
+ * (see xmlSecTransformDefaultPushBin), the pushed block is passed directly
+ * to EVP_DigestUpdate(). This lets the streaming producers (e.g. c14n via
+ * xmlSecTransformCreateOutputBuffer) hash their output without any copies.
+ */
+static int
+xmlSecOpenSSLEvpDigestPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
+                        xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecOpenSSLDigestCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpDigestCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpDigestSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecOpenSSLEvpDigestGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if((dataSize > 0) && (xmlSecBufferGetSize(&(transform->inBuf)) == 0)) {
+        xmlSecAssert2(data != NULL, -1);
+
+        ret = xmlSecOpenSSLEvpDigestStart(transform, ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLEvpDigestStart",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        if(transform->status == xmlSecTransformStatusWorking) {
+            ret = EVP_DigestUpdate(ctx->digestCtx, data, dataSize);
+            if(ret != 1) {
+                xmlSecOpenSSLError2("EVP_DigestUpdate",
+                                    xmlSecTransformGetName(transform),
+                                    "size=%lu", (unsigned long)dataSize);
+                return(-1);
+            }
+            data = NULL;
+            dataSize = 0;
+        }
+    }
+
+    /* nothing left to do until the final call */
+    if((dataSize == 0) && (final == 0)) {
+        return(0);
+    }
+    return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+}
+
 static int
 xmlSecOpenSSLEvpDigestExecute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr transformCtx) {
     xmlSecOpenSSLDigestCtxPtr ctx;
@@ -302,14 +404,11 @@ xmlSecOpenSSLEvpDigestExecute(xmlSecTransformPtr transform, int last, xmlSecTran
     xmlSecAssert2(ctx->digest != NULL, -1);
     xmlSecAssert2(ctx->digestCtx != NULL, -1);
 
-    if(transform->status == xmlSecTransformStatusNone) {
-        ret = EVP_DigestInit(ctx->digestCtx, ctx->digest);
-        if(ret != 1) {
-            xmlSecOpenSSLError("EVP_DigestInit",
-                               xmlSecTransformGetName(transform));
-            return(-1);
-        }
-        transform->status = xmlSecTransformStatusWorking;
+    ret = xmlSecOpenSSLEvpDigestStart(transform, ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpDigestStart",
+                            xmlSecTransformGetName(transform));
+        return(-1);
     }
 
     if(transform->status == xmlSecTransformStatusWorking) {
@@ -338,9 +437,9 @@ xmlSecOpenSSLEvpDigestExecute(xmlSecTransformPtr transform, int last, xmlSecTran
 
             xmlSecAssert2((xmlSecSize)EVP_MD_size(ctx->digest) <= sizeof(ctx->dgst), -1);
 
-            ret = EVP_DigestFinal(ctx->digestCtx, ctx->dgst, &dgstSize);
+            ret = EVP_DigestFinal_ex(ctx->digestCtx, ctx->dgst, &dgstSize);
             if(ret != 1) {
-                xmlSecOpenSSLError("EVP_DigestFinal",
+                xmlSecOpenSSLError("EVP_DigestFinal_ex",
                                    xmlSecTransformGetName(transform));
                 return(-1);
             }
@@ -394,13 +493,13 @@ static xmlSecTransformKlass xmlSecOpenSSLMd5Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -440,13 +539,13 @@ static xmlSecTransformKlass xmlSecOpenSSLRipemd160Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -487,13 +586,13 @@ static xmlSecTransformKlass xmlSecOpenSSLSha1Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -533,13 +632,13 @@ static xmlSecTransformKlass xmlSecOpenSSLSha224Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -579,13 +678,13 @@ static xmlSecTransformKlass xmlSecOpenSSLSha256Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -625,13 +724,13 @@ static xmlSecTransformKlass xmlSecOpenSSLSha384Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -671,13 +770,13 @@ static xmlSecTransformKlass xmlSecOpenSSLSha512Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,              /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -716,12 +815,12 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_94Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,                /* xmlSecTransformExecuteMethod execute; */
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -761,12 +860,12 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_2012_256Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,                /* xmlSecTransformExecuteMethod execute; */
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -803,12 +902,12 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_2012_512Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpDigestExecute,                /* xmlSecTransformExecuteMethod execute; */
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpDigestReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
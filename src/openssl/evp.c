@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include <openssl/evp.h>
+#include <openssl/err.h>
 #include <openssl/rand.h>
 
 #include <xmlsec/xmlsec.h>
@@ -24,6 +25,7 @@
 #include <xmlsec/openssl/bn.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 /******************************************************************************
  *
@@ -387,6 +389,24 @@ xmlSecOpenSSLEvpKeyAdopt(EVP_PKEY *pKey) {
         break;
 #endif /* XMLSEC_NO_GOST2012 */
 
+#ifndef XMLSEC_NO_EDDSA
+    case EVP_PKEY_ED25519:
+        data = xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataEd25519Id);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataEd25519Id)", NULL);
+            return(NULL);
+        }
+        break;
+
+    case EVP_PKEY_ED448:
+        data = xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataEd448Id);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataEd448Id)", NULL);
+            return(NULL);
+        }
+        break;
+#endif /* XMLSEC_NO_EDDSA */
+
     default:
         xmlSecInvalidIntegerTypeError("evp key type", EVP_PKEY_base_id(pKey),
                 "supported evp key type", NULL);
@@ -403,6 +423,101 @@ xmlSecOpenSSLEvpKeyAdopt(EVP_PKEY *pKey) {
     return(data);
 }
 
+#if !defined(XMLSEC_NO_DSA) || !defined(XMLSEC_NO_RSA)
+/*
+ * Serializes the <dsig:KeyValue/> child node content to look up the key in
+ * the public keys cache. Returns 1 if the key could be cached, 0 if the
+ * node has @privateNodeName child (private keys are never cached) or
+ * a negative value if an error occurs.
+ */
+static int
+xmlSecOpenSSLEvpKeyValueGetCacheId(xmlSecKeyDataId id, xmlNodePtr node,
+                                   const xmlChar* privateNodeName, xmlSecBufferPtr cacheId) {
+    xmlNodePtr cur;
+    xmlChar* content;
+    int ret;
+
+    xmlSecAssert2(id != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(privateNodeName != NULL, -1);
+    xmlSecAssert2(cacheId != NULL, -1);
+
+    /* name=content pairs separated by zero bytes */
+    ret = xmlSecBufferAppend(cacheId, xmlSecKeyDataKlassGetName(id),
+                             xmlStrlen(xmlSecKeyDataKlassGetName(id)) + 1);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+    for(cur = xmlSecGetNextElementNode(node->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlStrEqual(cur->name, privateNodeName)) {
+            return(0);
+        }
+
+        ret = xmlSecBufferAppend(cacheId, cur->name, xmlStrlen(cur->name) + 1);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+
+        content = xmlNodeGetContent(cur);
+        if(content == NULL) {
+            continue;
+        }
+        ret = xmlSecBufferAppend(cacheId, content, xmlStrlen(content) + 1);
+        xmlFree(content);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", xmlSecKeyDataKlassGetName(id));
+            return(-1);
+        }
+    }
+    return(1);
+}
+
+/*
+ * Sets the @key value from the public keys cache. Returns 1 if the key
+ * was found, 0 if it is not in the cache or a negative value if an error occurs.
+ */
+static int
+xmlSecOpenSSLEvpKeyValueGetCached(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlSecBufferPtr cacheId) {
+    xmlSecKeyDataPtr data;
+    EVP_PKEY* pKey;
+    int ret;
+
+    xmlSecAssert2(id != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(cacheId != NULL, -1);
+
+    pKey = xmlSecOpenSSLEvpKeyCacheFind(xmlSecBufferGetData(cacheId), xmlSecBufferGetSize(cacheId));
+    if(pKey == NULL) {
+        return(0);
+    }
+
+    data = xmlSecKeyDataCreate(id);
+    if(data == NULL ) {
+        xmlSecInternalError("xmlSecKeyDataCreate", xmlSecKeyDataKlassGetName(id));
+        EVP_PKEY_free(pKey);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLEvpKeyDataAdoptEvp(data, pKey);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpKeyDataAdoptEvp", xmlSecKeyDataKlassGetName(id));
+        EVP_PKEY_free(pKey);
+        xmlSecKeyDataDestroy(data);
+        return(-1);
+    }
+
+    ret = xmlSecKeySetValue(key, data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeySetValue", xmlSecKeyDataKlassGetName(id));
+        xmlSecKeyDataDestroy(data);
+        return(-1);
+    }
+    return(1);
+}
+#endif /* !defined(XMLSEC_NO_DSA) || !defined(XMLSEC_NO_RSA) */
+
 #ifndef XMLSEC_NO_DSA
 /**************************************************************************
  *
@@ -679,6 +794,8 @@ xmlSecOpenSSLKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     DSA *dsa = NULL;
     BIGNUM *p = NULL, *q = NULL, *g = NULL;
     BIGNUM *priv_key = NULL, *pub_key = NULL;
+    xmlSecBuffer cacheId;
+    int cacheable;
     int ret;
 
     xmlSecAssert2(id == xmlSecOpenSSLKeyDataDsaId, -1);
@@ -693,6 +810,22 @@ xmlSecOpenSSLKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         return(-1);
     }
 
+    /* the same public key might have been read already */
+    ret = xmlSecBufferInitialize(&cacheId, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+    cacheable = xmlSecOpenSSLEvpKeyValueGetCacheId(id, node, xmlSecNodeDSAX, &cacheId);
+    if(cacheable > 0) {
+        ret = xmlSecOpenSSLEvpKeyValueGetCached(id, key, &cacheId);
+        if(ret != 0) {
+            xmlSecBufferFinalize(&cacheId);
+            return((ret > 0) ? 0 : -1);
+        }
+    }
+
     dsa = DSA_new();
     if(dsa == NULL) {
         xmlSecOpenSSLError("DSA_new",
@@ -821,6 +954,12 @@ xmlSecOpenSSLKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     }
     dsa = NULL;
 
+    if(cacheable > 0) {
+        xmlSecOpenSSLEvpKeyCacheAdd(xmlSecBufferGetData(&cacheId), xmlSecBufferGetSize(&cacheId),
+                                    xmlSecOpenSSLKeyDataDsaGetEvp(data));
+    }
+    xmlSecBufferFinalize(&cacheId);
+
     ret = xmlSecKeySetValue(key, data);
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeySetValue",
@@ -832,6 +971,7 @@ xmlSecOpenSSLKeyDataDsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     return(0);
 
 err_cleanup:
+    xmlSecBufferFinalize(&cacheId);
     DSA_free(dsa);
     BN_free(p);
     BN_free(q);
@@ -1587,6 +1727,8 @@ xmlSecOpenSSLKeyDataRsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     xmlNodePtr cur;
     RSA *rsa = NULL;
     BIGNUM *n = NULL, *e = NULL, *d = NULL;
+    xmlSecBuffer cacheId;
+    int cacheable;
     int ret;
 
     xmlSecAssert2(id == xmlSecOpenSSLKeyDataRsaId, -1);
@@ -1601,10 +1743,27 @@ xmlSecOpenSSLKeyDataRsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         return(-1);
     }
 
+    /* the same public key might have been read already */
+    ret = xmlSecBufferInitialize(&cacheId, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+    cacheable = xmlSecOpenSSLEvpKeyValueGetCacheId(id, node, xmlSecNodeRSAPrivateExponent, &cacheId);
+    if(cacheable > 0) {
+        ret = xmlSecOpenSSLEvpKeyValueGetCached(id, key, &cacheId);
+        if(ret != 0) {
+            xmlSecBufferFinalize(&cacheId);
+            return((ret > 0) ? 0 : -1);
+        }
+    }
+
     rsa = RSA_new();
     if(rsa == NULL) {
         xmlSecOpenSSLError("RSA_new",
                            xmlSecKeyDataGetName(data));
+        xmlSecBufferFinalize(&cacheId);
         return(-1);
     }
 
@@ -1677,6 +1836,12 @@ xmlSecOpenSSLKeyDataRsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         goto err_cleanup;
     }
 
+    if(cacheable > 0) {
+        xmlSecOpenSSLEvpKeyCacheAdd(xmlSecBufferGetData(&cacheId), xmlSecBufferGetSize(&cacheId),
+                                    xmlSecOpenSSLKeyDataRsaGetEvp(data));
+    }
+    xmlSecBufferFinalize(&cacheId);
+
     ret = xmlSecKeySetValue(key, data);
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeySetValue",
@@ -1688,6 +1853,7 @@ xmlSecOpenSSLKeyDataRsaXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     return(0);
 
 err_cleanup:
+    xmlSecBufferFinalize(&cacheId);
     RSA_free(rsa);
     BN_free(n);
     BN_free(e);
@@ -2280,3 +2446,287 @@ xmlSecOpenSSLKeyDataGostR3410_2012_512DebugXmlDump(xmlSecKeyDataPtr data, FILE*
 
 #endif /* XMLSEC_NO_GOST2012 */
 
+
+#ifndef XMLSEC_NO_EDDSA
+/**************************************************************************
+ *
+ * EdDSA keys: there is no standard KeyValue representation for these
+ * keys yet, they can only be loaded from files (PEM, DER, PKCS#8, ...).
+ *
+ *************************************************************************/
+static xmlSecKeyDataType
+xmlSecOpenSSLKeyDataEdGetType(xmlSecKeyDataPtr data) {
+    EVP_PKEY* pKey;
+    size_t len = 0;
+
+    pKey = xmlSecOpenSSLEvpKeyDataGetEvp(data);
+    if(pKey == NULL) {
+        return(xmlSecKeyDataTypeUnknown);
+    }
+
+    /* raw private key is available only if we actually have it */
+    if(EVP_PKEY_get_raw_private_key(pKey, NULL, &len) == 1) {
+        return(xmlSecKeyDataTypePrivate | xmlSecKeyDataTypePublic);
+    }
+    ERR_clear_error();
+    return(xmlSecKeyDataTypePublic);
+}
+
+static xmlSecSize
+xmlSecOpenSSLKeyDataEdGetSize(xmlSecKeyDataPtr data) {
+    EVP_PKEY* pKey;
+    int ret;
+
+    pKey = xmlSecOpenSSLEvpKeyDataGetEvp(data);
+    if(pKey == NULL) {
+        return(0);
+    }
+
+    ret = EVP_PKEY_bits(pKey);
+    if(ret <= 0) {
+        return(0);
+    }
+    return((xmlSecSize)ret);
+}
+
+/**************************************************************************
+ *
+ * Ed25519 key data
+ *
+ *************************************************************************/
+static int              xmlSecOpenSSLKeyDataEd25519Initialize   (xmlSecKeyDataPtr data);
+static int              xmlSecOpenSSLKeyDataEd25519Duplicate    (xmlSecKeyDataPtr dst,
+                                                                 xmlSecKeyDataPtr src);
+static void             xmlSecOpenSSLKeyDataEd25519Finalize     (xmlSecKeyDataPtr data);
+
+static xmlSecKeyDataType xmlSecOpenSSLKeyDataEd25519GetType     (xmlSecKeyDataPtr data);
+static xmlSecSize        xmlSecOpenSSLKeyDataEd25519GetSize     (xmlSecKeyDataPtr data);
+static void              xmlSecOpenSSLKeyDataEd25519DebugDump   (xmlSecKeyDataPtr data,
+                                                                 FILE* output);
+static void             xmlSecOpenSSLKeyDataEd25519DebugXmlDump (xmlSecKeyDataPtr data,
+                                                                 FILE* output);
+
+static xmlSecKeyDataKlass xmlSecOpenSSLKeyDataEd25519Klass = {
+    sizeof(xmlSecKeyDataKlass),
+    xmlSecOpenSSLEvpKeyDataSize,
+
+    /* data */
+    xmlSecNameEd25519KeyValue,
+    xmlSecKeyDataUsageReadFromFile,             /* xmlSecKeyDataUsage usage; */
+    NULL,                                       /* const xmlChar* href; */
+    NULL,                                       /* const xmlChar* dataNodeName; */
+    NULL,                                       /* const xmlChar* dataNodeNs; */
+
+    /* constructors/destructor */
+    xmlSecOpenSSLKeyDataEd25519Initialize,      /* xmlSecKeyDataInitializeMethod initialize; */
+    xmlSecOpenSSLKeyDataEd25519Duplicate,       /* xmlSecKeyDataDuplicateMethod duplicate; */
+    xmlSecOpenSSLKeyDataEd25519Finalize,        /* xmlSecKeyDataFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecKeyDataGenerateMethod generate; */
+
+    /* get info */
+    xmlSecOpenSSLKeyDataEd25519GetType,         /* xmlSecKeyDataGetTypeMethod getType; */
+    xmlSecOpenSSLKeyDataEd25519GetSize,         /* xmlSecKeyDataGetSizeMethod getSize; */
+    NULL,                                       /* xmlSecKeyDataGetIdentifier getIdentifier; */
+
+    /* read/write */
+    NULL,                                       /* xmlSecKeyDataXmlReadMethod xmlRead; */
+    NULL,                                       /* xmlSecKeyDataXmlWriteMethod xmlWrite; */
+    NULL,                                       /* xmlSecKeyDataBinReadMethod binRead; */
+    NULL,                                       /* xmlSecKeyDataBinWriteMethod binWrite; */
+
+    /* debug */
+    xmlSecOpenSSLKeyDataEd25519DebugDump,       /* xmlSecKeyDataDebugDumpMethod debugDump; */
+    xmlSecOpenSSLKeyDataEd25519DebugXmlDump,    /* xmlSecKeyDataDebugDumpMethod debugXmlDump; */
+
+    /* reserved for the future */
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLKeyDataEd25519GetKlass:
+ *
+ * The Ed25519 key data klass.
+ *
+ * Returns: pointer to Ed25519 key data klass.
+ */
+xmlSecKeyDataId
+xmlSecOpenSSLKeyDataEd25519GetKlass(void) {
+    return(&xmlSecOpenSSLKeyDataEd25519Klass);
+}
+
+static int
+xmlSecOpenSSLKeyDataEd25519Initialize(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id), -1);
+
+    return(xmlSecOpenSSLEvpKeyDataInitialize(data));
+}
+
+static int
+xmlSecOpenSSLKeyDataEd25519Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(dst, xmlSecOpenSSLKeyDataEd25519Id), -1);
+    xmlSecAssert2(xmlSecKeyDataCheckId(src, xmlSecOpenSSLKeyDataEd25519Id), -1);
+
+    return(xmlSecOpenSSLEvpKeyDataDuplicate(dst, src));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd25519Finalize(xmlSecKeyDataPtr data) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id));
+
+    xmlSecOpenSSLEvpKeyDataFinalize(data);
+}
+
+static xmlSecKeyDataType
+xmlSecOpenSSLKeyDataEd25519GetType(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id), xmlSecKeyDataTypeUnknown);
+
+    return(xmlSecOpenSSLKeyDataEdGetType(data));
+}
+
+static xmlSecSize
+xmlSecOpenSSLKeyDataEd25519GetSize(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id), 0);
+
+    return(xmlSecOpenSSLKeyDataEdGetSize(data));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd25519DebugDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id));
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "=== ed25519 key: size = %lu\n",
+            (unsigned long)xmlSecOpenSSLKeyDataEd25519GetSize(data));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd25519DebugXmlDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd25519Id));
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "<Ed25519KeyValue size=\"%lu\" />\n",
+            (unsigned long)xmlSecOpenSSLKeyDataEd25519GetSize(data));
+}
+
+/**************************************************************************
+ *
+ * Ed448 key data
+ *
+ *************************************************************************/
+static int              xmlSecOpenSSLKeyDataEd448Initialize   (xmlSecKeyDataPtr data);
+static int              xmlSecOpenSSLKeyDataEd448Duplicate    (xmlSecKeyDataPtr dst,
+                                                                 xmlSecKeyDataPtr src);
+static void             xmlSecOpenSSLKeyDataEd448Finalize     (xmlSecKeyDataPtr data);
+
+static xmlSecKeyDataType xmlSecOpenSSLKeyDataEd448GetType     (xmlSecKeyDataPtr data);
+static xmlSecSize        xmlSecOpenSSLKeyDataEd448GetSize     (xmlSecKeyDataPtr data);
+static void              xmlSecOpenSSLKeyDataEd448DebugDump   (xmlSecKeyDataPtr data,
+                                                                 FILE* output);
+static void             xmlSecOpenSSLKeyDataEd448DebugXmlDump (xmlSecKeyDataPtr data,
+                                                                 FILE* output);
+
+static xmlSecKeyDataKlass xmlSecOpenSSLKeyDataEd448Klass = {
+    sizeof(xmlSecKeyDataKlass),
+    xmlSecOpenSSLEvpKeyDataSize,
+
+    /* data */
+    xmlSecNameEd448KeyValue,
+    xmlSecKeyDataUsageReadFromFile,             /* xmlSecKeyDataUsage usage; */
+    NULL,                                       /* const xmlChar* href; */
+    NULL,                                       /* const xmlChar* dataNodeName; */
+    NULL,                                       /* const xmlChar* dataNodeNs; */
+
+    /* constructors/destructor */
+    xmlSecOpenSSLKeyDataEd448Initialize,      /* xmlSecKeyDataInitializeMethod initialize; */
+    xmlSecOpenSSLKeyDataEd448Duplicate,       /* xmlSecKeyDataDuplicateMethod duplicate; */
+    xmlSecOpenSSLKeyDataEd448Finalize,        /* xmlSecKeyDataFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecKeyDataGenerateMethod generate; */
+
+    /* get info */
+    xmlSecOpenSSLKeyDataEd448GetType,         /* xmlSecKeyDataGetTypeMethod getType; */
+    xmlSecOpenSSLKeyDataEd448GetSize,         /* xmlSecKeyDataGetSizeMethod getSize; */
+    NULL,                                       /* xmlSecKeyDataGetIdentifier getIdentifier; */
+
+    /* read/write */
+    NULL,                                       /* xmlSecKeyDataXmlReadMethod xmlRead; */
+    NULL,                                       /* xmlSecKeyDataXmlWriteMethod xmlWrite; */
+    NULL,                                       /* xmlSecKeyDataBinReadMethod binRead; */
+    NULL,                                       /* xmlSecKeyDataBinWriteMethod binWrite; */
+
+    /* debug */
+    xmlSecOpenSSLKeyDataEd448DebugDump,       /* xmlSecKeyDataDebugDumpMethod debugDump; */
+    xmlSecOpenSSLKeyDataEd448DebugXmlDump,    /* xmlSecKeyDataDebugDumpMethod debugXmlDump; */
+
+    /* reserved for the future */
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLKeyDataEd448GetKlass:
+ *
+ * The Ed448 key data klass.
+ *
+ * Returns: pointer to Ed448 key data klass.
+ */
+xmlSecKeyDataId
+xmlSecOpenSSLKeyDataEd448GetKlass(void) {
+    return(&xmlSecOpenSSLKeyDataEd448Klass);
+}
+
+static int
+xmlSecOpenSSLKeyDataEd448Initialize(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id), -1);
+
+    return(xmlSecOpenSSLEvpKeyDataInitialize(data));
+}
+
+static int
+xmlSecOpenSSLKeyDataEd448Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(dst, xmlSecOpenSSLKeyDataEd448Id), -1);
+    xmlSecAssert2(xmlSecKeyDataCheckId(src, xmlSecOpenSSLKeyDataEd448Id), -1);
+
+    return(xmlSecOpenSSLEvpKeyDataDuplicate(dst, src));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd448Finalize(xmlSecKeyDataPtr data) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id));
+
+    xmlSecOpenSSLEvpKeyDataFinalize(data);
+}
+
+static xmlSecKeyDataType
+xmlSecOpenSSLKeyDataEd448GetType(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id), xmlSecKeyDataTypeUnknown);
+
+    return(xmlSecOpenSSLKeyDataEdGetType(data));
+}
+
+static xmlSecSize
+xmlSecOpenSSLKeyDataEd448GetSize(xmlSecKeyDataPtr data) {
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id), 0);
+
+    return(xmlSecOpenSSLKeyDataEdGetSize(data));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd448DebugDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id));
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "=== ed448 key: size = %lu\n",
+            (unsigned long)xmlSecOpenSSLKeyDataEd448GetSize(data));
+}
+
+static void
+xmlSecOpenSSLKeyDataEd448DebugXmlDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataEd448Id));
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "<Ed448KeyValue size=\"%lu\" />\n",
+            (unsigned long)xmlSecOpenSSLKeyDataEd448GetSize(data));
+}
+
+#endif /* XMLSEC_NO_EDDSA */
@@ -0,0 +1,1009 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Reusable OpenSSL contexts and pre-fetched algorithms.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <string.h>
+
+#include <libxml/threads.h>
+#include <openssl/evp.h>
+#include <openssl/err.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/openssl/crypto.h>
+#include "openssl_compat.h"
+#include "evp_pool.h"
+
+/**************************************************************************
+ *
+ * Every digest, cipher or HMAC transform needs an OpenSSL context and
+ * OpenSSL 3 also looks up the algorithm implementation in the providers
+ * on every EVP_DigestInit()/EVP_CipherInit() call with the "legacy"
+ * EVP_sha1()-like algorithms. The released contexts are reset and kept
+ * for the next transform, the algorithms are fetched only once.
+ *
+ *****************************************************************************/
+#define XMLSEC_OPENSSL_EVP_POOL_SIZE                    32
+#define XMLSEC_OPENSSL_EVP_FETCH_SIZE                   32
+
+typedef struct _xmlSecOpenSSLEvpPool {
+    void*                       items[XMLSEC_OPENSSL_EVP_POOL_SIZE];
+    xmlSecSize                  size;
+} xmlSecOpenSSLEvpPool, *xmlSecOpenSSLEvpPoolPtr;
+
+static xmlMutexPtr              xmlSecOpenSSLEvpPoolMutex       = NULL;
+static xmlSecOpenSSLEvpPool     xmlSecOpenSSLEvpMdCtxPool;
+static xmlSecOpenSSLEvpPool     xmlSecOpenSSLEvpCipherCtxPool;
+#ifndef XMLSEC_NO_HMAC
+static xmlSecOpenSSLEvpPool     xmlSecOpenSSLHmacCtxPool;
+
+/*
+ * The HMAC contexts initialized with the recently used keys: HMAC_Init_ex()
+ * hashes the inner and outer padded key blocks, the copy of the initialized
+ * context is much cheaper when the same shared secret is used over and over.
+ */
+#define XMLSEC_OPENSSL_HMAC_TEMPLATES_SIZE              16
+
+typedef struct _xmlSecOpenSSLHmacTemplate {
+    const EVP_MD*               md;
+    xmlSecByte*                 key;
+    xmlSecSize                  keySize;
+    HMAC_CTX*                   hmacCtx;
+    xmlSecSize                  lastUse;
+} xmlSecOpenSSLHmacTemplate, *xmlSecOpenSSLHmacTemplatePtr;
+
+static xmlSecOpenSSLHmacTemplate xmlSecOpenSSLHmacTemplates[XMLSEC_OPENSSL_HMAC_TEMPLATES_SIZE];
+static xmlSecSize               xmlSecOpenSSLHmacTemplatesClock = 0;
+
+static void
+xmlSecOpenSSLHmacTemplateClear(xmlSecOpenSSLHmacTemplatePtr tmpl) {
+    xmlSecAssert(tmpl != NULL);
+
+    if(tmpl->key != NULL) {
+        /* do not left the key in memory */
+        memset(tmpl->key, 0, tmpl->keySize);
+        xmlFree(tmpl->key);
+    }
+    if(tmpl->hmacCtx != NULL) {
+        HMAC_CTX_free(tmpl->hmacCtx);
+    }
+    memset(tmpl, 0, sizeof(xmlSecOpenSSLHmacTemplate));
+}
+
+/* should be called under the pool mutex, returns NULL if not found */
+static xmlSecOpenSSLHmacTemplatePtr
+xmlSecOpenSSLHmacTemplateFind(const xmlSecByte* key, xmlSecSize keySize, const EVP_MD* md) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_HMAC_TEMPLATES_SIZE; ++ii) {
+        if((xmlSecOpenSSLHmacTemplates[ii].hmacCtx != NULL) &&
+           (xmlSecOpenSSLHmacTemplates[ii].md == md) &&
+           (xmlSecOpenSSLHmacTemplates[ii].keySize == keySize) &&
+           (memcmp(xmlSecOpenSSLHmacTemplates[ii].key, key, keySize) == 0)) {
+            return(&(xmlSecOpenSSLHmacTemplates[ii]));
+        }
+    }
+    return(NULL);
+}
+#endif /* XMLSEC_NO_HMAC */
+
+/*
+ * The signature and verification contexts for the recently used keys:
+ * EVP_PKEY_CTX_new() and EVP_PKEY_sign_init() / EVP_PKEY_verify_init()
+ * look up the signature implementation and export the key to the provider
+ * (OpenSSL 3.0 or newer). The initialized context is duplicated for every
+ * operation instead, the duplicates share the key and its blinding and
+ * Montgomery caches. The template holds a reference to the key so the key
+ * pointer can not be reused for another key.
+ */
+#define XMLSEC_OPENSSL_EVP_PKEY_CTX_TEMPLATES_SIZE      16
+
+typedef struct _xmlSecOpenSSLEvpPKeyCtxTemplate {
+    EVP_PKEY*                   pKey;
+    const EVP_MD*               md;
+    int                         sign;
+    EVP_PKEY_CTX*               pKeyCtx;
+    xmlSecSize                  lastUse;
+} xmlSecOpenSSLEvpPKeyCtxTemplate, *xmlSecOpenSSLEvpPKeyCtxTemplatePtr;
+
+static xmlSecOpenSSLEvpPKeyCtxTemplate xmlSecOpenSSLEvpPKeyCtxTemplates[XMLSEC_OPENSSL_EVP_PKEY_CTX_TEMPLATES_SIZE];
+static xmlSecSize               xmlSecOpenSSLEvpPKeyCtxTemplatesClock = 0;
+
+/*
+ * The "hot" keys (see #xmlSecOpenSSLEvpKeySetHot) sign or verify most of
+ * the traffic: their contexts are never evicted by the other keys.
+ */
+static EVP_PKEY**               xmlSecOpenSSLEvpHotKeys = NULL;
+static xmlSecSize               xmlSecOpenSSLEvpHotKeysSize = 0;
+static xmlSecSize               xmlSecOpenSSLEvpHotKeysMaxSize = 0;
+static xmlSecOpenSSLEvpPKeyCtxTemplatePtr xmlSecOpenSSLEvpHotTemplates = NULL;
+static xmlSecSize               xmlSecOpenSSLEvpHotTemplatesSize = 0;
+static xmlSecSize               xmlSecOpenSSLEvpHotTemplatesMaxSize = 0;
+
+static void
+xmlSecOpenSSLEvpPKeyCtxTemplateClear(xmlSecOpenSSLEvpPKeyCtxTemplatePtr tmpl) {
+    xmlSecAssert(tmpl != NULL);
+
+    if(tmpl->pKeyCtx != NULL) {
+        EVP_PKEY_CTX_free(tmpl->pKeyCtx);
+    }
+    if(tmpl->pKey != NULL) {
+        EVP_PKEY_free(tmpl->pKey);
+    }
+    memset(tmpl, 0, sizeof(xmlSecOpenSSLEvpPKeyCtxTemplate));
+}
+
+/* should be called under the pool mutex, returns NULL if not found */
+static xmlSecOpenSSLEvpPKeyCtxTemplatePtr
+xmlSecOpenSSLEvpPKeyCtxTemplateFind(EVP_PKEY* pKey, const EVP_MD* md, int sign) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_TEMPLATES_SIZE; ++ii) {
+        if((xmlSecOpenSSLEvpPKeyCtxTemplates[ii].pKeyCtx != NULL) &&
+           (xmlSecOpenSSLEvpPKeyCtxTemplates[ii].pKey == pKey) &&
+           (xmlSecOpenSSLEvpPKeyCtxTemplates[ii].md == md) &&
+           (xmlSecOpenSSLEvpPKeyCtxTemplates[ii].sign == sign)) {
+            return(&(xmlSecOpenSSLEvpPKeyCtxTemplates[ii]));
+        }
+    }
+    for(ii = 0; ii < xmlSecOpenSSLEvpHotTemplatesSize; ++ii) {
+        if((xmlSecOpenSSLEvpHotTemplates[ii].pKey == pKey) &&
+           (xmlSecOpenSSLEvpHotTemplates[ii].md == md) &&
+           (xmlSecOpenSSLEvpHotTemplates[ii].sign == sign)) {
+            return(&(xmlSecOpenSSLEvpHotTemplates[ii]));
+        }
+    }
+    return(NULL);
+}
+
+/* should be called under the pool mutex */
+static int
+xmlSecOpenSSLEvpKeyIsHot(EVP_PKEY* pKey) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpHotKeysSize; ++ii) {
+        if(xmlSecOpenSSLEvpHotKeys[ii] == pKey) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/* should be called under the pool mutex, returns NULL if there is no memory */
+static xmlSecOpenSSLEvpPKeyCtxTemplatePtr
+xmlSecOpenSSLEvpHotTemplateAdd(void) {
+    xmlSecOpenSSLEvpPKeyCtxTemplatePtr newTemplates;
+    xmlSecSize newSize;
+
+    if(xmlSecOpenSSLEvpHotTemplatesSize >= xmlSecOpenSSLEvpHotTemplatesMaxSize) {
+        newSize = (xmlSecOpenSSLEvpHotTemplatesMaxSize > 0) ? 2 * xmlSecOpenSSLEvpHotTemplatesMaxSize : 16;
+        newTemplates = (xmlSecOpenSSLEvpPKeyCtxTemplatePtr)xmlRealloc(xmlSecOpenSSLEvpHotTemplates,
+                                    newSize * sizeof(xmlSecOpenSSLEvpPKeyCtxTemplate));
+        if(newTemplates == NULL) {
+            return(NULL);
+        }
+        xmlSecOpenSSLEvpHotTemplates = newTemplates;
+        xmlSecOpenSSLEvpHotTemplatesMaxSize = newSize;
+    }
+    memset(&(xmlSecOpenSSLEvpHotTemplates[xmlSecOpenSSLEvpHotTemplatesSize]), 0,
+           sizeof(xmlSecOpenSSLEvpPKeyCtxTemplate));
+    return(&(xmlSecOpenSSLEvpHotTemplates[xmlSecOpenSSLEvpHotTemplatesSize++]));
+}
+
+/*
+ * The public keys recently read from the <dsig:KeyValue/> nodes: the same
+ * partner sends the same inline key with every message. The keys are
+ * found by the serialized KeyValue content and shared with EVP_PKEY_up_ref().
+ */
+#define XMLSEC_OPENSSL_EVP_KEY_CACHE_SIZE               32
+
+typedef struct _xmlSecOpenSSLEvpKeyCacheEntry {
+    xmlSecByte*                 id;
+    xmlSecSize                  idSize;
+    unsigned int                hash;
+    EVP_PKEY*                   pKey;
+    xmlSecSize                  lastUse;
+} xmlSecOpenSSLEvpKeyCacheEntry, *xmlSecOpenSSLEvpKeyCacheEntryPtr;
+
+static xmlSecOpenSSLEvpKeyCacheEntry xmlSecOpenSSLEvpKeyCache[XMLSEC_OPENSSL_EVP_KEY_CACHE_SIZE];
+static xmlSecSize               xmlSecOpenSSLEvpKeyCacheClock   = 0;
+
+static unsigned int
+xmlSecOpenSSLEvpKeyCacheHash(const xmlSecByte* id, xmlSecSize idSize) {
+    unsigned int hash = 2166136261U;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < idSize; ++ii) {
+        hash = (hash ^ id[ii]) * 16777619U;
+    }
+    return(hash);
+}
+
+static void
+xmlSecOpenSSLEvpKeyCacheEntryClear(xmlSecOpenSSLEvpKeyCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->id != NULL) {
+        xmlFree(entry->id);
+    }
+    if(entry->pKey != NULL) {
+        EVP_PKEY_free(entry->pKey);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLEvpKeyCacheEntry));
+}
+
+/* should be called under the pool mutex, returns NULL if not found */
+static xmlSecOpenSSLEvpKeyCacheEntryPtr
+xmlSecOpenSSLEvpKeyCacheEntryFind(const xmlSecByte* id, xmlSecSize idSize, unsigned int hash) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_KEY_CACHE_SIZE; ++ii) {
+        if((xmlSecOpenSSLEvpKeyCache[ii].pKey != NULL) &&
+           (xmlSecOpenSSLEvpKeyCache[ii].hash == hash) &&
+           (xmlSecOpenSSLEvpKeyCache[ii].idSize == idSize) &&
+           (memcmp(xmlSecOpenSSLEvpKeyCache[ii].id, id, idSize) == 0)) {
+            return(&(xmlSecOpenSSLEvpKeyCache[ii]));
+        }
+    }
+    return(NULL);
+}
+
+#if !defined(LIBRESSL_VERSION_NUMBER) && (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#define XMLSEC_OPENSSL_EVP_FETCH        1
+
+typedef struct _xmlSecOpenSSLEvpFetchEntry {
+    const void*                 legacy;
+    void*                       fetched;
+} xmlSecOpenSSLEvpFetchEntry;
+
+static xmlSecOpenSSLEvpFetchEntry xmlSecOpenSSLEvpDigests[XMLSEC_OPENSSL_EVP_FETCH_SIZE];
+static xmlSecSize               xmlSecOpenSSLEvpDigestsSize     = 0;
+static xmlSecOpenSSLEvpFetchEntry xmlSecOpenSSLEvpCiphers[XMLSEC_OPENSSL_EVP_FETCH_SIZE];
+static xmlSecSize               xmlSecOpenSSLEvpCiphersSize     = 0;
+#endif /* !defined(LIBRESSL_VERSION_NUMBER) && (OPENSSL_VERSION_NUMBER >= 0x30000000L) */
+
+/* returns the item or NULL if the pool is empty */
+static void*
+xmlSecOpenSSLEvpPoolPop(xmlSecOpenSSLEvpPoolPtr pool) {
+    void* res = NULL;
+
+    xmlSecAssert2(pool != NULL, NULL);
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return(NULL);
+    }
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(pool->size > 0) {
+        res = pool->items[--pool->size];
+        pool->items[pool->size] = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+}
+
+/* returns 1 if the item was added to the pool or 0 if the pool is full */
+static int
+xmlSecOpenSSLEvpPoolPush(xmlSecOpenSSLEvpPoolPtr pool, void* item) {
+    int res = 0;
+
+    xmlSecAssert2(pool != NULL, 0);
+    xmlSecAssert2(item != NULL, 0);
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return(0);
+    }
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(pool->size < XMLSEC_OPENSSL_EVP_POOL_SIZE) {
+        pool->items[pool->size++] = item;
+        res = 1;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpPoolInitialize:
+ *
+ * Initializes the OpenSSL contexts pool. This function is called
+ * from the #xmlSecOpenSSLInit function.
+ */
+void
+xmlSecOpenSSLEvpPoolInitialize(void) {
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        xmlSecOpenSSLEvpPoolMutex = xmlNewMutex();
+        if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+            /* the contexts will be created every time */
+            xmlSecXmlError("xmlNewMutex", NULL);
+        }
+    }
+}
+
+/**
+ * xmlSecOpenSSLEvpPoolShutdown:
+ *
+ * Frees the pooled OpenSSL contexts and the pre-fetched algorithms.
+ * This function is called from the #xmlSecOpenSSLShutdown function.
+ */
+void
+xmlSecOpenSSLEvpPoolShutdown(void) {
+    xmlSecSize ii;
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    for(ii = 0; ii < xmlSecOpenSSLEvpMdCtxPool.size; ++ii) {
+        EVP_MD_CTX_free((EVP_MD_CTX*)xmlSecOpenSSLEvpMdCtxPool.items[ii]);
+    }
+    memset(&xmlSecOpenSSLEvpMdCtxPool, 0, sizeof(xmlSecOpenSSLEvpMdCtxPool));
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpCipherCtxPool.size; ++ii) {
+        EVP_CIPHER_CTX_free((EVP_CIPHER_CTX*)xmlSecOpenSSLEvpCipherCtxPool.items[ii]);
+    }
+    memset(&xmlSecOpenSSLEvpCipherCtxPool, 0, sizeof(xmlSecOpenSSLEvpCipherCtxPool));
+
+#ifndef XMLSEC_NO_HMAC
+    for(ii = 0; ii < xmlSecOpenSSLHmacCtxPool.size; ++ii) {
+        HMAC_CTX_free((HMAC_CTX*)xmlSecOpenSSLHmacCtxPool.items[ii]);
+    }
+    memset(&xmlSecOpenSSLHmacCtxPool, 0, sizeof(xmlSecOpenSSLHmacCtxPool));
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_HMAC_TEMPLATES_SIZE; ++ii) {
+        xmlSecOpenSSLHmacTemplateClear(&(xmlSecOpenSSLHmacTemplates[ii]));
+    }
+    xmlSecOpenSSLHmacTemplatesClock = 0;
+#endif /* XMLSEC_NO_HMAC */
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_TEMPLATES_SIZE; ++ii) {
+        xmlSecOpenSSLEvpPKeyCtxTemplateClear(&(xmlSecOpenSSLEvpPKeyCtxTemplates[ii]));
+    }
+    xmlSecOpenSSLEvpPKeyCtxTemplatesClock = 0;
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpHotTemplatesSize; ++ii) {
+        xmlSecOpenSSLEvpPKeyCtxTemplateClear(&(xmlSecOpenSSLEvpHotTemplates[ii]));
+    }
+    if(xmlSecOpenSSLEvpHotTemplates != NULL) {
+        xmlFree(xmlSecOpenSSLEvpHotTemplates);
+    }
+    xmlSecOpenSSLEvpHotTemplates = NULL;
+    xmlSecOpenSSLEvpHotTemplatesSize = xmlSecOpenSSLEvpHotTemplatesMaxSize = 0;
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpHotKeysSize; ++ii) {
+        EVP_PKEY_free(xmlSecOpenSSLEvpHotKeys[ii]);
+    }
+    if(xmlSecOpenSSLEvpHotKeys != NULL) {
+        xmlFree(xmlSecOpenSSLEvpHotKeys);
+    }
+    xmlSecOpenSSLEvpHotKeys = NULL;
+    xmlSecOpenSSLEvpHotKeysSize = xmlSecOpenSSLEvpHotKeysMaxSize = 0;
+
+    for(ii = 0; ii < XMLSEC_OPENSSL_EVP_KEY_CACHE_SIZE; ++ii) {
+        xmlSecOpenSSLEvpKeyCacheEntryClear(&(xmlSecOpenSSLEvpKeyCache[ii]));
+    }
+    xmlSecOpenSSLEvpKeyCacheClock = 0;
+
+#ifdef XMLSEC_OPENSSL_EVP_FETCH
+    for(ii = 0; ii < xmlSecOpenSSLEvpDigestsSize; ++ii) {
+        if(xmlSecOpenSSLEvpDigests[ii].fetched != NULL) {
+            EVP_MD_free((EVP_MD*)xmlSecOpenSSLEvpDigests[ii].fetched);
+        }
+    }
+    memset(xmlSecOpenSSLEvpDigests, 0, sizeof(xmlSecOpenSSLEvpDigests));
+    xmlSecOpenSSLEvpDigestsSize = 0;
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpCiphersSize; ++ii) {
+        if(xmlSecOpenSSLEvpCiphers[ii].fetched != NULL) {
+            EVP_CIPHER_free((EVP_CIPHER*)xmlSecOpenSSLEvpCiphers[ii].fetched);
+        }
+    }
+    memset(xmlSecOpenSSLEvpCiphers, 0, sizeof(xmlSecOpenSSLEvpCiphers));
+    xmlSecOpenSSLEvpCiphersSize = 0;
+#endif /* XMLSEC_OPENSSL_EVP_FETCH */
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+
+    xmlFreeMutex(xmlSecOpenSSLEvpPoolMutex);
+    xmlSecOpenSSLEvpPoolMutex = NULL;
+}
+
+/**
+ * xmlSecOpenSSLEvpDigestFetch:
+ * @digest:             the digest algorithm (e.g. EVP_sha1()).
+ *
+ * Gets the provider's implementation of @digest fetched once and
+ * kept until #xmlSecOpenSSLShutdown (OpenSSL 3.0 or newer).
+ *
+ * Returns: the fetched digest or @digest itself if it can't be (or
+ * doesn't need to be) fetched.
+ */
+const EVP_MD*
+xmlSecOpenSSLEvpDigestFetch(const EVP_MD* digest) {
+#ifdef XMLSEC_OPENSSL_EVP_FETCH
+    const EVP_MD* res = digest;
+    xmlSecSize ii;
+
+    if((digest == NULL) || (xmlSecOpenSSLEvpPoolMutex == NULL) || (EVP_MD_get0_provider(digest) != NULL)) {
+        return(digest);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    for(ii = 0; ii < xmlSecOpenSSLEvpDigestsSize; ++ii) {
+        if(xmlSecOpenSSLEvpDigests[ii].legacy == digest) {
+            break;
+        }
+    }
+    if((ii >= xmlSecOpenSSLEvpDigestsSize) && (ii < XMLSEC_OPENSSL_EVP_FETCH_SIZE)) {
+        /* the engines' digests can't be fetched, remember that too */
+        ERR_set_mark();
+        xmlSecOpenSSLEvpDigests[ii].legacy  = digest;
+        xmlSecOpenSSLEvpDigests[ii].fetched = EVP_MD_fetch(NULL, EVP_MD_get0_name(digest), NULL);
+        ERR_pop_to_mark();
+        ++xmlSecOpenSSLEvpDigestsSize;
+    }
+    if((ii < xmlSecOpenSSLEvpDigestsSize) && (xmlSecOpenSSLEvpDigests[ii].fetched != NULL)) {
+        res = (const EVP_MD*)xmlSecOpenSSLEvpDigests[ii].fetched;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+#else  /* XMLSEC_OPENSSL_EVP_FETCH */
+    return(digest);
+#endif /* XMLSEC_OPENSSL_EVP_FETCH */
+}
+
+/**
+ * xmlSecOpenSSLEvpCipherFetch:
+ * @cipher:             the cipher algorithm (e.g. EVP_aes_128_cbc()).
+ *
+ * Gets the provider's implementation of @cipher fetched once and
+ * kept until #xmlSecOpenSSLShutdown (OpenSSL 3.0 or newer).
+ *
+ * Returns: the fetched cipher or @cipher itself if it can't be (or
+ * doesn't need to be) fetched.
+ */
+const EVP_CIPHER*
+xmlSecOpenSSLEvpCipherFetch(const EVP_CIPHER* cipher) {
+#ifdef XMLSEC_OPENSSL_EVP_FETCH
+    const EVP_CIPHER* res = cipher;
+    xmlSecSize ii;
+
+    if((cipher == NULL) || (xmlSecOpenSSLEvpPoolMutex == NULL) || (EVP_CIPHER_get0_provider(cipher) != NULL)) {
+        return(cipher);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    for(ii = 0; ii < xmlSecOpenSSLEvpCiphersSize; ++ii) {
+        if(xmlSecOpenSSLEvpCiphers[ii].legacy == cipher) {
+            break;
+        }
+    }
+    if((ii >= xmlSecOpenSSLEvpCiphersSize) && (ii < XMLSEC_OPENSSL_EVP_FETCH_SIZE)) {
+        ERR_set_mark();
+        xmlSecOpenSSLEvpCiphers[ii].legacy  = cipher;
+        xmlSecOpenSSLEvpCiphers[ii].fetched = EVP_CIPHER_fetch(NULL, EVP_CIPHER_get0_name(cipher), NULL);
+        ERR_pop_to_mark();
+        ++xmlSecOpenSSLEvpCiphersSize;
+    }
+    if((ii < xmlSecOpenSSLEvpCiphersSize) && (xmlSecOpenSSLEvpCiphers[ii].fetched != NULL)) {
+        res = (const EVP_CIPHER*)xmlSecOpenSSLEvpCiphers[ii].fetched;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+#else  /* XMLSEC_OPENSSL_EVP_FETCH */
+    return(cipher);
+#endif /* XMLSEC_OPENSSL_EVP_FETCH */
+}
+
+/**
+ * xmlSecOpenSSLEvpMdCtxAcquire:
+ *
+ * Gets a digest context from the pool or creates a new one. The caller
+ * is responsible for releasing the context with #xmlSecOpenSSLEvpMdCtxRelease.
+ *
+ * Returns: the digest context or NULL if an error occurs.
+ */
+EVP_MD_CTX*
+xmlSecOpenSSLEvpMdCtxAcquire(void) {
+    EVP_MD_CTX* res;
+
+    res = (EVP_MD_CTX*)xmlSecOpenSSLEvpPoolPop(&xmlSecOpenSSLEvpMdCtxPool);
+    if(res == NULL) {
+        res = EVP_MD_CTX_new();
+    }
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpMdCtxRelease:
+ * @mdCtx:              the digest context.
+ *
+ * Resets @mdCtx and returns it to the pool (or frees it if the pool is full).
+ */
+void
+xmlSecOpenSSLEvpMdCtxRelease(EVP_MD_CTX* mdCtx) {
+    xmlSecAssert(mdCtx != NULL);
+
+    if((EVP_MD_CTX_reset(mdCtx) == 1) && (xmlSecOpenSSLEvpPoolPush(&xmlSecOpenSSLEvpMdCtxPool, mdCtx) == 1)) {
+        return;
+    }
+    EVP_MD_CTX_free(mdCtx);
+}
+
+/**
+ * xmlSecOpenSSLEvpCipherCtxAcquire:
+ *
+ * Gets a cipher context from the pool or creates a new one. The caller
+ * is responsible for releasing the context with #xmlSecOpenSSLEvpCipherCtxRelease.
+ *
+ * Returns: the cipher context or NULL if an error occurs.
+ */
+EVP_CIPHER_CTX*
+xmlSecOpenSSLEvpCipherCtxAcquire(void) {
+    EVP_CIPHER_CTX* res;
+
+    res = (EVP_CIPHER_CTX*)xmlSecOpenSSLEvpPoolPop(&xmlSecOpenSSLEvpCipherCtxPool);
+    if(res == NULL) {
+        res = EVP_CIPHER_CTX_new();
+    }
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpCipherCtxRelease:
+ * @cipherCtx:          the cipher context.
+ *
+ * Resets @cipherCtx (the key material is cleared) and returns it to
+ * the pool (or frees it if the pool is full).
+ */
+void
+xmlSecOpenSSLEvpCipherCtxRelease(EVP_CIPHER_CTX* cipherCtx) {
+    xmlSecAssert(cipherCtx != NULL);
+
+    if((EVP_CIPHER_CTX_reset(cipherCtx) == 1) && (xmlSecOpenSSLEvpPoolPush(&xmlSecOpenSSLEvpCipherCtxPool, cipherCtx) == 1)) {
+        return;
+    }
+    EVP_CIPHER_CTX_free(cipherCtx);
+}
+
+#ifndef XMLSEC_NO_HMAC
+/**
+ * xmlSecOpenSSLHmacCtxAcquire:
+ *
+ * Gets a HMAC context from the pool or creates a new one. The caller
+ * is responsible for releasing the context with #xmlSecOpenSSLHmacCtxRelease.
+ *
+ * Returns: the HMAC context or NULL if an error occurs.
+ */
+HMAC_CTX*
+xmlSecOpenSSLHmacCtxAcquire(void) {
+    HMAC_CTX* res;
+
+    res = (HMAC_CTX*)xmlSecOpenSSLEvpPoolPop(&xmlSecOpenSSLHmacCtxPool);
+    if(res == NULL) {
+        res = HMAC_CTX_new();
+    }
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLHmacCtxRelease:
+ * @hmacCtx:            the HMAC context.
+ *
+ * Resets @hmacCtx (the key material is cleared) and returns it to
+ * the pool (or frees it if the pool is full).
+ */
+void
+xmlSecOpenSSLHmacCtxRelease(HMAC_CTX* hmacCtx) {
+    xmlSecAssert(hmacCtx != NULL);
+
+    if((HMAC_CTX_reset(hmacCtx) == 1) && (xmlSecOpenSSLEvpPoolPush(&xmlSecOpenSSLHmacCtxPool, hmacCtx) == 1)) {
+        return;
+    }
+    HMAC_CTX_free(hmacCtx);
+}
+
+/**
+ * xmlSecOpenSSLHmacCtxInitKey:
+ * @hmacCtx:            the HMAC context.
+ * @key:                the HMAC key.
+ * @keySize:            the HMAC key size.
+ * @md:                 the HMAC digest.
+ *
+ * Initializes @hmacCtx with @key and @md exactly as HMAC_Init_ex() does.
+ * The contexts initialized with the recently used keys are kept and
+ * copied to @hmacCtx instead of hashing the padded key again.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLHmacCtxInitKey(HMAC_CTX* hmacCtx, const xmlSecByte* key, xmlSecSize keySize,
+                            const EVP_MD* md) {
+    xmlSecOpenSSLHmacTemplatePtr tmpl;
+    HMAC_CTX* tmplCtx;
+    xmlSecByte* tmplKey;
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(hmacCtx != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keySize > 0, -1);
+    xmlSecAssert2(md != NULL, -1);
+
+    if(xmlSecOpenSSLEvpPoolMutex != NULL) {
+        ret = 0;
+        xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+        tmpl = xmlSecOpenSSLHmacTemplateFind(key, keySize, md);
+        if(tmpl != NULL) {
+            tmpl->lastUse = ++xmlSecOpenSSLHmacTemplatesClock;
+            ret = HMAC_CTX_copy(hmacCtx, tmpl->hmacCtx);
+        }
+        xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+        if(ret == 1) {
+            return(0);
+        }
+    }
+
+    ret = HMAC_Init_ex(hmacCtx, key, keySize, md, NULL);
+    if(ret != 1) {
+        xmlSecOpenSSLError("HMAC_Init_ex", NULL);
+        return(-1);
+    }
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return(0);
+    }
+
+    /* remember the initialized context, not fatal if we can't */
+    tmplCtx = HMAC_CTX_new();
+    if(tmplCtx == NULL) {
+        return(0);
+    }
+    if(HMAC_CTX_copy(tmplCtx, hmacCtx) != 1) {
+        HMAC_CTX_free(tmplCtx);
+        return(0);
+    }
+    tmplKey = (xmlSecByte*)xmlMalloc(keySize);
+    if(tmplKey == NULL) {
+        HMAC_CTX_free(tmplCtx);
+        return(0);
+    }
+    memcpy(tmplKey, key, keySize);
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(xmlSecOpenSSLHmacTemplateFind(key, keySize, md) == NULL) {
+        /* replace the least recently used one */
+        tmpl = &(xmlSecOpenSSLHmacTemplates[0]);
+        for(ii = 1; (ii < XMLSEC_OPENSSL_HMAC_TEMPLATES_SIZE) && (tmpl->hmacCtx != NULL); ++ii) {
+            if((xmlSecOpenSSLHmacTemplates[ii].hmacCtx == NULL) ||
+               (xmlSecOpenSSLHmacTemplates[ii].lastUse < tmpl->lastUse)) {
+                tmpl = &(xmlSecOpenSSLHmacTemplates[ii]);
+            }
+        }
+        xmlSecOpenSSLHmacTemplateClear(tmpl);
+        tmpl->md        = md;
+        tmpl->key       = tmplKey;
+        tmpl->keySize   = keySize;
+        tmpl->hmacCtx   = tmplCtx;
+        tmpl->lastUse   = ++xmlSecOpenSSLHmacTemplatesClock;
+        tmplKey = NULL;
+        tmplCtx = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+
+    /* another thread was faster */
+    if(tmplKey != NULL) {
+        memset(tmplKey, 0, keySize);
+        xmlFree(tmplKey);
+    }
+    if(tmplCtx != NULL) {
+        HMAC_CTX_free(tmplCtx);
+    }
+    return(0);
+}
+#endif /* XMLSEC_NO_HMAC */
+
+/* creates (or duplicates the kept) context for EVP_PKEY_sign() if sign != 0
+ * or EVP_PKEY_verify() otherwise */
+static EVP_PKEY_CTX*
+xmlSecOpenSSLEvpPKeyCtxCreate(EVP_PKEY* pKey, const EVP_MD* md, int sign) {
+    xmlSecOpenSSLEvpPKeyCtxTemplatePtr tmpl;
+    EVP_PKEY_CTX* res = NULL;
+    EVP_PKEY_CTX* tmplCtx;
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(md != NULL, NULL);
+
+    if(xmlSecOpenSSLEvpPoolMutex != NULL) {
+        xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+        tmpl = xmlSecOpenSSLEvpPKeyCtxTemplateFind(pKey, md, sign);
+        if(tmpl != NULL) {
+            tmpl->lastUse = ++xmlSecOpenSSLEvpPKeyCtxTemplatesClock;
+            res = EVP_PKEY_CTX_dup(tmpl->pKeyCtx);
+        }
+        xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+        if(res != NULL) {
+            return(res);
+        }
+    }
+
+    res = EVP_PKEY_CTX_new(pKey, NULL);
+    if(res == NULL) {
+        xmlSecOpenSSLError("EVP_PKEY_CTX_new", NULL);
+        return(NULL);
+    }
+    if(sign != 0) {
+        ret = EVP_PKEY_sign_init(res);
+        if(ret <= 0) {
+            xmlSecOpenSSLError("EVP_PKEY_sign_init", NULL);
+            EVP_PKEY_CTX_free(res);
+            return(NULL);
+        }
+    } else {
+        ret = EVP_PKEY_verify_init(res);
+        if(ret <= 0) {
+            xmlSecOpenSSLError("EVP_PKEY_verify_init", NULL);
+            EVP_PKEY_CTX_free(res);
+            return(NULL);
+        }
+    }
+    ret = EVP_PKEY_CTX_set_signature_md(res, md);
+    if(ret <= 0) {
+        xmlSecOpenSSLError("EVP_PKEY_CTX_set_signature_md", NULL);
+        EVP_PKEY_CTX_free(res);
+        return(NULL);
+    }
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return(res);
+    }
+
+    /* remember the initialized context, not fatal if we can't */
+    tmplCtx = EVP_PKEY_CTX_dup(res);
+    if(tmplCtx == NULL) {
+        return(res);
+    }
+    if(EVP_PKEY_up_ref(pKey) != 1) {
+        EVP_PKEY_CTX_free(tmplCtx);
+        return(res);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(xmlSecOpenSSLEvpPKeyCtxTemplateFind(pKey, md, sign) == NULL) {
+        /* hot keys are kept forever, otherwise replace the least recently used one */
+        tmpl = NULL;
+        if(xmlSecOpenSSLEvpKeyIsHot(pKey) != 0) {
+            tmpl = xmlSecOpenSSLEvpHotTemplateAdd();
+        }
+        if(tmpl == NULL) {
+            tmpl = &(xmlSecOpenSSLEvpPKeyCtxTemplates[0]);
+            for(ii = 1; (ii < XMLSEC_OPENSSL_EVP_PKEY_CTX_TEMPLATES_SIZE) && (tmpl->pKeyCtx != NULL); ++ii) {
+                if((xmlSecOpenSSLEvpPKeyCtxTemplates[ii].pKeyCtx == NULL) ||
+                   (xmlSecOpenSSLEvpPKeyCtxTemplates[ii].lastUse < tmpl->lastUse)) {
+                    tmpl = &(xmlSecOpenSSLEvpPKeyCtxTemplates[ii]);
+                }
+            }
+            xmlSecOpenSSLEvpPKeyCtxTemplateClear(tmpl);
+        }
+        tmpl->pKey      = pKey;
+        tmpl->md        = md;
+        tmpl->sign      = sign;
+        tmpl->pKeyCtx   = tmplCtx;
+        tmpl->lastUse   = ++xmlSecOpenSSLEvpPKeyCtxTemplatesClock;
+        pKey = NULL;
+        tmplCtx = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+
+    /* another thread was faster */
+    if(tmplCtx != NULL) {
+        EVP_PKEY_CTX_free(tmplCtx);
+    }
+    if(pKey != NULL) {
+        EVP_PKEY_free(pKey);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpKeySetHot:
+ * @pKey:               the key.
+ *
+ * Marks @pKey as a frequently used key: the signature and verification
+ * contexts initialized for it are kept until #xmlSecOpenSSLShutdown
+ * instead of being evicted by the other keys.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLEvpKeySetHot(EVP_PKEY* pKey) {
+    EVP_PKEY** newKeys;
+    xmlSecSize newSize;
+    int res = -1;
+
+    xmlSecAssert2(pKey != NULL, -1);
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "evp pool is not initialized");
+        return(-1);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(xmlSecOpenSSLEvpKeyIsHot(pKey) != 0) {
+        res = 0;
+        goto done;
+    }
+
+    if(xmlSecOpenSSLEvpHotKeysSize >= xmlSecOpenSSLEvpHotKeysMaxSize) {
+        newSize = (xmlSecOpenSSLEvpHotKeysMaxSize > 0) ? 2 * xmlSecOpenSSLEvpHotKeysMaxSize : 16;
+        newKeys = (EVP_PKEY**)xmlRealloc(xmlSecOpenSSLEvpHotKeys, newSize * sizeof(EVP_PKEY*));
+        if(newKeys == NULL) {
+            xmlSecMallocError(newSize * sizeof(EVP_PKEY*), NULL);
+            goto done;
+        }
+        xmlSecOpenSSLEvpHotKeys = newKeys;
+        xmlSecOpenSSLEvpHotKeysMaxSize = newSize;
+    }
+
+    /* keep the reference so the pointer can not be reused for another key */
+    if(EVP_PKEY_up_ref(pKey) != 1) {
+        xmlSecOpenSSLError("EVP_PKEY_up_ref", NULL);
+        goto done;
+    }
+    xmlSecOpenSSLEvpHotKeys[xmlSecOpenSSLEvpHotKeysSize++] = pKey;
+    res = 0;
+
+done:
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpPKeyCtxCreateSign:
+ * @pKey:               the private key.
+ * @md:                 the signature digest.
+ *
+ * Creates the context for EVP_PKEY_sign() with @pKey and @md, exactly
+ * as EVP_SignFinal() does. The contexts initialized for the recently
+ * used keys are kept and duplicated. The caller is responsible for freeing
+ * the returned context with EVP_PKEY_CTX_free().
+ *
+ * Returns: the signature context or NULL if an error occurs.
+ */
+EVP_PKEY_CTX*
+xmlSecOpenSSLEvpPKeyCtxCreateSign(EVP_PKEY* pKey, const EVP_MD* md) {
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(md != NULL, NULL);
+
+    return(xmlSecOpenSSLEvpPKeyCtxCreate(pKey, md, 1));
+}
+
+/**
+ * xmlSecOpenSSLEvpPKeyCtxCreateVerify:
+ * @pKey:               the public key.
+ * @md:                 the signature digest.
+ *
+ * Creates the context for EVP_PKEY_verify() with @pKey and @md, exactly
+ * as EVP_VerifyFinal() does. The contexts initialized for the recently
+ * used keys are kept and duplicated. The caller is responsible for freeing
+ * the returned context with EVP_PKEY_CTX_free().
+ *
+ * Returns: the verification context or NULL if an error occurs.
+ */
+EVP_PKEY_CTX*
+xmlSecOpenSSLEvpPKeyCtxCreateVerify(EVP_PKEY* pKey, const EVP_MD* md) {
+    xmlSecAssert2(pKey != NULL, NULL);
+    xmlSecAssert2(md != NULL, NULL);
+
+    return(xmlSecOpenSSLEvpPKeyCtxCreate(pKey, md, 0));
+}
+
+/**
+ * xmlSecOpenSSLEvpKeyCacheFind:
+ * @id:                 the serialized key value.
+ * @idSize:             the serialized key value size.
+ *
+ * Looks up the public key previously added with #xmlSecOpenSSLEvpKeyCacheAdd
+ * for the same @id. The caller is responsible for freeing the returned key
+ * with EVP_PKEY_free().
+ *
+ * Returns: the new reference to the cached key or NULL if not found.
+ */
+EVP_PKEY*
+xmlSecOpenSSLEvpKeyCacheFind(const xmlSecByte* id, xmlSecSize idSize) {
+    xmlSecOpenSSLEvpKeyCacheEntryPtr entry;
+    EVP_PKEY* res = NULL;
+    unsigned int hash;
+
+    xmlSecAssert2(id != NULL, NULL);
+    xmlSecAssert2(idSize > 0, NULL);
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return(NULL);
+    }
+
+    hash = xmlSecOpenSSLEvpKeyCacheHash(id, idSize);
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    entry = xmlSecOpenSSLEvpKeyCacheEntryFind(id, idSize, hash);
+    if((entry != NULL) && (EVP_PKEY_up_ref(entry->pKey) == 1)) {
+        entry->lastUse = ++xmlSecOpenSSLEvpKeyCacheClock;
+        res = entry->pKey;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+    return(res);
+}
+
+/**
+ * xmlSecOpenSSLEvpKeyCacheAdd:
+ * @id:                 the serialized key value.
+ * @idSize:             the serialized key value size.
+ * @pKey:               the public key.
+ *
+ * Remembers @pKey (the cache takes its own reference) for the following
+ * #xmlSecOpenSSLEvpKeyCacheFind calls, the least recently used key is
+ * dropped if the cache is full. Only the public keys should be added.
+ * Failures are silently ignored.
+ */
+void
+xmlSecOpenSSLEvpKeyCacheAdd(const xmlSecByte* id, xmlSecSize idSize, EVP_PKEY* pKey) {
+    xmlSecOpenSSLEvpKeyCacheEntryPtr entry;
+    xmlSecByte* entryId;
+    unsigned int hash;
+    xmlSecSize ii;
+
+    xmlSecAssert(id != NULL);
+    xmlSecAssert(idSize > 0);
+    xmlSecAssert(pKey != NULL);
+
+    if(xmlSecOpenSSLEvpPoolMutex == NULL) {
+        return;
+    }
+
+    entryId = (xmlSecByte*)xmlMalloc(idSize);
+    if(entryId == NULL) {
+        return;
+    }
+    memcpy(entryId, id, idSize);
+    if(EVP_PKEY_up_ref(pKey) != 1) {
+        xmlFree(entryId);
+        return;
+    }
+
+    hash = xmlSecOpenSSLEvpKeyCacheHash(id, idSize);
+    xmlMutexLock(xmlSecOpenSSLEvpPoolMutex);
+    if(xmlSecOpenSSLEvpKeyCacheEntryFind(id, idSize, hash) == NULL) {
+        /* replace the least recently used one */
+        entry = &(xmlSecOpenSSLEvpKeyCache[0]);
+        for(ii = 1; (ii < XMLSEC_OPENSSL_EVP_KEY_CACHE_SIZE) && (entry->pKey != NULL); ++ii) {
+            if((xmlSecOpenSSLEvpKeyCache[ii].pKey == NULL) ||
+               (xmlSecOpenSSLEvpKeyCache[ii].lastUse < entry->lastUse)) {
+                entry = &(xmlSecOpenSSLEvpKeyCache[ii]);
+            }
+        }
+        xmlSecOpenSSLEvpKeyCacheEntryClear(entry);
+        entry->id       = entryId;
+        entry->idSize   = idSize;
+        entry->hash     = hash;
+        entry->pKey     = pKey;
+        entry->lastUse  = ++xmlSecOpenSSLEvpKeyCacheClock;
+        entryId = NULL;
+        pKey = NULL;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLEvpPoolMutex);
+
+    /* another thread was faster */
+    if(entryId != NULL) {
+        xmlFree(entryId);
+    }
+    if(pKey != NULL) {
+        EVP_PKEY_free(pKey);
+    }
+}
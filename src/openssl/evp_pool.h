@@ -0,0 +1,69 @@
+/*
+ * XML Security Library
+ *
+ * THIS IS A PRIVATE XMLSEC HEADER FILE
+ * DON'T USE IT IN YOUR APPLICATION
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_OPENSSL_EVP_POOL_H__
+#define __XMLSEC_OPENSSL_EVP_POOL_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "openssl/evp_pool.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <openssl/evp.h>
+#ifndef XMLSEC_NO_HMAC
+#include <openssl/hmac.h>
+#endif /* XMLSEC_NO_HMAC */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**************************************************************************
+ *
+ * Reusable OpenSSL contexts and pre-fetched algorithms
+ *
+ *****************************************************************************/
+void                    xmlSecOpenSSLEvpPoolInitialize          (void);
+void                    xmlSecOpenSSLEvpPoolShutdown            (void);
+
+const EVP_MD*           xmlSecOpenSSLEvpDigestFetch             (const EVP_MD* digest);
+const EVP_CIPHER*       xmlSecOpenSSLEvpCipherFetch             (const EVP_CIPHER* cipher);
+
+EVP_MD_CTX*             xmlSecOpenSSLEvpMdCtxAcquire            (void);
+void                    xmlSecOpenSSLEvpMdCtxRelease            (EVP_MD_CTX* mdCtx);
+EVP_CIPHER_CTX*         xmlSecOpenSSLEvpCipherCtxAcquire        (void);
+void                    xmlSecOpenSSLEvpCipherCtxRelease        (EVP_CIPHER_CTX* cipherCtx);
+
+#ifndef XMLSEC_NO_HMAC
+HMAC_CTX*               xmlSecOpenSSLHmacCtxAcquire             (void);
+void                    xmlSecOpenSSLHmacCtxRelease             (HMAC_CTX* hmacCtx);
+int                     xmlSecOpenSSLHmacCtxInitKey             (HMAC_CTX* hmacCtx,
+                                                                 const xmlSecByte* key,
+                                                                 xmlSecSize keySize,
+                                                                 const EVP_MD* md);
+#endif /* XMLSEC_NO_HMAC */
+
+int                     xmlSecOpenSSLEvpKeySetHot               (EVP_PKEY* pKey);
+EVP_PKEY_CTX*           xmlSecOpenSSLEvpPKeyCtxCreateSign       (EVP_PKEY* pKey,
+                                                                 const EVP_MD* md);
+EVP_PKEY_CTX*           xmlSecOpenSSLEvpPKeyCtxCreateVerify     (EVP_PKEY* pKey,
+                                                                 const EVP_MD* md);
+
+EVP_PKEY*               xmlSecOpenSSLEvpKeyCacheFind            (const xmlSecByte* id,
+                                                                 xmlSecSize idSize);
+void                    xmlSecOpenSSLEvpKeyCacheAdd             (const xmlSecByte* id,
+                                                                 xmlSecSize idSize,
+                                                                 EVP_PKEY* pKey);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_OPENSSL_EVP_POOL_H__ */
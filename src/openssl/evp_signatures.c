@@ -21,7 +21,9 @@
 
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
+#include <xmlsec/openssl/remote.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 /**************************************************************************
  *
@@ -35,6 +37,10 @@ struct _xmlSecOpenSSLEvpSignatureCtx {
     EVP_MD_CTX*         digestCtx;
     xmlSecKeyDataId     keyId;
     EVP_PKEY*           pKey;
+    xmlSecBuffer        data;   /* the signed data for one-shot (EdDSA) signatures */
+#ifdef XMLSEC_OPENSSL_REMOTE
+    xmlSecKeyDataPtr    remote; /* the remote private key */
+#endif /* XMLSEC_OPENSSL_REMOTE */
 };
 
 /******************************************************************************
@@ -52,6 +58,7 @@ struct _xmlSecOpenSSLEvpSignatureCtx {
 static int      xmlSecOpenSSLEvpSignatureCheckId                (xmlSecTransformPtr transform);
 static int      xmlSecOpenSSLEvpSignatureInitialize             (xmlSecTransformPtr transform);
 static void     xmlSecOpenSSLEvpSignatureFinalize               (xmlSecTransformPtr transform);
+static int      xmlSecOpenSSLEvpSignatureReset                  (xmlSecTransformPtr transform);
 static int      xmlSecOpenSSLEvpSignatureSetKeyReq              (xmlSecTransformPtr transform,
                                                                  xmlSecKeyReqPtr keyReq);
 static int      xmlSecOpenSSLEvpSignatureSetKey                 (xmlSecTransformPtr transform,
@@ -63,6 +70,11 @@ static int      xmlSecOpenSSLEvpSignatureVerify                 (xmlSecTransform
 static int      xmlSecOpenSSLEvpSignatureExecute                (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
+#ifdef XMLSEC_OPENSSL_REMOTE
+static int      xmlSecOpenSSLEvpSignatureRemoteSign             (xmlSecTransformPtr transform,
+                                                                 xmlSecOpenSSLEvpSignatureCtxPtr ctx,
+                                                                 xmlSecBufferPtr out);
+#endif /* XMLSEC_OPENSSL_REMOTE */
 
 static int
 xmlSecOpenSSLEvpSignatureCheckId(xmlSecTransformPtr transform) {
@@ -128,6 +140,16 @@ xmlSecOpenSSLEvpSignatureCheckId(xmlSecTransformPtr transform) {
     } else
 #endif /* XMLSEC_NO_GOST2012 */
 
+#ifndef XMLSEC_NO_EDDSA
+    if(xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformEd25519Id)) {
+        return(1);
+    } else
+
+    if(xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformEd448Id)) {
+        return(1);
+    } else
+#endif /* XMLSEC_NO_EDDSA */
+
     {
         return(0);
     }
@@ -138,6 +160,7 @@ xmlSecOpenSSLEvpSignatureCheckId(xmlSecTransformPtr transform) {
 static int
 xmlSecOpenSSLEvpSignatureInitialize(xmlSecTransformPtr transform) {
     xmlSecOpenSSLEvpSignatureCtxPtr ctx;
+    int ret;
 
     xmlSecAssert2(xmlSecOpenSSLEvpSignatureCheckId(transform), -1);
     xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpSignatureSize), -1);
@@ -231,16 +254,38 @@ xmlSecOpenSSLEvpSignatureInitialize(xmlSecTransformPtr transform) {
     } else
 #endif /* XMLSEC_NO_GOST2012 */
 
+#ifndef XMLSEC_NO_EDDSA
+    /* EdDSA hashes the data internally (twice), there is no digest */
+    if(xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformEd25519Id)) {
+        ctx->keyId  = xmlSecOpenSSLKeyDataEd25519Id;
+        ctx->digest = NULL;
+    } else
+
+    if(xmlSecTransformCheckId(transform, xmlSecOpenSSLTransformEd448Id)) {
+        ctx->keyId  = xmlSecOpenSSLKeyDataEd448Id;
+        ctx->digest = NULL;
+    } else
+#endif /* XMLSEC_NO_EDDSA */
+
     if(1) {
         xmlSecInvalidTransfromError(transform)
         return(-1);
     }
 
+    ret = xmlSecBufferInitialize(&(ctx->data), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
     /* create digest CTX */
-    ctx->digestCtx = EVP_MD_CTX_new();
+    ctx->digest = xmlSecOpenSSLEvpDigestFetch(ctx->digest);
+
+    ctx->digestCtx = xmlSecOpenSSLEvpMdCtxAcquire();
     if(ctx->digestCtx == NULL) {
-        xmlSecOpenSSLError("EVP_MD_CTX_new",
-                           xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpMdCtxAcquire",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -263,12 +308,50 @@ xmlSecOpenSSLEvpSignatureFinalize(xmlSecTransformPtr transform) {
     }
 
     if(ctx->digestCtx != NULL) {
-        EVP_MD_CTX_free(ctx->digestCtx);
+        xmlSecOpenSSLEvpMdCtxRelease(ctx->digestCtx);
+    }
+
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
     }
+#endif /* XMLSEC_OPENSSL_REMOTE */
 
+    xmlSecBufferFinalize(&(ctx->data));
     memset(ctx, 0, sizeof(xmlSecOpenSSLEvpSignatureCtx));
 }
 
+static int
+xmlSecOpenSSLEvpSignatureReset(xmlSecTransformPtr transform) {
+    xmlSecOpenSSLEvpSignatureCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpSignatureCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpSignatureSize), -1);
+
+    ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    /* keep the digest and the digest context, the key is set again */
+    if(ctx->pKey != NULL) {
+        EVP_PKEY_free(ctx->pKey);
+        ctx->pKey = NULL;
+    }
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+        ctx->remote = NULL;
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+    if(EVP_MD_CTX_reset(ctx->digestCtx) != 1) {
+        xmlSecOpenSSLError("EVP_MD_CTX_reset",
+                           xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    xmlSecBufferEmpty(&(ctx->data));
+    return(0);
+}
+
 static int
 xmlSecOpenSSLEvpSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
     xmlSecOpenSSLEvpSignatureCtxPtr ctx;
@@ -282,7 +365,6 @@ xmlSecOpenSSLEvpSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key)
 
     ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->digest != NULL, -1);
     xmlSecAssert2(ctx->keyId != NULL, -1);
     xmlSecAssert2(xmlSecKeyCheckId(key, ctx->keyId), -1);
 
@@ -307,6 +389,23 @@ xmlSecOpenSSLEvpSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key)
         return(-1);
     }
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+    /* the remote key signs, the local key value verifies */
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+        ctx->remote = NULL;
+    }
+    value = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataRemoteId);
+    if((value != NULL) && (transform->operation == xmlSecTransformOperationSign)) {
+        ctx->remote = xmlSecKeyDataDuplicate(value);
+        if(ctx->remote == NULL) {
+            xmlSecInternalError("xmlSecKeyDataDuplicate",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
     return(0);
 }
 
@@ -340,6 +439,9 @@ xmlSecOpenSSLEvpSignatureVerify(xmlSecTransformPtr transform,
                         const xmlSecByte* data, xmlSecSize dataSize,
                         xmlSecTransformCtxPtr transformCtx) {
     xmlSecOpenSSLEvpSignatureCtxPtr ctx;
+    xmlSecByte dgst[EVP_MAX_MD_SIZE];
+    unsigned int dgstSize = 0;
+    EVP_PKEY_CTX* pKeyCtx;
     int ret;
 
     xmlSecAssert2(xmlSecOpenSSLEvpSignatureCheckId(transform), -1);
@@ -352,16 +454,64 @@ xmlSecOpenSSLEvpSignatureVerify(xmlSecTransformPtr transform,
     ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->digestCtx != NULL, -1);
+    xmlSecAssert2(ctx->pKey != NULL, -1);
+
+#ifndef XMLSEC_NO_EDDSA
+    if(ctx->digest == NULL) {
+        /* one-shot signature over the whole buffered data */
+        ret = EVP_DigestVerifyInit(ctx->digestCtx, NULL, NULL, NULL, ctx->pKey);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_DigestVerifyInit",
+                               xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        ret = EVP_DigestVerify(ctx->digestCtx, data, dataSize,
+                               xmlSecBufferGetData(&(ctx->data)),
+                               xmlSecBufferGetSize(&(ctx->data)));
+        if(ret < 0) {
+            xmlSecOpenSSLError("EVP_DigestVerify",
+                               xmlSecTransformGetName(transform));
+            return(-1);
+        } else if(ret != 1) {
+            xmlSecOtherError(XMLSEC_ERRORS_R_DATA_NOT_MATCH,
+                             xmlSecTransformGetName(transform),
+                             "EVP_DigestVerify: signature does not verify");
+            transform->status = xmlSecTransformStatusFail;
+            return(0);
+        }
+
+        transform->status = xmlSecTransformStatusOk;
+        return(0);
+    }
+#endif /* XMLSEC_NO_EDDSA */
+
+    /* same as EVP_VerifyFinal() but the verification context for
+     * the key is initialized only once */
+    ret = EVP_DigestFinal_ex(ctx->digestCtx, dgst, &dgstSize);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestFinal_ex",
+                           xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    pKeyCtx = xmlSecOpenSSLEvpPKeyCtxCreateVerify(ctx->pKey, ctx->digest);
+    if(pKeyCtx == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLEvpPKeyCtxCreateVerify",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
 
-    ret = EVP_VerifyFinal(ctx->digestCtx, (xmlSecByte*)data, dataSize, ctx->pKey);
+    ret = EVP_PKEY_verify(pKeyCtx, data, dataSize, dgst, dgstSize);
+    EVP_PKEY_CTX_free(pKeyCtx);
     if(ret < 0) {
-        xmlSecOpenSSLError("EVP_VerifyFinal",
+        xmlSecOpenSSLError("EVP_PKEY_verify",
                            xmlSecTransformGetName(transform));
         return(-1);
     } else if(ret != 1) {
         xmlSecOtherError(XMLSEC_ERRORS_R_DATA_NOT_MATCH,
                          xmlSecTransformGetName(transform),
-                         "EVP_VerifyFinal: signature does not verify");
+                         "EVP_PKEY_verify: signature does not verify");
         transform->status = xmlSecTransformStatusFail;
         return(0);
     }
@@ -370,6 +520,44 @@ xmlSecOpenSSLEvpSignatureVerify(xmlSecTransformPtr transform,
     return(0);
 }
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+static int
+xmlSecOpenSSLEvpSignatureRemoteSign(xmlSecTransformPtr transform, xmlSecOpenSSLEvpSignatureCtxPtr ctx,
+                                    xmlSecBufferPtr out) {
+    xmlSecByte dgst[EVP_MAX_MD_SIZE];
+    unsigned int dgstSize = 0;
+    int ret;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->remote != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    /* the one-shot signatures send the data itself */
+    if(ctx->digest == NULL) {
+        ret = xmlSecOpenSSLKeyDataRemoteSign(ctx->remote, transform->id->href,
+                                             xmlSecBufferGetData(&(ctx->data)),
+                                             xmlSecBufferGetSize(&(ctx->data)),
+                                             out);
+    } else {
+        ret = EVP_DigestFinal_ex(ctx->digestCtx, dgst, &dgstSize);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_DigestFinal_ex",
+                               xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        ret = xmlSecOpenSSLKeyDataRemoteSign(ctx->remote, transform->id->href,
+                                             dgst, dgstSize, out);
+    }
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteSign",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    return(0);
+}
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
 static int
 xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr transformCtx) {
     xmlSecOpenSSLEvpSignatureCtxPtr ctx;
@@ -393,14 +581,15 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
 
     ctx = xmlSecOpenSSLEvpSignatureGetCtx(transform);
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->digest != NULL, -1);
     xmlSecAssert2(ctx->digestCtx != NULL, -1);
     xmlSecAssert2(ctx->pKey != NULL, -1);
 
     if(transform->status == xmlSecTransformStatusNone) {
         xmlSecAssert2(outSize == 0, -1);
 
-        if(transform->operation == xmlSecTransformOperationSign) {
+        if(ctx->digest == NULL) {
+            /* one-shot signature: nothing to init until we have all the data */
+        } else if(transform->operation == xmlSecTransformOperationSign) {
             ret = EVP_SignInit(ctx->digestCtx, ctx->digest);
             if(ret != 1) {
                 xmlSecOpenSSLError("EVP_SignInit",
@@ -421,7 +610,15 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
     if((transform->status == xmlSecTransformStatusWorking) && (inSize > 0)) {
         xmlSecAssert2(outSize == 0, -1);
 
-        if(transform->operation == xmlSecTransformOperationSign) {
+        if(ctx->digest == NULL) {
+            ret = xmlSecBufferAppend(&(ctx->data), xmlSecBufferGetData(in), inSize);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferAppend",
+                                     xmlSecTransformGetName(transform),
+                                     "size=%lu", (unsigned long)inSize);
+                return(-1);
+            }
+        } else if(transform->operation == xmlSecTransformOperationSign) {
             ret = EVP_SignUpdate(ctx->digestCtx, xmlSecBufferGetData(in), inSize);
             if(ret != 1) {
                 xmlSecOpenSSLError("EVP_SignUpdate",
@@ -450,6 +647,19 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
         if(transform->operation == xmlSecTransformOperationSign) {
             unsigned int signSize;
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+            if(ctx->remote != NULL) {
+                ret = xmlSecOpenSSLEvpSignatureRemoteSign(transform, ctx, out);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecOpenSSLEvpSignatureRemoteSign",
+                                        xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+                transform->status = xmlSecTransformStatusFinished;
+                return(0);
+            }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
             /* for rsa signatures we get size from EVP_PKEY_size() */
             signSize = EVP_PKEY_size(ctx->pKey);
             ret = xmlSecBufferSetMaxSize(out, signSize);
@@ -460,11 +670,58 @@ xmlSecOpenSSLEvpSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecT
                 return(-1);
             }
 
-            ret = EVP_SignFinal(ctx->digestCtx, xmlSecBufferGetData(out), &signSize, ctx->pKey);
-            if(ret != 1) {
-                xmlSecOpenSSLError("EVP_SignFinal",
-                                   xmlSecTransformGetName(transform));
-                return(-1);
+#ifndef XMLSEC_NO_EDDSA
+            if(ctx->digest == NULL) {
+                size_t len = signSize;
+
+                ret = EVP_DigestSignInit(ctx->digestCtx, NULL, NULL, NULL, ctx->pKey);
+                if(ret != 1) {
+                    xmlSecOpenSSLError("EVP_DigestSignInit",
+                                       xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+
+                ret = EVP_DigestSign(ctx->digestCtx, xmlSecBufferGetData(out), &len,
+                                     xmlSecBufferGetData(&(ctx->data)),
+                                     xmlSecBufferGetSize(&(ctx->data)));
+                if(ret != 1) {
+                    xmlSecOpenSSLError("EVP_DigestSign",
+                                       xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+                signSize = (unsigned int)len;
+            } else
+#endif /* XMLSEC_NO_EDDSA */
+            {
+                xmlSecByte dgst[EVP_MAX_MD_SIZE];
+                unsigned int dgstSize = 0;
+                EVP_PKEY_CTX* pKeyCtx;
+                size_t len = signSize;
+
+                /* same as EVP_SignFinal() but the signature context for
+                 * the key is initialized only once */
+                ret = EVP_DigestFinal_ex(ctx->digestCtx, dgst, &dgstSize);
+                if(ret != 1) {
+                    xmlSecOpenSSLError("EVP_DigestFinal_ex",
+                                       xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+
+                pKeyCtx = xmlSecOpenSSLEvpPKeyCtxCreateSign(ctx->pKey, ctx->digest);
+                if(pKeyCtx == NULL) {
+                    xmlSecInternalError("xmlSecOpenSSLEvpPKeyCtxCreateSign",
+                                        xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+
+                ret = EVP_PKEY_sign(pKeyCtx, xmlSecBufferGetData(out), &len, dgst, dgstSize);
+                EVP_PKEY_CTX_free(pKeyCtx);
+                if(ret != 1) {
+                    xmlSecOpenSSLError("EVP_PKEY_sign",
+                                       xmlSecTransformGetName(transform));
+                    return(-1);
+                }
+                signSize = (unsigned int)len;
             }
 
             ret = xmlSecBufferSetSize(out, signSize);
@@ -521,7 +778,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaMd5Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -568,7 +825,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaRipemd160Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -615,7 +872,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaSha1Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -662,7 +919,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaSha224Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -709,7 +966,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaSha256Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -756,7 +1013,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaSha384Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -803,7 +1060,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRsaSha512Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -853,7 +1110,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGost2001GostR3411_94Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,             /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -901,7 +1158,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3410_2012GostR3411_2012_256Klass =
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,             /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -947,7 +1204,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3410_2012GostR3411_2012_512Klass =
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLEvpSignatureExecute,             /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -966,3 +1223,94 @@ xmlSecOpenSSLTransformGostR3410_2012GostR3411_2012_512GetKlass(void) {
 #endif /* XMLSEC_NO_GOST2012 */
 
 
+
+#ifndef XMLSEC_NO_EDDSA
+/****************************************************************************
+ *
+ * EdDSA Ed25519 signature transform
+ *
+ ***************************************************************************/
+static xmlSecTransformKlass xmlSecOpenSSLEd25519Klass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecOpenSSLEvpSignatureSize,              /* xmlSecSize objSize */
+
+    xmlSecNameEd25519,                          /* const xmlChar* name; */
+    xmlSecHrefEd25519,                          /* const xmlChar* href; */
+    xmlSecTransformUsageSignatureMethod,        /* xmlSecTransformUsage usage; */
+
+    xmlSecOpenSSLEvpSignatureInitialize,        /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecOpenSSLEvpSignatureFinalize,          /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    xmlSecOpenSSLEvpSignatureSetKeyReq,         /* xmlSecTransformSetKeyReqMethod setKeyReq; */
+    xmlSecOpenSSLEvpSignatureSetKey,            /* xmlSecTransformSetKeyMethod setKey; */
+    xmlSecOpenSSLEvpSignatureVerify,            /* xmlSecTransformVerifyMethod verify; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
+
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLTransformEd25519GetKlass:
+ *
+ * The EdDSA Ed25519 signature transform klass.
+ *
+ * Returns: EdDSA Ed25519 signature transform klass.
+ */
+xmlSecTransformId
+xmlSecOpenSSLTransformEd25519GetKlass(void) {
+    return(&xmlSecOpenSSLEd25519Klass);
+}
+
+/****************************************************************************
+ *
+ * EdDSA Ed448 signature transform
+ *
+ ***************************************************************************/
+static xmlSecTransformKlass xmlSecOpenSSLEd448Klass = {
+    /* klass/object sizes */
+    sizeof(xmlSecTransformKlass),               /* xmlSecSize klassSize */
+    xmlSecOpenSSLEvpSignatureSize,              /* xmlSecSize objSize */
+
+    xmlSecNameEd448,                          /* const xmlChar* name; */
+    xmlSecHrefEd448,                          /* const xmlChar* href; */
+    xmlSecTransformUsageSignatureMethod,        /* xmlSecTransformUsage usage; */
+
+    xmlSecOpenSSLEvpSignatureInitialize,        /* xmlSecTransformInitializeMethod initialize; */
+    xmlSecOpenSSLEvpSignatureFinalize,          /* xmlSecTransformFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecTransformNodeReadMethod readNode; */
+    NULL,                                       /* xmlSecTransformNodeWriteMethod writeNode; */
+    xmlSecOpenSSLEvpSignatureSetKeyReq,         /* xmlSecTransformSetKeyReqMethod setKeyReq; */
+    xmlSecOpenSSLEvpSignatureSetKey,            /* xmlSecTransformSetKeyMethod setKey; */
+    xmlSecOpenSSLEvpSignatureVerify,            /* xmlSecTransformVerifyMethod verify; */
+    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
+    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
+    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecOpenSSLEvpSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
+
+    xmlSecOpenSSLEvpSignatureReset,             /* xmlSecTransformResetMethod reset; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLTransformEd448GetKlass:
+ *
+ * The EdDSA Ed448 signature transform klass.
+ *
+ * Returns: EdDSA Ed448 signature transform klass.
+ */
+xmlSecTransformId
+xmlSecOpenSSLTransformEd448GetKlass(void) {
+    return(&xmlSecOpenSSLEd448Klass);
+}
+
+#endif /* XMLSEC_NO_EDDSA */
@@ -32,6 +32,7 @@
 
 #include <xmlsec/openssl/crypto.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 /* sizes in bits */
 #define XMLSEC_OPENSSL_MIN_HMAC_SIZE            80
@@ -229,10 +230,12 @@ xmlSecOpenSSLHmacInitialize(xmlSecTransformPtr transform) {
     }
 
     /* create hmac CTX */
-    ctx->hmacCtx = HMAC_CTX_new();
+    ctx->hmacDgst = xmlSecOpenSSLEvpDigestFetch(ctx->hmacDgst);
+
+    ctx->hmacCtx = xmlSecOpenSSLHmacCtxAcquire();
     if(ctx->hmacCtx == NULL) {
-        xmlSecOpenSSLError("HMAC_CTX_new",
-                           xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLHmacCtxAcquire",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -251,7 +254,7 @@ xmlSecOpenSSLHmacFinalize(xmlSecTransformPtr transform) {
     xmlSecAssert(ctx != NULL);
 
     if(ctx->hmacCtx != NULL) {
-        HMAC_CTX_free(ctx->hmacCtx);
+        xmlSecOpenSSLHmacCtxRelease(ctx->hmacCtx);
     }
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLHmacCtx));
@@ -350,14 +353,13 @@ xmlSecOpenSSLHmacSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
 
     xmlSecAssert2(xmlSecBufferGetData(buffer) != NULL, -1);
 
-    ret = HMAC_Init_ex(ctx->hmacCtx,
+    ret = xmlSecOpenSSLHmacCtxInitKey(ctx->hmacCtx,
                 xmlSecBufferGetData(buffer),
                 xmlSecBufferGetSize(buffer),
-                ctx->hmacDgst,
-                NULL);
-    if(ret != 1) {
-        xmlSecOpenSSLError("HMAC_Init_ex",
-                           xmlSecTransformGetName(transform));
+                ctx->hmacDgst);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLHmacCtxInitKey",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
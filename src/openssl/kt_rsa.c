@@ -33,6 +33,7 @@
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include <xmlsec/openssl/bn.h>
+#include <xmlsec/openssl/remote.h>
 #include "openssl_compat.h"
 
 /**************************************************************************
@@ -44,6 +45,9 @@ typedef struct _xmlSecOpenSSLRsaPkcs1Ctx        xmlSecOpenSSLRsaPkcs1Ctx,
                                                 *xmlSecOpenSSLRsaPkcs1CtxPtr;
 struct _xmlSecOpenSSLRsaPkcs1Ctx {
     EVP_PKEY*           pKey;
+#ifdef XMLSEC_OPENSSL_REMOTE
+    xmlSecKeyDataPtr    remote; /* the remote private key */
+#endif /* XMLSEC_OPENSSL_REMOTE */
 };
 
 /*********************************************************************
@@ -136,6 +140,11 @@ xmlSecOpenSSLRsaPkcs1Finalize(xmlSecTransformPtr transform) {
     if(ctx->pKey != NULL) {
         EVP_PKEY_free(ctx->pKey);
     }
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
     memset(ctx, 0, sizeof(xmlSecOpenSSLRsaPkcs1Ctx));
 }
 
@@ -195,6 +204,22 @@ xmlSecOpenSSLRsaPkcs1SetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
         return(-1);
     }
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(transform->operation == xmlSecTransformOperationDecrypt) {
+        xmlSecKeyDataPtr remote;
+
+        remote = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataRemoteId);
+        if(remote != NULL) {
+            ctx->remote = xmlSecKeyDataDuplicate(remote);
+            if(ctx->remote == NULL) {
+                xmlSecInternalError("xmlSecKeyDataDuplicate",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        }
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
     return(0);
 }
 
@@ -288,6 +313,19 @@ xmlSecOpenSSLRsaPkcs1Process(xmlSecTransformPtr transform, xmlSecTransformCtxPtr
         return(-1);
     }
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if((transform->operation == xmlSecTransformOperationDecrypt) && (ctx->remote != NULL)) {
+        ret = xmlSecOpenSSLKeyDataRemoteDecrypt(ctx->remote, transform->id->href,
+                                                xmlSecBufferGetData(in), inSize,
+                                                NULL, 0, out);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteDecrypt",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        outSize = xmlSecBufferGetSize(out);
+    } else
+#endif /* XMLSEC_OPENSSL_REMOTE */
     if(transform->operation == xmlSecTransformOperationEncrypt) {
         ret = RSA_public_encrypt(inSize, xmlSecBufferGetData(in),
                                  xmlSecBufferGetData(out),
@@ -341,6 +379,9 @@ typedef struct _xmlSecOpenSSLRsaOaepCtx         xmlSecOpenSSLRsaOaepCtx,
 struct _xmlSecOpenSSLRsaOaepCtx {
     EVP_PKEY*           pKey;
     xmlSecBuffer        oaepParams;
+#ifdef XMLSEC_OPENSSL_REMOTE
+    xmlSecKeyDataPtr    remote; /* the remote private key */
+#endif /* XMLSEC_OPENSSL_REMOTE */
 };
 
 /*********************************************************************
@@ -444,6 +485,11 @@ xmlSecOpenSSLRsaOaepFinalize(xmlSecTransformPtr transform) {
     if(ctx->pKey != NULL) {
         EVP_PKEY_free(ctx->pKey);
     }
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
     xmlSecBufferFinalize(&(ctx->oaepParams));
     memset(ctx, 0, sizeof(xmlSecOpenSSLRsaOaepCtx));
 }
@@ -563,6 +609,22 @@ xmlSecOpenSSLRsaOaepSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
         return(-1);
     }
 
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(transform->operation == xmlSecTransformOperationDecrypt) {
+        xmlSecKeyDataPtr remote;
+
+        remote = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataRemoteId);
+        if(remote != NULL) {
+            ctx->remote = xmlSecKeyDataDuplicate(remote);
+            if(ctx->remote == NULL) {
+                xmlSecInternalError("xmlSecKeyDataDuplicate",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        }
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+
     return(0);
 }
 
@@ -658,6 +720,20 @@ xmlSecOpenSSLRsaOaepProcess(xmlSecTransformPtr transform, xmlSecTransformCtxPtr
     }
 
     paramsSize = xmlSecBufferGetSize(&(ctx->oaepParams));
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if((transform->operation == xmlSecTransformOperationDecrypt) && (ctx->remote != NULL)) {
+        ret = xmlSecOpenSSLKeyDataRemoteDecrypt(ctx->remote, transform->id->href,
+                                                xmlSecBufferGetData(in), inSize,
+                                                xmlSecBufferGetData(&(ctx->oaepParams)), paramsSize,
+                                                out);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteDecrypt",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        outSize = xmlSecBufferGetSize(out);
+    } else
+#endif /* XMLSEC_OPENSSL_REMOTE */
     if((transform->operation == xmlSecTransformOperationEncrypt) && (paramsSize == 0)) {
         /* encode w/o OAEPParams --> simple */
         ret = RSA_public_encrypt(inSize, xmlSecBufferGetData(in),
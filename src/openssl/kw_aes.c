@@ -44,11 +44,25 @@ static int        xmlSecOpenSSLKWAesBlockDecrypt                (const xmlSecByt
                                                                  xmlSecByte * out, 
                                                                  xmlSecSize outSize,
                                                                  void * context);
+static int        xmlSecOpenSSLKWAesWrap                        (const xmlSecByte * in,
+                                                                 xmlSecSize inSize,
+                                                                 xmlSecByte * out,
+                                                                 xmlSecSize outSize,
+                                                                 void * context);
+static int        xmlSecOpenSSLKWAesUnwrap                      (const xmlSecByte * in,
+                                                                 xmlSecSize inSize,
+                                                                 xmlSecByte * out,
+                                                                 xmlSecSize outSize,
+                                                                 void * context);
 static xmlSecKWAesKlass xmlSecOpenSSLKWAesKlass = {
     /* callbacks */
     xmlSecOpenSSLKWAesBlockEncrypt,         /* xmlSecKWAesBlockEncryptMethod       encrypt; */
     xmlSecOpenSSLKWAesBlockDecrypt,         /* xmlSecKWAesBlockDecryptMethod       decrypt; */
 
+    /* bulk operations */
+    xmlSecOpenSSLKWAesWrap,                 /* xmlSecKWAesWrapMethod               wrap; */
+    xmlSecOpenSSLKWAesUnwrap,               /* xmlSecKWAesUnwrapMethod             unwrap; */
+
     /* for the future */
     NULL,                                   /* void*                               reserved0; */
     NULL                                    /* void*                               reserved1; */
@@ -434,6 +448,93 @@ xmlSecOpenSSLTransformKWAes256GetKlass(void) {
     return(&xmlSecOpenSSLKWAes256Klass);
 }
 
+/**
+ * xmlSecOpenSSLKWAesDecodeBatch:
+ * @key:                the AES key-encryption key.
+ * @in:                 the array of @size wrapped keys.
+ * @out:                the array of @size buffers for the unwrapped keys.
+ * @size:               the number of keys.
+ * @results:            the array of @size elements for the unwrap results.
+ *
+ * Unwraps (RFC 3394) all the keys in @in with the same key-encryption
+ * @key (e.g. several <enc:EncryptedKey/> nodes for the same recipient)
+ * with the AES key schedule prepared once. The result of in[i] unwrap
+ * is returned in results[i]: 0 on success (the key is in out[i]) or
+ * a negative value if an error occurs.
+ *
+ * Returns: 0 on success (check @results to get the individual keys
+ * unwrap results) or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLKWAesDecodeBatch(xmlSecKeyPtr key, xmlSecBufferPtr* in, xmlSecBufferPtr* out,
+                              xmlSecSize size, int* results) {
+    xmlSecBufferPtr buffer;
+    xmlSecSize keySize, inSize, ii;
+    AES_KEY aesKey;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(results != NULL, -1);
+
+    if(!xmlSecKeyDataCheckId(xmlSecKeyGetValue(key), xmlSecOpenSSLKeyDataAesId)) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_KEY_DATA, NULL, "AES key is expected");
+        return(-1);
+    }
+    buffer = xmlSecKeyDataBinaryValueGetBuffer(xmlSecKeyGetValue(key));
+    xmlSecAssert2(buffer != NULL, -1);
+
+    keySize = xmlSecBufferGetSize(buffer);
+    if((keySize != XMLSEC_KW_AES128_KEY_SIZE) && (keySize != XMLSEC_KW_AES192_KEY_SIZE) &&
+       (keySize != XMLSEC_KW_AES256_KEY_SIZE)) {
+        xmlSecInvalidKeyDataSizeError(keySize, XMLSEC_KW_AES128_KEY_SIZE, NULL);
+        return(-1);
+    }
+
+    /* prepare key once */
+    ret = AES_set_decrypt_key(xmlSecBufferGetData(buffer), 8 * keySize, &aesKey);
+    if(ret != 0) {
+        xmlSecOpenSSLError("AES_set_decrypt_key", NULL);
+        return(-1);
+    }
+
+    for(ii = 0; ii < size; ++ii) {
+        xmlSecAssert2(in[ii] != NULL, -1);
+        xmlSecAssert2(out[ii] != NULL, -1);
+
+        results[ii] = -1;
+        inSize = xmlSecBufferGetSize(in[ii]);
+        if((inSize < 2 * XMLSEC_KW_AES_MAGIC_BLOCK_SIZE) || ((inSize % 8) != 0)) {
+            xmlSecInvalidSizeNotMultipleOfError("Input data", inSize, 8, NULL);
+            continue;
+        }
+
+        ret = xmlSecBufferSetMaxSize(out[ii], inSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL, "size=" XMLSEC_SIZE_FMT, inSize);
+            continue;
+        }
+        ret = xmlSecKWAesDecode(&xmlSecOpenSSLKWAesKlass, &aesKey,
+                                xmlSecBufferGetData(in[ii]), inSize,
+                                xmlSecBufferGetData(out[ii]), inSize);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKWAesDecode", NULL);
+            continue;
+        }
+        ret = xmlSecBufferSetSize(out[ii], ret);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferSetSize", NULL);
+            continue;
+        }
+        results[ii] = 0;
+    }
+
+    /* do not left data in memory */
+    memset(&aesKey, 0, sizeof(aesKey));
+    return(0);
+}
+
 /*********************************************************************
  *
  * AES KW implementation
@@ -467,4 +568,46 @@ xmlSecOpenSSLKWAesBlockDecrypt(const xmlSecByte * in, xmlSecSize inSize,
     return(AES_BLOCK_SIZE);
 }
 
+static int
+xmlSecOpenSSLKWAesWrap(const xmlSecByte * in, xmlSecSize inSize,
+                       xmlSecByte * out, xmlSecSize outSize,
+                       void * context) {
+    int ret;
+
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(inSize >= 2 * XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(outSize >= inSize + XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+    xmlSecAssert2(context != NULL, -1);
+
+    /* NULL iv is the default 0xA6A6A6A6A6A6A6A6 */
+    ret = AES_wrap_key((AES_KEY*)context, NULL, out, in, inSize);
+    if(ret <= 0) {
+        xmlSecOpenSSLError("AES_wrap_key", NULL);
+        return(-1);
+    }
+    return(ret);
+}
+
+static int
+xmlSecOpenSSLKWAesUnwrap(const xmlSecByte * in, xmlSecSize inSize,
+                         xmlSecByte * out, xmlSecSize outSize,
+                         void * context) {
+    int ret;
+
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(inSize >= 3 * XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(outSize >= inSize - XMLSEC_KW_AES_MAGIC_BLOCK_SIZE, -1);
+    xmlSecAssert2(context != NULL, -1);
+
+    /* NULL iv is the default 0xA6A6A6A6A6A6A6A6, the check failure returns 0 */
+    ret = AES_unwrap_key((AES_KEY*)context, NULL, out, in, inSize);
+    if(ret <= 0) {
+        xmlSecOpenSSLError("AES_unwrap_key", NULL);
+        return(-1);
+    }
+    return(ret);
+}
+
 #endif /* XMLSEC_NO_AES */
@@ -16,7 +16,6 @@
 #include <string.h>
 
 #include <openssl/des.h>
-#include <openssl/rand.h>
 #include <openssl/sha.h>
 
 #include <xmlsec/xmlsec.h>
@@ -24,6 +23,7 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/random.h>
 
 #include <xmlsec/openssl/crypto.h>
 
@@ -379,10 +379,9 @@ xmlSecOpenSSLKWDes3GenerateRandom(void * context,
     xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(outSize > 0, -1);
 
-    ret = RAND_bytes(out, outSize);
-    if(ret != 1) {
-        xmlSecOpenSSLError2("RAND_bytes", NULL,
-                            "size=%lu", (unsigned long)outSize);
+    ret = xmlSecRandomGenerate(xmlSecOpenSSLGenerateRandomBytes, NULL, out, outSize);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecRandomGenerate", NULL, "size=" XMLSEC_SIZE_FMT, outSize);
         return(-1);
     }
 
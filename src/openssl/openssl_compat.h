@@ -28,15 +28,20 @@
 #define EVP_MD_CTX_new()                   EVP_MD_CTX_create()
 #define EVP_MD_CTX_free(x)                 EVP_MD_CTX_destroy((x))
 #define EVP_MD_CTX_md_data(x)              ((x)->md_data)
+#define EVP_MD_CTX_reset(x)                EVP_MD_CTX_cleanup((x))
 
 /* EVP_CIPHER_CTX stuff */
 #define EVP_CIPHER_CTX_encrypting(x)       ((x)->encrypt)
+#define EVP_CIPHER_CTX_reset(x)            EVP_CIPHER_CTX_cleanup((x))
 
 /* HMAC_CTX stuff */
 #define HMAC_CTX_new()                     ((HMAC_CTX*)calloc(1, sizeof(HMAC_CTX)))
 #define HMAC_CTX_free(x)                   { HMAC_CTX_cleanup((x)); free((x)); }
+#define HMAC_CTX_reset(x)                  (HMAC_CTX_cleanup((x)), 1)
 
 /* X509 stuff */
+#define X509_up_ref(x509)                  CRYPTO_add(&((x509)->references), 1, CRYPTO_LOCK_X509)
+#define X509_CRL_up_ref(crl)               CRYPTO_add(&((crl)->references), 1, CRYPTO_LOCK_X509_CRL)
 #define ASN1_STRING_get0_data(data)        ASN1_STRING_data((data))
 #define X509_CRL_get0_nextUpdate(crl)      X509_CRL_get_nextUpdate((crl))
 #define X509_get0_notBefore(x509)          X509_get_notBefore((x509))
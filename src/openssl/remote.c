@@ -0,0 +1,1062 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Remote private key operations.
+ *
+ * The signatures and the key transport decryption with a key adopted by
+ * xmlSecOpenSSLRemoteSignerAdoptKey() are done by a remote signing service
+ * (e.g. an HSM cluster front end); the digests, c14n, verification and
+ * encryption stay local. All the keys of a signer share one connection:
+ * the requests from all the threads are pipelined (many requests are in
+ * flight, the replies may come in any order) and batched (the requests
+ * queued while a thread is writing are sent with one write).
+ *
+ * The protocol is line based, one request or reply per line:
+ *
+ *   <id> SIGN <key name> <algorithm href> <base64 digest>
+ *   <id> DECRYPT <key name> <algorithm href> <base64 data> [<base64 OAEP params>]
+ *
+ *   <id> OK <base64 result>
+ *   <id> FAIL <error message>
+ *
+ * The SIGN input is the digest (or the data itself for the algorithms
+ * without a digest, e.g. EdDSA) and the result is the signature in the
+ * <dsig:SignatureValue/> format for the algorithm (e.g. r||s for ECDSA).
+ * The DECRYPT result is the decrypted and unpadded key.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <xmlsec/openssl/remote.h>
+
+#ifdef XMLSEC_OPENSSL_REMOTE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include <openssl/rsa.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/base64.h>
+#include <xmlsec/xmltree.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/openssl/crypto.h>
+#include <xmlsec/openssl/evp.h>
+
+#include "openssl_compat.h"
+
+/* the longest accepted reply line */
+#define XMLSEC_OPENSSL_REMOTE_MAX_LINE                  1048576
+#define XMLSEC_OPENSSL_REMOTE_READ_SIZE                 4096
+
+/**************************************************************************
+ *
+ * Remote signer
+ *
+ *****************************************************************************/
+typedef struct _xmlSecOpenSSLRemoteRequest              xmlSecOpenSSLRemoteRequest,
+                                                        *xmlSecOpenSSLRemoteRequestPtr;
+struct _xmlSecOpenSSLRemoteRequest {
+    unsigned long                       id;
+    xmlSecBufferPtr                     out;
+    int                                 done;
+    int                                 status;
+    xmlSecOpenSSLRemoteRequestPtr       next;
+};
+
+struct _xmlSecOpenSSLRemoteSigner {
+    int                                 fd;
+    xmlChar*                            address;
+    xmlSecSize                          maxPending;
+
+    pthread_t                           reader;
+    int                                 readerStarted;
+    pthread_mutex_t                     mutex;
+    pthread_cond_t                      cond;
+
+    /* protected by the mutex */
+    xmlSecSize                          refs;
+    unsigned long                       nextId;
+    xmlSecSize                          pending;
+    xmlSecOpenSSLRemoteRequestPtr       requests;
+    xmlSecBuffer                        queue;
+    int                                 writing;
+    int                                 broken;
+};
+
+static int      xmlSecOpenSSLRemoteSignerConnect        (const char* address);
+static void*    xmlSecOpenSSLRemoteSignerReadThread     (void* arg);
+static int      xmlSecOpenSSLRemoteSignerReply          (xmlSecOpenSSLRemoteSignerPtr signer,
+                                                         char* line);
+static int      xmlSecOpenSSLRemoteSignerWrite          (xmlSecOpenSSLRemoteSignerPtr signer,
+                                                         xmlSecBufferPtr batch);
+static int      xmlSecOpenSSLRemoteSignerRequest        (xmlSecOpenSSLRemoteSignerPtr signer,
+                                                         const char* operation,
+                                                         const xmlChar* keyName,
+                                                         const xmlChar* algorithm,
+                                                         const xmlSecByte* in,
+                                                         xmlSecSize inSize,
+                                                         const xmlSecByte* params,
+                                                         xmlSecSize paramsSize,
+                                                         xmlSecBufferPtr out);
+static int      xmlSecOpenSSLRemoteCheckToken           (const xmlChar* token);
+static int      xmlSecOpenSSLKeyDataRemoteSet           (xmlSecKeyDataPtr data,
+                                                         xmlSecOpenSSLRemoteSignerPtr signer,
+                                                         const xmlChar* keyName);
+
+/**
+ * xmlSecOpenSSLRemoteSignerCreate:
+ * @address:            the signing service address: "unix:<path>" for a unix
+ *                      domain socket or "<host>:<port>" for TCP.
+ * @maxPending:         the maximum number of requests waiting for the reply
+ *                      (the callers block when the limit is reached) or 0
+ *                      for #XMLSEC_OPENSSL_REMOTE_DEFAULT_MAX_PENDING.
+ *
+ * Connects to the remote signing service. The signer is shared by all
+ * the threads and stays alive while there are keys referencing it.
+ *
+ * Returns: pointer to newly allocated signer or NULL if an error occurs.
+ */
+xmlSecOpenSSLRemoteSignerPtr
+xmlSecOpenSSLRemoteSignerCreate(const char* address, xmlSecSize maxPending) {
+    xmlSecOpenSSLRemoteSignerPtr signer;
+    int ret;
+
+    xmlSecAssert2(address != NULL, NULL);
+
+    signer = (xmlSecOpenSSLRemoteSignerPtr)xmlMalloc(sizeof(xmlSecOpenSSLRemoteSigner));
+    if(signer == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLRemoteSigner), NULL);
+        return(NULL);
+    }
+    memset(signer, 0, sizeof(xmlSecOpenSSLRemoteSigner));
+    signer->fd = -1;
+    signer->refs = 1;
+    signer->nextId = 1;
+    signer->maxPending = (maxPending > 0) ? maxPending : XMLSEC_OPENSSL_REMOTE_DEFAULT_MAX_PENDING;
+
+    if(pthread_mutex_init(&(signer->mutex), NULL) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_mutex_init");
+        xmlFree(signer);
+        return(NULL);
+    }
+    if(pthread_cond_init(&(signer->cond), NULL) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_cond_init");
+        pthread_mutex_destroy(&(signer->mutex));
+        xmlFree(signer);
+        return(NULL);
+    }
+    ret = xmlSecBufferInitialize(&(signer->queue), XMLSEC_OPENSSL_REMOTE_READ_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        pthread_cond_destroy(&(signer->cond));
+        pthread_mutex_destroy(&(signer->mutex));
+        xmlFree(signer);
+        return(NULL);
+    }
+
+    signer->address = xmlStrdup(BAD_CAST address);
+    if(signer->address == NULL) {
+        xmlSecStrdupError(BAD_CAST address, NULL);
+        xmlSecOpenSSLRemoteSignerDestroy(signer);
+        return(NULL);
+    }
+
+    signer->fd = xmlSecOpenSSLRemoteSignerConnect(address);
+    if(signer->fd < 0) {
+        xmlSecInternalError2("xmlSecOpenSSLRemoteSignerConnect", NULL,
+                             "address=%s", xmlSecErrorsSafeString(address));
+        xmlSecOpenSSLRemoteSignerDestroy(signer);
+        return(NULL);
+    }
+
+    if(pthread_create(&(signer->reader), NULL, xmlSecOpenSSLRemoteSignerReadThread, signer) != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL, "pthread_create");
+        xmlSecOpenSSLRemoteSignerDestroy(signer);
+        return(NULL);
+    }
+    signer->readerStarted = 1;
+
+    return(signer);
+}
+
+/**
+ * xmlSecOpenSSLRemoteSignerDestroy:
+ * @signer:             the pointer to remote signer.
+ *
+ * Releases the caller's reference to @signer: the connection is closed
+ * when the last key adopted by the signer is destroyed.
+ */
+void
+xmlSecOpenSSLRemoteSignerDestroy(xmlSecOpenSSLRemoteSignerPtr signer) {
+    xmlSecSize refs;
+
+    xmlSecAssert(signer != NULL);
+    xmlSecAssert(signer->refs > 0);
+
+    pthread_mutex_lock(&(signer->mutex));
+    refs = --(signer->refs);
+    pthread_mutex_unlock(&(signer->mutex));
+    if(refs > 0) {
+        return;
+    }
+    xmlSecAssert(signer->pending == 0);
+
+    if(signer->fd >= 0) {
+        /* wakes up the reader thread */
+        shutdown(signer->fd, SHUT_RDWR);
+    }
+    if(signer->readerStarted != 0) {
+        pthread_join(signer->reader, NULL);
+    }
+    if(signer->fd >= 0) {
+        close(signer->fd);
+    }
+    if(signer->address != NULL) {
+        xmlFree(signer->address);
+    }
+    xmlSecBufferFinalize(&(signer->queue));
+    pthread_cond_destroy(&(signer->cond));
+    pthread_mutex_destroy(&(signer->mutex));
+
+    memset(signer, 0, sizeof(xmlSecOpenSSLRemoteSigner));
+    xmlFree(signer);
+}
+
+/**
+ * xmlSecOpenSSLRemoteSignerAdoptKey:
+ * @signer:             the pointer to remote signer.
+ * @key:                the pointer to key with the public key value.
+ * @keyName:            the key name known to the signing service.
+ *
+ * Makes @key a private key whose private operations are done by @signer
+ * with the remote key @keyName. The @key value (e.g. loaded from the
+ * certificate) is used for everything else.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLRemoteSignerAdoptKey(xmlSecOpenSSLRemoteSignerPtr signer, xmlSecKeyPtr key, const xmlChar* keyName) {
+    xmlSecKeyDataPtr data;
+    xmlSecKeyDataPtr value;
+    int ret;
+
+    xmlSecAssert2(signer != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keyName != NULL, -1);
+
+    value = xmlSecKeyGetValue(key);
+    if(value == NULL) {
+        xmlSecInvalidDataError("key has no value", NULL);
+        return(-1);
+    }
+    if(xmlSecOpenSSLRemoteCheckToken(keyName) < 0) {
+        xmlSecInvalidStringDataError("keyName", keyName, "no spaces", NULL);
+        return(-1);
+    }
+
+#ifndef XMLSEC_NO_RSA
+    /* the RSA public key is marked as an external private key (same as
+     * the engine keys) so the transforms accept it for private operations */
+    if(xmlSecKeyDataCheckId(value, xmlSecOpenSSLKeyDataRsaId) &&
+       ((xmlSecKeyDataGetType(value) & xmlSecKeyDataTypePrivate) == 0)) {
+        const BIGNUM *n = NULL, *e = NULL;
+        BIGNUM *nDup, *eDup;
+        RSA* rsa;
+
+        rsa = xmlSecOpenSSLKeyDataRsaGetRsa(value);
+        if(rsa == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLKeyDataRsaGetRsa",
+                                xmlSecKeyDataGetName(value));
+            return(-1);
+        }
+        RSA_get0_key(rsa, &n, &e, NULL);
+        xmlSecAssert2(n != NULL, -1);
+        xmlSecAssert2(e != NULL, -1);
+
+        data = xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataRsaId);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecKeyDataCreate(KeyDataRsaId)", NULL);
+            return(-1);
+        }
+        rsa = RSA_new();
+        nDup = BN_dup(n);
+        eDup = BN_dup(e);
+        if((rsa == NULL) || (nDup == NULL) || (eDup == NULL) || (RSA_set0_key(rsa, nDup, eDup, NULL) != 1)) {
+            xmlSecOpenSSLError("RSA_set0_key", xmlSecKeyDataGetName(data));
+            if(rsa != NULL) {
+                RSA_free(rsa);
+            }
+            if(nDup != NULL) {
+                BN_free(nDup);
+            }
+            if(eDup != NULL) {
+                BN_free(eDup);
+            }
+            xmlSecKeyDataDestroy(data);
+            return(-1);
+        }
+        RSA_set_flags(rsa, RSA_FLAG_EXT_PKEY);
+
+        ret = xmlSecOpenSSLKeyDataRsaAdoptRsa(data, rsa);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLKeyDataRsaAdoptRsa",
+                                xmlSecKeyDataGetName(data));
+            RSA_free(rsa);
+            xmlSecKeyDataDestroy(data);
+            return(-1);
+        }
+
+        ret = xmlSecKeySetValue(key, data);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeySetValue",
+                                xmlSecKeyDataGetName(data));
+            xmlSecKeyDataDestroy(data);
+            return(-1);
+        }
+    }
+#endif /* XMLSEC_NO_RSA */
+
+    data = xmlSecKeyDataCreate(xmlSecOpenSSLKeyDataRemoteId);
+    if(data == NULL) {
+        xmlSecInternalError("xmlSecKeyDataCreate(KeyDataRemoteId)", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecOpenSSLKeyDataRemoteSet(data, signer, keyName);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteSet",
+                            xmlSecKeyDataGetName(data));
+        xmlSecKeyDataDestroy(data);
+        return(-1);
+    }
+
+    ret = xmlSecKeyAdoptData(key, data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyAdoptData",
+                            xmlSecKeyDataGetName(data));
+        xmlSecKeyDataDestroy(data);
+        return(-1);
+    }
+
+    return(0);
+}
+
+static int
+xmlSecOpenSSLRemoteCheckToken(const xmlChar* token) {
+    xmlSecAssert2(token != NULL, -1);
+
+    if(token[0] == '\0') {
+        return(-1);
+    }
+    for(; (*token) != '\0'; ++token) {
+        if(((*token) == ' ') || ((*token) == '\t') || ((*token) == '\r') || ((*token) == '\n')) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLRemoteSignerConnect(const char* address) {
+    int fd = -1;
+    int ret;
+
+    xmlSecAssert2(address != NULL, -1);
+
+    if(strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        const char* path = address + 5;
+
+        if(strlen(path) >= sizeof(addr.sun_path)) {
+            xmlSecInvalidStringDataError("address", path, "shorter path", NULL);
+            return(-1);
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0) {
+            xmlSecIOError("socket", address, NULL);
+            return(-1);
+        }
+        ret = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+        if(ret < 0) {
+            xmlSecIOError("connect", address, NULL);
+            close(fd);
+            return(-1);
+        }
+    } else {
+        struct addrinfo hints;
+        struct addrinfo* res = NULL;
+        struct addrinfo* ai;
+        char host[256];
+        const char* port;
+        size_t hostLen;
+
+        /* "<host>:<port>", the IPv6 host is in brackets */
+        port = strrchr(address, ':');
+        if((port == NULL) || (port == address) || (port[1] == '\0')) {
+            xmlSecInvalidStringDataError("address", address, "unix:<path> or <host>:<port>", NULL);
+            return(-1);
+        }
+        hostLen = (size_t)(port - address);
+        if((address[0] == '[') && (hostLen > 2) && (address[hostLen - 1] == ']')) {
+            ++address;
+            hostLen -= 2;
+        }
+        if(hostLen >= sizeof(host)) {
+            xmlSecInvalidStringDataError("address", address, "shorter host name", NULL);
+            return(-1);
+        }
+        memcpy(host, address, hostLen);
+        host[hostLen] = '\0';
+        ++port;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        ret = getaddrinfo(host, port, &hints, &res);
+        if(ret != 0) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_IO_FAILED, NULL,
+                              "getaddrinfo: %s", gai_strerror(ret));
+            return(-1);
+        }
+        for(ai = res; ai != NULL; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if(fd < 0) {
+                continue;
+            }
+            if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(res);
+        if(fd < 0) {
+            xmlSecIOError("connect", host, NULL);
+            return(-1);
+        }
+
+        /* the batches are small and latency sensitive */
+        ret = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &ret, sizeof(ret));
+    }
+
+    return(fd);
+}
+
+static int
+xmlSecOpenSSLRemoteSignerRequest(xmlSecOpenSSLRemoteSignerPtr signer, const char* operation,
+                                 const xmlChar* keyName, const xmlChar* algorithm,
+                                 const xmlSecByte* in, xmlSecSize inSize,
+                                 const xmlSecByte* params, xmlSecSize paramsSize,
+                                 xmlSecBufferPtr out) {
+    xmlSecOpenSSLRemoteRequest request;
+    xmlSecOpenSSLRemoteRequestPtr* cur;
+    xmlChar* inStr = NULL;
+    xmlChar* paramsStr = NULL;
+    xmlSecBuffer batch;
+    char header[64];
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(signer != NULL, -1);
+    xmlSecAssert2(operation != NULL, -1);
+    xmlSecAssert2(keyName != NULL, -1);
+    xmlSecAssert2(algorithm != NULL, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    /* encode before taking the lock */
+    inStr = xmlSecBase64Encode(in, inSize, 0);
+    if(inStr == NULL) {
+        xmlSecInternalError("xmlSecBase64Encode", NULL);
+        return(-1);
+    }
+    if((params != NULL) && (paramsSize > 0)) {
+        paramsStr = xmlSecBase64Encode(params, paramsSize, 0);
+        if(paramsStr == NULL) {
+            xmlSecInternalError("xmlSecBase64Encode", NULL);
+            xmlFree(inStr);
+            return(-1);
+        }
+    }
+    ret = xmlSecBufferInitialize(&batch, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        xmlFree(inStr);
+        if(paramsStr != NULL) {
+            xmlFree(paramsStr);
+        }
+        return(-1);
+    }
+    xmlSecBufferEmpty(out);
+    memset(&request, 0, sizeof(request));
+    request.out = out;
+
+    pthread_mutex_lock(&(signer->mutex));
+
+    /* the queue depth limit */
+    while((signer->broken == 0) && (signer->pending >= signer->maxPending)) {
+        pthread_cond_wait(&(signer->cond), &(signer->mutex));
+    }
+    if(signer->broken != 0) {
+        pthread_mutex_unlock(&(signer->mutex));
+        xmlSecOtherError2(XMLSEC_ERRORS_R_IO_FAILED, NULL,
+                          "remote signer connection is closed: %s",
+                          xmlSecErrorsSafeString(signer->address));
+        goto done;
+    }
+
+    request.id = (signer->nextId)++;
+    snprintf(header, sizeof(header), "%lu %s ", request.id, operation);
+    if((xmlSecBufferAppend(&(signer->queue), BAD_CAST header, strlen(header)) < 0) ||
+       (xmlSecBufferAppend(&(signer->queue), keyName, xmlStrlen(keyName)) < 0) ||
+       (xmlSecBufferAppend(&(signer->queue), BAD_CAST " ", 1) < 0) ||
+       (xmlSecBufferAppend(&(signer->queue), algorithm, xmlStrlen(algorithm)) < 0) ||
+       (xmlSecBufferAppend(&(signer->queue), BAD_CAST " ", 1) < 0) ||
+       (xmlSecBufferAppend(&(signer->queue), inStr, xmlStrlen(inStr)) < 0) ||
+       ((paramsStr != NULL) && (xmlSecBufferAppend(&(signer->queue), BAD_CAST " ", 1) < 0)) ||
+       ((paramsStr != NULL) && (xmlSecBufferAppend(&(signer->queue), paramsStr, xmlStrlen(paramsStr)) < 0)) ||
+       (xmlSecBufferAppend(&(signer->queue), BAD_CAST "\n", 1) < 0)) {
+        /* the half written request breaks the stream */
+        signer->broken = 1;
+        pthread_cond_broadcast(&(signer->cond));
+        pthread_mutex_unlock(&(signer->mutex));
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        goto done;
+    }
+    request.next = signer->requests;
+    signer->requests = &request;
+    ++(signer->pending);
+
+    /* the first thread to find no writer sends everything queued so far
+     * including the requests queued by the others while it is writing */
+    if(signer->writing == 0) {
+        signer->writing = 1;
+        while((signer->broken == 0) && (xmlSecBufferGetSize(&(signer->queue)) > 0)) {
+            /* neither buffer uses the inline storage, the swap never fails */
+            (void)xmlSecBufferSwap(&batch, &(signer->queue));
+            xmlSecBufferEmpty(&(signer->queue));
+
+            pthread_mutex_unlock(&(signer->mutex));
+            ret = xmlSecOpenSSLRemoteSignerWrite(signer, &batch);
+            pthread_mutex_lock(&(signer->mutex));
+            if(ret < 0) {
+                signer->broken = 1;
+                pthread_cond_broadcast(&(signer->cond));
+            }
+        }
+        signer->writing = 0;
+    }
+
+    while((request.done == 0) && (signer->broken == 0)) {
+        pthread_cond_wait(&(signer->cond), &(signer->mutex));
+    }
+
+    for(cur = &(signer->requests); (*cur) != NULL; cur = &((*cur)->next)) {
+        if((*cur) == &request) {
+            (*cur) = request.next;
+            break;
+        }
+    }
+    --(signer->pending);
+    pthread_cond_broadcast(&(signer->cond));
+    pthread_mutex_unlock(&(signer->mutex));
+
+    if(request.done == 0) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_IO_FAILED, NULL,
+                          "remote signer connection is closed: %s",
+                          xmlSecErrorsSafeString(signer->address));
+        goto done;
+    }
+    if(request.status < 0) {
+        xmlSecInternalError2("xmlSecOpenSSLRemoteSignerRequest", NULL,
+                             "operation=%s", operation);
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    xmlSecBufferFinalize(&batch);
+    xmlFree(inStr);
+    if(paramsStr != NULL) {
+        xmlFree(paramsStr);
+    }
+    return(res);
+}
+
+static int
+xmlSecOpenSSLRemoteSignerWrite(xmlSecOpenSSLRemoteSignerPtr signer, xmlSecBufferPtr batch) {
+    const xmlSecByte* data;
+    xmlSecSize size;
+    ssize_t ret;
+    int flags = 0;
+
+    xmlSecAssert2(signer != NULL, -1);
+    xmlSecAssert2(batch != NULL, -1);
+
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif /* MSG_NOSIGNAL */
+
+    data = xmlSecBufferGetData(batch);
+    size = xmlSecBufferGetSize(batch);
+    while(size > 0) {
+        ret = send(signer->fd, data, size, flags);
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            xmlSecIOError("send", signer->address, NULL);
+            return(-1);
+        }
+        data += ret;
+        size -= (xmlSecSize)ret;
+    }
+    xmlSecBufferEmpty(batch);
+    return(0);
+}
+
+static void*
+xmlSecOpenSSLRemoteSignerReadThread(void* arg) {
+    xmlSecOpenSSLRemoteSignerPtr signer = (xmlSecOpenSSLRemoteSignerPtr)arg;
+    xmlSecBuffer buf;
+    xmlSecByte* data;
+    xmlSecByte* eol;
+    xmlSecSize size;
+    ssize_t len;
+    int ret;
+
+    xmlSecAssert2(signer != NULL, NULL);
+
+    ret = xmlSecBufferInitialize(&buf, XMLSEC_OPENSSL_REMOTE_READ_SIZE);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        goto done;
+    }
+
+    while(1) {
+        size = xmlSecBufferGetSize(&buf);
+        if(size >= XMLSEC_OPENSSL_REMOTE_MAX_LINE) {
+            xmlSecInvalidSizeLessThanError("Reply line", size,
+                                           XMLSEC_OPENSSL_REMOTE_MAX_LINE, NULL);
+            break;
+        }
+        ret = xmlSecBufferSetMaxSize(&buf, size + XMLSEC_OPENSSL_REMOTE_READ_SIZE);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferSetMaxSize", NULL);
+            break;
+        }
+
+        len = recv(signer->fd, xmlSecBufferGetData(&buf) + size, XMLSEC_OPENSSL_REMOTE_READ_SIZE, 0);
+        if((len < 0) && (errno == EINTR)) {
+            continue;
+        } else if(len <= 0) {
+            /* closed by the service or by xmlSecOpenSSLRemoteSignerDestroy() */
+            break;
+        }
+        ret = xmlSecBufferSetSize(&buf, size + (xmlSecSize)len);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferSetSize", NULL);
+            break;
+        }
+
+        /* one read may bring many replies */
+        data = xmlSecBufferGetData(&buf);
+        size = xmlSecBufferGetSize(&buf);
+        while((eol = (xmlSecByte*)memchr(data, '\n', size)) != NULL) {
+            (*eol) = '\0';
+            ret = xmlSecOpenSSLRemoteSignerReply(signer, (char*)data);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLRemoteSignerReply", NULL);
+                goto done;
+            }
+            ret = xmlSecBufferRemoveHead(&buf, (xmlSecSize)(eol - data) + 1);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecBufferRemoveHead", NULL);
+                goto done;
+            }
+            data = xmlSecBufferGetData(&buf);
+            size = xmlSecBufferGetSize(&buf);
+        }
+    }
+
+done:
+    /* fail all the pending and the future requests */
+    pthread_mutex_lock(&(signer->mutex));
+    signer->broken = 1;
+    pthread_cond_broadcast(&(signer->cond));
+    pthread_mutex_unlock(&(signer->mutex));
+
+    xmlSecBufferFinalize(&buf);
+    return(NULL);
+}
+
+static int
+xmlSecOpenSSLRemoteSignerReply(xmlSecOpenSSLRemoteSignerPtr signer, char* line) {
+    xmlSecOpenSSLRemoteRequestPtr request;
+    unsigned long id;
+    char* status;
+    char* payload;
+    int ret;
+
+    xmlSecAssert2(signer != NULL, -1);
+    xmlSecAssert2(line != NULL, -1);
+
+    /* "<id> OK|FAIL <payload>" */
+    id = strtoul(line, &status, 10);
+    if((status == line) || ((*status) != ' ')) {
+        xmlSecInvalidStringDataError("reply", line, "<id> OK|FAIL <payload>", NULL);
+        return(-1);
+    }
+    ++status;
+    payload = strchr(status, ' ');
+    if(payload != NULL) {
+        (*(payload++)) = '\0';
+    } else {
+        payload = status + strlen(status);
+    }
+    if((strcmp(status, "OK") != 0) && (strcmp(status, "FAIL") != 0)) {
+        xmlSecInvalidStringDataError("reply status", status, "OK or FAIL", NULL);
+        return(-1);
+    }
+
+    pthread_mutex_lock(&(signer->mutex));
+    for(request = signer->requests; request != NULL; request = request->next) {
+        if((request->id == id) && (request->done == 0)) {
+            break;
+        }
+    }
+    if(request == NULL) {
+        pthread_mutex_unlock(&(signer->mutex));
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_DATA, NULL,
+                          "unexpected reply id=%lu", id);
+        return(-1);
+    }
+
+    if(strcmp(status, "OK") == 0) {
+        ret = xmlSecBufferSetMaxSize(request->out, strlen(payload) + 1);
+        if(ret >= 0) {
+            ret = xmlSecBase64Decode(BAD_CAST payload, xmlSecBufferGetData(request->out),
+                                     xmlSecBufferGetMaxSize(request->out));
+        }
+        if(ret >= 0) {
+            ret = xmlSecBufferSetSize(request->out, (xmlSecSize)ret);
+        }
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBase64Decode", NULL, "id=%lu", id);
+        }
+        request->status = (ret >= 0) ? 0 : -1;
+    } else {
+        xmlSecOtherError3(XMLSEC_ERRORS_R_CRYPTO_FAILED, NULL,
+                          "remote signer failure: id=%lu; error=%s",
+                          id, payload);
+        request->status = -1;
+    }
+    request->done = 1;
+    pthread_cond_broadcast(&(signer->cond));
+    pthread_mutex_unlock(&(signer->mutex));
+
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * Remote key data: the reference to the remote private key.
+ *
+ *****************************************************************************/
+typedef struct _xmlSecOpenSSLKeyDataRemoteCtx           xmlSecOpenSSLKeyDataRemoteCtx,
+                                                        *xmlSecOpenSSLKeyDataRemoteCtxPtr;
+struct _xmlSecOpenSSLKeyDataRemoteCtx {
+    xmlSecOpenSSLRemoteSignerPtr        signer;
+    xmlChar*                            keyName;
+};
+
+#define xmlSecOpenSSLKeyDataRemoteSize  \
+    (sizeof(xmlSecKeyData) + sizeof(xmlSecOpenSSLKeyDataRemoteCtx))
+#define xmlSecOpenSSLKeyDataRemoteGetCtx(data) \
+    ((xmlSecOpenSSLKeyDataRemoteCtxPtr)(((xmlSecByte*)(data)) + sizeof(xmlSecKeyData)))
+
+static int      xmlSecOpenSSLKeyDataRemoteInitialize    (xmlSecKeyDataPtr data);
+static int      xmlSecOpenSSLKeyDataRemoteDuplicate     (xmlSecKeyDataPtr dst,
+                                                         xmlSecKeyDataPtr src);
+static void     xmlSecOpenSSLKeyDataRemoteFinalize      (xmlSecKeyDataPtr data);
+static void     xmlSecOpenSSLKeyDataRemoteDebugDump     (xmlSecKeyDataPtr data,
+                                                         FILE* output);
+static void     xmlSecOpenSSLKeyDataRemoteDebugXmlDump  (xmlSecKeyDataPtr data,
+                                                         FILE* output);
+
+static xmlSecKeyDataKlass xmlSecOpenSSLKeyDataRemoteKlass = {
+    sizeof(xmlSecKeyDataKlass),
+    xmlSecOpenSSLKeyDataRemoteSize,
+
+    /* data */
+    BAD_CAST "remote",
+    xmlSecKeyDataUsageUnknown,                  /* xmlSecKeyDataUsage usage; */
+    NULL,                                       /* const xmlChar* href; */
+    NULL,                                       /* const xmlChar* dataNodeName; */
+    NULL,                                       /* const xmlChar* dataNodeNs; */
+
+    /* constructors/destructor */
+    xmlSecOpenSSLKeyDataRemoteInitialize,       /* xmlSecKeyDataInitializeMethod initialize; */
+    xmlSecOpenSSLKeyDataRemoteDuplicate,        /* xmlSecKeyDataDuplicateMethod duplicate; */
+    xmlSecOpenSSLKeyDataRemoteFinalize,         /* xmlSecKeyDataFinalizeMethod finalize; */
+    NULL,                                       /* xmlSecKeyDataGenerateMethod generate; */
+
+    /* get info */
+    NULL,                                       /* xmlSecKeyDataGetTypeMethod getType; */
+    NULL,                                       /* xmlSecKeyDataGetSizeMethod getSize; */
+    NULL,                                       /* xmlSecKeyDataGetIdentifier getIdentifier; */
+
+    /* read/write */
+    NULL,                                       /* xmlSecKeyDataXmlReadMethod xmlRead; */
+    NULL,                                       /* xmlSecKeyDataXmlWriteMethod xmlWrite; */
+    NULL,                                       /* xmlSecKeyDataBinReadMethod binRead; */
+    NULL,                                       /* xmlSecKeyDataBinWriteMethod binWrite; */
+
+    /* debug */
+    xmlSecOpenSSLKeyDataRemoteDebugDump,        /* xmlSecKeyDataDebugDumpMethod debugDump; */
+    xmlSecOpenSSLKeyDataRemoteDebugXmlDump,     /* xmlSecKeyDataDebugDumpMethod debugXmlDump; */
+
+    /* reserved for the future */
+    NULL,                                       /* void* reserved0; */
+    NULL,                                       /* void* reserved1; */
+};
+
+/**
+ * xmlSecOpenSSLKeyDataRemoteGetKlass:
+ *
+ * The remote private key reference klass: added to the key by
+ * #xmlSecOpenSSLRemoteSignerAdoptKey, it is never read from or written
+ * to XML.
+ *
+ * Returns: the remote key data klass.
+ */
+xmlSecKeyDataId
+xmlSecOpenSSLKeyDataRemoteGetKlass(void) {
+    return(&xmlSecOpenSSLKeyDataRemoteKlass);
+}
+
+static int
+xmlSecOpenSSLKeyDataRemoteSet(xmlSecKeyDataPtr data, xmlSecOpenSSLRemoteSignerPtr signer, const xmlChar* keyName) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId), -1);
+    xmlSecAssert2(signer != NULL, -1);
+    xmlSecAssert2(keyName != NULL, -1);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->signer == NULL, -1);
+    xmlSecAssert2(ctx->keyName == NULL, -1);
+
+    ctx->keyName = xmlStrdup(keyName);
+    if(ctx->keyName == NULL) {
+        xmlSecStrdupError(keyName, xmlSecKeyDataGetName(data));
+        return(-1);
+    }
+
+    pthread_mutex_lock(&(signer->mutex));
+    ++(signer->refs);
+    pthread_mutex_unlock(&(signer->mutex));
+    ctx->signer = signer;
+
+    return(0);
+}
+
+static int
+xmlSecOpenSSLKeyDataRemoteInitialize(xmlSecKeyDataPtr data) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId), -1);
+    xmlSecAssert2(xmlSecKeyDataCheckSize(data, xmlSecOpenSSLKeyDataRemoteSize), -1);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecOpenSSLKeyDataRemoteCtx));
+    return(0);
+}
+
+static int
+xmlSecOpenSSLKeyDataRemoteDuplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctxSrc;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(dst, xmlSecOpenSSLKeyDataRemoteId), -1);
+    xmlSecAssert2(xmlSecKeyDataCheckId(src, xmlSecOpenSSLKeyDataRemoteId), -1);
+
+    ctxSrc = xmlSecOpenSSLKeyDataRemoteGetCtx(src);
+    xmlSecAssert2(ctxSrc != NULL, -1);
+    xmlSecAssert2(ctxSrc->signer != NULL, -1);
+    xmlSecAssert2(ctxSrc->keyName != NULL, -1);
+
+    ret = xmlSecOpenSSLKeyDataRemoteSet(dst, ctxSrc->signer, ctxSrc->keyName);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteSet",
+                            xmlSecKeyDataGetName(dst));
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecOpenSSLKeyDataRemoteFinalize(xmlSecKeyDataPtr data) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId));
+    xmlSecAssert(xmlSecKeyDataCheckSize(data, xmlSecOpenSSLKeyDataRemoteSize));
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->signer != NULL) {
+        xmlSecOpenSSLRemoteSignerDestroy(ctx->signer);
+    }
+    if(ctx->keyName != NULL) {
+        xmlFree(ctx->keyName);
+    }
+    memset(ctx, 0, sizeof(xmlSecOpenSSLKeyDataRemoteCtx));
+}
+
+static void
+xmlSecOpenSSLKeyDataRemoteDebugDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId));
+    xmlSecAssert(output != NULL);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->signer != NULL);
+
+    fprintf(output, "=== remote key: name = \"%s\", address = \"%s\"\n",
+            ctx->keyName, ctx->signer->address);
+}
+
+static void
+xmlSecOpenSSLKeyDataRemoteDebugXmlDump(xmlSecKeyDataPtr data, FILE* output) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+
+    xmlSecAssert(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId));
+    xmlSecAssert(output != NULL);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->signer != NULL);
+
+    fprintf(output, "<RemoteKey name=\"");
+    xmlSecPrintXmlString(output, ctx->keyName);
+    fprintf(output, "\" address=\"");
+    xmlSecPrintXmlString(output, ctx->signer->address);
+    fprintf(output, "\" />\n");
+}
+
+/**
+ * xmlSecOpenSSLKeyDataRemoteSign:
+ * @data:               the pointer to remote key data.
+ * @algorithm:          the signature algorithm href.
+ * @in:                 the digest (or the data for the algorithms without digest).
+ * @inSize:             the @in size.
+ * @out:                the output buffer for the signature.
+ *
+ * Signs @in with the remote key. The calling thread is blocked until
+ * the reply comes while the other threads' requests are sent over the
+ * same connection.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLKeyDataRemoteSign(xmlSecKeyDataPtr data, const xmlChar* algorithm,
+                               const xmlSecByte* in, xmlSecSize inSize,
+                               xmlSecBufferPtr out) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId), -1);
+    xmlSecAssert2(algorithm != NULL, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->signer != NULL, -1);
+    xmlSecAssert2(ctx->keyName != NULL, -1);
+
+    ret = xmlSecOpenSSLRemoteSignerRequest(ctx->signer, "SIGN", ctx->keyName, algorithm,
+                                           in, inSize, NULL, 0, out);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecOpenSSLRemoteSignerRequest",
+                             xmlSecKeyDataGetName(data),
+                             "key=%s", xmlSecErrorsSafeString(ctx->keyName));
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLKeyDataRemoteDecrypt:
+ * @data:               the pointer to remote key data.
+ * @algorithm:          the key transport algorithm href.
+ * @in:                 the encrypted data.
+ * @inSize:             the @in size.
+ * @params:             the OAEP params or NULL.
+ * @paramsSize:         the @params size.
+ * @out:                the output buffer for the decrypted data.
+ *
+ * Decrypts @in with the remote key (see #xmlSecOpenSSLKeyDataRemoteSign).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLKeyDataRemoteDecrypt(xmlSecKeyDataPtr data, const xmlChar* algorithm,
+                                  const xmlSecByte* in, xmlSecSize inSize,
+                                  const xmlSecByte* params, xmlSecSize paramsSize,
+                                  xmlSecBufferPtr out) {
+    xmlSecOpenSSLKeyDataRemoteCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataRemoteId), -1);
+    xmlSecAssert2(algorithm != NULL, -1);
+    xmlSecAssert2(in != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    ctx = xmlSecOpenSSLKeyDataRemoteGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->signer != NULL, -1);
+    xmlSecAssert2(ctx->keyName != NULL, -1);
+
+    ret = xmlSecOpenSSLRemoteSignerRequest(ctx->signer, "DECRYPT", ctx->keyName, algorithm,
+                                           in, inSize, params, paramsSize, out);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecOpenSSLRemoteSignerRequest",
+                             xmlSecKeyDataGetName(data),
+                             "key=%s", xmlSecErrorsSafeString(ctx->keyName));
+        return(-1);
+    }
+    return(0);
+}
+
+#endif /* XMLSEC_OPENSSL_REMOTE */
@@ -21,7 +21,9 @@
 
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
+#include <xmlsec/openssl/remote.h>
 #include "openssl_compat.h"
+#include "evp_pool.h"
 
 /******************************************************************************
  *
@@ -43,17 +45,19 @@ static inline void ECDSA_SIG_get0(const ECDSA_SIG *sig, const BIGNUM **pr, const
     }
 }
 
-static inline int ECDSA_SIG_set0(ECDSA_SIG *sig, BIGNUM *r, BIGNUM *s) {
-    xmlSecAssert2(sig != NULL, 0);
+static inline int BN_bn2binpad(const BIGNUM *a, unsigned char *to, int tolen) {
+    int size;
 
-    if((r == NULL) || (s == NULL)) {
-        return(0);
+    xmlSecAssert2(a != NULL, -1);
+    xmlSecAssert2(to != NULL, -1);
+
+    size = BN_num_bytes(a);
+    if((tolen < 0) || (size > tolen)) {
+        return(-1);
     }
-    BN_clear_free(sig->r);
-    BN_clear_free(sig->s);
-    sig->r = r;
-    sig->s = s;
-    return(1);
+    memset(to, 0, tolen - size);
+    BN_bn2bin(a, to + tolen - size);
+    return(tolen);
 }
 #endif /* XMLSEC_NO_ECDSA */
 
@@ -145,6 +149,10 @@ struct _xmlSecOpenSSLSignatureCtx {
     EVP_PKEY*                            pKey;
     unsigned char                        dgst[EVP_MAX_MD_SIZE];
     unsigned int                         dgstSize;
+    xmlSecSize                           signHalfSize;  /* ECDSA r and s size for pKey */
+#ifdef XMLSEC_OPENSSL_REMOTE
+    xmlSecKeyDataPtr                     remote;        /* the remote private key */
+#endif /* XMLSEC_OPENSSL_REMOTE */
 };
 
 
@@ -164,6 +172,7 @@ struct _xmlSecOpenSSLSignatureCtx {
 static int      xmlSecOpenSSLSignatureCheckId                (xmlSecTransformPtr transform);
 static int      xmlSecOpenSSLSignatureInitialize             (xmlSecTransformPtr transform);
 static void     xmlSecOpenSSLSignatureFinalize               (xmlSecTransformPtr transform);
+static int      xmlSecOpenSSLSignatureReset                  (xmlSecTransformPtr transform);
 static int      xmlSecOpenSSLSignatureSetKeyReq              (xmlSecTransformPtr transform,
                                                                  xmlSecKeyReqPtr keyReq);
 static int      xmlSecOpenSSLSignatureSetKey                 (xmlSecTransformPtr transform,
@@ -325,10 +334,12 @@ xmlSecOpenSSLSignatureInitialize(xmlSecTransformPtr transform) {
     }
 
     /* create/init digest CTX */
-    ctx->digestCtx = EVP_MD_CTX_new();
+    ctx->digest = xmlSecOpenSSLEvpDigestFetch(ctx->digest);
+
+    ctx->digestCtx = xmlSecOpenSSLEvpMdCtxAcquire();
     if(ctx->digestCtx == NULL) {
-        xmlSecOpenSSLError("EVP_MD_CTX_new",
-                           xmlSecTransformGetName(transform));
+        xmlSecInternalError("xmlSecOpenSSLEvpMdCtxAcquire",
+                            xmlSecTransformGetName(transform));
         return(-1);
     }
 
@@ -358,12 +369,53 @@ xmlSecOpenSSLSignatureFinalize(xmlSecTransformPtr transform) {
     }
 
     if(ctx->digestCtx != NULL) {
-        EVP_MD_CTX_free(ctx->digestCtx);
+        xmlSecOpenSSLEvpMdCtxRelease(ctx->digestCtx);
+    }
+
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
     }
+#endif /* XMLSEC_OPENSSL_REMOTE */
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLSignatureCtx));
 }
 
+static int
+xmlSecOpenSSLSignatureReset(xmlSecTransformPtr transform) {
+    xmlSecOpenSSLSignatureCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecOpenSSLSignatureCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLSignatureSize), -1);
+
+    ctx = xmlSecOpenSSLSignatureGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    /* keep the digest context initialized for the next use, the key is set again */
+    if(ctx->pKey != NULL) {
+        EVP_PKEY_free(ctx->pKey);
+        ctx->pKey = NULL;
+    }
+#ifdef XMLSEC_OPENSSL_REMOTE
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+        ctx->remote = NULL;
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
+    ret = EVP_DigestInit(ctx->digestCtx, ctx->digest);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestInit",
+                           xmlSecTransformGetName(transform));
+        return(-1);
+    }
+    memset(ctx->dgst, 0, sizeof(ctx->dgst));
+    ctx->dgstSize = 0;
+    ctx->signHalfSize = 0;
+    return(0);
+}
+
 static int
 xmlSecOpenSSLSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
     xmlSecOpenSSLSignatureCtxPtr ctx;
@@ -401,6 +453,24 @@ xmlSecOpenSSLSignatureSetKey(xmlSecTransformPtr transform, xmlSecKeyPtr key) {
                             xmlSecTransformGetName(transform));
         return(-1);
     }
+    ctx->signHalfSize = 0;
+
+#ifdef XMLSEC_OPENSSL_REMOTE
+    /* the remote key signs, the local key value verifies */
+    if(ctx->remote != NULL) {
+        xmlSecKeyDataDestroy(ctx->remote);
+        ctx->remote = NULL;
+    }
+    value = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataRemoteId);
+    if((value != NULL) && (transform->operation == xmlSecTransformOperationSign)) {
+        ctx->remote = xmlSecKeyDataDuplicate(value);
+        if(ctx->remote == NULL) {
+            xmlSecInternalError("xmlSecKeyDataDuplicate",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+#endif /* XMLSEC_OPENSSL_REMOTE */
 
     return(0);
 }
@@ -534,6 +604,17 @@ xmlSecOpenSSLSignatureExecute(xmlSecTransformPtr transform, int last, xmlSecTran
         xmlSecAssert2(ctx->dgstSize > 0, -1);
 
         /* sign right away, verify will wait till separate call */
+#ifdef XMLSEC_OPENSSL_REMOTE
+        if((transform->operation == xmlSecTransformOperationSign) && (ctx->remote != NULL)) {
+            ret = xmlSecOpenSSLKeyDataRemoteSign(ctx->remote, transform->id->href,
+                                                 ctx->dgst, ctx->dgstSize, out);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLKeyDataRemoteSign",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        } else
+#endif /* XMLSEC_OPENSSL_REMOTE */
         if(transform->operation == xmlSecTransformOperationSign) {
             ret = (ctx->signCallback)(ctx, out);
             if(ret < 0) {
@@ -804,7 +885,7 @@ static xmlSecTransformKlass xmlSecOpenSSLDsaSha1Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -852,7 +933,7 @@ static xmlSecTransformKlass xmlSecOpenSSLDsaSha256Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -893,51 +974,81 @@ xmlSecOpenSSLTransformDsaSha256GetKlass(void) {
  *
  ***************************************************************************/
 static xmlSecSize
-xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(EC_KEY * ecKey) {
-    const EC_GROUP *group;
-    BIGNUM *order = NULL;
-    xmlSecSize signHalfSize = 0;
+xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(xmlSecOpenSSLSignatureCtxPtr ctx) {
+    int bits;
 
-    xmlSecAssert2(ecKey != NULL, 0);
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ctx->pKey != NULL, 0);
 
-    group = EC_KEY_get0_group(ecKey);
-    if(group == NULL) {
-        xmlSecOpenSSLError("EC_KEY_get0_group", NULL);
-        goto done;
+    /* the size of the base point order is the same for all the signatures
+     * with this key: calculate it only once */
+    if(ctx->signHalfSize > 0) {
+        return(ctx->signHalfSize);
     }
 
-    order = BN_new();
-    if(order == NULL) {
-        xmlSecOpenSSLError("BN_new", NULL);
-        goto done;
+    /* for EC keys EVP_PKEY_bits() returns the number of bits in the order */
+    bits = EVP_PKEY_bits(ctx->pKey);
+    if(bits <= 0) {
+        xmlSecOpenSSLError("EVP_PKEY_bits", NULL);
+        return(0);
     }
 
-    if(EC_GROUP_get_order(group, order, NULL) != 1) {
-        xmlSecOpenSSLError("EC_GROUP_get_order", NULL);
-        goto done;
-    }
+    ctx->signHalfSize = ((xmlSecSize)bits + 7) / 8;
+    return(ctx->signHalfSize);
+}
 
-    /* result */
-    signHalfSize = BN_num_bytes(order);
+/* the largest base point order we support (the binary sect571 curves
+ * have 72 bytes) and the DER encoded ECDSA-Sig-Value for it:
+ * SEQUENCE { INTEGER r, INTEGER s } */
+#define XMLSEC_OPENSSL_ECDSA_MAX_HALF_SIZE      128
+#define XMLSEC_OPENSSL_ECDSA_MAX_DER_SIZE       (4 + 2 * (4 + XMLSEC_OPENSSL_ECDSA_MAX_HALF_SIZE + 1))
 
-done:
-    /* cleanup */
-    if(order != NULL) {
-        BN_clear_free(order);
+static xmlSecSize
+xmlSecOpenSSLSignatureEcdsaDerLength(xmlSecSize len, xmlSecByte* out) {
+    if(len < 0x80) {
+        out[0] = (xmlSecByte)len;
+        return(1);
+    } else if(len < 0x100) {
+        out[0] = 0x81;
+        out[1] = (xmlSecByte)len;
+        return(2);
+    }
+    out[0] = 0x82;
+    out[1] = (xmlSecByte)(len >> 8);
+    out[2] = (xmlSecByte)(len & 0xFF);
+    return(3);
+}
+
+static xmlSecSize
+xmlSecOpenSSLSignatureEcdsaDerInteger(const xmlSecByte* data, xmlSecSize dataSize, xmlSecByte* out) {
+    xmlSecSize pos;
+
+    /* unsigned big endian number: strip leading zeros (but keep one
+     * byte for zero) and add a zero byte if the high bit is set */
+    while((dataSize > 1) && (data[0] == 0)) {
+        ++data;
+        --dataSize;
     }
 
-    /* done */
-    return(signHalfSize);
+    out[0] = 0x02;
+    pos = 1;
+    if((data[0] & 0x80) != 0) {
+        pos += xmlSecOpenSSLSignatureEcdsaDerLength(dataSize + 1, out + pos);
+        out[pos++] = 0;
+    } else {
+        pos += xmlSecOpenSSLSignatureEcdsaDerLength(dataSize, out + pos);
+    }
+    memcpy(out + pos, data, dataSize);
+    return(pos + dataSize);
 }
 
-
 static int
 xmlSecOpenSSLSignatureEcdsaSign(xmlSecOpenSSLSignatureCtxPtr ctx, xmlSecBufferPtr out) {
     EC_KEY * ecKey = NULL;
     ECDSA_SIG *sig = NULL;
     const BIGNUM *rr = NULL, *ss = NULL;
     xmlSecByte *outData;
-    xmlSecSize signHalfSize, rSize, sSize;
+    xmlSecSize signHalfSize;
     int res = -1;
     int ret;
 
@@ -947,20 +1058,20 @@ xmlSecOpenSSLSignatureEcdsaSign(xmlSecOpenSSLSignatureCtxPtr ctx, xmlSecBufferPt
     xmlSecAssert2(ctx->dgstSize <= sizeof(ctx->dgst), -1);
     xmlSecAssert2(out != NULL, -1);
 
-    /* get key */
-    ecKey = EVP_PKEY_get1_EC_KEY(ctx->pKey);
-    if(ecKey == NULL) {
-        xmlSecOpenSSLError("EVP_PKEY_get1_DSA", NULL);
-        goto done;
-    }
-
     /* calculate signature size */
-    signHalfSize = xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(ecKey);
+    signHalfSize = xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(ctx);
     if(signHalfSize <= 0) {
         xmlSecInternalError("xmlSecOpenSSLSignatureEcdsaSignatureHalfSize", NULL);
         goto done;
     }
 
+    /* get key */
+    ecKey = EVP_PKEY_get1_EC_KEY(ctx->pKey);
+    if(ecKey == NULL) {
+        xmlSecOpenSSLError("EVP_PKEY_get1_EC_KEY", NULL);
+        goto done;
+    }
+
     /* sign */
     sig = ECDSA_do_sign(ctx->dgst, ctx->dgstSize, ecKey);
     if(sig == NULL) {
@@ -975,36 +1086,29 @@ xmlSecOpenSSLSignatureEcdsaSign(xmlSecOpenSSLSignatureCtxPtr ctx, xmlSecBufferPt
         goto done;
     }
 
-    /* check sizes */
-    rSize = BN_num_bytes(rr);
-    if(rSize > signHalfSize) {
-        xmlSecInvalidSizeMoreThanError("ECDSA signatue r",
-                                       rSize, signHalfSize, NULL);
-        goto done;
-    }
-
-    sSize = BN_num_bytes(ss);
-    if(sSize > signHalfSize) {
-        xmlSecInvalidSizeMoreThanError("ECDSA signatue s",
-                                       sSize, signHalfSize, NULL);
-        goto done;
-    }
-
-    /* allocate buffer */
+    /* write components right into the output buffer, I2OSP padding
+     * is done by BN_bn2binpad() */
     ret = xmlSecBufferSetSize(out, 2 * signHalfSize);
     if(ret < 0) {
         xmlSecInternalError2("xmlSecBufferSetSize", NULL,
-                             "size=%d", (int)(2 * signHalfSize));
+                             "size=%lu", (unsigned long)(2 * signHalfSize));
         goto done;
     }
     outData = xmlSecBufferGetData(out);
     xmlSecAssert2(outData != NULL, -1);
 
-    /* write components */
-    xmlSecAssert2((rSize + sSize) <= 2 * signHalfSize, -1);
-    memset(outData, 0, 2 * signHalfSize);
-    BN_bn2bin(rr, outData + signHalfSize - rSize);
-    BN_bn2bin(ss, outData + 2 * signHalfSize - sSize);
+    ret = BN_bn2binpad(rr, outData, (int)signHalfSize);
+    if(ret < 0) {
+        xmlSecInvalidSizeMoreThanError("ECDSA signatue r",
+                                       (xmlSecSize)BN_num_bytes(rr), signHalfSize, NULL);
+        goto done;
+    }
+    ret = BN_bn2binpad(ss, outData + signHalfSize, (int)signHalfSize);
+    if(ret < 0) {
+        xmlSecInvalidSizeMoreThanError("ECDSA signatue s",
+                                       (xmlSecSize)BN_num_bytes(ss), signHalfSize, NULL);
+        goto done;
+    }
 
     /* success */
     res = 0;
@@ -1024,88 +1128,64 @@ done:
 
 static int
 xmlSecOpenSSLSignatureEcdsaVerify(xmlSecOpenSSLSignatureCtxPtr ctx, const xmlSecByte* signData, xmlSecSize signSize) {
-    EC_KEY * ecKey = NULL;
-    ECDSA_SIG *sig = NULL;
-    BIGNUM *rr = NULL, *ss = NULL;
-    xmlSecSize signHalfSize;
-    int res = -1;
+    xmlSecByte der[XMLSEC_OPENSSL_ECDSA_MAX_DER_SIZE];
+    xmlSecByte ints[XMLSEC_OPENSSL_ECDSA_MAX_DER_SIZE];
+    xmlSecSize signHalfSize, intsSize, derSize;
+    EVP_PKEY_CTX* pKeyCtx;
     int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->pKey != NULL, -1);
+    xmlSecAssert2(ctx->digest != NULL, -1);
     xmlSecAssert2(ctx->dgstSize > 0, -1);
     xmlSecAssert2(ctx->dgstSize <= sizeof(ctx->dgst), -1);
     xmlSecAssert2(signData != NULL, -1);
 
-    /* get key */
-    ecKey = EVP_PKEY_get1_EC_KEY(ctx->pKey);
-    if(ecKey == NULL) {
-        xmlSecOpenSSLError("EVP_PKEY_get1_EC_KEY", NULL);
-        goto done;
-    }
-
     /* calculate signature size */
-    signHalfSize = xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(ecKey);
+    signHalfSize = xmlSecOpenSSLSignatureEcdsaSignatureHalfSize(ctx);
     if(signHalfSize <= 0) {
         xmlSecInternalError("xmlSecOpenSSLSignatureEcdsaSignatureHalfSize", NULL);
-        goto done;
+        return(-1);
+    }
+    if(signHalfSize > XMLSEC_OPENSSL_ECDSA_MAX_HALF_SIZE) {
+        xmlSecInvalidSizeMoreThanError("ECDSA signature (half)", signHalfSize,
+                                       XMLSEC_OPENSSL_ECDSA_MAX_HALF_SIZE, NULL);
+        return(-1);
     }
 
     /* check size */
     if(signSize != 2 * signHalfSize) {
         xmlSecInvalidSizeError("ECDSA signature", signSize, 2 * signHalfSize,
                                NULL);
-        goto done;
+        return(-1);
     }
 
-    /* create/read signature */
-    sig = ECDSA_SIG_new();
-    if (sig == NULL) {
-        xmlSecOpenSSLError("DSA_SIG_new", NULL);
-        goto done;
-    }
+    /* convert r || s to the DER encoded ECDSA-Sig-Value on the stack */
+    intsSize  = xmlSecOpenSSLSignatureEcdsaDerInteger(signData, signHalfSize, ints);
+    intsSize += xmlSecOpenSSLSignatureEcdsaDerInteger(signData + signHalfSize, signHalfSize, ints + intsSize);
 
-    rr = BN_bin2bn(signData, signHalfSize, NULL);
-    if(rr == NULL) {
-        xmlSecOpenSSLError("BN_bin2bn(sig->r)", NULL);
-        goto done;
-    }
-    ss = BN_bin2bn(signData + signHalfSize, signHalfSize, NULL);
-    if(ss == NULL) {
-        xmlSecOpenSSLError("BN_bin2bn(sig->s)", NULL);
-        goto done;
-    }
+    der[0] = 0x30;
+    derSize = 1 + xmlSecOpenSSLSignatureEcdsaDerLength(intsSize, der + 1);
+    xmlSecAssert2(derSize + intsSize <= sizeof(der), -1);
+    memcpy(der + derSize, ints, intsSize);
+    derSize += intsSize;
 
-    ret = ECDSA_SIG_set0(sig, rr, ss);
-    if(ret == 0) {
-        xmlSecOpenSSLError("ECDSA_SIG_set0()", NULL);
-        goto done;
+    /* verify signature */
+    pKeyCtx = xmlSecOpenSSLEvpPKeyCtxCreateVerify(ctx->pKey, ctx->digest);
+    if(pKeyCtx == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLEvpPKeyCtxCreateVerify", NULL);
+        return(-1);
     }
-    rr = NULL;
-    ss = NULL;
 
-    /* verify signature */
-    ret = ECDSA_do_verify(ctx->dgst, ctx->dgstSize, sig, ecKey);
+    ret = EVP_PKEY_verify(pKeyCtx, der, derSize, ctx->dgst, ctx->dgstSize);
+    EVP_PKEY_CTX_free(pKeyCtx);
     if(ret < 0) {
-        xmlSecOpenSSLError("ECDSA_do_verify", NULL);
-        goto done;
+        xmlSecOpenSSLError("EVP_PKEY_verify", NULL);
+        return(-1);
     }
 
     /* return 1 for good signatures and 0 for bad */
-    if(ret > 0) {
-        res = 1;
-    } else if(ret == 0) {
-        res = 0;
-    }
-
-done:
-    /* cleanup */
-    ECDSA_SIG_free(sig);
-    EC_KEY_free(ecKey);
-    BN_clear_free(rr);
-    BN_clear_free(ss);
-    /* done */
-    return(res);
+    return((ret > 0) ? 1 : 0);
 }
 
 #ifndef XMLSEC_NO_SHA1
@@ -1138,7 +1218,7 @@ static xmlSecTransformKlass xmlSecOpenSSLEcdsaSha1Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -1186,7 +1266,7 @@ static xmlSecTransformKlass xmlSecOpenSSLEcdsaSha224Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -1234,7 +1314,7 @@ static xmlSecTransformKlass xmlSecOpenSSLEcdsaSha256Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -1282,7 +1362,7 @@ static xmlSecTransformKlass xmlSecOpenSSLEcdsaSha384Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -1330,7 +1410,7 @@ static xmlSecTransformKlass xmlSecOpenSSLEcdsaSha512Klass = {
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecOpenSSLSignatureExecute,           /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecOpenSSLSignatureReset,                /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
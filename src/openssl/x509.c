@@ -21,6 +21,7 @@
 #include <time.h>
 
 #include <libxml/tree.h>
+#include <libxml/threads.h>
 #include <openssl/evp.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
@@ -40,6 +41,7 @@
 #include <xmlsec/openssl/evp.h>
 #include <xmlsec/openssl/x509.h>
 #include "openssl_compat.h"
+#include "x509utils.h"
 
 /* The ASN1_TIME_check() function was changed from ASN1_TIME * to
  * const ASN1_TIME * in 1.1.0. To avoid compiler warnings, we use this hack.
@@ -61,29 +63,32 @@ static int              xmlSecOpenSSLX509DataNodeRead           (xmlSecKeyDataPt
 static int              xmlSecOpenSSLX509CertificateNodeRead    (xmlSecKeyDataPtr data,
                                                                  xmlNodePtr node,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
-static int              xmlSecOpenSSLX509CertificateNodeWrite   (X509* cert,
-                                                                 xmlNodePtr node,
-                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int              xmlSecOpenSSLX509CertificateNodeWrite   (const xmlChar* buf,
+                                                                 xmlNodePtr node);
 static int              xmlSecOpenSSLX509SubjectNameNodeRead    (xmlSecKeyDataPtr data,
                                                                  xmlNodePtr node,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
-static int              xmlSecOpenSSLX509SubjectNameNodeWrite   (X509* cert,
-                                                                 xmlNodePtr node,
-                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int              xmlSecOpenSSLX509SubjectNameNodeWrite   (const xmlChar* subject,
+                                                                 xmlNodePtr node);
 static int              xmlSecOpenSSLX509IssuerSerialNodeRead   (xmlSecKeyDataPtr data,
                                                                  xmlNodePtr node,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
-static int              xmlSecOpenSSLX509IssuerSerialNodeWrite  (X509* cert,
-                                                                 xmlNodePtr node,
-                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int              xmlSecOpenSSLX509IssuerSerialNodeWrite  (const xmlChar* issuerName,
+                                                                 const xmlChar* issuerSerial,
+                                                                 xmlNodePtr node);
 static int              xmlSecOpenSSLX509SKINodeRead            (xmlSecKeyDataPtr data,
                                                                  xmlNodePtr node,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
 static int              xmlSecOpenSSLX509SKINodeWrite           (X509* cert,
                                                                  xmlNodePtr node,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int              xmlSecOpenSSLX509DataCrlNodesRead       (xmlSecKeyDataPtr data,
+                                                                 xmlSecKeyPtr key,
+                                                                 xmlNodePtr node,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
 static int              xmlSecOpenSSLX509CRLNodeRead            (xmlSecKeyDataPtr data,
                                                                  xmlNodePtr node,
+                                                                 xmlSecKeyDataStorePtr x509Store,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
 static int              xmlSecOpenSSLX509CRLNodeWrite           (X509_CRL* crl,
                                                                  xmlNodePtr node,
@@ -98,7 +103,8 @@ static xmlChar*         xmlSecOpenSSLX509CertBase64DerWrite     (X509* cert,
                                                                  int base64LineWrap);
 static X509_CRL*        xmlSecOpenSSLX509CrlDerRead             (xmlSecByte* buf,
                                                                  xmlSecSize size);
-static X509_CRL*        xmlSecOpenSSLX509CrlBase64DerRead       (xmlChar* buf);
+static X509_NAME*       xmlSecOpenSSLX509CrlDerReadIssuer       (const xmlSecByte* buf,
+                                                                 xmlSecSize size);
 static xmlChar*         xmlSecOpenSSLX509CrlBase64DerWrite      (X509_CRL* crl,
                                                                  int base64LineWrap);
 static xmlChar*         xmlSecOpenSSLX509NameWrite              (X509_NAME* nm);
@@ -111,6 +117,45 @@ static void             xmlSecOpenSSLX509CertDebugXmlDump       (X509* cert,
 static int              xmlSecOpenSSLX509CertGetTime            (XMLSEC_CONST_ASN1_TIME * t,
                                                                  time_t* res);
 
+/*************************************************************************
+ *
+ * Serialized <dsig:X509Data/> children cache: the strings are computed
+ * once per certificate and the cache is shared between the key data
+ * duplicates (e.g. the keys returned by the keys manager for signing).
+ * The entries are never changed after the strings are set and hold
+ * a reference to the certificate so the pointers can not be reused.
+ *
+ ************************************************************************/
+typedef struct _xmlSecOpenSSLX509WriteCacheEntry        xmlSecOpenSSLX509WriteCacheEntry,
+                                                        *xmlSecOpenSSLX509WriteCacheEntryPtr;
+struct _xmlSecOpenSSLX509WriteCacheEntry {
+    X509*               cert;
+    int                 base64LineSize;
+    xmlChar*            certBase64;
+    xmlChar*            subjectName;
+    xmlChar*            issuerName;
+    xmlChar*            issuerSerial;
+};
+
+typedef struct _xmlSecOpenSSLX509WriteCache             xmlSecOpenSSLX509WriteCache,
+                                                        *xmlSecOpenSSLX509WriteCachePtr;
+struct _xmlSecOpenSSLX509WriteCache {
+    xmlMutexPtr                         mutex;
+    int                                 refs;
+    xmlSecOpenSSLX509WriteCacheEntryPtr entries;
+    xmlSecSize                          entriesSize;
+    xmlSecSize                          entriesMaxSize;
+};
+
+static xmlSecOpenSSLX509WriteCachePtr xmlSecOpenSSLX509WriteCacheCreate (void);
+static xmlSecOpenSSLX509WriteCachePtr xmlSecOpenSSLX509WriteCacheRef    (xmlSecOpenSSLX509WriteCachePtr cache);
+static void             xmlSecOpenSSLX509WriteCacheRelease      (xmlSecOpenSSLX509WriteCachePtr cache);
+static int              xmlSecOpenSSLX509WriteCacheGet          (xmlSecOpenSSLX509WriteCachePtr cache,
+                                                                 X509* cert,
+                                                                 int content,
+                                                                 int base64LineSize,
+                                                                 xmlSecOpenSSLX509WriteCacheEntryPtr res);
+
 /*************************************************************************
  *
  * Internal OpenSSL X509 data CTX
@@ -122,6 +167,7 @@ struct _xmlSecOpenSSLX509DataCtx {
     X509*               keyCert;
     STACK_OF(X509)*     certsList;
     STACK_OF(X509_CRL)* crlsList;
+    xmlSecOpenSSLX509WriteCachePtr writeCache;
 };
 
 /**************************************************************************
@@ -514,11 +560,20 @@ xmlSecOpenSSLKeyDataX509Initialize(xmlSecKeyDataPtr data) {
     xmlSecAssert2(ctx != NULL, -1);
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLX509DataCtx));
+
+    ctx->writeCache = xmlSecOpenSSLX509WriteCacheCreate();
+    if(ctx->writeCache == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509WriteCacheCreate",
+                            xmlSecKeyDataGetName(data));
+        return(-1);
+    }
     return(0);
 }
 
 static int
 xmlSecOpenSSLKeyDataX509Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
+    xmlSecOpenSSLX509DataCtxPtr ctxDst;
+    xmlSecOpenSSLX509DataCtxPtr ctxSrc;
     X509* certSrc;
     X509* certDst;
     X509_CRL* crlSrc;
@@ -540,12 +595,9 @@ xmlSecOpenSSLKeyDataX509Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
             return(-1);
         }
 
-        certDst = X509_dup(certSrc);
-        if(certDst == NULL) {
-            xmlSecOpenSSLError("X509_dup",
-                               xmlSecKeyDataGetName(dst));
-            return(-1);
-        }
+        /* certificates are never modified after load, share them */
+        X509_up_ref(certSrc);
+        certDst = certSrc;
 
         ret = xmlSecOpenSSLKeyDataX509AdoptCert(dst, certDst);
         if(ret < 0) {
@@ -567,12 +619,8 @@ xmlSecOpenSSLKeyDataX509Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
             return(-1);
         }
 
-        crlDst = X509_CRL_dup(crlSrc);
-        if(crlDst == NULL) {
-            xmlSecOpenSSLError("X509_CRL_dup",
-                               xmlSecKeyDataGetName(dst));
-            return(-1);
-        }
+        X509_CRL_up_ref(crlSrc);
+        crlDst = crlSrc;
 
         ret = xmlSecOpenSSLKeyDataX509AdoptCrl(dst, crlDst);
         if(ret < 0) {
@@ -586,12 +634,8 @@ xmlSecOpenSSLKeyDataX509Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
     /* copy key cert if exist */
     certSrc = xmlSecOpenSSLKeyDataX509GetKeyCert(src);
     if(certSrc != NULL) {
-        certDst = X509_dup(certSrc);
-        if(certDst == NULL) {
-            xmlSecOpenSSLError("X509_dup",
-                               xmlSecKeyDataGetName(dst));
-            return(-1);
-        }
+        X509_up_ref(certSrc);
+        certDst = certSrc;
         ret = xmlSecOpenSSLKeyDataX509AdoptKeyCert(dst, certDst);
         if(ret < 0) {
             xmlSecInternalError("xmlSecOpenSSLKeyDataX509AdoptKeyCert",
@@ -600,6 +644,18 @@ xmlSecOpenSSLKeyDataX509Duplicate(xmlSecKeyDataPtr dst, xmlSecKeyDataPtr src) {
             return(-1);
         }
     }
+
+    /* share the serialized certificates */
+    ctxDst = xmlSecOpenSSLX509DataGetCtx(dst);
+    xmlSecAssert2(ctxDst != NULL, -1);
+    ctxSrc = xmlSecOpenSSLX509DataGetCtx(src);
+    xmlSecAssert2(ctxSrc != NULL, -1);
+    xmlSecAssert2(ctxSrc->writeCache != NULL, -1);
+
+    if(ctxDst->writeCache != NULL) {
+        xmlSecOpenSSLX509WriteCacheRelease(ctxDst->writeCache);
+    }
+    ctxDst->writeCache = xmlSecOpenSSLX509WriteCacheRef(ctxSrc->writeCache);
     return(0);
 }
 
@@ -621,6 +677,9 @@ xmlSecOpenSSLKeyDataX509Finalize(xmlSecKeyDataPtr data) {
     if(ctx->keyCert != NULL) {
         X509_free(ctx->keyCert);
     }
+    if(ctx->writeCache != NULL) {
+        xmlSecOpenSSLX509WriteCacheRelease(ctx->writeCache);
+    }
     memset(ctx, 0, sizeof(xmlSecOpenSSLX509DataCtx));
 }
 
@@ -649,6 +708,13 @@ xmlSecOpenSSLKeyDataX509XmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
         return(-1);
     }
 
+    ret = xmlSecOpenSSLX509DataCrlNodesRead(data, key, node, keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509DataCrlNodesRead",
+                            xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+
     ret = xmlSecOpenSSLKeyDataX509VerifyAndExtractKey(data, key, keyInfoCtx);
     if(ret < 0) {
         xmlSecInternalError("xmlSecOpenSSLKeyDataX509VerifyAndExtractKey",
@@ -662,6 +728,8 @@ static int
 xmlSecOpenSSLKeyDataX509XmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key,
                                 xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
     xmlSecKeyDataPtr data;
+    xmlSecOpenSSLX509DataCtxPtr ctx;
+    xmlSecOpenSSLX509WriteCacheEntry entry;
     X509* cert;
     X509_CRL* crl;
     xmlSecSize size, pos;
@@ -690,6 +758,9 @@ xmlSecOpenSSLKeyDataX509XmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key,
         /* no x509 data in the key */
         return(0);
     }
+    ctx = xmlSecOpenSSLX509DataGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->writeCache != NULL, -1);
 
     /* write certs */
     size = xmlSecOpenSSLKeyDataX509GetCertsSize(data);
@@ -702,8 +773,17 @@ xmlSecOpenSSLKeyDataX509XmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key,
             return(-1);
         }
 
+        ret = xmlSecOpenSSLX509WriteCacheGet(ctx->writeCache, cert, content,
+                                             keyInfoCtx->base64LineSize, &entry);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecOpenSSLX509WriteCacheGet",
+                                 xmlSecKeyDataKlassGetName(id),
+                                 "pos=" XMLSEC_SIZE_FMT, pos);
+            return(-1);
+        }
+
         if((content & XMLSEC_X509DATA_CERTIFICATE_NODE) != 0) {
-            ret = xmlSecOpenSSLX509CertificateNodeWrite(cert, node, keyInfoCtx);
+            ret = xmlSecOpenSSLX509CertificateNodeWrite(entry.certBase64, node);
             if(ret < 0) {
                 xmlSecInternalError2("xmlSecOpenSSLX509CertificateNodeWrite",
                                      xmlSecKeyDataKlassGetName(id),
@@ -713,7 +793,7 @@ xmlSecOpenSSLKeyDataX509XmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key,
         }
 
         if((content & XMLSEC_X509DATA_SUBJECTNAME_NODE) != 0) {
-            ret = xmlSecOpenSSLX509SubjectNameNodeWrite(cert, node, keyInfoCtx);
+            ret = xmlSecOpenSSLX509SubjectNameNodeWrite(entry.subjectName, node);
             if(ret < 0) {
                 xmlSecInternalError2("xmlSecOpenSSLX509SubjectNameNodeWrite",
                                      xmlSecKeyDataKlassGetName(id),
@@ -723,7 +803,8 @@ xmlSecOpenSSLKeyDataX509XmlWrite(xmlSecKeyDataId id, xmlSecKeyPtr key,
         }
 
         if((content & XMLSEC_X509DATA_ISSUERSERIAL_NODE) != 0) {
-            ret = xmlSecOpenSSLX509IssuerSerialNodeWrite(cert, node, keyInfoCtx);
+            ret = xmlSecOpenSSLX509IssuerSerialNodeWrite(entry.issuerName,
+                                                         entry.issuerSerial, node);
             if(ret < 0) {
                 xmlSecInternalError2("xmlSecOpenSSLX509IssuerSerialNodeWrite",
                                      xmlSecKeyDataKlassGetName(id),
@@ -897,13 +978,7 @@ xmlSecOpenSSLX509DataNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyI
                 return(-1);
             }
         } else if(xmlSecCheckNodeName(cur, xmlSecNodeX509CRL, xmlSecDSigNs)) {
-            ret = xmlSecOpenSSLX509CRLNodeRead(data, cur, keyInfoCtx);
-            if(ret < 0) {
-                xmlSecInternalError2("xmlSecOpenSSLX509CRLNodeRead",
-                                     xmlSecKeyDataGetName(data),
-                                     "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
-                return(-1);
-            }
+            /* CRLs are read after all the certificates, see xmlSecOpenSSLX509DataCrlNodesRead() */
         } else if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_STOP_ON_UNKNOWN_CHILD) != 0) {
             /* laxi schema validation: ignore unknown nodes */
             xmlSecUnexpectedNodeError(cur, xmlSecKeyDataGetName(data));
@@ -915,6 +990,7 @@ xmlSecOpenSSLX509DataNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyI
 
 static int
 xmlSecOpenSSLX509CertificateNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecKeyDataStorePtr x509Store = NULL;
     xmlChar *content;
     X509* cert;
     int ret;
@@ -935,12 +1011,35 @@ xmlSecOpenSSLX509CertificateNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xml
         return(0);
     }
 
-    cert = xmlSecOpenSSLX509CertBase64DerRead(content);
-    if(cert == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509CertBase64DerRead",
-                            xmlSecKeyDataGetName(data));
-        xmlFree(content);
-        return(-1);
+    if(keyInfoCtx->keysMngr != NULL) {
+        x509Store = xmlSecKeysMngrGetDataStore(keyInfoCtx->keysMngr, xmlSecOpenSSLX509StoreId);
+    }
+    if(x509Store != NULL) {
+        /* usual trick with base64 decoding "in-place" */
+        ret = xmlSecBase64Decode(content, (xmlSecByte*)content, xmlStrlen(content));
+        if(ret <= 0) {
+            xmlSecInternalError("xmlSecBase64Decode",
+                                xmlSecKeyDataGetName(data));
+            xmlFree(content);
+            return(-1);
+        }
+
+        /* the store caches the recently parsed certs */
+        cert = xmlSecOpenSSLX509StoreCertDerRead(x509Store, (xmlSecByte*)content, ret);
+        if(cert == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreCertDerRead",
+                                xmlSecKeyDataGetName(data));
+            xmlFree(content);
+            return(-1);
+        }
+    } else {
+        cert = xmlSecOpenSSLX509CertBase64DerRead(content);
+        if(cert == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509CertBase64DerRead",
+                                xmlSecKeyDataGetName(data));
+            xmlFree(content);
+            return(-1);
+        }
     }
 
     ret = xmlSecOpenSSLKeyDataX509AdoptCert(data, cert);
@@ -957,25 +1056,15 @@ xmlSecOpenSSLX509CertificateNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xml
 }
 
 static int
-xmlSecOpenSSLX509CertificateNodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
-    xmlChar* buf;
+xmlSecOpenSSLX509CertificateNodeWrite(const xmlChar* buf, xmlNodePtr node) {
     xmlNodePtr cur;
 
-    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
-    xmlSecAssert2(keyInfoCtx != NULL, -1);
-
-    /* set base64 lines size from context */
-    buf = xmlSecOpenSSLX509CertBase64DerWrite(cert, keyInfoCtx->base64LineSize);
-    if(buf == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509CertBase64DerWrite", NULL);
-        return(-1);
-    }
 
     cur = xmlSecEnsureEmptyChild(node, xmlSecNodeX509Certificate, xmlSecDSigNs);
     if(cur == NULL) {
         xmlSecInternalError("xmlSecEnsureEmptyChild(xmlSecNodeX509Certificate)", NULL);
-        xmlFree(buf);
         return(-1);
     }
 
@@ -983,7 +1072,6 @@ xmlSecOpenSSLX509CertificateNodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInfo
     /* todo: add errors check */
     xmlNodeSetContent(cur, xmlSecGetDefaultLineFeed());
     xmlNodeSetContent(cur, buf);
-    xmlFree(buf);
     return(0);
 }
 
@@ -1033,13 +1121,8 @@ xmlSecOpenSSLX509SubjectNameNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xml
         return(0);
     }
 
-    cert2 = X509_dup(cert);
-    if(cert2 == NULL) {
-        xmlSecOpenSSLError("X509_dup",
-                           xmlSecKeyDataGetName(data));
-        xmlFree(subject);
-        return(-1);
-    }
+    X509_up_ref(cert);
+    cert2 = cert;
 
     ret = xmlSecOpenSSLKeyDataX509AdoptCert(data, cert2);
     if(ret < 0) {
@@ -1055,36 +1138,26 @@ xmlSecOpenSSLX509SubjectNameNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xml
 }
 
 static int
-xmlSecOpenSSLX509SubjectNameNodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx ATTRIBUTE_UNUSED) {
-    xmlChar* buf = NULL;
+xmlSecOpenSSLX509SubjectNameNodeWrite(const xmlChar* subject, xmlNodePtr node) {
     xmlNodePtr cur = NULL;
     int ret;
 
-    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(subject != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
-    buf = xmlSecOpenSSLX509NameWrite(X509_get_subject_name(cert));
-    if(buf == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509NameWrite(X509_get_subject_name)", NULL);
-        return(-1);
-    }
-
     cur = xmlSecEnsureEmptyChild(node, xmlSecNodeX509SubjectName, xmlSecDSigNs);
     if(cur == NULL) {
         xmlSecInternalError("xmlSecEnsureEmptyChild(xmlSecNodeX509SubjectName)", NULL);
-        xmlFree(buf);
         return(-1);
     }
 
-    ret = xmlSecNodeEncodeAndSetContent(cur, buf);
+    ret = xmlSecNodeEncodeAndSetContent(cur, subject);
     if(ret < 0) {
         xmlSecInternalError("xmlSecNodeEncodeAndSetContent", NULL);
-        xmlFree(buf);
         return(-1);
     }
 
     /* done */
-    xmlFree(buf);
     return(0);
 }
 
@@ -1170,14 +1243,8 @@ xmlSecOpenSSLX509IssuerSerialNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xm
         return(0);
     }
 
-    cert2 = X509_dup(cert);
-    if(cert2 == NULL) {
-        xmlSecOpenSSLError("X509_dup",
-                           xmlSecKeyDataGetName(data));
-        xmlFree(issuerSerial);
-        xmlFree(issuerName);
-        return(-1);
-    }
+    X509_up_ref(cert);
+    cert2 = cert;
 
     ret = xmlSecOpenSSLKeyDataX509AdoptCert(data, cert2);
     if(ret < 0) {
@@ -1195,14 +1262,14 @@ xmlSecOpenSSLX509IssuerSerialNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xm
 }
 
 static int
-xmlSecOpenSSLX509IssuerSerialNodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx ATTRIBUTE_UNUSED) {
+xmlSecOpenSSLX509IssuerSerialNodeWrite(const xmlChar* issuerName, const xmlChar* issuerSerial, xmlNodePtr node) {
     xmlNodePtr cur;
     xmlNodePtr issuerNameNode;
     xmlNodePtr issuerNumberNode;
-    xmlChar* buf;
     int ret;
 
-    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(issuerName != NULL, -1);
+    xmlSecAssert2(issuerSerial != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
     /* create xml nodes */
@@ -1225,35 +1292,19 @@ xmlSecOpenSSLX509IssuerSerialNodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInf
     }
 
     /* write data */
-    buf = xmlSecOpenSSLX509NameWrite(X509_get_issuer_name(cert));
-    if(buf == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509NameWrite(X509_get_issuer_name)", NULL);
-        return(-1);
-    }
-
-    ret = xmlSecNodeEncodeAndSetContent(issuerNameNode, buf);
+    ret = xmlSecNodeEncodeAndSetContent(issuerNameNode, issuerName);
     if(ret < 0) {
         xmlSecInternalError("xmlSecNodeEncodeAndSetContent(issuerNameNode)", NULL);
-        xmlFree(buf);
-        return(-1);
-    }
-    xmlFree(buf);
-
-    buf = xmlSecOpenSSLASN1IntegerWrite(X509_get_serialNumber(cert));
-    if(buf == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLASN1IntegerWrite(X509_get_serialNumber)", NULL);
         return(-1);
     }
 
-    ret = xmlSecNodeEncodeAndSetContent(issuerNumberNode, buf);
+    ret = xmlSecNodeEncodeAndSetContent(issuerNumberNode, issuerSerial);
     if(ret < 0) {
         xmlSecInternalError("xmlSecNodeEncodeAndSetContent(issuerNumberNode)", NULL);
-        xmlFree(buf);
         return(-1);
     }
 
     /* done */
-    xmlFree(buf);
     return(0);
 }
 
@@ -1302,13 +1353,8 @@ xmlSecOpenSSLX509SKINodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyIn
         return(0);
     }
 
-    cert2 = X509_dup(cert);
-    if(cert2 == NULL) {
-        xmlSecOpenSSLError("X509_dup",
-                           xmlSecKeyDataGetName(data));
-        xmlFree(ski);
-        return(-1);
-    }
+    X509_up_ref(cert);
+    cert2 = cert;
 
     ret = xmlSecOpenSSLKeyDataX509AdoptCert(data, cert2);
     if(ret < 0) {
@@ -1357,10 +1403,70 @@ xmlSecOpenSSLX509SKINodeWrite(X509* cert, xmlNodePtr node, xmlSecKeyInfoCtxPtr k
     return(0);
 }
 
+/*
+ * The CRLs are only used to check the certificates from the same X509Data
+ * (or the store's untrusted certificates) during the verification. Most of
+ * the time the key is already known or the CRLs are for other issuers, so
+ * the CRLs are only parsed if the verification is going to happen and the
+ * CRL issuer (found without parsing the whole CRL) issued one of these
+ * certificates.
+ */
+static int
+xmlSecOpenSSLX509DataCrlNodesRead(xmlSecKeyDataPtr data, xmlSecKeyPtr key, xmlNodePtr node,
+                                  xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecOpenSSLX509DataCtxPtr ctx;
+    xmlSecKeyDataStorePtr x509Store = NULL;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataX509Id), -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+
+    ctx = xmlSecOpenSSLX509DataGetCtx(data);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    for(cur = xmlSecGetNextElementNode(node->children);
+        cur != NULL;
+        cur = xmlSecGetNextElementNode(cur->next)) {
+
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeX509CRL, xmlSecDSigNs)) {
+            continue;
+        }
+
+        /* see xmlSecOpenSSLKeyDataX509VerifyAndExtractKey() */
+        if((ctx->keyCert != NULL) || (ctx->certsList == NULL) || (xmlSecKeyGetValue(key) != NULL)) {
+            if(((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_STOP_ON_EMPTY_NODE) != 0) && (xmlSecIsEmptyNode(cur) == 1)) {
+                xmlSecInvalidNodeContentError(cur, xmlSecKeyDataGetName(data), "empty");
+                return(-1);
+            }
+            continue;
+        }
+
+        if((x509Store == NULL) && (keyInfoCtx->keysMngr != NULL)) {
+            x509Store = xmlSecKeysMngrGetDataStore(keyInfoCtx->keysMngr, xmlSecOpenSSLX509StoreId);
+        }
+
+        ret = xmlSecOpenSSLX509CRLNodeRead(data, cur, x509Store, keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecOpenSSLX509CRLNodeRead",
+                                 xmlSecKeyDataGetName(data),
+                                 "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
 static int
-xmlSecOpenSSLX509CRLNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+xmlSecOpenSSLX509CRLNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyDataStorePtr x509Store,
+                             xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecOpenSSLX509DataCtxPtr ctx;
     xmlChar *content;
+    X509_NAME* issuer;
     X509_CRL* crl;
+    xmlSecSize size;
     int ret;
 
     xmlSecAssert2(xmlSecKeyDataCheckId(data, xmlSecOpenSSLKeyDataX509Id), -1);
@@ -1379,9 +1485,36 @@ xmlSecOpenSSLX509CRLNodeRead(xmlSecKeyDataPtr data, xmlNodePtr node, xmlSecKeyIn
         return(0);
     }
 
-    crl = xmlSecOpenSSLX509CrlBase64DerRead(content);
+    /* usual trick with base64 decoding "in-place" */
+    ret = xmlSecBase64Decode(content, (xmlSecByte*)content, xmlStrlen(content));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64Decode",
+                            xmlSecKeyDataGetName(data));
+        xmlFree(content);
+        return(-1);
+    }
+    size = ret;
+
+    /* skip the CRLs for other issuers; if the issuer can't be found then
+     * the CRL is parsed (and the error is reported) below */
+    if(x509Store != NULL) {
+        ctx = xmlSecOpenSSLX509DataGetCtx(data);
+        xmlSecAssert2(ctx != NULL, -1);
+
+        issuer = xmlSecOpenSSLX509CrlDerReadIssuer((xmlSecByte*)content, size);
+        if(issuer != NULL) {
+            ret = xmlSecOpenSSLX509StoreIsCrlNeeded(x509Store, ctx->certsList, issuer);
+            X509_NAME_free(issuer);
+            if(ret == 0) {
+                xmlFree(content);
+                return(0);
+            }
+        }
+    }
+
+    crl = xmlSecOpenSSLX509CrlDerRead((xmlSecByte*)content, size);
     if(crl == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509CrlBase64DerRead",
+        xmlSecInternalError("xmlSecOpenSSLX509CrlDerRead",
                             xmlSecKeyDataGetName(data));
         xmlFree(content);
         return(-1);
@@ -1455,17 +1588,16 @@ xmlSecOpenSSLKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data, xmlSecKeyPtr
 
     if((ctx->keyCert == NULL) && (ctx->certsList != NULL) && (xmlSecKeyGetValue(key) == NULL)) {
         X509* cert;
+        void* span;
 
+        span = xmlSecTraceBegin(xmlSecTracePhaseX509Verify, NULL, keyInfoCtx->userData);
         cert = xmlSecOpenSSLX509StoreVerify(x509Store, ctx->certsList, ctx->crlsList, keyInfoCtx);
+        xmlSecTraceEnd(span, xmlSecTracePhaseX509Verify, (cert != NULL) ? 0 : -1);
         if(cert != NULL) {
             xmlSecKeyDataPtr keyValue;
 
-            ctx->keyCert = X509_dup(cert);
-            if(ctx->keyCert == NULL) {
-                xmlSecOpenSSLError("X509_dup",
-                                   xmlSecKeyDataGetName(data));
-                return(-1);
-            }
+            X509_up_ref(cert);
+            ctx->keyCert = cert;
 
             keyValue = xmlSecOpenSSLX509CertGetKey(ctx->keyCert);
             if(keyValue == NULL) {
@@ -1705,6 +1837,174 @@ xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
     return(cert);
 }
 
+#define XMLSEC_OPENSSL_X509_WRITE_CACHE_SIZE     4
+
+static xmlSecOpenSSLX509WriteCachePtr
+xmlSecOpenSSLX509WriteCacheCreate(void) {
+    xmlSecOpenSSLX509WriteCachePtr cache;
+
+    cache = (xmlSecOpenSSLX509WriteCachePtr)xmlMalloc(sizeof(xmlSecOpenSSLX509WriteCache));
+    if(cache == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509WriteCache), NULL);
+        return(NULL);
+    }
+    memset(cache, 0, sizeof(xmlSecOpenSSLX509WriteCache));
+
+    cache->mutex = xmlNewMutex();
+    if(cache->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlFree(cache);
+        return(NULL);
+    }
+    cache->refs = 1;
+    return(cache);
+}
+
+static xmlSecOpenSSLX509WriteCachePtr
+xmlSecOpenSSLX509WriteCacheRef(xmlSecOpenSSLX509WriteCachePtr cache) {
+    xmlSecAssert2(cache != NULL, NULL);
+    xmlSecAssert2(cache->mutex != NULL, NULL);
+
+    xmlMutexLock(cache->mutex);
+    ++cache->refs;
+    xmlMutexUnlock(cache->mutex);
+    return(cache);
+}
+
+static void
+xmlSecOpenSSLX509WriteCacheRelease(xmlSecOpenSSLX509WriteCachePtr cache) {
+    xmlSecOpenSSLX509WriteCacheEntryPtr entry;
+    xmlSecSize pos;
+    int refs;
+
+    xmlSecAssert(cache != NULL);
+    xmlSecAssert(cache->mutex != NULL);
+
+    xmlMutexLock(cache->mutex);
+    refs = --cache->refs;
+    xmlMutexUnlock(cache->mutex);
+    if(refs > 0) {
+        return;
+    }
+
+    for(pos = 0; pos < cache->entriesSize; ++pos) {
+        entry = &(cache->entries[pos]);
+        X509_free(entry->cert);
+        if(entry->certBase64 != NULL) {
+            xmlFree(entry->certBase64);
+        }
+        if(entry->subjectName != NULL) {
+            xmlFree(entry->subjectName);
+        }
+        if(entry->issuerName != NULL) {
+            xmlFree(entry->issuerName);
+        }
+        if(entry->issuerSerial != NULL) {
+            xmlFree(entry->issuerSerial);
+        }
+    }
+    if(cache->entries != NULL) {
+        xmlFree(cache->entries);
+    }
+    xmlFreeMutex(cache->mutex);
+    xmlFree(cache);
+}
+
+/* the cache mutex is locked by the caller */
+static xmlSecOpenSSLX509WriteCacheEntryPtr
+xmlSecOpenSSLX509WriteCacheEnsureEntry(xmlSecOpenSSLX509WriteCachePtr cache, X509* cert, int base64LineSize) {
+    xmlSecOpenSSLX509WriteCacheEntryPtr entry;
+    xmlSecOpenSSLX509WriteCacheEntryPtr newEntries;
+    xmlSecSize newSize;
+    xmlSecSize pos;
+
+    xmlSecAssert2(cache != NULL, NULL);
+    xmlSecAssert2(cert != NULL, NULL);
+
+    for(pos = 0; pos < cache->entriesSize; ++pos) {
+        entry = &(cache->entries[pos]);
+        if((entry->cert == cert) && (entry->base64LineSize == base64LineSize)) {
+            return(entry);
+        }
+    }
+
+    if(cache->entriesSize >= cache->entriesMaxSize) {
+        newSize = (cache->entriesMaxSize > 0) ? (2 * cache->entriesMaxSize) : XMLSEC_OPENSSL_X509_WRITE_CACHE_SIZE;
+        newEntries = (xmlSecOpenSSLX509WriteCacheEntryPtr)xmlRealloc(cache->entries, newSize * sizeof(xmlSecOpenSSLX509WriteCacheEntry));
+        if(newEntries == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecOpenSSLX509WriteCacheEntry), NULL);
+            return(NULL);
+        }
+        cache->entries = newEntries;
+        cache->entriesMaxSize = newSize;
+    }
+
+    entry = &(cache->entries[cache->entriesSize++]);
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509WriteCacheEntry));
+    X509_up_ref(cert);
+    entry->cert = cert;
+    entry->base64LineSize = base64LineSize;
+    return(entry);
+}
+
+static int
+xmlSecOpenSSLX509WriteCacheGet(xmlSecOpenSSLX509WriteCachePtr cache, X509* cert,
+                               int content, int base64LineSize,
+                               xmlSecOpenSSLX509WriteCacheEntryPtr res) {
+    xmlSecOpenSSLX509WriteCacheEntryPtr entry;
+
+    xmlSecAssert2(cache != NULL, -1);
+    xmlSecAssert2(cache->mutex != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(res != NULL, -1);
+
+    xmlMutexLock(cache->mutex);
+    entry = xmlSecOpenSSLX509WriteCacheEnsureEntry(cache, cert, base64LineSize);
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509WriteCacheEnsureEntry", NULL);
+        xmlMutexUnlock(cache->mutex);
+        return(-1);
+    }
+
+    if(((content & XMLSEC_X509DATA_CERTIFICATE_NODE) != 0) && (entry->certBase64 == NULL)) {
+        entry->certBase64 = xmlSecOpenSSLX509CertBase64DerWrite(cert, base64LineSize);
+        if(entry->certBase64 == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509CertBase64DerWrite", NULL);
+            xmlMutexUnlock(cache->mutex);
+            return(-1);
+        }
+    }
+    if(((content & XMLSEC_X509DATA_SUBJECTNAME_NODE) != 0) && (entry->subjectName == NULL)) {
+        entry->subjectName = xmlSecOpenSSLX509NameWrite(X509_get_subject_name(cert));
+        if(entry->subjectName == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509NameWrite(X509_get_subject_name)", NULL);
+            xmlMutexUnlock(cache->mutex);
+            return(-1);
+        }
+    }
+    if(((content & XMLSEC_X509DATA_ISSUERSERIAL_NODE) != 0) && (entry->issuerName == NULL)) {
+        entry->issuerName = xmlSecOpenSSLX509NameWrite(X509_get_issuer_name(cert));
+        if(entry->issuerName == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLX509NameWrite(X509_get_issuer_name)", NULL);
+            xmlMutexUnlock(cache->mutex);
+            return(-1);
+        }
+    }
+    if(((content & XMLSEC_X509DATA_ISSUERSERIAL_NODE) != 0) && (entry->issuerSerial == NULL)) {
+        entry->issuerSerial = xmlSecOpenSSLASN1IntegerWrite(X509_get_serialNumber(cert));
+        if(entry->issuerSerial == NULL) {
+            xmlSecInternalError("xmlSecOpenSSLASN1IntegerWrite(X509_get_serialNumber)", NULL);
+            xmlMutexUnlock(cache->mutex);
+            return(-1);
+        }
+    }
+
+    /* the strings are owned by the cache and never change once set */
+    (*res) = (*entry);
+    xmlMutexUnlock(cache->mutex);
+    return(0);
+}
+
 static xmlChar*
 xmlSecOpenSSLX509CertBase64DerWrite(X509* cert, int base64LineWrap) {
     xmlChar *res = NULL;
@@ -1742,22 +2042,6 @@ xmlSecOpenSSLX509CertBase64DerWrite(X509* cert, int base64LineWrap) {
     return(res);
 }
 
-static X509_CRL*
-xmlSecOpenSSLX509CrlBase64DerRead(xmlChar* buf) {
-    int ret;
-
-    xmlSecAssert2(buf != NULL, NULL);
-
-    /* usual trick with base64 decoding "in-place" */
-    ret = xmlSecBase64Decode(buf, (xmlSecByte*)buf, xmlStrlen(buf));
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecBase64Decode", NULL);
-        return(NULL);
-    }
-
-    return(xmlSecOpenSSLX509CrlDerRead((xmlSecByte*)buf, ret));
-}
-
 static X509_CRL*
 xmlSecOpenSSLX509CrlDerRead(xmlSecByte* buf, xmlSecSize size) {
     X509_CRL *crl = NULL;
@@ -1792,6 +2076,66 @@ xmlSecOpenSSLX509CrlDerRead(xmlSecByte* buf, xmlSecSize size) {
     return(crl);
 }
 
+/*
+ * Finds the issuer name in the CRL DER without parsing the (possibly very
+ * long) revoked certificates list:
+ *
+ *   CertificateList ::= SEQUENCE {
+ *      tbsCertList          TBSCertList,
+ *      ...
+ *   }
+ *   TBSCertList ::= SEQUENCE {
+ *      version              Version OPTIONAL,
+ *      signature            AlgorithmIdentifier,
+ *      issuer               Name,
+ *      ...
+ *   }
+ */
+static X509_NAME*
+xmlSecOpenSSLX509CrlDerReadIssuer(const xmlSecByte* buf, xmlSecSize size) {
+    const unsigned char* p;
+    const unsigned char* q;
+    long len;
+    int tag, xclass, ret;
+
+    xmlSecAssert2(buf != NULL, NULL);
+
+    /* CertificateList and TBSCertList */
+    p = buf;
+    ret = ASN1_get_object(&p, &len, &tag, &xclass, (long)size);
+    if(((ret & 0x80) != 0) || (tag != V_ASN1_SEQUENCE)) {
+        return(NULL);
+    }
+    ret = ASN1_get_object(&p, &len, &tag, &xclass, (long)size - (p - buf));
+    if(((ret & 0x80) != 0) || (tag != V_ASN1_SEQUENCE)) {
+        return(NULL);
+    }
+
+    /* optional version */
+    q = p;
+    ret = ASN1_get_object(&q, &len, &tag, &xclass, (long)size - (p - buf));
+    if((ret & 0x80) != 0) {
+        return(NULL);
+    }
+    if(tag == V_ASN1_INTEGER) {
+        p = q + len;
+        q = p;
+        ret = ASN1_get_object(&q, &len, &tag, &xclass, (long)size - (p - buf));
+        if((ret & 0x80) != 0) {
+            return(NULL);
+        }
+    }
+
+    /* signature */
+    if(tag != V_ASN1_SEQUENCE) {
+        return(NULL);
+    }
+    p = q + len;
+
+    /* issuer */
+    return(d2i_X509_NAME(NULL, &p, (long)size - (p - buf)));
+}
+
 static xmlChar*
 xmlSecOpenSSLX509CrlBase64DerWrite(X509_CRL* crl, int base64LineWrap) {
     xmlChar *res = NULL;
@@ -0,0 +1,43 @@
+/*
+ * XML Security Library
+ *
+ * THIS IS A PRIVATE XMLSEC HEADER FILE
+ * DON'T USE IT IN YOUR APPLICATION
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_OPENSSL_X509UTILS_H__
+#define __XMLSEC_OPENSSL_X509UTILS_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "openssl/x509utils.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifndef XMLSEC_NO_X509
+
+/**************************************************************************
+ *
+ * X509 store internals
+ *
+ *****************************************************************************/
+X509*                   xmlSecOpenSSLX509StoreCertDerRead       (xmlSecKeyDataStorePtr store,
+                                                                 const xmlSecByte* buf,
+                                                                 xmlSecSize size);
+int                     xmlSecOpenSSLX509StoreIsCrlNeeded       (xmlSecKeyDataStorePtr store,
+                                                                 XMLSEC_STACK_OF_X509* certs,
+                                                                 X509_NAME* crlIssuer);
+
+#endif /* XMLSEC_NO_X509 */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_OPENSSL_X509UTILS_H__ */
@@ -18,38 +18,231 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <libxml/tree.h>
+#include <libxml/threads.h>
+#include <libxml/hash.h>
 #include <openssl/evp.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/x509v3.h>
+#include <openssl/rand.h>
+#ifndef OPENSSL_NO_OCSP
+#include <openssl/ocsp.h>
+#endif /* OPENSSL_NO_OCSP */
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/keysmngr.h>
+#include <xmlsec/transforms.h>
 #include <xmlsec/base64.h>
+#include <xmlsec/metrics.h>
+#include <xmlsec/sharedcache.h>
 #include <xmlsec/errors.h>
 
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include <xmlsec/openssl/x509.h>
 #include "openssl_compat.h"
+#include "x509utils.h"
 
 /**************************************************************************
  *
  * Internal OpenSSL X509 store CTX
  *
  *************************************************************************/
+/**
+ * XMLSEC_OPENSSL_X509_VERIFY_CACHE_SIZE:
+ *
+ * The max number of successful certificate verification results
+ * remembered by the OpenSSL X509 store.
+ */
+#define XMLSEC_OPENSSL_X509_VERIFY_CACHE_SIZE                   64
+
+/*
+ * The verified certificates cache entry: the signer certificate fingerprint,
+ * the fingerprint of the untrusted certificates set used to build the chain
+ * (after the revoked certificates were removed), the verification depth and
+ * the verified chain itself (used to check the validity window on lookup).
+ * The cache is flushed every time trusted certs or CRLs in the store change.
+ */
+typedef struct _xmlSecOpenSSLX509VerifyCacheEntry       xmlSecOpenSSLX509VerifyCacheEntry,
+                                                        *xmlSecOpenSSLX509VerifyCacheEntryPtr;
+struct _xmlSecOpenSSLX509VerifyCacheEntry {
+    unsigned char                       certMd[EVP_MAX_MD_SIZE];
+    unsigned char                       certsMd[EVP_MAX_MD_SIZE];
+    int                                 depth;
+    STACK_OF(X509)*                     chain;
+    xmlSecOpenSSLX509VerifyCacheEntryPtr prev;
+    xmlSecOpenSSLX509VerifyCacheEntryPtr next;
+};
+
+/**
+ * XMLSEC_OPENSSL_X509_CERTS_CACHE_SIZE:
+ *
+ * The max number of parsed certificates remembered by the OpenSSL X509 store.
+ */
+#define XMLSEC_OPENSSL_X509_CERTS_CACHE_SIZE                    256
+
+/*
+ * The parsed certificates cache entry: the certificate DER (the key is
+ * a hash of it, the DER itself is compared on lookup) and the parsed cert.
+ */
+typedef struct _xmlSecOpenSSLX509CertsCacheEntry        xmlSecOpenSSLX509CertsCacheEntry,
+                                                        *xmlSecOpenSSLX509CertsCacheEntryPtr;
+struct _xmlSecOpenSSLX509CertsCacheEntry {
+    xmlChar                             key[32];
+    xmlSecByte*                         der;
+    xmlSecSize                          derSize;
+    X509*                               cert;
+    xmlSecOpenSSLX509CertsCacheEntryPtr prev;
+    xmlSecOpenSSLX509CertsCacheEntryPtr next;
+};
+
+/**
+ * XMLSEC_OPENSSL_X509_VERIFIED_CRLS_CACHE_SIZE:
+ *
+ * The max number of CRLs (from the signed documents) which signatures
+ * were verified and remembered by the OpenSSL X509 store.
+ */
+#define XMLSEC_OPENSSL_X509_VERIFIED_CRLS_CACHE_SIZE            32
+
+/**
+ * XMLSEC_OPENSSL_X509_NAMES_CACHE_SIZE:
+ *
+ * The max number of parsed <dsig:X509SubjectName/> and <dsig:X509IssuerName/>
+ * strings remembered by the OpenSSL X509 store.
+ */
+#define XMLSEC_OPENSSL_X509_NAMES_CACHE_SIZE                    64
+
+/*
+ * The parsed names cache entry: the name string from the signed document
+ * and the name part of the certs index key built from it.
+ */
+typedef struct _xmlSecOpenSSLX509NamesCacheEntry        xmlSecOpenSSLX509NamesCacheEntry,
+                                                        *xmlSecOpenSSLX509NamesCacheEntryPtr;
+struct _xmlSecOpenSSLX509NamesCacheEntry {
+    xmlChar*                            name;
+    xmlChar*                            nameKey;
+    xmlSecOpenSSLX509NamesCacheEntryPtr prev;
+    xmlSecOpenSSLX509NamesCacheEntryPtr next;
+};
+
+#ifndef OPENSSL_NO_OCSP
+/**
+ * XMLSEC_OPENSSL_X509_OCSP_CACHE_SIZE:
+ *
+ * The max number of OCSP responses (added to the store or fetched from
+ * the responders) remembered by the OpenSSL X509 store.
+ */
+#define XMLSEC_OPENSSL_X509_OCSP_CACHE_SIZE                     128
+
+/**
+ * XMLSEC_OPENSSL_X509_OCSP_LEEWAY:
+ *
+ * The allowed clock skew (in seconds) when checking the OCSP response
+ * validity period.
+ */
+#define XMLSEC_OPENSSL_X509_OCSP_LEEWAY                         300
+
+/*
+ * The OCSP responses cache entry: the response is used until its nextUpdate
+ * time, the response signature is verified once (until the trusted certs
+ * in the store change).
+ */
+typedef struct _xmlSecOpenSSLX509OcspCacheEntry         xmlSecOpenSSLX509OcspCacheEntry,
+                                                        *xmlSecOpenSSLX509OcspCacheEntryPtr;
+struct _xmlSecOpenSSLX509OcspCacheEntry {
+    OCSP_BASICRESP*                     bs;
+    int                                 verified;
+    xmlSecOpenSSLX509OcspCacheEntryPtr  prev;
+    xmlSecOpenSSLX509OcspCacheEntryPtr  next;
+};
+#endif /* OPENSSL_NO_OCSP */
+
+/*
+ * The certs folder (c_rehash layout) or file added to the store: the certs
+ * from the folders are loaded by OpenSSL on demand (by subject hash), the
+ * modification time is checked by xmlSecOpenSSLX509StoreReloadCertsPaths().
+ */
+typedef struct _xmlSecOpenSSLX509CertsPath              xmlSecOpenSSLX509CertsPath,
+                                                        *xmlSecOpenSSLX509CertsPathPtr;
+struct _xmlSecOpenSSLX509CertsPath {
+    char*                               path;
+    int                                 isFile;
+    time_t                              mtime;
+    xmlSecOpenSSLX509CertsPathPtr       next;
+};
+
+/*
+ * The issuer name hashes of the untrusted certificates sorted by the hash:
+ * built once per verification to find the certs issued by the given cert.
+ */
+typedef struct _xmlSecOpenSSLX509IssuerHash             xmlSecOpenSSLX509IssuerHash,
+                                                        *xmlSecOpenSSLX509IssuerHashPtr;
+struct _xmlSecOpenSSLX509IssuerHash {
+    unsigned long                       hash;
+    X509*                               cert;
+};
+
 typedef struct _xmlSecOpenSSLX509StoreCtx               xmlSecOpenSSLX509StoreCtx,
                                                         *xmlSecOpenSSLX509StoreCtxPtr;
 struct _xmlSecOpenSSLX509StoreCtx {
     X509_STORE*         xst;
+    STACK_OF(X509)*     trusted;        /* the adopted trusted certs (to re-create xst) */
     STACK_OF(X509)*     untrusted;
     STACK_OF(X509_CRL)* crls;
     X509_VERIFY_PARAM * vpm;
+
+    /* untrusted certs lookup by subject, issuer/serial and ski */
+    xmlHashTablePtr     untrustedIndex;
+
+    /* crls lookup by issuer */
+    xmlHashTablePtr     crlsIndex;
+
+    /* verified certificates cache */
+    xmlSecOpenSSLX509VerifyCacheEntryPtr cacheHead;
+    xmlSecOpenSSLX509VerifyCacheEntryPtr cacheTail;
+    xmlSecSize                            cacheSize;
+    xmlMutexPtr                           cacheMutex;
+
+    /* random id of the trusted certs / CRLs set, the verification results
+     * in the shared cache are only used by the stores with the same id
+     * (i.e. the copies of this store in the forked processes) */
+    xmlSecByte                            sharedCacheId[16];
+    int                                   sharedCacheIdSet;
+
+    /* parsed certificates cache (protected by the cacheMutex) */
+    xmlHashTablePtr                       certsCacheIndex;
+    xmlSecOpenSSLX509CertsCacheEntryPtr   certsCacheHead;
+    xmlSecOpenSSLX509CertsCacheEntryPtr   certsCacheTail;
+    xmlSecSize                            certsCacheSize;
+
+    /* parsed names cache (protected by the cacheMutex) */
+    xmlHashTablePtr                       namesCacheIndex;
+    xmlSecOpenSSLX509NamesCacheEntryPtr   namesCacheHead;
+    xmlSecOpenSSLX509NamesCacheEntryPtr   namesCacheTail;
+    xmlSecSize                            namesCacheSize;
+
+#ifndef OPENSSL_NO_OCSP
+    /* OCSP responses cache (protected by the cacheMutex) */
+    xmlSecOpenSSLX509OcspCacheEntryPtr    ocspCacheHead;
+    xmlSecOpenSSLX509OcspCacheEntryPtr    ocspCacheTail;
+    xmlSecSize                            ocspCacheSize;
+#endif /* OPENSSL_NO_OCSP */
+
+    /* verified crls fingerprints (protected by the cacheMutex) */
+    unsigned char                         verifiedCrls[XMLSEC_OPENSSL_X509_VERIFIED_CRLS_CACHE_SIZE][EVP_MAX_MD_SIZE];
+    xmlSecSize                            verifiedCrlsNum;
+    xmlSecSize                            verifiedCrlsPos;
+
+    /* trusted certs folders and files */
+    xmlSecOpenSSLX509CertsPathPtr         certsPaths;
 };
 
 /****************************************************************************
@@ -84,17 +277,94 @@ static xmlSecKeyDataStoreKlass xmlSecOpenSSLX509StoreKlass = {
     NULL,                                       /* void* reserved1; */
 };
 
+static X509_STORE*      xmlSecOpenSSLX509StoreCreateXst                 (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         const xmlChar* storeName);
+static int              xmlSecOpenSSLX509StoreAddLookup                 (X509_STORE* xst,
+                                                                         const char* path,
+                                                                         int isFile,
+                                                                         const xmlChar* storeName);
+static int              xmlSecOpenSSLX509StoreAddCertsPathInternal      (xmlSecKeyDataStorePtr store,
+                                                                         const char* path,
+                                                                         int isFile);
+static time_t           xmlSecOpenSSLX509CertsPathGetMTime              (const char* path);
 static int              xmlSecOpenSSLX509VerifyCRL                      (X509_STORE* xst,
                                                                          X509_CRL *crl );
+static int              xmlSecOpenSSLX509CertsDigest                    (STACK_OF(X509) *certs,
+                                                                         unsigned char *md);
+static int              xmlSecOpenSSLX509VerifyCacheLookup              (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         const unsigned char *certMd,
+                                                                         const unsigned char *certsMd,
+                                                                         int depth,
+                                                                         time_t verificationTime);
+static int              xmlSecOpenSSLX509VerifyCacheAdd                 (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         const unsigned char *certMd,
+                                                                         const unsigned char *certsMd,
+                                                                         int depth,
+                                                                         STACK_OF(X509) *chain);
+static void             xmlSecOpenSSLX509VerifyCacheFlush               (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509VerifyCacheNewSharedId         (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509CertsCacheFlush                (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509NamesCacheFlush                (xmlSecOpenSSLX509StoreCtxPtr ctx);
+#ifndef OPENSSL_NO_OCSP
+static void             xmlSecOpenSSLX509OcspCacheFlush                 (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static int              xmlSecOpenSSLX509OcspCacheAdd                   (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         OCSP_BASICRESP* bs,
+                                                                         int verified);
+static OCSP_BASICRESP*  xmlSecOpenSSLX509OcspResponseRead               (const xmlSecByte* data,
+                                                                         xmlSecSize dataSize,
+                                                                         const xmlChar* storeName);
+static int              xmlSecOpenSSLX509StoreVerifyOcsp                (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         STACK_OF(X509)* chain,
+                                                                         xmlSecKeyInfoCtx* keyInfoCtx,
+                                                                         X509** badCert,
+                                                                         int* err,
+                                                                         const xmlChar* storeName);
+#endif /* OPENSSL_NO_OCSP */
+static int              xmlSecOpenSSLX509NamesCacheAppendName           (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         xmlSecBufferPtr key,
+                                                                         const xmlChar *str);
 static X509*            xmlSecOpenSSLX509FindCert                       (STACK_OF(X509) *certs,
                                                                          xmlChar *subjectName,
                                                                          xmlChar *issuerName,
                                                                          xmlChar *issuerSerial,
                                                                          xmlChar *ski);
-static X509*            xmlSecOpenSSLX509FindNextChainCert              (STACK_OF(X509) *chain,
+static X509*            xmlSecOpenSSLX509IndexFindCert                  (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         xmlChar *subjectName,
+                                                                         xmlChar *issuerName,
+                                                                         xmlChar *issuerSerial,
+                                                                         xmlChar *ski);
+static int              xmlSecOpenSSLX509IndexAddCert                   (xmlHashTablePtr index,
+                                                                         X509* cert);
+static xmlSecOpenSSLX509IssuerHashPtr xmlSecOpenSSLX509IssuerHashesCreate(STACK_OF(X509) *certs);
+static X509*            xmlSecOpenSSLX509FindNextChainCert              (xmlSecOpenSSLX509IssuerHashPtr issuerHashes,
+                                                                         int issuerHashesSize,
                                                                          X509 *cert);
 static int              xmlSecOpenSSLX509VerifyCertAgainstCrls          (STACK_OF(X509_CRL) *crls,
                                                                          X509* cert);
+static int              xmlSecOpenSSLX509VerifyCertAgainstCrl           (X509_CRL *crl,
+                                                                         X509* cert);
+static int              xmlSecOpenSSLX509StoreVerifyCRL                 (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         X509_CRL *crl);
+static int              xmlSecOpenSSLX509StoreVerifyCertAgainstCrls     (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         X509* cert);
+static int              xmlSecOpenSSLX509IndexAddCrl                    (xmlHashTablePtr index,
+                                                                         X509_CRL* crl);
+static int              xmlSecOpenSSLX509IndexKeyBuild                  (xmlSecBufferPtr key,
+                                                                         const char *prefix,
+                                                                         X509_NAME *nm,
+                                                                         const ASN1_INTEGER *serial,
+                                                                         const xmlSecByte *data,
+                                                                         xmlSecSize dataSize);
+static int              xmlSecOpenSSLX509IndexKeyBuildEx                (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         xmlSecBufferPtr key,
+                                                                         const char *prefix,
+                                                                         X509_NAME *nm,
+                                                                         const xmlChar *nameStr,
+                                                                         const ASN1_INTEGER *serial,
+                                                                         const xmlSecByte *data,
+                                                                         xmlSecSize dataSize);
+static int              xmlSecOpenSSLX509IndexKeyAppendName             (xmlSecBufferPtr key,
+                                                                         X509_NAME *nm);
 static X509_NAME*       xmlSecOpenSSLX509NameRead                       (xmlSecByte *str,
                                                                          int len);
 static int              xmlSecOpenSSLX509NameStringRead                 (xmlSecByte **str,
@@ -106,8 +376,8 @@ static int              xmlSecOpenSSLX509NameStringRead                 (xmlSecB
 static int              xmlSecOpenSSLX509NamesCompare                   (X509_NAME *a,
                                                                          X509_NAME *b);
 static STACK_OF(X509_NAME_ENTRY)*  xmlSecOpenSSLX509_NAME_ENTRIES_copy  (X509_NAME *a);
-static int              xmlSecOpenSSLX509_NAME_ENTRIES_cmp              (STACK_OF(X509_NAME_ENTRY) * a,
-                                                                         STACK_OF(X509_NAME_ENTRY) * b);
+static int              xmlSecOpenSSLX509_NAME_ENTRIES_count            (X509_NAME *nm,
+                                                                         const X509_NAME_ENTRY *entry);
 static int              xmlSecOpenSSLX509_NAME_ENTRY_cmp                (const X509_NAME_ENTRY * const *a,
                                                                          const X509_NAME_ENTRY * const *b);
 
@@ -151,7 +421,9 @@ xmlSecOpenSSLX509StoreFindCert(xmlSecKeyDataStorePtr store, xmlChar *subjectName
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, NULL);
 
-    if((res == NULL) && (ctx->untrusted != NULL)) {
+    if((res == NULL) && (ctx->untrustedIndex != NULL)) {
+        res = xmlSecOpenSSLX509IndexFindCert(ctx, subjectName, issuerName, issuerSerial, ski);
+    } else if((res == NULL) && (ctx->untrusted != NULL)) {
         res = xmlSecOpenSSLX509FindCert(ctx->untrusted, subjectName, issuerName, issuerSerial, ski);
     }
     return(res);
@@ -178,6 +450,11 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     X509 * cert;
     X509 * err_cert = NULL;
     X509_STORE_CTX *xsc;
+    xmlSecOpenSSLX509IssuerHashPtr issuerHashes = NULL;
+    unsigned char certMd[EVP_MAX_MD_SIZE];
+    unsigned char certsMd[EVP_MAX_MD_SIZE];
+    unsigned int certMdLen;
+    int useCache;
     int err = 0;
     int i;
     int ret;
@@ -227,13 +504,13 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
         }
 
         for(i = 0; i < sk_X509_CRL_num(crls2); ) {
-            ret = xmlSecOpenSSLX509VerifyCRL(ctx->xst, sk_X509_CRL_value(crls2, i));
+            ret = xmlSecOpenSSLX509StoreVerifyCRL(ctx, sk_X509_CRL_value(crls2, i));
             if(ret == 1) {
                 ++i;
             } else if(ret == 0) {
                 (void)sk_X509_CRL_delete(crls2, i);
             } else {
-                xmlSecInternalError("xmlSecOpenSSLX509VerifyCRL",
+                xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCRL",
                                     xmlSecKeyDataStoreGetName(store));
                 goto done;
             }
@@ -257,12 +534,12 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
         }
 
         if(ctx->crls != NULL) {
-            ret = xmlSecOpenSSLX509VerifyCertAgainstCrls(ctx->crls, cert);
+            ret = xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(ctx, cert);
             if(ret == 0) {
                 (void)sk_X509_delete(certs2, i);
                 continue;
             } else if(ret != 1) {
-                xmlSecInternalError("xmlSecOpenSSLX509VerifyCertAgainstCrls",
+                xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCertAgainstCrls",
                                     xmlSecKeyDataStoreGetName(store));
                 goto done;
             }
@@ -270,10 +547,54 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
         ++i;
     }
 
+    /* the cached results are only valid for the same set of (non-revoked) untrusted certs */
+    useCache = ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) ? 1 : 0;
+
+    /* the OCSP status might change any time */
+    if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK) != 0) {
+        useCache = 0;
+    }
+    if(useCache != 0) {
+        memset(certsMd, 0, sizeof(certsMd));
+        ret = xmlSecOpenSSLX509CertsDigest(certs2, certsMd);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509CertsDigest",
+                                xmlSecKeyDataStoreGetName(store));
+            goto done;
+        }
+    }
+
+    /* only the certs that didn't issue any other cert are verified */
+    issuerHashes = xmlSecOpenSSLX509IssuerHashesCreate(certs2);
+    if(issuerHashes == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509IssuerHashesCreate",
+                            xmlSecKeyDataStoreGetName(store));
+        goto done;
+    }
+
     /* get one cert after another and try to verify */
     for(i = 0; i < sk_X509_num(certs2); ++i) {
         cert = sk_X509_value(certs2, i);
-        if(xmlSecOpenSSLX509FindNextChainCert(certs2, cert) == NULL) {
+        if(xmlSecOpenSSLX509FindNextChainCert(issuerHashes, sk_X509_num(certs2), cert) == NULL) {
+
+            /* did we verify this cert already? */
+            if(useCache != 0) {
+                memset(certMd, 0, sizeof(certMd));
+                ret = X509_digest(cert, EVP_sha256(), certMd, &certMdLen);
+                if(ret != 1) {
+                    xmlSecOpenSSLError("X509_digest",
+                                       xmlSecKeyDataStoreGetName(store));
+                    goto done;
+                }
+                ret = xmlSecOpenSSLX509VerifyCacheLookup(ctx, certMd, certsMd,
+                    keyInfoCtx->certsVerificationDepth, keyInfoCtx->certsVerificationTime);
+                if(ret == 1) {
+                    xmlSecMetricsAdd(xmlSecMetricX509CacheHits, 1);
+                    res = cert;
+                    goto done;
+                }
+                xmlSecMetricsAdd(xmlSecMetricX509CacheMisses, 1);
+            }
 
             ret = X509_STORE_CTX_init(xsc, ctx->xst, cert, certs2);
             if(ret != 1) {
@@ -318,6 +639,54 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
             err_cert    = X509_STORE_CTX_get_current_cert(xsc);
             err         = X509_STORE_CTX_get_error(xsc);
 
+#ifndef OPENSSL_NO_OCSP
+            /* the chain is good, check that the certs are not revoked */
+            if((ret == 1) &&
+               ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0) &&
+               ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK) != 0)) {
+                STACK_OF(X509)* chain;
+
+                chain = X509_STORE_CTX_get1_chain(xsc);
+                if(chain == NULL) {
+                    xmlSecOpenSSLError("X509_STORE_CTX_get1_chain",
+                                       xmlSecKeyDataStoreGetName(store));
+                    X509_STORE_CTX_cleanup (xsc);
+                    goto done;
+                }
+                ret = xmlSecOpenSSLX509StoreVerifyOcsp(ctx, chain, keyInfoCtx, &err_cert, &err,
+                                                       xmlSecKeyDataStoreGetName(store));
+                sk_X509_pop_free(chain, X509_free);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyOcsp",
+                                        xmlSecKeyDataStoreGetName(store));
+                    X509_STORE_CTX_cleanup (xsc);
+                    goto done;
+                }
+            }
+#endif /* OPENSSL_NO_OCSP */
+
+            if((ret == 1) && (useCache != 0)) {
+                STACK_OF(X509)* chain;
+
+                chain = X509_STORE_CTX_get1_chain(xsc);
+                if(chain == NULL) {
+                    xmlSecOpenSSLError("X509_STORE_CTX_get1_chain",
+                                       xmlSecKeyDataStoreGetName(store));
+                    X509_STORE_CTX_cleanup (xsc);
+                    goto done;
+                }
+                ret = xmlSecOpenSSLX509VerifyCacheAdd(ctx, certMd, certsMd,
+                    keyInfoCtx->certsVerificationDepth, chain);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecOpenSSLX509VerifyCacheAdd",
+                                        xmlSecKeyDataStoreGetName(store));
+                    sk_X509_pop_free(chain, X509_free);
+                    X509_STORE_CTX_cleanup (xsc);
+                    goto done;
+                }
+                ret = 1;
+            }
+
             X509_STORE_CTX_cleanup (xsc);
 
             if(ret == 1) {
@@ -383,6 +752,9 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     }
 
 done:
+    if(issuerHashes != NULL) {
+        xmlFree(issuerHashes);
+    }
     if(certs2 != NULL) {
         sk_X509_free(certs2);
     }
@@ -416,17 +788,28 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
 
+    /* the store changed: forget the previous verification results */
+    xmlSecOpenSSLX509VerifyCacheFlush(ctx);
+
     if((type & xmlSecKeyDataTypeTrusted) != 0) {
         xmlSecAssert2(ctx->xst != NULL, -1);
 
+        xmlSecAssert2(ctx->trusted != NULL, -1);
+
         ret = X509_STORE_add_cert(ctx->xst, cert);
         if(ret != 1) {
             xmlSecOpenSSLError("X509_STORE_add_cert",
                                xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
-        /* add cert increments the reference */
-        X509_free(cert);
+
+        /* add cert increments the reference, we keep ours to re-create the store */
+        ret = sk_X509_push(ctx->trusted, cert);
+        if(ret < 1) {
+            xmlSecOpenSSLError("sk_X509_push",
+                               xmlSecKeyDataStoreGetName(store));
+            return(-1);
+        }
     } else {
         xmlSecAssert2(ctx->untrusted != NULL, -1);
 
@@ -436,6 +819,17 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
                                xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
+
+        if(ctx->untrustedIndex != NULL) {
+            ret = xmlSecOpenSSLX509IndexAddCert(ctx->untrustedIndex, cert);
+            if(ret < 0) {
+                /* the cert is already in the store: fall back to the linear search */
+                xmlSecInternalError("xmlSecOpenSSLX509IndexAddCert",
+                                    xmlSecKeyDataStoreGetName(store));
+                xmlHashFree(ctx->untrustedIndex, NULL);
+                ctx->untrustedIndex = NULL;
+            }
+        }
     }
     return(0);
 }
@@ -461,6 +855,9 @@ xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
     xmlSecAssert2(ctx != NULL, -1);
         xmlSecAssert2(ctx->crls != NULL, -1);
 
+        /* the certs might be revoked now: forget the previous verification results */
+        xmlSecOpenSSLX509VerifyCacheFlush(ctx);
+
         ret = sk_X509_CRL_push(ctx->crls, crl);
         if(ret < 1) {
             xmlSecOpenSSLError("sk_X509_CRL_push",
@@ -468,45 +865,92 @@ xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
             return(-1);
         }
 
+        if(ctx->crlsIndex != NULL) {
+            ret = xmlSecOpenSSLX509IndexAddCrl(ctx->crlsIndex, crl);
+            if(ret < 0) {
+                /* the crl is already in the store: fall back to the linear search */
+                xmlSecInternalError("xmlSecOpenSSLX509IndexAddCrl",
+                                    xmlSecKeyDataStoreGetName(store));
+                xmlHashFree(ctx->crlsIndex, NULL);
+                ctx->crlsIndex = NULL;
+            }
+        }
+
     return (0);
 }
 
 /**
- * xmlSecOpenSSLX509StoreAddCertsPath:
- * @store: the pointer to OpenSSL x509 store.
- * @path: the path to the certs dir.
+ * xmlSecOpenSSLX509StoreAddOcspResponse:
+ * @store:              the pointer to X509 key data store klass.
+ * @data:               the DER encoded OCSP response.
+ * @dataSize:           the @data size.
  *
- * Adds all certs in the @path to the list of trusted certs
- * in @store.
+ * Adds the OCSP response (e.g. stapled to the signed document) to the store.
+ * The response is used to check the certificates revocation status if
+ * the XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_CHECK flag is set until the response
+ * nextUpdate time. The response signature is verified when it is used.
  *
- * Returns: 0 on success or a negative value otherwise.
+ * Returns: 0 on success or a negative value if an error occurs.
  */
 int
-xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store, const char *path) {
+xmlSecOpenSSLX509StoreAddOcspResponse(xmlSecKeyDataStorePtr store, const xmlSecByte* data,
+                                      xmlSecSize dataSize) {
+#ifndef OPENSSL_NO_OCSP
     xmlSecOpenSSLX509StoreCtxPtr ctx;
-    X509_LOOKUP *lookup = NULL;
+    OCSP_BASICRESP* bs;
+    int ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
-    xmlSecAssert2(path != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize > 0, -1);
 
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->xst != NULL, -1);
 
-    lookup = X509_STORE_add_lookup(ctx->xst, X509_LOOKUP_hash_dir());
-    if(lookup == NULL) {
-        xmlSecOpenSSLError("X509_STORE_add_lookup",
-                           xmlSecKeyDataStoreGetName(store));
+    bs = xmlSecOpenSSLX509OcspResponseRead(data, dataSize, xmlSecKeyDataStoreGetName(store));
+    if(bs == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509OcspResponseRead",
+                            xmlSecKeyDataStoreGetName(store));
         return(-1);
     }
-    if(!X509_LOOKUP_add_dir(lookup, path, X509_FILETYPE_PEM)) {
-        xmlSecOpenSSLError2("X509_LOOKUP_add_dir",
-                            xmlSecKeyDataStoreGetName(store),
-                            "path='%s'",
-                            xmlSecErrorsSafeString(path));
+    ret = xmlSecOpenSSLX509OcspCacheAdd(ctx, bs, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509OcspCacheAdd",
+                            xmlSecKeyDataStoreGetName(store));
+        OCSP_BASICRESP_free(bs);
         return(-1);
     }
     return(0);
+#else /* OPENSSL_NO_OCSP */
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize > 0, -1);
+
+    xmlSecOtherError(XMLSEC_ERRORS_R_DISABLED, xmlSecKeyDataStoreGetName(store),
+                     "OCSP support is disabled in OpenSSL");
+    return(-1);
+#endif /* OPENSSL_NO_OCSP */
+}
+
+/**
+ * xmlSecOpenSSLX509StoreAddCertsPath:
+ * @store: the pointer to OpenSSL x509 store.
+ * @path: the path to the certs dir.
+ *
+ * Adds all certs in the @path to the list of trusted certs
+ * in @store. The folder should have the OpenSSL c_rehash layout:
+ * the certs are not read now but loaded on demand by the subject
+ * name hash. The folder changes are picked up by
+ * #xmlSecOpenSSLX509StoreReloadCertsPaths.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store, const char *path) {
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(path != NULL, -1);
+
+    return(xmlSecOpenSSLX509StoreAddCertsPathInternal(store, path, 0));
 }
 
 /**
@@ -521,141 +965,562 @@ xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store, const char *path
  */
 int
 xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store, const char *filename) {
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    return(xmlSecOpenSSLX509StoreAddCertsPathInternal(store, filename, 1));
+}
+
+/**
+ * xmlSecOpenSSLX509StoreReloadCertsPaths:
+ * @store: the pointer to OpenSSL x509 store.
+ *
+ * Checks the certs folders and files added with #xmlSecOpenSSLX509StoreAddCertsPath
+ * and #xmlSecOpenSSLX509StoreAddCertsFile for changes (modification time) and
+ * re-creates the trusted certs store if any of them changed. The certs
+ * added with #xmlSecOpenSSLX509StoreAdoptCert are preserved. This function
+ * should not be called while @store is used to verify certificates.
+ *
+ * Returns: 1 if the store was reloaded, 0 if nothing changed or a negative
+ * value if an error occurs.
+ */
+int
+xmlSecOpenSSLX509StoreReloadCertsPaths(xmlSecKeyDataStorePtr store) {
     xmlSecOpenSSLX509StoreCtxPtr ctx;
-    X509_LOOKUP *lookup = NULL;
+    xmlSecOpenSSLX509CertsPathPtr cur;
+    X509_STORE* xst;
+    time_t mtime;
+    int changed = 0;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
-    xmlSecAssert2(filename != NULL, -1);
 
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(ctx->xst != NULL, -1);
 
-    lookup = X509_STORE_add_lookup(ctx->xst, X509_LOOKUP_file());
-    if(lookup == NULL) {
-        xmlSecOpenSSLError("X509_STORE_add_lookup",
-                           xmlSecKeyDataStoreGetName(store));
-        return(-1);
+    /* adding or removing a file changes the folder modification time */
+    for(cur = ctx->certsPaths; cur != NULL; cur = cur->next) {
+        mtime = xmlSecOpenSSLX509CertsPathGetMTime(cur->path);
+        if(mtime != cur->mtime) {
+            cur->mtime = mtime;
+            changed = 1;
+        }
+    }
+    if(changed == 0) {
+        return(0);
     }
-    if(!X509_LOOKUP_load_file(lookup, filename, X509_FILETYPE_PEM)) {
-        xmlSecOpenSSLError2("X509_LOOKUP_load_file",
-                            xmlSecKeyDataStoreGetName(store),
-                            "filename='%s'",
-                            xmlSecErrorsSafeString(filename));
+
+    xst = xmlSecOpenSSLX509StoreCreateXst(ctx, xmlSecKeyDataStoreGetName(store));
+    if(xst == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreCreateXst",
+                            xmlSecKeyDataStoreGetName(store));
         return(-1);
     }
-    return(0);
+    X509_STORE_free(ctx->xst);
+    ctx->xst = xst;
+
+    /* the trusted certs changed: forget the previous verification results */
+    xmlSecOpenSSLX509VerifyCacheFlush(ctx);
+    return(1);
 }
 
 static int
-xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
-    const xmlChar* path;
-    X509_LOOKUP *lookup = NULL;
-
+xmlSecOpenSSLX509StoreAddCertsPathInternal(xmlSecKeyDataStorePtr store, const char* path, int isFile) {
     xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509CertsPathPtr certsPath;
+    xmlSecOpenSSLX509CertsPathPtr* last;
+    int ret;
+
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(path != NULL, -1);
 
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xst != NULL, -1);
 
-    memset(ctx, 0, sizeof(xmlSecOpenSSLX509StoreCtx));
+    xmlSecOpenSSLX509VerifyCacheFlush(ctx);
 
-    ctx->xst = X509_STORE_new();
-    if(ctx->xst == NULL) {
-        xmlSecOpenSSLError("X509_STORE_new",
-                           xmlSecKeyDataStoreGetName(store));
+    ret = xmlSecOpenSSLX509StoreAddLookup(ctx->xst, path, isFile, xmlSecKeyDataStoreGetName(store));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreAddLookup",
+                            xmlSecKeyDataStoreGetName(store));
         return(-1);
     }
 
-    if(!X509_STORE_set_default_paths(ctx->xst)) {
-        xmlSecOpenSSLError("X509_STORE_set_default_paths",
-                           xmlSecKeyDataStoreGetName(store));
+    /* remember the path to re-create the store on reload */
+    certsPath = (xmlSecOpenSSLX509CertsPathPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509CertsPath));
+    if(certsPath == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509CertsPath),
+                          xmlSecKeyDataStoreGetName(store));
         return(-1);
     }
+    memset(certsPath, 0, sizeof(xmlSecOpenSSLX509CertsPath));
 
+    certsPath->path = (char*)xmlStrdup(BAD_CAST path);
+    if(certsPath->path == NULL) {
+        xmlSecStrdupError(BAD_CAST path, xmlSecKeyDataStoreGetName(store));
+        xmlFree(certsPath);
+        return(-1);
+    }
+    certsPath->isFile = isFile;
+    certsPath->mtime = xmlSecOpenSSLX509CertsPathGetMTime(path);
 
-    lookup = X509_STORE_add_lookup(ctx->xst, X509_LOOKUP_hash_dir());
-    if(lookup == NULL) {
-        xmlSecOpenSSLError("X509_STORE_add_lookup",
-                           xmlSecKeyDataStoreGetName(store));
-         return(-1);
+    for(last = &(ctx->certsPaths); (*last) != NULL; last = &((*last)->next)) {
+        ;
     }
+    (*last) = certsPath;
+    return(0);
+}
 
-    path = xmlSecOpenSSLGetDefaultTrustedCertsFolder();
-    if(path != NULL) {
-        if(!X509_LOOKUP_add_dir(lookup, (char*)path, X509_FILETYPE_PEM)) {
-            xmlSecOpenSSLError2("X509_LOOKUP_add_dir",
-                                xmlSecKeyDataStoreGetName(store),
-                                "path='%s'",
-                                xmlSecErrorsSafeString(path));
+static int
+xmlSecOpenSSLX509StoreAddLookup(X509_STORE* xst, const char* path, int isFile, const xmlChar* storeName) {
+    X509_LOOKUP *lookup = NULL;
+
+    xmlSecAssert2(xst != NULL, -1);
+    xmlSecAssert2(path != NULL, -1);
+
+    if(isFile != 0) {
+        lookup = X509_STORE_add_lookup(xst, X509_LOOKUP_file());
+        if(lookup == NULL) {
+            xmlSecOpenSSLError("X509_STORE_add_lookup", storeName);
+            return(-1);
+        }
+        if(!X509_LOOKUP_load_file(lookup, path, X509_FILETYPE_PEM)) {
+            xmlSecOpenSSLError2("X509_LOOKUP_load_file", storeName,
+                                "filename='%s'", xmlSecErrorsSafeString(path));
             return(-1);
         }
     } else {
-        if(!X509_LOOKUP_add_dir(lookup, NULL, X509_FILETYPE_DEFAULT)) {
-            xmlSecOpenSSLError("X509_LOOKUP_add_dir",
-                               xmlSecKeyDataStoreGetName(store));
+        /* the certs are loaded on demand */
+        lookup = X509_STORE_add_lookup(xst, X509_LOOKUP_hash_dir());
+        if(lookup == NULL) {
+            xmlSecOpenSSLError("X509_STORE_add_lookup", storeName);
+            return(-1);
+        }
+        if(!X509_LOOKUP_add_dir(lookup, path, X509_FILETYPE_PEM)) {
+            xmlSecOpenSSLError2("X509_LOOKUP_add_dir", storeName,
+                                "path='%s'", xmlSecErrorsSafeString(path));
             return(-1);
         }
     }
+    return(0);
+}
 
-    ctx->untrusted = sk_X509_new_null();
-    if(ctx->untrusted == NULL) {
-        xmlSecOpenSSLError("sk_X509_new_null",
-                           xmlSecKeyDataStoreGetName(store));
-        return(-1);
-    }
+static time_t
+xmlSecOpenSSLX509CertsPathGetMTime(const char* path) {
+    struct stat st;
 
-    ctx->crls = sk_X509_CRL_new_null();
-    if(ctx->crls == NULL) {
-        xmlSecOpenSSLError("sk_X509_CRL_new_null",
-                           xmlSecKeyDataStoreGetName(store));
-        return(-1);
-    }
+    xmlSecAssert2(path != NULL, 0);
 
-    ctx->vpm = X509_VERIFY_PARAM_new();
-    if(ctx->vpm == NULL) {
-        xmlSecOpenSSLError("X509_VERIFY_PARAM_new",
-                           xmlSecKeyDataStoreGetName(store));
-        return(-1);
+    /* the missing folder or file is "changed" when it is created */
+    if(stat(path, &st) != 0) {
+        return(0);
     }
-    X509_VERIFY_PARAM_set_depth(ctx->vpm, 9); /* the default cert verification path in openssl */
-    X509_STORE_set1_param(ctx->xst, ctx->vpm);
-
-
-    return(0);
+    return(st.st_mtime);
 }
 
-static void
-xmlSecOpenSSLX509StoreFinalize(xmlSecKeyDataStorePtr store) {
+/**
+ * xmlSecOpenSSLX509StoreCertDerRead:
+ * @store:              the pointer to OpenSSL x509 store.
+ * @buf:                the certificate DER.
+ * @size:               the size of @buf.
+ *
+ * Parses the certificate DER. The same certificates are usually sent in
+ * every message, so the store remembers the recently parsed certificates
+ * and returns a new reference to the cached object if @buf matches.
+ *
+ * Returns: the pointer to the certificate (the caller is responsible for
+ * freeing it with X509_free) or NULL if an error occurs.
+ */
+X509*
+xmlSecOpenSSLX509StoreCertDerRead(xmlSecKeyDataStorePtr store, const xmlSecByte* buf, xmlSecSize size) {
     xmlSecOpenSSLX509StoreCtxPtr ctx;
-    xmlSecAssert(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId));
+    xmlSecOpenSSLX509CertsCacheEntryPtr entry;
+    xmlChar key[32];
+    const unsigned char* p;
+    X509* cert;
+    unsigned long long hash;
+    xmlSecSize ii;
 
-    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
-    xmlSecAssert(ctx != NULL);
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), NULL);
+    xmlSecAssert2(buf != NULL, NULL);
+    xmlSecAssert2(size > 0, NULL);
 
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->cacheMutex != NULL, NULL);
+    xmlSecAssert2(ctx->certsCacheIndex != NULL, NULL);
 
-    if(ctx->xst != NULL) {
-        X509_STORE_free(ctx->xst);
+    /* FNV-1a: the hash only locates the entry, DER is compared anyway */
+    hash = 14695981039346656037ULL;
+    for(ii = 0; ii < size; ++ii) {
+        hash = (hash ^ buf[ii]) * 1099511628211ULL;
     }
-    if(ctx->untrusted != NULL) {
-        sk_X509_pop_free(ctx->untrusted, X509_free);
+    xmlStrPrintf(key, sizeof(key), "%016llx-%lu", hash, (unsigned long)size);
+
+    xmlMutexLock(ctx->cacheMutex);
+    entry = (xmlSecOpenSSLX509CertsCacheEntryPtr)xmlHashLookup(ctx->certsCacheIndex, key);
+    if((entry != NULL) && (entry->derSize == size) && (memcmp(entry->der, buf, size) == 0)) {
+        X509_up_ref(entry->cert);
+        cert = entry->cert;
+
+        /* most recently used goes first */
+        if(entry->prev != NULL) {
+            entry->prev->next = entry->next;
+            if(entry->next != NULL) {
+                entry->next->prev = entry->prev;
+            } else {
+                ctx->certsCacheTail = entry->prev;
+            }
+            entry->prev = NULL;
+            entry->next = ctx->certsCacheHead;
+            ctx->certsCacheHead->prev = entry;
+            ctx->certsCacheHead = entry;
+        }
+        xmlMutexUnlock(ctx->cacheMutex);
+        return(cert);
     }
-    if(ctx->crls != NULL) {
-        sk_X509_CRL_pop_free(ctx->crls, X509_CRL_free);
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    p = buf;
+    cert = d2i_X509(NULL, &p, (long)size);
+    if(cert == NULL) {
+        xmlSecOpenSSLError2("d2i_X509", xmlSecKeyDataStoreGetName(store),
+                            "size=%lu", (unsigned long)size);
+        return(NULL);
     }
-    if(ctx->vpm != NULL) {
-        X509_VERIFY_PARAM_free(ctx->vpm);
+    if(entry != NULL) {
+        /* hash collision: don't cache */
+        return(cert);
     }
 
-    memset(ctx, 0, sizeof(xmlSecOpenSSLX509StoreCtx));
-}
-
-
-/*****************************************************************************
- *
- * Low-level x509 functions
- *
- *****************************************************************************/
+    entry = (xmlSecOpenSSLX509CertsCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509CertsCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509CertsCacheEntry),
+                          xmlSecKeyDataStoreGetName(store));
+        X509_free(cert);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509CertsCacheEntry));
+    memcpy(entry->key, key, sizeof(entry->key));
+    entry->der = (xmlSecByte*)xmlMalloc(size);
+    if(entry->der == NULL) {
+        xmlSecMallocError(size, xmlSecKeyDataStoreGetName(store));
+        xmlFree(entry);
+        X509_free(cert);
+        return(NULL);
+    }
+    memcpy(entry->der, buf, size);
+    entry->derSize = size;
+    X509_up_ref(cert);
+    entry->cert = cert;
+
+    xmlMutexLock(ctx->cacheMutex);
+    if(xmlHashAddEntry(ctx->certsCacheIndex, entry->key, entry) < 0) {
+        /* somebody else added it already */
+        xmlMutexUnlock(ctx->cacheMutex);
+        X509_free(entry->cert);
+        xmlFree(entry->der);
+        xmlFree(entry);
+        return(cert);
+    }
+    entry->next = ctx->certsCacheHead;
+    if(ctx->certsCacheHead != NULL) {
+        ctx->certsCacheHead->prev = entry;
+    } else {
+        ctx->certsCacheTail = entry;
+    }
+    ctx->certsCacheHead = entry;
+    ++ctx->certsCacheSize;
+
+    while((ctx->certsCacheSize > XMLSEC_OPENSSL_X509_CERTS_CACHE_SIZE) && (ctx->certsCacheTail != NULL)) {
+        /* evict least recently used */
+        entry = ctx->certsCacheTail;
+        ctx->certsCacheTail = entry->prev;
+        if(entry->prev != NULL) {
+            entry->prev->next = NULL;
+        } else {
+            ctx->certsCacheHead = NULL;
+        }
+        (void)xmlHashRemoveEntry(ctx->certsCacheIndex, entry->key, NULL);
+        X509_free(entry->cert);
+        xmlFree(entry->der);
+        xmlFree(entry);
+        --ctx->certsCacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    return(cert);
+}
+
+/**
+ * xmlSecOpenSSLX509StoreIsCrlNeeded:
+ * @store:              the pointer to OpenSSL x509 store.
+ * @certs:              the certificates from the document (may be NULL).
+ * @crlIssuer:          the CRL issuer name.
+ *
+ * Checks if a CRL from the document issued by @crlIssuer could be used to
+ * check the revocation status during the verification: the document CRLs
+ * are only checked against the certificates (from @certs or the store's
+ * untrusted certificates) issued by the CRL issuer.
+ *
+ * Returns: 1 if the CRL is needed, 0 if it is not or a negative value
+ * if an error occurs.
+ */
+int
+xmlSecOpenSSLX509StoreIsCrlNeeded(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509* certs,
+                                  X509_NAME* crlIssuer) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    X509* cert;
+    int ii;
+
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(crlIssuer != NULL, -1);
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(certs != NULL) {
+        for(ii = 0; ii < sk_X509_num(certs); ++ii) {
+            cert = sk_X509_value(certs, ii);
+            if((cert != NULL) && (xmlSecOpenSSLX509NamesCompare(X509_get_issuer_name(cert), crlIssuer) == 0)) {
+                return(1);
+            }
+        }
+    }
+    if(ctx->untrusted != NULL) {
+        for(ii = 0; ii < sk_X509_num(ctx->untrusted); ++ii) {
+            cert = sk_X509_value(ctx->untrusted, ii);
+            if((cert != NULL) && (xmlSecOpenSSLX509NamesCompare(X509_get_issuer_name(cert), crlIssuer) == 0)) {
+                return(1);
+            }
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    memset(ctx, 0, sizeof(xmlSecOpenSSLX509StoreCtx));
+
+    ctx->trusted = sk_X509_new_null();
+    if(ctx->trusted == NULL) {
+        xmlSecOpenSSLError("sk_X509_new_null",
+                           xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->vpm = X509_VERIFY_PARAM_new();
+    if(ctx->vpm == NULL) {
+        xmlSecOpenSSLError("X509_VERIFY_PARAM_new",
+                           xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+    X509_VERIFY_PARAM_set_depth(ctx->vpm, 9); /* the default cert verification path in openssl */
+    xmlSecOpenSSLX509VerifyCacheNewSharedId(ctx);
+
+    ctx->xst = xmlSecOpenSSLX509StoreCreateXst(ctx, xmlSecKeyDataStoreGetName(store));
+    if(ctx->xst == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreCreateXst",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->untrusted = sk_X509_new_null();
+    if(ctx->untrusted == NULL) {
+        xmlSecOpenSSLError("sk_X509_new_null",
+                           xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->untrustedIndex = xmlHashCreate(0);
+    if(ctx->untrustedIndex == NULL) {
+        xmlSecXmlError("xmlHashCreate",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->crls = sk_X509_CRL_new_null();
+    if(ctx->crls == NULL) {
+        xmlSecOpenSSLError("sk_X509_CRL_new_null",
+                           xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->crlsIndex = xmlHashCreate(0);
+    if(ctx->crlsIndex == NULL) {
+        xmlSecXmlError("xmlHashCreate",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->cacheMutex = xmlNewMutex();
+    if(ctx->cacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->certsCacheIndex = xmlHashCreate(0);
+    if(ctx->certsCacheIndex == NULL) {
+        xmlSecXmlError("xmlHashCreate",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    ctx->namesCacheIndex = xmlHashCreate(0);
+    if(ctx->namesCacheIndex == NULL) {
+        xmlSecXmlError("xmlHashCreate",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+
+    return(0);
+}
+
+static void
+xmlSecOpenSSLX509StoreFinalize(xmlSecKeyDataStorePtr store) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509CertsPathPtr certsPath;
+    xmlSecAssert(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId));
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
+
+
+    if(ctx->xst != NULL) {
+        X509_STORE_free(ctx->xst);
+    }
+    if(ctx->trusted != NULL) {
+        sk_X509_pop_free(ctx->trusted, X509_free);
+    }
+    while(ctx->certsPaths != NULL) {
+        certsPath = ctx->certsPaths;
+        ctx->certsPaths = certsPath->next;
+        xmlFree(certsPath->path);
+        xmlFree(certsPath);
+    }
+    if(ctx->untrustedIndex != NULL) {
+        /* the certs are owned by the untrusted stack */
+        xmlHashFree(ctx->untrustedIndex, NULL);
+    }
+    if(ctx->untrusted != NULL) {
+        sk_X509_pop_free(ctx->untrusted, X509_free);
+    }
+    if(ctx->crlsIndex != NULL) {
+        /* the crls are owned by the crls stack */
+        xmlHashFree(ctx->crlsIndex, NULL);
+    }
+    if(ctx->crls != NULL) {
+        sk_X509_CRL_pop_free(ctx->crls, X509_CRL_free);
+    }
+    if(ctx->vpm != NULL) {
+        X509_VERIFY_PARAM_free(ctx->vpm);
+    }
+    xmlSecOpenSSLX509VerifyCacheFlush(ctx);
+    xmlSecOpenSSLX509CertsCacheFlush(ctx);
+    if(ctx->certsCacheIndex != NULL) {
+        /* the entries are freed by xmlSecOpenSSLX509CertsCacheFlush() */
+        xmlHashFree(ctx->certsCacheIndex, NULL);
+    }
+#ifndef OPENSSL_NO_OCSP
+    xmlSecOpenSSLX509OcspCacheFlush(ctx);
+#endif /* OPENSSL_NO_OCSP */
+    xmlSecOpenSSLX509NamesCacheFlush(ctx);
+    if(ctx->namesCacheIndex != NULL) {
+        /* the entries are freed by xmlSecOpenSSLX509NamesCacheFlush() */
+        xmlHashFree(ctx->namesCacheIndex, NULL);
+    }
+    if(ctx->cacheMutex != NULL) {
+        xmlFreeMutex(ctx->cacheMutex);
+    }
+
+    memset(ctx, 0, sizeof(xmlSecOpenSSLX509StoreCtx));
+}
+
+
+/* creates the trusted certs store: default paths, certs folders and files, adopted certs */
+static X509_STORE*
+xmlSecOpenSSLX509StoreCreateXst(xmlSecOpenSSLX509StoreCtxPtr ctx, const xmlChar* storeName) {
+    const xmlChar* path;
+    xmlSecOpenSSLX509CertsPathPtr cur;
+    X509_LOOKUP *lookup = NULL;
+    X509_STORE* xst;
+    int ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->trusted != NULL, NULL);
+    xmlSecAssert2(ctx->vpm != NULL, NULL);
+
+    xst = X509_STORE_new();
+    if(xst == NULL) {
+        xmlSecOpenSSLError("X509_STORE_new", storeName);
+        return(NULL);
+    }
+
+    if(!X509_STORE_set_default_paths(xst)) {
+        xmlSecOpenSSLError("X509_STORE_set_default_paths", storeName);
+        X509_STORE_free(xst);
+        return(NULL);
+    }
+
+    lookup = X509_STORE_add_lookup(xst, X509_LOOKUP_hash_dir());
+    if(lookup == NULL) {
+        xmlSecOpenSSLError("X509_STORE_add_lookup", storeName);
+        X509_STORE_free(xst);
+        return(NULL);
+    }
+
+    path = xmlSecOpenSSLGetDefaultTrustedCertsFolder();
+    if(path != NULL) {
+        if(!X509_LOOKUP_add_dir(lookup, (char*)path, X509_FILETYPE_PEM)) {
+            xmlSecOpenSSLError2("X509_LOOKUP_add_dir", storeName,
+                                "path='%s'", xmlSecErrorsSafeString(path));
+            X509_STORE_free(xst);
+            return(NULL);
+        }
+    } else {
+        if(!X509_LOOKUP_add_dir(lookup, NULL, X509_FILETYPE_DEFAULT)) {
+            xmlSecOpenSSLError("X509_LOOKUP_add_dir", storeName);
+            X509_STORE_free(xst);
+            return(NULL);
+        }
+    }
+
+    for(cur = ctx->certsPaths; cur != NULL; cur = cur->next) {
+        ret = xmlSecOpenSSLX509StoreAddLookup(xst, cur->path, cur->isFile, storeName);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreAddLookup", storeName);
+            X509_STORE_free(xst);
+            return(NULL);
+        }
+    }
+
+    for(ii = 0; ii < sk_X509_num(ctx->trusted); ++ii) {
+        ret = X509_STORE_add_cert(xst, sk_X509_value(ctx->trusted, ii));
+        if(ret != 1) {
+            xmlSecOpenSSLError("X509_STORE_add_cert", storeName);
+            X509_STORE_free(xst);
+            return(NULL);
+        }
+    }
+
+    X509_STORE_set1_param(xst, ctx->vpm);
+    return(xst);
+}
+
+/*****************************************************************************
+ *
+ * Low-level x509 functions
+ *
+ *****************************************************************************/
 static int
 xmlSecOpenSSLX509VerifyCRL(X509_STORE* xst, X509_CRL *crl ) {
     X509_STORE_CTX *xsc = NULL;
@@ -693,19 +1558,1086 @@ xmlSecOpenSSLX509VerifyCRL(X509_STORE* xst, X509_CRL *crl ) {
         xmlSecOpenSSLError("X509_get_pubkey", NULL);
         goto err;
     }
-    ret = X509_CRL_verify(crl, pkey);
-    EVP_PKEY_free(pkey);
-    if(ret != 1) {
-        xmlSecOpenSSLError("X509_CRL_verify", NULL);
+    ret = X509_CRL_verify(crl, pkey);
+    EVP_PKEY_free(pkey);
+    if(ret != 1) {
+        xmlSecOpenSSLError("X509_CRL_verify", NULL);
+    }
+    X509_STORE_CTX_free(xsc);
+    X509_OBJECT_free(xobj);
+    return((ret == 1) ? 1 : 0);
+
+err:
+    X509_STORE_CTX_free(xsc);
+    X509_OBJECT_free(xobj);
+    return(-1);
+}
+
+static int
+xmlSecOpenSSLX509CertsDigest(STACK_OF(X509) *certs, unsigned char *md) {
+    EVP_MD_CTX *mdCtx;
+    unsigned char certMd[EVP_MAX_MD_SIZE];
+    unsigned int certMdLen;
+    unsigned int mdLen;
+    int i;
+    int ret;
+
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(md != NULL, -1);
+
+    mdCtx = EVP_MD_CTX_new();
+    if(mdCtx == NULL) {
+        xmlSecOpenSSLError("EVP_MD_CTX_new", NULL);
+        return(-1);
+    }
+    ret = EVP_DigestInit_ex(mdCtx, EVP_sha256(), NULL);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestInit_ex", NULL);
+        EVP_MD_CTX_free(mdCtx);
+        return(-1);
+    }
+    for(i = 0; i < sk_X509_num(certs); ++i) {
+        ret = X509_digest(sk_X509_value(certs, i), EVP_sha256(), certMd, &certMdLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("X509_digest", NULL);
+            EVP_MD_CTX_free(mdCtx);
+            return(-1);
+        }
+        ret = EVP_DigestUpdate(mdCtx, certMd, certMdLen);
+        if(ret != 1) {
+            xmlSecOpenSSLError("EVP_DigestUpdate", NULL);
+            EVP_MD_CTX_free(mdCtx);
+            return(-1);
+        }
+    }
+    ret = EVP_DigestFinal_ex(mdCtx, md, &mdLen);
+    if(ret != 1) {
+        xmlSecOpenSSLError("EVP_DigestFinal_ex", NULL);
+        EVP_MD_CTX_free(mdCtx);
+        return(-1);
+    }
+    EVP_MD_CTX_free(mdCtx);
+    return(0);
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheUnlink(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                   xmlSecOpenSSLX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        ctx->cacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        ctx->cacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+static void
+xmlSecOpenSSLX509VerifyCachePushFront(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                      xmlSecOpenSSLX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = ctx->cacheHead;
+    if(ctx->cacheHead != NULL) {
+        ctx->cacheHead->prev = entry;
+    } else {
+        ctx->cacheTail = entry;
+    }
+    ctx->cacheHead = entry;
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheEntryDestroy(xmlSecOpenSSLX509VerifyCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->chain != NULL) {
+        sk_X509_pop_free(entry->chain, X509_free);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509VerifyCacheEntry));
+    xmlFree(entry);
+}
+
+/* the shared cache key: prefix, store id, fingerprints and depth */
+#define XMLSEC_OPENSSL_X509_VERIFY_SHARED_PREFIX        "xmlsec-openssl-x509-verify"
+#define XMLSEC_OPENSSL_X509_VERIFY_SHARED_KEY_SIZE      \
+    (sizeof(XMLSEC_OPENSSL_X509_VERIFY_SHARED_PREFIX) + 16 + 2 * EVP_MAX_MD_SIZE + sizeof(int))
+
+static xmlSecSize
+xmlSecOpenSSLX509VerifyCacheSharedKey(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                      const unsigned char *certMd,
+                                      const unsigned char *certsMd,
+                                      int depth, xmlSecByte* key) {
+    xmlSecByte* p = key;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(certMd != NULL, 0);
+    xmlSecAssert2(certsMd != NULL, 0);
+    xmlSecAssert2(key != NULL, 0);
+
+    memcpy(p, XMLSEC_OPENSSL_X509_VERIFY_SHARED_PREFIX, sizeof(XMLSEC_OPENSSL_X509_VERIFY_SHARED_PREFIX));
+    p += sizeof(XMLSEC_OPENSSL_X509_VERIFY_SHARED_PREFIX);
+    memcpy(p, ctx->sharedCacheId, sizeof(ctx->sharedCacheId));
+    p += sizeof(ctx->sharedCacheId);
+    memcpy(p, certMd, EVP_MAX_MD_SIZE);
+    p += EVP_MAX_MD_SIZE;
+    memcpy(p, certsMd, EVP_MAX_MD_SIZE);
+    p += EVP_MAX_MD_SIZE;
+    memcpy(p, &depth, sizeof(depth));
+    p += sizeof(depth);
+    return((xmlSecSize)(p - key));
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheNewSharedId(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    ctx->sharedCacheIdSet = (RAND_bytes(ctx->sharedCacheId, sizeof(ctx->sharedCacheId)) == 1) ? 1 : 0;
+}
+
+/* the shared cache keeps the chain validity window: the latest notBefore
+ * and the earliest notAfter */
+static int
+xmlSecOpenSSLX509VerifyCacheGetWindow(STACK_OF(X509) *chain, time_t* window) {
+    ASN1_TIME* epoch;
+    X509 * cert;
+    int day, sec;
+    time_t t;
+    int i;
+    int res = -1;
+
+    xmlSecAssert2(chain != NULL, -1);
+    xmlSecAssert2(window != NULL, -1);
+
+    epoch = ASN1_TIME_set(NULL, 0);
+    if(epoch == NULL) {
+        xmlSecOpenSSLError("ASN1_TIME_set", NULL);
+        return(-1);
+    }
+
+    window[0] = 0;
+    window[1] = 0;
+    for(i = 0; i < sk_X509_num(chain); ++i) {
+        cert = sk_X509_value(chain, i);
+        if(ASN1_TIME_diff(&day, &sec, epoch, X509_get0_notBefore(cert)) != 1) {
+            xmlSecOpenSSLError("ASN1_TIME_diff", NULL);
+            goto done;
+        }
+        t = (time_t)day * 86400 + sec;
+        if((i == 0) || (t > window[0])) {
+            window[0] = t;
+        }
+        if(ASN1_TIME_diff(&day, &sec, epoch, X509_get0_notAfter(cert)) != 1) {
+            xmlSecOpenSSLError("ASN1_TIME_diff", NULL);
+            goto done;
+        }
+        t = (time_t)day * 86400 + sec;
+        if((i == 0) || (t < window[1])) {
+            window[1] = t;
+        }
+    }
+    res = 0;
+
+done:
+    ASN1_TIME_free(epoch);
+    return(res);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheSharedLookup(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                         const unsigned char *certMd,
+                                         const unsigned char *certsMd,
+                                         int depth, time_t verificationTime) {
+    xmlSecByte key[XMLSEC_OPENSSL_X509_VERIFY_SHARED_KEY_SIZE];
+    xmlSecSize keySize;
+    xmlSecBuffer value;
+    time_t window[2];
+    int ret;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if((ctx->sharedCacheIdSet == 0) || (xmlSecSharedCacheIsEnabled() != 1)) {
+        return(0);
+    }
+    keySize = xmlSecOpenSSLX509VerifyCacheSharedKey(ctx, certMd, certsMd, depth, key);
+
+    ret = xmlSecBufferInitialize(&value, sizeof(window));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
+    ret = xmlSecSharedCacheLookup(key, keySize, &value);
+    if((ret == 1) && (xmlSecBufferGetSize(&value) == sizeof(window))) {
+        memcpy(window, xmlSecBufferGetData(&value), sizeof(window));
+        if(verificationTime <= 0) {
+            verificationTime = time(NULL);
+        }
+        if((window[0] < verificationTime) && (verificationTime < window[1])) {
+            res = 1;
+        }
+    }
+    xmlSecBufferFinalize(&value);
+    return(res);
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheSharedAdd(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                      const unsigned char *certMd,
+                                      const unsigned char *certsMd,
+                                      int depth, STACK_OF(X509) *chain) {
+    xmlSecByte key[XMLSEC_OPENSSL_X509_VERIFY_SHARED_KEY_SIZE];
+    xmlSecSize keySize;
+    time_t window[2];
+
+    xmlSecAssert(ctx != NULL);
+
+    if((ctx->sharedCacheIdSet == 0) || (xmlSecSharedCacheIsEnabled() != 1)) {
+        return;
+    }
+    if(xmlSecOpenSSLX509VerifyCacheGetWindow(chain, window) < 0) {
+        return;
+    }
+    keySize = xmlSecOpenSSLX509VerifyCacheSharedKey(ctx, certMd, certsMd, depth, key);
+
+    /* the cache is best effort: the failure only means another verification later */
+    if(xmlSecSharedCacheAdd(key, keySize, (const xmlSecByte*)window, sizeof(window)) < 0) {
+        xmlSecInternalError("xmlSecSharedCacheAdd", NULL);
+    }
+}
+
+/* returns 1 if the cached chain is valid at the verification time (0 means "now") */
+static int
+xmlSecOpenSSLX509VerifyCacheCheckTime(STACK_OF(X509) *chain, time_t verificationTime) {
+    time_t * cmpTime;
+    X509 * cert;
+    int i;
+
+    xmlSecAssert2(chain != NULL, 0);
+
+    cmpTime = (verificationTime > 0) ? &verificationTime : NULL;
+    for(i = 0; i < sk_X509_num(chain); ++i) {
+        cert = sk_X509_value(chain, i);
+        if(X509_cmp_time(X509_get0_notBefore(cert), cmpTime) >= 0) {
+            return(0);
+        }
+        if(X509_cmp_time(X509_get0_notAfter(cert), cmpTime) <= 0) {
+            return(0);
+        }
+    }
+    return(1);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheLookup(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                   const unsigned char *certMd,
+                                   const unsigned char *certsMd,
+                                   int depth, time_t verificationTime) {
+    xmlSecOpenSSLX509VerifyCacheEntryPtr entry;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+
+    xmlMutexLock(ctx->cacheMutex);
+    for(entry = ctx->cacheHead; entry != NULL; entry = entry->next) {
+        if((entry->depth == depth) &&
+           (memcmp(entry->certMd, certMd, sizeof(entry->certMd)) == 0) &&
+           (memcmp(entry->certsMd, certsMd, sizeof(entry->certsMd)) == 0)) {
+            break;
+        }
+    }
+    if((entry != NULL) && (xmlSecOpenSSLX509VerifyCacheCheckTime(entry->chain, verificationTime) == 1)) {
+        /* most recently used goes first */
+        xmlSecOpenSSLX509VerifyCacheUnlink(ctx, entry);
+        xmlSecOpenSSLX509VerifyCachePushFront(ctx, entry);
+        res = 1;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    /* another process might have verified it already */
+    if(res == 0) {
+        res = xmlSecOpenSSLX509VerifyCacheSharedLookup(ctx, certMd, certsMd,
+            depth, verificationTime);
+    }
+    return(res);
+}
+
+static int
+xmlSecOpenSSLX509VerifyCacheAdd(xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                const unsigned char *certMd,
+                                const unsigned char *certsMd,
+                                int depth, STACK_OF(X509) *chain) {
+    xmlSecOpenSSLX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(certMd != NULL, -1);
+    xmlSecAssert2(certsMd != NULL, -1);
+    xmlSecAssert2(chain != NULL, -1);
+
+    entry = (xmlSecOpenSSLX509VerifyCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509VerifyCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509VerifyCacheEntry), NULL);
+        return(-1);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509VerifyCacheEntry));
+    memcpy(entry->certMd, certMd, sizeof(entry->certMd));
+    memcpy(entry->certsMd, certsMd, sizeof(entry->certsMd));
+    entry->depth = depth;
+    entry->chain = chain;
+
+    xmlSecOpenSSLX509VerifyCacheSharedAdd(ctx, certMd, certsMd, depth, chain);
+
+    xmlMutexLock(ctx->cacheMutex);
+    xmlSecOpenSSLX509VerifyCachePushFront(ctx, entry);
+    ++ctx->cacheSize;
+    while((ctx->cacheSize > XMLSEC_OPENSSL_X509_VERIFY_CACHE_SIZE) && (ctx->cacheTail != NULL)) {
+        /* evict least recently used */
+        entry = ctx->cacheTail;
+        xmlSecOpenSSLX509VerifyCacheUnlink(ctx, entry);
+        xmlSecOpenSSLX509VerifyCacheEntryDestroy(entry);
+        --ctx->cacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(0);
+}
+
+static void
+xmlSecOpenSSLX509VerifyCacheFlush(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509VerifyCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexLock(ctx->cacheMutex);
+    }
+    while(ctx->cacheHead != NULL) {
+        entry = ctx->cacheHead;
+        xmlSecOpenSSLX509VerifyCacheUnlink(ctx, entry);
+        xmlSecOpenSSLX509VerifyCacheEntryDestroy(entry);
+    }
+    ctx->cacheSize = 0;
+    xmlSecOpenSSLX509VerifyCacheNewSharedId(ctx);
+    ctx->verifiedCrlsNum = 0;
+    ctx->verifiedCrlsPos = 0;
+#ifndef OPENSSL_NO_OCSP
+    {
+        xmlSecOpenSSLX509OcspCacheEntryPtr ocspEntry;
+
+        /* the OCSP responses signers might be not trusted anymore */
+        for(ocspEntry = ctx->ocspCacheHead; ocspEntry != NULL; ocspEntry = ocspEntry->next) {
+            ocspEntry->verified = 0;
+        }
+    }
+#endif /* OPENSSL_NO_OCSP */
+    if(ctx->cacheMutex != NULL) {
+        xmlMutexUnlock(ctx->cacheMutex);
+    }
+}
+
+static void
+xmlSecOpenSSLX509CertsCacheFlush(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509CertsCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    while(ctx->certsCacheHead != NULL) {
+        entry = ctx->certsCacheHead;
+        ctx->certsCacheHead = entry->next;
+        if(ctx->certsCacheIndex != NULL) {
+            (void)xmlHashRemoveEntry(ctx->certsCacheIndex, entry->key, NULL);
+        }
+        X509_free(entry->cert);
+        xmlFree(entry->der);
+        xmlFree(entry);
+    }
+    ctx->certsCacheTail = NULL;
+    ctx->certsCacheSize = 0;
+}
+
+static void
+xmlSecOpenSSLX509NamesCacheEntryDestroy(xmlSecOpenSSLX509NamesCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->name != NULL) {
+        xmlFree(entry->name);
+    }
+    if(entry->nameKey != NULL) {
+        xmlFree(entry->nameKey);
+    }
+    xmlFree(entry);
+}
+
+static void
+xmlSecOpenSSLX509NamesCacheFlush(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509NamesCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    while(ctx->namesCacheHead != NULL) {
+        entry = ctx->namesCacheHead;
+        ctx->namesCacheHead = entry->next;
+        if(ctx->namesCacheIndex != NULL) {
+            (void)xmlHashRemoveEntry(ctx->namesCacheIndex, entry->name, NULL);
+        }
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+    }
+    ctx->namesCacheTail = NULL;
+    ctx->namesCacheSize = 0;
+}
+
+/*
+ * Appends the name part of the certs index key for the name string to @key:
+ * the same partners names are used over and over again and parsing them
+ * (and sorting the entries) is done only once.
+ */
+static int
+xmlSecOpenSSLX509NamesCacheAppendName(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecBufferPtr key,
+                                      const xmlChar *str) {
+    xmlSecOpenSSLX509NamesCacheEntryPtr entry;
+    X509_NAME *nm;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(ctx->namesCacheIndex != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(str != NULL, -1);
+
+    xmlMutexLock(ctx->cacheMutex);
+    entry = (xmlSecOpenSSLX509NamesCacheEntryPtr)xmlHashLookup(ctx->namesCacheIndex, str);
+    if(entry != NULL) {
+        /* most recently used goes first */
+        if(entry->prev != NULL) {
+            entry->prev->next = entry->next;
+            if(entry->next != NULL) {
+                entry->next->prev = entry->prev;
+            } else {
+                ctx->namesCacheTail = entry->prev;
+            }
+            entry->prev = NULL;
+            entry->next = ctx->namesCacheHead;
+            ctx->namesCacheHead->prev = entry;
+            ctx->namesCacheHead = entry;
+        }
+        ret = xmlSecBufferAppend(key, entry->nameKey, (xmlSecSize)xmlStrlen(entry->nameKey));
+        xmlMutexUnlock(ctx->cacheMutex);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            return(-1);
+        }
+        return(0);
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    entry = (xmlSecOpenSSLX509NamesCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509NamesCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509NamesCacheEntry), NULL);
+        return(-1);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509NamesCacheEntry));
+    entry->name = xmlStrdup(str);
+    if(entry->name == NULL) {
+        xmlSecStrdupError(str, NULL);
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        return(-1);
+    }
+
+    nm = xmlSecOpenSSLX509NameRead(entry->name, xmlStrlen(entry->name));
+    if(nm == NULL) {
+        xmlSecInternalError2("xmlSecOpenSSLX509NameRead", NULL,
+                             "name=%s", xmlSecErrorsSafeString(str));
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        return(-1);
+    }
+    pos = xmlSecBufferGetSize(key);
+    ret = xmlSecOpenSSLX509IndexKeyAppendName(key, nm);
+    X509_NAME_free(nm);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexKeyAppendName", NULL);
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        return(-1);
+    }
+    entry->nameKey = xmlStrndup(xmlSecBufferGetData(key) + pos, (int)(xmlSecBufferGetSize(key) - pos));
+    if(entry->nameKey == NULL) {
+        xmlSecStrdupError(xmlSecBufferGetData(key) + pos, NULL);
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        return(-1);
+    }
+
+    xmlMutexLock(ctx->cacheMutex);
+    if(xmlHashAddEntry(ctx->namesCacheIndex, entry->name, entry) < 0) {
+        /* somebody else added it already */
+        xmlMutexUnlock(ctx->cacheMutex);
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        return(0);
+    }
+    entry->next = ctx->namesCacheHead;
+    if(ctx->namesCacheHead != NULL) {
+        ctx->namesCacheHead->prev = entry;
+    } else {
+        ctx->namesCacheTail = entry;
+    }
+    ctx->namesCacheHead = entry;
+    ++ctx->namesCacheSize;
+
+    while((ctx->namesCacheSize > XMLSEC_OPENSSL_X509_NAMES_CACHE_SIZE) && (ctx->namesCacheTail != NULL)) {
+        /* evict least recently used */
+        entry = ctx->namesCacheTail;
+        ctx->namesCacheTail = entry->prev;
+        if(entry->prev != NULL) {
+            entry->prev->next = NULL;
+        } else {
+            ctx->namesCacheHead = NULL;
+        }
+        (void)xmlHashRemoveEntry(ctx->namesCacheIndex, entry->name, NULL);
+        xmlSecOpenSSLX509NamesCacheEntryDestroy(entry);
+        --ctx->namesCacheSize;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    return(0);
+}
+
+#ifndef OPENSSL_NO_OCSP
+static void
+xmlSecOpenSSLX509OcspCacheFlush(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509OcspCacheEntryPtr entry;
+
+    xmlSecAssert(ctx != NULL);
+
+    while(ctx->ocspCacheHead != NULL) {
+        entry = ctx->ocspCacheHead;
+        ctx->ocspCacheHead = entry->next;
+        OCSP_BASICRESP_free(entry->bs);
+        xmlFree(entry);
+    }
+    ctx->ocspCacheTail = NULL;
+    ctx->ocspCacheSize = 0;
+}
+
+/* called with the cache mutex held */
+static void
+xmlSecOpenSSLX509OcspCacheUnlink(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecOpenSSLX509OcspCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        ctx->ocspCacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        ctx->ocspCacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+    --ctx->ocspCacheSize;
+}
+
+/* called with the cache mutex held */
+static void
+xmlSecOpenSSLX509OcspCacheLink(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecOpenSSLX509OcspCacheEntryPtr entry) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = ctx->ocspCacheHead;
+    if(ctx->ocspCacheHead != NULL) {
+        ctx->ocspCacheHead->prev = entry;
+    } else {
+        ctx->ocspCacheTail = entry;
+    }
+    ctx->ocspCacheHead = entry;
+    ++ctx->ocspCacheSize;
+}
+
+/* takes the ownership of @bs on success */
+static int
+xmlSecOpenSSLX509OcspCacheAdd(xmlSecOpenSSLX509StoreCtxPtr ctx, OCSP_BASICRESP* bs, int verified) {
+    xmlSecOpenSSLX509OcspCacheEntryPtr entry;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(bs != NULL, -1);
+
+    entry = (xmlSecOpenSSLX509OcspCacheEntryPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509OcspCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509OcspCacheEntry), NULL);
+        return(-1);
+    }
+    memset(entry, 0, sizeof(xmlSecOpenSSLX509OcspCacheEntry));
+    entry->bs = bs;
+    entry->verified = verified;
+
+    xmlMutexLock(ctx->cacheMutex);
+    xmlSecOpenSSLX509OcspCacheLink(ctx, entry);
+    while((ctx->ocspCacheSize > XMLSEC_OPENSSL_X509_OCSP_CACHE_SIZE) && (ctx->ocspCacheTail != NULL)) {
+        /* evict least recently used */
+        entry = ctx->ocspCacheTail;
+        xmlSecOpenSSLX509OcspCacheUnlink(ctx, entry);
+        OCSP_BASICRESP_free(entry->bs);
+        xmlFree(entry);
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(0);
+}
+
+/* the response is valid at @t if thisUpdate <= t <= nextUpdate (or thisUpdate is recent) */
+static int
+xmlSecOpenSSLX509OcspCheckTime(ASN1_GENERALIZEDTIME* thisUpdate, ASN1_GENERALIZEDTIME* nextUpdate, time_t t) {
+    time_t tt;
+
+    xmlSecAssert2(thisUpdate != NULL, 0);
+
+    tt = t + XMLSEC_OPENSSL_X509_OCSP_LEEWAY;
+    if(X509_cmp_time(thisUpdate, &tt) >= 0) {
+        return(0);
+    }
+    tt = t - XMLSEC_OPENSSL_X509_OCSP_LEEWAY;
+    if(nextUpdate != NULL) {
+        return((X509_cmp_time(nextUpdate, &tt) > 0) ? 1 : 0);
+    }
+    return((X509_cmp_time(thisUpdate, &tt) > 0) ? 1 : 0);
+}
+
+static int
+xmlSecOpenSSLX509OcspCacheFind(xmlSecOpenSSLX509StoreCtxPtr ctx, STACK_OF(X509)* chain,
+                               OCSP_CERTID* id, time_t t, int* status,
+                               const xmlChar* storeName) {
+    xmlSecOpenSSLX509OcspCacheEntryPtr entry, next;
+    ASN1_GENERALIZEDTIME* thisUpdate;
+    ASN1_GENERALIZEDTIME* nextUpdate;
+    int reason;
+    int res = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(chain != NULL, -1);
+    xmlSecAssert2(id != NULL, -1);
+    xmlSecAssert2(status != NULL, -1);
+
+    xmlMutexLock(ctx->cacheMutex);
+    for(entry = ctx->ocspCacheHead; entry != NULL; entry = next) {
+        next = entry->next;
+
+        thisUpdate = nextUpdate = NULL;
+        if(OCSP_resp_find_status(entry->bs, id, status, &reason, NULL, &thisUpdate, &nextUpdate) != 1) {
+            continue;
+        }
+        if(xmlSecOpenSSLX509OcspCheckTime(thisUpdate, nextUpdate, t) != 1) {
+            continue;
+        }
+        if(entry->verified == 0) {
+            if(OCSP_basic_verify(entry->bs, chain, ctx->xst, 0) <= 0) {
+                /* forget the bad response */
+                xmlSecOpenSSLError("OCSP_basic_verify", storeName);
+                xmlSecOpenSSLX509OcspCacheUnlink(ctx, entry);
+                OCSP_BASICRESP_free(entry->bs);
+                xmlFree(entry);
+                continue;
+            }
+            entry->verified = 1;
+        }
+
+        /* most recently used goes first */
+        xmlSecOpenSSLX509OcspCacheUnlink(ctx, entry);
+        xmlSecOpenSSLX509OcspCacheLink(ctx, entry);
+        res = 1;
+        break;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(res);
+}
+
+static OCSP_BASICRESP*
+xmlSecOpenSSLX509OcspResponseRead(const xmlSecByte* data, xmlSecSize dataSize, const xmlChar* storeName) {
+    const unsigned char* p;
+    OCSP_RESPONSE* resp;
+    OCSP_BASICRESP* bs;
+    int status;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(dataSize > 0, NULL);
+
+    p = data;
+    resp = d2i_OCSP_RESPONSE(NULL, &p, (long)dataSize);
+    if(resp == NULL) {
+        xmlSecOpenSSLError2("d2i_OCSP_RESPONSE", storeName,
+                            "size=%lu", (unsigned long)dataSize);
+        return(NULL);
+    }
+    status = OCSP_response_status(resp);
+    if(status != OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_DATA, storeName,
+                          "OCSP response status=%s", OCSP_response_status_str(status));
+        OCSP_RESPONSE_free(resp);
+        return(NULL);
+    }
+    bs = OCSP_response_get1_basic(resp);
+    OCSP_RESPONSE_free(resp);
+    if(bs == NULL) {
+        xmlSecOpenSSLError("OCSP_response_get1_basic", storeName);
+        return(NULL);
+    }
+    return(bs);
+}
+
+/* RFC 6960 Appendix A.1: GET {url}/{url-encoding of base-64 encoding of the DER request} */
+static xmlChar*
+xmlSecOpenSSLX509OcspRequestUri(const char* url, OCSP_CERTID* id) {
+    OCSP_REQUEST* req;
+    OCSP_CERTID* reqId;
+    unsigned char* der = NULL;
+    int derLen;
+    xmlChar* b64;
+    xmlChar* res;
+    xmlChar* p;
+    xmlChar* q;
+    size_t size;
+
+    xmlSecAssert2(url != NULL, NULL);
+    xmlSecAssert2(id != NULL, NULL);
+
+    req = OCSP_REQUEST_new();
+    if(req == NULL) {
+        xmlSecOpenSSLError("OCSP_REQUEST_new", NULL);
+        return(NULL);
+    }
+    reqId = OCSP_CERTID_dup(id);
+    if(reqId == NULL) {
+        xmlSecOpenSSLError("OCSP_CERTID_dup", NULL);
+        OCSP_REQUEST_free(req);
+        return(NULL);
+    }
+    if(OCSP_request_add0_id(req, reqId) == NULL) {
+        xmlSecOpenSSLError("OCSP_request_add0_id", NULL);
+        OCSP_CERTID_free(reqId);
+        OCSP_REQUEST_free(req);
+        return(NULL);
+    }
+    derLen = i2d_OCSP_REQUEST(req, &der);
+    OCSP_REQUEST_free(req);
+    if((derLen <= 0) || (der == NULL)) {
+        xmlSecOpenSSLError("i2d_OCSP_REQUEST", NULL);
+        return(NULL);
+    }
+
+    b64 = xmlSecBase64Encode(der, (xmlSecSize)derLen, 0);
+    OPENSSL_free(der);
+    if(b64 == NULL) {
+        xmlSecInternalError("xmlSecBase64Encode", NULL);
+        return(NULL);
+    }
+
+    /* '+', '/' and '=' are escaped: up to 3 chars for every base64 char */
+    size = strlen(url) + 1 + 3 * (size_t)xmlStrlen(b64) + 1;
+    res = (xmlChar*)xmlMalloc(size);
+    if(res == NULL) {
+        xmlSecMallocError(size, NULL);
+        xmlFree(b64);
+        return(NULL);
+    }
+    q = res;
+    for(p = BAD_CAST url; (*p) != '\0'; ++p) {
+        (*q++) = (*p);
+    }
+    if((q == res) || (q[-1] != '/')) {
+        (*q++) = '/';
+    }
+    for(p = b64; (*p) != '\0'; ++p) {
+        switch(*p) {
+        case '+':
+            (*q++) = '%'; (*q++) = '2'; (*q++) = 'B';
+            break;
+        case '/':
+            (*q++) = '%'; (*q++) = '2'; (*q++) = 'F';
+            break;
+        case '=':
+            (*q++) = '%'; (*q++) = '3'; (*q++) = 'D';
+            break;
+        default:
+            (*q++) = (*p);
+            break;
+        }
+    }
+    (*q) = '\0';
+    xmlFree(b64);
+    return(res);
+}
+
+/* requests the cert status from the responder in the cert AIA extension */
+static int
+xmlSecOpenSSLX509OcspFetch(xmlSecOpenSSLX509StoreCtxPtr ctx, X509* cert, STACK_OF(X509)* chain,
+                           OCSP_CERTID* id, const xmlChar* storeName) {
+    STACK_OF(OPENSSL_STRING)* urls;
+    const char* url = NULL;
+    xmlChar* uri;
+    xmlSecTransformCtx transformCtx;
+    OCSP_BASICRESP* bs;
+    int ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(chain != NULL, -1);
+    xmlSecAssert2(id != NULL, -1);
+
+    urls = X509_get1_ocsp(cert);
+    for(ii = 0; (urls != NULL) && (ii < sk_OPENSSL_STRING_num(urls)); ++ii) {
+        url = sk_OPENSSL_STRING_value(urls, ii);
+        if((xmlStrncasecmp(BAD_CAST url, BAD_CAST "http://", 7) == 0) ||
+           (xmlStrncasecmp(BAD_CAST url, BAD_CAST "https://", 8) == 0)) {
+            break;
+        }
+        url = NULL;
+    }
+    if(url == NULL) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_CERT_VERIFY_FAILED, storeName,
+                         "no OCSP responder in the certificate");
+        X509_email_free(urls);
+        return(-1);
+    }
+
+    uri = xmlSecOpenSSLX509OcspRequestUri(url, id);
+    X509_email_free(urls);
+    if(uri == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509OcspRequestUri", storeName);
+        return(-1);
+    }
+
+    /* the response is read with the registered I/O callbacks */
+    ret = xmlSecTransformCtxInitialize(&transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxInitialize", storeName);
+        xmlFree(uri);
+        return(-1);
+    }
+    ret = xmlSecTransformCtxUriExecute(&transformCtx, uri);
+    if((ret < 0) || (transformCtx.result == NULL) || (xmlSecBufferGetSize(transformCtx.result) == 0)) {
+        xmlSecInternalError2("xmlSecTransformCtxUriExecute", storeName,
+                             "uri=%s", xmlSecErrorsSafeString(uri));
+        xmlSecTransformCtxFinalize(&transformCtx);
+        xmlFree(uri);
+        return(-1);
+    }
+    xmlFree(uri);
+
+    bs = xmlSecOpenSSLX509OcspResponseRead(xmlSecBufferGetData(transformCtx.result),
+                                           xmlSecBufferGetSize(transformCtx.result),
+                                           storeName);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    if(bs == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509OcspResponseRead", storeName);
+        return(-1);
+    }
+
+    if(OCSP_basic_verify(bs, chain, ctx->xst, 0) <= 0) {
+        xmlSecOpenSSLError("OCSP_basic_verify", storeName);
+        OCSP_BASICRESP_free(bs);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509OcspCacheAdd(ctx, bs, 1);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509OcspCacheAdd", storeName);
+        OCSP_BASICRESP_free(bs);
+        return(-1);
+    }
+    return(0);
+}
+
+/* returns 1 if the status is found, 0 if not found or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509OcspCertStatus(xmlSecOpenSSLX509StoreCtxPtr ctx, STACK_OF(X509)* chain,
+                                X509* cert, X509* issuer, time_t t, int fetch,
+                                int* status, const xmlChar* storeName) {
+    OCSP_CERTID* id;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(issuer != NULL, -1);
+    xmlSecAssert2(status != NULL, -1);
+
+    /* the responses might use SHA256 for the cert ids */
+    id = OCSP_cert_to_id(EVP_sha256(), cert, issuer);
+    if(id == NULL) {
+        xmlSecOpenSSLError("OCSP_cert_to_id", storeName);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509OcspCacheFind(ctx, chain, id, t, status, storeName);
+    OCSP_CERTID_free(id);
+    if(ret != 0) {
+        return(ret);
+    }
+
+    /* SHA1 is the default */
+    id = OCSP_cert_to_id(NULL, cert, issuer);
+    if(id == NULL) {
+        xmlSecOpenSSLError("OCSP_cert_to_id", storeName);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509OcspCacheFind(ctx, chain, id, t, status, storeName);
+    if((ret == 0) && (fetch != 0)) {
+        /* a failed request means the status is unknown */
+        if(xmlSecOpenSSLX509OcspFetch(ctx, cert, chain, id, storeName) == 0) {
+            ret = xmlSecOpenSSLX509OcspCacheFind(ctx, chain, id, t, status, storeName);
+        }
+    }
+    OCSP_CERTID_free(id);
+    return(ret);
+}
+
+/* returns 1 if all the chain certs are good, 0 if not or a negative value if an error occurs */
+static int
+xmlSecOpenSSLX509StoreVerifyOcsp(xmlSecOpenSSLX509StoreCtxPtr ctx, STACK_OF(X509)* chain,
+                                 xmlSecKeyInfoCtx* keyInfoCtx, X509** badCert, int* err,
+                                 const xmlChar* storeName) {
+    X509* cert;
+    X509* issuer;
+    char subject[256];
+    time_t t;
+    int fetch;
+    int status;
+    int ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(chain != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(badCert != NULL, -1);
+    xmlSecAssert2(err != NULL, -1);
+
+    t = (keyInfoCtx->certsVerificationTime > 0) ? keyInfoCtx->certsVerificationTime : time(NULL);
+    fetch = ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_OCSP_FETCH) != 0) ? 1 : 0;
+
+    /* the last cert is the trust anchor */
+    for(ii = 0; ii + 1 < sk_X509_num(chain); ++ii) {
+        cert = sk_X509_value(chain, ii);
+        issuer = sk_X509_value(chain, ii + 1);
+
+        status = V_OCSP_CERTSTATUS_UNKNOWN;
+        ret = xmlSecOpenSSLX509OcspCertStatus(ctx, chain, cert, issuer, t, fetch, &status, storeName);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509OcspCertStatus", storeName);
+            return(-1);
+        }
+        if((ret == 1) && (status == V_OCSP_CERTSTATUS_GOOD)) {
+            continue;
+        }
+
+        X509_NAME_oneline(X509_get_subject_name(cert), subject, sizeof(subject));
+        if(status == V_OCSP_CERTSTATUS_REVOKED) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_CERT_REVOKED, storeName,
+                              "subject=%s", subject);
+            (*err) = X509_V_ERR_CERT_REVOKED;
+        } else {
+            xmlSecOtherError3(XMLSEC_ERRORS_R_CERT_VERIFY_FAILED, storeName,
+                              "subject=%s; OCSP status=%s", subject,
+                              (ret == 1) ? OCSP_cert_status_str(status) : "no response");
+            (*err) = X509_V_ERR_APPLICATION_VERIFICATION;
+        }
+        (*badCert) = cert;
+        return(0);
+    }
+    return(1);
+}
+#endif /* OPENSSL_NO_OCSP */
+
+/* the verified CRLs are remembered until the store changes */
+static int
+xmlSecOpenSSLX509StoreVerifyCRL(xmlSecOpenSSLX509StoreCtxPtr ctx, X509_CRL *crl) {
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen;
+    xmlSecSize ii;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xst != NULL, -1);
+    xmlSecAssert2(ctx->cacheMutex != NULL, -1);
+    xmlSecAssert2(crl != NULL, -1);
+
+    memset(md, 0, sizeof(md));
+    ret = X509_CRL_digest(crl, EVP_sha256(), md, &mdLen);
+    if(ret != 1) {
+        xmlSecOpenSSLError("X509_CRL_digest", NULL);
+        return(-1);
+    }
+
+    xmlMutexLock(ctx->cacheMutex);
+    for(ii = 0; ii < ctx->verifiedCrlsNum; ++ii) {
+        if(memcmp(ctx->verifiedCrls[ii], md, sizeof(md)) == 0) {
+            xmlMutexUnlock(ctx->cacheMutex);
+            return(1);
+        }
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+
+    ret = xmlSecOpenSSLX509VerifyCRL(ctx->xst, crl);
+    if(ret != 1) {
+        return(ret);
+    }
+
+    xmlMutexLock(ctx->cacheMutex);
+    memcpy(ctx->verifiedCrls[ctx->verifiedCrlsPos], md, sizeof(md));
+    ctx->verifiedCrlsPos = (ctx->verifiedCrlsPos + 1) % XMLSEC_OPENSSL_X509_VERIFIED_CRLS_CACHE_SIZE;
+    if(ctx->verifiedCrlsNum < XMLSEC_OPENSSL_X509_VERIFIED_CRLS_CACHE_SIZE) {
+        ++ctx->verifiedCrlsNum;
+    }
+    xmlMutexUnlock(ctx->cacheMutex);
+    return(1);
+}
+
+static int
+xmlSecOpenSSLX509StoreVerifyCertAgainstCrls(xmlSecOpenSSLX509StoreCtxPtr ctx, X509* cert) {
+    xmlSecBufferPtr key;
+    X509_CRL *crl;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->crls != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    if(ctx->crlsIndex == NULL) {
+        return(xmlSecOpenSSLX509VerifyCertAgainstCrls(ctx->crls, cert));
+    }
+    if(sk_X509_CRL_num(ctx->crls) <= 0) {
+        /* no crls at all */
+        return(1);
     }
-    X509_STORE_CTX_free(xsc);
-    X509_OBJECT_free(xobj);
-    return((ret == 1) ? 1 : 0);
 
-err:
-    X509_STORE_CTX_free(xsc);
-    X509_OBJECT_free(xobj);
-    return(-1);
+    key = xmlSecBufferCreate(256);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509IndexKeyBuild(key, "c:", X509_get_issuer_name(cert), NULL, NULL, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexKeyBuild", NULL);
+        xmlSecBufferDestroy(key);
+        return(-1);
+    }
+    crl = (X509_CRL*)xmlHashLookup(ctx->crlsIndex, xmlSecBufferGetData(key));
+    xmlSecBufferDestroy(key);
+
+    if(crl == NULL) {
+        /* no crls for this issuer */
+        return(1);
+    }
+    return(xmlSecOpenSSLX509VerifyCertAgainstCrl(crl, cert));
 }
 
 static X509*
@@ -820,20 +2752,429 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
     return(NULL);
 }
 
+/*
+ * The certs index keys are strings built from the same data the
+ * xmlSecOpenSSLX509FindCert() compares: the sorted name entries (object
+ * and value), the serial number and the SKI value. Two names are mapped
+ * to the same key if and only if xmlSecOpenSSLX509NamesCompare() returns 0.
+ */
+static int
+xmlSecOpenSSLX509IndexKeyAppendHex(xmlSecBufferPtr key, const xmlSecByte *data, xmlSecSize size) {
+    static const char hex[] = "0123456789abcdef";
+    xmlSecByte *p;
+    xmlSecSize pos, ii;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2((data != NULL) || (size == 0), -1);
+
+    pos = xmlSecBufferGetSize(key);
+    ret = xmlSecBufferSetSize(key, pos + 2 * size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetSize", NULL,
+                             "size=%d", (int)(pos + 2 * size));
+        return(-1);
+    }
+    p = xmlSecBufferGetData(key) + pos;
+    for(ii = 0; ii < size; ++ii) {
+        (*p++) = hex[(data[ii] >> 4) & 0x0F];
+        (*p++) = hex[data[ii] & 0x0F];
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509IndexKeyAppendName(xmlSecBufferPtr key, X509_NAME *nm) {
+    STACK_OF(X509_NAME_ENTRY) *entries;
+    X509_NAME_ENTRY *entry;
+    ASN1_STRING *value;
+    char oid[128];
+    int len;
+    int ii;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(nm != NULL, -1);
+
+    entries = xmlSecOpenSSLX509_NAME_ENTRIES_copy(nm);
+    if(entries == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
+        return(-1);
+    }
+    (void)sk_X509_NAME_ENTRY_set_cmp_func(entries, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
+    sk_X509_NAME_ENTRY_sort(entries);
+
+    for(ii = 0; ii < sk_X509_NAME_ENTRY_num(entries); ++ii) {
+        entry = sk_X509_NAME_ENTRY_value(entries, ii);
+
+        len = OBJ_obj2txt(oid, sizeof(oid), X509_NAME_ENTRY_get_object(entry), 1);
+        if((len < 0) || (len >= (int)sizeof(oid))) {
+            xmlSecOpenSSLError("OBJ_obj2txt", NULL);
+            sk_X509_NAME_ENTRY_free(entries);
+            return(-1);
+        }
+        ret = xmlSecBufferAppend(key, (const xmlSecByte*)oid, (xmlSecSize)len);
+        if(ret >= 0) {
+            ret = xmlSecBufferAppend(key, BAD_CAST "=", 1);
+        }
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            sk_X509_NAME_ENTRY_free(entries);
+            return(-1);
+        }
+
+        value = X509_NAME_ENTRY_get_data(entry);
+        if((value != NULL) && (ASN1_STRING_length(value) > 0)) {
+            ret = xmlSecOpenSSLX509IndexKeyAppendHex(key, ASN1_STRING_get0_data(value),
+                                                     (xmlSecSize)ASN1_STRING_length(value));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLX509IndexKeyAppendHex", NULL);
+                sk_X509_NAME_ENTRY_free(entries);
+                return(-1);
+            }
+        }
+        ret = xmlSecBufferAppend(key, BAD_CAST ";", 1);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            sk_X509_NAME_ENTRY_free(entries);
+            return(-1);
+        }
+    }
+
+    sk_X509_NAME_ENTRY_free(entries);
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509IndexKeyAppendSerial(xmlSecBufferPtr key, const ASN1_INTEGER *serial) {
+    BIGNUM *bn;
+    char *str;
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(serial != NULL, -1);
+
+    bn = ASN1_INTEGER_to_BN(serial, NULL);
+    if(bn == NULL) {
+        xmlSecOpenSSLError("ASN1_INTEGER_to_BN", NULL);
+        return(-1);
+    }
+    str = BN_bn2hex(bn);
+    BN_free(bn);
+    if(str == NULL) {
+        xmlSecOpenSSLError("BN_bn2hex", NULL);
+        return(-1);
+    }
+    ret = xmlSecBufferAppend(key, (const xmlSecByte*)str, (xmlSecSize)strlen(str));
+    OPENSSL_free(str);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* the key is NULL terminated in @key buffer */
+static int
+xmlSecOpenSSLX509IndexKeyBuild(xmlSecBufferPtr key, const char *prefix, X509_NAME *nm,
+                               const ASN1_INTEGER *serial, const xmlSecByte *data,
+                               xmlSecSize dataSize) {
+    return(xmlSecOpenSSLX509IndexKeyBuildEx(NULL, key, prefix, nm, NULL, serial, data, dataSize));
+}
+
+/* the name is either @nm or @nameStr (parsed through the store names cache) */
+static int
+xmlSecOpenSSLX509IndexKeyBuildEx(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecBufferPtr key,
+                                 const char *prefix, X509_NAME *nm, const xmlChar *nameStr,
+                                 const ASN1_INTEGER *serial, const xmlSecByte *data,
+                                 xmlSecSize dataSize) {
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(prefix != NULL, -1);
+    xmlSecAssert2((nameStr == NULL) || (ctx != NULL), -1);
+
+    ret = xmlSecBufferSetData(key, (const xmlSecByte*)prefix, (xmlSecSize)strlen(prefix));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetData", NULL);
+        return(-1);
+    }
+    if(nm != NULL) {
+        ret = xmlSecOpenSSLX509IndexKeyAppendName(key, nm);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexKeyAppendName", NULL);
+            return(-1);
+        }
+    } else if(nameStr != NULL) {
+        ret = xmlSecOpenSSLX509NamesCacheAppendName(ctx, key, nameStr);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509NamesCacheAppendName", NULL);
+            return(-1);
+        }
+    }
+    if(serial != NULL) {
+        ret = xmlSecOpenSSLX509IndexKeyAppendSerial(key, serial);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexKeyAppendSerial", NULL);
+            return(-1);
+        }
+    }
+    if(data != NULL) {
+        ret = xmlSecOpenSSLX509IndexKeyAppendHex(key, data, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexKeyAppendHex", NULL);
+            return(-1);
+        }
+    }
+    ret = xmlSecBufferAppend(key, BAD_CAST "", 1);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* the first cert added for a key wins, same as in the linear search */
+static int
+xmlSecOpenSSLX509IndexAddEntry(xmlHashTablePtr index, xmlSecBufferPtr key, X509 *cert) {
+    const xmlChar *name;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    name = xmlSecBufferGetData(key);
+    if(xmlHashLookup(index, name) != NULL) {
+        return(0);
+    }
+    ret = xmlHashAddEntry(index, name, cert);
+    if(ret < 0) {
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509IndexAddCert(xmlHashTablePtr index, X509 *cert) {
+    xmlSecBufferPtr key;
+    X509_EXTENSION *ext;
+    ASN1_OCTET_STRING *keyId;
+    int pos;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    key = xmlSecBufferCreate(256);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(-1);
+    }
+
+    /* subject */
+    ret = xmlSecOpenSSLX509IndexKeyBuild(key, "s:", X509_get_subject_name(cert), NULL, NULL, 0);
+    if((ret < 0) || (xmlSecOpenSSLX509IndexAddEntry(index, key, cert) < 0)) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexAddEntry(subject)", NULL);
+        xmlSecBufferDestroy(key);
+        return(-1);
+    }
+
+    /* issuer and serial */
+    ret = xmlSecOpenSSLX509IndexKeyBuild(key, "i:", X509_get_issuer_name(cert),
+                                         X509_get_serialNumber(cert), NULL, 0);
+    if((ret < 0) || (xmlSecOpenSSLX509IndexAddEntry(index, key, cert) < 0)) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexAddEntry(issuer)", NULL);
+        xmlSecBufferDestroy(key);
+        return(-1);
+    }
+
+    /* ski (if any) */
+    pos = X509_get_ext_by_NID(cert, NID_subject_key_identifier, -1);
+    if((pos >= 0) && ((ext = X509_get_ext(cert, pos)) != NULL)) {
+        keyId = X509V3_EXT_d2i(ext);
+        if(keyId != NULL) {
+            ret = xmlSecOpenSSLX509IndexKeyBuild(key, "k:", NULL, NULL,
+                        keyId->data, (xmlSecSize)keyId->length);
+            ASN1_OCTET_STRING_free(keyId);
+            if((ret < 0) || (xmlSecOpenSSLX509IndexAddEntry(index, key, cert) < 0)) {
+                xmlSecInternalError("xmlSecOpenSSLX509IndexAddEntry(ski)", NULL);
+                xmlSecBufferDestroy(key);
+                return(-1);
+            }
+        }
+    }
+
+    xmlSecBufferDestroy(key);
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509IndexAddCrl(xmlHashTablePtr index, X509_CRL *crl) {
+    xmlSecBufferPtr key;
+    const xmlChar *name;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(crl != NULL, -1);
+
+    key = xmlSecBufferCreate(256);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509IndexKeyBuild(key, "c:", X509_CRL_get_issuer(crl), NULL, NULL, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexKeyBuild", NULL);
+        xmlSecBufferDestroy(key);
+        return(-1);
+    }
+
+    /* the first crl for the issuer wins, same as in the linear search */
+    name = xmlSecBufferGetData(key);
+    if(xmlHashLookup(index, name) == NULL) {
+        ret = xmlHashAddEntry(index, name, crl);
+        if(ret < 0) {
+            xmlSecXmlError("xmlHashAddEntry", NULL);
+            xmlSecBufferDestroy(key);
+            return(-1);
+        }
+    }
+    xmlSecBufferDestroy(key);
+    return(0);
+}
+
 static X509*
-xmlSecOpenSSLX509FindNextChainCert(STACK_OF(X509) *chain, X509 *cert) {
-    unsigned long certSubjHash;
+xmlSecOpenSSLX509IndexFindCert(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlChar *subjectName,
+                               xmlChar *issuerName, xmlChar *issuerSerial,
+                               xmlChar *ski) {
+    xmlSecBufferPtr key;
+    X509 *cert = NULL;
+    int ret = -1;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->untrustedIndex != NULL, NULL);
+
+    key = xmlSecBufferCreate(256);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(NULL);
+    }
+
+    if(subjectName != NULL) {
+        ret = xmlSecOpenSSLX509IndexKeyBuildEx(ctx, key, "s:", NULL, subjectName, NULL, NULL, 0);
+    } else if((issuerName != NULL) && (issuerSerial != NULL)) {
+        BIGNUM *bn = NULL;
+        ASN1_INTEGER *serial;
+
+        if(BN_dec2bn(&bn, (char*)issuerSerial) == 0) {
+            xmlSecOpenSSLError("BN_dec2bn", NULL);
+            BN_free(bn);
+            xmlSecBufferDestroy(key);
+            return(NULL);
+        }
+        serial = BN_to_ASN1_INTEGER(bn, NULL);
+        BN_free(bn);
+        if(serial == NULL) {
+            xmlSecOpenSSLError("BN_to_ASN1_INTEGER", NULL);
+            xmlSecBufferDestroy(key);
+            return(NULL);
+        }
+        ret = xmlSecOpenSSLX509IndexKeyBuildEx(ctx, key, "i:", NULL, issuerName, serial, NULL, 0);
+        ASN1_INTEGER_free(serial);
+    } else if(ski != NULL) {
+        int len;
+
+        /* our usual trick with base64 decode */
+        len = xmlSecBase64Decode(ski, (xmlSecByte*)ski, xmlStrlen(ski));
+        if(len < 0) {
+            xmlSecInternalError2("xmlSecBase64Decode", NULL,
+                                 "ski=%s", xmlSecErrorsSafeString(ski));
+            xmlSecBufferDestroy(key);
+            return(NULL);
+        }
+        ret = xmlSecOpenSSLX509IndexKeyBuild(key, "k:", NULL, NULL, (xmlSecByte*)ski, (xmlSecSize)len);
+    } else {
+        /* nothing to search for */
+        xmlSecBufferDestroy(key);
+        return(NULL);
+    }
+
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexKeyBuild", NULL);
+        xmlSecBufferDestroy(key);
+        return(NULL);
+    }
+
+    cert = (X509*)xmlHashLookup(ctx->untrustedIndex, xmlSecBufferGetData(key));
+    xmlSecBufferDestroy(key);
+    return(cert);
+}
+
+static int
+xmlSecOpenSSLX509IssuerHashCompare(const void *a, const void *b) {
+    const xmlSecOpenSSLX509IssuerHash *ha = (const xmlSecOpenSSLX509IssuerHash *)a;
+    const xmlSecOpenSSLX509IssuerHash *hb = (const xmlSecOpenSSLX509IssuerHash *)b;
+
+    if(ha->hash < hb->hash) {
+        return(-1);
+    } else if(ha->hash > hb->hash) {
+        return(1);
+    }
+    return(0);
+}
+
+static xmlSecOpenSSLX509IssuerHashPtr
+xmlSecOpenSSLX509IssuerHashesCreate(STACK_OF(X509) *certs) {
+    xmlSecOpenSSLX509IssuerHashPtr res;
+    size_t size;
     int i;
 
-    xmlSecAssert2(chain != NULL, NULL);
+    xmlSecAssert2(certs != NULL, NULL);
+
+    /* allocate at least one entry to distinguish empty stack from an error */
+    size = sizeof(xmlSecOpenSSLX509IssuerHash) * (sk_X509_num(certs) + 1);
+    res = (xmlSecOpenSSLX509IssuerHashPtr)xmlMalloc(size);
+    if(res == NULL) {
+        xmlSecMallocError(size, NULL);
+        return(NULL);
+    }
+    for(i = 0; i < sk_X509_num(certs); ++i) {
+        res[i].cert = sk_X509_value(certs, i);
+        res[i].hash = X509_issuer_name_hash(res[i].cert);
+    }
+    qsort(res, sk_X509_num(certs), sizeof(xmlSecOpenSSLX509IssuerHash),
+          xmlSecOpenSSLX509IssuerHashCompare);
+    return(res);
+}
+
+static X509*
+xmlSecOpenSSLX509FindNextChainCert(xmlSecOpenSSLX509IssuerHashPtr issuerHashes,
+                                   int issuerHashesSize, X509 *cert) {
+    unsigned long certSubjHash;
+    int lo, hi, mid;
+
+    xmlSecAssert2(issuerHashes != NULL, NULL);
     xmlSecAssert2(cert != NULL, NULL);
 
+    /* find the first entry with the cert subject hash */
     certSubjHash = X509_subject_name_hash(cert);
-    for(i = 0; i < sk_X509_num(chain); ++i) {
-        if((sk_X509_value(chain, i) != cert) &&
-           (X509_issuer_name_hash(sk_X509_value(chain, i)) == certSubjHash)) {
+    lo = 0;
+    hi = issuerHashesSize;
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(issuerHashes[mid].hash < certSubjHash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
 
-            return(sk_X509_value(chain, i));
+    /* skip self-signed cert */
+    for(; (lo < issuerHashesSize) && (issuerHashes[lo].hash == certSubjHash); ++lo) {
+        if(issuerHashes[lo].cert != cert) {
+            return(issuerHashes[lo].cert);
         }
     }
     return(NULL);
@@ -843,9 +3184,7 @@ static int
 xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
     X509_NAME *issuer;
     X509_CRL *crl = NULL;
-    X509_REVOKED *revoked;
     int i, n;
-    int ret;
 
     xmlSecAssert2(crls != NULL, -1);
     xmlSecAssert2(cert != NULL, -1);
@@ -871,6 +3210,17 @@ xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
         return(1);
     }
 
+    return(xmlSecOpenSSLX509VerifyCertAgainstCrl(crl, cert));
+}
+
+static int
+xmlSecOpenSSLX509VerifyCertAgainstCrl(X509_CRL *crl, X509* cert) {
+    X509_REVOKED *revoked = NULL;
+    int ret;
+
+    xmlSecAssert2(crl != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
     /*
      * Check date of CRL to make sure it's not expired
      */
@@ -881,15 +3231,13 @@ xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
     }
 
     /*
-     * Check if the current certificate is revoked by this CRL
+     * Check if the current certificate is revoked by this CRL: OpenSSL
+     * sorts the revoked entries once and then uses the binary search
      */
-    n = sk_X509_REVOKED_num(X509_CRL_get_REVOKED(crl));
-    for (i = 0; i < n; i++) {
-        revoked = sk_X509_REVOKED_value(X509_CRL_get_REVOKED(crl), i);
-        if (ASN1_INTEGER_cmp(X509_REVOKED_get0_serialNumber(revoked), X509_get_serialNumber(cert)) == 0) {
-            xmlSecOtherError(XMLSEC_ERRORS_R_CERT_REVOKED, NULL, NULL);
-            return(0);
-        }
+    ret = X509_CRL_get0_by_serial(crl, &revoked, X509_get_serialNumber(cert));
+    if(ret == 1) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_CERT_REVOKED, NULL, NULL);
+        return(0);
     }
     return(1);
 }
@@ -1049,73 +3397,68 @@ xmlSecOpenSSLX509_NAME_ENTRIES_copy(X509_NAME * a) {
     return (res);
 }
 
-static
-int xmlSecOpenSSLX509_NAME_ENTRIES_cmp(STACK_OF(X509_NAME_ENTRY)* a,  STACK_OF(X509_NAME_ENTRY)* b) {
-    const X509_NAME_ENTRY *na;
-    const X509_NAME_ENTRY *nb;
-    int ii, ret;
-
-    xmlSecAssert2(a != NULL, -1);
-    xmlSecAssert2(b != NULL, 1);
-
-    if (sk_X509_NAME_ENTRY_num(a) != sk_X509_NAME_ENTRY_num(b)) {
-        return sk_X509_NAME_ENTRY_num(a) - sk_X509_NAME_ENTRY_num(b);
-    }
+static int
+xmlSecOpenSSLX509_NAME_ENTRIES_count(X509_NAME *nm, const X509_NAME_ENTRY *entry) {
+    const X509_NAME_ENTRY *ne;
+    int ii, res = 0;
 
-    for (ii = sk_X509_NAME_ENTRY_num(a) - 1; ii >= 0; --ii) {
-        na = sk_X509_NAME_ENTRY_value(a, ii);
-        nb = sk_X509_NAME_ENTRY_value(b, ii);
+    xmlSecAssert2(nm != NULL, 0);
+    xmlSecAssert2(entry != NULL, 0);
 
-        ret = xmlSecOpenSSLX509_NAME_ENTRY_cmp(&na, &nb);
-        if(ret != 0) {
-            return(ret);
+    for(ii = X509_NAME_entry_count(nm) - 1; ii >= 0; --ii) {
+        ne = X509_NAME_get_entry(nm, ii);
+        if(xmlSecOpenSSLX509_NAME_ENTRY_cmp(&ne, &entry) == 0) {
+            ++res;
         }
     }
-
-    return(0);
+    return(res);
 }
 
-
 /**
  * xmlSecOpenSSLX509NamesCompare:
  *
- * We have to sort X509_NAME entries to get correct results.
- * This is ugly but OpenSSL does not support it
+ * The X509_NAME entries order doesn't matter (OpenSSL's X509_NAME_cmp()
+ * does depend on it), so the names are equal if they have the same
+ * entries the same number of times. The names are only a few entries
+ * long and the entries are compared in place instead of copying and
+ * sorting them: this is called for every candidate cert in the lookups.
+ *
+ * Returns 0 if the names are equal or a non-zero value otherwise.
  */
 static int
 xmlSecOpenSSLX509NamesCompare(X509_NAME *a, X509_NAME *b) {
-    STACK_OF(X509_NAME_ENTRY) *a1 = NULL;
-    STACK_OF(X509_NAME_ENTRY) *b1 = NULL;
-    int ret;
+    const X509_NAME_ENTRY *na;
+    const X509_NAME_ENTRY *nb;
+    int num, ii;
 
     xmlSecAssert2(a != NULL, -1);
     xmlSecAssert2(b != NULL, 1);
 
-    a1 = xmlSecOpenSSLX509_NAME_ENTRIES_copy(a);
-    if(a1 == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
-        return(-1);
-    }
-    b1 = xmlSecOpenSSLX509_NAME_ENTRIES_copy(b);
-    if(b1 == NULL) {
-        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
-        sk_X509_NAME_ENTRY_free(a1);
-        return(1);
+    num = X509_NAME_entry_count(a);
+    if(num != X509_NAME_entry_count(b)) {
+        return(num - X509_NAME_entry_count(b));
     }
 
-    /* sort both */
-    (void)sk_X509_NAME_ENTRY_set_cmp_func(a1, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
-    sk_X509_NAME_ENTRY_sort(a1);
-    (void)sk_X509_NAME_ENTRY_set_cmp_func(b1, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
-    sk_X509_NAME_ENTRY_sort(b1);
-
-    /* actually compare */
-    ret = xmlSecOpenSSLX509_NAME_ENTRIES_cmp(a1, b1);
+    /* usually the entries are in the same order */
+    for(ii = 0; ii < num; ++ii) {
+        na = X509_NAME_get_entry(a, ii);
+        nb = X509_NAME_get_entry(b, ii);
+        if(xmlSecOpenSSLX509_NAME_ENTRY_cmp(&na, &nb) != 0) {
+            break;
+        }
+    }
+    if(ii >= num) {
+        return(0);
+    }
 
-    /* cleanup */
-    sk_X509_NAME_ENTRY_free(a1);
-    sk_X509_NAME_ENTRY_free(b1);
-    return(ret);
+    /* otherwise every remaining entry should be found as many times in both */
+    for(; ii < num; ++ii) {
+        na = X509_NAME_get_entry(a, ii);
+        if(xmlSecOpenSSLX509_NAME_ENTRIES_count(a, na) != xmlSecOpenSSLX509_NAME_ENTRIES_count(b, na)) {
+            return(1);
+        }
+    }
+    return(0);
 }
 
 static int
@@ -16,6 +16,8 @@
 #include <libxml/tree.h>
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
+#include <libxml/dict.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -24,6 +26,165 @@
 #include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/parser.h>
+
+/**************************************************************************
+ *
+ * Push parser contexts pool
+ *
+ * Creating a parser context (with its dictionary, SAX handler and input
+ * stacks) costs more than parsing a small document. The push parser
+ * contexts are reset and reused instead. A document keeps a reference
+ * to the dictionary it was parsed with, so the context gets a new one
+ * when the document is handed out (the dictionaries are not thread-safe).
+ *
+ *****************************************************************************/
+/**
+ * XMLSEC_PARSER_CTXT_POOL_SIZE:
+ *
+ * The max number of idle push parser contexts kept for reuse.
+ */
+#define XMLSEC_PARSER_CTXT_POOL_SIZE                            16
+
+static xmlMutexPtr              xmlSecParserCtxtPoolMutex = NULL;
+static xmlParserCtxtPtr         xmlSecParserCtxtPool[XMLSEC_PARSER_CTXT_POOL_SIZE];
+static xmlSecSize               xmlSecParserCtxtPoolCount = 0;
+
+/**
+ * xmlSecParserCtxtPoolInitialize:
+ *
+ * Initializes the push parser contexts pool (called from #xmlSecInit).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecParserCtxtPoolInitialize(void) {
+    xmlSecAssert2(xmlSecParserCtxtPoolMutex == NULL, -1);
+
+    xmlSecParserCtxtPoolMutex = xmlNewMutex();
+    if(xmlSecParserCtxtPoolMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+    memset(xmlSecParserCtxtPool, 0, sizeof(xmlSecParserCtxtPool));
+    xmlSecParserCtxtPoolCount = 0;
+    return(0);
+}
+
+/**
+ * xmlSecParserCtxtPoolFinalize:
+ *
+ * Frees all the pooled push parser contexts (called from #xmlSecShutdown).
+ */
+void
+xmlSecParserCtxtPoolFinalize(void) {
+    while(xmlSecParserCtxtPoolCount > 0) {
+        --xmlSecParserCtxtPoolCount;
+        xmlFreeParserCtxt(xmlSecParserCtxtPool[xmlSecParserCtxtPoolCount]);
+        xmlSecParserCtxtPool[xmlSecParserCtxtPoolCount] = NULL;
+    }
+    if(xmlSecParserCtxtPoolMutex != NULL) {
+        xmlFreeMutex(xmlSecParserCtxtPoolMutex);
+        xmlSecParserCtxtPoolMutex = NULL;
+    }
+}
+
+/**
+ * xmlSecParserCtxtAcquire:
+ * @options:            the parser options (XML_PARSE_*).
+ *
+ * Gets a push parser context from the pool (or creates a new one) set
+ * up for c14n. The caller is responsible for returning it with
+ * #xmlSecParserCtxtRelease.
+ *
+ * Returns: the push parser context or NULL if an error occurs.
+ */
+xmlParserCtxtPtr
+xmlSecParserCtxtAcquire(int options) {
+    xmlParserCtxtPtr ctxt = NULL;
+
+    if(xmlSecParserCtxtPoolMutex != NULL) {
+        xmlMutexLock(xmlSecParserCtxtPoolMutex);
+        if(xmlSecParserCtxtPoolCount > 0) {
+            --xmlSecParserCtxtPoolCount;
+            ctxt = xmlSecParserCtxtPool[xmlSecParserCtxtPoolCount];
+            xmlSecParserCtxtPool[xmlSecParserCtxtPoolCount] = NULL;
+        }
+        xmlMutexUnlock(xmlSecParserCtxtPoolMutex);
+    }
+
+    if(ctxt != NULL) {
+        if(xmlCtxtResetPush(ctxt, NULL, 0, NULL, NULL) != 0) {
+            xmlSecXmlError("xmlCtxtResetPush", NULL);
+            xmlFreeParserCtxt(ctxt);
+            ctxt = NULL;
+        }
+    }
+    if(ctxt == NULL) {
+        ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+        if(ctxt == NULL) {
+            xmlSecXmlError("xmlCreatePushParserCtxt", NULL);
+            return(NULL);
+        }
+    }
+
+    /* required for c14n! */
+    ctxt->loadsubset      = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
+    ctxt->replaceEntities = 1;
+    ctxt->options         = options;
+    return(ctxt);
+}
+
+/**
+ * xmlSecParserCtxtRelease:
+ * @ctxt:               the push parser context.
+ *
+ * Returns the push parser context acquired with #xmlSecParserCtxtAcquire
+ * to the pool. The parsed document (if any) should be taken out of
+ * ctxt->myDoc before, otherwise it is freed.
+ */
+void
+xmlSecParserCtxtRelease(xmlParserCtxtPtr ctxt) {
+    xmlDictPtr dict;
+    int handedOut;
+
+    xmlSecAssert(ctxt != NULL);
+
+    /* the document left in the context (if any) is freed by the reset */
+    handedOut = (ctxt->myDoc == NULL) ? 1 : 0;
+    xmlCtxtReset(ctxt);
+
+    /* the handed out document might still use the dictionary */
+    if(handedOut != 0) {
+        dict = xmlDictCreate();
+        if(dict == NULL) {
+            xmlSecXmlError("xmlDictCreate", NULL);
+            xmlFreeParserCtxt(ctxt);
+            return;
+        }
+        if(ctxt->dict != NULL) {
+            xmlDictFree(ctxt->dict);
+        }
+        ctxt->dict = dict;
+        ctxt->str_xml    = xmlDictLookup(dict, BAD_CAST "xml", 3);
+        ctxt->str_xmlns  = xmlDictLookup(dict, BAD_CAST "xmlns", 5);
+        ctxt->str_xml_ns = xmlDictLookup(dict, XML_XML_NAMESPACE, 36);
+    }
+
+    if(xmlSecParserCtxtPoolMutex != NULL) {
+        xmlMutexLock(xmlSecParserCtxtPoolMutex);
+        if(xmlSecParserCtxtPoolCount < XMLSEC_PARSER_CTXT_POOL_SIZE) {
+            xmlSecParserCtxtPool[xmlSecParserCtxtPoolCount] = ctxt;
+            ++xmlSecParserCtxtPoolCount;
+            ctxt = NULL;
+        }
+        xmlMutexUnlock(xmlSecParserCtxtPoolMutex);
+    }
+    if(ctxt != NULL) {
+        xmlFreeParserCtxt(ctxt);
+    }
+}
+
 /**************************************************************************
  *
  * Internal parser
@@ -126,7 +287,7 @@ xmlSecParserFinalize(xmlSecTransformPtr transform) {
     xmlSecAssert(ctx != NULL);
 
     if(ctx->parserCtx != NULL) {
-        xmlFreeParserCtxt(ctx->parserCtx);
+        xmlSecParserCtxtRelease(ctx->parserCtx);
     }
     memset(ctx, 0, sizeof(xmlSecParserCtx));
 }
@@ -147,17 +308,12 @@ xmlSecParserPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
     if(transform->status == xmlSecTransformStatusNone) {
         xmlSecAssert2(ctx->parserCtx == NULL, -1);
 
-        ctx->parserCtx = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+        ctx->parserCtx = xmlSecParserCtxtAcquire(XML_PARSE_NONET);
         if(ctx->parserCtx == NULL) {
-            xmlSecXmlError("xmlCreatePushParserCtxt", xmlSecTransformGetName(transform));
+            xmlSecInternalError("xmlSecParserCtxtAcquire", xmlSecTransformGetName(transform));
             return(-1);
         }
 
-        /* required for c14n! */
-        ctx->parserCtx->loadsubset      = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
-        ctx->parserCtx->replaceEntities = 1;
-        ctx->parserCtx->options         = XML_PARSE_NONET;
-
         transform->status = xmlSecTransformStatusWorking;
     } else if(transform->status == xmlSecTransformStatusFinished) {
         return(0);
@@ -438,17 +594,13 @@ xmlSecParseMemoryExt(const xmlSecByte *prefix, xmlSecSize prefixSize,
     xmlDocPtr doc = NULL;
     int ret;
 
-    /* create context */
-    ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+    /* get context */
+    ctxt = xmlSecParserCtxtAcquire(0);
     if(ctxt == NULL) {
-        xmlSecXmlError("xmlCreatePushParserCtxt", NULL);
+        xmlSecInternalError("xmlSecParserCtxtAcquire", NULL);
         goto done;
     }
 
-    /* required for c14n! */
-    ctxt->loadsubset = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
-    ctxt->replaceEntities = 1;
-
     /* prefix */
     if((prefix != NULL) && (prefixSize > 0)) {
         ret = xmlParseChunk(ctxt, (const char*)prefix, prefixSize, 0);
@@ -489,10 +641,11 @@ xmlSecParseMemoryExt(const xmlSecByte *prefix, xmlSecSize prefixSize,
         goto done;
     }
     doc = ctxt->myDoc;
+    ctxt->myDoc = NULL;
 
 done:
     if(ctxt != NULL) {
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserCtxtRelease(ctxt);
     }
     return(doc);
 }
@@ -0,0 +1,358 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Per-thread random bytes pool: the IVs, the paddings and the session keys
+ * are small, with the pool enabled each thread gets them from its own
+ * buffer refilled with one call to the crypto library random generator
+ * instead of taking the generator lock for every encryption.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_RANDOM_WIN32             1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#include <unistd.h>
+#define XMLSEC_RANDOM_PTHREAD           1
+#endif /* defined(_WIN32) */
+
+#include <libxml/tree.h>
+#include <libxml/threads.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/random.h>
+#include <xmlsec/errors.h>
+
+#include <xmlsec/private/random.h>
+
+typedef struct _xmlSecRandomPool                        xmlSecRandomPool,
+                                                        *xmlSecRandomPoolPtr;
+struct _xmlSecRandomPool {
+    xmlSecRandomGenerateMethod  generate;       /* the bytes source */
+#if defined(XMLSEC_RANDOM_PTHREAD)
+    pid_t                       pid;            /* the bytes are not reused after fork() */
+#endif /* defined(XMLSEC_RANDOM_PTHREAD) */
+    xmlSecByte*                 data;
+    xmlSecSize                  size;
+    xmlSecSize                  pos;            /* the first unused byte */
+    xmlSecSize                  end;
+    xmlSecRandomPoolPtr         next;           /* all the threads pools */
+    xmlSecRandomPoolPtr         prev;
+};
+
+#if defined(XMLSEC_RANDOM_WIN32)
+static DWORD xmlSecRandomPoolKey = TLS_OUT_OF_INDEXES;
+#elif defined(XMLSEC_RANDOM_PTHREAD)
+static pthread_key_t xmlSecRandomPoolKey;
+static int xmlSecRandomPoolKeyCreated = 0;
+#else /* defined(XMLSEC_RANDOM_WIN32) */
+/* no threads support, there is only one thread */
+static xmlSecRandomPoolPtr xmlSecRandomPoolCurrent = NULL;
+#endif /* defined(XMLSEC_RANDOM_WIN32) */
+
+static xmlSecSize               xmlSecRandomPoolSize    = 0;
+static xmlMutexPtr              xmlSecRandomMutex       = NULL;
+static xmlSecRandomPoolPtr      xmlSecRandomPools       = NULL;
+
+static void
+xmlSecRandomPoolFree(xmlSecRandomPoolPtr pool) {
+    xmlSecAssert(pool != NULL);
+
+    if(pool->data != NULL) {
+        memset(pool->data, 0, pool->size);
+        xmlFree(pool->data);
+    }
+    memset(pool, 0, sizeof(xmlSecRandomPool));
+    xmlFree(pool);
+}
+
+/* called when the thread exits */
+static void
+xmlSecRandomPoolDestroy(void* data) {
+    xmlSecRandomPoolPtr pool = (xmlSecRandomPoolPtr)data;
+
+    if(pool == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecRandomMutex);
+    if(pool->prev != NULL) {
+        pool->prev->next = pool->next;
+    } else {
+        xmlSecRandomPools = pool->next;
+    }
+    if(pool->next != NULL) {
+        pool->next->prev = pool->prev;
+    }
+    xmlMutexUnlock(xmlSecRandomMutex);
+
+    xmlSecRandomPoolFree(pool);
+}
+
+/*
+ * Gets the current thread pool creating it if needed. Returns NULL if the
+ * pool is disabled or can not be created (not an error, the bytes are
+ * generated directly).
+ */
+static xmlSecRandomPoolPtr
+xmlSecRandomPoolGet(void) {
+    xmlSecRandomPoolPtr pool;
+
+    if((xmlSecRandomPoolSize == 0) || (xmlSecRandomMutex == NULL)) {
+        return(NULL);
+    }
+
+#if defined(XMLSEC_RANDOM_WIN32)
+    if(xmlSecRandomPoolKey == TLS_OUT_OF_INDEXES) {
+        return(NULL);
+    }
+    pool = (xmlSecRandomPoolPtr)TlsGetValue(xmlSecRandomPoolKey);
+#elif defined(XMLSEC_RANDOM_PTHREAD)
+    if(xmlSecRandomPoolKeyCreated == 0) {
+        return(NULL);
+    }
+    pool = (xmlSecRandomPoolPtr)pthread_getspecific(xmlSecRandomPoolKey);
+#else /* defined(XMLSEC_RANDOM_WIN32) */
+    pool = xmlSecRandomPoolCurrent;
+#endif /* defined(XMLSEC_RANDOM_WIN32) */
+    if(pool != NULL) {
+        return(pool);
+    }
+
+    pool = (xmlSecRandomPoolPtr)xmlMalloc(sizeof(xmlSecRandomPool));
+    if(pool == NULL) {
+        return(NULL);
+    }
+    memset(pool, 0, sizeof(xmlSecRandomPool));
+
+#if defined(XMLSEC_RANDOM_WIN32)
+    if(!TlsSetValue(xmlSecRandomPoolKey, pool)) {
+        xmlFree(pool);
+        return(NULL);
+    }
+#elif defined(XMLSEC_RANDOM_PTHREAD)
+    if(pthread_setspecific(xmlSecRandomPoolKey, pool) != 0) {
+        xmlFree(pool);
+        return(NULL);
+    }
+#else /* defined(XMLSEC_RANDOM_WIN32) */
+    xmlSecRandomPoolCurrent = pool;
+#endif /* defined(XMLSEC_RANDOM_WIN32) */
+
+    xmlMutexLock(xmlSecRandomMutex);
+    pool->next = xmlSecRandomPools;
+    if(xmlSecRandomPools != NULL) {
+        xmlSecRandomPools->prev = pool;
+    }
+    xmlSecRandomPools = pool;
+    xmlMutexUnlock(xmlSecRandomMutex);
+
+    return(pool);
+}
+
+/* drops the remaining bytes and refills the @pool from @generate */
+static int
+xmlSecRandomPoolRefill(xmlSecRandomPoolPtr pool, xmlSecRandomGenerateMethod generate, void* context) {
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(pool != NULL, -1);
+    xmlSecAssert2(generate != NULL, -1);
+
+    size = xmlSecRandomPoolSize;
+    if((pool->data != NULL) && (pool->size != size)) {
+        memset(pool->data, 0, pool->size);
+        xmlFree(pool->data);
+        pool->data = NULL;
+        pool->size = 0;
+    }
+    if(pool->data == NULL) {
+        pool->data = (xmlSecByte*)xmlMalloc(size);
+        if(pool->data == NULL) {
+            xmlSecMallocError(size, NULL);
+            return(-1);
+        }
+        pool->size = size;
+    }
+    pool->generate = NULL;
+    pool->pos = pool->end = 0;
+
+    ret = generate(pool->data, size, context);
+    if(ret < 0) {
+        xmlSecInternalError("generate", NULL);
+        return(-1);
+    }
+    pool->generate = generate;
+#if defined(XMLSEC_RANDOM_PTHREAD)
+    pool->pid = getpid();
+#endif /* defined(XMLSEC_RANDOM_PTHREAD) */
+    pool->end = size;
+    return(0);
+}
+
+/**
+ * xmlSecRandomInitialize:
+ *
+ * Initializes the random bytes pools. This function is called from the
+ * #xmlSecInit function.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecRandomInitialize(void) {
+    if(xmlSecRandomMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecRandomMutex = xmlNewMutex();
+    if(xmlSecRandomMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
+#if defined(XMLSEC_RANDOM_WIN32)
+    if(xmlSecRandomPoolKey == TLS_OUT_OF_INDEXES) {
+        xmlSecRandomPoolKey = TlsAlloc();
+    }
+#elif defined(XMLSEC_RANDOM_PTHREAD)
+    if(xmlSecRandomPoolKeyCreated == 0) {
+        if(pthread_key_create(&xmlSecRandomPoolKey, xmlSecRandomPoolDestroy) == 0) {
+            xmlSecRandomPoolKeyCreated = 1;
+        }
+    }
+#endif /* defined(XMLSEC_RANDOM_WIN32) */
+    return(0);
+}
+
+/**
+ * xmlSecRandomShutdown:
+ *
+ * Destroys the random bytes pools. This function is called from the
+ * #xmlSecShutdown function.
+ */
+void
+xmlSecRandomShutdown(void) {
+    xmlSecRandomPoolPtr pool;
+
+    if(xmlSecRandomMutex == NULL) {
+        return;
+    }
+
+    /* the pools of the threads that are still running are released too */
+    xmlMutexLock(xmlSecRandomMutex);
+    while(xmlSecRandomPools != NULL) {
+        pool = xmlSecRandomPools;
+        xmlSecRandomPools = pool->next;
+        xmlSecRandomPoolFree(pool);
+    }
+    xmlMutexUnlock(xmlSecRandomMutex);
+
+#if defined(XMLSEC_RANDOM_WIN32)
+    if(xmlSecRandomPoolKey != TLS_OUT_OF_INDEXES) {
+        TlsFree(xmlSecRandomPoolKey);
+        xmlSecRandomPoolKey = TLS_OUT_OF_INDEXES;
+    }
+#elif defined(XMLSEC_RANDOM_PTHREAD)
+    if(xmlSecRandomPoolKeyCreated != 0) {
+        pthread_key_delete(xmlSecRandomPoolKey);
+        xmlSecRandomPoolKeyCreated = 0;
+    }
+#else /* defined(XMLSEC_RANDOM_WIN32) */
+    xmlSecRandomPoolCurrent = NULL;
+#endif /* defined(XMLSEC_RANDOM_WIN32) */
+
+    xmlFreeMutex(xmlSecRandomMutex);
+    xmlSecRandomMutex = NULL;
+}
+
+/**
+ * xmlSecRandomSetPoolSize:
+ * @size:               the per-thread pool size in bytes or 0 to disable
+ *                      the pools.
+ *
+ * Sets the size of the per-thread random bytes pools used by the crypto
+ * libraries for the IVs, the paddings and the symmetric keys (disabled by
+ * default). A bigger pool takes the random generator lock less often,
+ * which helps when many threads encrypt at the same time and the crypto
+ * library random generator is shared between them. The function is not
+ * thread safe and should be called before any processing is started.
+ */
+void
+xmlSecRandomSetPoolSize(xmlSecSize size) {
+    xmlSecRandomPoolSize = size;
+}
+
+/**
+ * xmlSecRandomGetPoolSize:
+ *
+ * Gets the size of the per-thread random bytes pools.
+ *
+ * Returns: the pool size in bytes or 0 if the pools are disabled.
+ */
+xmlSecSize
+xmlSecRandomGetPoolSize(void) {
+    return(xmlSecRandomPoolSize);
+}
+
+/**
+ * xmlSecRandomGenerate:
+ * @generate:           the crypto library random generator.
+ * @context:            the context for @generate.
+ * @out:                the output buffer.
+ * @outSize:            the number of random bytes to generate.
+ *
+ * Fills @out with @outSize random bytes taken from the current thread
+ * pool (see #xmlSecRandomSetPoolSize) or directly from @generate if the
+ * pools are disabled or the request is large. The pool is refilled from
+ * @generate (with the @context of the request that triggered the refill)
+ * and never mixes the bytes of different generators. The bytes are
+ * cleared from the pool once used.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecRandomGenerate(xmlSecRandomGenerateMethod generate, void* context,
+                     xmlSecByte* out, xmlSecSize outSize) {
+    xmlSecRandomPoolPtr pool;
+    int ret;
+
+    xmlSecAssert2(generate != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+
+    if(outSize == 0) {
+        return(0);
+    }
+
+    /* the large requests do not gain anything from the pool */
+    pool = (outSize <= xmlSecRandomPoolSize / 4) ? xmlSecRandomPoolGet() : NULL;
+    if(pool == NULL) {
+        return(generate(out, outSize, context));
+    }
+
+    if((pool->generate != generate) || (pool->end - pool->pos < outSize)
+#if defined(XMLSEC_RANDOM_PTHREAD)
+        || (pool->pid != getpid())
+#endif /* defined(XMLSEC_RANDOM_PTHREAD) */
+    ) {
+        ret = xmlSecRandomPoolRefill(pool, generate, context);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecRandomPoolRefill", NULL);
+            return(-1);
+        }
+    }
+    xmlSecAssert2(pool->end - pool->pos >= outSize, -1);
+
+    memcpy(out, pool->data + pool->pos, outSize);
+    memset(pool->data + pool->pos, 0, outSize);
+    pool->pos += outSize;
+    return(0);
+}
@@ -23,6 +23,7 @@
 #include <xmlsec/list.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/transforms.h>
 
 
 /******************************************************************************
@@ -96,6 +97,8 @@ typedef struct _xmlSecRelationshipCtx           xmlSecRelationshipCtx,
                                                 *xmlSecRelationshipCtxPtr;
 struct _xmlSecRelationshipCtx {
     xmlSecPtrListPtr                    sourceIdList;
+    const xmlChar**                     sourceIds;      /* sorted copy of sourceIdList pointers */
+    xmlSecSize                          sourceIdsSize;
 };
 #define xmlSecRelationshipSize        \
     (sizeof(xmlSecTransform) + sizeof(xmlSecRelationshipCtx))
@@ -116,8 +119,10 @@ static int              xmlSecRelationshipReadNode        (xmlSecTransformPtr tr
                                                            xmlNodePtr node,
                                                            xmlSecTransformCtxPtr transformCtx);
 
+static int              xmlSecTransformRelationshipCompareStr(const void* p1,
+                                                            const void* p2);
 static int              xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform,
-                                                            xmlOutputBufferPtr buf,
+                                                            xmlSecBufferPtr out,
                                                             xmlNodePtr cur);
 
 
@@ -185,6 +190,9 @@ xmlSecRelationshipFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecRelationshipGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
+    if(ctx->sourceIds != NULL) {
+       xmlFree(ctx->sourceIds);
+    }
     if(ctx->sourceIdList != NULL) {
        xmlSecPtrListDestroy(ctx->sourceIdList);
     }
@@ -229,48 +237,101 @@ xmlSecRelationshipReadNode(xmlSecTransformPtr transform, xmlNodePtr node, xmlSec
         cur = cur->next;
     }
 
+    /* sort the source ids once to avoid the linear search for every relationship */
+    ctx->sourceIdsSize = xmlSecPtrListGetSize(ctx->sourceIdList);
+    if(ctx->sourceIdsSize > 0) {
+        xmlSecSize ii;
+
+        xmlSecAssert2(ctx->sourceIds == NULL, -1);
+        ctx->sourceIds = (const xmlChar**)xmlMalloc(ctx->sourceIdsSize * sizeof(xmlChar*));
+        if(ctx->sourceIds == NULL) {
+            xmlSecMallocError(ctx->sourceIdsSize * sizeof(xmlChar*),
+                              xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        for(ii = 0; ii < ctx->sourceIdsSize; ++ii) {
+            ctx->sourceIds[ii] = (const xmlChar*)xmlSecPtrListGetItem(ctx->sourceIdList, ii);
+        }
+        qsort((void*)ctx->sourceIds, ctx->sourceIdsSize, sizeof(xmlChar*),
+              xmlSecTransformRelationshipCompareStr);
+    }
+
     return(0);
 }
 
+/*
+ * The Relationship elements are extracted into a compact array once and
+ * sorted there, instead of looking up the Id attribute on every comparison.
+ */
+typedef struct _xmlSecRelationshipItem {
+    xmlNodePtr          node;
+    const xmlChar*      id;
+    xmlChar*            idBuf;
+    xmlSecSize          pos;
+} xmlSecRelationshipItem, *xmlSecRelationshipItemPtr;
+
+/* returns attribute value without a copy in the common case (single text node) */
+static const xmlChar*
+xmlSecTransformRelationshipGetAttrValue(xmlAttrPtr attr, xmlChar** valueBuf) {
+    xmlSecAssert2(attr != NULL, NULL);
+    xmlSecAssert2(valueBuf != NULL, NULL);
+
+    (*valueBuf) = NULL;
+    if((attr->children != NULL) && (attr->children->next == NULL) &&
+       (attr->children->type == XML_TEXT_NODE) && (attr->children->content != NULL)) {
+        return(attr->children->content);
+    }
+    (*valueBuf) = xmlNodeListGetString(attr->doc, attr->children, 1);
+    return((*valueBuf) != NULL ? (*valueBuf) : BAD_CAST "");
+}
+
+static const xmlChar*
+xmlSecTransformRelationshipGetId(xmlNodePtr cur, xmlChar** idBuf) {
+    xmlAttrPtr attr;
+
+    xmlSecAssert2(cur != NULL, NULL);
+    xmlSecAssert2(idBuf != NULL, NULL);
+
+    (*idBuf) = NULL;
+    attr = xmlHasProp(cur, xmlSecRelationshipAttrId);
+    if((attr == NULL) || (attr->type != XML_ATTRIBUTE_NODE)) {
+        /* DTD defaults are rare enough to take the slow path */
+        (*idBuf) = xmlGetProp(cur, xmlSecRelationshipAttrId);
+        return(*idBuf);
+    }
+    return(xmlSecTransformRelationshipGetAttrValue(attr, idBuf));
+}
+
 /* Sorts Relationship elements by Id value in lexicographical order. */
 static int
-xmlSecTransformRelationshipCompare(xmlNodePtr node1, xmlNodePtr node2) {
-    xmlChar* id1 = NULL;
-    xmlChar* id2 = NULL;
+xmlSecTransformRelationshipCompare(const void* p1, const void* p2) {
+    const xmlSecRelationshipItem* item1 = (const xmlSecRelationshipItem*)p1;
+    const xmlSecRelationshipItem* item2 = (const xmlSecRelationshipItem*)p2;
     int ret;
 
-    if(node1 == node2) {
-        return(0);
-    }
-    if(node1 == NULL) {
+    if((item1->id == NULL) && (item2->id != NULL)) {
         return(-1);
     }
-    if(node2 == NULL) {
+    if((item1->id != NULL) && (item2->id == NULL)) {
         return(1);
     }
-
-    id1 = xmlGetProp(node1, xmlSecRelationshipAttrId);
-    id2 = xmlGetProp(node2, xmlSecRelationshipAttrId);
-    if(id1 == NULL) {
-        ret = -1;
-        goto done;
-    }
-    if(id2 == NULL) {
-        ret = 1;
-        goto done;
+    ret = xmlStrcmp(item1->id, item2->id);
+    if(ret != 0) {
+        return(ret);
     }
 
-    ret = xmlStrcmp(id1, id2);
-
-done:
-    if (id1 != NULL) {
-        xmlFree(id1);
-    }
-    if (id2 != NULL) {
-        xmlFree(id2);
+    /* keep the document order for equal ids */
+    if(item1->pos < item2->pos) {
+        return(-1);
+    } else if(item1->pos > item2->pos) {
+        return(1);
     }
+    return(0);
+}
 
-    return ret;
+static int
+xmlSecTransformRelationshipCompareStr(const void* p1, const void* p2) {
+    return(xmlStrcmp(*(const xmlChar* const*)p1, *(const xmlChar* const*)p2));
 }
 
 /*
@@ -278,141 +339,157 @@ done:
  * then exclude it from the output, instead of processing it.
  */
 static int
-xmlSecTransformRelationshipProcessNode(xmlSecTransformPtr transform, xmlOutputBufferPtr buf, xmlNodePtr cur) {
-    int found = -1;
-    xmlSecRelationshipCtxPtr ctx;
-    xmlSecSize ii;
-    int ret;
+xmlSecTransformRelationshipIsSourceId(xmlSecRelationshipCtxPtr ctx, const xmlChar* id) {
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(id != NULL, 0);
 
-    xmlSecAssert2(transform != NULL, -1);
-    xmlSecAssert2(buf != NULL, -1);
-    xmlSecAssert2(cur != NULL, -1);
-
-    if(xmlSecCheckNodeName(cur, xmlSecNodeRelationship, xmlSecRelationshipsNs)) {
-        xmlChar* id = xmlGetProp(cur, xmlSecRelationshipAttrId);
-        if(id == NULL) {
-            xmlSecXmlError2("xmlGetProp(xmlSecRelationshipAttrId)",
-                            xmlSecTransformGetName(transform),
-                            "name=%s", xmlSecRelationshipAttrId);
-            return(-1);
-        }
+    if(ctx->sourceIds == NULL) {
+        return(0);
+    }
+    return((bsearch(&id, ctx->sourceIds, ctx->sourceIdsSize, sizeof(xmlChar*),
+                    xmlSecTransformRelationshipCompareStr) != NULL) ? 1 : 0);
+}
 
-        ctx = xmlSecRelationshipGetCtx(transform);
-        for(ii = 0; ii < xmlSecPtrListGetSize(ctx->sourceIdList); ++ii) {
-            if(xmlStrcmp(xmlSecPtrListGetItem(ctx->sourceIdList, ii), id) == 0) {
-                found = 1;
-                break;
-            }
-        }
+static void
+xmlSecTransformRelationshipItemsDestroy(xmlSecRelationshipItemPtr items, xmlSecSize size) {
+    xmlSecSize ii;
 
-        xmlFree(id);
+    xmlSecAssert(items != NULL);
 
-        if(found < 0) {
-            return(0);
+    for(ii = 0; ii < size; ++ii) {
+        if(items[ii].idBuf != NULL) {
+            xmlFree(items[ii].idBuf);
         }
     }
-
-    ret = xmlSecTransformRelationshipProcessElementNode(transform, buf, cur);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformRelationshipProcessElementNode",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
-
-    return(0);
+    xmlFree(items);
 }
 
 /*
- * This is step 2, point 3: sort elements by Id: we process other elements as-is, but for elements we collect them in a list,
- * then sort, and finally process them (process the head of the list, then pop the head, till the list becomes empty).
+ * This is step 2, point 3: sort elements by Id: we process other elements as-is, but Relationship elements
+ * are collected (and filtered) into an array, then sorted, and finally processed in one pass.
  */
 static int
-xmlSecTransformRelationshipProcessNodeList(xmlSecTransformPtr transform, xmlOutputBufferPtr buf, xmlNodePtr cur) {
-    xmlListPtr list;
+xmlSecTransformRelationshipProcessNodeList(xmlSecTransformPtr transform, xmlSecBufferPtr out, xmlNodePtr first) {
+    xmlSecRelationshipCtxPtr ctx;
+    xmlSecRelationshipItemPtr items = NULL;
+    xmlSecSize itemsSize = 0;
+    xmlSecSize itemsMaxSize = 0;
+    xmlSecSize ii;
+    xmlNodePtr cur;
     int ret;
 
     xmlSecAssert2(transform != NULL, -1);
-    xmlSecAssert2(buf != NULL, -1);
-    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(first != NULL, -1);
 
-    list = xmlListCreate(NULL, (xmlListDataCompare)xmlSecTransformRelationshipCompare);
-    if(list == NULL) {
-        xmlSecXmlError("xmlListCreate", xmlSecTransformGetName(transform));
-        return(-1);
+    ctx = xmlSecRelationshipGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* count candidates to allocate the array once */
+    for(cur = first; cur != NULL; cur = cur->next) {
+        if(xmlStrcmp(cur->name, xmlSecNodeRelationship) == 0) {
+            ++itemsMaxSize;
+        }
+    }
+    if(itemsMaxSize > 0) {
+        items = (xmlSecRelationshipItemPtr)xmlMalloc(itemsMaxSize * sizeof(xmlSecRelationshipItem));
+        if(items == NULL) {
+            xmlSecMallocError(itemsMaxSize * sizeof(xmlSecRelationshipItem),
+                              xmlSecTransformGetName(transform));
+            return(-1);
+        }
     }
 
-    for(; cur; cur = cur->next) {
+    for(cur = first; cur != NULL; cur = cur->next) {
         if(xmlStrcmp(cur->name, xmlSecNodeRelationship) == 0) {
-            if(xmlListInsert(list, cur) != 0) {
-                xmlSecXmlError("xmlListInsert", xmlSecTransformGetName(transform));
-                return(-1);
+            xmlSecRelationshipItemPtr item;
+
+            xmlSecAssert2(items != NULL, -1);
+            xmlSecAssert2(itemsSize < itemsMaxSize, -1);
+
+            item = &(items[itemsSize]);
+            item->node = cur;
+            item->pos  = itemsSize;
+            item->id   = xmlSecTransformRelationshipGetId(cur, &(item->idBuf));
+
+            if(xmlSecCheckNodeName(cur, xmlSecNodeRelationship, xmlSecRelationshipsNs)) {
+                if(item->id == NULL) {
+                    xmlSecXmlError2("xmlGetProp(xmlSecRelationshipAttrId)",
+                                    xmlSecTransformGetName(transform),
+                                    "name=%s", xmlSecRelationshipAttrId);
+                    xmlSecTransformRelationshipItemsDestroy(items, itemsSize);
+                    return(-1);
+                }
+                if(xmlSecTransformRelationshipIsSourceId(ctx, item->id) != 1) {
+                    if(item->idBuf != NULL) {
+                        xmlFree(item->idBuf);
+                    }
+                    continue;
+                }
             }
+            ++itemsSize;
         } else {
-            ret = xmlSecTransformRelationshipProcessNode(transform, buf, cur);
+            ret = xmlSecTransformRelationshipProcessElementNode(transform, out, cur);
             if(ret < 0) {
-                xmlSecInternalError("xmlSecTransformRelationshipProcessNode",
+                xmlSecInternalError("xmlSecTransformRelationshipProcessElementNode",
                                     xmlSecTransformGetName(transform));
-                xmlListDelete(list);
+                if(items != NULL) {
+                    xmlSecTransformRelationshipItemsDestroy(items, itemsSize);
+                }
                 return(-1);
             }
         }
     }
 
-    xmlListSort(list);
+    if(items == NULL) {
+        return(0);
+    }
 
-    while(!xmlListEmpty(list)) {
-        xmlLinkPtr link = xmlListFront(list);
-        xmlNodePtr node = (xmlNodePtr)xmlLinkGetData(link);
+    qsort(items, itemsSize, sizeof(xmlSecRelationshipItem), xmlSecTransformRelationshipCompare);
 
-        ret = xmlSecTransformRelationshipProcessNode(transform, buf, node);
+    for(ii = 0; ii < itemsSize; ++ii) {
+        ret = xmlSecTransformRelationshipProcessElementNode(transform, out, items[ii].node);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformRelationshipProcessNode",
+            xmlSecInternalError("xmlSecTransformRelationshipProcessElementNode",
                                 xmlSecTransformGetName(transform));
-            xmlListDelete(list);
+            xmlSecTransformRelationshipItemsDestroy(items, itemsSize);
             return(-1);
         }
-
-        xmlListPopFront(list);
     }
 
     /* done */
-    xmlListDelete(list);
+    xmlSecTransformRelationshipItemsDestroy(items, itemsSize);
     return(0);
 }
 
 static int
-xmlSecTransformRelationshipWriteProp(xmlOutputBufferPtr buf, const xmlChar * name, const xmlChar * value) {
+xmlSecTransformRelationshipWriteStr(xmlSecBufferPtr out, const xmlChar * str) {
     int ret;
 
-    xmlSecAssert2(buf != NULL, -1);
-    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(str != NULL, -1);
 
-    ret = xmlOutputBufferWriteString(buf, " ");
+    ret = xmlSecBufferAppend(out, str, (xmlSecSize)xmlStrlen(str));
     if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString", NULL);
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
         return(-1);
     }
+    return(0);
+}
 
-    ret = xmlOutputBufferWriteString(buf, (const char*) name);
-    if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString", NULL);
+static int
+xmlSecTransformRelationshipWriteProp(xmlSecBufferPtr out, const xmlChar * name, const xmlChar * value) {
+    xmlSecAssert2(out != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    if((xmlSecTransformRelationshipWriteStr(out, BAD_CAST " ") < 0) ||
+       (xmlSecTransformRelationshipWriteStr(out, name) < 0)) {
         return(-1);
     }
-
     if(value != NULL) {
-        ret = xmlOutputBufferWriteString(buf, "=\"");
-        if(ret < 0) {
-            xmlSecXmlError("xmlOutputBufferWriteString", NULL);
-            return(-1);
-        }
-        ret = xmlOutputBufferWriteString(buf, (const char*) value);
-        if(ret < 0) {
-            xmlSecXmlError("xmlOutputBufferWriteString", NULL);
-            return(-1);
-        }
-        ret = xmlOutputBufferWriteString(buf, "\"");
-        if(ret < 0) {
-            xmlSecXmlError("xmlOutputBufferWriteString", NULL);
+        if((xmlSecTransformRelationshipWriteStr(out, BAD_CAST "=\"") < 0) ||
+           (xmlSecTransformRelationshipWriteStr(out, value) < 0) ||
+           (xmlSecTransformRelationshipWriteStr(out, BAD_CAST "\"") < 0)) {
             return(-1);
         }
     }
@@ -421,41 +498,35 @@ xmlSecTransformRelationshipWriteProp(xmlOutputBufferPtr buf, const xmlChar * nam
 }
 
 static int
-xmlSecTransformRelationshipWriteNs(xmlOutputBufferPtr buf, const xmlChar * href) {
-    xmlSecAssert2(buf != NULL, -1);
+xmlSecTransformRelationshipWriteNs(xmlSecBufferPtr out, const xmlChar * href) {
+    xmlSecAssert2(out != NULL, -1);
 
-    return(xmlSecTransformRelationshipWriteProp(buf, BAD_CAST "xmlns", (href != NULL) ? href : BAD_CAST ""));
+    return(xmlSecTransformRelationshipWriteProp(out, BAD_CAST "xmlns", (href != NULL) ? href : BAD_CAST ""));
 }
 
 
 static int
-xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlOutputBufferPtr buf, xmlNodePtr cur) {
+xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlSecBufferPtr out, xmlNodePtr cur) {
     xmlAttrPtr attr;
     int foundTargetMode = 0;
     int ret;
 
     xmlSecAssert2(transform != NULL, -1);
-    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(cur != NULL, -1);
     xmlSecAssert2(cur->name != NULL, -1);
 
     /* write open node */
-    ret = xmlOutputBufferWriteString(buf, "<");
-    if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
-    ret = xmlOutputBufferWriteString(buf, (const char *)cur->name);
-    if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
+    if((xmlSecTransformRelationshipWriteStr(out, BAD_CAST "<") < 0) ||
+       (xmlSecTransformRelationshipWriteStr(out, cur->name) < 0)) {
+        xmlSecInternalError("xmlSecTransformRelationshipWriteStr",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
 
     /* write namespaces */
     if(cur->nsDef != NULL) {
-        ret = xmlSecTransformRelationshipWriteNs(buf, cur->nsDef->href);
+        ret = xmlSecTransformRelationshipWriteNs(out, cur->nsDef->href);
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformRelationshipWriteNs",
                                 xmlSecTransformGetName(transform));
@@ -469,26 +540,28 @@ xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlO
      *  This is step 3, point 6: add default value of TargetMode if there is no such attribute.
      */
     for(attr = cur->properties; attr != NULL; attr = attr->next) {
-        xmlChar * value = xmlGetProp(cur, attr->name);
+        xmlChar * valueBuf;
+        const xmlChar * value;
 
+        value = xmlSecTransformRelationshipGetAttrValue(attr, &valueBuf);
         if(xmlStrcmp(attr->name, xmlSecRelationshipAttrTargetMode) == 0) {
             foundTargetMode = 1;
         }
 
-        ret = xmlSecTransformRelationshipWriteProp(buf, attr->name, value);
+        ret = xmlSecTransformRelationshipWriteProp(out, attr->name, value);
+        if(valueBuf != NULL) {
+            xmlFree(valueBuf);
+        }
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformRelationshipWriteProp",
                                 xmlSecTransformGetName(transform));
-            xmlFree(value);
             return(-1);
         }
-
-        xmlFree(value);
     }
 
     /* write TargetMode */
     if(xmlStrcmp(cur->name, xmlSecNodeRelationship) == 0 && !foundTargetMode) {
-        ret = xmlSecTransformRelationshipWriteProp(buf, xmlSecRelationshipAttrTargetMode, BAD_CAST "Internal");
+        ret = xmlSecTransformRelationshipWriteProp(out, xmlSecRelationshipAttrTargetMode, BAD_CAST "Internal");
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformRelationshipWriteProp(TargetMode=Internal)",
                                 xmlSecTransformGetName(transform));
@@ -497,16 +570,16 @@ xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlO
     }
 
     /* finish writing open node */
-    ret = xmlOutputBufferWriteString(buf, ">");
+    ret = xmlSecTransformRelationshipWriteStr(out, BAD_CAST ">");
     if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
+        xmlSecInternalError("xmlSecTransformRelationshipWriteStr",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
 
     /* write children */
     if(cur->children != NULL) {
-        ret = xmlSecTransformRelationshipProcessNodeList(transform, buf, cur->children);
+        ret = xmlSecTransformRelationshipProcessNodeList(transform, out, cur->children);
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformRelationshipProcessNodeList",
                                 xmlSecTransformGetName(transform));
@@ -515,20 +588,10 @@ xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlO
     }
 
     /* write closing node */
-    ret = xmlOutputBufferWriteString(buf, "</");
-    if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
-    ret = xmlOutputBufferWriteString(buf, (const char *)cur->name);
-    if(ret < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
-    if(xmlOutputBufferWriteString(buf, ">") < 0) {
-        xmlSecXmlError("xmlOutputBufferWriteString",
+    if((xmlSecTransformRelationshipWriteStr(out, BAD_CAST "</") < 0) ||
+       (xmlSecTransformRelationshipWriteStr(out, cur->name) < 0) ||
+       (xmlSecTransformRelationshipWriteStr(out, BAD_CAST ">") < 0)) {
+        xmlSecInternalError("xmlSecTransformRelationshipWriteStr",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
@@ -538,15 +601,15 @@ xmlSecTransformRelationshipProcessElementNode(xmlSecTransformPtr transform, xmlO
 }
 
 static int
-xmlSecTransformRelationshipExecute(xmlSecTransformPtr transform, xmlOutputBufferPtr buf, xmlDocPtr doc) {
+xmlSecTransformRelationshipExecute(xmlSecTransformPtr transform, xmlSecBufferPtr out, xmlDocPtr doc) {
     int ret;
 
     xmlSecAssert2(transform != NULL, -1);
-    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(out != NULL, -1);
     xmlSecAssert2(doc != NULL, -1);
 
     if(doc->children != NULL) {
-        ret = xmlSecTransformRelationshipProcessNodeList(transform, buf, doc->children);
+        ret = xmlSecTransformRelationshipProcessNodeList(transform, out, doc->children);
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformRelationshipProcessNodeList",
                                 xmlSecTransformGetName(transform));
@@ -560,7 +623,6 @@ xmlSecTransformRelationshipExecute(xmlSecTransformPtr transform, xmlOutputBuffer
 static int
 xmlSecTransformRelationshipPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes, xmlSecTransformCtxPtr transformCtx)
 {
-    xmlOutputBufferPtr buf;
     xmlSecRelationshipCtxPtr ctx;
     int ret;
 
@@ -585,35 +647,26 @@ xmlSecTransformRelationshipPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPt
     }
     xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
 
-    /* prepare output buffer: next transform or ourselves */
-    if(transform->next != NULL) {
-       buf = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
-       if(buf == NULL) {
-           xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
-                               xmlSecTransformGetName(transform));
-           return(-1);
-       }
-    } else {
-       buf = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
-       if(buf == NULL) {
-           xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
-                               xmlSecTransformGetName(transform));
-           return(-1);
-       }
-    }
-
-    ret = xmlSecTransformRelationshipExecute(transform, buf, nodes->doc);
+    /* serialize everything into our own buffer in one pass */
+    ret = xmlSecTransformRelationshipExecute(transform, &(transform->outBuf), nodes->doc);
     if(ret < 0) {
        xmlSecInternalError("xmlSecTransformRelationshipExecute",
                            xmlSecTransformGetName(transform));
-       xmlOutputBufferClose(buf);
        return(-1);
     }
 
-    ret = xmlOutputBufferClose(buf);
-    if(ret < 0) {
-       xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
-       return(-1);
+    /* and hand it over to the next transform with a single call */
+    if(transform->next != NULL) {
+       ret = xmlSecTransformPushBin(transform->next,
+                                    xmlSecBufferGetData(&(transform->outBuf)),
+                                    xmlSecBufferGetSize(&(transform->outBuf)),
+                                    1, transformCtx);
+       if(ret < 0) {
+           xmlSecInternalError("xmlSecTransformPushBin",
+                               xmlSecTransformGetName(transform));
+           return(-1);
+       }
+       xmlSecBufferEmpty(&(transform->outBuf));
     }
     transform->status = xmlSecTransformStatusFinished;
     return(0);
@@ -680,8 +733,8 @@ xmlSecTransformRelationshipPopBin(xmlSecTransformPtr transform, xmlSecByte* data
        if(outSize > maxDataSize) {
            outSize = maxDataSize;
        }
-       if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-           outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+       if(outSize > xmlSecTransformCtxGetBinaryChunkSize(transformCtx)) {
+           outSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
        }
        if(outSize > 0) {
            xmlSecAssert2(xmlSecBufferGetData(out), -1);
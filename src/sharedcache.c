@@ -0,0 +1,366 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * The cache shared by the forked processes (e.g. the prefork server
+ * workers): a fixed size shared memory region mapped before fork() with
+ * the hash table of (key, value) byte strings. The crypto libraries keep
+ * there the results that are expensive to compute and can be serialized
+ * (the certificates verification results, the public keys). The entries
+ * are never changed or removed one by one, the whole cache is cleared
+ * when it is full.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && defined(HAVE_PTHREAD_H) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define XMLSEC_SHARED_CACHE     1
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS           MAP_ANON
+#endif /* !defined(MAP_ANONYMOUS) && defined(MAP_ANON) */
+
+/* the lock held by a crashed process is recovered */
+#if defined(EOWNERDEAD) && defined(_POSIX_THREAD_ROBUST_PRIO_INHERIT)
+#define XMLSEC_SHARED_CACHE_ROBUST      1
+#endif /* defined(EOWNERDEAD) && defined(_POSIX_THREAD_ROBUST_PRIO_INHERIT) */
+#endif /* !defined(_WIN32) && defined(HAVE_PTHREAD_H) && defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/sharedcache.h>
+#include <xmlsec/errors.h>
+
+#ifdef XMLSEC_SHARED_CACHE
+
+/* the number of the cache bytes per hash table slot */
+#define XMLSEC_SHARED_CACHE_BYTES_PER_SLOT      512
+
+/* the min number of the hash table slots */
+#define XMLSEC_SHARED_CACHE_MIN_SLOTS           64
+
+/* the hash table slot: the key followed by the value in the data area */
+typedef struct _xmlSecSharedCacheSlot {
+    unsigned int        hash;           /* 0 for the empty slot */
+    xmlSecSize          offset;
+    xmlSecSize          keySize;
+    xmlSecSize          valueSize;
+} xmlSecSharedCacheSlot, *xmlSecSharedCacheSlotPtr;
+
+/* the shared memory region starts with the header followed by the slots and the data */
+typedef struct _xmlSecSharedCacheHeader {
+    pthread_mutex_t     mutex;
+    xmlSecSize          slotsNumber;
+    xmlSecSize          slotsUsed;
+    xmlSecSize          dataSize;
+    xmlSecSize          dataUsed;
+} xmlSecSharedCacheHeader, *xmlSecSharedCacheHeaderPtr;
+
+static xmlSecSharedCacheHeaderPtr xmlSecSharedCacheMem          = NULL;
+static xmlSecSize               xmlSecSharedCacheMemSize        = 0;
+
+#define xmlSecSharedCacheGetSlots(header) \
+    ((xmlSecSharedCacheSlotPtr)((xmlSecByte*)(header) + sizeof(xmlSecSharedCacheHeader)))
+#define xmlSecSharedCacheGetData(header) \
+    ((xmlSecByte*)(xmlSecSharedCacheGetSlots(header) + (header)->slotsNumber))
+
+static unsigned int
+xmlSecSharedCacheHash(const xmlSecByte* key, xmlSecSize keySize) {
+    unsigned int hash = 2166136261U;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < keySize; ++ii) {
+        hash = (hash ^ key[ii]) * 16777619U;
+    }
+    return((hash != 0) ? hash : 1);
+}
+
+static void
+xmlSecSharedCacheClear(xmlSecSharedCacheHeaderPtr header) {
+    memset(xmlSecSharedCacheGetSlots(header), 0, header->slotsNumber * sizeof(xmlSecSharedCacheSlot));
+    header->slotsUsed = 0;
+    header->dataUsed = 0;
+}
+
+static int
+xmlSecSharedCacheLock(xmlSecSharedCacheHeaderPtr header) {
+    int ret;
+
+    ret = pthread_mutex_lock(&(header->mutex));
+#ifdef XMLSEC_SHARED_CACHE_ROBUST
+    if(ret == EOWNERDEAD) {
+        /* the owner died in the middle of the update */
+        xmlSecSharedCacheClear(header);
+        ret = pthread_mutex_consistent(&(header->mutex));
+    }
+#endif /* XMLSEC_SHARED_CACHE_ROBUST */
+    if(ret != 0) {
+        xmlSecIOError("pthread_mutex_lock", NULL, NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* returns the slot with @key or the empty slot where it should be added */
+static xmlSecSharedCacheSlotPtr
+xmlSecSharedCacheFind(xmlSecSharedCacheHeaderPtr header, const xmlSecByte* key,
+                      xmlSecSize keySize, unsigned int hash) {
+    xmlSecSharedCacheSlotPtr slots = xmlSecSharedCacheGetSlots(header);
+    xmlSecByte* data = xmlSecSharedCacheGetData(header);
+    xmlSecSize pos;
+
+    for(pos = hash % header->slotsNumber; ; pos = (pos + 1) % header->slotsNumber) {
+        if(slots[pos].hash == 0) {
+            return(&(slots[pos]));
+        }
+        if((slots[pos].hash == hash) && (slots[pos].keySize == keySize) &&
+           (memcmp(data + slots[pos].offset, key, keySize) == 0)) {
+            return(&(slots[pos]));
+        }
+    }
+}
+
+#endif /* XMLSEC_SHARED_CACHE */
+
+/**
+ * xmlSecSharedCacheCreate:
+ * @size:               the cache size in bytes or 0 for
+ *                      #XMLSEC_SHARED_CACHE_DEFAULT_SIZE.
+ *
+ * Creates the cache shared by the current process and all the processes
+ * forked from it after this call: the prefork server should call it (and
+ * load the keys managers with the trusted certificates) in the parent
+ * process before starting the workers. The function is not thread safe.
+ *
+ * Returns: 0 on success or a negative value if an error occurs or the
+ * shared memory is not supported on this platform.
+ */
+int
+xmlSecSharedCacheCreate(xmlSecSize size) {
+#ifdef XMLSEC_SHARED_CACHE
+    xmlSecSharedCacheHeaderPtr header;
+    pthread_mutexattr_t attr;
+    xmlSecSize slotsNumber;
+    void* mem;
+    int ret;
+#endif /* XMLSEC_SHARED_CACHE */
+
+    if(size == 0) {
+        size = XMLSEC_SHARED_CACHE_DEFAULT_SIZE;
+    }
+
+#ifdef XMLSEC_SHARED_CACHE
+    xmlSecAssert2(xmlSecSharedCacheMem == NULL, -1);
+
+    slotsNumber = size / XMLSEC_SHARED_CACHE_BYTES_PER_SLOT;
+    if(slotsNumber < XMLSEC_SHARED_CACHE_MIN_SLOTS) {
+        slotsNumber = XMLSEC_SHARED_CACHE_MIN_SLOTS;
+    }
+    if(size <= sizeof(xmlSecSharedCacheHeader) + slotsNumber * sizeof(xmlSecSharedCacheSlot)) {
+        xmlSecInvalidSizeLessThanError("shared cache size", size,
+            sizeof(xmlSecSharedCacheHeader) + slotsNumber * sizeof(xmlSecSharedCacheSlot) + 1, NULL);
+        return(-1);
+    }
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) {
+        xmlSecIOError("mmap", NULL, NULL);
+        return(-1);
+    }
+    header = (xmlSecSharedCacheHeaderPtr)mem;
+    memset(header, 0, sizeof(xmlSecSharedCacheHeader));
+
+    ret = pthread_mutexattr_init(&attr);
+    if(ret == 0) {
+        ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef XMLSEC_SHARED_CACHE_ROBUST
+        if(ret == 0) {
+            ret = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        }
+#endif /* XMLSEC_SHARED_CACHE_ROBUST */
+        if(ret == 0) {
+            ret = pthread_mutex_init(&(header->mutex), &attr);
+        }
+        pthread_mutexattr_destroy(&attr);
+    }
+    if(ret != 0) {
+        xmlSecIOError("pthread_mutex_init", NULL, NULL);
+        munmap(mem, size);
+        return(-1);
+    }
+
+    header->slotsNumber = slotsNumber;
+    header->dataSize = size - sizeof(xmlSecSharedCacheHeader) - slotsNumber * sizeof(xmlSecSharedCacheSlot);
+    xmlSecSharedCacheClear(header);
+
+    xmlSecSharedCacheMem = header;
+    xmlSecSharedCacheMemSize = size;
+    return(0);
+#else  /* XMLSEC_SHARED_CACHE */
+    xmlSecNotImplementedError("shared memory is not supported");
+    return(-1);
+#endif /* XMLSEC_SHARED_CACHE */
+}
+
+/**
+ * xmlSecSharedCacheDestroy:
+ *
+ * Unmaps the shared cache in the current process (the other processes
+ * still use it). The function is not thread safe.
+ */
+void
+xmlSecSharedCacheDestroy(void) {
+#ifdef XMLSEC_SHARED_CACHE
+    if(xmlSecSharedCacheMem != NULL) {
+        munmap((void*)xmlSecSharedCacheMem, xmlSecSharedCacheMemSize);
+        xmlSecSharedCacheMem = NULL;
+        xmlSecSharedCacheMemSize = 0;
+    }
+#endif /* XMLSEC_SHARED_CACHE */
+}
+
+/**
+ * xmlSecSharedCacheIsEnabled:
+ *
+ * Checks if the shared cache was created with #xmlSecSharedCacheCreate.
+ *
+ * Returns: 1 if the shared cache is enabled or 0 otherwise.
+ */
+int
+xmlSecSharedCacheIsEnabled(void) {
+#ifdef XMLSEC_SHARED_CACHE
+    return((xmlSecSharedCacheMem != NULL) ? 1 : 0);
+#else  /* XMLSEC_SHARED_CACHE */
+    return(0);
+#endif /* XMLSEC_SHARED_CACHE */
+}
+
+/**
+ * xmlSecSharedCacheLookup:
+ * @key:                the key.
+ * @keySize:            the key size.
+ * @value:              the buffer for the value.
+ *
+ * Looks up the value added for @key by this or another process.
+ *
+ * Returns: 1 if the value was found and copied to @value, 0 if it is not
+ * found or the cache is not enabled or a negative value if an error occurs.
+ */
+int
+xmlSecSharedCacheLookup(const xmlSecByte* key, xmlSecSize keySize, xmlSecBufferPtr value) {
+#ifdef XMLSEC_SHARED_CACHE
+    xmlSecSharedCacheHeaderPtr header = xmlSecSharedCacheMem;
+    xmlSecSharedCacheSlotPtr slot;
+    int res = 0;
+    int ret;
+#endif /* XMLSEC_SHARED_CACHE */
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keySize > 0, -1);
+    xmlSecAssert2(value != NULL, -1);
+
+#ifdef XMLSEC_SHARED_CACHE
+    if(header == NULL) {
+        return(0);
+    }
+
+    ret = xmlSecSharedCacheLock(header);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSharedCacheLock", NULL);
+        return(-1);
+    }
+    slot = xmlSecSharedCacheFind(header, key, keySize, xmlSecSharedCacheHash(key, keySize));
+    if(slot->hash != 0) {
+        ret = xmlSecBufferSetData(value, xmlSecSharedCacheGetData(header) + slot->offset + slot->keySize,
+                                  slot->valueSize);
+        res = (ret < 0) ? -1 : 1;
+    }
+    pthread_mutex_unlock(&(header->mutex));
+
+    if(res < 0) {
+        xmlSecInternalError("xmlSecBufferSetData", NULL);
+        return(-1);
+    }
+    return(res);
+#else  /* XMLSEC_SHARED_CACHE */
+    return(0);
+#endif /* XMLSEC_SHARED_CACHE */
+}
+
+/**
+ * xmlSecSharedCacheAdd:
+ * @key:                the key.
+ * @keySize:            the key size.
+ * @value:              the value.
+ * @valueSize:          the value size.
+ *
+ * Adds the @value for @key to the shared cache (the value already added
+ * for @key by this or another process is kept). The cache is cleared if
+ * there is no room for the new value. Does nothing if the cache is not
+ * enabled.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSharedCacheAdd(const xmlSecByte* key, xmlSecSize keySize,
+                     const xmlSecByte* value, xmlSecSize valueSize) {
+#ifdef XMLSEC_SHARED_CACHE
+    xmlSecSharedCacheHeaderPtr header = xmlSecSharedCacheMem;
+    xmlSecSharedCacheSlotPtr slot;
+    unsigned int hash;
+    xmlSecByte* data;
+    int ret;
+#endif /* XMLSEC_SHARED_CACHE */
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keySize > 0, -1);
+    xmlSecAssert2((value != NULL) || (valueSize == 0), -1);
+
+#ifdef XMLSEC_SHARED_CACHE
+    if((header == NULL) || (keySize + valueSize > header->dataSize / 4)) {
+        return(0);
+    }
+    hash = xmlSecSharedCacheHash(key, keySize);
+
+    ret = xmlSecSharedCacheLock(header);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecSharedCacheLock", NULL);
+        return(-1);
+    }
+    slot = xmlSecSharedCacheFind(header, key, keySize, hash);
+    if(slot->hash == 0) {
+        /* keep the hash table at most 3/4 full */
+        if((4 * (header->slotsUsed + 1) > 3 * header->slotsNumber) ||
+           (header->dataUsed + keySize + valueSize > header->dataSize)) {
+            xmlSecSharedCacheClear(header);
+            slot = xmlSecSharedCacheFind(header, key, keySize, hash);
+        }
+
+        data = xmlSecSharedCacheGetData(header) + header->dataUsed;
+        memcpy(data, key, keySize);
+        if(valueSize > 0) {
+            memcpy(data + keySize, value, valueSize);
+        }
+        slot->offset = header->dataUsed;
+        slot->keySize = keySize;
+        slot->valueSize = valueSize;
+        slot->hash = hash;
+        header->dataUsed += keySize + valueSize;
+        ++header->slotsUsed;
+    }
+    pthread_mutex_unlock(&(header->mutex));
+    return(0);
+#else  /* XMLSEC_SHARED_CACHE */
+    return(0);
+#endif /* XMLSEC_SHARED_CACHE */
+}
@@ -402,7 +402,9 @@ xmlSecSoap11GetBodyEntriesNumber(xmlNodePtr envNode) {
  * @envNode:    the pointer to <soap:Envelope> node.
  * @pos:        the body entry number.
  *
- * Gets the body entry number @pos.
+ * Gets the body entry number @pos. The search starts from the first
+ * entry on every call, use #xmlSecSoapBodyEntriesIter to walk through
+ * all the entries.
  *
  * Returns: pointer to body entry node or NULL if an error occurs.
  */
@@ -1061,7 +1063,9 @@ xmlSecSoap12GetBodyEntriesNumber(xmlNodePtr envNode) {
  * @envNode:    the pointer to <soap:Envelope> node.
  * @pos:        the body entry number.
  *
- * Gets the body entry number @pos.
+ * Gets the body entry number @pos. The search starts from the first
+ * entry on every call, use #xmlSecSoapBodyEntriesIter to walk through
+ * all the entries.
  *
  * Returns: pointer to body entry node or NULL if an error occurs.
  */
@@ -1112,6 +1116,155 @@ xmlSecSoap12GetFaultEntry(xmlNodePtr envNode) {
     return(xmlSecFindChild(bodyNode, xmlSecNodeFault, xmlSecSoap12Ns));
 }
 
+
+/***********************************************************************
+ *
+ * SOAP body entries iterator
+ *
+ **********************************************************************/
+/**
+ * xmlSecSoapBodyEntriesIterInitialize:
+ * @iter:       the pointer to body entries iterator.
+ * @bodyNode:   the pointer to <soap:Body> node (see #xmlSecSoap11GetBody
+ *              and #xmlSecSoap12GetBody).
+ *
+ * Initializes the body entries iterator. Unlike #xmlSecSoap11GetBodyEntry
+ * and #xmlSecSoap12GetBodyEntry that walk from the first entry on every
+ * call, the iterator continues from the last returned entry.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSoapBodyEntriesIterInitialize(xmlSecSoapBodyEntriesIterPtr iter, xmlNodePtr bodyNode) {
+    xmlSecAssert2(iter != NULL, -1);
+    xmlSecAssert2(bodyNode != NULL, -1);
+
+    memset(iter, 0, sizeof(xmlSecSoapBodyEntriesIter));
+    iter->bodyNode = bodyNode;
+    return(0);
+}
+
+/**
+ * xmlSecSoapBodyEntriesIterFinalize:
+ * @iter:       the pointer to body entries iterator.
+ *
+ * Cleans up the body entries iterator.
+ */
+void
+xmlSecSoapBodyEntriesIterFinalize(xmlSecSoapBodyEntriesIterPtr iter) {
+    xmlSecAssert(iter != NULL);
+
+    memset(iter, 0, sizeof(xmlSecSoapBodyEntriesIter));
+}
+
+/**
+ * xmlSecSoapBodyEntriesIterNext:
+ * @iter:       the pointer to body entries iterator.
+ *
+ * Moves the iterator to the next body entry (the first one after
+ * #xmlSecSoapBodyEntriesIterInitialize).
+ *
+ * Returns: pointer to the next body entry or NULL if there are no more entries.
+ */
+xmlNodePtr
+xmlSecSoapBodyEntriesIterNext(xmlSecSoapBodyEntriesIterPtr iter) {
+    xmlNodePtr next;
+
+    xmlSecAssert2(iter != NULL, NULL);
+    xmlSecAssert2(iter->bodyNode != NULL, NULL);
+
+    if(iter->cur == NULL) {
+        next = xmlSecGetNextElementNode(iter->bodyNode->children);
+        if(next != NULL) {
+            iter->pos = 0;
+            iter->cur = next;
+        }
+        return(next);
+    }
+
+    next = xmlSecGetNextElementNode(iter->cur->next);
+    if(next != NULL) {
+        ++iter->pos;
+        iter->cur = next;
+    }
+    return(next);
+}
+
+/**
+ * xmlSecSoapBodyEntriesIterGet:
+ * @iter:       the pointer to body entries iterator.
+ * @pos:        the body entry number.
+ *
+ * Gets the body entry number @pos and moves the iterator to it. The
+ * search starts from the current entry unless @pos is before it.
+ *
+ * Returns: pointer to body entry node or NULL if there is no such entry.
+ */
+xmlNodePtr
+xmlSecSoapBodyEntriesIterGet(xmlSecSoapBodyEntriesIterPtr iter, xmlSecSize pos) {
+    xmlSecAssert2(iter != NULL, NULL);
+    xmlSecAssert2(iter->bodyNode != NULL, NULL);
+
+    if((iter->sizeKnown != 0) && (pos >= iter->size)) {
+        return(NULL);
+    }
+    if((iter->cur != NULL) && (pos < iter->pos)) {
+        iter->cur = NULL;
+        iter->pos = 0;
+    }
+    if(iter->cur == NULL) {
+        if(xmlSecSoapBodyEntriesIterNext(iter) == NULL) {
+            return(NULL);
+        }
+    }
+    while(iter->pos < pos) {
+        if(xmlSecSoapBodyEntriesIterNext(iter) == NULL) {
+            return(NULL);
+        }
+    }
+
+    return(iter->cur);
+}
+
+/**
+ * xmlSecSoapBodyEntriesIterGetSize:
+ * @iter:       the pointer to body entries iterator.
+ *
+ * Gets the number of body entries. The entries are counted once, the
+ * following calls return the remembered value. The current iterator
+ * position is not changed.
+ *
+ * Returns: the number of body entries.
+ */
+xmlSecSize
+xmlSecSoapBodyEntriesIterGetSize(xmlSecSoapBodyEntriesIterPtr iter) {
+    xmlSecSize number = 0;
+    xmlNodePtr cur;
+
+    xmlSecAssert2(iter != NULL, 0);
+    xmlSecAssert2(iter->bodyNode != NULL, 0);
+
+    if(iter->sizeKnown != 0) {
+        return(iter->size);
+    }
+
+    /* count the remaining entries only */
+    if(iter->cur != NULL) {
+        number = iter->pos + 1;
+        cur = xmlSecGetNextElementNode(iter->cur->next);
+    } else {
+        cur = xmlSecGetNextElementNode(iter->bodyNode->children);
+    }
+    while(cur != NULL) {
+        number++;
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    iter->size = number;
+    iter->sizeKnown = 1;
+    return(number);
+}
+
 #endif /* XMLSEC_NO_SOAP */
 
 
@@ -108,6 +108,15 @@ const xmlChar xmlSecHrefAes192Cbc[]             = "http://www.w3.org/2001/04/xml
 const xmlChar xmlSecNameAes256Cbc[]             = "aes256-cbc";
 const xmlChar xmlSecHrefAes256Cbc[]             = "http://www.w3.org/2001/04/xmlenc#aes256-cbc";
 
+const xmlChar xmlSecNameAes128Gcm[]             = "aes128-gcm";
+const xmlChar xmlSecHrefAes128Gcm[]             = "http://www.w3.org/2009/xmlenc11#aes128-gcm";
+
+const xmlChar xmlSecNameAes192Gcm[]             = "aes192-gcm";
+const xmlChar xmlSecHrefAes192Gcm[]             = "http://www.w3.org/2009/xmlenc11#aes192-gcm";
+
+const xmlChar xmlSecNameAes256Gcm[]             = "aes256-gcm";
+const xmlChar xmlSecHrefAes256Gcm[]             = "http://www.w3.org/2009/xmlenc11#aes256-gcm";
+
 const xmlChar xmlSecNameKWAes128[]              = "kw-aes128";
 const xmlChar xmlSecHrefKWAes128[]              = "http://www.w3.org/2001/04/xmlenc#kw-aes128";
 
@@ -154,6 +163,15 @@ const xmlChar xmlSecNsExcC14NWithComments[]     = "http://www.w3.org/2001/10/xml
 const xmlChar xmlSecNodeInclusiveNamespaces[]   = "InclusiveNamespaces";
 const xmlChar xmlSecAttrPrefixList[]            = "PrefixList";
 
+const xmlChar xmlSecNameC14N2[]                 = "c14n2";
+const xmlChar xmlSecHrefC14N2[]                 = "http://www.w3.org/2010/xml-c14n2";
+const xmlChar xmlSecNsC14N2[]                   = "http://www.w3.org/2010/xml-c14n2";
+
+const xmlChar xmlSecNodeC14N2IgnoreComments[]   = "IgnoreComments";
+const xmlChar xmlSecNodeC14N2TrimTextNodes[]    = "TrimTextNodes";
+const xmlChar xmlSecNodeC14N2PrefixRewrite[]    = "PrefixRewrite";
+const xmlChar xmlSecNodeC14N2QNameAware[]       = "QNameAware";
+
 /*************************************************************************
  *
  * DES strings
@@ -257,6 +275,20 @@ const xmlChar xmlSecHrefEcdsaSha384[]           = "http://www.w3.org/2001/04/xml
 const xmlChar xmlSecNameEcdsaSha512[]           = "ecdsa-sha512";
 const xmlChar xmlSecHrefEcdsaSha512[]           = "http://www.w3.org/2001/04/xmldsig-more#ecdsa-sha512";
 
+/*************************************************************************
+ *
+ * EdDSA strings
+ *
+ ************************************************************************/
+const xmlChar xmlSecNameEd25519KeyValue[]       = "ed25519";
+const xmlChar xmlSecNameEd448KeyValue[]         = "ed448";
+
+const xmlChar xmlSecNameEd25519[]               = "eddsa-ed25519";
+const xmlChar xmlSecHrefEd25519[]               = "http://www.w3.org/2021/04/xmldsig-more#eddsa-ed25519";
+
+const xmlChar xmlSecNameEd448[]                 = "eddsa-ed448";
+const xmlChar xmlSecHrefEd448[]                 = "http://www.w3.org/2021/04/xmldsig-more#eddsa-ed448";
+
 /*************************************************************************
  *
  * EncryptedKey
@@ -506,6 +538,7 @@ const xmlChar xmlSecRelationshipReferenceNs[]   = "http://schemas.openxmlformats
 const xmlChar xmlSecRelationshipAttrId[]        = "Id";
 const xmlChar xmlSecRelationshipAttrSourceId[]  = "SourceId";
 const xmlChar xmlSecRelationshipAttrTargetMode[]= "TargetMode";
+const xmlChar xmlSecRelationshipsContentType[]  = "application/vnd.openxmlformats-package.relationships+xml";
 
 /*************************************************************************
  *
@@ -547,6 +580,20 @@ const xmlChar xmlSecSoapFaultCodeReceiver[]             = "Receiver";
 const xmlChar xmlSecSoapFaultCodeSender[]               = "Sender";
 const xmlChar xmlSecSoapFaultDataEncodningUnknown[]     = "DataEncodingUnknown";
 
+/*************************************************************************
+ *
+ * WS-Security strings
+ *
+ ************************************************************************/
+const xmlChar xmlSecWsseNs[]                    = "http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-secext-1.0.xsd";
+const xmlChar xmlSecWsuNs[]                     = "http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-utility-1.0.xsd";
+const xmlChar xmlSecNodeSecurity[]              = "Security";
+const xmlChar xmlSecNodeBinarySecurityToken[]   = "BinarySecurityToken";
+const xmlChar xmlSecNodeSecurityTokenReference[]= "SecurityTokenReference";
+const xmlChar xmlSecNodeTimestamp[]             = "Timestamp";
+const xmlChar xmlSecAttrValueType[]             = "ValueType";
+const xmlChar xmlSecWsseValueTypeX509v3[]       = "http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-x509-token-profile-1.0#X509v3";
+
 
 #endif /* XMLSEC_NO_SOAP */
 
@@ -512,6 +512,117 @@ xmlSecTmplManifestAddReference(xmlNodePtr manifestNode, xmlSecTransformId digest
     return(xmlSecTmplAddReference(manifestNode, digestMethodId, id, uri, type));
 }
 
+/**
+ * xmlSecTmplManifestAddPackagePart:
+ * @manifestNode:       the pointer to <dsig:Manifest/> node.
+ * @digestMethodId:     the reference digest method.
+ * @partName:           the OPC package part name (e.g. "/word/document.xml").
+ * @contentType:        the part content type.
+ *
+ * Adds <dsig:Reference/> node for the OPC (Office Open XML) package part
+ * @partName to the package <dsig:Manifest/> node @manifestNode. The reference
+ * URI is "@partName?ContentType=@contentType" and the part data is read
+ * through the registered IO callbacks (the application is expected to map
+ * the part names to the package zip entries). Use
+ * #XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES flag to digest the parts concurrently.
+ *
+ * Returns: the pointer to newly created <dsig:Reference/> node or NULL
+ * if an error occurs.
+ */
+xmlNodePtr
+xmlSecTmplManifestAddPackagePart(xmlNodePtr manifestNode, xmlSecTransformId digestMethodId,
+                                 const xmlChar *partName, const xmlChar *contentType) {
+    xmlChar* uri;
+    xmlNodePtr res;
+
+    xmlSecAssert2(manifestNode != NULL, NULL);
+    xmlSecAssert2(partName != NULL, NULL);
+    xmlSecAssert2(contentType != NULL, NULL);
+
+    uri = xmlStrdup(partName);
+    if(uri != NULL) {
+        uri = xmlStrcat(uri, BAD_CAST "?ContentType=");
+    }
+    if(uri != NULL) {
+        uri = xmlStrcat(uri, contentType);
+    }
+    if(uri == NULL) {
+        xmlSecStrdupError(partName, NULL);
+        return(NULL);
+    }
+
+    res = xmlSecTmplAddReference(manifestNode, digestMethodId, NULL, uri, NULL);
+    if(res == NULL) {
+        xmlSecInternalError2("xmlSecTmplAddReference", NULL,
+                             "uri=%s", xmlSecErrorsSafeString(uri));
+        xmlFree(uri);
+        return(NULL);
+    }
+
+    xmlFree(uri);
+    return(res);
+}
+
+/**
+ * xmlSecTmplManifestAddPackageRelationships:
+ * @manifestNode:       the pointer to <dsig:Manifest/> node.
+ * @digestMethodId:     the reference digest method.
+ * @partName:           the OPC relationships part name (e.g. "/_rels/.rels").
+ * @sourceIds:          the NULL terminated list of the signed relationships Ids.
+ *
+ * Adds <dsig:Reference/> node for the OPC package relationships part
+ * @partName to the package <dsig:Manifest/> node @manifestNode. Only the
+ * relationships with Ids from @sourceIds list are signed: the reference
+ * has the Relationship transform followed by the inclusive C14N transform.
+ *
+ * Returns: the pointer to newly created <dsig:Reference/> node or NULL
+ * if an error occurs.
+ */
+xmlNodePtr
+xmlSecTmplManifestAddPackageRelationships(xmlNodePtr manifestNode, xmlSecTransformId digestMethodId,
+                                          const xmlChar *partName, const xmlChar **sourceIds) {
+    xmlNodePtr res;
+    xmlNodePtr transformNode;
+    const xmlChar **ptr;
+    int ret;
+
+    xmlSecAssert2(manifestNode != NULL, NULL);
+    xmlSecAssert2(partName != NULL, NULL);
+    xmlSecAssert2(sourceIds != NULL, NULL);
+
+    res = xmlSecTmplManifestAddPackagePart(manifestNode, digestMethodId,
+                                           partName, xmlSecRelationshipsContentType);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecTmplManifestAddPackagePart", NULL);
+        return(NULL);
+    }
+
+    transformNode = xmlSecTmplReferenceAddTransform(res, xmlSecTransformRelationshipId);
+    if(transformNode == NULL) {
+        xmlSecInternalError("xmlSecTmplReferenceAddTransform(xmlSecTransformRelationshipId)", NULL);
+        goto error;
+    }
+    for(ptr = sourceIds; (*ptr) != NULL; ++ptr) {
+        ret = xmlSecTmplTransformAddRelationshipReference(transformNode, (*ptr));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTmplTransformAddRelationshipReference", NULL);
+            goto error;
+        }
+    }
+
+    transformNode = xmlSecTmplReferenceAddTransform(res, xmlSecTransformInclC14NId);
+    if(transformNode == NULL) {
+        xmlSecInternalError("xmlSecTmplReferenceAddTransform(xmlSecTransformInclC14NId)", NULL);
+        goto error;
+    }
+    return(res);
+
+error:
+    xmlUnlinkNode(res);
+    xmlFreeNode(res);
+    return(NULL);
+}
+
 /**************************************************************************
  *
  * <enc:EncryptedData/> node
@@ -1694,6 +1805,40 @@ xmlSecTmplTransformAddXPointer(xmlNodePtr transformNode, const xmlChar *expressi
     return((nsList != NULL) ? xmlSecTmplNodeWriteNsList(xpointerNode, nsList) : 0);
 }
 
+/**
+ * xmlSecTmplTransformAddRelationshipReference:
+ * @transformNode:      the pointer to the Relationship <dsig:Transform/> node.
+ * @sourceId:           the Id of the relationship to sign.
+ *
+ * Adds <mdssi:RelationshipReference/> node with SourceId attribute @sourceId
+ * to the Relationship transform node @transformNode.
+ *
+ * Returns: 0 for success or a negative value otherwise.
+ */
+int
+xmlSecTmplTransformAddRelationshipReference(xmlNodePtr transformNode, const xmlChar *sourceId) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(transformNode != NULL, -1);
+    xmlSecAssert2(sourceId != NULL, -1);
+
+    cur = xmlSecAddChild(transformNode, xmlSecNodeRelationshipReference, xmlSecRelationshipReferenceNs);
+    if(cur == NULL) {
+        xmlSecInternalError("xmlSecAddChild(xmlSecNodeRelationshipReference)",
+                            xmlSecNodeGetName(transformNode));
+        return(-1);
+    }
+
+    if(xmlSetProp(cur, xmlSecRelationshipAttrSourceId, sourceId) == NULL) {
+        xmlSecXmlError2("xmlSetProp", NULL,
+                        "name=%s", xmlSecErrorsSafeString(xmlSecRelationshipAttrSourceId));
+        xmlUnlinkNode(cur);
+        xmlFreeNode(cur);
+        return(-1);
+    }
+    return(0);
+}
+
 static int
 xmlSecTmplNodeWriteNsList(xmlNodePtr parentNode, const xmlChar** nsList) {
     xmlNsPtr ns;
@@ -1733,3 +1878,490 @@ xmlSecTmplNodeWriteNsList(xmlNodePtr parentNode, const xmlChar** nsList) {
     }
     return(0);
 }
+
+/**************************************************************************
+ *
+ * Frozen templates
+ *
+ * Building a template node by node costs a lot of node allocations and
+ * namespace lookups. An application that signs or encrypts many messages
+ * with the same template can build it once, freeze it with
+ * #xmlSecTmplFreeze and then stamp a copy into every new document with
+ * #xmlSecTmplFrozenStamp. The stamp copies the nodes directly, maps the
+ * namespaces through a small pre-resolved table instead of searching the
+ * tree and optionally makes the template Id attributes (and the
+ * same-document URI attributes that point to them) unique.
+ *
+ *************************************************************************/
+#define XMLSEC_TMPL_FROZEN_NS_BUF_SIZE          16
+
+struct _xmlSecTmplFrozen {
+    xmlDocPtr           doc;
+    xmlNodePtr          node;
+    xmlSecSize          nsCount;
+    xmlAttrPtr*         rewriteAttrs;
+    xmlSecSize          rewriteAttrsSize;
+    xmlSecSize          rewriteAttrsMaxSize;
+};
+
+typedef struct _xmlSecTmplStampCtx {
+    xmlSecTmplFrozenPtr frozen;
+    xmlDocPtr           doc;
+    const xmlChar*      idSuffix;
+    xmlNsPtr*           srcNs;
+    xmlNsPtr*           dstNs;
+    xmlSecSize          nsUsed;
+} xmlSecTmplStampCtx, *xmlSecTmplStampCtxPtr;
+
+static int              xmlSecTmplFrozenScan            (xmlSecTmplFrozenPtr frozen,
+                                                         xmlNodePtr cur);
+static int              xmlSecTmplFrozenHasId           (xmlNodePtr cur,
+                                                         const xmlChar* id);
+static int              xmlSecTmplFrozenAddRewriteAttr  (xmlSecTmplFrozenPtr frozen,
+                                                         xmlAttrPtr attr);
+static int              xmlSecTmplFrozenIsRewriteAttr   (xmlSecTmplFrozenPtr frozen,
+                                                         xmlAttrPtr attr);
+static xmlNsPtr         xmlSecTmplStampMapNs            (xmlSecTmplStampCtxPtr ctx,
+                                                         xmlNodePtr node,
+                                                         xmlNsPtr ns);
+static xmlNodePtr       xmlSecTmplStampCopyNode         (xmlSecTmplStampCtxPtr ctx,
+                                                         xmlNodePtr src,
+                                                         xmlNodePtr parent);
+static int              xmlSecTmplStampCopyAttr         (xmlSecTmplStampCtxPtr ctx,
+                                                         xmlAttrPtr attr,
+                                                         xmlNodePtr node);
+
+/**
+ * xmlSecTmplFreeze:
+ * @tmplNode:           the pointer to a template node (e.g. <dsig:Signature/>
+ *                      or <enc:EncryptedData/> node).
+ *
+ * Creates a frozen copy of the template @tmplNode. The copy is private to the
+ * returned object and does not depend on @tmplNode or its document, so the
+ * original template can be freed right away. All the namespaces used by the
+ * template are declared inside the frozen copy.
+ *
+ * A frozen template is never modified after creation: it is safe to stamp
+ * the same frozen template from several threads at the same time.
+ * The caller is responsible for destroying the returned object
+ * with #xmlSecTmplFrozenDestroy function.
+ *
+ * Returns: the pointer to newly created frozen template or NULL if an error occurs.
+ */
+xmlSecTmplFrozenPtr
+xmlSecTmplFreeze(xmlNodePtr tmplNode) {
+    xmlSecTmplFrozenPtr frozen;
+    int ret;
+
+    xmlSecAssert2(tmplNode != NULL, NULL);
+    xmlSecAssert2(tmplNode->type == XML_ELEMENT_NODE, NULL);
+
+    frozen = (xmlSecTmplFrozenPtr)xmlMalloc(sizeof(xmlSecTmplFrozen));
+    if(frozen == NULL) {
+        xmlSecMallocError(sizeof(xmlSecTmplFrozen), NULL);
+        return(NULL);
+    }
+    memset(frozen, 0, sizeof(xmlSecTmplFrozen));
+
+    frozen->doc = xmlNewDoc(BAD_CAST "1.0");
+    if(frozen->doc == NULL) {
+        xmlSecXmlError("xmlNewDoc", NULL);
+        xmlSecTmplFrozenDestroy(frozen);
+        return(NULL);
+    }
+
+    frozen->node = xmlDocCopyNode(tmplNode, frozen->doc, 1);
+    if(frozen->node == NULL) {
+        xmlSecXmlError("xmlDocCopyNode", NULL);
+        xmlSecTmplFrozenDestroy(frozen);
+        return(NULL);
+    }
+    xmlDocSetRootElement(frozen->doc, frozen->node);
+
+    /* make sure all the namespaces are declared inside the template */
+    ret = xmlReconciliateNs(frozen->doc, frozen->node);
+    if(ret < 0) {
+        xmlSecXmlError("xmlReconciliateNs", NULL);
+        xmlSecTmplFrozenDestroy(frozen);
+        return(NULL);
+    }
+
+    ret = xmlSecTmplFrozenScan(frozen, frozen->node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTmplFrozenScan", NULL);
+        xmlSecTmplFrozenDestroy(frozen);
+        return(NULL);
+    }
+
+    return(frozen);
+}
+
+/**
+ * xmlSecTmplFrozenDestroy:
+ * @frozen:             the pointer to frozen template.
+ *
+ * Destroys the frozen template created with #xmlSecTmplFreeze function.
+ */
+void
+xmlSecTmplFrozenDestroy(xmlSecTmplFrozenPtr frozen) {
+    xmlSecAssert(frozen != NULL);
+
+    if(frozen->rewriteAttrs != NULL) {
+        xmlFree(frozen->rewriteAttrs);
+    }
+    if(frozen->doc != NULL) {
+        xmlFreeDoc(frozen->doc);
+    }
+    memset(frozen, 0, sizeof(xmlSecTmplFrozen));
+    xmlFree(frozen);
+}
+
+/**
+ * xmlSecTmplFrozenStamp:
+ * @frozen:             the pointer to frozen template.
+ * @doc:                the pointer to signature or encryption document.
+ * @idSuffix:           the optional suffix for the template Id attributes.
+ *
+ * Creates a new copy of the frozen template in the document @doc. The
+ * returned node is not linked to the document and the caller is responsible
+ * for inserting it (see #xmlSecTmplSignatureCreate for the same convention).
+ *
+ * If @idSuffix is not NULL then it is appended to the value of every Id
+ * attribute of the template and to every same-document URI attribute
+ * ("#id") that refers to one of these Id attributes, so the copies stamped
+ * into one document stay unique.
+ *
+ * Returns: the pointer to newly created template node or NULL if an error occurs.
+ */
+xmlNodePtr
+xmlSecTmplFrozenStamp(xmlSecTmplFrozenPtr frozen, xmlDocPtr doc, const xmlChar *idSuffix) {
+    xmlNsPtr nsBuf[2 * XMLSEC_TMPL_FROZEN_NS_BUF_SIZE];
+    xmlNsPtr* nsMap = NULL;
+    xmlSecTmplStampCtx ctx;
+    xmlNodePtr res;
+
+    xmlSecAssert2(frozen != NULL, NULL);
+    xmlSecAssert2(frozen->node != NULL, NULL);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.frozen   = frozen;
+    ctx.doc      = doc;
+    ctx.idSuffix = ((idSuffix != NULL) && (idSuffix[0] != '\0')) ? idSuffix : NULL;
+
+    /* the namespaces map is tiny for real templates */
+    if(frozen->nsCount <= XMLSEC_TMPL_FROZEN_NS_BUF_SIZE) {
+        ctx.srcNs = nsBuf;
+        ctx.dstNs = nsBuf + XMLSEC_TMPL_FROZEN_NS_BUF_SIZE;
+    } else {
+        nsMap = (xmlNsPtr*)xmlMalloc(2 * frozen->nsCount * sizeof(xmlNsPtr));
+        if(nsMap == NULL) {
+            xmlSecMallocError(2 * frozen->nsCount * sizeof(xmlNsPtr), NULL);
+            return(NULL);
+        }
+        ctx.srcNs = nsMap;
+        ctx.dstNs = nsMap + frozen->nsCount;
+    }
+
+    res = xmlSecTmplStampCopyNode(&ctx, frozen->node, NULL);
+    if(res == NULL) {
+        xmlSecInternalError("xmlSecTmplStampCopyNode", NULL);
+    }
+
+    if(nsMap != NULL) {
+        xmlFree(nsMap);
+    }
+    return(res);
+}
+
+static int
+xmlSecTmplFrozenScan(xmlSecTmplFrozenPtr frozen, xmlNodePtr cur) {
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+    xmlChar* value;
+    int ret;
+
+    xmlSecAssert2(frozen != NULL, -1);
+
+    for(; cur != NULL; cur = cur->next) {
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+
+        for(ns = cur->nsDef; ns != NULL; ns = ns->next) {
+            ++frozen->nsCount;
+        }
+
+        for(attr = cur->properties; attr != NULL; attr = attr->next) {
+            if(attr->ns != NULL) {
+                continue;
+            }
+            if(xmlStrEqual(attr->name, xmlSecAttrId)) {
+                ret = xmlSecTmplFrozenAddRewriteAttr(frozen, attr);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecTmplFrozenAddRewriteAttr", NULL);
+                    return(-1);
+                }
+            } else if(xmlStrEqual(attr->name, xmlSecAttrURI)) {
+                /* only the plain "#id" references to the template itself */
+                value = xmlNodeListGetString(frozen->doc, attr->children, 1);
+                if((value != NULL) && (value[0] == '#') &&
+                   (xmlStrchr(value, '(') == NULL) &&
+                   (xmlSecTmplFrozenHasId(frozen->node, value + 1) == 1)) {
+                    ret = xmlSecTmplFrozenAddRewriteAttr(frozen, attr);
+                    if(ret < 0) {
+                        xmlSecInternalError("xmlSecTmplFrozenAddRewriteAttr", NULL);
+                        xmlFree(value);
+                        return(-1);
+                    }
+                }
+                if(value != NULL) {
+                    xmlFree(value);
+                }
+            }
+        }
+
+        ret = xmlSecTmplFrozenScan(frozen, cur->children);
+        if(ret < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecTmplFrozenHasId(xmlNodePtr cur, const xmlChar* id) {
+    xmlChar* value;
+    int found;
+
+    xmlSecAssert2(id != NULL, -1);
+
+    for(; cur != NULL; cur = cur->next) {
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+
+        value = xmlGetNoNsProp(cur, xmlSecAttrId);
+        if(value != NULL) {
+            found = xmlStrEqual(value, id);
+            xmlFree(value);
+            if(found) {
+                return(1);
+            }
+        }
+
+        if(xmlSecTmplFrozenHasId(cur->children, id) == 1) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecTmplFrozenAddRewriteAttr(xmlSecTmplFrozenPtr frozen, xmlAttrPtr attr) {
+    xmlAttrPtr* newAttrs;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(frozen != NULL, -1);
+    xmlSecAssert2(attr != NULL, -1);
+
+    if(frozen->rewriteAttrsSize >= frozen->rewriteAttrsMaxSize) {
+        newSize = (frozen->rewriteAttrsMaxSize > 0) ? 2 * frozen->rewriteAttrsMaxSize : 8;
+        newAttrs = (xmlAttrPtr*)xmlRealloc(frozen->rewriteAttrs, newSize * sizeof(xmlAttrPtr));
+        if(newAttrs == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlAttrPtr), NULL);
+            return(-1);
+        }
+        frozen->rewriteAttrs = newAttrs;
+        frozen->rewriteAttrsMaxSize = newSize;
+    }
+    frozen->rewriteAttrs[frozen->rewriteAttrsSize++] = attr;
+    return(0);
+}
+
+static int
+xmlSecTmplFrozenIsRewriteAttr(xmlSecTmplFrozenPtr frozen, xmlAttrPtr attr) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(frozen != NULL, 0);
+
+    for(ii = 0; ii < frozen->rewriteAttrsSize; ++ii) {
+        if(frozen->rewriteAttrs[ii] == attr) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static xmlNsPtr
+xmlSecTmplStampMapNs(xmlSecTmplStampCtxPtr ctx, xmlNodePtr node, xmlNsPtr ns) {
+    xmlNsPtr res;
+    xmlSecSize ii;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(ns != NULL, NULL);
+
+    for(ii = ctx->nsUsed; ii > 0; --ii) {
+        if(ctx->srcNs[ii - 1] == ns) {
+            return(ctx->dstNs[ii - 1]);
+        }
+    }
+
+    /* not declared in the template (e.g. the "xml" namespace) */
+    res = xmlSearchNsByHref(ctx->doc, node, ns->href);
+    if(res == NULL) {
+        xmlSecXmlError2("xmlSearchNsByHref", NULL,
+                        "href=%s", xmlSecErrorsSafeString(ns->href));
+        return(NULL);
+    }
+    return(res);
+}
+
+static xmlNodePtr
+xmlSecTmplStampCopyNode(xmlSecTmplStampCtxPtr ctx, xmlNodePtr src, xmlNodePtr parent) {
+    xmlNodePtr res;
+    xmlNodePtr cur;
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+    xmlSecSize nsStart;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->frozen != NULL, NULL);
+    xmlSecAssert2(src != NULL, NULL);
+
+    /* text, comments, etc. do not need namespaces */
+    if(src->type != XML_ELEMENT_NODE) {
+        res = xmlDocCopyNode(src, ctx->doc, 1);
+        if(res == NULL) {
+            xmlSecXmlError("xmlDocCopyNode", NULL);
+            return(NULL);
+        }
+        if(parent != NULL) {
+            /* adjacent text nodes might be merged */
+            res = xmlAddChild(parent, res);
+        }
+        return(res);
+    }
+
+    res = xmlNewDocNode(ctx->doc, NULL, src->name, NULL);
+    if(res == NULL) {
+        xmlSecXmlError2("xmlNewDocNode", NULL,
+                        "node=%s", xmlSecErrorsSafeString(src->name));
+        return(NULL);
+    }
+    if(parent != NULL) {
+        xmlAddChild(parent, res);
+    }
+
+    nsStart = ctx->nsUsed;
+    for(ns = src->nsDef; ns != NULL; ns = ns->next) {
+        xmlSecAssert2(ctx->nsUsed < ctx->frozen->nsCount, NULL);
+
+        ctx->srcNs[ctx->nsUsed] = ns;
+        ctx->dstNs[ctx->nsUsed] = xmlNewNs(res, ns->href, ns->prefix);
+        if(ctx->dstNs[ctx->nsUsed] == NULL) {
+            xmlSecXmlError2("xmlNewNs", NULL,
+                            "prefix=%s", xmlSecErrorsSafeString(ns->prefix));
+            goto error;
+        }
+        ++ctx->nsUsed;
+    }
+
+    if(src->ns != NULL) {
+        ns = xmlSecTmplStampMapNs(ctx, res, src->ns);
+        if(ns == NULL) {
+            xmlSecInternalError("xmlSecTmplStampMapNs", NULL);
+            goto error;
+        }
+        xmlSetNs(res, ns);
+    }
+
+    for(attr = src->properties; attr != NULL; attr = attr->next) {
+        ret = xmlSecTmplStampCopyAttr(ctx, attr, res);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTmplStampCopyAttr", NULL,
+                                 "attr=%s", xmlSecErrorsSafeString(attr->name));
+            goto error;
+        }
+    }
+
+    for(cur = src->children; cur != NULL; cur = cur->next) {
+        if(xmlSecTmplStampCopyNode(ctx, cur, res) == NULL) {
+            goto error;
+        }
+    }
+
+    ctx->nsUsed = nsStart;
+    return(res);
+
+error:
+    ctx->nsUsed = nsStart;
+    if(parent == NULL) {
+        /* the children are linked to the node; the inner nodes are
+         * destroyed together with the root */
+        xmlFreeNode(res);
+    }
+    return(NULL);
+}
+
+static int
+xmlSecTmplStampCopyAttr(xmlSecTmplStampCtxPtr ctx, xmlAttrPtr attr, xmlNodePtr node) {
+    xmlNsPtr ns = NULL;
+    xmlChar* buf = NULL;
+    const xmlChar* value;
+    xmlAttrPtr res;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(attr != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* the common case: the value is a single text node */
+    if((attr->children != NULL) && (attr->children->next == NULL) &&
+       (attr->children->type == XML_TEXT_NODE)) {
+        value = attr->children->content;
+    } else {
+        buf = xmlNodeListGetString(ctx->frozen->doc, attr->children, 1);
+        value = buf;
+    }
+
+    if((ctx->idSuffix != NULL) && (xmlSecTmplFrozenIsRewriteAttr(ctx->frozen, attr) == 1)) {
+        xmlChar* tmp;
+
+        tmp = xmlStrncatNew(value, ctx->idSuffix, -1);
+        if(tmp == NULL) {
+            xmlSecStrdupError(ctx->idSuffix, NULL);
+            if(buf != NULL) {
+                xmlFree(buf);
+            }
+            return(-1);
+        }
+        if(buf != NULL) {
+            xmlFree(buf);
+        }
+        buf = tmp;
+        value = buf;
+    }
+
+    if(attr->ns != NULL) {
+        ns = xmlSecTmplStampMapNs(ctx, node, attr->ns);
+        if(ns == NULL) {
+            xmlSecInternalError("xmlSecTmplStampMapNs", NULL);
+            if(buf != NULL) {
+                xmlFree(buf);
+            }
+            return(-1);
+        }
+    }
+
+    res = xmlNewNsProp(node, ns, attr->name, value);
+    if(buf != NULL) {
+        xmlFree(buf);
+    }
+    if(res == NULL) {
+        xmlSecXmlError2("xmlNewNsProp", NULL,
+                        "attr=%s", xmlSecErrorsSafeString(attr->name));
+        return(-1);
+    }
+    return(0);
+}
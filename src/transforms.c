@@ -43,8 +43,19 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define XMLSEC_TRANSFORM_CACHE_WIN32    1
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#define XMLSEC_TRANSFORM_CACHE_PTHREAD  1
+#endif /* defined(_WIN32) */
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 #include <libxml/xpath.h>
 #include <libxml/xpointer.h>
 
@@ -59,10 +70,58 @@
 #include <xmlsec/io.h>
 #include <xmlsec/membuf.h>
 #include <xmlsec/parser.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/io.h>
+#include <xmlsec/private/transforms.h>
+#include <xmlsec/private/xpath.h>
 #include <xmlsec/private/xslt.h>
 
+/* the max number of released transforms kept by the transforms chain context */
+#define XMLSEC_TRANSFORM_CTX_FREE_TRANSFORMS_MAX        16
+
+/* the max number of destroyed transforms kept by one thread */
+#define XMLSEC_TRANSFORM_THREAD_CACHE_MAX               16
+
+/* the stack buffer for the decoded DigestValue or SignatureValue (RSA 8192 bits) */
+#define XMLSEC_TRANSFORM_VERIFY_STACK_SIZE              1024
+
+/* the outBuf inline storage allocated with the digest, HMAC and signature
+ * transforms: the results (up to RSA 4096 bits) need no heap allocation */
+#define XMLSEC_TRANSFORM_OUT_BUF_INLINE_SIZE            512
+
+/* the transform private data goes after the klass data aligned to this */
+#define XMLSEC_TRANSFORM_PRIVATE_ALIGN                  16
+#define xmlSecTransformPrivateOffset(id) \
+    ((((id)->objSize) + XMLSEC_TRANSFORM_PRIVATE_ALIGN - 1) / XMLSEC_TRANSFORM_PRIVATE_ALIGN * XMLSEC_TRANSFORM_PRIVATE_ALIGN)
+
+/* the transform statistics or NULL if the transform has no private data */
+#define xmlSecTransformStatsGet(transform) \
+    ((xmlSecTransformGetPrivate(transform) != NULL) ? \
+        &(xmlSecTransformGetPrivate(transform)->stats) : \
+        (xmlSecTransformStatsPtr)NULL)
+
+static xmlSecTransformPtr       xmlSecTransformCtxCreateTransform       (xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecTransformId id);
+static void                     xmlSecTransformCtxReleaseTransform      (xmlSecTransformCtxPtr ctx,
+                                                                         xmlSecTransformPtr transform);
+static void                     xmlSecTransformCtxFreeTransformsDestroy (xmlSecTransformCtxPtr ctx);
+static int                      xmlSecTransformCtxCheckTransformsNumber (xmlSecTransformCtxPtr ctx);
+static void                     xmlSecTransformStatsDebugDump           (xmlSecTransformStatsPtr stats,
+                                                                         FILE* output);
+static void                     xmlSecTransformStatsDebugXmlDump        (xmlSecTransformStatsPtr stats,
+                                                                         FILE* output);
+static double                   xmlSecTransformStatsNow                 (void);
+static void                     xmlSecTransformFree                     (xmlSecTransformPtr transform);
+static int                      xmlSecTransformRecycle                  (xmlSecTransformPtr transform);
+static int                      xmlSecTransformReuse                    (xmlSecTransformPtr transform);
+static void                     xmlSecTransformFreeRecycled             (xmlSecTransformPtr transform);
+static void                     xmlSecTransformThreadCacheInitialize    (void);
+static void                     xmlSecTransformThreadCacheShutdown      (void);
+static xmlSecTransformPtr       xmlSecTransformThreadCacheTake          (xmlSecTransformId id);
+static int                      xmlSecTransformThreadCachePut           (xmlSecTransformPtr transform);
+
 /**************************************************************************
  *
  * Global xmlSecTransformIds list functions
@@ -70,6 +129,24 @@
  *************************************************************************/
 static xmlSecPtrList xmlSecAllTransformIds;
 
+/*
+ * The href and name indexes of xmlSecAllTransformIds: the first registered
+ * klass wins on duplicates to match the list order. The indexes are built
+ * on the first lookup rather than on every registration (most klasses
+ * are never looked up by a short-lived process) and are only used while
+ * they cover every item in the list. After #xmlSecTransformIdsFreeze the
+ * list and the indexes never change and are read without the mutex.
+ */
+static xmlHashTablePtr xmlSecAllTransformIdsByHref = NULL;
+static xmlHashTablePtr xmlSecAllTransformIdsByName = NULL;
+static xmlSecSize xmlSecAllTransformIdsIndexed = 0;
+static xmlMutexPtr xmlSecAllTransformIdsIndexMutex = NULL;
+static int xmlSecAllTransformIdsFrozen = 0;
+
+static int              xmlSecTransformIdsIndexAdd              (xmlSecTransformId id);
+static int              xmlSecTransformIdsIndexRebuild          (void);
+static int              xmlSecTransformIdsIndexEnsure           (xmlSecPtrListPtr list);
+static void             xmlSecTransformIdsIndexFinalize         (void);
 
 /**
  * xmlSecTransformIdsGet:
@@ -101,12 +178,23 @@ xmlSecTransformIdsInit(void) {
         return(-1);
     }
 
+    xmlSecAllTransformIdsIndexMutex = xmlNewMutex();
+    if(xmlSecAllTransformIdsIndexMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
+    xmlSecTransformThreadCacheInitialize();
+
     ret = xmlSecTransformIdsRegisterDefault();
     if(ret < 0) {
         xmlSecInternalError("xmlSecTransformIdsRegisterDefault", NULL);
         return(-1);
     }
 
+    xmlSecTransformXPathCacheInitialize();
+    xmlSecTransformC14NCacheInitialize();
+
 #ifndef XMLSEC_NO_XSLT
     xmlSecTransformXsltInitialize();
 #endif /* XMLSEC_NO_XSLT */
@@ -122,11 +210,132 @@ xmlSecTransformIdsInit(void) {
  */
 void
 xmlSecTransformIdsShutdown(void) {
+    xmlSecTransformThreadCacheShutdown();
+
 #ifndef XMLSEC_NO_XSLT
     xmlSecTransformXsltShutdown();
 #endif /* XMLSEC_NO_XSLT */
 
+    xmlSecTransformXPathCacheShutdown();
+    xmlSecTransformC14NCacheShutdown();
+
+    xmlSecTransformIdsIndexFinalize();
     xmlSecPtrListFinalize(xmlSecTransformIdsGet());
+    xmlSecAllTransformIdsFrozen = 0;
+
+    if(xmlSecAllTransformIdsIndexMutex != NULL) {
+        xmlFreeMutex(xmlSecAllTransformIdsIndexMutex);
+        xmlSecAllTransformIdsIndexMutex = NULL;
+    }
+}
+
+static void
+xmlSecTransformIdsIndexFinalize(void) {
+    if(xmlSecAllTransformIdsByHref != NULL) {
+        xmlHashFree(xmlSecAllTransformIdsByHref, NULL);
+        xmlSecAllTransformIdsByHref = NULL;
+    }
+    if(xmlSecAllTransformIdsByName != NULL) {
+        xmlHashFree(xmlSecAllTransformIdsByName, NULL);
+        xmlSecAllTransformIdsByName = NULL;
+    }
+    xmlSecAllTransformIdsIndexed = 0;
+}
+
+static int
+xmlSecTransformIdsIndexRebuild(void) {
+    xmlSecTransformId id;
+    xmlSecSize i, size;
+    int ret;
+
+    xmlSecTransformIdsIndexFinalize();
+
+    size = xmlSecPtrListGetSize(xmlSecTransformIdsGet());
+    for(i = 0; i < size; ++i) {
+        id = (xmlSecTransformId)xmlSecPtrListGetItem(xmlSecTransformIdsGet(), i);
+        xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
+
+        ret = xmlSecTransformIdsIndexAdd(id);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformIdsIndexAdd",
+                                xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecTransformIdsIndexAdd(xmlSecTransformId id) {
+    xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
+
+    if(xmlSecAllTransformIdsByHref == NULL) {
+        xmlSecAllTransformIdsByHref = xmlHashCreate(0);
+        if(xmlSecAllTransformIdsByHref == NULL) {
+            xmlSecXmlError("xmlHashCreate", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+    }
+    if(xmlSecAllTransformIdsByName == NULL) {
+        xmlSecAllTransformIdsByName = xmlHashCreate(0);
+        if(xmlSecAllTransformIdsByName == NULL) {
+            xmlSecXmlError("xmlHashCreate", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+    }
+
+    /* keep the first klass on duplicates */
+    if((id->href != NULL) && (xmlHashLookup(xmlSecAllTransformIdsByHref, id->href) == NULL)) {
+        if(xmlHashAddEntry(xmlSecAllTransformIdsByHref, id->href, (void*)id) < 0) {
+            xmlSecXmlError2("xmlHashAddEntry", xmlSecTransformKlassGetName(id),
+                            "href=%s", xmlSecErrorsSafeString(id->href));
+            return(-1);
+        }
+    }
+    if((id->name != NULL) && (xmlHashLookup(xmlSecAllTransformIdsByName, id->name) == NULL)) {
+        if(xmlHashAddEntry(xmlSecAllTransformIdsByName, id->name, (void*)id) < 0) {
+            xmlSecXmlError("xmlHashAddEntry", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+    }
+
+    ++xmlSecAllTransformIdsIndexed;
+    return(0);
+}
+
+/* returns 1 if the indexes can be used for lookups in @list, 0 otherwise */
+static int
+xmlSecTransformIdsIndexEnsure(xmlSecPtrListPtr list) {
+    int ret;
+
+    if(list != xmlSecTransformIdsGet()) {
+        return(0);
+    }
+    if(xmlSecAllTransformIdsFrozen != 0) {
+        return(1);
+    }
+    if((xmlSecAllTransformIdsByHref != NULL) &&
+       (xmlSecAllTransformIdsByName != NULL) &&
+       (xmlSecAllTransformIdsIndexed == xmlSecPtrListGetSize(xmlSecTransformIdsGet()))) {
+        return(1);
+    }
+    if(xmlSecAllTransformIdsIndexMutex == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecAllTransformIdsIndexMutex);
+    if(xmlSecAllTransformIdsIndexed != xmlSecPtrListGetSize(xmlSecTransformIdsGet())) {
+        ret = xmlSecTransformIdsIndexRebuild();
+        if(ret < 0) {
+            /* fall back to the list scan */
+            xmlSecInternalError("xmlSecTransformIdsIndexRebuild", NULL);
+            xmlSecTransformIdsIndexFinalize();
+        }
+    }
+    ret = (xmlSecAllTransformIdsIndexed == xmlSecPtrListGetSize(xmlSecTransformIdsGet())) ? 1 : 0;
+    xmlMutexUnlock(xmlSecAllTransformIdsIndexMutex);
+
+    return(ret);
 }
 
 /**
@@ -143,6 +352,14 @@ xmlSecTransformIdsRegister(xmlSecTransformId id) {
 
     xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
 
+    if(xmlSecAllTransformIdsFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION,
+                         xmlSecTransformKlassGetName(id),
+                         "transform klasses are frozen");
+        return(-1);
+    }
+
+    /* the indexes are rebuilt on the next lookup */
     ret = xmlSecPtrListAdd(xmlSecTransformIdsGet(), (xmlSecPtr)id);
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListAdd",
@@ -153,6 +370,55 @@ xmlSecTransformIdsRegister(xmlSecTransformId id) {
     return(0);
 }
 
+/**
+ * xmlSecTransformIdsFreeze:
+ *
+ * Builds the lookup indexes for the global list of transform klasses
+ * and makes the list read-only: the following registrations fail and
+ * the lookups do not take any locks. The function should be called
+ * after all the klasses are registered and before the threads that
+ * use the library are started. The list is unfrozen by
+ * #xmlSecTransformIdsShutdown.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformIdsFreeze(void) {
+    int ret;
+
+    xmlSecAssert2(xmlSecAllTransformIdsIndexMutex != NULL, -1);
+
+    if(xmlSecAllTransformIdsFrozen != 0) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecAllTransformIdsIndexMutex);
+    ret = xmlSecTransformIdsIndexRebuild();
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformIdsIndexRebuild", NULL);
+        xmlSecTransformIdsIndexFinalize();
+        xmlMutexUnlock(xmlSecAllTransformIdsIndexMutex);
+        return(-1);
+    }
+    xmlSecAllTransformIdsFrozen = 1;
+    xmlMutexUnlock(xmlSecAllTransformIdsIndexMutex);
+
+    return(0);
+}
+
+/**
+ * xmlSecTransformIdsIsFrozen:
+ *
+ * Checks if the global list of transform klasses was frozen with
+ * #xmlSecTransformIdsFreeze.
+ *
+ * Returns: 1 if the list is frozen or 0 otherwise.
+ */
+int
+xmlSecTransformIdsIsFrozen(void) {
+    return((xmlSecAllTransformIdsFrozen != 0) ? 1 : 0);
+}
+
 /**
  * xmlSecTransformIdsRegisterDefault:
  *
@@ -163,65 +429,92 @@ xmlSecTransformIdsRegister(xmlSecTransformId id) {
  */
 int
 xmlSecTransformIdsRegisterDefault(void) {
-    if(xmlSecTransformIdsRegister(xmlSecTransformBase64Id) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformBase64Id)", NULL);
+    if(xmlSecAllTransformIdsFrozen != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_OPERATION, NULL,
+                         "transform klasses are frozen");
+        return(-1);
+    }
+    return(xmlSecTransformIdListAddDefault(xmlSecTransformIdsGet()));
+}
+
+/**
+ * xmlSecTransformIdListAddDefault:
+ * @list:               the pointer to transform ids list.
+ *
+ * Adds default (implemented by XML Security Library) transform
+ * klasses (XPath, Base64, C14N, ...) to @list. Together with
+ * #xmlSecCryptoDLFunctionsAddKeyDataAndTransforms this allows to fill
+ * a per-context enabled transform list for one crypto library.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformIdListAddDefault(xmlSecPtrListPtr list) {
+    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecTransformIdListId), -1);
+
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformBase64Id) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformBase64Id)", NULL);
         return(-1);
     }
 
-    if(xmlSecTransformIdsRegister(xmlSecTransformEnvelopedId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformEnvelopedId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformEnvelopedId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformEnvelopedId)", NULL);
         return(-1);
     }
 
     /* c14n methods */
-    if(xmlSecTransformIdsRegister(xmlSecTransformInclC14NId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformInclC14NId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformInclC14NId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformInclC14NId)", NULL);
         return(-1);
     }
-    if(xmlSecTransformIdsRegister(xmlSecTransformInclC14NWithCommentsId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformInclC14NWithCommentsId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformInclC14NWithCommentsId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformInclC14NWithCommentsId)", NULL);
         return(-1);
     }
-    if(xmlSecTransformIdsRegister(xmlSecTransformInclC14N11Id) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformInclC14N11Id)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformInclC14N11Id) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformInclC14N11Id)", NULL);
         return(-1);
     }
-    if(xmlSecTransformIdsRegister(xmlSecTransformInclC14N11WithCommentsId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformInclC14N11WithCommentsId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformInclC14N11WithCommentsId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformInclC14N11WithCommentsId)", NULL);
         return(-1);
     }
-    if(xmlSecTransformIdsRegister(xmlSecTransformExclC14NId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformExclC14NId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformExclC14NId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformExclC14NId)", NULL);
         return(-1);
     }
-    if(xmlSecTransformIdsRegister(xmlSecTransformExclC14NWithCommentsId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformExclC14NWithCommentsId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformExclC14NWithCommentsId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformExclC14NWithCommentsId)", NULL);
+        return(-1);
+    }
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformC14N2Id) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformC14N2Id)", NULL);
         return(-1);
     }
 
-    if(xmlSecTransformIdsRegister(xmlSecTransformXPathId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformXPathId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformXPathId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformXPathId)", NULL);
         return(-1);
     }
 
-    if(xmlSecTransformIdsRegister(xmlSecTransformXPath2Id) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformXPath2Id)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformXPath2Id) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformXPath2Id)", NULL);
         return(-1);
     }
 
-    if(xmlSecTransformIdsRegister(xmlSecTransformXPointerId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformXPointerId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformXPointerId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformXPointerId)", NULL);
         return(-1);
     }
 
-    if(xmlSecTransformIdsRegister(xmlSecTransformRelationshipId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformRelationshipId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformRelationshipId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformRelationshipId)", NULL);
         return(-1);
     }
 
 #ifndef XMLSEC_NO_XSLT
-    if(xmlSecTransformIdsRegister(xmlSecTransformXsltId) < 0) {
-        xmlSecInternalError("xmlSecTransformIdsRegister(xmlSecTransformXsltId)", NULL);
+    if(xmlSecPtrListAdd(list, (xmlSecPtr)xmlSecTransformXsltId) < 0) {
+        xmlSecInternalError("xmlSecPtrListAdd(xmlSecTransformXsltId)", NULL);
         return(-1);
     }
 #endif /* XMLSEC_NO_XSLT */
@@ -330,6 +623,13 @@ xmlSecTransformCtxInitialize(xmlSecTransformCtxPtr ctx) {
 
     memset(ctx, 0, sizeof(xmlSecTransformCtx));
 
+    ctx->reserved0 = xmlMalloc(sizeof(xmlSecTransformCtxPrivate));
+    if(ctx->reserved0 == NULL) {
+        xmlSecMallocError(sizeof(xmlSecTransformCtxPrivate), NULL);
+        return(-1);
+    }
+    memset(ctx->reserved0, 0, sizeof(xmlSecTransformCtxPrivate));
+
     ret = xmlSecPtrListInitialize(&(ctx->enabledTransforms), xmlSecTransformIdListId);
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListInitialize(xmlSecTransformIdListId)", NULL);
@@ -351,7 +651,15 @@ xmlSecTransformCtxFinalize(xmlSecTransformCtxPtr ctx) {
     xmlSecAssert(ctx != NULL);
 
     xmlSecTransformCtxReset(ctx);
+    xmlSecTransformCtxFreeTransformsDestroy(ctx);
     xmlSecPtrListFinalize(&(ctx->enabledTransforms));
+    if(ctx->reserved0 != NULL) {
+        if(xmlSecTransformCtxGetPrivate(ctx)->arena != NULL) {
+            xmlSecArenaDestroy(xmlSecTransformCtxGetPrivate(ctx)->arena);
+        }
+        memset(ctx->reserved0, 0, sizeof(xmlSecTransformCtxPrivate));
+        xmlFree(ctx->reserved0);
+    }
     memset(ctx, 0, sizeof(xmlSecTransformCtx));
 }
 
@@ -359,7 +667,8 @@ xmlSecTransformCtxFinalize(xmlSecTransformCtxPtr ctx) {
  * xmlSecTransformCtxReset:
  * @ctx:                the pointer to transforms chain processing context.
  *
- * Resets transfroms context for new processing.
+ * Resets transfroms context for new processing. The transforms from
+ * the chain are kept in the @ctx and reused by the next chain.
  */
 void
 xmlSecTransformCtxReset(xmlSecTransformCtxPtr ctx) {
@@ -367,25 +676,145 @@ xmlSecTransformCtxReset(xmlSecTransformCtxPtr ctx) {
 
     xmlSecAssert(ctx != NULL);
 
+    if(ctx->result != NULL) {
+        xmlSecBufferSetMemCounter(ctx->result, NULL);
+    }
     ctx->result = NULL;
     ctx->status = xmlSecTransformStatusNone;
-
-    /* destroy uri */
-    if(ctx->uri != NULL) {
-        xmlFree(ctx->uri);
-        ctx->uri = NULL;
-    }
-    if(ctx->xptrExpr != NULL) {
-        xmlFree(ctx->xptrExpr);
-        ctx->xptrExpr = NULL;
+    if(xmlSecTransformCtxGetPrivate(ctx) != NULL) {
+        xmlSecTransformCtxGetPrivate(ctx)->binChunkSize = 0;
+        xmlSecTransformCtxGetPrivate(ctx)->digestSize = 0;
+        xmlSecTransformCtxGetPrivate(ctx)->xpathOps = 0;
     }
 
-    /* destroy transforms chain */
+    /* uri is allocated from the arena */
+    ctx->uri = NULL;
+    ctx->xptrExpr = NULL;
+
+    /* release transforms chain */
     for(transform = ctx->first; transform != NULL; transform = tmp) {
         tmp = transform->next;
-        xmlSecTransformDestroy(transform);
+        xmlSecBufferSetMemCounter(&(transform->inBuf), NULL);
+        xmlSecBufferSetMemCounter(&(transform->outBuf), NULL);
+        xmlSecTransformCtxReleaseTransform(ctx, transform);
     }
     ctx->first = ctx->last = NULL;
+    if(xmlSecTransformCtxGetPrivate(ctx) != NULL) {
+        xmlSecMetricsAdd(xmlSecMetricTransformsMemoryPeak, xmlSecTransformCtxGetPrivate(ctx)->memCounter.peakSize);
+        memset(&(xmlSecTransformCtxGetPrivate(ctx)->memCounter), 0, sizeof(xmlSecBufferMemCounter));
+    }
+
+    /* all the memory from the arena is released at once */
+    if((xmlSecTransformCtxGetPrivate(ctx) != NULL) && (xmlSecTransformCtxGetPrivate(ctx)->arena != NULL)) {
+        xmlSecArenaReset(xmlSecTransformCtxGetPrivate(ctx)->arena);
+    }
+}
+
+static xmlSecTransformPtr
+xmlSecTransformCtxCreateTransform(xmlSecTransformCtxPtr ctx, xmlSecTransformId id) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+    xmlSecTransformPtr transform, prev;
+    int ret;
+
+    xmlSecAssert2(id != NULL, NULL);
+
+    if((ctx == NULL) || (xmlSecTransformCtxGetPrivate(ctx) == NULL)) {
+        return(xmlSecTransformCreate(id));
+    }
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+
+    /* look for the released transform of the same klass */
+    for(prev = NULL, transform = ctxPriv->freeTransforms; transform != NULL; prev = transform, transform = transform->next) {
+        if(transform->id == id) {
+            break;
+        }
+    }
+    if(transform == NULL) {
+        return(xmlSecTransformCreate(id));
+    }
+    if(prev != NULL) {
+        prev->next = transform->next;
+    } else {
+        ctxPriv->freeTransforms = transform->next;
+    }
+    --ctxPriv->freeTransformsSize;
+    transform->next = NULL;
+
+    ret = xmlSecTransformReuse(transform);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformReuse",
+                            xmlSecTransformKlassGetName(id));
+        return(NULL);
+    }
+    return(transform);
+}
+
+static void
+xmlSecTransformRecycleBuffer(xmlSecBufferPtr buf) {
+    xmlSecByte* inlineData;
+    xmlSecSize inlineSize;
+
+    xmlSecAssert(buf != NULL);
+
+    /* don't hold on to the memory from an unusually large document */
+    if(buf->offset + buf->maxSize > XMLSEC_TRANSFORM_BINARY_CHUNK_MAX) {
+        inlineData = buf->inlineData;
+        inlineSize = buf->inlineSize;
+        xmlSecBufferFinalize(buf);
+        xmlSecBufferInitialize(buf, 0);
+        xmlSecBufferSetInlineStorage(buf, inlineData, inlineSize);
+        buf->allocMode = xmlSecAllocModeOffset;
+    } else {
+        xmlSecBufferEmpty(buf);
+    }
+}
+
+static void
+xmlSecTransformCtxReleaseTransform(xmlSecTransformCtxPtr ctx, xmlSecTransformPtr transform) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(xmlSecTransformIsValid(transform));
+    xmlSecAssert(transform->id->objSize > 0);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    if((ctxPriv == NULL) || (ctxPriv->freeTransformsSize >= XMLSEC_TRANSFORM_CTX_FREE_TRANSFORMS_MAX)) {
+        xmlSecTransformDestroy(transform);
+        return;
+    }
+    if(xmlSecTransformRecycle(transform) < 0) {
+        /* the transform is destroyed */
+        return;
+    }
+
+    transform->next = ctxPriv->freeTransforms;
+    ctxPriv->freeTransforms = transform;
+    ++ctxPriv->freeTransformsSize;
+}
+
+static void
+xmlSecTransformCtxFreeTransformsDestroy(xmlSecTransformCtxPtr ctx) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+    xmlSecTransformPtr transform;
+
+    xmlSecAssert(ctx != NULL);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    if(ctxPriv == NULL) {
+        return;
+    }
+
+    /* hand over the transforms that can be reset to the thread cache */
+    while(ctxPriv->freeTransforms != NULL) {
+        transform = ctxPriv->freeTransforms;
+        ctxPriv->freeTransforms = transform->next;
+        transform->next = NULL;
+
+        if((transform->id->reset == NULL) || (xmlSecTransformThreadCachePut(transform) < 0)) {
+            xmlSecTransformFreeRecycled(transform);
+        }
+    }
+    ctxPriv->freeTransformsSize = 0;
 }
 
 /**
@@ -402,7 +831,9 @@ xmlSecTransformCtxCopyUserPref(xmlSecTransformCtxPtr dst, xmlSecTransformCtxPtr
     int ret;
 
     xmlSecAssert2(dst != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(dst) != NULL, -1);
     xmlSecAssert2(src != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(src) != NULL, -1);
 
     dst->userData        = src->userData;
     dst->flags           = src->flags;
@@ -410,6 +841,13 @@ xmlSecTransformCtxCopyUserPref(xmlSecTransformCtxPtr dst, xmlSecTransformCtxPtr
     dst->enabledUris     = src->enabledUris;
     dst->preExecCallback = src->preExecCallback;
 
+    xmlSecTransformCtxGetPrivate(dst)->binChunkMaxSize = xmlSecTransformCtxGetPrivate(src)->binChunkMaxSize;
+    xmlSecTransformCtxGetPrivate(dst)->maxTransforms   = xmlSecTransformCtxGetPrivate(src)->maxTransforms;
+    xmlSecTransformCtxGetPrivate(dst)->maxDigestSize   = xmlSecTransformCtxGetPrivate(src)->maxDigestSize;
+    xmlSecTransformCtxGetPrivate(dst)->maxXPathOps     = xmlSecTransformCtxGetPrivate(src)->maxXPathOps;
+    xmlSecTransformCtxGetPrivate(dst)->maxMemSize      = xmlSecTransformCtxGetPrivate(src)->maxMemSize;
+    xmlSecTransformCtxGetPrivate(dst)->attachmentResolver = xmlSecTransformCtxGetPrivate(src)->attachmentResolver;
+
     ret = xmlSecPtrListCopy(&(dst->enabledTransforms), &(src->enabledTransforms));
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListCopy(enabledTransforms)", NULL);
@@ -420,119 +858,475 @@ xmlSecTransformCtxCopyUserPref(xmlSecTransformCtxPtr dst, xmlSecTransformCtxPtr
 }
 
 /**
- * xmlSecTransformCtxAppend:
+ * xmlSecTransformCtxSetBinaryChunkMaxSize:
  * @ctx:                the pointer to transforms chain processing context.
- * @transform:          the pointer to new transform.
+ * @size:               the maximum binary data chunk size (0 means
+ *                      #XMLSEC_TRANSFORM_BINARY_CHUNK_MAX).
  *
- * Connects the @transform to the end of the chain of transforms in the @ctx
- * (see #xmlSecTransformConnect function for details).
+ * Sets the maximum binary data chunk size for the transforms chain; set it
+ * to #XMLSEC_TRANSFORM_BINARY_CHUNK to disable chunks growth.
  *
  * Returns: 0 on success or a negative value otherwise.
  */
 int
-xmlSecTransformCtxAppend(xmlSecTransformCtxPtr ctx, xmlSecTransformPtr transform) {
-    int ret;
-
+xmlSecTransformCtxSetBinaryChunkMaxSize(xmlSecTransformCtxPtr ctx, xmlSecSize size) {
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, -1);
-    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
-
-    if(ctx->last != NULL) {
-        ret = xmlSecTransformConnect(ctx->last, transform, ctx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformConnect",
-                                xmlSecTransformGetName(transform));
-            return(-1);
-        }
-    } else {
-        xmlSecAssert2(ctx->first == NULL, -1);
-        ctx->first = transform;
-    }
-    ctx->last = transform;
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(ctx) != NULL, -1);
 
+    xmlSecTransformCtxGetPrivate(ctx)->binChunkMaxSize = size;
     return(0);
 }
 
 /**
- * xmlSecTransformCtxPrepend:
+ * xmlSecTransformCtxSetLimits:
  * @ctx:                the pointer to transforms chain processing context.
- * @transform:          the pointer to new transform.
+ * @maxTransforms:      the maximum number of transforms in the chain (0 means
+ *                      no limit).
+ * @maxDigestSize:      the maximum number of bytes processed by the digest
+ *                      transforms in the chain (0 means no limit).
+ * @maxXPathOps:        the maximum number of XPath operations (mostly the
+ *                      nodes visited) by all the XPath, XPath Filter 2.0 and
+ *                      XPointer expressions in the chain (0 means no limit).
  *
- * Connects the @transform to the beggining of the chain of transforms in the @ctx
- * (see #xmlSecTransformConnect function for details).
+ * Sets the limits for the transforms chain processing, the chain fails
+ * with #XMLSEC_ERRORS_R_LIMIT_EXCEEDED error if any of them is exceeded.
  *
  * Returns: 0 on success or a negative value otherwise.
  */
 int
-xmlSecTransformCtxPrepend(xmlSecTransformCtxPtr ctx, xmlSecTransformPtr transform) {
-    int ret;
+xmlSecTransformCtxSetLimits(xmlSecTransformCtxPtr ctx, xmlSecSize maxTransforms,
+                            xmlSecSize maxDigestSize, xmlSecSize maxXPathOps) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
 
     xmlSecAssert2(ctx != NULL, -1);
-    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, -1);
-    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
 
-    if(ctx->first != NULL) {
-        ret = xmlSecTransformConnect(transform, ctx->first, ctx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformConnect",
-                                xmlSecTransformGetName(transform));
-            return(-1);
-        }
-    } else {
-        xmlSecAssert2(ctx->last == NULL, -1);
-        ctx->last = transform;
-    }
-    ctx->first = transform;
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    xmlSecAssert2(ctxPriv != NULL, -1);
 
+    ctxPriv->maxTransforms = maxTransforms;
+    ctxPriv->maxDigestSize = maxDigestSize;
+    ctxPriv->maxXPathOps   = maxXPathOps;
     return(0);
 }
 
 /**
- * xmlSecTransformCtxCreateAndAppend:
+ * xmlSecTransformCtxSetMaxMemSize:
  * @ctx:                the pointer to transforms chain processing context.
- * @id:                 the new transform klass.
+ * @maxMemSize:         the maximum memory allocated by the transforms buffers
+ *                      in the chain (0 means no limit).
  *
- * Creaeates new transform and connects it to the end of the chain of
- * transforms in the @ctx (see #xmlSecTransformConnect function for details).
+ * Sets the limit for the memory allocated by the transforms buffers in the
+ * chain. The current and the peak sizes are reported by the debug dump when
+ * #XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS is set.
  *
- * Returns: pointer to newly created transform or NULL if an error occurs.
+ * Returns: 0 on success or a negative value otherwise.
  */
-xmlSecTransformPtr
-xmlSecTransformCtxCreateAndAppend(xmlSecTransformCtxPtr ctx, xmlSecTransformId id) {
-    xmlSecTransformPtr transform;
-    int ret;
-
-    xmlSecAssert2(ctx != NULL, NULL);
-    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, NULL);
-    xmlSecAssert2(id != xmlSecTransformIdUnknown, NULL);
-
-    transform = xmlSecTransformCreate(id);
-    if(!xmlSecTransformIsValid(transform)) {
-        xmlSecInternalError("xmlSecTransformCreate",
-                            xmlSecTransformKlassGetName(id));
-        return(NULL);
-    }
-
-    ret = xmlSecTransformCtxAppend(ctx, transform);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformCtxAppend",
-                            xmlSecTransformKlassGetName(id));
-        xmlSecTransformDestroy(transform);
-        return(NULL);
-    }
+int
+xmlSecTransformCtxSetMaxMemSize(xmlSecTransformCtxPtr ctx, xmlSecSize maxMemSize) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(ctx) != NULL, -1);
 
-    return(transform);
+    xmlSecTransformCtxGetPrivate(ctx)->maxMemSize = maxMemSize;
+    return(0);
 }
 
 /**
- * xmlSecTransformCtxCreateAndPrepend:
+ * xmlSecTransformCtxSetAttachmentResolver:
  * @ctx:                the pointer to transforms chain processing context.
- * @id:                 the new transform klass.
+ * @resolver:           the resolver for the "cid:" URIs (see
+ *                      #xmlSecAttachmentResolver) or NULL.
  *
- * Creaeates new transform and connects it to the end of the chain of
- * transforms in the @ctx (see #xmlSecTransformConnect function for details).
+ * Sets the resolver for the "cid:" URIs; if it is NULL (default) then
+ * these URIs are read with the IO callbacks. The @resolver is not copied
+ * and should be valid while @ctx is used.
  *
- * Returns: pointer to newly created transform or NULL if an error occurs.
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformCtxSetAttachmentResolver(xmlSecTransformCtxPtr ctx, xmlSecAttachmentResolverPtr resolver) {
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(ctx) != NULL, -1);
+
+    xmlSecTransformCtxGetPrivate(ctx)->attachmentResolver = resolver;
+    return(0);
+}
+
+/**
+ * xmlSecTransformCtxGetBinaryChunkSize:
+ * @ctx:                the pointer to transforms chain processing context.
+ *
+ * Gets the current binary data chunk size for the transforms chain.
+ *
+ * Returns: the chunk size (at least #XMLSEC_TRANSFORM_BINARY_CHUNK).
+ */
+xmlSecSize
+xmlSecTransformCtxGetBinaryChunkSize(xmlSecTransformCtxPtr ctx) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+
+    xmlSecAssert2(ctx != NULL, XMLSEC_TRANSFORM_BINARY_CHUNK);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    if((ctxPriv == NULL) || (ctxPriv->binChunkSize < XMLSEC_TRANSFORM_BINARY_CHUNK)) {
+        return(XMLSEC_TRANSFORM_BINARY_CHUNK);
+    }
+    return(ctxPriv->binChunkSize);
+}
+
+/**
+ * xmlSecTransformCtxGetArena:
+ * @ctx:                the pointer to transforms chain processing context.
+ *
+ * Gets the memory arena for the objects that live until the next
+ * #xmlSecTransformCtxReset call, the arena is created on the first call.
+ *
+ * Returns: the pointer to the arena or NULL if an error occurs.
+ */
+xmlSecArenaPtr
+xmlSecTransformCtxGetArena(xmlSecTransformCtxPtr ctx) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    xmlSecAssert2(ctxPriv != NULL, NULL);
+
+    if(ctxPriv->arena == NULL) {
+        ctxPriv->arena = xmlSecArenaCreate();
+        if(ctxPriv->arena == NULL) {
+            xmlSecInternalError("xmlSecArenaCreate", NULL);
+            return(NULL);
+        }
+    }
+    return(ctxPriv->arena);
+}
+
+/**************************************************************************
+ *
+ * Transforms plan
+ *
+ *************************************************************************/
+typedef struct _xmlSecTransformPlanItem {
+    xmlChar*                    href;
+    xmlSecTransformId           id;
+} xmlSecTransformPlanItem;
+
+struct _xmlSecTransformPlan {
+    xmlSecTransformPlanItem*    items;
+    xmlSecSize                  itemsSize;
+    xmlSecSize                  itemsMaxSize;
+};
+
+/**
+ * xmlSecTransformPlanCreate:
+ *
+ * Creates the empty transforms plan.
+ *
+ * Returns: the pointer to the plan or NULL if an error occurs.
+ */
+xmlSecTransformPlanPtr
+xmlSecTransformPlanCreate(void) {
+    xmlSecTransformPlanPtr plan;
+
+    plan = (xmlSecTransformPlanPtr)xmlMalloc(sizeof(xmlSecTransformPlan));
+    if(plan == NULL) {
+        xmlSecMallocError(sizeof(xmlSecTransformPlan), NULL);
+        return(NULL);
+    }
+    memset(plan, 0, sizeof(xmlSecTransformPlan));
+    return(plan);
+}
+
+/**
+ * xmlSecTransformPlanDestroy:
+ * @plan:               the pointer to transforms plan.
+ *
+ * Destroys @plan.
+ */
+void
+xmlSecTransformPlanDestroy(xmlSecTransformPlanPtr plan) {
+    xmlSecSize ii;
+
+    xmlSecAssert(plan != NULL);
+
+    for(ii = 0; ii < plan->itemsSize; ++ii) {
+        xmlFree(plan->items[ii].href);
+    }
+    if(plan->items != NULL) {
+        xmlFree(plan->items);
+    }
+    memset(plan, 0, sizeof(xmlSecTransformPlan));
+    xmlFree(plan);
+}
+
+/**
+ * xmlSecTransformPlanAddNode:
+ * @plan:               the pointer to transforms plan.
+ * @node:               the transform node (with Algorithm attribute).
+ * @usage:              the transform usage.
+ *
+ * Resolves the transform klass for the Algorithm attribute of @node
+ * and adds it to @plan.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformPlanAddNode(xmlSecTransformPlanPtr plan, xmlNodePtr node, xmlSecTransformUsage usage) {
+    xmlSecTransformPlanItem* items;
+    xmlSecTransformId id;
+    xmlChar* href;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(plan != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    href = xmlGetProp(node, xmlSecAttrAlgorithm);
+    if(href == NULL) {
+        xmlSecInvalidNodeAttributeError(node, xmlSecAttrAlgorithm,
+                                        NULL, "empty");
+        return(-1);
+    }
+
+    /* already there? */
+    if(xmlSecTransformPlanFind(plan, href, usage) != xmlSecTransformIdUnknown) {
+        xmlFree(href);
+        return(0);
+    }
+
+    id = xmlSecTransformIdListFindByHref(xmlSecTransformIdsGet(), href, usage);
+    if(id == xmlSecTransformIdUnknown) {
+        xmlSecInternalError2("xmlSecTransformIdListFindByHref", NULL,
+                             "href=%s", xmlSecErrorsSafeString(href));
+        xmlFree(href);
+        return(-1);
+    }
+
+    if(plan->itemsSize >= plan->itemsMaxSize) {
+        newSize = (plan->itemsMaxSize > 0) ? 2 * plan->itemsMaxSize : 8;
+        items = (xmlSecTransformPlanItem*)xmlRealloc(plan->items, newSize * sizeof(xmlSecTransformPlanItem));
+        if(items == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlSecTransformPlanItem), NULL);
+            xmlFree(href);
+            return(-1);
+        }
+        plan->items = items;
+        plan->itemsMaxSize = newSize;
+    }
+    plan->items[plan->itemsSize].href = href;
+    plan->items[plan->itemsSize].id   = id;
+    ++plan->itemsSize;
+    return(0);
+}
+
+/**
+ * xmlSecTransformPlanFind:
+ * @plan:               the pointer to transforms plan.
+ * @href:               the transform href.
+ * @usage:              the transform usage.
+ *
+ * Looks for the transform klass for @href and @usage in @plan.
+ *
+ * Returns: the transform klass or #xmlSecTransformIdUnknown if it is not found.
+ */
+xmlSecTransformId
+xmlSecTransformPlanFind(xmlSecTransformPlanPtr plan, const xmlChar* href, xmlSecTransformUsage usage) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(plan != NULL, xmlSecTransformIdUnknown);
+    xmlSecAssert2(href != NULL, xmlSecTransformIdUnknown);
+
+    for(ii = 0; ii < plan->itemsSize; ++ii) {
+        if(((usage & plan->items[ii].id->usage) != 0) && xmlStrEqual(href, plan->items[ii].href)) {
+            return(plan->items[ii].id);
+        }
+    }
+    return(xmlSecTransformIdUnknown);
+}
+
+/**
+ * xmlSecTransformCtxUpdateBinaryChunkSize:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @processedSize:      the size of the data chunk just processed.
+ *
+ * Doubles the binary data chunk size (up to the maximum set with
+ * #xmlSecTransformCtxSetBinaryChunkMaxSize) if
+ * the last processed chunk was a full one: large payloads then go through
+ * the chain in a few big calls while small ones keep using small chunks.
+ */
+void
+xmlSecTransformCtxUpdateBinaryChunkSize(xmlSecTransformCtxPtr ctx, xmlSecSize processedSize) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+    xmlSecSize curSize, maxSize;
+
+    xmlSecAssert(ctx != NULL);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    xmlSecAssert(ctxPriv != NULL);
+
+    maxSize = (ctxPriv->binChunkMaxSize > 0) ? ctxPriv->binChunkMaxSize : XMLSEC_TRANSFORM_BINARY_CHUNK_MAX;
+    curSize = xmlSecTransformCtxGetBinaryChunkSize(ctx);
+    if((processedSize < curSize) || (curSize >= maxSize)) {
+        return;
+    }
+
+    curSize *= 2;
+    if(curSize > maxSize) {
+        curSize = maxSize;
+    }
+    ctxPriv->binChunkSize = curSize;
+}
+
+static int
+xmlSecTransformCtxCheckTransformsNumber(xmlSecTransformCtxPtr ctx) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+    xmlSecTransformPtr cur;
+    xmlSecSize count = 0;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    ctxPriv = xmlSecTransformCtxGetPrivate(ctx);
+    xmlSecAssert2(ctxPriv != NULL, -1);
+
+    if(ctxPriv->maxTransforms <= 0) {
+        return(0);
+    }
+    for(cur = ctx->first; cur != NULL; cur = cur->next) {
+        if((++count) >= ctxPriv->maxTransforms) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED, NULL,
+                              "maxTransforms=%d", (int)ctxPriv->maxTransforms);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * xmlSecTransformCtxAppend:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @transform:          the pointer to new transform.
+ *
+ * Connects the @transform to the end of the chain of transforms in the @ctx
+ * (see #xmlSecTransformConnect function for details).
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformCtxAppend(xmlSecTransformCtxPtr ctx, xmlSecTransformPtr transform) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, -1);
+    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
+
+    ret = xmlSecTransformCtxCheckTransformsNumber(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxCheckTransformsNumber",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    if(ctx->last != NULL) {
+        ret = xmlSecTransformConnect(ctx->last, transform, ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformConnect",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    } else {
+        xmlSecAssert2(ctx->first == NULL, -1);
+        ctx->first = transform;
+    }
+    ctx->last = transform;
+
+    return(0);
+}
+
+/**
+ * xmlSecTransformCtxPrepend:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @transform:          the pointer to new transform.
+ *
+ * Connects the @transform to the beggining of the chain of transforms in the @ctx
+ * (see #xmlSecTransformConnect function for details).
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecTransformCtxPrepend(xmlSecTransformCtxPtr ctx, xmlSecTransformPtr transform) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, -1);
+    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
+
+    ret = xmlSecTransformCtxCheckTransformsNumber(ctx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxCheckTransformsNumber",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    if(ctx->first != NULL) {
+        ret = xmlSecTransformConnect(transform, ctx->first, ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformConnect",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    } else {
+        xmlSecAssert2(ctx->last == NULL, -1);
+        ctx->last = transform;
+    }
+    ctx->first = transform;
+
+    return(0);
+}
+
+/**
+ * xmlSecTransformCtxCreateAndAppend:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @id:                 the new transform klass.
+ *
+ * Creaeates new transform and connects it to the end of the chain of
+ * transforms in the @ctx (see #xmlSecTransformConnect function for details).
+ *
+ * Returns: pointer to newly created transform or NULL if an error occurs.
+ */
+xmlSecTransformPtr
+xmlSecTransformCtxCreateAndAppend(xmlSecTransformCtxPtr ctx, xmlSecTransformId id) {
+    xmlSecTransformPtr transform;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, NULL);
+    xmlSecAssert2(id != xmlSecTransformIdUnknown, NULL);
+
+    transform = xmlSecTransformCtxCreateTransform(ctx, id);
+    if(!xmlSecTransformIsValid(transform)) {
+        xmlSecInternalError("xmlSecTransformCtxCreateTransform",
+                            xmlSecTransformKlassGetName(id));
+        return(NULL);
+    }
+
+    ret = xmlSecTransformCtxAppend(ctx, transform);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxAppend",
+                            xmlSecTransformKlassGetName(id));
+        xmlSecTransformDestroy(transform);
+        return(NULL);
+    }
+
+    return(transform);
+}
+
+/**
+ * xmlSecTransformCtxCreateAndPrepend:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @id:                 the new transform klass.
+ *
+ * Creaeates new transform and connects it to the end of the chain of
+ * transforms in the @ctx (see #xmlSecTransformConnect function for details).
+ *
+ * Returns: pointer to newly created transform or NULL if an error occurs.
  */
 xmlSecTransformPtr
 xmlSecTransformCtxCreateAndPrepend(xmlSecTransformCtxPtr ctx, xmlSecTransformId id) {
@@ -543,9 +1337,9 @@ xmlSecTransformCtxCreateAndPrepend(xmlSecTransformCtxPtr ctx, xmlSecTransformId
     xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, NULL);
     xmlSecAssert2(id != xmlSecTransformIdUnknown, NULL);
 
-    transform = xmlSecTransformCreate(id);
+    transform = xmlSecTransformCtxCreateTransform(ctx, id);
     if(!xmlSecTransformIsValid(transform)) {
-        xmlSecInternalError("xmlSecTransformCreate",
+        xmlSecInternalError("xmlSecTransformCtxCreateTransform",
                             xmlSecTransformKlassGetName(id));
         return(NULL);
     }
@@ -690,6 +1484,7 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
     xmlSecNodeSetType nodeSetType = xmlSecNodeSetTree;
     const xmlChar* xptr;
     xmlChar* buf = NULL;
+    xmlSecArenaPtr arena;
     int useVisa3DHack = 0;
     int ret;
 
@@ -711,35 +1506,41 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
         return(0);
     }
 
-    /* do we have barename or full xpointer? */
+    arena = xmlSecTransformCtxGetArena(ctx);
+    if(arena == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxGetArena", NULL);
+        return(-1);
+    }
+
+    /* do we have barename or full xpointer? */
     xptr = xmlStrchr(uri, '#');
     if(xptr == NULL){
-        ctx->uri = xmlStrdup(uri);
+        ctx->uri = xmlSecArenaStrndup(arena, uri, xmlStrlen(uri));
         if(ctx->uri == NULL) {
-            xmlSecStrdupError(uri, NULL);
+            xmlSecInternalError("xmlSecArenaStrndup", NULL);
             return(-1);
         }
         /* we are done */
         return(0);
     } else if(xmlStrcmp(uri, BAD_CAST "#xpointer(/)") == 0) {
-        ctx->xptrExpr = xmlStrdup(uri);
+        ctx->xptrExpr = xmlSecArenaStrndup(arena, uri, xmlStrlen(uri));
         if(ctx->xptrExpr == NULL) {
-            xmlSecStrdupError(uri, NULL);
+            xmlSecInternalError("xmlSecArenaStrndup", NULL);
             return(-1);
         }
         /* we are done */
         return(0);
     }
 
-    ctx->uri = xmlStrndup(uri, xptr - uri);
+    ctx->uri = xmlSecArenaStrndup(arena, uri, xptr - uri);
     if(ctx->uri == NULL) {
-        xmlSecStrdupError(uri, NULL);
+        xmlSecInternalError("xmlSecArenaStrndup", NULL);
         return(-1);
     }
 
-    ctx->xptrExpr = xmlStrdup(xptr);
+    ctx->xptrExpr = xmlSecArenaStrndup(arena, xptr, xmlStrlen(xptr));
     if(ctx->xptrExpr == NULL) {
-        xmlSecStrdupError(xptr, NULL);
+        xmlSecInternalError("xmlSecArenaStrndup", NULL);
         return(-1);
     }
 
@@ -843,10 +1644,12 @@ xmlSecTransformCtxSetUri(xmlSecTransformCtxPtr ctx, const xmlChar* uri, xmlNodeP
 int
 xmlSecTransformCtxPrepare(xmlSecTransformCtxPtr ctx, xmlSecTransformDataType inputDataType) {
     xmlSecTransformDataType firstType;
+    xmlSecBufferMemCounterPtr memCounter;
     xmlSecTransformPtr transform;
     int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(ctx) != NULL, -1);
     xmlSecAssert2(ctx->result == NULL, -1);
     xmlSecAssert2(ctx->status == xmlSecTransformStatusNone, -1);
 
@@ -894,6 +1697,15 @@ xmlSecTransformCtxPrepare(xmlSecTransformCtxPtr ctx, xmlSecTransformDataType inp
         }
     }
 
+    /* charge all the transforms buffers to the chain memory counter */
+    memCounter = &(xmlSecTransformCtxGetPrivate(ctx)->memCounter);
+    memCounter->maxSize = xmlSecTransformCtxGetPrivate(ctx)->maxMemSize;
+    for(transform = ctx->first; transform != NULL; transform = transform->next) {
+        xmlSecBufferSetMemCounter(&(transform->inBuf), memCounter);
+        xmlSecBufferSetMemCounter(&(transform->outBuf), memCounter);
+    }
+    xmlSecBufferSetMemCounter(ctx->result, memCounter);
+
     ctx->status = xmlSecTransformStatusWorking;
     return(0);
 }
@@ -951,6 +1763,8 @@ xmlSecTransformCtxBinaryExecute(xmlSecTransformCtxPtr ctx,
 int
 xmlSecTransformCtxUriExecute(xmlSecTransformCtxPtr ctx, const xmlChar* uri) {
     xmlSecTransformPtr uriTransform;
+    const xmlSecByte* mappedData;
+    xmlSecSize mappedSize;
     int ret;
 
     xmlSecAssert2(ctx != NULL, -1);
@@ -966,11 +1780,33 @@ xmlSecTransformCtxUriExecute(xmlSecTransformCtxPtr ctx, const xmlChar* uri) {
         return(-1);
     }
 
-    ret = xmlSecTransformInputURIOpen(uriTransform, uri);
-    if(ret < 0) {
-        xmlSecInternalError2("xmlSecTransformInputURIOpen", NULL,
-                            "uri=%s", xmlSecErrorsSafeString(uri));
-        return(-1);
+    /* the attachments are streamed by the application */
+    ret = 0;
+    if((xmlSecTransformCtxGetPrivate(ctx) != NULL) && (xmlSecTransformCtxGetPrivate(ctx)->attachmentResolver != NULL)) {
+        ret = xmlSecTransformInputURIOpenAttachment(uriTransform, xmlSecTransformCtxGetPrivate(ctx)->attachmentResolver, uri);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformInputURIOpenAttachment", NULL,
+                                "uri=%s", xmlSecErrorsSafeString(uri));
+            return(-1);
+        }
+    }
+
+    /* the uri might be already read in the background */
+    if((ret == 0) && (xmlSecTransformCtxGetPrivate(ctx) != NULL) && (xmlSecTransformCtxGetPrivate(ctx)->prefetch != NULL)) {
+        ret = xmlSecTransformInputURIOpenPrefetched(uriTransform, xmlSecTransformCtxGetPrivate(ctx)->prefetch, uri);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformInputURIOpenPrefetched", NULL,
+                                "uri=%s", xmlSecErrorsSafeString(uri));
+            return(-1);
+        }
+    }
+    if(ret == 0) {
+        ret = xmlSecTransformInputURIOpen(uriTransform, uri);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformInputURIOpen", NULL,
+                                "uri=%s", xmlSecErrorsSafeString(uri));
+            return(-1);
+        }
     }
 
     /* we do not need to do something special for this transform */
@@ -980,14 +1816,37 @@ xmlSecTransformCtxUriExecute(xmlSecTransformCtxPtr ctx, const xmlChar* uri) {
         return(-1);
     }
 
-    /* Now we have a choice: we either can push from first transform or pop
-     * from last. Our C14N transforms prefers push, so push data!
-     */
-    ret = xmlSecTransformPump(uriTransform, uriTransform->next, ctx);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformPump",
-                            xmlSecTransformGetName(uriTransform));
-        return(-1);
+    /* a mapped local file is pushed to the binary transform as is */
+    mappedData = NULL;
+    mappedSize = 0;
+    if((uriTransform->next != NULL) &&
+       ((xmlSecTransformGetDataType(uriTransform->next, xmlSecTransformModePush, ctx) & xmlSecTransformDataTypeBin) != 0)) {
+        ret = xmlSecTransformInputURIGetMappedData(uriTransform, &mappedData, &mappedSize);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformInputURIGetMappedData",
+                                xmlSecTransformGetName(uriTransform));
+            return(-1);
+        }
+    }
+
+    if(mappedData != NULL) {
+        ret = xmlSecTransformPushBin(uriTransform->next, mappedData, mappedSize, 1, ctx);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformPushBin",
+                                 xmlSecTransformGetName(uriTransform->next),
+                                 "size=" XMLSEC_SIZE_FMT, mappedSize);
+            return(-1);
+        }
+    } else {
+        /* Now we have a choice: we either can push from first transform or pop
+         * from last. Our C14N transforms prefers push, so push data!
+         */
+        ret = xmlSecTransformPump(uriTransform, uriTransform->next, ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPump",
+                                xmlSecTransformGetName(uriTransform));
+            return(-1);
+        }
     }
 
     /* Close to free up file handle */
@@ -1127,143 +1986,639 @@ xmlSecTransformCtxDebugDump(xmlSecTransformCtxPtr ctx, FILE* output) {
             (ctx->uri != NULL) ? ctx->uri : BAD_CAST "NULL");
     fprintf(output, "=== uri xpointer expr: %s\n",
             (ctx->xptrExpr != NULL) ? ctx->xptrExpr : BAD_CAST "NULL");
+    if(((ctx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) != 0) && (xmlSecTransformCtxGetPrivate(ctx) != NULL)) {
+        fprintf(output, "=== memory: size=%lu; peak=%lu; max=%lu\n",
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->memCounter.size,
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->memCounter.peakSize,
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->maxMemSize);
+    }
     for(transform = ctx->first; transform != NULL; transform = transform->next) {
         xmlSecTransformDebugDump(transform, output);
+        if((ctx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) != 0) {
+            if(xmlSecTransformStatsGet(transform) != NULL) {
+                xmlSecTransformStatsDebugDump(xmlSecTransformStatsGet(transform), output);
+            }
+        }
+    }
+}
+
+/**
+ * xmlSecTransformCtxDebugXmlDump:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @output:             the pointer to output FILE.
+ *
+ * Prints transforms context debug information to @output in XML format.
+ */
+void
+xmlSecTransformCtxDebugXmlDump(xmlSecTransformCtxPtr ctx, FILE* output) {
+    xmlSecTransformPtr transform;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "<TransformCtx status=\"%d\">\n", ctx->status);
+
+    fprintf(output, "<Flags>%08x</Flags>\n", ctx->flags);
+    fprintf(output, "<Flags2>%08x</Flags2>\n", ctx->flags2);
+    if(xmlSecPtrListGetSize(&(ctx->enabledTransforms)) > 0) {
+        fprintf(output, "<EnabledTransforms>\n");
+        xmlSecTransformIdListDebugXmlDump(&(ctx->enabledTransforms), output);
+        fprintf(output, "</EnabledTransforms>\n");
+    } else {
+        fprintf(output, "<EnabledTransforms>all</EnabledTransforms>\n");
+    }
+
+
+    fprintf(output, "<Uri>");
+    xmlSecPrintXmlString(output, ctx->uri);
+    fprintf(output, "</Uri>\n");
+
+    fprintf(output, "<UriXPointer>");
+    xmlSecPrintXmlString(output, ctx->xptrExpr);
+    fprintf(output, "</UriXPointer>\n");
+
+    if(((ctx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) != 0) && (xmlSecTransformCtxGetPrivate(ctx) != NULL)) {
+        fprintf(output, "<Memory size=\"%lu\" peak=\"%lu\" max=\"%lu\" />\n",
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->memCounter.size,
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->memCounter.peakSize,
+                (unsigned long)xmlSecTransformCtxGetPrivate(ctx)->maxMemSize);
+    }
+    for(transform = ctx->first; transform != NULL; transform = transform->next) {
+        xmlSecTransformDebugXmlDump(transform, output);
+        if((ctx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) != 0) {
+            if(xmlSecTransformStatsGet(transform) != NULL) {
+                xmlSecTransformStatsDebugXmlDump(xmlSecTransformStatsGet(transform), output);
+            }
+        }
+    }
+    fprintf(output, "</TransformCtx>\n");
+}
+
+/**
+ * xmlSecTransformCtxGetStats:
+ * @ctx:                the pointer to transforms chain processing context.
+ * @stats:              the pointer to the result statistics.
+ *
+ * Sums up the statistics of all the transforms in the chain. The
+ * statistics are collected only if #XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS
+ * flag is set. The @stats time is the time spent in the first transform
+ * of the chain since it includes the time spent in all the other transforms.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformCtxGetStats(xmlSecTransformCtxPtr ctx, xmlSecTransformStatsPtr stats) {
+    xmlSecTransformPtr transform;
+    xmlSecTransformStatsPtr transformStats;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(stats != NULL, -1);
+
+    memset(stats, 0, sizeof(xmlSecTransformStats));
+    for(transform = ctx->first; transform != NULL; transform = transform->next) {
+        transformStats = xmlSecTransformStatsGet(transform);
+        if(transformStats == NULL) {
+            continue;
+        }
+        stats->bytesIn      += transformStats->bytesIn;
+        stats->bytesOut     += transformStats->bytesOut;
+        stats->pushBinCalls += transformStats->pushBinCalls;
+        stats->popBinCalls  += transformStats->popBinCalls;
+        stats->pushXmlCalls += transformStats->pushXmlCalls;
+        stats->popXmlCalls  += transformStats->popXmlCalls;
+        if(transformStats->time > stats->time) {
+            stats->time = transformStats->time;
+        }
+    }
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * xmlSecTransform
+ *
+ *************************************************************************/
+/**
+ * xmlSecTransformCreate:
+ * @id:                 the transform id to create.
+ *
+ * Creates new transform of the @id klass. The caller is responsible for
+ * destroying returned tansform using #xmlSecTransformDestroy function.
+ *
+ * Returns: pointer to newly created transform or NULL if an error occurs.
+ */
+xmlSecTransformPtr
+xmlSecTransformCreate(xmlSecTransformId id) {
+    xmlSecTransformPtr transform;
+    xmlSecTransformPrivatePtr transformPriv;
+    xmlSecSize size, inlineSize;
+    int ret;
+
+    xmlSecAssert2(id != NULL, NULL);
+    xmlSecAssert2(id->klassSize >= sizeof(xmlSecTransformKlass), NULL);
+    xmlSecAssert2(id->objSize >= sizeof(xmlSecTransform), NULL);
+    xmlSecAssert2(id->name != NULL, NULL);
+
+    /* reuse the transform destroyed by this thread */
+    if(id->reset != NULL) {
+        transform = xmlSecTransformThreadCacheTake(id);
+        if(transform != NULL) {
+            return(transform);
+        }
+    }
+
+    /* the digest or signature is written to the output buffer at the end */
+    if((id->usage & (xmlSecTransformUsageDigestMethod | xmlSecTransformUsageSignatureMethod)) != 0) {
+        inlineSize = XMLSEC_TRANSFORM_OUT_BUF_INLINE_SIZE;
+    } else {
+        inlineSize = 0;
+    }
+
+    /* Allocate a new xmlSecTransform with the private data and fill the fields. */
+    size = xmlSecTransformPrivateOffset(id) + sizeof(xmlSecTransformPrivate) + inlineSize;
+    transform = (xmlSecTransformPtr)xmlMalloc(size);
+    if(transform == NULL) {
+        xmlSecMallocError(size, NULL);
+        return(NULL);
+    }
+    memset(transform, 0, size);
+    transform->id = id;
+    transformPriv = (xmlSecTransformPrivatePtr)(((xmlSecByte*)transform) + xmlSecTransformPrivateOffset(id));
+    transform->reserved0 = transformPriv;
+
+    if(id->initialize != NULL) {
+        ret = (id->initialize)(transform);
+        if(ret < 0) {
+            xmlSecInternalError("id->initialize",
+                                xmlSecTransformGetName(transform));
+            xmlSecTransformFree(transform);
+            return(NULL);
+        }
+    }
+
+    ret = xmlSecBufferInitialize(&(transform->inBuf), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecTransformGetName(transform));
+        xmlSecTransformFree(transform);
+        return(NULL);
+    }
+
+    ret = xmlSecBufferInitialize(&(transform->outBuf), 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecTransformGetName(transform));
+        xmlSecTransformFree(transform);
+        return(NULL);
+    }
+
+    if(inlineSize > 0) {
+        ret = xmlSecBufferSetInlineStorage(&(transform->outBuf),
+                                           ((xmlSecByte*)transformPriv) + sizeof(xmlSecTransformPrivate),
+                                           inlineSize);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferSetInlineStorage",
+                                xmlSecTransformGetName(transform));
+            xmlSecTransformFree(transform);
+            return(NULL);
+        }
+    }
+
+    /* transforms consume their buffers from the head */
+    transform->inBuf.allocMode = xmlSecAllocModeOffset;
+    transform->outBuf.allocMode = xmlSecAllocModeOffset;
+
+    return(transform);
+}
+
+/**
+ * xmlSecTransformDestroy:
+ * @transform:          the pointer to transform.
+ *
+ * Destroys transform created with #xmlSecTransformCreate function. The
+ * transforms with the klass reset method (see #xmlSecTransformResetMethod)
+ * are kept for the next #xmlSecTransformCreate call from the same thread.
+ */
+void
+xmlSecTransformDestroy(xmlSecTransformPtr transform) {
+    xmlSecAssert(xmlSecTransformIsValid(transform));
+    xmlSecAssert(transform->id->objSize > 0);
+
+    if(transform->id->reset != NULL) {
+        if(xmlSecTransformRecycle(transform) < 0) {
+            /* the transform is destroyed */
+            return;
+        }
+        if(xmlSecTransformThreadCachePut(transform) < 0) {
+            xmlSecTransformFreeRecycled(transform);
+        }
+        return;
+    }
+    xmlSecTransformFree(transform);
+}
+
+static void
+xmlSecTransformFree(xmlSecTransformPtr transform) {
+    xmlSecAssert(xmlSecTransformIsValid(transform));
+    xmlSecAssert(transform->id->objSize > 0);
+
+    /* first need to remove ourselves from chain */
+    xmlSecTransformRemove(transform);
+
+    xmlSecBufferFinalize(&(transform->inBuf));
+    xmlSecBufferFinalize(&(transform->outBuf));
+
+    /* we never destroy input nodes, output nodes
+     * are destroyed if and only if they are different
+     * from input nodes
+     */
+    if((transform->outNodes != NULL) && (transform->outNodes != transform->inNodes)) {
+        xmlSecNodeSetDestroy(transform->outNodes);
+    }
+    if(transform->id->finalize != NULL) {
+        (transform->id->finalize)(transform);
+    }
+    memset(transform, 0, transform->id->objSize);
+    xmlFree(transform);
+}
+
+/*
+ * Same as xmlSecTransformDestroy() but keeps the memory and, if the klass
+ * has the reset method, the klass data for reuse. The transform is destroyed
+ * if it can not be reset.
+ */
+static int
+xmlSecTransformRecycle(xmlSecTransformPtr transform) {
+    xmlSecTransformId id;
+    xmlSecTransformPrivatePtr transformPriv;
+    xmlSecBuffer inBuf, outBuf;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
+    xmlSecAssert2(transform->id->objSize > 0, -1);
+
+    xmlSecTransformRemove(transform);
+    if((transform->outNodes != NULL) && (transform->outNodes != transform->inNodes)) {
+        xmlSecNodeSetDestroy(transform->outNodes);
+    }
+    transform->outNodes = NULL;
+
+    if(transform->id->reset != NULL) {
+        ret = (transform->id->reset)(transform);
+        if(ret < 0) {
+            xmlSecInternalError("id->reset",
+                                xmlSecTransformGetName(transform));
+            xmlSecTransformFree(transform);
+            return(-1);
+        }
+    } else if(transform->id->finalize != NULL) {
+        (transform->id->finalize)(transform);
+    }
+    xmlSecTransformRecycleBuffer(&(transform->inBuf));
+    xmlSecTransformRecycleBuffer(&(transform->outBuf));
+
+    /* the klass data after the transform is kept if it was reset */
+    id = transform->id;
+    inBuf = transform->inBuf;
+    outBuf = transform->outBuf;
+    transformPriv = xmlSecTransformGetPrivate(transform);
+    if(id->reset != NULL) {
+        memset(transform, 0, sizeof(xmlSecTransform));
+    } else {
+        memset(transform, 0, id->objSize);
+    }
+    transform->id = id;
+    transform->inBuf = inBuf;
+    transform->outBuf = outBuf;
+    transform->reserved0 = transformPriv;
+    if(transformPriv != NULL) {
+        memset(&(transformPriv->stats), 0, sizeof(xmlSecTransformStats));
+    }
+    return(0);
+}
+
+/* prepares the transform from xmlSecTransformRecycle() for reuse or destroys it */
+static int
+xmlSecTransformReuse(xmlSecTransformPtr transform) {
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
+
+    /* the buffers are already initialized, only klass data might be missing */
+    if((transform->id->reset == NULL) && (transform->id->initialize != NULL)) {
+        ret = (transform->id->initialize)(transform);
+        if(ret < 0) {
+            xmlSecInternalError("id->initialize",
+                                xmlSecTransformGetName(transform));
+            xmlSecTransformFree(transform);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* destroys the transform from xmlSecTransformRecycle() */
+static void
+xmlSecTransformFreeRecycled(xmlSecTransformPtr transform) {
+    xmlSecAssert(xmlSecTransformIsValid(transform));
+
+    if((transform->id->reset != NULL) && (transform->id->finalize != NULL)) {
+        (transform->id->finalize)(transform);
+    }
+    xmlSecBufferFinalize(&(transform->inBuf));
+    xmlSecBufferFinalize(&(transform->outBuf));
+    memset(transform, 0, transform->id->objSize);
+    xmlFree(transform);
+}
+
+/**************************************************************************
+ *
+ * Per-thread transforms cache: the destroyed transforms with the klass
+ * reset method are kept with their klass data (e.g. the crypto library
+ * contexts) for the next xmlSecTransformCreate() call from the same
+ * thread. The owner thread is the only user of its cache except for
+ * xmlSecTransformCacheFlush() which releases the transforms from all
+ * the caches, hence the uncontended per-cache mutex.
+ *
+ *************************************************************************/
+typedef struct _xmlSecTransformThreadCache              xmlSecTransformThreadCache,
+                                                        *xmlSecTransformThreadCachePtr;
+struct _xmlSecTransformThreadCache {
+    xmlSecTransformPtr                  transforms;     /* linked thru transform->next */
+    xmlSecSize                          size;
+    xmlMutexPtr                         mutex;
+    xmlSecTransformThreadCachePtr       next;           /* all the threads caches */
+    xmlSecTransformThreadCachePtr       prev;
+};
+
+#if defined(XMLSEC_TRANSFORM_CACHE_WIN32)
+static DWORD xmlSecTransformThreadCacheKey = TLS_OUT_OF_INDEXES;
+#elif defined(XMLSEC_TRANSFORM_CACHE_PTHREAD)
+static pthread_key_t xmlSecTransformThreadCacheKey;
+static int xmlSecTransformThreadCacheKeyCreated = 0;
+#else /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+/* no threads support, there is only one thread */
+static xmlSecTransformThreadCachePtr xmlSecTransformThreadCacheCurrent = NULL;
+#endif /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+
+static xmlSecTransformThreadCachePtr xmlSecTransformThreadCaches = NULL;
+static xmlMutexPtr xmlSecTransformThreadCachesMutex = NULL;
+
+static void
+xmlSecTransformThreadCacheClear(xmlSecTransformThreadCachePtr cache) {
+    xmlSecTransformPtr transforms, transform;
+
+    xmlSecAssert(cache != NULL);
+
+    xmlMutexLock(cache->mutex);
+    transforms = cache->transforms;
+    cache->transforms = NULL;
+    cache->size = 0;
+    xmlMutexUnlock(cache->mutex);
+
+    while(transforms != NULL) {
+        transform = transforms;
+        transforms = transform->next;
+        transform->next = NULL;
+
+        xmlSecTransformFreeRecycled(transform);
+    }
+}
+
+static void
+xmlSecTransformThreadCacheRelease(xmlSecTransformThreadCachePtr cache) {
+    xmlSecAssert(cache != NULL);
+
+    xmlSecTransformThreadCacheClear(cache);
+    xmlFreeMutex(cache->mutex);
+    memset(cache, 0, sizeof(xmlSecTransformThreadCache));
+    xmlFree(cache);
+}
+
+/* called when the thread exits */
+static void
+xmlSecTransformThreadCacheDestroy(void* data) {
+    xmlSecTransformThreadCachePtr cache = (xmlSecTransformThreadCachePtr)data;
+
+    if(cache == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecTransformThreadCachesMutex);
+    if(cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    } else {
+        xmlSecTransformThreadCaches = cache->next;
+    }
+    if(cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+    xmlMutexUnlock(xmlSecTransformThreadCachesMutex);
+
+    xmlSecTransformThreadCacheRelease(cache);
+}
+
+static void
+xmlSecTransformThreadCacheInitialize(void) {
+    xmlSecTransformThreadCachesMutex = xmlNewMutex();
+    if(xmlSecTransformThreadCachesMutex == NULL) {
+        /* no cache, not an error */
+        return;
+    }
+#if defined(XMLSEC_TRANSFORM_CACHE_WIN32)
+    if(xmlSecTransformThreadCacheKey == TLS_OUT_OF_INDEXES) {
+        xmlSecTransformThreadCacheKey = TlsAlloc();
+    }
+#elif defined(XMLSEC_TRANSFORM_CACHE_PTHREAD)
+    if(xmlSecTransformThreadCacheKeyCreated == 0) {
+        if(pthread_key_create(&xmlSecTransformThreadCacheKey, xmlSecTransformThreadCacheDestroy) == 0) {
+            xmlSecTransformThreadCacheKeyCreated = 1;
+        }
+    }
+#endif /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+}
+
+static void
+xmlSecTransformThreadCacheShutdown(void) {
+    xmlSecTransformThreadCachePtr cache;
+
+    if(xmlSecTransformThreadCachesMutex == NULL) {
+        return;
+    }
+
+    /* the caches of the threads that are still running are released too */
+    xmlMutexLock(xmlSecTransformThreadCachesMutex);
+    while(xmlSecTransformThreadCaches != NULL) {
+        cache = xmlSecTransformThreadCaches;
+        xmlSecTransformThreadCaches = cache->next;
+
+        xmlSecTransformThreadCacheRelease(cache);
     }
-}
+    xmlMutexUnlock(xmlSecTransformThreadCachesMutex);
 
-/**
- * xmlSecTransformCtxDebugXmlDump:
- * @ctx:                the pointer to transforms chain processing context.
- * @output:             the pointer to output FILE.
- *
- * Prints transforms context debug information to @output in XML format.
- */
-void
-xmlSecTransformCtxDebugXmlDump(xmlSecTransformCtxPtr ctx, FILE* output) {
-    xmlSecTransformPtr transform;
+#if defined(XMLSEC_TRANSFORM_CACHE_WIN32)
+    if(xmlSecTransformThreadCacheKey != TLS_OUT_OF_INDEXES) {
+        TlsFree(xmlSecTransformThreadCacheKey);
+        xmlSecTransformThreadCacheKey = TLS_OUT_OF_INDEXES;
+    }
+#elif defined(XMLSEC_TRANSFORM_CACHE_PTHREAD)
+    if(xmlSecTransformThreadCacheKeyCreated != 0) {
+        pthread_key_delete(xmlSecTransformThreadCacheKey);
+        xmlSecTransformThreadCacheKeyCreated = 0;
+    }
+#else /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+    xmlSecTransformThreadCacheCurrent = NULL;
+#endif /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
 
-    xmlSecAssert(ctx != NULL);
-    xmlSecAssert(output != NULL);
+    xmlFreeMutex(xmlSecTransformThreadCachesMutex);
+    xmlSecTransformThreadCachesMutex = NULL;
+}
 
-    fprintf(output, "<TransformCtx status=\"%d\">\n", ctx->status);
+/*
+ * Gets the current thread cache creating it if requested. The cache is
+ * an optimization: if it can not be created, the transforms are simply
+ * not cached and no error is reported.
+ */
+static xmlSecTransformThreadCachePtr
+xmlSecTransformThreadCacheGet(int create) {
+    xmlSecTransformThreadCachePtr cache;
 
-    fprintf(output, "<Flags>%08x</Flags>\n", ctx->flags);
-    fprintf(output, "<Flags2>%08x</Flags2>\n", ctx->flags2);
-    if(xmlSecPtrListGetSize(&(ctx->enabledTransforms)) > 0) {
-        fprintf(output, "<EnabledTransforms>\n");
-        xmlSecTransformIdListDebugXmlDump(&(ctx->enabledTransforms), output);
-        fprintf(output, "</EnabledTransforms>\n");
-    } else {
-        fprintf(output, "<EnabledTransforms>all</EnabledTransforms>\n");
+    if(xmlSecTransformThreadCachesMutex == NULL) {
+        return(NULL);
     }
 
+#if defined(XMLSEC_TRANSFORM_CACHE_WIN32)
+    if(xmlSecTransformThreadCacheKey == TLS_OUT_OF_INDEXES) {
+        return(NULL);
+    }
+    cache = (xmlSecTransformThreadCachePtr)TlsGetValue(xmlSecTransformThreadCacheKey);
+#elif defined(XMLSEC_TRANSFORM_CACHE_PTHREAD)
+    if(xmlSecTransformThreadCacheKeyCreated == 0) {
+        return(NULL);
+    }
+    cache = (xmlSecTransformThreadCachePtr)pthread_getspecific(xmlSecTransformThreadCacheKey);
+#else /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+    cache = xmlSecTransformThreadCacheCurrent;
+#endif /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+    if((cache != NULL) || (create == 0)) {
+        return(cache);
+    }
 
-    fprintf(output, "<Uri>");
-    xmlSecPrintXmlString(output, ctx->uri);
-    fprintf(output, "</Uri>\n");
+    cache = (xmlSecTransformThreadCachePtr)xmlMalloc(sizeof(xmlSecTransformThreadCache));
+    if(cache == NULL) {
+        return(NULL);
+    }
+    memset(cache, 0, sizeof(xmlSecTransformThreadCache));
 
-    fprintf(output, "<UriXPointer>");
-    xmlSecPrintXmlString(output, ctx->xptrExpr);
-    fprintf(output, "</UriXPointer>\n");
+    cache->mutex = xmlNewMutex();
+    if(cache->mutex == NULL) {
+        xmlFree(cache);
+        return(NULL);
+    }
 
-    for(transform = ctx->first; transform != NULL; transform = transform->next) {
-        xmlSecTransformDebugXmlDump(transform, output);
+#if defined(XMLSEC_TRANSFORM_CACHE_WIN32)
+    if(!TlsSetValue(xmlSecTransformThreadCacheKey, cache)) {
+        xmlSecTransformThreadCacheRelease(cache);
+        return(NULL);
     }
-    fprintf(output, "</TransformCtx>\n");
+#elif defined(XMLSEC_TRANSFORM_CACHE_PTHREAD)
+    if(pthread_setspecific(xmlSecTransformThreadCacheKey, cache) != 0) {
+        xmlSecTransformThreadCacheRelease(cache);
+        return(NULL);
+    }
+#else /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+    xmlSecTransformThreadCacheCurrent = cache;
+#endif /* defined(XMLSEC_TRANSFORM_CACHE_WIN32) */
+
+    xmlMutexLock(xmlSecTransformThreadCachesMutex);
+    cache->next = xmlSecTransformThreadCaches;
+    if(xmlSecTransformThreadCaches != NULL) {
+        xmlSecTransformThreadCaches->prev = cache;
+    }
+    xmlSecTransformThreadCaches = cache;
+    xmlMutexUnlock(xmlSecTransformThreadCachesMutex);
+
+    return(cache);
 }
 
-/**************************************************************************
- *
- * xmlSecTransform
- *
- *************************************************************************/
-/**
- * xmlSecTransformCreate:
- * @id:                 the transform id to create.
- *
- * Creates new transform of the @id klass. The caller is responsible for
- * destroying returned tansform using #xmlSecTransformDestroy function.
- *
- * Returns: pointer to newly created transform or NULL if an error occurs.
- */
-xmlSecTransformPtr
-xmlSecTransformCreate(xmlSecTransformId id) {
-    xmlSecTransformPtr transform;
-    int ret;
+static xmlSecTransformPtr
+xmlSecTransformThreadCacheTake(xmlSecTransformId id) {
+    xmlSecTransformThreadCachePtr cache;
+    xmlSecTransformPtr transform, prev;
 
     xmlSecAssert2(id != NULL, NULL);
-    xmlSecAssert2(id->klassSize >= sizeof(xmlSecTransformKlass), NULL);
-    xmlSecAssert2(id->objSize >= sizeof(xmlSecTransform), NULL);
-    xmlSecAssert2(id->name != NULL, NULL);
 
-    /* Allocate a new xmlSecTransform and fill the fields. */
-    transform = (xmlSecTransformPtr)xmlMalloc(id->objSize);
-    if(transform == NULL) {
-        xmlSecMallocError(id->objSize, NULL);
+    cache = xmlSecTransformThreadCacheGet(0);
+    if(cache == NULL) {
         return(NULL);
     }
-    memset(transform, 0, id->objSize);
-    transform->id = id;
 
-    if(id->initialize != NULL) {
-        ret = (id->initialize)(transform);
-        if(ret < 0) {
-            xmlSecInternalError("id->initialize",
-                                xmlSecTransformGetName(transform));
-            xmlSecTransformDestroy(transform);
-            return(NULL);
+    xmlMutexLock(cache->mutex);
+    for(prev = NULL, transform = cache->transforms; transform != NULL; prev = transform, transform = transform->next) {
+        if(transform->id == id) {
+            break;
         }
     }
+    if(transform != NULL) {
+        if(prev != NULL) {
+            prev->next = transform->next;
+        } else {
+            cache->transforms = transform->next;
+        }
+        --cache->size;
+        transform->next = NULL;
+    }
+    xmlMutexUnlock(cache->mutex);
 
-    ret = xmlSecBufferInitialize(&(transform->inBuf), 0);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecBufferInitialize",
-                            xmlSecTransformGetName(transform));
-        xmlSecTransformDestroy(transform);
-        return(NULL);
+    return(transform);
+}
+
+/* takes the transform from xmlSecTransformRecycle(): returns 0 if the transform is cached */
+static int
+xmlSecTransformThreadCachePut(xmlSecTransformPtr transform) {
+    xmlSecTransformThreadCachePtr cache;
+    int res = -1;
+
+    xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
+    xmlSecAssert2(transform->id->reset != NULL, -1);
+
+    cache = xmlSecTransformThreadCacheGet(1);
+    if(cache == NULL) {
+        return(-1);
     }
 
-    ret = xmlSecBufferInitialize(&(transform->outBuf), 0);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecBufferInitialize",
-                            xmlSecTransformGetName(transform));
-        xmlSecTransformDestroy(transform);
-        return(NULL);
+    xmlMutexLock(cache->mutex);
+    if(cache->size < XMLSEC_TRANSFORM_THREAD_CACHE_MAX) {
+        transform->next = cache->transforms;
+        cache->transforms = transform;
+        ++cache->size;
+        res = 0;
     }
+    xmlMutexUnlock(cache->mutex);
 
-    return(transform);
+    return(res);
 }
 
 /**
- * xmlSecTransformDestroy:
- * @transform:          the pointer to transform.
+ * xmlSecTransformCacheFlush:
  *
- * Destroys transform created with #xmlSecTransformCreate function.
+ * Destroys the transforms kept for reuse by all the threads (see
+ * #xmlSecTransformResetMethod). The crypto libraries call this function
+ * before releasing the resources the cached transforms might hold.
  */
 void
-xmlSecTransformDestroy(xmlSecTransformPtr transform) {
-    xmlSecAssert(xmlSecTransformIsValid(transform));
-    xmlSecAssert(transform->id->objSize > 0);
-
-    /* first need to remove ourselves from chain */
-    xmlSecTransformRemove(transform);
+xmlSecTransformCacheFlush(void) {
+    xmlSecTransformThreadCachePtr cache;
 
-    xmlSecBufferFinalize(&(transform->inBuf));
-    xmlSecBufferFinalize(&(transform->outBuf));
-
-    /* we never destroy input nodes, output nodes
-     * are destroyed if and only if they are different
-     * from input nodes
-     */
-    if((transform->outNodes != NULL) && (transform->outNodes != transform->inNodes)) {
-        xmlSecNodeSetDestroy(transform->outNodes);
+    if(xmlSecTransformThreadCachesMutex == NULL) {
+        return;
     }
-    if(transform->id->finalize != NULL) {
-        (transform->id->finalize)(transform);
+
+    xmlMutexLock(xmlSecTransformThreadCachesMutex);
+    for(cache = xmlSecTransformThreadCaches; cache != NULL; cache = cache->next) {
+        xmlSecTransformThreadCacheClear(cache);
     }
-    memset(transform, 0, transform->id->objSize);
-    xmlFree(transform);
+    xmlMutexUnlock(xmlSecTransformThreadCachesMutex);
 }
 
 /**
@@ -1288,24 +2643,43 @@ xmlSecTransformPtr
 xmlSecTransformNodeRead(xmlNodePtr node, xmlSecTransformUsage usage, xmlSecTransformCtxPtr transformCtx) {
     xmlSecTransformPtr transform;
     xmlSecTransformId id;
+    xmlSecArenaPtr arena;
     xmlChar *href;
     int ret;
 
     xmlSecAssert2(node != NULL, NULL);
     xmlSecAssert2(transformCtx != NULL, NULL);
 
-    href = xmlGetProp(node, xmlSecAttrAlgorithm);
+    arena = xmlSecTransformCtxGetArena(transformCtx);
+    if(arena == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxGetArena", NULL);
+        return(NULL);
+    }
+
+    /* href is allocated from the arena */
+    href = xmlSecArenaGetProp(arena, node, xmlSecAttrAlgorithm);
     if(href == NULL) {
         xmlSecInvalidNodeAttributeError(node, xmlSecAttrAlgorithm,
                                         NULL, "empty");
         return(NULL);
     }
 
-    id = xmlSecTransformIdListFindByHref(xmlSecTransformIdsGet(), href, usage);
+    /* the compiled template already knows the transform */
+    id = xmlSecTransformIdUnknown;
+    if((xmlSecTransformCtxGetPrivate(transformCtx) != NULL) && (xmlSecTransformCtxGetPrivate(transformCtx)->plan != NULL)) {
+        id = xmlSecTransformPlanFind(xmlSecTransformCtxGetPrivate(transformCtx)->plan, href, usage);
+    }
+    /* prefer the enabled transforms: the global list might have several
+     * klasses with the same href from different crypto libraries */
+    if((id == xmlSecTransformIdUnknown) && (xmlSecPtrListGetSize(&(transformCtx->enabledTransforms)) > 0)) {
+        id = xmlSecTransformIdListFindByHref(&(transformCtx->enabledTransforms), href, usage);
+    }
+    if(id == xmlSecTransformIdUnknown) {
+        id = xmlSecTransformIdListFindByHref(xmlSecTransformIdsGet(), href, usage);
+    }
     if(id == xmlSecTransformIdUnknown) {
         xmlSecInternalError2("xmlSecTransformIdListFindByHref", NULL,
                              "href=%s", xmlSecErrorsSafeString(href));
-        xmlFree(href);
         return(NULL);
     }
 
@@ -1315,15 +2689,13 @@ xmlSecTransformNodeRead(xmlNodePtr node, xmlSecTransformUsage usage, xmlSecTrans
         xmlSecOtherError2(XMLSEC_ERRORS_R_TRANSFORM_DISABLED,
                           xmlSecTransformKlassGetName(id),
                           "href=%s", xmlSecErrorsSafeString(href));
-        xmlFree(href);
         return(NULL);
     }
 
-    transform = xmlSecTransformCreate(id);
+    transform = xmlSecTransformCtxCreateTransform(transformCtx, id);
     if(!xmlSecTransformIsValid(transform)) {
-        xmlSecInternalError("xmlSecTransformCreate(id)",
+        xmlSecInternalError("xmlSecTransformCtxCreateTransform",
                             xmlSecTransformKlassGetName(id));
-        xmlFree(href);
         return(NULL);
     }
 
@@ -1333,14 +2705,12 @@ xmlSecTransformNodeRead(xmlNodePtr node, xmlSecTransformUsage usage, xmlSecTrans
             xmlSecInternalError("readNode",
                                 xmlSecTransformGetName(transform));
             xmlSecTransformDestroy(transform);
-            xmlFree(href);
             return(NULL);
         }
     }
 
     /* finally remember the transform node */
     transform->hereNode = node;
-    xmlFree(href);
     return(transform);
 }
 
@@ -1388,25 +2758,48 @@ xmlSecTransformPump(xmlSecTransformPtr left, xmlSecTransformPtr right, xmlSecTra
        }
     }  else if(((leftType & xmlSecTransformDataTypeBin) != 0) &&
                ((rightType & xmlSecTransformDataTypeBin) != 0)) {
-        xmlSecByte buf[XMLSEC_TRANSFORM_BINARY_CHUNK];
-        xmlSecSize bufSize;
+        xmlSecBuffer buf;
+        xmlSecSize chunkSize, bufSize;
         int final;
 
+        ret = xmlSecBufferInitialize(&buf, xmlSecTransformCtxGetBinaryChunkSize(transformCtx));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferInitialize",
+                                xmlSecTransformGetName(left));
+            return(-1);
+        }
+
         do {
-            ret = xmlSecTransformPopBin(left, buf, sizeof(buf), &bufSize, transformCtx);
+            /* the chunk size might change as data goes through the chain */
+            chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
+            ret = xmlSecBufferSetMaxSize(&buf, chunkSize);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferSetMaxSize",
+                                     xmlSecTransformGetName(left),
+                                     "size=" XMLSEC_SIZE_FMT, chunkSize);
+                xmlSecBufferFinalize(&buf);
+                return(-1);
+            }
+
+            ret = xmlSecTransformPopBin(left, xmlSecBufferGetData(&buf), chunkSize, &bufSize, transformCtx);
             if(ret < 0) {
                 xmlSecInternalError("xmlSecTransformPopBin",
                                     xmlSecTransformGetName(left));
+                xmlSecBufferFinalize(&buf);
                 return(-1);
             }
             final = (bufSize == 0) ? 1 : 0;
-            ret = xmlSecTransformPushBin(right, buf, bufSize, final, transformCtx);
+            ret = xmlSecTransformPushBin(right, xmlSecBufferGetData(&buf), bufSize, final, transformCtx);
             if(ret < 0) {
                 xmlSecInternalError("xmlSecTransformPushBin",
                                     xmlSecTransformGetName(right));
+                xmlSecBufferFinalize(&buf);
                 return(-1);
             }
+            xmlSecTransformCtxUpdateBinaryChunkSize(transformCtx, bufSize);
         } while(final == 0);
+
+        xmlSecBufferFinalize(&buf);
     } else {
         xmlSecInvalidTransfromError2(left,
                     "transforms input/output data formats do not match, right transform=\"%s\"",
@@ -1498,6 +2891,8 @@ xmlSecTransformVerify(xmlSecTransformPtr transform, const xmlSecByte* data,
 int
 xmlSecTransformVerifyNodeContent(xmlSecTransformPtr transform, xmlNodePtr node,
                                  xmlSecTransformCtxPtr transformCtx) {
+    xmlSecByte data[XMLSEC_TRANSFORM_VERIFY_STACK_SIZE];
+    xmlSecSize dataSize;
     xmlSecBuffer buffer;
     int ret;
 
@@ -1505,6 +2900,22 @@ xmlSecTransformVerifyNodeContent(xmlSecTransformPtr transform, xmlNodePtr node,
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
+    /* digests and signatures are small: try to avoid the heap */
+    ret = xmlSecBase64NodeContentDecode(node, data, sizeof(data), &dataSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64NodeContentDecode",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    } else if(ret > 0) {
+        ret = xmlSecTransformVerify(transform, data, dataSize, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformVerify",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        return(0);
+    }
+
     ret = xmlSecBufferInitialize(&buffer, 0);
     if(ret < 0) {
         xmlSecInternalError("xmlSecBufferInitialize",
@@ -1569,11 +2980,57 @@ xmlSecTransformGetDataType(xmlSecTransformPtr transform, xmlSecTransformMode mod
 int
 xmlSecTransformPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
                     xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+    xmlSecSize outSize;
+    xmlSecTransformStatsPtr stats;
+    double start;
+    int ret;
+
     xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
     xmlSecAssert2(transform->id->pushBin != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
-    return((transform->id->pushBin)(transform, data, dataSize, final, transformCtx));
+    ctxPriv = xmlSecTransformCtxGetPrivate(transformCtx);
+    if(((transform->id->usage & xmlSecTransformUsageDigestMethod) != 0) && (ctxPriv != NULL)) {
+        ctxPriv->digestSize += dataSize;
+        if((ctxPriv->maxDigestSize > 0) && (ctxPriv->digestSize > ctxPriv->maxDigestSize)) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED,
+                              xmlSecTransformGetName(transform),
+                              "maxDigestSize=%d", (int)ctxPriv->maxDigestSize);
+            return(-1);
+        }
+    }
+
+    if((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) == 0) {
+        /* almost all binary transforms (digests, signatures, ciphers) use
+         * the default method: call it directly, this is done for every
+         * data chunk and the direct call could be inlined */
+        if(transform->id->pushBin == xmlSecTransformDefaultPushBin) {
+            return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+        }
+        return((transform->id->pushBin)(transform, data, dataSize, final, transformCtx));
+    }
+
+    stats = xmlSecTransformStatsGet(transform);
+    if(stats == NULL) {
+        return((transform->id->pushBin)(transform, data, dataSize, final, transformCtx));
+    }
+
+    /* the last transform in the chain keeps the result in the outBuf */
+    outSize = xmlSecBufferGetSize(&(transform->outBuf));
+    start = xmlSecTransformStatsNow();
+    ret = (transform->id->pushBin)(transform, data, dataSize, final, transformCtx);
+    stats->time += xmlSecTransformStatsNow() - start;
+
+    ++stats->pushBinCalls;
+    stats->bytesIn += dataSize;
+    if((transform->prev != NULL) && (xmlSecTransformStatsGet(transform->prev) != NULL)) {
+        xmlSecTransformStatsGet(transform->prev)->bytesOut += dataSize;
+    }
+    if((transform->next == NULL) && (xmlSecBufferGetSize(&(transform->outBuf)) > outSize)) {
+        stats->bytesOut += xmlSecBufferGetSize(&(transform->outBuf)) - outSize;
+    }
+    return(ret);
 }
 
 /**
@@ -1593,13 +3050,41 @@ xmlSecTransformPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
 int
 xmlSecTransformPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
                     xmlSecSize maxDataSize, xmlSecSize* dataSize, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformStatsPtr stats;
+    double start;
+    int ret;
+
     xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
     xmlSecAssert2(transform->id->popBin != NULL, -1);
     xmlSecAssert2(data != NULL, -1);
     xmlSecAssert2(dataSize != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
-    return((transform->id->popBin)(transform, data, maxDataSize, dataSize, transformCtx));
+    if((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) == 0) {
+        /* see xmlSecTransformPushBin() */
+        if(transform->id->popBin == xmlSecTransformDefaultPopBin) {
+            return(xmlSecTransformDefaultPopBin(transform, data, maxDataSize, dataSize, transformCtx));
+        }
+        return((transform->id->popBin)(transform, data, maxDataSize, dataSize, transformCtx));
+    }
+
+    stats = xmlSecTransformStatsGet(transform);
+    if(stats == NULL) {
+        return((transform->id->popBin)(transform, data, maxDataSize, dataSize, transformCtx));
+    }
+
+    start = xmlSecTransformStatsNow();
+    ret = (transform->id->popBin)(transform, data, maxDataSize, dataSize, transformCtx);
+    stats->time += xmlSecTransformStatsNow() - start;
+
+    ++stats->popBinCalls;
+    if(ret >= 0) {
+        stats->bytesOut += (*dataSize);
+        if((transform->next != NULL) && (xmlSecTransformStatsGet(transform->next) != NULL)) {
+            xmlSecTransformStatsGet(transform->next)->bytesIn += (*dataSize);
+        }
+    }
+    return(ret);
 }
 
 /**
@@ -1615,11 +3100,28 @@ xmlSecTransformPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
 int
 xmlSecTransformPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
                     xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformStatsPtr stats;
+    double start;
+    int ret;
+
     xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
     xmlSecAssert2(transform->id->pushXml != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
-    return((transform->id->pushXml)(transform, nodes, transformCtx));
+    if((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) == 0) {
+        return((transform->id->pushXml)(transform, nodes, transformCtx));
+    }
+
+    stats = xmlSecTransformStatsGet(transform);
+    if(stats == NULL) {
+        return((transform->id->pushXml)(transform, nodes, transformCtx));
+    }
+
+    start = xmlSecTransformStatsNow();
+    ret = (transform->id->pushXml)(transform, nodes, transformCtx);
+    stats->time += xmlSecTransformStatsNow() - start;
+    ++stats->pushXmlCalls;
+    return(ret);
 }
 
 /**
@@ -1636,11 +3138,28 @@ xmlSecTransformPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
 int
 xmlSecTransformPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
                     xmlSecTransformCtxPtr transformCtx) {
+    xmlSecTransformStatsPtr stats;
+    double start;
+    int ret;
+
     xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
     xmlSecAssert2(transform->id->popXml != NULL, -1);
     xmlSecAssert2(transformCtx != NULL, -1);
 
-    return((transform->id->popXml)(transform, nodes, transformCtx));
+    if((transformCtx->flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) == 0) {
+        return((transform->id->popXml)(transform, nodes, transformCtx));
+    }
+
+    stats = xmlSecTransformStatsGet(transform);
+    if(stats == NULL) {
+        return((transform->id->popXml)(transform, nodes, transformCtx));
+    }
+
+    start = xmlSecTransformStatsNow();
+    ret = (transform->id->popXml)(transform, nodes, transformCtx);
+    stats->time += xmlSecTransformStatsNow() - start;
+    ++stats->popXmlCalls;
+    return(ret);
 }
 
 /**
@@ -1698,6 +3217,58 @@ xmlSecTransformDebugXmlDump(xmlSecTransformPtr transform, FILE* output) {
     fprintf(output, "\" />\n");
 }
 
+/**
+ * xmlSecTransformGetStats:
+ * @transform:          the pointer to transform.
+ *
+ * Gets the transform statistics collected when the transforms chain
+ * context has #XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS flag set.
+ *
+ * Returns: the pointer to the transform statistics or NULL if an error occurs.
+ */
+xmlSecTransformStatsPtr
+xmlSecTransformGetStats(xmlSecTransformPtr transform) {
+    xmlSecAssert2(xmlSecTransformIsValid(transform), NULL);
+
+    return(xmlSecTransformStatsGet(transform));
+}
+
+static void
+xmlSecTransformStatsDebugDump(xmlSecTransformStatsPtr stats, FILE* output) {
+    xmlSecAssert(stats != NULL);
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "==== stats: bytesIn=%lu; bytesOut=%lu; pushBin=%lu; popBin=%lu; pushXml=%lu; popXml=%lu; time=%.0fus\n",
+            (unsigned long)stats->bytesIn, (unsigned long)stats->bytesOut,
+            (unsigned long)stats->pushBinCalls, (unsigned long)stats->popBinCalls,
+            (unsigned long)stats->pushXmlCalls, (unsigned long)stats->popXmlCalls,
+            stats->time);
+}
+
+static void
+xmlSecTransformStatsDebugXmlDump(xmlSecTransformStatsPtr stats, FILE* output) {
+    xmlSecAssert(stats != NULL);
+    xmlSecAssert(output != NULL);
+
+    fprintf(output, "<TransformStats bytesIn=\"%lu\" bytesOut=\"%lu\" pushBin=\"%lu\" popBin=\"%lu\" pushXml=\"%lu\" popXml=\"%lu\" time=\"%.0f\" />\n",
+            (unsigned long)stats->bytesIn, (unsigned long)stats->bytesOut,
+            (unsigned long)stats->pushBinCalls, (unsigned long)stats->popBinCalls,
+            (unsigned long)stats->pushXmlCalls, (unsigned long)stats->popXmlCalls,
+            stats->time);
+}
+
+static double
+xmlSecTransformStatsNow(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(((double)ts.tv_sec * 1000000.0) + ((double)ts.tv_nsec / 1000.0));
+#else /* defined(CLOCK_MONOTONIC) */
+    return(((double)clock() * 1000000.0) / CLOCKS_PER_SEC);
+#endif /* defined(CLOCK_MONOTONIC) */
+}
+
 /************************************************************************
  *
  * Operations on transforms chain
@@ -1727,6 +3298,10 @@ xmlSecTransformDebugXmlDump(xmlSecTransformPtr transform, FILE* output) {
  * and any of its descendant elements as well as any descendant comments and
  * processing instructions. The output of this transform is an octet stream.
  *
+ * With the #XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS flag the canonicalization
+ * transforms also return XML and no parser is inserted between them and
+ * the XML transforms.
+ *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
@@ -1777,9 +3352,9 @@ xmlSecTransformConnect(xmlSecTransformPtr left, xmlSecTransformPtr right,
     }
 
     /* insert transform */
-    middle = xmlSecTransformCreate(middleId);
+    middle = xmlSecTransformCtxCreateTransform(transformCtx, middleId);
     if(middle == NULL) {
-        xmlSecInternalError("xmlSecTransformCreate",
+        xmlSecInternalError("xmlSecTransformCtxCreateTransform",
                             xmlSecTransformKlassGetName(middleId));
         return(-1);
     }
@@ -1807,6 +3382,10 @@ xmlSecTransformRemove(xmlSecTransformPtr transform) {
         transform->prev->next = transform->next;
     }
     transform->next = transform->prev = NULL;
+
+    /* the transform is not a part of the chain anymore */
+    xmlSecBufferSetMemCounter(&(transform->inBuf), NULL);
+    xmlSecBufferSetMemCounter(&(transform->outBuf), NULL);
 }
 
 
@@ -1863,6 +3442,34 @@ xmlSecTransformDefaultGetDataType(xmlSecTransformPtr transform, xmlSecTransformM
     return(type);
 }
 
+/*
+ * The output of @transform can be handed over to the next transform as-is
+ * if the next transform processes its input with the default pushBin method
+ * (i.e. it would simply append the data to its empty inBuf). The swapped
+ * out buffer becomes our new (empty) outBuf.
+ */
+static int
+xmlSecTransformDefaultCanHandOff(xmlSecTransformPtr transform, xmlSecSize outSize) {
+    xmlSecAssert2(transform != NULL, 0);
+
+    if((outSize == 0) || (transform->next == NULL)) {
+        return(0);
+    }
+    /* the base64 transform only handles the big pushed data differently */
+    if((transform->next->id->pushBin != xmlSecTransformDefaultPushBin) &&
+       (transform->next->id != xmlSecTransformBase64Id)) {
+        return(0);
+    }
+    if(xmlSecBufferGetSize(&(transform->next->inBuf)) != 0) {
+        return(0);
+    }
+    /* copying the small output is cheaper than moving it to the heap */
+    if(outSize <= transform->outBuf.inlineSize) {
+        return(0);
+    }
+    return(1);
+}
+
 /**
  * xmlSecTransformDefaultPushBin:
  * @transform:          the pointer to transform object.
@@ -1896,8 +3503,8 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
             xmlSecAssert2(data != NULL, -1);
 
             chunkSize = dataSize;
-            if(chunkSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-                chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+            if(chunkSize > xmlSecTransformCtxGetBinaryChunkSize(transformCtx)) {
+                chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
             }
 
             ret = xmlSecBufferAppend(&(transform->inBuf), data, chunkSize);
@@ -1910,6 +3517,7 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
 
             dataSize -= chunkSize;
             data += chunkSize;
+            xmlSecTransformCtxUpdateBinaryChunkSize(transformCtx, chunkSize);
         }
 
         /* process data */
@@ -1930,10 +3538,28 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
         }
 
         /* we don't want to puch too much */
-        if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-            outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+        if(outSize > xmlSecTransformCtxGetBinaryChunkSize(transformCtx)) {
+            outSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
             finalData = 0;
         }
+        if(xmlSecTransformDefaultCanHandOff(transform, outSize) != 0) {
+            /* give the whole output to the next transform without copying */
+            outSize = xmlSecBufferGetSize(&(transform->outBuf));
+            ret = xmlSecBufferSwap(&(transform->outBuf), &(transform->next->inBuf));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecBufferSwap",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+            ret = xmlSecTransformPushBin(transform->next, NULL, 0, finalData, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError3("xmlSecTransformPushBin",
+                                     xmlSecTransformGetName(transform->next),
+                                     "final=%d;outSize=" XMLSEC_SIZE_FMT, final, outSize);
+                return(-1);
+            }
+            continue;
+        }
         if((transform->next != NULL) && ((outSize > 0) || (finalData != 0))) {
             ret = xmlSecTransformPushBin(transform->next,
                             xmlSecBufferGetData(&(transform->outBuf)),
@@ -1996,7 +3622,7 @@ xmlSecTransformDefaultPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             xmlSecSize inSize, chunkSize;
 
             inSize = xmlSecBufferGetSize(&(transform->inBuf));
-            chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+            chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
 
             /* ensure that we have space for at least one data chunk */
             ret = xmlSecBufferSetMaxSize(&(transform->inBuf), inSize + chunkSize);
@@ -2050,8 +3676,8 @@ xmlSecTransformDefaultPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
     }
 
     /* we don't want to put too much */
-    if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-        outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+    if(outSize > xmlSecTransformCtxGetBinaryChunkSize(transformCtx)) {
+        outSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
     }
     if(outSize > 0) {
         xmlSecAssert2(xmlSecBufferGetData(&(transform->outBuf)), -1);
@@ -2231,6 +3857,17 @@ xmlSecTransformIdListFindByHref(xmlSecPtrListPtr list, const xmlChar* href,
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecTransformIdListId), xmlSecTransformIdUnknown);
     xmlSecAssert2(href != NULL, xmlSecTransformIdUnknown);
 
+    if(xmlSecTransformIdsIndexEnsure(list) == 1) {
+        transformId = (xmlSecTransformId)xmlHashLookup(xmlSecAllTransformIdsByHref, href);
+        if(transformId == xmlSecTransformIdUnknown) {
+            return(xmlSecTransformIdUnknown);
+        }
+        if((usage & transformId->usage) != 0) {
+            return(transformId);
+        }
+        /* another klass with the same href might have the right usage */
+    }
+
     size = xmlSecPtrListGetSize(list);
     for(i = 0; i < size; ++i) {
         transformId = (xmlSecTransformId)xmlSecPtrListGetItem(list, i);
@@ -2263,6 +3900,17 @@ xmlSecTransformIdListFindByName(xmlSecPtrListPtr list, const xmlChar* name,
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecTransformIdListId), xmlSecTransformIdUnknown);
     xmlSecAssert2(name != NULL, xmlSecTransformIdUnknown);
 
+    if(xmlSecTransformIdsIndexEnsure(list) == 1) {
+        transformId = (xmlSecTransformId)xmlHashLookup(xmlSecAllTransformIdsByName, name);
+        if(transformId == xmlSecTransformIdUnknown) {
+            return(xmlSecTransformIdUnknown);
+        }
+        if((usage & transformId->usage) != 0) {
+            return(transformId);
+        }
+        /* another klass with the same name might have the right usage */
+    }
+
     size = xmlSecPtrListGetSize(list);
     for(i = 0; i < size; ++i) {
         transformId = (xmlSecTransformId)xmlSecPtrListGetItem(list, i);
@@ -2545,6 +4193,7 @@ xmlSecTransformIOBufferClose(xmlSecTransformIOBufferPtr buffer) {
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformPushBin",
                                 xmlSecTransformGetName(buffer->transform));
+            xmlSecTransformIOBufferDestroy(buffer);
             return(-1);
         }
     }
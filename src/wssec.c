@@ -0,0 +1,819 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * WS-Security header processing.
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include "globals.h"
+
+#ifndef XMLSEC_NO_SOAP
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/valid.h>
+#include <libxml/hash.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/xmltree.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/list.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysdata.h>
+#include <xmlsec/keyinfo.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/transforms.h>
+#include <xmlsec/xmldsig.h>
+#include <xmlsec/xmlenc.h>
+#include <xmlsec/soap.h>
+#include <xmlsec/wssec.h>
+#include <xmlsec/errors.h>
+
+/**************************************************************************
+ *
+ * WS-Security header
+ *
+ * The <wsse:Security/> header children are indexed once: the tokens
+ * (any header element with Id attribute) go to a hash table and the
+ * elements that need processing go to the entries list in the header
+ * order. The <wsse:SecurityTokenReference/> elements are resolved with the
+ * tokens table, the references to the elements outside of the header
+ * are not followed (the keys manager is used for them). The unwrapped
+ * <enc:EncryptedKey/> values are kept until the header is finalized thus
+ * every encrypted key is decrypted only once.
+ *
+ *****************************************************************************/
+static const xmlChar* xmlSecWsSecDefaultIds[] = { xmlSecAttrId, NULL };
+
+static xmlSecPtrListKlass xmlSecWsSecNodesListKlass = {
+    BAD_CAST "wssec-nodes",
+    NULL,                                       /* xmlSecPtrDuplicateItemMethod duplicateItem; */
+    NULL,                                       /* xmlSecPtrDestroyItemMethod destroyItem; */
+    NULL,                                       /* xmlSecPtrDebugDumpItemMethod debugDumpItem; */
+    NULL,                                       /* xmlSecPtrDebugDumpItemMethod debugXmlDumpItem; */
+};
+
+static void             xmlSecWsSecSessionKeyDestroy    (void* payload,
+                                                         const xmlChar* name);
+static int              xmlSecWsSecHeaderIndexNode      (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node,
+                                                         int* isEntry);
+static int              xmlSecWsSecHeaderIndexDecrypted (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr first,
+                                                         xmlNodePtr last,
+                                                         xmlSecSize pos);
+static xmlNodePtr       xmlSecWsSecHeaderResolveKeyInfo (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node);
+static xmlSecBufferPtr  xmlSecWsSecHeaderGetSessionKey  (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr encKeyNode);
+static xmlSecKeyPtr     xmlSecWsSecHeaderGetTokenKey    (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr tokenNode,
+                                                         xmlNodePtr methodNode,
+                                                         xmlSecTransformUsage usage,
+                                                         xmlSecTransformOperation operation,
+                                                         xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int              xmlSecWsSecHeaderProcessEncryptedKey(xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node);
+static int              xmlSecWsSecHeaderProcessReferenceList(xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr encKeyNode);
+static int              xmlSecWsSecHeaderDecrypt        (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr encKeyNode);
+static int              xmlSecWsSecHeaderVerify         (xmlSecWsSecHeaderPtr header,
+                                                         xmlNodePtr node);
+
+/**
+ * xmlSecWsSecHeaderInitialize:
+ * @header:             the pointer to WS-Security header processing context.
+ * @keysMngr:           the pointer to keys manager (may be NULL).
+ *
+ * Initializes the WS-Security header processing context.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecWsSecHeaderInitialize(xmlSecWsSecHeaderPtr header, xmlSecKeysMngrPtr keysMngr) {
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+
+    memset(header, 0, sizeof(xmlSecWsSecHeader));
+    header->keysMngr = keysMngr;
+    header->ids = xmlSecWsSecDefaultIds;
+    header->status = xmlSecDSigStatusUnknown;
+
+    ret = xmlSecPtrListInitialize(&(header->entries), &xmlSecWsSecNodesListKlass);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize", NULL);
+        return(-1);
+    }
+
+    header->tokens = xmlHashCreate(0);
+    if(header->tokens == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecWsSecHeaderFinalize(header);
+        return(-1);
+    }
+
+    header->sessionKeys = xmlHashCreate(0);
+    if(header->sessionKeys == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecWsSecHeaderFinalize(header);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * xmlSecWsSecHeaderFinalize:
+ * @header:             the pointer to WS-Security header processing context.
+ *
+ * Cleans up the WS-Security header processing context.
+ */
+void
+xmlSecWsSecHeaderFinalize(xmlSecWsSecHeaderPtr header) {
+    xmlSecAssert(header != NULL);
+
+    xmlSecPtrListFinalize(&(header->entries));
+    if(header->tokens != NULL) {
+        xmlHashFree(header->tokens, NULL);
+    }
+    if(header->sessionKeys != NULL) {
+        xmlHashFree(header->sessionKeys, xmlSecWsSecSessionKeyDestroy);
+    }
+    memset(header, 0, sizeof(xmlSecWsSecHeader));
+}
+
+/**
+ * xmlSecWsSecFindSecurity:
+ * @envNode:            the pointer to SOAP 1.1 or 1.2 <soap:Envelope/> node.
+ *
+ * Searches the SOAP header for the <wsse:Security/> node.
+ *
+ * Returns: pointer to <wsse:Security/> node or NULL if it is not found.
+ */
+xmlNodePtr
+xmlSecWsSecFindSecurity(xmlNodePtr envNode) {
+    xmlNodePtr headerNode;
+
+    xmlSecAssert2(envNode != NULL, NULL);
+
+    if(xmlSecCheckNodeName(envNode, xmlSecNodeEnvelope, xmlSecSoap12Ns)) {
+        headerNode = xmlSecSoap12GetHeader(envNode);
+    } else {
+        headerNode = xmlSecSoap11GetHeader(envNode);
+    }
+    if(headerNode == NULL) {
+        return(NULL);
+    }
+
+    return(xmlSecFindChild(headerNode, xmlSecNodeSecurity, xmlSecWsseNs));
+}
+
+/**
+ * xmlSecWsSecHeaderRead:
+ * @header:             the pointer to WS-Security header processing context.
+ * @securityNode:       the pointer to <wsse:Security/> node.
+ * @ids:                the ID attributes names (NULL terminated list) or NULL
+ *                      to use "Id" (wsu:Id, dsig and xmlenc Id attributes).
+ *
+ * Indexes the <wsse:Security/> header children in one pass and registers
+ * the @ids attributes of the whole document with #xmlSecAddIDs. The @ids
+ * list must be valid until the header is finalized.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecWsSecHeaderRead(xmlSecWsSecHeaderPtr header, xmlNodePtr securityNode, const xmlChar** ids) {
+    xmlNodePtr cur;
+    int isEntry;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(header->tokens != NULL, -1);
+    xmlSecAssert2(header->securityNode == NULL, -1);
+    xmlSecAssert2(securityNode != NULL, -1);
+    xmlSecAssert2(securityNode->doc != NULL, -1);
+
+    if(!xmlSecCheckNodeName(securityNode, xmlSecNodeSecurity, xmlSecWsseNs)) {
+        xmlSecInvalidNodeError(securityNode, xmlSecNodeSecurity, NULL);
+        return(-1);
+    }
+    header->securityNode = securityNode;
+    if(ids != NULL) {
+        header->ids = ids;
+    }
+
+    for(cur = xmlSecGetNextElementNode(securityNode->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        ret = xmlSecWsSecHeaderIndexNode(header, cur, &isEntry);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecWsSecHeaderIndexNode", NULL);
+            return(-1);
+        }
+        if(isEntry != 0) {
+            ret = xmlSecPtrListAdd(&(header->entries), cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListAdd", NULL);
+                return(-1);
+            }
+        }
+    }
+
+    /* the signatures and the references lists point to the body and to
+     * the header elements by ids */
+    xmlSecAddIDs(securityNode->doc, NULL, header->ids);
+    return(0);
+}
+
+/**
+ * xmlSecWsSecHeaderFindToken:
+ * @header:             the pointer to WS-Security header processing context.
+ * @id:                 the token id.
+ *
+ * Searches the <wsse:Security/> header for the element with Id
+ * attribute @id.
+ *
+ * Returns: pointer to the token node or NULL if it is not found.
+ */
+xmlNodePtr
+xmlSecWsSecHeaderFindToken(xmlSecWsSecHeaderPtr header, const xmlChar* id) {
+    xmlSecAssert2(header != NULL, NULL);
+    xmlSecAssert2(header->tokens != NULL, NULL);
+    xmlSecAssert2(id != NULL, NULL);
+
+    return((xmlNodePtr)xmlHashLookup(header->tokens, id));
+}
+
+/**
+ * xmlSecWsSecHeaderResolveTokenReference:
+ * @header:             the pointer to WS-Security header processing context.
+ * @strNode:            the pointer to <wsse:SecurityTokenReference/> node.
+ *
+ * Resolves the direct <wsse:Reference URI="#id"/> reference to
+ * the <wsse:Security/> header token.
+ *
+ * Returns: pointer to the token node or NULL if @strNode does not
+ * reference a header token.
+ */
+xmlNodePtr
+xmlSecWsSecHeaderResolveTokenReference(xmlSecWsSecHeaderPtr header, xmlNodePtr strNode) {
+    xmlNodePtr refNode;
+    xmlNodePtr res = NULL;
+    xmlChar* uri;
+
+    xmlSecAssert2(header != NULL, NULL);
+    xmlSecAssert2(strNode != NULL, NULL);
+
+    refNode = xmlSecFindChild(strNode, xmlSecNodeReference, xmlSecWsseNs);
+    if(refNode == NULL) {
+        return(NULL);
+    }
+
+    uri = xmlGetProp(refNode, xmlSecAttrURI);
+    if((uri != NULL) && (uri[0] == '#')) {
+        res = xmlSecWsSecHeaderFindToken(header, uri + 1);
+    }
+    if(uri != NULL) {
+        xmlFree(uri);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecWsSecHeaderProcess:
+ * @header:             the pointer to WS-Security header processing context.
+ *
+ * Processes the <wsse:Security/> header read with #xmlSecWsSecHeaderRead
+ * in the header order: decrypts the data referenced from <enc:EncryptedKey/>
+ * and <enc:ReferenceList/> elements and the encrypted header elements,
+ * verifies the signatures. The decrypted header elements are processed
+ * in place of the <enc:EncryptedData/> element. The signatures verification
+ * result is returned in the @header status member.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecWsSecHeaderProcess(xmlSecWsSecHeaderPtr header) {
+    xmlNodePtr cur;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(header->securityNode != NULL, -1);
+
+    /* the entries list might change while we are processing it: the decrypted
+     * header element takes the place of its <enc:EncryptedData/> element */
+    pos = 0;
+    while(pos < xmlSecPtrListGetSize(&(header->entries))) {
+        cur = (xmlNodePtr)xmlSecPtrListGetItem(&(header->entries), pos);
+        if(cur == NULL) {
+            ++pos;
+            continue;
+        }
+
+        if(xmlSecCheckNodeName(cur, xmlSecNodeEncryptedKey, xmlSecEncNs)) {
+            ret = xmlSecWsSecHeaderProcessEncryptedKey(header, cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecWsSecHeaderProcessEncryptedKey", NULL);
+                return(-1);
+            }
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeReferenceList, xmlSecEncNs)) {
+            ret = xmlSecWsSecHeaderProcessReferenceList(header, cur, NULL);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecWsSecHeaderProcessReferenceList", NULL);
+                return(-1);
+            }
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeEncryptedData, xmlSecEncNs)) {
+            ret = xmlSecWsSecHeaderDecrypt(header, cur, NULL);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecWsSecHeaderDecrypt", NULL);
+                return(-1);
+            }
+            /* process the decrypted element at the same position */
+            continue;
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeSignature, xmlSecDSigNs)) {
+            ret = xmlSecWsSecHeaderVerify(header, cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecWsSecHeaderVerify", NULL);
+                return(-1);
+            }
+        }
+        ++pos;
+    }
+
+    return(0);
+}
+
+static void
+xmlSecWsSecSessionKeyDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlSecBufferDestroy((xmlSecBufferPtr)payload);
+    }
+}
+
+static int
+xmlSecWsSecHeaderIndexNode(xmlSecWsSecHeaderPtr header, xmlNodePtr node, int* isEntry) {
+    xmlChar* id;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(header->tokens != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(isEntry != NULL, -1);
+
+    (*isEntry) = 0;
+    if(xmlSecCheckNodeName(node, xmlSecNodeTimestamp, xmlSecWsuNs)) {
+        header->timestampNode = node;
+    } else if(xmlSecCheckNodeName(node, xmlSecNodeEncryptedKey, xmlSecEncNs) ||
+              xmlSecCheckNodeName(node, xmlSecNodeReferenceList, xmlSecEncNs) ||
+              xmlSecCheckNodeName(node, xmlSecNodeEncryptedData, xmlSecEncNs) ||
+              xmlSecCheckNodeName(node, xmlSecNodeSignature, xmlSecDSigNs)) {
+        (*isEntry) = 1;
+    }
+
+    /* wsu:Id or the element own Id attribute */
+    id = xmlGetNsProp(node, xmlSecAttrId, xmlSecWsuNs);
+    if(id == NULL) {
+        id = xmlGetNoNsProp(node, xmlSecAttrId);
+    }
+    if(id == NULL) {
+        return(0);
+    }
+
+    ret = xmlHashAddEntry(header->tokens, id, node);
+    if(ret != 0) {
+        /* the token substitution is not allowed */
+        xmlSecInvalidStringDataError("id", id, "unique token id", NULL);
+        xmlFree(id);
+        return(-1);
+    }
+    xmlFree(id);
+    return(0);
+}
+
+static int
+xmlSecWsSecHeaderIndexDecrypted(xmlSecWsSecHeaderPtr header, xmlNodePtr first, xmlNodePtr last, xmlSecSize pos) {
+    xmlNodePtr cur;
+    int isEntry;
+    int replaced = 0;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+
+    for(cur = first; (cur != NULL) && (cur != last); cur = cur->next) {
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+        xmlSecAddIDs(cur->doc, cur, header->ids);
+
+        if(cur->parent != header->securityNode) {
+            continue;
+        }
+        ret = xmlSecWsSecHeaderIndexNode(header, cur, &isEntry);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecWsSecHeaderIndexNode", NULL);
+            return(-1);
+        }
+        if(isEntry == 0) {
+            continue;
+        }
+        /* the first one takes the <enc:EncryptedData/> element place */
+        if((replaced == 0) && (pos < xmlSecPtrListGetSize(&(header->entries)))) {
+            ret = xmlSecPtrListSet(&(header->entries), cur, pos);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListSet", NULL);
+                return(-1);
+            }
+        } else {
+            ret = xmlSecPtrListAdd(&(header->entries), cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListAdd", NULL);
+                return(-1);
+            }
+        }
+        replaced = 1;
+    }
+    return(0);
+}
+
+static xmlNodePtr
+xmlSecWsSecHeaderResolveKeyInfo(xmlSecWsSecHeaderPtr header, xmlNodePtr node) {
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr strNode;
+
+    xmlSecAssert2(header != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    keyInfoNode = xmlSecFindChild(node, xmlSecNodeKeyInfo, xmlSecDSigNs);
+    if(keyInfoNode == NULL) {
+        return(NULL);
+    }
+    strNode = xmlSecFindChild(keyInfoNode, xmlSecNodeSecurityTokenReference, xmlSecWsseNs);
+    if(strNode == NULL) {
+        return(NULL);
+    }
+    return(xmlSecWsSecHeaderResolveTokenReference(header, strNode));
+}
+
+static xmlSecBufferPtr
+xmlSecWsSecHeaderGetSessionKey(xmlSecWsSecHeaderPtr header, xmlNodePtr encKeyNode) {
+    xmlSecEncCtx encCtx;
+    xmlSecBufferPtr result;
+    xmlSecBufferPtr value;
+    xmlChar name[64];
+    int ret;
+
+    xmlSecAssert2(header != NULL, NULL);
+    xmlSecAssert2(header->sessionKeys != NULL, NULL);
+    xmlSecAssert2(encKeyNode != NULL, NULL);
+
+    (void)xmlStrPrintf(name, sizeof(name), "%p", (void*)encKeyNode);
+    value = (xmlSecBufferPtr)xmlHashLookup(header->sessionKeys, name);
+    if(value != NULL) {
+        return(value);
+    }
+
+    ret = xmlSecEncCtxInitialize(&encCtx, header->keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxInitialize", NULL);
+        return(NULL);
+    }
+    encCtx.mode = xmlEncCtxModeEncryptedKey;
+    encCtx.keyInfoReadCtx.flags |= header->keyInfoFlags;
+
+    result = xmlSecEncCtxDecryptToBuffer(&encCtx, encKeyNode);
+    if((result == NULL) || (xmlSecBufferGetData(result) == NULL)) {
+        xmlSecInternalError("xmlSecEncCtxDecryptToBuffer", NULL);
+        xmlSecEncCtxFinalize(&encCtx);
+        return(NULL);
+    }
+
+    value = xmlSecBufferCreate(xmlSecBufferGetSize(result));
+    if(value == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        xmlSecEncCtxFinalize(&encCtx);
+        return(NULL);
+    }
+    ret = xmlSecBufferSetData(value, xmlSecBufferGetData(result), xmlSecBufferGetSize(result));
+    xmlSecEncCtxFinalize(&encCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetData", NULL);
+        xmlSecBufferDestroy(value);
+        return(NULL);
+    }
+
+    ret = xmlHashAddEntry(header->sessionKeys, name, value);
+    if(ret != 0) {
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        xmlSecBufferDestroy(value);
+        return(NULL);
+    }
+    return(value);
+}
+
+/* Returns the key from a header token or NULL with no error if the token
+ * type is not supported and the keys manager has to find the key */
+static xmlSecKeyPtr
+xmlSecWsSecHeaderGetTokenKey(xmlSecWsSecHeaderPtr header, xmlNodePtr tokenNode,
+                             xmlNodePtr methodNode, xmlSecTransformUsage usage,
+                             xmlSecTransformOperation operation, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecTransformId transformId;
+    xmlSecTransformPtr transform;
+    xmlSecBufferPtr value;
+    xmlSecKeyPtr key;
+    xmlChar* href;
+    int ret;
+
+    xmlSecAssert2(header != NULL, NULL);
+    xmlSecAssert2(tokenNode != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    if(methodNode == NULL) {
+        return(NULL);
+    }
+    href = xmlGetProp(methodNode, xmlSecAttrAlgorithm);
+    if(href == NULL) {
+        return(NULL);
+    }
+    transformId = xmlSecTransformIdListFindByHref(xmlSecTransformIdsGet(), href, usage);
+    if(transformId == xmlSecTransformIdUnknown) {
+        /* will be reported by the processing context */
+        xmlFree(href);
+        return(NULL);
+    }
+    xmlFree(href);
+
+    /* the key requirements depend on the operation (public or private key) */
+    transform = xmlSecTransformCreate(transformId);
+    if(transform == NULL) {
+        xmlSecInternalError("xmlSecTransformCreate",
+                            xmlSecTransformKlassGetName(transformId));
+        return(NULL);
+    }
+    transform->operation = operation;
+    ret = xmlSecTransformSetKeyReq(transform, &(keyInfoCtx->keyReq));
+    xmlSecTransformDestroy(transform);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformSetKeyReq",
+                            xmlSecTransformKlassGetName(transformId));
+        return(NULL);
+    }
+
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecKeyCreate", NULL);
+        return(NULL);
+    }
+
+    if(xmlSecCheckNodeName(tokenNode, xmlSecNodeEncryptedKey, xmlSecEncNs)) {
+        value = xmlSecWsSecHeaderGetSessionKey(header, tokenNode);
+        if(value == NULL) {
+            xmlSecInternalError("xmlSecWsSecHeaderGetSessionKey", NULL);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+        ret = xmlSecKeyDataBinRead(keyInfoCtx->keyReq.keyId, key,
+                                   xmlSecBufferGetData(value),
+                                   xmlSecBufferGetSize(value),
+                                   keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyDataBinRead",
+                                xmlSecKeyDataKlassGetName(keyInfoCtx->keyReq.keyId));
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+    } else if(xmlSecCheckNodeName(tokenNode, xmlSecNodeBinarySecurityToken, xmlSecWsseNs)) {
+        xmlSecKeyDataId dataId;
+        xmlSecBuffer buffer;
+        xmlChar* valueType;
+
+        valueType = xmlGetProp(tokenNode, xmlSecAttrValueType);
+        if((valueType == NULL) || !xmlStrEqual(valueType, xmlSecWsseValueTypeX509v3)) {
+            if(valueType != NULL) {
+                xmlFree(valueType);
+            }
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+        xmlFree(valueType);
+
+        /* the certificate is verified with the keys manager certificates store */
+        dataId = xmlSecKeyDataIdListFindByHref(xmlSecKeyDataIdsGet(), xmlSecHrefRawX509Cert,
+                                               xmlSecKeyDataUsageRetrievalMethodNodeBin);
+        if(dataId == xmlSecKeyDataIdUnknown) {
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+
+        ret = xmlSecBufferInitialize(&buffer, 0);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferInitialize", NULL);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+        ret = xmlSecBufferBase64NodeContentRead(&buffer, tokenNode);
+        if((ret < 0) || (xmlSecBufferGetData(&buffer) == NULL)) {
+            xmlSecInternalError("xmlSecBufferBase64NodeContentRead", NULL);
+            xmlSecBufferFinalize(&buffer);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+        ret = xmlSecKeyDataBinRead(dataId, key,
+                                   xmlSecBufferGetData(&buffer),
+                                   xmlSecBufferGetSize(&buffer),
+                                   keyInfoCtx);
+        xmlSecBufferFinalize(&buffer);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyDataBinRead",
+                                xmlSecKeyDataKlassGetName(dataId));
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+    } else {
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+
+    return(key);
+}
+
+static int
+xmlSecWsSecHeaderProcessEncryptedKey(xmlSecWsSecHeaderPtr header, xmlNodePtr node) {
+    xmlNodePtr refListNode;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* the key is unwrapped when it is used the first time */
+    refListNode = xmlSecFindChild(node, xmlSecNodeReferenceList, xmlSecEncNs);
+    if(refListNode == NULL) {
+        return(0);
+    }
+    return(xmlSecWsSecHeaderProcessReferenceList(header, refListNode, node));
+}
+
+static int
+xmlSecWsSecHeaderProcessReferenceList(xmlSecWsSecHeaderPtr header, xmlNodePtr node, xmlNodePtr encKeyNode) {
+    xmlNodePtr cur;
+    xmlNodePtr encDataNode;
+    xmlAttrPtr attr;
+    xmlChar* uri;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    for(cur = xmlSecGetNextElementNode(node->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeDataReference, xmlSecEncNs)) {
+            continue;
+        }
+
+        uri = xmlGetProp(cur, xmlSecAttrURI);
+        if((uri == NULL) || (uri[0] != '#')) {
+            xmlSecInvalidNodeAttributeError(cur, xmlSecAttrURI, NULL, "same document reference is expected");
+            if(uri != NULL) {
+                xmlFree(uri);
+            }
+            return(-1);
+        }
+        attr = xmlGetID(node->doc, uri + 1);
+        if((attr == NULL) || (attr->parent == NULL)) {
+            xmlSecInvalidStringDataError("uri", uri, "existing id", NULL);
+            xmlFree(uri);
+            return(-1);
+        }
+        xmlFree(uri);
+
+        encDataNode = attr->parent;
+        if(!xmlSecCheckNodeName(encDataNode, xmlSecNodeEncryptedData, xmlSecEncNs)) {
+            xmlSecInvalidNodeError(encDataNode, xmlSecNodeEncryptedData, NULL);
+            return(-1);
+        }
+
+        ret = xmlSecWsSecHeaderDecrypt(header, encDataNode, encKeyNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecWsSecHeaderDecrypt", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecWsSecHeaderDecrypt(xmlSecWsSecHeaderPtr header, xmlNodePtr node, xmlNodePtr encKeyNode) {
+    xmlSecEncCtx encCtx;
+    xmlNodePtr tokenNode;
+    xmlNodePtr parent;
+    xmlNodePtr prev;
+    xmlNodePtr next;
+    xmlSecSize pos = 0;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* the header element is freed when it is replaced with the decrypted data */
+    size = xmlSecPtrListGetSize(&(header->entries));
+    if(node->parent == header->securityNode) {
+        for(pos = 0; pos < size; ++pos) {
+            if(xmlSecPtrListGetItem(&(header->entries), pos) == node) {
+                xmlSecPtrListSet(&(header->entries), NULL, pos);
+                break;
+            }
+        }
+    }
+
+    ret = xmlSecEncCtxInitialize(&encCtx, header->keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxInitialize", NULL);
+        return(-1);
+    }
+
+    encCtx.keyInfoReadCtx.flags |= header->keyInfoFlags;
+
+    tokenNode = (encKeyNode != NULL) ? encKeyNode : xmlSecWsSecHeaderResolveKeyInfo(header, node);
+    if(tokenNode != NULL) {
+        encCtx.encKey = xmlSecWsSecHeaderGetTokenKey(header, tokenNode,
+                            xmlSecFindChild(node, xmlSecNodeEncryptionMethod, xmlSecEncNs),
+                            xmlSecTransformUsageEncryptionMethod, xmlSecTransformOperationDecrypt,
+                            &(encCtx.keyInfoReadCtx));
+    }
+
+    parent = node->parent;
+    prev = node->prev;
+    next = node->next;
+    ret = xmlSecEncCtxDecrypt(&encCtx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxDecrypt", NULL);
+        xmlSecEncCtxFinalize(&encCtx);
+        return(-1);
+    }
+    xmlSecEncCtxFinalize(&encCtx);
+    ++header->decryptedNumber;
+
+    /* the decrypted nodes are between prev and next */
+    if(parent != NULL) {
+        ret = xmlSecWsSecHeaderIndexDecrypted(header,
+                    (prev != NULL) ? prev->next : parent->children, next, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecWsSecHeaderIndexDecrypted", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecWsSecHeaderVerify(xmlSecWsSecHeaderPtr header, xmlNodePtr node) {
+    xmlSecDSigCtx dsigCtx;
+    xmlNodePtr tokenNode;
+    xmlNodePtr signedInfoNode;
+    int ret;
+
+    xmlSecAssert2(header != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    ret = xmlSecDSigCtxInitialize(&dsigCtx, header->keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxInitialize", NULL);
+        return(-1);
+    }
+    dsigCtx.flags |= XMLSEC_DSIG_FLAGS_IDS_ADDED;
+    dsigCtx.keyInfoReadCtx.flags |= header->keyInfoFlags;
+
+    tokenNode = xmlSecWsSecHeaderResolveKeyInfo(header, node);
+    if(tokenNode != NULL) {
+        signedInfoNode = xmlSecFindChild(node, xmlSecNodeSignedInfo, xmlSecDSigNs);
+        dsigCtx.signKey = xmlSecWsSecHeaderGetTokenKey(header, tokenNode,
+                            (signedInfoNode != NULL) ? xmlSecFindChild(signedInfoNode, xmlSecNodeSignatureMethod, xmlSecDSigNs) : NULL,
+                            xmlSecTransformUsageSignatureMethod, xmlSecTransformOperationVerify,
+                            &(dsigCtx.keyInfoReadCtx));
+    }
+
+    ret = xmlSecDSigCtxVerify(&dsigCtx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxVerify", NULL);
+        xmlSecDSigCtxFinalize(&dsigCtx);
+        return(-1);
+    }
+    ++header->signaturesNumber;
+
+    if(dsigCtx.status != xmlSecDSigStatusSucceeded) {
+        header->status = xmlSecDSigStatusInvalid;
+    } else if(header->status == xmlSecDSigStatusUnknown) {
+        header->status = xmlSecDSigStatusSucceeded;
+    }
+
+    xmlSecDSigCtxFinalize(&dsigCtx);
+    return(0);
+}
+
+#endif /* XMLSEC_NO_SOAP */
@@ -20,6 +20,9 @@
 
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/uri.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/buffer.h>
@@ -27,15 +30,44 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/keysmngr.h>
 #include <xmlsec/transforms.h>
+#include <xmlsec/io.h>
 #include <xmlsec/membuf.h>
+#include <xmlsec/base64.h>
 #include <xmlsec/xmldsig.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/executor.h>
+
+#include <xmlsec/private/c14nstream.h>
+#include <xmlsec/private/doccache.h>
+#include <xmlsec/private/io.h>
+#include <xmlsec/private/keysmngr.h>
+#include <xmlsec/private/transforms.h>
 
 /**************************************************************************
  *
  * xmlSecDSigCtx
  *
  *************************************************************************/
+/* the private data, kept behind xmlSecDSigCtx::reserved1 to preserve the public layout */
+typedef struct _xmlSecDSigCtxPrivate {
+    xmlSecSize                  maxReferences;
+    xmlSecDSigReferenceDigestCallback referenceDigestCallback;
+
+    /* the file processed by xmlSecDSigCtxSignFile() or xmlSecDSigCtxVerifyFile() */
+    const char*                 streamFilename;
+
+    /* the changed nodes passed to xmlSecDSigCtxResign() */
+    xmlNodePtr*                 changedNodes;
+    xmlSecSize                  changedNodesSize;
+
+    /* the references contexts released by xmlSecDSigCtxReset() and kept for reuse */
+    xmlSecPtrList               freeReferences;
+} xmlSecDSigCtxPrivate, *xmlSecDSigCtxPrivatePtr;
+
+#define xmlSecDSigCtxGetPrivate(dsigCtx) \
+    ((xmlSecDSigCtxPrivatePtr)((dsigCtx)->reserved1))
+
 static int      xmlSecDSigCtxProcessSignatureNode       (xmlSecDSigCtxPtr dsigCtx,
                                                          xmlNodePtr node);
 static int      xmlSecDSigCtxProcessSignedInfoNode      (xmlSecDSigCtxPtr dsigCtx,
@@ -50,10 +82,126 @@ static int      xmlSecDSigCtxProcessManifestNode        (xmlSecDSigCtxPtr dsigCt
 
 static int      xmlSecDSigCtxProcessReferences          (xmlSecDSigCtxPtr dsigCtx,
                                                          xmlNodePtr firstReferenceNode);
+static int      xmlSecDSigCtxExecuteSignedInfo          (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode);
+static int      xmlSecDSigCtxVerifySignatureValue       (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode,
+                                                         xmlNodePtr keyInfoNode,
+                                                         int keyResolved);
+static xmlChar*  xmlSecDSigCtxVerifyCacheGetSignature    (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode);
+static xmlChar*  xmlSecDSigCtxSignedInfoCacheKey         (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode);
+static int      xmlSecDSigCtxExecuteCachedSignedInfo    (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode,
+                                                         const xmlChar* cacheKey);
+static int      xmlSecDSigCtxProcessReferencesPrefetched(xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr firstReferenceNode);
+static int      xmlSecDSigCtxVerifyInternal             (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr node,
+                                                         int addIds);
+/**
+ * XMLSEC_DSIG_MAX_REFERENCES_THREADS:
+ *
+ * The max number of threads used to verify references or signatures.
+ */
+#define XMLSEC_DSIG_MAX_REFERENCES_THREADS              16
+
+static int      xmlSecDSigCtxProcessReferencesParallel  (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr firstReferenceNode,
+                                                         xmlSecDSigReferenceOrigin origin);
+static xmlSecSize xmlSecDSigReferencesJobGetThreadsNumber(xmlSecSize size);
+
+/* the max number of released <dsig:Reference/> contexts kept for reuse */
+#define XMLSEC_DSIG_FREE_REFERENCES_MAX                         64
+
+/* the stack buffer for the decoded <dsig:DigestValue/> (the largest digest is 64 bytes) */
+#define XMLSEC_DSIG_DIGEST_STACK_SIZE                           128
+
+static xmlSecDSigReferenceCtxPtr xmlSecDSigCtxCreateReference   (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigReferenceOrigin origin);
+static void     xmlSecDSigCtxReleaseReferences          (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlSecPtrListPtr references);
+static int      xmlSecDSigReferenceCtxSetup             (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlSecDSigReferenceOrigin origin);
+static void     xmlSecDSigReferenceCtxRelease           (xmlSecDSigReferenceCtxPtr dsigRefCtx);
+static int      xmlSecDSigReferenceCtxProcess           (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         int writeDigestValue);
+static int      xmlSecDSigReferenceCtxExecute           (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         int writeDigestValue);
+static int      xmlSecDSigReferenceCtxWriteDigestValue  (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node);
+static int      xmlSecDSigReferenceCtxStreamExecute     (xmlSecDSigReferenceCtxPtr dsigRefCtx);
+static int      xmlSecDSigReferenceCtxDigestExecute     (xmlSecDSigReferenceCtxPtr dsigRefCtx);
+static int      xmlSecDSigReferenceCtxDigestVerify      (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr digestValueNode);
+static xmlChar*  xmlSecDSigReferenceCtxCacheKey          (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr transformsNode,
+                                                         xmlNodePtr* excluded);
+static xmlNodePtr xmlSecDSigReferenceCtxCacheRoot       (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlDocPtr doc);
+static xmlChar*  xmlSecDSigReferenceCtxIOCacheKey        (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr transformsNode,
+                                                         char** ioUri);
+static int      xmlSecDSigReferenceCtxCheckTransforms   (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr* signatureNode);
+static int      xmlSecDSigReferenceCtxIsChanged         (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr digestValueNode);
+static int      xmlSecDSigReferenceCtxDocCacheCheck     (xmlDocPtr doc,
+                                                         const xmlChar* key,
+                                                         xmlNodePtr root,
+                                                         const xmlChar* digestValue);
+
+/* the <dsig:Reference/> digests verified in one batch (shared by the threads) */
+typedef struct _xmlSecDSigDigestsCache {
+    xmlHashTablePtr             items;
+    xmlMutexPtr                 mutex;
+} xmlSecDSigDigestsCache, *xmlSecDSigDigestsCachePtr;
+
+/* the cache is kept in xmlSecDSigCtx::reserved0 to preserve the public layout */
+#define xmlSecDSigCtxGetDigestsCache(dsigCtx) \
+    ((xmlSecDSigDigestsCachePtr)((dsigCtx)->reserved0))
+
+static xmlSecDSigDigestsCachePtr xmlSecDSigDigestsCacheCreate   (void);
+static void     xmlSecDSigDigestsCacheDestroy           (xmlSecDSigDigestsCachePtr cache);
+static int      xmlSecDSigDigestsCacheCheck             (xmlSecDSigDigestsCachePtr cache,
+                                                         const xmlChar* key,
+                                                         const xmlChar* digestValue);
+static int      xmlSecDSigDigestsCacheAdd               (xmlSecDSigDigestsCachePtr cache,
+                                                         const xmlChar* key,
+                                                         xmlChar* digestValue);
+static int      xmlSecDSigReferenceCtxStreamWrite       (void* context,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize);
+static int      xmlSecDSigCtxStreamOutputWrite          (void* context,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize);
+static xmlDocPtr xmlSecDSigExtractFile                  (const char* filename,
+                                                         xmlNodePtr* signNode);
+
+static int      xmlSecDSigCtxBatchKeyInfoIsSelfContained(xmlNodePtr keyInfoNode);
+static xmlBufferPtr xmlSecDSigCtxBatchKeyInfoDump       (xmlNodePtr keyInfoNode);
+
+/* the <dsig:Signature/> template with pre-resolved transforms */
+struct _xmlSecDSigTemplate {
+    xmlSecTransformPlanPtr      plan;
+};
+
+static int      xmlSecDSigTemplateAddReferences         (xmlSecDSigTemplatePtr compiledTmpl,
+                                                         xmlNodePtr cur);
 
 /* The ID attribute in XMLDSig is 'Id' */
 static const xmlChar*           xmlSecDSigIds[] = { xmlSecAttrId, NULL };
 
+/* the ID attributes of the nodes referenced from the <dsig:Signature/> in a file (SAML uses 'ID') */
+static const xmlChar*           xmlSecDSigFileIds[] = { xmlSecAttrId, BAD_CAST "ID", BAD_CAST "id", NULL };
+
 /**
  * xmlSecDSigCtxCreate:
  * @keysMngr:           the pointer to keys manager.
@@ -118,6 +266,13 @@ xmlSecDSigCtxInitialize(xmlSecDSigCtxPtr dsigCtx, xmlSecKeysMngrPtr keysMngr) {
 
     memset(dsigCtx, 0, sizeof(xmlSecDSigCtx));
 
+    dsigCtx->reserved1 = xmlMalloc(sizeof(xmlSecDSigCtxPrivate));
+    if(dsigCtx->reserved1 == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDSigCtxPrivate), NULL);
+        return(-1);
+    }
+    memset(dsigCtx->reserved1, 0, sizeof(xmlSecDSigCtxPrivate));
+
     /* initialize key info */
     ret = xmlSecKeyInfoCtxInitialize(&(dsigCtx->keyInfoReadCtx), keysMngr);
     if(ret < 0) {
@@ -155,6 +310,12 @@ xmlSecDSigCtxInitialize(xmlSecDSigCtxPtr dsigCtx, xmlSecKeysMngrPtr keysMngr) {
         xmlSecInternalError("xmlSecPtrListInitialize", NULL);
         return(ret);
     }
+    ret = xmlSecPtrListInitialize(&(xmlSecDSigCtxGetPrivate(dsigCtx)->freeReferences),
+                                  xmlSecDSigReferenceCtxListId);
+    if(ret != 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize", NULL);
+        return(ret);
+    }
 
     dsigCtx->enabledReferenceUris = xmlSecTransformUriTypeAny;
     return(0);
@@ -182,12 +343,118 @@ xmlSecDSigCtxFinalize(xmlSecDSigCtxPtr dsigCtx) {
     if(dsigCtx->signKey != NULL) {
         xmlSecKeyDestroy(dsigCtx->signKey);
     }
-    if(dsigCtx->id != NULL) {
-        xmlFree(dsigCtx->id);
+    if(dsigCtx->reserved1 != NULL) {
+        xmlSecPtrListFinalize(&(xmlSecDSigCtxGetPrivate(dsigCtx)->freeReferences));
+        xmlFree(dsigCtx->reserved1);
     }
     memset(dsigCtx, 0, sizeof(xmlSecDSigCtx));
 }
 
+/**
+ * xmlSecDSigCtxReset:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ *
+ * Resets @dsigCtx object for the next signature, user settings are not
+ * touched. The transforms and <dsig:Reference/> contexts are kept in
+ * the @dsigCtx and reused by the next #xmlSecDSigCtxSign or
+ * #xmlSecDSigCtxVerify call.
+ */
+void
+xmlSecDSigCtxReset(xmlSecDSigCtxPtr dsigCtx) {
+    xmlSecAssert(dsigCtx != NULL);
+
+    xmlSecTransformCtxReset(&(dsigCtx->transformCtx));
+    xmlSecKeyInfoCtxReset(&(dsigCtx->keyInfoReadCtx));
+    xmlSecKeyInfoCtxReset(&(dsigCtx->keyInfoWriteCtx));
+    xmlSecDSigCtxReleaseReferences(dsigCtx, &(dsigCtx->signedInfoReferences));
+    xmlSecDSigCtxReleaseReferences(dsigCtx, &(dsigCtx->manifestReferences));
+
+    dsigCtx->operation           = xmlSecTransformOperationNone;
+    dsigCtx->result              = NULL;
+    dsigCtx->status              = xmlSecDSigStatusUnknown;
+    dsigCtx->signMethod          = NULL;
+    dsigCtx->c14nMethod          = NULL;
+    dsigCtx->preSignMemBufMethod = NULL;
+    dsigCtx->signValueNode       = NULL;
+
+    dsigCtx->id                  = NULL;
+
+    if(dsigCtx->signKey != NULL) {
+        xmlSecKeyDestroy(dsigCtx->signKey);
+        dsigCtx->signKey = NULL;
+    }
+}
+
+static xmlSecDSigReferenceCtxPtr
+xmlSecDSigCtxCreateReference(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigReferenceOrigin origin) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, NULL);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, NULL);
+
+    /* hostile signatures might have a lot of references */
+    if(xmlSecDSigCtxGetPrivate(dsigCtx)->maxReferences > 0) {
+        size = xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences)) +
+               xmlSecPtrListGetSize(&(dsigCtx->manifestReferences));
+        if(size >= xmlSecDSigCtxGetPrivate(dsigCtx)->maxReferences) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED, NULL,
+                              "maxReferences=%d", (int)xmlSecDSigCtxGetPrivate(dsigCtx)->maxReferences);
+            return(NULL);
+        }
+    }
+
+    size = xmlSecPtrListGetSize(&(xmlSecDSigCtxGetPrivate(dsigCtx)->freeReferences));
+    if(size == 0) {
+        return(xmlSecDSigReferenceCtxCreate(dsigCtx, origin));
+    }
+
+    dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListRemoveAndReturn(&(xmlSecDSigCtxGetPrivate(dsigCtx)->freeReferences), size - 1);
+    if(dsigRefCtx == NULL) {
+        xmlSecInternalError("xmlSecPtrListRemoveAndReturn", NULL);
+        return(NULL);
+    }
+    ret = xmlSecDSigReferenceCtxSetup(dsigRefCtx, dsigCtx, origin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxSetup", NULL);
+        xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+        return(NULL);
+    }
+    return(dsigRefCtx);
+}
+
+static void
+xmlSecDSigCtxReleaseReferences(xmlSecDSigCtxPtr dsigCtx, xmlSecPtrListPtr references) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecPtrListPtr freeReferences;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert(dsigCtx != NULL);
+    xmlSecAssert(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL);
+    xmlSecAssert(references != NULL);
+
+    freeReferences = &(xmlSecDSigCtxGetPrivate(dsigCtx)->freeReferences);
+    while((size = xmlSecPtrListGetSize(references)) > 0) {
+        dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListRemoveAndReturn(references, size - 1);
+        if(dsigRefCtx == NULL) {
+            continue;
+        }
+        if(xmlSecPtrListGetSize(freeReferences) >= XMLSEC_DSIG_FREE_REFERENCES_MAX) {
+            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            continue;
+        }
+
+        xmlSecDSigReferenceCtxRelease(dsigRefCtx);
+        ret = xmlSecPtrListAdd(freeReferences, dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+        }
+    }
+}
+
 /**
  * xmlSecDSigCtxEnableReferenceTransform:
  * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
@@ -257,6 +524,64 @@ xmlSecDSigCtxGetPreSignBuffer(xmlSecDSigCtxPtr dsigCtx) {
             xmlSecTransformMemBufGetBuffer(dsigCtx->preSignMemBufMethod) : NULL);
 }
 
+/* counts the finished signature in the process-wide metrics */
+static void
+xmlSecDSigCtxUpdateMetrics(xmlSecDSigCtxPtr dsigCtx) {
+    xmlSecAssert(dsigCtx != NULL);
+
+    if(dsigCtx->status == xmlSecDSigStatusInvalid) {
+        xmlSecMetricsAdd(xmlSecMetricSignaturesInvalid, 1);
+    } else if(dsigCtx->status != xmlSecDSigStatusSucceeded) {
+        return;
+    } else if(dsigCtx->operation == xmlSecTransformOperationSign) {
+        xmlSecMetricsAdd(xmlSecMetricSignaturesCreated, 1);
+    } else {
+        xmlSecMetricsAdd(xmlSecMetricSignaturesVerified, 1);
+    }
+}
+
+/**
+ * xmlSecDSigCtxSetMaxReferences:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @maxReferences:      the maximum number of <dsig:Reference/> nodes (0 means
+ *                      no limit).
+ *
+ * Sets the maximum number of <dsig:Reference/> nodes in <dsig:SignedInfo/>
+ * and <dsig:Manifest/> nodes. The transforms chains limits set for
+ * #xmlSecDSigCtx::transformCtx with #xmlSecTransformCtxSetLimits are
+ * applied to each reference.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecDSigCtxSetMaxReferences(xmlSecDSigCtxPtr dsigCtx, xmlSecSize maxReferences) {
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+
+    xmlSecDSigCtxGetPrivate(dsigCtx)->maxReferences = maxReferences;
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxSetReferenceDigestCallback:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @callback:           the callback or NULL.
+ *
+ * Sets the callback for the precomputed digests of the <dsig:Reference/>
+ * nodes to the external objects (see #xmlSecDSigReferenceDigestCallback).
+ * The #XMLSEC_DSIG_FLAGS_PREFETCH_REFERENCES flag is ignored if it is set.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecDSigCtxSetReferenceDigestCallback(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigReferenceDigestCallback callback) {
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+
+    xmlSecDSigCtxGetPrivate(dsigCtx)->referenceDigestCallback = callback;
+    return(0);
+}
+
 /**
  * xmlSecDSigCtxSign:
  * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
@@ -278,7 +603,9 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
     /* add ids for Signature nodes */
     dsigCtx->operation  = xmlSecTransformOperationSign;
     dsigCtx->status     = xmlSecDSigStatusUnknown;
-    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecDSigIds);
+    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_IDS_ADDED) == 0) {
+        xmlSecAddIDs(tmpl->doc, tmpl, xmlSecDSigIds);
+    }
 
     /* read signature template */
     ret = xmlSecDSigCtxProcessSignatureNode(dsigCtx, tmpl);
@@ -291,6 +618,7 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
 
     /* references processing might change the status */
     if(dsigCtx->status != xmlSecDSigStatusUnknown) {
+        xmlSecDSigCtxUpdateMetrics(dsigCtx);
         return(0);
     }
 
@@ -305,9 +633,306 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
     xmlNodeSetContentLen(dsigCtx->signValueNode,
                             xmlSecBufferGetData(dsigCtx->result),
                             xmlSecBufferGetSize(dsigCtx->result));
+    xmlSecDocCacheTouch(dsigCtx->signValueNode);
 
     /* set success status and we are done */
     dsigCtx->status = xmlSecDSigStatusSucceeded;
+    xmlSecDSigCtxUpdateMetrics(dsigCtx);
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxSignWithTemplate:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @compiledTmpl:       the compiled signature template.
+ * @tmpl:               the pointer to <dsig:Signature/> node with signature template.
+ *
+ * The same as #xmlSecDSigCtxSign but the transforms algorithms are
+ * taken from @compiledTmpl created from the same template (the
+ * algorithms not found in @compiledTmpl are looked up as usual).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxSignWithTemplate(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigTemplatePtr compiledTmpl, xmlNodePtr tmpl) {
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx)) != NULL, -1);
+    xmlSecAssert2(compiledTmpl != NULL, -1);
+    xmlSecAssert2(compiledTmpl->plan != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+
+    /* the <dsig:Reference/> contexts get the plan in xmlSecDSigReferenceCtxSetup() */
+    xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->plan = compiledTmpl->plan;
+    ret = xmlSecDSigCtxSign(dsigCtx, tmpl);
+    xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->plan = NULL;
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxSign", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxResign:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @node:               the pointer to the signed <dsig:Signature/> node.
+ * @changedNodes:       the nodes changed since the document was signed.
+ * @changedNodesSize:   the number of nodes in @changedNodes.
+ *
+ * Signs the previously signed @node again after the document was edited.
+ * The digests of the <dsig:Reference/> nodes are recomputed only if the
+ * reference might include one of the @changedNodes (the whole document,
+ * the subtree that contains or is contained in a changed node, or a
+ * reference with XPath, XSLT or other location dependent transforms);
+ * the other references keep their <dsig:DigestValue/> (this includes
+ * the references to the external objects). The removed nodes should be
+ * reported with their former parents.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxResign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node, xmlNodePtr* changedNodes,
+                    xmlSecSize changedNodesSize) {
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx)->changedNodes == NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2((changedNodes != NULL) || (changedNodesSize == 0), -1);
+
+    /* the empty list is still a re-signing */
+    xmlSecDSigCtxGetPrivate(dsigCtx)->changedNodes = (changedNodes != NULL) ? changedNodes : &node;
+    xmlSecDSigCtxGetPrivate(dsigCtx)->changedNodesSize = changedNodesSize;
+    ret = xmlSecDSigCtxSign(dsigCtx, node);
+    xmlSecDSigCtxGetPrivate(dsigCtx)->changedNodes = NULL;
+    xmlSecDSigCtxGetPrivate(dsigCtx)->changedNodesSize = 0;
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxSign", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxSignFile:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @filename:           the XML file with the enveloped signature template.
+ * @output:             the output buffer for the signed document.
+ *
+ * Signs the document in the file @filename without loading it in memory.
+ * The first <dsig:Signature/> node in the file is the signature template.
+ * Only the <dsig:Reference/> with empty URI and the enveloped signature
+ * transform followed by exclusive c14n or C14N 2.0 transform is computed
+ * over the stream. For the same document "#id" references, only the
+ * <dsig:Signature/> node and the referenced subtrees are loaded (the 'Id',
+ * 'ID' or 'id' attributes are the IDs). The signed document is written
+ * to @output.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxSignFile(xmlSecDSigCtxPtr dsigCtx, const char* filename, xmlOutputBufferPtr output) {
+    xmlNodePtr signNode = NULL;
+    xmlDocPtr sigDoc;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename == NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    sigDoc = xmlSecDSigExtractFile(filename, &signNode);
+    if(sigDoc == NULL) {
+        xmlSecInternalError2("xmlSecDSigExtractFile", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+
+    xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename = filename;
+    ret = xmlSecDSigCtxSign(dsigCtx, signNode);
+    xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename = NULL;
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxSign", NULL);
+        dsigCtx->signValueNode = NULL;
+        xmlFreeDoc(sigDoc);
+        return(-1);
+    }
+
+    /* copy the document with the signed <dsig:Signature/> node */
+    ret = xmlSecC14NStreamProcess(filename, xmlSecC14NStreamModeCopy, NULL,
+                xmlSecNodeSignature, xmlSecDSigNs, signNode,
+                xmlSecDSigCtxStreamOutputWrite, output);
+    dsigCtx->signValueNode = NULL;
+    xmlFreeDoc(sigDoc);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecC14NStreamProcess", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxVerifyFile:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @filename:           the XML file with the enveloped signature.
+ *
+ * Validates the first <dsig:Signature/> node in the file @filename without
+ * loading the document in memory (see #xmlSecDSigCtxSignFile for the
+ * supported references). The verification result is returned in
+ * #status member of the @dsigCtx object.
+ *
+ * Returns: 0 on success (check #status member of @dsigCtx to get
+ * signature verification result) or a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxVerifyFile(xmlSecDSigCtxPtr dsigCtx, const char* filename) {
+    xmlNodePtr signNode = NULL;
+    xmlDocPtr sigDoc;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename == NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    sigDoc = xmlSecDSigExtractFile(filename, &signNode);
+    if(sigDoc == NULL) {
+        xmlSecInternalError2("xmlSecDSigExtractFile", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+
+    xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename = filename;
+    ret = xmlSecDSigCtxVerify(dsigCtx, signNode);
+    xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename = NULL;
+    dsigCtx->signValueNode = NULL;
+    xmlFreeDoc(sigDoc);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxVerify", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/*
+ * Loads the first <dsig:Signature/> node from @filename. If it has the same
+ * document "#id" references to the nodes outside of it, then loads only the
+ * <dsig:Signature/> node and the referenced subtrees (see
+ * xmlSecC14NStreamExtractNodes()) instead.
+ */
+static xmlDocPtr
+xmlSecDSigExtractFile(const char* filename, xmlNodePtr* signNode) {
+    xmlDocPtr sigDoc;
+    xmlNodePtr cur;
+    xmlChar* uri;
+    xmlChar** ids = NULL;
+    xmlSecSize idsSize = 0;
+    xmlSecSize idsMaxSize = 0;
+    xmlSecSize ii;
+
+    xmlSecAssert2(filename != NULL, NULL);
+    xmlSecAssert2(signNode != NULL, NULL);
+
+    sigDoc = xmlSecC14NStreamExtractNode(filename, xmlSecNodeSignature, xmlSecDSigNs);
+    if(sigDoc == NULL) {
+        xmlSecInternalError2("xmlSecC14NStreamExtractNode", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(NULL);
+    }
+    (*signNode) = xmlDocGetRootElement(sigDoc);
+    xmlSecAddIDs(sigDoc, (*signNode), xmlSecDSigFileIds);
+
+    /* collect the ids of the nodes outside of <dsig:Signature/> */
+    cur = xmlSecFindChild((*signNode), xmlSecNodeSignedInfo, xmlSecDSigNs);
+    for(cur = (cur != NULL) ? xmlSecGetNextElementNode(cur->children) : NULL;
+        cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            continue;
+        }
+        uri = xmlGetProp(cur, xmlSecAttrURI);
+        if((uri == NULL) || (uri[0] != '#') || (xmlStrncmp(uri, BAD_CAST "#xpointer(", 10) == 0) ||
+           (xmlGetID(sigDoc, uri + 1) != NULL)) {
+            if(uri != NULL) {
+                xmlFree(uri);
+            }
+            continue;
+        }
+
+        if(idsSize + 1 >= idsMaxSize) {
+            xmlChar** newIds;
+
+            idsMaxSize = 2 * idsMaxSize + 4;
+            newIds = (xmlChar**)xmlRealloc(ids, idsMaxSize * sizeof(xmlChar*));
+            if(newIds == NULL) {
+                xmlSecMallocError(idsMaxSize * sizeof(xmlChar*), NULL);
+                xmlFree(uri);
+                xmlFreeDoc(sigDoc);
+                sigDoc = NULL;
+                goto done;
+            }
+            ids = newIds;
+        }
+        ids[idsSize] = xmlStrdup(uri + 1);
+        if(ids[idsSize] == NULL) {
+            xmlSecStrdupError(uri, NULL);
+            xmlFree(uri);
+            xmlFreeDoc(sigDoc);
+            sigDoc = NULL;
+            goto done;
+        }
+        ids[++idsSize] = NULL;
+        xmlFree(uri);
+    }
+    if(idsSize == 0) {
+        goto done;
+    }
+
+    /* read the file again for the referenced subtrees */
+    xmlFreeDoc(sigDoc);
+    sigDoc = xmlSecC14NStreamExtractNodes(filename, xmlSecNodeSignature, xmlSecDSigNs,
+                                          xmlSecDSigFileIds, (const xmlChar**)ids);
+    if(sigDoc == NULL) {
+        xmlSecInternalError2("xmlSecC14NStreamExtractNodes", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        goto done;
+    }
+    (*signNode) = xmlSecFindNode(xmlDocGetRootElement(sigDoc), xmlSecNodeSignature, xmlSecDSigNs);
+    if((*signNode) == NULL) {
+        xmlSecNodeNotFoundError("xmlSecFindNode", xmlDocGetRootElement(sigDoc),
+                                xmlSecNodeSignature, NULL);
+        xmlFreeDoc(sigDoc);
+        sigDoc = NULL;
+        goto done;
+    }
+
+done:
+    for(ii = 0; ii < idsSize; ++ii) {
+        xmlFree(ids[ii]);
+    }
+    if(ids != NULL) {
+        xmlFree(ids);
+    }
+    return(sigDoc);
+}
+
+static int
+xmlSecDSigCtxStreamOutputWrite(void* context, const xmlSecByte* data, xmlSecSize dataSize) {
+    xmlOutputBufferPtr output = (xmlOutputBufferPtr)context;
+    int ret;
+
+    xmlSecAssert2(output != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+
+    ret = xmlOutputBufferWrite(output, (int)dataSize, (const char*)data);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferWrite", NULL);
+        return(-1);
+    }
     return(0);
 }
 
@@ -324,6 +949,11 @@ xmlSecDSigCtxSign(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr tmpl) {
  */
 int
 xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    return(xmlSecDSigCtxVerifyInternal(dsigCtx, node, 1));
+}
+
+static int
+xmlSecDSigCtxVerifyInternal(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node, int addIds) {
     int ret;
 
     xmlSecAssert2(dsigCtx != NULL, -1);
@@ -333,7 +963,9 @@ xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
     /* add ids for Signature nodes */
     dsigCtx->operation  = xmlSecTransformOperationVerify;
     dsigCtx->status     = xmlSecDSigStatusUnknown;
-    xmlSecAddIDs(node->doc, node, xmlSecDSigIds);
+    if((addIds != 0) && ((dsigCtx->flags & XMLSEC_DSIG_FLAGS_IDS_ADDED) == 0)) {
+        xmlSecAddIDs(node->doc, node, xmlSecDSigIds);
+    }
 
     /* read signature info */
     ret = xmlSecDSigCtxProcessSignatureNode(dsigCtx, node);
@@ -346,355 +978,819 @@ xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
 
     /* references processing might change the status */
     if(dsigCtx->status != xmlSecDSigStatusUnknown) {
+        xmlSecDSigCtxUpdateMetrics(dsigCtx);
         return(0);
     }
 
-    /* verify SignatureValue node content */
-    ret = xmlSecTransformVerifyNodeContent(dsigCtx->signMethod, dsigCtx->signValueNode,
-                                           &(dsigCtx->transformCtx));
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
-        return(-1);
-    }
-
-    /* set status and we are done */
+    /* set status (SignatureValue node content is verified already) and we are done */
     if(dsigCtx->signMethod->status == xmlSecTransformStatusOk) {
         dsigCtx->status = xmlSecDSigStatusSucceeded;
     } else {
         dsigCtx->status = xmlSecDSigStatusInvalid;
     }
+    xmlSecDSigCtxUpdateMetrics(dsigCtx);
     return(0);
 }
 
 /**
- * xmlSecDSigCtxProcessSignatureNode:
- *
- * The Signature  element (http://www.w3.org/TR/xmldsig-core/#sec-Signature)
+ * xmlSecDSigCtxVerifyManifestReference:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @pos:                the reference position.
  *
- * The Signature element is the root element of an XML Signature.
- * Implementation MUST generate laxly schema valid [XML-schema] Signature
- * elements as specified by the following schema:
- * The way in which the SignedInfo element is presented to the
- * canonicalization method is dependent on that method. The following
- * applies to algorithms which process XML as nodes or characters:
+ * Digests and checks the @pos-th (counting from 0) <dsig:Reference/>
+ * element in the <dsig:Manifest/> elements of the <dsig:Object/> children
+ * of the signature that was verified with #xmlSecDSigCtxVerify. The core
+ * signature must be valid. Unlike #XMLSEC_DSIG_FLAGS_PROCESS_MANIFESTS
+ * (which processes all of them during the verification), this lets the
+ * application check only the manifest references it actually needs.
  *
- *  - XML based canonicalization implementations MUST be provided with
- *  a [XPath] node-set originally formed from the document containing
- *  the SignedInfo and currently indicating the SignedInfo, its descendants,
- *  and the attribute and namespace nodes of SignedInfo and its descendant
- *  elements.
+ * The returned reference context is added to the #manifestReferences
+ * list of @dsigCtx; check its #status member to get the result.
  *
- *  - Text based canonicalization algorithms (such as CRLF and charset
- *  normalization) should be provided with the UTF-8 octets that represent
- *  the well-formed SignedInfo element, from the first character to the
- *  last character of the XML representation, inclusive. This includes
- *  the entire text of the start and end tags of the SignedInfo element
- *  as well as all descendant markup and character data (i.e., the text)
- *  between those tags. Use of text based canonicalization of SignedInfo
- *  is NOT RECOMMENDED.
- *
- *  =================================
- *  we do not support any non XML based C14N
- *
- * Schema Definition:
+ * Returns: the reference context or NULL if an error occurs or there is
+ * no such reference.
+ */
+xmlSecDSigReferenceCtxPtr
+xmlSecDSigCtxVerifyManifestReference(xmlSecDSigCtxPtr dsigCtx, xmlSecSize pos) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlNodePtr objectNode, manifestNode, cur;
+    xmlSecSize ii = 0;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, NULL);
+    xmlSecAssert2(dsigCtx->operation == xmlSecTransformOperationVerify, NULL);
+    xmlSecAssert2(dsigCtx->signValueNode != NULL, NULL);
+    xmlSecAssert2(dsigCtx->signValueNode->parent != NULL, NULL);
+
+    if(dsigCtx->status != xmlSecDSigStatusSucceeded) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_STATUS, NULL,
+                          "status=%d", (int)dsigCtx->status);
+        return(NULL);
+    }
+
+    /* the Object nodes follow the SignatureValue node */
+    for(objectNode = xmlSecGetNextElementNode(dsigCtx->signValueNode->next);
+        objectNode != NULL;
+        objectNode = xmlSecGetNextElementNode(objectNode->next)) {
+
+        if(!xmlSecCheckNodeName(objectNode, xmlSecNodeObject, xmlSecDSigNs)) {
+            continue;
+        }
+        for(manifestNode = xmlSecGetNextElementNode(objectNode->children);
+            manifestNode != NULL;
+            manifestNode = xmlSecGetNextElementNode(manifestNode->next)) {
+
+            if(!xmlSecCheckNodeName(manifestNode, xmlSecNodeManifest, xmlSecDSigNs)) {
+                continue;
+            }
+            for(cur = xmlSecGetNextElementNode(manifestNode->children);
+                (cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs));
+                cur = xmlSecGetNextElementNode(cur->next)) {
+
+                if(ii++ != pos) {
+                    continue;
+                }
+
+                dsigRefCtx = xmlSecDSigCtxCreateReference(dsigCtx, xmlSecDSigReferenceOriginManifest);
+                if(dsigRefCtx == NULL) {
+                    xmlSecInternalError("xmlSecDSigCtxCreateReference", NULL);
+                    return(NULL);
+                }
+
+                ret = xmlSecPtrListAdd(&(dsigCtx->manifestReferences), dsigRefCtx);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecPtrListAdd", NULL);
+                    xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+                    return(NULL);
+                }
+
+                ret = xmlSecDSigReferenceCtxProcessNode(dsigRefCtx, cur);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
+                                        xmlSecNodeGetName(cur));
+                    return(NULL);
+                }
+                return(dsigRefCtx);
+            }
+        }
+    }
+
+    xmlSecOtherError3(XMLSEC_ERRORS_R_NODE_NOT_FOUND, NULL,
+                      "Manifest reference pos=%lu; size=%lu",
+                      (unsigned long)pos, (unsigned long)ii);
+    return(NULL);
+}
+
+/* max number of different <dsig:KeyInfo/> nodes remembered by xmlSecDSigCtxVerifyBatch() */
+#define XMLSEC_DSIG_BATCH_KEYS_MAX              16
+
+typedef struct _xmlSecDSigBatchKey {
+    xmlBufferPtr        keyInfo;
+    xmlSecKeyPtr        key;
+} xmlSecDSigBatchKey;
+
+static int      xmlSecDSigCtxBatchSetKey                (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlSecDSigBatchKey* keys,
+                                                         xmlSecSize keysSize,
+                                                         xmlSecKeyPtr fixedKey,
+                                                         xmlNodePtr node,
+                                                         xmlBufferPtr* keyInfo);
+static int      xmlSecDSigCtxBatchAddKey                (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlSecDSigBatchKey* keys,
+                                                         xmlSecSize* keysSize,
+                                                         xmlBufferPtr keyInfo);
+
+/**
+ * xmlSecDSigCtxVerifyBatch:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @nodes:              the array of <dsig:Signature/> nodes.
+ * @nodesSize:          the number of nodes in @nodes.
+ * @statuses:           the array of @nodesSize elements for the verification results.
  *
- *  <element name="Signature" type="ds:SignatureType"/>
- *  <complexType name="SignatureType">
- *  <sequence>
- *     <element ref="ds:SignedInfo"/>
- *     <element ref="ds:SignatureValue"/>
- *     <element ref="ds:KeyInfo" minOccurs="0"/>
- *     <element ref="ds:Object" minOccurs="0" maxOccurs="unbounded"/>
- *     </sequence> <attribute name="Id" type="ID" use="optional"/>
- *  </complexType>
+ * Validates signatures in the @nodes one after another with the same
+ * @dsigCtx (see #xmlSecDSigCtxReset). The keys are resolved once per
+ * distinct self-contained <dsig:KeyInfo/> node (i.e. with only
+ * <dsig:KeyName/>, <dsig:KeyValue/> and <dsig:X509Data/> children):
+ * the following signatures with the same <dsig:KeyInfo/> content skip
+ * the keys manager lookup and the certificates verification. If the
+ * key is set in @dsigCtx before the call then it is used for all
+ * signatures.
  *
- * DTD:
+ * The <dsig:Reference/> elements with the same bare name (or empty) URI,
+ * c14n transforms and digest method (e.g. counter-signatures or several
+ * parties signing the same element) are digested once: a reference with
+ * the same <dsig:DigestValue/> as an already verified one is valid.
+ * The documents must not be modified while the function runs.
  *
- *  <!ELEMENT Signature (SignedInfo, SignatureValue, KeyInfo?, Object*)  >
- *  <!ATTLIST Signature
- *      xmlns   CDATA   #FIXED 'http://www.w3.org/2000/09/xmldsig#'
- *      Id      ID  #IMPLIED >
+ * The verification result of the signature in nodes[i] is returned in
+ * statuses[i]; it is #xmlSecDSigStatusUnknown if processing of this
+ * signature failed. When the function returns, @dsigCtx has the results
+ * of the last signature.
  *
+ * Returns: 0 on success (check @statuses to get the signatures verification
+ * results) or a negative value if an error occurs.
  */
-static int
-xmlSecDSigCtxProcessSignatureNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
-    xmlSecTransformDataType firstType;
-    xmlNodePtr signedInfoNode = NULL;
-    xmlNodePtr keyInfoNode = NULL;
-    xmlNodePtr firstReferenceNode = NULL;
-    xmlNodePtr cur;
+int
+xmlSecDSigCtxVerifyBatch(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr* nodes, xmlSecSize nodesSize,
+                         xmlSecDSigStatus* statuses) {
+    xmlSecDSigBatchKey keys[XMLSEC_DSIG_BATCH_KEYS_MAX];
+    xmlSecSize keysSize = 0;
+    xmlSecKeyPtr fixedKey;
+    xmlBufferPtr keyInfo;
+    xmlSecSize ii, jj;
+    int res = -1;
     int ret;
 
     xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
-    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
-    xmlSecAssert2(dsigCtx->signValueNode == NULL, -1);
-    xmlSecAssert2(dsigCtx->signMethod == NULL, -1);
-    xmlSecAssert2(dsigCtx->c14nMethod == NULL, -1);
-    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(statuses != NULL, -1);
 
-    if(!xmlSecCheckNodeName(node, xmlSecNodeSignature, xmlSecDSigNs)) {
-        xmlSecInvalidNodeError(node, xmlSecNodeSignature, NULL);
+    memset(keys, 0, sizeof(keys));
+
+    /* the same references in different signatures are digested once */
+    xmlSecAssert2(dsigCtx->reserved0 == NULL, -1);
+    dsigCtx->reserved0 = xmlSecDSigDigestsCacheCreate();
+    if(dsigCtx->reserved0 == NULL) {
+        xmlSecInternalError("xmlSecDSigDigestsCacheCreate", NULL);
         return(-1);
     }
 
-    /* read node data */
-    xmlSecAssert2(dsigCtx->id == NULL, -1);
-    dsigCtx->id = xmlGetProp(node, xmlSecAttrId);
+    /* the key set by the caller is used for all signatures */
+    fixedKey = dsigCtx->signKey;
+    dsigCtx->signKey = NULL;
 
-    /* first node is required SignedInfo */
-    cur = xmlSecGetNextElementNode(node->children);
-    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeSignedInfo, xmlSecDSigNs))) {
-        xmlSecInvalidNodeError(cur, xmlSecNodeSignedInfo, NULL);
-        return(-1);
-    }
-    signedInfoNode = cur;
-    cur = xmlSecGetNextElementNode(cur->next);
+    for(ii = 0; ii < nodesSize; ++ii) {
+        xmlSecAssert2(nodes[ii] != NULL, -1);
 
-    /* next node is required SignatureValue */
-    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeSignatureValue, xmlSecDSigNs))) {
-        xmlSecInvalidNodeError(cur, xmlSecNodeSignatureValue, NULL);
-        return(-1);
+        statuses[ii] = xmlSecDSigStatusUnknown;
+        xmlSecDSigCtxReset(dsigCtx);
+
+        ret = xmlSecDSigCtxBatchSetKey(dsigCtx, keys, keysSize, fixedKey, nodes[ii], &keyInfo);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigCtxBatchSetKey", NULL);
+            goto done;
+        }
+
+        ret = xmlSecDSigCtxVerify(dsigCtx, nodes[ii]);
+        if(ret < 0) {
+            /* the error is already reported, move on to the next signature */
+            if(keyInfo != NULL) {
+                xmlBufferFree(keyInfo);
+            }
+            continue;
+        }
+        statuses[ii] = dsigCtx->status;
+
+        /* remember the key found for the new <dsig:KeyInfo/> */
+        if(keyInfo != NULL) {
+            ret = xmlSecDSigCtxBatchAddKey(dsigCtx, keys, &keysSize, keyInfo);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDSigCtxBatchAddKey", NULL);
+                goto done;
+            }
+        }
     }
-    dsigCtx->signValueNode = cur;
-    cur = xmlSecGetNextElementNode(cur->next);
 
-    /* next node is optional KeyInfo */
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
-        keyInfoNode = cur;
-        cur = xmlSecGetNextElementNode(cur->next);
-    } else {
-        keyInfoNode = NULL;
+    /* success */
+    res = 0;
+
+done:
+    for(jj = 0; jj < keysSize; ++jj) {
+        xmlBufferFree(keys[jj].keyInfo);
+        xmlSecKeyDestroy(keys[jj].key);
     }
+    xmlSecDSigDigestsCacheDestroy(xmlSecDSigCtxGetDigestsCache(dsigCtx));
+    dsigCtx->reserved0 = NULL;
+    if(fixedKey != NULL) {
+        if(dsigCtx->signKey == NULL) {
+            dsigCtx->signKey = fixedKey;
+        } else {
+            xmlSecKeyDestroy(fixedKey);
+        }
+    }
+    return(res);
+}
 
-    /* next nodes are optional Object nodes */
-    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeObject, xmlSecDSigNs))) {
-        /* read manifests from objects */
-        if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_IGNORE_MANIFESTS) == 0) {
-            ret = xmlSecDSigCtxProcessObjectNode(dsigCtx, cur);
+/**
+ * xmlSecDSigCtxSignBatch:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @compiledTmpl:       the compiled signature template (might be NULL).
+ * @tmpls:              the array of <dsig:Signature/> template nodes.
+ * @tmplsSize:          the number of nodes in @tmpls.
+ * @statuses:           the array of @tmplsSize elements for the signing results.
+ *
+ * Signs the templates in @tmpls (e.g. in many documents created from the same
+ * template) one after another with the same @dsigCtx (see #xmlSecDSigCtxReset).
+ * The signing keys are resolved once per distinct self-contained <dsig:KeyInfo/>
+ * template, the same way as in #xmlSecDSigCtxVerifyBatch: the following
+ * templates skip the keys manager lookup. If the key is set in @dsigCtx before
+ * the call then it is used for all signatures. If @compiledTmpl is not NULL
+ * then the transforms algorithms are taken from it (see
+ * #xmlSecDSigCtxSignWithTemplate).
+ *
+ * The result for the template in tmpls[i] is returned in statuses[i]: it is
+ * #xmlSecDSigStatusSucceeded if the template is signed or
+ * #xmlSecDSigStatusUnknown if processing of this template failed. When the
+ * function returns, @dsigCtx has the results of the last signature.
+ *
+ * Returns: 0 on success (check @statuses to get the signing results) or
+ * a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxSignBatch(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigTemplatePtr compiledTmpl,
+                       xmlNodePtr* tmpls, xmlSecSize tmplsSize, xmlSecDSigStatus* statuses) {
+    xmlSecDSigBatchKey keys[XMLSEC_DSIG_BATCH_KEYS_MAX];
+    xmlSecSize keysSize = 0;
+    xmlSecKeyPtr fixedKey;
+    xmlBufferPtr keyInfo;
+    xmlSecSize ii, jj;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(tmpls != NULL, -1);
+    xmlSecAssert2(statuses != NULL, -1);
+
+    memset(keys, 0, sizeof(keys));
+
+    /* the key set by the caller is used for all signatures */
+    fixedKey = dsigCtx->signKey;
+    dsigCtx->signKey = NULL;
+
+    for(ii = 0; ii < tmplsSize; ++ii) {
+        xmlSecAssert2(tmpls[ii] != NULL, -1);
+
+        statuses[ii] = xmlSecDSigStatusUnknown;
+        xmlSecDSigCtxReset(dsigCtx);
+
+        /* the <dsig:KeyInfo/> template is dumped before it is filled in */
+        ret = xmlSecDSigCtxBatchSetKey(dsigCtx, keys, keysSize, fixedKey, tmpls[ii], &keyInfo);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigCtxBatchSetKey", NULL);
+            goto done;
+        }
+
+        if(compiledTmpl != NULL) {
+            ret = xmlSecDSigCtxSignWithTemplate(dsigCtx, compiledTmpl, tmpls[ii]);
+        } else {
+            ret = xmlSecDSigCtxSign(dsigCtx, tmpls[ii]);
+        }
+        if(ret < 0) {
+            /* the error is already reported, move on to the next template */
+            if(keyInfo != NULL) {
+                xmlBufferFree(keyInfo);
+            }
+            continue;
+        }
+        statuses[ii] = dsigCtx->status;
+
+        /* remember the key found for the new <dsig:KeyInfo/> */
+        if(keyInfo != NULL) {
+            ret = xmlSecDSigCtxBatchAddKey(dsigCtx, keys, &keysSize, keyInfo);
             if(ret < 0) {
-                xmlSecInternalError("xmlSecDSigCtxProcessObjectNode", NULL);
-                return(-1);
+                xmlSecInternalError("xmlSecDSigCtxBatchAddKey", NULL);
+                goto done;
             }
         }
-        cur = xmlSecGetNextElementNode(cur->next);
     }
 
-    /* if there is something left than it's an error */
-    if(cur != NULL) {
-        xmlSecUnexpectedNodeError(cur,  NULL);
-        return(-1);
-    }
+    /* success */
+    res = 0;
 
-    /* now validated all the references and prepare transform */
-    ret = xmlSecDSigCtxProcessSignedInfoNode(dsigCtx, signedInfoNode, &firstReferenceNode);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecDSigCtxProcessSignedInfoNode", NULL);
-        return(-1);
+done:
+    for(jj = 0; jj < keysSize; ++jj) {
+        xmlBufferFree(keys[jj].keyInfo);
+        xmlSecKeyDestroy(keys[jj].key);
+    }
+    if(fixedKey != NULL) {
+        if(dsigCtx->signKey == NULL) {
+            dsigCtx->signKey = fixedKey;
+        } else {
+            xmlSecKeyDestroy(fixedKey);
+        }
     }
+    return(res);
+}
 
-    /* as the result, we should have sign and c14n methods set */
-    xmlSecAssert2(dsigCtx->signMethod != NULL, -1);
-    xmlSecAssert2(dsigCtx->c14nMethod != NULL, -1);
+/*
+ * Sets dsigCtx->signKey to the @fixedKey copy or to the copy of the key already
+ * found for the same <dsig:KeyInfo/> as in the @node. Otherwise, if the @node
+ * <dsig:KeyInfo/> is self-contained, returns its dump in @keyInfo for
+ * #xmlSecDSigCtxBatchAddKey.
+ */
+static int
+xmlSecDSigCtxBatchSetKey(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigBatchKey* keys, xmlSecSize keysSize,
+                         xmlSecKeyPtr fixedKey, xmlNodePtr node, xmlBufferPtr* keyInfo) {
+    xmlNodePtr keyInfoNode;
+    xmlSecSize ii;
 
-    /* now read key info node */
-    ret = xmlSecDSigCtxProcessKeyInfoNode(dsigCtx, keyInfoNode);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecDSigCtxProcessKeyInfoNode", NULL);
-        return(-1);
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->signKey == NULL, -1);
+    xmlSecAssert2(keys != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(keyInfo != NULL, -1);
+
+    (*keyInfo) = NULL;
+    if(fixedKey != NULL) {
+        dsigCtx->signKey = xmlSecKeyDuplicate(fixedKey);
+        if(dsigCtx->signKey == NULL) {
+            xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+            return(-1);
+        }
+        return(0);
     }
-    /* as the result, we should have a key */
-    xmlSecAssert2(dsigCtx->signKey != NULL, -1);
 
-    /* now actually process references and calculate digests */
-    ret = xmlSecDSigCtxProcessReferences(dsigCtx, firstReferenceNode);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecDSigCtxProcessReferences", NULL);
-        return(-1);
+    keyInfoNode = xmlSecFindChild(node, xmlSecNodeKeyInfo, xmlSecDSigNs);
+    if((keyInfoNode == NULL) || (xmlSecDSigCtxBatchKeyInfoIsSelfContained(keyInfoNode) != 1)) {
+        return(0);
     }
-    /* references processing might change the status */
-    if(dsigCtx->status != xmlSecDSigStatusUnknown) {
+    (*keyInfo) = xmlSecDSigCtxBatchKeyInfoDump(keyInfoNode);
+    if((*keyInfo) == NULL) {
         return(0);
     }
+    for(ii = 0; ii < keysSize; ++ii) {
+        if(xmlStrEqual(xmlBufferContent(keys[ii].keyInfo), xmlBufferContent(*keyInfo))) {
+            xmlBufferFree(*keyInfo);
+            (*keyInfo) = NULL;
+
+            dsigCtx->signKey = xmlSecKeyDuplicate(keys[ii].key);
+            if(dsigCtx->signKey == NULL) {
+                xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+                return(-1);
+            }
+            break;
+        }
+    }
+    return(0);
+}
 
-    /* if we need to write result to xml node then we need base64 encode result */
-    if(dsigCtx->operation == xmlSecTransformOperationSign) {
-        xmlSecTransformPtr base64Encode;
+/* remembers the dsigCtx->signKey for the @keyInfo (always taken over) */
+static int
+xmlSecDSigCtxBatchAddKey(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigBatchKey* keys, xmlSecSize* keysSize,
+                         xmlBufferPtr keyInfo) {
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(keys != NULL, -1);
+    xmlSecAssert2(keysSize != NULL, -1);
+    xmlSecAssert2(keyInfo != NULL, -1);
 
-        /* we need to add base64 encode transform */
-        base64Encode = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
-                                                         xmlSecTransformBase64Id);
-        if(base64Encode == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend", NULL);
-            return(-1);
-        }
-        base64Encode->operation = xmlSecTransformOperationEncode;
+    if((dsigCtx->signKey == NULL) || ((*keysSize) >= XMLSEC_DSIG_BATCH_KEYS_MAX)) {
+        xmlBufferFree(keyInfo);
+        return(0);
+    }
+    keys[(*keysSize)].key = xmlSecKeyDuplicate(dsigCtx->signKey);
+    if(keys[(*keysSize)].key == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        xmlBufferFree(keyInfo);
+        return(-1);
     }
+    keys[(*keysSize)].keyInfo = keyInfo;
+    ++(*keysSize);
+    return(0);
+}
 
-    firstType = xmlSecTransformGetDataType(dsigCtx->transformCtx.first,
-                                           xmlSecTransformModePush,
-                                           &(dsigCtx->transformCtx));
-    if((firstType & xmlSecTransformDataTypeXml) != 0) {
-        xmlSecNodeSetPtr nodeset = NULL;
+typedef struct _xmlSecDSigSignaturesJob {
+    xmlNodePtr*                 nodes;
+    xmlSecDSigStatus*           statuses;
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlMutexPtr                 mutex;
+} xmlSecDSigSignaturesJob, *xmlSecDSigSignaturesJobPtr;
+
+typedef struct _xmlSecDSigSignaturesWorker {
+    xmlSecDSigSignaturesJobPtr  job;
+    xmlSecDSigCtx               dsigCtx;
+    xmlSecKeyPtr                fixedKey;
+    int                         initialized;
+} xmlSecDSigSignaturesWorker, *xmlSecDSigSignaturesWorkerPtr;
+
+static void
+xmlSecDSigSignaturesWorkerRun(xmlSecDSigSignaturesWorkerPtr worker) {
+    xmlSecDSigSignaturesJobPtr job;
+    xmlSecSize pos;
+    int ret;
 
-        xmlSecAssert2(signedInfoNode != NULL, -1);
-        nodeset = xmlSecNodeSetGetChildren(signedInfoNode->doc, signedInfoNode, 1, 0);
-        if(nodeset == NULL) {
-            xmlSecInternalError("xmlSecNodeSetGetChildren(signedInfoNode)", NULL);
-            return(-1);
+    xmlSecAssert(worker != NULL);
+    xmlSecAssert(worker->job != NULL);
+    xmlSecAssert(worker->job->mutex != NULL);
+
+    job = worker->job;
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = job->next;
+        if(pos < job->size) {
+            ++job->next;
         }
+        xmlMutexUnlock(job->mutex);
 
-        /* calculate the signature */
-        ret = xmlSecTransformCtxXmlExecute(&(dsigCtx->transformCtx), nodeset);
+        if(pos >= job->size) {
+            break;
+        }
+
+        xmlSecDSigCtxReset(&(worker->dsigCtx));
+        if(worker->fixedKey != NULL) {
+            worker->dsigCtx.signKey = xmlSecKeyDuplicate(worker->fixedKey);
+            if(worker->dsigCtx.signKey == NULL) {
+                xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+                continue;
+            }
+        }
+
+        /* the ids are already added and the documents are not modified */
+        ret = xmlSecDSigCtxVerifyInternal(&(worker->dsigCtx), job->nodes[pos], 0);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformCtxXmlExecute", NULL);
-            xmlSecNodeSetDestroy(nodeset);
-            return(-1);
+            /* the error is already reported, move on to the next signature */
+            continue;
         }
-        xmlSecNodeSetDestroy(nodeset);
-    } else {
-        /* TODO */
-        xmlSecNotImplementedError("binary c14n transforms");
+        job->statuses[pos] = worker->dsigCtx.status;
+    }
+}
+
+static void
+xmlSecDSigSignaturesWorkerTask(void* data) {
+    xmlSecDSigSignaturesWorkerRun((xmlSecDSigSignaturesWorkerPtr)data);
+}
+
+static int
+xmlSecDSigSignaturesWorkerInitialize(xmlSecDSigSignaturesWorkerPtr worker,
+                                     xmlSecDSigSignaturesJobPtr job,
+                                     xmlSecDSigCtxPtr dsigCtx) {
+    int ret;
+
+    xmlSecAssert2(worker != NULL, -1);
+    xmlSecAssert2(job != NULL, -1);
+    xmlSecAssert2(dsigCtx != NULL, -1);
+
+    memset(worker, 0, sizeof(xmlSecDSigSignaturesWorker));
+    worker->job = job;
+
+    ret = xmlSecDSigCtxInitialize(&(worker->dsigCtx), dsigCtx->keyInfoReadCtx.keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxInitialize", NULL);
+        return(-1);
+    }
+    worker->initialized = 1;
+
+    /* copy user preferences, the references are processed by the worker itself */
+    worker->dsigCtx.userData                    = dsigCtx->userData;
+    worker->dsigCtx.flags                       = dsigCtx->flags & (~XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES);
+    worker->dsigCtx.flags2                      = dsigCtx->flags2;
+    worker->dsigCtx.enabledReferenceUris        = dsigCtx->enabledReferenceUris;
+    worker->dsigCtx.referencePreExecuteCallback = dsigCtx->referencePreExecuteCallback;
+    worker->dsigCtx.defSignMethodId             = dsigCtx->defSignMethodId;
+    worker->dsigCtx.defC14NMethodId             = dsigCtx->defC14NMethodId;
+    worker->dsigCtx.defDigestMethodId           = dsigCtx->defDigestMethodId;
+    xmlSecDSigCtxGetPrivate(&(worker->dsigCtx))->maxReferences = xmlSecDSigCtxGetPrivate(dsigCtx)->maxReferences;
+    xmlSecDSigCtxGetPrivate(&(worker->dsigCtx))->referenceDigestCallback = xmlSecDSigCtxGetPrivate(dsigCtx)->referenceDigestCallback;
+    worker->dsigCtx.reserved0                   = dsigCtx->reserved0;
+
+    ret = xmlSecKeyInfoCtxCopyUserPref(&(worker->dsigCtx.keyInfoReadCtx), &(dsigCtx->keyInfoReadCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxCopyUserPref", NULL);
         return(-1);
     }
+    ret = xmlSecKeyInfoCtxCopyUserPref(&(worker->dsigCtx.keyInfoWriteCtx), &(dsigCtx->keyInfoWriteCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxCopyUserPref", NULL);
+        return(-1);
+    }
+    ret = xmlSecTransformCtxCopyUserPref(&(worker->dsigCtx.transformCtx), &(dsigCtx->transformCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxCopyUserPref", NULL);
+        return(-1);
+    }
+    if(dsigCtx->enabledReferenceTransforms != NULL) {
+        worker->dsigCtx.enabledReferenceTransforms = xmlSecPtrListDuplicate(dsigCtx->enabledReferenceTransforms);
+        if(worker->dsigCtx.enabledReferenceTransforms == NULL) {
+            xmlSecInternalError("xmlSecPtrListDuplicate", NULL);
+            return(-1);
+        }
+    }
+    if(dsigCtx->signKey != NULL) {
+        worker->fixedKey = xmlSecKeyDuplicate(dsigCtx->signKey);
+        if(worker->fixedKey == NULL) {
+            xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+            return(-1);
+        }
+    }
     return(0);
 }
 
-/**
- * xmlSecDSigCtxProcessSignedInfoNode:
+static void
+xmlSecDSigSignaturesWorkerFinalize(xmlSecDSigSignaturesWorkerPtr worker) {
+    xmlSecAssert(worker != NULL);
+
+    if(worker->initialized != 0) {
+        /* the cache is owned by the caller's context */
+        worker->dsigCtx.reserved0 = NULL;
+        xmlSecDSigCtxFinalize(&(worker->dsigCtx));
+    }
+    if(worker->fixedKey != NULL) {
+        xmlSecKeyDestroy(worker->fixedKey);
+    }
+    memset(worker, 0, sizeof(xmlSecDSigSignaturesWorker));
+}
+
+/**
+ * xmlSecDSigCtxVerifyParallel:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @nodes:              the array of <dsig:Signature/> nodes.
+ * @nodesSize:          the number of nodes in @nodes.
+ * @statuses:           the array of @nodesSize elements for the verification results.
  *
- * The SignedInfo Element (http://www.w3.org/TR/xmldsig-core/#sec-SignedInfo)
+ * Validates signatures in the @nodes (e.g. several signers of the same
+ * document) on the worker threads. The <dsig:Signature/> ids are added
+ * to the documents once before the verification starts and the
+ * <dsig:Reference/> digests are shared between the signatures exactly as
+ * in #xmlSecDSigCtxVerifyBatch. Each thread uses its own copy of @dsigCtx
+ * settings (including the key if it is set in @dsigCtx) with the same keys
+ * manager: the keys manager and the keys stores must support concurrent
+ * lookups. The documents must not be modified while the function runs.
  *
- * The structure of SignedInfo includes the canonicalization algorithm,
- * a result algorithm, and one or more references. The SignedInfo element
- * may contain an optional ID attribute that will allow it to be referenced by
- * other signatures and objects.
+ * The verification result of the signature in nodes[i] is returned in
+ * statuses[i]; it is #xmlSecDSigStatusUnknown if processing of this
+ * signature failed. The results of the individual signatures are not
+ * kept in @dsigCtx. The workers are run by the executor set with
+ * #xmlSecExecutorSetCallback.
  *
- * SignedInfo does not include explicit result or digest properties (such as
- * calculation time, cryptographic device serial number, etc.). If an
- * application needs to associate properties with the result or digest,
- * it may include such information in a SignatureProperties element within
- * an Object element.
+ * Returns: 0 on success (check @statuses to get the signatures verification
+ * results) or a negative value if an error occurs.
+ */
+int
+xmlSecDSigCtxVerifyParallel(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr* nodes, xmlSecSize nodesSize,
+                            xmlSecDSigStatus* statuses) {
+    xmlSecDSigSignaturesJob job;
+    xmlSecDSigSignaturesWorker workers[XMLSEC_DSIG_MAX_REFERENCES_THREADS];
+    void* tasks[XMLSEC_DSIG_MAX_REFERENCES_THREADS];
+    xmlSecSize threadsNum, ii;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(statuses != NULL, -1);
+    xmlSecAssert2(dsigCtx->reserved0 == NULL, -1);
+
+    memset(&job, 0, sizeof(job));
+    memset(workers, 0, sizeof(workers));
+
+    /* the ids are added once (and not by the threads) */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        xmlSecAssert2(nodes[ii] != NULL, -1);
+        xmlSecAssert2(nodes[ii]->doc != NULL, -1);
+
+        statuses[ii] = xmlSecDSigStatusUnknown;
+        if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_IDS_ADDED) == 0) {
+            xmlSecAddIDs(nodes[ii]->doc, nodes[ii], xmlSecDSigIds);
+        }
+    }
+    threadsNum = xmlSecDSigReferencesJobGetThreadsNumber(nodesSize);
+    if(threadsNum == 0) {
+        return(0);
+    }
+
+    /* the same references in different signatures are digested once */
+    dsigCtx->reserved0 = xmlSecDSigDigestsCacheCreate();
+    if(dsigCtx->reserved0 == NULL) {
+        xmlSecInternalError("xmlSecDSigDigestsCacheCreate", NULL);
+        return(-1);
+    }
+
+    job.nodes = nodes;
+    job.statuses = statuses;
+    job.size = nodesSize;
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        goto done;
+    }
+    for(ii = 0; ii < threadsNum; ++ii) {
+        ret = xmlSecDSigSignaturesWorkerInitialize(&(workers[ii]), &job, dsigCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigSignaturesWorkerInitialize", NULL);
+            goto done;
+        }
+        tasks[ii] = &(workers[ii]);
+    }
+
+    /* process */
+    ret = xmlSecExecutorRun(xmlSecDSigSignaturesWorkerTask, tasks, threadsNum);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    for(ii = 0; ii < threadsNum; ++ii) {
+        xmlSecDSigSignaturesWorkerFinalize(&(workers[ii]));
+    }
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    xmlSecDSigDigestsCacheDestroy(xmlSecDSigCtxGetDigestsCache(dsigCtx));
+    dsigCtx->reserved0 = NULL;
+    return(res);
+}
+
+/* returns 1 if the key can be found from <dsig:KeyInfo/> content alone, 0 otherwise */
+static int
+xmlSecDSigCtxBatchKeyInfoIsSelfContained(xmlNodePtr keyInfoNode) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(keyInfoNode != NULL, 0);
+
+    for(cur = xmlSecGetNextElementNode(keyInfoNode->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeKeyName, xmlSecDSigNs) &&
+           !xmlSecCheckNodeName(cur, xmlSecNodeKeyValue, xmlSecDSigNs) &&
+           !xmlSecCheckNodeName(cur, xmlSecNodeX509Data, xmlSecDSigNs)) {
+            return(0);
+        }
+    }
+    return(1);
+}
+
+static xmlBufferPtr
+xmlSecDSigCtxBatchKeyInfoDump(xmlNodePtr keyInfoNode) {
+    xmlBufferPtr res;
+
+    xmlSecAssert2(keyInfoNode != NULL, NULL);
+    xmlSecAssert2(keyInfoNode->doc != NULL, NULL);
+
+    res = xmlBufferCreate();
+    if(res == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(NULL);
+    }
+    if(xmlNodeDump(res, keyInfoNode->doc, keyInfoNode, 0, 0) < 0) {
+        xmlSecXmlError("xmlNodeDump", NULL);
+        xmlBufferFree(res);
+        return(NULL);
+    }
+    return(res);
+}
+
+/**
+ * xmlSecDSigCtxProcessSignatureNode:
+ *
+ * The Signature  element (http://www.w3.org/TR/xmldsig-core/#sec-Signature)
+ *
+ * The Signature element is the root element of an XML Signature.
+ * Implementation MUST generate laxly schema valid [XML-schema] Signature
+ * elements as specified by the following schema:
+ * The way in which the SignedInfo element is presented to the
+ * canonicalization method is dependent on that method. The following
+ * applies to algorithms which process XML as nodes or characters:
+ *
+ *  - XML based canonicalization implementations MUST be provided with
+ *  a [XPath] node-set originally formed from the document containing
+ *  the SignedInfo and currently indicating the SignedInfo, its descendants,
+ *  and the attribute and namespace nodes of SignedInfo and its descendant
+ *  elements.
+ *
+ *  - Text based canonicalization algorithms (such as CRLF and charset
+ *  normalization) should be provided with the UTF-8 octets that represent
+ *  the well-formed SignedInfo element, from the first character to the
+ *  last character of the XML representation, inclusive. This includes
+ *  the entire text of the start and end tags of the SignedInfo element
+ *  as well as all descendant markup and character data (i.e., the text)
+ *  between those tags. Use of text based canonicalization of SignedInfo
+ *  is NOT RECOMMENDED.
+ *
+ *  =================================
+ *  we do not support any non XML based C14N
  *
  * Schema Definition:
  *
- *  <element name="SignedInfo" type="ds:SignedInfoType"/>
- *  <complexType name="SignedInfoType">
- *    <sequence>
- *      <element ref="ds:CanonicalizationMethod"/>
- *      <element ref="ds:SignatureMethod"/>
- *      <element ref="ds:Reference" maxOccurs="unbounded"/>
- *    </sequence>
- *    <attribute name="Id" type="ID" use="optional"/>
+ *  <element name="Signature" type="ds:SignatureType"/>
+ *  <complexType name="SignatureType">
+ *  <sequence>
+ *     <element ref="ds:SignedInfo"/>
+ *     <element ref="ds:SignatureValue"/>
+ *     <element ref="ds:KeyInfo" minOccurs="0"/>
+ *     <element ref="ds:Object" minOccurs="0" maxOccurs="unbounded"/>
+ *     </sequence> <attribute name="Id" type="ID" use="optional"/>
  *  </complexType>
  *
  * DTD:
  *
- *  <!ELEMENT SignedInfo (CanonicalizationMethod, SignatureMethod,  Reference+) >
- *  <!ATTLIST SignedInfo  Id   ID      #IMPLIED>
+ *  <!ELEMENT Signature (SignedInfo, SignatureValue, KeyInfo?, Object*)  >
+ *  <!ATTLIST Signature
+ *      xmlns   CDATA   #FIXED 'http://www.w3.org/2000/09/xmldsig#'
+ *      Id      ID  #IMPLIED >
  *
  */
 static int
-xmlSecDSigCtxProcessSignedInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node, xmlNodePtr * firstReferenceNode) {
-    xmlSecSize refNodesCount = 0;
+xmlSecDSigCtxProcessSignatureNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    xmlNodePtr signedInfoNode = NULL;
+    xmlNodePtr keyInfoNode = NULL;
+    xmlNodePtr firstReferenceNode = NULL;
     xmlNodePtr cur;
+    xmlSecArenaPtr arena;
+    int keyResolved;
+    void* span;
+    int ret;
 
     xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigCtx) != NULL, -1);
+    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
     xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
+    xmlSecAssert2(dsigCtx->signValueNode == NULL, -1);
     xmlSecAssert2(dsigCtx->signMethod == NULL, -1);
     xmlSecAssert2(dsigCtx->c14nMethod == NULL, -1);
-    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
     xmlSecAssert2(node != NULL, -1);
-    xmlSecAssert2(firstReferenceNode != NULL, -1);
-    xmlSecAssert2((*firstReferenceNode) == NULL, -1);
 
-    /* first node is required CanonicalizationMethod. */
-    cur = xmlSecGetNextElementNode(node->children);
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeCanonicalizationMethod, xmlSecDSigNs))) {
-        dsigCtx->c14nMethod = xmlSecTransformCtxNodeRead(&(dsigCtx->transformCtx),
-                                        cur, xmlSecTransformUsageC14NMethod);
-        if(dsigCtx->c14nMethod == NULL) {
-            xmlSecInternalError2("xmlSecTransformCtxNodeRead", NULL,
-                                "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
-            return(-1);
-        }
-    } else if(dsigCtx->defC14NMethodId != xmlSecTransformIdUnknown) {
-        /* the dsig spec does require CanonicalizationMethod node
-         * to be present but in some case it application might decide to
-         * minimize traffic */
-        dsigCtx->c14nMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
-                                                              dsigCtx->defC14NMethodId);
-        if(dsigCtx->c14nMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
-            return(-1);
-        }
-    } else {
-        /* if c14n method is not specified in the template and not specified in
-         * the dsig context then it's an error.
-         */
-        xmlSecInvalidNodeError(cur, xmlSecNodeCanonicalizationMethod, NULL);
+    if(!xmlSecCheckNodeName(node, xmlSecNodeSignature, xmlSecDSigNs)) {
+        xmlSecInvalidNodeError(node, xmlSecNodeSignature, NULL);
         return(-1);
     }
 
-    /* insert membuf if requested */
-    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) {
-        xmlSecAssert2(dsigCtx->preSignMemBufMethod == NULL, -1);
-        dsigCtx->preSignMemBufMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
-                                                xmlSecTransformMemBufId);
-        if(dsigCtx->preSignMemBufMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend",
-                                xmlSecTransformKlassGetName(xmlSecTransformMemBufId));
-        }
+    /* read node data */
+    xmlSecAssert2(dsigCtx->id == NULL, -1);
+    arena = xmlSecTransformCtxGetArena(&(dsigCtx->transformCtx));
+    if(arena == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxGetArena", NULL);
+        return(-1);
     }
+    dsigCtx->id = xmlSecArenaGetProp(arena, node, xmlSecAttrId);
 
-    /* next node is required SignatureMethod. */
-    cur = xmlSecGetNextElementNode( ((cur != NULL) ? cur->next : node->children) );
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeSignatureMethod, xmlSecDSigNs))) {
-        dsigCtx->signMethod = xmlSecTransformCtxNodeRead(&(dsigCtx->transformCtx),
-                                        cur, xmlSecTransformUsageSignatureMethod);
-        if(dsigCtx->signMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxNodeRead",
-                                xmlSecNodeGetName(cur));
-            return(-1);
-        }
-    } else if(dsigCtx->defSignMethodId != xmlSecTransformIdUnknown) {
-        /* the dsig spec does require SignatureMethod node
-         * to be present but in some case it application might decide to
-         * minimize traffic */
-        dsigCtx->signMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
-                                                              dsigCtx->defSignMethodId);
-        if(dsigCtx->signMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
-            return(-1);
-        }
-    } else {
-        /* if sign method is not specified in the template and not specified in
-         * the dsig context then it's an error.
-         */
-        xmlSecInvalidNodeError(cur, xmlSecNodeSignatureMethod, NULL);
+    /* first node is required SignedInfo */
+    cur = xmlSecGetNextElementNode(node->children);
+    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeSignedInfo, xmlSecDSigNs))) {
+        xmlSecInvalidNodeError(cur, xmlSecNodeSignedInfo, NULL);
         return(-1);
     }
-    dsigCtx->signMethod->operation = dsigCtx->operation;
+    signedInfoNode = cur;
+    cur = xmlSecGetNextElementNode(cur->next);
 
-    /* read references */
-    if(cur != NULL) {
-        cur = xmlSecGetNextElementNode(cur->next);
+    /* next node is required SignatureValue */
+    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeSignatureValue, xmlSecDSigNs))) {
+        xmlSecInvalidNodeError(cur, xmlSecNodeSignatureValue, NULL);
+        return(-1);
     }
-    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs))) {
-        /* record first reference node */
-        if((*firstReferenceNode) == NULL) {
-            (*firstReferenceNode) = cur;
-        }
-        ++refNodesCount;
+    dsigCtx->signValueNode = cur;
+    cur = xmlSecGetNextElementNode(cur->next);
 
-        /* go to next */
+    /* next node is optional KeyInfo */
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
+        keyInfoNode = cur;
         cur = xmlSecGetNextElementNode(cur->next);
+    } else {
+        keyInfoNode = NULL;
     }
 
-    /* check that we have at least one Reference */
-    if(refNodesCount == 0) {
-        xmlSecOtherError(XMLSEC_ERRORS_R_DSIG_NO_REFERENCES, NULL, NULL);
-        return(-1);
+    /* next nodes are optional Object nodes */
+    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeObject, xmlSecDSigNs))) {
+        /* read manifests from objects */
+        if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_IGNORE_MANIFESTS) == 0) {
+            ret = xmlSecDSigCtxProcessObjectNode(dsigCtx, cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDSigCtxProcessObjectNode", NULL);
+                return(-1);
+            }
+        }
+        cur = xmlSecGetNextElementNode(cur->next);
     }
 
     /* if there is something left than it's an error */
@@ -703,740 +1799,2651 @@ xmlSecDSigCtxProcessSignedInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node, xm
         return(-1);
     }
 
-    /* done */
-    return(0);
-}
-
-
-static int
-xmlSecDSigCtxProcessReferences(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferenceNode) {
-    xmlSecDSigReferenceCtxPtr dsigRefCtx;
-    xmlNodePtr cur;
-    int ret;
+    /* now validated all the references and prepare transform */
+    ret = xmlSecDSigCtxProcessSignedInfoNode(dsigCtx, signedInfoNode, &firstReferenceNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxProcessSignedInfoNode", NULL);
+        return(-1);
+    }
 
-    xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
-    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
-    xmlSecAssert2(xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences)) == 0, -1);
-    xmlSecAssert2(firstReferenceNode != NULL, -1);
+    /* as the result, we should have sign and c14n methods set */
+    xmlSecAssert2(dsigCtx->signMethod != NULL, -1);
+    xmlSecAssert2(dsigCtx->c14nMethod != NULL, -1);
 
-    /* process references */
-    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
-        /* already checked but we trust none */
-        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
-            xmlSecInvalidNodeError(cur, xmlSecNodeReference, NULL);
-            return(-1);
-        }
+    /* now read key info node */
+    keyResolved = (dsigCtx->signKey == NULL) ? 1 : 0;
+    ret = xmlSecDSigCtxProcessKeyInfoNode(dsigCtx, keyInfoNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxProcessKeyInfoNode", NULL);
+        return(-1);
+    }
+    /* as the result, we should have a key */
+    xmlSecAssert2(dsigCtx->signKey != NULL, -1);
 
-        /* create reference */
-        dsigRefCtx = xmlSecDSigReferenceCtxCreate(dsigCtx, xmlSecDSigReferenceOriginSignedInfo);
-        if(dsigRefCtx == NULL) {
-            xmlSecInternalError("xmlSecDSigReferenceCtxCreate", NULL);
-            return(-1);
-        }
+    /* check the signature value before doing anything with references */
+    if((dsigCtx->operation == xmlSecTransformOperationVerify) &&
+       ((dsigCtx->flags & XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST) != 0)) {
 
-        /* add to the list */
-        ret = xmlSecPtrListAdd(&(dsigCtx->signedInfoReferences), dsigRefCtx);
+        span = xmlSecTraceBegin(xmlSecTracePhaseSignedInfo, signedInfoNode, dsigCtx->userData);
+        ret = xmlSecDSigCtxExecuteSignedInfo(dsigCtx, signedInfoNode);
+        xmlSecTraceEnd(span, xmlSecTracePhaseSignedInfo, ret);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListAdd", NULL);
-            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            xmlSecInternalError("xmlSecDSigCtxExecuteSignedInfo", NULL);
             return(-1);
         }
 
-        /* process */
-        ret = xmlSecDSigReferenceCtxProcessNode(dsigRefCtx, cur);
+        ret = xmlSecDSigCtxVerifySignatureValue(dsigCtx, signedInfoNode, keyInfoNode, keyResolved);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
-                                xmlSecNodeGetName(cur));
+            xmlSecInternalError("xmlSecDSigCtxVerifySignatureValue", NULL);
             return(-1);
         }
-
-        /* bail out if next Reference processing failed */
-        if(dsigRefCtx->status != xmlSecDSigStatusSucceeded) {
+        if(dsigCtx->signMethod->status != xmlSecTransformStatusOk) {
             dsigCtx->status = xmlSecDSigStatusInvalid;
             return(0);
         }
-    }
-
-    /* done */
-    return(0);
-}
-
-
-static int
-xmlSecDSigCtxProcessKeyInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
-    int ret;
 
-    xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigCtx->signMethod != NULL, -1);
+        ret = xmlSecDSigCtxProcessReferences(dsigCtx, firstReferenceNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigCtxProcessReferences", NULL);
+            return(-1);
+        }
+        /* references processing might change the status */
+        if(dsigCtx->status == xmlSecDSigStatusUnknown) {
+            dsigCtx->status = xmlSecDSigStatusSucceeded;
+        }
+        return(0);
+    }
 
-    /* set key requirements */
-    ret = xmlSecTransformSetKeyReq(dsigCtx->signMethod, &(dsigCtx->keyInfoReadCtx.keyReq));
+    /* now actually process references and calculate digests */
+    ret = xmlSecDSigCtxProcessReferences(dsigCtx, firstReferenceNode);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformSetKeyReq",
-                            xmlSecTransformGetName(dsigCtx->signMethod));
+        xmlSecInternalError("xmlSecDSigCtxProcessReferences", NULL);
         return(-1);
     }
-
-    /* ignore <dsig:KeyInfo /> if there is the key is already set */
-    /* todo: throw an error if key is set and node != NULL? */
-    if((dsigCtx->signKey == NULL) && (dsigCtx->keyInfoReadCtx.keysMngr != NULL)
-                        && (dsigCtx->keyInfoReadCtx.keysMngr->getKey != NULL)) {
-        dsigCtx->signKey = (dsigCtx->keyInfoReadCtx.keysMngr->getKey)(node, &(dsigCtx->keyInfoReadCtx));
-    }
-
-    /* check that we have exactly what we want */
-    if((dsigCtx->signKey == NULL) || (!xmlSecKeyMatch(dsigCtx->signKey, NULL, &(dsigCtx->keyInfoReadCtx.keyReq)))) {
-        xmlSecOtherError(XMLSEC_ERRORS_R_KEY_NOT_FOUND, NULL, NULL);
-        return(-1);
+    /* references processing might change the status */
+    if(dsigCtx->status != xmlSecDSigStatusUnknown) {
+        return(0);
     }
 
-    /* set the key to the transform */
-    ret = xmlSecTransformSetKey(dsigCtx->signMethod, dsigCtx->signKey);
+    /* calculate the signature */
+    span = xmlSecTraceBegin(xmlSecTracePhaseSignedInfo, signedInfoNode, dsigCtx->userData);
+    ret = xmlSecDSigCtxExecuteSignedInfo(dsigCtx, signedInfoNode);
+    xmlSecTraceEnd(span, xmlSecTracePhaseSignedInfo, ret);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformSetKey",
-                            xmlSecTransformGetName(dsigCtx->signMethod));
+        xmlSecInternalError("xmlSecDSigCtxExecuteSignedInfo", NULL);
         return(-1);
     }
 
-    /* if we are signing document, update <dsig:KeyInfo/> node */
-    if((node != NULL) && (dsigCtx->operation == xmlSecTransformOperationSign)) {
-        ret = xmlSecKeyInfoNodeWrite(node, dsigCtx->signKey, &(dsigCtx->keyInfoWriteCtx));
+    /* and check it */
+    if(dsigCtx->operation == xmlSecTransformOperationVerify) {
+        ret = xmlSecDSigCtxVerifySignatureValue(dsigCtx, signedInfoNode, keyInfoNode, keyResolved);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeWrite", NULL);
+            xmlSecInternalError("xmlSecDSigCtxVerifySignatureValue", NULL);
             return(-1);
         }
     }
-
     return(0);
 }
 
-/**
- * xmlSecDSigCtxProcessObjectNode:
- *
- * The Object Element (http://www.w3.org/TR/xmldsig-core/#sec-Object)
- *
- * Object is an optional element that may occur one or more times. When
- * present, this element may contain any data. The Object element may include
- * optional MIME type, ID, and encoding attributes.
- *
- * Schema Definition:
- *
- * <element name="Object" type="ds:ObjectType"/>
- * <complexType name="ObjectType" mixed="true">
- *   <sequence minOccurs="0" maxOccurs="unbounded">
- *     <any namespace="##any" processContents="lax"/>
- *   </sequence>
- *   <attribute name="Id" type="ID" use="optional"/>
- *   <attribute name="MimeType" type="string" use="optional"/>
- *   <attribute name="Encoding" type="anyURI" use="optional"/>
- * </complexType>
- *
- * DTD:
- *
- * <!ELEMENT Object (#PCDATA|Signature|SignatureProperties|Manifest %Object.ANY;)* >
- * <!ATTLIST Object  Id  ID  #IMPLIED
- *                   MimeType    CDATA   #IMPLIED
- *                   Encoding    CDATA   #IMPLIED >
+/*
+ * Verifies the <dsig:SignatureValue/> node content unless the same signature
+ * is found in the keys manager verified signatures cache. The @keyResolved
+ * is 1 if the key was found by the keys manager for @keyInfoNode (and not
+ * set by the application).
  */
 static int
-xmlSecDSigCtxProcessObjectNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
-    xmlNodePtr cur;
+xmlSecDSigCtxVerifySignatureValue(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode,
+                                  xmlNodePtr keyInfoNode, int keyResolved) {
+    xmlSecKeysMngrPtr keysMngr;
+    xmlChar* signature;
+    xmlChar* cacheKey = NULL;
+    void* span;
     int ret;
 
     xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
-    xmlSecAssert2(node != NULL, -1);
-
-    /* we care about Manifest nodes only; ignore everything else */
-    cur = xmlSecGetNextElementNode(node->children);
-    while(cur != NULL) {
-        if(xmlSecCheckNodeName(cur, xmlSecNodeManifest, xmlSecDSigNs)) {
-            ret = xmlSecDSigCtxProcessManifestNode(dsigCtx, cur);
-            if(ret < 0){
-                xmlSecInternalError("xmlSecDSigCtxProcessManifestNode", NULL);
+    xmlSecAssert2(dsigCtx->signMethod != NULL, -1);
+    xmlSecAssert2(dsigCtx->signValueNode != NULL, -1);
+    xmlSecAssert2(signedInfoNode != NULL, -1);
+
+    keysMngr = dsigCtx->keyInfoReadCtx.keysMngr;
+    if((keyResolved != 0) && (keysMngr != NULL) && (keysMngr->verifyCache != NULL) &&
+       (keysMngr->getKey == xmlSecKeysMngrGetKey)) {
+        signature = xmlSecDSigCtxVerifyCacheGetSignature(dsigCtx, signedInfoNode);
+        if(signature != NULL) {
+            ret = xmlSecKeysMngrVerifyCacheFind(keysMngr, keyInfoNode, &(dsigCtx->keyInfoReadCtx),
+                                                signature, &cacheKey);
+            xmlFree(signature);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecKeysMngrVerifyCacheFind", NULL);
                 return(-1);
+            } else if(ret == 1) {
+                dsigCtx->signMethod->status = xmlSecTransformStatusOk;
+                return(0);
             }
         }
-        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    span = xmlSecTraceBegin(xmlSecTracePhaseSignatureVerify, dsigCtx->signValueNode, dsigCtx->userData);
+    ret = xmlSecTransformVerifyNodeContent(dsigCtx->signMethod, dsigCtx->signValueNode,
+                                           &(dsigCtx->transformCtx));
+    xmlSecTraceEnd(span, xmlSecTracePhaseSignatureVerify, ret);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
+        if(cacheKey != NULL) {
+            xmlFree(cacheKey);
+        }
+        return(-1);
+    }
+
+    /* remember the signature only if it is good */
+    if(cacheKey != NULL) {
+        if(dsigCtx->signMethod->status == xmlSecTransformStatusOk) {
+            ret = xmlSecKeysMngrVerifyCacheAdd(keysMngr, cacheKey);
+            if(ret < 0) {
+                /* not fatal, the signature is still verified */
+                xmlSecInternalError("xmlSecKeysMngrVerifyCacheAdd", NULL);
+            }
+        }
+        xmlFree(cacheKey);
     }
     return(0);
 }
 
-/**
- * xmlSecDSigCtxProcessManifestNode:
- *
- * The Manifest  Element (http://www.w3.org/TR/xmldsig-core/#sec-Manifest)
- *
- * The Manifest element provides a list of References. The difference from
- * the list in SignedInfo is that it is application defined which, if any, of
- * the digests are actually checked against the objects referenced and what to
- * do if the object is inaccessible or the digest compare fails. If a Manifest
- * is pointed to from SignedInfo, the digest over the Manifest itself will be
- * checked by the core result validation behavior. The digests within such
- * a Manifest are checked at the application's discretion. If a Manifest is
- * referenced from another Manifest, even the overall digest of this two level
- * deep Manifest might not be checked.
- *
- * Schema Definition:
- *
- * <element name="Manifest" type="ds:ManifestType"/>
- * <complexType name="ManifestType">
- *   <sequence>
- *     <element ref="ds:Reference" maxOccurs="unbounded"/>
- *   </sequence>
- *   <attribute name="Id" type="ID" use="optional"/>
- *  </complexType>
- *
- * DTD:
- *
- * <!ELEMENT Manifest (Reference+)  >
- * <!ATTLIST Manifest Id ID  #IMPLIED >
+/*
+ * Returns the signature method, <dsig:SignatureValue/> and canonical
+ * <dsig:SignedInfo/> for the verified signatures cache or NULL if the
+ * signature can't be cached: not all the <dsig:Reference/> nodes are
+ * same-document or the canonical <dsig:SignedInfo/> is not stored.
  */
-static int
-xmlSecDSigCtxProcessManifestNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
-    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+static xmlChar*
+xmlSecDSigCtxVerifyCacheGetSignature(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode) {
+    xmlSecBufferPtr preSign;
+    xmlSecBuffer signValue;
+    xmlChar* signValueBase64;
+    xmlChar* res;
+    xmlChar* uri;
     xmlNodePtr cur;
     int ret;
 
+    xmlSecAssert2(dsigCtx != NULL, NULL);
+    xmlSecAssert2(dsigCtx->signMethod != NULL, NULL);
+    xmlSecAssert2(dsigCtx->signValueNode != NULL, NULL);
+    xmlSecAssert2(signedInfoNode != NULL, NULL);
+
+    for(cur = xmlSecGetNextElementNode(signedInfoNode->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            continue;
+        }
+        uri = xmlGetProp(cur, xmlSecAttrURI);
+        if((uri == NULL) || ((uri[0] != '\0') && (uri[0] != '#'))) {
+            if(uri != NULL) {
+                xmlFree(uri);
+            }
+            return(NULL);
+        }
+        xmlFree(uri);
+    }
+
+    preSign = xmlSecDSigCtxGetPreSignBuffer(dsigCtx);
+    if((preSign == NULL) || (xmlSecBufferGetSize(preSign) == 0)) {
+        return(NULL);
+    }
+
+    ret = xmlSecBufferInitialize(&signValue, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(NULL);
+    }
+    ret = xmlSecBufferBase64NodeContentRead(&signValue, dsigCtx->signValueNode);
+    if((ret < 0) || (xmlSecBufferGetData(&signValue) == NULL)) {
+        xmlSecBufferFinalize(&signValue);
+        return(NULL);
+    }
+    signValueBase64 = xmlSecBase64Encode(xmlSecBufferGetData(&signValue),
+                                         xmlSecBufferGetSize(&signValue), 0);
+    xmlSecBufferFinalize(&signValue);
+    if(signValueBase64 == NULL) {
+        xmlSecInternalError("xmlSecBase64Encode", NULL);
+        return(NULL);
+    }
+
+    res = xmlStrncatNew(dsigCtx->signMethod->id->href, BAD_CAST "|", -1);
+    if(res != NULL) {
+        res = xmlStrcat(res, signValueBase64);
+    }
+    if(res != NULL) {
+        res = xmlStrcat(res, BAD_CAST "|");
+    }
+    if(res != NULL) {
+        res = xmlStrncat(res, xmlSecBufferGetData(preSign), (int)xmlSecBufferGetSize(preSign));
+    }
+    xmlFree(signValueBase64);
+    if(res == NULL) {
+        xmlSecXmlError("xmlStrcat", NULL);
+        return(NULL);
+    }
+    return(res);
+}
+
+static int
+xmlSecDSigCtxExecuteSignedInfo(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode) {
+    xmlSecTransformDataType firstType;
+    xmlSecBufferPtr buffer;
+    xmlChar* cacheKey = NULL;
+    xmlSecSize generation = 0;
+    int ret;
+
     xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
-    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(signedInfoNode != NULL, -1);
 
-    /* calculate references */
-    cur = xmlSecGetNextElementNode(node->children);
-    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs))) {
-        /* create reference */
-        dsigRefCtx = xmlSecDSigReferenceCtxCreate(dsigCtx, xmlSecDSigReferenceOriginManifest);
-        if(dsigRefCtx == NULL) {
-            xmlSecInternalError("xmlSecDSigReferenceCtxCreate", NULL);
+    /* if we need to write result to xml node then we need base64 encode result */
+    if(dsigCtx->operation == xmlSecTransformOperationSign) {
+        xmlSecTransformPtr base64Encode;
+
+        /* we need to add base64 encode transform */
+        base64Encode = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
+                                                         xmlSecTransformBase64Id);
+        if(base64Encode == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend", NULL);
             return(-1);
         }
+        base64Encode->operation = xmlSecTransformOperationEncode;
+    }
 
-        /* add to the list */
-        ret = xmlSecPtrListAdd(&(dsigCtx->manifestReferences), dsigRefCtx);
+    /* the canonical <dsig:SignedInfo/> might be computed already */
+    if(xmlSecDocCacheGetGeneration(signedInfoNode->doc, &generation) != 0) {
+        cacheKey = xmlSecDSigCtxSignedInfoCacheKey(dsigCtx, signedInfoNode);
+    }
+    if((cacheKey != NULL) && (dsigCtx->operation == xmlSecTransformOperationVerify)) {
+        ret = xmlSecDSigCtxExecuteCachedSignedInfo(dsigCtx, signedInfoNode, cacheKey);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListAdd", NULL);
-            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            xmlSecInternalError("xmlSecDSigCtxExecuteCachedSignedInfo", NULL);
+            xmlFree(cacheKey);
             return(-1);
+        } else if(ret == 1) {
+            xmlFree(cacheKey);
+            return(0);
+        }
+    }
+
+    firstType = xmlSecTransformGetDataType(dsigCtx->transformCtx.first,
+                                           xmlSecTransformModePush,
+                                           &(dsigCtx->transformCtx));
+    if((firstType & xmlSecTransformDataTypeXml) != 0) {
+        xmlSecNodeSetPtr nodeset = NULL;
+
+        nodeset = xmlSecNodeSetGetChildren(signedInfoNode->doc, signedInfoNode, 1, 0);
+        if(nodeset == NULL) {
+            xmlSecInternalError("xmlSecNodeSetGetChildren(signedInfoNode)", NULL);
+            goto error;
         }
 
-        /* process */
-        ret = xmlSecDSigReferenceCtxProcessNode(dsigRefCtx, cur);
+        /* calculate the signature */
+        ret = xmlSecTransformCtxXmlExecute(&(dsigCtx->transformCtx), nodeset);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
-                                xmlSecNodeGetName(cur));
-            return(-1);
+            xmlSecInternalError("xmlSecTransformCtxXmlExecute", NULL);
+            xmlSecNodeSetDestroy(nodeset);
+            goto error;
         }
+        xmlSecNodeSetDestroy(nodeset);
+    } else {
+        /* TODO */
+        xmlSecNotImplementedError("binary c14n transforms");
+        goto error;
+    }
 
-        /* we don;t care if Reference processing failed because
-         * it's Manifest node */
-        cur = xmlSecGetNextElementNode(cur->next);
+    /* remember the canonical <dsig:SignedInfo/> */
+    if(cacheKey != NULL) {
+        buffer = xmlSecTransformMemBufGetBuffer(dsigCtx->preSignMemBufMethod);
+        if((buffer != NULL) && (xmlSecBufferGetSize(buffer) > 0)) {
+            ret = xmlSecDocCacheAdd(signedInfoNode->doc, cacheKey, signedInfoNode, NULL,
+                                    generation, xmlSecBufferGetData(buffer),
+                                    xmlSecBufferGetSize(buffer));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDocCacheAdd", NULL);
+                goto error;
+            }
+        }
+        xmlFree(cacheKey);
     }
+    return(0);
 
-    /* we should have nothing else here */
-    if(cur != NULL) {
-        xmlSecUnexpectedNodeError(cur,  NULL);
+error:
+    if(cacheKey != NULL) {
+        xmlFree(cacheKey);
+    }
+    return(-1);
+}
+
+/*
+ * Returns the key of the canonical <dsig:SignedInfo/> in the document
+ * cache or NULL if it can't be cached: the canonicalization method is
+ * not a c14n transform or its output is not stored.
+ */
+static xmlChar*
+xmlSecDSigCtxSignedInfoCacheKey(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode) {
+    xmlChar* key;
+    char node[64];
+
+    xmlSecAssert2(dsigCtx != NULL, NULL);
+    xmlSecAssert2(dsigCtx->c14nMethod != NULL, NULL);
+    xmlSecAssert2(signedInfoNode != NULL, NULL);
+
+    if((dsigCtx->preSignMemBufMethod == NULL) ||
+       (dsigCtx->c14nMethod->next != dsigCtx->preSignMemBufMethod)) {
+        return(NULL);
+    }
+    if(!xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformInclC14NId) &&
+       !xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformInclC14NWithCommentsId) &&
+       !xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformInclC14N11Id) &&
+       !xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformInclC14N11WithCommentsId) &&
+       !xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformExclC14NId) &&
+       !xmlSecTransformCheckId(dsigCtx->c14nMethod, xmlSecTransformExclC14NWithCommentsId)) {
+        return(NULL);
+    }
+
+    (void)xmlStrPrintf(BAD_CAST node, sizeof(node), "SignedInfo %p\n", (void*)signedInfoNode);
+    key = xmlStrncatNew(BAD_CAST node, dsigCtx->c14nMethod->id->href, -1);
+    if(key == NULL) {
+        xmlSecXmlError("xmlStrncatNew", NULL);
+        return(NULL);
+    }
+    return(key);
+}
+
+/*
+ * Pushes the canonical <dsig:SignedInfo/> from the document cache to the
+ * transforms after the c14n method. Returns 1 if it is found in the cache,
+ * 0 if not or a negative value if an error occurs.
+ */
+static int
+xmlSecDSigCtxExecuteCachedSignedInfo(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode,
+                                     const xmlChar* cacheKey) {
+    xmlSecBuffer cached;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->c14nMethod != NULL, -1);
+    xmlSecAssert2(dsigCtx->c14nMethod->next != NULL, -1);
+    xmlSecAssert2(signedInfoNode != NULL, -1);
+    xmlSecAssert2(cacheKey != NULL, -1);
+
+    ret = xmlSecBufferInitialize(&cached, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
         return(-1);
     }
-    return(0);
+
+    ret = xmlSecDocCacheLookup(signedInfoNode->doc, cacheKey, signedInfoNode, &cached);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDocCacheLookup", NULL);
+        goto done;
+    } else if(ret == 0) {
+        res = 0;
+        goto done;
+    }
+
+    ret = xmlSecTransformCtxPrepare(&(dsigCtx->transformCtx), xmlSecTransformDataTypeXml);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeXml)", NULL);
+        goto done;
+    }
+    ret = xmlSecTransformPushBin(dsigCtx->c14nMethod->next, xmlSecBufferGetData(&cached),
+                                 xmlSecBufferGetSize(&cached), 1, &(dsigCtx->transformCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin",
+                            xmlSecTransformGetName(dsigCtx->c14nMethod->next));
+        goto done;
+    }
+    dsigCtx->transformCtx.status = xmlSecTransformStatusFinished;
+    res = 1;
+
+done:
+    xmlSecBufferFinalize(&cached);
+    return(res);
 }
 
 /**
- * xmlSecDSigCtxDebugDump:
- * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
- * @output:             the pointer to output FILE.
+ * xmlSecDSigCtxProcessSignedInfoNode:
+ *
+ * The SignedInfo Element (http://www.w3.org/TR/xmldsig-core/#sec-SignedInfo)
+ *
+ * The structure of SignedInfo includes the canonicalization algorithm,
+ * a result algorithm, and one or more references. The SignedInfo element
+ * may contain an optional ID attribute that will allow it to be referenced by
+ * other signatures and objects.
+ *
+ * SignedInfo does not include explicit result or digest properties (such as
+ * calculation time, cryptographic device serial number, etc.). If an
+ * application needs to associate properties with the result or digest,
+ * it may include such information in a SignatureProperties element within
+ * an Object element.
+ *
+ * Schema Definition:
+ *
+ *  <element name="SignedInfo" type="ds:SignedInfoType"/>
+ *  <complexType name="SignedInfoType">
+ *    <sequence>
+ *      <element ref="ds:CanonicalizationMethod"/>
+ *      <element ref="ds:SignatureMethod"/>
+ *      <element ref="ds:Reference" maxOccurs="unbounded"/>
+ *    </sequence>
+ *    <attribute name="Id" type="ID" use="optional"/>
+ *  </complexType>
+ *
+ * DTD:
+ *
+ *  <!ELEMENT SignedInfo (CanonicalizationMethod, SignatureMethod,  Reference+) >
+ *  <!ATTLIST SignedInfo  Id   ID      #IMPLIED>
  *
- * Prints the debug information about @dsigCtx to @output.
  */
-void
-xmlSecDSigCtxDebugDump(xmlSecDSigCtxPtr dsigCtx, FILE* output) {
-    xmlSecAssert(dsigCtx != NULL);
-    xmlSecAssert(output != NULL);
+static int
+xmlSecDSigCtxProcessSignedInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node, xmlNodePtr * firstReferenceNode) {
+    xmlSecSize refNodesCount = 0;
+    xmlSecSize generation = 0;
+    xmlNodePtr cur;
 
-    if(dsigCtx->operation == xmlSecTransformOperationSign) {
-        fprintf(output, "= SIGNATURE CONTEXT\n");
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
+    xmlSecAssert2(dsigCtx->signMethod == NULL, -1);
+    xmlSecAssert2(dsigCtx->c14nMethod == NULL, -1);
+    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(firstReferenceNode != NULL, -1);
+    xmlSecAssert2((*firstReferenceNode) == NULL, -1);
+
+    /* first node is required CanonicalizationMethod. */
+    cur = xmlSecGetNextElementNode(node->children);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeCanonicalizationMethod, xmlSecDSigNs))) {
+        dsigCtx->c14nMethod = xmlSecTransformCtxNodeRead(&(dsigCtx->transformCtx),
+                                        cur, xmlSecTransformUsageC14NMethod);
+        if(dsigCtx->c14nMethod == NULL) {
+            xmlSecInternalError2("xmlSecTransformCtxNodeRead", NULL,
+                                "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
+            return(-1);
+        }
+    } else if(dsigCtx->defC14NMethodId != xmlSecTransformIdUnknown) {
+        /* the dsig spec does require CanonicalizationMethod node
+         * to be present but in some case it application might decide to
+         * minimize traffic */
+        dsigCtx->c14nMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
+                                                              dsigCtx->defC14NMethodId);
+        if(dsigCtx->c14nMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
+            return(-1);
+        }
     } else {
-        fprintf(output, "= VERIFICATION CONTEXT\n");
+        /* if c14n method is not specified in the template and not specified in
+         * the dsig context then it's an error.
+         */
+        xmlSecInvalidNodeError(cur, xmlSecNodeCanonicalizationMethod, NULL);
+        return(-1);
     }
-    switch(dsigCtx->status) {
-        case xmlSecDSigStatusUnknown:
-            fprintf(output, "== Status: unknown\n");
-            break;
-        case xmlSecDSigStatusSucceeded:
-            fprintf(output, "== Status: succeeded\n");
-            break;
-        case xmlSecDSigStatusInvalid:
-            fprintf(output, "== Status: invalid\n");
-            break;
+
+    /* insert membuf if requested (or to cache the canonical <dsig:SignedInfo/>) */
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) ||
+       (xmlSecDocCacheGetGeneration(node->doc, &generation) != 0) ||
+       ((dsigCtx->operation == xmlSecTransformOperationVerify) &&
+        (dsigCtx->keyInfoReadCtx.keysMngr != NULL) &&
+        (dsigCtx->keyInfoReadCtx.keysMngr->verifyCache != NULL))) {
+        xmlSecAssert2(dsigCtx->preSignMemBufMethod == NULL, -1);
+        dsigCtx->preSignMemBufMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
+                                                xmlSecTransformMemBufId);
+        if(dsigCtx->preSignMemBufMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend",
+                                xmlSecTransformKlassGetName(xmlSecTransformMemBufId));
+        }
+    }
+
+    /* next node is required SignatureMethod. */
+    cur = xmlSecGetNextElementNode( ((cur != NULL) ? cur->next : node->children) );
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeSignatureMethod, xmlSecDSigNs))) {
+        dsigCtx->signMethod = xmlSecTransformCtxNodeRead(&(dsigCtx->transformCtx),
+                                        cur, xmlSecTransformUsageSignatureMethod);
+        if(dsigCtx->signMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxNodeRead",
+                                xmlSecNodeGetName(cur));
+            return(-1);
+        }
+    } else if(dsigCtx->defSignMethodId != xmlSecTransformIdUnknown) {
+        /* the dsig spec does require SignatureMethod node
+         * to be present but in some case it application might decide to
+         * minimize traffic */
+        dsigCtx->signMethod = xmlSecTransformCtxCreateAndAppend(&(dsigCtx->transformCtx),
+                                                              dsigCtx->defSignMethodId);
+        if(dsigCtx->signMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
+            return(-1);
+        }
+    } else {
+        /* if sign method is not specified in the template and not specified in
+         * the dsig context then it's an error.
+         */
+        xmlSecInvalidNodeError(cur, xmlSecNodeSignatureMethod, NULL);
+        return(-1);
+    }
+    dsigCtx->signMethod->operation = dsigCtx->operation;
+
+    /* read references */
+    if(cur != NULL) {
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs))) {
+        /* record first reference node */
+        if((*firstReferenceNode) == NULL) {
+            (*firstReferenceNode) = cur;
+        }
+        ++refNodesCount;
+
+        /* go to next */
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    /* check that we have at least one Reference */
+    if(refNodesCount == 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_DSIG_NO_REFERENCES, NULL, NULL);
+        return(-1);
+    }
+
+    /* if there is something left than it's an error */
+    if(cur != NULL) {
+        xmlSecUnexpectedNodeError(cur,  NULL);
+        return(-1);
+    }
+
+    /* done */
+    return(0);
+}
+
+
+static int
+xmlSecDSigCtxProcessReferences(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferenceNode) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx)) != NULL, -1);
+    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
+    xmlSecAssert2((dsigCtx->operation == xmlSecTransformOperationSign) || (dsigCtx->operation == xmlSecTransformOperationVerify), -1);
+    xmlSecAssert2(xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences)) == 0, -1);
+    xmlSecAssert2(firstReferenceNode != NULL, -1);
+
+    /* the prefetch would read the objects the application has the digests for */
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PREFETCH_REFERENCES) != 0) &&
+        (xmlSecDSigCtxGetPrivate(dsigCtx)->referenceDigestCallback == NULL) &&
+        (xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->prefetch == NULL)) {
+        return(xmlSecDSigCtxProcessReferencesPrefetched(dsigCtx, firstReferenceNode));
+    }
+
+    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES) != 0) {
+        return(xmlSecDSigCtxProcessReferencesParallel(dsigCtx, firstReferenceNode,
+                    xmlSecDSigReferenceOriginSignedInfo));
+    }
+
+    /* process references */
+    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        /* already checked but we trust none */
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            xmlSecInvalidNodeError(cur, xmlSecNodeReference, NULL);
+            return(-1);
+        }
+
+        /* create reference */
+        dsigRefCtx = xmlSecDSigCtxCreateReference(dsigCtx, xmlSecDSigReferenceOriginSignedInfo);
+        if(dsigRefCtx == NULL) {
+            xmlSecInternalError("xmlSecDSigCtxCreateReference", NULL);
+            return(-1);
+        }
+
+        /* add to the list */
+        ret = xmlSecPtrListAdd(&(dsigCtx->signedInfoReferences), dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            return(-1);
+        }
+
+        /* process */
+        ret = xmlSecDSigReferenceCtxProcessNode(dsigRefCtx, cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
+                                xmlSecNodeGetName(cur));
+            return(-1);
+        }
+
+        /* bail out if next Reference processing failed */
+        if(dsigRefCtx->status != xmlSecDSigStatusSucceeded) {
+            dsigCtx->status = xmlSecDSigStatusInvalid;
+            return(0);
+        }
+    }
+
+    /* done */
+    return(0);
+}
+
+
+/*
+ * The external URIs of all the references are started first, the references
+ * are then processed as usual and read the data as it arrives.
+ */
+static int
+xmlSecDSigCtxProcessReferencesPrefetched(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferenceNode) {
+    xmlSecIOPrefetchPtr prefetch;
+    xmlNodePtr cur;
+    xmlChar* uri;
+    xmlChar* xptr;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx)) != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->prefetch == NULL, -1);
+    xmlSecAssert2(firstReferenceNode != NULL, -1);
+
+    prefetch = xmlSecIOPrefetchCreate();
+    if(prefetch == NULL) {
+        xmlSecInternalError("xmlSecIOPrefetchCreate", NULL);
+        return(-1);
+    }
+
+    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            break;
+        }
+
+        /* only the external uris allowed for references */
+        uri = xmlGetProp(cur, xmlSecAttrURI);
+        if(uri == NULL) {
+            continue;
+        }
+        xptr = (xmlChar*)xmlStrchr(uri, '#');
+        if(xptr != NULL) {
+            (*xptr) = '\0';
+        }
+        /* the attachments are streamed by the application */
+        if((xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->attachmentResolver != NULL) &&
+           (xmlSecAttachmentUriCheck(uri) == 1)) {
+            xmlFree(uri);
+            continue;
+        }
+        if((uri[0] != '\0') && (xmlSecTransformUriTypeCheck(dsigCtx->enabledReferenceUris, uri) == 1)) {
+            ret = xmlSecIOPrefetchStart(prefetch, uri);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecIOPrefetchStart", NULL,
+                                     "uri=%s", xmlSecErrorsSafeString(uri));
+                xmlFree(uri);
+                xmlSecIOPrefetchDestroy(prefetch);
+                return(-1);
+            }
+        }
+        xmlFree(uri);
+    }
+
+    /* the <dsig:Reference/> contexts get it in xmlSecDSigReferenceCtxSetup() */
+    xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->prefetch = prefetch;
+    ret = xmlSecDSigCtxProcessReferences(dsigCtx, firstReferenceNode);
+    xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->prefetch = NULL;
+
+    /* the references are done with the data, the contexts may keep the transforms */
+    xmlSecIOPrefetchDestroy(prefetch);
+    return(ret);
+}
+
+typedef struct _xmlSecDSigReferencesJob {
+    xmlSecDSigReferenceCtxPtr*  refCtxs;
+    xmlNodePtr*                 nodes;
+    int*                        results;
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlMutexPtr                 mutex;
+} xmlSecDSigReferencesJob, *xmlSecDSigReferencesJobPtr;
+
+static void
+xmlSecDSigReferencesJobRun(xmlSecDSigReferencesJobPtr job) {
+    xmlSecSize pos;
+
+    xmlSecAssert(job != NULL);
+    xmlSecAssert(job->mutex != NULL);
+
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = job->next;
+        if(pos < job->size) {
+            ++job->next;
+        }
+        xmlMutexUnlock(job->mutex);
+
+        if(pos >= job->size) {
+            break;
+        }
+        /* the document is not modified until all the workers are done */
+        job->results[pos] = xmlSecDSigReferenceCtxProcess(job->refCtxs[pos], job->nodes[pos], 0);
+    }
+}
+
+static void
+xmlSecDSigReferencesJobTask(void* data) {
+    xmlSecDSigReferencesJobRun((xmlSecDSigReferencesJobPtr)data);
+}
+
+static xmlSecSize
+xmlSecDSigReferencesJobGetThreadsNumber(xmlSecSize size) {
+    xmlSecSize res;
+
+    res = xmlSecExecutorGetThreadsNumber();
+    if(res > XMLSEC_DSIG_MAX_REFERENCES_THREADS) {
+        res = XMLSEC_DSIG_MAX_REFERENCES_THREADS;
+    }
+    if(res > size) {
+        res = size;
+    }
+    return(res);
+}
+
+/*
+ * All the references contexts are created first, then the references are
+ * processed by the executor tasks (see #xmlSecExecutorSetCallback) and
+ * finally the results are checked in the document order: the first failed
+ * or invalid reference determines the result exactly as in the sequential
+ * processing. When signing, the <dsig:DigestValue/> nodes are written in the
+ * last step as well.
+ *
+ * The <dsig:SignedInfo/> and <dsig:Manifest/> references differ only in
+ * how the results are checked: the invalid manifest references are not errors.
+ */
+static int
+xmlSecDSigCtxProcessReferencesParallel(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferenceNode,
+                                       xmlSecDSigReferenceOrigin origin) {
+    xmlSecDSigReferencesJob job;
+    void* tasks[XMLSEC_DSIG_MAX_REFERENCES_THREADS];
+    xmlSecSize threadsNum;
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecPtrListPtr references;
+    xmlNodePtr cur;
+    xmlNodePtr badNode = NULL;
+    xmlSecSize size, ii, base;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(firstReferenceNode != NULL, -1);
+
+    references = (origin == xmlSecDSigReferenceOriginSignedInfo) ?
+        &(dsigCtx->signedInfoReferences) : &(dsigCtx->manifestReferences);
+    base = xmlSecPtrListGetSize(references);
+    memset(&job, 0, sizeof(job));
+
+    /* count references */
+    for(size = 0, cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        ++size;
+    }
+
+    job.refCtxs = (xmlSecDSigReferenceCtxPtr*)xmlMalloc(size * sizeof(xmlSecDSigReferenceCtxPtr));
+    job.nodes = (xmlNodePtr*)xmlMalloc(size * sizeof(xmlNodePtr));
+    job.results = (int*)xmlMalloc(size * sizeof(int));
+    if((job.refCtxs == NULL) || (job.nodes == NULL) || (job.results == NULL)) {
+        xmlSecMallocError(size * (sizeof(xmlSecDSigReferenceCtxPtr) + sizeof(xmlNodePtr) + sizeof(int)), NULL);
+        goto done;
+    }
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        goto done;
+    }
+
+    /* create references contexts up to the first bad node (if any) */
+    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        /* already checked but we trust none */
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            badNode = cur;
+            break;
+        }
+
+        /* create reference */
+        dsigRefCtx = xmlSecDSigCtxCreateReference(dsigCtx, origin);
+        if(dsigRefCtx == NULL) {
+            xmlSecInternalError("xmlSecDSigCtxCreateReference", NULL);
+            goto done;
+        }
+
+        /* add to the list */
+        ret = xmlSecPtrListAdd(references, dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            goto done;
+        }
+
+        job.refCtxs[job.size] = dsigRefCtx;
+        job.nodes[job.size] = cur;
+        job.results[job.size] = -1;
+        ++job.size;
+    }
+
+    /* process: all the tasks share the same job */
+    threadsNum = xmlSecDSigReferencesJobGetThreadsNumber(job.size);
+    for(ii = 0; ii < threadsNum; ++ii) {
+        tasks[ii] = &job;
+    }
+    ret = xmlSecExecutorRun(xmlSecDSigReferencesJobTask, tasks, threadsNum);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+
+    /* check results in the document order, the references after the first
+     * failed or invalid one are dropped: the sequential processing doesn't
+     * get to them */
+    for(ii = 0; ii < job.size; ++ii) {
+        if(job.results[ii] < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
+                                xmlSecNodeGetName(job.nodes[ii]));
+            xmlSecPtrListTruncate(references, base + ii + 1);
+            goto done;
+        }
+
+        if(dsigCtx->operation == xmlSecTransformOperationSign) {
+            ret = xmlSecDSigReferenceCtxWriteDigestValue(job.refCtxs[ii], job.nodes[ii]);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDSigReferenceCtxWriteDigestValue",
+                                    xmlSecNodeGetName(job.nodes[ii]));
+                goto done;
+            }
+        }
+
+        /* bail out if next Reference processing failed (we don't care
+         * about the manifest references) */
+        if((origin == xmlSecDSigReferenceOriginSignedInfo) &&
+           (job.refCtxs[ii]->status != xmlSecDSigStatusSucceeded)) {
+            xmlSecPtrListTruncate(references, base + ii + 1);
+            dsigCtx->status = xmlSecDSigStatusInvalid;
+            res = 0;
+            goto done;
+        }
+    }
+    if(badNode != NULL) {
+        if(origin == xmlSecDSigReferenceOriginSignedInfo) {
+            xmlSecInvalidNodeError(badNode, xmlSecNodeReference, NULL);
+        } else {
+            xmlSecUnexpectedNodeError(badNode,  NULL);
+        }
+        goto done;
+    }
+
+    /* done */
+    res = 0;
+
+done:
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    if(job.refCtxs != NULL) {
+        xmlFree(job.refCtxs);
+    }
+    if(job.nodes != NULL) {
+        xmlFree(job.nodes);
+    }
+    if(job.results != NULL) {
+        xmlFree(job.results);
+    }
+    return(res);
+}
+
+static int
+xmlSecDSigCtxProcessKeyInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    void* span;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->signMethod != NULL, -1);
+
+    /* set key requirements */
+    ret = xmlSecTransformSetKeyReq(dsigCtx->signMethod, &(dsigCtx->keyInfoReadCtx.keyReq));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformSetKeyReq",
+                            xmlSecTransformGetName(dsigCtx->signMethod));
+        return(-1);
+    }
+
+    /* the pinned key is the only option, <dsig:KeyInfo /> is not looked at */
+    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PINNED_KEY) != 0) {
+        if(dsigCtx->signKey == NULL) {
+            xmlSecOtherError(XMLSEC_ERRORS_R_KEY_NOT_FOUND, NULL,
+                             "pinned key is not set");
+            return(-1);
+        }
+        node = NULL;
+    }
+
+    /* ignore <dsig:KeyInfo /> if there is the key is already set */
+    /* todo: throw an error if key is set and node != NULL? */
+    if((dsigCtx->signKey == NULL) && (dsigCtx->keyInfoReadCtx.keysMngr != NULL)
+                        && (dsigCtx->keyInfoReadCtx.keysMngr->getKey != NULL)) {
+        span = xmlSecTraceBegin(xmlSecTracePhaseKeyInfo, node, dsigCtx->userData);
+        dsigCtx->signKey = (dsigCtx->keyInfoReadCtx.keysMngr->getKey)(node, &(dsigCtx->keyInfoReadCtx));
+        xmlSecTraceEnd(span, xmlSecTracePhaseKeyInfo, (dsigCtx->signKey != NULL) ? 0 : -1);
+    }
+
+    /* check that we have exactly what we want */
+    if((dsigCtx->signKey == NULL) || (!xmlSecKeyMatch(dsigCtx->signKey, NULL, &(dsigCtx->keyInfoReadCtx.keyReq)))) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_KEY_NOT_FOUND, NULL, NULL);
+        return(-1);
+    }
+
+    /* set the key to the transform */
+    ret = xmlSecTransformSetKey(dsigCtx->signMethod, dsigCtx->signKey);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformSetKey",
+                            xmlSecTransformGetName(dsigCtx->signMethod));
+        return(-1);
+    }
+
+    /* if we are signing document, update <dsig:KeyInfo/> node */
+    if((node != NULL) && (dsigCtx->operation == xmlSecTransformOperationSign)) {
+        ret = xmlSecKeyInfoNodeWrite(node, dsigCtx->signKey, &(dsigCtx->keyInfoWriteCtx));
+        xmlSecDocCacheTouch(node);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoNodeWrite", NULL);
+            return(-1);
+        }
+    }
+
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxProcessObjectNode:
+ *
+ * The Object Element (http://www.w3.org/TR/xmldsig-core/#sec-Object)
+ *
+ * Object is an optional element that may occur one or more times. When
+ * present, this element may contain any data. The Object element may include
+ * optional MIME type, ID, and encoding attributes.
+ *
+ * Schema Definition:
+ *
+ * <element name="Object" type="ds:ObjectType"/>
+ * <complexType name="ObjectType" mixed="true">
+ *   <sequence minOccurs="0" maxOccurs="unbounded">
+ *     <any namespace="##any" processContents="lax"/>
+ *   </sequence>
+ *   <attribute name="Id" type="ID" use="optional"/>
+ *   <attribute name="MimeType" type="string" use="optional"/>
+ *   <attribute name="Encoding" type="anyURI" use="optional"/>
+ * </complexType>
+ *
+ * DTD:
+ *
+ * <!ELEMENT Object (#PCDATA|Signature|SignatureProperties|Manifest %Object.ANY;)* >
+ * <!ATTLIST Object  Id  ID  #IMPLIED
+ *                   MimeType    CDATA   #IMPLIED
+ *                   Encoding    CDATA   #IMPLIED >
+ */
+static int
+xmlSecDSigCtxProcessObjectNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* we care about Manifest nodes only; ignore everything else */
+    cur = xmlSecGetNextElementNode(node->children);
+    while(cur != NULL) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeManifest, xmlSecDSigNs)) {
+            ret = xmlSecDSigCtxProcessManifestNode(dsigCtx, cur);
+            if(ret < 0){
+                xmlSecInternalError("xmlSecDSigCtxProcessManifestNode", NULL);
+                return(-1);
+            }
+        }
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxProcessManifestNode:
+ *
+ * The Manifest  Element (http://www.w3.org/TR/xmldsig-core/#sec-Manifest)
+ *
+ * The Manifest element provides a list of References. The difference from
+ * the list in SignedInfo is that it is application defined which, if any, of
+ * the digests are actually checked against the objects referenced and what to
+ * do if the object is inaccessible or the digest compare fails. If a Manifest
+ * is pointed to from SignedInfo, the digest over the Manifest itself will be
+ * checked by the core result validation behavior. The digests within such
+ * a Manifest are checked at the application's discretion. If a Manifest is
+ * referenced from another Manifest, even the overall digest of this two level
+ * deep Manifest might not be checked.
+ *
+ * Schema Definition:
+ *
+ * <element name="Manifest" type="ds:ManifestType"/>
+ * <complexType name="ManifestType">
+ *   <sequence>
+ *     <element ref="ds:Reference" maxOccurs="unbounded"/>
+ *   </sequence>
+ *   <attribute name="Id" type="ID" use="optional"/>
+ *  </complexType>
+ *
+ * DTD:
+ *
+ * <!ELEMENT Manifest (Reference+)  >
+ * <!ATTLIST Manifest Id ID  #IMPLIED >
+ */
+static int
+xmlSecDSigCtxProcessManifestNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigCtx->status == xmlSecDSigStatusUnknown, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* calculate references */
+    cur = xmlSecGetNextElementNode(node->children);
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES) != 0) && (cur != NULL)) {
+        return(xmlSecDSigCtxProcessReferencesParallel(dsigCtx, cur,
+                    xmlSecDSigReferenceOriginManifest));
+    }
+    while((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs))) {
+        /* create reference */
+        dsigRefCtx = xmlSecDSigCtxCreateReference(dsigCtx, xmlSecDSigReferenceOriginManifest);
+        if(dsigRefCtx == NULL) {
+            xmlSecInternalError("xmlSecDSigCtxCreateReference", NULL);
+            return(-1);
+        }
+
+        /* add to the list */
+        ret = xmlSecPtrListAdd(&(dsigCtx->manifestReferences), dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+            return(-1);
+        }
+
+        /* process */
+        ret = xmlSecDSigReferenceCtxProcessNode(dsigRefCtx, cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxProcessNode",
+                                xmlSecNodeGetName(cur));
+            return(-1);
+        }
+
+        /* we don;t care if Reference processing failed because
+         * it's Manifest node */
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    /* we should have nothing else here */
+    if(cur != NULL) {
+        xmlSecUnexpectedNodeError(cur,  NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecDSigCtxDebugDump:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @output:             the pointer to output FILE.
+ *
+ * Prints the debug information about @dsigCtx to @output.
+ */
+void
+xmlSecDSigCtxDebugDump(xmlSecDSigCtxPtr dsigCtx, FILE* output) {
+    xmlSecAssert(dsigCtx != NULL);
+    xmlSecAssert(output != NULL);
+
+    if(dsigCtx->operation == xmlSecTransformOperationSign) {
+        fprintf(output, "= SIGNATURE CONTEXT\n");
+    } else {
+        fprintf(output, "= VERIFICATION CONTEXT\n");
+    }
+    switch(dsigCtx->status) {
+        case xmlSecDSigStatusUnknown:
+            fprintf(output, "== Status: unknown\n");
+            break;
+        case xmlSecDSigStatusSucceeded:
+            fprintf(output, "== Status: succeeded\n");
+            break;
+        case xmlSecDSigStatusInvalid:
+            fprintf(output, "== Status: invalid\n");
+            break;
+    }
+    fprintf(output, "== flags: 0x%08x\n", dsigCtx->flags);
+    fprintf(output, "== flags2: 0x%08x\n", dsigCtx->flags2);
+
+    if(dsigCtx->id != NULL) {
+        fprintf(output, "== Id: \"%s\"\n", dsigCtx->id);
+    }
+
+    fprintf(output, "== Key Info Read Ctx:\n");
+    xmlSecKeyInfoCtxDebugDump(&(dsigCtx->keyInfoReadCtx), output);
+    fprintf(output, "== Key Info Write Ctx:\n");
+    xmlSecKeyInfoCtxDebugDump(&(dsigCtx->keyInfoWriteCtx), output);
+
+    fprintf(output, "== Signature Transform Ctx:\n");
+    xmlSecTransformCtxDebugDump(&(dsigCtx->transformCtx), output);
+
+    if(dsigCtx->signMethod != NULL) {
+        fprintf(output, "== Signature Method:\n");
+        xmlSecTransformDebugDump(dsigCtx->signMethod, output);
+    }
+
+    if(dsigCtx->signKey != NULL) {
+        fprintf(output, "== Signature Key:\n");
+        xmlSecKeyDebugDump(dsigCtx->signKey, output);
+    }
+
+    fprintf(output, "== SignedInfo References List:\n");
+    xmlSecPtrListDebugDump(&(dsigCtx->signedInfoReferences), output);
+
+    fprintf(output, "== Manifest References List:\n");
+    xmlSecPtrListDebugDump(&(dsigCtx->manifestReferences), output);
+
+    if((dsigCtx->result != NULL) &&
+       (xmlSecBufferGetData(dsigCtx->result) != NULL)) {
+
+        fprintf(output, "== Result - start buffer:\n");
+        (void)fwrite(xmlSecBufferGetData(dsigCtx->result),
+                     xmlSecBufferGetSize(dsigCtx->result),
+                     1, output);
+        fprintf(output, "\n== Result - end buffer\n");
+    }
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) &&
+       (xmlSecDSigCtxGetPreSignBuffer(dsigCtx) != NULL) &&
+       (xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)) != NULL)) {
+
+        fprintf(output, "== PreSigned data - start buffer:\n");
+        (void)fwrite(xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
+                     xmlSecBufferGetSize(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
+                     1, output);
+        fprintf(output, "\n== PreSigned data - end buffer\n");
+    }
+}
+
+/**
+ * xmlSecDSigCtxDebugXmlDump:
+ * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
+ * @output:             the pointer to output FILE.
+ *
+ * Prints the debug information about @dsigCtx to @output in XML format.
+ */
+void
+xmlSecDSigCtxDebugXmlDump(xmlSecDSigCtxPtr dsigCtx, FILE* output) {
+    xmlSecAssert(dsigCtx != NULL);
+    xmlSecAssert(output != NULL);
+
+    if(dsigCtx->operation == xmlSecTransformOperationSign) {
+        fprintf(output, "<SignatureContext \n");
+    } else {
+        fprintf(output, "<VerificationContext \n");
+    }
+    switch(dsigCtx->status) {
+        case xmlSecDSigStatusUnknown:
+            fprintf(output, "status=\"unknown\" >\n");
+            break;
+        case xmlSecDSigStatusSucceeded:
+            fprintf(output, "status=\"succeeded\" >\n");
+            break;
+        case xmlSecDSigStatusInvalid:
+            fprintf(output, "status=\"invalid\" >\n");
+            break;
+    }
+
+    fprintf(output, "<Flags>%08x</Flags>\n", dsigCtx->flags);
+    fprintf(output, "<Flags2>%08x</Flags2>\n", dsigCtx->flags2);
+
+    fprintf(output, "<Id>");
+    xmlSecPrintXmlString(output, dsigCtx->id);
+    fprintf(output, "</Id>\n");
+
+    fprintf(output, "<KeyInfoReadCtx>\n");
+    xmlSecKeyInfoCtxDebugXmlDump(&(dsigCtx->keyInfoReadCtx), output);
+    fprintf(output, "</KeyInfoReadCtx>\n");
+
+    fprintf(output, "<KeyInfoWriteCtx>\n");
+    xmlSecKeyInfoCtxDebugXmlDump(&(dsigCtx->keyInfoWriteCtx), output);
+    fprintf(output, "</KeyInfoWriteCtx>\n");
+
+    fprintf(output, "<SignatureTransformCtx>\n");
+    xmlSecTransformCtxDebugXmlDump(&(dsigCtx->transformCtx), output);
+    fprintf(output, "</SignatureTransformCtx>\n");
+
+    if(dsigCtx->signMethod != NULL) {
+        fprintf(output, "<SignatureMethod>\n");
+        xmlSecTransformDebugXmlDump(dsigCtx->signMethod, output);
+        fprintf(output, "</SignatureMethod>\n");
+    }
+
+    if(dsigCtx->signKey != NULL) {
+        fprintf(output, "<SignatureKey>\n");
+        xmlSecKeyDebugXmlDump(dsigCtx->signKey, output);
+        fprintf(output, "</SignatureKey>\n");
+    }
+
+    fprintf(output, "<SignedInfoReferences>\n");
+    xmlSecPtrListDebugXmlDump(&(dsigCtx->signedInfoReferences), output);
+    fprintf(output, "</SignedInfoReferences>\n");
+
+    fprintf(output, "<ManifestReferences>\n");
+    xmlSecPtrListDebugXmlDump(&(dsigCtx->manifestReferences), output);
+    fprintf(output, "</ManifestReferences>\n");
+
+    if((dsigCtx->result != NULL) &&
+       (xmlSecBufferGetData(dsigCtx->result) != NULL)) {
+
+        fprintf(output, "<Result>");
+        (void)fwrite(xmlSecBufferGetData(dsigCtx->result),
+                     xmlSecBufferGetSize(dsigCtx->result),
+                     1, output);
+        fprintf(output, "</Result>\n");
+    }
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) &&
+       (xmlSecDSigCtxGetPreSignBuffer(dsigCtx) != NULL) &&
+       (xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)) != NULL)) {
+
+        fprintf(output, "<PreSignedData>");
+        (void)fwrite(xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
+                     xmlSecBufferGetSize(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
+                     1, output);
+        fprintf(output, "</PreSignedData>\n");
+    }
+
+    if(dsigCtx->operation == xmlSecTransformOperationSign) {
+        fprintf(output, "</SignatureContext>\n");
+    } else {
+        fprintf(output, "</VerificationContext>\n");
+    }
+}
+
+/**************************************************************************
+ *
+ * xmlSecDSigTemplate
+ *
+ *************************************************************************/
+/**
+ * xmlSecDSigTemplateCreate:
+ * @tmpl:               the pointer to <dsig:Signature/> node with signature template.
+ *
+ * Resolves the transforms algorithms used in the @tmpl once so that many
+ * documents created from the same template could be signed with
+ * #xmlSecDSigCtxSignWithTemplate without looking up the transforms
+ * registry for each of them. The caller is responsible for destroying
+ * the returned object with #xmlSecDSigTemplateDestroy function.
+ *
+ * Returns: the pointer to the compiled template or NULL if an error occurs.
+ */
+xmlSecDSigTemplatePtr
+xmlSecDSigTemplateCreate(xmlNodePtr tmpl) {
+    xmlSecDSigTemplatePtr compiledTmpl;
+    xmlNodePtr signedInfoNode;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(tmpl != NULL, NULL);
+
+    if(!xmlSecCheckNodeName(tmpl, xmlSecNodeSignature, xmlSecDSigNs)) {
+        xmlSecInvalidNodeError(tmpl, xmlSecNodeSignature, NULL);
+        return(NULL);
+    }
+
+    compiledTmpl = (xmlSecDSigTemplatePtr)xmlMalloc(sizeof(xmlSecDSigTemplate));
+    if(compiledTmpl == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDSigTemplate), NULL);
+        return(NULL);
+    }
+    memset(compiledTmpl, 0, sizeof(xmlSecDSigTemplate));
+
+    compiledTmpl->plan = xmlSecTransformPlanCreate();
+    if(compiledTmpl->plan == NULL) {
+        xmlSecInternalError("xmlSecTransformPlanCreate", NULL);
+        xmlSecDSigTemplateDestroy(compiledTmpl);
+        return(NULL);
+    }
+
+    /* <dsig:SignedInfo/> */
+    signedInfoNode = xmlSecGetNextElementNode(tmpl->children);
+    if((signedInfoNode == NULL) || (!xmlSecCheckNodeName(signedInfoNode, xmlSecNodeSignedInfo, xmlSecDSigNs))) {
+        xmlSecInvalidNodeError(signedInfoNode, xmlSecNodeSignedInfo, NULL);
+        xmlSecDSigTemplateDestroy(compiledTmpl);
+        return(NULL);
+    }
+
+    cur = xmlSecGetNextElementNode(signedInfoNode->children);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeCanonicalizationMethod, xmlSecDSigNs))) {
+        ret = xmlSecTransformPlanAddNode(compiledTmpl->plan, cur, xmlSecTransformUsageC14NMethod);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPlanAddNode(CanonicalizationMethod)", NULL);
+            xmlSecDSigTemplateDestroy(compiledTmpl);
+            return(NULL);
+        }
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeSignatureMethod, xmlSecDSigNs))) {
+        ret = xmlSecTransformPlanAddNode(compiledTmpl->plan, cur, xmlSecTransformUsageSignatureMethod);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPlanAddNode(SignatureMethod)", NULL);
+            xmlSecDSigTemplateDestroy(compiledTmpl);
+            return(NULL);
+        }
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    ret = xmlSecDSigTemplateAddReferences(compiledTmpl, cur);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigTemplateAddReferences(SignedInfo)", NULL);
+        xmlSecDSigTemplateDestroy(compiledTmpl);
+        return(NULL);
+    }
+
+    /* <dsig:Object/> nodes might have <dsig:Manifest/> with more references */
+    for(cur = xmlSecGetNextElementNode(signedInfoNode->next); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        xmlNodePtr manifestNode;
+
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeObject, xmlSecDSigNs)) {
+            continue;
+        }
+        for(manifestNode = xmlSecGetNextElementNode(cur->children); manifestNode != NULL; manifestNode = xmlSecGetNextElementNode(manifestNode->next)) {
+            if(!xmlSecCheckNodeName(manifestNode, xmlSecNodeManifest, xmlSecDSigNs)) {
+                continue;
+            }
+            ret = xmlSecDSigTemplateAddReferences(compiledTmpl, xmlSecGetNextElementNode(manifestNode->children));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDSigTemplateAddReferences(Manifest)", NULL);
+                xmlSecDSigTemplateDestroy(compiledTmpl);
+                return(NULL);
+            }
+        }
+    }
+
+    return(compiledTmpl);
+}
+
+/**
+ * xmlSecDSigTemplateDestroy:
+ * @compiledTmpl:       the pointer to compiled signature template.
+ *
+ * Destroys the template created with #xmlSecDSigTemplateCreate function.
+ */
+void
+xmlSecDSigTemplateDestroy(xmlSecDSigTemplatePtr compiledTmpl) {
+    xmlSecAssert(compiledTmpl != NULL);
+
+    if(compiledTmpl->plan != NULL) {
+        xmlSecTransformPlanDestroy(compiledTmpl->plan);
+    }
+    memset(compiledTmpl, 0, sizeof(xmlSecDSigTemplate));
+    xmlFree(compiledTmpl);
+}
+
+static int
+xmlSecDSigTemplateAddReferences(xmlSecDSigTemplatePtr compiledTmpl, xmlNodePtr cur) {
+    xmlNodePtr node;
+    xmlNodePtr transformNode;
+    int ret;
+
+    xmlSecAssert2(compiledTmpl != NULL, -1);
+    xmlSecAssert2(compiledTmpl->plan != NULL, -1);
+
+    for(; cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            continue;
+        }
+
+        node = xmlSecGetNextElementNode(cur->children);
+        if((node != NULL) && (xmlSecCheckNodeName(node, xmlSecNodeTransforms, xmlSecDSigNs))) {
+            for(transformNode = xmlSecGetNextElementNode(node->children); transformNode != NULL; transformNode = xmlSecGetNextElementNode(transformNode->next)) {
+                if(!xmlSecCheckNodeName(transformNode, xmlSecNodeTransform, xmlSecDSigNs)) {
+                    continue;
+                }
+                ret = xmlSecTransformPlanAddNode(compiledTmpl->plan, transformNode, xmlSecTransformUsageDSigTransform);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecTransformPlanAddNode(Transform)", NULL);
+                    return(-1);
+                }
+            }
+            node = xmlSecGetNextElementNode(node->next);
+        }
+        if((node != NULL) && (xmlSecCheckNodeName(node, xmlSecNodeDigestMethod, xmlSecDSigNs))) {
+            ret = xmlSecTransformPlanAddNode(compiledTmpl->plan, node, xmlSecTransformUsageDigestMethod);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformPlanAddNode(DigestMethod)", NULL);
+                return(-1);
+            }
+        }
+    }
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * xmlSecDSigReferenceCtx
+ *
+ *************************************************************************/
+/**
+ * xmlSecDSigReferenceCtxCreate:
+ * @dsigCtx:            the pointer to parent <dsig:Signature/> node processing context.
+ * @origin:             the reference origin (<dsig:SignedInfo/> or <dsig:Manifest/> node).
+ *
+ * Creates new <dsig:Reference/> element processing context. Caller is responsible
+ * for destroying the returned context by calling #xmlSecDSigReferenceCtxDestroy
+ * function.
+ *
+ * Returns: pointer to newly created context or NULL if an error occurs.
+ */
+xmlSecDSigReferenceCtxPtr
+xmlSecDSigReferenceCtxCreate(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigReferenceOrigin origin) {
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, NULL);
+
+    dsigRefCtx = (xmlSecDSigReferenceCtxPtr) xmlMalloc(sizeof(xmlSecDSigReferenceCtx));
+    if(dsigRefCtx == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDSigReferenceCtx), NULL);
+        return(NULL);
+    }
+
+    ret = xmlSecDSigReferenceCtxInitialize(dsigRefCtx, dsigCtx, origin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxInitialize", NULL);
+        xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+        return(NULL);
+    }
+    return(dsigRefCtx);
+}
+
+/**
+ * xmlSecDSigReferenceCtxDestroy:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
+ *
+ * Destroy context object created with #xmlSecDSigReferenceCtxCreate function.
+ */
+void
+xmlSecDSigReferenceCtxDestroy(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecAssert(dsigRefCtx != NULL);
+
+    xmlSecDSigReferenceCtxFinalize(dsigRefCtx);
+    xmlFree(dsigRefCtx);
+}
+
+/**
+ * xmlSecDSigReferenceCtxInitialize:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
+ * @dsigCtx:            the pointer to parent <dsig:Signature/> node processing context.
+ * @origin:             the reference origin (<dsig:SignedInfo/> or <dsig:Manifest/> node).
+ *
+ * Initializes new <dsig:Reference/> element processing context. Caller is responsible
+ * for cleaning up the returned context by calling #xmlSecDSigReferenceCtxFinalize
+ * function.
+ *
+ * Returns: 0 on succes or aa negative value otherwise.
+ */
+int
+xmlSecDSigReferenceCtxInitialize(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlSecDSigCtxPtr dsigCtx,
+                                xmlSecDSigReferenceOrigin origin) {
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+
+    memset(dsigRefCtx, 0, sizeof(xmlSecDSigReferenceCtx));
+
+    /* initializes transforms dsigRefCtx */
+    ret = xmlSecTransformCtxInitialize(&(dsigRefCtx->transformCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxInitialize", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecDSigReferenceCtxSetup(dsigRefCtx, dsigCtx, origin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxSetup", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecDSigReferenceCtxSetup(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlSecDSigCtxPtr dsigCtx,
+                            xmlSecDSigReferenceOrigin origin) {
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx)) != NULL, -1);
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx)) != NULL, -1);
+
+    dsigRefCtx->dsigCtx = dsigCtx;
+    dsigRefCtx->origin = origin;
+
+    /* copy enabled transforms */
+    xmlSecPtrListEmpty(&(dsigRefCtx->transformCtx.enabledTransforms));
+    if(dsigCtx->enabledReferenceTransforms != NULL) {
+        ret = xmlSecPtrListCopy(&(dsigRefCtx->transformCtx.enabledTransforms),
+                                     dsigCtx->enabledReferenceTransforms);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListCopy", NULL);
+            return(-1);
+        }
+    }
+    dsigRefCtx->transformCtx.preExecCallback = dsigCtx->referencePreExecuteCallback;
+    dsigRefCtx->transformCtx.enabledUris = dsigCtx->enabledReferenceUris;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->plan =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->plan;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->prefetch =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->prefetch;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->maxTransforms =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->maxTransforms;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->maxDigestSize =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->maxDigestSize;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->maxXPathOps =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->maxXPathOps;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->maxMemSize =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->maxMemSize;
+    xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx))->attachmentResolver =
+        xmlSecTransformCtxGetPrivate(&(dsigCtx->transformCtx))->attachmentResolver;
+
+    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_USE_VISA3D_HACK) != 0) {
+        dsigRefCtx->transformCtx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_USE_VISA3D_HACK;
+    }
+    if((dsigCtx->transformCtx.flags & XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS) != 0) {
+        dsigRefCtx->transformCtx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS;
+    }
+    if((dsigCtx->transformCtx.flags & XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS) != 0) {
+        dsigRefCtx->transformCtx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_KEEP_NODE_SETS;
+    }
+    if((dsigCtx->transformCtx.flags & XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N) != 0) {
+        dsigRefCtx->transformCtx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N;
+    }
+    return(0);
+}
+
+/* same as xmlSecDSigReferenceCtxFinalize() but keeps the transforms context */
+static void
+xmlSecDSigReferenceCtxRelease(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecTransformCtx transformCtx;
+
+    xmlSecAssert(dsigRefCtx != NULL);
+    xmlSecAssert(xmlSecTransformCtxGetPrivate(&(dsigRefCtx->transformCtx)) != NULL);
+
+    xmlSecTransformCtxReset(&(dsigRefCtx->transformCtx));
+
+    /* drop the settings copied from dsig ctx, xmlSecDSigReferenceCtxSetup() sets them again */
+    transformCtx = dsigRefCtx->transformCtx;
+    transformCtx.flags = 0;
+    transformCtx.preExecCallback = NULL;
+    xmlSecTransformCtxGetPrivate(&transformCtx)->plan = NULL;
+    xmlSecTransformCtxGetPrivate(&transformCtx)->prefetch = NULL;
+    memset(dsigRefCtx, 0, sizeof(xmlSecDSigReferenceCtx));
+    dsigRefCtx->transformCtx = transformCtx;
+}
+
+/**
+ * xmlSecDSigReferenceCtxFinalize:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
+ *
+ * Cleans up context object created with #xmlSecDSigReferenceCtxInitialize function.
+ */
+void
+xmlSecDSigReferenceCtxFinalize(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecAssert(dsigRefCtx != NULL);
+
+    xmlSecTransformCtxFinalize(&(dsigRefCtx->transformCtx));
+    memset(dsigRefCtx, 0, sizeof(xmlSecDSigReferenceCtx));
+}
+
+/**
+ * xmlSecDSigReferenceCtxGetPreDigestBuffer:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
+ *
+ * Gets the results of <dsig:Reference/> node processing just before digesting
+ * (valid only if #XMLSEC_DSIG_FLAGS_STORE_SIGNEDINFO_REFERENCES or
+ * #XMLSEC_DSIG_FLAGS_STORE_MANIFEST_REFERENCES flas of signature context
+ * is set).
+ *
+ * Returns: pointer to the buffer or NULL if an error occurs.
+ */
+xmlSecBufferPtr
+xmlSecDSigReferenceCtxGetPreDigestBuffer(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecAssert2(dsigRefCtx != NULL, NULL);
+
+    return((dsigRefCtx->preDigestMemBufMethod != NULL) ?
+            xmlSecTransformMemBufGetBuffer(dsigRefCtx->preDigestMemBufMethod) : NULL);
+}
+
+/**
+ * xmlSecDSigReferenceCtxProcessNode:
+ * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
+ * @node:               the pointer to <dsig:Reference/> node.
+
+ * The Reference Element (http://www.w3.org/TR/xmldsig-core/#sec-Reference)
+ *
+ * Reference is an element that may occur one or more times. It specifies
+ * a digest algorithm and digest value, and optionally an identifier of the
+ * object being signed, the type of the object, and/or a list of transforms
+ * to be applied prior to digesting. The identification (URI) and transforms
+ * describe how the digested content (i.e., the input to the digest method)
+ * was created. The Type attribute facilitates the processing of referenced
+ * data. For example, while this specification makes no requirements over
+ * external data, an application may wish to signal that the referent is a
+ * Manifest. An optional ID attribute permits a Reference to be referenced
+ * from elsewhere.
+ *
+ * Returns: 0 on succes or aa negative value otherwise.
+ */
+int
+xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node) {
+    return(xmlSecDSigReferenceCtxProcess(dsigRefCtx, node, 1));
+}
+
+static int
+xmlSecDSigReferenceCtxProcess(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node, int writeDigestValue) {
+    void* span;
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
+
+    span = xmlSecTraceBegin(xmlSecTracePhaseReference, node, dsigRefCtx->dsigCtx->userData);
+    ret = xmlSecDSigReferenceCtxExecute(dsigRefCtx, node, writeDigestValue);
+    xmlSecTraceEnd(span, xmlSecTracePhaseReference, ret);
+    return(ret);
+}
+
+static int
+xmlSecDSigReferenceCtxExecute(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node, int writeDigestValue) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlNodePtr transformsNode = NULL;
+    xmlNodePtr digestValueNode;
+    xmlChar* cacheKey = NULL;
+    xmlChar* digestValue = NULL;
+    xmlNodePtr cacheRoot = NULL;
+    xmlNodePtr cacheExcluded = NULL;
+    xmlChar* ioKey = NULL;
+    char* ioUri = NULL;
+    xmlSecSize ioVersion = 0;
+    xmlSecSize generation = 0;
+    int useDocCache;
+    int precomputed = 0;
+    xmlNodePtr cur;
+    xmlSecArenaPtr arena;
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod == NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod == NULL, -1);
+    xmlSecAssert2(dsigRefCtx->preDigestMemBufMethod == NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+
+    transformCtx = &(dsigRefCtx->transformCtx);
+
+    /* read attributes first */
+    arena = xmlSecTransformCtxGetArena(transformCtx);
+    if(arena == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxGetArena", NULL);
+        return(-1);
+    }
+    dsigRefCtx->uri = xmlSecArenaGetProp(arena, node, xmlSecAttrURI);
+    dsigRefCtx->id  = xmlSecArenaGetProp(arena, node, xmlSecAttrId);
+    dsigRefCtx->type= xmlSecArenaGetProp(arena, node, xmlSecAttrType);
+
+    /* set start URI (and check that it is enabled!) */
+    ret = xmlSecTransformCtxSetUri(transformCtx, dsigRefCtx->uri, node);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformCtxSetUri", NULL,
+                             "uri=%s", xmlSecErrorsSafeString(dsigRefCtx->uri));
+        return(-1);
+    }
+
+    /* first is optional Transforms node */
+    cur  = xmlSecGetNextElementNode(node->children);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeTransforms, xmlSecDSigNs))) {
+        transformsNode = cur;
+        ret = xmlSecTransformCtxNodesListRead(transformCtx,
+                                        cur, xmlSecTransformUsageDSigTransform);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformCtxNodesListRead", NULL,
+                                 "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
+            return(-1);
+        }
+
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    /* insert membuf if requested */
+    if(((dsigRefCtx->origin == xmlSecDSigReferenceOriginSignedInfo) &&
+        ((dsigRefCtx->dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNEDINFO_REFERENCES) != 0)) ||
+       ((dsigRefCtx->origin == xmlSecDSigReferenceOriginManifest) &&
+        ((dsigRefCtx->dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_MANIFEST_REFERENCES) != 0))) {
+
+        xmlSecAssert2(dsigRefCtx->preDigestMemBufMethod == NULL, -1);
+        dsigRefCtx->preDigestMemBufMethod = xmlSecTransformCtxCreateAndAppend(
+                                                transformCtx,
+                                                xmlSecTransformMemBufId);
+        if(dsigRefCtx->preDigestMemBufMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend(xmlSecTransformMemBufId)", NULL);
+            return(-1);
+        }
+    }
+
+    /* next node is required DigestMethod. */
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeDigestMethod, xmlSecDSigNs))) {
+        dsigRefCtx->digestMethod = xmlSecTransformCtxNodeRead(&(dsigRefCtx->transformCtx),
+                                        cur, xmlSecTransformUsageDigestMethod);
+        if(dsigRefCtx->digestMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxNodeRead",
+                                xmlSecNodeGetName(cur));
+            return(-1);
+        }
+
+        cur = xmlSecGetNextElementNode(cur->next);
+    } else if(dsigRefCtx->dsigCtx->defSignMethodId != xmlSecTransformIdUnknown) {
+        /* the dsig spec does require DigestMethod node
+         * to be present but in some case it application might decide to
+         * minimize traffic */
+        dsigRefCtx->digestMethod = xmlSecTransformCtxCreateAndAppend(&(dsigRefCtx->transformCtx),
+                                                              dsigRefCtx->dsigCtx->defSignMethodId);
+        if(dsigRefCtx->digestMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
+            return(-1);
+        }
+    } else {
+        /* if digest method is not specified in the template and not specified in
+         * the dsig context then it's an error.
+         */
+        xmlSecInvalidNodeError(cur, xmlSecNodeDigestMethod, NULL);
+        return(-1);
+    }
+    dsigRefCtx->digestMethod->operation = dsigRefCtx->dsigCtx->operation;
+
+    /* last node is required DigestValue */
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeDigestValue, xmlSecDSigNs))) {
+        digestValueNode = cur;
+        cur = xmlSecGetNextElementNode(cur->next);
+    } else {
+        xmlSecInvalidNodeError(cur, xmlSecNodeDigestValue, NULL);
+        return(-1);
+    }
+
+    /* if we have something else then it's an error */
+    if(cur != NULL) {
+        xmlSecUnexpectedNodeError(cur,  NULL);
+        return(-1);
+    }
+
+    /* if we need to write result to xml node then we need base64 encode result */
+    if(dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) {
+        xmlSecTransformPtr base64Encode;
+
+        /* we need to add base64 encode transform */
+        base64Encode = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformBase64Id);
+        if(base64Encode == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend", NULL);
+            return(-1);
+        }
+        base64Encode->operation = xmlSecTransformOperationEncode;
+    }
+
+    /* the same reference was already verified in this batch */
+    useDocCache = xmlSecDocCacheGetGeneration(node->doc, &generation);
+    if((useDocCache != 0) || ((xmlSecDSigCtxGetDigestsCache(dsigRefCtx->dsigCtx) != NULL) &&
+       (dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationVerify))) {
+        cacheKey = xmlSecDSigReferenceCtxCacheKey(dsigRefCtx, node, transformsNode, &cacheExcluded);
+    }
+    if((cacheKey != NULL) && (dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationVerify)) {
+        digestValue = xmlNodeGetContent(digestValueNode);
+    }
+    if((cacheKey != NULL) && (digestValue != NULL) &&
+       (xmlSecDSigCtxGetDigestsCache(dsigRefCtx->dsigCtx) != NULL) &&
+       (xmlSecDSigDigestsCacheCheck(xmlSecDSigCtxGetDigestsCache(dsigRefCtx->dsigCtx),
+                                    cacheKey, digestValue) == 1)) {
+        dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
+        dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+        xmlFree(digestValue);
+        xmlFree(cacheKey);
+        return(0);
+    }
+
+    /* or signed or verified earlier in this document */
+    if((cacheKey != NULL) && (useDocCache != 0)) {
+        cacheRoot = xmlSecDSigReferenceCtxCacheRoot(dsigRefCtx, node->doc);
+    }
+    if((cacheRoot != NULL) && (digestValue != NULL)) {
+        ret = xmlSecDSigReferenceCtxDocCacheCheck(node->doc, cacheKey, cacheRoot, digestValue);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxDocCacheCheck", NULL);
+            goto error;
+        } else if(ret == 1) {
+            dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
+            dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+            xmlFree(digestValue);
+            xmlFree(cacheKey);
+            return(0);
+        }
+    }
+
+    /* re-signing: the digest of the reference not affected by the changes is kept */
+    if((dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) &&
+       (xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->changedNodes != NULL)) {
+        ret = xmlSecDSigReferenceCtxIsChanged(dsigRefCtx, node, digestValueNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxIsChanged", NULL);
+            goto error;
+        } else if(ret == 0) {
+            dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
+            dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+            if(cacheKey != NULL) {
+                xmlFree(cacheKey);
+            }
+            return(0);
+        }
+    }
+
+    /* or verified earlier with the same (not modified) external resource */
+    ioKey = xmlSecDSigReferenceCtxIOCacheKey(dsigRefCtx, transformsNode, &ioUri);
+    if((ioKey != NULL) && (digestValue == NULL)) {
+        digestValue = xmlNodeGetContent(digestValueNode);
+    }
+    if((ioKey != NULL) && (digestValue != NULL)) {
+        xmlChar* ioDigestValue = NULL;
+
+        ret = xmlSecIOCacheDigestFind(ioUri, ioKey, &ioDigestValue, &ioVersion);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecIOCacheDigestFind", NULL);
+            goto error;
+        } else if((ret == 1) && (xmlStrEqual(ioDigestValue, digestValue) == 1)) {
+            dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
+            dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+            xmlFree(ioDigestValue);
+            goto done;
+        }
+        if(ioDigestValue != NULL) {
+            xmlFree(ioDigestValue);
+        }
+    }
+
+    /* the application might already know the external object digest */
+    if((xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->referenceDigestCallback != NULL) && (dsigRefCtx->uri != NULL) &&
+       (dsigRefCtx->uri[0] != '\0') && (dsigRefCtx->uri[0] != '#')) {
+        precomputed = xmlSecDSigReferenceCtxDigestExecute(dsigRefCtx);
+        if(precomputed < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxDigestExecute", NULL);
+            goto error;
+        }
+    }
+
+    /* finally get transforms results: the reference to the whole document
+     * is computed over the file in xmlSecDSigCtxSignFile/VerifyFile() */
+    if(precomputed != 0) {
+        /* done */
+    } else if((xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->streamFilename != NULL) &&
+       (dsigRefCtx->uri != NULL) && (dsigRefCtx->uri[0] == '\0')) {
+        ret = xmlSecDSigReferenceCtxStreamExecute(dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxStreamExecute", NULL);
+            return(-1);
+        }
+    } else {
+        ret = xmlSecTransformCtxExecute(transformCtx, node->doc);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
+            goto error;
+        }
+    }
+    dsigRefCtx->result = transformCtx->result;
+
+    if(dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) {
+        if((dsigRefCtx->result == NULL) || (xmlSecBufferGetData(dsigRefCtx->result) == NULL)) {
+            xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
+            return(-1);
+        }
+
+        /* remember the digest before the document is modified */
+        if(cacheRoot != NULL) {
+            ret = xmlSecDocCacheAdd(node->doc, cacheKey, cacheRoot, cacheExcluded, generation,
+                                    xmlSecBufferGetData(dsigRefCtx->result),
+                                    xmlSecBufferGetSize(dsigRefCtx->result));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDocCacheAdd", NULL);
+                goto error;
+            }
+        }
+
+        /* write signed data to xml (unless the caller does it later) */
+        if(writeDigestValue != 0) {
+            xmlNodeSetContentLen(digestValueNode,
+                                xmlSecBufferGetData(dsigRefCtx->result),
+                                xmlSecBufferGetSize(dsigRefCtx->result));
+            xmlSecDocCacheTouch(digestValueNode);
+        }
+
+        /* set success status and we are done */
+        dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+    } else {
+        /* verify SignatureValue node content */
+        if(precomputed != 0) {
+            ret = xmlSecDSigReferenceCtxDigestVerify(dsigRefCtx, digestValueNode);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDSigReferenceCtxDigestVerify", NULL);
+                goto error;
+            }
+        } else {
+            ret = xmlSecTransformVerifyNodeContent(dsigRefCtx->digestMethod,
+                                digestValueNode, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
+                goto error;
+            }
+        }
+
+        /* set status and we are done */
+        if(dsigRefCtx->digestMethod->status == xmlSecTransformStatusOk) {
+            dsigRefCtx->status = xmlSecDSigStatusSucceeded;
+        } else {
+            dsigRefCtx->status = xmlSecDSigStatusInvalid;
+        }
+
+        /* remember the verified digest value (the batch cache takes it) */
+        if((ioKey != NULL) && (digestValue != NULL) &&
+           (dsigRefCtx->status == xmlSecDSigStatusSucceeded)) {
+            ret = xmlSecIOCacheDigestAdd(ioUri, ioVersion, ioKey, digestValue);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecIOCacheDigestAdd", NULL);
+                goto error;
+            }
+        }
+        if((cacheRoot != NULL) && (digestValue != NULL) &&
+           (dsigRefCtx->status == xmlSecDSigStatusSucceeded)) {
+            ret = xmlSecDocCacheAdd(node->doc, cacheKey, cacheRoot, cacheExcluded, generation,
+                                    digestValue, (xmlSecSize)xmlStrlen(digestValue));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecDocCacheAdd", NULL);
+                goto error;
+            }
+        }
+        if((cacheKey != NULL) && (digestValue != NULL) &&
+           (xmlSecDSigCtxGetDigestsCache(dsigRefCtx->dsigCtx) != NULL) &&
+           (dsigRefCtx->status == xmlSecDSigStatusSucceeded)) {
+            if(xmlSecDSigDigestsCacheAdd(xmlSecDSigCtxGetDigestsCache(dsigRefCtx->dsigCtx),
+                                         cacheKey, digestValue) == 0) {
+                digestValue = NULL;
+            }
+        }
     }
-    fprintf(output, "== flags: 0x%08x\n", dsigCtx->flags);
-    fprintf(output, "== flags2: 0x%08x\n", dsigCtx->flags2);
 
-    if(dsigCtx->id != NULL) {
-        fprintf(output, "== Id: \"%s\"\n", dsigCtx->id);
+done:
+    if(digestValue != NULL) {
+        xmlFree(digestValue);
     }
-
-    fprintf(output, "== Key Info Read Ctx:\n");
-    xmlSecKeyInfoCtxDebugDump(&(dsigCtx->keyInfoReadCtx), output);
-    fprintf(output, "== Key Info Write Ctx:\n");
-    xmlSecKeyInfoCtxDebugDump(&(dsigCtx->keyInfoWriteCtx), output);
-
-    fprintf(output, "== Signature Transform Ctx:\n");
-    xmlSecTransformCtxDebugDump(&(dsigCtx->transformCtx), output);
-
-    if(dsigCtx->signMethod != NULL) {
-        fprintf(output, "== Signature Method:\n");
-        xmlSecTransformDebugDump(dsigCtx->signMethod, output);
+    if(cacheKey != NULL) {
+        xmlFree(cacheKey);
     }
-
-    if(dsigCtx->signKey != NULL) {
-        fprintf(output, "== Signature Key:\n");
-        xmlSecKeyDebugDump(dsigCtx->signKey, output);
+    if(ioKey != NULL) {
+        xmlFree(ioKey);
     }
-
-    fprintf(output, "== SignedInfo References List:\n");
-    xmlSecPtrListDebugDump(&(dsigCtx->signedInfoReferences), output);
-
-    fprintf(output, "== Manifest References List:\n");
-    xmlSecPtrListDebugDump(&(dsigCtx->manifestReferences), output);
-
-    if((dsigCtx->result != NULL) &&
-       (xmlSecBufferGetData(dsigCtx->result) != NULL)) {
-
-        fprintf(output, "== Result - start buffer:\n");
-        (void)fwrite(xmlSecBufferGetData(dsigCtx->result),
-                     xmlSecBufferGetSize(dsigCtx->result),
-                     1, output);
-        fprintf(output, "\n== Result - end buffer\n");
+    if(ioUri != NULL) {
+        xmlFree(ioUri);
     }
-    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) &&
-       (xmlSecDSigCtxGetPreSignBuffer(dsigCtx) != NULL) &&
-       (xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)) != NULL)) {
+    return(0);
 
-        fprintf(output, "== PreSigned data - start buffer:\n");
-        (void)fwrite(xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
-                     xmlSecBufferGetSize(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
-                     1, output);
-        fprintf(output, "\n== PreSigned data - end buffer\n");
+error:
+    if(digestValue != NULL) {
+        xmlFree(digestValue);
     }
-}
-
-/**
- * xmlSecDSigCtxDebugXmlDump:
- * @dsigCtx:            the pointer to <dsig:Signature/> processing context.
- * @output:             the pointer to output FILE.
- *
- * Prints the debug information about @dsigCtx to @output in XML format.
- */
-void
-xmlSecDSigCtxDebugXmlDump(xmlSecDSigCtxPtr dsigCtx, FILE* output) {
-    xmlSecAssert(dsigCtx != NULL);
-    xmlSecAssert(output != NULL);
-
-    if(dsigCtx->operation == xmlSecTransformOperationSign) {
-        fprintf(output, "<SignatureContext \n");
-    } else {
-        fprintf(output, "<VerificationContext \n");
+    if(cacheKey != NULL) {
+        xmlFree(cacheKey);
     }
-    switch(dsigCtx->status) {
-        case xmlSecDSigStatusUnknown:
-            fprintf(output, "status=\"unknown\" >\n");
-            break;
-        case xmlSecDSigStatusSucceeded:
-            fprintf(output, "status=\"succeeded\" >\n");
-            break;
-        case xmlSecDSigStatusInvalid:
-            fprintf(output, "status=\"invalid\" >\n");
-            break;
+    if(ioKey != NULL) {
+        xmlFree(ioKey);
     }
+    if(ioUri != NULL) {
+        xmlFree(ioUri);
+    }
+    return(-1);
+}
 
-    fprintf(output, "<Flags>%08x</Flags>\n", dsigCtx->flags);
-    fprintf(output, "<Flags2>%08x</Flags2>\n", dsigCtx->flags2);
-
-    fprintf(output, "<Id>");
-    xmlSecPrintXmlString(output, dsigCtx->id);
-    fprintf(output, "</Id>\n");
-
-    fprintf(output, "<KeyInfoReadCtx>\n");
-    xmlSecKeyInfoCtxDebugXmlDump(&(dsigCtx->keyInfoReadCtx), output);
-    fprintf(output, "</KeyInfoReadCtx>\n");
+/*
+ * Asks the application for the precomputed digest and pushes it to the
+ * transforms after the digest method (as if the digest method produced it).
+ * Returns 1 if the digest is supplied, 0 if not or a negative value if
+ * an error occurs.
+ */
+static int
+xmlSecDSigReferenceCtxDigestExecute(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecBuffer digest;
+    int res = -1;
+    int ret;
 
-    fprintf(output, "<KeyInfoWriteCtx>\n");
-    xmlSecKeyInfoCtxDebugXmlDump(&(dsigCtx->keyInfoWriteCtx), output);
-    fprintf(output, "</KeyInfoWriteCtx>\n");
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->referenceDigestCallback != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, -1);
 
-    fprintf(output, "<SignatureTransformCtx>\n");
-    xmlSecTransformCtxDebugXmlDump(&(dsigCtx->transformCtx), output);
-    fprintf(output, "</SignatureTransformCtx>\n");
+    transformCtx = &(dsigRefCtx->transformCtx);
+    ret = xmlSecBufferInitialize(&digest, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
 
-    if(dsigCtx->signMethod != NULL) {
-        fprintf(output, "<SignatureMethod>\n");
-        xmlSecTransformDebugXmlDump(dsigCtx->signMethod, output);
-        fprintf(output, "</SignatureMethod>\n");
+    ret = (xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->referenceDigestCallback)(dsigRefCtx, &digest);
+    if(ret < 0) {
+        xmlSecInternalError2("referenceDigestCallback", NULL,
+                             "uri=%s", xmlSecErrorsSafeString(dsigRefCtx->uri));
+        goto done;
+    } else if((ret == 0) || (xmlSecBufferGetSize(&digest) == 0)) {
+        res = 0;
+        goto done;
     }
 
-    if(dsigCtx->signKey != NULL) {
-        fprintf(output, "<SignatureKey>\n");
-        xmlSecKeyDebugXmlDump(dsigCtx->signKey, output);
-        fprintf(output, "</SignatureKey>\n");
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        goto done;
+    }
+    xmlSecAssert2(dsigRefCtx->digestMethod->next != NULL, -1);
+    ret = xmlSecTransformPushBin(dsigRefCtx->digestMethod->next, xmlSecBufferGetData(&digest),
+                                 xmlSecBufferGetSize(&digest), 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin",
+                            xmlSecTransformGetName(dsigRefCtx->digestMethod->next));
+        goto done;
     }
+    transformCtx->status = xmlSecTransformStatusFinished;
+    res = 1;
 
-    fprintf(output, "<SignedInfoReferences>\n");
-    xmlSecPtrListDebugXmlDump(&(dsigCtx->signedInfoReferences), output);
-    fprintf(output, "</SignedInfoReferences>\n");
+done:
+    xmlSecBufferFinalize(&digest);
+    return(res);
+}
 
-    fprintf(output, "<ManifestReferences>\n");
-    xmlSecPtrListDebugXmlDump(&(dsigCtx->manifestReferences), output);
-    fprintf(output, "</ManifestReferences>\n");
+/*
+ * Compares the precomputed digest (the transforms result) with
+ * the <dsig:DigestValue/> node content.
+ */
+static int
+xmlSecDSigReferenceCtxDigestVerify(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr digestValueNode) {
+    xmlSecByte digest[XMLSEC_DSIG_DIGEST_STACK_SIZE];
+    xmlSecSize digestSize;
+    xmlSecBuffer buffer;
+    int ret;
 
-    if((dsigCtx->result != NULL) &&
-       (xmlSecBufferGetData(dsigCtx->result) != NULL)) {
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->result != NULL, -1);
+    xmlSecAssert2(digestValueNode != NULL, -1);
 
-        fprintf(output, "<Result>");
-        (void)fwrite(xmlSecBufferGetData(dsigCtx->result),
-                     xmlSecBufferGetSize(dsigCtx->result),
-                     1, output);
-        fprintf(output, "</Result>\n");
+    ret = xmlSecBase64NodeContentDecode(digestValueNode, digest, sizeof(digest), &digestSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64NodeContentDecode", NULL);
+        return(-1);
+    } else if(ret > 0) {
+        if((digestSize == xmlSecBufferGetSize(dsigRefCtx->result)) &&
+           (memcmp(digest, xmlSecBufferGetData(dsigRefCtx->result), digestSize) == 0)) {
+            dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
+        } else {
+            dsigRefCtx->digestMethod->status = xmlSecTransformStatusFail;
+        }
+        return(0);
     }
-    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNATURE) != 0) &&
-       (xmlSecDSigCtxGetPreSignBuffer(dsigCtx) != NULL) &&
-       (xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)) != NULL)) {
 
-        fprintf(output, "<PreSignedData>");
-        (void)fwrite(xmlSecBufferGetData(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
-                     xmlSecBufferGetSize(xmlSecDSigCtxGetPreSignBuffer(dsigCtx)),
-                     1, output);
-        fprintf(output, "</PreSignedData>\n");
+    ret = xmlSecBufferInitialize(&buffer, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
+    ret = xmlSecBufferBase64NodeContentRead(&buffer, digestValueNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferBase64NodeContentRead", NULL);
+        xmlSecBufferFinalize(&buffer);
+        return(-1);
     }
 
-    if(dsigCtx->operation == xmlSecTransformOperationSign) {
-        fprintf(output, "</SignatureContext>\n");
+    if((xmlSecBufferGetSize(&buffer) == xmlSecBufferGetSize(dsigRefCtx->result)) &&
+       (memcmp(xmlSecBufferGetData(&buffer), xmlSecBufferGetData(dsigRefCtx->result),
+               xmlSecBufferGetSize(&buffer)) == 0)) {
+        dsigRefCtx->digestMethod->status = xmlSecTransformStatusOk;
     } else {
-        fprintf(output, "</VerificationContext>\n");
+        dsigRefCtx->digestMethod->status = xmlSecTransformStatusFail;
     }
+    xmlSecBufferFinalize(&buffer);
+    return(0);
 }
 
-/**************************************************************************
- *
- * xmlSecDSigReferenceCtx
- *
- *************************************************************************/
-/**
- * xmlSecDSigReferenceCtxCreate:
- * @dsigCtx:            the pointer to parent <dsig:Signature/> node processing context.
- * @origin:             the reference origin (<dsig:SignedInfo/> or <dsig:Manifest/> node).
- *
- * Creates new <dsig:Reference/> element processing context. Caller is responsible
- * for destroying the returned context by calling #xmlSecDSigReferenceCtxDestroy
- * function.
- *
- * Returns: pointer to newly created context or NULL if an error occurs.
- */
-xmlSecDSigReferenceCtxPtr
-xmlSecDSigReferenceCtxCreate(xmlSecDSigCtxPtr dsigCtx, xmlSecDSigReferenceOrigin origin) {
-    xmlSecDSigReferenceCtxPtr dsigRefCtx;
-    int ret;
+static void
+xmlSecDSigDigestsCacheItemDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlFree(payload);
+    }
+}
 
-    xmlSecAssert2(dsigCtx != NULL, NULL);
+static xmlSecDSigDigestsCachePtr
+xmlSecDSigDigestsCacheCreate(void) {
+    xmlSecDSigDigestsCachePtr cache;
 
-    dsigRefCtx = (xmlSecDSigReferenceCtxPtr) xmlMalloc(sizeof(xmlSecDSigReferenceCtx));
-    if(dsigRefCtx == NULL) {
-        xmlSecMallocError(sizeof(xmlSecDSigReferenceCtx), NULL);
+    cache = (xmlSecDSigDigestsCachePtr)xmlMalloc(sizeof(xmlSecDSigDigestsCache));
+    if(cache == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDSigDigestsCache), NULL);
         return(NULL);
     }
+    memset(cache, 0, sizeof(xmlSecDSigDigestsCache));
 
-    ret = xmlSecDSigReferenceCtxInitialize(dsigRefCtx, dsigCtx, origin);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecDSigReferenceCtxInitialize", NULL);
-        xmlSecDSigReferenceCtxDestroy(dsigRefCtx);
+    cache->items = xmlHashCreate(0);
+    if(cache->items == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        xmlSecDSigDigestsCacheDestroy(cache);
         return(NULL);
     }
-    return(dsigRefCtx);
+    cache->mutex = xmlNewMutex();
+    if(cache->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlSecDSigDigestsCacheDestroy(cache);
+        return(NULL);
+    }
+    return(cache);
 }
 
-/**
- * xmlSecDSigReferenceCtxDestroy:
- * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
- *
- * Destroy context object created with #xmlSecDSigReferenceCtxCreate function.
- */
-void
-xmlSecDSigReferenceCtxDestroy(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
-    xmlSecAssert(dsigRefCtx != NULL);
+static void
+xmlSecDSigDigestsCacheDestroy(xmlSecDSigDigestsCachePtr cache) {
+    if(cache == NULL) {
+        return;
+    }
+    if(cache->items != NULL) {
+        xmlHashFree(cache->items, xmlSecDSigDigestsCacheItemDestroy);
+    }
+    if(cache->mutex != NULL) {
+        xmlFreeMutex(cache->mutex);
+    }
+    xmlFree(cache);
+}
 
-    xmlSecDSigReferenceCtxFinalize(dsigRefCtx);
-    xmlFree(dsigRefCtx);
+/* returns 1 if @digestValue was already verified for @key, 0 otherwise */
+static int
+xmlSecDSigDigestsCacheCheck(xmlSecDSigDigestsCachePtr cache, const xmlChar* key,
+                            const xmlChar* digestValue) {
+    const xmlChar* cached;
+    int res;
+
+    xmlSecAssert2(cache != NULL, 0);
+    xmlSecAssert2(key != NULL, 0);
+    xmlSecAssert2(digestValue != NULL, 0);
+
+    xmlMutexLock(cache->mutex);
+    cached = (const xmlChar*)xmlHashLookup(cache->items, key);
+    res = ((cached != NULL) && xmlStrEqual(cached, digestValue)) ? 1 : 0;
+    xmlMutexUnlock(cache->mutex);
+
+    return(res);
 }
 
-/**
- * xmlSecDSigReferenceCtxInitialize:
- * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
- * @dsigCtx:            the pointer to parent <dsig:Signature/> node processing context.
- * @origin:             the reference origin (<dsig:SignedInfo/> or <dsig:Manifest/> node).
- *
- * Initializes new <dsig:Reference/> element processing context. Caller is responsible
- * for cleaning up the returned context by calling #xmlSecDSigReferenceCtxFinalize
- * function.
- *
- * Returns: 0 on succes or aa negative value otherwise.
- */
-int
-xmlSecDSigReferenceCtxInitialize(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlSecDSigCtxPtr dsigCtx,
-                                xmlSecDSigReferenceOrigin origin) {
+/* takes @digestValue on success */
+static int
+xmlSecDSigDigestsCacheAdd(xmlSecDSigDigestsCachePtr cache, const xmlChar* key,
+                          xmlChar* digestValue) {
     int ret;
 
-    xmlSecAssert2(dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(cache != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(digestValue != NULL, -1);
 
-    memset(dsigRefCtx, 0, sizeof(xmlSecDSigReferenceCtx));
+    xmlMutexLock(cache->mutex);
+    ret = xmlHashUpdateEntry(cache->items, key, digestValue, xmlSecDSigDigestsCacheItemDestroy);
+    xmlMutexUnlock(cache->mutex);
 
-    dsigRefCtx->dsigCtx = dsigCtx;
-    dsigRefCtx->origin = origin;
+    return((ret == 0) ? 0 : -1);
+}
 
-    /* initializes transforms dsigRefCtx */
-    ret = xmlSecTransformCtxInitialize(&(dsigRefCtx->transformCtx));
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformCtxInitialize", NULL);
-        return(-1);
+/*
+ * Returns the key of the reference in the digests caches or NULL if
+ * the reference result might depend on something but the document
+ * content: the reference location (XPath here() function, ...), the
+ * external resources or the application callbacks. The <dsig:Signature/>
+ * node excluded by the enveloped signature transform is returned in
+ * @excluded (NULL if there is no such transform).
+ */
+static xmlChar*
+xmlSecDSigReferenceCtxCacheKey(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node,
+                               xmlNodePtr transformsNode, xmlNodePtr* excluded) {
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlNodePtr signatureNode = NULL;
+    xmlBufferPtr buf;
+    xmlChar* key;
+    char doc[64];
+
+    xmlSecAssert2(dsigRefCtx != NULL, NULL);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, NULL);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(excluded != NULL, NULL);
+
+    dsigCtx = dsigRefCtx->dsigCtx;
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES) != 0) ||
+       (xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename != NULL) ||
+       (dsigCtx->referencePreExecuteCallback != NULL) ||
+       (dsigRefCtx->preDigestMemBufMethod != NULL)) {
+        return(NULL);
     }
 
-    /* copy enabled transforms */
-    if(dsigCtx->enabledReferenceTransforms != NULL) {
-        ret = xmlSecPtrListCopy(&(dsigRefCtx->transformCtx.enabledTransforms),
-                                     dsigCtx->enabledReferenceTransforms);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecPtrListCopy", NULL);
-            return(-1);
+    if(xmlSecDSigReferenceCtxCheckTransforms(dsigRefCtx, node, &signatureNode) != 1) {
+        return(NULL);
+    }
+
+    buf = xmlBufferCreate();
+    if(buf == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(NULL);
+    }
+    (void)xmlStrPrintf(BAD_CAST doc, sizeof(doc), "%p\n", (void*)node->doc);
+    xmlBufferCat(buf, BAD_CAST doc);
+    xmlBufferCat(buf, dsigRefCtx->uri);
+    xmlBufferCat(buf, BAD_CAST "\n");
+    xmlBufferCat(buf, dsigRefCtx->digestMethod->id->href);
+    xmlBufferCat(buf, BAD_CAST "\n");
+    if(signatureNode != NULL) {
+        (void)xmlStrPrintf(BAD_CAST doc, sizeof(doc), "%p\n", (void*)signatureNode);
+        xmlBufferCat(buf, BAD_CAST doc);
+    }
+    if(transformsNode != NULL) {
+        if(xmlNodeDump(buf, transformsNode->doc, transformsNode, 0, 0) < 0) {
+            xmlSecXmlError("xmlNodeDump", NULL);
+            xmlBufferFree(buf);
+            return(NULL);
         }
     }
-    dsigRefCtx->transformCtx.preExecCallback = dsigCtx->referencePreExecuteCallback;
-    dsigRefCtx->transformCtx.enabledUris = dsigCtx->enabledReferenceUris;
 
-    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_USE_VISA3D_HACK) != 0) {
-        dsigRefCtx->transformCtx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_USE_VISA3D_HACK;
+    key = xmlStrdup(xmlBufferContent(buf));
+    if(key == NULL) {
+        xmlSecStrdupError(xmlBufferContent(buf), NULL);
     }
-    return(0);
+    xmlBufferFree(buf);
+    (*excluded) = signatureNode;
+    return(key);
 }
 
-/**
- * xmlSecDSigReferenceCtxFinalize:
- * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
- *
- * Cleans up context object created with #xmlSecDSigReferenceCtxInitialize function.
+/*
+ * Returns the key for the digest of the external resource (see
+ * xmlSecIOCacheDigestFind): the digest method and the transforms that
+ * only depend on the resource (c14n and base64), or NULL if the digest
+ * can't be cached. The unescaped resource URI is returned in @ioUri.
  */
-void
-xmlSecDSigReferenceCtxFinalize(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
-    xmlSecAssert(dsigRefCtx != NULL);
+static xmlChar*
+xmlSecDSigReferenceCtxIOCacheKey(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr transformsNode,
+                                 char** ioUri) {
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr transform;
+    xmlBufferPtr buf;
+    xmlChar* key;
 
-    xmlSecTransformCtxFinalize(&(dsigRefCtx->transformCtx));
-    if(dsigRefCtx->id != NULL) {
-        xmlFree(dsigRefCtx->id);
+    xmlSecAssert2(dsigRefCtx != NULL, NULL);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, NULL);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, NULL);
+    xmlSecAssert2(ioUri != NULL, NULL);
+
+    (*ioUri) = NULL;
+    dsigCtx = dsigRefCtx->dsigCtx;
+    transformCtx = &(dsigRefCtx->transformCtx);
+    if((dsigCtx->operation != xmlSecTransformOperationVerify) ||
+       (xmlSecDSigCtxGetPrivate(dsigCtx)->streamFilename != NULL) ||
+       (xmlSecDSigCtxGetPrivate(dsigCtx)->referenceDigestCallback != NULL) ||
+       (dsigCtx->referencePreExecuteCallback != NULL) ||
+       (dsigRefCtx->preDigestMemBufMethod != NULL) ||
+       (transformCtx->uri == NULL) || (transformCtx->xptrExpr != NULL) ||
+       (xmlSecIOCacheMatch((const char*)transformCtx->uri) == 0)) {
+        return(NULL);
     }
-    if(dsigRefCtx->uri != NULL) {
-        xmlFree(dsigRefCtx->uri);
+    for(transform = transformCtx->first; transform != NULL; transform = transform->next) {
+        if((transform != dsigRefCtx->digestMethod) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14NId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14NWithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14N11Id) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14N11WithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformExclC14NId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformExclC14NWithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformBase64Id)) {
+            return(NULL);
+        }
     }
-    if(dsigRefCtx->type != NULL) {
-        xmlFree(dsigRefCtx->type);
+
+    buf = xmlBufferCreate();
+    if(buf == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(NULL);
     }
-    memset(dsigRefCtx, 0, sizeof(xmlSecDSigReferenceCtx));
+    xmlBufferCat(buf, dsigRefCtx->digestMethod->id->href);
+    xmlBufferCat(buf, BAD_CAST "\n");
+    if(transformsNode != NULL) {
+        if(xmlNodeDump(buf, transformsNode->doc, transformsNode, 0, 0) < 0) {
+            xmlSecXmlError("xmlNodeDump", NULL);
+            xmlBufferFree(buf);
+            return(NULL);
+        }
+    }
+
+    key = xmlStrdup(xmlBufferContent(buf));
+    if(key == NULL) {
+        xmlSecStrdupError(xmlBufferContent(buf), NULL);
+        xmlBufferFree(buf);
+        return(NULL);
+    }
+    xmlBufferFree(buf);
+
+    /* the same uri as in xmlSecTransformInputURIOpen() */
+    (*ioUri) = xmlURIUnescapeString((const char*)transformCtx->uri, 0, NULL);
+    if((*ioUri) == NULL) {
+        xmlSecXmlError("xmlURIUnescapeString", NULL);
+        xmlFree(key);
+        return(NULL);
+    }
+    return(key);
 }
 
-/**
- * xmlSecDSigReferenceCtxGetPreDigestBuffer:
- * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
- *
- * Gets the results of <dsig:Reference/> node processing just before digesting
- * (valid only if #XMLSEC_DSIG_FLAGS_STORE_SIGNEDINFO_REFERENCES or
- * #XMLSEC_DSIG_FLAGS_STORE_MANIFEST_REFERENCES flas of signature context
- * is set).
- *
- * Returns: pointer to the buffer or NULL if an error occurs.
+/*
+ * Returns 1 if the reference is a same document bare name (or empty)
+ * URI reference with only the c14n and base64 transforms that don't
+ * depend on the location, the id() xpointer added for the bare name uri
+ * and the enveloped signature transform (the <dsig:Signature/> node is
+ * returned in @signatureNode) or 0 otherwise.
  */
-xmlSecBufferPtr
-xmlSecDSigReferenceCtxGetPreDigestBuffer(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
-    xmlSecAssert2(dsigRefCtx != NULL, NULL);
+static int
+xmlSecDSigReferenceCtxCheckTransforms(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node,
+                                      xmlNodePtr* signatureNode) {
+    xmlSecTransformPtr transform;
 
-    return((dsigRefCtx->preDigestMemBufMethod != NULL) ?
-            xmlSecTransformMemBufGetBuffer(dsigRefCtx->preDigestMemBufMethod) : NULL);
-}
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(signatureNode != NULL, -1);
 
-/**
- * xmlSecDSigReferenceCtxProcessNode:
- * @dsigRefCtx:         the pointer to <dsig:Reference/> element processing context.
- * @node:               the pointer to <dsig:Reference/> node.
+    (*signatureNode) = NULL;
 
- * The Reference Element (http://www.w3.org/TR/xmldsig-core/#sec-Reference)
- *
- * Reference is an element that may occur one or more times. It specifies
- * a digest algorithm and digest value, and optionally an identifier of the
- * object being signed, the type of the object, and/or a list of transforms
- * to be applied prior to digesting. The identification (URI) and transforms
- * describe how the digested content (i.e., the input to the digest method)
- * was created. The Type attribute facilitates the processing of referenced
- * data. For example, while this specification makes no requirements over
- * external data, an application may wish to signal that the referent is a
- * Manifest. An optional ID attribute permits a Reference to be referenced
- * from elsewhere.
- *
- * Returns: 0 on succes or aa negative value otherwise.
+    /* same document bare name references only */
+    if((dsigRefCtx->uri == NULL) ||
+       ((dsigRefCtx->uri[0] != '\0') && (dsigRefCtx->uri[0] != '#')) ||
+       (xmlStrchr(dsigRefCtx->uri, '(') != NULL)) {
+        return(0);
+    }
+
+    for(transform = dsigRefCtx->transformCtx.first; transform != NULL; transform = transform->next) {
+        if(xmlSecTransformCheckId(transform, xmlSecTransformEnvelopedId)) {
+            (*signatureNode) = xmlSecFindParent(node, xmlSecNodeSignature, xmlSecDSigNs);
+            if((*signatureNode) == NULL) {
+                return(0);
+            }
+            continue;
+        }
+        if((transform == dsigRefCtx->transformCtx.first) && (dsigRefCtx->uri[0] == '#') &&
+           xmlSecTransformCheckId(transform, xmlSecTransformXPointerId)) {
+            continue;
+        }
+        if((transform != dsigRefCtx->digestMethod) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14NId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14NWithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14N11Id) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformInclC14N11WithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformExclC14NId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformExclC14NWithCommentsId) &&
+           !xmlSecTransformCheckId(transform, xmlSecTransformBase64Id)) {
+            return(0);
+        }
+    }
+    return(1);
+}
+
+/*
+ * Returns 0 if the reference digest in @digestValueNode can be kept by
+ * #xmlSecDSigCtxResign: the reference is to the external object or its
+ * result is computed from the subtree that doesn't contain and is not
+ * contained in any of the changed nodes. Otherwise returns 1.
  */
-int
-xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node) {
-    xmlSecTransformCtxPtr transformCtx;
-    xmlNodePtr digestValueNode;
+static int
+xmlSecDSigReferenceCtxIsChanged(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node,
+                                xmlNodePtr digestValueNode) {
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlSecDSigCtxPrivatePtr dsigCtxPriv;
+    xmlNodePtr signatureNode = NULL;
+    xmlNodePtr root;
     xmlNodePtr cur;
+    xmlSecSize ii;
     int ret;
 
     xmlSecAssert2(dsigRefCtx != NULL, -1);
     xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
-    xmlSecAssert2(dsigRefCtx->digestMethod == NULL, -1);
-    xmlSecAssert2(dsigRefCtx->digestMethod == NULL, -1);
-    xmlSecAssert2(dsigRefCtx->preDigestMemBufMethod == NULL, -1);
     xmlSecAssert2(node != NULL, -1);
-    xmlSecAssert2(node->doc != NULL, -1);
+    xmlSecAssert2(digestValueNode != NULL, -1);
 
-    transformCtx = &(dsigRefCtx->transformCtx);
+    dsigCtx = dsigRefCtx->dsigCtx;
+    dsigCtxPriv = xmlSecDSigCtxGetPrivate(dsigCtx);
+    xmlSecAssert2(dsigCtxPriv != NULL, -1);
 
-    /* read attributes first */
-    dsigRefCtx->uri = xmlGetProp(node, xmlSecAttrURI);
-    dsigRefCtx->id  = xmlGetProp(node, xmlSecAttrId);
-    dsigRefCtx->type= xmlGetProp(node, xmlSecAttrType);
+    if(xmlSecIsEmptyNode(digestValueNode) != 0) {
+        return(1);
+    }
 
-    /* set start URI (and check that it is enabled!) */
-    ret = xmlSecTransformCtxSetUri(transformCtx, dsigRefCtx->uri, node);
+    /* the edits don't change the external objects */
+    if((dsigRefCtx->uri != NULL) && (dsigRefCtx->uri[0] != '\0') && (dsigRefCtx->uri[0] != '#') &&
+       (dsigCtxPriv->referenceDigestCallback == NULL) && (dsigCtx->referencePreExecuteCallback == NULL)) {
+        return(0);
+    }
+
+    ret = xmlSecDSigReferenceCtxCheckTransforms(dsigRefCtx, node, &signatureNode);
     if(ret < 0) {
-        xmlSecInternalError2("xmlSecTransformCtxSetUri", NULL,
-                             "uri=%s", xmlSecErrorsSafeString(dsigRefCtx->uri));
+        xmlSecInternalError("xmlSecDSigReferenceCtxCheckTransforms", NULL);
         return(-1);
+    } else if((ret == 0) || (dsigCtx->referencePreExecuteCallback != NULL)) {
+        return(1);
+    }
+    root = xmlSecDSigReferenceCtxCacheRoot(dsigRefCtx, node->doc);
+    if(root == NULL) {
+        return(1);
     }
 
-    /* first is optional Transforms node */
-    cur  = xmlSecGetNextElementNode(node->children);
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeTransforms, xmlSecDSigNs))) {
-        ret = xmlSecTransformCtxNodesListRead(transformCtx,
-                                        cur, xmlSecTransformUsageDSigTransform);
-        if(ret < 0) {
-            xmlSecInternalError2("xmlSecTransformCtxNodesListRead", NULL,
-                                 "node=%s", xmlSecErrorsSafeString(xmlSecNodeGetName(cur)));
-            return(-1);
+    for(ii = 0; ii < dsigCtxPriv->changedNodesSize; ++ii) {
+        /* the changes inside the subtree or the ancestors (namespaces, xml:* attributes) */
+        for(cur = dsigCtxPriv->changedNodes[ii]; cur != NULL; cur = cur->parent) {
+            if(cur == root) {
+                return(1);
+            }
+        }
+        for(cur = root; cur != NULL; cur = cur->parent) {
+            if(cur == dsigCtxPriv->changedNodes[ii]) {
+                return(1);
+            }
         }
+    }
+    return(0);
+}
 
-        cur = xmlSecGetNextElementNode(cur->next);
+/*
+ * Returns the node the cached reference result is computed from: the
+ * document node for the whole document or the element with the ID from
+ * the reference URI (NULL if it is not found).
+ */
+static xmlNodePtr
+xmlSecDSigReferenceCtxCacheRoot(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlDocPtr doc) {
+    xmlAttrPtr attr;
+
+    xmlSecAssert2(dsigRefCtx != NULL, NULL);
+    xmlSecAssert2(dsigRefCtx->uri != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    if(dsigRefCtx->uri[0] == '\0') {
+        return((xmlNodePtr)doc);
     }
+    xmlSecAssert2(dsigRefCtx->uri[0] == '#', NULL);
 
-    /* insert membuf if requested */
-    if(((dsigRefCtx->origin == xmlSecDSigReferenceOriginSignedInfo) &&
-        ((dsigRefCtx->dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_SIGNEDINFO_REFERENCES) != 0)) ||
-       ((dsigRefCtx->origin == xmlSecDSigReferenceOriginManifest) &&
-        ((dsigRefCtx->dsigCtx->flags & XMLSEC_DSIG_FLAGS_STORE_MANIFEST_REFERENCES) != 0))) {
+    attr = xmlGetID(doc, dsigRefCtx->uri + 1);
+    if((attr == NULL) || (attr->parent == NULL) || (attr->parent->doc != doc)) {
+        return(NULL);
+    }
+    return(attr->parent);
+}
 
-        xmlSecAssert2(dsigRefCtx->preDigestMemBufMethod == NULL, -1);
-        dsigRefCtx->preDigestMemBufMethod = xmlSecTransformCtxCreateAndAppend(
-                                                transformCtx,
-                                                xmlSecTransformMemBufId);
-        if(dsigRefCtx->preDigestMemBufMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend(xmlSecTransformMemBufId)", NULL);
-            return(-1);
-        }
+/* returns 1 if @digestValue is the digest cached for @key in @doc, 0 otherwise */
+static int
+xmlSecDSigReferenceCtxDocCacheCheck(xmlDocPtr doc, const xmlChar* key, xmlNodePtr root,
+                                    const xmlChar* digestValue) {
+    xmlSecBuffer cached;
+    int res = 0;
+    int ret;
+
+    xmlSecAssert2(doc != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(root != NULL, -1);
+    xmlSecAssert2(digestValue != NULL, -1);
+
+    ret = xmlSecBufferInitialize(&cached, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
     }
 
-    /* next node is required DigestMethod. */
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeDigestMethod, xmlSecDSigNs))) {
-        dsigRefCtx->digestMethod = xmlSecTransformCtxNodeRead(&(dsigRefCtx->transformCtx),
-                                        cur, xmlSecTransformUsageDigestMethod);
-        if(dsigRefCtx->digestMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxNodeRead",
-                                xmlSecNodeGetName(cur));
-            return(-1);
-        }
+    ret = xmlSecDocCacheLookup(doc, key, root, &cached);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDocCacheLookup", NULL);
+        xmlSecBufferFinalize(&cached);
+        return(-1);
+    }
+    if((ret == 1) && (xmlSecBufferGetSize(&cached) == (xmlSecSize)xmlStrlen(digestValue)) &&
+       (memcmp(xmlSecBufferGetData(&cached), digestValue, xmlSecBufferGetSize(&cached)) == 0)) {
+        res = 1;
+    }
 
-        cur = xmlSecGetNextElementNode(cur->next);
-    } else if(dsigRefCtx->dsigCtx->defSignMethodId != xmlSecTransformIdUnknown) {
-        /* the dsig spec does require DigestMethod node
-         * to be present but in some case it application might decide to
-         * minimize traffic */
-        dsigRefCtx->digestMethod = xmlSecTransformCtxCreateAndAppend(&(dsigRefCtx->transformCtx),
-                                                              dsigRefCtx->dsigCtx->defSignMethodId);
-        if(dsigRefCtx->digestMethod == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxAppend", NULL);
-            return(-1);
-        }
-    } else {
-        /* if digest method is not specified in the template and not specified in
-         * the dsig context then it's an error.
-         */
-        xmlSecInvalidNodeError(cur, xmlSecNodeDigestMethod, NULL);
+    xmlSecBufferFinalize(&cached);
+    return(res);
+}
+
+/* writes the digest calculated with writeDigestValue=0 */
+static int
+xmlSecDSigReferenceCtxWriteDigestValue(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node) {
+    xmlNodePtr digestValueNode;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* the digest is kept by xmlSecDSigCtxResign() */
+    if((dsigRefCtx->result == NULL) && (xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->changedNodes != NULL) &&
+       (dsigRefCtx->status == xmlSecDSigStatusSucceeded)) {
+        return(0);
+    }
+
+    if((dsigRefCtx->result == NULL) || (xmlSecBufferGetData(dsigRefCtx->result) == NULL)) {
+        xmlSecInvalidDataError("reference digest is not calculated", NULL);
         return(-1);
     }
-    dsigRefCtx->digestMethod->operation = dsigRefCtx->dsigCtx->operation;
 
-    /* last node is required DigestValue */
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeDigestValue, xmlSecDSigNs))) {
-        digestValueNode = cur;
-        cur = xmlSecGetNextElementNode(cur->next);
-    } else {
-        xmlSecInvalidNodeError(cur, xmlSecNodeDigestValue, NULL);
+    digestValueNode = xmlSecFindChild(node, xmlSecNodeDigestValue, xmlSecDSigNs);
+    if(digestValueNode == NULL) {
+        xmlSecNodeNotFoundError("xmlSecFindChild", node, xmlSecNodeDigestValue, NULL);
         return(-1);
     }
 
-    /* if we have something else then it's an error */
-    if(cur != NULL) {
-        xmlSecUnexpectedNodeError(cur,  NULL);
+    xmlNodeSetContentLen(digestValueNode,
+                        xmlSecBufferGetData(dsigRefCtx->result),
+                        xmlSecBufferGetSize(dsigRefCtx->result));
+    xmlSecDocCacheTouch(digestValueNode);
+    return(0);
+}
+
+static int
+xmlSecDSigReferenceCtxStreamExecute(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr envelopedTransform;
+    xmlSecTransformPtr c14nTransform;
+    xmlSecC14NStreamMode mode;
+    xmlChar** inclusiveNsList;
+    const char* filename;
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
+    xmlSecAssert2(xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx) != NULL, -1);
+
+    filename = xmlSecDSigCtxGetPrivate(dsigRefCtx->dsigCtx)->streamFilename;
+    xmlSecAssert2(filename != NULL, -1);
+    transformCtx = &(dsigRefCtx->transformCtx);
+
+    /* only enveloped signature followed by exclusive c14n or C14N 2.0 can be streamed */
+    envelopedTransform = transformCtx->first;
+    if((envelopedTransform == NULL) || (!xmlSecTransformCheckId(envelopedTransform, xmlSecTransformEnvelopedId))) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_TRANSFORM, NULL,
+                         "streamed reference must start with enveloped signature transform");
         return(-1);
     }
+    /* the empty URI removes comments, so both exclusive c14n flavors are the same */
+    c14nTransform = envelopedTransform->next;
+    if((c14nTransform != NULL) &&
+       ((xmlSecTransformCheckId(c14nTransform, xmlSecTransformExclC14NId)) ||
+        (xmlSecTransformCheckId(c14nTransform, xmlSecTransformExclC14NWithCommentsId)))) {
+        mode = xmlSecC14NStreamModeExclC14N;
+        inclusiveNsList = xmlSecTransformC14NGetInclusiveNsList(c14nTransform);
+    } else if((c14nTransform != NULL) && (xmlSecTransformCheckId(c14nTransform, xmlSecTransformC14N2Id))) {
+        mode = (xmlSecTransformC14N2GetTrimTextNodes(c14nTransform) != 0) ?
+            xmlSecC14NStreamModeC14N2TrimTextNodes : xmlSecC14NStreamModeExclC14N;
+        inclusiveNsList = NULL;
+    } else {
+        xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_TRANSFORM, NULL,
+                         "streamed reference requires exclusive c14n or c14n2 after enveloped signature transform");
+        return(-1);
+    }
+    xmlSecAssert2(c14nTransform->next != NULL, -1);
 
-    /* if we need to write result to xml node then we need base64 encode result */
-    if(dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) {
-        xmlSecTransformPtr base64Encode;
+    /* the stream replaces both transforms */
+    transformCtx->first = c14nTransform->next;
+    xmlSecTransformRemove(envelopedTransform);
+    xmlSecTransformRemove(c14nTransform);
 
-        /* we need to add base64 encode transform */
-        base64Encode = xmlSecTransformCtxCreateAndAppend(transformCtx, xmlSecTransformBase64Id);
-        if(base64Encode == NULL) {
-            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend", NULL);
-            return(-1);
-        }
-        base64Encode->operation = xmlSecTransformOperationEncode;
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        xmlSecTransformDestroy(envelopedTransform);
+        xmlSecTransformDestroy(c14nTransform);
+        return(-1);
     }
 
-    /* finally get transforms results */
-    ret = xmlSecTransformCtxExecute(transformCtx, node->doc);
+    ret = xmlSecC14NStreamProcess(filename, mode, inclusiveNsList,
+                xmlSecNodeSignature, xmlSecDSigNs, NULL,
+                xmlSecDSigReferenceCtxStreamWrite, transformCtx);
+    xmlSecTransformDestroy(envelopedTransform);
+    xmlSecTransformDestroy(c14nTransform);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
+        xmlSecInternalError2("xmlSecC14NStreamProcess", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
         return(-1);
     }
-    dsigRefCtx->result = transformCtx->result;
 
-    if(dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) {
-        if((dsigRefCtx->result == NULL) || (xmlSecBufferGetData(dsigRefCtx->result) == NULL)) {
-            xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
-            return(-1);
-        }
+    ret = xmlSecTransformPushBin(transformCtx->first, NULL, 0, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin", NULL);
+        return(-1);
+    }
+    transformCtx->status = xmlSecTransformStatusFinished;
+    return(0);
+}
 
-        /* write signed data to xml */
-        xmlNodeSetContentLen(digestValueNode,
-                            xmlSecBufferGetData(dsigRefCtx->result),
-                            xmlSecBufferGetSize(dsigRefCtx->result));
+static int
+xmlSecDSigReferenceCtxStreamWrite(void* context, const xmlSecByte* data, xmlSecSize dataSize) {
+    xmlSecTransformCtxPtr transformCtx = (xmlSecTransformCtxPtr)context;
+    int ret;
 
-        /* set success status and we are done */
-        dsigRefCtx->status = xmlSecDSigStatusSucceeded;
-    } else {
-        /* verify SignatureValue node content */
-        ret = xmlSecTransformVerifyNodeContent(dsigRefCtx->digestMethod,
-                            digestValueNode, transformCtx);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
-            return(-1);
-        }
+    xmlSecAssert2(transformCtx != NULL, -1);
+    xmlSecAssert2(transformCtx->first != NULL, -1);
 
-        /* set status and we are done */
-        if(dsigRefCtx->digestMethod->status == xmlSecTransformStatusOk) {
-            dsigRefCtx->status = xmlSecDSigStatusSucceeded;
-        } else {
-            dsigRefCtx->status = xmlSecDSigStatusInvalid;
-        }
+    ret = xmlSecTransformPushBin(transformCtx->first, data, dataSize, 0, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                             "dataSize=" XMLSEC_SIZE_FMT, dataSize);
+        return(-1);
     }
-
     return(0);
 }
 
@@ -16,9 +16,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/parserInternals.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/buffer.h>
@@ -27,16 +31,46 @@
 #include <xmlsec/keysmngr.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/keyinfo.h>
+#include <xmlsec/templates.h>
+#include <xmlsec/io.h>
 #include <xmlsec/xmlenc.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/executor.h>
+
+#include <xmlsec/private/doccache.h>
+#include <xmlsec/private/transforms.h>
 
 static int      xmlSecEncCtxEncDataNodeRead             (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
 static int      xmlSecEncCtxEncDataNodeWrite            (xmlSecEncCtxPtr encCtx);
 static int      xmlSecEncCtxCipherDataNodeRead          (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
+static int      xmlSecEncCtxDecryptCipherValue          (xmlSecEncCtxPtr encCtx,
+                                                         xmlOutputBufferPtr output);
+static int      xmlSecEncCtxFlushResult                 (xmlSecEncCtxPtr encCtx,
+                                                         xmlOutputBufferPtr output);
+static int      xmlSecEncCtxWriteOutputStart            (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr tmpl,
+                                                         xmlOutputBufferPtr output,
+                                                         xmlBufferPtr* serialized);
+static int      xmlSecEncCtxWriteOutputEnd              (xmlSecEncCtxPtr encCtx,
+                                                         xmlOutputBufferPtr output,
+                                                         xmlBufferPtr serialized);
+static xmlSecBufferPtr xmlSecEncCtxDecryptToBufferInternal(xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr node,
+                                                         int addIds);
 static int      xmlSecEncCtxCipherReferenceNodeRead     (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
+static int      xmlSecEncCtxEncryptedKeyMatch           (xmlSecEncCtxPtr encCtx);
+static int      xmlSecEncReplaceNodeLazy                (xmlNodePtr node,
+                                                         const xmlSecByte* buffer,
+                                                         xmlSecSize size,
+                                                         xmlNodePtr* replaced);
+#ifndef XMLSEC_NO_X509
+static int      xmlSecEncCtxEncryptedKeyMatchX509Data   (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr x509DataNode);
+#endif /* XMLSEC_NO_X509 */
 
 /* The ID attribute in XMLEnc is 'Id' */
 static const xmlChar*           xmlSecEncIds[] = { BAD_CAST "Id", NULL };
@@ -172,6 +206,13 @@ xmlSecEncCtxReset(xmlSecEncCtxPtr encCtx) {
     encCtx->resultReplaced      = 0;
     encCtx->encMethod           = NULL;
 
+    /* allocated from the transforms ctx arena */
+    encCtx->id                  = NULL;
+    encCtx->type                = NULL;
+    encCtx->mimeType            = NULL;
+    encCtx->encoding            = NULL;
+    encCtx->recipient           = NULL;
+
     if (encCtx->replacedNodeList != NULL) {
                 xmlFreeNodeList(encCtx->replacedNodeList);
         encCtx->replacedNodeList = NULL;
@@ -182,31 +223,6 @@ xmlSecEncCtxReset(xmlSecEncCtxPtr encCtx) {
             encCtx->encKey = NULL;
     }
 
-    if(encCtx->id != NULL) {
-            xmlFree(encCtx->id);
-            encCtx->id = NULL;
-    }
-
-    if(encCtx->type != NULL) {
-            xmlFree(encCtx->type);
-            encCtx->type = NULL;
-    }
-
-    if(encCtx->mimeType != NULL) {
-            xmlFree(encCtx->mimeType);
-            encCtx->mimeType = NULL;
-    }
-
-    if(encCtx->encoding != NULL) {
-            xmlFree(encCtx->encoding);
-            encCtx->encoding = NULL;
-    }
-
-    if(encCtx->recipient != NULL) {
-            xmlFree(encCtx->recipient);
-            encCtx->recipient = NULL;
-    }
-
     if(encCtx->carriedKeyName != NULL) {
             xmlFree(encCtx->carriedKeyName);
             encCtx->carriedKeyName = NULL;
@@ -497,204 +513,1949 @@ xmlSecEncCtxUriEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *u
     return(0);
 }
 
+/* the <enc:CipherValue/> content placeholder in the serialized template */
+#define XMLSEC_ENC_CIPHER_VALUE_PLACEHOLDER             ">{xmlsec-cipher-value}<"
+
 /**
- * xmlSecEncCtxDecrypt:
+ * xmlSecEncCtxBinaryEncryptToOutput:
  * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
- * @node:               the pointer to <enc:EncryptedData/> node.
+ * @tmpl:               the pointer to <enc:EncryptedData/> template node.
+ * @data:               the pointer for binary buffer.
+ * @dataSize:           the @data buffer size.
+ * @output:             the output buffer for the <enc:EncryptedData/> node.
  *
- * Decrypts @node and if necessary replaces @node with decrypted data.
+ * Encrypts @data according to template @tmpl and writes the serialized
+ * <enc:EncryptedData/> node to @output. The encrypted and base64 encoded
+ * data goes to @output chunk by chunk as the <enc:CipherValue/> content
+ * and is never collected in memory or set in @tmpl.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
-xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
-    xmlSecBufferPtr buffer;
+xmlSecEncCtxBinaryEncryptToOutput(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
+                                  const xmlSecByte* data, xmlSecSize dataSize,
+                                  xmlOutputBufferPtr output) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlBufferPtr serialized = NULL;
+    xmlSecSize chunkSize;
     int ret;
 
     xmlSecAssert2(encCtx != NULL, -1);
-    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
 
-    /* decrypt */
-    buffer = xmlSecEncCtxDecryptToBuffer(encCtx, node);
-    if(buffer == NULL) {
-        xmlSecInternalError("xmlSecEncCtxDecryptToBuffer", NULL);
+    transformCtx = &(encCtx->transformCtx);
+
+    /* initialize context and add ID atributes to the list of known ids */
+    encCtx->operation = xmlSecTransformOperationEncrypt;
+    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
+
+    /* read the template and set encryption method, key, etc. */
+    ret = xmlSecEncCtxEncDataNodeRead(encCtx, tmpl);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
         return(-1);
     }
 
-    /* replace original node if requested */
-    if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
-        /* check if we need to return the replaced node */
-        if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
-                if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
-                                        xmlSecNodeGetName(node));
-                    return(-1);
-                }
-        } else {
-                ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer));
-                if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
-                                        xmlSecNodeGetName(node));
-                    return(-1);
-                }
-        }
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        return(-1);
+    }
+    encCtx->result = transformCtx->result;
 
-        encCtx->resultReplaced = 1;
-    } else if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncContent)) {
-        /* replace the node with the buffer */
+    ret = xmlSecEncCtxWriteOutputStart(encCtx, tmpl, output, &serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputStart", NULL);
+        return(-1);
+    }
 
-        /* check if we need to return the replaced node */
-        if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
-                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
-                if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
-                                        xmlSecNodeGetName(node));
-                    return(-1);
-                }
-        } else {
-            ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer));
-                if(ret < 0) {
-                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
-                                        xmlSecNodeGetName(node));
-                    return(-1);
-                }
+    while(dataSize > 0) {
+        chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
+        if(chunkSize > dataSize) {
+            chunkSize = dataSize;
         }
-        encCtx->resultReplaced = 1;
+
+        ret = xmlSecTransformPushBin(transformCtx->first, data, chunkSize, 0, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                                 "dataSize=" XMLSEC_SIZE_FMT, chunkSize);
+            xmlBufferFree(serialized);
+            return(-1);
+        }
+        ret = xmlSecEncCtxFlushResult(encCtx, output);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+            xmlBufferFree(serialized);
+            return(-1);
+        }
+        xmlSecTransformCtxUpdateBinaryChunkSize(transformCtx, chunkSize);
+
+        data += chunkSize;
+        dataSize -= chunkSize;
+    }
+
+    ret = xmlSecTransformPushBin(transformCtx->first, NULL, 0, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin", NULL);
+        xmlBufferFree(serialized);
+        return(-1);
     }
+    transformCtx->status = xmlSecTransformStatusFinished;
 
+    ret = xmlSecEncCtxWriteOutputEnd(encCtx, output, serialized);
+    xmlBufferFree(serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputEnd", NULL);
+        return(-1);
+    }
     return(0);
 }
 
 /**
- * xmlSecEncCtxDecryptToBuffer:
+ * xmlSecEncCtxUriEncryptToOutput:
  * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
- * @node:               the pointer to <enc:EncryptedData/> node.
+ * @tmpl:               the pointer to <enc:EncryptedData/> template node.
+ * @uri:                the URI.
+ * @output:             the output buffer for the <enc:EncryptedData/> node.
  *
- * Decrypts @node data to the @encCtx buffer.
+ * Encrypts data from @uri according to template @tmpl and writes the
+ * serialized <enc:EncryptedData/> node to @output. The data is read from
+ * @uri, encrypted, base64 encoded and written to @output chunk by chunk
+ * (see #xmlSecEncCtxBinaryEncryptToOutput). The @uri can not point to
+ * a node in the @tmpl document.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
-xmlSecBufferPtr
-xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+int
+xmlSecEncCtxUriEncryptToOutput(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, const xmlChar *uri,
+                               xmlOutputBufferPtr output) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecTransformPtr uriTransform;
+    xmlBufferPtr serialized = NULL;
+    xmlSecBuffer buf;
+    xmlSecSize chunkSize, bufSize;
+    int final;
     int ret;
 
-    xmlSecAssert2(encCtx != NULL, NULL);
-    xmlSecAssert2(encCtx->result == NULL, NULL);
-    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(uri != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    transformCtx = &(encCtx->transformCtx);
 
     /* initialize context and add ID atributes to the list of known ids */
-    encCtx->operation = xmlSecTransformOperationDecrypt;
-    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    encCtx->operation = xmlSecTransformOperationEncrypt;
+    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
 
-    ret = xmlSecEncCtxEncDataNodeRead(encCtx, node);
+    /* check that we can process the uri */
+    ret = xmlSecTransformCtxSetUri(transformCtx, uri, tmpl);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformCtxSetUri", NULL,
+                             "uri=%s", xmlSecErrorsSafeString(uri));
+        return(-1);
+    }
+    if((transformCtx->uri == NULL) || (transformCtx->xptrExpr != NULL)) {
+        xmlSecInvalidDataError("only external uri can be streamed", NULL);
+        return(-1);
+    }
+
+    /* read the template and set encryption method, key, etc. */
+    ret = xmlSecEncCtxEncDataNodeRead(encCtx, tmpl);
     if(ret < 0) {
         xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
-        return(NULL);
+        return(-1);
     }
 
-    /* decrypt the data */
-    if(encCtx->cipherValueNode != NULL) {
-        xmlChar* data = NULL;
-        xmlSecSize dataSize = 0;
+    uriTransform = xmlSecTransformCtxCreateAndPrepend(transformCtx, xmlSecTransformInputURIId);
+    if(uriTransform == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxCreateAndPrepend(xmlSecTransformInputURIId)", NULL);
+        return(-1);
+    }
+    ret = xmlSecTransformInputURIOpen(uriTransform, transformCtx->uri);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformInputURIOpen", NULL,
+                            "uri=%s", xmlSecErrorsSafeString(transformCtx->uri));
+        return(-1);
+    }
 
-        data = xmlNodeGetContent(encCtx->cipherValueNode);
-        if(data == NULL) {
-            xmlSecInvalidNodeContentError(encCtx->cipherValueNode, NULL, "empty");
-            return(NULL);
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeUnknown);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeUnknown)", NULL);
+        return(-1);
+    }
+    encCtx->result = transformCtx->result;
+
+    ret = xmlSecEncCtxWriteOutputStart(encCtx, tmpl, output, &serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputStart", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecBufferInitialize(&buf, xmlSecTransformCtxGetBinaryChunkSize(transformCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        xmlBufferFree(serialized);
+        return(-1);
+    }
+    do {
+        chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
+        ret = xmlSecBufferSetMaxSize(&buf, chunkSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL,
+                                 "size=" XMLSEC_SIZE_FMT, chunkSize);
+            break;
         }
-        dataSize = xmlStrlen(data);
 
-        ret = xmlSecTransformCtxBinaryExecute(&(encCtx->transformCtx), data, dataSize);
+        ret = xmlSecTransformPopBin(uriTransform, xmlSecBufferGetData(&buf), chunkSize, &bufSize, transformCtx);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformCtxBinaryExecute", NULL);
-            if(data != NULL) {
-                xmlFree(data);
-            }
-            return(NULL);
+            xmlSecInternalError("xmlSecTransformPopBin",
+                                xmlSecTransformGetName(uriTransform));
+            break;
         }
-        if(data != NULL) {
-            xmlFree(data);
+        final = (bufSize == 0) ? 1 : 0;
+        ret = xmlSecTransformPushBin(uriTransform->next, xmlSecBufferGetData(&buf), bufSize, final, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPushBin",
+                                xmlSecTransformGetName(uriTransform->next));
+            break;
         }
-    } else {
-        ret = xmlSecTransformCtxExecute(&(encCtx->transformCtx), node->doc);
+        ret = xmlSecEncCtxFlushResult(encCtx, output);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformCtxBinaryExecute", NULL);
-            return(NULL);
+            xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+            break;
         }
+        xmlSecTransformCtxUpdateBinaryChunkSize(transformCtx, bufSize);
+    } while(final == 0);
+    xmlSecBufferFinalize(&buf);
+    if(ret < 0) {
+        xmlBufferFree(serialized);
+        return(-1);
     }
 
-    encCtx->result = encCtx->transformCtx.result;
-    xmlSecAssert2(encCtx->result != NULL, NULL);
+    /* close to free up file handle */
+    ret = xmlSecTransformInputURIClose(uriTransform);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformInputURIClose",
+                            xmlSecTransformGetName(uriTransform));
+        xmlBufferFree(serialized);
+        return(-1);
+    }
+    transformCtx->status = xmlSecTransformStatusFinished;
 
-    return(encCtx->result);
+    ret = xmlSecEncCtxWriteOutputEnd(encCtx, output, serialized);
+    xmlBufferFree(serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputEnd", NULL);
+        return(-1);
+    }
+    return(0);
 }
 
+/* the serialized node goes thru the encryption transforms to the output */
+typedef struct _xmlSecEncCtxNodeWriteCtx {
+    xmlSecEncCtxPtr             encCtx;
+    xmlOutputBufferPtr          output;
+} xmlSecEncCtxNodeWriteCtx, *xmlSecEncCtxNodeWriteCtxPtr;
+
 static int
-xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
-    xmlNodePtr cur;
+xmlSecEncCtxNodeWriteCallback(void* context, const char* buffer, int len) {
+    xmlSecEncCtxNodeWriteCtxPtr ctx = (xmlSecEncCtxNodeWriteCtxPtr)context;
+    xmlSecTransformCtxPtr transformCtx;
     int ret;
 
-    xmlSecAssert2(encCtx != NULL, -1);
-    xmlSecAssert2((encCtx->operation == xmlSecTransformOperationEncrypt) || (encCtx->operation == xmlSecTransformOperationDecrypt), -1);
-    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->encCtx != NULL, -1);
+    xmlSecAssert2(buffer != NULL, -1);
+    xmlSecAssert2(len >= 0, -1);
 
-    switch(encCtx->mode) {
-        case xmlEncCtxModeEncryptedData:
-            if(!xmlSecCheckNodeName(node, xmlSecNodeEncryptedData, xmlSecEncNs)) {
-                xmlSecInvalidNodeError(node, xmlSecNodeEncryptedData, NULL);
-                return(-1);
-            }
-            break;
-        case xmlEncCtxModeEncryptedKey:
-            if(!xmlSecCheckNodeName(node, xmlSecNodeEncryptedKey, xmlSecEncNs)) {
-                xmlSecInvalidNodeError(node, xmlSecNodeEncryptedKey, NULL);
-                return(-1);
-            }
-            break;
+    transformCtx = &(ctx->encCtx->transformCtx);
+    ret = xmlSecTransformPushBin(transformCtx->first, (const xmlSecByte*)buffer,
+                                 (xmlSecSize)len, 0, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                             "dataSize=%d", len);
+        return(-1);
     }
-
-    /* first read node data */
-    xmlSecAssert2(encCtx->id == NULL, -1);
-    xmlSecAssert2(encCtx->type == NULL, -1);
-    xmlSecAssert2(encCtx->mimeType == NULL, -1);
-    xmlSecAssert2(encCtx->encoding == NULL, -1);
-    xmlSecAssert2(encCtx->recipient == NULL, -1);
-    xmlSecAssert2(encCtx->carriedKeyName == NULL, -1);
-
-    encCtx->id = xmlGetProp(node, xmlSecAttrId);
-    encCtx->type = xmlGetProp(node, xmlSecAttrType);
-    encCtx->mimeType = xmlGetProp(node, xmlSecAttrMimeType);
-    encCtx->encoding = xmlGetProp(node, xmlSecAttrEncoding);
-    if(encCtx->mode == xmlEncCtxModeEncryptedKey) {
-        encCtx->recipient = xmlGetProp(node, xmlSecAttrRecipient);
-        /* todo: check recipient? */
+    ret = xmlSecEncCtxFlushResult(ctx->encCtx, ctx->output);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+        return(-1);
     }
-    cur = xmlSecGetNextElementNode(node->children);
+    return(len);
+}
 
-    /* first node is optional EncryptionMethod, we'll read it later */
-    xmlSecAssert2(encCtx->encMethodNode == NULL, -1);
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeEncryptionMethod, xmlSecEncNs))) {
-        encCtx->encMethodNode = cur;
-        cur = xmlSecGetNextElementNode(cur->next);
-    }
+/**
+ * xmlSecEncCtxXmlEncryptToOutput:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @tmpl:               the pointer to <enc:EncryptedData/> template node.
+ * @node:               the pointer to node for encryption.
+ * @output:             the output buffer for the <enc:EncryptedData/> node.
+ *
+ * Encrypts @node (or its content, depending on the <enc:EncryptedData/>
+ * Type attribute) according to template @tmpl and writes the serialized
+ * <enc:EncryptedData/> node to @output. The @node is serialized directly
+ * into the encryption transforms and the encrypted and base64 encoded data
+ * goes to @output block by block (see #xmlSecEncCtxBinaryEncryptToOutput).
+ * Neither the serialized @node nor the encrypted data is collected in memory
+ * and the @node document is not modified.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecEncCtxXmlEncryptToOutput(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr node,
+                               xmlOutputBufferPtr output) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecEncCtxNodeWriteCtx writeCtx;
+    xmlOutputBufferPtr nodeOutput;
+    xmlBufferPtr serialized = NULL;
+    int ret;
 
-    /* next node is optional KeyInfo, we'll process it later */
-    xmlSecAssert2(encCtx->keyInfoNode == NULL, -1);
-    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
-        encCtx->keyInfoNode = cur;
-        cur = xmlSecGetNextElementNode(cur->next);
-    }
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
 
-    /* next is required CipherData node */
-    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeCipherData, xmlSecEncNs))) {
-        xmlSecInvalidNodeError(cur, xmlSecNodeCipherData, NULL);
-        return(-1);
-    }
+    transformCtx = &(encCtx->transformCtx);
 
-    ret = xmlSecEncCtxCipherDataNodeRead(encCtx, cur);
+    /* initialize context and add ID atributes to the list of known ids */
+    encCtx->operation = xmlSecTransformOperationEncrypt;
+    xmlSecAddIDs(tmpl->doc, tmpl, xmlSecEncIds);
+
+    /* read the template and set encryption method, key, etc. */
+    ret = xmlSecEncCtxEncDataNodeRead(encCtx, tmpl);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecEncCtxCipherDataNodeRead", NULL);
+        xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
+        return(-1);
+    }
+    if((encCtx->type == NULL) ||
+       (!xmlStrEqual(encCtx->type, xmlSecTypeEncElement) && !xmlStrEqual(encCtx->type, xmlSecTypeEncContent))) {
+        xmlSecInvalidStringTypeError("encryption type", encCtx->type,
+                "supported encryption type", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        return(-1);
+    }
+    xmlSecAssert2(transformCtx->first != NULL, -1);
+    encCtx->result = transformCtx->result;
+
+    ret = xmlSecEncCtxWriteOutputStart(encCtx, tmpl, output, &serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputStart", NULL);
+        return(-1);
+    }
+
+    /* libxml2 collects the serialized node in blocks before calling us */
+    writeCtx.encCtx = encCtx;
+    writeCtx.output = output;
+    nodeOutput = xmlOutputBufferCreateIO(xmlSecEncCtxNodeWriteCallback, NULL, &writeCtx, NULL);
+    if(nodeOutput == NULL) {
+        xmlSecXmlError("xmlOutputBufferCreateIO", NULL);
+        xmlBufferFree(serialized);
+        return(-1);
+    }
+
+    if(xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
+        xmlNodeDumpOutput(nodeOutput, node->doc, node, 0, 0, NULL);
+    } else {
+        xmlNodePtr cur;
+
+        for(cur = node->children; cur != NULL; cur = cur->next) {
+            xmlNodeDumpOutput(nodeOutput, node->doc, cur, 0, 0, NULL);
+        }
+    }
+
+    /* close the buffer to push the last block */
+    ret = xmlOutputBufferClose(nodeOutput);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", NULL);
+        xmlBufferFree(serialized);
+        return(-1);
+    }
+
+    ret = xmlSecTransformPushBin(transformCtx->first, NULL, 0, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin", NULL);
+        xmlBufferFree(serialized);
+        return(-1);
+    }
+    transformCtx->status = xmlSecTransformStatusFinished;
+
+    ret = xmlSecEncCtxWriteOutputEnd(encCtx, output, serialized);
+    xmlBufferFree(serialized);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxWriteOutputEnd", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* updates <enc:KeyInfo/> node, serializes @tmpl with a placeholder for the
+ * <enc:CipherValue/> content and writes everything before the placeholder */
+static int
+xmlSecEncCtxWriteOutputStart(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlOutputBufferPtr output,
+                             xmlBufferPtr* serialized) {
+    static const xmlChar placeholder[] = XMLSEC_ENC_CIPHER_VALUE_PLACEHOLDER;
+    const xmlChar* content;
+    const xmlChar* pos;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->encKey != NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+    xmlSecAssert2(serialized != NULL, -1);
+    xmlSecAssert2((*serialized) == NULL, -1);
+
+    /* the data can only be streamed into <enc:CipherValue/> */
+    if(encCtx->cipherValueNode == NULL) {
+        xmlSecNodeNotFoundError("xmlSecEncCtxWriteOutputStart", tmpl, xmlSecNodeCipherValue, NULL);
+        return(-1);
+    }
+
+    if(encCtx->keyInfoNode != NULL) {
+        ret = xmlSecKeyInfoNodeWrite(encCtx->keyInfoNode, encCtx->encKey, &(encCtx->keyInfoWriteCtx));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoNodeWrite", NULL);
+            return(-1);
+        }
+    }
+
+    /* the placeholder includes the tags brackets, drop them for the node content */
+    xmlNodeSetContentLen(encCtx->cipherValueNode, placeholder + 1, xmlStrlen(placeholder) - 2);
+    (*serialized) = xmlBufferCreate();
+    if((*serialized) == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        xmlNodeSetContent(encCtx->cipherValueNode, NULL);
+        return(-1);
+    }
+    ret = xmlNodeDump((*serialized), tmpl->doc, tmpl, 0, 0);
+    xmlNodeSetContent(encCtx->cipherValueNode, NULL);
+    if(ret < 0) {
+        xmlSecXmlError("xmlNodeDump", NULL);
+        xmlBufferFree(*serialized);
+        (*serialized) = NULL;
+        return(-1);
+    }
+
+    content = xmlBufferContent(*serialized);
+    pos = xmlStrstr(content, placeholder);
+    if(pos == NULL) {
+        xmlSecInvalidDataError("cipher value placeholder is not found", NULL);
+        xmlBufferFree(*serialized);
+        (*serialized) = NULL;
+        return(-1);
+    }
+    ret = xmlOutputBufferWrite(output, (int)(pos + 1 - content), (const char*)content);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferWrite", NULL);
+        xmlBufferFree(*serialized);
+        (*serialized) = NULL;
+        return(-1);
+    }
+    return(0);
+}
+
+/* writes the rest of the encrypted data and everything after the placeholder */
+static int
+xmlSecEncCtxWriteOutputEnd(xmlSecEncCtxPtr encCtx, xmlOutputBufferPtr output, xmlBufferPtr serialized) {
+    static const xmlChar placeholder[] = XMLSEC_ENC_CIPHER_VALUE_PLACEHOLDER;
+    const xmlChar* pos;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+    xmlSecAssert2(serialized != NULL, -1);
+
+    ret = xmlSecEncCtxFlushResult(encCtx, output);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+        return(-1);
+    }
+
+    pos = xmlStrstr(xmlBufferContent(serialized), placeholder);
+    xmlSecAssert2(pos != NULL, -1);
+    pos += xmlStrlen(placeholder) - 1;
+
+    ret = xmlOutputBufferWriteString(output, (const char*)pos);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferWriteString", NULL);
+        return(-1);
+    }
+    xmlSecMetricsAdd(xmlSecMetricDataEncrypted, 1);
+    return(0);
+}
+
+/**
+ * xmlSecEncCtxDecrypt:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @node:               the pointer to <enc:EncryptedData/> node.
+ *
+ * Decrypts @node and if necessary replaces @node with decrypted data.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecEncCtxDecrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    xmlSecBufferPtr buffer;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    /* decrypt */
+    buffer = xmlSecEncCtxDecryptToBuffer(encCtx, node);
+    if(buffer == NULL) {
+        xmlSecInternalError("xmlSecEncCtxDecryptToBuffer", NULL);
+        return(-1);
+    }
+
+    /* keep the decrypted XML as is until it is needed */
+    if(((encCtx->flags & XMLSEC_ENC_LAZY_DECRYPTED_DATA) != 0) && (encCtx->type != NULL) &&
+       (xmlStrEqual(encCtx->type, xmlSecTypeEncElement) || xmlStrEqual(encCtx->type, xmlSecTypeEncContent))) {
+        ret = xmlSecEncReplaceNodeLazy(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer),
+                    ((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) ? &(encCtx->replacedNodeList) : NULL);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncReplaceNodeLazy",
+                                xmlSecNodeGetName(node));
+            return(-1);
+        }
+        encCtx->resultReplaced = 1;
+        return(0);
+    }
+
+    /* replace original node if requested */
+    if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
+        /* check if we need to return the replaced node */
+        if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
+                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
+                                        xmlSecNodeGetName(node));
+                    return(-1);
+                }
+        } else {
+                ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer),  xmlSecBufferGetSize(buffer));
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
+                                        xmlSecNodeGetName(node));
+                    return(-1);
+                }
+        }
+
+        encCtx->resultReplaced = 1;
+    } else if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncContent)) {
+        /* replace the node with the buffer */
+
+        /* check if we need to return the replaced node */
+        if((encCtx->flags & XMLSEC_ENC_RETURN_REPLACED_NODE) != 0) {
+                ret = xmlSecReplaceNodeBufferAndReturn(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), &(encCtx->replacedNodeList));
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecReplaceNodeBufferAndReturn",
+                                        xmlSecNodeGetName(node));
+                    return(-1);
+                }
+        } else {
+            ret = xmlSecReplaceNodeBuffer(node, xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer));
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecReplaceNodeBuffer",
+                                        xmlSecNodeGetName(node));
+                    return(-1);
+                }
+        }
+        encCtx->resultReplaced = 1;
+    }
+
+    return(0);
+}
+
+/*
+ * The decrypted XML is kept in a "noenc" text node: libxml2 writes its
+ * content as is when the document is saved and the data is parsed only
+ * if the application asks for it with #xmlSecEncParseLazyDecryptedNodes.
+ */
+static int
+xmlSecEncReplaceNodeLazy(xmlNodePtr node, const xmlSecByte* buffer, xmlSecSize size, xmlNodePtr* replaced) {
+    xmlNodePtr placeholder;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->parent != NULL, -1);
+
+    xmlSecDocCacheTouch(node);
+
+    placeholder = xmlNewDocTextLen(node->doc, (const xmlChar*)buffer, (int)size);
+    if(placeholder == NULL) {
+        xmlSecXmlError2("xmlNewDocTextLen", NULL, "size=%d", (int)size);
+        return(-1);
+    }
+    placeholder->name = xmlStringTextNoenc;
+    xmlReplaceNode(node, placeholder);
+
+    /* return the old node if requested */
+    if(replaced != NULL) {
+        (*replaced) = node;
+    } else {
+        xmlFreeNode(node);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecEncIsLazyDecryptedNode:
+ * @node:               the pointer to an XML node.
+ *
+ * Checks if @node holds the not yet parsed decrypted XML data
+ * (see #XMLSEC_ENC_LAZY_DECRYPTED_DATA).
+ *
+ * Returns: 1 if @node is a decrypted data placeholder or 0 otherwise.
+ */
+int
+xmlSecEncIsLazyDecryptedNode(xmlNodePtr node) {
+    xmlSecAssert2(node != NULL, 0);
+
+    return(((node->type == XML_TEXT_NODE) && (node->name == xmlStringTextNoenc)) ? 1 : 0);
+}
+
+/**
+ * xmlSecEncParseLazyDecryptedNodes:
+ * @node:               the pointer to an XML node.
+ *
+ * Parses the decrypted XML data kept by #xmlSecEncCtxDecrypt with the
+ * #XMLSEC_ENC_LAZY_DECRYPTED_DATA flag in @node or its descendants and
+ * replaces the placeholders with the parsed nodes. If @node itself is
+ * a placeholder then it is destroyed.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecEncParseLazyDecryptedNodes(xmlNodePtr node) {
+    xmlNodePtr cur;
+    xmlNodePtr next;
+    int ret;
+
+    xmlSecAssert2(node != NULL, -1);
+
+    if(xmlSecEncIsLazyDecryptedNode(node) == 1) {
+        ret = xmlSecReplaceNodeBuffer(node, node->content, xmlStrlen(node->content));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecReplaceNodeBuffer", NULL);
+            return(-1);
+        }
+        return(0);
+    }
+    if((node->type != XML_ELEMENT_NODE) && (node->type != XML_DOCUMENT_NODE)) {
+        return(0);
+    }
+
+    for(cur = node->children; cur != NULL; cur = next) {
+        next = cur->next;
+        ret = xmlSecEncParseLazyDecryptedNodes(cur);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncParseLazyDecryptedNodes", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * xmlSecEncCtxDecryptToBuffer:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @node:               the pointer to <enc:EncryptedData/> node.
+ *
+ * Decrypts @node data to the @encCtx buffer.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+xmlSecBufferPtr
+xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    return(xmlSecEncCtxDecryptToBufferInternal(encCtx, node, 1));
+}
+
+static xmlSecBufferPtr
+xmlSecEncCtxDecryptToBufferInternal(xmlSecEncCtxPtr encCtx, xmlNodePtr node, int addIds) {
+    void* span;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, NULL);
+    xmlSecAssert2(encCtx->result == NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    /* initialize context and add ID atributes to the list of known ids */
+    encCtx->operation = xmlSecTransformOperationDecrypt;
+    if(addIds != 0) {
+        xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+    }
+
+    ret = xmlSecEncCtxEncDataNodeRead(encCtx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
+        return(NULL);
+    }
+
+    /* decrypt the data */
+    if(encCtx->cipherValueNode != NULL) {
+        span = xmlSecTraceBegin(xmlSecTracePhaseCipher, node, encCtx->userData);
+        ret = xmlSecEncCtxDecryptCipherValue(encCtx, NULL);
+        xmlSecTraceEnd(span, xmlSecTracePhaseCipher, ret);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxDecryptCipherValue", NULL);
+            return(NULL);
+        }
+    } else {
+        span = xmlSecTraceBegin(xmlSecTracePhaseCipher, node, encCtx->userData);
+        ret = xmlSecTransformCtxExecute(&(encCtx->transformCtx), node->doc);
+        xmlSecTraceEnd(span, xmlSecTracePhaseCipher, ret);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformCtxBinaryExecute", NULL);
+            return(NULL);
+        }
+    }
+
+    encCtx->result = encCtx->transformCtx.result;
+    xmlSecAssert2(encCtx->result != NULL, NULL);
+
+    xmlSecMetricsAdd(xmlSecMetricDataDecrypted, 1);
+    return(encCtx->result);
+}
+
+/**
+ * xmlSecEncCtxDecryptToOutput:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @node:               the pointer to <enc:EncryptedData/> node.
+ * @output:             the output buffer for the decrypted data.
+ *
+ * Decrypts @node data and writes it to @output. The <enc:CipherValue/>
+ * content goes through the base64 decoding and the decryption chunk by
+ * chunk and every decrypted chunk is written to @output right away
+ * instead of collecting the whole result in memory. The @node is not
+ * replaced.
+ *
+ * Note that the decrypted data is written before the decryption is
+ * finished: for authenticated ciphers (e.g. AES-GCM) the caller should
+ * discard everything written to @output if this function fails.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecEncCtxDecryptToOutput(xmlSecEncCtxPtr encCtx, xmlNodePtr node, xmlOutputBufferPtr output) {
+    void* span;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    /* initialize context and add ID atributes to the list of known ids */
+    encCtx->operation = xmlSecTransformOperationDecrypt;
+    xmlSecAddIDs(node->doc, node, xmlSecEncIds);
+
+    ret = xmlSecEncCtxEncDataNodeRead(encCtx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
+        return(-1);
+    }
+
+    /* the <enc:CipherReference/> data is not in the document, nothing to pipeline */
+    if(encCtx->cipherValueNode == NULL) {
+        span = xmlSecTraceBegin(xmlSecTracePhaseCipher, node, encCtx->userData);
+        ret = xmlSecTransformCtxExecute(&(encCtx->transformCtx), node->doc);
+        xmlSecTraceEnd(span, xmlSecTracePhaseCipher, ret);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
+            return(-1);
+        }
+        encCtx->result = encCtx->transformCtx.result;
+        ret = xmlSecEncCtxFlushResult(encCtx, output);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+            return(-1);
+        }
+        xmlSecMetricsAdd(xmlSecMetricDataDecrypted, 1);
+        return(0);
+    }
+
+    span = xmlSecTraceBegin(xmlSecTracePhaseCipher, node, encCtx->userData);
+    ret = xmlSecEncCtxDecryptCipherValue(encCtx, output);
+    xmlSecTraceEnd(span, xmlSecTracePhaseCipher, ret);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxDecryptCipherValue", NULL);
+        return(-1);
+    }
+    xmlSecMetricsAdd(xmlSecMetricDataDecrypted, 1);
+    return(0);
+}
+
+/**
+ * XMLSEC_ENC_MAX_THREADS:
+ *
+ * The max number of threads used to encrypt or decrypt <enc:EncryptedData/> nodes.
+ */
+#define XMLSEC_ENC_MAX_THREADS                  16
+
+typedef struct _xmlSecEncDecryptItem {
+    xmlNodePtr                  node;
+    xmlSecKeyPtr                key;
+    xmlSecBufferPtr             buffer;
+    int                         replace;
+    int                         status;
+} xmlSecEncDecryptItem, *xmlSecEncDecryptItemPtr;
+
+typedef struct _xmlSecEncDecryptJob {
+    xmlSecEncDecryptItemPtr     items;
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlMutexPtr                 mutex;
+} xmlSecEncDecryptJob, *xmlSecEncDecryptJobPtr;
+
+typedef struct _xmlSecEncDecryptWorker {
+    xmlSecEncDecryptJobPtr      job;
+    xmlSecEncCtx                encCtx;
+    int                         initialized;
+} xmlSecEncDecryptWorker, *xmlSecEncDecryptWorkerPtr;
+
+static xmlSecSize
+xmlSecEncJobGetThreadsNumber(xmlSecSize size) {
+    xmlSecSize res;
+
+    res = xmlSecExecutorGetThreadsNumber();
+    if(res > XMLSEC_ENC_MAX_THREADS) {
+        res = XMLSEC_ENC_MAX_THREADS;
+    }
+    if(res > size) {
+        res = size;
+    }
+    return(res);
+}
+
+static void
+xmlSecEncDecryptKeyDestroy(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlSecKeyDestroy((xmlSecKeyPtr)payload);
+    }
+}
+
+/*
+ * The keys are shared by the <enc:EncryptedData/> nodes from the same document
+ * with the same encryption method and the same <dsig:KeyInfo/> content (e.g.
+ * the same <enc:EncryptedKey/> or <dsig:RetrievalMethod/>).
+ */
+static xmlBufferPtr
+xmlSecEncDecryptKeyName(xmlNodePtr node) {
+    xmlBufferPtr res;
+    xmlNodePtr cur;
+    xmlChar* alg = NULL;
+    char buf[64];
+
+    xmlSecAssert2(node != NULL, NULL);
+    xmlSecAssert2(node->doc != NULL, NULL);
+
+    res = xmlBufferCreate();
+    if(res == NULL) {
+        xmlSecXmlError("xmlBufferCreate", NULL);
+        return(NULL);
+    }
+
+    cur = xmlSecGetNextElementNode(node->children);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeEncryptionMethod, xmlSecEncNs))) {
+        alg = xmlGetProp(cur, xmlSecAttrAlgorithm);
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    (void)snprintf(buf, sizeof(buf), "%p|", (void*)node->doc);
+    xmlBufferCCat(res, buf);
+    if(alg != NULL) {
+        xmlBufferCat(res, alg);
+        xmlFree(alg);
+    }
+    xmlBufferCCat(res, "|");
+
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
+        if(xmlNodeDump(res, cur->doc, cur, 0, 0) < 0) {
+            xmlSecXmlError("xmlNodeDump", NULL);
+            xmlBufferFree(res);
+            return(NULL);
+        }
+    }
+    return(res);
+}
+
+static xmlSecKeyPtr
+xmlSecEncDecryptKeyResolve(xmlSecEncCtxPtr encCtx, xmlHashTablePtr keys, xmlNodePtr node) {
+    xmlSecEncCtx tmpCtx;
+    xmlBufferPtr name;
+    xmlSecKeyPtr key;
+    xmlSecKeyPtr res = NULL;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, NULL);
+    xmlSecAssert2(keys != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    name = xmlSecEncDecryptKeyName(node);
+    if(name == NULL) {
+        xmlSecInternalError("xmlSecEncDecryptKeyName", NULL);
+        return(NULL);
+    }
+
+    key = (xmlSecKeyPtr)xmlHashLookup(keys, xmlBufferContent(name));
+    if(key != NULL) {
+        res = xmlSecKeyDuplicate(key);
+        if(res == NULL) {
+            xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        }
+        xmlBufferFree(name);
+        return(res);
+    }
+
+    /* read the node with a temp context to get the key exactly as xmlSecEncCtxDecrypt would */
+    ret = xmlSecEncCtxInitialize(&tmpCtx, encCtx->keyInfoReadCtx.keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxInitialize", NULL);
+        xmlBufferFree(name);
+        return(NULL);
+    }
+    ret = xmlSecEncCtxCopyUserPref(&tmpCtx, encCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxCopyUserPref", NULL);
+        goto done;
+    }
+    tmpCtx.operation = xmlSecTransformOperationDecrypt;
+    ret = xmlSecEncCtxEncDataNodeRead(&tmpCtx, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
+        goto done;
+    }
+    xmlSecAssert2(tmpCtx.encKey != NULL, NULL);
+
+    key = xmlSecKeyDuplicate(tmpCtx.encKey);
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+        goto done;
+    }
+    ret = xmlHashAddEntry(keys, xmlBufferContent(name), key);
+    if(ret != 0) {
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        xmlSecKeyDestroy(key);
+        goto done;
+    }
+
+    /* success */
+    res = tmpCtx.encKey;
+    tmpCtx.encKey = NULL;
+
+done:
+    xmlSecEncCtxFinalize(&tmpCtx);
+    xmlBufferFree(name);
+    return(res);
+}
+
+static void
+xmlSecEncDecryptWorkerRun(xmlSecEncDecryptWorkerPtr worker) {
+    xmlSecEncDecryptJobPtr job;
+    xmlSecEncDecryptItemPtr item;
+    xmlSecBufferPtr buffer;
+    xmlSecSize pos;
+
+    xmlSecAssert(worker != NULL);
+    xmlSecAssert(worker->job != NULL);
+    xmlSecAssert(worker->job->mutex != NULL);
+
+    job = worker->job;
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = job->next;
+        if(pos < job->size) {
+            ++job->next;
+        }
+        xmlMutexUnlock(job->mutex);
+
+        if(pos >= job->size) {
+            break;
+        }
+        item = &(job->items[pos]);
+        if(item->key == NULL) {
+            /* the key was not found, the error is already reported */
+            continue;
+        }
+
+        xmlSecEncCtxReset(&(worker->encCtx));
+        worker->encCtx.encKey = item->key;
+        item->key = NULL;
+
+        /* the ids are already added and the documents are not modified */
+        buffer = xmlSecEncCtxDecryptToBufferInternal(&(worker->encCtx), item->node, 0);
+        if(buffer == NULL) {
+            xmlSecInternalError("xmlSecEncCtxDecryptToBufferInternal", NULL);
+            continue;
+        }
+
+        /* the result buffer is owned by the context, take its content */
+        item->buffer = xmlSecBufferCreate(0);
+        if(item->buffer == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", NULL);
+            continue;
+        }
+        if(xmlSecBufferSwap(item->buffer, buffer) < 0) {
+            xmlSecInternalError("xmlSecBufferSwap", NULL);
+            xmlSecBufferDestroy(item->buffer);
+            item->buffer = NULL;
+            continue;
+        }
+
+        if(worker->encCtx.type != NULL) {
+            item->replace = (xmlStrEqual(worker->encCtx.type, xmlSecTypeEncElement) ||
+                             xmlStrEqual(worker->encCtx.type, xmlSecTypeEncContent)) ? 1 : 0;
+        }
+        item->status = 0;
+    }
+}
+
+static void
+xmlSecEncDecryptWorkerTask(void* data) {
+    xmlSecEncDecryptWorkerRun((xmlSecEncDecryptWorkerPtr)data);
+}
+
+static int
+xmlSecEncDecryptWorkerInitialize(xmlSecEncDecryptWorkerPtr worker, xmlSecEncDecryptJobPtr job,
+                                 xmlSecEncCtxPtr encCtx) {
+    int ret;
+
+    xmlSecAssert2(worker != NULL, -1);
+    xmlSecAssert2(job != NULL, -1);
+    xmlSecAssert2(encCtx != NULL, -1);
+
+    memset(worker, 0, sizeof(xmlSecEncDecryptWorker));
+    worker->job = job;
+
+    ret = xmlSecEncCtxInitialize(&(worker->encCtx), encCtx->keyInfoReadCtx.keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxInitialize", NULL);
+        return(-1);
+    }
+    worker->initialized = 1;
+
+    ret = xmlSecEncCtxCopyUserPref(&(worker->encCtx), encCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxCopyUserPref", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecEncDecryptWorkerFinalize(xmlSecEncDecryptWorkerPtr worker) {
+    xmlSecAssert(worker != NULL);
+
+    if(worker->initialized != 0) {
+        xmlSecEncCtxFinalize(&(worker->encCtx));
+    }
+    memset(worker, 0, sizeof(xmlSecEncDecryptWorker));
+}
+
+/**
+ * xmlSecEncCtxDecryptParallel:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @nodes:              the array of <enc:EncryptedData/> nodes in the document order.
+ * @nodesSize:          the number of nodes in @nodes.
+ * @results:            the array of @nodesSize elements for the decryption results.
+ *
+ * Decrypts the @nodes (e.g. several encrypted parts of the same document)
+ * on the worker threads and replaces the nodes with the decrypted data
+ * exactly as #xmlSecEncCtxDecrypt does. The decryption key is resolved
+ * once for all the nodes from the same document with the same encryption
+ * method and the same <dsig:KeyInfo/> content (or the key from @encCtx is
+ * used if it is set). The ciphers run concurrently, each thread uses its
+ * own copy of @encCtx settings. The nodes are replaced in the current
+ * thread after all the nodes are decrypted, the replaced nodes are
+ * freed (the #XMLSEC_ENC_RETURN_REPLACED_NODE flag is ignored). The nodes
+ * must not be nested and the documents must not be modified while the
+ * function runs.
+ *
+ * The result of nodes[i] processing is returned in results[i]: 0 on
+ * success or a negative value if an error occurs. The results of the
+ * individual nodes are not kept in @encCtx. The workers are run by
+ * the executor set with #xmlSecExecutorSetCallback.
+ *
+ * Returns: 0 on success (check @results to get the individual nodes
+ * decryption results) or a negative value if an error occurs.
+ */
+int
+xmlSecEncCtxDecryptParallel(xmlSecEncCtxPtr encCtx, xmlNodePtr* nodes, xmlSecSize nodesSize,
+                            int* results) {
+    xmlSecEncDecryptJob job;
+    xmlSecEncDecryptWorker workers[XMLSEC_ENC_MAX_THREADS];
+    void* tasks[XMLSEC_ENC_MAX_THREADS];
+    xmlHashTablePtr keys = NULL;
+    xmlSecEncDecryptItemPtr item;
+    xmlSecSize threadsNum, ii;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(results != NULL, -1);
+
+    memset(&job, 0, sizeof(job));
+    memset(workers, 0, sizeof(workers));
+
+    /* the ids are added once (and not by the threads) */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        xmlSecAssert2(nodes[ii] != NULL, -1);
+        xmlSecAssert2(nodes[ii]->doc != NULL, -1);
+
+        results[ii] = -1;
+        xmlSecAddIDs(nodes[ii]->doc, nodes[ii], xmlSecEncIds);
+    }
+    threadsNum = xmlSecEncJobGetThreadsNumber(nodesSize);
+    if(threadsNum == 0) {
+        return(0);
+    }
+
+    job.size = nodesSize;
+    job.items = (xmlSecEncDecryptItemPtr)xmlMalloc(sizeof(xmlSecEncDecryptItem) * nodesSize);
+    if(job.items == NULL) {
+        xmlSecMallocError(sizeof(xmlSecEncDecryptItem) * nodesSize, NULL);
+        return(-1);
+    }
+    memset(job.items, 0, sizeof(xmlSecEncDecryptItem) * nodesSize);
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        goto done;
+    }
+    keys = xmlHashCreate(0);
+    if(keys == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        goto done;
+    }
+
+    /* resolve the keys in the current thread: the keys manager is not touched by the workers */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        item->node = nodes[ii];
+        item->status = -1;
+
+        if(encCtx->encKey != NULL) {
+            item->key = xmlSecKeyDuplicate(encCtx->encKey);
+            if(item->key == NULL) {
+                xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+                goto done;
+            }
+        } else {
+            /* not fatal: only this node fails */
+            item->key = xmlSecEncDecryptKeyResolve(encCtx, keys, item->node);
+        }
+    }
+
+    for(ii = 0; ii < threadsNum; ++ii) {
+        ret = xmlSecEncDecryptWorkerInitialize(&(workers[ii]), &job, encCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncDecryptWorkerInitialize", NULL);
+            goto done;
+        }
+        tasks[ii] = &(workers[ii]);
+    }
+
+    /* decrypt */
+    ret = xmlSecExecutorRun(xmlSecEncDecryptWorkerTask, tasks, threadsNum);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+
+    /* replace the nodes in the current thread */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        if(item->status < 0) {
+            continue;
+        }
+        if((item->replace != 0) && ((encCtx->flags & XMLSEC_ENC_LAZY_DECRYPTED_DATA) != 0)) {
+            ret = xmlSecEncReplaceNodeLazy(item->node, xmlSecBufferGetData(item->buffer),
+                                           xmlSecBufferGetSize(item->buffer), NULL);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecEncReplaceNodeLazy", NULL);
+                continue;
+            }
+        } else if(item->replace != 0) {
+            ret = xmlSecReplaceNodeBuffer(item->node, xmlSecBufferGetData(item->buffer),
+                                          xmlSecBufferGetSize(item->buffer));
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecReplaceNodeBuffer", NULL);
+                continue;
+            }
+        }
+        results[ii] = 0;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    for(ii = 0; ii < threadsNum; ++ii) {
+        xmlSecEncDecryptWorkerFinalize(&(workers[ii]));
+    }
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        if(item->key != NULL) {
+            xmlSecKeyDestroy(item->key);
+        }
+        if(item->buffer != NULL) {
+            xmlSecBufferDestroy(item->buffer);
+        }
+    }
+    if(keys != NULL) {
+        xmlHashFree(keys, xmlSecEncDecryptKeyDestroy);
+    }
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    xmlFree(job.items);
+    return(res);
+}
+
+typedef struct _xmlSecEncEncryptItem {
+    xmlNodePtr                  node;
+    xmlNodePtr                  encNode;
+    xmlNodePtr                  cipherValueNode;
+    xmlSecBufferPtr             buffer;
+    int                         content;
+    int                         status;
+} xmlSecEncEncryptItem, *xmlSecEncEncryptItemPtr;
+
+typedef struct _xmlSecEncEncryptJob {
+    xmlSecEncEncryptItemPtr     items;
+    xmlSecSize                  size;
+    xmlSecSize                  next;
+    xmlSecKeyPtr                key;
+    xmlMutexPtr                 mutex;
+} xmlSecEncEncryptJob, *xmlSecEncEncryptJobPtr;
+
+typedef struct _xmlSecEncEncryptWorker {
+    xmlSecEncEncryptJobPtr      job;
+    xmlSecEncCtx                encCtx;
+    int                         initialized;
+} xmlSecEncEncryptWorker, *xmlSecEncEncryptWorkerPtr;
+
+/* generates a new key for the <enc:EncryptionMethod/> from the template */
+static xmlSecKeyPtr
+xmlSecEncCtxGenerateSessionKey(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformPtr encMethod;
+    xmlSecKeyReq keyReq;
+    xmlNodePtr cur;
+    xmlSecKeyPtr res = NULL;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, NULL);
+    xmlSecAssert2(tmpl != NULL, NULL);
+
+    ret = xmlSecTransformCtxInitialize(&transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxInitialize", NULL);
+        return(NULL);
+    }
+    ret = xmlSecKeyReqInitialize(&keyReq);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyReqInitialize", NULL);
+        xmlSecTransformCtxFinalize(&transformCtx);
+        return(NULL);
+    }
+
+    cur = xmlSecGetNextElementNode(tmpl->children);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeEncryptionMethod, xmlSecEncNs))) {
+        encMethod = xmlSecTransformCtxNodeRead(&transformCtx, cur, xmlSecTransformUsageEncryptionMethod);
+        if(encMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxNodeRead", xmlSecNodeGetName(cur));
+            goto done;
+        }
+    } else if(encCtx->defEncMethodId != xmlSecTransformIdUnknown) {
+        encMethod = xmlSecTransformCtxCreateAndAppend(&transformCtx, encCtx->defEncMethodId);
+        if(encMethod == NULL) {
+            xmlSecInternalError("xmlSecTransformCtxCreateAndAppend",
+                    xmlSecTransformKlassGetName(encCtx->defEncMethodId));
+            goto done;
+        }
+    } else {
+        xmlSecInvalidDataError("encryption method not specified", NULL);
+        goto done;
+    }
+    encMethod->operation = xmlSecTransformOperationEncrypt;
+
+    ret = xmlSecTransformSetKeyReq(encMethod, &keyReq);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformSetKeyReq", xmlSecTransformGetName(encMethod));
+        goto done;
+    }
+
+    res = xmlSecKeyGenerate(keyReq.keyId, keyReq.keyBitsSize, xmlSecKeyDataTypeSession);
+    if(res == NULL) {
+        xmlSecInternalError2("xmlSecKeyGenerate", xmlSecTransformGetName(encMethod),
+                             "keyBitsSize=%lu", (unsigned long)keyReq.keyBitsSize);
+        goto done;
+    }
+
+done:
+    xmlSecKeyReqFinalize(&keyReq);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    return(res);
+}
+
+static void
+xmlSecEncEncryptWorkerRun(xmlSecEncEncryptWorkerPtr worker) {
+    xmlSecEncEncryptJobPtr job;
+    xmlSecEncEncryptItemPtr item;
+    xmlSecEncCtxPtr encCtx;
+    xmlOutputBufferPtr output;
+    xmlNodePtr cur;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert(worker != NULL);
+    xmlSecAssert(worker->job != NULL);
+    xmlSecAssert(worker->job->key != NULL);
+    xmlSecAssert(worker->job->mutex != NULL);
+
+    job = worker->job;
+    encCtx = &(worker->encCtx);
+    while(1) {
+        xmlMutexLock(job->mutex);
+        pos = job->next;
+        if(pos < job->size) {
+            ++job->next;
+        }
+        xmlMutexUnlock(job->mutex);
+
+        if(pos >= job->size) {
+            break;
+        }
+        item = &(job->items[pos]);
+
+        xmlSecEncCtxReset(encCtx);
+        encCtx->encKey = xmlSecKeyDuplicate(job->key);
+        if(encCtx->encKey == NULL) {
+            xmlSecInternalError("xmlSecKeyDuplicate", NULL);
+            continue;
+        }
+
+        /* the template copy is not in the document yet and nothing is written to it here */
+        encCtx->operation = xmlSecTransformOperationEncrypt;
+        ret = xmlSecEncCtxEncDataNodeRead(encCtx, item->encNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxEncDataNodeRead", NULL);
+            continue;
+        }
+        if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncElement)) {
+            item->content = 0;
+        } else if((encCtx->type != NULL) && xmlStrEqual(encCtx->type, xmlSecTypeEncContent)) {
+            item->content = 1;
+        } else {
+            xmlSecInvalidStringTypeError("encryption type", encCtx->type,
+                    "supported encryption type", NULL);
+            continue;
+        }
+
+        ret = xmlSecTransformCtxPrepare(&(encCtx->transformCtx), xmlSecTransformDataTypeBin);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+            continue;
+        }
+        output = xmlSecTransformCreateOutputBuffer(encCtx->transformCtx.first, &(encCtx->transformCtx));
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
+                                xmlSecTransformGetName(encCtx->transformCtx.first));
+            continue;
+        }
+        if(item->content == 0) {
+            xmlNodeDumpOutput(output, item->node->doc, item->node, 0, 0, NULL);
+        } else {
+            for(cur = item->node->children; cur != NULL; cur = cur->next) {
+                xmlNodeDumpOutput(output, item->node->doc, cur, 0, 0, NULL);
+            }
+        }
+        ret = xmlOutputBufferClose(output);
+        if(ret < 0) {
+            xmlSecXmlError("xmlOutputBufferClose", NULL);
+            continue;
+        }
+        if(encCtx->transformCtx.result == NULL) {
+            xmlSecInvalidDataError("encryption result is missing", NULL);
+            continue;
+        }
+
+        /* the result buffer is owned by the context, take its content */
+        item->buffer = xmlSecBufferCreate(0);
+        if(item->buffer == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", NULL);
+            continue;
+        }
+        if(xmlSecBufferSwap(item->buffer, encCtx->transformCtx.result) < 0) {
+            xmlSecInternalError("xmlSecBufferSwap", NULL);
+            xmlSecBufferDestroy(item->buffer);
+            item->buffer = NULL;
+            continue;
+        }
+        item->cipherValueNode = encCtx->cipherValueNode;
+        item->status = 0;
+    }
+}
+
+static void
+xmlSecEncEncryptWorkerTask(void* data) {
+    xmlSecEncEncryptWorkerRun((xmlSecEncEncryptWorkerPtr)data);
+}
+
+static int
+xmlSecEncEncryptWorkerInitialize(xmlSecEncEncryptWorkerPtr worker, xmlSecEncEncryptJobPtr job,
+                                 xmlSecEncCtxPtr encCtx) {
+    int ret;
+
+    xmlSecAssert2(worker != NULL, -1);
+    xmlSecAssert2(job != NULL, -1);
+    xmlSecAssert2(encCtx != NULL, -1);
+
+    memset(worker, 0, sizeof(xmlSecEncEncryptWorker));
+    worker->job = job;
+
+    ret = xmlSecEncCtxInitialize(&(worker->encCtx), encCtx->keyInfoReadCtx.keysMngr);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxInitialize", NULL);
+        return(-1);
+    }
+    worker->initialized = 1;
+
+    ret = xmlSecEncCtxCopyUserPref(&(worker->encCtx), encCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxCopyUserPref", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+xmlSecEncEncryptWorkerFinalize(xmlSecEncEncryptWorkerPtr worker) {
+    xmlSecAssert(worker != NULL);
+
+    if(worker->initialized != 0) {
+        xmlSecEncCtxFinalize(&(worker->encCtx));
+    }
+    memset(worker, 0, sizeof(xmlSecEncEncryptWorker));
+}
+
+static xmlChar*
+xmlSecEncEncryptItemGetId(const xmlChar* prefix, xmlSecSize pos) {
+    xmlChar* res;
+    int len;
+    int ret;
+
+    xmlSecAssert2(prefix != NULL, NULL);
+
+    len = xmlStrlen(prefix) + 32;
+    res = (xmlChar*)xmlMalloc(len);
+    if(res == NULL) {
+        xmlSecMallocError(len, NULL);
+        return(NULL);
+    }
+    ret = xmlStrPrintf(res, len, "%s-%lu", (const char*)prefix, (unsigned long)pos);
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        xmlFree(res);
+        return(NULL);
+    }
+    return(res);
+}
+
+/* adds <enc:DataReference/> to the <enc:EncryptedKey/> and sets the node id */
+static int
+xmlSecEncEncryptItemSetId(xmlNodePtr encNode, xmlNodePtr encKeyNode, const xmlChar* id) {
+    xmlChar* uri;
+
+    xmlSecAssert2(encNode != NULL, -1);
+    xmlSecAssert2(id != NULL, -1);
+
+    if(xmlSetProp(encNode, xmlSecAttrId, id) == NULL) {
+        xmlSecXmlError2("xmlSetProp", NULL, "name=%s", xmlSecErrorsSafeString(xmlSecAttrId));
+        return(-1);
+    }
+    if(encKeyNode == NULL) {
+        return(0);
+    }
+
+    uri = xmlStrncatNew(BAD_CAST "#", id, -1);
+    if(uri == NULL) {
+        xmlSecStrdupError(id, NULL);
+        return(-1);
+    }
+    if(xmlSecTmplReferenceListAddDataReference(encKeyNode, uri) == NULL) {
+        xmlSecInternalError("xmlSecTmplReferenceListAddDataReference", NULL);
+        xmlFree(uri);
+        return(-1);
+    }
+    xmlFree(uri);
+    return(0);
+}
+
+/**
+ * xmlSecEncCtxXmlEncryptMultiple:
+ * @encCtx:             the pointer to <enc:EncryptedData/> processing context.
+ * @tmpl:               the pointer to <enc:EncryptedData/> template node.
+ * @nodes:              the array of nodes for encryption.
+ * @nodesSize:          the number of nodes in @nodes.
+ *
+ * Encrypts every node in @nodes with the same key according to template
+ * @tmpl and replaces the nodes (or their content) with the result
+ * <enc:EncryptedData/> nodes exactly as #xmlSecEncCtxXmlEncrypt does.
+ * If @encCtx has no key, then a new session key is generated for the
+ * template encryption method. The <dsig:KeyInfo/> in @tmpl is written
+ * once: if it has an <enc:EncryptedKey/> child, the key is encrypted
+ * once, an <enc:DataReference/> for every <enc:EncryptedData/> node is
+ * added to it and the other <enc:EncryptedData/> nodes refer to it with
+ * a <dsig:RetrievalMethod/>. The <enc:EncryptedData/> nodes get "Id"
+ * attributes based on the @tmpl id (if any) and the <enc:EncryptedKey/>
+ * node gets an "Id" attribute if it doesn't have one.
+ *
+ * The @tmpl is used for the first node and copied for the other nodes.
+ * The nodes are encrypted on the worker threads (each thread uses its own
+ * copy of @encCtx settings) and replaced in the current thread after all
+ * the nodes are encrypted: if any node fails, then the document is not
+ * changed. The replaced nodes are freed (the #XMLSEC_ENC_RETURN_REPLACED_NODE
+ * flag is ignored). The nodes must be in the @tmpl document and must not
+ * be nested. The workers are run by the executor set with
+ * #xmlSecExecutorSetCallback.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecEncCtxXmlEncryptMultiple(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl, xmlNodePtr* nodes,
+                               xmlSecSize nodesSize) {
+    xmlSecEncEncryptJob job;
+    xmlSecEncEncryptWorker workers[XMLSEC_ENC_MAX_THREADS];
+    void* tasks[XMLSEC_ENC_MAX_THREADS];
+    xmlSecEncEncryptItemPtr item;
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr encKeyNode = NULL;
+    xmlNodePtr cur;
+    xmlChar* prefix = NULL;
+    xmlChar* keyId = NULL;
+    xmlChar* id = NULL;
+    xmlChar* uri = NULL;
+    xmlSecSize threadsNum = 0;
+    xmlSecSize ii;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result == NULL, -1);
+    xmlSecAssert2(tmpl != NULL, -1);
+    xmlSecAssert2(tmpl->doc != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+
+    for(ii = 0; ii < nodesSize; ++ii) {
+        xmlSecAssert2(nodes[ii] != NULL, -1);
+        xmlSecAssert2(nodes[ii]->doc == tmpl->doc, -1);
+    }
+    if(nodesSize == 0) {
+        return(0);
+    }
+
+    memset(&job, 0, sizeof(job));
+    memset(workers, 0, sizeof(workers));
+
+    job.size = nodesSize;
+    job.items = (xmlSecEncEncryptItemPtr)xmlMalloc(sizeof(xmlSecEncEncryptItem) * nodesSize);
+    if(job.items == NULL) {
+        xmlSecMallocError(sizeof(xmlSecEncEncryptItem) * nodesSize, NULL);
+        return(-1);
+    }
+    memset(job.items, 0, sizeof(xmlSecEncEncryptItem) * nodesSize);
+    job.mutex = xmlNewMutex();
+    if(job.mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        goto done;
+    }
+
+    /* one key for all the nodes */
+    if(encCtx->encKey == NULL) {
+        encCtx->encKey = xmlSecEncCtxGenerateSessionKey(encCtx, tmpl);
+        if(encCtx->encKey == NULL) {
+            xmlSecInternalError("xmlSecEncCtxGenerateSessionKey", NULL);
+            goto done;
+        }
+    }
+    job.key = encCtx->encKey;
+
+    /* write <dsig:KeyInfo/> once (i.e. encrypt the key once for <enc:EncryptedKey/>) */
+    encCtx->operation = xmlSecTransformOperationEncrypt;
+    keyInfoNode = xmlSecFindChild(tmpl, xmlSecNodeKeyInfo, xmlSecDSigNs);
+    if(keyInfoNode != NULL) {
+        ret = xmlSecKeyInfoNodeWrite(keyInfoNode, encCtx->encKey, &(encCtx->keyInfoWriteCtx));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoNodeWrite", NULL);
+            goto done;
+        }
+        encKeyNode = xmlSecFindChild(keyInfoNode, xmlSecNodeEncryptedKey, xmlSecEncNs);
+    }
+
+    /* the ids for the references */
+    prefix = xmlGetProp(tmpl, xmlSecAttrId);
+    if(prefix == NULL) {
+        prefix = xmlStrdup(BAD_CAST "enc-data");
+        if(prefix == NULL) {
+            xmlSecStrdupError(BAD_CAST "enc-data", NULL);
+            goto done;
+        }
+    }
+    if(encKeyNode != NULL) {
+        keyId = xmlGetProp(encKeyNode, xmlSecAttrId);
+        if(keyId == NULL) {
+            keyId = xmlStrncatNew(prefix, BAD_CAST "-key", -1);
+            if(keyId == NULL) {
+                xmlSecStrdupError(prefix, NULL);
+                goto done;
+            }
+            if(xmlSetProp(encKeyNode, xmlSecAttrId, keyId) == NULL) {
+                xmlSecXmlError2("xmlSetProp", NULL, "name=%s", xmlSecErrorsSafeString(xmlSecAttrId));
+                goto done;
+            }
+        }
+        uri = xmlStrncatNew(BAD_CAST "#", keyId, -1);
+        if(uri == NULL) {
+            xmlSecStrdupError(keyId, NULL);
+            goto done;
+        }
+    }
+
+    /* the template copies are created in the current thread (the document dictionary is not thread safe) */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        item->node = nodes[ii];
+        item->status = -1;
+
+        if(ii == 0) {
+            item->encNode = tmpl;
+        } else {
+            item->encNode = xmlDocCopyNode(tmpl, tmpl->doc, 1);
+            if(item->encNode == NULL) {
+                xmlSecXmlError("xmlDocCopyNode", NULL);
+                goto done;
+            }
+
+            /* refer to the only <enc:EncryptedKey/> */
+            cur = xmlSecFindChild(item->encNode, xmlSecNodeKeyInfo, xmlSecDSigNs);
+            if((uri != NULL) && (cur != NULL)) {
+                xmlNodeSetContent(cur, NULL);
+                if(xmlSecTmplKeyInfoAddRetrievalMethod(cur, uri, xmlSecHrefEncryptedKey) == NULL) {
+                    xmlSecInternalError("xmlSecTmplKeyInfoAddRetrievalMethod", NULL);
+                    goto done;
+                }
+            }
+        }
+
+        id = xmlSecEncEncryptItemGetId(prefix, ii);
+        if(id == NULL) {
+            xmlSecInternalError("xmlSecEncEncryptItemGetId", NULL);
+            goto done;
+        }
+        ret = xmlSecEncEncryptItemSetId(item->encNode, encKeyNode, id);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncEncryptItemSetId", NULL);
+            goto done;
+        }
+        xmlFree(id);
+        id = NULL;
+    }
+    for(ii = 0; ii < nodesSize; ++ii) {
+        xmlSecAddIDs(tmpl->doc, job.items[ii].encNode, xmlSecEncIds);
+    }
+
+    threadsNum = xmlSecEncJobGetThreadsNumber(nodesSize);
+    for(ii = 0; ii < threadsNum; ++ii) {
+        ret = xmlSecEncEncryptWorkerInitialize(&(workers[ii]), &job, encCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncEncryptWorkerInitialize", NULL);
+            goto done;
+        }
+        tasks[ii] = &(workers[ii]);
+    }
+
+    /* encrypt */
+    ret = xmlSecExecutorRun(xmlSecEncEncryptWorkerTask, tasks, threadsNum);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecExecutorRun", NULL);
+        goto done;
+    }
+
+    for(ii = 0; ii < nodesSize; ++ii) {
+        if(job.items[ii].status < 0) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_XMLSEC_FAILED, NULL,
+                              "node=%lu", (unsigned long)ii);
+            goto done;
+        }
+    }
+
+    /* write the results and update the document in the current thread */
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        if(item->cipherValueNode != NULL) {
+            xmlNodeSetContentLen(item->cipherValueNode,
+                                 xmlSecBufferGetData(item->buffer),
+                                 xmlSecBufferGetSize(item->buffer));
+        }
+        if(item->content == 0) {
+            ret = xmlSecReplaceNode(item->node, item->encNode);
+        } else {
+            ret = xmlSecReplaceContent(item->node, item->encNode);
+        }
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecReplaceNode", xmlSecNodeGetName(item->node));
+            goto done;
+        }
+        /* the node is in the document now */
+        item->encNode = NULL;
+    }
+    encCtx->resultReplaced = 1;
+
+    /* success */
+    res = 0;
+
+done:
+    for(ii = 0; ii < threadsNum; ++ii) {
+        xmlSecEncEncryptWorkerFinalize(&(workers[ii]));
+    }
+    for(ii = 0; ii < nodesSize; ++ii) {
+        item = &(job.items[ii]);
+        if((item->encNode != NULL) && (item->encNode != tmpl)) {
+            xmlFreeNode(item->encNode);
+        }
+        if(item->buffer != NULL) {
+            xmlSecBufferDestroy(item->buffer);
+        }
+    }
+    if(id != NULL) {
+        xmlFree(id);
+    }
+    if(uri != NULL) {
+        xmlFree(uri);
+    }
+    if(keyId != NULL) {
+        xmlFree(keyId);
+    }
+    if(prefix != NULL) {
+        xmlFree(prefix);
+    }
+    if(job.mutex != NULL) {
+        xmlFreeMutex(job.mutex);
+    }
+    xmlFree(job.items);
+    return(res);
+}
+
+/*
+ * Pushes the <enc:CipherValue/> text nodes content directly (without copying it)
+ * to the transforms chain. If @output is not NULL then the decrypted data is
+ * written to it chunk by chunk, otherwise the whole result is collected in
+ * encCtx->result (allocated once for the max possible size).
+ */
+static int
+xmlSecEncCtxDecryptCipherValue(xmlSecEncCtxPtr encCtx, xmlOutputBufferPtr output) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlNodePtr cur;
+    const xmlChar* data;
+    xmlSecSize dataSize, chunkSize;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->cipherValueNode != NULL, -1);
+
+    transformCtx = &(encCtx->transformCtx);
+
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        return(-1);
+    }
+    encCtx->result = transformCtx->result;
+
+    /* the decrypted data is not bigger than the base64 decoded data */
+    if(output == NULL) {
+        for(dataSize = 0, cur = encCtx->cipherValueNode->children; cur != NULL; cur = cur->next) {
+            if(((cur->type == XML_TEXT_NODE) || (cur->type == XML_CDATA_SECTION_NODE)) && (cur->content != NULL)) {
+                dataSize += XMLSEC_SIZE_BAD_CAST(xmlStrlen(cur->content));
+            }
+        }
+        if(dataSize == 0) {
+            xmlSecInvalidNodeContentError(encCtx->cipherValueNode, NULL, "empty");
+            return(-1);
+        }
+        ret = xmlSecBufferSetMaxSize(encCtx->result, 3 * (dataSize / 4) + 3);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetMaxSize", NULL,
+                                 "size=" XMLSEC_SIZE_FMT, 3 * (dataSize / 4) + 3);
+            return(-1);
+        }
+    }
+
+    for(cur = encCtx->cipherValueNode->children; cur != NULL; cur = cur->next) {
+        if(((cur->type != XML_TEXT_NODE) && (cur->type != XML_CDATA_SECTION_NODE)) || (cur->content == NULL)) {
+            continue;
+        }
+
+        data = cur->content;
+        dataSize = XMLSEC_SIZE_BAD_CAST(xmlStrlen(data));
+        while(dataSize > 0) {
+            /* without output, the whole text node goes in one batch */
+            chunkSize = (output != NULL) ? xmlSecTransformCtxGetBinaryChunkSize(transformCtx) : dataSize;
+            if(chunkSize > dataSize) {
+                chunkSize = dataSize;
+            }
+
+            ret = xmlSecTransformPushBin(transformCtx->first, data, chunkSize, 0, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                                     "dataSize=" XMLSEC_SIZE_FMT, chunkSize);
+                return(-1);
+            }
+            if(output != NULL) {
+                ret = xmlSecEncCtxFlushResult(encCtx, output);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+                    return(-1);
+                }
+                xmlSecTransformCtxUpdateBinaryChunkSize(transformCtx, chunkSize);
+            }
+
+            data += chunkSize;
+            dataSize -= chunkSize;
+        }
+    }
+
+    ret = xmlSecTransformPushBin(transformCtx->first, NULL, 0, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin", NULL);
+        return(-1);
+    }
+    if(output != NULL) {
+        ret = xmlSecEncCtxFlushResult(encCtx, output);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxFlushResult", NULL);
+            return(-1);
+        }
+    }
+    transformCtx->status = xmlSecTransformStatusFinished;
+
+    return(0);
+}
+
+/* writes the decrypted data collected so far to @output and empties the result */
+static int
+xmlSecEncCtxFlushResult(xmlSecEncCtxPtr encCtx, xmlOutputBufferPtr output) {
+    xmlSecSize size;
+    int len;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->result != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    size = xmlSecBufferGetSize(encCtx->result);
+    if(size == 0) {
+        return(0);
+    }
+
+    XMLSEC_SAFE_CAST_SIZE_TO_INT(size, len, return(-1), NULL);
+    ret = xmlOutputBufferWrite(output, len, (const char*)xmlSecBufferGetData(encCtx->result));
+    if(ret < 0) {
+        xmlSecXmlError2("xmlOutputBufferWrite", NULL, "size=" XMLSEC_SIZE_FMT, size);
+        return(-1);
+    }
+    xmlSecBufferEmpty(encCtx->result);
+    return(0);
+}
+
+static int
+xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    xmlNodePtr cur;
+    xmlSecArenaPtr arena;
+    void* span;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2((encCtx->operation == xmlSecTransformOperationEncrypt) || (encCtx->operation == xmlSecTransformOperationDecrypt), -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    switch(encCtx->mode) {
+        case xmlEncCtxModeEncryptedData:
+            if(!xmlSecCheckNodeName(node, xmlSecNodeEncryptedData, xmlSecEncNs)) {
+                xmlSecInvalidNodeError(node, xmlSecNodeEncryptedData, NULL);
+                return(-1);
+            }
+            break;
+        case xmlEncCtxModeEncryptedKey:
+            if(!xmlSecCheckNodeName(node, xmlSecNodeEncryptedKey, xmlSecEncNs)) {
+                xmlSecInvalidNodeError(node, xmlSecNodeEncryptedKey, NULL);
+                return(-1);
+            }
+            break;
+    }
+
+    /* first read node data */
+    xmlSecAssert2(encCtx->id == NULL, -1);
+    xmlSecAssert2(encCtx->type == NULL, -1);
+    xmlSecAssert2(encCtx->mimeType == NULL, -1);
+    xmlSecAssert2(encCtx->encoding == NULL, -1);
+    xmlSecAssert2(encCtx->recipient == NULL, -1);
+    xmlSecAssert2(encCtx->carriedKeyName == NULL, -1);
+
+    arena = xmlSecTransformCtxGetArena(&(encCtx->transformCtx));
+    if(arena == NULL) {
+        xmlSecInternalError("xmlSecTransformCtxGetArena", NULL);
+        return(-1);
+    }
+    encCtx->id = xmlSecArenaGetProp(arena, node, xmlSecAttrId);
+    encCtx->type = xmlSecArenaGetProp(arena, node, xmlSecAttrType);
+    encCtx->mimeType = xmlSecArenaGetProp(arena, node, xmlSecAttrMimeType);
+    encCtx->encoding = xmlSecArenaGetProp(arena, node, xmlSecAttrEncoding);
+    if(encCtx->mode == xmlEncCtxModeEncryptedKey) {
+        /* checked with XMLSEC_KEYINFO_FLAGS_ENCKEY_MATCH_RECIPIENT flag */
+        encCtx->recipient = xmlSecArenaGetProp(arena, node, xmlSecAttrRecipient);
+    }
+    cur = xmlSecGetNextElementNode(node->children);
+
+    /* first node is optional EncryptionMethod, we'll read it later */
+    xmlSecAssert2(encCtx->encMethodNode == NULL, -1);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeEncryptionMethod, xmlSecEncNs))) {
+        encCtx->encMethodNode = cur;
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    /* next node is optional KeyInfo, we'll process it later */
+    xmlSecAssert2(encCtx->keyInfoNode == NULL, -1);
+    if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyInfo, xmlSecDSigNs))) {
+        encCtx->keyInfoNode = cur;
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+
+    /* next is required CipherData node */
+    if((cur == NULL) || (!xmlSecCheckNodeName(cur, xmlSecNodeCipherData, xmlSecEncNs))) {
+        xmlSecInvalidNodeError(cur, xmlSecNodeCipherData, NULL);
+        return(-1);
+    }
+
+    ret = xmlSecEncCtxCipherDataNodeRead(encCtx, cur);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecEncCtxCipherDataNodeRead", NULL);
         return(-1);
     }
     cur = xmlSecGetNextElementNode(cur->next);
@@ -764,8 +2525,10 @@ xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     /* TODO: KeyInfo node != NULL and encKey != NULL */
     if((encCtx->encKey == NULL) && (encCtx->keyInfoReadCtx.keysMngr != NULL)
                         && (encCtx->keyInfoReadCtx.keysMngr->getKey != NULL)) {
+        span = xmlSecTraceBegin(xmlSecTracePhaseKeyInfo, encCtx->keyInfoNode, encCtx->userData);
         encCtx->encKey = (encCtx->keyInfoReadCtx.keysMngr->getKey)(encCtx->keyInfoNode,
                                                              &(encCtx->keyInfoReadCtx));
+        xmlSecTraceEnd(span, xmlSecTracePhaseKeyInfo, (encCtx->encKey != NULL) ? 0 : -1);
     }
 
     /* check that we have exactly what we want */
@@ -778,6 +2541,22 @@ xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
         return(-1);
     }
 
+    /* don't waste a private key operation on the <enc:EncryptedKey/> for someone else */
+    if((encCtx->mode == xmlEncCtxModeEncryptedKey) &&
+       (encCtx->operation == xmlSecTransformOperationDecrypt) &&
+       ((encCtx->keyInfoReadCtx.flags & XMLSEC_KEYINFO_FLAGS_ENCKEY_MATCH_RECIPIENT) != 0)) {
+        ret = xmlSecEncCtxEncryptedKeyMatch(encCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxEncryptedKeyMatch", NULL);
+            return(-1);
+        } else if(ret == 0) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_KEY_NOT_FOUND, NULL,
+                              "recipient=%s;key does not match",
+                              xmlSecErrorsSafeString(encCtx->recipient));
+            return(-1);
+        }
+    }
+
     /* set the key to the transform */
     ret = xmlSecTransformSetKey(encCtx->encMethod, encCtx->encKey);
     if(ret < 0) {
@@ -803,6 +2582,215 @@ xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     return(0);
 }
 
+/*
+ * The <enc:EncryptedKey/> matches the key if the key name is the same as
+ * the Recipient attribute and one of the <dsig:KeyName/> elements and
+ * one of the key's certificates has the <dsig:X509SerialNumber/> and
+ * <dsig:X509SKI/> values from the <dsig:X509Data/> elements. Only the
+ * identifiers present in both the node and the key are checked.
+ *
+ * Returns: 1 if the key matches, 0 if it doesn't or a negative value
+ * if an error occurs.
+ */
+static int
+xmlSecEncCtxEncryptedKeyMatch(xmlSecEncCtxPtr encCtx) {
+    const xmlChar* keyName;
+    xmlChar* content;
+    xmlNodePtr cur;
+    int hasKeyNames = 0;
+    int keyNameFound = 0;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->encKey != NULL, -1);
+
+    keyName = xmlSecKeyGetName(encCtx->encKey);
+    if((keyName != NULL) && (encCtx->recipient != NULL) && (!xmlStrEqual(keyName, encCtx->recipient))) {
+        return(0);
+    }
+    if(encCtx->keyInfoNode == NULL) {
+        return(1);
+    }
+
+    for(cur = xmlSecGetNextElementNode(encCtx->keyInfoNode->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if((keyName != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeKeyName, xmlSecDSigNs))) {
+            hasKeyNames = 1;
+            content = xmlNodeGetContent(cur);
+            if(content == NULL) {
+                continue;
+            }
+            if(xmlStrEqual(content, keyName)) {
+                keyNameFound = 1;
+            }
+            xmlFree(content);
+#ifndef XMLSEC_NO_X509
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeX509Data, xmlSecDSigNs)) {
+            ret = xmlSecEncCtxEncryptedKeyMatchX509Data(encCtx, cur);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecEncCtxEncryptedKeyMatchX509Data", NULL);
+                return(-1);
+            } else if(ret == 0) {
+                return(0);
+            }
+#endif /* XMLSEC_NO_X509 */
+        }
+    }
+
+    return(((hasKeyNames == 0) || (keyNameFound != 0)) ? 1 : 0);
+}
+
+#ifndef XMLSEC_NO_X509
+/* returns the node content without whitespaces */
+static xmlChar*
+xmlSecEncCtxGetNormalizedContent(xmlNodePtr node) {
+    xmlChar* content;
+    xmlChar* p;
+    xmlChar* q;
+
+    xmlSecAssert2(node != NULL, NULL);
+
+    content = xmlNodeGetContent(node);
+    if(content == NULL) {
+        return(NULL);
+    }
+    for(p = q = content; (*p) != '\0'; ++p) {
+        if(!isspace((int)(*p))) {
+            *(q++) = *p;
+        }
+    }
+    (*q) = '\0';
+    return(content);
+}
+
+/*
+ * Checks if @keyX509DataNode has the @nodeName (in the @parentName node
+ * if not NULL) with the same value as the node @node.
+ */
+static int
+xmlSecEncCtxX509DataHasValue(xmlNodePtr keyX509DataNode, const xmlChar* parentName,
+                             const xmlChar* nodeName, xmlNodePtr node) {
+    xmlChar* value;
+    xmlChar* content;
+    xmlNodePtr cur;
+    xmlNodePtr valueNode;
+    int res = 0;
+
+    xmlSecAssert2(keyX509DataNode != NULL, -1);
+    xmlSecAssert2(nodeName != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    value = xmlSecEncCtxGetNormalizedContent(node);
+    if(value == NULL) {
+        /* nothing to compare */
+        return(1);
+    }
+
+    for(cur = xmlSecGetNextElementNode(keyX509DataNode->children); (cur != NULL) && (res == 0); cur = xmlSecGetNextElementNode(cur->next)) {
+        if(parentName != NULL) {
+            if(!xmlSecCheckNodeName(cur, parentName, xmlSecDSigNs)) {
+                continue;
+            }
+            valueNode = xmlSecFindChild(cur, nodeName, xmlSecDSigNs);
+        } else {
+            valueNode = xmlSecCheckNodeName(cur, nodeName, xmlSecDSigNs) ? cur : NULL;
+        }
+        if(valueNode == NULL) {
+            continue;
+        }
+
+        content = xmlSecEncCtxGetNormalizedContent(valueNode);
+        if(content != NULL) {
+            res = xmlStrEqual(content, value);
+            xmlFree(content);
+        }
+    }
+
+    xmlFree(value);
+    return(res);
+}
+
+static int
+xmlSecEncCtxEncryptedKeyMatchX509Data(xmlSecEncCtxPtr encCtx, xmlNodePtr x509DataNode) {
+    xmlSecKeyDataPtr data = NULL;
+    xmlNodePtr keyX509DataNode = NULL;
+    xmlNodePtr cur;
+    xmlNodePtr valueNode;
+    xmlNsPtr ns;
+    xmlSecSize size, pos;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->encKey != NULL, -1);
+    xmlSecAssert2(x509DataNode != NULL, -1);
+
+    /* find the key's certificates */
+    size = (encCtx->encKey->dataList != NULL) ? xmlSecPtrListGetSize(encCtx->encKey->dataList) : 0;
+    for(pos = 0; pos < size; ++pos) {
+        data = (xmlSecKeyDataPtr)xmlSecPtrListGetItem(encCtx->encKey->dataList, pos);
+        if((data != NULL) && (data->id->xmlWrite != NULL) &&
+           xmlStrEqual(data->id->dataNodeName, xmlSecNodeX509Data) &&
+           xmlStrEqual(data->id->dataNodeNs, xmlSecDSigNs)) {
+            break;
+        }
+        data = NULL;
+    }
+    if(data == NULL) {
+        /* nothing to compare */
+        return(1);
+    }
+
+    /* write the certificates identifiers */
+    keyX509DataNode = xmlNewDocNode(x509DataNode->doc, NULL, xmlSecNodeX509Data, NULL);
+    if(keyX509DataNode == NULL) {
+        xmlSecXmlError("xmlNewDocNode", NULL);
+        goto done;
+    }
+    ns = xmlNewNs(keyX509DataNode, xmlSecDSigNs, NULL);
+    if(ns == NULL) {
+        xmlSecXmlError("xmlNewNs", NULL);
+        goto done;
+    }
+    xmlSetNs(keyX509DataNode, ns);
+
+    if((xmlSecAddChild(keyX509DataNode, xmlSecNodeX509IssuerSerial, xmlSecDSigNs) == NULL) ||
+       (xmlSecAddChild(keyX509DataNode, xmlSecNodeX509SKI, xmlSecDSigNs) == NULL)) {
+        xmlSecInternalError("xmlSecAddChild", NULL);
+        goto done;
+    }
+
+    ret = xmlSecKeyDataXmlWrite(data->id, encCtx->encKey, keyX509DataNode, &(encCtx->keyInfoWriteCtx));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyDataXmlWrite",
+                            xmlSecKeyDataKlassGetName(data->id));
+        goto done;
+    }
+
+    /* every identifier should belong to one of the key's certificates */
+    res = 1;
+    for(cur = xmlSecGetNextElementNode(x509DataNode->children); (cur != NULL) && (res == 1); cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeX509IssuerSerial, xmlSecDSigNs)) {
+            valueNode = xmlSecFindChild(cur, xmlSecNodeX509SerialNumber, xmlSecDSigNs);
+            if(valueNode != NULL) {
+                res = xmlSecEncCtxX509DataHasValue(keyX509DataNode, xmlSecNodeX509IssuerSerial,
+                                                   xmlSecNodeX509SerialNumber, valueNode);
+            }
+        } else if(xmlSecCheckNodeName(cur, xmlSecNodeX509SKI, xmlSecDSigNs)) {
+            res = xmlSecEncCtxX509DataHasValue(keyX509DataNode, NULL, xmlSecNodeX509SKI, cur);
+        }
+    }
+    if(res < 0) {
+        xmlSecInternalError("xmlSecEncCtxX509DataHasValue", NULL);
+    }
+
+done:
+    if(keyX509DataNode != NULL) {
+        xmlFreeNode(keyX509DataNode);
+    }
+    return(res);
+}
+#endif /* XMLSEC_NO_X509 */
+
 static int
 xmlSecEncCtxEncDataNodeWrite(xmlSecEncCtxPtr encCtx) {
     int ret;
@@ -818,18 +2806,21 @@ xmlSecEncCtxEncDataNodeWrite(xmlSecEncCtxPtr encCtx) {
         xmlNodeSetContentLen(encCtx->cipherValueNode,
                             xmlSecBufferGetData(encCtx->result),
                             xmlSecBufferGetSize(encCtx->result));
+        xmlSecDocCacheTouch(encCtx->cipherValueNode);
         encCtx->resultReplaced = 1;
     }
 
     /* update <enc:KeyInfo/> node */
     if(encCtx->keyInfoNode != NULL) {
         ret = xmlSecKeyInfoNodeWrite(encCtx->keyInfoNode, encCtx->encKey, &(encCtx->keyInfoWriteCtx));
+        xmlSecDocCacheTouch(encCtx->keyInfoNode);
         if(ret < 0) {
             xmlSecInternalError("xmlSecKeyInfoNodeWrite", NULL);
             return(-1);
         }
     }
 
+    xmlSecMetricsAdd(xmlSecMetricDataEncrypted, 1);
     return(0);
 }
 
@@ -22,6 +22,13 @@
 #include <xmlsec/app.h>
 #include <xmlsec/io.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/sharedcache.h>
+
+#include <xmlsec/private/doccache.h>
+#include <xmlsec/private/keygenpool.h>
+#include <xmlsec/private/metrics.h>
+#include <xmlsec/private/parser.h>
+#include <xmlsec/private/random.h>
 
 /*
  * Custom external entity handler, denies all files except the initial
@@ -83,6 +90,26 @@ xmlSecInit(void) {
     xmlSecErrorsInit();
     xmlSecIOInit();
 
+    if(xmlSecMetricsInitialize() < 0) {
+        xmlSecInternalError("xmlSecMetricsInitialize", NULL);
+        return(-1);
+    }
+
+    if(xmlSecRandomInitialize() < 0) {
+        xmlSecInternalError("xmlSecRandomInitialize", NULL);
+        return(-1);
+    }
+
+    if(xmlSecParserCtxtPoolInitialize() < 0) {
+        xmlSecInternalError("xmlSecParserCtxtPoolInitialize", NULL);
+        return(-1);
+    }
+
+    if(xmlSecDocCachesInitialize() < 0) {
+        xmlSecInternalError("xmlSecDocCachesInitialize", NULL);
+        return(-1);
+    }
+
 #ifndef XMLSEC_NO_CRYPTO_DYNAMIC_LOADING
     if(xmlSecCryptoDLInit() < 0) {
         xmlSecInternalError("xmlSecCryptoDLInit", NULL);
@@ -123,6 +150,9 @@ int
 xmlSecShutdown(void) {
     int res = 0;
 
+    /* the keys pool thread uses the crypto library */
+    xmlSecKeyGenPoolStop();
+
     xmlSecTransformIdsShutdown();
     xmlSecKeyDataIdsShutdown();
 
@@ -133,11 +163,46 @@ xmlSecShutdown(void) {
     }
 #endif /* XMLSEC_NO_CRYPTO_DYNAMIC_LOADING */
 
+    xmlSecSharedCacheDestroy();
+    xmlSecDocCachesFinalize();
+    xmlSecParserCtxtPoolFinalize();
+    xmlSecRandomShutdown();
+    xmlSecMetricsShutdown();
     xmlSecIOShutdown();
     xmlSecErrorsShutdown();
     return(res);
 }
 
+/**
+ * xmlSecRegistriesFreeze:
+ *
+ * Freezes the global transform and key data klasses lists and the input
+ * callbacks table (see #xmlSecTransformIdsFreeze, #xmlSecKeyDataIdsFreeze
+ * and #xmlSecIOCallbacksFreeze): after this call the lookups in these
+ * registries are safe from any thread without locks. The application
+ * should call it once the crypto library is initialized and all the custom
+ * klasses and callbacks are registered, before starting the threads. The
+ * registries are unfrozen by #xmlSecShutdown.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecRegistriesFreeze(void) {
+    if(xmlSecTransformIdsFreeze() < 0) {
+        xmlSecInternalError("xmlSecTransformIdsFreeze", NULL);
+        return(-1);
+    }
+    if(xmlSecKeyDataIdsFreeze() < 0) {
+        xmlSecInternalError("xmlSecKeyDataIdsFreeze", NULL);
+        return(-1);
+    }
+    if(xmlSecIOCallbacksFreeze() < 0) {
+        xmlSecInternalError("xmlSecIOCallbacksFreeze", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
 /**
  * xmlSecShutdown:
  *
@@ -149,6 +214,76 @@ const xmlChar * xmlSecGetDefaultCrypto(void) {
     return BAD_CAST XMLSEC_DEFAULT_CRYPTO;
 }
 
+/***********************************************************************
+ *
+ * Tracing
+ *
+ ***********************************************************************/
+static xmlSecTraceBeginCallback xmlSecTraceBeginClbk = NULL;
+static xmlSecTraceEndCallback   xmlSecTraceEndClbk = NULL;
+
+/**
+ * xmlSecTraceSetCallbacks:
+ * @beginCallback:      the callback called when a processing phase starts.
+ * @endCallback:        the callback called when a processing phase ends.
+ *
+ * Sets the tracing callbacks called around the signature and encryption
+ * processing phases (see #xmlSecTracePhase). Both callbacks must be
+ * either set or NULL (default, disables tracing). The callbacks should
+ * be set before any processing starts.
+ */
+void
+xmlSecTraceSetCallbacks(xmlSecTraceBeginCallback beginCallback, xmlSecTraceEndCallback endCallback) {
+    if((beginCallback == NULL) || (endCallback == NULL)) {
+        xmlSecTraceBeginClbk = NULL;
+        xmlSecTraceEndClbk = NULL;
+        return;
+    }
+    xmlSecTraceBeginClbk = beginCallback;
+    xmlSecTraceEndClbk = endCallback;
+}
+
+/**
+ * xmlSecTraceBegin:
+ * @phase:              the processing phase.
+ * @node:               the node processed in this phase (might be NULL).
+ * @userData:           the user data from the processing context.
+ *
+ * Reports the processing phase start to the tracing callback installed
+ * with #xmlSecTraceSetCallbacks function and starts the phase timer if
+ * the metrics are enabled (see #xmlSecMetricsSetEnabled).
+ *
+ * Returns: the span pointer that must be passed to #xmlSecTraceEnd.
+ */
+void*
+xmlSecTraceBegin(xmlSecTracePhase phase, xmlNodePtr node, void* userData) {
+    xmlSecMetricsPhaseBegin(phase);
+    if(xmlSecTraceBeginClbk == NULL) {
+        return(NULL);
+    }
+    return(xmlSecTraceBeginClbk(phase, node, userData));
+}
+
+/**
+ * xmlSecTraceEnd:
+ * @span:               the span pointer returned by #xmlSecTraceBegin.
+ * @phase:              the processing phase.
+ * @result:             the phase result: 0 on success or a negative value
+ *                      if an error occurs.
+ *
+ * Reports the processing phase end to the tracing callback installed
+ * with #xmlSecTraceSetCallbacks function and records the phase time if
+ * the metrics are enabled.
+ */
+void
+xmlSecTraceEnd(void* span, xmlSecTracePhase phase, int result) {
+    xmlSecMetricsPhaseEnd(phase, result);
+    if(xmlSecTraceEndClbk == NULL) {
+        return;
+    }
+    xmlSecTraceEndClbk(span, phase, result);
+}
+
 /**
  * xmlSecCheckVersionExt:
  * @major:              the major version number.
@@ -15,7 +15,9 @@
 #include <ctype.h>
 
 #include <libxml/tree.h>
+#include <libxml/dict.h>
 #include <libxml/valid.h>
+#include <libxml/xmlIO.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 
@@ -26,8 +28,38 @@
 #include <xmlsec/base64.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/buffer.h>
+#include <xmlsec/private/doccache.h>
+
 static const xmlChar*	g_xmlsec_xmltree_default_linefeed = xmlSecStringCR;
 
+/*
+ * The node name matcher used while walking the tree: the name is looked
+ * up in the document dictionary once so the parsed nodes match by pointer
+ * and the last seen namespace is remembered since siblings share it.
+ */
+typedef struct _xmlSecNodeNameMatcher {
+    const xmlChar*      name;
+    const xmlChar*      dictName;
+    const xmlChar*      ns;
+    xmlNsPtr            nsMatch;
+    xmlNsPtr            nsMismatch;
+} xmlSecNodeNameMatcher, *xmlSecNodeNameMatcherPtr;
+
+static void             xmlSecNodeNameMatcherInitialize (xmlSecNodeNameMatcherPtr matcher,
+                                                         xmlDocPtr doc,
+                                                         const xmlChar* name,
+                                                         const xmlChar* ns);
+static int              xmlSecNodeNameMatcherCheck      (xmlSecNodeNameMatcherPtr matcher,
+                                                         const xmlNodePtr cur);
+static xmlNodePtr       xmlSecNodeNameMatcherFindNode   (xmlSecNodeNameMatcherPtr matcher,
+                                                         const xmlNodePtr parent);
+
+static int              xmlSecQNameInfoMatch            (const xmlChar* infoHref,
+                                                         const xmlChar* infoLocalPart,
+                                                         const xmlChar* qnameHref,
+                                                         const xmlChar* qnameLocalPart);
+
 /**
  * xmlSecGetDefaultLineFeed:
  *
@@ -68,12 +100,19 @@ xmlSecSetDefaultLineFeed(const xmlChar *linefeed)
  */
 xmlNodePtr
 xmlSecFindSibling(const xmlNodePtr cur, const xmlChar *name, const xmlChar *ns) {
+    xmlSecNodeNameMatcher matcher;
     xmlNodePtr tmp;
+
     xmlSecAssert2(name != NULL, NULL);
 
+    if(cur == NULL) {
+        return(NULL);
+    }
+    xmlSecNodeNameMatcherInitialize(&matcher, cur->doc, name, ns);
+
     for(tmp = cur; tmp != NULL; tmp = tmp->next) {
         if(tmp->type == XML_ELEMENT_NODE) {
-            if(xmlSecCheckNodeName(tmp, name, ns)) {
+            if(xmlSecNodeNameMatcherCheck(&matcher, tmp)) {
                 return(tmp);
             }
         }
@@ -140,18 +179,182 @@ xmlSecFindParent(const xmlNodePtr cur, const xmlChar *name, const xmlChar *ns) {
  */
 xmlNodePtr
 xmlSecFindNode(const xmlNodePtr parent, const xmlChar *name, const xmlChar *ns) {
+    xmlSecNodeNameMatcher matcher;
+
+    xmlSecAssert2(name != NULL, NULL);
+
+    if(parent == NULL) {
+        return(NULL);
+    }
+    xmlSecNodeNameMatcherInitialize(&matcher, parent->doc, name, ns);
+
+    return(xmlSecNodeNameMatcherFindNode(&matcher, parent));
+}
+
+/* the nodes collected by xmlSecFindNodes() */
+typedef struct _xmlSecFindNodesCtx {
+    xmlSecNodeNameMatcher       matcher;
+    xmlNodePtr                  parent;
+    xmlNodePtr*                 nodes;
+    xmlSecSize                  nodesSize;
+    xmlSecSize                  nodesMaxSize;
+    int                         failed;
+} xmlSecFindNodesCtx, *xmlSecFindNodesCtxPtr;
+
+static int
+xmlSecFindNodesAdd(xmlSecFindNodesCtxPtr ctx, xmlNodePtr node) {
+    xmlNodePtr* newNodes;
+    xmlSecSize newSize;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    if(ctx->nodesSize >= ctx->nodesMaxSize) {
+        newSize = (ctx->nodesMaxSize > 0) ? 2 * ctx->nodesMaxSize : 8;
+        newNodes = (xmlNodePtr*)xmlRealloc(ctx->nodes, newSize * sizeof(xmlNodePtr));
+        if(newNodes == NULL) {
+            xmlSecMallocError(newSize * sizeof(xmlNodePtr), NULL);
+            return(-1);
+        }
+        ctx->nodes = newNodes;
+        ctx->nodesMaxSize = newSize;
+    }
+    ctx->nodes[ctx->nodesSize++] = node;
+    return(0);
+}
+
+static void
+xmlSecFindNodesIdScanner(void* payload, void* data, const xmlChar* name ATTRIBUTE_UNUSED) {
+    xmlSecFindNodesCtxPtr ctx = (xmlSecFindNodesCtxPtr)data;
+    xmlIDPtr id = (xmlIDPtr)payload;
+    xmlNodePtr node, cur;
+
+    if((ctx == NULL) || (ctx->failed != 0) || (id == NULL) || (id->attr == NULL)) {
+        return;
+    }
+    node = id->attr->parent;
+    if((node == NULL) || (node->type != XML_ELEMENT_NODE) ||
+       (xmlSecNodeNameMatcherCheck(&(ctx->matcher), node) == 0)) {
+        return;
+    }
+    for(cur = node; (cur != NULL) && (cur != ctx->parent); cur = cur->parent);
+    if(cur == NULL) {
+        return;
+    }
+    if(xmlSecFindNodesAdd(ctx, node) < 0) {
+        ctx->failed = 1;
+    }
+}
+
+static int
+xmlSecFindNodesCmp(const void* a, const void* b) {
+    /* xmlXPathCmpNodes() returns 1 if the first node goes first */
+    return(-xmlXPathCmpNodes(*((xmlNodePtr*)a), *((xmlNodePtr*)b)));
+}
+
+/**
+ * xmlSecFindNodes:
+ * @parent:             the pointer to XML node.
+ * @name:               the name.
+ * @ns:                 the namespace href (may be NULL).
+ * @flags:              the bit mask of XMLSEC_FIND_NODES_* flags.
+ * @nodes:              the pointer to the returned nodes array.
+ * @nodesSize:          the pointer to the returned nodes number.
+ *
+ * Collects the @parent node and all its descendants having given name
+ * and namespace href in the document order in one pass (unlike calling
+ * #xmlSecFindNode for every match, e.g. for all the signatures in the
+ * document). With #XMLSEC_FIND_NODES_ID_INDEX flag the tree is not
+ * scanned at all: only the nodes registered in the document ID index
+ * (see #xmlSecAddIDs) are returned. The caller is responsible for
+ * freeing the returned array with xmlFree() (it is NULL if no nodes
+ * are found).
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecFindNodes(const xmlNodePtr parent, const xmlChar *name, const xmlChar *ns,
+                int flags, xmlNodePtr** nodes, xmlSecSize* nodesSize) {
+    xmlSecFindNodesCtx ctx;
+    xmlNodePtr cur;
+    xmlSecSize ii, jj;
+
+    xmlSecAssert2(parent != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(nodesSize != NULL, -1);
+
+    (*nodes) = NULL;
+    (*nodesSize) = 0;
+
+    memset(&ctx, 0, sizeof(ctx));
+    xmlSecNodeNameMatcherInitialize(&(ctx.matcher), parent->doc, name, ns);
+    ctx.parent = parent;
+
+    if((flags & XMLSEC_FIND_NODES_ID_INDEX) != 0) {
+        if((parent->doc != NULL) && (parent->doc->ids != NULL)) {
+            xmlHashScan((xmlHashTablePtr)parent->doc->ids, xmlSecFindNodesIdScanner, &ctx);
+        }
+        if(ctx.failed != 0) {
+            xmlSecInternalError("xmlSecFindNodesAdd", NULL);
+            goto error;
+        }
+        if(ctx.nodesSize > 1) {
+            /* the hash order is random, an element might have several ids */
+            qsort(ctx.nodes, ctx.nodesSize, sizeof(xmlNodePtr), xmlSecFindNodesCmp);
+            for(ii = 1, jj = 1; ii < ctx.nodesSize; ++ii) {
+                if(ctx.nodes[ii] != ctx.nodes[jj - 1]) {
+                    ctx.nodes[jj++] = ctx.nodes[ii];
+                }
+            }
+            ctx.nodesSize = jj;
+        }
+    } else {
+        /* iterative pre-order walk of the @parent subtree */
+        cur = parent;
+        while(cur != NULL) {
+            if((cur->type == XML_ELEMENT_NODE) && xmlSecNodeNameMatcherCheck(&(ctx.matcher), cur)) {
+                if(xmlSecFindNodesAdd(&ctx, cur) < 0) {
+                    xmlSecInternalError("xmlSecFindNodesAdd", NULL);
+                    goto error;
+                }
+            }
+            if((cur->type != XML_ENTITY_REF_NODE) && (cur->children != NULL)) {
+                cur = cur->children;
+                continue;
+            }
+            while((cur != parent) && (cur->next == NULL)) {
+                cur = cur->parent;
+            }
+            cur = (cur != parent) ? cur->next : NULL;
+        }
+    }
+
+    (*nodes) = ctx.nodes;
+    (*nodesSize) = ctx.nodesSize;
+    return(0);
+
+error:
+    if(ctx.nodes != NULL) {
+        xmlFree(ctx.nodes);
+    }
+    return(-1);
+}
+
+static xmlNodePtr
+xmlSecNodeNameMatcherFindNode(xmlSecNodeNameMatcherPtr matcher, const xmlNodePtr parent) {
     xmlNodePtr cur;
     xmlNodePtr ret;
 
-    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2(matcher != NULL, NULL);
 
     cur = parent;
     while(cur != NULL) {
-        if((cur->type == XML_ELEMENT_NODE) && xmlSecCheckNodeName(cur, name, ns)) {
+        if((cur->type == XML_ELEMENT_NODE) && xmlSecNodeNameMatcherCheck(matcher, cur)) {
             return(cur);
         }
         if(cur->children != NULL) {
-            ret = xmlSecFindNode(cur->children, name, ns);
+            ret = xmlSecNodeNameMatcherFindNode(matcher, cur->children);
             if(ret != NULL) {
                 return(ret);
             }
@@ -203,8 +406,57 @@ int
 xmlSecCheckNodeName(const xmlNodePtr cur, const xmlChar *name, const xmlChar *ns) {
     xmlSecAssert2(cur != NULL, 0);
 
-    return(xmlStrEqual(cur->name, name) &&
-           xmlStrEqual(xmlSecGetNodeNsHref(cur), ns));
+    /* the names from the same dictionary or the same constant are equal */
+    if((cur->name != name) && !xmlStrEqual(cur->name, name)) {
+        return(0);
+    }
+    if((cur->ns != NULL) && (cur->ns->href == ns)) {
+        return(1);
+    }
+    return(xmlStrEqual(xmlSecGetNodeNsHref(cur), ns));
+}
+
+static void
+xmlSecNodeNameMatcherInitialize(xmlSecNodeNameMatcherPtr matcher, xmlDocPtr doc,
+                                const xmlChar* name, const xmlChar* ns) {
+    xmlSecAssert(matcher != NULL);
+    xmlSecAssert(name != NULL);
+
+    memset(matcher, 0, sizeof(xmlSecNodeNameMatcher));
+    matcher->name = name;
+    matcher->ns   = ns;
+    if((doc != NULL) && (doc->dict != NULL)) {
+        matcher->dictName = xmlDictExists(doc->dict, name, -1);
+    }
+}
+
+static int
+xmlSecNodeNameMatcherCheck(xmlSecNodeNameMatcherPtr matcher, const xmlNodePtr cur) {
+    xmlSecAssert2(matcher != NULL, 0);
+    xmlSecAssert2(cur != NULL, 0);
+
+    if((cur->name != matcher->dictName) || (matcher->dictName == NULL)) {
+        if((cur->name != matcher->name) && !xmlStrEqual(cur->name, matcher->name)) {
+            return(0);
+        }
+    }
+
+    /* the default namespace lookup is rare, don't cache it */
+    if(cur->ns == NULL) {
+        return(xmlStrEqual(xmlSecGetNodeNsHref(cur), matcher->ns));
+    }
+    if(cur->ns == matcher->nsMatch) {
+        return(1);
+    }
+    if(cur->ns == matcher->nsMismatch) {
+        return(0);
+    }
+    if(xmlStrEqual(cur->ns->href, matcher->ns)) {
+        matcher->nsMatch = cur->ns;
+        return(1);
+    }
+    matcher->nsMismatch = cur->ns;
+    return(0);
 }
 
 /**
@@ -265,6 +517,7 @@ xmlSecAddChild(xmlNodePtr parent, const xmlChar *name, const xmlChar *ns) {
     }
     xmlAddChild(parent, text);
 
+    xmlSecDocCacheTouch(cur);
     return(cur);
 }
 
@@ -304,6 +557,7 @@ xmlSecAddChildNode(xmlNodePtr parent, xmlNodePtr child) {
     }
     xmlAddChild(parent, text);
 
+    xmlSecDocCacheTouch(child);
     return(child);
 }
 
@@ -398,6 +652,7 @@ xmlSecAddNextSibling(xmlNodePtr node, const xmlChar *name, const xmlChar *ns) {
     }
     xmlAddNextSibling(node, text);
 
+    xmlSecDocCacheTouch(cur);
     return(cur);
 }
 
@@ -446,6 +701,7 @@ xmlSecAddPrevSibling(xmlNodePtr node, const xmlChar *name, const xmlChar *ns) {
     }
     xmlAddPrevSibling(node, text);
 
+    xmlSecDocCacheTouch(cur);
     return(cur);
 }
 
@@ -498,6 +754,9 @@ xmlSecReplaceNodeAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr* repl
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(newNode != NULL, -1);
 
+    xmlSecDocCacheTouch(node);
+    xmlSecDocCacheTouch(newNode);
+
     /* fix documents children if necessary first */
     if((node->doc != NULL) && (node->doc->children == node)) {
         node->doc->children = node->next;
@@ -556,6 +815,9 @@ xmlSecReplaceContentAndReturn(xmlNodePtr node, xmlNodePtr newNode, xmlNodePtr *r
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(newNode != NULL, -1);
 
+    xmlSecDocCacheTouch(node);
+    xmlSecDocCacheTouch(newNode);
+
     xmlUnlinkNode(newNode);
     xmlSetTreeDoc(newNode, node->doc);
 
@@ -616,28 +878,58 @@ xmlSecReplaceNodeBuffer(xmlNodePtr node, const xmlSecByte *buffer, xmlSecSize si
 int
 xmlSecReplaceNodeBufferAndReturn(xmlNodePtr node, const xmlSecByte *buffer, xmlSecSize size, xmlNodePtr *replaced) {
     xmlNodePtr results = NULL;
-    xmlNodePtr next = NULL;
+    xmlNodePtr parent;
+    xmlNodePtr last;
+    int options;
     int ret;
 
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(node->parent != NULL, -1);
 
+    xmlSecDocCacheTouch(node);
+
+    /* the names go to the target doc dictionary unless there is none
+     * (then the parser dictionary is freed together with the parser) */
+    options = 0;
+    if((node->doc == NULL) || (node->doc->dict == NULL)) {
+        options |= XML_PARSE_NODICT;
+    }
+
     /* parse buffer in the context of node's parent */
-    ret = xmlParseInNodeContext(node->parent, (const char*)buffer, size, XML_PARSE_NODICT, &results);
+    parent = node->parent;
+    ret = xmlParseInNodeContext(parent, (const char*)buffer, size, options, &results);
     if(ret != XML_ERR_OK) {
         xmlSecXmlError("xmlParseInNodeContext", NULL);
         return(-1);
     }
 
-    /* add new nodes */
-    while (results != NULL) {
-        next = results->next;
-        xmlAddPrevSibling(node, results);
-        results = next;
-    }
+    /* splice the new nodes in place of the old node */
+    if(results != NULL) {
+        for(last = results; ; last = last->next) {
+            last->parent = parent;
+            if(last->next == NULL) {
+                break;
+            }
+        }
 
-    /* remove old node */
-    xmlUnlinkNode(node);
+        results->prev = node->prev;
+        if(node->prev != NULL) {
+            node->prev->next = results;
+        } else {
+            parent->children = results;
+        }
+        last->next = node->next;
+        if(node->next != NULL) {
+            node->next->prev = last;
+        } else {
+            parent->last = last;
+        }
+        node->parent = NULL;
+        node->prev = NULL;
+        node->next = NULL;
+    } else {
+        xmlUnlinkNode(node);
+    }
 
     /* return the old node if requested */
     if(replaced != NULL) {
@@ -676,58 +968,100 @@ xmlSecNodeEncodeAndSetContent(xmlNodePtr node, const xmlChar * buffer) {
     } else {
         xmlNodeSetContent(node, NULL);
     }
+    xmlSecDocCacheTouch(node);
     return(0);
 }
 
+static void
+xmlSecAddNodeIDs(xmlDocPtr doc, xmlNodePtr cur, const xmlChar** ids) {
+    xmlAttrPtr attr;
+    xmlAttrPtr tmp;
+    xmlChar* name;
+    int i;
+
+    xmlSecAssert(doc != NULL);
+    xmlSecAssert(cur != NULL);
+    xmlSecAssert(ids != NULL);
+
+    for(attr = cur->properties; attr != NULL; attr = attr->next) {
+        if(attr->name == NULL) {
+            continue;
+        }
+        for(i = 0; ids[i] != NULL; ++i) {
+            /* most attributes are not ids, check the first char before comparing */
+            if((attr->name[0] != ids[i][0]) || !xmlStrEqual(attr->name, ids[i])) {
+                continue;
+            }
+            name = xmlNodeListGetString(doc, attr->children, 1);
+            if(name != NULL) {
+                tmp = xmlGetID(doc, name);
+                if(tmp == NULL) {
+                    xmlAddID(NULL, doc, name, attr);
+                } else if(tmp != attr) {
+                    xmlSecInvalidStringDataError("id", name, "unique id (id already defined)", NULL);
+                }
+                xmlFree(name);
+            }
+        }
+    }
+}
+
 /**
  * xmlSecAddIDs:
  * @doc:                the pointer to an XML document.
  * @cur:                the pointer to an XML node.
  * @ids:                the pointer to a NULL terminated list of ID attributes.
  *
- * Walks thru all children of the @cur node and adds all attributes
- * from the @ids list to the @doc document IDs attributes hash.
+ * Walks thru @cur node and all its descendants (or the whole @doc document
+ * if @cur is NULL) and adds all attributes from the @ids list to the @doc
+ * document IDs attributes hash. All the names in @ids are checked in
+ * one pass, the walk is not recursive and deep documents are fine. The
+ * IDs are stored in the document itself: one call for the whole document
+ * with all the needed names can be shared by all the signatures in it
+ * (see #XMLSEC_DSIG_FLAGS_IDS_ADDED).
  */
 void
 xmlSecAddIDs(xmlDocPtr doc, xmlNodePtr cur, const xmlChar** ids) {
-    xmlNodePtr children = NULL;
+    xmlNodePtr node;
 
     xmlSecAssert(doc != NULL);
     xmlSecAssert(ids != NULL);
 
-    if((cur != NULL) && (cur->type == XML_ELEMENT_NODE)) {
-        xmlAttrPtr attr;
-        xmlAttrPtr tmp;
-        int i;
-        xmlChar* name;
-
-        for(attr = cur->properties; attr != NULL; attr = attr->next) {
-            for(i = 0; ids[i] != NULL; ++i) {
-                if(xmlStrEqual(attr->name, ids[i])) {
-                    name = xmlNodeListGetString(doc, attr->children, 1);
-                    if(name != NULL) {
-                        tmp = xmlGetID(doc, name);
-                        if(tmp == NULL) {
-                            xmlAddID(NULL, doc, name, attr);
-                        } else if(tmp != attr) {
-                            xmlSecInvalidStringDataError("id", name, "unique id (id already defined)", NULL);
-                        }
-                        xmlFree(name);
-                    }
-                }
+    if(ids[0] == NULL) {
+        return;
+    }
+    if(cur == NULL) {
+        node = doc->children;
+    } else if(cur->type == XML_ELEMENT_NODE) {
+        node = cur;
+    } else {
+        return;
+    }
+
+    while(node != NULL) {
+        if(node->type == XML_ELEMENT_NODE) {
+            xmlSecAddNodeIDs(doc, node, ids);
+            if(node->children != NULL) {
+                node = node->children;
+                continue;
             }
         }
 
-        children = cur->children;
-    } else if(cur == NULL) {
-        children = doc->children;
-    }
-
-    while(children != NULL) {
-        if(children->type == XML_ELEMENT_NODE) {
-            xmlSecAddIDs(doc, children, ids);
+        /* go to the next sibling of the node or of its closest ancestor */
+        while(node != NULL) {
+            if(node == cur) {
+                node = NULL;
+            } else if(node->next != NULL) {
+                node = node->next;
+                break;
+            } else {
+                node = node->parent;
+                if((node != NULL) && (node->type != XML_ELEMENT_NODE)) {
+                    /* the document node */
+                    node = NULL;
+                }
+            }
         }
-        children = children->next;
     }
 }
 
@@ -862,6 +1196,331 @@ xmlSecPrintXmlString(FILE * fd, const xmlChar * str) {
     return(res);
 }
 
+/* the largest chunk passed to xmlOutputBufferWrite at once */
+#define XMLSEC_WRITE_FILE_CHUNK_SIZE            (1024 * 1024 * 1024)
+
+static xmlSecSize
+xmlSecFindBytes(const xmlSecByte* data, xmlSecSize size, xmlSecSize pos,
+                const char* pattern) {
+    xmlSecSize len = strlen(pattern);
+    const xmlSecByte* p;
+
+    while((pos < size) && (size - pos >= len)) {
+        p = (const xmlSecByte*)memchr(data + pos, pattern[0], size - pos - len + 1);
+        if(p == NULL) {
+            break;
+        }
+        pos = p - data;
+        if(memcmp(p, pattern, len) == 0) {
+            return(pos);
+        }
+        ++pos;
+    }
+    return(size);
+}
+
+static int
+xmlSecIsBytes(const xmlSecByte* data, xmlSecSize size, xmlSecSize pos,
+              const char* pattern) {
+    xmlSecSize len = strlen(pattern);
+
+    return(((size - pos) >= len) && (memcmp(data + pos, pattern, len) == 0));
+}
+
+/* checks that the start tag at @pos has the @node's qualified name */
+static int
+xmlSecCheckStartTagName(const xmlSecByte* data, xmlSecSize size, xmlSecSize pos,
+                        xmlNodePtr node) {
+    xmlSecSize len;
+
+    ++pos;
+    if((node->ns != NULL) && (node->ns->prefix != NULL)) {
+        len = xmlStrlen(node->ns->prefix);
+        if((size - pos <= len) || (memcmp(data + pos, node->ns->prefix, len) != 0) ||
+           (data[pos + len] != ':')) {
+            return(0);
+        }
+        pos += len + 1;
+    }
+    len = xmlStrlen(node->name);
+    if((size - pos <= len) || (memcmp(data + pos, node->name, len) != 0)) {
+        return(0);
+    }
+    pos += len;
+    return((data[pos] == '>') || (data[pos] == '/') || isspace((int)data[pos]));
+}
+
+/*
+ * Finds the bytes range [@start, @end) of the @index-th element (in the
+ * document order) in the document text and counts all the elements
+ * except the ones inside this element.
+ * Returns 0 on success or 1 if the text doesn't have the expected structure.
+ */
+static int
+xmlSecFindElementBytes(const xmlSecByte* data, xmlSecSize size, xmlNodePtr node,
+                       xmlSecSize index, xmlSecSize* start, xmlSecSize* end,
+                       xmlSecSize* count) {
+    xmlSecSize pos = 0;
+    xmlSecSize elements = 0;
+    xmlSecSize depth = 0;
+    xmlSecSize nodeDepth = 0;
+    xmlSecSize inner = 0;
+    int found = 0;
+    int closed = 0;
+    const xmlSecByte* p;
+    xmlSecByte quote;
+    int brackets;
+
+    /* only the ASCII compatible encodings have plain '<' and '>' */
+    if((size >= 2) && (((data[0] == 0xFE) && (data[1] == 0xFF)) ||
+                       ((data[0] == 0xFF) && (data[1] == 0xFE)) ||
+                       (data[0] == 0) || (data[1] == 0))) {
+        return(1);
+    }
+
+    while(pos < size) {
+        p = (const xmlSecByte*)memchr(data + pos, '<', size - pos);
+        if(p == NULL) {
+            break;
+        }
+        pos = p - data;
+
+        if(xmlSecIsBytes(data, size, pos, "<!--")) {
+            pos = xmlSecFindBytes(data, size, pos + 4, "-->");
+            if(pos >= size) {
+                return(1);
+            }
+            pos += 3;
+        } else if(xmlSecIsBytes(data, size, pos, "<![CDATA[")) {
+            pos = xmlSecFindBytes(data, size, pos + 9, "]]>");
+            if(pos >= size) {
+                return(1);
+            }
+            pos += 3;
+        } else if(xmlSecIsBytes(data, size, pos, "<?")) {
+            pos = xmlSecFindBytes(data, size, pos + 2, "?>");
+            if(pos >= size) {
+                return(1);
+            }
+            pos += 2;
+        } else if(xmlSecIsBytes(data, size, pos, "<!")) {
+            /* DOCTYPE with the optional internal subset */
+            for(++pos, quote = 0, brackets = 0; pos < size; ++pos) {
+                if(quote != 0) {
+                    if(data[pos] == quote) {
+                        quote = 0;
+                    }
+                } else if((data[pos] == '"') || (data[pos] == '\'')) {
+                    quote = data[pos];
+                } else if(data[pos] == '[') {
+                    ++brackets;
+                } else if(data[pos] == ']') {
+                    --brackets;
+                } else if((data[pos] == '>') && (brackets <= 0)) {
+                    break;
+                }
+            }
+            if(pos >= size) {
+                return(1);
+            }
+            ++pos;
+        } else if(xmlSecIsBytes(data, size, pos, "</")) {
+            p = (const xmlSecByte*)memchr(data + pos, '>', size - pos);
+            if((p == NULL) || (depth == 0)) {
+                return(1);
+            }
+            pos = p - data + 1;
+            --depth;
+            if((found != 0) && (closed == 0) && (depth == nodeDepth)) {
+                (*end) = pos;
+                closed = 1;
+            }
+        } else {
+            if(elements == index) {
+                if(xmlSecCheckStartTagName(data, size, pos, node) == 0) {
+                    return(1);
+                }
+                (*start) = pos;
+                nodeDepth = depth;
+                found = 1;
+            } else if((found != 0) && (closed == 0)) {
+                ++inner;
+            }
+            for(++pos, quote = 0; pos < size; ++pos) {
+                if(quote != 0) {
+                    if(data[pos] == quote) {
+                        quote = 0;
+                    }
+                } else if((data[pos] == '"') || (data[pos] == '\'')) {
+                    quote = data[pos];
+                } else if(data[pos] == '>') {
+                    break;
+                }
+            }
+            if(pos >= size) {
+                return(1);
+            }
+            ++pos;
+            if(data[pos - 2] != '/') {
+                ++depth;
+            } else if(elements == index) {
+                (*end) = pos;
+                closed = 1;
+            }
+            ++elements;
+        }
+    }
+
+    if((closed == 0) || (depth != 0)) {
+        return(1);
+    }
+    (*count) = elements - inner;
+    return(0);
+}
+
+static int
+xmlSecWriteBytes(xmlOutputBufferPtr output, const xmlSecByte* data, xmlSecSize size) {
+    xmlSecSize chunk;
+    int ret;
+
+    while(size > 0) {
+        chunk = (size < XMLSEC_WRITE_FILE_CHUNK_SIZE) ? size : XMLSEC_WRITE_FILE_CHUNK_SIZE;
+        ret = xmlOutputBufferWrite(output, (int)chunk, (const char*)data);
+        if(ret < 0) {
+            xmlSecXmlError("xmlOutputBufferWrite", NULL);
+            return(-1);
+        }
+        data += chunk;
+        size -= chunk;
+    }
+    return(0);
+}
+
+/**
+ * xmlSecWriteFileWithNode:
+ * @filename:           the file @node's document was parsed from.
+ * @node:               the pointer to an element in the parsed document.
+ * @output:             the output buffer.
+ *
+ * Writes the content of @filename to @output as is except the bytes of
+ * the @node element which are replaced with the current @node serialization.
+ * For example, the signed <dsig:Signature/> element can be spliced into
+ * the original template without re-serializing the rest of the document.
+ * The unchanged bytes are written directly from the memory mapped file.
+ *
+ * Returns: 0 on success, 1 if the @node element can't be reliably located
+ * in the file (e.g. the document has entities with markup or non ASCII
+ * compatible encoding) and nothing was written, or a negative value if
+ * an error occurs.
+ */
+int
+xmlSecWriteFileWithNode(const char* filename, xmlNodePtr node, xmlOutputBufferPtr output) {
+    xmlSecMappedFile mappedFile;
+    xmlSecBuffer buffer;
+    const xmlSecByte* data;
+    xmlSecSize size;
+    xmlSecSize index = 0;
+    xmlSecSize elements = 0;
+    xmlSecSize count = 0;
+    xmlSecSize start = 0;
+    xmlSecSize end = 0;
+    xmlNodePtr cur;
+    int mapped;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->type == XML_ELEMENT_NODE, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    if((node->doc->encoding != NULL) &&
+       (xmlStrcasecmp(node->doc->encoding, BAD_CAST "UTF-8") != 0)) {
+        return(1);
+    }
+
+    /* find the @node index in the document order and count all elements
+     * except the @node children (they might be changed) */
+    for(cur = node->doc->children; cur != NULL; ) {
+        if(cur->type == XML_ELEMENT_NODE) {
+            if(cur == node) {
+                index = elements;
+            }
+            ++elements;
+            if((cur != node) && (cur->children != NULL)) {
+                cur = cur->children;
+                continue;
+            }
+        }
+        while((cur != NULL) && (cur->next == NULL)) {
+            cur = cur->parent;
+            if(cur == (xmlNodePtr)node->doc) {
+                cur = NULL;
+            }
+        }
+        if(cur != NULL) {
+            cur = cur->next;
+        }
+    }
+
+    ret = xmlSecBufferInitialize(&buffer, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize", NULL);
+        return(-1);
+    }
+    mapped = xmlSecMappedFileOpen(&mappedFile, filename);
+    if(mapped < 0) {
+        xmlSecInternalError("xmlSecMappedFileOpen", NULL);
+        goto done;
+    } else if(mapped == 0) {
+        data = mappedFile.data;
+        size = mappedFile.size;
+    } else {
+        ret = xmlSecBufferReadFile(&buffer, filename);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferReadFile", NULL,
+                                 "filename=%s", xmlSecErrorsSafeString(filename));
+            goto done;
+        }
+        data = xmlSecBufferGetData(&buffer);
+        size = xmlSecBufferGetSize(&buffer);
+    }
+
+    ret = xmlSecFindElementBytes(data, size, node, index, &start, &end, &count);
+    if((ret != 0) || (count != elements)) {
+        res = 1;
+        goto done;
+    }
+
+    ret = xmlSecWriteBytes(output, data, start);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecWriteBytes", NULL);
+        goto done;
+    }
+    xmlNodeDumpOutput(output, node->doc, node, 0, 0, NULL);
+    ret = xmlSecWriteBytes(output, data + end, size - end);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecWriteBytes", NULL);
+        goto done;
+    }
+    ret = xmlOutputBufferFlush(output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferFlush", NULL);
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    if(mapped == 0) {
+        xmlSecMappedFileClose(&mappedFile);
+    }
+    xmlSecBufferFinalize(&buffer);
+    return(res);
+}
+
 
 /**
  * xmlSecGetQName:
@@ -926,6 +1585,28 @@ xmlSecGetQName(xmlNodePtr node, const xmlChar* href, const xmlChar* local) {
  * QName <-> Integer mapping
  *
  ************************************************************************/
+
+/*
+ * The QName tables are small, caller provided and NULL terminated so the
+ * lookup is a scan; most entries are rejected by the first character of
+ * the local part (the table strings are xmlsec constants so the href is
+ * usually the same pointer).
+ */
+static int
+xmlSecQNameInfoMatch(const xmlChar* infoHref, const xmlChar* infoLocalPart,
+                     const xmlChar* qnameHref, const xmlChar* qnameLocalPart) {
+    xmlSecAssert2(infoLocalPart != NULL, 0);
+    xmlSecAssert2(qnameLocalPart != NULL, 0);
+
+    if(infoLocalPart[0] != qnameLocalPart[0]) {
+        return(0);
+    }
+    if((infoLocalPart != qnameLocalPart) && !xmlStrEqual(infoLocalPart, qnameLocalPart)) {
+        return(0);
+    }
+    return((infoHref == qnameHref) || xmlStrEqual(infoHref, qnameHref));
+}
+
 /**
  * xmlSecQName2IntegerGetInfo:
  * @info:               the qname<->integer mapping information.
@@ -973,8 +1654,7 @@ xmlSecQName2IntegerGetInteger(xmlSecQName2IntegerInfoConstPtr info,
     xmlSecAssert2(intValue != NULL, -1);
 
     for(ii = 0; info[ii].qnameLocalPart != NULL; ii++) {
-        if(xmlStrEqual(info[ii].qnameLocalPart, qnameLocalPart) &&
-           xmlStrEqual(info[ii].qnameHref, qnameHref)) {
+        if(xmlSecQNameInfoMatch(info[ii].qnameHref, info[ii].qnameLocalPart, qnameHref, qnameLocalPart)) {
             (*intValue) = info[ii].intValue;
             return(0);
         }
@@ -1376,8 +2056,7 @@ xmlSecQName2BitMaskGetBitMask(xmlSecQName2BitMaskInfoConstPtr info,
 
     for(ii = 0; info[ii].qnameLocalPart != NULL; ii++) {
         xmlSecAssert2(info[ii].mask != 0, -1);
-        if(xmlStrEqual(info[ii].qnameLocalPart, qnameLocalPart) &&
-           xmlStrEqual(info[ii].qnameHref, qnameHref)) {
+        if(xmlSecQNameInfoMatch(info[ii].qnameHref, info[ii].qnameLocalPart, qnameHref, qnameLocalPart)) {
 
             (*mask) = info[ii].mask;
             return(0);
@@ -12,18 +12,24 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/xpointer.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/list.h>
 #include <xmlsec/transforms.h>
+#include <xmlsec/metrics.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/transforms.h>
+#include <xmlsec/private/xpath.h>
 
 
 /**************************************************************************
@@ -47,6 +53,226 @@ xmlSecXPathHereFunction(xmlXPathParserContextPtr ctxt, int nargs) {
     valuePush(ctxt, xmlXPathNewNodeSet(ctxt->context->here));
 }
 
+/**************************************************************************
+ *
+ * Compiled XPath expressions cache
+ *
+ * The same few XPath expressions are used in almost all the signatures.
+ * The compiled expressions are shared between all the threads: the
+ * expression is evaluated against the caller's XPath context and the
+ * namespace prefixes and functions are resolved at the evaluation time.
+ * The cache key includes the namespaces bindings anyway. The entries are
+ * reference counted so the cache can be flushed while an expression
+ * is evaluated.
+ *
+ * libxml2 modifies the compiled expression during the evaluation (e.g.
+ * the resolved functions are remembered in the expression steps), thus
+ * a cached expression is evaluated by one thread at a time: the entry is
+ * marked busy until it is released and the other threads compile their
+ * own (not cached) copy of the same expression meanwhile.
+ *
+ *****************************************************************************/
+#define XMLSEC_XPATH_CACHE_MAX_SIZE                     1024
+
+typedef struct _xmlSecXPathCacheEntry           xmlSecXPathCacheEntry,
+                                                *xmlSecXPathCacheEntryPtr;
+struct _xmlSecXPathCacheEntry {
+    xmlXPathCompExprPtr         comp;
+    int                         refs;
+    int                         busy;
+    xmlSecXPathCacheEntryPtr    next;
+};
+
+static xmlMutexPtr              xmlSecXPathCacheMutex   = NULL;
+static xmlHashTablePtr          xmlSecXPathCacheTable   = NULL;
+static xmlSecXPathCacheEntryPtr xmlSecXPathCacheEntries = NULL;
+static xmlSecSize               xmlSecXPathCacheHits    = 0;
+static xmlSecSize               xmlSecXPathCacheMisses  = 0;
+
+static void
+xmlSecXPathCacheEntryRelease(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->refs > 0);
+
+    if((--entry->refs) > 0) {
+        return;
+    }
+    if(entry->comp != NULL) {
+        xmlXPathFreeCompExpr(entry->comp);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    xmlFree(entry);
+}
+
+/* must be called under the lock */
+static void
+xmlSecXPathCacheEntriesRelease(void) {
+    xmlSecXPathCacheEntryPtr entry;
+
+    if(xmlSecXPathCacheTable != NULL) {
+        xmlHashFree(xmlSecXPathCacheTable, NULL);
+        xmlSecXPathCacheTable = NULL;
+    }
+    while((entry = xmlSecXPathCacheEntries) != NULL) {
+        xmlSecXPathCacheEntries = entry->next;
+        entry->next = NULL;
+        xmlSecXPathCacheEntryRelease(entry);
+    }
+}
+
+/**
+ * xmlSecTransformXPathCacheInitialize:
+ *
+ * Initializes the compiled XPath expressions cache. This function is called
+ * from the #xmlSecTransformIdsInit function.
+ */
+void
+xmlSecTransformXPathCacheInitialize(void) {
+    if(xmlSecXPathCacheMutex == NULL) {
+        xmlSecXPathCacheMutex = xmlNewMutex();
+        if(xmlSecXPathCacheMutex == NULL) {
+            /* the expressions will be compiled every time */
+            xmlSecXmlError("xmlNewMutex", NULL);
+        }
+    }
+}
+
+/**
+ * xmlSecTransformXPathCacheShutdown:
+ *
+ * Destroys the compiled XPath expressions cache. This function is called
+ * from the #xmlSecTransformIdsShutdown function.
+ */
+void
+xmlSecTransformXPathCacheShutdown(void) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlSecXPathCacheEntriesRelease();
+        xmlFreeMutex(xmlSecXPathCacheMutex);
+        xmlSecXPathCacheMutex = NULL;
+    }
+    xmlSecXPathCacheHits = xmlSecXPathCacheMisses = 0;
+}
+
+/**
+ * xmlSecTransformXPathGetCacheStats:
+ * @hits:               the pointer to the cache hits number (optional).
+ * @misses:             the pointer to the cache misses number (optional).
+ *
+ * Gets the compiled XPath expressions cache statistics since the library
+ * initialization.
+ */
+void
+xmlSecTransformXPathGetCacheStats(xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecXPathCacheHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecXPathCacheMisses;
+    }
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+}
+
+/**
+ * xmlSecTransformXPathFlushCache:
+ *
+ * Removes all the compiled XPath expressions from the cache.
+ */
+void
+xmlSecTransformXPathFlushCache(void) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        xmlSecXPathCacheEntriesRelease();
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+}
+
+static xmlSecXPathCacheEntryPtr
+xmlSecXPathCacheAcquire(const xmlChar* expr, const xmlChar* nsKey) {
+    xmlSecXPathCacheEntryPtr entry;
+    xmlSecXPathCacheEntryPtr tmp;
+
+    xmlSecAssert2(expr != NULL, NULL);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        if(xmlSecXPathCacheTable != NULL) {
+            entry = (xmlSecXPathCacheEntryPtr)xmlHashLookup2(xmlSecXPathCacheTable, expr, nsKey);
+            if((entry != NULL) && (entry->busy == 0)) {
+                entry->busy = 1;
+                ++entry->refs;
+                ++xmlSecXPathCacheHits;
+                xmlSecMetricsAdd(xmlSecMetricXPathCacheHits, 1);
+                xmlMutexUnlock(xmlSecXPathCacheMutex);
+                return(entry);
+            }
+        }
+        ++xmlSecXPathCacheMisses;
+        xmlSecMetricsAdd(xmlSecMetricXPathCacheMisses, 1);
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+
+    /* compile outside of the lock */
+    entry = (xmlSecXPathCacheEntryPtr)xmlMalloc(sizeof(xmlSecXPathCacheEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecXPathCacheEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    entry->refs = 1;
+
+    entry->comp = xmlXPathCompile(expr);
+    if(entry->comp == NULL) {
+        xmlSecXmlError2("xmlXPathCompile", NULL,
+                        "expr=%s", xmlSecErrorsSafeString(expr));
+        xmlSecXPathCacheEntryRelease(entry);
+        return(NULL);
+    }
+
+    if(xmlSecXPathCacheMutex == NULL) {
+        return(entry);
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if((xmlSecXPathCacheTable != NULL) &&
+       (xmlHashSize(xmlSecXPathCacheTable) >= XMLSEC_XPATH_CACHE_MAX_SIZE)) {
+        xmlSecXPathCacheEntriesRelease();
+    }
+    if(xmlSecXPathCacheTable == NULL) {
+        xmlSecXPathCacheTable = xmlHashCreate(0);
+    }
+    if(xmlSecXPathCacheTable != NULL) {
+        /* another thread might be faster, then our copy is not cached */
+        tmp = (xmlSecXPathCacheEntryPtr)xmlHashLookup2(xmlSecXPathCacheTable, expr, nsKey);
+        if((tmp == NULL) && (xmlHashAddEntry2(xmlSecXPathCacheTable, expr, nsKey, entry) == 0)) {
+            entry->busy = 1;
+            ++entry->refs;
+            entry->next = xmlSecXPathCacheEntries;
+            xmlSecXPathCacheEntries = entry;
+        }
+    }
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+    return(entry);
+}
+
+static void
+xmlSecXPathCacheRelease(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+        entry->busy = 0;
+        xmlSecXPathCacheEntryRelease(entry);
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    } else {
+        xmlSecXPathCacheEntryRelease(entry);
+    }
+}
+
 /**************************************************************************
  *
  * XPath/XPointer data
@@ -57,19 +283,22 @@ typedef struct _xmlSecXPathData                 xmlSecXPathData,
 typedef enum {
     xmlSecXPathDataTypeXPath,
     xmlSecXPathDataTypeXPath2,
-    xmlSecXPathDataTypeXPointer
+    xmlSecXPathDataTypeXPointer,
+    xmlSecXPathDataTypeId
 } xmlSecXPathDataType;
 
 struct _xmlSecXPathData {
     xmlSecXPathDataType                 type;
     xmlXPathContextPtr                  ctx;
     xmlChar*                            expr;
+    xmlChar*                            nsKey;
     xmlSecNodeSetOp                     nodeSetOp;
     xmlSecNodeSetType                   nodeSetType;
 };
 
 static xmlSecXPathDataPtr       xmlSecXPathDataCreate           (xmlSecXPathDataType type);
 static void                     xmlSecXPathDataDestroy          (xmlSecXPathDataPtr data);
+static void                     xmlSecXPathDataReset            (xmlSecXPathDataPtr data);
 static int                      xmlSecXPathDataSetExpr          (xmlSecXPathDataPtr data,
                                                                  const xmlChar* expr);
 static int                      xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data,
@@ -78,11 +307,18 @@ static int                      xmlSecXPathDataNodeRead         (xmlSecXPathData
                                                                  xmlNodePtr node);
 static xmlSecNodeSetPtr         xmlSecXPathDataExecute          (xmlSecXPathDataPtr data,
                                                                  xmlDocPtr doc,
-                                                                 xmlNodePtr hereNode);
+                                                                 xmlNodePtr hereNode,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int                      xmlSecXPathDataCheckOpsLimit    (xmlSecXPathDataPtr data,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static xmlChar*                 xmlSecXPathDataGetSimpleId      (const xmlChar* expr);
+static xmlSecNodeSetPtr         xmlSecXPathDataExecuteId        (xmlSecXPathDataPtr data,
+                                                                 xmlDocPtr doc);
 
 static xmlSecXPathDataPtr
 xmlSecXPathDataCreate(xmlSecXPathDataType type) {
     xmlSecXPathDataPtr data;
+    int ret;
 
     data = (xmlSecXPathDataPtr) xmlMalloc(sizeof(xmlSecXPathData));
     if(data == NULL) {
@@ -104,8 +340,17 @@ xmlSecXPathDataCreate(xmlSecXPathDataType type) {
             xmlSecXPathDataDestroy(data);
             return(NULL);
         }
+
+        /* the context might be reused, the here() function fails without the here node */
+        ret = xmlXPathRegisterFunc(data->ctx, BAD_CAST "here", xmlSecXPathHereFunction);
+        if(ret != 0) {
+            xmlSecXmlError("xmlXPathRegisterFunc(here)", NULL);
+            xmlSecXPathDataDestroy(data);
+            return(NULL);
+        }
         break;
     case xmlSecXPathDataTypeXPointer:
+        /* the XPointer context has its own here() function */
         data->ctx = xmlXPtrNewContext(NULL, NULL, NULL); /* we'll set doc in the context later */
         if(data->ctx == NULL) {
             xmlSecXmlError("xmlXPtrNewContext", NULL);
@@ -113,11 +358,34 @@ xmlSecXPathDataCreate(xmlSecXPathDataType type) {
             return(NULL);
         }
         break;
+    case xmlSecXPathDataTypeId:
+        /* no XPath context: the element is looked up by ID directly */
+        break;
     }
 
     return(data);
 }
 
+/* brings the data back to the state after xmlSecXPathDataRegisterNamespaces() */
+static void
+xmlSecXPathDataReset(xmlSecXPathDataPtr data) {
+    xmlSecAssert(data != NULL);
+    xmlSecAssert(data->ctx != NULL);
+
+    if(data->expr != NULL) {
+        xmlFree(data->expr);
+        data->expr = NULL;
+    }
+    data->ctx->doc = NULL;
+    data->ctx->node = NULL;
+    data->ctx->here = NULL;
+    data->ctx->xptr = (data->type == xmlSecXPathDataTypeXPointer) ? 1 : 0;
+    xmlResetError(&(data->ctx->lastError));
+
+    data->nodeSetOp = xmlSecNodeSetIntersection;
+    data->nodeSetType = xmlSecNodeSetTree;
+}
+
 static void
 xmlSecXPathDataDestroy(xmlSecXPathDataPtr data) {
     xmlSecAssert(data != NULL);
@@ -125,6 +393,9 @@ xmlSecXPathDataDestroy(xmlSecXPathDataPtr data) {
     if(data->expr != NULL) {
         xmlFree(data->expr);
     }
+    if(data->nsKey != NULL) {
+        xmlFree(data->nsKey);
+    }
     if(data->ctx != NULL) {
         xmlXPathFreeContext(data->ctx);
     }
@@ -136,7 +407,7 @@ static int
 xmlSecXPathDataSetExpr(xmlSecXPathDataPtr data, const xmlChar* expr) {
     xmlSecAssert2(data != NULL, -1);
     xmlSecAssert2(data->expr == NULL, -1);
-    xmlSecAssert2(data->ctx != NULL, -1);
+    xmlSecAssert2((data->ctx != NULL) || (data->type == xmlSecXPathDataTypeId), -1);
     xmlSecAssert2(expr != NULL, -1);
 
     data->expr = xmlStrdup(expr);
@@ -148,27 +419,102 @@ xmlSecXPathDataSetExpr(xmlSecXPathDataPtr data, const xmlChar* expr) {
 }
 
 
+/*
+ * The namespace declared on the @scope element is visible from @node unless
+ * the same prefix is declared closer to @node. The "xml" prefix is always
+ * known to XPath.
+ */
+static int
+xmlSecXPathNsIsVisible(xmlNodePtr node, xmlNodePtr scope, xmlNsPtr ns) {
+    xmlNodePtr cur;
+    xmlNsPtr tmp;
+
+    xmlSecAssert2(node != NULL, 0);
+    xmlSecAssert2(scope != NULL, 0);
+    xmlSecAssert2(ns != NULL, 0);
+
+    if((ns->prefix == NULL) || xmlStrEqual(ns->prefix, BAD_CAST "xml")) {
+        return(0);
+    }
+    for(cur = node; cur != NULL; cur = cur->parent) {
+        for(tmp = cur->nsDef; (tmp != NULL) && (tmp != ns); tmp = tmp->next) {
+            if(xmlStrEqual(tmp->prefix, ns->prefix)) {
+                return(0);
+            }
+        }
+        if(cur == scope) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/*
+ * The context keeps the namespaces registered by the previous use of the data
+ * (see xmlSecTransformXPathReset): if the namespaces in scope are the same,
+ * there is nothing to do.
+ */
 static int
 xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data, xmlNodePtr node) {
     xmlNodePtr cur;
     xmlNsPtr ns;
+    xmlChar* nsKey = NULL;
     int ret;
 
     xmlSecAssert2(data != NULL, -1);
     xmlSecAssert2(data->ctx != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
+    /* the bindings are the expressions cache key as well */
+    for(cur = node; cur != NULL; cur = cur->parent) {
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
+        for(ns = cur->nsDef; ns != NULL; ns = ns->next) {
+            if(xmlSecXPathNsIsVisible(node, cur, ns) == 0) {
+                continue;
+            }
+            nsKey = xmlStrcat(nsKey, ns->prefix);
+            nsKey = xmlStrcat(nsKey, BAD_CAST "=");
+            nsKey = xmlStrcat(nsKey, ns->href);
+            nsKey = xmlStrcat(nsKey, BAD_CAST " ");
+            if(nsKey == NULL) {
+                xmlSecStrdupError(ns->href, NULL);
+                return(-1);
+            }
+        }
+    }
+    if(xmlStrEqual(nsKey, data->nsKey)) {
+        if(nsKey != NULL) {
+            xmlFree(nsKey);
+        }
+        return(0);
+    }
+
+    if(data->nsKey != NULL) {
+        xmlFree(data->nsKey);
+    }
+    data->nsKey = nsKey;
+    xmlXPathRegisteredNsCleanup(data->ctx);
+
     /* register namespaces */
     for(cur = node; cur != NULL; cur = cur->parent) {
+        if(cur->type != XML_ELEMENT_NODE) {
+            continue;
+        }
         for(ns = cur->nsDef; ns != NULL; ns = ns->next) {
-            /* check that we have no other namespace with same prefix already */
-            if((ns->prefix != NULL) && (xmlXPathNsLookup(data->ctx, ns->prefix) == NULL)){
-                ret = xmlXPathRegisterNs(data->ctx, ns->prefix, ns->href);
-                if(ret != 0) {
-                    xmlSecXmlError2("xmlXPathRegisterNs", NULL,
-                                    "prefix=%s", xmlSecErrorsSafeString(ns->prefix));
-                    return(-1);
-                }
+            if(xmlSecXPathNsIsVisible(node, cur, ns) == 0) {
+                continue;
+            }
+            ret = xmlXPathRegisterNs(data->ctx, ns->prefix, ns->href);
+            if(ret != 0) {
+                xmlSecXmlError2("xmlXPathRegisterNs", NULL,
+                                "prefix=%s", xmlSecErrorsSafeString(ns->prefix));
+                /* the registered namespaces do not match the key anymore */
+                xmlFree(data->nsKey);
+                data->nsKey = NULL;
+                xmlXPathRegisteredNsCleanup(data->ctx);
+                return(-1);
             }
         }
     }
@@ -178,19 +524,11 @@ xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data, xmlNodePtr node) {
 
 static int
 xmlSecXPathDataNodeRead(xmlSecXPathDataPtr data, xmlNodePtr node) {
-    int ret;
-
     xmlSecAssert2(data != NULL, -1);
     xmlSecAssert2(data->expr == NULL, -1);
     xmlSecAssert2(data->ctx != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
-    ret = xmlSecXPathDataRegisterNamespaces (data, node);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecXPathDataRegisterNamespaces", NULL);
-        return(-1);
-    }
-
     /* read node content and set expr */
     data->expr = xmlNodeGetContent(node);
     if(data->expr == NULL) {
@@ -201,46 +539,127 @@ xmlSecXPathDataNodeRead(xmlSecXPathDataPtr data, xmlNodePtr node) {
     return(0);
 }
 
+/*
+ * Adds the operations used by the last evaluation to the chain counter and
+ * reports the error if libxml2 stopped the evaluation because of the limit.
+ */
+static int
+xmlSecXPathDataCheckOpsLimit(xmlSecXPathDataPtr data, xmlSecTransformCtxPtr transformCtx) {
+#if LIBXML_VERSION >= 20911
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+#endif /* LIBXML_VERSION >= 20911 */
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->ctx != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+#if LIBXML_VERSION >= 20911
+    ctxPriv = xmlSecTransformCtxGetPrivate(transformCtx);
+    xmlSecAssert2(ctxPriv != NULL, -1);
+
+    ctxPriv->xpathOps += (xmlSecSize)data->ctx->opCount;
+    if((ctxPriv->maxXPathOps > 0) && (ctxPriv->xpathOps > ctxPriv->maxXPathOps)) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED, NULL,
+                          "maxXPathOps=%d", (int)ctxPriv->maxXPathOps);
+        return(-1);
+    }
+#endif /* LIBXML_VERSION >= 20911 */
+    return(0);
+}
+
 static xmlSecNodeSetPtr
-xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNode) {
+xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNode,
+                       xmlSecTransformCtxPtr transformCtx) {
+#if LIBXML_VERSION >= 20911
+    xmlSecTransformCtxPrivatePtr ctxPriv;
+#endif /* LIBXML_VERSION >= 20911 */
     xmlXPathObjectPtr xpathObj = NULL;
+    xmlSecXPathCacheEntryPtr entry;
     xmlSecNodeSetPtr nodes;
 
     xmlSecAssert2(data != NULL, NULL);
     xmlSecAssert2(data->expr != NULL, NULL);
-    xmlSecAssert2(data->ctx != NULL, NULL);
     xmlSecAssert2(doc != NULL, NULL);
     xmlSecAssert2(hereNode != NULL, NULL);
+    xmlSecAssert2(transformCtx != NULL, NULL);
+
+    /* the most common case: "#id" reference */
+    if(data->type == xmlSecXPathDataTypeId) {
+        return(xmlSecXPathDataExecuteId(data, doc));
+    }
+    xmlSecAssert2(data->ctx != NULL, NULL);
 
     /* do not forget to set the doc */
     data->ctx->doc = doc;
 
     /* here function works only on the same document */
     if(hereNode->doc == doc) {
-        xmlXPathRegisterFunc(data->ctx, (xmlChar *)"here", xmlSecXPathHereFunction);
         data->ctx->here = hereNode;
         data->ctx->xptr = 1;
+    } else {
+        data->ctx->here = NULL;
+        data->ctx->xptr = (data->type == xmlSecXPathDataTypeXPointer) ? 1 : 0;
+    }
+
+#if LIBXML_VERSION >= 20911
+    /* the XPath operations budget is shared by all the expressions in the chain */
+    ctxPriv = xmlSecTransformCtxGetPrivate(transformCtx);
+    xmlSecAssert2(ctxPriv != NULL, NULL);
+    if(ctxPriv->maxXPathOps > 0) {
+        if(ctxPriv->xpathOps >= ctxPriv->maxXPathOps) {
+            xmlSecOtherError2(XMLSEC_ERRORS_R_LIMIT_EXCEEDED, NULL,
+                              "maxXPathOps=%d", (int)ctxPriv->maxXPathOps);
+            return(NULL);
+        }
+        data->ctx->opLimit = ctxPriv->maxXPathOps - ctxPriv->xpathOps;
+    } else {
+        data->ctx->opLimit = 0;
     }
+    data->ctx->opCount = 0;
+#endif /* LIBXML_VERSION >= 20911 */
 
     /* execute xpath or xpointer expression */
     switch(data->type) {
     case xmlSecXPathDataTypeXPath:
     case xmlSecXPathDataTypeXPath2:
-        xpathObj = xmlXPathEvalExpression(data->expr, data->ctx);
+        entry = xmlSecXPathCacheAcquire(data->expr, data->nsKey);
+        if(entry == NULL) {
+            xmlSecInternalError2("xmlSecXPathCacheAcquire", NULL,
+                                 "expr=%s", xmlSecErrorsSafeString(data->expr));
+            return(NULL);
+        }
+        xpathObj = xmlXPathCompiledEval(entry->comp, data->ctx);
+        xmlSecXPathCacheRelease(entry);
+        if(xmlSecXPathDataCheckOpsLimit(data, transformCtx) < 0) {
+            if(xpathObj != NULL) {
+                xmlXPathFreeObject(xpathObj);
+            }
+            return(NULL);
+        }
         if(xpathObj == NULL) {
-            xmlSecXmlError2("xmlXPathEvalExpression", NULL,
+            xmlSecXmlError2("xmlXPathCompiledEval", NULL,
                             "expr=%s", xmlSecErrorsSafeString(data->expr));
             return(NULL);
         }
         break;
     case xmlSecXPathDataTypeXPointer:
         xpathObj = xmlXPtrEval(data->expr, data->ctx);
+        if(xmlSecXPathDataCheckOpsLimit(data, transformCtx) < 0) {
+            if(xpathObj != NULL) {
+                xmlXPathFreeObject(xpathObj);
+            }
+            return(NULL);
+        }
         if(xpathObj == NULL) {
             xmlSecXmlError2("xmlXPtrEval", NULL,
                             "expr=%s", xmlSecErrorsSafeString(data->expr));
             return(NULL);
         }
         break;
+    case xmlSecXPathDataTypeId:
+        /* handled above */
+        xmlSecAssert2(data->type != xmlSecXPathDataTypeId, NULL);
+        return(NULL);
     }
 
     /* sometime LibXML2 returns an empty nodeset or just NULL, we want
@@ -269,6 +688,89 @@ xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNo
 }
 
 
+/*
+ * Returns the ID from the "xpointer(id('ID'))" expression (this is what
+ * the "#ID" barename reference is converted to) or NULL if the expression
+ * has any other form.
+ */
+static xmlChar*
+xmlSecXPathDataGetSimpleId(const xmlChar* expr) {
+    static const char prefix[] = "xpointer(id(";
+    static const char suffix[] = "))";
+    xmlSecSize prefixSize = sizeof(prefix) - 1;
+    xmlSecSize suffixSize = sizeof(suffix) - 1;
+    xmlSecSize size, i;
+    xmlChar quote;
+
+    xmlSecAssert2(expr != NULL, NULL);
+
+    size = xmlStrlen(expr);
+    if((size < prefixSize + suffixSize + 3) ||
+       (xmlStrncmp(expr, BAD_CAST prefix, prefixSize) != 0) ||
+       (xmlStrcmp(expr + size - suffixSize, BAD_CAST suffix) != 0)) {
+        return(NULL);
+    }
+
+    /* the id must be quoted and have no spaces (a list of ids) or quotes */
+    quote = expr[prefixSize];
+    if(((quote != '\'') && (quote != '\"')) || (expr[size - suffixSize - 1] != quote)) {
+        return(NULL);
+    }
+    for(i = prefixSize + 1; i < size - suffixSize - 1; ++i) {
+        if((expr[i] == '\'') || (expr[i] == '\"') || isspace((int)(expr[i]))) {
+            return(NULL);
+        }
+    }
+    return(xmlStrndup(expr + prefixSize + 1, size - prefixSize - suffixSize - 2));
+}
+
+/*
+ * Same as XPath id() function with a single id: no XPath context or evaluation.
+ * The missing element is an error: xmlXPtrEval() returns NULL for the empty
+ * "xpointer(id('ID'))" result and the reference processing fails as well.
+ */
+static xmlSecNodeSetPtr
+xmlSecXPathDataExecuteId(xmlSecXPathDataPtr data, xmlDocPtr doc) {
+    xmlNodeSetPtr nodeSet;
+    xmlSecNodeSetPtr nodes;
+    xmlAttrPtr attr;
+    xmlNodePtr cur = NULL;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->type == xmlSecXPathDataTypeId, NULL);
+    xmlSecAssert2(data->expr != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    attr = xmlGetID(doc, data->expr);
+    if(attr != NULL) {
+        if(attr->type == XML_ATTRIBUTE_NODE) {
+            cur = attr->parent;
+        } else if(attr->type == XML_ELEMENT_NODE) {
+            cur = (xmlNodePtr)attr;
+        }
+    }
+    if(cur == NULL) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_NODE_NOT_FOUND, NULL,
+                          "id=%s", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+
+    nodeSet = xmlXPathNodeSetCreate(cur);
+    if(nodeSet == NULL) {
+        xmlSecXmlError2("xmlXPathNodeSetCreate", NULL,
+                        "id=%s", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+
+    nodes = xmlSecNodeSetCreate(doc, nodeSet, data->nodeSetType);
+    if(nodes == NULL) {
+        xmlSecInternalError2("xmlSecNodeSetCreate", NULL, "type=%d", data->nodeSetType);
+        xmlXPathFreeNodeSet(nodeSet);
+        return(NULL);
+    }
+    return(nodes);
+}
+
 /**************************************************************************
  *
  * XPath data list
@@ -280,7 +782,8 @@ static xmlSecPtrListId  xmlSecXPathDataListGetKlass             (void);
 static xmlSecNodeSetPtr xmlSecXPathDataListExecute              (xmlSecPtrListPtr dataList,
                                                                  xmlDocPtr doc,
                                                                  xmlNodePtr hereNode,
-                                                                 xmlSecNodeSetPtr nodes);
+                                                                 xmlSecNodeSetPtr nodes,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 
 static xmlSecPtrListKlass xmlSecXPathDataListKlass = {
     BAD_CAST "xpath-data-list",
@@ -297,7 +800,8 @@ xmlSecXPathDataListGetKlass(void) {
 
 static xmlSecNodeSetPtr
 xmlSecXPathDataListExecute(xmlSecPtrListPtr dataList, xmlDocPtr doc,
-                           xmlNodePtr hereNode, xmlSecNodeSetPtr nodes) {
+                           xmlNodePtr hereNode, xmlSecNodeSetPtr nodes,
+                           xmlSecTransformCtxPtr transformCtx) {
     xmlSecXPathDataPtr data;
     xmlSecNodeSetPtr res, tmp, tmp2;
     xmlSecSize pos;
@@ -306,6 +810,7 @@ xmlSecXPathDataListExecute(xmlSecPtrListPtr dataList, xmlDocPtr doc,
     xmlSecAssert2(xmlSecPtrListGetSize(dataList) > 0, NULL);
     xmlSecAssert2(doc != NULL, NULL);
     xmlSecAssert2(hereNode != NULL, NULL);
+    xmlSecAssert2(transformCtx != NULL, NULL);
 
     res = nodes;
     for(pos = 0; pos < xmlSecPtrListGetSize(dataList); ++pos) {
@@ -318,7 +823,7 @@ xmlSecXPathDataListExecute(xmlSecPtrListPtr dataList, xmlDocPtr doc,
             return(NULL);
         }
 
-        tmp = xmlSecXPathDataExecute(data, doc, hereNode);
+        tmp = xmlSecXPathDataExecute(data, doc, hereNode, transformCtx);
         if(tmp == NULL) {
             xmlSecInternalError("xmlSecXPathDataExecute", NULL);
             if((res != NULL) && (res != nodes)) {
@@ -347,15 +852,24 @@ xmlSecXPathDataListExecute(xmlSecPtrListPtr dataList, xmlDocPtr doc,
  *
  * XPath/XPointer transforms
  *
- * xmlSecXPathDataList is located after xmlSecTransform structure
+ * xmlSecXPathDataList is located after xmlSecTransform structure followed
+ * by the list of the spare XPath data: the transforms are reset and kept
+ * per-thread (see xmlSecTransformResetMethod) and the XPath contexts with
+ * the registered namespaces and functions are reused with the transform.
  *
  *****************************************************************************/
+#define XMLSEC_XPATH_TRANSFORM_SPARE_DATA_MAX           8
+
 #define xmlSecXPathTransformSize        \
-    (sizeof(xmlSecTransform) + sizeof(xmlSecPtrList))
+    (sizeof(xmlSecTransform) + 2 * sizeof(xmlSecPtrList))
 #define xmlSecXPathTransformGetDataList(transform) \
     ((xmlSecTransformCheckSize((transform), xmlSecXPathTransformSize)) ? \
         (xmlSecPtrListPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform)) : \
         (xmlSecPtrListPtr)NULL)
+#define xmlSecXPathTransformGetSpareDataList(transform) \
+    ((xmlSecTransformCheckSize((transform), xmlSecXPathTransformSize)) ? \
+        (xmlSecPtrListPtr)(((xmlSecByte*)(transform)) + sizeof(xmlSecTransform) + sizeof(xmlSecPtrList)) : \
+        (xmlSecPtrListPtr)NULL)
 #define xmlSecTransformXPathCheckId(transform) \
     (xmlSecTransformCheckId((transform), xmlSecTransformXPathId) || \
      xmlSecTransformCheckId((transform), xmlSecTransformXPath2Id) || \
@@ -363,19 +877,26 @@ xmlSecXPathDataListExecute(xmlSecPtrListPtr dataList, xmlDocPtr doc,
 
 static int              xmlSecTransformXPathInitialize  (xmlSecTransformPtr transform);
 static void             xmlSecTransformXPathFinalize    (xmlSecTransformPtr transform);
+static int              xmlSecTransformXPathReset       (xmlSecTransformPtr transform);
 static int              xmlSecTransformXPathExecute     (xmlSecTransformPtr transform,
                                                          int last,
                                                          xmlSecTransformCtxPtr transformCtx);
+static xmlSecXPathDataPtr xmlSecTransformXPathCreateData(xmlSecTransformPtr transform,
+                                                         xmlSecXPathDataType type,
+                                                         xmlNodePtr node);
 
 static int
 xmlSecTransformXPathInitialize(xmlSecTransformPtr transform) {
     xmlSecPtrListPtr dataList;
+    xmlSecPtrListPtr spareList;
     int ret;
 
     xmlSecAssert2(xmlSecTransformXPathCheckId(transform), -1);
 
     dataList = xmlSecXPathTransformGetDataList(transform);
     xmlSecAssert2(dataList != NULL, -1);
+    spareList = xmlSecXPathTransformGetSpareDataList(transform);
+    xmlSecAssert2(spareList != NULL, -1);
 
     ret = xmlSecPtrListInitialize(dataList, xmlSecXPathDataListId);
     if(ret < 0) {
@@ -383,19 +904,113 @@ xmlSecTransformXPathInitialize(xmlSecTransformPtr transform) {
                             xmlSecTransformGetName(transform));
         return(-1);
     }
+    ret = xmlSecPtrListInitialize(spareList, xmlSecXPathDataListId);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListInitialize",
+                            xmlSecTransformGetName(transform));
+        xmlSecPtrListFinalize(dataList);
+        return(-1);
+    }
     return(0);
 }
 
 static void
 xmlSecTransformXPathFinalize(xmlSecTransformPtr transform) {
     xmlSecPtrListPtr dataList;
+    xmlSecPtrListPtr spareList;
 
     xmlSecAssert(xmlSecTransformXPathCheckId(transform));
 
     dataList = xmlSecXPathTransformGetDataList(transform);
     xmlSecAssert(xmlSecPtrListCheckId(dataList, xmlSecXPathDataListId));
+    spareList = xmlSecXPathTransformGetSpareDataList(transform);
+    xmlSecAssert(xmlSecPtrListCheckId(spareList, xmlSecXPathDataListId));
 
     xmlSecPtrListFinalize(dataList);
+    xmlSecPtrListFinalize(spareList);
+}
+
+static int
+xmlSecTransformXPathReset(xmlSecTransformPtr transform) {
+    xmlSecPtrListPtr dataList;
+    xmlSecPtrListPtr spareList;
+    xmlSecXPathDataPtr data;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformXPathCheckId(transform), -1);
+
+    dataList = xmlSecXPathTransformGetDataList(transform);
+    xmlSecAssert2(xmlSecPtrListCheckId(dataList, xmlSecXPathDataListId), -1);
+    spareList = xmlSecXPathTransformGetSpareDataList(transform);
+    xmlSecAssert2(xmlSecPtrListCheckId(spareList, xmlSecXPathDataListId), -1);
+
+    while(xmlSecPtrListGetSize(dataList) > 0) {
+        data = (xmlSecXPathDataPtr)xmlSecPtrListRemoveAndReturn(dataList,
+                    xmlSecPtrListGetSize(dataList) - 1);
+        if(data == NULL) {
+            continue;
+        }
+        if((data->ctx == NULL) || (xmlSecPtrListGetSize(spareList) >= XMLSEC_XPATH_TRANSFORM_SPARE_DATA_MAX)) {
+            xmlSecXPathDataDestroy(data);
+            continue;
+        }
+
+        xmlSecXPathDataReset(data);
+        ret = xmlSecPtrListAdd(spareList, data);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd",
+                                xmlSecTransformGetName(transform));
+            xmlSecXPathDataDestroy(data);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/*
+ * Creates the XPath data with the namespaces in @node scope registered. The
+ * spare data is taken in the original order since the transform usually reads
+ * the same expressions with the same namespaces in scope again.
+ */
+static xmlSecXPathDataPtr
+xmlSecTransformXPathCreateData(xmlSecTransformPtr transform, xmlSecXPathDataType type, xmlNodePtr node) {
+    xmlSecPtrListPtr spareList;
+    xmlSecXPathDataPtr data = NULL;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformXPathCheckId(transform), NULL);
+    xmlSecAssert2(type != xmlSecXPathDataTypeId, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    spareList = xmlSecXPathTransformGetSpareDataList(transform);
+    xmlSecAssert2(xmlSecPtrListCheckId(spareList, xmlSecXPathDataListId), NULL);
+
+    size = xmlSecPtrListGetSize(spareList);
+    if(size > 0) {
+        data = (xmlSecXPathDataPtr)xmlSecPtrListRemoveAndReturn(spareList, size - 1);
+    }
+    if((data != NULL) && (data->type != type)) {
+        xmlSecXPathDataDestroy(data);
+        data = NULL;
+    }
+    if(data == NULL) {
+        data = xmlSecXPathDataCreate(type);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecXPathDataCreate",
+                                xmlSecTransformGetName(transform));
+            return(NULL);
+        }
+    }
+
+    ret = xmlSecXPathDataRegisterNamespaces(data, node);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathDataRegisterNamespaces",
+                            xmlSecTransformGetName(transform));
+        xmlSecXPathDataDestroy(data);
+        return(NULL);
+    }
+    return(data);
 }
 
 static int
@@ -403,6 +1018,7 @@ xmlSecTransformXPathExecute(xmlSecTransformPtr transform, int last,
                             xmlSecTransformCtxPtr transformCtx) {
     xmlSecPtrListPtr dataList;
     xmlDocPtr doc;
+    int ret;
 
     xmlSecAssert2(xmlSecTransformXPathCheckId(transform), -1);
     xmlSecAssert2(transform->hereNode != NULL, -1);
@@ -418,12 +1034,23 @@ xmlSecTransformXPathExecute(xmlSecTransformPtr transform, int last,
     xmlSecAssert2(doc != NULL, -1);
 
     transform->outNodes = xmlSecXPathDataListExecute(dataList, doc,
-                                transform->hereNode, transform->inNodes);
+                                transform->hereNode, transform->inNodes, transformCtx);
     if(transform->outNodes == NULL) {
         xmlSecInternalError("xmlSecXPathDataExecute",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
+
+    /* collapse the XPath Filter 2.0 nodes sets chain before c14n */
+    if(xmlSecTransformCheckId(transform, xmlSecTransformXPath2Id) &&
+       (transform->outNodes->next != transform->outNodes)) {
+        ret = xmlSecNodeSetMaterialize(transform->outNodes);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetMaterialize",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
     return(0);
 }
 
@@ -459,7 +1086,7 @@ static xmlSecTransformKlass xmlSecTransformXPathKlass = {
     xmlSecTransformDefaultPopXml,               /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecTransformXPathExecute,                /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformXPathReset,                  /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -504,9 +1131,9 @@ xmlSecTransformXPathNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlS
     }
 
     /* read information from the node */
-    data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPath);
+    data = xmlSecTransformXPathCreateData(transform, xmlSecXPathDataTypeXPath, cur);
     if(data == NULL) {
-        xmlSecInternalError("xmlSecXPathDataCreate",
+        xmlSecInternalError("xmlSecTransformXPathCreateData",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
@@ -590,7 +1217,7 @@ static xmlSecTransformKlass xmlSecTransformXPath2Klass = {
     xmlSecTransformDefaultPopXml,               /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecTransformXPathExecute,                /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformXPathReset,                  /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -626,9 +1253,9 @@ xmlSecTransformXPath2NodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xml
     cur = xmlSecGetNextElementNode(node->children);
     while((cur != NULL) && xmlSecCheckNodeName(cur, xmlSecNodeXPath2, xmlSecXPath2Ns)) {
         /* read information from the node */
-        data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPath2);
+        data = xmlSecTransformXPathCreateData(transform, xmlSecXPathDataTypeXPath2, cur);
         if(data == NULL) {
-            xmlSecInternalError("xmlSecXPathDataCreate",
+            xmlSecInternalError("xmlSecTransformXPathCreateData",
                                 xmlSecTransformGetName(transform));
             return(-1);
         }
@@ -716,7 +1343,7 @@ static xmlSecTransformKlass xmlSecTransformXPointerKlass = {
     xmlSecTransformDefaultPopXml,               /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecTransformXPathExecute,                /* xmlSecTransformExecuteMethod execute; */
 
-    NULL,                                       /* void* reserved0; */
+    xmlSecTransformXPathReset,                  /* xmlSecTransformResetMethod reset; */
     NULL,                                       /* void* reserved1; */
 };
 
@@ -749,6 +1376,7 @@ xmlSecTransformXPointerSetExpr(xmlSecTransformPtr transform, const xmlChar* expr
                             xmlSecNodeSetType  nodeSetType, xmlNodePtr hereNode) {
     xmlSecPtrListPtr dataList;
     xmlSecXPathDataPtr data;
+    xmlChar* id;
     int ret;
 
     xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXPointerId), -1);
@@ -762,27 +1390,32 @@ xmlSecTransformXPointerSetExpr(xmlSecTransformPtr transform, const xmlChar* expr
     xmlSecAssert2(xmlSecPtrListCheckId(dataList, xmlSecXPathDataListId), -1);
     xmlSecAssert2(xmlSecPtrListGetSize(dataList) == 0, -1);
 
-    data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPointer);
-    if(data == NULL) {
-        xmlSecInternalError("xmlSecXPathDataCreate",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
-
-    ret = xmlSecXPathDataRegisterNamespaces(data, hereNode);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecXPathDataRegisterNamespaces",
-                            xmlSecTransformGetName(transform));
-        xmlSecXPathDataDestroy(data);
-        return(-1);
-    }
+    id = xmlSecXPathDataGetSimpleId(expr);
+    if(id != NULL) {
+        /* no need to evaluate XPointer expression to find an element by ID */
+        data = xmlSecXPathDataCreate(xmlSecXPathDataTypeId);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecXPathDataCreate",
+                                xmlSecTransformGetName(transform));
+            xmlFree(id);
+            return(-1);
+        }
+        data->expr = id;
+    } else {
+        data = xmlSecTransformXPathCreateData(transform, xmlSecXPathDataTypeXPointer, hereNode);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecTransformXPathCreateData",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
 
-    ret = xmlSecXPathDataSetExpr(data, expr);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecXPathDataSetExpr",
-                            xmlSecTransformGetName(transform));
-        xmlSecXPathDataDestroy(data);
-        return(-1);
+        ret = xmlSecXPathDataSetExpr(data, expr);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXPathDataSetExpr",
+                                xmlSecTransformGetName(transform));
+            xmlSecXPathDataDestroy(data);
+            return(-1);
+        }
     }
 
     /* append it to the list */
@@ -825,9 +1458,9 @@ xmlSecTransformXPointerNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, x
     }
 
     /* read information from the node */
-    data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPointer);
+    data = xmlSecTransformXPathCreateData(transform, xmlSecXPathDataTypeXPointer, cur);
     if(data == NULL) {
-        xmlSecInternalError("xmlSecXPathDataCreate",
+        xmlSecInternalError("xmlSecTransformXPathCreateData",
                             xmlSecTransformGetName(transform));
         return(-1);
     }
@@ -16,6 +16,9 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/xpathInternals.h>
 #include <libxslt/xslt.h>
 #include <libxslt/xsltInternals.h>
 #include <libxslt/transform.h>
@@ -28,6 +31,7 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/transforms.h>
 #include <xmlsec/private/xslt.h>
 
 /**************************************************************************
@@ -35,10 +39,12 @@
  * Internal xslt ctx
  *
  *****************************************************************************/
+typedef struct _xmlSecXsltCacheItem             xmlSecXsltCacheItem, *xmlSecXsltCacheItemPtr;
 typedef struct _xmlSecXsltCtx                   xmlSecXsltCtx, *xmlSecXsltCtxPtr;
 struct _xmlSecXsltCtx {
     xsltStylesheetPtr   xslt;
     xmlParserCtxtPtr    parserCtx;
+    xmlSecXsltCacheItemPtr cacheItem;   /* set if xslt is owned by the cache */
 };
 
 /****************************************************************************
@@ -58,14 +64,36 @@ static void             xmlSecXsltFinalize                      (xmlSecTransform
 static int              xmlSecXsltReadNode                      (xmlSecTransformPtr transform,
                                                                  xmlNodePtr node,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static xmlSecTransformDataType xmlSecXsltGetDataType           (xmlSecTransformPtr transform,
+                                                                 xmlSecTransformMode mode,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecXsltPushBin                       (xmlSecTransformPtr transform,
                                                                  const xmlSecByte* data,
                                                                  xmlSecSize dataSize,
                                                                  int final,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPopBin                        (xmlSecTransformPtr transform,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize maxDataSize,
+                                                                 xmlSecSize* dataSize,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPushXml                       (xmlSecTransformPtr transform,
+                                                                 xmlSecNodeSetPtr nodes,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPopXml                        (xmlSecTransformPtr transform,
+                                                                 xmlSecNodeSetPtr* nodes,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltCanOutputXml                  (xmlSecXsltCtxPtr ctx);
+static int              xmlSecXsltPushDoc                       (xmlSecTransformPtr transform,
+                                                                 xmlDocPtr docIn,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecXsltExecute                       (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static xmlSecXsltCacheItemPtr xmlSecXsltCacheFind               (const xmlChar* content);
+static xmlSecXsltCacheItemPtr xmlSecXsltCacheAdd                (const xmlChar* content,
+                                                                 xsltStylesheetPtr xslt);
+static void             xmlSecXsltCacheRelease                  (xmlSecXsltCacheItemPtr item);
 static int              xmlSecXslProcess                        (xmlSecXsltCtxPtr ctx,
                                                                  xmlSecBufferPtr in,
                                                                  xmlSecBufferPtr out);
@@ -88,11 +116,11 @@ static xmlSecTransformKlass xmlSecXsltKlass = {
     NULL,                                       /* xmlSecTransformSetKeyReqMethod setKeyReq; */
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
-    xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
+    xmlSecXsltGetDataType,                      /* xmlSecTransformGetDataTypeMethod getDataType; */
     xmlSecXsltPushBin,                          /* xmlSecTransformPushBinMethod pushBin; */
-    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
-    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecXsltPopBin,                           /* xmlSecTransformPopBinMethod popBin; */
+    xmlSecXsltPushXml,                          /* xmlSecTransformPushXmlMethod pushXml; */
+    xmlSecXsltPopXml,                           /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecXsltExecute,                          /* xmlSecTransformExecuteMethod execute; */
 
     NULL,                                       /* void* reserved0; */
@@ -105,6 +133,24 @@ static xmlSecTransformKlass xmlSecXsltKlass = {
 
 static xsltSecurityPrefsPtr g_xslt_default_security_prefs = NULL;
 
+/**************************************************************************
+ *
+ * Compiled stylesheets cache: the stylesheets are indexed by the
+ * serialized <xsl:stylesheet/> content and shared between transforms
+ * (libxslt doesn't modify the compiled stylesheet when it is applied).
+ * Each item is referenced by the cache itself and by every transform
+ * that uses it.
+ *
+ *****************************************************************************/
+struct _xmlSecXsltCacheItem {
+    xsltStylesheetPtr   xslt;
+    int                 refs;
+};
+
+static xmlHashTablePtr  g_xslt_cache = NULL;
+static xmlSecSize       g_xslt_cache_max_size = 0;
+static xmlMutexPtr      g_xslt_cache_mutex = NULL;  /* protects all the above and item->refs */
+
 void xmlSecTransformXsltInitialize(void) {
     xmlSecAssert(g_xslt_default_security_prefs == NULL);
 
@@ -115,9 +161,18 @@ void xmlSecTransformXsltInitialize(void) {
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_CREATE_DIRECTORY, xsltSecurityForbid);
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_READ_NETWORK,     xsltSecurityForbid);
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_WRITE_NETWORK,    xsltSecurityForbid);
+
+    xmlSecAssert(g_xslt_cache_mutex == NULL);
+    g_xslt_cache_mutex = xmlNewMutex();
+    xmlSecAssert(g_xslt_cache_mutex != NULL);
 }
 
 void xmlSecTransformXsltShutdown(void) {
+    xmlSecTransformXsltSetCacheSize(0);
+    if(g_xslt_cache_mutex != NULL) {
+        xmlFreeMutex(g_xslt_cache_mutex);
+        g_xslt_cache_mutex = NULL;
+    }
     if(g_xslt_default_security_prefs != NULL) {
         xsltFreeSecurityPrefs(g_xslt_default_security_prefs);
         g_xslt_default_security_prefs = NULL;
@@ -144,6 +199,132 @@ xmlSecTransformXsltSetDefaultSecurityPrefs(xsltSecurityPrefsPtr sec) {
     XMLSEC_XSLT_COPY_SEC_PREF(sec, g_xslt_default_security_prefs, XSLT_SECPREF_WRITE_NETWORK);
 }
 
+/* must be called with g_xslt_cache_mutex locked */
+static void
+xmlSecXsltCacheItemUnref(xmlSecXsltCacheItemPtr item) {
+    xmlSecAssert(item != NULL);
+    xmlSecAssert(item->refs > 0);
+
+    --(item->refs);
+    if(item->refs == 0) {
+        if(item->xslt != NULL) {
+            xsltFreeStylesheet(item->xslt);
+        }
+        xmlFree(item);
+    }
+}
+
+static void
+xmlSecXsltCacheItemDrop(void* payload, const xmlChar* name ATTRIBUTE_UNUSED) {
+    if(payload != NULL) {
+        xmlSecXsltCacheItemUnref((xmlSecXsltCacheItemPtr)payload);
+    }
+}
+
+/**
+ * xmlSecTransformXsltSetCacheSize:
+ * @maxSize:            the max number of cached stylesheets (0 disables
+ *                      the cache).
+ *
+ * Sets the size of the compiled stylesheets cache. When the cache is
+ * enabled, the XSLT transforms with the same stylesheet share one compiled
+ * stylesheet and the stylesheet is parsed and compiled only once. The cache
+ * is disabled by default. Changing the size drops all the cached
+ * stylesheets (the transforms that use them are not affected).
+ *
+ * This function should be called after xmlsec library is initialized
+ * (see #xmlSecInit).
+ */
+void
+xmlSecTransformXsltSetCacheSize(xmlSecSize maxSize) {
+    xmlSecAssert(g_xslt_cache_mutex != NULL);
+
+    xmlMutexLock(g_xslt_cache_mutex);
+    if(g_xslt_cache != NULL) {
+        xmlHashFree(g_xslt_cache, xmlSecXsltCacheItemDrop);
+        g_xslt_cache = NULL;
+    }
+    g_xslt_cache_max_size = maxSize;
+    xmlMutexUnlock(g_xslt_cache_mutex);
+}
+
+static xmlSecXsltCacheItemPtr
+xmlSecXsltCacheFind(const xmlChar* content) {
+    xmlSecXsltCacheItemPtr item = NULL;
+
+    xmlSecAssert2(content != NULL, NULL);
+
+    if(g_xslt_cache_mutex == NULL) {
+        return(NULL);
+    }
+
+    xmlMutexLock(g_xslt_cache_mutex);
+    if(g_xslt_cache != NULL) {
+        item = (xmlSecXsltCacheItemPtr)xmlHashLookup(g_xslt_cache, content);
+        if(item != NULL) {
+            ++(item->refs);
+        }
+    }
+    xmlMutexUnlock(g_xslt_cache_mutex);
+    return(item);
+}
+
+/* takes ownership of @xslt if the returned item is not NULL */
+static xmlSecXsltCacheItemPtr
+xmlSecXsltCacheAdd(const xmlChar* content, xsltStylesheetPtr xslt) {
+    xmlSecXsltCacheItemPtr item;
+    int ret;
+
+    xmlSecAssert2(content != NULL, NULL);
+    xmlSecAssert2(xslt != NULL, NULL);
+
+    if((g_xslt_cache_mutex == NULL) || (g_xslt_cache_max_size == 0)) {
+        return(NULL);
+    }
+
+    item = (xmlSecXsltCacheItemPtr)xmlMalloc(sizeof(xmlSecXsltCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecXsltCacheItem), NULL);
+        return(NULL);
+    }
+    memset(item, 0, sizeof(xmlSecXsltCacheItem));
+    item->refs = 2; /* one for the cache and one for the caller */
+
+    xmlMutexLock(g_xslt_cache_mutex);
+    /* keep it simple: drop everything when the cache is full */
+    if((g_xslt_cache != NULL) && ((xmlSecSize)xmlHashSize(g_xslt_cache) >= g_xslt_cache_max_size)) {
+        xmlHashFree(g_xslt_cache, xmlSecXsltCacheItemDrop);
+        g_xslt_cache = NULL;
+    }
+    if(g_xslt_cache == NULL) {
+        g_xslt_cache = xmlHashCreate(0);
+    }
+    if(g_xslt_cache != NULL) {
+        /* fails if another thread added the same stylesheet first */
+        ret = xmlHashAddEntry(g_xslt_cache, content, item);
+    } else {
+        ret = -1;
+    }
+    xmlMutexUnlock(g_xslt_cache_mutex);
+
+    if(ret != 0) {
+        xmlFree(item);
+        return(NULL);
+    }
+    item->xslt = xslt;
+    return(item);
+}
+
+static void
+xmlSecXsltCacheRelease(xmlSecXsltCacheItemPtr item) {
+    xmlSecAssert(item != NULL);
+    xmlSecAssert(g_xslt_cache_mutex != NULL);
+
+    xmlMutexLock(g_xslt_cache_mutex);
+    xmlSecXsltCacheItemUnref(item);
+    xmlMutexUnlock(g_xslt_cache_mutex);
+}
+
 /**
  * xmlSecTransformXsltGetKlass:
  *
@@ -208,7 +389,9 @@ xmlSecXsltFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecXsltGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->xslt != NULL) {
+    if(ctx->cacheItem != NULL) {
+        xmlSecXsltCacheRelease(ctx->cacheItem);
+    } else if(ctx->xslt != NULL) {
         xsltFreeStylesheet(ctx->xslt);
     }
     if(ctx->parserCtx != NULL) {
@@ -245,6 +428,14 @@ xmlSecXsltReadNode(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransfor
         cur = cur->next;
     }
 
+    /* we might have already compiled this stylesheet */
+    ctx->cacheItem = xmlSecXsltCacheFind(xmlBufferContent(buffer));
+    if(ctx->cacheItem != NULL) {
+        ctx->xslt = ctx->cacheItem->xslt;
+        xmlBufferFree(buffer);
+        return(0);
+    }
+
     /* parse the buffer */
     doc = xmlSecParseMemory(xmlBufferContent(buffer),
                              xmlBufferLength(buffer), 1);
@@ -267,6 +458,9 @@ xmlSecXsltReadNode(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransfor
         return(-1);
     }
 
+    /* share it with the other transforms if the cache is enabled */
+    ctx->cacheItem = xmlSecXsltCacheAdd(xmlBufferContent(buffer), ctx->xslt);
+
     xmlBufferFree(buffer);
     return(0);
 }
@@ -324,8 +518,6 @@ xmlSecXsltPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
     /* finish parsing, apply xslt transforms and push to next in the chain */
     if(final != 0) {
         xmlDocPtr docIn;
-        xmlDocPtr docOut;
-        xmlOutputBufferPtr output;
 
         /* finalize */
         ret = xmlParseChunk(ctx->parserCtx, NULL, 0, 1);
@@ -339,47 +531,13 @@ xmlSecXsltPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
         docIn = ctx->parserCtx->myDoc;
         ctx->parserCtx->myDoc = NULL;
 
-        docOut = xmlSecXsApplyStylesheet(ctx, docIn);
-        if(docOut == NULL) {
-            xmlSecInternalError("xmlSecXsApplyStylesheet",
-                                xmlSecTransformGetName(transform));
-            xmlFreeDoc(docIn);
-            return(-1);
-        }
+        ret = xmlSecXsltPushDoc(transform, docIn, transformCtx);
         xmlFreeDoc(docIn);
-
-        if(transform->next != NULL) {
-            output = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
-            if(output == NULL) {
-                xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
-                                    xmlSecTransformGetName(transform));
-                xmlFreeDoc(docOut);
-                return(-1);
-            }
-        } else {
-            output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
-            if(output == NULL) {
-                xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
-                                    xmlSecTransformGetName(transform));
-                xmlFreeDoc(docOut);
-                return(-1);
-            }
-        }
-
-        ret = xsltSaveResultTo(output, docOut, ctx->xslt);
-        if(ret < 0) {
-            xmlSecXsltError("xsltParseStylesheetDoc", ctx->xslt, xmlSecTransformGetName(transform));
-            xmlOutputBufferClose(output);
-            xmlFreeDoc(docOut);
-            return(-1);
-        }
-        ret = xmlOutputBufferClose(output);
         if(ret < 0) {
-            xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
-            xmlFreeDoc(docOut);
+            xmlSecInternalError("xmlSecXsltPushDoc",
+                                xmlSecTransformGetName(transform));
             return(-1);
         }
-        xmlFreeDoc(docOut);
 
         transform->status = xmlSecTransformStatusFinished;
     }
@@ -444,7 +602,595 @@ xmlSecXsltExecute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr
     return(0);
 }
 
-/* TODO: create PopBin method instead */
+static xmlSecTransformDataType
+xmlSecXsltGetDataType(xmlSecTransformPtr transform, xmlSecTransformMode mode,
+                      xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), xmlSecTransformDataTypeUnknown);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), xmlSecTransformDataTypeUnknown);
+    xmlSecAssert2(transformCtx != NULL, xmlSecTransformDataTypeUnknown);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, xmlSecTransformDataTypeUnknown);
+
+    switch(mode) {
+    case xmlSecTransformModePush:
+        return(xmlSecTransformDataTypeBin | xmlSecTransformDataTypeXml);
+    case xmlSecTransformModePop:
+        if(xmlSecXsltCanOutputXml(ctx) != 0) {
+            return(xmlSecTransformDataTypeBin | xmlSecTransformDataTypeXml);
+        }
+        return(xmlSecTransformDataTypeBin);
+    default:
+        xmlSecInvalidIntegerDataError("mode", mode,
+                "xmlSecTransformModePush,xmlSecTransformModePop",
+                xmlSecTransformGetName(transform));
+        return(xmlSecTransformDataTypeUnknown);
+    }
+}
+
+/*
+ * The result document can be passed to the next transform as-is only if
+ * serializing and parsing it back gives the same document: the output
+ * method is "xml" and there is no DOCTYPE to load.
+ */
+static int
+xmlSecXsltCanOutputXml(xmlSecXsltCtxPtr ctx) {
+    xmlSecAssert2(ctx != NULL, 0);
+
+    if(ctx->xslt == NULL) {
+        return(0);
+    }
+    if((ctx->xslt->method != NULL) && !xmlStrEqual(ctx->xslt->method, BAD_CAST "xml")) {
+        return(0);
+    }
+    if((ctx->xslt->doctypeSystem != NULL) || (ctx->xslt->doctypePublic != NULL)) {
+        return(0);
+    }
+    return(1);
+}
+
+/*
+ * The input nodes set can be used as the stylesheet input document directly
+ * (instead of the c14n and parse round trip) only if it is the whole
+ * document and the c14n would not change it: no comments (the c14n
+ * transform inserted for the binary input removes them), no entity
+ * references and no DTD. The stylesheet should not strip spaces since
+ * it modifies the input document.
+ */
+static int
+xmlSecXsltCanUseNodeSetDoc(xmlSecXsltCtxPtr ctx, xmlSecNodeSetPtr nodes) {
+    xmlNodePtr cur;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ctx->xslt != NULL, 0);
+    xmlSecAssert2(nodes != NULL, 0);
+    xmlSecAssert2(nodes->doc != NULL, 0);
+
+    if((ctx->xslt->stripSpaces != NULL) || (ctx->xslt->stripAll != 0)) {
+        return(0);
+    }
+    if((nodes->next != nodes) ||
+       ((nodes->type != xmlSecNodeSetTree) && (nodes->type != xmlSecNodeSetTreeWithoutComments))) {
+        return(0);
+    }
+    if((nodes->doc->intSubset != NULL) || (nodes->doc->extSubset != NULL)) {
+        return(0);
+    }
+
+    /* the nodes set should cover all the doc children */
+    for(cur = nodes->doc->children; cur != NULL; cur = cur->next) {
+        if(cur->type == XML_COMMENT_NODE) {
+            return(0);
+        }
+        if((nodes->nodes != NULL) && (xmlXPathNodeSetContains(nodes->nodes, cur) == 0)) {
+            return(0);
+        }
+    }
+
+    /* walk the doc and check there is nothing c14n would change */
+    cur = xmlDocGetRootElement(nodes->doc);
+    while(cur != NULL) {
+        if((cur->type == XML_COMMENT_NODE) || (cur->type == XML_ENTITY_REF_NODE) ||
+           (cur->type == XML_XINCLUDE_START) || (cur->type == XML_XINCLUDE_END)) {
+            return(0);
+        }
+
+        if((cur->type == XML_ELEMENT_NODE) && (cur->children != NULL)) {
+            cur = cur->children;
+            continue;
+        }
+        while((cur != NULL) && (cur->next == NULL)) {
+            cur = cur->parent;
+            if((cur != NULL) && (cur->type == XML_DOCUMENT_NODE)) {
+                cur = NULL;
+            }
+        }
+        if(cur != NULL) {
+            cur = cur->next;
+        }
+    }
+    return(1);
+}
+
+/* the caller is responsible for freeing the returned doc if *owned is set */
+static xmlDocPtr
+xmlSecXsltNodeSetGetDoc(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
+                        xmlSecTransformCtxPtr transformCtx, int* owned) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecTransformPtr c14n;
+    xmlDocPtr doc;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), NULL);
+    xmlSecAssert2(nodes != NULL, NULL);
+    xmlSecAssert2(transformCtx != NULL, NULL);
+    xmlSecAssert2(owned != NULL, NULL);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    if(xmlSecXsltCanUseNodeSetDoc(ctx, nodes) != 0) {
+        (*owned) = 0;
+        return(nodes->doc);
+    }
+
+    /* do what the c14n transform inserted in front of us would do */
+    c14n = xmlSecTransformCreate(xmlSecTransformInclC14NId);
+    if(c14n == NULL) {
+        xmlSecInternalError("xmlSecTransformCreate(xmlSecTransformInclC14NId)",
+                            xmlSecTransformGetName(transform));
+        return(NULL);
+    }
+    ret = xmlSecTransformPushXml(c14n, nodes, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushXml",
+                            xmlSecTransformGetName(c14n));
+        xmlSecTransformDestroy(c14n);
+        return(NULL);
+    }
+
+    doc = xmlSecParseMemory(xmlSecBufferGetData(&(c14n->outBuf)),
+                            xmlSecBufferGetSize(&(c14n->outBuf)), 1);
+    xmlSecTransformDestroy(c14n);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecParseMemory",
+                            xmlSecTransformGetName(transform));
+        return(NULL);
+    }
+    (*owned) = 1;
+    return(doc);
+}
+
+static int
+xmlSecXsltSaveResult(xmlSecXsltCtxPtr ctx, xmlDocPtr docOut, xmlOutputBufferPtr output) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+    xmlSecAssert2(docOut != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    ret = xsltSaveResultTo(output, docOut, ctx->xslt);
+    if(ret < 0) {
+        xmlSecXsltError("xsltSaveResultTo", ctx->xslt, NULL);
+        xmlOutputBufferClose(output);
+        return(-1);
+    }
+    ret = xmlOutputBufferClose(output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* takes ownership of @docOut and sets transform->outNodes */
+static int
+xmlSecXsltResultToNodeSet(xmlSecTransformPtr transform, xmlDocPtr docOut) {
+    xmlSecXsltCtxPtr ctx;
+    xmlOutputBufferPtr output;
+    xmlSecBuffer buf;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(transform->outNodes == NULL, -1);
+    xmlSecAssert2(docOut != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* html or text results have to go through the serialization */
+    if((docOut->type != XML_DOCUMENT_NODE) || (xmlSecXsltCanOutputXml(ctx) == 0)) {
+        ret = xmlSecBufferInitialize(&buf, 0);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecBufferInitialize",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+        output = xmlSecBufferCreateOutputBuffer(&buf);
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlSecBufferFinalize(&buf);
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+        ret = xmlSecXsltSaveResult(ctx, docOut, output);
+        xmlFreeDoc(docOut);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXsltSaveResult",
+                                xmlSecTransformGetName(transform));
+            xmlSecBufferFinalize(&buf);
+            return(-1);
+        }
+        docOut = xmlSecParseMemory(xmlSecBufferGetData(&buf), xmlSecBufferGetSize(&buf), 1);
+        xmlSecBufferFinalize(&buf);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecParseMemory",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+
+    transform->outNodes = xmlSecNodeSetCreate(docOut, NULL, xmlSecNodeSetTree);
+    if(transform->outNodes == NULL) {
+        xmlSecInternalError("xmlSecNodeSetCreate",
+                            xmlSecTransformGetName(transform));
+        xmlFreeDoc(docOut);
+        return(-1);
+    }
+    xmlSecNodeSetDocDestroy(transform->outNodes); /* this node set "owns" the doc pointer */
+    return(0);
+}
+
+/* applies the stylesheet and pushes the result to the next transform */
+static int
+xmlSecXsltPushDoc(xmlSecTransformPtr transform, xmlDocPtr docIn, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlDocPtr docOut;
+    xmlOutputBufferPtr output;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(docIn != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+    if(docOut == NULL) {
+        xmlSecInternalError("xmlSecXsApplyStylesheet",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    /* the next transform takes XML: skip the serialization and parsing */
+    if((transform->next != NULL) &&
+       ((xmlSecTransformGetDataType(transform->next, xmlSecTransformModePush, transformCtx) & xmlSecTransformDataTypeXml) != 0)) {
+        ret = xmlSecXsltResultToNodeSet(transform, docOut);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXsltResultToNodeSet",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        ret = xmlSecTransformPushXml(transform->next, transform->outNodes, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPushXml",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        return(0);
+    }
+
+    if(transform->next != NULL) {
+        output = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+    } else {
+        output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecXsltSaveResult(ctx, docOut, output);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltSaveResult",
+                            xmlSecTransformGetName(transform));
+        xmlFreeDoc(docOut);
+        return(-1);
+    }
+    xmlFreeDoc(docOut);
+    return(0);
+}
+
+static int
+xmlSecXsltPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
+                  xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlDocPtr docIn;
+    int owned = 0;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+
+    /* check/update current transform status */
+    switch(transform->status) {
+    case xmlSecTransformStatusNone:
+        transform->status = xmlSecTransformStatusWorking;
+        break;
+    case xmlSecTransformStatusFinished:
+        return(0);
+    default:
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+    xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
+
+    docIn = xmlSecXsltNodeSetGetDoc(transform, nodes, transformCtx, &owned);
+    if(docIn == NULL) {
+        xmlSecInternalError("xmlSecXsltNodeSetGetDoc",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    ret = xmlSecXsltPushDoc(transform, docIn, transformCtx);
+    if(owned != 0) {
+        xmlFreeDoc(docIn);
+    }
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltPushDoc",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    transform->status = xmlSecTransformStatusFinished;
+    return(0);
+}
+
+/* pops the input from the previous transform that produces XML only */
+static xmlDocPtr
+xmlSecXsltPopXmlInput(xmlSecTransformPtr transform, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecNodeSetPtr nodes = NULL;
+    xmlDocPtr docIn;
+    xmlDocPtr docOut;
+    int owned = 0;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), NULL);
+    xmlSecAssert2(transform->prev != NULL, NULL);
+    xmlSecAssert2(transformCtx != NULL, NULL);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    ret = xmlSecTransformPopXml(transform->prev, &nodes, transformCtx);
+    if((ret < 0) || (nodes == NULL)) {
+        xmlSecInternalError("xmlSecTransformPopXml",
+                            xmlSecTransformGetName(transform->prev));
+        return(NULL);
+    }
+
+    docIn = xmlSecXsltNodeSetGetDoc(transform, nodes, transformCtx, &owned);
+    if(docIn == NULL) {
+        xmlSecInternalError("xmlSecXsltNodeSetGetDoc",
+                            xmlSecTransformGetName(transform));
+        return(NULL);
+    }
+
+    docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+    if(owned != 0) {
+        xmlFreeDoc(docIn);
+    }
+    if(docOut == NULL) {
+        xmlSecInternalError("xmlSecXsApplyStylesheet",
+                            xmlSecTransformGetName(transform));
+        return(NULL);
+    }
+    return(docOut);
+}
+
+static int
+xmlSecXsltPopBin(xmlSecTransformPtr transform, xmlSecByte* data, xmlSecSize maxDataSize,
+                 xmlSecSize* dataSize, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecSize outSize;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    /* binary input: the usual way */
+    if((transform->prev == NULL) ||
+       ((xmlSecTransformGetDataType(transform->prev, xmlSecTransformModePop, transformCtx) & xmlSecTransformDataTypeBin) != 0)) {
+        return(xmlSecTransformDefaultPopBin(transform, data, maxDataSize, dataSize, transformCtx));
+    }
+
+    /* XML input: process everything on the first call */
+    if(transform->status == xmlSecTransformStatusNone) {
+        xmlOutputBufferPtr output;
+        xmlDocPtr docOut;
+
+        transform->status = xmlSecTransformStatusWorking;
+
+        docOut = xmlSecXsltPopXmlInput(transform, transformCtx);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsltPopXmlInput",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+        ret = xmlSecXsltSaveResult(ctx, docOut, output);
+        xmlFreeDoc(docOut);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXsltSaveResult",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        transform->status = xmlSecTransformStatusFinished;
+    }
+
+    /* copy result (if any) */
+    outSize = xmlSecBufferGetSize(&(transform->outBuf));
+    if(outSize > maxDataSize) {
+        outSize = maxDataSize;
+    }
+    if(outSize > 0) {
+        memcpy(data, xmlSecBufferGetData(&(transform->outBuf)), outSize);
+
+        ret = xmlSecBufferRemoveHead(&(transform->outBuf), outSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferRemoveHead",
+                                 xmlSecTransformGetName(transform),
+                                 "size=%lu", (unsigned long)outSize);
+            return(-1);
+        }
+    }
+    (*dataSize) = outSize;
+    return(0);
+}
+
+static int
+xmlSecXsltPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
+                 xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlDocPtr docIn;
+    xmlDocPtr docOut;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+
+    /* check/update current transform status */
+    switch(transform->status) {
+    case xmlSecTransformStatusNone:
+        transform->status = xmlSecTransformStatusWorking;
+        break;
+    case xmlSecTransformStatusFinished:
+        if(nodes != NULL) {
+            (*nodes) = transform->outNodes;
+        }
+        return(0);
+    default:
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+    xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
+
+    if(transform->prev == NULL) {
+        xmlSecInvalidTransfromError2(transform,
+                                     "prev transform=\"%s\"",
+                                     xmlSecErrorsSafeString(transform->prev));
+        return(-1);
+    }
+
+    if((xmlSecTransformGetDataType(transform->prev, xmlSecTransformModePop, transformCtx) & xmlSecTransformDataTypeXml) != 0) {
+        docOut = xmlSecXsltPopXmlInput(transform, transformCtx);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsltPopXmlInput",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    } else {
+        xmlSecSize inSize, chunkSize;
+
+        /* read everything from the previous transform */
+        do {
+            inSize = xmlSecBufferGetSize(&(transform->inBuf));
+            chunkSize = xmlSecTransformCtxGetBinaryChunkSize(transformCtx);
+            ret = xmlSecBufferSetMaxSize(&(transform->inBuf), inSize + chunkSize);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferSetMaxSize",
+                                     xmlSecTransformGetName(transform),
+                                     "size=%lu", (unsigned long)(inSize + chunkSize));
+                return(-1);
+            }
+            ret = xmlSecTransformPopBin(transform->prev,
+                            xmlSecBufferGetData(&(transform->inBuf)) + inSize,
+                            chunkSize, &chunkSize, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformPopBin",
+                                    xmlSecTransformGetName(transform->prev));
+                return(-1);
+            }
+            ret = xmlSecBufferSetSize(&(transform->inBuf), inSize + chunkSize);
+            if(ret < 0) {
+                xmlSecInternalError2("xmlSecBufferSetSize",
+                                     xmlSecTransformGetName(transform),
+                                     "size=%lu", (unsigned long)(inSize + chunkSize));
+                return(-1);
+            }
+        } while(chunkSize > 0);
+
+        docIn = xmlSecParseMemory(xmlSecBufferGetData(&(transform->inBuf)),
+                                  xmlSecBufferGetSize(&(transform->inBuf)), 1);
+        if(docIn == NULL) {
+            xmlSecInternalError("xmlSecParseMemory",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        xmlSecBufferEmpty(&(transform->inBuf));
+
+        docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+        xmlFreeDoc(docIn);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsApplyStylesheet",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+    }
+
+    ret = xmlSecXsltResultToNodeSet(transform, docOut);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltResultToNodeSet",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    if(nodes != NULL) {
+        (*nodes) = transform->outNodes;
+    }
+    transform->status = xmlSecTransformStatusFinished;
+    return(0);
+}
+
+/* used by xmlSecTransformDefaultPopBin() for the binary input */
 static int
 xmlSecXslProcess(xmlSecXsltCtxPtr ctx, xmlSecBufferPtr in, xmlSecBufferPtr out) {
     xmlDocPtr docIn = NULL;
@@ -0,0 +1,6238 @@
+/**
+ * XML Security Library tests: the library API.
+ *
+ * Checks the library behavior that can not be observed with the xmlsec
+ * command line utility (the caches, the shared objects, ...). Each test
+ * is run separately and the process exit code is the test result.
+ *
+ * Usage:
+ *      testApi [--crypto <name>] [--crypto-config <path>] <test> <topfolder>
+ *
+ * This program needs to be called from testrun.sh script (see testApi.sh).
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#else  /* defined(_MSC_VER) */
+#include <unistd.h>
+#endif /* defined(_MSC_VER) */
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif /* HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC */
+
+#include <libxml/tree.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+#include <libxml/c14n.h>
+#include <libxml/xpath.h>
+#include <libxml/xpathInternals.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/base64.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/keyinfo.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/metrics.h>
+#include <xmlsec/nodeset.h>
+#include <xmlsec/executor.h>
+#include <xmlsec/io.h>
+#include <xmlsec/xmltree.h>
+#include <xmlsec/transforms.h>
+#include <xmlsec/templates.h>
+#include <xmlsec/xmlenc.h>
+#include <xmlsec/xmldsig.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/crypto.h>
+
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509)
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <xmlsec/openssl/app.h>
+#include <xmlsec/openssl/evp.h>
+#include <xmlsec/openssl/x509.h>
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509) */
+
+#if defined(XMLSEC_CRYPTO_OPENSSL)
+#include <xmlsec/openssl/remote.h>
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) */
+
+#if defined(XMLSEC_CRYPTO_OPENSSL) && defined(XMLSEC_OPENSSL_REMOTE)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && defined(XMLSEC_OPENSSL_REMOTE) */
+
+/**************************************************************************
+ *
+ * Helpers
+ *
+ *************************************************************************/
+#define testApiCheck(cond) \
+    if(!(cond)) { \
+        fprintf(stderr, "Error: %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        goto done; \
+    }
+
+typedef int (*testApiFunc)                              (const char* topfolder);
+
+/* the folder for the temporary files (the crypto config folder) */
+static const char* testApiTmpFolder = ".";
+
+/* waits for at least @seconds seconds */
+static void
+testApiSleep(unsigned int seconds) {
+#if defined(_MSC_VER)
+    Sleep(seconds * 1000);
+#else  /* defined(_MSC_VER) */
+    sleep(seconds);
+#endif /* defined(_MSC_VER) */
+}
+
+typedef struct _testApiTest {
+    const char*         name;
+    testApiFunc         func;
+} testApiTest;
+
+/**************************************************************************
+ *
+ * Buffer offset allocation mode
+ *
+ *************************************************************************/
+#define TEST_API_BUFFER_SIZE                    1000
+#define TEST_API_BUFFER_DATA_SIZE               (4 * TEST_API_BUFFER_SIZE)
+#define TEST_API_BUFFER_STEPS                   2000
+
+/* returns the pseudo random number (the sequence is the same for all runs) */
+static xmlSecSize
+testApiBufferRand(unsigned long* seed, xmlSecSize max) {
+    (*seed) = (*seed) * 1103515245UL + 12345UL;
+    return((xmlSecSize)(((*seed) >> 16) % (max + 1)));
+}
+
+/* returns 1 if @buf has the same data as @expected and the unused
+ * memory after the data is cleared or 0 otherwise */
+static int
+testApiBufferCheck(xmlSecBufferPtr buf, xmlSecBufferPtr expected) {
+    xmlSecSize ii;
+
+    if(xmlSecBufferGetSize(buf) != xmlSecBufferGetSize(expected)) {
+        fprintf(stderr, "Error: buffer size %d, expected %d\n",
+                (int)xmlSecBufferGetSize(buf), (int)xmlSecBufferGetSize(expected));
+        return(0);
+    }
+    if((xmlSecBufferGetSize(buf) > 0) &&
+       (memcmp(xmlSecBufferGetData(buf), xmlSecBufferGetData(expected), xmlSecBufferGetSize(buf)) != 0)) {
+        fprintf(stderr, "Error: buffer data mismatch\n");
+        return(0);
+    }
+    for(ii = buf->size; ii < buf->maxSize; ++ii) {
+        if(buf->data[ii] != 0) {
+            fprintf(stderr, "Error: buffer unused byte %d is not cleared\n", (int)ii);
+            return(0);
+        }
+    }
+    return(1);
+}
+
+static int
+testApiBufferOffset(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecByte data[TEST_API_BUFFER_DATA_SIZE];
+    xmlSecBufferMemCounter memCounter;
+    xmlSecBuffer buf;
+    xmlSecBuffer expected;
+    xmlSecByte* start;
+    xmlSecSize maxSize;
+    xmlSecSize size;
+    unsigned long seed = 1;
+    int bufInitialized = 0;
+    int expectedInitialized = 0;
+    xmlSecSize ii;
+    int res = -1;
+
+    for(ii = 0; ii < TEST_API_BUFFER_DATA_SIZE; ++ii) {
+        data[ii] = (xmlSecByte)(ii % 251 + 1);
+    }
+    memset(&memCounter, 0, sizeof(memCounter));
+
+    testApiCheck(xmlSecBufferInitialize(&buf, 0) == 0);
+    bufInitialized = 1;
+    buf.allocMode = xmlSecAllocModeOffset;
+    xmlSecBufferSetMemCounter(&buf, &memCounter);
+    testApiCheck(xmlSecBufferInitialize(&expected, 0) == 0);
+    expectedInitialized = 1;
+    expected.allocMode = xmlSecAllocModeDouble;
+
+    testApiCheck(xmlSecBufferAppend(&buf, data, TEST_API_BUFFER_SIZE) == 0);
+    testApiCheck(xmlSecBufferAppend(&expected, data, TEST_API_BUFFER_SIZE) == 0);
+    start = xmlSecBufferGetData(&buf);
+    maxSize = xmlSecBufferGetMaxSize(&buf);
+    testApiCheck(memCounter.size == maxSize);
+
+    /* removing the head only moves the data pointer */
+    testApiCheck(xmlSecBufferRemoveHead(&buf, 10) == 0);
+    testApiCheck(xmlSecBufferRemoveHead(&expected, 10) == 0);
+    testApiCheck(xmlSecBufferGetData(&buf) == start + 10);
+    testApiCheck(buf.offset == 10);
+    testApiCheck(xmlSecBufferGetMaxSize(&buf) + buf.offset == maxSize);
+    testApiCheck(memCounter.size == maxSize);
+    testApiCheck(testApiBufferCheck(&buf, &expected) == 1);
+    for(ii = 0; ii < 10; ++ii) {
+        testApiCheck(start[ii] == 0);
+    }
+
+    /* the prepended data reuses the space before the data */
+    testApiCheck(xmlSecBufferPrepend(&buf, data + 5, 5) == 0);
+    testApiCheck(xmlSecBufferPrepend(&expected, data + 5, 5) == 0);
+    testApiCheck(xmlSecBufferGetData(&buf) == start + 5);
+    testApiCheck(buf.offset == 5);
+    testApiCheck(testApiBufferCheck(&buf, &expected) == 1);
+
+    /* the space before the data is reclaimed before growing the buffer */
+    size = xmlSecBufferGetMaxSize(&buf) - xmlSecBufferGetSize(&buf) + 1;
+    testApiCheck(size <= TEST_API_BUFFER_DATA_SIZE);
+    testApiCheck(xmlSecBufferAppend(&buf, data, size) == 0);
+    testApiCheck(xmlSecBufferAppend(&expected, data, size) == 0);
+    testApiCheck(xmlSecBufferGetData(&buf) == start);
+    testApiCheck(buf.offset == 0);
+    testApiCheck(xmlSecBufferGetMaxSize(&buf) == maxSize);
+    testApiCheck(testApiBufferCheck(&buf, &expected) == 1);
+
+    /* removing everything goes back to the beginning */
+    testApiCheck(xmlSecBufferRemoveHead(&buf, 20) == 0);
+    testApiCheck(buf.offset == 20);
+    testApiCheck(xmlSecBufferRemoveHead(&buf, xmlSecBufferGetSize(&buf)) == 0);
+    xmlSecBufferEmpty(&expected);
+    testApiCheck(xmlSecBufferGetData(&buf) == start);
+    testApiCheck(buf.offset == 0);
+    testApiCheck(testApiBufferCheck(&buf, &expected) == 1);
+
+    /* the random operations give the same data as the double mode */
+    for(ii = 0; ii < TEST_API_BUFFER_STEPS; ++ii) {
+        size = testApiBufferRand(&seed, TEST_API_BUFFER_SIZE / 4);
+        switch(testApiBufferRand(&seed, 5)) {
+        case 0:
+        case 1:
+            testApiCheck(xmlSecBufferAppend(&buf, data, size) == 0);
+            testApiCheck(xmlSecBufferAppend(&expected, data, size) == 0);
+            break;
+        case 2:
+            testApiCheck(xmlSecBufferPrepend(&buf, data + size, size) == 0);
+            testApiCheck(xmlSecBufferPrepend(&expected, data + size, size) == 0);
+            break;
+        case 3:
+        case 4:
+            testApiCheck(xmlSecBufferRemoveHead(&buf, size) == 0);
+            testApiCheck(xmlSecBufferRemoveHead(&expected, size) == 0);
+            break;
+        default:
+            testApiCheck(xmlSecBufferRemoveTail(&buf, size) == 0);
+            testApiCheck(xmlSecBufferRemoveTail(&expected, size) == 0);
+            break;
+        }
+        testApiCheck(testApiBufferCheck(&buf, &expected) == 1);
+        testApiCheck(memCounter.size == xmlSecBufferGetMaxSize(&buf) + buf.offset);
+    }
+
+    /* the memory is released from the beginning of the allocation */
+    testApiCheck(xmlSecBufferRemoveHead(&buf, 1) == 0);
+    xmlSecBufferFinalize(&buf);
+    bufInitialized = 0;
+    testApiCheck(memCounter.size == 0);
+    res = 0;
+
+done:
+    if(expectedInitialized != 0) {
+        xmlSecBufferFinalize(&expected);
+    }
+    if(bufInitialized != 0) {
+        xmlSecBufferFinalize(&buf);
+    }
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * Buffers memory limit
+ *
+ *************************************************************************/
+#define TEST_API_MEM_LIMIT_SIZE                 1000
+#define TEST_API_MEM_LIMIT_DATA_SIZE            (64 * 1024)
+
+/* base64 encodes @data with the transforms memory limit @maxMemSize and
+ * returns 0 on success or a negative value if an error occurs, @peakSize
+ * is set to the transforms buffers peak memory */
+static int
+testApiMemLimitEncode(const xmlSecByte* data, xmlSecSize dataSize, xmlSecSize maxMemSize,
+                      xmlSecSize* peakSize) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecSize peak0;
+    int initialized = 0;
+    int ret;
+    int res = -1;
+
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    initialized = 1;
+    testApiCheck(xmlSecTransformCtxSetMaxMemSize(&transformCtx, maxMemSize) == 0);
+    transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, xmlSecTransformBase64Id);
+    testApiCheck(transform != NULL);
+    transform->operation = xmlSecTransformOperationEncode;
+
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    ret = xmlSecTransformCtxBinaryExecute(&transformCtx, data, dataSize);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(ret == 0) {
+        testApiCheck(transformCtx.result != NULL);
+        testApiCheck(xmlSecBufferGetSize(transformCtx.result) >= dataSize);
+        res = 0;
+    }
+
+    /* the peak memory is reported when the context is finalized */
+    peak0 = xmlSecMetricsGet(xmlSecMetricTransformsMemoryPeak);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    initialized = 0;
+    (*peakSize) = xmlSecMetricsGet(xmlSecMetricTransformsMemoryPeak) - peak0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(initialized != 0) {
+        xmlSecTransformCtxFinalize(&transformCtx);
+    }
+    return(res);
+}
+
+static int
+testApiBufferMemLimit(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecBufferMemCounter memCounter;
+    xmlSecBufferMemCounter memCounter2;
+    xmlSecBuffer buf;
+    xmlSecBuffer buf2;
+    xmlSecByte* data = NULL;
+    xmlSecSize peakSize = 0;
+    xmlSecSize limitedPeakSize = 0;
+    int bufInitialized = 0;
+    int buf2Initialized = 0;
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(&memCounter, 0, sizeof(memCounter));
+    memset(&memCounter2, 0, sizeof(memCounter2));
+    memCounter.maxSize = TEST_API_MEM_LIMIT_SIZE;
+    testApiCheck(xmlSecBufferInitialize(&buf, 0) == 0);
+    bufInitialized = 1;
+    xmlSecBufferSetMemCounter(&buf, &memCounter);
+    testApiCheck(xmlSecBufferInitialize(&buf2, 0) == 0);
+    buf2Initialized = 1;
+    xmlSecBufferSetMemCounter(&buf2, &memCounter);
+
+    /* the buffer grows exactly to the limit but not above it */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(xmlSecBufferSetMaxSize(&buf, TEST_API_MEM_LIMIT_SIZE) == 0);
+    testApiCheck(xmlSecBufferGetMaxSize(&buf) == TEST_API_MEM_LIMIT_SIZE);
+    testApiCheck(memCounter.size == TEST_API_MEM_LIMIT_SIZE);
+    testApiCheck(xmlSecBufferSetMaxSize(&buf, TEST_API_MEM_LIMIT_SIZE + 1) < 0);
+    testApiCheck(xmlSecBufferGetMaxSize(&buf) == TEST_API_MEM_LIMIT_SIZE);
+
+    /* all the buffers are charged to the same counter */
+    testApiCheck(xmlSecBufferSetMaxSize(&buf2, 1) < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    xmlSecBufferFinalize(&buf);
+    bufInitialized = 0;
+    testApiCheck(memCounter.size == 0);
+    testApiCheck(memCounter.peakSize == TEST_API_MEM_LIMIT_SIZE);
+    testApiCheck(xmlSecBufferSetMaxSize(&buf2, TEST_API_MEM_LIMIT_SIZE / 2) == 0);
+    testApiCheck(memCounter.size == xmlSecBufferGetMaxSize(&buf2));
+
+    /* the swapped buffers keep their counters */
+    testApiCheck(xmlSecBufferInitialize(&buf, 0) == 0);
+    bufInitialized = 1;
+    xmlSecBufferSetMemCounter(&buf, &memCounter2);
+    testApiCheck(xmlSecBufferSetMaxSize(&buf, 2 * TEST_API_MEM_LIMIT_SIZE) == 0);
+    testApiCheck(xmlSecBufferSwap(&buf, &buf2) == 0);
+    testApiCheck(memCounter.size == xmlSecBufferGetMaxSize(&buf2));
+    testApiCheck(memCounter2.size == xmlSecBufferGetMaxSize(&buf));
+    xmlSecBufferSetMemCounter(&buf2, NULL);
+    testApiCheck(memCounter.size == 0);
+
+    /* the transforms chain fails instead of growing above the limit */
+    data = (xmlSecByte*)xmlMalloc(TEST_API_MEM_LIMIT_DATA_SIZE);
+    testApiCheck(data != NULL);
+    for(ii = 0; ii < TEST_API_MEM_LIMIT_DATA_SIZE; ++ii) {
+        data[ii] = (xmlSecByte)(ii % 251);
+    }
+    xmlSecMetricsSetEnabled(1);
+    testApiCheck(testApiMemLimitEncode(data, TEST_API_MEM_LIMIT_DATA_SIZE, 0, &peakSize) == 0);
+    testApiCheck(peakSize > TEST_API_MEM_LIMIT_DATA_SIZE);
+    testApiCheck(testApiMemLimitEncode(data, TEST_API_MEM_LIMIT_DATA_SIZE, peakSize, &limitedPeakSize) == 0);
+    testApiCheck(limitedPeakSize <= peakSize);
+    testApiCheck(testApiMemLimitEncode(data, TEST_API_MEM_LIMIT_DATA_SIZE, TEST_API_MEM_LIMIT_DATA_SIZE, &limitedPeakSize) < 0);
+    testApiCheck(limitedPeakSize <= TEST_API_MEM_LIMIT_DATA_SIZE);
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(data != NULL) {
+        xmlFree(data);
+    }
+    if(buf2Initialized != 0) {
+        xmlSecBufferFinalize(&buf2);
+    }
+    if(bufInitialized != 0) {
+        xmlSecBufferFinalize(&buf);
+    }
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * Compiled XPath expressions cache
+ *
+ *************************************************************************/
+static const char testApiXPathDoc[] =
+    "<Document xmlns:dsig=\"http://www.w3.org/2000/09/xmldsig#\">"
+    "<Data>some text</Data>"
+    "<dsig:Transform Algorithm=\"http://www.w3.org/TR/1999/REC-xpath-19991116\">"
+    "<dsig:XPath/>"
+    "</dsig:Transform>"
+    "</Document>";
+
+/* runs the XPath transform with @expr over the whole @doc */
+static int
+testApiXPathExecute(xmlDocPtr doc, const char* expr) {
+    xmlSecTransformCtx ctx;
+    xmlNodePtr transformNode;
+    xmlNodePtr xpathNode;
+    int res = -1;
+
+    transformNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeTransform, xmlSecDSigNs);
+    testApiCheck(transformNode != NULL);
+    xpathNode = xmlSecFindChild(transformNode, xmlSecNodeXPath, xmlSecDSigNs);
+    testApiCheck(xpathNode != NULL);
+    xmlNodeSetContent(xpathNode, BAD_CAST expr);
+
+    if(xmlSecTransformCtxInitialize(&ctx) < 0) {
+        fprintf(stderr, "Error: xmlSecTransformCtxInitialize failed\n");
+        return(-1);
+    }
+    testApiCheck(xmlSecTransformCtxNodeRead(&ctx, transformNode, xmlSecTransformUsageDSigTransform) != NULL);
+    testApiCheck(xmlSecTransformCtxExecute(&ctx, doc) == 0);
+    testApiCheck(ctx.result != NULL);
+    res = 0;
+
+done:
+    xmlSecTransformCtxFinalize(&ctx);
+    return(res);
+}
+
+/* runs the XPath transform and returns the cache hits and misses it caused */
+static int
+testApiXPathCount(xmlDocPtr doc, const char* expr, xmlSecSize* hits, xmlSecSize* misses) {
+    xmlSecSize hits0, misses0;
+
+    xmlSecTransformXPathGetCacheStats(&hits0, &misses0);
+    if(testApiXPathExecute(doc, expr) < 0) {
+        return(-1);
+    }
+    xmlSecTransformXPathGetCacheStats(hits, misses);
+    (*hits) -= hits0;
+    (*misses) -= misses0;
+    return(0);
+}
+
+static int
+testApiXPathCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    static const char expr[] = "ancestor-or-self::Data";
+    char tmp[128];
+    xmlDocPtr doc;
+    xmlSecSize hits, misses;
+    xmlSecSize ii;
+    int evicted = 0;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiXPathDoc, (int)strlen(testApiXPathDoc), NULL, NULL, 0);
+    if(doc == NULL) {
+        fprintf(stderr, "Error: unable to parse the test document\n");
+        return(-1);
+    }
+    xmlSecTransformXPathFlushCache();
+
+    /* the first evaluation compiles the expression, the second reuses it */
+    testApiCheck(testApiXPathCount(doc, expr, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+    testApiCheck(testApiXPathCount(doc, expr, &hits, &misses) == 0);
+    testApiCheck((hits == 1) && (misses == 0));
+
+    /* the flushed expression is compiled again */
+    xmlSecTransformXPathFlushCache();
+    testApiCheck(testApiXPathCount(doc, expr, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+
+    /* the full cache evicts the cached expressions */
+    for(ii = 0; (ii < 100000) && (evicted == 0); ++ii) {
+        snprintf(tmp, sizeof(tmp), "ancestor-or-self::Data or %u = 0", (unsigned int)ii);
+        testApiCheck(testApiXPathCount(doc, tmp, &hits, &misses) == 0);
+        testApiCheck((hits == 0) && (misses == 1));
+
+        testApiCheck(testApiXPathCount(doc, expr, &hits, &misses) == 0);
+        testApiCheck(hits + misses == 1);
+        evicted = (misses == 1) ? 1 : 0;
+    }
+    testApiCheck(evicted == 1);
+
+    /* and caches the expressions again after the eviction */
+    testApiCheck(testApiXPathCount(doc, expr, &hits, &misses) == 0);
+    testApiCheck((hits == 1) && (misses == 0));
+    res = 0;
+
+done:
+    xmlFreeDoc(doc);
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * Native c14n: the output is compared with libxml2 xmlC14NDocSaveTo()
+ * for the same nodes set.
+ *
+ *************************************************************************/
+#define TEST_API_C14N_MAX_PREFIXES              8
+#define TEST_API_C14N_PARALLEL_ITEMS            10000
+
+typedef xmlSecTransformId (*testApiC14NGetKlass)       (void);
+
+typedef struct _testApiC14NMode {
+    const char*         name;
+    testApiC14NGetKlass getKlass;
+    int                 mode;
+    int                 withComments;
+    const char*         prefixList;
+} testApiC14NMode;
+
+static const testApiC14NMode testApiC14NModes[] = {
+    { "c14n",                   xmlSecTransformInclC14NGetKlass,                XML_C14N_1_0,           0, NULL },
+    { "c14n-comments",          xmlSecTransformInclC14NWithCommentsGetKlass,    XML_C14N_1_0,           1, NULL },
+    { "c14n11",                 xmlSecTransformInclC14N11GetKlass,              XML_C14N_1_1,           0, NULL },
+    { "c14n11-comments",        xmlSecTransformInclC14N11WithCommentsGetKlass,  XML_C14N_1_1,           1, NULL },
+    { "exc-c14n",               xmlSecTransformExclC14NGetKlass,                XML_C14N_EXCLUSIVE_1_0, 0, NULL },
+    { "exc-c14n-comments",      xmlSecTransformExclC14NWithCommentsGetKlass,    XML_C14N_EXCLUSIVE_1_0, 1, NULL },
+    { "exc-c14n-prefixes",      xmlSecTransformExclC14NGetKlass,                XML_C14N_EXCLUSIVE_1_0, 0, "b #default" },
+    { "exc-c14n-prefixes2",     xmlSecTransformExclC14NWithCommentsGetKlass,    XML_C14N_EXCLUSIVE_1_0, 1, "a c xml" },
+    { NULL,                     NULL,                                           0,                      0, NULL }
+};
+
+static const char testApiC14NDoc[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<?pi-before data?>\n"
+    "<!-- comment before -->\n"
+    "<a:Root xmlns:a=\"urn:a\" xmlns=\"urn:default\" xmlns:b=\"urn:b\" "
+        "attr=\"v&amp;&lt;&quot;&#9;&#10;&#13;>\" xml:lang=\"en\" xml:space=\"default\">\n"
+    "  <B xmlns:c=\"urn:c\" b:attr=\"1\" a:attr=\"2\" zattr=\"3\" c:x=\"4\">text &amp; &lt; &gt; &#13; more\n"
+    "    <c:C xmlns=\"\" xml:space=\"preserve\"><D xmlns:a=\"urn:a2\" a:y=\"5\">d</D><!-- inner --><?pi inner?></c:C>\n"
+    "    <E xmlns:b=\"urn:b\"><b:F xmlns=\"urn:default\"/><G xmlns=\"\"/></E>\n"
+    "  </B>\n"
+    "  <H xmlns:a=\"urn:a\" xml:lang=\"fr\"><![CDATA[cdata <&>\r]]></H>\n"
+    "</a:Root>\n"
+    "<!-- comment after -->\n"
+    "<?pi-after?>\n";
+
+/* the nodes sets: NULL is the whole document (see testApiC14NCompare) */
+static const char* const testApiC14NExprs[] = {
+    "(//. | //@* | //namespace::*)",
+    "(//. | //@* | //namespace::*)[ancestor-or-self::*[local-name()='B']]",
+    "(//. | //@* | //namespace::*)[not(ancestor-or-self::*[local-name()='C'])]",
+    "(//. | //@* | //namespace::*)[not(self::*[local-name()='E'])]",
+    "(//. | //@*)[ancestor-or-self::*[local-name()='B']]",
+    "(//. | //namespace::*)[not(self::text())]",
+    "//*[local-name()='D' or local-name()='F' or local-name()='H'] | //@* | //namespace::*",
+    "(//. | //@* | //namespace::*)[not(self::*[local-name()='Root'])]",
+    NULL
+};
+
+/* splits @prefixList into @prefixes (NULL terminated), the strings point into @buf */
+static xmlChar**
+testApiC14NGetPrefixes(const char* prefixList, xmlChar* buf, xmlSecSize bufSize, xmlChar** prefixes) {
+    xmlSecSize ii = 0;
+    xmlChar* cur;
+
+    if(prefixList == NULL) {
+        return(NULL);
+    }
+    xmlStrPrintf(buf, (int)bufSize, "%s", prefixList);
+    for(cur = (xmlChar*)strtok((char*)buf, " "); (cur != NULL) && (ii + 1 < TEST_API_C14N_MAX_PREFIXES); cur = (xmlChar*)strtok(NULL, " ")) {
+        prefixes[ii++] = cur;
+    }
+    prefixes[ii] = NULL;
+    return(prefixes);
+}
+
+/* evaluates @expr over @doc (the caller owns the result) */
+static xmlNodeSetPtr
+testApiC14NEvalNodes(xmlDocPtr doc, const char* expr) {
+    xmlXPathContextPtr xpathCtx;
+    xmlXPathObjectPtr obj;
+    xmlNodeSetPtr res = NULL;
+
+    xpathCtx = xmlXPathNewContext(doc);
+    if(xpathCtx == NULL) {
+        fprintf(stderr, "Error: xmlXPathNewContext failed\n");
+        return(NULL);
+    }
+    obj = xmlXPathEval(BAD_CAST expr, xpathCtx);
+    if((obj != NULL) && (obj->type == XPATH_NODESET) && (obj->nodesetval != NULL)) {
+        res = obj->nodesetval;
+        obj->nodesetval = NULL;
+    } else {
+        fprintf(stderr, "Error: xmlXPathEval(\"%s\") failed\n", expr);
+    }
+    if(obj != NULL) {
+        xmlXPathFreeObject(obj);
+    }
+    xmlXPathFreeContext(xpathCtx);
+    return(res);
+}
+
+/* canonicalizes @nodes (or the whole @doc if @nodes is NULL) with libxml2 */
+static int
+testApiC14NLibxml2(xmlDocPtr doc, xmlNodeSetPtr nodes, const testApiC14NMode* mode, int withComments, xmlBufferPtr out) {
+    xmlChar* prefixes[TEST_API_C14N_MAX_PREFIXES];
+    xmlChar prefixesBuf[128];
+    xmlOutputBufferPtr buf;
+    int ret;
+
+    buf = xmlOutputBufferCreateBuffer(out, NULL);
+    if(buf == NULL) {
+        fprintf(stderr, "Error: xmlOutputBufferCreateBuffer failed\n");
+        return(-1);
+    }
+    ret = xmlC14NDocSaveTo(doc, nodes, mode->mode,
+        testApiC14NGetPrefixes(mode->prefixList, prefixesBuf, sizeof(prefixesBuf), prefixes),
+        withComments, buf);
+    if(xmlOutputBufferClose(buf) < 0) {
+        ret = -1;
+    }
+    if(ret < 0) {
+        fprintf(stderr, "Error: xmlC14NDocSaveTo failed\n");
+        return(-1);
+    }
+    return(0);
+}
+
+/* reads the c14n transform for @mode into @ctx */
+static int
+testApiC14NReadTransform(xmlSecTransformCtxPtr ctx, const testApiC14NMode* mode) {
+    char str[512];
+    char prefixList[256] = "";
+    xmlDocPtr doc;
+    int res = -1;
+
+    if(mode->prefixList != NULL) {
+        snprintf(prefixList, sizeof(prefixList),
+            "<ec:InclusiveNamespaces xmlns:ec=\"%s\" PrefixList=\"%s\"/>",
+            (const char*)xmlSecNsExcC14N, mode->prefixList);
+    }
+    snprintf(str, sizeof(str),
+        "<dsig:Transform xmlns:dsig=\"%s\" Algorithm=\"%s\">%s</dsig:Transform>",
+        (const char*)xmlSecDSigNs, (const char*)(mode->getKlass()->href), prefixList);
+
+    doc = xmlReadMemory(str, (int)strlen(str), NULL, NULL, 0);
+    if(doc == NULL) {
+        fprintf(stderr, "Error: unable to parse the transform node\n");
+        return(-1);
+    }
+    testApiCheck(xmlSecTransformCtxNodeRead(ctx, xmlDocGetRootElement(doc), xmlSecTransformUsageDSigTransform) != NULL);
+    res = 0;
+
+done:
+    xmlFreeDoc(doc);
+    return(res);
+}
+
+/* canonicalizes @nodes with xmlsec (takes the ownership of @nodes) */
+static int
+testApiC14NXmlSec(xmlSecNodeSetPtr nodes, const testApiC14NMode* mode, unsigned int flags, xmlBufferPtr out) {
+    xmlSecTransformCtx ctx;
+    int res = -1;
+
+    if(xmlSecTransformCtxInitialize(&ctx) < 0) {
+        fprintf(stderr, "Error: xmlSecTransformCtxInitialize failed\n");
+        xmlSecNodeSetDestroy(nodes);
+        return(-1);
+    }
+    ctx.flags |= flags;
+
+    testApiCheck(testApiC14NReadTransform(&ctx, mode) == 0);
+    testApiCheck(xmlSecTransformCtxXmlExecute(&ctx, nodes) == 0);
+    testApiCheck(ctx.result != NULL);
+    testApiCheck(xmlBufferAdd(out, xmlSecBufferGetData(ctx.result), (int)xmlSecBufferGetSize(ctx.result)) == 0);
+    res = 0;
+
+done:
+    xmlSecTransformCtxFinalize(&ctx);
+    xmlSecNodeSetDestroy(nodes);
+    return(res);
+}
+
+static int
+testApiC14NCheckEqual(xmlBufferPtr expected, xmlBufferPtr actual, const char* name, const char* expr) {
+    if((xmlBufferLength(expected) != xmlBufferLength(actual)) ||
+       (memcmp(xmlBufferContent(expected), xmlBufferContent(actual), (size_t)xmlBufferLength(actual)) != 0)) {
+        fprintf(stderr, "Error: %s c14n of \"%s\" doesn't match libxml2\n", name, expr);
+        fprintf(stderr, "--- libxml2:\n%s\n--- xmlsec:\n%s\n---\n",
+            (const char*)xmlBufferContent(expected), (const char*)xmlBufferContent(actual));
+        return(-1);
+    }
+    return(0);
+}
+
+/* compares the xmlsec and libxml2 c14n of the nodes selected by @expr or,
+ * if @expr is NULL, of the whole document (@withComments selects the comments) */
+static int
+testApiC14NCompare(xmlDocPtr doc, const char* expr, int withComments, const testApiC14NMode* mode) {
+    xmlNodeSetPtr nodes = NULL;
+    xmlSecNodeSetPtr nset = NULL;
+    xmlBufferPtr expected = NULL;
+    xmlBufferPtr actual = NULL;
+    int res = -1;
+
+    expected = xmlBufferCreate();
+    testApiCheck(expected != NULL);
+    actual = xmlBufferCreate();
+    testApiCheck(actual != NULL);
+
+    if(expr != NULL) {
+        nodes = testApiC14NEvalNodes(doc, expr);
+        testApiCheck(nodes != NULL);
+        testApiCheck(testApiC14NLibxml2(doc, nodes, mode, mode->withComments, expected) == 0);
+        nset = xmlSecNodeSetCreate(doc, testApiC14NEvalNodes(doc, expr), xmlSecNodeSetNormal);
+    } else {
+        testApiCheck(testApiC14NLibxml2(doc, NULL, mode, (mode->withComments && withComments) ? 1 : 0, expected) == 0);
+        nset = xmlSecNodeSetGetChildren(doc, NULL, withComments, 0);
+    }
+    testApiCheck(nset != NULL);
+    testApiCheck(testApiC14NXmlSec(nset, mode, 0, actual) == 0);
+    testApiCheck(testApiC14NCheckEqual(expected, actual, mode->name, (expr != NULL) ? expr : "/") == 0);
+    res = 0;
+
+done:
+    if(nodes != NULL) {
+        xmlXPathFreeNodeSet(nodes);
+    }
+    if(actual != NULL) {
+        xmlBufferFree(actual);
+    }
+    if(expected != NULL) {
+        xmlBufferFree(expected);
+    }
+    return(res);
+}
+
+static int
+testApiC14NNative(const char* topfolder ATTRIBUTE_UNUSED) {
+    const testApiC14NMode* mode;
+    const char* const* expr;
+    xmlDocPtr doc;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiC14NDoc, (int)strlen(testApiC14NDoc), NULL, NULL, 0);
+    if(doc == NULL) {
+        fprintf(stderr, "Error: unable to parse the test document\n");
+        return(-1);
+    }
+
+    for(mode = testApiC14NModes; mode->name != NULL; ++mode) {
+        testApiCheck(testApiC14NCompare(doc, NULL, 1, mode) == 0);
+        testApiCheck(testApiC14NCompare(doc, NULL, 0, mode) == 0);
+        for(expr = testApiC14NExprs; (*expr) != NULL; ++expr) {
+            testApiCheck(testApiC14NCompare(doc, *expr, 0, mode) == 0);
+        }
+    }
+    res = 0;
+
+done:
+    xmlFreeDoc(doc);
+    return(res);
+}
+
+/* the executor callback that remembers the max number of tasks */
+static int
+testApiC14NExecutorCallback(xmlSecExecutorTaskMethod task, void** tasksData,
+                            xmlSecSize tasksNumber, void* userData) {
+    xmlSecSize* maxTasksNumber = (xmlSecSize*)userData;
+
+    if((*maxTasksNumber) < tasksNumber) {
+        (*maxTasksNumber) = tasksNumber;
+    }
+    return(xmlSecExecutorDefaultRunCallback(task, tasksData, tasksNumber, NULL));
+}
+
+/* a big document with the enveloped signature transforms (for @mode) */
+static xmlDocPtr
+testApiC14NCreateBigDoc(const testApiC14NMode* mode) {
+    char prefixList[256] = "";
+    xmlBufferPtr buf;
+    xmlDocPtr doc = NULL;
+    int ii;
+
+    buf = xmlBufferCreate();
+    if(buf == NULL) {
+        fprintf(stderr, "Error: xmlBufferCreate failed\n");
+        return(NULL);
+    }
+    xmlBufferCCat(buf, "<Root xmlns=\"urn:r\" xmlns:p=\"urn:p\" xml:lang=\"en\">\n");
+    for(ii = 0; ii < TEST_API_C14N_PARALLEL_ITEMS; ++ii) {
+        char str[256];
+
+        snprintf(str, sizeof(str),
+            "<p:Item id=\"%d\" a=\"x&amp;y\">text %d &lt;<Sub xmlns:q=\"urn:q%d\" q:v=\"1\"/></p:Item><!-- c -->\n",
+            ii, ii, ii % 3);
+        xmlBufferCCat(buf, str);
+    }
+    if(mode->prefixList != NULL) {
+        snprintf(prefixList, sizeof(prefixList),
+            "<ec:InclusiveNamespaces xmlns:ec=\"%s\" PrefixList=\"%s\"/>",
+            (const char*)xmlSecNsExcC14N, mode->prefixList);
+    }
+    xmlBufferCCat(buf, "<dsig:Signature xmlns:dsig=\"");
+    xmlBufferCat(buf, xmlSecDSigNs);
+    xmlBufferCCat(buf, "\"><dsig:SignedInfo><dsig:Reference URI=\"\"><dsig:Transforms>");
+    xmlBufferCCat(buf, "<dsig:Transform Algorithm=\"");
+    xmlBufferCat(buf, xmlSecHrefEnveloped);
+    xmlBufferCCat(buf, "\"/><dsig:Transform Algorithm=\"");
+    xmlBufferCat(buf, mode->getKlass()->href);
+    xmlBufferCCat(buf, "\">");
+    xmlBufferCCat(buf, prefixList);
+    xmlBufferCCat(buf, "</dsig:Transform></dsig:Transforms></dsig:Reference></dsig:SignedInfo></dsig:Signature>");
+    xmlBufferCCat(buf, "</Root>\n");
+
+    doc = xmlReadMemory((const char*)xmlBufferContent(buf), xmlBufferLength(buf), NULL, NULL, 0);
+    if(doc == NULL) {
+        fprintf(stderr, "Error: unable to parse the big test document\n");
+    }
+    xmlBufferFree(buf);
+    return(doc);
+}
+
+/* the parallel c14n of the whole document and of the enveloped signature */
+static int
+testApiC14NParallelCompare(const testApiC14NMode* mode, xmlSecSize* maxTasksNumber) {
+    xmlSecTransformCtx ctx;
+    int ctxInitialized = 0;
+    xmlDocPtr doc = NULL;
+    xmlDocPtr envelopedDoc = NULL;
+    xmlNodePtr node;
+    xmlBufferPtr expected = NULL;
+    xmlBufferPtr actual = NULL;
+    int res = -1;
+
+    doc = testApiC14NCreateBigDoc(mode);
+    testApiCheck(doc != NULL);
+    expected = xmlBufferCreate();
+    testApiCheck(expected != NULL);
+    actual = xmlBufferCreate();
+    testApiCheck(actual != NULL);
+
+    /* the whole document */
+    (*maxTasksNumber) = 0;
+    testApiCheck(testApiC14NLibxml2(doc, NULL, mode, mode->withComments, expected) == 0);
+    testApiCheck(testApiC14NXmlSec(xmlSecNodeSetGetChildren(doc, NULL, 1, 0), mode,
+        XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N, actual) == 0);
+    testApiCheck(testApiC14NCheckEqual(expected, actual, mode->name, "/ (parallel)") == 0);
+    testApiCheck((*maxTasksNumber) > 1);
+
+    /* the enveloped signature: the same as the document without the signature */
+    xmlBufferEmpty(expected);
+    xmlBufferEmpty(actual);
+    envelopedDoc = xmlCopyDoc(doc, 1);
+    testApiCheck(envelopedDoc != NULL);
+    node = xmlSecFindNode(xmlDocGetRootElement(envelopedDoc), xmlSecNodeSignature, xmlSecDSigNs);
+    testApiCheck(node != NULL);
+    xmlUnlinkNode(node);
+    xmlFreeNode(node);
+    testApiCheck(testApiC14NLibxml2(envelopedDoc, NULL, mode, 0, expected) == 0);
+
+    (*maxTasksNumber) = 0;
+    testApiCheck(xmlSecTransformCtxInitialize(&ctx) == 0);
+    ctxInitialized = 1;
+    ctx.flags |= XMLSEC_TRANSFORMCTX_FLAGS_PARALLEL_C14N;
+    node = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeTransforms, xmlSecDSigNs);
+    testApiCheck(node != NULL);
+    testApiCheck(xmlSecTransformCtxNodesListRead(&ctx, node, xmlSecTransformUsageDSigTransform) == 0);
+    testApiCheck(xmlSecTransformCtxExecute(&ctx, doc) == 0);
+    testApiCheck(ctx.result != NULL);
+    testApiCheck(xmlBufferAdd(actual, xmlSecBufferGetData(ctx.result), (int)xmlSecBufferGetSize(ctx.result)) == 0);
+    testApiCheck(testApiC14NCheckEqual(expected, actual, mode->name, "enveloped (parallel)") == 0);
+    testApiCheck((*maxTasksNumber) > 1);
+    res = 0;
+
+done:
+    if(ctxInitialized != 0) {
+        xmlSecTransformCtxFinalize(&ctx);
+    }
+    if(actual != NULL) {
+        xmlBufferFree(actual);
+    }
+    if(expected != NULL) {
+        xmlBufferFree(expected);
+    }
+    if(envelopedDoc != NULL) {
+        xmlFreeDoc(envelopedDoc);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiC14NNativeParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    const testApiC14NMode* mode;
+    xmlSecSize maxTasksNumber = 0;
+    int res = -1;
+
+    /* at least 4 tasks, whatever the number of processors */
+    xmlSecExecutorSetCallback(testApiC14NExecutorCallback, 4, &maxTasksNumber);
+    for(mode = testApiC14NModes; mode->name != NULL; ++mode) {
+        testApiCheck(testApiC14NParallelCompare(mode, &maxTasksNumber) == 0);
+    }
+    res = 0;
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * Transforms: statistics
+ *
+ *************************************************************************/
+#ifndef XMLSEC_NO_SHA256
+
+static const char testApiTransformStatsData[] = "some data to digest";
+
+static int
+testApiTransformStats(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecTransformCtxPtr ctx = NULL;
+    xmlSecTransformPtr transform;
+    xmlSecTransformPtr other = NULL;
+    xmlSecTransformStatsPtr stats;
+    xmlSecTransformStats ctxStats;
+    int res = -1;
+
+    ctx = xmlSecTransformCtxCreate();
+    testApiCheck(ctx != NULL);
+    ctx->flags |= XMLSEC_TRANSFORMCTX_FLAGS_COLLECT_STATS;
+    transform = xmlSecTransformCtxCreateAndAppend(ctx, xmlSecTransformSha256Id);
+    testApiCheck(transform != NULL);
+    transform->operation = xmlSecTransformOperationSign;
+
+    /* only the digest and signature transforms get the inline output storage */
+    testApiCheck((transform->outBuf.inlineData != NULL) && (transform->outBuf.inlineSize >= 32));
+    other = xmlSecTransformCreate(xmlSecTransformBase64Id);
+    testApiCheck(other != NULL);
+    testApiCheck((other->outBuf.inlineData == NULL) && (other->outBuf.inlineSize == 0));
+
+    /* nothing is collected before the execution */
+    stats = xmlSecTransformGetStats(transform);
+    testApiCheck(stats != NULL);
+    testApiCheck((stats->pushBinCalls == 0) && (stats->bytesIn == 0));
+
+    testApiCheck(xmlSecTransformCtxBinaryExecute(ctx, (const xmlSecByte*)testApiTransformStatsData,
+                 sizeof(testApiTransformStatsData) - 1) == 0);
+    stats = xmlSecTransformGetStats(transform);
+    testApiCheck(stats != NULL);
+    testApiCheck(stats->pushBinCalls == 1);
+    testApiCheck(stats->bytesIn == sizeof(testApiTransformStatsData) - 1);
+    testApiCheck(stats->bytesOut == 32);
+
+    /* the chain totals include the digest */
+    testApiCheck(xmlSecTransformCtxGetStats(ctx, &ctxStats) == 0);
+    testApiCheck(ctxStats.bytesIn >= stats->bytesIn);
+    testApiCheck(ctxStats.pushBinCalls >= stats->pushBinCalls);
+    res = 0;
+
+done:
+    if(other != NULL) {
+        xmlSecTransformDestroy(other);
+    }
+    if(ctx != NULL) {
+        xmlSecTransformCtxDestroy(ctx);
+    }
+    return(res);
+}
+
+#else  /* XMLSEC_NO_SHA256 */
+
+static int
+testApiTransformStats(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* XMLSEC_NO_SHA256 */
+
+/**************************************************************************
+ *
+ * I/O: caching input callbacks
+ *
+ *************************************************************************/
+#define TEST_API_IO_CACHE_URI_PREFIX            "http://testapi.example/"
+
+/* the fake transport: the response is the uri and the transport opens counter */
+typedef struct _testApiIOTransportCtx {
+    char                data[256];
+    size_t              size;
+    size_t              pos;
+} testApiIOTransportCtx;
+
+static unsigned int testApiIOTransportOpens = 0;
+
+static int
+testApiIOTransportMatch(const char* uri) {
+    if((uri == NULL) || (strncmp(uri, TEST_API_IO_CACHE_URI_PREFIX, strlen(TEST_API_IO_CACHE_URI_PREFIX)) != 0)) {
+        return(0);
+    }
+    return(1);
+}
+
+static void*
+testApiIOTransportOpen(const char* uri) {
+    testApiIOTransportCtx* ctx;
+
+    /* the "missing" uri is not found */
+    if(strstr(uri, "missing") != NULL) {
+        return(NULL);
+    }
+    ctx = (testApiIOTransportCtx*)xmlMalloc(sizeof(testApiIOTransportCtx));
+    if(ctx == NULL) {
+        return(NULL);
+    }
+    ++testApiIOTransportOpens;
+    snprintf(ctx->data, sizeof(ctx->data), "%s #%u", uri, testApiIOTransportOpens);
+    ctx->size = strlen(ctx->data);
+    ctx->pos = 0;
+    return(ctx);
+}
+
+static int
+testApiIOTransportRead(void* context, char* buffer, int len) {
+    testApiIOTransportCtx* ctx = (testApiIOTransportCtx*)context;
+    size_t size;
+
+    if(len < 0) {
+        return(-1);
+    }
+    size = ctx->size - ctx->pos;
+    if(size > (size_t)len) {
+        size = (size_t)len;
+    }
+    memcpy(buffer, ctx->data + ctx->pos, size);
+    ctx->pos += size;
+    return((int)size);
+}
+
+static int
+testApiIOTransportClose(void* context) {
+    xmlFree(context);
+    return(0);
+}
+
+/* reads the @name uri with the input URI transform and checks that the
+ * response is from the @expectedOpen transport open */
+static int
+testApiIOCacheGet(const char* name, unsigned int expectedOpen) {
+    xmlSecTransformCtx transformCtx;
+    char uri[128];
+    char expected[256];
+    int res = -1;
+
+    snprintf(uri, sizeof(uri), "%s%s", TEST_API_IO_CACHE_URI_PREFIX, name);
+    snprintf(expected, sizeof(expected), "%s #%u", uri, expectedOpen);
+
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    if(xmlSecTransformCtxUriExecute(&transformCtx, BAD_CAST uri) < 0) {
+        fprintf(stderr, "Error: unable to read uri=%s\n", uri);
+        xmlSecTransformCtxFinalize(&transformCtx);
+        goto done;
+    }
+    if((transformCtx.result == NULL) ||
+       (xmlSecBufferGetSize(transformCtx.result) != strlen(expected)) ||
+       (memcmp(xmlSecBufferGetData(transformCtx.result), expected, strlen(expected)) != 0)) {
+        fprintf(stderr, "Error: unexpected response for uri=%s, expected=\"%s\"\n", uri, expected);
+        xmlSecTransformCtxFinalize(&transformCtx);
+        goto done;
+    }
+    xmlSecTransformCtxFinalize(&transformCtx);
+    res = 0;
+
+done:
+    return(res);
+}
+
+static int
+testApiIOCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecTransformCtx transformCtx;
+    int res = -1;
+
+    testApiIOTransportOpens = 0;
+    xmlSecIOCacheFlush();
+    xmlSecIOCleanupCallbacks();
+    testApiCheck(xmlSecIORegisterCallbacks(xmlSecIOCacheMatch, xmlSecIOCacheOpen,
+        xmlSecIOCacheRead, xmlSecIOCacheClose) == 0);
+    testApiCheck(xmlSecIORegisterCallbacks(testApiIOTransportMatch, testApiIOTransportOpen,
+        testApiIOTransportRead, testApiIOTransportClose) == 0);
+    testApiCheck(xmlSecIOCacheSetLimits(2, 1024, 300) == 0);
+
+    /* the repeated uri is served from the cache */
+    testApiCheck(testApiIOCacheGet("a", 1) == 0);
+    testApiCheck(testApiIOCacheGet("a", 1) == 0);
+    testApiCheck(testApiIOCacheGet("b", 2) == 0);
+    testApiCheck(testApiIOCacheGet("a", 1) == 0);
+
+    /* the least recently used response is dropped */
+    testApiCheck(testApiIOCacheGet("c", 3) == 0);
+    testApiCheck(testApiIOCacheGet("a", 1) == 0);
+    testApiCheck(testApiIOCacheGet("b", 4) == 0);
+    testApiCheck(testApiIOCacheGet("c", 5) == 0);
+
+    /* the failed requests are not cached */
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(xmlSecTransformCtxUriExecute(&transformCtx, BAD_CAST TEST_API_IO_CACHE_URI_PREFIX "missing") < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    testApiCheck(testApiIOTransportOpens == 5);
+    testApiCheck(testApiIOCacheGet("c", 5) == 0);
+
+    /* the responses larger than the cache are not cached */
+    testApiCheck(xmlSecIOCacheSetLimits(2, 16, 300) == 0);
+    testApiCheck(testApiIOCacheGet("d", 6) == 0);
+    testApiCheck(testApiIOCacheGet("d", 7) == 0);
+
+    /* the flushed and the expired responses are fetched again */
+    testApiCheck(xmlSecIOCacheSetLimits(2, 1024, 1) == 0);
+    testApiCheck(testApiIOCacheGet("e", 8) == 0);
+    testApiCheck(testApiIOCacheGet("e", 8) == 0);
+    xmlSecIOCacheFlush();
+    testApiCheck(testApiIOCacheGet("e", 9) == 0);
+    testApiSleep(2);
+    testApiCheck(testApiIOCacheGet("e", 10) == 0);
+
+    /* the cache is disabled with 0 max age */
+    testApiCheck(xmlSecIOCacheSetLimits(2, 1024, 0) == 0);
+    testApiCheck(testApiIOCacheGet("f", 11) == 0);
+    testApiCheck(testApiIOCacheGet("f", 12) == 0);
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    xmlSecIOCacheFlush();
+    (void)xmlSecIOCacheSetLimits(256, 16 * 1024 * 1024, 300);
+    xmlSecIOCleanupCallbacks();
+    (void)xmlSecIORegisterDefaultCallbacks();
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * I/O: memory mapped local files
+ *
+ *************************************************************************/
+#define TEST_API_MAPPED_FILE_SIZE               (300 * 1024 + 7)
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#define TEST_API_MAPPED_FILE_EXPECTED           1
+#else  /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+#define TEST_API_MAPPED_FILE_EXPECTED           0
+#endif /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+
+/* writes @size bytes of @data to the @filename file */
+static int
+testApiMappedFileWrite(const char* filename, const xmlSecByte* data, xmlSecSize size) {
+    FILE* f;
+    int res = -1;
+
+    f = fopen(filename, "wb");
+    testApiCheck(f != NULL);
+    if((size > 0) && (fwrite(data, 1, size, f) != size)) {
+        fprintf(stderr, "Error: unable to write file \"%s\"\n", filename);
+        fclose(f);
+        goto done;
+    }
+    testApiCheck(fclose(f) == 0);
+    res = 0;
+
+done:
+    return(res);
+}
+
+/* reads the @filename with the input URI transform (and the digest if
+ * @digestId is not unknown) and checks the result is @expected */
+static int
+testApiMappedFileUriRead(const char* filename, xmlSecTransformId digestId, xmlSecBufferPtr expected) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformPtr transform;
+    int initialized = 0;
+    int res = -1;
+
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    initialized = 1;
+    if(digestId != xmlSecTransformIdUnknown) {
+        transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, digestId);
+        testApiCheck(transform != NULL);
+        transform->operation = xmlSecTransformOperationSign;
+    }
+    testApiCheck(xmlSecTransformCtxUriExecute(&transformCtx, BAD_CAST filename) == 0);
+    testApiCheck(transformCtx.result != NULL);
+    testApiCheck(xmlSecBufferGetSize(transformCtx.result) == xmlSecBufferGetSize(expected));
+    testApiCheck(memcmp(xmlSecBufferGetData(transformCtx.result), xmlSecBufferGetData(expected),
+        xmlSecBufferGetSize(expected)) == 0);
+    res = 0;
+
+done:
+    if(initialized != 0) {
+        xmlSecTransformCtxFinalize(&transformCtx);
+    }
+    return(res);
+}
+
+static int
+testApiMappedFile(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecTransformCtx transformCtx;
+    xmlSecTransformPtr transform;
+    xmlSecBufferPtr buf = NULL;
+    xmlSecBufferPtr expected = NULL;
+    const xmlSecByte* mappedData = NULL;
+    xmlSecSize mappedSize = 0;
+    xmlSecByte* data = NULL;
+    char filename[1024];
+    char emptyFilename[1024];
+    unsigned long seed = 1;
+    int initialized = 0;
+    xmlSecSize ii;
+    int res = -1;
+
+    snprintf(filename, sizeof(filename), "%s/testApi-mapped-file.bin", testApiTmpFolder);
+    snprintf(emptyFilename, sizeof(emptyFilename), "%s/testApi-mapped-file-empty.bin", testApiTmpFolder);
+    data = (xmlSecByte*)xmlMalloc(TEST_API_MAPPED_FILE_SIZE);
+    testApiCheck(data != NULL);
+    for(ii = 0; ii < TEST_API_MAPPED_FILE_SIZE; ++ii) {
+        data[ii] = (xmlSecByte)testApiBufferRand(&seed, 255);
+    }
+    testApiCheck(testApiMappedFileWrite(filename, data, TEST_API_MAPPED_FILE_SIZE) == 0);
+    testApiCheck(testApiMappedFileWrite(emptyFilename, data, 0) == 0);
+    buf = xmlSecBufferCreate(0);
+    testApiCheck(buf != NULL);
+    expected = xmlSecBufferCreate(0);
+    testApiCheck(expected != NULL);
+
+    /* the file is appended to the buffer */
+    testApiCheck(xmlSecBufferSetData(buf, BAD_CAST "prefix", 6) == 0);
+    testApiCheck(xmlSecBufferReadFile(buf, filename) == 0);
+    testApiCheck(xmlSecBufferGetSize(buf) == 6 + TEST_API_MAPPED_FILE_SIZE);
+    testApiCheck(memcmp(xmlSecBufferGetData(buf), "prefix", 6) == 0);
+    testApiCheck(memcmp(xmlSecBufferGetData(buf) + 6, data, TEST_API_MAPPED_FILE_SIZE) == 0);
+
+    /* the empty file is read without the mapping and the missing file fails */
+    testApiCheck(xmlSecBufferReadFile(buf, emptyFilename) == 0);
+    testApiCheck(xmlSecBufferGetSize(buf) == 6 + TEST_API_MAPPED_FILE_SIZE);
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(xmlSecBufferReadFile(buf, "testApi-mapped-file-missing.bin") < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+
+    /* the file uri is mapped */
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    initialized = 1;
+    transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, xmlSecTransformInputURIId);
+    testApiCheck(transform != NULL);
+    testApiCheck(xmlSecTransformInputURIOpen(transform, BAD_CAST filename) == 0);
+    testApiCheck(xmlSecTransformInputURIGetMappedData(transform, &mappedData, &mappedSize) == TEST_API_MAPPED_FILE_EXPECTED);
+    if(TEST_API_MAPPED_FILE_EXPECTED != 0) {
+        testApiCheck(mappedSize == TEST_API_MAPPED_FILE_SIZE);
+        testApiCheck(memcmp(mappedData, data, TEST_API_MAPPED_FILE_SIZE) == 0);
+
+        /* the mapped data is read once */
+        testApiCheck(xmlSecTransformInputURIGetMappedData(transform, &mappedData, &mappedSize) == 1);
+        testApiCheck(mappedSize == 0);
+    }
+    testApiCheck(xmlSecTransformInputURIClose(transform) == 0);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    initialized = 0;
+
+    /* the mapped file is pushed to the next transform */
+    testApiCheck(xmlSecBufferSetData(expected, data, TEST_API_MAPPED_FILE_SIZE) == 0);
+    testApiCheck(testApiMappedFileUriRead(filename, xmlSecTransformIdUnknown, expected) == 0);
+    testApiCheck(xmlSecBufferSetSize(expected, 0) == 0);
+    testApiCheck(testApiMappedFileUriRead(emptyFilename, xmlSecTransformIdUnknown, expected) == 0);
+#ifndef XMLSEC_NO_SHA256
+    testApiCheck(xmlSecTransformCtxInitialize(&transformCtx) == 0);
+    initialized = 1;
+    transform = xmlSecTransformCtxCreateAndAppend(&transformCtx, xmlSecTransformSha256Id);
+    testApiCheck(transform != NULL);
+    transform->operation = xmlSecTransformOperationSign;
+    testApiCheck(xmlSecTransformCtxBinaryExecute(&transformCtx, data, TEST_API_MAPPED_FILE_SIZE) == 0);
+    testApiCheck(transformCtx.result != NULL);
+    testApiCheck(xmlSecBufferSetData(expected, xmlSecBufferGetData(transformCtx.result),
+        xmlSecBufferGetSize(transformCtx.result)) == 0);
+    xmlSecTransformCtxFinalize(&transformCtx);
+    initialized = 0;
+    testApiCheck(testApiMappedFileUriRead(filename, xmlSecTransformSha256Id, expected) == 0);
+#endif /* XMLSEC_NO_SHA256 */
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(initialized != 0) {
+        xmlSecTransformCtxFinalize(&transformCtx);
+    }
+    (void)remove(filename);
+    (void)remove(emptyFilename);
+    if(expected != NULL) {
+        xmlSecBufferDestroy(expected);
+    }
+    if(buf != NULL) {
+        xmlSecBufferDestroy(buf);
+    }
+    if(data != NULL) {
+        xmlFree(data);
+    }
+    return(res);
+}
+
+/**************************************************************************
+ *
+ * Keys manager: resolved keys cache, shared keys, references and holder
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) || !defined(XMLSEC_NO_AES)
+
+#define TEST_API_KEY_NAME                       "test-key"
+
+/* creates the simple keys store with the "test-key" @dataId key of @sizeBits bits */
+static xmlSecKeyStorePtr
+testApiKeysStoreCreate(xmlSecKeyDataId dataId, xmlSecSize sizeBits) {
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key;
+
+    store = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    if(store == NULL) {
+        fprintf(stderr, "Error: unable to create the keys store\n");
+        return(NULL);
+    }
+    key = xmlSecKeyGenerate(dataId, sizeBits, xmlSecKeyDataTypeSymmetric);
+    if((key == NULL) || (xmlSecKeySetName(key, BAD_CAST TEST_API_KEY_NAME) < 0)) {
+        fprintf(stderr, "Error: unable to generate the key\n");
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        xmlSecKeyStoreDestroy(store);
+        return(NULL);
+    }
+    if(xmlSecSimpleKeysStoreAdoptKey(store, key) < 0) {
+        fprintf(stderr, "Error: unable to add the key to the keys store\n");
+        xmlSecKeyDestroy(key);
+        xmlSecKeyStoreDestroy(store);
+        return(NULL);
+    }
+    return(store);
+}
+
+/* creates the keys manager with the "test-key" @dataId key of @sizeBits bits */
+static xmlSecKeysMngrPtr
+testApiKeysMngrCreate(xmlSecKeyDataId dataId, xmlSecSize sizeBits) {
+    xmlSecKeysMngrPtr mngr;
+    xmlSecKeyStorePtr store;
+
+    mngr = xmlSecKeysMngrCreate();
+    if(mngr == NULL) {
+        fprintf(stderr, "Error: unable to create the keys manager\n");
+        return(NULL);
+    }
+    store = testApiKeysStoreCreate(dataId, sizeBits);
+    if(store == NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+        return(NULL);
+    }
+    if(xmlSecKeysMngrAdoptKeysStore(mngr, store) < 0) {
+        fprintf(stderr, "Error: unable to adopt the keys store\n");
+        xmlSecKeyStoreDestroy(store);
+        xmlSecKeysMngrDestroy(mngr);
+        return(NULL);
+    }
+    mngr->getKey = xmlSecKeysMngrGetKey;
+    return(mngr);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) || !defined(XMLSEC_NO_AES) */
+
+#ifndef XMLSEC_NO_HMAC
+
+/* the first two <dsig:KeyInfo/> nodes have the same exclusive c14n form */
+static const char testApiKeysDoc[] =
+    "<Document xmlns:dsig=\"http://www.w3.org/2000/09/xmldsig#\">"
+    "<dsig:KeyInfo><dsig:KeyName>" TEST_API_KEY_NAME "</dsig:KeyName></dsig:KeyInfo>"
+    "<dsig:KeyInfo xmlns:unused=\"urn:unused\"><dsig:KeyName>" TEST_API_KEY_NAME "</dsig:KeyName></dsig:KeyInfo>"
+    "<dsig:KeyInfo><dsig:KeyName>other-key</dsig:KeyName></dsig:KeyInfo>"
+    "</Document>";
+
+/* returns the key size in bits or 0 if there is no key */
+static xmlSecSize
+testApiKeySize(xmlSecKeyPtr key) {
+    if((key == NULL) || (xmlSecKeyGetValue(key) == NULL)) {
+        return(0);
+    }
+    return(xmlSecKeyDataGetSize(xmlSecKeyGetValue(key)));
+}
+
+/* resolves the key for the @index-th <dsig:KeyInfo/> node in @doc and returns
+ * the resolved keys cache hits and misses it caused */
+static xmlSecKeyPtr
+testApiKeysMngrGetKey(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, int index,
+                      xmlSecSize* hits, xmlSecSize* misses) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key = NULL;
+    xmlNodePtr cur;
+    xmlSecSize hits0, misses0;
+
+    cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    for(; (cur != NULL) && (index > 0); --index) {
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    if(cur == NULL) {
+        fprintf(stderr, "Error: the <dsig:KeyInfo/> node is not found\n");
+        return(NULL);
+    }
+
+    if(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) < 0) {
+        fprintf(stderr, "Error: xmlSecKeyInfoCtxInitialize failed\n");
+        return(NULL);
+    }
+    keyInfoCtx.mode = xmlSecKeyInfoModeRead;
+    keyInfoCtx.keyReq.keyId = xmlSecKeyDataHmacId;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeSymmetric;
+
+    hits0 = xmlSecMetricsGet(xmlSecMetricKeysCacheHits);
+    misses0 = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses);
+    key = xmlSecKeysMngrGetKey(cur, &keyInfoCtx);
+    (*hits) = xmlSecMetricsGet(xmlSecMetricKeysCacheHits) - hits0;
+    (*misses) = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses) - misses0;
+
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(key);
+}
+
+static int
+testApiKeysCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlDocPtr doc = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyStorePtr store = NULL;
+#ifndef XMLSEC_NO_X509
+    xmlSecKeyDataStorePtr dataStore = NULL;
+#endif /* XMLSEC_NO_X509 */
+    xmlSecKeyPtr key1 = NULL;
+    xmlSecKeyPtr key2 = NULL;
+    xmlSecKeyPtr key3 = NULL;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    xmlSecMetricsSetEnabled(1);
+    doc = xmlReadMemory(testApiKeysDoc, sizeof(testApiKeysDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecKeysMngrEnableKeyCache(mngr, 16, 0) == 0);
+
+    /* the first lookup reads the key, the second one returns the shared cached key */
+    key1 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key1) == 256);
+    testApiCheck((hits == 0) && (misses == 1));
+    key2 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key2) == 256);
+    testApiCheck((hits == 1) && (misses == 0));
+    testApiCheck(xmlSecKeyIsShared(key2) == 1);
+
+    /* the unused namespace declaration does not change the exclusive c14n form */
+    key3 = testApiKeysMngrGetKey(mngr, doc, 1, &hits, &misses);
+    testApiCheck(key3 == key2);
+    testApiCheck((hits == 1) && (misses == 0));
+    xmlSecKeyDestroy(key3);
+    key3 = NULL;
+
+    /* another <dsig:KeyInfo/> content is another cache item (the key
+     * is still found: the keys store is searched without the name) */
+    key3 = testApiKeysMngrGetKey(mngr, doc, 2, &hits, &misses);
+    testApiCheck(testApiKeySize(key3) == 256);
+    testApiCheck((hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key3);
+    key3 = testApiKeysMngrGetKey(mngr, doc, 2, &hits, &misses);
+    testApiCheck((key3 != NULL) && (key3 != key2));
+    testApiCheck((hits == 1) && (misses == 0));
+    xmlSecKeyDestroy(key3);
+    key3 = NULL;
+
+    /* explicit invalidation */
+    xmlSecKeysMngrInvalidateKeyCache(mngr);
+    key3 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key3) == 256);
+    testApiCheck((hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key3);
+    key3 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck((key3 != NULL) && (key3 != key2));
+    testApiCheck((hits == 1) && (misses == 0));
+    xmlSecKeyDestroy(key3);
+    key3 = NULL;
+
+    /* the new keys store has another "test-key": the cached key is dropped */
+    store = testApiKeysStoreCreate(xmlSecKeyDataHmacId, 512);
+    testApiCheck(store != NULL);
+    testApiCheck(xmlSecKeysMngrAdoptKeysStore(mngr, store) == 0);
+    store = NULL;
+    key3 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key3) == 512);
+    testApiCheck((hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key3);
+    key3 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key3) == 512);
+    testApiCheck((hits == 1) && (misses == 0));
+    xmlSecKeyDestroy(key3);
+    key3 = NULL;
+
+#ifndef XMLSEC_NO_X509
+    /* the new data store might verify the certificates differently */
+    dataStore = xmlSecKeyDataStoreCreate(xmlSecX509StoreId);
+    testApiCheck(dataStore != NULL);
+    testApiCheck(xmlSecKeysMngrAdoptDataStore(mngr, dataStore) == 0);
+    dataStore = NULL;
+    key3 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key3) == 512);
+    testApiCheck((hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key3);
+    key3 = NULL;
+#endif /* XMLSEC_NO_X509 */
+
+    /* the keys returned before are not affected */
+    testApiCheck(testApiKeySize(key1) == 256);
+    testApiCheck(testApiKeySize(key2) == 256);
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    if(key1 != NULL) {
+        xmlSecKeyDestroy(key1);
+    }
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    if(key3 != NULL) {
+        xmlSecKeyDestroy(key3);
+    }
+#ifndef XMLSEC_NO_X509
+    if(dataStore != NULL) {
+        xmlSecKeyDataStoreDestroy(dataStore);
+    }
+#endif /* XMLSEC_NO_X509 */
+    if(store != NULL) {
+        xmlSecKeyStoreDestroy(store);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiKeysCacheTtl(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlDocPtr doc = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    xmlSecMetricsSetEnabled(1);
+    doc = xmlReadMemory(testApiKeysDoc, sizeof(testApiKeysDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecKeysMngrEnableKeyCache(mngr, 16, 1) == 0);
+
+    key = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck((key != NULL) && (hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key);
+    key = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck((key != NULL) && (hits == 1) && (misses == 0));
+    xmlSecKeyDestroy(key);
+
+    /* the cached key expires after 1 second */
+    testApiSleep(2);
+    key = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck((key != NULL) && (hits == 0) && (misses == 1));
+    xmlSecKeyDestroy(key);
+    key = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck((key != NULL) && (hits == 1) && (misses == 0));
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiKeyShare(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeyPtr key = NULL;
+    xmlSecKeyPtr key2 = NULL;
+    xmlSecKeyReq keyReq;
+    int keyReqInitialized = 0;
+    int res = -1;
+
+    key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, 256, xmlSecKeyDataTypeSymmetric);
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecKeyIsShared(key) == 0);
+
+    testApiCheck(xmlSecKeyReqInitialize(&keyReq) == 0);
+    keyReqInitialized = 1;
+    keyReq.keyId       = xmlSecKeyDataHmacId;
+    keyReq.keyType     = xmlSecKeyDataTypeSymmetric;
+    keyReq.keyBitsSize = 256;
+    testApiCheck(xmlSecKeyReqMatchKey(&keyReq, key) == 1);
+    keyReq.keyBitsSize = 512;
+    testApiCheck(xmlSecKeyReqMatchKey(&keyReq, key) == 0);
+
+    /* the plain key is copied */
+    key2 = xmlSecKeyDuplicate(key);
+    testApiCheck((key2 != NULL) && (key2 != key));
+    testApiCheck(xmlSecKeyIsShared(key2) == 0);
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+
+    /* the shared key is returned with one more reference */
+    testApiCheck(xmlSecKeyShare(key) == 0);
+    testApiCheck(xmlSecKeyShare(key) == 0);
+    testApiCheck(xmlSecKeyIsShared(key) == 1);
+    key2 = xmlSecKeyDuplicate(key);
+    testApiCheck(key2 == key);
+
+    /* the shared key matches the requirements with the cached value type and size */
+    testApiCheck(xmlSecKeyGetType(key) == xmlSecKeyDataTypeSymmetric);
+    testApiCheck(xmlSecKeyReqMatchKey(&keyReq, key) == 0);
+    keyReq.keyBitsSize = 256;
+    testApiCheck(xmlSecKeyReqMatchKey(&keyReq, key) == 1);
+    keyReq.keyId = xmlSecKeyDataNameId;
+    testApiCheck(xmlSecKeyReqMatchKey(&keyReq, key) == 0);
+
+    /* the key is destroyed when the last reference is released */
+    xmlSecKeyDestroy(key);
+    key = NULL;
+    testApiCheck(testApiKeySize(key2) == 256);
+    res = 0;
+
+done:
+    if(keyReqInitialized) {
+        xmlSecKeyReqFinalize(&keyReq);
+    }
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    return(res);
+}
+
+static int
+testApiKeysMngrRef(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlDocPtr doc = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiKeysDoc, sizeof(testApiKeysDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+
+    /* the keys manager is destroyed when the last reference is released */
+    testApiCheck(xmlSecKeysMngrRef(mngr) == mngr);
+    testApiCheck(xmlSecKeysMngrRef(mngr) == mngr);
+    xmlSecKeysMngrDestroy(mngr);
+    xmlSecKeysMngrDestroy(mngr);
+    key = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key) == 256);
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiKeysMngrHolder(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlDocPtr doc = NULL;
+    xmlSecKeysMngrHolderPtr holder = NULL;
+    xmlSecKeysMngrPtr mngr1 = NULL;
+    xmlSecKeysMngrPtr mngr2 = NULL;
+    xmlSecKeysMngrPtr acquired1 = NULL;
+    xmlSecKeysMngrPtr acquired2 = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlSecSize generation1 = 0;
+    xmlSecSize generation2 = 0;
+    xmlSecSize generation3 = 0;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiKeysDoc, sizeof(testApiKeysDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    mngr1 = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr1 != NULL);
+    holder = xmlSecKeysMngrHolderCreate(mngr1);
+    testApiCheck(holder != NULL);
+    mngr1 = NULL;
+
+    acquired1 = xmlSecKeysMngrHolderAcquire(holder, &generation1);
+    testApiCheck(acquired1 != NULL);
+    testApiCheck(generation1 > 0);
+
+    /* the next generation is used by the operations started after the swap */
+    mngr2 = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 512);
+    testApiCheck(mngr2 != NULL);
+    generation2 = xmlSecKeysMngrHolderSwap(holder, mngr2);
+    testApiCheck(generation2 > generation1);
+    mngr2 = NULL;
+    acquired2 = xmlSecKeysMngrHolderAcquire(holder, &generation3);
+    testApiCheck((acquired2 != NULL) && (acquired2 != acquired1));
+    testApiCheck(generation3 == generation2);
+    key = testApiKeysMngrGetKey(acquired2, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key) == 512);
+    xmlSecKeyDestroy(key);
+
+    /* the operation in progress keeps using the previous generation */
+    key = testApiKeysMngrGetKey(acquired1, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key) == 256);
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(acquired1 != NULL) {
+        xmlSecKeysMngrDestroy(acquired1);
+    }
+    if(acquired2 != NULL) {
+        xmlSecKeysMngrDestroy(acquired2);
+    }
+    if(mngr1 != NULL) {
+        xmlSecKeysMngrDestroy(mngr1);
+    }
+    if(mngr2 != NULL) {
+        xmlSecKeysMngrDestroy(mngr2);
+    }
+    if(holder != NULL) {
+        xmlSecKeysMngrHolderDestroy(holder);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+/* generates the "test-key" HMAC key of @sizeBits bits */
+static xmlSecKeyPtr
+testApiKeysStoreGenerateKey(xmlSecSize sizeBits) {
+    xmlSecKeyPtr key;
+
+    key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, sizeBits, xmlSecKeyDataTypeSymmetric);
+    if((key == NULL) || (xmlSecKeySetName(key, BAD_CAST TEST_API_KEY_NAME) < 0)) {
+        fprintf(stderr, "Error: unable to generate the key\n");
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        return(NULL);
+    }
+    return(key);
+}
+
+#define TEST_API_KEYS_STORE_TASKS               4
+#define TEST_API_KEYS_STORE_REPLACES            50
+#define TEST_API_KEYS_STORE_LOOKUPS             200
+
+typedef struct _testApiKeysStoreTask {
+    xmlSecKeysMngrPtr           mngr;
+    xmlDocPtr                   doc;
+    int                         writer;
+    int                         failures;
+} testApiKeysStoreTask;
+
+/* the writer rotates the key, the readers check that they always get one */
+static void
+testApiKeysStoreTaskRun(void* data) {
+    testApiKeysStoreTask* task = (testApiKeysStoreTask*)data;
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key;
+    xmlSecSize hits, misses, size;
+    int ii;
+
+    store = xmlSecKeysMngrGetKeysStore(task->mngr);
+    if(task->writer != 0) {
+        for(ii = 0; ii < TEST_API_KEYS_STORE_REPLACES; ++ii) {
+            key = testApiKeysStoreGenerateKey(((ii % 2) == 0) ? 512 : 256);
+            if((key == NULL) || (xmlSecSimpleKeysStoreReplaceKey(store, key) < 0)) {
+                if(key != NULL) {
+                    xmlSecKeyDestroy(key);
+                }
+                ++task->failures;
+            }
+        }
+        return;
+    }
+    for(ii = 0; ii < TEST_API_KEYS_STORE_LOOKUPS; ++ii) {
+        key = testApiKeysMngrGetKey(task->mngr, task->doc, 0, &hits, &misses);
+        size = testApiKeySize(key);
+        if((size != 256) && (size != 512)) {
+            ++task->failures;
+        }
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+    }
+}
+
+static int
+testApiKeysStoreReplace(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlDocPtr doc = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key = NULL;
+    xmlSecKeyPtr key1 = NULL;
+    xmlSecKeyPtr key2 = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    int keyInfoCtxInitialized = 0;
+    testApiKeysStoreTask tasks[TEST_API_KEYS_STORE_TASKS];
+    void* tasksData[TEST_API_KEYS_STORE_TASKS];
+    xmlSecSize hits, misses, ii;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiKeysDoc, sizeof(testApiKeysDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    store = xmlSecKeysMngrGetKeysStore(mngr);
+    testApiCheck(store != NULL);
+
+    key1 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key1) == 256);
+
+    /* the rotated key replaces the old one, the old copy stays valid */
+    key = testApiKeysStoreGenerateKey(512);
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecSimpleKeysStoreReplaceKey(store, key) == 0);
+    key = NULL;
+    key2 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key2) == 512);
+    testApiCheck(testApiKeySize(key1) == 256);
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+
+    /* the shared key is replaced while a reference to it is in use */
+    key = testApiKeysStoreGenerateKey(256);
+    testApiCheck((key != NULL) && (xmlSecKeyShare(key) == 0));
+    testApiCheck(xmlSecSimpleKeysStoreReplaceKey(store, key) == 0);
+    key = NULL;
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) == 0);
+    keyInfoCtxInitialized = 1;
+    key2 = xmlSecKeyStoreFindKey(store, BAD_CAST TEST_API_KEY_NAME, &keyInfoCtx);
+    testApiCheck((key2 != NULL) && (xmlSecKeyIsShared(key2) == 1));
+    key = testApiKeysStoreGenerateKey(512);
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecSimpleKeysStoreReplaceKey(store, key) == 0);
+    key = NULL;
+    testApiCheck(testApiKeySize(key2) == 256);
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+
+    /* the removed key is not found anymore */
+    testApiCheck(xmlSecSimpleKeysStoreRemoveKeys(store, BAD_CAST TEST_API_KEY_NAME) == 1);
+    testApiCheck(xmlSecSimpleKeysStoreRemoveKeys(store, BAD_CAST TEST_API_KEY_NAME) == 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    key2 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    testApiCheck(key2 == NULL);
+
+    /* the key is rotated while the other threads look it up */
+    key = testApiKeysStoreGenerateKey(256);
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecSimpleKeysStoreReplaceKey(store, key) == 0);
+    key = NULL;
+    memset(tasks, 0, sizeof(tasks));
+    for(ii = 0; ii < TEST_API_KEYS_STORE_TASKS; ++ii) {
+        tasks[ii].mngr = mngr;
+        tasks[ii].doc = doc;
+        tasks[ii].writer = (ii == 0) ? 1 : 0;
+        tasksData[ii] = &(tasks[ii]);
+    }
+    xmlSecExecutorSetCallback(NULL, TEST_API_KEYS_STORE_TASKS, NULL);
+    testApiCheck(xmlSecExecutorRun(testApiKeysStoreTaskRun, tasksData, TEST_API_KEYS_STORE_TASKS) == 0);
+    for(ii = 0; ii < TEST_API_KEYS_STORE_TASKS; ++ii) {
+        testApiCheck(tasks[ii].failures == 0);
+    }
+    key2 = testApiKeysMngrGetKey(mngr, doc, 0, &hits, &misses);
+    testApiCheck(testApiKeySize(key2) == 256);
+    res = 0;
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    if(keyInfoCtxInitialized) {
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    }
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(key1 != NULL) {
+        xmlSecKeyDestroy(key1);
+    }
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+
+#define TEST_API_KEYS_INDEX_NAMES               100
+#define TEST_API_KEYS_INDEX_SIZE                (3 * TEST_API_KEYS_INDEX_NAMES)
+
+/* returns 1 if @key1 and @key2 are both NULL or have the same value or 0 otherwise */
+static int
+testApiKeysIndexSameKey(xmlSecKeyPtr key1, xmlSecKeyPtr key2) {
+    xmlSecBufferPtr buf1, buf2;
+
+    if((key1 == NULL) || (key2 == NULL)) {
+        return((key1 == key2) ? 1 : 0);
+    }
+    buf1 = xmlSecKeyDataBinaryValueGetBuffer(xmlSecKeyGetValue(key1));
+    buf2 = xmlSecKeyDataBinaryValueGetBuffer(xmlSecKeyGetValue(key2));
+    if((buf1 == NULL) || (buf2 == NULL) || (xmlSecBufferGetSize(buf1) != xmlSecBufferGetSize(buf2))) {
+        return(0);
+    }
+    return((memcmp(xmlSecBufferGetData(buf1), xmlSecBufferGetData(buf2), xmlSecBufferGetSize(buf1)) == 0) ? 1 : 0);
+}
+
+/* checks that the @store lookups return the first matching key from the
+ * @keys copies (the linear search) for all the names and key sizes */
+static int
+testApiKeysIndexCheck(xmlSecKeyStorePtr store, xmlSecKeyInfoCtxPtr keyInfoCtx,
+                      xmlSecKeyPtr* keys, xmlSecSize keysSize) {
+    static const xmlSecSize sizes[] = { 0, 128, 192, 256 };
+    char name[32];
+    const xmlChar* lookupName;
+    xmlSecKeyPtr expected;
+    xmlSecKeyPtr key;
+    xmlSecSize ii, jj, kk;
+    int res;
+
+    for(ii = 0; ii <= TEST_API_KEYS_INDEX_NAMES + 1; ++ii) {
+        if(ii < TEST_API_KEYS_INDEX_NAMES) {
+            snprintf(name, sizeof(name), "key-%d", (int)ii);
+            lookupName = BAD_CAST name;
+        } else if(ii == TEST_API_KEYS_INDEX_NAMES) {
+            lookupName = BAD_CAST "key-unknown";
+        } else {
+            lookupName = NULL;
+        }
+        for(jj = 0; jj < sizeof(sizes) / sizeof(sizes[0]); ++jj) {
+            keyInfoCtx->keyReq.keyBitsSize = sizes[jj];
+
+            expected = NULL;
+            for(kk = 0; (kk < keysSize) && (expected == NULL); ++kk) {
+                if((keys[kk] != NULL) && (xmlSecKeyMatch(keys[kk], lookupName, &(keyInfoCtx->keyReq)) == 1)) {
+                    expected = keys[kk];
+                }
+            }
+
+            key = xmlSecKeyStoreFindKey(store, lookupName, keyInfoCtx);
+            res = testApiKeysIndexSameKey(key, expected);
+            if(key != NULL) {
+                xmlSecKeyDestroy(key);
+            }
+            if(res != 1) {
+                fprintf(stderr, "Error: wrong key for name=%s, size=%d\n",
+                        (lookupName != NULL) ? (const char*)lookupName : "NULL",
+                        (int)sizes[jj]);
+                keyInfoCtx->keyReq.keyBitsSize = 0;
+                return(0);
+            }
+        }
+    }
+    keyInfoCtx->keyReq.keyBitsSize = 0;
+    return(1);
+}
+
+/* generates the HMAC key of @sizeBits bits named @name (if not NULL), adds
+ * it to @store (directly to the keys list if @direct is not 0) and saves
+ * its copy to @copy */
+static int
+testApiKeysIndexAdd(xmlSecKeyStorePtr store, const char* name, xmlSecSize sizeBits,
+                    int direct, xmlSecKeyPtr* copy) {
+    xmlSecKeyPtr key;
+    int ret;
+
+    key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, sizeBits, xmlSecKeyDataTypeSymmetric);
+    if((key == NULL) || ((name != NULL) && (xmlSecKeySetName(key, BAD_CAST name) < 0))) {
+        fprintf(stderr, "Error: unable to generate the key\n");
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        return(-1);
+    }
+    (*copy) = xmlSecKeyDuplicate(key);
+    if((*copy) == NULL) {
+        fprintf(stderr, "Error: unable to duplicate the key\n");
+        xmlSecKeyDestroy(key);
+        return(-1);
+    }
+    if(direct != 0) {
+        ret = xmlSecPtrListAdd(xmlSecSimpleKeysStoreGetKeys(store), key);
+    } else {
+        ret = xmlSecSimpleKeysStoreAdoptKey(store, key);
+    }
+    if(ret < 0) {
+        fprintf(stderr, "Error: unable to add the key to the keys store\n");
+        xmlSecKeyDestroy(key);
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+testApiKeysStoreIndex(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeyStorePtr store = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    int keyInfoCtxInitialized = 0;
+    xmlSecKeyPtr keys[TEST_API_KEYS_INDEX_SIZE + 2];
+    xmlSecKeyPtr key = NULL;
+    xmlSecSize keysSize = 0;
+    char name[32];
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(keys, 0, sizeof(keys));
+    mngr = xmlSecKeysMngrCreate();
+    testApiCheck(mngr != NULL);
+    store = xmlSecKeyStoreCreate(xmlSecSimpleKeysStoreId);
+    testApiCheck(store != NULL);
+    testApiCheck(xmlSecKeysMngrAdoptKeysStore(mngr, store) == 0);
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) == 0);
+    keyInfoCtxInitialized = 1;
+    keyInfoCtx.keyReq.keyId = xmlSecKeyDataHmacId;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeSymmetric;
+
+    /* each name has keys of 64, 128 and 192 bits, a few keys have no name */
+    for(ii = 0; ii < TEST_API_KEYS_INDEX_SIZE; ++ii) {
+        snprintf(name, sizeof(name), "key-%d", (int)(ii % TEST_API_KEYS_INDEX_NAMES));
+        testApiCheck(testApiKeysIndexAdd(store, ((ii % 37) != 5) ? name : NULL,
+            64 * (1 + ii / TEST_API_KEYS_INDEX_NAMES), 0, &(keys[keysSize])) == 0);
+        ++keysSize;
+    }
+    testApiCheck(testApiKeysIndexCheck(store, &keyInfoCtx, keys, keysSize) == 1);
+
+    /* the keys added directly to the list are indexed on lookup */
+    testApiCheck(testApiKeysIndexAdd(store, "key-3", 256, 1, &(keys[keysSize])) == 0);
+    ++keysSize;
+    testApiCheck(testApiKeysIndexCheck(store, &keyInfoCtx, keys, keysSize) == 1);
+
+    /* the removed keys leave the index */
+    testApiCheck(xmlSecSimpleKeysStoreRemoveKeys(store, BAD_CAST "key-7") == 3);
+    for(ii = 0; ii < keysSize; ++ii) {
+        if((keys[ii] != NULL) && xmlStrEqual(xmlSecKeyGetName(keys[ii]), BAD_CAST "key-7")) {
+            xmlSecKeyDestroy(keys[ii]);
+            keys[ii] = NULL;
+        }
+    }
+    testApiCheck(testApiKeysIndexCheck(store, &keyInfoCtx, keys, keysSize) == 1);
+
+    /* the replaced key takes the place of the first key with the same name */
+    key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, 256, xmlSecKeyDataTypeSymmetric);
+    testApiCheck((key != NULL) && (xmlSecKeySetName(key, BAD_CAST "key-11") == 0));
+    for(ii = 0; ii < keysSize; ++ii) {
+        if((keys[ii] != NULL) && xmlStrEqual(xmlSecKeyGetName(keys[ii]), BAD_CAST "key-11")) {
+            xmlSecKeyDestroy(keys[ii]);
+            keys[ii] = NULL;
+            if(key != NULL) {
+                keys[ii] = xmlSecKeyDuplicate(key);
+                testApiCheck(keys[ii] != NULL);
+                testApiCheck(xmlSecSimpleKeysStoreReplaceKey(store, key) == 0);
+                key = NULL;
+            }
+        }
+    }
+    testApiCheck(key == NULL);
+    testApiCheck(testApiKeysIndexCheck(store, &keyInfoCtx, keys, keysSize) == 1);
+
+    /* the new name after the changes */
+    testApiCheck(testApiKeysIndexAdd(store, "key-7", 128, 0, &(keys[keysSize])) == 0);
+    ++keysSize;
+    testApiCheck(testApiKeysIndexCheck(store, &keyInfoCtx, keys, keysSize) == 1);
+    res = 0;
+
+done:
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    for(ii = 0; ii < keysSize; ++ii) {
+        if(keys[ii] != NULL) {
+            xmlSecKeyDestroy(keys[ii]);
+        }
+    }
+    if(keyInfoCtxInitialized) {
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* XMLSEC_NO_HMAC */
+
+static int
+testApiKeysCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeysCacheTtl(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeyShare(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeysMngrRef(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeysMngrHolder(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeysStoreReplace(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+static int
+testApiKeysStoreIndex(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC support is disabled\n");
+    return(0);
+}
+
+#endif /* XMLSEC_NO_HMAC */
+
+/**************************************************************************
+ *
+ * Keys manager: unwrapped keys cache
+ *
+ *************************************************************************/
+#ifndef XMLSEC_NO_AES
+
+static const char testApiEncKeysData[] = "some secret data";
+
+/* encrypts the test data with a new session key wrapped with the "test-key"
+ * from @mngr and returns the <enc:EncryptedData/> document */
+static xmlChar*
+testApiEncKeysEncrypt(xmlSecKeysMngrPtr mngr) {
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr encDataNode;
+    xmlNodePtr encKeyNode;
+    xmlNodePtr keyInfoNode;
+    xmlChar* res = NULL;
+    int size = 0;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc != NULL);
+    encDataNode = xmlSecTmplEncDataCreate(doc, xmlSecTransformAes128CbcId, NULL, NULL, NULL, NULL);
+    testApiCheck(encDataNode != NULL);
+    xmlDocSetRootElement(doc, encDataNode);
+    testApiCheck(xmlSecTmplEncDataEnsureCipherValue(encDataNode) != NULL);
+    keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(encDataNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    encKeyNode = xmlSecTmplKeyInfoAddEncryptedKey(keyInfoNode, xmlSecTransformKWAes128Id, NULL, NULL, NULL);
+    testApiCheck(encKeyNode != NULL);
+    testApiCheck(xmlSecTmplEncDataEnsureCipherValue(encKeyNode) != NULL);
+    keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(encKeyNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+    encCtx->encKey = xmlSecKeyGenerate(xmlSecKeyDataAesId, 128, xmlSecKeyDataTypeSession);
+    testApiCheck(encCtx->encKey != NULL);
+    testApiCheck(xmlSecEncCtxBinaryEncrypt(encCtx, encDataNode, (const xmlSecByte*)testApiEncKeysData,
+        sizeof(testApiEncKeysData) - 1) == 0);
+    xmlDocDumpMemory(doc, &res, &size);
+    testApiCheck(res != NULL);
+
+done:
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+/* decrypts the <enc:EncryptedData/> document @xml with the keys from @mngr and
+ * returns 1 if the test data is decrypted, 0 if the decryption fails or a negative
+ * value if an error occurs; @hits and @misses are the keys cache hits and misses */
+static int
+testApiEncKeysDecrypt(xmlSecKeysMngrPtr mngr, const xmlChar* xml, xmlSecSize* hits, xmlSecSize* misses) {
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlSecBufferPtr result;
+    xmlSecSize hits0, misses0;
+    int res = -1;
+
+    doc = xmlReadMemory((const char*)xml, xmlStrlen(xml), NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+
+    hits0 = xmlSecMetricsGet(xmlSecMetricKeysCacheHits);
+    misses0 = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses);
+    /* the failures are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    result = xmlSecEncCtxDecryptToBuffer(encCtx, xmlDocGetRootElement(doc));
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    (*hits) = xmlSecMetricsGet(xmlSecMetricKeysCacheHits) - hits0;
+    (*misses) = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses) - misses0;
+
+    if(result == NULL) {
+        res = 0;
+        goto done;
+    }
+    testApiCheck(xmlSecBufferGetSize(result) == sizeof(testApiEncKeysData) - 1);
+    testApiCheck(memcmp(xmlSecBufferGetData(result), testApiEncKeysData, sizeof(testApiEncKeysData) - 1) == 0);
+    res = 1;
+
+done:
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiEncKeysCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlChar* xml1 = NULL;
+    xmlChar* xml2 = NULL;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    xmlSecMetricsSetEnabled(1);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataAesId, 128);
+    testApiCheck(mngr != NULL);
+    xml1 = testApiEncKeysEncrypt(mngr);
+    testApiCheck(xml1 != NULL);
+    xml2 = testApiEncKeysEncrypt(mngr);
+    testApiCheck(xml2 != NULL);
+    testApiCheck(xmlSecKeysMngrEnableEncryptedKeyCache(mngr, 16, 0) == 0);
+
+    /* the first decryption unwraps the session key, the second one uses the cache */
+    testApiCheck(testApiEncKeysDecrypt(mngr, xml1, &hits, &misses) == 1);
+    testApiCheck((hits == 0) && (misses == 1));
+    testApiCheck(testApiEncKeysDecrypt(mngr, xml1, &hits, &misses) == 1);
+    testApiCheck((hits == 1) && (misses == 0));
+
+    /* without the key encryption key, only the cached session key is available */
+    xmlSecPtrListEmpty(xmlSecSimpleKeysStoreGetKeys(xmlSecKeysMngrGetKeysStore(mngr)));
+    testApiCheck(testApiEncKeysDecrypt(mngr, xml1, &hits, &misses) == 1);
+    testApiCheck((hits == 1) && (misses == 0));
+    testApiCheck(testApiEncKeysDecrypt(mngr, xml2, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+
+    /* the session key is dropped from the cache */
+    xmlSecKeysMngrInvalidateKeyCache(mngr);
+    testApiCheck(testApiEncKeysDecrypt(mngr, xml1, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    if(xml1 != NULL) {
+        xmlFree(xml1);
+    }
+    if(xml2 != NULL) {
+        xmlFree(xml2);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* XMLSEC_NO_AES */
+
+static int
+testApiEncKeysCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: AES support is disabled\n");
+    return(0);
+}
+
+#endif /* XMLSEC_NO_AES */
+
+/**************************************************************************
+ *
+ * Streaming encryption to the output buffer
+ *
+ *************************************************************************/
+#ifndef XMLSEC_NO_AES
+
+#define TEST_API_STREAM_DATA_SIZE               (256 * 1024)
+
+/* the encrypted data is never collected in memory: the chunks are small and
+ * the transforms buffers stay well below the data size */
+#define TEST_API_STREAM_CHUNK_MAX_SIZE          4096
+#define TEST_API_STREAM_MAX_MEM_SIZE            (TEST_API_STREAM_DATA_SIZE / 4)
+
+static int
+testApiStreamOutputWrite(void* context, const char* buffer, int len) {
+    xmlSecBufferPtr output = (xmlSecBufferPtr)context;
+
+    if((len < 0) || (xmlSecBufferAppend(output, (const xmlSecByte*)buffer, (xmlSecSize)len) < 0)) {
+        return(-1);
+    }
+    return(len);
+}
+
+/* creates the <enc:EncryptedData/> template for the "test-key" */
+static xmlNodePtr
+testApiStreamTmplCreate(xmlDocPtr* doc) {
+    xmlNodePtr encDataNode;
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr res = NULL;
+
+    (*doc) = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck((*doc) != NULL);
+    encDataNode = xmlSecTmplEncDataCreate((*doc), xmlSecTransformAes128CbcId, NULL, NULL, NULL, NULL);
+    testApiCheck(encDataNode != NULL);
+    xmlDocSetRootElement((*doc), encDataNode);
+    testApiCheck(xmlSecTmplEncDataEnsureCipherValue(encDataNode) != NULL);
+    keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(encDataNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+    res = encDataNode;
+
+done:
+    return(res);
+}
+
+/* encrypts @data (or the @uri content if @uri is not NULL) to the @output
+ * buffer with the transforms memory limit and checks that the result is
+ * decrypted to @data, returns 0 on success */
+static int
+testApiStreamEncrypt(xmlSecKeysMngrPtr mngr, const xmlSecByte* data, xmlSecSize dataSize,
+                     const char* uri, xmlSecBufferPtr output) {
+    xmlOutputBufferPtr out = NULL;
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlDocPtr encDoc = NULL;
+    xmlNodePtr tmpl;
+    xmlChar* cipherValue = NULL;
+    xmlSecBufferPtr result;
+    int ret;
+    int res = -1;
+
+    testApiCheck(xmlSecBufferSetSize(output, 0) == 0);
+    tmpl = testApiStreamTmplCreate(&doc);
+    testApiCheck(tmpl != NULL);
+    out = xmlOutputBufferCreateIO(testApiStreamOutputWrite, NULL, output, NULL);
+    testApiCheck(out != NULL);
+
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+    testApiCheck(xmlSecTransformCtxSetBinaryChunkMaxSize(&(encCtx->transformCtx), TEST_API_STREAM_CHUNK_MAX_SIZE) == 0);
+    testApiCheck(xmlSecTransformCtxSetMaxMemSize(&(encCtx->transformCtx), TEST_API_STREAM_MAX_MEM_SIZE) == 0);
+    if(uri == NULL) {
+        ret = xmlSecEncCtxBinaryEncryptToOutput(encCtx, tmpl, data, dataSize, out);
+    } else {
+        ret = xmlSecEncCtxUriEncryptToOutput(encCtx, tmpl, BAD_CAST uri, out);
+    }
+    testApiCheck(ret == 0);
+    testApiCheck(xmlOutputBufferClose(out) >= 0);
+    out = NULL;
+    xmlSecEncCtxDestroy(encCtx);
+    encCtx = NULL;
+
+    /* the encrypted data is not set in the template */
+    cipherValue = xmlNodeGetContent(xmlSecFindNode(tmpl, xmlSecNodeCipherValue, xmlSecEncNs));
+    testApiCheck((cipherValue == NULL) || (cipherValue[0] == '\0'));
+
+    encDoc = xmlReadMemory((const char*)xmlSecBufferGetData(output),
+        (int)xmlSecBufferGetSize(output), NULL, NULL, 0);
+    testApiCheck(encDoc != NULL);
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+    result = xmlSecEncCtxDecryptToBuffer(encCtx, xmlDocGetRootElement(encDoc));
+    testApiCheck(result != NULL);
+    testApiCheck(xmlSecBufferGetSize(result) == dataSize);
+    testApiCheck((dataSize == 0) || (memcmp(xmlSecBufferGetData(result), data, dataSize) == 0));
+    res = 0;
+
+done:
+    if(cipherValue != NULL) {
+        xmlFree(cipherValue);
+    }
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(out != NULL) {
+        xmlOutputBufferClose(out);
+    }
+    if(encDoc != NULL) {
+        xmlFreeDoc(encDoc);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiEncToOutput(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecBufferPtr output = NULL;
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlOutputBufferPtr out = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr tmpl;
+    xmlSecByte* data = NULL;
+    char filename[1024];
+    unsigned long seed = 1;
+    FILE* f = NULL;
+    xmlSecSize ii;
+    int res = -1;
+
+    snprintf(filename, sizeof(filename), "%s/testApi-enc-to-output.bin", testApiTmpFolder);
+    output = xmlSecBufferCreate(0);
+    testApiCheck(output != NULL);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataAesId, 128);
+    testApiCheck(mngr != NULL);
+    data = (xmlSecByte*)xmlMalloc(TEST_API_STREAM_DATA_SIZE);
+    testApiCheck(data != NULL);
+    for(ii = 0; ii < TEST_API_STREAM_DATA_SIZE; ++ii) {
+        data[ii] = (xmlSecByte)testApiBufferRand(&seed, 255);
+    }
+
+    /* the encrypted data is written in chunks */
+    testApiCheck(testApiStreamEncrypt(mngr, data, TEST_API_STREAM_DATA_SIZE, NULL, output) == 0);
+
+    /* the short and the empty data */
+    testApiCheck(testApiStreamEncrypt(mngr, data, 5, NULL, output) == 0);
+    testApiCheck(testApiStreamEncrypt(mngr, data, 0, NULL, output) == 0);
+
+    /* the data from the URI */
+    f = fopen(filename, "wb");
+    testApiCheck(f != NULL);
+    testApiCheck(fwrite(data, 1, TEST_API_STREAM_DATA_SIZE, f) == TEST_API_STREAM_DATA_SIZE);
+    testApiCheck(fclose(f) == 0);
+    f = NULL;
+    testApiCheck(testApiStreamEncrypt(mngr, data, TEST_API_STREAM_DATA_SIZE, filename, output) == 0);
+
+    /* the references into the template document are not supported */
+    tmpl = testApiStreamTmplCreate(&doc);
+    testApiCheck(tmpl != NULL);
+    out = xmlOutputBufferCreateIO(testApiStreamOutputWrite, NULL, output, NULL);
+    testApiCheck(out != NULL);
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(xmlSecEncCtxUriEncryptToOutput(encCtx, tmpl, BAD_CAST "#xpointer(/)", out) < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(f != NULL) {
+        fclose(f);
+    }
+    (void)remove(filename);
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(out != NULL) {
+        xmlOutputBufferClose(out);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(data != NULL) {
+        xmlFree(data);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(output != NULL) {
+        xmlSecBufferDestroy(output);
+    }
+    return(res);
+}
+
+#else  /* XMLSEC_NO_AES */
+
+static int
+testApiEncToOutput(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: AES support is disabled\n");
+    return(0);
+}
+
+#endif /* XMLSEC_NO_AES */
+
+/**************************************************************************
+ *
+ * Parallel encryption and decryption
+ *
+ *************************************************************************/
+#ifndef XMLSEC_NO_AES
+
+#define TEST_API_ENC_PARTS_NUMBER               8
+#define TEST_API_ENC_PARALLEL_THREADS           4
+#define TEST_API_ENC_OTHER_KEY_NAME             "other-key"
+
+/* 20 bytes: not a whole number of the AES blocks */
+#define TEST_API_ENC_BOGUS_CIPHER_VALUE         "AAAAAAAAAAAAAAAAAAAAAAAAAAA="
+
+static const xmlChar* testApiEncIds[] = { BAD_CAST "Id", NULL };
+
+/* returns the document dump or NULL if an error occurs */
+static xmlChar*
+testApiEncPartsDump(xmlDocPtr doc) {
+    xmlChar* res = NULL;
+    int size = 0;
+
+    xmlDocDumpMemory(doc, &res, &size);
+    return(res);
+}
+
+/* creates the document with TEST_API_ENC_PARTS_NUMBER <Part/> nodes, @xml
+ * is set to the document dump */
+static xmlDocPtr
+testApiEncPartsCreate(xmlChar** xml) {
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root;
+    char buf[64];
+    xmlSecSize ii;
+    int res = -1;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc != NULL);
+    root = xmlNewDocNode(doc, NULL, BAD_CAST "Document", NULL);
+    testApiCheck(root != NULL);
+    xmlDocSetRootElement(doc, root);
+    for(ii = 0; ii < TEST_API_ENC_PARTS_NUMBER; ++ii) {
+        snprintf(buf, sizeof(buf), "part %u", (unsigned int)ii);
+        testApiCheck(xmlNewChild(root, NULL, BAD_CAST "Part", BAD_CAST buf) != NULL);
+    }
+    (*xml) = testApiEncPartsDump(doc);
+    testApiCheck((*xml) != NULL);
+    res = 0;
+
+done:
+    if((res < 0) && (doc != NULL)) {
+        xmlFreeDoc(doc);
+        doc = NULL;
+    }
+    return(doc);
+}
+
+/* returns the <Part/> children of the @doc root node */
+static xmlSecSize
+testApiEncPartsGetParts(xmlDocPtr doc, xmlNodePtr* nodes, xmlSecSize nodesSize) {
+    xmlNodePtr cur;
+    xmlSecSize res = 0;
+
+    cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    for(; cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, BAD_CAST "Part", NULL) && (res < nodesSize)) {
+            nodes[res++] = cur;
+        }
+    }
+    return(res);
+}
+
+/* encrypts every <Part/> node in @doc with its own template: the odd parts
+ * are encrypted with the @oddKeyName key */
+static int
+testApiEncPartsEncrypt(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, const char* oddKeyName) {
+    xmlNodePtr parts[TEST_API_ENC_PARTS_NUMBER];
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlNodePtr encDataNode;
+    xmlNodePtr keyInfoNode;
+    xmlSecSize ii;
+    int ret;
+    int res = -1;
+
+    testApiCheck(testApiEncPartsGetParts(doc, parts, TEST_API_ENC_PARTS_NUMBER) == TEST_API_ENC_PARTS_NUMBER);
+    for(ii = 0; ii < TEST_API_ENC_PARTS_NUMBER; ++ii) {
+        encDataNode = xmlSecTmplEncDataCreate(doc, xmlSecTransformAes128CbcId, NULL, xmlSecTypeEncElement, NULL, NULL);
+        testApiCheck(encDataNode != NULL);
+        testApiCheck(xmlSecTmplEncDataEnsureCipherValue(encDataNode) != NULL);
+        keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(encDataNode, NULL);
+        testApiCheck(keyInfoNode != NULL);
+        testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode,
+            BAD_CAST (((ii % 2) == 0) ? TEST_API_KEY_NAME : oddKeyName)) != NULL);
+
+        encCtx = xmlSecEncCtxCreate(mngr);
+        testApiCheck(encCtx != NULL);
+        ret = xmlSecEncCtxXmlEncrypt(encCtx, encDataNode, parts[ii]);
+        if(ret < 0) {
+            xmlFreeNode(encDataNode);
+        }
+        testApiCheck(ret == 0);
+        xmlSecEncCtxDestroy(encCtx);
+        encCtx = NULL;
+    }
+    res = 0;
+
+done:
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    return(res);
+}
+
+/* returns the <enc:EncryptedData/> children of the @doc root node */
+static xmlSecSize
+testApiEncPartsGetNodes(xmlDocPtr doc, xmlNodePtr* nodes, xmlSecSize nodesSize) {
+    xmlNodePtr cur;
+    xmlSecSize res = 0;
+
+    cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    for(; cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeEncryptedData, xmlSecEncNs) && (res < nodesSize)) {
+            nodes[res++] = cur;
+        }
+    }
+    return(res);
+}
+
+/* decrypts a copy of @doc one node at a time (@parallel is 0) or on the
+ * worker threads with the @encKey (if not NULL) and returns the decrypted
+ * document dump or NULL if an error occurs, @decrypted is set to the
+ * number of the decrypted nodes */
+static xmlChar*
+testApiEncPartsDecrypt(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, int parallel,
+                       xmlSecKeyPtr encKey, xmlSecSize* decrypted) {
+    xmlNodePtr nodes[TEST_API_ENC_PARTS_NUMBER];
+    int results[TEST_API_ENC_PARTS_NUMBER];
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlDocPtr decDoc = NULL;
+    xmlSecSize nodesSize;
+    xmlSecSize ii;
+    xmlChar* res = NULL;
+
+    (*decrypted) = 0;
+    decDoc = xmlCopyDoc(doc, 1);
+    testApiCheck(decDoc != NULL);
+    nodesSize = testApiEncPartsGetNodes(decDoc, nodes, TEST_API_ENC_PARTS_NUMBER);
+    testApiCheck(nodesSize == TEST_API_ENC_PARTS_NUMBER);
+
+    xmlSecAddIDs(decDoc, NULL, testApiEncIds);
+
+    /* the failures are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    for(ii = 0; ii < nodesSize; ii += (parallel != 0) ? nodesSize : 1) {
+        encCtx = xmlSecEncCtxCreate(mngr);
+        testApiCheck(encCtx != NULL);
+        if(encKey != NULL) {
+            encCtx->encKey = xmlSecKeyDuplicate(encKey);
+            testApiCheck(encCtx->encKey != NULL);
+        }
+        if(parallel != 0) {
+            xmlSecExecutorSetCallback(NULL, TEST_API_ENC_PARALLEL_THREADS, NULL);
+            testApiCheck(xmlSecEncCtxDecryptParallel(encCtx, nodes, nodesSize, results) == 0);
+        } else {
+            /* the last node first: the first node may have the <enc:EncryptedKey/>
+             * for the others */
+            results[nodesSize - ii - 1] = xmlSecEncCtxDecrypt(encCtx, nodes[nodesSize - ii - 1]);
+        }
+        xmlSecEncCtxDestroy(encCtx);
+        encCtx = NULL;
+    }
+    for(ii = 0; ii < nodesSize; ++ii) {
+        if(results[ii] == 0) {
+            ++(*decrypted);
+        }
+    }
+    res = testApiEncPartsDump(decDoc);
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(decDoc != NULL) {
+        xmlFreeDoc(decDoc);
+    }
+    return(res);
+}
+
+/* decrypts @doc one node at a time and on the worker threads and checks that
+ * both results are the same as @expected (if not NULL) and the
+ * @expectedDecrypted nodes are decrypted */
+static int
+testApiEncPartsCheck(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, xmlSecKeyPtr encKey,
+                     const xmlChar* expected, xmlSecSize expectedDecrypted) {
+    xmlChar* xml = NULL;
+    xmlChar* parallelXml = NULL;
+    xmlSecSize decrypted = 0;
+    xmlSecSize parallelDecrypted = 0;
+    int res = -1;
+
+    xml = testApiEncPartsDecrypt(mngr, doc, 0, encKey, &decrypted);
+    testApiCheck(xml != NULL);
+    testApiCheck(decrypted == expectedDecrypted);
+    testApiCheck((expected == NULL) || xmlStrEqual(xml, expected));
+
+    parallelXml = testApiEncPartsDecrypt(mngr, doc, 1, encKey, &parallelDecrypted);
+    testApiCheck(parallelXml != NULL);
+    testApiCheck(parallelDecrypted == expectedDecrypted);
+    testApiCheck(xmlStrEqual(parallelXml, xml));
+    res = 0;
+
+done:
+    if(parallelXml != NULL) {
+        xmlFree(parallelXml);
+    }
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    return(res);
+}
+
+static int
+testApiEncDecryptParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyPtr key = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlNodePtr nodes[TEST_API_ENC_PARTS_NUMBER];
+    xmlNodePtr cipherValueNode;
+    xmlDocPtr doc = NULL;
+    xmlChar* xml = NULL;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataAesId, 128);
+    testApiCheck(mngr != NULL);
+    key = xmlSecKeyGenerate(xmlSecKeyDataAesId, 128, xmlSecKeyDataTypeSymmetric);
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecKeySetName(key, BAD_CAST TEST_API_ENC_OTHER_KEY_NAME) == 0);
+    testApiCheck(xmlSecSimpleKeysStoreAdoptKey(xmlSecKeysMngrGetKeysStore(mngr), key) == 0);
+    key = NULL;
+
+    /* the keys are resolved for each <dsig:KeyInfo/> content */
+    doc = testApiEncPartsCreate(&xml);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiEncPartsEncrypt(mngr, doc, TEST_API_ENC_OTHER_KEY_NAME) == 0);
+    testApiCheck(testApiEncPartsCheck(mngr, doc, NULL, xml, TEST_API_ENC_PARTS_NUMBER) == 0);
+
+    /* only the corrupted node is not decrypted */
+    testApiCheck(testApiEncPartsGetNodes(doc, nodes, TEST_API_ENC_PARTS_NUMBER) == TEST_API_ENC_PARTS_NUMBER);
+    cipherValueNode = xmlSecFindNode(nodes[TEST_API_ENC_PARTS_NUMBER / 2 + 1], xmlSecNodeCipherValue, xmlSecEncNs);
+    testApiCheck(cipherValueNode != NULL);
+    xmlNodeSetContent(cipherValueNode, BAD_CAST TEST_API_ENC_BOGUS_CIPHER_VALUE);
+    testApiCheck(testApiEncPartsCheck(mngr, doc, NULL, NULL, TEST_API_ENC_PARTS_NUMBER - 1) == 0);
+    xmlFreeDoc(doc);
+    doc = NULL;
+    xmlFree(xml);
+    xml = NULL;
+
+    /* the key from the context is used for all the nodes: the keys manager is not needed */
+    doc = testApiEncPartsCreate(&xml);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiEncPartsEncrypt(mngr, doc, TEST_API_KEY_NAME) == 0);
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) == 0);
+    keyInfoCtx.keyReq.keyId = xmlSecKeyDataAesId;
+    key = xmlSecKeysMngrFindKey(mngr, BAD_CAST TEST_API_KEY_NAME, &keyInfoCtx);
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    testApiCheck(key != NULL);
+    testApiCheck(testApiEncPartsCheck(NULL, doc, key, xml, TEST_API_ENC_PARTS_NUMBER) == 0);
+    res = 0;
+
+done:
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+/* returns the number of the @name nodes in the @node subtree */
+static xmlSecSize
+testApiEncCountNodes(xmlNodePtr node, const xmlChar* name, const xmlChar* ns) {
+    xmlNodePtr cur;
+    xmlSecSize res = 0;
+
+    if(xmlSecCheckNodeName(node, name, ns)) {
+        ++res;
+    }
+    for(cur = xmlSecGetNextElementNode(node->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        res += testApiEncCountNodes(cur, name, ns);
+    }
+    return(res);
+}
+
+static int
+testApiEncXmlEncryptMultiple(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlNodePtr parts[TEST_API_ENC_PARTS_NUMBER];
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecEncCtxPtr encCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlDocPtr encDoc = NULL;
+    xmlNodePtr tmpl = NULL;
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr encKeyNode;
+    xmlNodePtr root;
+    xmlChar* xml = NULL;
+    xmlChar* encXml = NULL;
+    xmlChar* keyId = NULL;
+    int ret;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataAesId, 128);
+    testApiCheck(mngr != NULL);
+    doc = testApiEncPartsCreate(&xml);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiEncPartsGetParts(doc, parts, TEST_API_ENC_PARTS_NUMBER) == TEST_API_ENC_PARTS_NUMBER);
+
+    /* the session key is encrypted with the "test-key" */
+    tmpl = xmlSecTmplEncDataCreate(doc, xmlSecTransformAes128CbcId, BAD_CAST "parts", xmlSecTypeEncElement, NULL, NULL);
+    testApiCheck(tmpl != NULL);
+    testApiCheck(xmlSecTmplEncDataEnsureCipherValue(tmpl) != NULL);
+    keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(tmpl, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    encKeyNode = xmlSecTmplKeyInfoAddEncryptedKey(keyInfoNode, xmlSecTransformKWAes128Id, NULL, NULL, NULL);
+    testApiCheck(encKeyNode != NULL);
+    testApiCheck(xmlSecTmplEncDataEnsureCipherValue(encKeyNode) != NULL);
+    keyInfoNode = xmlSecTmplEncDataEnsureKeyInfo(encKeyNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    encCtx = xmlSecEncCtxCreate(mngr);
+    testApiCheck(encCtx != NULL);
+    xmlSecExecutorSetCallback(NULL, TEST_API_ENC_PARALLEL_THREADS, NULL);
+    ret = xmlSecEncCtxXmlEncryptMultiple(encCtx, tmpl, parts, TEST_API_ENC_PARTS_NUMBER);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    testApiCheck(ret == 0);
+    tmpl = NULL;
+
+    /* the key is encrypted once and the other nodes refer to it */
+    root = xmlDocGetRootElement(doc);
+    testApiCheck(testApiEncPartsGetParts(doc, parts, TEST_API_ENC_PARTS_NUMBER) == 0);
+    testApiCheck(testApiEncPartsGetNodes(doc, parts, TEST_API_ENC_PARTS_NUMBER) == TEST_API_ENC_PARTS_NUMBER);
+    testApiCheck(testApiEncCountNodes(root, xmlSecNodeEncryptedKey, xmlSecEncNs) == 1);
+    testApiCheck(testApiEncCountNodes(root, xmlSecNodeDataReference, xmlSecEncNs) == TEST_API_ENC_PARTS_NUMBER);
+    testApiCheck(testApiEncCountNodes(root, xmlSecNodeRetrievalMethod, xmlSecDSigNs) == TEST_API_ENC_PARTS_NUMBER - 1);
+    encKeyNode = xmlSecFindNode(root, xmlSecNodeEncryptedKey, xmlSecEncNs);
+    testApiCheck(encKeyNode != NULL);
+    keyId = xmlGetProp(encKeyNode, xmlSecAttrId);
+    testApiCheck(xmlStrEqual(keyId, BAD_CAST "parts-key"));
+
+    /* the nodes are decrypted one by one and on the worker threads */
+    encXml = testApiEncPartsDump(doc);
+    testApiCheck(encXml != NULL);
+    encDoc = xmlReadMemory((const char*)encXml, xmlStrlen(encXml), NULL, NULL, 0);
+    testApiCheck(encDoc != NULL);
+    testApiCheck(testApiEncPartsCheck(mngr, encDoc, NULL, xml, TEST_API_ENC_PARTS_NUMBER) == 0);
+    res = 0;
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    if(keyId != NULL) {
+        xmlFree(keyId);
+    }
+    if(encXml != NULL) {
+        xmlFree(encXml);
+    }
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    if(encCtx != NULL) {
+        xmlSecEncCtxDestroy(encCtx);
+    }
+    if(tmpl != NULL) {
+        xmlFreeNode(tmpl);
+    }
+    if(encDoc != NULL) {
+        xmlFreeDoc(encDoc);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* XMLSEC_NO_AES */
+
+static int
+testApiEncDecryptParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: AES support is disabled\n");
+    return(0);
+}
+
+static int
+testApiEncXmlEncryptMultiple(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: AES support is disabled\n");
+    return(0);
+}
+
+#endif /* XMLSEC_NO_AES */
+
+/**************************************************************************
+ *
+ * Keys manager: verified signatures cache
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+static const char testApiVerifyDoc[] =
+    "<Document><Data>some signed data</Data></Document>";
+
+/* replaces the "test-key" in the @mngr keys store with a new HMAC key of
+ * @sizeBits bits without invalidating the keys manager caches */
+static int
+testApiKeysStoreReplaceKey(xmlSecKeysMngrPtr mngr, xmlSecSize sizeBits) {
+    xmlSecKeyStorePtr store;
+    xmlSecKeyPtr key;
+
+    store = xmlSecKeysMngrGetKeysStore(mngr);
+    if(store == NULL) {
+        fprintf(stderr, "Error: the keys manager has no keys store\n");
+        return(-1);
+    }
+    key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, sizeBits, xmlSecKeyDataTypeSymmetric);
+    if((key == NULL) || (xmlSecKeySetName(key, BAD_CAST TEST_API_KEY_NAME) < 0)) {
+        fprintf(stderr, "Error: unable to generate the key\n");
+        if(key != NULL) {
+            xmlSecKeyDestroy(key);
+        }
+        return(-1);
+    }
+    xmlSecPtrListEmpty(xmlSecSimpleKeysStoreGetKeys(store));
+    if(xmlSecSimpleKeysStoreAdoptKey(store, key) < 0) {
+        fprintf(stderr, "Error: unable to add the key to the keys store\n");
+        xmlSecKeyDestroy(key);
+        return(-1);
+    }
+    return(0);
+}
+
+/* signs the test document with the "test-key" from @mngr (enveloped
+ * signature, HMAC-SHA256) and returns the signed document */
+static xmlChar*
+testApiVerifySign(xmlSecKeysMngrPtr mngr) {
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr signNode;
+    xmlNodePtr refNode;
+    xmlNodePtr keyInfoNode;
+    xmlChar* res = NULL;
+    int size = 0;
+
+    doc = xmlReadMemory(testApiVerifyDoc, sizeof(testApiVerifyDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck(signNode != NULL);
+    testApiCheck(xmlAddChild(xmlDocGetRootElement(doc), signNode) != NULL);
+    refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL, BAD_CAST "", NULL);
+    testApiCheck(refNode != NULL);
+    testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId) != NULL);
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxSign(dsigCtx, signNode) == 0);
+    xmlDocDumpMemory(doc, &res, &size);
+    testApiCheck(res != NULL);
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+/* verifies the signed document @xml with the keys from @mngr and returns 1 if
+ * the signature is valid, 0 if it is invalid or a negative value if an error
+ * occurs; @hits and @misses are the keys cache hits and misses */
+static int
+testApiVerify(xmlSecKeysMngrPtr mngr, const xmlChar* xml, xmlSecSize* hits, xmlSecSize* misses) {
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr signNode;
+    xmlSecSize hits0, misses0;
+    int ret;
+    int res = -1;
+
+    doc = xmlReadMemory((const char*)xml, xmlStrlen(xml), NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    signNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    testApiCheck(signNode != NULL);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+
+    hits0 = xmlSecMetricsGet(xmlSecMetricKeysCacheHits);
+    misses0 = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses);
+    /* the invalid signatures are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    ret = xmlSecDSigCtxVerify(dsigCtx, signNode);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    (*hits) = xmlSecMetricsGet(xmlSecMetricKeysCacheHits) - hits0;
+    (*misses) = xmlSecMetricsGet(xmlSecMetricKeysCacheMisses) - misses0;
+    testApiCheck(ret == 0);
+    res = (dsigCtx->status == xmlSecDSigStatusSucceeded) ? 1 : 0;
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+static int
+testApiVerifyCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlChar* xml = NULL;
+    xmlChar* forged = NULL;
+    xmlChar* pos;
+    xmlSecSize hits, misses;
+    int res = -1;
+
+    xmlSecMetricsSetEnabled(1);
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    xml = testApiVerifySign(mngr);
+    testApiCheck(xml != NULL);
+    testApiCheck(xmlSecKeysMngrEnableVerifyCache(mngr, 16, 0) == 0);
+
+    /* the first verification checks the signature value, the second one uses the cache */
+    testApiCheck(testApiVerify(mngr, xml, &hits, &misses) == 1);
+    testApiCheck((hits == 0) && (misses == 1));
+    testApiCheck(testApiVerify(mngr, xml, &hits, &misses) == 1);
+    testApiCheck((hits == 1) && (misses == 0));
+
+    /* the same <dsig:SignedInfo/> over the changed data: the digests are still checked */
+    forged = xmlStrdup(xml);
+    testApiCheck(forged != NULL);
+    pos = (xmlChar*)xmlStrstr(forged, BAD_CAST "signed data");
+    testApiCheck(pos != NULL);
+    memcpy(pos, "forged data", 11);
+    testApiCheck(testApiVerify(mngr, forged, &hits, &misses) == 0);
+
+    /* with another key, only the cached signature is valid */
+    testApiCheck(testApiKeysStoreReplaceKey(mngr, 256) == 0);
+    testApiCheck(testApiVerify(mngr, xml, &hits, &misses) == 1);
+    testApiCheck((hits == 1) && (misses == 0));
+
+    /* the signature is dropped from the cache and the invalid signatures are not cached */
+    xmlSecKeysMngrInvalidateKeyCache(mngr);
+    testApiCheck(testApiVerify(mngr, xml, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+    testApiCheck(testApiVerify(mngr, xml, &hits, &misses) == 0);
+    testApiCheck((hits == 0) && (misses == 1));
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    if(forged != NULL) {
+        xmlFree(forged);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiVerifyCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Re-signing the edited document
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+#define TEST_API_RESIGN_BOGUS_DIGEST            "AAAA"
+
+static const char testApiResignDoc[] =
+    "<Document>"
+    "<Data Id=\"data1\">first</Data>"
+    "<Data Id=\"data2\">second</Data>"
+    "</Document>";
+
+/* the <dsig:Reference/> URIs: the two subtrees and the whole document */
+static const char* const testApiResignUris[] = { "#data1", "#data2", "" };
+
+#define TEST_API_RESIGN_REFS_NUMBER             (sizeof(testApiResignUris) / sizeof(testApiResignUris[0]))
+
+/* returns the <dsig:DigestValue/> node of the @index-th <dsig:Reference/> */
+static xmlNodePtr
+testApiResignGetDigestNode(xmlNodePtr signNode, xmlSecSize index) {
+    xmlNodePtr cur;
+
+    cur = xmlSecFindChild(signNode, xmlSecNodeSignedInfo, xmlSecDSigNs);
+    cur = (cur != NULL) ? xmlSecFindChild(cur, xmlSecNodeReference, xmlSecDSigNs) : NULL;
+    for(; (cur != NULL) && (index > 0); cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            --index;
+        }
+    }
+    return((cur != NULL) ? xmlSecFindChild(cur, xmlSecNodeDigestValue, xmlSecDSigNs) : NULL);
+}
+
+/* saves the <dsig:DigestValue/> of all the references to @digests */
+static int
+testApiResignGetDigests(xmlNodePtr signNode, xmlChar** digests) {
+    xmlNodePtr digestValueNode;
+    xmlSecSize ii;
+
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        if(digests[ii] != NULL) {
+            xmlFree(digests[ii]);
+        }
+        digestValueNode = testApiResignGetDigestNode(signNode, ii);
+        digests[ii] = (digestValueNode != NULL) ? xmlNodeGetContent(digestValueNode) : NULL;
+        if(digests[ii] == NULL) {
+            fprintf(stderr, "Error: the reference %d digest is not found\n", (int)ii);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+/* returns 1 if the @index-th reference digest is @expected or 0 otherwise */
+static int
+testApiResignCheckDigest(xmlNodePtr signNode, xmlSecSize index, const xmlChar* expected) {
+    xmlNodePtr digestValueNode;
+    xmlChar* digest;
+    int res;
+
+    digestValueNode = testApiResignGetDigestNode(signNode, index);
+    if(digestValueNode == NULL) {
+        return(0);
+    }
+    digest = xmlNodeGetContent(digestValueNode);
+    res = xmlStrEqual(digest, expected);
+    if(digest != NULL) {
+        xmlFree(digest);
+    }
+    return(res);
+}
+
+/* sets the @index-th reference digest to the bogus value: it stays in the
+ * signature only if the digest is kept by xmlSecDSigCtxResign() */
+static int
+testApiResignSetBogusDigest(xmlNodePtr signNode, xmlSecSize index) {
+    xmlNodePtr digestValueNode;
+
+    digestValueNode = testApiResignGetDigestNode(signNode, index);
+    if(digestValueNode == NULL) {
+        fprintf(stderr, "Error: the reference %d digest is not found\n", (int)index);
+        return(-1);
+    }
+    xmlNodeSetContent(digestValueNode, BAD_CAST TEST_API_RESIGN_BOGUS_DIGEST);
+    return(0);
+}
+
+/* signs (@resign is 0) or re-signs the @signNode with the keys from @mngr,
+ * returns 0 on success or a negative value if an error occurs */
+static int
+testApiResignSign(xmlSecKeysMngrPtr mngr, xmlNodePtr signNode, int resign,
+                  xmlNodePtr* changedNodes, xmlSecSize changedNodesSize) {
+    xmlSecDSigCtxPtr dsigCtx;
+    int ret;
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(-1);
+    }
+    if(resign != 0) {
+        ret = xmlSecDSigCtxResign(dsigCtx, signNode, changedNodes, changedNodesSize);
+    } else {
+        ret = xmlSecDSigCtxSign(dsigCtx, signNode);
+    }
+    xmlSecDSigCtxDestroy(dsigCtx);
+    if(ret < 0) {
+        fprintf(stderr, "Error: unable to sign the document\n");
+        return(-1);
+    }
+    return(0);
+}
+
+/* returns 1 if the @signNode is valid, 0 if it is invalid or a negative
+ * value if an error occurs */
+static int
+testApiResignVerify(xmlSecKeysMngrPtr mngr, xmlNodePtr signNode) {
+    xmlSecDSigCtxPtr dsigCtx;
+    int ret;
+    int res;
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(-1);
+    }
+    /* the invalid signatures are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    ret = xmlSecDSigCtxVerify(dsigCtx, signNode);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    res = (ret < 0) ? -1 : ((dsigCtx->status == xmlSecDSigStatusSucceeded) ? 1 : 0);
+    xmlSecDSigCtxDestroy(dsigCtx);
+    return(res);
+}
+
+static int
+testApiDSigResign(const char* topfolder ATTRIBUTE_UNUSED) {
+    static const xmlChar* ids[] = { BAD_CAST "Id", NULL };
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr signNode;
+    xmlNodePtr refNode;
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr data1;
+    xmlNodePtr data2;
+    xmlNodePtr changedNodes[1];
+    xmlChar* digests[TEST_API_RESIGN_REFS_NUMBER];
+    xmlChar* digests2[TEST_API_RESIGN_REFS_NUMBER];
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(digests, 0, sizeof(digests));
+    memset(digests2, 0, sizeof(digests2));
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+
+    doc = xmlReadMemory(testApiResignDoc, sizeof(testApiResignDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    xmlSecAddIDs(doc, xmlDocGetRootElement(doc), ids);
+    data1 = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    testApiCheck(data1 != NULL);
+    data2 = xmlSecGetNextElementNode(data1->next);
+    testApiCheck(data2 != NULL);
+
+    signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck(signNode != NULL);
+    testApiCheck(xmlAddChild(xmlDocGetRootElement(doc), signNode) != NULL);
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL,
+                        BAD_CAST testApiResignUris[ii], NULL);
+        testApiCheck(refNode != NULL);
+        if(testApiResignUris[ii][0] == '\0') {
+            testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId) != NULL);
+        }
+        testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformExclC14NId) != NULL);
+    }
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    testApiCheck(testApiResignSign(mngr, signNode, 0, NULL, 0) == 0);
+    testApiCheck(testApiResignGetDigests(signNode, digests) == 0);
+    testApiCheck(testApiResignVerify(mngr, signNode) == 1);
+
+    /* nothing is changed: all the digests are kept */
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        testApiCheck(testApiResignSetBogusDigest(signNode, ii) == 0);
+    }
+    testApiCheck(testApiResignSign(mngr, signNode, 1, NULL, 0) == 0);
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        testApiCheck(testApiResignCheckDigest(signNode, ii, BAD_CAST TEST_API_RESIGN_BOGUS_DIGEST) == 1);
+    }
+
+    /* the changed subtree: its reference and the whole document reference are recomputed */
+    changedNodes[0] = data1;
+    testApiCheck(testApiResignSign(mngr, signNode, 1, changedNodes, 1) == 0);
+    testApiCheck(testApiResignCheckDigest(signNode, 0, digests[0]) == 1);
+    testApiCheck(testApiResignCheckDigest(signNode, 1, BAD_CAST TEST_API_RESIGN_BOGUS_DIGEST) == 1);
+    testApiCheck(testApiResignCheckDigest(signNode, 2, digests[2]) == 1);
+
+    /* the node inside the subtree */
+    changedNodes[0] = data2->children;
+    testApiCheck(testApiResignSign(mngr, signNode, 1, changedNodes, 1) == 0);
+    testApiCheck(testApiResignGetDigests(signNode, digests2) == 0);
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        testApiCheck(xmlStrEqual(digests2[ii], digests[ii]) == 1);
+    }
+    testApiCheck(testApiResignVerify(mngr, signNode) == 1);
+
+    /* the edited document is signed again */
+    xmlNodeSetContent(data1, BAD_CAST "first changed");
+    testApiCheck(testApiResignVerify(mngr, signNode) == 0);
+    changedNodes[0] = data1;
+    testApiCheck(testApiResignSign(mngr, signNode, 1, changedNodes, 1) == 0);
+    testApiCheck(testApiResignGetDigests(signNode, digests2) == 0);
+    testApiCheck(xmlStrEqual(digests2[0], digests[0]) == 0);
+    testApiCheck(xmlStrEqual(digests2[1], digests[1]) == 1);
+    testApiCheck(xmlStrEqual(digests2[2], digests[2]) == 0);
+    testApiCheck(testApiResignVerify(mngr, signNode) == 1);
+
+    /* the changed ancestor (e.g. a namespace declaration) changes all the references */
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        testApiCheck(testApiResignSetBogusDigest(signNode, ii) == 0);
+    }
+    changedNodes[0] = xmlDocGetRootElement(doc);
+    testApiCheck(testApiResignSign(mngr, signNode, 1, changedNodes, 1) == 0);
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        testApiCheck(testApiResignCheckDigest(signNode, ii, digests2[ii]) == 1);
+    }
+    testApiCheck(testApiResignVerify(mngr, signNode) == 1);
+    res = 0;
+
+done:
+    for(ii = 0; ii < TEST_API_RESIGN_REFS_NUMBER; ++ii) {
+        if(digests[ii] != NULL) {
+            xmlFree(digests[ii]);
+        }
+        if(digests2[ii] != NULL) {
+            xmlFree(digests2[ii]);
+        }
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigResign(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Pinned signature key
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+static const char testApiPinnedDoc[] =
+    "<Document>"
+    "<Data>pinned</Data>"
+    "</Document>";
+
+/* returns 1 if the errors stack has the "key not found" error with @msg */
+static int
+testApiPinnedHasKeyNotFound(const char* msg) {
+    xmlSecErrorsStackItemPtr item;
+    xmlSecSize ii;
+
+    for(ii = 0; (item = xmlSecErrorsStackGetItem(ii)) != NULL; ++ii) {
+        if((item->reason == XMLSEC_ERRORS_R_KEY_NOT_FOUND) &&
+           ((msg == NULL) || (strstr((const char*)item->msg, msg) != NULL))) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/* verifies the @signNode with the @pinnedKey copy (if any) and the @flags,
+ * returns 1 if the signature is valid, 0 if it is invalid or a negative
+ * value if an error occurs; @keyNotFound is set to 1 if the verification
+ * failed because the pinned key is not set */
+static int
+testApiPinnedVerify(xmlSecKeysMngrPtr mngr, xmlNodePtr signNode, xmlSecKeyPtr pinnedKey,
+                    unsigned int flags, int* keyNotFound) {
+    xmlSecDSigCtxPtr dsigCtx;
+    int ret;
+    int res;
+
+    (*keyNotFound) = 0;
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(-1);
+    }
+    dsigCtx->flags |= flags;
+    if(pinnedKey != NULL) {
+        dsigCtx->signKey = xmlSecKeyDuplicate(pinnedKey);
+        if(dsigCtx->signKey == NULL) {
+            fprintf(stderr, "Error: unable to duplicate the pinned key\n");
+            xmlSecDSigCtxDestroy(dsigCtx);
+            return(-1);
+        }
+    }
+
+    /* the errors are expected: collect them instead of printing */
+    if(xmlSecErrorsStackStart() < 0) {
+        fprintf(stderr, "Error: unable to start the errors stack\n");
+        xmlSecDSigCtxDestroy(dsigCtx);
+        return(-1);
+    }
+    ret = xmlSecDSigCtxVerify(dsigCtx, signNode);
+    if(ret < 0) {
+        (*keyNotFound) = testApiPinnedHasKeyNotFound("pinned key is not set");
+        res = -1;
+    } else {
+        res = (dsigCtx->status == xmlSecDSigStatusSucceeded) ? 1 : 0;
+    }
+    xmlSecErrorsStackStop();
+
+    xmlSecDSigCtxDestroy(dsigCtx);
+    return(res);
+}
+
+static int
+testApiDSigPinnedKey(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyPtr signKey = NULL;
+    xmlSecKeyPtr otherKey = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr signNode;
+    xmlNodePtr refNode;
+    xmlNodePtr keyInfoNode;
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    int keyNotFound = 0;
+    int res = -1;
+
+    /* the <dsig:KeyInfo/> resolves to the "test-key" in the keys manager */
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) == 0);
+    keyInfoCtx.keyReq.keyId = xmlSecKeyDataHmacId;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeSymmetric;
+    signKey = xmlSecKeysMngrFindKey(mngr, BAD_CAST TEST_API_KEY_NAME, &keyInfoCtx);
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    testApiCheck(signKey != NULL);
+    otherKey = xmlSecKeyGenerate(xmlSecKeyDataHmacId, 256, xmlSecKeyDataTypeSymmetric);
+    testApiCheck(otherKey != NULL);
+
+    doc = xmlReadMemory(testApiPinnedDoc, sizeof(testApiPinnedDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck(signNode != NULL);
+    testApiCheck(xmlAddChild(xmlDocGetRootElement(doc), signNode) != NULL);
+    refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL, BAD_CAST "", NULL);
+    testApiCheck(refNode != NULL);
+    testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId) != NULL);
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxSign(dsigCtx, signNode) == 0);
+    xmlSecDSigCtxDestroy(dsigCtx);
+    dsigCtx = NULL;
+
+    /* the key from <dsig:KeyInfo/> is valid */
+    testApiCheck(testApiPinnedVerify(mngr, signNode, NULL, 0, &keyNotFound) == 1);
+
+    /* the matching pinned key */
+    testApiCheck(testApiPinnedVerify(mngr, signNode, signKey, XMLSEC_DSIG_FLAGS_PINNED_KEY, &keyNotFound) == 1);
+
+    /* the different pinned key: the valid key from <dsig:KeyInfo/> is not used */
+    testApiCheck(testApiPinnedVerify(mngr, signNode, otherKey, XMLSEC_DSIG_FLAGS_PINNED_KEY, &keyNotFound) == 0);
+
+    /* no pinned key: the <dsig:KeyInfo/> is not looked at */
+    testApiCheck(testApiPinnedVerify(mngr, signNode, NULL, XMLSEC_DSIG_FLAGS_PINNED_KEY, &keyNotFound) < 0);
+    testApiCheck(keyNotFound == 1);
+    res = 0;
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(otherKey != NULL) {
+        xmlSecKeyDestroy(otherKey);
+    }
+    if(signKey != NULL) {
+        xmlSecKeyDestroy(signKey);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigPinnedKey(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Parallel <dsig:Reference/> processing
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+#define TEST_API_PARALLEL_REFS_NUMBER           8
+#define TEST_API_PARALLEL_THREADS               4
+#define TEST_API_PARALLEL_TASKS                 4
+
+/* the same expression in all the references: the compiled XPath is shared */
+#define TEST_API_PARALLEL_XPATH                 "not(self::comment())"
+
+typedef struct _testApiDSigParallelResult {
+    int                 ret;
+    xmlSecDSigStatus    status;
+    xmlSecSize          refsNumber;
+    xmlSecDSigStatus    refs[2 * TEST_API_PARALLEL_REFS_NUMBER];
+} testApiDSigParallelResult;
+
+/* creates the document with TEST_API_PARALLEL_REFS_NUMBER <Data/> nodes signed
+ * with the references in <dsig:SignedInfo/> or, if @manifest is not 0, in
+ * a <dsig:Manifest/> (the <dsig:SignedInfo/> references only the manifest) */
+static xmlDocPtr
+testApiDSigParallelCreate(xmlSecKeysMngrPtr mngr, int manifest, int parallel) {
+    static const xmlChar* ids[] = { BAD_CAST "Id", NULL };
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root;
+    xmlNodePtr signNode;
+    xmlNodePtr refsNode;
+    xmlNodePtr refNode;
+    xmlNodePtr transformNode;
+    xmlNodePtr keyInfoNode;
+    xmlNodePtr node;
+    char buf[64];
+    int ii;
+    int res = -1;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc != NULL);
+    root = xmlNewDocNode(doc, NULL, BAD_CAST "Document", NULL);
+    testApiCheck(root != NULL);
+    xmlDocSetRootElement(doc, root);
+    for(ii = 0; ii < TEST_API_PARALLEL_REFS_NUMBER; ++ii) {
+        snprintf(buf, sizeof(buf), "data %d", ii);
+        node = xmlNewChild(root, NULL, BAD_CAST "Data", BAD_CAST buf);
+        testApiCheck(node != NULL);
+        snprintf(buf, sizeof(buf), "data%d", ii);
+        testApiCheck(xmlSetProp(node, BAD_CAST "Id", BAD_CAST buf) != NULL);
+    }
+
+    signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck(signNode != NULL);
+    testApiCheck(xmlAddChild(root, signNode) != NULL);
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+    if(manifest != 0) {
+        node = xmlSecTmplSignatureAddObject(signNode, NULL, NULL, NULL);
+        testApiCheck(node != NULL);
+        refsNode = xmlSecTmplObjectAddManifest(node, BAD_CAST "manifest");
+        testApiCheck(refsNode != NULL);
+        refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL, BAD_CAST "#manifest", NULL);
+        testApiCheck(refNode != NULL);
+    } else {
+        refsNode = signNode;
+    }
+    for(ii = 0; ii < TEST_API_PARALLEL_REFS_NUMBER; ++ii) {
+        snprintf(buf, sizeof(buf), "#data%d", ii);
+        if(manifest != 0) {
+            refNode = xmlSecTmplManifestAddReference(refsNode, xmlSecTransformSha256Id, NULL, BAD_CAST buf, NULL);
+        } else {
+            refNode = xmlSecTmplSignatureAddReference(refsNode, xmlSecTransformSha256Id, NULL, BAD_CAST buf, NULL);
+        }
+        testApiCheck(refNode != NULL);
+        transformNode = xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformXPathId);
+        testApiCheck(transformNode != NULL);
+        testApiCheck(xmlSecTmplTransformAddXPath(transformNode, BAD_CAST TEST_API_PARALLEL_XPATH, NULL) == 0);
+        testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformExclC14NId) != NULL);
+    }
+    xmlSecAddIDs(doc, root, ids);
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    if(parallel != 0) {
+        dsigCtx->flags |= XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES;
+    }
+    testApiCheck(xmlSecDSigCtxSign(dsigCtx, signNode) == 0);
+    res = 0;
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if((res < 0) && (doc != NULL)) {
+        xmlFreeDoc(doc);
+        doc = NULL;
+    }
+    return(doc);
+}
+
+/* returns the @index-th <Data/> node or the <dsig:SignedInfo/> (@index is -1)
+ * or the <dsig:Manifest/> (@index is -2) node of the @doc */
+static xmlNodePtr
+testApiDSigParallelGetNode(xmlDocPtr doc, int index) {
+    xmlNodePtr cur;
+
+    cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    if(index == -1) {
+        cur = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignedInfo, xmlSecDSigNs);
+    } else if(index == -2) {
+        cur = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeManifest, xmlSecDSigNs);
+    }
+    for(; (cur != NULL) && (index > 0); --index) {
+        cur = xmlSecGetNextElementNode(cur->next);
+    }
+    return(cur);
+}
+
+typedef struct _testApiDSigParallelTask {
+    xmlSecKeysMngrPtr   mngr;
+    xmlDocPtr           doc;
+    xmlSecDSigStatus    status;
+} testApiDSigParallelTask;
+
+/* verifies the task's own copy of the document with the parallel references
+ * processing: the keys manager, the XPath and the transforms caches are shared */
+static void
+testApiDSigParallelTaskRun(void* data) {
+    testApiDSigParallelTask* task = (testApiDSigParallelTask*)data;
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlNodePtr signNode;
+
+    task->status = xmlSecDSigStatusUnknown;
+    signNode = xmlSecFindNode(xmlDocGetRootElement(task->doc), xmlSecNodeSignature, xmlSecDSigNs);
+    if(signNode == NULL) {
+        return;
+    }
+    dsigCtx = xmlSecDSigCtxCreate(task->mngr);
+    if(dsigCtx == NULL) {
+        return;
+    }
+    dsigCtx->flags |= XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES;
+    if(xmlSecDSigCtxVerify(dsigCtx, signNode) == 0) {
+        task->status = dsigCtx->status;
+    }
+    xmlSecDSigCtxDestroy(dsigCtx);
+}
+
+/* verifies the signature in @doc with the sequential (@parallel is 0) or the
+ * parallel references processing and records the result */
+static void
+testApiDSigParallelVerify(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, int parallel,
+                          testApiDSigParallelResult* result) {
+    xmlSecPtrListPtr lists[2];
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlNodePtr signNode;
+    xmlSecSize ii, jj, size;
+
+    memset(result, 0, sizeof(testApiDSigParallelResult));
+    result->ret = -1;
+    signNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    if(signNode == NULL) {
+        return;
+    }
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        return;
+    }
+    if(parallel != 0) {
+        dsigCtx->flags |= XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES;
+    }
+
+    /* the invalid signatures and the errors are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    result->ret = xmlSecDSigCtxVerify(dsigCtx, signNode);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    result->status = dsigCtx->status;
+
+    lists[0] = &(dsigCtx->signedInfoReferences);
+    lists[1] = &(dsigCtx->manifestReferences);
+    for(ii = 0; ii < sizeof(lists) / sizeof(lists[0]); ++ii) {
+        size = xmlSecPtrListGetSize(lists[ii]);
+        for(jj = 0; (jj < size) && (result->refsNumber < sizeof(result->refs) / sizeof(result->refs[0])); ++jj) {
+            dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(lists[ii], jj);
+            result->refs[result->refsNumber++] = (dsigRefCtx != NULL) ? dsigRefCtx->status : xmlSecDSigStatusUnknown;
+        }
+    }
+    xmlSecDSigCtxDestroy(dsigCtx);
+}
+
+/* verifies the signature in @doc with the sequential and the parallel
+ * references processing, returns 0 if the results are the same */
+static int
+testApiDSigParallelCompare(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, testApiDSigParallelResult* result) {
+    testApiDSigParallelResult parallelResult;
+    xmlSecSize ii;
+    int res = -1;
+
+    testApiDSigParallelVerify(mngr, doc, 0, result);
+    xmlSecExecutorSetCallback(NULL, TEST_API_PARALLEL_THREADS, NULL);
+    testApiDSigParallelVerify(mngr, doc, 1, &parallelResult);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+
+    testApiCheck((result->ret < 0) == (parallelResult.ret < 0));
+    testApiCheck(result->status == parallelResult.status);
+    testApiCheck(result->refsNumber == parallelResult.refsNumber);
+    for(ii = 0; ii < result->refsNumber; ++ii) {
+        testApiCheck(result->refs[ii] == parallelResult.refs[ii]);
+    }
+    res = 0;
+
+done:
+    return(res);
+}
+
+/* signs the document with the sequential and the parallel references
+ * processing, returns 0 if the signed documents are the same */
+static int
+testApiDSigParallelCompareSign(xmlSecKeysMngrPtr mngr, int manifest) {
+    xmlDocPtr doc = NULL;
+    xmlDocPtr parallelDoc = NULL;
+    xmlChar* xml = NULL;
+    xmlChar* parallelXml = NULL;
+    int size = 0;
+    int res = -1;
+
+    doc = testApiDSigParallelCreate(mngr, manifest, 0);
+    testApiCheck(doc != NULL);
+    xmlSecExecutorSetCallback(NULL, TEST_API_PARALLEL_THREADS, NULL);
+    parallelDoc = testApiDSigParallelCreate(mngr, manifest, 1);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    testApiCheck(parallelDoc != NULL);
+
+    xmlDocDumpMemory(doc, &xml, &size);
+    testApiCheck(xml != NULL);
+    xmlDocDumpMemory(parallelDoc, &parallelXml, &size);
+    testApiCheck(parallelXml != NULL);
+    testApiCheck(xmlStrEqual(xml, parallelXml) == 1);
+    res = 0;
+
+done:
+    if(xml != NULL) {
+        xmlFree(xml);
+    }
+    if(parallelXml != NULL) {
+        xmlFree(parallelXml);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(parallelDoc != NULL) {
+        xmlFreeDoc(parallelDoc);
+    }
+    return(res);
+}
+
+static int
+testApiDSigParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    static const xmlChar* ids[] = { BAD_CAST "Id", NULL };
+    testApiDSigParallelResult result;
+    testApiDSigParallelTask tasks[TEST_API_PARALLEL_TASKS];
+    void* tasksData[TEST_API_PARALLEL_TASKS];
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node;
+    char buf[64];
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(tasks, 0, sizeof(tasks));
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecKeysMngrEnableKeyCache(mngr, 16, 0) == 0);
+
+    /* the parallel signing writes the same digests */
+    testApiCheck(testApiDSigParallelCompareSign(mngr, 0) == 0);
+    testApiCheck(testApiDSigParallelCompareSign(mngr, 1) == 0);
+
+    /* all the references are valid */
+    doc = testApiDSigParallelCreate(mngr, 0, 0);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck((result.ret == 0) && (result.status == xmlSecDSigStatusSucceeded));
+    testApiCheck(result.refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+
+    /* one invalid reference in the middle: the processing stops there */
+    node = testApiDSigParallelGetNode(doc, TEST_API_PARALLEL_REFS_NUMBER / 2);
+    testApiCheck(node != NULL);
+    xmlNodeSetContent(node, BAD_CAST "changed data");
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck((result.ret == 0) && (result.status == xmlSecDSigStatusInvalid));
+    testApiCheck(result.refs[TEST_API_PARALLEL_REFS_NUMBER / 2] == xmlSecDSigStatusInvalid);
+    for(ii = 0; ii < TEST_API_PARALLEL_REFS_NUMBER / 2; ++ii) {
+        testApiCheck(result.refs[ii] == xmlSecDSigStatusSucceeded);
+    }
+
+    /* a non-Reference node after the references is an error */
+    snprintf(buf, sizeof(buf), "data %d", TEST_API_PARALLEL_REFS_NUMBER / 2);
+    xmlNodeSetContent(node, BAD_CAST buf);
+    node = testApiDSigParallelGetNode(doc, -1);
+    testApiCheck(node != NULL);
+    testApiCheck(xmlNewChild(node, node->ns, BAD_CAST "NotReference", NULL) != NULL);
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck(result.ret < 0);
+    xmlFreeDoc(doc);
+    doc = NULL;
+
+    /* the invalid manifest references don't make the signature invalid */
+    doc = testApiDSigParallelCreate(mngr, 1, 0);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck((result.ret == 0) && (result.status == xmlSecDSigStatusSucceeded));
+    testApiCheck(result.refsNumber == TEST_API_PARALLEL_REFS_NUMBER + 1);
+    node = testApiDSigParallelGetNode(doc, TEST_API_PARALLEL_REFS_NUMBER / 2);
+    testApiCheck(node != NULL);
+    xmlNodeSetContent(node, BAD_CAST "changed data");
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck((result.ret == 0) && (result.status == xmlSecDSigStatusSucceeded));
+    testApiCheck(result.refsNumber == TEST_API_PARALLEL_REFS_NUMBER + 1);
+    testApiCheck(result.refs[1 + TEST_API_PARALLEL_REFS_NUMBER / 2] == xmlSecDSigStatusInvalid);
+
+    /* a non-Reference node in the manifest is an error */
+    node = testApiDSigParallelGetNode(doc, -2);
+    testApiCheck(node != NULL);
+    testApiCheck(xmlNewChild(node, node->ns, BAD_CAST "NotReference", NULL) != NULL);
+    testApiCheck(testApiDSigParallelCompare(mngr, doc, &result) == 0);
+    testApiCheck(result.ret < 0);
+    xmlFreeDoc(doc);
+    doc = NULL;
+
+    /* the signatures are verified concurrently with the shared caches */
+    doc = testApiDSigParallelCreate(mngr, 0, 0);
+    testApiCheck(doc != NULL);
+    for(ii = 0; ii < TEST_API_PARALLEL_TASKS; ++ii) {
+        tasks[ii].mngr = mngr;
+        tasks[ii].doc = xmlCopyDoc(doc, 1);
+        testApiCheck(tasks[ii].doc != NULL);
+        xmlSecAddIDs(tasks[ii].doc, xmlDocGetRootElement(tasks[ii].doc), ids);
+        tasksData[ii] = &(tasks[ii]);
+    }
+    xmlSecExecutorSetCallback(NULL, TEST_API_PARALLEL_THREADS, NULL);
+    testApiCheck(xmlSecExecutorRun(testApiDSigParallelTaskRun, tasksData, TEST_API_PARALLEL_TASKS) == 0);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    for(ii = 0; ii < TEST_API_PARALLEL_TASKS; ++ii) {
+        testApiCheck(tasks[ii].status == xmlSecDSigStatusSucceeded);
+    }
+    res = 0;
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    for(ii = 0; ii < TEST_API_PARALLEL_TASKS; ++ii) {
+        if(tasks[ii].doc != NULL) {
+            xmlFreeDoc(tasks[ii].doc);
+        }
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Verifying <dsig:SignatureValue/> before the references
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+/* the HMAC-SHA256 value that doesn't match anything */
+#define TEST_API_BOGUS_SIGNATURE_VALUE          "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA="
+
+/* verifies the signature in @doc with the @flags, returns the status or
+ * xmlSecDSigStatusUnknown if an error occurs; @refsNumber is set to the number
+ * of the processed <dsig:Reference/> nodes */
+static xmlSecDSigStatus
+testApiDSigModesVerify(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, unsigned int flags,
+                       xmlSecSize* refsNumber) {
+    xmlSecDSigStatus res = xmlSecDSigStatusUnknown;
+    xmlSecDSigReferenceCtxPtr dsigRefCtx;
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlNodePtr signNode;
+    xmlSecSize ii;
+
+    (*refsNumber) = 0;
+    signNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    if(signNode == NULL) {
+        fprintf(stderr, "Error: unable to find the signature node\n");
+        return(xmlSecDSigStatusUnknown);
+    }
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(xmlSecDSigStatusUnknown);
+    }
+    dsigCtx->flags |= flags;
+    if(xmlSecDSigCtxVerify(dsigCtx, signNode) < 0) {
+        fprintf(stderr, "Error: signature verification failed\n");
+        xmlSecDSigCtxDestroy(dsigCtx);
+        return(xmlSecDSigStatusUnknown);
+    }
+    res = dsigCtx->status;
+
+    /* the references that were not processed have no status */
+    for(ii = 0; ii < xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences)); ++ii) {
+        dsigRefCtx = (xmlSecDSigReferenceCtxPtr)xmlSecPtrListGetItem(&(dsigCtx->signedInfoReferences), ii);
+        if((dsigRefCtx != NULL) && (dsigRefCtx->status != xmlSecDSigStatusUnknown)) {
+            ++(*refsNumber);
+        }
+    }
+    xmlSecDSigCtxDestroy(dsigCtx);
+    return(res);
+}
+
+static int
+testApiDSigSignatureFirst(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node;
+    xmlChar* signatureValue = NULL;
+    xmlSecSize refsNumber = 0;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    doc = testApiDSigParallelCreate(mngr, 0, 0);
+    testApiCheck(doc != NULL);
+
+    /* the valid signature: all the references are processed in both modes */
+    testApiCheck(testApiDSigModesVerify(mngr, doc, 0, &refsNumber) == xmlSecDSigStatusSucceeded);
+    testApiCheck(refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST,
+        &refsNumber) == xmlSecDSigStatusSucceeded);
+    testApiCheck(refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+
+    /* the invalid reference makes the signature invalid in both modes (the
+     * errors are expected from now on) */
+    node = testApiDSigParallelGetNode(doc, TEST_API_PARALLEL_REFS_NUMBER - 1);
+    testApiCheck(node != NULL);
+    xmlNodeSetContent(node, BAD_CAST "changed data");
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, 0, &refsNumber) == xmlSecDSigStatusInvalid);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST,
+        &refsNumber) == xmlSecDSigStatusInvalid);
+    testApiCheck(refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+
+    /* the forged <dsig:SignatureValue/>: the references are not processed */
+    node = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignatureValue, xmlSecDSigNs);
+    testApiCheck(node != NULL);
+    signatureValue = xmlNodeGetContent(node);
+    testApiCheck(signatureValue != NULL);
+    xmlNodeSetContent(node, BAD_CAST TEST_API_BOGUS_SIGNATURE_VALUE);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, 0, &refsNumber) == xmlSecDSigStatusInvalid);
+    testApiCheck(refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST,
+        &refsNumber) == xmlSecDSigStatusInvalid);
+    testApiCheck(refsNumber == 0);
+
+    /* the references are still checked after the valid <dsig:SignatureValue/> */
+    xmlNodeSetContent(node, signatureValue);
+    testApiCheck(testApiDSigModesVerify(mngr, doc, XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST,
+        &refsNumber) == xmlSecDSigStatusInvalid);
+    testApiCheck(refsNumber == TEST_API_PARALLEL_REFS_NUMBER);
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(signatureValue != NULL) {
+        xmlFree(signatureValue);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigSignatureFirst(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Multiple signatures verification
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+#define TEST_API_SIGNERS_NUMBER                 6
+
+/* creates the document with the <Data/> node signed by TEST_API_SIGNERS_NUMBER
+ * signers (all of them use the same key) */
+static xmlDocPtr
+testApiDSigSignersCreate(xmlSecKeysMngrPtr mngr) {
+    static const xmlChar* ids[] = { BAD_CAST "Id", NULL };
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root;
+    xmlNodePtr node;
+    xmlNodePtr signNode;
+    xmlNodePtr refNode;
+    xmlNodePtr keyInfoNode;
+    int ii;
+    int res = -1;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc != NULL);
+    root = xmlNewDocNode(doc, NULL, BAD_CAST "Document", NULL);
+    testApiCheck(root != NULL);
+    xmlDocSetRootElement(doc, root);
+    node = xmlNewChild(root, NULL, BAD_CAST "Data", BAD_CAST "signed data");
+    testApiCheck(node != NULL);
+    testApiCheck(xmlSetProp(node, BAD_CAST "Id", BAD_CAST "data") != NULL);
+    xmlSecAddIDs(doc, root, ids);
+
+    for(ii = 0; ii < TEST_API_SIGNERS_NUMBER; ++ii) {
+        signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+        testApiCheck(signNode != NULL);
+        testApiCheck(xmlAddChild(root, signNode) != NULL);
+        refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL, BAD_CAST "#data", NULL);
+        testApiCheck(refNode != NULL);
+        testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformExclC14NId) != NULL);
+        keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+        testApiCheck(keyInfoNode != NULL);
+        testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+        dsigCtx = xmlSecDSigCtxCreate(mngr);
+        testApiCheck(dsigCtx != NULL);
+        testApiCheck(xmlSecDSigCtxSign(dsigCtx, signNode) == 0);
+        xmlSecDSigCtxDestroy(dsigCtx);
+        dsigCtx = NULL;
+    }
+    res = 0;
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if((res < 0) && (doc != NULL)) {
+        xmlFreeDoc(doc);
+        doc = NULL;
+    }
+    return(doc);
+}
+
+/* verifies all the signatures in @doc and the <Data/> node (which is not a
+ * signature) one by one and on the worker threads, with the @signKey copy
+ * (if any); returns 0 if the results are the same and match @expected (the
+ * last status is for the <Data/> node) */
+static int
+testApiDSigSignersVerify(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, xmlSecKeyPtr signKey,
+                         const xmlSecDSigStatus* expected) {
+    xmlNodePtr nodes[TEST_API_SIGNERS_NUMBER + 1];
+    xmlSecDSigStatus statuses[TEST_API_SIGNERS_NUMBER + 1];
+    xmlSecDSigStatus parallelStatuses[TEST_API_SIGNERS_NUMBER + 1];
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlNodePtr cur;
+    xmlSecSize nodesSize = 0;
+    xmlSecSize ii;
+    int res = -1;
+
+    for(cur = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children); cur != NULL; cur = xmlSecGetNextElementNode(cur->next)) {
+        if(xmlSecCheckNodeName(cur, xmlSecNodeSignature, xmlSecDSigNs)) {
+            testApiCheck(nodesSize < TEST_API_SIGNERS_NUMBER);
+            nodes[nodesSize++] = cur;
+        }
+    }
+    testApiCheck(nodesSize == TEST_API_SIGNERS_NUMBER);
+    nodes[nodesSize++] = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+
+    /* the invalid signatures and the errors are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    if(signKey != NULL) {
+        dsigCtx->signKey = xmlSecKeyDuplicate(signKey);
+        testApiCheck(dsigCtx->signKey != NULL);
+    }
+    testApiCheck(xmlSecDSigCtxVerifyBatch(dsigCtx, nodes, nodesSize, statuses) == 0);
+    xmlSecDSigCtxDestroy(dsigCtx);
+    dsigCtx = NULL;
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    if(signKey != NULL) {
+        dsigCtx->signKey = xmlSecKeyDuplicate(signKey);
+        testApiCheck(dsigCtx->signKey != NULL);
+    }
+    xmlSecExecutorSetCallback(NULL, TEST_API_PARALLEL_THREADS, NULL);
+    testApiCheck(xmlSecDSigCtxVerifyParallel(dsigCtx, nodes, nodesSize, parallelStatuses) == 0);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+
+    for(ii = 0; ii < nodesSize; ++ii) {
+        if((statuses[ii] != expected[ii]) || (parallelStatuses[ii] != expected[ii])) {
+            fprintf(stderr, "Error: signature %u: status %d, parallel status %d, expected %d\n",
+                (unsigned int)ii, (int)statuses[ii], (int)parallelStatuses[ii], (int)expected[ii]);
+            goto done;
+        }
+    }
+    res = 0;
+
+done:
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    return(res);
+}
+
+static int
+testApiDSigVerifyParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecDSigStatus expected[TEST_API_SIGNERS_NUMBER + 1];
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyPtr signKey = NULL;
+    xmlSecKeyPtr otherKey = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node;
+    xmlSecSize ii;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) == 0);
+    keyInfoCtx.keyReq.keyId = xmlSecKeyDataHmacId;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeSymmetric;
+    signKey = xmlSecKeysMngrFindKey(mngr, BAD_CAST TEST_API_KEY_NAME, &keyInfoCtx);
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    testApiCheck(signKey != NULL);
+    otherKey = xmlSecKeyGenerate(xmlSecKeyDataHmacId, 256, xmlSecKeyDataTypeSymmetric);
+    testApiCheck(otherKey != NULL);
+    doc = testApiDSigSignersCreate(mngr);
+    testApiCheck(doc != NULL);
+
+    /* all the signatures are valid, the <Data/> node fails */
+    for(ii = 0; ii < TEST_API_SIGNERS_NUMBER; ++ii) {
+        expected[ii] = xmlSecDSigStatusSucceeded;
+    }
+    expected[TEST_API_SIGNERS_NUMBER] = xmlSecDSigStatusUnknown;
+    testApiCheck(testApiDSigSignersVerify(mngr, doc, NULL, expected) == 0);
+
+    /* each thread gets its own copy of the key from the context */
+    testApiCheck(testApiDSigSignersVerify(mngr, doc, signKey, expected) == 0);
+
+    /* one forged <dsig:SignatureValue/> */
+    node = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    for(ii = 0; (node != NULL) && (ii < TEST_API_SIGNERS_NUMBER / 2); ++ii) {
+        node = xmlSecGetNextElementNode(node->next);
+    }
+    testApiCheck(node != NULL);
+    node = xmlSecFindNode(node, xmlSecNodeSignatureValue, xmlSecDSigNs);
+    testApiCheck(node != NULL);
+    xmlNodeSetContent(node, BAD_CAST TEST_API_BOGUS_SIGNATURE_VALUE);
+    expected[TEST_API_SIGNERS_NUMBER / 2] = xmlSecDSigStatusInvalid;
+    testApiCheck(testApiDSigSignersVerify(mngr, doc, NULL, expected) == 0);
+
+    /* the wrong key */
+    for(ii = 0; ii < TEST_API_SIGNERS_NUMBER; ++ii) {
+        expected[ii] = xmlSecDSigStatusInvalid;
+    }
+    testApiCheck(testApiDSigSignersVerify(mngr, doc, otherKey, expected) == 0);
+
+    /* the changed data (digested once for all the signatures) */
+    node = xmlSecGetNextElementNode(xmlDocGetRootElement(doc)->children);
+    testApiCheck(node != NULL);
+    xmlNodeSetContent(node, BAD_CAST "changed data");
+    testApiCheck(testApiDSigSignersVerify(mngr, doc, NULL, expected) == 0);
+    res = 0;
+
+done:
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(otherKey != NULL) {
+        xmlSecKeyDestroy(otherKey);
+    }
+    if(signKey != NULL) {
+        xmlSecKeyDestroy(signKey);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigVerifyParallel(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Per-document cache of the canonical <dsig:SignedInfo/> and digests
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+/* creates the document with the enveloped signature of the <Data/> node */
+static xmlDocPtr
+testApiDocCacheCreate(xmlSecKeysMngrPtr mngr, xmlNodePtr* dataNode, xmlNodePtr* signNode) {
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr root;
+    xmlNodePtr refNode;
+    xmlNodePtr keyInfoNode;
+    int res = -1;
+
+    doc = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc != NULL);
+    root = xmlNewDocNode(doc, NULL, BAD_CAST "Document", NULL);
+    testApiCheck(root != NULL);
+    xmlDocSetRootElement(doc, root);
+    (*dataNode) = xmlNewChild(root, NULL, BAD_CAST "Data", BAD_CAST "some data");
+    testApiCheck((*dataNode) != NULL);
+
+    (*signNode) = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck((*signNode) != NULL);
+    xmlAddChild(root, (*signNode));
+    refNode = xmlSecTmplSignatureAddReference((*signNode), xmlSecTransformSha256Id, NULL, BAD_CAST "", NULL);
+    testApiCheck(refNode != NULL);
+    testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId) != NULL);
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo((*signNode), NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+
+    /* the digests are cached when signing */
+    testApiCheck(xmlSecDSigDocCacheEnable(doc) == 0);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxSign(dsigCtx, (*signNode)) == 0);
+    res = 0;
+
+done:
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if((res < 0) && (doc != NULL)) {
+        xmlSecDSigDocCacheDisable(doc);
+        xmlFreeDoc(doc);
+        doc = NULL;
+    }
+    return(doc);
+}
+
+/* verifies the signature and returns the status */
+static xmlSecDSigStatus
+testApiDocCacheVerify(xmlSecKeysMngrPtr mngr, xmlNodePtr signNode) {
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlSecDSigStatus res = xmlSecDSigStatusUnknown;
+
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(xmlSecDSigStatusUnknown);
+    }
+    /* the invalid digests are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    if(xmlSecDSigCtxVerify(dsigCtx, signNode) == 0) {
+        res = dsigCtx->status;
+    }
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    xmlSecDSigCtxDestroy(dsigCtx);
+    return(res);
+}
+
+static int
+testApiDSigDocCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlDocPtr doc2 = NULL;
+    xmlNodePtr dataNode = NULL;
+    xmlNodePtr signNode = NULL;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    doc = testApiDocCacheCreate(mngr, &dataNode, &signNode);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusSucceeded);
+
+    /* the direct changes are not seen until the cache is invalidated */
+    xmlNodeSetContent(dataNode, BAD_CAST "changed data");
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusSucceeded);
+    xmlSecDSigDocCacheInvalidate(doc);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusInvalid);
+    xmlNodeSetContent(dataNode, BAD_CAST "some data");
+    xmlSecDSigDocCacheInvalidate(doc);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusSucceeded);
+
+    /* the changes in the subtree excluded by the enveloped signature
+     * transform keep the reference digest */
+    xmlNodeSetContent(dataNode, BAD_CAST "changed data");
+    testApiCheck(xmlSecAddChild(signNode, xmlSecNodeObject, xmlSecDSigNs) != NULL);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusSucceeded);
+
+    /* the changes done by xmlsec drop the cached digests */
+    testApiCheck(xmlSecNodeEncodeAndSetContent(dataNode, BAD_CAST "changed data") == 0);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusInvalid);
+    testApiCheck(xmlSecNodeEncodeAndSetContent(dataNode, BAD_CAST "some data") == 0);
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusSucceeded);
+
+    /* no cache */
+    xmlSecDSigDocCacheDisable(doc);
+    xmlNodeSetContent(dataNode, BAD_CAST "changed data");
+    testApiCheck(testApiDocCacheVerify(mngr, signNode) == xmlSecDSigStatusInvalid);
+
+    /* the document psvi field is used by the cache */
+    doc2 = xmlNewDoc(BAD_CAST "1.0");
+    testApiCheck(doc2 != NULL);
+    doc2->psvi = doc2;
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    testApiCheck(xmlSecDSigDocCacheEnable(doc2) < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    doc2->psvi = NULL;
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(doc2 != NULL) {
+        xmlFreeDoc(doc2);
+    }
+    if(doc != NULL) {
+        xmlSecDSigDocCacheDisable(doc);
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiDSigDocCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Processing limits
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+/* the reference chain: the XPointer, the XPath, the c14n, the digest
+ * and the memory buffer transforms */
+#define TEST_API_LIMITS_TRANSFORMS              5
+
+/* the exclusive c14n of the <Data Id="dataN">data N</Data> nodes */
+#define TEST_API_LIMITS_DIGEST_SIZE             30
+
+/* enough for the XPath expressions of one reference but not for all of them */
+#define TEST_API_LIMITS_XPATH_OPS               20000
+
+static void
+testApiLimitsErrorFunc(void* ctx ATTRIBUTE_UNUSED, const char* msg ATTRIBUTE_UNUSED, ...) {
+    /* the libxml2 errors are expected */
+}
+
+/* verifies the signature in @doc with the limits, returns 0 if the signature
+ * is valid or a negative value otherwise */
+static int
+testApiLimitsVerify(xmlSecKeysMngrPtr mngr, xmlDocPtr doc, xmlSecSize maxReferences,
+                    xmlSecSize maxTransforms, xmlSecSize maxDigestSize, xmlSecSize maxXPathOps) {
+    xmlSecDSigCtxPtr dsigCtx;
+    xmlNodePtr signNode;
+    int res = -1;
+
+    signNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    if(signNode == NULL) {
+        fprintf(stderr, "Error: unable to find the signature node\n");
+        return(-1);
+    }
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    if(dsigCtx == NULL) {
+        fprintf(stderr, "Error: unable to create the signature context\n");
+        return(-1);
+    }
+    if((xmlSecDSigCtxSetMaxReferences(dsigCtx, maxReferences) < 0) ||
+       (xmlSecTransformCtxSetLimits(&(dsigCtx->transformCtx), maxTransforms, maxDigestSize, maxXPathOps) < 0)) {
+        fprintf(stderr, "Error: unable to set the limits\n");
+        xmlSecDSigCtxDestroy(dsigCtx);
+        return(-1);
+    }
+
+    /* the failures are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    xmlSetGenericErrorFunc(NULL, testApiLimitsErrorFunc);
+    if((xmlSecDSigCtxVerify(dsigCtx, signNode) == 0) && (dsigCtx->status == xmlSecDSigStatusSucceeded)) {
+        res = 0;
+    }
+    xmlSetGenericErrorFunc(NULL, NULL);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    xmlSecDSigCtxDestroy(dsigCtx);
+    return(res);
+}
+
+static int
+testApiLimits(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlDocPtr manifestDoc = NULL;
+    int res = -1;
+
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    doc = testApiDSigParallelCreate(mngr, 0, 0);
+    testApiCheck(doc != NULL);
+    manifestDoc = testApiDSigParallelCreate(mngr, 1, 0);
+    testApiCheck(manifestDoc != NULL);
+
+    /* no limits */
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, 0, 0, 0) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, manifestDoc, 0, 0, 0, 0) == 0);
+
+    /* the <dsig:SignedInfo/> and the <dsig:Manifest/> references are counted */
+    testApiCheck(testApiLimitsVerify(mngr, doc, TEST_API_PARALLEL_REFS_NUMBER, 0, 0, 0) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, doc, TEST_API_PARALLEL_REFS_NUMBER - 1, 0, 0, 0) < 0);
+    testApiCheck(testApiLimitsVerify(mngr, manifestDoc, TEST_API_PARALLEL_REFS_NUMBER + 1, 0, 0, 0) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, manifestDoc, TEST_API_PARALLEL_REFS_NUMBER, 0, 0, 0) < 0);
+
+    /* the limits are applied to each reference chain */
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, TEST_API_LIMITS_TRANSFORMS, 0, 0) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, TEST_API_LIMITS_TRANSFORMS - 1, 0, 0) < 0);
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, 0, TEST_API_LIMITS_DIGEST_SIZE, 0) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, 0, TEST_API_LIMITS_DIGEST_SIZE - 1, 0) < 0);
+#if LIBXML_VERSION >= 20911
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, 0, 0, TEST_API_LIMITS_XPATH_OPS) == 0);
+    testApiCheck(testApiLimitsVerify(mngr, doc, 0, 0, 0, 1) < 0);
+#endif /* LIBXML_VERSION >= 20911 */
+    res = 0;
+
+done:
+    if(manifestDoc != NULL) {
+        xmlFreeDoc(manifestDoc);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiLimits(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * Canonical XML 2.0
+ *
+ *************************************************************************/
+#if !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256)
+
+/* the text in <a/> and <b/> is preserved, the text in <c/> is trimmed */
+static const char testApiC14N2Doc[] =
+    "<Root xmlns=\"urn:r\" xmlns:u=\"urn:u\">\n"
+    "  <!-- comment -->\n"
+    "  <a xml:space=\"preserve\">  keep  <b>  also kept  </b></a>\n"
+    "  <c>  trim &amp; me  </c>\n"
+    "</Root>";
+
+static const char testApiC14N2Trimmed[] =
+    "<Root xmlns=\"urn:r\"><a xml:space=\"preserve\">  keep  <b>  also kept  </b></a>"
+    "<c>trim &amp; me</c></Root>";
+
+/* canonicalizes the whole @doc with the C14N 2.0 transform with @params */
+static int
+testApiC14N2Execute(xmlDocPtr doc, const char* params, xmlBufferPtr out) {
+    xmlSecTransformCtx ctx;
+    xmlDocPtr transformDoc = NULL;
+    xmlSecNodeSetPtr nodes = NULL;
+    char str[512];
+    int ret;
+    int res = -1;
+
+    if(xmlSecTransformCtxInitialize(&ctx) < 0) {
+        fprintf(stderr, "Error: xmlSecTransformCtxInitialize failed\n");
+        return(-1);
+    }
+    snprintf(str, sizeof(str),
+        "<dsig:Transform xmlns:dsig=\"%s\" xmlns:c14n2=\"%s\" Algorithm=\"%s\">%s</dsig:Transform>",
+        (const char*)xmlSecDSigNs, (const char*)xmlSecNsC14N2, (const char*)xmlSecHrefC14N2, params);
+    transformDoc = xmlReadMemory(str, (int)strlen(str), NULL, NULL, 0);
+    testApiCheck(transformDoc != NULL);
+
+    /* the unsupported parameters are expected: don't confuse the log */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    ret = (xmlSecTransformCtxNodeRead(&ctx, xmlDocGetRootElement(transformDoc), xmlSecTransformUsageDSigTransform) != NULL) ? 0 : -1;
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(ret < 0) {
+        goto done;
+    }
+    nodes = xmlSecNodeSetGetChildren(doc, NULL, 1, 0);
+    testApiCheck(nodes != NULL);
+    testApiCheck(xmlSecTransformCtxXmlExecute(&ctx, nodes) == 0);
+    testApiCheck(ctx.result != NULL);
+    testApiCheck(xmlBufferAdd(out, xmlSecBufferGetData(ctx.result), (int)xmlSecBufferGetSize(ctx.result)) == 0);
+    res = 0;
+
+done:
+    xmlSecTransformCtxFinalize(&ctx);
+    if(nodes != NULL) {
+        xmlSecNodeSetDestroy(nodes);
+    }
+    if(transformDoc != NULL) {
+        xmlFreeDoc(transformDoc);
+    }
+    return(res);
+}
+
+/* checks the C14N 2.0 of the whole @doc with @params is @expected */
+static int
+testApiC14N2Check(xmlDocPtr doc, const char* params, const xmlChar* expected) {
+    xmlBufferPtr out;
+    int res = -1;
+
+    out = xmlBufferCreate();
+    testApiCheck(out != NULL);
+    testApiCheck(testApiC14N2Execute(doc, params, out) == 0);
+    if(!xmlStrEqual(xmlBufferContent(out), expected)) {
+        fprintf(stderr, "Error: c14n2 with \"%s\" doesn't match\n--- expected:\n%s\n--- actual:\n%s\n---\n",
+            params, (const char*)expected, (const char*)xmlBufferContent(out));
+        goto done;
+    }
+    res = 0;
+
+done:
+    if(out != NULL) {
+        xmlBufferFree(out);
+    }
+    return(res);
+}
+
+/* checks the C14N 2.0 with @params is the same as the libxml2 exclusive c14n */
+static int
+testApiC14N2CheckExclC14N(xmlDocPtr doc, const char* params, int withComments) {
+    xmlChar* expected = NULL;
+    int res = -1;
+
+    testApiCheck(xmlC14NDocDumpMemory(doc, NULL, XML_C14N_EXCLUSIVE_1_0, NULL, withComments, &expected) >= 0);
+    testApiCheck(testApiC14N2Check(doc, params, expected) == 0);
+    res = 0;
+
+done:
+    if(expected != NULL) {
+        xmlFree(expected);
+    }
+    return(res);
+}
+
+/* writes the enveloped signature template with the C14N 2.0 transform (TrimTextNodes) */
+static int
+testApiC14N2TmplWrite(const char* filename) {
+    xmlDocPtr doc;
+    xmlNodePtr signNode;
+    xmlNodePtr refNode;
+    xmlNodePtr transformNode;
+    xmlNodePtr keyInfoNode;
+    xmlNsPtr ns;
+    int res = -1;
+
+    doc = xmlReadMemory(testApiC14N2Doc, sizeof(testApiC14N2Doc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    signNode = xmlSecTmplSignatureCreate(doc, xmlSecTransformExclC14NId, xmlSecTransformHmacSha256Id, NULL);
+    testApiCheck(signNode != NULL);
+    testApiCheck(xmlAddChild(xmlDocGetRootElement(doc), signNode) != NULL);
+    refNode = xmlSecTmplSignatureAddReference(signNode, xmlSecTransformSha256Id, NULL, BAD_CAST "", NULL);
+    testApiCheck(refNode != NULL);
+    testApiCheck(xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformEnvelopedId) != NULL);
+    transformNode = xmlSecTmplReferenceAddTransform(refNode, xmlSecTransformC14N2Id);
+    testApiCheck(transformNode != NULL);
+    ns = xmlNewNs(transformNode, xmlSecNsC14N2, BAD_CAST "c14n2");
+    testApiCheck(ns != NULL);
+    testApiCheck(xmlNewTextChild(transformNode, ns, xmlSecNodeC14N2TrimTextNodes, BAD_CAST "true") != NULL);
+    keyInfoNode = xmlSecTmplSignatureEnsureKeyInfo(signNode, NULL);
+    testApiCheck(keyInfoNode != NULL);
+    testApiCheck(xmlSecTmplKeyInfoAddKeyName(keyInfoNode, BAD_CAST TEST_API_KEY_NAME) != NULL);
+    testApiCheck(xmlSaveFile(filename, doc) > 0);
+    res = 0;
+
+done:
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+/* verifies the @filename file with the streaming and with the DOM verification,
+ * returns 1 if the signature is valid in both cases, 0 if it is invalid in
+ * both cases or a negative value otherwise */
+static int
+testApiC14N2Verify(xmlSecKeysMngrPtr mngr, const char* filename) {
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr signNode;
+    int streamed, ret;
+    int res = -1;
+
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxVerifyFile(dsigCtx, filename) == 0);
+    streamed = (dsigCtx->status == xmlSecDSigStatusSucceeded) ? 1 : 0;
+    xmlSecDSigCtxDestroy(dsigCtx);
+
+    doc = xmlReadFile(filename, NULL, 0);
+    testApiCheck(doc != NULL);
+    signNode = xmlSecFindNode(xmlDocGetRootElement(doc), xmlSecNodeSignature, xmlSecDSigNs);
+    testApiCheck(signNode != NULL);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxVerify(dsigCtx, signNode) == 0);
+    ret = (dsigCtx->status == xmlSecDSigStatusSucceeded) ? 1 : 0;
+    if(ret != streamed) {
+        fprintf(stderr, "Error: streaming verification result %d doesn't match %d for \"%s\"\n",
+            streamed, ret, filename);
+        goto done;
+    }
+    res = ret;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    return(res);
+}
+
+/* replaces @from with @to in the signed document and verifies the result */
+static int
+testApiC14N2VerifyChanged(xmlSecKeysMngrPtr mngr, xmlSecBufferPtr signedData, const char* filename,
+                          const char* from, const char* to) {
+    xmlSecBuffer buf;
+    const xmlSecByte* data;
+    xmlSecSize size, fromSize, pos;
+    int res = -1;
+
+    testApiCheck(xmlSecBufferInitialize(&buf, 0) == 0);
+    data = xmlSecBufferGetData(signedData);
+    size = xmlSecBufferGetSize(signedData);
+    fromSize = (xmlSecSize)strlen(from);
+    for(pos = 0; (pos + fromSize <= size) && (memcmp(data + pos, from, fromSize) != 0); ++pos);
+    testApiCheck(pos + fromSize <= size);
+    testApiCheck(xmlSecBufferSetData(&buf, data, pos) == 0);
+    testApiCheck(xmlSecBufferAppend(&buf, (const xmlSecByte*)to, (xmlSecSize)strlen(to)) == 0);
+    testApiCheck(xmlSecBufferAppend(&buf, data + pos + fromSize, size - pos - fromSize) == 0);
+    testApiCheck(testApiMappedFileWrite(filename, xmlSecBufferGetData(&buf), xmlSecBufferGetSize(&buf)) == 0);
+    res = testApiC14N2Verify(mngr, filename);
+
+done:
+    xmlSecBufferFinalize(&buf);
+    return(res);
+}
+
+static int
+testApiC14N2(const char* topfolder ATTRIBUTE_UNUSED) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecDSigCtxPtr dsigCtx = NULL;
+    xmlOutputBufferPtr output = NULL;
+    xmlSecBuffer signedData;
+    int signedDataInitialized = 0;
+    xmlDocPtr doc = NULL;
+    xmlBufferPtr out = NULL;
+    char tmplFilename[1024];
+    char signedFilename[1024];
+    char changedFilename[1024];
+    int res = -1;
+
+    snprintf(tmplFilename, sizeof(tmplFilename), "%s/testApi-c14n2-tmpl.xml", testApiTmpFolder);
+    snprintf(signedFilename, sizeof(signedFilename), "%s/testApi-c14n2-signed.xml", testApiTmpFolder);
+    snprintf(changedFilename, sizeof(changedFilename), "%s/testApi-c14n2-changed.xml", testApiTmpFolder);
+
+    /* without the parameters it is the exclusive c14n */
+    doc = xmlReadMemory(testApiC14NDoc, sizeof(testApiC14NDoc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiC14N2CheckExclC14N(doc, "", 0) == 0);
+    testApiCheck(testApiC14N2CheckExclC14N(doc, "<c14n2:IgnoreComments>true</c14n2:IgnoreComments>", 0) == 0);
+    testApiCheck(testApiC14N2CheckExclC14N(doc, "<c14n2:IgnoreComments> false </c14n2:IgnoreComments>", 1) == 0);
+    testApiCheck(testApiC14N2CheckExclC14N(doc,
+        "<c14n2:PrefixRewrite>none</c14n2:PrefixRewrite><c14n2:QNameAware/>", 0) == 0);
+    xmlFreeDoc(doc);
+
+    /* the text nodes are trimmed unless xml:space="preserve" is in scope */
+    doc = xmlReadMemory(testApiC14N2Doc, sizeof(testApiC14N2Doc) - 1, NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    testApiCheck(testApiC14N2Check(doc, "<c14n2:TrimTextNodes>1</c14n2:TrimTextNodes>",
+        BAD_CAST testApiC14N2Trimmed) == 0);
+
+    /* the unsupported or invalid parameters are rejected */
+    out = xmlBufferCreate();
+    testApiCheck(out != NULL);
+    testApiCheck(testApiC14N2Execute(doc, "<c14n2:PrefixRewrite>sequential</c14n2:PrefixRewrite>", out) < 0);
+    testApiCheck(testApiC14N2Execute(doc,
+        "<c14n2:QNameAware><c14n2:Element Name=\"a\" NS=\"urn:r\"/></c14n2:QNameAware>", out) < 0);
+    testApiCheck(testApiC14N2Execute(doc, "<c14n2:TrimTextNodes>yes</c14n2:TrimTextNodes>", out) < 0);
+    testApiCheck(testApiC14N2Execute(doc, "<c14n2:Unknown/>", out) < 0);
+    testApiCheck(xmlBufferLength(out) == 0);
+
+    /* the streaming signature and verification */
+    mngr = testApiKeysMngrCreate(xmlSecKeyDataHmacId, 256);
+    testApiCheck(mngr != NULL);
+    testApiCheck(testApiC14N2TmplWrite(tmplFilename) == 0);
+    output = xmlOutputBufferCreateFilename(signedFilename, NULL, 0);
+    testApiCheck(output != NULL);
+    dsigCtx = xmlSecDSigCtxCreate(mngr);
+    testApiCheck(dsigCtx != NULL);
+    testApiCheck(xmlSecDSigCtxSignFile(dsigCtx, tmplFilename, output) == 0);
+    testApiCheck(xmlOutputBufferClose(output) >= 0);
+    output = NULL;
+    testApiCheck(testApiC14N2Verify(mngr, signedFilename) == 1);
+
+    /* the trimmed whitespace is not signed but the preserved one is */
+    testApiCheck(xmlSecBufferInitialize(&signedData, 0) == 0);
+    signedDataInitialized = 1;
+    testApiCheck(xmlSecBufferReadFile(&signedData, signedFilename) == 0);
+    testApiCheck(testApiC14N2VerifyChanged(mngr, &signedData, changedFilename,
+        "<c>  trim &amp; me  </c>", "<c>\ttrim &amp; me</c>") == 1);
+    testApiCheck(testApiC14N2VerifyChanged(mngr, &signedData, changedFilename,
+        "\n  <c>", "<c>") == 1);
+    testApiCheck(testApiC14N2VerifyChanged(mngr, &signedData, changedFilename,
+        "<c>  trim &amp; me  </c>", "<c>trim &amp;  me</c>") == 0);
+    testApiCheck(testApiC14N2VerifyChanged(mngr, &signedData, changedFilename,
+        "<b>  also kept  </b>", "<b>also kept</b>") == 0);
+    res = 0;
+
+done:
+    if(signedDataInitialized != 0) {
+        xmlSecBufferFinalize(&signedData);
+    }
+    if(output != NULL) {
+        xmlOutputBufferClose(output);
+    }
+    if(dsigCtx != NULL) {
+        xmlSecDSigCtxDestroy(dsigCtx);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(out != NULL) {
+        xmlBufferFree(out);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    (void)remove(tmplFilename);
+    (void)remove(signedFilename);
+    (void)remove(changedFilename);
+    return(res);
+}
+
+#else  /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+static int
+testApiC14N2(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: HMAC or SHA256 support is disabled\n");
+    return(0);
+}
+
+#endif /* !defined(XMLSEC_NO_HMAC) && !defined(XMLSEC_NO_SHA256) */
+
+/**************************************************************************
+ *
+ * OpenSSL X509 store parsed certificates cache
+ *
+ *************************************************************************/
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509)
+
+static const char testApiX509Doc[] =
+    "<dsig:X509Data xmlns:dsig=\"http://www.w3.org/2000/09/xmldsig#\">"
+    "<dsig:X509Certificate/>"
+    "</dsig:X509Data>";
+
+/* reads <dsig:X509Data/> with the @der certificate through the keys manager
+ * (and its X509 store) and checks that the result matches @der */
+static X509*
+testApiOpenSSLCertRead(xmlSecKeysMngrPtr mngr, xmlNodePtr x509DataNode,
+                       const xmlSecByte* der, xmlSecSize derSize) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key = NULL;
+    xmlSecKeyDataPtr data;
+    xmlChar* content = NULL;
+    unsigned char* buf = NULL;
+    X509* cert = NULL;
+    X509* res = NULL;
+    int len;
+
+    if(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr) < 0) {
+        fprintf(stderr, "Error: xmlSecKeyInfoCtxInitialize failed\n");
+        return(NULL);
+    }
+    keyInfoCtx.mode = xmlSecKeyInfoModeRead;
+    keyInfoCtx.flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
+
+    content = xmlSecBase64Encode(der, derSize, 0);
+    testApiCheck(content != NULL);
+    xmlNodeSetContent(xmlSecGetNextElementNode(x509DataNode->children), content);
+
+    key = xmlSecKeyCreate();
+    testApiCheck(key != NULL);
+    testApiCheck(xmlSecKeyDataXmlRead(xmlSecOpenSSLKeyDataX509Id, key, x509DataNode, &keyInfoCtx) == 0);
+    data = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataX509Id);
+    testApiCheck(data != NULL);
+    testApiCheck(xmlSecOpenSSLKeyDataX509GetCertsSize(data) == 1);
+    cert = xmlSecOpenSSLKeyDataX509GetCert(data, 0);
+    testApiCheck(cert != NULL);
+
+    len = i2d_X509(cert, &buf);
+    testApiCheck((len > 0) && ((xmlSecSize)len == derSize) && (memcmp(buf, der, derSize) == 0));
+    testApiCheck(X509_up_ref(cert) == 1);
+    res = cert;
+
+done:
+    if(buf != NULL) {
+        OPENSSL_free(buf);
+    }
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    if(content != NULL) {
+        xmlFree(content);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(res);
+}
+
+static int
+testApiOpenSSLCertsCache(const char* topfolder) {
+    char filename[1024];
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlDocPtr doc = NULL;
+    xmlNodePtr node;
+    xmlSecBufferPtr der = NULL;
+    xmlSecBufferPtr tmp = NULL;
+    xmlSecByte* data;
+    xmlSecSize size;
+    X509* cert = NULL;
+    X509* cert2 = NULL;
+    X509* changed = NULL;
+    X509* other;
+    xmlSecSize ii;
+    int res = -1;
+
+    snprintf(filename, sizeof(filename), "%s/keys/rsacert.der", topfolder);
+    der = xmlSecBufferCreate(0);
+    testApiCheck(der != NULL);
+    testApiCheck(xmlSecBufferReadFile(der, filename) == 0);
+    testApiCheck(xmlSecBufferGetSize(der) > 2);
+    size = xmlSecBufferGetSize(der);
+
+    /* a separate copy of the DER: the cache must compare the bytes */
+    tmp = xmlSecBufferCreate(size);
+    testApiCheck(tmp != NULL);
+    testApiCheck(xmlSecBufferSetData(tmp, xmlSecBufferGetData(der), size) == 0);
+    data = xmlSecBufferGetData(tmp);
+
+    mngr = xmlSecKeysMngrCreate();
+    testApiCheck(mngr != NULL);
+    testApiCheck(xmlSecCryptoAppDefaultKeysMngrInit(mngr) == 0);
+    testApiCheck(xmlSecKeysMngrGetDataStore(mngr, xmlSecOpenSSLX509StoreId) != NULL);
+
+    doc = xmlReadMemory(testApiX509Doc, (int)strlen(testApiX509Doc), NULL, NULL, 0);
+    testApiCheck(doc != NULL);
+    node = xmlDocGetRootElement(doc);
+
+    /* the same DER returns the cached certificate */
+    cert = testApiOpenSSLCertRead(mngr, node, xmlSecBufferGetData(der), size);
+    testApiCheck(cert != NULL);
+    cert2 = testApiOpenSSLCertRead(mngr, node, data, size);
+    testApiCheck(cert2 != NULL);
+    testApiCheck(cert2 == cert);
+    X509_free(cert2);
+    cert2 = NULL;
+
+    /* the changed bytes (in the signature value) are parsed again */
+    data[size - 1] ^= 0x01;
+    changed = testApiOpenSSLCertRead(mngr, node, data, size);
+    testApiCheck(changed != NULL);
+    testApiCheck(changed != cert);
+    cert2 = testApiOpenSSLCertRead(mngr, node, data, size);
+    testApiCheck(cert2 == changed);
+    X509_free(cert2);
+    cert2 = NULL;
+
+    /* the unchanged DER is still cached */
+    cert2 = testApiOpenSSLCertRead(mngr, node, xmlSecBufferGetData(der), size);
+    testApiCheck(cert2 == cert);
+    X509_free(cert2);
+    cert2 = NULL;
+
+    /* many different certificates evict the cached one (we keep our
+     * reference so the new object can not reuse the same memory) */
+    for(ii = 0; ii < 1024; ++ii) {
+        memcpy(data, xmlSecBufferGetData(der), size);
+        data[size - 1] ^= (xmlSecByte)((ii + 1) & 0xFF);
+        data[size - 2] ^= (xmlSecByte)(((ii + 1) >> 8) & 0xFF);
+        other = testApiOpenSSLCertRead(mngr, node, data, size);
+        testApiCheck(other != NULL);
+        testApiCheck(other != cert);
+        X509_free(other);
+    }
+    cert2 = testApiOpenSSLCertRead(mngr, node, xmlSecBufferGetData(der), size);
+    testApiCheck(cert2 != NULL);
+    testApiCheck(cert2 != cert);
+
+    /* and it is cached again */
+    other = testApiOpenSSLCertRead(mngr, node, xmlSecBufferGetData(der), size);
+    testApiCheck(other == cert2);
+    X509_free(other);
+    res = 0;
+
+done:
+    if(cert != NULL) {
+        X509_free(cert);
+    }
+    if(cert2 != NULL) {
+        X509_free(cert2);
+    }
+    if(changed != NULL) {
+        X509_free(changed);
+    }
+    if(doc != NULL) {
+        xmlFreeDoc(doc);
+    }
+    if(mngr != NULL) {
+        xmlSecKeysMngrDestroy(mngr);
+    }
+    if(tmp != NULL) {
+        xmlSecBufferDestroy(tmp);
+    }
+    if(der != NULL) {
+        xmlSecBufferDestroy(der);
+    }
+    return(res);
+}
+
+/* copies @src and then @suffix to @dst (an existing file is truncated, its inode stays the same) */
+static int
+testApiCopyFile(const char* src, const char* dst, const char* suffix) {
+    char buf[4096];
+    FILE* in;
+    FILE* out;
+    size_t size;
+    int res = 0;
+
+    in = fopen(src, "rb");
+    if(in == NULL) {
+        fprintf(stderr, "Error: unable to open \"%s\"\n", src);
+        return(-1);
+    }
+    out = fopen(dst, "wb");
+    if(out == NULL) {
+        fprintf(stderr, "Error: unable to open \"%s\"\n", dst);
+        fclose(in);
+        return(-1);
+    }
+    while((size = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if(fwrite(buf, 1, size, out) != size) {
+            res = -1;
+            break;
+        }
+    }
+    if((res == 0) && (suffix != NULL) && (fputs(suffix, out) < 0)) {
+        res = -1;
+    }
+    fclose(in);
+    if(fclose(out) != 0) {
+        res = -1;
+    }
+    if(res < 0) {
+        fprintf(stderr, "Error: unable to write \"%s\"\n", dst);
+    }
+    return(res);
+}
+
+/* sets the file modification time to @sec seconds and @nsec nanoseconds */
+static int
+testApiSetMTime(const char* filename, long sec, long nsec) {
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    struct timespec times[2];
+
+    times[0].tv_sec = sec;
+    times[0].tv_nsec = nsec;
+    times[1].tv_sec = sec;
+    times[1].tv_nsec = nsec;
+    if(utimensat(AT_FDCWD, filename, times, 0) != 0) {
+        fprintf(stderr, "Error: unable to set the \"%s\" modification time\n", filename);
+        return(-1);
+    }
+    return(0);
+#else  /* HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC */
+    (void)filename;
+    (void)sec;
+    (void)nsec;
+    return(0);
+#endif /* HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC */
+}
+
+/* loads the password protected PEM key and returns its (not owned) EVP_PKEY
+ * pointer to compare with other loads: the cached keys share the OpenSSL key */
+static EVP_PKEY*
+testApiOpenSSLKeyLoad(const char* filename, xmlSecKeyPtr* key) {
+    EVP_PKEY* pKey;
+
+    (*key) = xmlSecOpenSSLAppKeyLoad(filename, xmlSecKeyDataFormatPem, "secret123", NULL, NULL);
+    if((*key) == NULL) {
+        fprintf(stderr, "Error: unable to load the key \"%s\"\n", filename);
+        return(NULL);
+    }
+    pKey = xmlSecOpenSSLEvpKeyDataGetEvp(xmlSecKeyGetValue(*key));
+    if(pKey == NULL) {
+        fprintf(stderr, "Error: the key \"%s\" has no EVP_PKEY\n", filename);
+    }
+    return(pKey);
+}
+
+static int
+testApiOpenSSLKeysCache(const char* topfolder) {
+    char src[1024];
+    char filename[1024];
+    xmlSecKeyPtr key1 = NULL;
+    xmlSecKeyPtr key2 = NULL;
+    EVP_PKEY* pKey1;
+    EVP_PKEY* pKey2;
+    int res = -1;
+
+    snprintf(src, sizeof(src), "%s/keys/cakey.pem", topfolder);
+    snprintf(filename, sizeof(filename), "%s/testApi-keys-cache.pem", testApiTmpFolder);
+    (void)remove(filename);
+    testApiCheck(testApiCopyFile(src, filename, NULL) == 0);
+    testApiCheck(testApiSetMTime(filename, 1000000000L, 100) == 0);
+
+    testApiCheck(xmlSecOpenSSLAppKeysCacheSetEnabled(1) == 0);
+
+    /* the unchanged file is loaded from the cache */
+    pKey1 = testApiOpenSSLKeyLoad(filename, &key1);
+    testApiCheck(pKey1 != NULL);
+    pKey2 = testApiOpenSSLKeyLoad(filename, &key2);
+    testApiCheck(pKey2 == pKey1);
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    /* the same second, another nanosecond: the file is loaded again */
+    testApiCheck(testApiSetMTime(filename, 1000000000L, 200) == 0);
+    pKey2 = testApiOpenSSLKeyLoad(filename, &key2);
+    testApiCheck(pKey2 != NULL);
+    testApiCheck(pKey2 != pKey1);
+    xmlSecKeyDestroy(key1);
+    key1 = key2;
+    pKey1 = pKey2;
+    key2 = NULL;
+
+    pKey2 = testApiOpenSSLKeyLoad(filename, &key2);
+    testApiCheck(pKey2 == pKey1);
+    xmlSecKeyDestroy(key2);
+    key2 = NULL;
+#endif /* HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC */
+
+    /* the rewritten file with the same inode and modification time: the size differs */
+    testApiCheck(testApiCopyFile(src, filename, "\n") == 0);
+    testApiCheck(testApiSetMTime(filename, 1000000000L, 200) == 0);
+    pKey2 = testApiOpenSSLKeyLoad(filename, &key2);
+    testApiCheck(pKey2 != NULL);
+    testApiCheck(pKey2 != pKey1);
+    res = 0;
+
+done:
+    xmlSecOpenSSLAppKeysCacheSetEnabled(0);
+    if(key1 != NULL) {
+        xmlSecKeyDestroy(key1);
+    }
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    (void)remove(filename);
+    return(res);
+}
+
+#else  /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509) */
+
+static int
+testApiOpenSSLCertsCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl X509 support is not linked\n");
+    return(0);
+}
+
+static int
+testApiOpenSSLKeysCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl X509 support is not linked\n");
+    return(0);
+}
+
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509) */
+
+/**************************************************************************
+ *
+ * OpenSSL X509 store: verification results cache, certs and CRLs indexes
+ *
+ *************************************************************************/
+#if defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509)
+
+/* the test certificates are valid from 2014-05-23 till 2114-04-29 */
+#define TEST_API_X509_TIME_VALID                ((time_t)1401667200)    /* 2014-06-02 00:00:00 UTC */
+#define TEST_API_X509_TIME_NOT_YET_VALID        ((time_t)1388534400)    /* 2014-01-01 00:00:00 UTC */
+
+/* reads the certificate from the "keys/@name.pem" file */
+static X509*
+testApiOpenSSLX509Load(const char* topfolder, const char* name) {
+    char filename[1024];
+    X509* cert;
+    BIO* bio;
+
+    snprintf(filename, sizeof(filename), "%s/keys/%s.pem", topfolder, name);
+    bio = BIO_new_file(filename, "r");
+    if(bio == NULL) {
+        fprintf(stderr, "Error: unable to open the file \"%s\"\n", filename);
+        return(NULL);
+    }
+    cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    if(cert == NULL) {
+        fprintf(stderr, "Error: unable to read the certificate from the file \"%s\"\n", filename);
+        return(NULL);
+    }
+    return(cert);
+}
+
+/* reads the certificate from the "keys/@name.pem" file and adopts it in the @store */
+static int
+testApiOpenSSLX509Adopt(xmlSecKeyDataStorePtr store, const char* topfolder,
+                        const char* name, xmlSecKeyDataType type) {
+    X509* cert;
+
+    cert = testApiOpenSSLX509Load(topfolder, name);
+    if(cert == NULL) {
+        return(-1);
+    }
+    if(xmlSecOpenSSLX509StoreAdoptCert(store, cert, type) < 0) {
+        fprintf(stderr, "Error: unable to adopt the certificate \"%s\"\n", name);
+        X509_free(cert);
+        return(-1);
+    }
+    return(0);
+}
+
+/* creates the X509 store with the trusted root certificate */
+static xmlSecKeyDataStorePtr
+testApiOpenSSLX509StoreCreate(const char* topfolder) {
+    xmlSecKeyDataStorePtr store;
+
+    store = xmlSecKeyDataStoreCreate(xmlSecOpenSSLX509StoreId);
+    if(store == NULL) {
+        fprintf(stderr, "Error: unable to create the X509 store\n");
+        return(NULL);
+    }
+    if(testApiOpenSSLX509Adopt(store, topfolder, "cacert", xmlSecKeyDataTypeTrusted) < 0) {
+        xmlSecKeyDataStoreDestroy(store);
+        return(NULL);
+    }
+    return(store);
+}
+
+/* creates the CRL issued (and signed) by the "keys/@ca{cert,key}.pem" (the
+ * key password is @pwd) that revokes @cert (if not NULL) */
+static X509_CRL*
+testApiOpenSSLCrlCreate(const char* topfolder, const char* ca, const char* pwd, X509* cert) {
+    char filename[1024];
+    X509* issuer = NULL;
+    EVP_PKEY* pkey = NULL;
+    X509_CRL* crl = NULL;
+    X509_REVOKED* revoked = NULL;
+    ASN1_TIME* tm = NULL;
+    X509_CRL* res = NULL;
+    BIO* bio;
+
+    snprintf(filename, sizeof(filename), "%scert", ca);
+    issuer = testApiOpenSSLX509Load(topfolder, filename);
+    testApiCheck(issuer != NULL);
+    snprintf(filename, sizeof(filename), "%s/keys/%skey.pem", topfolder, ca);
+    bio = BIO_new_file(filename, "r");
+    testApiCheck(bio != NULL);
+    pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, (void*)pwd);
+    BIO_free(bio);
+    testApiCheck(pkey != NULL);
+
+    crl = X509_CRL_new();
+    testApiCheck(crl != NULL);
+    testApiCheck(X509_CRL_set_version(crl, 1) == 1);
+    testApiCheck(X509_CRL_set_issuer_name(crl, X509_get_subject_name(issuer)) == 1);
+    tm = ASN1_TIME_new();
+    testApiCheck(tm != NULL);
+    testApiCheck(ASN1_TIME_set_string(tm, "20140524000000Z") == 1);
+    testApiCheck(X509_CRL_set1_lastUpdate(crl, tm) == 1);
+    testApiCheck(ASN1_TIME_set_string(tm, "21140101000000Z") == 1);
+    testApiCheck(X509_CRL_set1_nextUpdate(crl, tm) == 1);
+
+    if(cert != NULL) {
+        revoked = X509_REVOKED_new();
+        testApiCheck(revoked != NULL);
+        testApiCheck(X509_REVOKED_set_serialNumber(revoked, X509_get_serialNumber(cert)) == 1);
+        testApiCheck(ASN1_TIME_set_string(tm, "20140525000000Z") == 1);
+        testApiCheck(X509_REVOKED_set_revocationDate(revoked, tm) == 1);
+        testApiCheck(X509_CRL_add0_revoked(crl, revoked) == 1);
+        revoked = NULL;
+    }
+    testApiCheck(X509_CRL_sort(crl) == 1);
+    testApiCheck(X509_CRL_sign(crl, pkey, EVP_sha256()) > 0);
+    res = crl;
+    crl = NULL;
+
+done:
+    if(revoked != NULL) {
+        X509_REVOKED_free(revoked);
+    }
+    if(tm != NULL) {
+        ASN1_TIME_free(tm);
+    }
+    if(crl != NULL) {
+        X509_CRL_free(crl);
+    }
+    if(pkey != NULL) {
+        EVP_PKEY_free(pkey);
+    }
+    if(issuer != NULL) {
+        X509_free(issuer);
+    }
+    return(res);
+}
+
+/* verifies @certs at @verificationTime, returns 1 if @expected is verified,
+ * 0 if another or no certificate is verified or a negative value if an error
+ * occurs; @hit is set to 1 if the result came from the verification results
+ * cache */
+static int
+testApiOpenSSLX509Verify(xmlSecKeyDataStorePtr store, STACK_OF(X509)* certs,
+                         STACK_OF(X509_CRL)* crls, X509* expected,
+                         time_t verificationTime, int* hit) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecSize hits0;
+    X509* cert;
+    int res;
+
+    if(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL) < 0) {
+        fprintf(stderr, "Error: xmlSecKeyInfoCtxInitialize failed\n");
+        return(-1);
+    }
+    keyInfoCtx.certsVerificationTime = verificationTime;
+
+    /* the failures are expected: collect the errors instead of printing */
+    if(xmlSecErrorsStackStart() < 0) {
+        fprintf(stderr, "Error: unable to start the errors stack\n");
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        return(-1);
+    }
+    hits0 = xmlSecMetricsGet(xmlSecMetricX509CacheHits);
+    cert = xmlSecOpenSSLX509StoreVerify(store, certs, crls, &keyInfoCtx);
+    (*hit) = (xmlSecMetricsGet(xmlSecMetricX509CacheHits) != hits0) ? 1 : 0;
+    xmlSecErrorsStackStop();
+
+    res = ((cert != NULL) && (X509_cmp(cert, expected) == 0)) ? 1 : 0;
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(res);
+}
+
+static int
+testApiOpenSSLVerifyCache(const char* topfolder) {
+    xmlSecKeyDataStorePtr store = NULL;
+    STACK_OF(X509)* certs = NULL;
+    X509* cert = NULL;
+    X509* rsacert;
+    X509_CRL* crl = NULL;
+    int hit = 0;
+    int res = -1;
+
+    xmlSecMetricsSetEnabled(1);
+    store = testApiOpenSSLX509StoreCreate(topfolder);
+    testApiCheck(store != NULL);
+    certs = sk_X509_new_null();
+    testApiCheck(certs != NULL);
+    cert = testApiOpenSSLX509Load(topfolder, "rsacert");
+    testApiCheck((cert != NULL) && (sk_X509_push(certs, cert) > 0));
+    rsacert = cert;
+    cert = testApiOpenSSLX509Load(topfolder, "ca2cert");
+    testApiCheck((cert != NULL) && (sk_X509_push(certs, cert) > 0));
+    cert = NULL;
+
+    /* the first verification is cached */
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 1);
+
+    /* the cached chain is not valid at this time */
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_NOT_YET_VALID, &hit) == 0);
+    testApiCheck(hit == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 1);
+
+    /* the different untrusted certificates set */
+    cert = testApiOpenSSLX509Load(topfolder, "dsacert");
+    testApiCheck((cert != NULL) && (sk_X509_push(certs, cert) > 0));
+    cert = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 0);
+    X509_free(sk_X509_pop(certs));
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 1);
+
+    /* the new certificate in the store flushes the cache */
+    testApiCheck(testApiOpenSSLX509Adopt(store, topfolder, "largersacert", xmlSecKeyDataTypeNone) == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 1);
+
+    /* the new CRL in the store flushes the cache */
+    crl = testApiOpenSSLCrlCreate(topfolder, "ca", "secret123", NULL);
+    testApiCheck(crl != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreAdoptCrl(store, crl) == 0);
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+    testApiCheck(hit == 1);
+
+    /* the revoked certificate is not verified */
+    crl = testApiOpenSSLCrlCreate(topfolder, "ca2", NULL, rsacert);
+    testApiCheck(crl != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreAdoptCrl(store, crl) == 0);
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 0);
+    testApiCheck(hit == 0);
+    res = 0;
+
+done:
+    xmlSecMetricsSetEnabled(0);
+    if(crl != NULL) {
+        X509_CRL_free(crl);
+    }
+    if(cert != NULL) {
+        X509_free(cert);
+    }
+    if(certs != NULL) {
+        sk_X509_pop_free(certs, X509_free);
+    }
+    if(store != NULL) {
+        xmlSecKeyDataStoreDestroy(store);
+    }
+    return(res);
+}
+
+/* writes @nm in the RFC2253 format, in the reverse (RFC2253) or in the
+ * direct (@reverse is 0) entries order */
+static xmlChar*
+testApiOpenSSLX509NameWrite(X509_NAME* nm, int reverse) {
+    unsigned long flags = XN_FLAG_RFC2253;
+    xmlChar* res = NULL;
+    char* data = NULL;
+    long len;
+    BIO* bio;
+
+    if(reverse == 0) {
+        flags &= ~XN_FLAG_DN_REV;
+    }
+    bio = BIO_new(BIO_s_mem());
+    if(bio == NULL) {
+        return(NULL);
+    }
+    if(X509_NAME_print_ex(bio, nm, 0, flags) > 0) {
+        len = BIO_get_mem_data(bio, &data);
+        if((data != NULL) && (len > 0)) {
+            res = xmlStrndup(BAD_CAST data, (int)len);
+        }
+    }
+    BIO_free(bio);
+    return(res);
+}
+
+/* returns 1 if the @store lookups by @cert subject name (in both entries
+ * orders), issuer name and serial number or SKI find @expected, 0 if another
+ * or no cert is found or a negative value if an error occurs */
+static int
+testApiOpenSSLX509FindCheck(xmlSecKeyDataStorePtr store, X509* cert, X509* expected) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    const ASN1_OCTET_STRING* keyId;
+    xmlChar* subjectName = NULL;
+    xmlChar* issuerName = NULL;
+    xmlChar* issuerSerial = NULL;
+    xmlChar* ski = NULL;
+    BIGNUM* bn = NULL;
+    char* serial = NULL;
+    int reverse;
+    int res = -1;
+
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL) == 0);
+
+    for(reverse = 0; reverse <= 1; ++reverse) {
+        subjectName = testApiOpenSSLX509NameWrite(X509_get_subject_name(cert), reverse);
+        testApiCheck(subjectName != NULL);
+        if(xmlSecOpenSSLX509StoreFindCert(store, subjectName, NULL, NULL, NULL, &keyInfoCtx) != expected) {
+            fprintf(stderr, "Error: unexpected lookup result for subject \"%s\"\n", subjectName);
+            res = 0;
+            goto done;
+        }
+        xmlFree(subjectName);
+        subjectName = NULL;
+    }
+
+    bn = ASN1_INTEGER_to_BN(X509_get_serialNumber(cert), NULL);
+    testApiCheck(bn != NULL);
+    serial = BN_bn2dec(bn);
+    testApiCheck(serial != NULL);
+    issuerSerial = xmlStrdup(BAD_CAST serial);
+    testApiCheck(issuerSerial != NULL);
+    issuerName = testApiOpenSSLX509NameWrite(X509_get_issuer_name(cert), 1);
+    testApiCheck(issuerName != NULL);
+    if(xmlSecOpenSSLX509StoreFindCert(store, NULL, issuerName, issuerSerial, NULL, &keyInfoCtx) != expected) {
+        fprintf(stderr, "Error: unexpected lookup result for issuer \"%s\" and serial \"%s\"\n",
+            issuerName, issuerSerial);
+        res = 0;
+        goto done;
+    }
+
+    /* the SKI is base64 decoded in place */
+    keyId = X509_get0_subject_key_id(cert);
+    testApiCheck(keyId != NULL);
+    ski = xmlSecBase64Encode(ASN1_STRING_get0_data(keyId), (xmlSecSize)ASN1_STRING_length(keyId), 0);
+    testApiCheck(ski != NULL);
+    if(xmlSecOpenSSLX509StoreFindCert(store, NULL, NULL, NULL, ski, &keyInfoCtx) != expected) {
+        fprintf(stderr, "Error: unexpected lookup result for SKI\n");
+        res = 0;
+        goto done;
+    }
+    res = 1;
+
+done:
+    if(ski != NULL) {
+        xmlFree(ski);
+    }
+    if(issuerName != NULL) {
+        xmlFree(issuerName);
+    }
+    if(issuerSerial != NULL) {
+        xmlFree(issuerSerial);
+    }
+    if(serial != NULL) {
+        OPENSSL_free(serial);
+    }
+    if(bn != NULL) {
+        BN_free(bn);
+    }
+    if(subjectName != NULL) {
+        xmlFree(subjectName);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(res);
+}
+
+static int
+testApiOpenSSLCertsIndex(const char* topfolder) {
+    static const char* names[] = {
+        "rsacert", "dsacert", "ca2cert", "largersacert", "ecdsa-secp256r1-cert"
+    };
+    X509* certs[sizeof(names) / sizeof(names[0])];
+    xmlSecKeyDataStorePtr store = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlChar* subjectName = NULL;
+    xmlChar serial[] = "1";
+    X509* cacert = NULL;
+    X509* cert = NULL;
+    size_t ii;
+    int res = -1;
+
+    testApiCheck(xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL) == 0);
+    store = testApiOpenSSLX509StoreCreate(topfolder);
+    testApiCheck(store != NULL);
+    for(ii = 0; ii < sizeof(names) / sizeof(names[0]); ++ii) {
+        /* the store owns the adopted cert */
+        certs[ii] = testApiOpenSSLX509Load(topfolder, names[ii]);
+        testApiCheck(certs[ii] != NULL);
+        testApiCheck(xmlSecOpenSSLX509StoreAdoptCert(store, certs[ii], xmlSecKeyDataTypeNone) == 0);
+    }
+
+    /* every untrusted cert is found by any of its ids */
+    for(ii = 0; ii < sizeof(names) / sizeof(names[0]); ++ii) {
+        testApiCheck(testApiOpenSSLX509FindCheck(store, certs[ii], certs[ii]) == 1);
+    }
+
+    /* the trusted cert is not in the untrusted certs index */
+    cacert = testApiOpenSSLX509Load(topfolder, "cacert");
+    testApiCheck(cacert != NULL);
+    testApiCheck(testApiOpenSSLX509FindCheck(store, cacert, NULL) == 1);
+
+    /* the unknown serial number is not found */
+    subjectName = testApiOpenSSLX509NameWrite(X509_get_issuer_name(certs[0]), 1);
+    testApiCheck(subjectName != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreFindCert(store, NULL, subjectName, serial, NULL, &keyInfoCtx) == NULL);
+
+    /* the first cert added with the same ids wins */
+    cert = X509_dup(certs[0]);
+    testApiCheck(cert != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreAdoptCert(store, cert, xmlSecKeyDataTypeNone) == 0);
+    testApiCheck(testApiOpenSSLX509FindCheck(store, cert, certs[0]) == 1);
+    cert = NULL;
+    res = 0;
+
+done:
+    if(subjectName != NULL) {
+        xmlFree(subjectName);
+    }
+    if(cert != NULL) {
+        X509_free(cert);
+    }
+    if(cacert != NULL) {
+        X509_free(cacert);
+    }
+    if(store != NULL) {
+        xmlSecKeyDataStoreDestroy(store);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(res);
+}
+
+static int
+testApiOpenSSLCrlsIndex(const char* topfolder) {
+    xmlSecKeyDataStorePtr store = NULL;
+    STACK_OF(X509)* certs = NULL;
+    STACK_OF(X509)* dsacerts = NULL;
+    STACK_OF(X509_CRL)* crls = NULL;
+    STACK_OF(X509_CRL)* badCrls = NULL;
+    const ASN1_BIT_STRING* sig = NULL;
+    const X509_ALGOR* alg = NULL;
+    X509_CRL* crl = NULL;
+    X509* cert = NULL;
+    X509* rsacert;
+    X509* dsacert;
+    X509* ca2cert;
+    int hit = 0;
+    int res = -1;
+
+    store = testApiOpenSSLX509StoreCreate(topfolder);
+    testApiCheck(store != NULL);
+    certs = sk_X509_new_null();
+    testApiCheck(certs != NULL);
+    dsacerts = sk_X509_new_null();
+    testApiCheck(dsacerts != NULL);
+    cert = testApiOpenSSLX509Load(topfolder, "rsacert");
+    testApiCheck((cert != NULL) && (sk_X509_push(certs, cert) > 0));
+    rsacert = cert;
+    cert = testApiOpenSSLX509Load(topfolder, "dsacert");
+    testApiCheck((cert != NULL) && (sk_X509_push(dsacerts, cert) > 0));
+    dsacert = cert;
+    cert = testApiOpenSSLX509Load(topfolder, "ca2cert");
+    testApiCheck((cert != NULL) && (sk_X509_push(certs, cert) > 0));
+    ca2cert = cert;
+    cert = NULL;
+    testApiCheck(X509_up_ref(ca2cert) == 1);
+    testApiCheck(sk_X509_push(dsacerts, ca2cert) > 0);
+
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+
+    /* the inline CRL is verified with the trusted certs: the root CA revokes
+     * the intermediate CA cert */
+    crls = sk_X509_CRL_new_null();
+    testApiCheck(crls != NULL);
+    crl = testApiOpenSSLCrlCreate(topfolder, "ca", "secret123", ca2cert);
+    testApiCheck((crl != NULL) && (sk_X509_CRL_push(crls, crl) > 0));
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, crls, rsacert, TEST_API_X509_TIME_VALID, &hit) == 0);
+
+    /* the inline CRL with the broken signature is ignored even after the same
+     * (but correctly signed) CRL was verified */
+    badCrls = sk_X509_CRL_new_null();
+    testApiCheck(badCrls != NULL);
+    crl = X509_CRL_dup(sk_X509_CRL_value(crls, 0));
+    testApiCheck((crl != NULL) && (sk_X509_CRL_push(badCrls, crl) > 0));
+    X509_CRL_get0_signature(crl, &sig, &alg);
+    testApiCheck((sig != NULL) && (ASN1_STRING_length(sig) > 0));
+    ((unsigned char*)ASN1_STRING_get0_data(sig))[0] ^= 0xFF;
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, badCrls, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+
+    /* the already verified inline CRL is still honoured */
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, crls, rsacert, TEST_API_X509_TIME_VALID, &hit) == 0);
+
+    /* the store CRLs are found by the cert issuer */
+    crl = testApiOpenSSLCrlCreate(topfolder, "ca2", NULL, dsacert);
+    testApiCheck(crl != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreAdoptCrl(store, crl) == 0);
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, dsacerts, NULL, dsacert, TEST_API_X509_TIME_VALID, &hit) == 0);
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 1);
+
+    crl = testApiOpenSSLCrlCreate(topfolder, "ca", "secret123", ca2cert);
+    testApiCheck(crl != NULL);
+    testApiCheck(xmlSecOpenSSLX509StoreAdoptCrl(store, crl) == 0);
+    crl = NULL;
+    testApiCheck(testApiOpenSSLX509Verify(store, certs, NULL, rsacert, TEST_API_X509_TIME_VALID, &hit) == 0);
+    res = 0;
+
+done:
+    if(crl != NULL) {
+        X509_CRL_free(crl);
+    }
+    if(badCrls != NULL) {
+        sk_X509_CRL_pop_free(badCrls, X509_CRL_free);
+    }
+    if(crls != NULL) {
+        sk_X509_CRL_pop_free(crls, X509_CRL_free);
+    }
+    if(cert != NULL) {
+        X509_free(cert);
+    }
+    if(dsacerts != NULL) {
+        sk_X509_pop_free(dsacerts, X509_free);
+    }
+    if(certs != NULL) {
+        sk_X509_pop_free(certs, X509_free);
+    }
+    if(store != NULL) {
+        xmlSecKeyDataStoreDestroy(store);
+    }
+    return(res);
+}
+
+#else  /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509) */
+
+static int
+testApiOpenSSLVerifyCache(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl X509 support is not linked\n");
+    return(0);
+}
+
+static int
+testApiOpenSSLCertsIndex(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl X509 support is not linked\n");
+    return(0);
+}
+
+static int
+testApiOpenSSLCrlsIndex(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl X509 support is not linked\n");
+    return(0);
+}
+
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && !defined(XMLSEC_NO_X509) */
+
+/**************************************************************************
+ *
+ * OpenSSL remote signer: the fake signing service
+ *
+ *************************************************************************/
+#if defined(XMLSEC_CRYPTO_OPENSSL) && defined(XMLSEC_OPENSSL_REMOTE) && !defined(XMLSEC_NO_HMAC)
+
+#define TEST_API_REMOTE_MAX_CLIENTS             8
+#define TEST_API_REMOTE_MAX_LINE                1024
+#define TEST_API_REMOTE_TIMEOUT                 5000
+#define TEST_API_REMOTE_GRACE                   100
+#define TEST_API_REMOTE_FAIL_KEY                "fail-key"
+#define TEST_API_REMOTE_ALGORITHM               "http://www.w3.org/2001/04/xmldsig-more#rsa-sha256"
+
+/* the fake service collects @batch requests and replies to them in the
+ * reverse order: "OK" with the request data or "FAIL" for the
+ * TEST_API_REMOTE_FAIL_KEY; it closes the connection without replying
+ * after @dropAfter requests (if not 0) */
+typedef struct _testApiRemoteServer {
+    int                 listenFd;
+    xmlSecSize          batch;
+    xmlSecSize          dropAfter;
+    xmlSecSize          expected;
+    xmlSecSize          maxOutstanding;
+    int                 res;
+} testApiRemoteServer;
+
+typedef struct _testApiRemoteClient {
+    xmlSecKeyPtr        key;
+    xmlSecByte          in[32];
+    xmlSecBuffer        out;
+    int                 outInitialized;
+    int                 res;
+} testApiRemoteClient;
+
+typedef struct _testApiRemoteTask {
+    testApiRemoteServer* server;
+    testApiRemoteClient* client;
+} testApiRemoteTask;
+
+/* replies to the @linesNum requests in @lines in the reverse order */
+static int
+testApiRemoteServerReply(int fd, char** lines, xmlSecSize linesNum) {
+    char reply[TEST_API_REMOTE_MAX_LINE + 32];
+    char* tokens[5];
+    char* cur;
+    xmlSecSize ii, jj;
+    size_t len;
+
+    for(ii = linesNum; ii > 0; --ii) {
+        /* "<id> SIGN <key name> <algorithm href> <base64 digest>" */
+        for(cur = lines[ii - 1], jj = 0; jj < sizeof(tokens) / sizeof(tokens[0]); ++jj) {
+            tokens[jj] = cur;
+            cur = (cur != NULL) ? strchr(cur, ' ') : NULL;
+            if(cur != NULL) {
+                (*(cur++)) = '\0';
+            }
+        }
+        if(tokens[4] == NULL) {
+            fprintf(stderr, "Error: unexpected remote signer request\n");
+            return(-1);
+        }
+        if(strcmp(tokens[2], TEST_API_REMOTE_FAIL_KEY) == 0) {
+            snprintf(reply, sizeof(reply), "%s FAIL unknown key\n", tokens[0]);
+        } else {
+            snprintf(reply, sizeof(reply), "%s OK %s\n", tokens[0], tokens[4]);
+        }
+        len = strlen(reply);
+        if(send(fd, reply, len, 0) != (ssize_t)len) {
+            fprintf(stderr, "Error: unable to send the remote signer reply\n");
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static void
+testApiRemoteServerRun(testApiRemoteServer* server) {
+    char buf[TEST_API_REMOTE_MAX_LINE];
+    char* lines[TEST_API_REMOTE_MAX_CLIENTS];
+    xmlSecSize linesNum = 0;
+    xmlSecSize received = 0;
+    xmlSecSize replied = 0;
+    struct pollfd pfd;
+    size_t used = 0;
+    char* eol;
+    ssize_t len;
+    int fd;
+    int ret;
+
+    server->res = -1;
+    fd = accept(server->listenFd, NULL, NULL);
+    if(fd < 0) {
+        fprintf(stderr, "Error: unable to accept the remote signer connection\n");
+        return;
+    }
+    while((server->expected == 0) || (replied < server->expected)) {
+        /* the full batch is replied to when nothing else comes */
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, (linesNum >= server->batch) ? TEST_API_REMOTE_GRACE : TEST_API_REMOTE_TIMEOUT);
+        if((ret == 0) && (linesNum >= server->batch)) {
+            if(testApiRemoteServerReply(fd, lines, linesNum) < 0) {
+                goto done;
+            }
+            replied += linesNum;
+            for(; linesNum > 0; --linesNum) {
+                free(lines[linesNum - 1]);
+            }
+            continue;
+        } else if(ret <= 0) {
+            fprintf(stderr, "Error: the remote signer requests timeout\n");
+            goto done;
+        }
+
+        len = recv(fd, buf + used, sizeof(buf) - used - 1, 0);
+        if(len <= 0) {
+            fprintf(stderr, "Error: the remote signer connection is closed\n");
+            goto done;
+        }
+        used += (size_t)len;
+        buf[used] = '\0';
+        while((eol = strchr(buf, '\n')) != NULL) {
+            (*eol) = '\0';
+            if(linesNum >= TEST_API_REMOTE_MAX_CLIENTS) {
+                fprintf(stderr, "Error: too many remote signer requests\n");
+                goto done;
+            }
+            lines[linesNum] = strdup(buf);
+            if(lines[linesNum] == NULL) {
+                goto done;
+            }
+            ++linesNum;
+            ++received;
+            if(server->maxOutstanding < linesNum) {
+                server->maxOutstanding = linesNum;
+            }
+            used -= (size_t)(eol - buf) + 1;
+            memmove(buf, eol + 1, used + 1);
+
+            /* the connection drop with all the requests pending */
+            if((server->dropAfter > 0) && (received >= server->dropAfter)) {
+                server->res = 0;
+                goto done;
+            }
+        }
+    }
+    server->res = 0;
+
+done:
+    for(; linesNum > 0; --linesNum) {
+        free(lines[linesNum - 1]);
+    }
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+
+static void
+testApiRemoteClientRun(testApiRemoteClient* client) {
+    xmlSecKeyDataPtr data;
+
+    client->res = -1;
+    data = xmlSecKeyGetData(client->key, xmlSecOpenSSLKeyDataRemoteId);
+    if(data == NULL) {
+        return;
+    }
+    if(xmlSecOpenSSLKeyDataRemoteSign(data, BAD_CAST TEST_API_REMOTE_ALGORITHM,
+            client->in, sizeof(client->in), &(client->out)) < 0) {
+        return;
+    }
+    /* the fake service returns the request data */
+    if((xmlSecBufferGetSize(&(client->out)) != sizeof(client->in)) ||
+       (memcmp(xmlSecBufferGetData(&(client->out)), client->in, sizeof(client->in)) != 0)) {
+        fprintf(stderr, "Error: the remote signer reply is for another request\n");
+        return;
+    }
+    client->res = 0;
+}
+
+static void
+testApiRemoteTaskRun(void* data) {
+    testApiRemoteTask* task = (testApiRemoteTask*)data;
+
+    if(task->server != NULL) {
+        testApiRemoteServerRun(task->server);
+    } else {
+        testApiRemoteClientRun(task->client);
+    }
+}
+
+static void
+testApiRemoteCleanup(testApiRemoteClient* clients, xmlSecSize clientsNum) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < clientsNum; ++ii) {
+        if(clients[ii].key != NULL) {
+            xmlSecKeyDestroy(clients[ii].key);
+        }
+        if(clients[ii].outInitialized != 0) {
+            xmlSecBufferFinalize(&(clients[ii].out));
+        }
+    }
+    memset(clients, 0, sizeof(testApiRemoteClient) * clientsNum);
+}
+
+/* connects the remote signer with @maxPending to the fake @server and signs
+ * concurrently with the @clientsNum keys named @keyNames, the keys are kept
+ * in the @clients for the checks (see testApiRemoteCleanup) */
+static int
+testApiRemoteRun(testApiRemoteServer* server, xmlSecSize maxPending,
+                 const char* const* keyNames, testApiRemoteClient* clients,
+                 xmlSecSize clientsNum) {
+    testApiRemoteTask tasks[TEST_API_REMOTE_MAX_CLIENTS + 1];
+    void* tasksData[TEST_API_REMOTE_MAX_CLIENTS + 1];
+    xmlSecOpenSSLRemoteSignerPtr signer = NULL;
+    struct sockaddr_un addr;
+    char address[sizeof(addr.sun_path) + 8];
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(clients, 0, sizeof(testApiRemoteClient) * clientsNum);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/testApi-remote.sock", testApiTmpFolder);
+    snprintf(address, sizeof(address), "unix:%s", addr.sun_path);
+    (void)unlink(addr.sun_path);
+
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    testApiCheck(server->listenFd >= 0);
+    testApiCheck(bind(server->listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    testApiCheck(listen(server->listenFd, 1) == 0);
+    signer = xmlSecOpenSSLRemoteSignerCreate(address, maxPending);
+    testApiCheck(signer != NULL);
+
+    testApiCheck(clientsNum <= TEST_API_REMOTE_MAX_CLIENTS);
+    for(ii = 0; ii < clientsNum; ++ii) {
+        memset(clients[ii].in, (int)ii + 1, sizeof(clients[ii].in));
+        testApiCheck(xmlSecBufferInitialize(&(clients[ii].out), 0) == 0);
+        clients[ii].outInitialized = 1;
+        clients[ii].key = xmlSecKeyGenerate(xmlSecKeyDataHmacId, 256, xmlSecKeyDataTypeSymmetric);
+        testApiCheck(clients[ii].key != NULL);
+        testApiCheck(xmlSecOpenSSLRemoteSignerAdoptKey(signer, clients[ii].key, BAD_CAST keyNames[ii]) == 0);
+        tasks[ii + 1].server = NULL;
+        tasks[ii + 1].client = &(clients[ii]);
+        tasksData[ii + 1] = &(tasks[ii + 1]);
+    }
+    tasks[0].server = server;
+    tasks[0].client = NULL;
+    tasksData[0] = &(tasks[0]);
+
+    xmlSecExecutorSetCallback(NULL, clientsNum + 1, NULL);
+    testApiCheck(xmlSecExecutorRun(testApiRemoteTaskRun, tasksData, clientsNum + 1) == 0);
+    xmlSecExecutorSetCallback(NULL, 0, NULL);
+    testApiCheck(server->res == 0);
+    res = 0;
+
+done:
+    /* the keys keep the signer */
+    if(signer != NULL) {
+        xmlSecOpenSSLRemoteSignerDestroy(signer);
+    }
+    if(server->listenFd >= 0) {
+        close(server->listenFd);
+        server->listenFd = -1;
+    }
+    (void)unlink(addr.sun_path);
+    return(res);
+}
+
+static int
+testApiOpenSSLRemote(const char* topfolder ATTRIBUTE_UNUSED) {
+    static const char* const keyNames[] = {
+        "key-1", "key-2", "key-3", "key-4", "key-5", "key-6", "key-7", "key-8"
+    };
+    static const char* const failKeyNames[] = { "key-1", TEST_API_REMOTE_FAIL_KEY };
+    testApiRemoteClient clients[TEST_API_REMOTE_MAX_CLIENTS];
+    testApiRemoteServer server;
+    xmlSecBuffer out;
+    xmlSecSize ii;
+    int res = -1;
+
+    memset(clients, 0, sizeof(clients));
+    testApiCheck(xmlSecBufferInitialize(&out, 0) == 0);
+
+    /* the replies come in the reverse order */
+    memset(&server, 0, sizeof(server));
+    server.batch = server.expected = 4;
+    testApiCheck(testApiRemoteRun(&server, 0, keyNames, clients, 4) == 0);
+    for(ii = 0; ii < 4; ++ii) {
+        testApiCheck(clients[ii].res == 0);
+    }
+    testApiCheck(server.maxOutstanding == 4);
+    testApiRemoteCleanup(clients, 4);
+
+    /* the FAIL reply fails only its own request */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    memset(&server, 0, sizeof(server));
+    server.batch = server.expected = 2;
+    testApiCheck(testApiRemoteRun(&server, 0, failKeyNames, clients, 2) == 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    testApiCheck(clients[0].res == 0);
+    testApiCheck(clients[1].res < 0);
+    testApiRemoteCleanup(clients, 2);
+
+    /* the connection drop fails all the pending and the future requests */
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    memset(&server, 0, sizeof(server));
+    server.batch = TEST_API_REMOTE_MAX_CLIENTS;
+    server.dropAfter = 3;
+    testApiCheck(testApiRemoteRun(&server, 0, keyNames, clients, 3) == 0);
+    for(ii = 0; ii < 3; ++ii) {
+        testApiCheck(clients[ii].res < 0);
+    }
+    testApiCheck(xmlSecOpenSSLKeyDataRemoteSign(xmlSecKeyGetData(clients[0].key, xmlSecOpenSSLKeyDataRemoteId),
+        BAD_CAST TEST_API_REMOTE_ALGORITHM, clients[0].in, sizeof(clients[0].in), &out) < 0);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    testApiRemoteCleanup(clients, 3);
+
+    /* no more than maxPending requests are sent before the replies */
+    memset(&server, 0, sizeof(server));
+    server.batch = 2;
+    server.expected = 6;
+    testApiCheck(testApiRemoteRun(&server, 2, keyNames, clients, 6) == 0);
+    for(ii = 0; ii < 6; ++ii) {
+        testApiCheck(clients[ii].res == 0);
+    }
+    testApiCheck(server.maxOutstanding == 2);
+    res = 0;
+
+done:
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+    testApiRemoteCleanup(clients, TEST_API_REMOTE_MAX_CLIENTS);
+    xmlSecBufferFinalize(&out);
+    return(res);
+}
+
+#else  /* defined(XMLSEC_CRYPTO_OPENSSL) && defined(XMLSEC_OPENSSL_REMOTE) && !defined(XMLSEC_NO_HMAC) */
+
+static int
+testApiOpenSSLRemote(const char* topfolder ATTRIBUTE_UNUSED) {
+    fprintf(stderr, "Test is not available: xmlsec-openssl remote signer support is not linked\n");
+    return(0);
+}
+
+#endif /* defined(XMLSEC_CRYPTO_OPENSSL) && defined(XMLSEC_OPENSSL_REMOTE) && !defined(XMLSEC_NO_HMAC) */
+
+/**************************************************************************
+ *
+ * Main
+ *
+ *************************************************************************/
+static testApiTest testApiTests[] = {
+    { "buffer-offset",          testApiBufferOffset },
+    { "buffer-mem-limit",       testApiBufferMemLimit },
+    { "xpath-cache",            testApiXPathCache },
+    { "c14n-native",            testApiC14NNative },
+    { "c14n-native-parallel",   testApiC14NNativeParallel },
+    { "c14n2",                  testApiC14N2 },
+    { "transform-stats",        testApiTransformStats },
+    { "io-cache",               testApiIOCache },
+    { "io-mapped-file",         testApiMappedFile },
+    { "keys-cache",             testApiKeysCache },
+    { "keys-cache-ttl",         testApiKeysCacheTtl },
+    { "key-share",              testApiKeyShare },
+    { "keys-mngr-ref",          testApiKeysMngrRef },
+    { "keys-mngr-holder",       testApiKeysMngrHolder },
+    { "keys-store-replace",     testApiKeysStoreReplace },
+    { "keys-store-index",       testApiKeysStoreIndex },
+    { "enc-keys-cache",         testApiEncKeysCache },
+    { "enc-to-output",          testApiEncToOutput },
+    { "enc-decrypt-parallel",   testApiEncDecryptParallel },
+    { "enc-encrypt-multiple",   testApiEncXmlEncryptMultiple },
+    { "verify-cache",           testApiVerifyCache },
+    { "dsig-resign",            testApiDSigResign },
+    { "dsig-pinned-key",        testApiDSigPinnedKey },
+    { "dsig-parallel",          testApiDSigParallel },
+    { "dsig-signature-first",   testApiDSigSignatureFirst },
+    { "dsig-verify-parallel",   testApiDSigVerifyParallel },
+    { "dsig-doc-cache",         testApiDSigDocCache },
+    { "limits",                 testApiLimits },
+    { "openssl-certs-cache",    testApiOpenSSLCertsCache },
+    { "openssl-keys-cache",     testApiOpenSSLKeysCache },
+    { "openssl-verify-cache",   testApiOpenSSLVerifyCache },
+    { "openssl-certs-index",    testApiOpenSSLCertsIndex },
+    { "openssl-crls-index",     testApiOpenSSLCrlsIndex },
+    { "openssl-remote",         testApiOpenSSLRemote },
+    { NULL,                     NULL }
+};
+
+static void
+testApiUsage(const char* name) {
+    testApiTest* test;
+
+    fprintf(stderr, "Usage: %s [--crypto <name>] [--crypto-config <path>] <test> <topfolder>\n", name);
+    fprintf(stderr, "Tests:\n");
+    for(test = testApiTests; test->name != NULL; ++test) {
+        fprintf(stderr, "    %s\n", test->name);
+    }
+}
+
+int
+main(int argc, char** argv) {
+    const char* crypto = NULL;
+    const char* cryptoConfig = NULL;
+    testApiTest* test;
+    int pos;
+    int res = 1;
+
+    for(pos = 1; (pos + 1 < argc) && (strncmp(argv[pos], "--", 2) == 0); pos += 2) {
+        if(strcmp(argv[pos], "--crypto") == 0) {
+            crypto = argv[pos + 1];
+        } else if(strcmp(argv[pos], "--crypto-config") == 0) {
+            cryptoConfig = argv[pos + 1];
+            testApiTmpFolder = cryptoConfig;
+        } else {
+            testApiUsage(argv[0]);
+            return(1);
+        }
+    }
+    if(pos + 2 != argc) {
+        testApiUsage(argv[0]);
+        return(1);
+    }
+    for(test = testApiTests; test->name != NULL; ++test) {
+        if(strcmp(test->name, argv[pos]) == 0) {
+            break;
+        }
+    }
+    if(test->name == NULL) {
+        fprintf(stderr, "Error: unknown test \"%s\"\n", argv[pos]);
+        testApiUsage(argv[0]);
+        return(1);
+    }
+
+    /* init libxml and xmlsec */
+    xmlInitParser();
+    LIBXML_TEST_VERSION
+    if(xmlSecInit() < 0) {
+        fprintf(stderr, "Error: xmlsec initialization failed.\n");
+        return(1);
+    }
+    if(xmlSecCheckVersion() != 1) {
+        fprintf(stderr, "Error: loaded xmlsec library version is not compatible.\n");
+        goto shutdown_xmlsec;
+    }
+#ifdef XMLSEC_CRYPTO_DYNAMIC_LOADING
+    if(xmlSecCryptoDLLoadLibrary(BAD_CAST crypto) < 0) {
+        fprintf(stderr, "Error: unable to load xmlsec-%s library.\n",
+                (crypto != NULL) ? crypto : "default");
+        goto shutdown_xmlsec;
+    }
+#else  /* XMLSEC_CRYPTO_DYNAMIC_LOADING */
+    (void)crypto;
+#endif /* XMLSEC_CRYPTO_DYNAMIC_LOADING */
+    if(xmlSecCryptoAppInit(cryptoConfig) < 0) {
+        fprintf(stderr, "Error: crypto initialization failed.\n");
+        goto shutdown_xmlsec;
+    }
+    if(xmlSecCryptoInit() < 0) {
+        fprintf(stderr, "Error: xmlsec-crypto initialization failed.\n");
+        goto shutdown_crypto_app;
+    }
+
+    /* run the test */
+    if(test->func(argv[pos + 1]) == 0) {
+        res = 0;
+    } else {
+        fprintf(stderr, "Error: test \"%s\" failed\n", test->name);
+    }
+
+    xmlSecCryptoShutdown();
+shutdown_crypto_app:
+    xmlSecCryptoAppShutdown();
+shutdown_xmlsec:
+    xmlSecShutdown();
+    xmlCleanupParser();
+    return(res);
+}
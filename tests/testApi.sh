@@ -0,0 +1,145 @@
+#!/bin/sh
+#
+# This script needs to be called from testrun.sh script
+#
+
+##########################################################################
+##########################################################################
+##########################################################################
+if [ -z "$XMLSEC_TEST_REPRODUCIBLE" ]; then
+    echo "--- testApi started for xmlsec-$crypto library ($timestamp) ---"
+fi
+echo "--- LD_LIBRARY_PATH=$LD_LIBRARY_PATH"
+echo "--- LTDL_LIBRARY_PATH=$LTDL_LIBRARY_PATH"
+if [ -z "$XMLSEC_TEST_REPRODUCIBLE" ]; then
+    echo "--- log file is $logfile"
+fi
+echo "--- testApi started for xmlsec-$crypto library ($timestamp) ---" >> $logfile
+echo "--- LD_LIBRARY_PATH=$LD_LIBRARY_PATH" >> $logfile
+echo "--- LTDL_LIBRARY_PATH=$LTDL_LIBRARY_PATH" >> $logfile
+
+# the crypto config folder is shared with the other tests (keys.xml
+# is created by testKeys.sh), keep its content
+mkdir -p $crypto_config
+
+# copy NSS DB files if needed
+if [ "z$crypto" = "znss" ] ; then
+    cp -f $nssdbfolder/*.db $crypto_config
+fi
+
+##########################################################################
+##########################################################################
+##########################################################################
+echo "--------- Positive Testing ----------"
+execApiTest $res_success \
+    "buffer-offset"
+
+execApiTest $res_success \
+    "buffer-mem-limit"
+
+execApiTest $res_success \
+    "xpath-cache"
+
+execApiTest $res_success \
+    "c14n-native"
+
+execApiTest $res_success \
+    "c14n-native-parallel"
+
+execApiTest $res_success \
+    "c14n2"
+
+execApiTest $res_success \
+    "transform-stats"
+
+execApiTest $res_success \
+    "io-cache"
+
+execApiTest $res_success \
+    "io-mapped-file"
+
+execApiTest $res_success \
+    "keys-cache"
+
+execApiTest $res_success \
+    "keys-cache-ttl"
+
+execApiTest $res_success \
+    "key-share"
+
+execApiTest $res_success \
+    "keys-mngr-ref"
+
+execApiTest $res_success \
+    "keys-mngr-holder"
+
+execApiTest $res_success \
+    "keys-store-replace"
+
+execApiTest $res_success \
+    "keys-store-index"
+
+execApiTest $res_success \
+    "enc-keys-cache"
+
+execApiTest $res_success \
+    "enc-to-output"
+
+execApiTest $res_success \
+    "enc-decrypt-parallel"
+
+execApiTest $res_success \
+    "enc-encrypt-multiple"
+
+execApiTest $res_success \
+    "verify-cache"
+
+execApiTest $res_success \
+    "dsig-resign"
+
+execApiTest $res_success \
+    "dsig-pinned-key"
+
+execApiTest $res_success \
+    "dsig-parallel"
+
+execApiTest $res_success \
+    "dsig-signature-first"
+
+execApiTest $res_success \
+    "dsig-verify-parallel"
+
+execApiTest $res_success \
+    "dsig-doc-cache"
+
+execApiTest $res_success \
+    "limits"
+
+if [ "z$crypto" = "zopenssl" ] ; then
+    execApiTest $res_success \
+        "openssl-certs-cache"
+
+    execApiTest $res_success \
+        "openssl-keys-cache"
+
+    execApiTest $res_success \
+        "openssl-verify-cache"
+
+    execApiTest $res_success \
+        "openssl-certs-index"
+
+    execApiTest $res_success \
+        "openssl-crls-index"
+
+    execApiTest $res_success \
+        "openssl-remote"
+fi
+
+##########################################################################
+##########################################################################
+##########################################################################
+echo "--- testApi finished ---" >> $logfile
+echo "--- testApi finished ---"
+if [ -z "$XMLSEC_TEST_REPRODUCIBLE" ]; then
+    echo "--- detailed log is written to  $logfile ---"
+fi
@@ -0,0 +1,250 @@
+#!/bin/sh
+#
+# This script needs to be called from testrun.sh script
+#
+# Measures the throughput and the per operation processor time percentiles
+# for a few representative workloads. The results are written as one JSON
+# object per line to $BENCH_OUTPUT (or to a file in $TMPFOLDER).
+#
+#   BENCH_ITERATIONS        the number of operations per measurement (100)
+#   BENCH_LARGE_ITERATIONS  the same for the large payload workloads (10)
+#   BENCH_PAYLOAD_SIZE      the large payload size in KB (8192)
+#   BENCH_MANIFEST_SIZE     the number of references in the manifest (100)
+#
+
+##########################################################################
+##########################################################################
+##########################################################################
+if [ -z "$BENCH_ITERATIONS" ] ; then
+    BENCH_ITERATIONS=100
+fi
+if [ -z "$BENCH_LARGE_ITERATIONS" ] ; then
+    BENCH_LARGE_ITERATIONS=10
+fi
+if [ -z "$BENCH_PAYLOAD_SIZE" ] ; then
+    BENCH_PAYLOAD_SIZE=8192
+fi
+if [ -z "$BENCH_MANIFEST_SIZE" ] ; then
+    BENCH_MANIFEST_SIZE=100
+fi
+if [ -z "$BENCH_OUTPUT" ] ; then
+    BENCH_OUTPUT=$TMPFOLDER/xmlsec-bench-$crypto-$timestamp.json
+fi
+benchfolder=$TMPFOLDER/xmlsec-bench-$timestamp-$$
+timings=$benchfolder/timings.txt
+
+echo "--- testBench started for xmlsec-$crypto library ($timestamp)"
+echo "--- log file is $logfile"
+echo "--- results are written to $BENCH_OUTPUT"
+echo "--- testBench started for xmlsec-$crypto library ($timestamp)" >> $logfile
+
+rm -rf $benchfolder
+mkdir -p $benchfolder
+rm -f $BENCH_OUTPUT
+
+sign_params="$priv_key_option $topfolder/keys/rsakey$priv_key_suffix.$priv_key_format --pwd secret123"
+verify_params="--trusted-$cert_format $topfolder/keys/cacert.$cert_format --enabled-key-data x509"
+
+##########################################################################
+#
+# Runs "xmlsec1 <command> <params>" $iterations times and reports the
+# results for the workload $name
+#
+##########################################################################
+execBenchTest() {
+    name="$1"
+    command="$2"
+    iterations="$3"
+    size="$4"
+    params="$5"
+
+    printf "    %-20s %-10s" "$name" "$command"
+    rm -f $timings
+    echo "$xmlsec_app $command $xmlsec_params --repeat $iterations --timings $timings $params" >> $logfile
+    $xmlsec_app $command $xmlsec_params --repeat $iterations --timings $timings $params >> $logfile 2>> $logfile
+    if [ $? != 0 -o ! -s $timings ] ; then
+        echo "         Fail"
+        return
+    fi
+
+    sort -n $timings | awk \
+        -v crypto="$crypto" -v name="$name" -v command="$command" -v size="$size" '
+        { t[NR] = $1; total += $1 }
+        function pct(p,  i) { i = int(NR * p); if(i < NR * p) { i++ }; if(i < 1) { i = 1 }; return t[i] }
+        END {
+            ops = (total > 0) ? (NR * 1000000 / total) : 0;
+            printf("{\"crypto\":\"%s\",\"workload\":\"%s\",\"operation\":\"%s\",\"iterations\":%d,\"size\":%d,", crypto, name, command, NR, size);
+            printf("\"total_usec\":%d,\"ops_per_sec\":%.2f,\"min_usec\":%d,\"p50_usec\":%d,\"p90_usec\":%d,\"p99_usec\":%d,\"max_usec\":%d}\n",
+                total, ops, t[1], pct(0.5), pct(0.9), pct(0.99), t[NR]);
+        }' >> $BENCH_OUTPUT
+    tail -n 1 $BENCH_OUTPUT | sed 's/.*"ops_per_sec":\([^,]*\),.*"p50_usec":\([^,]*\),.*"p99_usec":\([^,]*\),.*/\1 ops\/sec, p50 \2 usec, p99 \3 usec/'
+}
+
+##########################################################################
+#
+# Runs a sign + verify benchmark for the template $tmpl
+#
+##########################################################################
+execBenchDSig() {
+    name="$1"
+    tmpl="$2"
+    iterations="$3"
+    params="$4"
+
+    echo "$xmlsec_app sign $xmlsec_params $sign_params $params --output $benchfolder/$name.xml $tmpl" >> $logfile
+    $xmlsec_app sign $xmlsec_params $sign_params $params --output $benchfolder/$name.xml $tmpl >> $logfile 2>> $logfile
+    if [ $? != 0 ] ; then
+        printf "    %-20s %-10s" "$name" "sign"
+        echo "         Fail"
+        return
+    fi
+    size=`wc -c < $tmpl | tr -d ' '`
+
+    execBenchTest "$name" "sign" "$iterations" "$size" "$sign_params $params $tmpl"
+    execBenchTest "$name" "verify" "$iterations" "$size" "$verify_params $params $benchfolder/$name.xml"
+}
+
+##########################################################################
+##########################################################################
+##########################################################################
+echo "--------- Workloads ----------"
+
+#
+# SAML assertion with enveloped exclusive c14n signature
+#
+cat > $benchfolder/saml-enveloped.tmpl <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<samlp:Response xmlns:samlp="urn:oasis:names:tc:SAML:2.0:protocol" xmlns:saml="urn:oasis:names:tc:SAML:2.0:assertion" ID="_response" Version="2.0" IssueInstant="2016-01-01T00:00:00Z">
+  <saml:Issuer>https://idp.example.com/</saml:Issuer>
+  <samlp:Status><samlp:StatusCode Value="urn:oasis:names:tc:SAML:2.0:status:Success"/></samlp:Status>
+  <saml:Assertion ID="_assertion" Version="2.0" IssueInstant="2016-01-01T00:00:00Z">
+    <saml:Issuer>https://idp.example.com/</saml:Issuer>
+    <Signature xmlns="http://www.w3.org/2000/09/xmldsig#">
+      <SignedInfo>
+        <CanonicalizationMethod Algorithm="http://www.w3.org/2001/10/xml-exc-c14n#"/>
+        <SignatureMethod Algorithm="http://www.w3.org/2001/04/xmldsig-more#rsa-sha256"/>
+        <Reference URI="#_assertion">
+          <Transforms>
+            <Transform Algorithm="http://www.w3.org/2000/09/xmldsig#enveloped-signature"/>
+            <Transform Algorithm="http://www.w3.org/2001/10/xml-exc-c14n#"/>
+          </Transforms>
+          <DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>
+          <DigestValue></DigestValue>
+        </Reference>
+      </SignedInfo>
+      <SignatureValue></SignatureValue>
+      <KeyInfo><X509Data/></KeyInfo>
+    </Signature>
+    <saml:Subject><saml:NameID Format="urn:oasis:names:tc:SAML:1.1:nameid-format:emailAddress">user@example.com</saml:NameID></saml:Subject>
+    <saml:Conditions NotBefore="2016-01-01T00:00:00Z" NotOnOrAfter="2016-01-01T01:00:00Z"><saml:AudienceRestriction><saml:Audience>https://sp.example.com/</saml:Audience></saml:AudienceRestriction></saml:Conditions>
+    <saml:AuthnStatement AuthnInstant="2016-01-01T00:00:00Z"><saml:AuthnContext><saml:AuthnContextClassRef>urn:oasis:names:tc:SAML:2.0:ac:classes:Password</saml:AuthnContextClassRef></saml:AuthnContext></saml:AuthnStatement>
+    <saml:AttributeStatement>
+      <saml:Attribute Name="mail"><saml:AttributeValue>user@example.com</saml:AttributeValue></saml:Attribute>
+      <saml:Attribute Name="groups"><saml:AttributeValue>staff</saml:AttributeValue><saml:AttributeValue>developers</saml:AttributeValue></saml:Attribute>
+    </saml:AttributeStatement>
+  </saml:Assertion>
+</samlp:Response>
+EOF
+execBenchDSig "saml-enveloped" "$benchfolder/saml-enveloped.tmpl" "$BENCH_ITERATIONS" \
+    "--id-attr:ID urn:oasis:names:tc:SAML:2.0:assertion:Assertion"
+
+#
+# WS-Security header signature selecting the SOAP body with XPath
+#
+cat > $benchfolder/wss-xpath.tmpl <<EOF
+<?xml version="1.0" encoding="UTF-8"?>
+<soap:Envelope xmlns:soap="http://schemas.xmlsoap.org/soap/envelope/" xmlns:wsse="http://docs.oasis-open.org/wss/2004/01/oasis-200401-wss-wssecurity-secext-1.0.xsd">
+  <soap:Header>
+    <wsse:Security soap:mustUnderstand="1">
+      <Signature xmlns="http://www.w3.org/2000/09/xmldsig#">
+        <SignedInfo>
+          <CanonicalizationMethod Algorithm="http://www.w3.org/2001/10/xml-exc-c14n#"/>
+          <SignatureMethod Algorithm="http://www.w3.org/2001/04/xmldsig-more#rsa-sha256"/>
+          <Reference URI="">
+            <Transforms>
+              <Transform Algorithm="http://www.w3.org/TR/1999/REC-xpath-19991116">
+                <XPath xmlns:soap="http://schemas.xmlsoap.org/soap/envelope/">ancestor-or-self::soap:Body</XPath>
+              </Transform>
+              <Transform Algorithm="http://www.w3.org/2001/10/xml-exc-c14n#"/>
+            </Transforms>
+            <DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>
+            <DigestValue></DigestValue>
+          </Reference>
+        </SignedInfo>
+        <SignatureValue></SignatureValue>
+        <KeyInfo><X509Data/></KeyInfo>
+      </Signature>
+    </wsse:Security>
+  </soap:Header>
+  <soap:Body>
+    <m:GetQuote xmlns:m="urn:example:quotes">
+      <m:Symbol>XMLSEC</m:Symbol>
+      <m:Exchange>EXAMPLE</m:Exchange>
+      <m:Currency>USD</m:Currency>
+    </m:GetQuote>
+  </soap:Body>
+</soap:Envelope>
+EOF
+execBenchDSig "wss-xpath" "$benchfolder/wss-xpath.tmpl" "$BENCH_ITERATIONS" ""
+
+#
+# Manifest with many same document references
+#
+(
+    echo '<?xml version="1.0" encoding="UTF-8"?>'
+    echo '<Document xmlns="urn:example:manifest">'
+    ii=0
+    while [ $ii -lt $BENCH_MANIFEST_SIZE ] ; do
+        echo "  <Item Id=\"item-$ii\">item $ii content</Item>"
+        ii=`expr $ii + 1`
+    done
+    echo '  <Signature xmlns="http://www.w3.org/2000/09/xmldsig#">'
+    echo '    <SignedInfo>'
+    echo '      <CanonicalizationMethod Algorithm="http://www.w3.org/2001/10/xml-exc-c14n#"/>'
+    echo '      <SignatureMethod Algorithm="http://www.w3.org/2001/04/xmldsig-more#rsa-sha256"/>'
+    echo '      <Reference URI="#manifest" Type="http://www.w3.org/2000/09/xmldsig#Manifest">'
+    echo '        <DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>'
+    echo '        <DigestValue></DigestValue>'
+    echo '      </Reference>'
+    echo '    </SignedInfo>'
+    echo '    <SignatureValue></SignatureValue>'
+    echo '    <KeyInfo><X509Data/></KeyInfo>'
+    echo '    <Object><Manifest Id="manifest">'
+    ii=0
+    while [ $ii -lt $BENCH_MANIFEST_SIZE ] ; do
+        echo "      <Reference URI=\"#item-$ii\"><DigestMethod Algorithm=\"http://www.w3.org/2001/04/xmlenc#sha256\"/><DigestValue></DigestValue></Reference>"
+        ii=`expr $ii + 1`
+    done
+    echo '    </Manifest></Object>'
+    echo '  </Signature>'
+    echo '</Document>'
+) > $benchfolder/manifest-many.tmpl
+execBenchDSig "manifest-many" "$benchfolder/manifest-many.tmpl" "$BENCH_ITERATIONS" \
+    "--id-attr:Id urn:example:manifest:Item"
+
+#
+# Large binary payload encryption
+#
+dd if=/dev/urandom of=$benchfolder/xmlenc-large.data bs=1024 count=$BENCH_PAYLOAD_SIZE >> $logfile 2>> $logfile
+enc_tmpl=$topfolder/aleksey-xmlenc-01/enc-aes256cbc-keyname.tmpl
+enc_params="--keys-file $topfolder/keys/keys.xml"
+echo "$xmlsec_app encrypt $xmlsec_params $enc_params --binary-data $benchfolder/xmlenc-large.data --output $benchfolder/xmlenc-large.xml $enc_tmpl" >> $logfile
+$xmlsec_app encrypt $xmlsec_params $enc_params --binary-data $benchfolder/xmlenc-large.data --output $benchfolder/xmlenc-large.xml $enc_tmpl >> $logfile 2>> $logfile
+if [ $? = 0 ] ; then
+    size=`wc -c < $benchfolder/xmlenc-large.data | tr -d ' '`
+    execBenchTest "xmlenc-large" "encrypt" "$BENCH_LARGE_ITERATIONS" "$size" \
+        "$enc_params --binary-data $benchfolder/xmlenc-large.data $enc_tmpl"
+    execBenchTest "xmlenc-large" "decrypt" "$BENCH_LARGE_ITERATIONS" "$size" \
+        "$enc_params $benchfolder/xmlenc-large.xml"
+else
+    printf "    %-20s %-10s" "xmlenc-large" "encrypt"
+    echo "         Fail"
+fi
+
+##########################################################################
+##########################################################################
+##########################################################################
+rm -rf $benchfolder
+echo "--- testBench finished" >> $logfile
+echo "--- testBench finished"
+echo "--- detailed log is written to  $logfile"
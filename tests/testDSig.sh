@@ -380,6 +380,15 @@ execDSigTest $res_success \
     "$priv_key_option $topfolder/keys/ecdsa-secp256r1-key.$priv_key_format --pwd secret123" \
     "--trusted-$cert_format $topfolder/keys/cacert.$cert_format --enabled-key-data x509"
 
+execDSigTest $res_success \
+    "" \
+    "aleksey-xmldsig-01/enveloping-eddsa-ed25519" \
+    "sha256 eddsa-ed25519" \
+    "ed25519" \
+    "--pubkey-pem $topfolder/keys/ed25519pubkey.pem" \
+    "--privkey-pem $topfolder/keys/ed25519key.pem" \
+    "--pubkey-pem $topfolder/keys/ed25519pubkey.pem"
+
 #
 # To generate expired cert run the following command
 # > xmlsec1 sign --pkcs12 tests/keys/expiredkey.p12 --pwd secret123 --output out.xml ./tests/aleksey-xmldsig-01/enveloping-expired-cert.tmpl
@@ -900,6 +909,15 @@ execDSigTest $res_fail \
     "hmac" \
     "--enabled-reference-uris empty --hmackey $topfolder/keys/hmackey.bin --dtd-file $topfolder/aleksey-xmldsig-01/dtd-hmac-91.dtd" 
 
+# the "#id" reference to a missing element fails (same as the XPointer
+# id() expression that finds nothing)
+execDSigTest $res_fail \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha256-hmac-sha256-missing-id" \
+    "sha256 hmac-sha256" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin"
+
 execDSigTest $res_fail \
     "phaos-xmldsig-three" \
     "signature-rsa-detached-xslt-transform-bad-retrieval-method" \
@@ -957,6 +975,53 @@ execDSigTest $res_success \
     "rsa x509" \
     "--enabled-key-data x509 --insecure"
 
+# OCSP checks with the stapled responses (see tests/keys/README): the
+# responses are valid from 2014-06-01 till 2014-06-08. The options are
+# only available in the OpenSSL builds without crypto dynamic loading.
+if [ "z$crypto" = "zopenssl" ] && $xmlsec_app --help-verify 2>&1 | grep -q -- "--X509-ocsp-response" ;
+then
+    ocsp_params="--trusted-$cert_format $topfolder/keys/cacert.$cert_format --enabled-key-data x509 --X509-ocsp"
+
+    execDSigTest $res_success \
+        "aleksey-xmldsig-01" \
+        "enveloping-rsa-x509chain" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "$ocsp_params --verification-time 2014-06-02+00:00:00 --X509-ocsp-response $topfolder/keys/ocsp-ca2cert-good.der --X509-ocsp-response $topfolder/keys/ocsp-rsacert-good.der"
+
+    # no response for the leaf certificate
+    execDSigTest $res_fail \
+        "aleksey-xmldsig-01" \
+        "enveloping-rsa-x509chain" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "$ocsp_params --verification-time 2014-06-02+00:00:00 --X509-ocsp-response $topfolder/keys/ocsp-ca2cert-good.der"
+
+    # revoked leaf certificate
+    execDSigTest $res_fail \
+        "aleksey-xmldsig-01" \
+        "enveloping-rsa-x509chain" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "$ocsp_params --verification-time 2014-06-02+00:00:00 --X509-ocsp-response $topfolder/keys/ocsp-ca2cert-good.der --X509-ocsp-response $topfolder/keys/ocsp-rsacert-revoked.der"
+
+    # the responses nextUpdate is before the verification time
+    execDSigTest $res_fail \
+        "aleksey-xmldsig-01" \
+        "enveloping-rsa-x509chain" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "$ocsp_params --verification-time 2014-07-01+00:00:00 --X509-ocsp-response $topfolder/keys/ocsp-ca2cert-good.der --X509-ocsp-response $topfolder/keys/ocsp-rsacert-good.der"
+
+    # the leaf certificate response is signed by an untrusted responder
+    execDSigTest $res_fail \
+        "aleksey-xmldsig-01" \
+        "enveloping-rsa-x509chain" \
+        "sha1 rsa-sha1" \
+        "rsa x509" \
+        "$ocsp_params --verification-time 2014-06-02+00:00:00 --X509-ocsp-response $topfolder/keys/ocsp-ca2cert-good.der --X509-ocsp-response $topfolder/keys/ocsp-rsacert-untrusted.der"
+fi
+
 ##########################################################################
 ##########################################################################
 ##########################################################################
@@ -75,6 +75,30 @@ execEncTest $res_success \
     "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes256cbc-keyname.data" \
     "--keys-file $keysfile"
 
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128gcm-keyname" \
+    "aes128-gcm" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128gcm-keyname.data" \
+    "--keys-file $keysfile"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes192gcm-keyname" \
+    "aes192-gcm" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes192gcm-keyname.data" \
+    "--keys-file $keysfile"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes256gcm-keyname" \
+    "aes256-gcm" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes256gcm-keyname.data" \
+    "--keys-file $keysfile"
+
 execEncTest $res_success \
     "" \
     "aleksey-xmlenc-01/enc-des3cbc-keyname-content" \
@@ -0,0 +1,287 @@
+#!/bin/sh
+#
+# This script needs to be called from testrun.sh script
+#
+# Performance regression corpus: generates documents known to stress the
+# hot paths (deep nesting, many namespaces and attributes, many references,
+# long XPath Filter 2.0 chains, large base64 blobs), signs and verifies them
+# and checks the fastest of the repeated runs against the per case budget.
+# A quadratic behavior makes a case run well over its budget.
+#
+#   PERF_REPEAT             the number of runs per case (3)
+#   PERF_BUDGET_SCALE       the budgets multiplier for slow or instrumented
+#                           builds (1)
+#   PERF_SCALE              the documents size multiplier (1)
+#
+
+##########################################################################
+##########################################################################
+##########################################################################
+if [ -z "$PERF_REPEAT" ] ; then
+    PERF_REPEAT=3
+fi
+if [ -z "$PERF_BUDGET_SCALE" ] ; then
+    PERF_BUDGET_SCALE=1
+fi
+if [ -z "$PERF_SCALE" ] ; then
+    PERF_SCALE=1
+fi
+perffolder=$TMPFOLDER/xmlsec-perf-$timestamp-$$
+timings=$perffolder/timings.txt
+count_success=0
+count_fail=0
+
+echo "--- testPerf started for xmlsec-$crypto library ($timestamp)"
+echo "--- log file is $logfile"
+echo "--- testPerf started for xmlsec-$crypto library ($timestamp)" >> $logfile
+
+rm -rf $perffolder
+mkdir -p $perffolder
+
+hmac_params="--hmackey $topfolder/keys/hmackey.bin"
+
+##########################################################################
+#
+# Prints the signature template part before the references and after them
+#
+##########################################################################
+printSignatureStart() {
+    echo '<Signature xmlns="http://www.w3.org/2000/09/xmldsig#">'
+    echo '<SignedInfo>'
+    echo '<CanonicalizationMethod Algorithm="http://www.w3.org/TR/2001/REC-xml-c14n-20010315"/>'
+    echo '<SignatureMethod Algorithm="http://www.w3.org/2001/04/xmldsig-more#hmac-sha256"/>'
+}
+
+printSignatureEnd() {
+    echo '</SignedInfo>'
+    echo '<SignatureValue></SignatureValue>'
+    echo '</Signature>'
+}
+
+printEnvelopedReference() {
+    echo '<Reference URI="">'
+    echo '<Transforms><Transform Algorithm="http://www.w3.org/2000/09/xmldsig#enveloped-signature"/></Transforms>'
+    echo '<DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>'
+    echo '<DigestValue></DigestValue>'
+    echo '</Reference>'
+}
+
+##########################################################################
+#
+# Runs "xmlsec1 <command> <params>" $PERF_REPEAT times and checks the
+# fastest run against the $budget (in msec)
+#
+##########################################################################
+execPerfTest() {
+    name="$1"
+    command="$2"
+    budget="$3"
+    params="$4"
+
+    printf "    %-20s %-10s" "$name" "$command"
+    rm -f $timings
+    echo "$xmlsec_app $command $xmlsec_params --repeat $PERF_REPEAT --timings $timings $params" >> $logfile
+    $xmlsec_app $command $xmlsec_params --repeat $PERF_REPEAT --timings $timings $params >> $logfile 2>> $logfile
+    if [ $? != 0 -o ! -s $timings ] ; then
+        count_fail=`expr $count_fail + 1`
+        echo "         Fail"
+        return
+    fi
+
+    res=`sort -n $timings | awk -v budget="$budget" -v scale="$PERF_BUDGET_SCALE" '
+        NR == 1 {
+            limit = budget * scale * 1000;
+            printf("%s %d msec (budget %d msec)", ($1 <= limit) ? "OK" : "Fail", $1 / 1000, limit / 1000);
+        }'`
+    echo "$name $command: $res" >> $logfile
+    case "$res" in
+    OK*)
+        count_success=`expr $count_success + 1`
+        echo "   $res"
+        ;;
+    *)
+        count_fail=`expr $count_fail + 1`
+        echo " $res"
+        ;;
+    esac
+}
+
+##########################################################################
+#
+# Signs the template $tmpl and runs the sign and verify cases for it
+#
+##########################################################################
+execPerfDSig() {
+    name="$1"
+    tmpl="$2"
+    budget="$3"
+    params="$4"
+
+    echo "$xmlsec_app sign $xmlsec_params $hmac_params $params --output $perffolder/$name.xml $tmpl" >> $logfile
+    $xmlsec_app sign $xmlsec_params $hmac_params $params --output $perffolder/$name.xml $tmpl >> $logfile 2>> $logfile
+    if [ $? != 0 ] ; then
+        count_fail=`expr $count_fail + 1`
+        printf "    %-20s %-10s" "$name" "sign"
+        echo "         Fail"
+        return
+    fi
+
+    # execPerfTest() overwrites the variables
+    dsig_name="$name"
+    dsig_budget="$budget"
+    dsig_verify_params="$hmac_params $params $perffolder/$name.xml"
+    execPerfTest "$dsig_name" "sign" "$dsig_budget" "$hmac_params $params $tmpl"
+    execPerfTest "$dsig_name" "verify" "$dsig_budget" "$dsig_verify_params"
+}
+
+##########################################################################
+##########################################################################
+##########################################################################
+echo "--------- Cases ----------"
+
+#
+# Deeply nested elements (just under the parser depth limit), each
+# with a namespace so the c14n namespaces stack grows with the depth
+#
+awk -v depth=250 'BEGIN {
+    print "<?xml version=\"1.0\"?>";
+    for(ii = 0; ii < depth; ii++) { printf("<e%d xmlns:n%d=\"urn:example:n%d\" n%d:a=\"%d\">\n", ii, ii, ii, ii, ii); }
+    print "<Data>deep</Data>";
+    for(ii = depth - 1; ii >= 0; ii--) { printf("</e%d>\n", ii); }
+}' > $perffolder/deep.body
+(
+    head -n 250 $perffolder/deep.body
+    printSignatureStart
+    printEnvelopedReference
+    printSignatureEnd
+    tail -n +251 $perffolder/deep.body
+) > $perffolder/deep-nesting.tmpl
+execPerfDSig "deep-nesting" "$perffolder/deep-nesting.tmpl" 500 ""
+
+#
+# Hundreds of namespace declarations on the root element inherited
+# by every element
+#
+awk -v nss=`expr 500 \* $PERF_SCALE` -v items=200 'BEGIN {
+    print "<?xml version=\"1.0\"?>";
+    printf("<Document");
+    for(ii = 0; ii < nss; ii++) { printf(" xmlns:ns%d=\"urn:example:ns%d\"", ii, ii); }
+    print ">";
+    for(ii = 0; ii < items; ii++) { printf("<ns%d:Item>%d</ns%d:Item>\n", ii % nss, ii, ii % nss); }
+}' > $perffolder/many-ns.tmpl
+(
+    printSignatureStart
+    printEnvelopedReference
+    printSignatureEnd
+    echo '</Document>'
+) >> $perffolder/many-ns.tmpl
+execPerfDSig "many-ns" "$perffolder/many-ns.tmpl" 1000 ""
+
+#
+# Huge attributes count on a few elements (c14n sorts the attributes)
+#
+awk -v attrs=`expr 10000 \* $PERF_SCALE` 'BEGIN {
+    print "<?xml version=\"1.0\"?>";
+    print "<Document>";
+    for(jj = 0; jj < 4; jj++) {
+        printf("<Item");
+        for(ii = attrs; ii > 0; ii--) { printf(" a%d=\"%d\"", ii, ii); }
+        print "/>";
+    }
+}' > $perffolder/many-attrs.tmpl
+(
+    printSignatureStart
+    printEnvelopedReference
+    printSignatureEnd
+    echo '</Document>'
+) >> $perffolder/many-attrs.tmpl
+execPerfDSig "many-attrs" "$perffolder/many-attrs.tmpl" 1000 ""
+
+#
+# Many same document references, each selecting one element by ID
+#
+refs=`expr 1000 \* $PERF_SCALE`
+awk -v refs=$refs 'BEGIN {
+    print "<?xml version=\"1.0\"?>";
+    print "<Document xmlns=\"urn:example:perf\">";
+    for(ii = 0; ii < refs; ii++) { printf("<Item Id=\"item-%d\">item %d content</Item>\n", ii, ii); }
+}' > $perffolder/many-refs.tmpl
+(
+    printSignatureStart
+    awk -v refs=$refs 'BEGIN {
+        for(ii = 0; ii < refs; ii++) {
+            printf("<Reference URI=\"#item-%d\"><DigestMethod Algorithm=\"http://www.w3.org/2001/04/xmlenc#sha256\"/><DigestValue></DigestValue></Reference>\n", ii);
+        }
+    }'
+    printSignatureEnd
+    echo '</Document>'
+) >> $perffolder/many-refs.tmpl
+execPerfDSig "many-refs" "$perffolder/many-refs.tmpl" 3000 \
+    "--id-attr:Id urn:example:perf:Item"
+
+#
+# Long XPath Filter 2.0 chain over a large document
+#
+awk -v items=`expr 5000 \* $PERF_SCALE` 'BEGIN {
+    print "<?xml version=\"1.0\"?>";
+    print "<Document>";
+    for(ii = 0; ii < items; ii++) { printf("<Item n=\"%d\"><Value>%d</Value><Skip>%d</Skip></Item>\n", ii % 20, ii, ii); }
+}' > $perffolder/xpath2-chain.tmpl
+(
+    printSignatureStart
+    echo '<Reference URI="">'
+    echo '<Transforms><Transform Algorithm="http://www.w3.org/2002/06/xmldsig-filter2">'
+    awk 'BEGIN {
+        for(ii = 0; ii < 20; ii++) {
+            printf("<XPath xmlns=\"http://www.w3.org/2002/06/xmldsig-filter2\" Filter=\"union\">//Item[@n=\"%d\"]</XPath>\n", ii);
+            printf("<XPath xmlns=\"http://www.w3.org/2002/06/xmldsig-filter2\" Filter=\"subtract\">//Item[@n=\"%d\"]/Skip</XPath>\n", ii);
+        }
+        print "<XPath xmlns=\"http://www.w3.org/2002/06/xmldsig-filter2\" Filter=\"intersect\">/Document/Item</XPath>";
+    }'
+    echo '</Transform></Transforms>'
+    echo '<DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>'
+    echo '<DigestValue></DigestValue>'
+    echo '</Reference>'
+    printSignatureEnd
+    echo '</Document>'
+) >> $perffolder/xpath2-chain.tmpl
+execPerfDSig "xpath2-chain" "$perffolder/xpath2-chain.tmpl" 1000 ""
+
+#
+# Large (4MB) base64 blob decoded by the base64 transform
+#
+echo '<?xml version="1.0"?>' > $perffolder/base64-blob.tmpl
+echo '<Document xmlns="urn:example:perf"><Blob Id="blob">' >> $perffolder/base64-blob.tmpl
+awk -v lines=`expr 87382 \* $PERF_SCALE` 'BEGIN {
+    b64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    srand(1);
+    for(ii = 0; ii < lines; ii++) {
+        line = "";
+        for(jj = 0; jj < 64; jj++) { line = line substr(b64, int(rand() * 64) + 1, 1); }
+        print line;
+    }
+}' >> $perffolder/base64-blob.tmpl
+echo '</Blob>' >> $perffolder/base64-blob.tmpl
+(
+    printSignatureStart
+    echo '<Reference URI="#blob">'
+    echo '<Transforms><Transform Algorithm="http://www.w3.org/2000/09/xmldsig#base64"/></Transforms>'
+    echo '<DigestMethod Algorithm="http://www.w3.org/2001/04/xmlenc#sha256"/>'
+    echo '<DigestValue></DigestValue>'
+    echo '</Reference>'
+    printSignatureEnd
+    echo '</Document>'
+) >> $perffolder/base64-blob.tmpl
+execPerfDSig "base64-blob" "$perffolder/base64-blob.tmpl" 500 \
+    "--id-attr:Id urn:example:perf:Blob"
+
+##########################################################################
+##########################################################################
+##########################################################################
+rm -rf $perffolder
+echo "--- testPerf finished: $count_success passed, $count_fail failed" >> $logfile
+echo "--- testPerf finished: $count_success passed, $count_fail failed"
+echo "--- detailed log is written to  $logfile"
+if [ $count_fail != 0 ] ; then
+    exit 1
+fi
@@ -199,6 +199,31 @@ execKeysTest() {
     rm -f $tmpfile
 }
 
+#
+# API test function (the $xmlsec_app is the testApi program)
+#
+execApiTest() {
+    expected_res="$1"
+    test_name="$2"
+
+    if [ -n "$XMLSEC_TEST_NAME" -a "$XMLSEC_TEST_NAME" != "$test_name" ]; then
+        return
+    fi
+
+    # check params
+    if [ "z$expected_res" != "z$res_success" -a "z$expected_res" != "z$res_fail" ] ; then
+        echo " Bad parameter: expected_res=$expected_res"
+        return
+    fi
+    echo "Test: $test_name ($expected_res)" >> $logfile
+
+    # run test
+    printf "    %-54s" "$test_name"
+    echo "$VALGRIND $xmlsec_app $xmlsec_params $test_name $topfolder" >> $logfile
+    $VALGRIND $xmlsec_app $xmlsec_params $test_name $topfolder >> $logfile 2>> $logfile
+    printRes $expected_res $?
+}
+
 #
 # DSig test function
 #
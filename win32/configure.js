@@ -39,6 +39,7 @@ var versionHeader = baseDir + "\\include\\xmlsec\\version.h";
 var verMajorXmlSec;
 var verMinorXmlSec;
 var verMicroXmlSec;
+var verAbiMinorXmlSec;
 
 /* Libxmlsec features. */
 var withCrypto = "openssl";
@@ -158,6 +159,9 @@ function discoverVersion()
 		} else if(s.search(/^XMLSEC_VERSION_SUBMINOR/) != -1) {
 			vf.WriteLine(s);
 			verMicroXmlSec = s.substring(s.indexOf("=") + 1, s.length)
+		} else if(s.search(/^XMLSEC_VERSION_ABI_MINOR/) != -1) {
+			vf.WriteLine(s);
+			verAbiMinorXmlSec = s.substring(s.indexOf("=") + 1, s.length)
 		}		
 	}
 	cf.Close();
@@ -244,7 +248,7 @@ function configureXmlSecVersion()
 				verMajorXmlSec + "." + verMinorXmlSec + "." + verMicroXmlSec));
 		} else if (s.search(/\@XMLSEC_VERSION_INFO\@/) != -1) {
 			of.WriteLine(s.replace(/\@XMLSEC_VERSION_INFO\@/,
-				(parseInt(verMajorXmlSec) + parseInt(verMinorXmlSec)) + ":" + verMicroXmlSec + ":" + verMinorXmlSec));
+				(parseInt(verMajorXmlSec) + parseInt(verMinorXmlSec)) + ":" + verMicroXmlSec + ":" + (parseInt(verMinorXmlSec) - parseInt(verAbiMinorXmlSec))));
 		} else
 			of.WriteLine(ln);
 	}